@@ -6,6 +6,7 @@
 #include "aadd_message.h"
 #include "action.h"
 #include "minipack.h"
+#include "name_index.h"
 #include "mem.h"
 #include "dbg.h"
 
@@ -61,6 +62,16 @@ void sky_aadd_message_free_action(sky_aadd_message *message)
             sky_action_free(message->action);
         }
         message->action = NULL;
+
+        uint32_t i;
+        for(i=0; i<message->action_count; i++) {
+            if(message->actions[i] && message->actions[i]->action_file == NULL) {
+                sky_action_free(message->actions[i]);
+            }
+        }
+        free(message->actions);
+        message->actions = NULL;
+        message->action_count = 0;
     }
 }
 
@@ -77,7 +88,16 @@ void sky_aadd_message_free_action(sky_aadd_message *message)
 size_t sky_aadd_message_sizeof(sky_aadd_message *message)
 {
     size_t sz = 0;
-    sz += sky_action_sizeof(message->action);
+    if(message->action_count > 0) {
+        uint32_t i;
+        sz += minipack_sizeof_array(message->action_count);
+        for(i=0; i<message->action_count; i++) {
+            sz += sky_action_sizeof(message->actions[i]);
+        }
+    }
+    else {
+        sz += sky_action_sizeof(message->action);
+    }
     return sz;
 }
 
@@ -93,8 +113,21 @@ int sky_aadd_message_pack(sky_aadd_message *message, FILE *file)
     check(message != NULL, "Message required");
     check(file != NULL, "File stream required");
 
-    rc = sky_action_pack(message->action, file);
-    check(rc == 0, "Unable to pack action");
+    // Write a batch as an array of actions.
+    if(message->action_count > 0) {
+        size_t sz;
+        uint32_t i;
+        rc = minipack_fwrite_array(file, message->action_count, &sz);
+        check(rc == 0, "Unable to pack action array");
+        for(i=0; i<message->action_count; i++) {
+            rc = sky_action_pack(message->actions[i], file);
+            check(rc == 0, "Unable to pack action");
+        }
+    }
+    else {
+        rc = sky_action_pack(message->action, file);
+        check(rc == 0, "Unable to pack action");
+    }
     
     return 0;
 
@@ -114,8 +147,28 @@ int sky_aadd_message_unpack(sky_aadd_message *message, FILE *file)
     check(message != NULL, "Message required");
     check(file != NULL, "File stream required");
 
-    rc = sky_action_unpack(message->action, file);
-    check(rc == 0, "Unable to unpack action");
+    // Peek at the first byte to see if the body is a batch.
+    uint8_t buffer[1];
+    check(fread(buffer, sizeof(*buffer), 1, file) == 1, "Unable to read message body type");
+    ungetc(buffer[0], file);
+
+    if(minipack_is_array((void*)buffer)) {
+        size_t sz;
+        uint32_t i, count = minipack_fread_array(file, &sz);
+        check(sz != 0, "Unable to unpack action array");
+        check(count > 0, "Action array cannot be empty");
+        message->actions = calloc(count, sizeof(*message->actions)); check_mem(message->actions);
+        message->action_count = count;
+        for(i=0; i<count; i++) {
+            message->actions[i] = sky_action_create(); check_mem(message->actions[i]);
+            rc = sky_action_unpack(message->actions[i], file);
+            check(rc == 0, "Unable to unpack action");
+        }
+    }
+    else {
+        rc = sky_action_unpack(message->action, file);
+        check(rc == 0, "Unable to unpack action");
+    }
 
     return 0;
 
@@ -128,45 +181,82 @@ error:
 // Processing
 //--------------------------------------
 
-// Applies an AADD message to a table.
+// Applies an AADD message to a table. A batch is checked for names that
+// are already defined or repeated before any action is added.
 //
 // message - The message.
 // table   - The table to apply the message to.
-// output  - The output stream to write to.
+// output  - The buffer to write the response to.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_aadd_message_process(sky_aadd_message *message, sky_table *table,
-                             FILE *output)
+                             sky_buffer *output)
 {
     int rc;
-    size_t sz;
+    uint32_t i;
+    sky_name_index *names = NULL;
     check(message != NULL, "Message required");
     check(table != NULL, "Table required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
 
     struct tagbstring status_str = bsStatic("status");
     struct tagbstring ok_str = bsStatic("ok");
     struct tagbstring action_str = bsStatic("action");
+    struct tagbstring actions_str = bsStatic("actions");
 
-    // Add action.
-    rc = sky_action_file_add_action(table->action_file, message->action);
-    check(rc == 0, "Unable to add action");
+    // Add a single action.
+    if(message->action_count == 0) {
+        rc = sky_action_file_add_action(table->action_file, message->action);
+        check(rc == 0, "Unable to add action");
+    }
+    // Or check the names of a batch and then add each action.
+    else {
+        names = sky_name_index_create(); check_mem(names);
+        for(i=0; i<message->action_count; i++) {
+            sky_action *existing = NULL;
+            rc = sky_action_file_find_action_by_name(table->action_file, message->actions[i]->name, &existing);
+            check(rc == 0 && existing == NULL, "Action already exists with the same name");
+            check(sky_name_index_get(names, message->actions[i]->name) == NULL, "Action name repeated in batch");
+            rc = sky_name_index_put(names, message->actions[i]->name, message->actions[i]);
+            check(rc == 0, "Unable to index action name");
+        }
+        sky_name_index_free(names);
+        names = NULL;
+
+        for(i=0; i<message->action_count; i++) {
+            rc = sky_action_file_add_action(table->action_file, message->actions[i]);
+            if(rc != 0) {
+                // Keep the file in step with the actions that were added.
+                sky_action_file_save(table->action_file);
+            }
+            check(rc == 0, "Unable to add action");
+        }
+    }
     
-    // Save actions file.
+    // Save action file.
     rc = sky_action_file_save(table->action_file);
     check(rc == 0, "Unable to save action file");
     
     // Return.
-    //   {status:"OK", action:{...}}
-    minipack_fwrite_map(output, 2, &sz);
-    check(sz > 0, "Unable to write output");
-    check(sky_minipack_fwrite_bstring(output, &status_str) == 0, "Unable to write status key");
-    check(sky_minipack_fwrite_bstring(output, &ok_str) == 0, "Unable to write status value");
-    check(sky_minipack_fwrite_bstring(output, &action_str) == 0, "Unable to write action key");
-    check(sky_action_pack(message->action, output) == 0, "Unable to write action value");
+    //   {status:"OK", action:{...}} or {status:"OK", actions:[...]}
+    check(sky_buffer_pack_map(output, 2) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    if(message->action_count == 0) {
+        check(sky_buffer_pack_bstring(output, &action_str) == 0, "Unable to write action key");
+        check(sky_action_pack_buffer(message->action, output) == 0, "Unable to write action value");
+    }
+    else {
+        check(sky_buffer_pack_bstring(output, &actions_str) == 0, "Unable to write actions key");
+        check(sky_buffer_pack_array(output, message->action_count) == 0, "Unable to write actions array");
+        for(i=0; i<message->action_count; i++) {
+            check(sky_action_pack_buffer(message->actions[i], output) == 0, "Unable to write action value");
+        }
+    }
     
     return 0;
 
 error:
+    sky_name_index_free(names);
     return -1;
-}
\ No newline at end of file
+}
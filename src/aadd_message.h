@@ -6,10 +6,23 @@
 #include <netinet/in.h>
 
 #include "bstring.h"
+#include "buffer.h"
 #include "table.h"
 #include "event.h"
 
 
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The AADD message body is either a single action or an array of actions. All
+// actions in an array are added to the table and the action file is saved once
+// so that defining many actions at a time, such as during an import, does not
+// write one record at a time.
+
+
 //==============================================================================
 //
 // Typedefs
@@ -19,6 +32,8 @@
 // A message for adding actions to a table.
 typedef struct sky_aadd_message {
     sky_action* action;
+    sky_action **actions;
+    uint32_t action_count;
 } sky_aadd_message;
 
 
@@ -51,6 +66,6 @@ int sky_aadd_message_unpack(sky_aadd_message *message, FILE *file);
 //--------------------------------------
 
 int sky_aadd_message_process(sky_aadd_message *message, sky_table *table,
-    FILE *output);
+    sky_buffer *output);
 
 #endif
@@ -99,6 +99,37 @@ error:
     return -1;
 }
 
+// Serializes an action to a buffer.
+//
+// action - The action.
+// buffer - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_action_pack_buffer(sky_action *action, sky_buffer *buffer)
+{
+    check(action != NULL, "Action required");
+    check(buffer != NULL, "Buffer required");
+
+    struct tagbstring id_str = bsStatic("id");
+    struct tagbstring name_str = bsStatic("name");
+
+    // Map
+    check(sky_buffer_pack_map(buffer, 2) == 0, "Unable to write map");
+
+    // ID
+    check(sky_buffer_pack_bstring(buffer, &id_str) == 0, "Unable to write id key");
+    check(sky_buffer_pack_uint(buffer, action->id) == 0, "Unable to write id value");
+
+    // Name
+    check(sky_buffer_pack_bstring(buffer, &name_str) == 0, "Unable to write name key");
+    check(sky_buffer_pack_bstring(buffer, action->name) == 0, "Unable to write name value");
+
+    return 0;
+
+error:
+    return -1;
+}
+
 // Deserializes an action from a file stream.
 //
 // action - The action.
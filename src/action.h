@@ -8,6 +8,7 @@
 typedef struct sky_action sky_action;
 
 #include "bstring.h"
+#include "buffer.h"
 #include "file.h"
 #include "action_file.h"
 
@@ -59,6 +60,8 @@ size_t sky_action_sizeof(sky_action *action);
 
 int sky_action_pack(sky_action *action, FILE *file);
 
+int sky_action_pack_buffer(sky_action *action, sky_buffer *buffer);
+
 int sky_action_unpack(sky_action *action, FILE *file);
 
 #endif
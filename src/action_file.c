@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <inttypes.h>
+#include <string.h>
 
 #include "dbg.h"
 #include "mem.h"
@@ -8,6 +9,25 @@
 #include "action_file.h"
 #include "minipack.h"
 
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_action_file_index_action(sky_action_file *action_file,
+    sky_action *action);
+
+int sky_action_file_read_action(sky_action_file *action_file, FILE *file,
+    sky_action **ret);
+
+int sky_action_file_write_action(sky_action *action, FILE *file);
+
+int sky_action_file_save_snapshot(sky_action_file *action_file);
+
+int sky_action_file_append(sky_action_file *action_file);
+
+
 //==============================================================================
 //
 // Functions
@@ -26,6 +46,9 @@ sky_action_file *sky_action_file_create()
 {
     sky_action_file *action_file = calloc(sizeof(sky_action_file), 1);
     check_mem(action_file);
+    action_file->name_index = sky_name_index_create();
+    check_mem(action_file->name_index);
+    action_file->loaded = true;
     return action_file;
     
 error:
@@ -42,6 +65,8 @@ void sky_action_file_free(sky_action_file *action_file)
         if(action_file->path) bdestroy(action_file->path);
         action_file->path = NULL;
         sky_action_file_unload(action_file);
+        sky_name_index_free(action_file->name_index);
+        action_file->name_index = NULL;
         free(action_file);
     }
 }
@@ -85,6 +110,10 @@ int sky_action_file_set_path(sky_action_file *action_file, bstring path)
         bdestroy(action_file->path);
     }
     
+    // Nothing is known about the contents of the new file.
+    action_file->snapshot_count = 0;
+    action_file->saved_count = 0;
+
     action_file->path = bstrcpy(path);
     if(path) check_mem(action_file->path);
 
@@ -100,16 +129,17 @@ error:
 // Persistence
 //--------------------------------------
 
-// Loads actions from file.
+// Loads actions from file. The snapshot is read first and then any actions
+// that were appended after it.
 //
 // action_file - The action file to load.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_action_file_load(sky_action_file *action_file)
 {
-    FILE *file;
+    FILE *file = NULL;
     sky_action **actions = NULL;
-    uint32_t count = 0;
+    uint32_t count = 0, snapshot_count = 0, capacity = 0;
     size_t sz;
 
     int rc;
@@ -125,61 +155,188 @@ int sky_action_file_load(sky_action_file *action_file)
         file = fopen(bdata(action_file->path), "r");
         check(file, "Failed to open action file: %s",  bdata(action_file->path));
 
-        // Read action count.
-        count = minipack_fread_array(file, &sz);
+        // Read snapshot count.
+        snapshot_count = minipack_fread_array(file, &sz);
         check(sz != 0, "Unable to read actions array at byte: %ld", ftell(file));
 
         // Allocate actions.
-        actions = malloc(sizeof(sky_action*) * count);
-        if(count > 0) check_mem(actions);
-
-        // Read actions.
-        uint32_t i;
-        for(i=0; i<count; i++) {
-            sky_action *action = sky_action_create();
-            check_mem(action);
-
-            // Read action id.
-            action->id = (sky_action_id_t)minipack_fread_uint(file, &sz);
-            check(sz != 0, "Unable to read action identifier at byte: %ld", ftell(file));
-
-            // Read action name.
-            rc = sky_minipack_fread_bstring(file, &action->name);
-            check(rc == 0, "Unable to read action name at byte: %ld", ftell(file));
-
-            // Append to array.
-            action->action_file = action_file;
-            actions[i] = action;
+        capacity = snapshot_count;
+        actions = malloc(sizeof(sky_action*) * capacity);
+        if(capacity > 0) check_mem(actions);
+
+        // Read the snapshot.
+        for(count=0; count<snapshot_count; count++) {
+            rc = sky_action_file_read_action(action_file, file, &actions[count]);
+            check(rc == 0, "Unable to read action");
+        }
+
+        // Read the actions appended after the snapshot.
+        int c;
+        while((c = fgetc(file)) != EOF) {
+            ungetc(c, file);
+            if(count >= capacity) {
+                capacity = (capacity > 0 ? capacity * 2 : 16);
+                sky_action **new_actions = realloc(actions, sizeof(sky_action*) * capacity);
+                check_mem(new_actions);
+                actions = new_actions;
+            }
+            rc = sky_action_file_read_action(action_file, file, &actions[count]);
+            check(rc == 0, "Unable to read appended action");
+            count++;
         }
 
         // Close the file.
         fclose(file);
+        file = NULL;
     }
 
     // Store action list on action file.
     action_file->actions = actions;
     action_file->action_count = count;
+    action_file->snapshot_count = snapshot_count;
+    action_file->saved_count = count;
+    action_file->loaded = true;
+
+    // Index the actions.
+    uint32_t i;
+    for(i=0; i<count; i++) {
+        rc = sky_action_file_index_action(action_file, actions[i]);
+        check(rc == 0, "Unable to index action");
+    }
 
     return 0;
 
 error:
     if(file) fclose(file);
+    if(action_file->actions == NULL && actions != NULL) {
+        uint32_t j;
+        for(j=0; j<count; j++) {
+            sky_action_free(actions[j]);
+        }
+        free(actions);
+    }
     return -1;
 }
 
-// Saves actions to file.
+// Reads a single action from an action file.
 //
-// action_file - The action file to save.
+// action_file - The action file that the action belongs to.
+// file        - The file stream to read from.
+// ret         - A pointer to where the action should be returned.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_action_file_save(sky_action_file *action_file)
+int sky_action_file_read_action(sky_action_file *action_file, FILE *file,
+                                sky_action **ret)
+{
+    int rc;
+    size_t sz;
+    sky_action *action = sky_action_create();
+    check_mem(action);
+
+    // Read action id.
+    action->id = (sky_action_id_t)minipack_fread_uint(file, &sz);
+    check(sz != 0, "Unable to read action identifier at byte: %ld", ftell(file));
+
+    // Read action name.
+    rc = sky_minipack_fread_bstring(file, &action->name);
+    check(rc == 0, "Unable to read action name at byte: %ld", ftell(file));
+
+    action->action_file = action_file;
+    *ret = action;
+    return 0;
+
+error:
+    sky_action_free(action);
+    *ret = NULL;
+    return -1;
+}
+
+// Writes a single action to an action file.
+//
+// action - The action to write.
+// file   - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_action_file_write_action(sky_action *action, FILE *file)
 {
-    FILE *file;
+    int rc;
     size_t sz;
 
+    // Write action id.
+    minipack_fwrite_uint(file, action->id, &sz);
+    check(sz != 0, "Unable to write action identifier at byte: %ld", ftell(file));
+
+    // Write action name.
+    rc = sky_minipack_fwrite_bstring(file, action->name);
+    check(rc == 0, "Unable to write action name at byte: %ld", ftell(file));
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Loads the actions from file unless they have already been loaded.
+//
+// action_file - The action file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_action_file_ensure_loaded(sky_action_file *action_file)
+{
+    check(action_file != NULL, "Action file required");
+    if(action_file->loaded) {
+        return 0;
+    }
+    return sky_action_file_load(action_file);
+
+error:
+    return -1;
+}
+
+// Saves actions to file. Actions added since the last save are appended to
+// the file. The whole file is rewritten instead if its contents are not
+// known or if the appended actions would outnumber the snapshot.
+//
+// action_file - The action file to save.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_action_file_save(sky_action_file *action_file)
+{
     int rc;
     check(action_file != NULL, "Action file required");
     check(action_file->path != NULL, "Action file path required");
+    rc = sky_action_file_ensure_loaded(action_file);
+    check(rc == 0, "Unable to load actions");
+
+    bool appendable = action_file->saved_count > 0 &&
+        action_file->saved_count <= action_file->action_count &&
+        action_file->action_count - action_file->snapshot_count <= action_file->snapshot_count &&
+        sky_file_exists(action_file->path);
+    if(appendable) {
+        rc = sky_action_file_append(action_file);
+        check(rc == 0, "Unable to append to action file");
+    }
+    else {
+        rc = sky_action_file_save_snapshot(action_file);
+        check(rc == 0, "Unable to save action file snapshot");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Rewrites the action file as a snapshot of every action.
+//
+// action_file - The action file to save.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_action_file_save_snapshot(sky_action_file *action_file)
+{
+    FILE *file = NULL;
+    size_t sz;
+    int rc;
 
     // Open file.
     file = fopen(bdata(action_file->path), "w");
@@ -192,24 +349,62 @@ int sky_action_file_save(sky_action_file *action_file)
     // Write actions.
     uint32_t i;
     for(i=0; i<action_file->action_count; i++) {
-        sky_action *action = action_file->actions[i];
+        rc = sky_action_file_write_action(action_file->actions[i], file);
+        check(rc == 0, "Unable to write action");
+    }
+
+    // Close the file.
+    rc = fclose(file);
+    file = NULL;
+    check(rc == 0, "Unable to close action file: %s", bdata(action_file->path));
+
+    action_file->snapshot_count = action_file->action_count;
+    action_file->saved_count = action_file->action_count;
 
-        // Write action id.
-        minipack_fwrite_uint(file, action->id, &sz);
-        check(sz != 0, "Unable to write action identifier at byte: %ld", ftell(file));
+    return 0;
+
+error:
+    if(file) fclose(file);
+    action_file->snapshot_count = 0;
+    action_file->saved_count = 0;
+    return -1;
+}
 
-        // Write action name.
-        rc = sky_minipack_fwrite_bstring(file, action->name);
-        check(rc == 0, "Unable to write action name at byte: %ld", ftell(file));
+// Appends the actions that have not been saved yet to the action file.
+//
+// action_file - The action file to save.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_action_file_append(sky_action_file *action_file)
+{
+    FILE *file = NULL;
+    int rc;
+
+    if(action_file->saved_count == action_file->action_count) {
+        return 0;
     }
 
-    // Close the file.
-    fclose(file);
+    file = fopen(bdata(action_file->path), "a");
+    check(file, "Failed to open action file: %s", bdata(action_file->path));
+
+    uint32_t i;
+    for(i=action_file->saved_count; i<action_file->action_count; i++) {
+        rc = sky_action_file_write_action(action_file->actions[i], file);
+        check(rc == 0, "Unable to append action");
+    }
+
+    rc = fclose(file);
+    file = NULL;
+    check(rc == 0, "Unable to close action file: %s", bdata(action_file->path));
+
+    action_file->saved_count = action_file->action_count;
 
     return 0;
 
 error:
     if(file) fclose(file);
+    // The file may end with a partial action so it is rewritten next time.
+    action_file->saved_count = 0;
     return -1;
 }
 
@@ -234,6 +429,14 @@ int sky_action_file_unload(sky_action_file *action_file)
         }
         
         action_file->action_count = 0;
+        action_file->snapshot_count = 0;
+        action_file->saved_count = 0;
+
+        // Release indexes.
+        sky_name_index_clear(action_file->name_index);
+        free(action_file->id_index);
+        action_file->id_index = NULL;
+        action_file->id_index_length = 0;
     }
     
     return 0;
@@ -256,19 +459,13 @@ int sky_action_file_find_action_by_id(sky_action_file *action_file,
                                       sky_action **ret)
 {
     check(action_file != NULL, "Action file required");
-    
-    // Initialize return values.
-    *ret = NULL;
-    
-    // Loop over actions to find matching name.
-    uint32_t i;
-    for(i=0; i<action_file->action_count; i++) {
-        if(action_file->actions[i]->id == action_id) {
-            *ret = action_file->actions[i];
-            break;
-        }
+    if(!action_file->loaded) {
+        check(sky_action_file_ensure_loaded(action_file) == 0, "Unable to load actions");
     }
     
+    // Look up the action in the id index.
+    *ret = (action_id < action_file->id_index_length ? action_file->id_index[action_id] : NULL);
+    
     return 0;
 
 error:
@@ -288,19 +485,13 @@ int sky_action_file_find_action_by_name(sky_action_file *action_file,
 {
     check(action_file != NULL, "Action file required");
     check(name != NULL, "Action name required");
-    
-    // Initialize action id to zero.
-    *ret = NULL;
-    
-    // Loop over actions to find matching name.
-    uint32_t i;
-    for(i=0; i<action_file->action_count; i++) {
-        if(biseq(action_file->actions[i]->name, name) == 1) {
-            *ret = action_file->actions[i];
-            break;
-        }
+    if(!action_file->loaded) {
+        check(sky_action_file_ensure_loaded(action_file) == 0, "Unable to load actions");
     }
     
+    // Look up the action in the name index.
+    *ret = sky_name_index_get(action_file->name_index, name);
+    
     return 0;
 
 error:
@@ -344,6 +535,10 @@ int sky_action_file_add_action(sky_action_file *action_file,
     action_file->actions = realloc(action_file->actions, sizeof(sky_action*) * action_file->action_count);
     check_mem(action_file->actions);
     action_file->actions[action_file->action_count-1] = action;
+
+    // Index the action.
+    rc = sky_action_file_index_action(action_file, action);
+    check(rc == 0, "Unable to index action");
     
     return 0;
 
@@ -351,3 +546,66 @@ error:
     return -1;
 }
 
+// Adds an action to the name and id indexes of an action file. The id index
+// grows to fit the action's id.
+//
+// action_file - The action file.
+// action      - The action to index.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_action_file_index_action(sky_action_file *action_file,
+                                 sky_action *action)
+{
+    int rc;
+
+    // Grow the id index by at least double so appends stay amortized.
+    if(action->id >= action_file->id_index_length) {
+        uint32_t length = action_file->id_index_length * 2;
+        if(length <= action->id) {
+            length = action->id + 1;
+        }
+        action_file->id_index = realloc(action_file->id_index, sizeof(*action_file->id_index) * length);
+        check_mem(action_file->id_index);
+        memset(&action_file->id_index[action_file->id_index_length], 0, sizeof(*action_file->id_index) * (length - action_file->id_index_length));
+        action_file->id_index_length = length;
+    }
+    action_file->id_index[action->id] = action;
+
+    rc = sky_name_index_put(action_file->name_index, action->name, action);
+    check(rc == 0, "Unable to add action to name index");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+// Calculates the heap memory used by the actions of an action file and
+// their indexes.
+//
+// action_file - The action file.
+//
+// Returns the number of bytes.
+size_t sky_action_file_get_memory_usage(sky_action_file *action_file)
+{
+    uint32_t i;
+    if(action_file == NULL) {
+        return 0;
+    }
+
+    size_t size = sizeof(*action_file);
+    size += sizeof(*action_file->actions) * action_file->action_count;
+    size += sizeof(*action_file->id_index) * action_file->id_index_length;
+    size += sky_name_index_get_memory_usage(action_file->name_index);
+    for(i=0; i<action_file->action_count; i++) {
+        sky_action *action = action_file->actions[i];
+        size += sizeof(*action);
+        if(action->name != NULL) size += sizeof(*action->name) + action->name->mlen;
+    }
+    return size;
+}
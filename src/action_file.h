@@ -10,6 +10,7 @@ typedef struct sky_action_file sky_action_file;
 #include "file.h"
 #include "types.h"
 #include "action.h"
+#include "name_index.h"
 
 //==============================================================================
 //
@@ -21,6 +22,24 @@ typedef struct sky_action_file sky_action_file;
 // stored in an associated table. Each table has one action file. Currently
 // actions only support a numeric ID and a name but additional fields may be
 // allowed in the future.
+//
+// Actions are indexed by name with a hash table and by id with a dense array
+// so both lookups run in constant time. The indexes are built when the file
+// is loaded and are updated as actions are added.
+//
+// A new action file starts out empty. A table instead only sets the path of
+// its action file and marks it as not loaded when the table is opened. The
+// file is then loaded the first time an action is looked up, added or saved
+// so that opening a table does not read files that its messages never use.
+// Code that reads the action list directly must load it first with
+// sky_action_file_ensure_loaded().
+//
+// The file is a log. It starts with a snapshot, which is an array of
+// actions, and actions added after the snapshot was written follow it one
+// after another. Saving only appends the actions that are not in the file
+// yet so adding many actions one at a time stays linear. The file is
+// rewritten as a single snapshot once the appended actions outnumber the
+// actions in the snapshot.
 
 
 //==============================================================================
@@ -33,6 +52,12 @@ struct sky_action_file {
     bstring path;
     sky_action **actions;
     uint32_t action_count;
+    sky_name_index *name_index;
+    sky_action **id_index;
+    uint32_t id_index_length;
+    bool loaded;
+    uint32_t snapshot_count;
+    uint32_t saved_count;
 };
 
 
@@ -66,6 +91,8 @@ int sky_action_file_get_path(sky_action_file *action_file, bstring *path);
 
 int sky_action_file_load(sky_action_file *action_file);
 
+int sky_action_file_ensure_loaded(sky_action_file *action_file);
+
 int sky_action_file_unload(sky_action_file *action_file);
 
 int sky_action_file_save(sky_action_file *action_file);
@@ -83,4 +110,10 @@ int sky_action_file_find_action_by_name(sky_action_file *action_file,
 
 int sky_action_file_add_action(sky_action_file *action_file, sky_action *ret);
 
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+size_t sky_action_file_get_memory_usage(sky_action_file *action_file);
+
 #endif
@@ -0,0 +1,345 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "action_index.h"
+#include "block.h"
+#include "path_iterator.h"
+#include "cursor.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+bool sky_action_index_list_contains(sky_action_index_list *list,
+    sky_object_id_t object_id, uint32_t *index);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty action index. The index is not built until
+// sky_action_index_build() is called.
+//
+// Returns a reference to the new index if successful. Otherwise returns
+// null.
+sky_action_index *sky_action_index_create()
+{
+    sky_action_index *index = calloc(1, sizeof(sky_action_index)); check_mem(index);
+    return index;
+
+error:
+    sky_action_index_free(index);
+    return NULL;
+}
+
+// Removes an action index from memory.
+//
+// index - The index to free.
+void sky_action_index_free(sky_action_index *index)
+{
+    if(index) {
+        sky_action_index_clear(index);
+        free(index);
+    }
+}
+
+// Removes every list from the index and marks it as not built.
+//
+// index - The index.
+void sky_action_index_clear(sky_action_index *index)
+{
+    uint32_t i;
+    if(index == NULL) return;
+
+    for(i=0; i<index->list_count; i++) {
+        free(index->lists[i].object_ids);
+    }
+    free(index->lists);
+    index->lists = NULL;
+    index->list_count = 0;
+    index->built = false;
+}
+
+
+//--------------------------------------
+// Maintenance
+//--------------------------------------
+
+// Rebuilds the index from every event in a data file.
+//
+// index     - The index.
+// data_file - The data file to read.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_action_index_build(sky_action_index *index, sky_data_file *data_file)
+{
+    int rc;
+    check(index != NULL, "Action index required");
+
+    sky_action_index_clear(index);
+    rc = sky_action_index_add_data_file(index, data_file);
+    check(rc == 0, "Unable to add data file to action index");
+
+    index->built = true;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Adds every event in a data file to the index. The index is cleared if
+// the data file cannot be read.
+//
+// index     - The index.
+// data_file - The data file to read.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_action_index_add_data_file(sky_action_index *index,
+                                   sky_data_file *data_file)
+{
+    int rc;
+    uint32_t i;
+    sky_block *pinned_block = NULL;
+    check(index != NULL, "Action index required");
+    check(data_file != NULL, "Data file required");
+
+    // Every part of a spanned path is read so each block is walked alone.
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block *block = data_file->blocks[i];
+        rc = sky_block_pin(block);
+        check(rc == 0, "Unable to pin block");
+        pinned_block = block;
+
+        sky_path_iterator iterator;
+        sky_path_iterator_init(&iterator);
+        rc = sky_path_iterator_set_block(&iterator, block);
+        check(rc == 0, "Unable to set path iterator block");
+
+        while(!iterator.eof) {
+            void *path_ptr = NULL;
+            rc = sky_path_iterator_get_ptr(&iterator, &path_ptr);
+            check(rc == 0, "Unable to retrieve the path iterator pointer");
+
+            if(data_file->action_only) {
+                sky_path_foreach_action_only_event(path_ptr, event_ptr) {
+                    rc = sky_action_index_add(index, sky_cursor_action_only_get_action_id(event_ptr), iterator.current_object_id);
+                    check(rc == 0, "Unable to add event to action index");
+                }
+            }
+            else {
+                sky_path_foreach_event(path_ptr, event_ptr) {
+                    rc = sky_action_index_add(index, sky_cursor_fast_get_action_id(event_ptr), iterator.current_object_id);
+                    check(rc == 0, "Unable to add event to action index");
+                }
+            }
+
+            rc = sky_path_iterator_next(&iterator);
+            check(rc == 0, "Unable to find next path");
+        }
+
+        sky_block_unpin(block);
+        pinned_block = NULL;
+    }
+
+    return 0;
+
+error:
+    sky_block_unpin(pinned_block);
+    sky_action_index_clear(index);
+    return -1;
+}
+
+// Records that an object has performed an action. Events without an action
+// are ignored.
+//
+// index     - The index.
+// action_id - The action id.
+// object_id - The object id.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_action_index_add(sky_action_index *index, sky_action_id_t action_id,
+                         sky_object_id_t object_id)
+{
+    check(index != NULL, "Action index required");
+    if(action_id == 0) {
+        return 0;
+    }
+
+    // Add lists up to the action id.
+    if(action_id >= index->list_count) {
+        uint32_t list_count = action_id + 1;
+        sky_action_index_list *lists = realloc(index->lists, sizeof(*lists) * list_count);
+        check_mem(lists);
+        memset(&lists[index->list_count], 0, sizeof(*lists) * (list_count - index->list_count));
+        index->lists = lists;
+        index->list_count = list_count;
+    }
+
+    // Objects are mostly added in order so the end is checked first.
+    sky_action_index_list *list = &index->lists[action_id];
+    uint32_t insert_index = list->count;
+    if(list->count > 0 && list->object_ids[list->count-1] >= object_id) {
+        if(sky_action_index_list_contains(list, object_id, &insert_index)) {
+            return 0;
+        }
+    }
+
+    if(list->count == list->capacity) {
+        uint32_t capacity = (list->capacity > 0 ? list->capacity * 2 : 8);
+        sky_object_id_t *object_ids = realloc(list->object_ids, sizeof(*object_ids) * capacity);
+        check_mem(object_ids);
+        list->object_ids = object_ids;
+        list->capacity = capacity;
+    }
+    memmove(&list->object_ids[insert_index+1], &list->object_ids[insert_index], sizeof(*list->object_ids) * (list->count - insert_index));
+    list->object_ids[insert_index] = object_id;
+    list->count++;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+// Finds the objects that have performed every one of a set of actions.
+//
+// index           - The index.
+// action_ids      - The action ids.
+// action_id_count - The number of action ids.
+// object_ids      - A pointer to where the sorted object ids should be
+//                   returned. The caller owns the array. This is NULL if no
+//                   object has performed every action.
+// object_id_count - A pointer to where the number of object ids should be
+//                   returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_action_index_get_object_ids(sky_action_index *index,
+                                    sky_action_id_t *action_ids,
+                                    uint32_t action_id_count,
+                                    sky_object_id_t **object_ids,
+                                    uint32_t *object_id_count)
+{
+    uint32_t i, j;
+    check(index != NULL, "Action index required");
+    check(action_ids != NULL && action_id_count > 0, "Action ids required");
+    check(object_ids != NULL, "Object ids return pointer required");
+    check(object_id_count != NULL, "Object id count return pointer required");
+    *object_ids = NULL;
+    *object_id_count = 0;
+
+    // Start from the shortest list. An action that nobody performed leaves
+    // no objects.
+    sky_action_index_list *shortest = NULL;
+    for(i=0; i<action_id_count; i++) {
+        if(action_ids[i] == 0 || action_ids[i] >= index->list_count || index->lists[action_ids[i]].count == 0) {
+            return 0;
+        }
+        sky_action_index_list *list = &index->lists[action_ids[i]];
+        if(shortest == NULL || list->count < shortest->count) {
+            shortest = list;
+        }
+    }
+
+    *object_ids = malloc(sizeof(**object_ids) * shortest->count);
+    check_mem(*object_ids);
+    memcpy(*object_ids, shortest->object_ids, sizeof(**object_ids) * shortest->count);
+    *object_id_count = shortest->count;
+
+    // Keep the objects that are in every other list.
+    for(i=0; i<action_id_count && *object_id_count > 0; i++) {
+        sky_action_index_list *list = &index->lists[action_ids[i]];
+        if(list == shortest) {
+            continue;
+        }
+
+        uint32_t count = 0;
+        for(j=0; j<*object_id_count; j++) {
+            if(sky_action_index_list_contains(list, (*object_ids)[j], NULL)) {
+                (*object_ids)[count++] = (*object_ids)[j];
+            }
+        }
+        *object_id_count = count;
+    }
+
+    if(*object_id_count == 0) {
+        free(*object_ids);
+        *object_ids = NULL;
+    }
+
+    return 0;
+
+error:
+    if(object_ids) {
+        free(*object_ids);
+        *object_ids = NULL;
+    }
+    if(object_id_count) *object_id_count = 0;
+    return -1;
+}
+
+// Searches a list for an object id.
+//
+// list      - The list.
+// object_id - The object id to find.
+// index     - A pointer to where the index of the object id, or the index it
+//             would be inserted at, is returned. This can be null.
+//
+// Returns true if the list contains the object id.
+bool sky_action_index_list_contains(sky_action_index_list *list,
+                                    sky_object_id_t object_id, uint32_t *index)
+{
+    uint32_t min = 0, max = list->count;
+    while(min < max) {
+        uint32_t mid = min + ((max - min) / 2);
+        if(list->object_ids[mid] < object_id) {
+            min = mid + 1;
+        }
+        else {
+            max = mid;
+        }
+    }
+
+    if(index != NULL) *index = min;
+    return (min < list->count && list->object_ids[min] == object_id);
+}
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+// Calculates the heap memory used by the lists of an action index.
+//
+// index - The index.
+//
+// Returns the number of bytes.
+size_t sky_action_index_get_memory_usage(sky_action_index *index)
+{
+    uint32_t i;
+    if(index == NULL) {
+        return 0;
+    }
+
+    size_t size = sizeof(*index) + (sizeof(*index->lists) * index->list_count);
+    for(i=0; i<index->list_count; i++) {
+        size += sizeof(*index->lists[i].object_ids) * index->lists[i].capacity;
+    }
+    return size;
+}
@@ -0,0 +1,96 @@
+#ifndef _sky_action_index_h
+#define _sky_action_index_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "types.h"
+#include "data_file.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The action index maps each action id to the sorted list of object ids
+// that have performed it. Queries that need an object to have performed
+// certain actions, such as the prior actions of a 'Next Action' query,
+// intersect the lists of those actions and only scan the blocks and paths
+// of the objects that are left.
+//
+// The index is built from the data file the first time it is used and is
+// kept up to date as events are added. Removing events does not remove
+// object ids from the index so a list can hold objects that no longer have
+// the action. The lists are only used to rule objects out so this never
+// changes the results of a query.
+//
+// An action index is not thread safe. It is updated on the worker that owns
+// its table.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// The sorted object ids that have performed one action.
+typedef struct sky_action_index_list {
+    sky_object_id_t *object_ids;
+    uint32_t count;
+    uint32_t capacity;
+} sky_action_index_list;
+
+// The lists are indexed by action id.
+typedef struct sky_action_index {
+    bool built;
+    sky_action_index_list *lists;
+    uint32_t list_count;
+} sky_action_index;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_action_index *sky_action_index_create();
+
+void sky_action_index_free(sky_action_index *index);
+
+void sky_action_index_clear(sky_action_index *index);
+
+//--------------------------------------
+// Maintenance
+//--------------------------------------
+
+int sky_action_index_build(sky_action_index *index, sky_data_file *data_file);
+
+int sky_action_index_add_data_file(sky_action_index *index,
+    sky_data_file *data_file);
+
+int sky_action_index_add(sky_action_index *index, sky_action_id_t action_id,
+    sky_object_id_t object_id);
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+int sky_action_index_get_object_ids(sky_action_index *index,
+    sky_action_id_t *action_ids, uint32_t action_id_count,
+    sky_object_id_t **object_ids, uint32_t *object_id_count);
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+size_t sky_action_index_get_memory_usage(sky_action_index *index);
+
+#endif
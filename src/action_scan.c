@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "action_scan.h"
+#include "dbg.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SKY_ACTION_SCAN_X86 1
+#include <immintrin.h>
+#else
+#define SKY_ACTION_SCAN_X86 0
+#endif
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+uint32_t sky_action_scan_find_scalar(sky_action_id_t *action_ids,
+    uint32_t start, uint32_t end, sky_action_id_t action_id);
+
+#if SKY_ACTION_SCAN_X86
+uint32_t sky_action_scan_find_sse2(sky_action_id_t *action_ids,
+    uint32_t start, uint32_t end, sky_action_id_t action_id);
+
+uint32_t sky_action_scan_find_avx2(sky_action_id_t *action_ids,
+    uint32_t start, uint32_t end, sky_action_id_t action_id);
+#endif
+
+void sky_action_scan_init();
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+// The search function and vector width chosen for the current CPU.
+pthread_once_t sky_action_scan_once = PTHREAD_ONCE_INIT;
+sky_action_scan_find_func sky_action_scan_find_best = sky_action_scan_find_scalar;
+uint32_t sky_action_scan_width = 1;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Dispatch
+//--------------------------------------
+
+// Chooses the widest search supported by the CPU.
+void sky_action_scan_init()
+{
+#if SKY_ACTION_SCAN_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        sky_action_scan_find_best = sky_action_scan_find_avx2;
+        sky_action_scan_width = 16;
+    }
+    else {
+        sky_action_scan_find_best = sky_action_scan_find_sse2;
+        sky_action_scan_width = 8;
+    }
+#endif
+}
+
+// Retrieves the number of action ids that are compared at a time by the
+// search chosen for the current CPU.
+//
+// Returns the vector width of the search.
+uint32_t sky_action_scan_get_width()
+{
+    pthread_once(&sky_action_scan_once, sky_action_scan_init);
+    return sky_action_scan_width;
+}
+
+// Retrieves the search function for a given vector width.
+//
+// width - The number of action ids compared at a time. This must be 1, 8 or
+//         16.
+//
+// Returns the search function or NULL if the width is not supported by this
+// CPU.
+sky_action_scan_find_func sky_action_scan_get_find_func(uint32_t width)
+{
+    switch(width) {
+        case 1: return sky_action_scan_find_scalar;
+#if SKY_ACTION_SCAN_X86
+        case 8: return sky_action_scan_find_sse2;
+        case 16: return (sky_action_scan_get_width() >= 16 ? sky_action_scan_find_avx2 : NULL);
+#endif
+        default: return NULL;
+    }
+}
+
+
+//--------------------------------------
+// Search
+//--------------------------------------
+
+// Finds the first action id equal to a given value using the widest search
+// supported by the CPU.
+//
+// action_ids - The array of action ids to search.
+// start      - The index to start searching from.
+// end        - The index to stop searching at.
+// action_id  - The action id to search for.
+//
+// Returns the index of the first matching action id or end if there is none.
+uint32_t sky_action_scan_find(sky_action_id_t *action_ids, uint32_t start,
+                              uint32_t end, sky_action_id_t action_id)
+{
+    pthread_once(&sky_action_scan_once, sky_action_scan_init);
+    return sky_action_scan_find_best(action_ids, start, end, action_id);
+}
+
+// Finds the first matching action id one id at a time.
+//
+// action_ids - The array of action ids to search.
+// start      - The index to start searching from.
+// end        - The index to stop searching at.
+// action_id  - The action id to search for.
+//
+// Returns the index of the first matching action id or end if there is none.
+uint32_t sky_action_scan_find_scalar(sky_action_id_t *action_ids,
+                                     uint32_t start, uint32_t end,
+                                     sky_action_id_t action_id)
+{
+    uint32_t i;
+    for(i=start; i<end; i++) {
+        if(action_ids[i] == action_id) {
+            return i;
+        }
+    }
+    return end;
+}
+
+#if SKY_ACTION_SCAN_X86
+
+// Finds the first matching action id eight ids at a time using SSE2. The
+// compare mask has two bits per action id so the index of the first match is
+// half of the position of the lowest set bit.
+//
+// action_ids - The array of action ids to search.
+// start      - The index to start searching from.
+// end        - The index to stop searching at.
+// action_id  - The action id to search for.
+//
+// Returns the index of the first matching action id or end if there is none.
+uint32_t sky_action_scan_find_sse2(sky_action_id_t *action_ids,
+                                   uint32_t start, uint32_t end,
+                                   sky_action_id_t action_id)
+{
+    uint32_t i = start;
+    __m128i needle = _mm_set1_epi16((short)action_id);
+    for(; i+8 <= end; i+=8) {
+        __m128i chunk = _mm_loadu_si128((__m128i*)(action_ids + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(chunk, needle));
+        if(mask != 0) {
+            return i + (__builtin_ctz(mask) / 2);
+        }
+    }
+    return sky_action_scan_find_scalar(action_ids, i, end, action_id);
+}
+
+// Finds the first matching action id sixteen ids at a time using AVX2.
+//
+// action_ids - The array of action ids to search.
+// start      - The index to start searching from.
+// end        - The index to stop searching at.
+// action_id  - The action id to search for.
+//
+// Returns the index of the first matching action id or end if there is none.
+__attribute__((target("avx2")))
+uint32_t sky_action_scan_find_avx2(sky_action_id_t *action_ids,
+                                   uint32_t start, uint32_t end,
+                                   sky_action_id_t action_id)
+{
+    uint32_t i = start;
+    __m256i needle = _mm256_set1_epi16((short)action_id);
+    for(; i+16 <= end; i+=16) {
+        __m256i chunk = _mm256_loadu_si256((__m256i*)(action_ids + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi16(chunk, needle));
+        if(mask != 0) {
+            return i + (__builtin_ctz(mask) / 2);
+        }
+    }
+    return sky_action_scan_find_sse2(action_ids, i, end, action_id);
+}
+
+#endif
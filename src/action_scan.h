@@ -0,0 +1,62 @@
+#ifndef _action_scan_h
+#define _action_scan_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "types.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The action scan provides vectorized search over dense arrays of action ids
+// such as the ones stored in block columns. Sequence matching queries spend
+// most of their time looking for the first action of a sequence so finding
+// that action several ids at a time lets them skip over long runs of events
+// that cannot start a match.
+//
+// On x86-64 there are SSE2 (8 ids at a time) and AVX2 (16 ids at a time)
+// versions of the search. The widest version supported by the CPU is chosen
+// at runtime the first time a search is performed. Other platforms use the
+// scalar version.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A function that returns the index of the first action id equal to a value
+// in the range [start, end) or end if there is none.
+typedef uint32_t (*sky_action_scan_find_func)(sky_action_id_t *action_ids,
+    uint32_t start, uint32_t end, sky_action_id_t action_id);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Dispatch
+//--------------------------------------
+
+uint32_t sky_action_scan_get_width();
+
+sky_action_scan_find_func sky_action_scan_get_find_func(uint32_t width);
+
+
+//--------------------------------------
+// Search
+//--------------------------------------
+
+uint32_t sky_action_scan_find(sky_action_id_t *action_ids, uint32_t start,
+    uint32_t end, sky_action_id_t action_id);
+
+#endif
@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// Rounds a size up to the arena alignment.
+#define SKY_ARENA_ALIGN(SIZE) \
+    (((SIZE) + (SKY_ARENA_ALIGNMENT-1)) & ~((size_t)SKY_ARENA_ALIGNMENT-1))
+
+// The size of the chunk header. The data of a chunk starts after it.
+#define SKY_ARENA_CHUNK_HEADER_SIZE SKY_ARENA_ALIGN(sizeof(sky_arena_chunk))
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_arena_next_chunk(sky_arena *arena, size_t size);
+
+void sky_arena_set_chunk(sky_arena *arena, sky_arena_chunk *chunk);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty arena. No memory is allocated until the first allocation.
+//
+// chunk_size - The size of each chunk or zero to use the default size.
+//
+// Returns a reference to the new arena if successful. Otherwise returns null.
+sky_arena *sky_arena_create(size_t chunk_size)
+{
+    sky_arena *arena = calloc(1, sizeof(sky_arena)); check_mem(arena);
+    arena->chunk_size = (chunk_size > 0 ? chunk_size : SKY_ARENA_DEFAULT_CHUNK_SIZE);
+    return arena;
+
+error:
+    sky_arena_free(arena);
+    return NULL;
+}
+
+// Removes an arena and all of its chunks from memory.
+//
+// arena - The arena to free.
+void sky_arena_free(sky_arena *arena)
+{
+    if(arena) {
+        sky_arena_chunk *chunk = arena->head;
+        while(chunk != NULL) {
+            sky_arena_chunk *next = chunk->next;
+            free(chunk);
+            chunk = next;
+        }
+        free(arena);
+    }
+}
+
+
+//--------------------------------------
+// Allocation
+//--------------------------------------
+
+// Allocates memory from the arena. The memory is valid until the arena is
+// reset or freed.
+//
+// arena - The arena.
+// size  - The number of bytes to allocate.
+//
+// Returns a pointer to the memory if successful. Otherwise returns null.
+void *sky_arena_alloc(sky_arena *arena, size_t size)
+{
+    int rc;
+    check(arena != NULL, "Arena required");
+
+    size = SKY_ARENA_ALIGN(size > 0 ? size : 1);
+    if(arena->ptr == NULL || (size_t)(arena->endptr - arena->ptr) < size) {
+        rc = sky_arena_next_chunk(arena, size);
+        check(rc == 0, "Unable to allocate arena chunk");
+    }
+
+    void *ptr = arena->ptr;
+    arena->ptr += size;
+    return ptr;
+
+error:
+    return NULL;
+}
+
+// Allocates zeroed memory for an array from the arena.
+//
+// arena - The arena.
+// count - The number of elements.
+// size  - The size of each element.
+//
+// Returns a pointer to the memory if successful. Otherwise returns null.
+void *sky_arena_calloc(sky_arena *arena, size_t count, size_t size)
+{
+    void *ptr = sky_arena_alloc(arena, count * size);
+    if(ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+// Resizes memory that was allocated from the arena. The most recent
+// allocation is grown in place when there is room in its chunk. Otherwise
+// new memory is allocated and the old contents are copied into it.
+//
+// arena    - The arena.
+// ptr      - The memory to resize or NULL.
+// old_size - The size of the memory when it was allocated.
+// size     - The new size.
+//
+// Returns a pointer to the memory if successful. Otherwise returns null.
+void *sky_arena_realloc(sky_arena *arena, void *ptr, size_t old_size,
+                        size_t size)
+{
+    check(arena != NULL, "Arena required");
+
+    // Grow the last allocation in place if it fits.
+    if(ptr != NULL && ptr + SKY_ARENA_ALIGN(old_size) == arena->ptr && (size_t)(arena->endptr - ptr) >= SKY_ARENA_ALIGN(size)) {
+        arena->ptr = ptr + SKY_ARENA_ALIGN(size > 0 ? size : 1);
+        return ptr;
+    }
+
+    void *new_ptr = sky_arena_alloc(arena, size);
+    check(new_ptr != NULL, "Unable to allocate arena memory");
+    if(ptr != NULL) {
+        memcpy(new_ptr, ptr, (old_size < size ? old_size : size));
+    }
+    return new_ptr;
+
+error:
+    return NULL;
+}
+
+// Releases all the memory allocated from the arena. This rewinds the arena
+// to its first chunk and keeps every chunk for reuse so it runs in constant
+// time.
+//
+// arena - The arena.
+void sky_arena_reset(sky_arena *arena)
+{
+    if(arena) {
+        sky_arena_set_chunk(arena, arena->head);
+    }
+}
+
+
+//--------------------------------------
+// Chunk Management
+//--------------------------------------
+
+// Moves the arena to the next chunk that can fit an allocation. Chunks that
+// were kept from earlier requests are reused before a new chunk is created.
+// New chunks are inserted after the current chunk.
+//
+// arena - The arena.
+// size  - The size of the allocation that the chunk has to fit.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_arena_next_chunk(sky_arena *arena, size_t size)
+{
+    // Reuse the next kept chunk if it is large enough.
+    sky_arena_chunk *next = (arena->current != NULL ? arena->current->next : arena->head);
+    if(next != NULL && next->size >= size) {
+        sky_arena_set_chunk(arena, next);
+        return 0;
+    }
+
+    // Otherwise create a new chunk. Oversized allocations get their own chunk.
+    size_t chunk_size = (size > arena->chunk_size ? size : arena->chunk_size);
+    sky_arena_chunk *chunk = malloc(SKY_ARENA_CHUNK_HEADER_SIZE + chunk_size);
+    check_mem(chunk);
+    chunk->size = chunk_size;
+    chunk->next = next;
+    if(arena->current != NULL) {
+        arena->current->next = chunk;
+    }
+    else {
+        arena->head = chunk;
+    }
+
+    sky_arena_set_chunk(arena, chunk);
+    return 0;
+
+error:
+    return -1;
+}
+
+// Points the arena at the start of a chunk.
+//
+// arena - The arena.
+// chunk - The chunk or NULL if the arena has no chunks.
+void sky_arena_set_chunk(sky_arena *arena, sky_arena_chunk *chunk)
+{
+    arena->current = chunk;
+    if(chunk != NULL) {
+        arena->ptr = ((void*)chunk) + SKY_ARENA_CHUNK_HEADER_SIZE;
+        arena->endptr = arena->ptr + chunk->size;
+    }
+    else {
+        arena->ptr = NULL;
+        arena->endptr = NULL;
+    }
+}
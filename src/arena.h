@@ -0,0 +1,91 @@
+#ifndef _arena_h
+#define _arena_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct sky_arena sky_arena;
+typedef struct sky_arena_chunk sky_arena_chunk;
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// An arena is a region allocator for temporary memory that lives for the
+// duration of a single request. Allocations are carved out of large chunks by
+// bumping a pointer and are never freed individually. Instead the whole arena
+// is reset once the request is finished.
+//
+// Resetting only rewinds the arena to its first chunk so it takes constant
+// time and the chunks are reused by the next request. Once an arena has grown
+// to the size of a typical request it stops calling malloc altogether.
+//
+// An arena is not thread safe. Each worker owns its own arena.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The default size of each chunk.
+#define SKY_ARENA_DEFAULT_CHUNK_SIZE (64 * 1024)
+
+// The alignment of every allocation.
+#define SKY_ARENA_ALIGNMENT 16
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+struct sky_arena_chunk {
+    sky_arena_chunk *next;
+    size_t size;
+};
+
+struct sky_arena {
+    size_t chunk_size;
+    sky_arena_chunk *head;
+    sky_arena_chunk *current;
+    void *ptr;
+    void *endptr;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_arena *sky_arena_create(size_t chunk_size);
+
+void sky_arena_free(sky_arena *arena);
+
+
+//--------------------------------------
+// Allocation
+//--------------------------------------
+
+void *sky_arena_alloc(sky_arena *arena, size_t size);
+
+void *sky_arena_calloc(sky_arena *arena, size_t count, size_t size);
+
+void *sky_arena_realloc(sky_arena *arena, void *ptr, size_t old_size,
+    size_t size);
+
+void sky_arena_reset(sky_arena *arena);
+
+#endif
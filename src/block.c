@@ -11,6 +11,23 @@
 #include "block.h"
 #include "path.h"
 #include "path_iterator.h"
+#include "compression.h"
+#include "crc32c.h"
+#include "cursor.h"
+#include "predicate.h"
+#include "minipack.h"
+#include "minipack_batch.h"
+#include "stats.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of bits set in the bloom filter for each object id.
+#define SKY_BLOCK_BLOOM_HASH_COUNT 3
 
 
 //==============================================================================
@@ -20,13 +37,38 @@
 //==============================================================================
 
 int sky_block_get_insertion_info(sky_block *block, sky_event *event,
-    void **path_ptr, void **event_ptr, size_t *block_data_length);
+    void **path_ptr, void **event_ptr, sky_timestamp_t *previous_timestamp,
+    size_t *block_data_length);
 
 int sky_block_split_with_event(sky_block *block, sky_event *event,
     sky_block **target_block);
 
 int sky_block_span_with_event(sky_block *block, sky_event *new_event,
-    void *path_ptr, uint32_t target_size, sky_block **target_block);
+    void *path_ptr, uint32_t target_size, sky_block **tail_block,
+    sky_block **target_block);
+
+int sky_block_detect_compression(sky_block *block);
+
+int sky_block_get_data_length(sky_block *block, size_t *length);
+
+int sky_block_build_bloom(sky_block *block);
+
+void sky_block_add_bloom(sky_block *block, sky_object_id_t object_id);
+
+void sky_block_remove_range(void *block_ptr, size_t block_data_length,
+    void *ptr, size_t length);
+
+uint32_t sky_block_get_bloom_bit(sky_object_id_t object_id, uint32_t index);
+
+int sky_block_build_zones(sky_block *block);
+
+int sky_block_add_zone_value(sky_block *block, sky_property_id_t property_id,
+    int64_t value);
+
+int sky_block_add_event_to_zones(sky_block *block, sky_event *event);
+
+int sky_block_update_directory(sky_block *block, sky_event *event,
+    bool path_exists, size_t offset, size_t sz);
 
 
 
@@ -46,11 +88,9 @@ int sky_block_span_with_event(sky_block *block, sky_event *new_event,
 // returns null.
 sky_block *sky_block_create(sky_data_file *data_file)
 {
-    sky_block *block = calloc(sizeof(sky_block), 1);
+    sky_block *block = malloc(sizeof(sky_block));
     check_mem(block);
-
-    block->data_file = data_file;
-    
+    sky_block_init(block, data_file);
     return block;
     
 error:
@@ -62,17 +102,49 @@ error:
 void sky_block_free(sky_block *block)
 {
     if(block) {
-        memset(block, 0, sizeof(*block));
+        sky_block_uninit(block);
         free(block);
     }
 }
 
+// Initializes a block object in memory owned by the caller. Data files use
+// this to allocate the blocks in their header all at once.
+//
+// block     - The block to initialize.
+// data_file - The data file that the block belongs to.
+void sky_block_init(sky_block *block, sky_data_file *data_file)
+{
+    memset(block, 0, sizeof(*block));
+    block->data_file = data_file;
+    block->checksum_verified = true;
+    block->write_version = __sync_add_and_fetch(&sky_data_file_last_write_version, 1);
+}
+
+// Releases everything a block object holds on to without freeing the block
+// object itself.
+//
+// block - The block.
+void sky_block_uninit(sky_block *block)
+{
+    if(block) {
+        if(block->cache_entry != NULL && block->data_file != NULL) {
+            sky_block_cache_remove(block->data_file->block_cache, block);
+        }
+        sky_block_column_free(block->column);
+        free(block->zones);
+        free(block->directory);
+        memset(block, 0, sizeof(*block));
+    }
+}
+
 
 //--------------------------------------
 // Persistence
 //--------------------------------------
 
-// Syncs the in-memory block back to disk.
+// Saves the block to disk. If the data file is batching changes or is not in
+// strict durability mode then the block is only flagged as dirty and is synced
+// when the data file is flushed.
 //
 // block - The block to save.
 //
@@ -81,31 +153,125 @@ int sky_block_save(sky_block *block)
 {
     int rc;
     check(block != NULL, "Block required");
+    check(block->data_file != NULL, "Data file required");
+
+    rc = sky_block_save_range(block, 0, block->data_file->block_size);
+    check(rc == 0, "Unable to save block");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Saves part of a block to disk. Only the pages that hold the changed bytes
+// are synced so small changes cost the same regardless of how full the block
+// is. Deferred blocks are flagged as dirty and are synced in full when the
+// data file is flushed.
+//
+// block  - The block to save.
+// offset - The offset of the changed bytes within the block.
+// length - The number of changed bytes.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_save_range(sky_block *block, size_t offset, size_t length)
+{
+    int rc;
+    check(block != NULL, "Block required");
+
+    // Changes are normally journaled before they are made. This covers the
+    // ones that were not.
+    rc = sky_data_file_journal_block(block->data_file, block);
+    check(rc == 0, "Unable to journal block");
+
+    block->modified_at = time(NULL);
+    block->write_version = __sync_add_and_fetch(&sky_data_file_last_write_version, 1);
+    block->checksum_verified = true;
+    if(sky_data_file_is_deferred(block->data_file)) {
+        block->dirty = true;
+    }
+    else {
+        rc = sky_block_sync_range(block, offset, length);
+        check(rc == 0, "Unable to sync block");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Syncs the in-memory block back to disk.
+//
+// block - The block to sync.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_sync(sky_block *block)
+{
+    int rc;
+    check(block != NULL, "Block required");
+    check(block->data_file != NULL, "Data file required");
+
+    rc = sky_block_sync_range(block, 0, block->data_file->block_size);
+    check(rc == 0, "Unable to sync block");
+    block->dirty = false;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Syncs part of the in-memory block back to disk. The range is widened to
+// the pages that contain it.
+//
+// block  - The block to sync.
+// offset - The offset of the bytes to sync within the block.
+// length - The number of bytes to sync.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_sync_range(sky_block *block, size_t offset, size_t length)
+{
+    int rc;
+    check(block != NULL, "Block required");
+    check(offset + length <= block->data_file->block_size, "Sync range must be within the block");
+    if(length == 0) {
+        return 0;
+    }
 
-    // Retrieve the location of the block in memory.
+    // Retrieve the location of the range in memory.
     void *ptr = NULL;
-    rc = sky_block_get_ptr(block, &ptr);
+    rc = sky_block_get_raw_ptr(block, &ptr);
     check(rc == 0, "Unable to retrieve block data pointer");
+    ptr += offset;
     
     // Determine the page size.
     long page_size = sysconf(_SC_PAGE_SIZE);
     
     // Adjust the pointer to align to page size.
-    size_t offset = ptr - block->data_file->data;
-    if(offset % page_size != 0) {
-        ptr -= offset % page_size;
-    }
+    size_t block_offset;
+    rc = sky_block_get_offset(block, &block_offset);
+    check(rc == 0, "Unable to determine block offset");
+    size_t misalignment = (block_offset + offset) % page_size;
+    ptr -= misalignment;
+    length += misalignment;
     
-    // Adjust the block size to align to page size.
-    uint32_t block_size = block->data_file->block_size;
-    if(block_size % page_size != 0) {
-        block_size -= (block_size % page_size);
-        block_size += page_size;
+    // Adjust the length to align to page size.
+    if(length % page_size != 0) {
+        length -= (length % page_size);
+        length += page_size;
     }
     
-    // Sync the memory for the block.
-    rc = msync(ptr, block_size, MS_SYNC);
+    // Sync the memory for the range. Async tables only schedule the write.
+    int flags = (block->data_file->durability == SKY_DURABILITY_ASYNC ? MS_ASYNC : MS_SYNC);
+    int64_t t0 = sky_stats_now();
+    rc = msync(ptr, length, flags);
     check(rc == 0, "Unable to sync block to disk");
+    sky_stats_record(&sky_stats_global.syncs, sky_stats_now() - t0);
+
+    // The checksum covers the whole block so it is only recalculated when
+    // the data file is flushed instead of after every sync.
+    block->checksum_stale = true;
     
     return 0;
     
@@ -192,16 +358,125 @@ error:
 }
 
 
+//--------------------------------------
+// Replication
+//--------------------------------------
+
+// Calculates the number of bytes at the start of a block that need to be
+// copied to reproduce it. A compressed block is its header and compressed
+// data. Any other block ends at its last non-zero byte since the rest of a
+// block is always zeroed.
+//
+// block  - The block.
+// length - A pointer to where the length is returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_get_stored_length(sky_block *block, size_t *length)
+{
+    int rc;
+    bool compressed;
+    void *ptr = NULL;
+    check(block != NULL, "Block required");
+    check(length != NULL, "Length return pointer required");
+
+    rc = sky_block_get_raw_ptr(block, &ptr);
+    check(rc == 0, "Unable to retrieve raw block pointer");
+    rc = sky_block_is_compressed(block, &compressed);
+    check(rc == 0, "Unable to detect block compression");
+
+    if(compressed) {
+        uint32_t compressed_length = *((uint32_t*)(ptr + sizeof(sky_object_id_t) + (sizeof(uint32_t) * 2)));
+        *length = SKY_BLOCK_COMPRESSED_HEADER_SIZE + compressed_length;
+    }
+    else {
+        size_t n = block->data_file->block_size;
+        while(n > 0 && ((uint8_t*)ptr)[n-1] == 0) {
+            n--;
+        }
+        *length = n;
+    }
+
+    return 0;
+
+error:
+    if(length != NULL) *length = 0;
+    return -1;
+}
+
+// Overwrites a block with a copy of a block from another data file with the
+// same block size. Everything derived from the old contents of the block is
+// dropped. The block's position is not updated so the data file must be
+// normalized once all of its replaced blocks have been applied.
+//
+// block  - The block to overwrite.
+// header - The packed header entry of the block.
+// data   - The stored bytes of the block.
+// length - The number of stored bytes.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_replace(sky_block *block, void *header, void *data,
+                      size_t length)
+{
+    int rc;
+    size_t sz;
+    void *ptr = NULL;
+    check(block != NULL, "Block required");
+    check(header != NULL, "Header entry required");
+    check(data != NULL || length == 0, "Block data required");
+    check(length <= block->data_file->block_size, "Block data too long: %ld", (long)length);
+
+    // Record the block before it changes so its ranges can be recovered.
+    rc = sky_data_file_journal_block(block->data_file, block);
+    check(rc == 0, "Unable to journal block");
+
+    if(block->cache_entry != NULL) {
+        sky_block_cache_remove(block->data_file->block_cache, block);
+    }
+    rc = sky_block_get_raw_ptr(block, &ptr);
+    check(rc == 0, "Unable to retrieve raw block pointer");
+    if(length > 0) {
+        memcpy(ptr, data, length);
+    }
+    memset(ptr + length, 0, block->data_file->block_size - length);
+
+    rc = sky_block_unpack(block, header, &sz);
+    check(rc == 0, "Unable to unpack block header entry");
+
+    sky_block_column_free(block->column);
+    block->column = NULL;
+    block->bloom_valid = false;
+    block->zones_valid = false;
+    block->directory_valid = false;
+    block->compression = SKY_BLOCK_COMPRESSION_UNKNOWN;
+    block->spanned = false;
+
+    rc = sky_block_save(block);
+    check(rc == 0, "Unable to save replaced block");
+    if(sky_data_file_is_deferred(block->data_file)) {
+        block->header_dirty = true;
+    }
+    else {
+        rc = sky_block_write_header(block);
+        check(rc == 0, "Unable to write block header");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
 //--------------------------------------
 // Header Management
 //--------------------------------------
 
-// Updates the block object id and timestamp ranges and saves the changes to
-// the header file as required.
+// Saves the block's ranges to the header file. If the data file is deferring
+// changes then the header entry is only flagged as dirty and is written when
+// the data file is flushed. The block is also moved to its new sorted
+// position in the data file since its ranges have changed.
 //
-// block     - The block to update ranges for.
-// object_id - The object id being added to the block.
-// timestamp - The timestamp being added to the block.
+// block - The block to save the header entry for.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_block_save_header(sky_block *block)
@@ -209,15 +484,39 @@ int sky_block_save_header(sky_block *block)
     int rc;
     check(block != NULL, "Block required");
 
-    // Open header file.
-    int fd = open(bdata(block->data_file->header_path), O_WRONLY);
-    check(fd != 0, "Unable to open header file for block update");
-    FILE *file = fdopen(fd, "w");
-    check(file != NULL, "Unable to open header file stream for block update");
-    
+    rc = sky_data_file_sort_block(block->data_file, block);
+    check(rc == 0, "Unable to sort block");
+
+    block->write_version = __sync_add_and_fetch(&sky_data_file_last_write_version, 1);
+    if(sky_data_file_is_deferred(block->data_file)) {
+        block->header_dirty = true;
+    }
+    else {
+        rc = sky_block_write_header(block);
+        check(rc == 0, "Unable to write block header");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes the block's ranges to its entry in the header file using the data
+// file's open header file descriptor.
+//
+// block - The block to write the header entry for.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_write_header(sky_block *block)
+{
+    int rc;
+    check(block != NULL, "Block required");
+    check(block->data_file->header_fd > 0, "Header file is not open");
+
     // Write to buffer.
     size_t sz;
-    uint8_t *buffer[SKY_BLOCK_HEADER_SIZE];
+    uint8_t buffer[SKY_BLOCK_HEADER_SIZE];
     rc = sky_block_pack(block, buffer, &sz);
     check(rc == 0, "Unable to pack block header data");
     
@@ -225,24 +524,18 @@ int sky_block_save_header(sky_block *block)
     off_t offset;
     rc = sky_block_get_header_offset(block, &offset);
     check(rc == 0, "Unable to determine block offset in header file");
-    rc = fseek(file, offset, SEEK_SET);
-    check(rc == 0, "Unable to position file at block position: %lld", offset);
     
     // Write to file.
-    rc = fwrite(buffer, SKY_BLOCK_HEADER_SIZE, 1, file);
-    check(rc == 1, "Unable to write block to header file");
+    rc = pwrite(block->data_file->header_fd, buffer, SKY_BLOCK_HEADER_SIZE, offset);
+    check(rc == ((int)SKY_BLOCK_HEADER_SIZE), "Unable to write block to header file");
     
-    // Close header file.
-    fclose(file);
-    close(fd);
+    block->header_dirty = false;
 
     return 0;
 
 error:
-    if(file) fclose(file);
-    if(fd) close(fd);
     return -1;
-}    
+}
 
 // Updates the block object id and timestamp ranges and saves the changes to
 // the header file as required.
@@ -343,14 +636,8 @@ int sky_block_full_update(sky_block *block)
             
         // Loop over cursor until we reach the event insertion point.
         while(!cursor.eof) {
-            sky_timestamp_t timestamp;
-            sky_action_id_t action_id;
-            sky_event_data_length_t data_length;
-
             // Retrieve current timestamp in cursor.
-            size_t hdrsz;
-            rc = sky_event_unpack_hdr(&timestamp, &action_id, &data_length, cursor.ptr, &hdrsz);
-            check(rc == 0, "Unable to unpack event header");
+            sky_timestamp_t timestamp = cursor.timestamp;
                 
             // Update timestamp ranges.
             if(!event_initialized || timestamp < block->min_timestamp) {
@@ -375,6 +662,16 @@ int sky_block_full_update(sky_block *block)
     rc = sky_block_save_header(block);
     check(rc == 0, "Unable to save block header");
 
+    // Rebuild the action column since the paths in the block have changed.
+    rc = sky_block_update_column(block);
+    check(rc == 0, "Unable to update block column");
+
+    // Rebuild the bloom filter, zone map and directory the next time they
+    // are needed.
+    block->bloom_valid = false;
+    block->zones_valid = false;
+    block->directory_valid = false;
+
     return 0;
 
 error:
@@ -402,746 +699,2144 @@ error:
     return -1;
 }
 
+
 //--------------------------------------
-// Block Position
+// Checksums
 //--------------------------------------
 
-// Calculates the byte offset for the beginning on the block in the
-// data file based on the data file block size and the block index.
+// Calculates the checksum of the stored bytes of the block once it has been
+// synced. The checksum entry is flagged as dirty and is written when the
+// data file is flushed.
 //
-// block  - The block to calculate the byte offset of.
-// offset - A pointer to where the offset will be returned to.
+// block - The block to update the checksum of.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_block_get_offset(sky_block *block, size_t *offset)
+int sky_block_update_checksum(sky_block *block)
 {
+    int rc;
+    void *ptr = NULL;
     check(block != NULL, "Block required");
-    check(block->data_file != NULL, "Data file required");
-    check(block->data_file->block_size != 0, "Data file must have a nonzero block size");
 
-    *offset = (block->data_file->block_size * block->index);
+    size_t length;
+    rc = sky_block_get_stored_length(block, &length);
+    check(rc == 0, "Unable to determine stored block length");
+    rc = sky_block_get_raw_ptr(block, &ptr);
+    check(rc == 0, "Unable to retrieve raw block pointer");
+
+    block->checksum = sky_crc32c(0, ptr, length);
+    block->checksum_valid = true;
+    block->checksum_verified = true;
+    block->checksum_stale = false;
+    block->checksum_dirty = true;
+
     return 0;
 
 error:
-    *offset = 0;
     return -1;
 }
 
-// Calculates the pointer position for the beginning on the block in the
-// data file based on the data file block size and the block index.
+// Writes the block's checksum to its entry in the checksum file using the
+// data file's open checksum file descriptor.
 //
-// block - The block to calculate the byte offset of.
-// ptr   - A pointer to where the blocks starting address will be set.
+// block - The block to write the checksum entry for.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_block_get_ptr(sky_block *block, void **ptr)
+int sky_block_write_checksum(sky_block *block)
 {
+    int rc;
     check(block != NULL, "Block required");
-    check(block->data_file != NULL, "Data file required");
-    check(block->data_file->data != NULL, "Data file must be mapped");
+    check(block->data_file->checksum_fd > 0, "Checksum file is not open");
 
-    // Retrieve the offset.
-    size_t offset;
-    int rc = sky_block_get_offset(block, &offset);
-    check(rc == 0, "Unable to determine block offset");
+    uint8_t buffer[SKY_BLOCK_CHECKSUM_SIZE];
+    sky_block_pack_checksum(block, buffer);
+    off_t offset = ((off_t)block->index) * ((off_t)SKY_BLOCK_CHECKSUM_SIZE);
+    rc = pwrite(block->data_file->checksum_fd, buffer, SKY_BLOCK_CHECKSUM_SIZE, offset);
+    check(rc == ((int)SKY_BLOCK_CHECKSUM_SIZE), "Unable to write block to checksum file");
+
+    block->checksum_dirty = false;
 
-    // Calculate pointer based on data pointer.
-    *ptr = block->data_file->data + offset;
-    
     return 0;
 
 error:
-    *ptr = NULL;
     return -1;
 }
 
+// Packs the checksum entry of a block. A block without a checksum is packed
+// as zeros.
+//
+// block - The block.
+// ptr   - The pointer to write the entry to.
+void sky_block_pack_checksum(sky_block *block, void *ptr)
+{
+    uint32_t entry[2] = {0, 0};
+    if(block->checksum_valid) {
+        entry[0] = block->checksum;
+        entry[1] = SKY_BLOCK_CHECKSUM_MAGIC;
+    }
+    memcpy(ptr, entry, SKY_BLOCK_CHECKSUM_SIZE);
+}
+
+// Unpacks the checksum entry of a block that was just loaded. The block is
+// verified the first time its data is retrieved if the entry holds a saved
+// checksum.
+//
+// block - The block.
+// ptr   - The pointer to the entry.
+void sky_block_unpack_checksum(sky_block *block, void *ptr)
+{
+    uint32_t entry[2];
+    memcpy(entry, ptr, SKY_BLOCK_CHECKSUM_SIZE);
+    block->checksum_valid = (entry[1] == SKY_BLOCK_CHECKSUM_MAGIC);
+    block->checksum = (block->checksum_valid ? entry[0] : 0);
+    block->checksum_verified = !block->checksum_valid;
+    block->checksum_stale = false;
+}
+
+// Compares the stored bytes of a block with the checksum that was saved when
+// the block was last synced. Nothing is checked if the block has already
+// been verified or changed since the data file was loaded, or if it does not
+// have a saved checksum. A block that fails is not marked as verified so
+// every later access fails as well.
+//
+// block - The block to verify.
+//
+// Returns 0 if the block is intact, otherwise returns -1.
+int sky_block_verify_checksum(sky_block *block)
+{
+    int rc;
+    void *ptr = NULL;
+    check(block != NULL, "Block required");
+    if(block->checksum_verified || !block->checksum_valid) {
+        return 0;
+    }
+
+    size_t length;
+    rc = sky_block_get_stored_length(block, &length);
+    check(rc == 0, "Unable to determine stored block length");
+    rc = sky_block_get_raw_ptr(block, &ptr);
+    check(rc == 0, "Unable to retrieve raw block pointer");
+
+    uint32_t checksum = sky_crc32c(0, ptr, length);
+    check(checksum == block->checksum, "Block #%d failed checksum verification: %08x != %08x", block->index, checksum, block->checksum);
+    block->checksum_verified = true;
+
+    return 0;
+
+error:
+    return -1;
+}
 
 //--------------------------------------
-// Spanning
+// Block Position
 //--------------------------------------
 
-// Determines the number of blocks that this block's object spans. This
-// function only works on the starting block of a span of blocks.
+// Calculates the index of the extent that the block is stored in.
 //
-// block - The initial block in a block span.
-// count - A pointer to where the number of spanned blocks should be stored.
+// block        - The block to find the extent of.
+// extent_index - A pointer to where the extent index will be returned to.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_block_get_span_count(sky_block *block, uint32_t *count)
+int sky_block_get_extent_index(sky_block *block, uint32_t *extent_index)
 {
     check(block != NULL, "Block required");
     check(block->data_file != NULL, "Data file required");
-    check(count != NULL, "Span count address required");
-    
-    sky_data_file *data_file = block->data_file;
-    sky_block **blocks = data_file->blocks;
-
-    // If this block is not spanned then return 1.
-    if(!block->spanned) {
-        *count = 1;
-    }
-    // Otherwise calculate the span count.
-    else {
-        // Loop until the ending block of the span is found.
-        uint32_t index = block->index;
-        sky_object_id_t object_id = block->min_object_id;
-        while(true) {
-            index++;
-
-            // If we've reached the end of the blocks or if the object id no longer
-            // matches the starting object id then break out of the loop.
-            if(index > data_file->block_count-1 || object_id != blocks[index]->min_object_id)
-            {
-                break;
-            }
-        }
+    check(block->data_file->extent_block_count != 0, "Data file must have a nonzero extent size");
 
-        // Assign count back to caller's provided address.
-        *count = (index - block->index);
-    }
-    
+    *extent_index = block->index / block->data_file->extent_block_count;
     return 0;
 
 error:
-    *count = 0;
+    *extent_index = 0;
     return -1;
 }
 
-// Spans a path across multiple blocks.
-int sky_block_span_with_event(sky_block *block, sky_event *new_event,
-                              void *path_ptr, uint32_t target_size,
-                              sky_block **target_block)
+// Calculates the byte offset for the beginning on the block in its extent
+// file based on the data file block size and the block index.
+//
+// block  - The block to calculate the byte offset of.
+// offset - A pointer to where the offset will be returned to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_get_offset(sky_block *block, size_t *offset)
 {
-    int rc;
-    size_t _sz;
     check(block != NULL, "Block required");
-    check(new_event != NULL, "Event required");
-    check(path_ptr != NULL, "Path pointer required");
-    check(target_size > 0, "Target size must be greater than zero");
-    check(target_block > 0, "Target block pointer required");
-    
-    // Initialize events stats.
-    uint32_t event_count = 0;
-    sky_path_event_stat *events;
+    check(block->data_file != NULL, "Data file required");
+    check(block->data_file->block_size != 0, "Data file must have a nonzero block size");
+    check(block->data_file->extent_block_count != 0, "Data file must have a nonzero extent size");
+
+    *offset = ((size_t)block->data_file->block_size * (block->index % block->data_file->extent_block_count));
+    return 0;
+
+error:
+    *offset = 0;
+    return -1;
+}
+
+// Retrieves a pointer to the data of the block. For a compressed block this
+// is its decompressed data in the block cache, which stays valid until the
+// cache is released or the block is unpinned.
+//
+// block - The block.
+// ptr   - A pointer to where the block's data address will be set.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_get_ptr(sky_block *block, void **ptr)
+{
+    int rc;
+    check(block != NULL, "Block required");
+
+    rc = sky_block_get_raw_ptr(block, ptr);
+    check(rc == 0, "Unable to retrieve raw block pointer");
+
+    if(!block->checksum_verified) {
+        rc = sky_block_verify_checksum(block);
+        check(rc == 0, "Unable to verify block #%d", block->index);
+    }
+    if(block->compression == SKY_BLOCK_COMPRESSION_UNKNOWN) {
+        rc = sky_block_detect_compression(block);
+        check(rc == 0, "Unable to detect block compression");
+    }
+    if(block->compression == SKY_BLOCK_COMPRESSION_COMPRESSED) {
+        rc = sky_block_cache_get(block->data_file->block_cache, block, ptr);
+        check(rc == 0, "Unable to retrieve decompressed block");
+    }
+
+    return 0;
+
+error:
+    *ptr = NULL;
+    return -1;
+}
+
+// Calculates the pointer position for the beginning on the block in the
+// data file based on the data file block size and the block index. This is
+// where the block is stored, even if it is compressed.
+//
+// block - The block to calculate the byte offset of.
+// ptr   - A pointer to where the blocks starting address will be set.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_get_raw_ptr(sky_block *block, void **ptr)
+{
+    check(block != NULL, "Block required");
+    check(block->data_file != NULL, "Data file required");
+
+    // Retrieve the extent and the offset within it.
+    uint32_t extent_index;
+    int rc = sky_block_get_extent_index(block, &extent_index);
+    check(rc == 0, "Unable to determine block extent");
+    check(extent_index < block->data_file->extent_count && block->data_file->extents[extent_index].data != NULL, "Block extent must be mapped");
+    size_t offset;
+    rc = sky_block_get_offset(block, &offset);
+    check(rc == 0, "Unable to determine block offset");
+
+    // Calculate pointer based on the extent's data pointer.
+    *ptr = block->data_file->extents[extent_index].data + offset;
+    
+    return 0;
+
+error:
+    *ptr = NULL;
+    return -1;
+}
+
+
+//--------------------------------------
+// Compression
+//--------------------------------------
+
+// Determines whether the data of a block is stored compressed.
+//
+// block - The block.
+// ret   - A pointer to where the flag is returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_is_compressed(sky_block *block, bool *ret)
+{
+    int rc;
+    check(block != NULL, "Block required");
+    check(ret != NULL, "Return address required");
+
+    if(block->compression == SKY_BLOCK_COMPRESSION_UNKNOWN) {
+        rc = sky_block_detect_compression(block);
+        check(rc == 0, "Unable to detect block compression");
+    }
+    *ret = (block->compression == SKY_BLOCK_COMPRESSION_COMPRESSED);
+
+    return 0;
+
+error:
+    *ret = false;
+    return -1;
+}
+
+// Reads the start of a block to determine whether it is compressed.
+//
+// block - The block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_detect_compression(sky_block *block)
+{
+    int rc;
+    void *ptr = NULL;
+    rc = sky_block_get_raw_ptr(block, &ptr);
+    check(rc == 0, "Unable to retrieve raw block pointer");
+
+    bool compressed = (*((sky_object_id_t*)ptr) == 0 &&
+        *((uint32_t*)(ptr + sizeof(sky_object_id_t))) == SKY_BLOCK_COMPRESSED_MAGIC);
+    block->compression = (compressed ? SKY_BLOCK_COMPRESSION_COMPRESSED : SKY_BLOCK_COMPRESSION_NONE);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Calculates the number of bytes used by the paths in an uncompressed block.
+//
+// block  - The block.
+// length - A pointer to where the length is returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_get_data_length(sky_block *block, size_t *length)
+{
+    int rc;
+    sky_path_iterator iterator;
+    sky_path_iterator_init(&iterator);
+    rc = sky_path_iterator_set_block(&iterator, block);
+    check(rc == 0, "Unable to set path iterator block");
+
+    while(!iterator.eof) {
+        rc = sky_path_iterator_next(&iterator);
+        check(rc == 0, "Unable to move to next path");
+    }
+    *length = iterator.block_data_length;
+
+    return 0;
+
+error:
+    *length = 0;
+    return -1;
+}
+
+// Compresses the data of a block in place. The block is left as is if it is
+// spanned, empty, already compressed or if compressing it would not free up
+// at least one page. The part of the block after the compressed data is
+// released from the file where the file system supports it.
+//
+// block - The block.
+// ret   - A pointer to where a flag is returned stating if the block was
+//         compressed.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_compress(sky_block *block, bool *ret)
+{
+    int rc;
+    bool compressed;
+    void *buffer = NULL;
+    check(block != NULL, "Block required");
+    check(ret != NULL, "Return address required");
+    *ret = false;
+
+    rc = sky_block_is_compressed(block, &compressed);
+    check(rc == 0, "Unable to detect block compression");
+    if(compressed || block->spanned) {
+        return 0;
+    }
+
+    size_t data_length;
+    rc = sky_block_get_data_length(block, &data_length);
+    check(rc == 0, "Unable to determine block data length");
+    if(data_length == 0) {
+        return 0;
+    }
+
+    // Compress the data into a temporary buffer.
+    void *ptr = NULL;
+    rc = sky_block_get_raw_ptr(block, &ptr);
+    check(rc == 0, "Unable to retrieve raw block pointer");
+    size_t capacity = sky_compression_bound(data_length);
+    buffer = malloc(capacity); check_mem(buffer);
+    size_t compressed_length;
+    rc = sky_compression_compress(ptr, data_length, buffer, capacity, &compressed_length);
+    check(rc == 0, "Unable to compress block #%d", block->index);
+
+    // Only compress if it saves at least one page.
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t length = SKY_BLOCK_COMPRESSED_HEADER_SIZE + compressed_length;
+    if(length + page_size > data_length) {
+        free(buffer);
+        return 0;
+    }
+
+    // Write the header and the compressed data and clear the rest.
+    *((sky_object_id_t*)ptr) = 0;
+    *((uint32_t*)(ptr + sizeof(sky_object_id_t))) = SKY_BLOCK_COMPRESSED_MAGIC;
+    *((uint32_t*)(ptr + sizeof(sky_object_id_t) + sizeof(uint32_t))) = (uint32_t)data_length;
+    *((uint32_t*)(ptr + sizeof(sky_object_id_t) + (sizeof(uint32_t) * 2))) = (uint32_t)compressed_length;
+    memcpy(ptr + SKY_BLOCK_COMPRESSED_HEADER_SIZE, buffer, compressed_length);
+    memset(ptr + length, 0, data_length - length);
+    free(buffer);
+    buffer = NULL;
+
+    // Release the pages after the compressed data.
+#if FALLOCATE_AVAILABLE
+    size_t offset;
+    uint32_t extent_index;
+    rc = sky_block_get_offset(block, &offset);
+    check(rc == 0, "Unable to determine block offset");
+    rc = sky_block_get_extent_index(block, &extent_index);
+    check(rc == 0, "Unable to determine block extent");
+    size_t hole_start = (offset + length + page_size - 1) & ~(page_size-1);
+    size_t hole_end = offset + block->data_file->block_size;
+    if(hole_end > hole_start) {
+        fallocate(block->data_file->extents[extent_index].fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, hole_start, hole_end - hole_start);
+    }
+#endif
+
+    sky_block_column_free(block->column);
+    block->column = NULL;
+    block->compression = SKY_BLOCK_COMPRESSION_COMPRESSED;
+    rc = sky_block_save(block);
+    check(rc == 0, "Unable to save compressed block");
+    *ret = true;
+
+    return 0;
+
+error:
+    free(buffer);
+    return -1;
+}
+
+// Decompresses the data of a compressed block into a buffer. The buffer
+// must be the size of a block and the bytes after the data are zeroed.
+//
+// block - The compressed block.
+// dest  - The buffer to decompress into.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_inflate(sky_block *block, void *dest)
+{
+    int rc;
+    void *ptr = NULL;
+    check(block != NULL, "Block required");
+    check(dest != NULL, "Destination required");
+
+    rc = sky_block_get_raw_ptr(block, &ptr);
+    check(rc == 0, "Unable to retrieve raw block pointer");
+    size_t block_size = block->data_file->block_size;
+    uint32_t data_length = *((uint32_t*)(ptr + sizeof(sky_object_id_t) + sizeof(uint32_t)));
+    uint32_t compressed_length = *((uint32_t*)(ptr + sizeof(sky_object_id_t) + (sizeof(uint32_t) * 2)));
+    check(data_length <= block_size, "Invalid compressed block data length: %d", data_length);
+    check(SKY_BLOCK_COMPRESSED_HEADER_SIZE + compressed_length <= block_size, "Invalid compressed block length: %d", compressed_length);
+
+    rc = sky_compression_decompress(ptr + SKY_BLOCK_COMPRESSED_HEADER_SIZE, compressed_length, dest, data_length);
+    check(rc == 0, "Unable to decompress block data");
+    memset(dest + data_length, 0, block_size - data_length);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Decompresses a compressed block back into place so that it can be
+// changed. Nothing happens if the block is not compressed.
+//
+// block - The block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_decompress(sky_block *block)
+{
+    int rc;
+    bool compressed;
+    void *buffer = NULL;
+    check(block != NULL, "Block required");
+
+    rc = sky_block_is_compressed(block, &compressed);
+    check(rc == 0, "Unable to detect block compression");
+    if(!compressed) {
+        return 0;
+    }
+
+    void *ptr = NULL;
+    rc = sky_block_get_raw_ptr(block, &ptr);
+    check(rc == 0, "Unable to retrieve raw block pointer");
+    buffer = malloc(block->data_file->block_size); check_mem(buffer);
+    rc = sky_block_inflate(block, buffer);
+    check(rc == 0, "Unable to decompress block #%d", block->index);
+    memcpy(ptr, buffer, block->data_file->block_size);
+    free(buffer);
+    buffer = NULL;
+
+    sky_block_cache_remove(block->data_file->block_cache, block);
+    block->compression = SKY_BLOCK_COMPRESSION_NONE;
+    rc = sky_block_save(block);
+    check(rc == 0, "Unable to save decompressed block");
+
+    return 0;
+
+error:
+    free(buffer);
+    return -1;
+}
+
+// Pins the decompressed data of a compressed block in the block cache so
+// that it stays valid until the block is unpinned. Nothing happens if the
+// block is not compressed.
+//
+// block - The block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_pin(sky_block *block)
+{
+    int rc;
+    bool compressed;
+    check(block != NULL, "Block required");
+
+    rc = sky_block_is_compressed(block, &compressed);
+    check(rc == 0, "Unable to detect block compression");
+    if(compressed) {
+        rc = sky_block_cache_pin(block->data_file->block_cache, block);
+        check(rc == 0, "Unable to pin block");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Removes a pin added by `sky_block_pin()`.
+//
+// block - The block.
+void sky_block_unpin(sky_block *block)
+{
+    if(block != NULL && block->compression == SKY_BLOCK_COMPRESSION_COMPRESSED) {
+        sky_block_cache_unpin(block->data_file->block_cache, block);
+    }
+}
+
+
+//--------------------------------------
+// Spanning
+//--------------------------------------
+
+// Determines the number of blocks that this block's object spans. This
+// function only works on the starting block of a span of blocks. The count
+// is maintained by the data file as blocks are created and moved.
+//
+// block - The initial block in a block span.
+// count - A pointer to where the number of spanned blocks should be stored.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_get_span_count(sky_block *block, uint32_t *count)
+{
+    check(block != NULL, "Block required");
+    check(block->data_file != NULL, "Data file required");
+    check(count != NULL, "Span count address required");
+    
+    // If this block is not spanned then return 1.
+    if(!block->spanned) {
+        *count = 1;
+    }
+    // Otherwise use the count of blocks to the end of the span.
+    else {
+        check(block->span_count > 0, "Span count not set: #%d", block->index);
+        *count = block->span_count;
+    }
+    
+    return 0;
+
+error:
+    *count = 0;
+    return -1;
+}
+
+// Spans a path across multiple blocks. The events of the path are planned
+// into ranges first so that every new block can be created with a single
+// remap of the data file before any data is moved.
+//
+// block        - The block containing the path.
+// new_event    - The event that is being added to the path.
+// path_ptr     - A pointer to the path.
+// target_size  - The target size of each block.
+// tail_block   - A pointer to where an extra empty block should be returned
+//                for the paths after the span or NULL if it is not needed.
+// target_block - A pointer to where insertion block for the event will be.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_span_with_event(sky_block *block, sky_event *new_event,
+                              void *path_ptr, uint32_t target_size,
+                              sky_block **tail_block,
+                              sky_block **target_block)
+{
+    int rc;
+    size_t _sz;
+    uint32_t *range_ends = NULL;
+    sky_block **new_blocks = NULL;
+    check(block != NULL, "Block required");
+    check(new_event != NULL, "Event required");
+    check(path_ptr != NULL, "Path pointer required");
+    check(target_size > 0, "Target size must be greater than zero");
+    check(target_block != NULL, "Target block pointer required");
+    
+    // Initialize events stats.
+    uint32_t event_count = 0;
+    sky_path_event_stat *events = NULL;
+
+    // Retrieve block size.
+    sky_data_file *data_file = block->data_file;
+    uint32_t block_size = data_file->block_size;
+    
+    // Retrieve block pointer.
+    void *block_ptr = NULL;
+    rc = sky_block_get_ptr(block, &block_ptr);
+    check(rc == 0, "Unable to retrieve block pointer");
+
+    // Retrieve a list of event sizes in the current block (plus new event).
+    rc = sky_path_get_event_stats(path_ptr, new_event, &events, &event_count);
+    check(rc == 0, "Unable to calculate event stats on path");
+    
+    // Initialize the return value.
+    *target_block = block;
+
+    // Retrieve path info.
+    bool is_first_path_in_block = (path_ptr == block_ptr);
+    sky_object_id_t object_id = *((sky_object_id_t*)path_ptr);
+    off_t path_off = path_ptr - block_ptr;
+
+    // Plan the range of events that goes into each block. Each range is
+    // stored as the index of its last event. If the data file stores
+    // timestamp deltas then the first event of a range may have to store its
+    // full timestamp instead so room is kept for it.
+    uint32_t i;
+    uint32_t range_count = 0;
+    uint32_t last_index = 0;
+    size_t range_header_length = SKY_PATH_HEADER_LENGTH + (data_file->version >= SKY_DATA_FILE_DELTA_VERSION ? sizeof(sky_timestamp_t) : 0);
+    size_t sz = range_header_length;
+    range_ends = malloc(sizeof(*range_ends) * event_count); check_mem(range_ends);
+    for(i=0; i<event_count; i++) {
+        sky_path_event_stat *event = &(events[i]);
+        sky_path_event_stat *next_event = (i < event_count-1 ? &(events[i+1]) : NULL);
+
+        // If we exceed the block size then create a spanned block.
+        if(range_header_length + event->sz > block_size) {
+            sentinel("Event is too large for block");
+        }
+        
+        // Add the event size to the running total.
+        sz += event->sz;
+
+        // If we exceeded the target size or if there is remaining data
+        // in an already split block then end the range.
+        bool exceeds_target_size = (sz >= target_size);
+        bool is_last_event = (i == event_count-1 && last_index > 0);
+        bool next_event_exceeds_max = (next_event != NULL && sz + next_event->sz > block_size);
+        if(exceeds_target_size || is_last_event || next_event_exceeds_max) {
+            range_ends[range_count++] = i;
+            last_index = i+1;
+            sz = range_header_length;
+        }
+    }
+
+    // Create every new block at once. The first range of the first path of
+    // a block stays where it is.
+    uint32_t in_place_count = (is_first_path_in_block && range_count > 0 ? 1 : 0);
+    uint32_t new_block_count = (range_count - in_place_count) + (tail_block != NULL ? 1 : 0);
+    if(new_block_count > 0) {
+        new_blocks = malloc(sizeof(*new_blocks) * new_block_count); check_mem(new_blocks);
+        rc = sky_data_file_create_blocks(data_file, new_block_count, new_blocks);
+        check(rc == 0, "Unable to create new blocks");
+
+        // Restore pointers in case an extent was remapped.
+        rc = sky_block_get_ptr(block, &block_ptr);
+        check(rc == 0, "Unable to retrieve block pointer");
+        path_ptr = block_ptr + path_off;
+    }
+    if(tail_block != NULL) {
+        *tail_block = new_blocks[new_block_count-1];
+    }
+
+    // Move each range of events into its block.
+    uint32_t r;
+    last_index = 0;
+    for(r=0; r<range_count; r++) {
+        i = range_ends[r];
+        sky_path_event_stat *event = &(events[i]);
+        sky_path_event_stat *last_event = &(events[last_index]);
+
+        // Calculate lengths and positions of event range.
+        size_t start_pos = last_event->start_pos;
+        size_t end_pos   = event->end_pos;
+        size_t len = end_pos - start_pos;
+
+        // If this is the first span of the first path of a block then
+        // just leave the data where it is.
+        sky_block *new_block = NULL;
+        void *new_block_ptr = NULL;
+        if(r < in_place_count) {
+            new_block = block;
+            new_block_ptr = path_ptr;
+        }
+        // Otherwise move the data to a new block.
+        else {
+            new_block = new_blocks[r - in_place_count];
+            rc = sky_block_get_ptr(new_block, &new_block_ptr);
+            check(rc == 0, "Unable to retrieve new block's data pointer");
+
+            // Move data. The first event starts a new path segment so it is
+            // rewritten with its full timestamp.
+            if(len > 0) {
+                void *ptr = path_ptr + start_pos;
+                uint32_t first_index = (last_event->start_pos == last_event->end_pos ? last_index+1 : last_index);
+                size_t first_event_length = sky_event_sizeof_raw(ptr);
+                rc = sky_event_pack_raw(ptr, events[first_index].timestamp, new_block_ptr + SKY_PATH_HEADER_LENGTH, &_sz);
+                check(rc == 0, "Unable to move first event of range");
+                memmove(new_block_ptr + SKY_PATH_HEADER_LENGTH + _sz, ptr + first_event_length, len - first_event_length);
+                memset(ptr, 0, len);
+                len += _sz - first_event_length;
+            }
+        }
+
+        // Clear out original header.
+        if(last_index == 0) {
+            memset(path_ptr, 0, SKY_PATH_HEADER_LENGTH);
+        }
+
+        // If we are leaving an empty block then clear the path header.
+        if(len == 0) {
+            memset(new_block_ptr, 0, SKY_PATH_HEADER_LENGTH);
+        }
+        // Otherwise write the header.
+        else {
+            rc = sky_path_pack_hdr(object_id, len, new_block_ptr, &_sz);
+            check(rc == 0, "Unable to write path header");
+        }
+
+        // If new block contains the event timestamp in range then
+        // set it as the target block.
+        if(new_event->timestamp >= last_event->timestamp && event->timestamp <= new_event->timestamp) {
+            *target_block = new_block;
+        }
+        
+        // Flag block as spanned.
+        new_block->spanned = true;
+        
+        // Save where we left off.
+        last_index = i+1;
+    }
+
+    // Save every block that received a range and update its ranges. The
+    // original block is saved by the split.
+    for(r=0; r<range_count; r++) {
+        sky_block *range_block = (r < in_place_count ? block : new_blocks[r - in_place_count]);
+        rc = sky_block_save(range_block);
+        check(rc == 0, "Unable to save span block");
+        rc = sky_block_full_update(range_block);
+        check(rc == 0, "Unable to update block ranges");
+    }
+
+    // Update block range on the original block if a split occurred.
+    if(last_index > 0) {
+        rc = sky_block_full_update(block);
+        check(rc == 0, "Unable to update block ranges");
+    }
+    
+    free(new_blocks);
+    free(range_ends);
+    free(events);
+    return 0;
+
+error:
+    *target_block = NULL;
+    if(tail_block) *tail_block = NULL;
+    free(new_blocks);
+    free(range_ends);
+    free(events);
+    return -1;
+}
+
+
+//--------------------------------------
+// Path Stats
+//--------------------------------------
+
+// Generates an index of stats on all the paths in the block. If an event is
+// passed in then it also generates stats on the path the event would be
+// added to or a new path that would be created from that event.
+//
+// block      - The block to calculate stats on.
+// event      - A soon-to-be-added event to calculate into the paths. If null then
+//              the stats are calculated as they exist in the block.
+// paths      - A pointer to where the stats should be returned.
+// path_count - A pointer to where the number of paths should be returned.
+int sky_block_get_path_stats(sky_block *block, sky_event *event,
+                             sky_block_path_stat **paths,
+                             uint32_t *path_count)
+{
+    int rc;
+    check(block != NULL, "Block required");
+    check(paths != NULL, "Paths return address required");
+    check(path_count != NULL, "Path count return address required");
+
+    // Initialize data file & block pointers.
+    void *block_ptr = NULL;
+    rc = sky_block_get_ptr(block, &block_ptr);
+    check(rc == 0, "Unable to retrieve block pointer");
+    
+    // Initialize path iterator.
+    sky_path_iterator iterator;
+    sky_path_iterator_init(&iterator);
+    rc = sky_path_iterator_set_block(&iterator, block);
+    check(rc == 0, "Unable to set path iterator block");
+
+    // Calculate size of the event.
+    size_t event_length = (event != NULL ? sky_event_sizeof(event) : 0);
+
+    // Initialize return values.
+    *path_count = 0;
+    *paths = NULL;
+ 
+    // Loop over iterator to calculate sizes of the paths.
+    sky_object_id_t last_object_id = 0;
+    while(!iterator.eof) {
+        // Retrieve path pointer.
+        void *path_ptr = NULL;
+        rc = sky_path_iterator_get_ptr(&iterator, &path_ptr);
+        check(rc == 0, "Unable to retrieve iterator's current pointer");
+
+        // Check if event is a new path inserted between the last path and
+        // this current path.
+        if(event != NULL && event->object_id > last_object_id && event->object_id < iterator.current_object_id) {
+            // Increment paths array.
+            (*path_count)++;
+            *paths = realloc(*paths, sizeof(sky_block_path_stat) * (*path_count));
+            sky_block_path_stat *stat = &((*paths)[(*path_count)-1]);
+            stat->object_id = event->object_id;
+            stat->start_pos = stat->end_pos = (path_ptr - block_ptr);
+            stat->sz = SKY_PATH_HEADER_LENGTH + event_length;
+        }
+        
+        // Calculate current path stats.
+        size_t path_length = sky_path_sizeof_raw(path_ptr);
+        (*path_count)++;
+        *paths = realloc(*paths, sizeof(sky_block_path_stat) * (*path_count));
+        sky_block_path_stat *stat = &((*paths)[(*path_count)-1]);
+        stat->object_id = iterator.current_object_id;
+        stat->start_pos = path_ptr - block_ptr;
+        stat->end_pos = stat->start_pos + path_length;
+        stat->sz = path_length;
+    
+        // Add insertion event length if this is the matching path.
+        if(event != NULL && event->object_id == iterator.current_object_id) {
+            stat->sz += event_length;
+        }
+
+        // Save off this object id.
+        last_object_id = iterator.current_object_id;
+    
+        // Move to next path.
+        rc = sky_path_iterator_next(&iterator);
+        check(rc == 0, "Unable to move to next path");
+    }
+
+    // Check if event is a new path inserted at the end.
+    if(event != NULL && event->object_id > last_object_id) {
+        (*path_count)++;
+        *paths = realloc(*paths, sizeof(sky_block_path_stat) * (*path_count));
+        sky_block_path_stat *stat = &((*paths)[(*path_count)-1]);
+        stat->object_id = event->object_id;
+        stat->start_pos = stat->end_pos = iterator.block_data_length;
+        stat->sz = SKY_PATH_HEADER_LENGTH + event_length;
+    }
+    
+    return 0;
+
+error:
+    free(*paths);
+    *paths = NULL;
+    *path_count = 0;
+    return -1;
+}
+
+
+
+//--------------------------------------
+// Event Management
+//--------------------------------------
+
+// Adds an event to the block. If the size of the block exceeds the block size
+// then a new empty block is allocated and half the paths in the block are
+// moved to the new block.
+//
+// block - The block to add the event to.
+// event - The event to add to the block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_add_event(sky_block *block, sky_event *event)
+{
+    int rc;
+    check(block != NULL, "Block required");
+    check(event != NULL, "Event required");
+    check(block->data_file != NULL, "Block data file required");
+    check(block->data_file->block_size > 0, "Block data file must have a nonzero block size");
+
+    // Record the block before it changes so its ranges can be recovered.
+    rc = sky_data_file_journal_block(block->data_file, block);
+    check(rc == 0, "Unable to journal block");
+
+    // Compressed blocks are changed in place so decompress it first.
+    rc = sky_block_decompress(block);
+    check(rc == 0, "Unable to decompress block");
+
+    // Store the block pointer.
+    void *block_ptr;
+    rc = sky_block_get_ptr(block, &block_ptr);
+    check(rc == 0, "Unable to retrieve block pointer");
+
+    // Retrieve insertion points and block info.
+    void *path_ptr, *event_ptr;
+    sky_timestamp_t previous_timestamp;
+    size_t block_data_length;
+    rc = sky_block_get_insertion_info(block, event, &path_ptr, &event_ptr, &previous_timestamp, &block_data_length);
+    check(rc == 0, "Unable to determine insertion info to add event");
+
+    // Determine size. The timestamp is stored as a delta if there is an
+    // event before it in the path and the data file format supports deltas.
+    bool path_exists = (event_ptr != NULL);
+    bool is_delta = (path_exists && event_ptr > path_ptr + SKY_PATH_HEADER_LENGTH && block->data_file->version >= SKY_DATA_FILE_DELTA_VERSION);
+    size_t event_length = (is_delta ? sky_event_sizeof_delta(event, previous_timestamp) : sky_event_sizeof(event));
+    size_t sz = event_length + (!path_exists ? SKY_PATH_HEADER_LENGTH : 0);
+    
+    // If adding the event will cause a split then go ahead and split and
+    // recall this function.
+    if(block_data_length + sz > block->data_file->block_size) {
+        sky_block *target_block;
+        rc = sky_block_split_with_event(block, event, &target_block);
+        check(rc == 0, "Unable to split block");
+        sky_stats_add(block_splits, 1);
+        
+        // Attempt to add the event again now.
+        rc = sky_block_add_event(target_block, event);
+        check(rc == 0, "Unable to add event into target block");
+        
+        // Exit here since the event was added in the previous add_event
+        // invocation.
+        return 0;
+    }
+
+    // If we reached EOF and found no path insertion point then move the
+    // pointer to the end of the last path.
+    if(path_ptr == NULL) {
+        path_ptr = block_ptr + block_data_length;
+    }
+
+    // Find the event after the insertion point and its timestamp before the
+    // data is moved.
+    void *next_event_ptr = NULL;
+    sky_timestamp_t next_timestamp = 0;
+    if(path_exists && event_ptr < path_ptr + sky_path_sizeof_raw(path_ptr)) {
+        next_event_ptr = event_ptr + sz;
+        next_timestamp = sky_event_get_timestamp(event_ptr, previous_timestamp);
+    }
+
+    // Shift data down in the block so we have enough room.
+    size_t insert_length = sz;
+    void *ptr = (path_exists ? event_ptr : path_ptr);
+    memmove(ptr+sz, ptr, block_data_length-(ptr-block_ptr));
+    
+    // Pack the path first if it is missing.
+    if(!path_exists) {
+        rc = sky_path_pack_hdr(event->object_id, event_length, ptr, &sz);
+        check(rc == 0, "Unable to pack path header");
+        
+        // Point event pointer at the beginning of the path event data.
+        event_ptr = path_ptr + SKY_PATH_HEADER_LENGTH;
+    }
+    // Or update the path event length if a path exists.
+    else {
+        *(sky_path_event_data_length_t*)(path_ptr+sizeof(sky_object_id_t)) += event_length;
+    }
+    
+    // Pack event.
+    size_t event_sz;
+    if(is_delta) {
+        rc = sky_event_pack_delta(event, previous_timestamp, event_ptr, &event_sz);
+    }
+    else {
+        rc = sky_event_pack(event, event_ptr, &event_sz);
+    }
+    check(rc == 0, "Unable to pack event");
+
+    // The next event now follows the new event so its delta is rewritten.
+    // The new delta is never larger than the old one.
+    if(next_event_ptr != NULL) {
+        rc = sky_event_set_timestamp(next_event_ptr, next_timestamp, event->timestamp);
+        check(rc == 0, "Unable to update next event timestamp");
+    }
+
+    // Move the paths after the insertion point in the directory.
+    rc = sky_block_update_directory(block, event, path_exists, (size_t)(path_ptr - block_ptr), insert_length);
+    check(rc == 0, "Unable to update block directory");
+    
+    // Save the bytes from the insertion point to the end of the data. An
+    // event added after the last path only touches the block's free tail.
+    rc = sky_block_save_range(block, (size_t)(ptr - block_ptr), block_data_length + insert_length - (size_t)(ptr - block_ptr));
+    check(rc == 0, "Unable to save block");
+    
+    // Update header.
+    rc = sky_block_update(block, event->object_id, event->timestamp);
+    check(rc == 0, "Unable to write block to header");
+    
+    // Update the action column. Events added at the end of the block's data
+    // are appended to it instead of rebuilding it.
+    if(block->column != NULL && ptr == block_ptr + block_data_length) {
+        rc = sky_block_column_append_event(block->column, event->object_id, event->action_id, event->timestamp);
+        check(rc == 0, "Unable to append to block column");
+    }
+    else {
+        rc = sky_block_update_column(block);
+        check(rc == 0, "Unable to update block column");
+    }
+
+    // Add the object to the bloom filter.
+    if(block->bloom_valid) {
+        sky_block_add_bloom(block, event->object_id);
+    }
+
+    // Extend the zone map with the event's values.
+    if(block->zones_valid) {
+        rc = sky_block_add_event_to_zones(block, event);
+        check(rc == 0, "Unable to update block zone map");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Calculates the information needed to perform an insertion of an event into
+// a block. The path pointer points to where the path is or should be inserted
+// into. The event pointer points to where the event should be inserted into.
+// If the event pointer is NULL then a path was not found. The previous
+// timestamp is the timestamp of the event before the insertion point if
+// there is one. Finally, the block data length is how many bytes in the block
+// are actually used to store data (and are not empty).
+//
+// The path is found with a binary search of the block's directory. Only the
+// path itself is walked to place the event and not even that if the event is
+// newer than every event in the path.
+//
+// block     - The block to add the event to.
+// event     - The event to add to the block.
+// path_ptr  - A pointer to where the path pointer should be returned to.
+// event_ptr - A pointer to where the event pointer should be returned to.
+// previous_timestamp - A pointer to where the timestamp of the event before
+//                      the insertion point should be returned to.
+// block_data_length  - A pointer to where the length of the block's data
+//                      should be returned to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_get_insertion_info(sky_block *block, sky_event *event,
+                                 void **path_ptr, void **event_ptr,
+                                 sky_timestamp_t *previous_timestamp,
+                                 size_t *block_data_length)
+{
+    int rc;
+    check(block != NULL, "Block required");
+    check(event != NULL, "Event required");
+    *previous_timestamp = 0;
+
+    // Initialize path and event pointers.
+    *path_ptr  = NULL;
+    *event_ptr = NULL;
+
+    void *block_ptr = NULL;
+    rc = sky_block_get_ptr(block, &block_ptr);
+    check(rc == 0, "Unable to retrieve block pointer");
+
+    if(!block->directory_valid) {
+        rc = sky_block_build_directory(block);
+        check(rc == 0, "Unable to build block directory");
+    }
+
+    // Find the object's path or the first path after it, which is where the
+    // object's path would be inserted.
+    uint32_t index = sky_block_search_directory(block, event->object_id);
+    if(index < block->directory_count) {
+        sky_block_directory_entry *entry = &block->directory[index];
+        *path_ptr = block_ptr + entry->offset;
+
+        // Events after the last event of the path are appended to it.
+        if(entry->object_id == event->object_id && event->timestamp > entry->max_timestamp) {
+            *event_ptr = (*path_ptr) + sky_path_sizeof_raw(*path_ptr);
+            *previous_timestamp = entry->max_timestamp;
+        }
+        // Otherwise use a cursor to find the event insertion point.
+        else if(entry->object_id == event->object_id) {
+            sky_cursor cursor;
+            sky_cursor_init(&cursor);
+            sky_cursor_set_path(&cursor, *path_ptr);
+
+            // The block's events were checked against its checksum when the
+            // block pointer was retrieved.
+            cursor.verified = block->checksum_valid;
+
+            // Loop over cursor until we reach the event insertion point.
+            while(!cursor.eof) {
+                // Retrieve event insertion pointer once the timestamp is
+                // reached.
+                if(cursor.timestamp >= event->timestamp) {
+                    *event_ptr = cursor.ptr;
+                    break;
+                }
+                *previous_timestamp = cursor.timestamp;
+
+                // Move to next event.
+                rc = sky_cursor_next(&cursor);
+                check(rc == 0, "Unable to move to next event");
+            }
+
+            // If no insertion point was found then append the event to the
+            // end of the path.
+            if(*event_ptr == NULL) {
+                *event_ptr = (*path_ptr) + sky_path_sizeof_raw(*path_ptr);
+            }
+        }
+    }
+
+    *block_data_length = block->directory_data_length;
+
+    return 0;
+
+error:
+    *path_ptr  = NULL;
+    *event_ptr = NULL;
+    *previous_timestamp = 0;
+    *block_data_length = 0;
+    return -1;
+}
+
+// Iterates over a block and splits it into smaller blocks. The block attempts
+// to create blocks which are half the maximum size although this is not
+// always possible because of path sizes.
+//
+// This function also creates spanned blocks when a single path is too large
+// for a single block. If an event is added that will exceed the block size
+// then the function will fail.
+//
+// block        - The block to add the event to.
+// event        - The event to add to the block.
+// target_block - A pointer to where insertion block for the event will be.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_split_with_event(sky_block *block, sky_event *event,
+                               sky_block **target_block)
+{
+    int rc;
+    uint32_t i;
+    uint32_t *range_ends = NULL;
+    sky_block **new_blocks = NULL;
+    check(block != NULL, "Block required");
+    check(event != NULL, "Event required");
+    check(block->data_file != NULL, "Block data file required");
+    check(block->data_file->block_size > 0, "Block data file must have a nonzero block size");
+
+    // Initialize path stats.
+    uint32_t path_count = 0;
+    sky_block_path_stat *paths = NULL;
+
+    // Calculate target block size.
+    sky_data_file *data_file = block->data_file;
+    uint32_t block_size = data_file->block_size;
+    uint32_t target_size = (block_size / 2);
+
+    // Retrieve a list of path sizes in the current block (plus new event).
+    rc = sky_block_get_path_stats(block, event, &paths, &path_count);
+    check(rc == 0, "Unable to calculate path stats on block");
+    
+    // Initialize the return value.
+    *target_block = block;
+    
+    // If a span is occurring then treat it as a special case.
+    bool is_spanning = false;
+    for(i=0; i<path_count; i++) {
+        sky_block_path_stat *path = &(paths[i]);
+
+        // If this path will exceed the block size then create a span.
+        if(path->sz > block_size) {
+            // Retrieve the block pointer.
+            void *block_ptr = NULL;
+            rc = sky_block_get_ptr(block, &block_ptr);
+            check(rc == 0, "Unable to retrieve source block pointer");
+            
+            // Span the path across multiple blocks and set the target block.
+            // A block for the remaining paths is created along with the
+            // span blocks so the data file is only remapped once.
+            bool has_tail = (i < path_count-1);
+            sky_block *tail_block = NULL;
+            rc = sky_block_span_with_event(block, event, block_ptr + path->start_pos, target_size, (has_tail ? &tail_block : NULL), target_block);
+            check(rc == 0, "Unable to create span");
+            sky_stats_add(block_spans, 1);
+            
+            // Move remaining paths to new block.
+            if(has_tail) {
+                // Retrieve the new block's pointer.
+                void *new_block_ptr = NULL;
+                rc = sky_block_get_ptr(tail_block, &new_block_ptr);
+                check(rc == 0, "Unable to retrieve new block's data pointer");
+
+                // Retrieve the original block's pointer
+                void *block_ptr = NULL;
+                rc = sky_block_get_ptr(block, &block_ptr);
+                check(rc == 0, "Unable to retrieve source block pointer");
+
+                // Calculate offsets.
+                size_t start_pos = paths[i+1].start_pos;
+                size_t end_pos   = paths[path_count-1].end_pos;
+                void *ptr = block_ptr + start_pos;
+                size_t len = end_pos - start_pos;
+
+                // Move data into new block.
+                memmove(new_block_ptr, ptr, len);
+                memset(ptr, 0, len);
+
+                // Save the new block and update its ranges.
+                rc = sky_block_save(tail_block);
+                check(rc == 0, "Unable to save new block");
+                rc = sky_block_full_update(tail_block);
+                check(rc == 0, "Unable to update block ranges");
+            }
+            
+            // Set a flag stating that a span has occurred.
+            is_spanning = true;
+            break;
+        }
+    }
+    
+    // Distribute paths across blocks if a span did not occur.
+    if(!is_spanning) {
+        // Plan the range of paths that goes into each block. Each range is
+        // stored as the index of its last path.
+        range_ends = malloc(sizeof(*range_ends) * path_count); check_mem(range_ends);
+        uint32_t range_count = 0;
+        uint32_t last_index = 0;
+        size_t sz = 0;
+        for(i=0; i<path_count; i++) {
+            sky_block_path_stat *path = &(paths[i]);
+            sky_block_path_stat *next_path = (i < path_count-1 ? &(paths[i+1]) : NULL);
+
+            // Add the path size to the running total.
+            sz += path->sz;
+
+            // If we exceeded the target size or if there is remaining data
+            // in an already split block then end the range.
+            bool exceeds_target_size = (sz >= target_size);
+            bool is_last_path = (i == path_count-1 && last_index > 0);
+            bool next_path_exceeds_max = (next_path != NULL && sz + next_path->sz > block_size);
+            if(exceeds_target_size || is_last_path || next_path_exceeds_max) {
+                range_ends[range_count++] = i;
+                last_index = i+1;
+                sz = 0;
+            }
+        }
+
+        // The first range stays in the original block. Every other range
+        // gets a new block and they are all created with a single remap.
+        uint32_t r;
+        if(range_count > 1) {
+            new_blocks = malloc(sizeof(*new_blocks) * (range_count-1)); check_mem(new_blocks);
+            rc = sky_data_file_create_blocks(data_file, range_count-1, new_blocks);
+            check(rc == 0, "Unable to create new blocks");
+
+            // Retrieve the original block's pointer
+            void *block_ptr = NULL;
+            rc = sky_block_get_ptr(block, &block_ptr);
+            check(rc == 0, "Unable to retrieve source block pointer");
+
+            // Move each range into its new block.
+            for(r=1; r<range_count; r++) {
+                sky_block *new_block = new_blocks[r-1];
+                sky_block_path_stat *last_path = &(paths[range_ends[r-1]+1]);
+                sky_block_path_stat *path = &(paths[range_ends[r]]);
+
+                // Retrieve the new block's pointer.
+                void *new_block_ptr = NULL;
+                rc = sky_block_get_ptr(new_block, &new_block_ptr);
+                check(rc == 0, "Unable to retrieve new block's data pointer");
+
+                // Calculate offsets.
+                size_t start_pos = last_path->start_pos;
+                size_t end_pos   = path->end_pos;
+                void *ptr = block_ptr + start_pos;
+                size_t len = end_pos - start_pos;
+
+                // Move data into new block.
+                memmove(new_block_ptr, ptr, len);
+                memset(ptr, 0, len);
+
+                // If new block contains the event object id in range then
+                // set it as the target block.
+                if(event->object_id >= last_path->object_id && event->object_id <= path->object_id) {
+                    *target_block = new_block;
+                }
+            }
+
+            // Save the new blocks and update their ranges.
+            for(r=1; r<range_count; r++) {
+                rc = sky_block_save(new_blocks[r-1]);
+                check(rc == 0, "Unable to save new block");
+                rc = sky_block_full_update(new_blocks[r-1]);
+                check(rc == 0, "Unable to update block ranges");
+            }
+        }
+    }
+    
+    // Save what is left of the original block so that its checksum covers
+    // the data that was moved out of it, and update its ranges.
+    rc = sky_block_save(block);
+    check(rc == 0, "Unable to save block");
+    rc = sky_block_full_update(block);
+    check(rc == 0, "Unable to update block ranges");
+
+    free(new_blocks);
+    free(range_ends);
+    free(paths);
+    return 0;
+
+error:
+    free(new_blocks);
+    free(range_ends);
+    free(paths);
+    return -1;
+}
+
+// Removes the path of an object from the block. The paths after it are moved
+// up to fill the space that it used.
+//
+// block     - The block.
+// object_id - The object id of the path to remove.
+// removed   - A pointer to where a flag is returned stating if the block had
+//             a path for the object. This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_remove_path(sky_block *block, sky_object_id_t object_id,
+                          bool *removed)
+{
+    int rc;
+    check(block != NULL, "Block required");
+    if(removed != NULL) *removed = false;
+
+    // Record the block before it changes so its ranges can be recovered.
+    rc = sky_data_file_journal_block(block->data_file, block);
+    check(rc == 0, "Unable to journal block");
+
+    // Compressed blocks are changed in place so decompress it first.
+    rc = sky_block_decompress(block);
+    check(rc == 0, "Unable to decompress block");
+
+    void *path_ptr = NULL;
+    rc = sky_block_find_path(block, object_id, &path_ptr);
+    check(rc == 0, "Unable to find path in block");
+    if(path_ptr == NULL) {
+        return 0;
+    }
+
+    void *block_ptr = NULL;
+    size_t block_data_length;
+    rc = sky_block_get_ptr(block, &block_ptr);
+    check(rc == 0, "Unable to retrieve block pointer");
+    rc = sky_block_get_data_length(block, &block_data_length);
+    check(rc == 0, "Unable to determine block data length");
+
+    // An empty block no longer belongs to a span.
+    size_t path_length = sky_path_sizeof_raw(path_ptr);
+    sky_block_remove_range(block_ptr, block_data_length, path_ptr, path_length);
+    if(block_data_length == path_length) {
+        block->spanned = false;
+    }
+
+    rc = sky_block_save(block);
+    check(rc == 0, "Unable to save block");
+    rc = sky_block_full_update(block);
+    check(rc == 0, "Unable to update block ranges");
+
+    if(removed != NULL) *removed = true;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Removes the events of an object at a given timestamp from the block. The
+// event after each removed event is rewritten against the timestamp of the
+// event before it, or with its full timestamp if it becomes the first event
+// of the path. The removed events never take up less space than the longer
+// timestamp of the next event so the block only ever shrinks. The path is
+// removed once its last event is gone.
+//
+// block     - The block.
+// object_id - The object id of the path.
+// timestamp - The timestamp of the events to remove.
+// count     - A pointer to where the number of removed events is returned.
+//             This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_remove_events(sky_block *block, sky_object_id_t object_id,
+                            sky_timestamp_t timestamp, uint32_t *count)
+{
+    int rc;
+    uint32_t removed_count = 0;
+    check(block != NULL, "Block required");
+    if(count != NULL) *count = 0;
+
+    // Record the block before it changes so its ranges can be recovered.
+    rc = sky_data_file_journal_block(block->data_file, block);
+    check(rc == 0, "Unable to journal block");
+
+    // Compressed blocks are changed in place so decompress it first.
+    rc = sky_block_decompress(block);
+    check(rc == 0, "Unable to decompress block");
+
+    void *path_ptr = NULL;
+    rc = sky_block_find_path(block, object_id, &path_ptr);
+    check(rc == 0, "Unable to find path in block");
+    if(path_ptr == NULL) {
+        return 0;
+    }
+
+    void *block_ptr = NULL;
+    size_t block_data_length;
+    rc = sky_block_get_ptr(block, &block_ptr);
+    check(rc == 0, "Unable to retrieve block pointer");
+    rc = sky_block_get_data_length(block, &block_data_length);
+    check(rc == 0, "Unable to determine block data length");
+
+    sky_path_event_data_length_t *event_data_length = (sky_path_event_data_length_t*)(path_ptr + sizeof(sky_object_id_t));
+    void *start_ptr = path_ptr + SKY_PATH_HEADER_LENGTH;
+    void *ptr = start_ptr;
+    sky_timestamp_t previous_timestamp = 0;
+    while(ptr < start_ptr + *event_data_length) {
+        sky_timestamp_t event_timestamp = sky_event_get_timestamp(ptr, previous_timestamp);
+        size_t event_length = sky_event_sizeof_raw(ptr);
+        if(event_timestamp > timestamp) {
+            break;
+        }
+        else if(event_timestamp < timestamp) {
+            previous_timestamp = event_timestamp;
+            ptr += event_length;
+            continue;
+        }
+
+        // Rewrite the next event in place of the removed event and then
+        // close the gap after it.
+        void *next_ptr = ptr + event_length;
+        size_t length = event_length;
+        if(next_ptr < start_ptr + *event_data_length) {
+            sky_timestamp_t next_timestamp = sky_event_get_timestamp(next_ptr, event_timestamp);
+            size_t next_length = sky_event_sizeof_raw(next_ptr);
+            size_t sz;
+            if(ptr == start_ptr) {
+                rc = sky_event_pack_raw(next_ptr, next_timestamp, ptr, &sz);
+            }
+            else {
+                rc = sky_event_pack_raw_delta(next_ptr, next_timestamp, previous_timestamp, ptr, &sz);
+            }
+            check(rc == 0, "Unable to rewrite next event");
+            check(sz <= event_length + next_length, "Rewritten event does not fit");
+
+            sky_block_remove_range(block_ptr, block_data_length, ptr + sz, (event_length + next_length) - sz);
+            length = (event_length + next_length) - sz;
+        }
+        else {
+            sky_block_remove_range(block_ptr, block_data_length, ptr, length);
+        }
+        block_data_length -= length;
+        *event_data_length -= length;
+        removed_count++;
+    }
+
+    if(removed_count == 0) {
+        return 0;
+    }
+
+    // Remove the path once it has no events left.
+    if(*event_data_length == 0) {
+        sky_block_remove_range(block_ptr, block_data_length, path_ptr, SKY_PATH_HEADER_LENGTH);
+        block_data_length -= SKY_PATH_HEADER_LENGTH;
+    }
+    // An empty block no longer belongs to a span.
+    if(block_data_length == 0) {
+        block->spanned = false;
+    }
+
+    rc = sky_block_save(block);
+    check(rc == 0, "Unable to save block");
+    rc = sky_block_full_update(block);
+    check(rc == 0, "Unable to update block ranges");
+
+    if(count != NULL) *count = removed_count;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Drops every path in the block. The data is zeroed and the whole pages of
+// the block are released from the file where the file system supports it.
+// The empty block is reclaimed by compaction.
+//
+// block - The block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_clear(sky_block *block)
+{
+    int rc;
+    check(block != NULL, "Block required");
+
+    // Record the block before it changes so its ranges can be recovered.
+    rc = sky_data_file_journal_block(block->data_file, block);
+    check(rc == 0, "Unable to journal block");
+
+    // Compressed data is dropped as is so it does not need to be inflated.
+    bool compressed;
+    rc = sky_block_is_compressed(block, &compressed);
+    check(rc == 0, "Unable to detect block compression");
+    if(compressed) {
+        sky_block_cache_remove(block->data_file->block_cache, block);
+    }
+
+    void *ptr = NULL;
+    rc = sky_block_get_raw_ptr(block, &ptr);
+    check(rc == 0, "Unable to retrieve raw block pointer");
+    memset(ptr, 0, block->data_file->block_size);
+
+#if FALLOCATE_AVAILABLE
+    size_t offset;
+    uint32_t extent_index;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    rc = sky_block_get_offset(block, &offset);
+    check(rc == 0, "Unable to determine block offset");
+    rc = sky_block_get_extent_index(block, &extent_index);
+    check(rc == 0, "Unable to determine block extent");
+    size_t hole_start = (offset + page_size - 1) & ~(page_size-1);
+    size_t hole_end = (offset + block->data_file->block_size) & ~(page_size-1);
+    if(hole_end > hole_start) {
+        fallocate(block->data_file->extents[extent_index].fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, hole_start, hole_end - hole_start);
+    }
+#endif
+
+    block->compression = SKY_BLOCK_COMPRESSION_NONE;
+    block->spanned = false;
+    rc = sky_block_save(block);
+    check(rc == 0, "Unable to save block");
+    rc = sky_block_full_update(block);
+    check(rc == 0, "Unable to update block ranges");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Removes a range of bytes from the data of a block. The data after the
+// range is moved up and the space freed at the end is zeroed so that it
+// reads as empty.
+//
+// block_ptr         - A pointer to the block data.
+// block_data_length - The number of bytes used in the block.
+// ptr               - A pointer to the start of the range.
+// length            - The number of bytes to remove.
+void sky_block_remove_range(void *block_ptr, size_t block_data_length,
+                            void *ptr, size_t length)
+{
+    void *end_ptr = block_ptr + block_data_length;
+    memmove(ptr, ptr + length, end_ptr - (ptr + length));
+    memset(end_ptr - length, 0, length);
+}
+
+
+//--------------------------------------
+// Column Management
+//--------------------------------------
+
+// Retrieves the action column of the block. The column is built from the
+// block's data the first time it is requested.
+//
+// block  - The block.
+// column - A pointer to where the column should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_get_column(sky_block *block, sky_block_column **column)
+{
+    int rc;
+    check(block != NULL, "Block required");
+    check(column != NULL, "Column return pointer required");
+
+    if(block->column == NULL) {
+        block->column = sky_block_column_create();
+        check_mem(block->column);
+        rc = sky_block_column_build(block->column, block);
+        check(rc == 0, "Unable to build block column");
+    }
+
+    *column = block->column;
+    return 0;
+
+error:
+    if(block) {
+        sky_block_column_free(block->column);
+        block->column = NULL;
+    }
+    if(column) *column = NULL;
+    return -1;
+}
+
+// Rebuilds the action column of the block after its data has changed. Blocks
+// that have not built a column yet are left without one.
+//
+// block - The block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_update_column(sky_block *block)
+{
+    int rc;
+    check(block != NULL, "Block required");
 
-    // Retrieve block size.
-    sky_data_file *data_file = block->data_file;
-    uint32_t block_size = data_file->block_size;
-    
-    // Retrieve block pointer.
-    void *block_ptr = NULL;
-    rc = sky_block_get_ptr(block, &block_ptr);
-    check(rc == 0, "Unable to retrieve block pointer");
+    if(block->column != NULL) {
+        rc = sky_block_column_build(block->column, block);
+        check(rc == 0, "Unable to rebuild block column");
+    }
 
-    // Retrieve a list of event sizes in the current block (plus new event).
-    rc = sky_path_get_event_stats(path_ptr, new_event, &events, &event_count);
-    check(rc == 0, "Unable to calculate event stats on path");
-    
-    // Initialize the return value.
-    *target_block = block;
+    return 0;
 
-    // Maintain list of blocks that are pending updates. A block can only be
-    // split into a maximum of 3 blocks.
-    sky_block *pending_updates[3];
-    uint32_t pending_update_count = 0;
-    
-    // Retrieve path info.
-    bool is_first_path_in_block = (path_ptr == block_ptr);
-    sky_object_id_t object_id = *((sky_object_id_t*)path_ptr);
+error:
+    return -1;
+}
 
-    // Distribute events across blocks.
+
+//--------------------------------------
+// Object Lookup
+//--------------------------------------
+
+// Checks whether a block may contain the path of an object. Spanned blocks
+// are checked against their object id range. Multi-object blocks are also
+// checked against their bloom filter so most misses are rejected without
+// reading the block.
+//
+// block     - The block.
+// object_id - The object id.
+// ret       - A pointer to where the result should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_may_contain_object(sky_block *block, sky_object_id_t object_id,
+                                 bool *ret)
+{
+    int rc;
     uint32_t i;
-    uint32_t last_index = 0;
-    size_t sz = SKY_PATH_HEADER_LENGTH;
-    for(i=0; i<event_count; i++) {
-        sky_path_event_stat *event = &(events[i]);
-        sky_path_event_stat *next_event = (i < event_count-1 ? &(events[i+1]) : NULL);
+    check(block != NULL, "Block required");
+    check(ret != NULL, "Return pointer required");
 
-        // If we exceed the block size then create a spanned block.
-        if(SKY_PATH_HEADER_LENGTH + event->sz > block_size) {
-            sentinel("Event is too large for block");
-        }
-        
-        // Add the event size to the running total.
-        sz += event->sz;
+    *ret = (object_id >= block->min_object_id && object_id <= block->max_object_id);
+    if(!*ret || block->spanned) {
+        return 0;
+    }
 
-        // If we exceeded the target size or if there is remaining data
-        // in an already split block then move everything to a new block.
-        bool exceeds_target_size = (sz >= target_size);
-        bool is_last_event = (i == event_count-1 && last_index > 0);
-        bool next_event_exceeds_max = (next_event != NULL && sz + next_event->sz > block_size);
-        if(exceeds_target_size || is_last_event || next_event_exceeds_max) {
-            sky_path_event_stat *last_event = &(events[last_index]);
-
-            // Calculate lengths and positions of event range.
-            size_t start_pos = last_event->start_pos;
-            size_t end_pos   = event->end_pos;
-            size_t len = end_pos - start_pos;
-
-            // If this is the first span of the first path of a block then
-            // just leave the data where it is.
-            sky_block *new_block = NULL;
-            void *new_block_ptr = NULL;
-            if(is_first_path_in_block && last_index == 0) {
-                new_block = block;
-                new_block_ptr = path_ptr;
-            }
-            // Otherwise move the data to a new block.
-            else {
-                // Save path pointer.
-                off_t path_off = path_ptr - data_file->data;
+    if(!block->bloom_valid) {
+        rc = sky_block_build_bloom(block);
+        check(rc == 0, "Unable to build block bloom filter");
+    }
 
-                // Create a new block.
-                rc = sky_data_file_create_block(data_file, &new_block);
-                check(rc == 0, "Unable to create new block");
+    for(i=0; i<SKY_BLOCK_BLOOM_HASH_COUNT && *ret; i++) {
+        uint32_t bit = sky_block_get_bloom_bit(object_id, i);
+        *ret = ((block->bloom[bit / 64] >> (bit % 64)) & 1);
+    }
 
-                // Restore path pointer.
-                path_ptr = data_file->data + path_off;
-                
-                // Retrieve the new block's pointer.
-                rc = sky_block_get_ptr(new_block, &new_block_ptr);
-                check(rc == 0, "Unable to retrieve new block's data pointer");
+    return 0;
 
-                // Move data.
-                if(len > 0) {
-                    void *ptr = path_ptr + start_pos;
-                    memmove(new_block_ptr + SKY_PATH_HEADER_LENGTH, ptr, len);
-                    memset(ptr, 0, len);
-                }
-            }
+error:
+    if(ret) *ret = false;
+    return -1;
+}
 
-            // Clear out original header.
-            if(last_index == 0) {
-                memset(path_ptr, 0, SKY_PATH_HEADER_LENGTH);
-            }
+// Finds the path of an object in a block.
+//
+// block     - The block.
+// object_id - The object id.
+// ret       - A pointer to where the raw path should be returned. This is
+//             NULL if the object has no path in the block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_find_path(sky_block *block, sky_object_id_t object_id, void **ret)
+{
+    int rc;
+    bool found;
+    check(block != NULL, "Block required");
+    check(ret != NULL, "Return pointer required");
+    *ret = NULL;
 
-            // If we are leaving an empty block then clear the path header.
-            if(len == 0) {
-                memset(new_block_ptr, 0, SKY_PATH_HEADER_LENGTH);
-            }
-            // Otherwise write the header.
-            else {
-                rc = sky_path_pack_hdr(object_id, len, new_block_ptr, &_sz);
-                check(rc == 0, "Unable to write path header");
-            }
+    rc = sky_block_may_contain_object(block, object_id, &found);
+    check(rc == 0, "Unable to check block for object");
+    if(!found) {
+        return 0;
+    }
 
-            // Add to pending updates list.
-            pending_update_count++;
-            pending_updates[pending_update_count-1] = new_block;
+    // Paths are sorted by object id so stop once the object is passed.
+    sky_path_iterator iterator;
+    sky_path_iterator_init(&iterator);
+    rc = sky_path_iterator_set_block(&iterator, block);
+    check(rc == 0, "Unable to set path iterator block");
 
-            // If new block contains the event timestamp in range then
-            // set it as the target block.
-            if(new_event->timestamp >= last_event->timestamp && event->timestamp <= new_event->timestamp) {
-                *target_block = new_block;
-            }
-            
-            // Flag block as spanned.
-            new_block->spanned = true;
-            
-            // Save where we left off.
-            last_index = i+1;
-            sz = SKY_PATH_HEADER_LENGTH;
+    while(!iterator.eof && iterator.current_object_id <= object_id) {
+        if(iterator.current_object_id == object_id) {
+            rc = sky_path_iterator_get_ptr(&iterator, ret);
+            check(rc == 0, "Unable to retrieve path pointer");
+            break;
         }
-    }
 
-    // Update block ranges.
-    for(i=0; i<pending_update_count; i++) {
-        rc = sky_block_full_update(pending_updates[i]);
-        check(rc == 0, "Unable to update block ranges");
+        rc = sky_path_iterator_next(&iterator);
+        check(rc == 0, "Unable to move to next path");
     }
 
-    // Update block range on the original block if a split occurred.
-    if(last_index > 0) {
-        rc = sky_block_full_update(block);
-        check(rc == 0, "Unable to update block ranges");
+    return 0;
+
+error:
+    if(ret) *ret = NULL;
+    return -1;
+}
+
+// Rebuilds the bloom filter from the object ids of the paths in a block.
+//
+// block - The block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_build_bloom(sky_block *block)
+{
+    int rc;
+    memset(block->bloom, 0, sizeof(block->bloom));
+
+    sky_path_iterator iterator;
+    sky_path_iterator_init(&iterator);
+    rc = sky_path_iterator_set_block(&iterator, block);
+    check(rc == 0, "Unable to set path iterator block");
+
+    while(!iterator.eof) {
+        sky_block_add_bloom(block, iterator.current_object_id);
+        rc = sky_path_iterator_next(&iterator);
+        check(rc == 0, "Unable to move to next path");
     }
-    
-    free(events);
+
+    block->bloom_valid = true;
     return 0;
 
 error:
-    *target_block = NULL;
-    free(events);
+    block->bloom_valid = false;
     return -1;
 }
 
+// Adds an object id to the bloom filter of a block.
+//
+// block     - The block.
+// object_id - The object id.
+void sky_block_add_bloom(sky_block *block, sky_object_id_t object_id)
+{
+    uint32_t i;
+    for(i=0; i<SKY_BLOCK_BLOOM_HASH_COUNT; i++) {
+        uint32_t bit = sky_block_get_bloom_bit(object_id, i);
+        block->bloom[bit / 64] |= (1ULL << (bit % 64));
+    }
+}
+
+// Calculates one of the bloom filter bits for an object id. The object id is
+// hashed by multiplying with a large odd constant and each bit is taken from
+// a different slice of the upper half of the product.
+//
+// object_id - The object id.
+// index     - The index of the hash function.
+//
+// Returns the bit position in the bloom filter.
+uint32_t sky_block_get_bloom_bit(sky_object_id_t object_id, uint32_t index)
+{
+    uint64_t hash = (uint64_t)object_id * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(hash >> (32 + (index * 10))) % (SKY_BLOCK_BLOOM_WORD_COUNT * 64);
+}
+
 
 //--------------------------------------
-// Path Stats
+// Directory
 //--------------------------------------
 
-// Generates an index of stats on all the paths in the block. If an event is
-// passed in then it also generates stats on the path the event would be
-// added to or a new path that would be created from that event.
+// Rebuilds the path directory of a block from its raw data. The entries are
+// reused so rebuilding only allocates when the block has more paths.
 //
-// block      - The block to calculate stats on.
-// event      - A soon-to-be-added event to calculate into the paths. If null then
-//              the stats are calculated as they exist in the block.
-// paths      - A pointer to where the stats should be returned.
-// path_count - A pointer to where the number of paths should be returned.
-int sky_block_get_path_stats(sky_block *block, sky_event *event,
-                             sky_block_path_stat **paths,
-                             uint32_t *path_count)
+// block - The block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_build_directory(sky_block *block)
 {
     int rc;
     check(block != NULL, "Block required");
-    check(paths != NULL, "Paths return address required");
-    check(path_count != NULL, "Path count return address required");
+    block->directory_valid = false;
+    block->directory_count = 0;
 
-    // Initialize data file & block pointers.
     void *block_ptr = NULL;
     rc = sky_block_get_ptr(block, &block_ptr);
     check(rc == 0, "Unable to retrieve block pointer");
-    
-    // Initialize path iterator.
-    sky_path_iterator iterator;
-    sky_path_iterator_init(&iterator);
-    rc = sky_path_iterator_set_block(&iterator, block);
-    check(rc == 0, "Unable to set path iterator block");
+    void *block_end_ptr = block_ptr + block->data_file->block_size;
+
+    // Loop over each path until the end of the block or until null data.
+    void *path_ptr = block_ptr;
+    while(path_ptr <= block_end_ptr - SKY_PATH_HEADER_LENGTH && *((sky_object_id_t*)path_ptr) != 0) {
+        if(block->directory_count >= block->directory_capacity) {
+            uint32_t capacity = (block->directory_capacity > 0 ? block->directory_capacity * 2 : 16);
+            sky_block_directory_entry *directory = realloc(block->directory, sizeof(*directory) * capacity);
+            check_mem(directory);
+            block->directory = directory;
+            block->directory_capacity = capacity;
+        }
 
-    // Calculate size of the event.
-    size_t event_length = (event != NULL ? sky_event_sizeof(event) : 0);
+        sky_block_directory_entry *entry = &block->directory[block->directory_count++];
+        entry->object_id = *((sky_object_id_t*)path_ptr);
+        entry->offset = (uint32_t)(path_ptr - block_ptr);
+        entry->event_count = 0;
+        entry->action_mask = 0;
+
+        // Summarize the events of the path.
+        sky_timestamp_t timestamp = 0;
+        if(block->data_file->action_only) {
+            sky_path_foreach_action_only_event(path_ptr, event_ptr) {
+                timestamp = sky_event_get_timestamp(event_ptr, timestamp);
+                if(entry->event_count == 0) {
+                    entry->min_timestamp = timestamp;
+                }
+                entry->event_count++;
+                entry->action_mask |= sky_block_action_bit(sky_cursor_action_only_get_action_id(event_ptr));
+            }
+        }
+        else {
+            sky_path_foreach_event(path_ptr, event_ptr) {
+                timestamp = sky_event_get_timestamp(event_ptr, timestamp);
+                if(entry->event_count == 0) {
+                    entry->min_timestamp = timestamp;
+                }
+                entry->event_count++;
+                entry->action_mask |= sky_block_action_bit(sky_cursor_fast_get_action_id(event_ptr));
+            }
+        }
+        entry->max_timestamp = timestamp;
 
-    // Initialize return values.
-    *path_count = 0;
-    *paths = NULL;
- 
-    // Loop over iterator to calculate sizes of the paths.
-    sky_object_id_t last_object_id = 0;
-    while(!iterator.eof) {
-        // Retrieve path pointer.
-        void *path_ptr = NULL;
-        rc = sky_path_iterator_get_ptr(&iterator, &path_ptr);
-        check(rc == 0, "Unable to retrieve iterator's current pointer");
+        path_ptr += sky_path_sizeof_raw(path_ptr);
+    }
 
-        // Check if event is a new path inserted between the last path and
-        // this current path.
-        if(event != NULL && event->object_id > last_object_id && event->object_id < iterator.current_object_id) {
-            // Increment paths array.
-            (*path_count)++;
-            *paths = realloc(*paths, sizeof(sky_block_path_stat) * (*path_count));
-            sky_block_path_stat *stat = &((*paths)[(*path_count)-1]);
-            stat->object_id = event->object_id;
-            stat->start_pos = stat->end_pos = (path_ptr - block_ptr);
-            stat->sz = SKY_PATH_HEADER_LENGTH + event_length;
+    block->directory_data_length = (size_t)(path_ptr - block_ptr);
+    block->directory_valid = true;
+    return 0;
+
+error:
+    block->directory_count = 0;
+    return -1;
+}
+
+// Retrieves the directory of a block, building it first if it is not valid.
+//
+// block   - The block.
+// entries - A pointer to where the directory entries should be returned.
+// count   - A pointer to where the number of entries should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_get_directory(sky_block *block,
+                            sky_block_directory_entry **entries,
+                            uint32_t *count)
+{
+    int rc;
+    check(block != NULL, "Block required");
+
+    if(!block->directory_valid) {
+        rc = sky_block_build_directory(block);
+        check(rc == 0, "Unable to build block directory");
+    }
+    *entries = block->directory;
+    *count = block->directory_count;
+    return 0;
+
+error:
+    *entries = NULL;
+    *count = 0;
+    return -1;
+}
+
+// Finds the position of an object in the directory of a block with a binary
+// search. The directory must be valid.
+//
+// block     - The block.
+// object_id - The object id.
+//
+// Returns the index of the object's path or of the first path with a larger
+// object id. This is the directory count if every path is before the object.
+uint32_t sky_block_search_directory(sky_block *block,
+                                    sky_object_id_t object_id)
+{
+    uint32_t min = 0, max = block->directory_count;
+    while(min < max) {
+        uint32_t mid = min + ((max - min) / 2);
+        if(block->directory[mid].object_id < object_id) {
+            min = mid + 1;
         }
-        
-        // Calculate current path stats.
-        size_t path_length = sky_path_sizeof_raw(path_ptr);
-        (*path_count)++;
-        *paths = realloc(*paths, sizeof(sky_block_path_stat) * (*path_count));
-        sky_block_path_stat *stat = &((*paths)[(*path_count)-1]);
-        stat->object_id = iterator.current_object_id;
-        stat->start_pos = path_ptr - block_ptr;
-        stat->end_pos = stat->start_pos + path_length;
-        stat->sz = path_length;
-    
-        // Add insertion event length if this is the matching path.
-        if(event != NULL && event->object_id == iterator.current_object_id) {
-            stat->sz += event_length;
+        else {
+            max = mid;
         }
+    }
+    return min;
+}
 
-        // Save off this object id.
-        last_object_id = iterator.current_object_id;
-    
-        // Move to next path.
-        rc = sky_path_iterator_next(&iterator);
-        check(rc == 0, "Unable to move to next path");
+// Updates the directory of a block after an event has been inserted. A
+// new path is added to the directory or the summary of the existing path is
+// extended, and the paths after the insertion point are moved down by the
+// size of the insert.
+//
+// block       - The block.
+// event       - The event that was added.
+// path_exists - Whether the event was added to an existing path.
+// offset      - The offset of the event's path in the block.
+// sz          - The number of bytes that were inserted.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_update_directory(sky_block *block, sky_event *event,
+                               bool path_exists, size_t offset, size_t sz)
+{
+    uint32_t i;
+    if(!block->directory_valid) {
+        return 0;
     }
 
-    // Check if event is a new path inserted at the end.
-    if(event != NULL && event->object_id > last_object_id) {
-        (*path_count)++;
-        *paths = realloc(*paths, sizeof(sky_block_path_stat) * (*path_count));
-        sky_block_path_stat *stat = &((*paths)[(*path_count)-1]);
-        stat->object_id = event->object_id;
-        stat->start_pos = stat->end_pos = iterator.block_data_length;
-        stat->sz = SKY_PATH_HEADER_LENGTH + event_length;
+    uint32_t index = sky_block_search_directory(block, event->object_id);
+    if(path_exists) {
+        sky_block_directory_entry *entry = &block->directory[index];
+        if(event->timestamp > entry->max_timestamp) {
+            entry->max_timestamp = event->timestamp;
+        }
+        if(event->timestamp < entry->min_timestamp) {
+            entry->min_timestamp = event->timestamp;
+        }
+        entry->event_count++;
+        entry->action_mask |= sky_block_action_bit(event->action_id);
     }
-    
+    else {
+        if(block->directory_count >= block->directory_capacity) {
+            uint32_t capacity = (block->directory_capacity > 0 ? block->directory_capacity * 2 : 16);
+            sky_block_directory_entry *directory = realloc(block->directory, sizeof(*directory) * capacity);
+            check_mem(directory);
+            block->directory = directory;
+            block->directory_capacity = capacity;
+        }
+        memmove(&block->directory[index+1], &block->directory[index], sizeof(*block->directory) * (block->directory_count - index));
+        block->directory_count++;
+
+        sky_block_directory_entry *entry = &block->directory[index];
+        entry->object_id = event->object_id;
+        entry->offset = (uint32_t)offset;
+        entry->min_timestamp = event->timestamp;
+        entry->max_timestamp = event->timestamp;
+        entry->event_count = 1;
+        entry->action_mask = sky_block_action_bit(event->action_id);
+    }
+
+    for(i=index+1; i<block->directory_count; i++) {
+        block->directory[i].offset += (uint32_t)sz;
+    }
+    block->directory_data_length += sz;
+
     return 0;
 
 error:
-    free(*paths);
-    *paths = NULL;
-    *path_count = 0;
+    block->directory_valid = false;
     return -1;
 }
 
 
-
 //--------------------------------------
-// Event Management
+// Zone Maps
 //--------------------------------------
 
-// Adds an event to the block. If the size of the block exceeds the block size
-// then a new empty block is allocated and half the paths in the block are
-// moved to the new block.
+// Retrieves the range of the numeric values of a property in a block. The
+// zone map of the block is built the first time it is needed.
 //
-// block - The block to add the event to.
-// event - The event to add to the block.
+// block       - The block.
+// property_id - The property.
+// ret         - A pointer to where the zone should be returned. This is NULL
+//               if no event in the block has a numeric value for the
+//               property.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_block_add_event(sky_block *block, sky_event *event)
+int sky_block_get_zone(sky_block *block, sky_property_id_t property_id,
+                       sky_block_zone **ret)
 {
     int rc;
+    uint32_t i;
     check(block != NULL, "Block required");
-    check(event != NULL, "Event required");
-    check(block->data_file != NULL, "Block data file required");
-    check(block->data_file->block_size > 0, "Block data file must have a nonzero block size");
-
-    // Store the block pointer.
-    void *block_ptr;
-    rc = sky_block_get_ptr(block, &block_ptr);
-    check(rc == 0, "Unable to retrieve block pointer");
-
-    // Initialize path iterator.
-    sky_path_iterator iterator;
-    sky_path_iterator_init(&iterator);
-    rc = sky_path_iterator_set_block(&iterator, block);
-    check(rc == 0, "Unable to set path iterator block");
-
-    // Retrieve insertion points and block info.
-    void *path_ptr, *event_ptr;
-    size_t block_data_length;
-    rc = sky_block_get_insertion_info(block, event, &path_ptr, &event_ptr, &block_data_length);
-    check(rc == 0, "Unable to determine insertion info to add event");
+    check(ret != NULL, "Return pointer required");
+    *ret = NULL;
 
-    // Determine size.
-    bool path_exists = (event_ptr != NULL);
-    size_t event_length = sky_event_sizeof(event);
-    size_t sz = event_length + (!path_exists ? SKY_PATH_HEADER_LENGTH : 0);
-    
-    // If adding the event will cause a split then go ahead and split and
-    // recall this function.
-    if(block_data_length + sz > block->data_file->block_size) {
-        sky_block *target_block;
-        rc = sky_block_split_with_event(block, event, &target_block);
-        check(rc == 0, "Unable to split block");
-        
-        // Attempt to add the event again now.
-        rc = sky_block_add_event(target_block, event);
-        check(rc == 0, "Unable to add event into target block");
-        
-        // Exit here since the event was added in the previous add_event
-        // invocation.
-        return 0;
+    if(!block->zones_valid) {
+        rc = sky_block_build_zones(block);
+        check(rc == 0, "Unable to build block zone map");
     }
 
-    // If we reached EOF and found no path insertion point then move the
-    // pointer to the end of the last path.
-    if(path_ptr == NULL) {
-        path_ptr = block_ptr + block_data_length;
+    for(i=0; i<block->zone_count; i++) {
+        if(block->zones[i].property_id == property_id) {
+            *ret = &block->zones[i];
+            break;
+        }
     }
 
-    // Shift data down in the block so we have enough room.
-    void *ptr = (path_exists ? event_ptr : path_ptr);
-    memmove(ptr+sz, ptr, block_data_length-(ptr-block_ptr));
-    
-    // Pack the path first if it is missing.
-    if(!path_exists) {
-        rc = sky_path_pack_hdr(event->object_id, event_length, ptr, &sz);
-        check(rc == 0, "Unable to pack path header");
-        
-        // Point event pointer at the beginning of the path event data.
-        event_ptr = path_ptr + SKY_PATH_HEADER_LENGTH;
-    }
-    // Or update the path event length if a path exists.
-    else {
-        *(sky_path_event_data_length_t*)(path_ptr+sizeof(sky_object_id_t)) += event_length;
-    }
-    
-    // Pack event.
-    size_t event_sz;
-    rc = sky_event_pack(event, event_ptr, &event_sz);
-    check(rc == 0, "Unable to pack event");
-    
-    // Save block to disk.
-    rc = sky_block_save(block);
-    check(rc == 0, "Unable to save block");
-    
-    // Update header.
-    rc = sky_block_update(block, event->object_id, event->timestamp);
-    check(rc == 0, "Unable to write block to header");
-    
     return 0;
 
 error:
+    if(ret) *ret = NULL;
     return -1;
 }
 
-// Calculates the information needed to perform an insertion of an event into
-// a block. The path pointer points to where the path is or should be inserted
-// into. The event pointer points to where the event should be inserted into.
-// If the event pointer is NULL then a path was not found. Finally, the block
-// data length is how many bytes in the block are actually used to store data
-// (and are not empty).
+// Rebuilds the zone map from the events of a block.
 //
-// block     - The block to add the event to.
-// event     - The event to add to the block.
-// path_ptr  - A pointer to where the path pointer should be returned to.
-// event_ptr - A pointer to where the event pointer should be returned to.
-// block_data_length - A pointer to where the length of the block's data
-//                     should be returned to.
+// block - The block.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_block_get_insertion_info(sky_block *block, sky_event *event,
-                                 void **path_ptr, void **event_ptr,
-                                 size_t *block_data_length)
+int sky_block_build_zones(sky_block *block)
 {
     int rc;
-    check(block != NULL, "Block required");
-    check(event != NULL, "Event required");
+    int64_t value;
+    bool pinned = false;
+    block->zone_count = 0;
+
+    rc = sky_block_pin(block);
+    check(rc == 0, "Unable to pin block");
+    pinned = true;
 
-    // Initialize path iterator.
     sky_path_iterator iterator;
     sky_path_iterator_init(&iterator);
     rc = sky_path_iterator_set_block(&iterator, block);
     check(rc == 0, "Unable to set path iterator block");
 
-    // Initialize path and event pointers.
-    *path_ptr  = NULL;
-    *event_ptr = NULL;
-    
-    // Loop over iterator until we find the path or insertion point.
     while(!iterator.eof) {
-        // If we reached the correct path then retrieve the path pointer
-        // and then use a cursor to find the insertion point.
-        if(event->object_id == iterator.current_object_id) {
-            // Save path pointer.
-            rc = sky_path_iterator_get_ptr(&iterator, path_ptr);
-            check(rc == 0, "Unable to retrieve iterator's current pointer");
-            
-            // Use cursor to find event insertion point.
-            sky_cursor cursor;
-            sky_cursor_init(&cursor);
-            sky_cursor_set_path(&cursor, *path_ptr);
-            check(rc == 0, "Unable to set cursor path");
-            
-            // Loop over cursor until we reach the event insertion point.
-            while(!cursor.eof) {
-                sky_timestamp_t timestamp;
-                sky_action_id_t action_id;
-                sky_event_data_length_t data_length;
-
-                // Retrieve current timestamp in cursor.
-                size_t hdrsz;
-                rc = sky_event_unpack_hdr(&timestamp, &action_id, &data_length, cursor.ptr, &hdrsz);
-                check(rc == 0, "Unable to unpack event header");
-                
-                // Retrieve event insertion pointer once the timestamp is
-                // reached.
-                if(timestamp >= event->timestamp) {
-                    *event_ptr = cursor.ptr;
-                    break;
+        void *path_ptr = NULL;
+        rc = sky_path_iterator_get_ptr(&iterator, &path_ptr);
+        check(rc == 0, "Unable to retrieve path pointer");
+
+        sky_path_foreach_event(path_ptr, event_ptr) {
+            sky_event_flag_t flag = *((sky_event_flag_t*)event_ptr);
+            if(!(flag & SKY_EVENT_FLAG_DATA)) {
+                continue;
+            }
+
+            // Read each value in the data section.
+            void *ptr = event_ptr + sky_event_header_length(flag) + ((flag & SKY_EVENT_FLAG_ACTION) ? sizeof(sky_action_id_t) : 0);
+            uint32_t data_length = *((sky_event_data_length_t*)ptr);
+            ptr += sizeof(sky_event_data_length_t);
+            void *end_ptr = ptr + data_length;
+
+            uint32_t i, fixed_count = sky_event_data_get_fixed_count(ptr, data_length);
+            for(i=0; i<fixed_count; i++) {
+                sky_event_data_view view;
+                sky_event_data_get_fixed_view(ptr, i, &view);
+                if(sky_event_data_view_get_numeric_value(&view, &value)) {
+                    rc = sky_block_add_zone_value(block, view.key, value);
+                    check(rc == 0, "Unable to add value to zone map");
                 }
-                
-                // Move to next event.
-                rc = sky_cursor_next(&cursor);
-                check(rc == 0, "Unable to move to next event");
             }
-            
-            // If no insertion point was found then append the event to the
-            // end of the path.
-            if(*event_ptr == NULL) {
-                *event_ptr = (*path_ptr) + sky_path_sizeof_raw(*path_ptr);
+            ptr += sky_event_data_get_fixed_length(ptr, data_length);
+
+            while(ptr < end_ptr) {
+                sky_property_id_t property_id = *((sky_property_id_t*)ptr);
+                ptr += sizeof(sky_property_id_t);
+                if(sky_predicate_unpack_value(ptr, &value)) {
+                    rc = sky_block_add_zone_value(block, property_id, value);
+                    check(rc == 0, "Unable to add value to zone map");
+                }
+
+                size_t sz = sky_minipack_batch_sizeof_elem(ptr);
+                if(sz == 0) {
+                    break;
+                }
+                ptr += sz;
             }
         }
-        // If we are beyond the object id then exit and use the current
-        // pointer as the insertion point.
-        else if(*path_ptr == NULL && iterator.current_object_id > event->object_id) {
-            rc = sky_path_iterator_get_ptr(&iterator, path_ptr);
-            check(rc == 0, "Unable to retrieve iterator's current pointer");
-        }
-        
-        // Move to next path.
+
         rc = sky_path_iterator_next(&iterator);
         check(rc == 0, "Unable to move to next path");
     }
-    
-    // Save the length of the data in the block. This value can only be 
-    // determined after the iterator has reached EOF.
-    *block_data_length = iterator.block_data_length;
 
+    sky_block_unpin(block);
+    block->zones_valid = true;
     return 0;
 
 error:
-    *path_ptr  = NULL;
-    *event_ptr = NULL;
-    *block_data_length = 0;
+    if(pinned) sky_block_unpin(block);
+    block->zones_valid = false;
     return -1;
 }
 
-// Iterates over a block and splits it into smaller blocks. The block attempts
-// to create blocks which are half the maximum size although this is not
-// always possible because of path sizes.
-//
-// This function also creates spanned blocks when a single path is too large
-// for a single block. If an event is added that will exceed the block size
-// then the function will fail.
+// Extends the zone map of a block with the numeric values of an event.
 //
-// block        - The block to add the event to.
-// event        - The event to add to the block.
-// target_block - A pointer to where insertion block for the event will be.
+// block - The block.
+// event - The event.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_block_split_with_event(sky_block *block, sky_event *event,
-                               sky_block **target_block)
+int sky_block_add_event_to_zones(sky_block *block, sky_event *event)
 {
     int rc;
     uint32_t i;
-    check(block != NULL, "Block required");
-    check(event != NULL, "Event required");
-    check(block->data_file != NULL, "Block data file required");
-    check(block->data_file->block_size > 0, "Block data file must have a nonzero block size");
-
-    // Initialize path stats.
-    uint32_t path_count = 0;
-    sky_block_path_stat *paths;
-
-    // Calculate target block size.
-    sky_data_file *data_file = block->data_file;
-    uint32_t block_size = data_file->block_size;
-    uint32_t target_size = (block_size / 2);
-
-    // Retrieve a list of path sizes in the current block (plus new event).
-    rc = sky_block_get_path_stats(block, event, &paths, &path_count);
-    check(rc == 0, "Unable to calculate path stats on block");
-    
-    // Initialize the return value.
-    *target_block = block;
-    
-    // If a span is occurring then treat it as a special case.
-    bool is_spanning = false;
-    for(i=0; i<path_count; i++) {
-        sky_block_path_stat *path = &(paths[i]);
-
-        // If this path will exceed the block size then create a span.
-        if(path->sz > block_size) {
-            // Retrieve the block pointer.
-            void *block_ptr = NULL;
-            rc = sky_block_get_ptr(block, &block_ptr);
-            check(rc == 0, "Unable to retrieve source block pointer");
-            
-            // Span the path across multiple blocks and set the target block.
-            rc = sky_block_span_with_event(block, event, block_ptr + path->start_pos, target_size, target_block);
-            check(rc == 0, "Unable to create span");
-            
-            // Move remaining paths to new block.
-            if(i < path_count-1) {
-                // Create a new block.
-                sky_block *new_block = NULL;
-                rc = sky_data_file_create_block(data_file, &new_block);
-                check(rc == 0, "Unable to create new block");
-
-                // Retrieve the new block's pointer.
-                void *new_block_ptr = NULL;
-                rc = sky_block_get_ptr(new_block, &new_block_ptr);
-                check(rc == 0, "Unable to retrieve new block's data pointer");
-
-                // Retrieve the original block's pointer
-                void *block_ptr = NULL;
-                rc = sky_block_get_ptr(block, &block_ptr);
-                check(rc == 0, "Unable to retrieve source block pointer");
-
-                // Calculate offsets.
-                size_t start_pos = paths[i+1].start_pos;
-                size_t end_pos   = paths[path_count-1].end_pos;
-                void *ptr = block_ptr + start_pos;
-                size_t len = end_pos - start_pos;
-
-                // Move data into new block.
-                memmove(new_block_ptr, ptr, len);
-                memset(ptr, 0, len);
+    int64_t value;
 
-                // Update block ranges.
-                rc = sky_block_full_update(new_block);
-                check(rc == 0, "Unable to update block ranges");
-            }
-            
-            // Set a flag stating that a span has occurred.
-            is_spanning = true;
-            break;
+    for(i=0; i<event->data_count; i++) {
+        if(sky_event_data_get_numeric_value(event->data[i], &value)) {
+            rc = sky_block_add_zone_value(block, event->data[i]->key, value);
+            check(rc == 0, "Unable to add value to zone map");
         }
     }
-    
-    // Distribute paths across blocks if a span did not occur.
-    if(!is_spanning) {
-        uint32_t last_index = 0;
-        size_t sz = 0;
-        for(i=0; i<path_count; i++) {
-            sky_block_path_stat *path = &(paths[i]);
-            sky_block_path_stat *next_path = (i < path_count-1 ? &(paths[i+1]) : NULL);
 
-            // Add the path size to the running total.
-            sz += path->sz;
+    return 0;
 
-            // If we exceeded the target size or if there is remaining data
-            // in an already split block then move everything to a new block.
-            bool exceeds_target_size = (sz >= target_size);
-            bool is_last_path = (i == path_count-1 && last_index > 0);
-            bool next_path_exceeds_max = (next_path != NULL && sz + next_path->sz > block_size);
-            if(exceeds_target_size || is_last_path || next_path_exceeds_max) {
-                sky_block_path_stat *last_path = &(paths[last_index]);
-
-                // If this is the first split then leave it in the first block.
-                if(last_index > 0) {
-                    // Create a new block.
-                    sky_block *new_block = NULL;
-                    rc = sky_data_file_create_block(data_file, &new_block);
-                    check(rc == 0, "Unable to create new block");
-
-                    // Retrieve the new block's pointer.
-                    void *new_block_ptr = NULL;
-                    rc = sky_block_get_ptr(new_block, &new_block_ptr);
-                    check(rc == 0, "Unable to retrieve new block's data pointer");
-
-                    // Retrieve the original block's pointer
-                    void *block_ptr = NULL;
-                    rc = sky_block_get_ptr(block, &block_ptr);
-                    check(rc == 0, "Unable to retrieve source block pointer");
-
-                    // Calculate offsets.
-                    size_t start_pos = last_path->start_pos;
-                    size_t end_pos   = path->end_pos;
-                    void *ptr = block_ptr + start_pos;
-                    size_t len = end_pos - start_pos;
-
-                    // Move data into new block.
-                    memmove(new_block_ptr, ptr, len);
-                    memset(ptr, 0, len);
-
-                    // Update block ranges.
-                    rc = sky_block_full_update(new_block);
-                    check(rc == 0, "Unable to update block ranges");
-
-                    // If new block contains the event object id in range then
-                    // set it as the target block.
-                    if(event->object_id >= last_path->object_id && event->object_id <= path->object_id) {
-                        *target_block = new_block;
-                    }
-                }
+error:
+    block->zones_valid = false;
+    return -1;
+}
 
-                // Save where we left off.
-                last_index = i+1;
-                sz = 0;
-            }
+// Widens the zone of a property to include a value.
+//
+// block       - The block.
+// property_id - The property.
+// value       - The value.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_add_zone_value(sky_block *block, sky_property_id_t property_id,
+                             int64_t value)
+{
+    uint32_t i;
+    for(i=0; i<block->zone_count; i++) {
+        sky_block_zone *zone = &block->zones[i];
+        if(zone->property_id == property_id) {
+            if(value < zone->min) zone->min = value;
+            if(value > zone->max) zone->max = value;
+            return 0;
         }
     }
-    
-    // Update block range on the original block.
-    rc = sky_block_full_update(block);
-    check(rc == 0, "Unable to update block ranges");
 
-    free(paths);
+    sky_block_zone *zones = realloc(block->zones, sizeof(*zones) * (block->zone_count+1));
+    check_mem(zones);
+    block->zones = zones;
+    sky_block_zone *zone = &block->zones[block->zone_count++];
+    zone->property_id = property_id;
+    zone->min = value;
+    zone->max = value;
+
     return 0;
 
 error:
-    free(paths);
     return -1;
 }
 
-
 //--------------------------------------
 // Debugging
 //--------------------------------------
@@ -1170,3 +2865,28 @@ int sky_block_memdump(sky_block *block)
 error:
     return -1;
 }
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+// Calculates the heap memory used by the metadata of a block: its header,
+// zones, directory and column. The cached copy of a compressed block is
+// counted by the block cache.
+//
+// block - The block.
+//
+// Returns the number of bytes.
+size_t sky_block_get_memory_usage(sky_block *block)
+{
+    if(block == NULL) {
+        return 0;
+    }
+
+    size_t size = sizeof(*block);
+    size += sizeof(*block->zones) * block->zone_count;
+    size += sizeof(*block->directory) * block->directory_capacity;
+    size += sky_block_column_get_memory_usage(block->column);
+    return size;
+}
@@ -3,6 +3,7 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <time.h>
 
 typedef struct sky_block sky_block;
 
@@ -11,6 +12,8 @@ typedef struct sky_block sky_block;
 #include "types.h"
 #include "data_file.h"
 #include "event.h"
+#include "block_column.h"
+#include "block_cache.h"
 
 //==============================================================================
 //
@@ -23,7 +26,70 @@ typedef struct sky_block sky_block;
 // stored in order of block index within the header file.
 //
 // The block also stores whether it is spanned, meaning that the
-// object that it contains is stored across multiple blocks.
+// object that it contains is stored across multiple blocks. The data file
+// keeps the number of blocks from each block to the end of its span up to
+// date so iterators can skip a span without scanning its blocks.
+//
+// While its data file is batching or is not in strict durability mode,
+// changes to a block are not synced to disk immediately. Instead the block is
+// flagged as dirty and it is saved once when the data file is flushed.
+//
+// A block can also keep a column of the action ids and timestamps of its
+// events for action-only scans. See block_column.h.
+//
+// Multi-object blocks keep an in-memory bloom filter of the object ids they
+// contain so point lookups can reject a block without scanning its paths.
+// The filter is built the first time it is needed, extended as events are
+// added and rebuilt after the paths of the block are rearranged.
+//
+// Blocks also keep an in-memory zone map with the smallest and largest
+// value of each numeric property in their events. Scans with property
+// filters skip the blocks whose zones cannot match. Like the bloom filter,
+// the zone map is built the first time it is needed, extended as events are
+// added and rebuilt after the paths of the block are rearranged.
+//
+// Blocks also keep an in-memory directory of their paths that is sorted
+// by object id. Each entry has the offset of the path in the block and the
+// timestamp of its last event. Inserts use it to find the path of an event
+// with a binary search and append events that are newer than the rest of
+// their path without walking it. The directory is built the first time an
+// event is added, updated in place by each insert and rebuilt after the
+// paths of the block are rearranged.
+//
+// Each directory entry is also a summary of its path. It holds the first
+// and last timestamp of the path, the number of events and a mask of the
+// actions that the path performs. An action sets bit `action_id % 64` of
+// the mask so a clear bit proves that the path never performs the action.
+// Queries use the summaries to reject whole paths without reading their
+// events.
+//
+// Blocks that have not been written to for a while can be compressed in
+// place. A compressed block starts with a zero object id so it looks empty
+// to old readers, followed by a marker, the length of its data and the
+// length of the compressed data. The rest of the block is released from the
+// file. Reading a compressed block returns its data from the data file's
+// block cache. Adding an event to a compressed block decompresses it in
+// place first. Spanned blocks are never compressed.
+//
+// Each block records the write version at which it was last changed so that
+// replicas can be sent only the blocks that changed since their last sync.
+// A replica overwrites its copy of a block with the stored bytes and header
+// entry of the primary's block. See replicate_message.h.
+//
+// Each block also has a CRC32C checksum of its stored bytes. The checksum is
+// kept in the data file's checksum file. Syncing a block only marks its
+// checksum as stale and the checksum is calculated once when the data file
+// is flushed, however many times the block was synced before that. A block is verified against its checksum the first
+// time its data is retrieved after the data file is loaded so a torn write
+// or a bad disk is reported as a failed block instead of as invalid events
+// in the middle of a scan. Blocks without a saved checksum, such as those
+// written before checksums were kept, are not verified until they are
+// changed and the data file is flushed. A block whose saved checksum is out
+// of date is always in the journal so recovery does not verify it.
+//
+// A block is recorded in its data file's journal before it is first changed
+// after a checkpoint so that its ranges can be rebuilt if the process stops
+// before its header entry is written. See data_file.h.
 
 
 //==============================================================================
@@ -34,14 +100,87 @@ typedef struct sky_block sky_block;
 
 #define SKY_BLOCK_HEADER_SIZE (sizeof(sky_object_id_t) * 2) + (sizeof(sky_timestamp_t) * 2)
 
+// The number of 64-bit words in the object id bloom filter of each block.
+#define SKY_BLOCK_BLOOM_WORD_COUNT 16
+
+// The marker after the zero object id at the start of a compressed block.
+#define SKY_BLOCK_COMPRESSED_MAGIC 0x5A594B53
+
+// The length of the header at the start of a compressed block: a zero object
+// id, the marker, the data length and the compressed length.
+#define SKY_BLOCK_COMPRESSED_HEADER_SIZE (sizeof(sky_object_id_t) + (sizeof(uint32_t) * 3))
+
+// The length of the entry of each block in the checksum file: the checksum
+// and a marker that shows that the checksum was saved.
+#define SKY_BLOCK_CHECKSUM_SIZE (sizeof(uint32_t) * 2)
+
+// The marker after the checksum of a block in the checksum file.
+#define SKY_BLOCK_CHECKSUM_MAGIC 0x4352434B
+
+// The range of the numeric values of a property in a block. Values are read
+// the same way that filters read them.
+typedef struct sky_block_zone {
+    sky_property_id_t property_id;
+    int64_t min;
+    int64_t max;
+} sky_block_zone;
+
+// A path in the directory of a block and the summary of its events.
+typedef struct sky_block_directory_entry {
+    sky_object_id_t object_id;
+    uint32_t offset;
+    sky_timestamp_t min_timestamp;
+    sky_timestamp_t max_timestamp;
+    uint32_t event_count;
+    uint64_t action_mask;
+} sky_block_directory_entry;
+
+// The bit of an action in the action mask of a directory entry. Events
+// without an action do not set a bit.
+#define sky_block_action_bit(ACTION_ID) \
+    ((ACTION_ID) == 0 ? 0ULL : (1ULL << ((uint64_t)(ACTION_ID) % 64)))
+
+// Whether the data of a block is stored compressed. The state is read from
+// the block the first time the block is accessed.
+typedef enum sky_block_compression_e {
+    SKY_BLOCK_COMPRESSION_UNKNOWN,
+    SKY_BLOCK_COMPRESSION_NONE,
+    SKY_BLOCK_COMPRESSION_COMPRESSED,
+} sky_block_compression_e;
+
 struct sky_block {
     sky_data_file *data_file;
     uint32_t index;
+    uint32_t position;
     sky_object_id_t min_object_id;
     sky_object_id_t max_object_id;
     sky_timestamp_t min_timestamp;
     sky_timestamp_t max_timestamp;
     bool spanned;
+    uint32_t span_count;
+    bool dirty;
+    bool header_dirty;
+    sky_block_column *column;
+    bool bloom_valid;
+    uint64_t bloom[SKY_BLOCK_BLOOM_WORD_COUNT];
+    bool zones_valid;
+    sky_block_zone *zones;
+    uint32_t zone_count;
+    bool directory_valid;
+    sky_block_directory_entry *directory;
+    uint32_t directory_count;
+    uint32_t directory_capacity;
+    size_t directory_data_length;
+    sky_block_compression_e compression;
+    sky_block_cache_entry *cache_entry;
+    time_t modified_at;
+    uint64_t write_version;
+    uint32_t checksum;
+    bool checksum_valid;
+    bool checksum_verified;
+    bool checksum_dirty;
+    bool checksum_stale;
+    bool journaled;
 };
 
 // This structure is used for splitting blocks. It contains positional
@@ -69,15 +208,32 @@ sky_block *sky_block_create(sky_data_file *data_file);
 
 void sky_block_free(sky_block *block);
 
+void sky_block_init(sky_block *block, sky_data_file *data_file);
+
+void sky_block_uninit(sky_block *block);
+
 
 //--------------------------------------
 // Persistence
 //--------------------------------------
 
+int sky_block_save(sky_block *block);
+
+int sky_block_save_range(sky_block *block, size_t offset, size_t length);
+
+int sky_block_sync(sky_block *block);
+
+int sky_block_sync_range(sky_block *block, size_t offset, size_t length);
+
 int sky_block_pack(sky_block *block, void *ptr, size_t *sz);
 
 int sky_block_unpack(sky_block *block, void *ptr, size_t *sz);
 
+int sky_block_get_stored_length(sky_block *block, size_t *length);
+
+int sky_block_replace(sky_block *block, void *header, void *data,
+    size_t length);
+
 
 //--------------------------------------
 // Header Management
@@ -85,17 +241,57 @@ int sky_block_unpack(sky_block *block, void *ptr, size_t *sz);
 
 int sky_block_get_header_offset(sky_block *block, off_t *offset);
 
+int sky_block_save_header(sky_block *block);
+
+int sky_block_write_header(sky_block *block);
+
 int sky_block_full_update(sky_block *block);
 
 
+//--------------------------------------
+// Checksums
+//--------------------------------------
+
+int sky_block_update_checksum(sky_block *block);
+
+int sky_block_write_checksum(sky_block *block);
+
+void sky_block_pack_checksum(sky_block *block, void *ptr);
+
+void sky_block_unpack_checksum(sky_block *block, void *ptr);
+
+int sky_block_verify_checksum(sky_block *block);
+
+
 //--------------------------------------
 // Block Position
 //--------------------------------------
 
+int sky_block_get_extent_index(sky_block *block, uint32_t *extent_index);
+
 int sky_block_get_offset(sky_block *block, size_t *offset);
 
 int sky_block_get_ptr(sky_block *block, void **ptr);
 
+int sky_block_get_raw_ptr(sky_block *block, void **ptr);
+
+
+//--------------------------------------
+// Compression
+//--------------------------------------
+
+int sky_block_is_compressed(sky_block *block, bool *ret);
+
+int sky_block_compress(sky_block *block, bool *ret);
+
+int sky_block_decompress(sky_block *block);
+
+int sky_block_inflate(sky_block *block, void *dest);
+
+int sky_block_pin(sky_block *block);
+
+void sky_block_unpin(sky_block *block);
+
 
 //--------------------------------------
 // Spanning
@@ -118,6 +314,55 @@ int sky_block_get_path_stats(sky_block *block, sky_event *event,
 
 int sky_block_add_event(sky_block *block, sky_event *event);
 
+int sky_block_remove_path(sky_block *block, sky_object_id_t object_id,
+    bool *removed);
+
+int sky_block_remove_events(sky_block *block, sky_object_id_t object_id,
+    sky_timestamp_t timestamp, uint32_t *count);
+
+int sky_block_clear(sky_block *block);
+
+
+//--------------------------------------
+// Column Management
+//--------------------------------------
+
+int sky_block_get_column(sky_block *block, sky_block_column **column);
+
+int sky_block_update_column(sky_block *block);
+
+
+//--------------------------------------
+// Object Lookup
+//--------------------------------------
+
+int sky_block_may_contain_object(sky_block *block, sky_object_id_t object_id,
+    bool *ret);
+
+int sky_block_find_path(sky_block *block, sky_object_id_t object_id,
+    void **ret);
+
+
+//--------------------------------------
+// Directory
+//--------------------------------------
+
+int sky_block_build_directory(sky_block *block);
+
+int sky_block_get_directory(sky_block *block,
+    sky_block_directory_entry **entries, uint32_t *count);
+
+uint32_t sky_block_search_directory(sky_block *block,
+    sky_object_id_t object_id);
+
+
+//--------------------------------------
+// Zone Maps
+//--------------------------------------
+
+int sky_block_get_zone(sky_block *block, sky_property_id_t property_id,
+    sky_block_zone **ret);
+
 
 //--------------------------------------
 // Debugging
@@ -125,5 +370,10 @@ int sky_block_add_event(sky_block *block, sky_event *event);
 
 int sky_block_memdump(sky_block *block);
 
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+size_t sky_block_get_memory_usage(sky_block *block);
 
 #endif
@@ -0,0 +1,375 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "block_cache.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_block_cache_acquire(sky_block_cache *cache, sky_block *block,
+    bool pin, void **ptr);
+
+void sky_block_cache_link(sky_block_cache *cache, sky_block_cache_entry *entry);
+
+void sky_block_cache_unlink(sky_block_cache *cache, sky_block_cache_entry *entry);
+
+void sky_block_cache_demote(sky_block_cache *cache);
+
+void sky_block_cache_evict(sky_block_cache *cache);
+
+void sky_block_cache_evict_list(sky_block_cache *cache,
+    sky_block_cache_entry *tail);
+
+void sky_block_cache_entry_free(sky_block_cache_entry *entry);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty block cache.
+//
+// capacity - The number of bytes of decompressed data to keep.
+//
+// Returns a reference to the new cache if successful. Otherwise returns
+// null.
+sky_block_cache *sky_block_cache_create(size_t capacity)
+{
+    sky_block_cache *cache = calloc(1, sizeof(sky_block_cache)); check_mem(cache);
+    cache->capacity = capacity;
+    pthread_mutex_init(&cache->mutex, NULL);
+    return cache;
+
+error:
+    return NULL;
+}
+
+// Removes a block cache and all of its entries from memory.
+//
+// cache - The cache to free.
+void sky_block_cache_free(sky_block_cache *cache)
+{
+    if(cache) {
+        while(cache->head != NULL || cache->protected_head != NULL) {
+            sky_block_cache_entry *entry = (cache->head != NULL ? cache->head : cache->protected_head);
+            sky_block_cache_unlink(cache, entry);
+            sky_block_cache_entry_free(entry);
+        }
+        pthread_mutex_destroy(&cache->mutex);
+        free(cache);
+    }
+}
+
+// Changes the number of bytes of decompressed data that the cache keeps.
+// Entries are demoted and evicted right away if the cache is now over its
+// capacity.
+//
+// cache    - The cache.
+// capacity - The number of bytes to keep.
+void sky_block_cache_set_capacity(sky_block_cache *cache, size_t capacity)
+{
+    if(cache) {
+        pthread_mutex_lock(&cache->mutex);
+        cache->capacity = capacity;
+        sky_block_cache_demote(cache);
+        sky_block_cache_evict(cache);
+        pthread_mutex_unlock(&cache->mutex);
+    }
+}
+
+// Removes a cache entry from memory and detaches it from its block.
+//
+// entry - The entry to free.
+void sky_block_cache_entry_free(sky_block_cache_entry *entry)
+{
+    if(entry) {
+        if(entry->block != NULL) {
+            entry->block->cache_entry = NULL;
+        }
+        free(entry->data);
+        free(entry);
+    }
+}
+
+
+//--------------------------------------
+// Entry Management
+//--------------------------------------
+
+// Retrieves the decompressed data of a block. The block is decompressed if
+// it is not in the cache. The entry is held until the cache is released
+// unless it is pinned.
+//
+// cache - The cache.
+// block - The compressed block.
+// ptr   - A pointer to where the decompressed data is returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_cache_get(sky_block_cache *cache, sky_block *block, void **ptr)
+{
+    return sky_block_cache_acquire(cache, block, false, ptr);
+}
+
+// Pins a block's entry so that it is not evicted until it is unpinned. The
+// block is decompressed if it is not in the cache.
+//
+// cache - The cache.
+// block - The compressed block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_cache_pin(sky_block_cache *cache, sky_block *block)
+{
+    void *ptr = NULL;
+    return sky_block_cache_acquire(cache, block, true, &ptr);
+}
+
+// Removes a pin from a block's entry. The entry can be evicted once it has
+// no pins and is not held.
+//
+// cache - The cache.
+// block - The block.
+void sky_block_cache_unpin(sky_block_cache *cache, sky_block *block)
+{
+    if(cache == NULL || block == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    sky_block_cache_entry *entry = block->cache_entry;
+    if(entry != NULL && entry->pin_count > 0) {
+        entry->pin_count--;
+        sky_block_cache_evict(cache);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+// Removes a block's entry from the cache. This is used when a block is
+// decompressed in place or freed and no pointers into its entry can be
+// outstanding.
+//
+// cache - The cache.
+// block - The block.
+void sky_block_cache_remove(sky_block_cache *cache, sky_block *block)
+{
+    if(cache == NULL || block == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    sky_block_cache_entry *entry = block->cache_entry;
+    if(entry != NULL) {
+        cache->size -= entry->size;
+        cache->entry_count--;
+        sky_block_cache_unlink(cache, entry);
+        sky_block_cache_entry_free(entry);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+// Releases every held entry and evicts entries until the cache is back
+// within its capacity. This must only be called when no pointers from
+// `sky_block_cache_get()` are still in use.
+//
+// cache - The cache.
+void sky_block_cache_release(sky_block_cache *cache)
+{
+    if(cache == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    sky_block_cache_entry *entry;
+    for(entry=cache->head; entry!=NULL; entry=entry->next) {
+        entry->held = false;
+    }
+    for(entry=cache->protected_head; entry!=NULL; entry=entry->next) {
+        entry->held = false;
+    }
+    sky_block_cache_evict(cache);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+// Looks up or creates the entry for a block and marks it as most recently
+// used. An entry on probation is protected if it is read again after it was
+// unpinned and released. Blocks are decompressed without holding the lock
+// so that scan threads can decompress in parallel.
+//
+// cache - The cache.
+// block - The compressed block.
+// pin   - Whether the entry is pinned instead of held.
+// ptr   - A pointer to where the decompressed data is returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_cache_acquire(sky_block_cache *cache, sky_block *block,
+                            bool pin, void **ptr)
+{
+    int rc;
+    sky_block_cache_entry *new_entry = NULL;
+    check(cache != NULL, "Block cache required");
+    check(block != NULL, "Block required");
+
+    pthread_mutex_lock(&cache->mutex);
+    sky_block_cache_entry *entry = block->cache_entry;
+
+    // Decompress the block if it is not cached. Another thread may cache the
+    // block in the meantime, in which case its entry is used instead.
+    if(entry == NULL) {
+        pthread_mutex_unlock(&cache->mutex);
+        new_entry = calloc(1, sizeof(*new_entry)); check_mem(new_entry);
+        new_entry->size = block->data_file->block_size;
+        new_entry->data = calloc(1, new_entry->size); check_mem(new_entry->data);
+        rc = sky_block_inflate(block, new_entry->data);
+        check(rc == 0, "Unable to decompress block #%d", block->index);
+        pthread_mutex_lock(&cache->mutex);
+
+        entry = block->cache_entry;
+        if(entry == NULL) {
+            entry = new_entry;
+            new_entry = NULL;
+            entry->block = block;
+            block->cache_entry = entry;
+            cache->size += entry->size;
+            cache->entry_count++;
+        }
+        else {
+            sky_block_cache_unlink(cache, entry);
+        }
+    }
+    else {
+        sky_block_cache_unlink(cache, entry);
+        if(entry->pin_count == 0 && !entry->held) {
+            entry->promoted = true;
+        }
+    }
+
+    // Mark the entry as in use and most recently used.
+    if(pin) {
+        entry->pin_count++;
+    }
+    else if(entry->pin_count == 0) {
+        entry->held = true;
+    }
+    sky_block_cache_link(cache, entry);
+    *ptr = entry->data;
+    sky_block_cache_demote(cache);
+    sky_block_cache_evict(cache);
+    pthread_mutex_unlock(&cache->mutex);
+
+    sky_block_cache_entry_free(new_entry);
+    return 0;
+
+error:
+    sky_block_cache_entry_free(new_entry);
+    *ptr = NULL;
+    return -1;
+}
+
+// Adds an entry to the front of its recently used list.
+//
+// cache - The cache.
+// entry - The entry.
+void sky_block_cache_link(sky_block_cache *cache, sky_block_cache_entry *entry)
+{
+    sky_block_cache_entry **head = (entry->promoted ? &cache->protected_head : &cache->head);
+    sky_block_cache_entry **tail = (entry->promoted ? &cache->protected_tail : &cache->tail);
+    entry->prev = NULL;
+    entry->next = *head;
+    if(*head != NULL) {
+        (*head)->prev = entry;
+    }
+    *head = entry;
+    if(*tail == NULL) {
+        *tail = entry;
+    }
+    if(entry->promoted) {
+        cache->protected_size += entry->size;
+    }
+}
+
+// Removes an entry from its recently used list.
+//
+// cache - The cache.
+// entry - The entry.
+void sky_block_cache_unlink(sky_block_cache *cache, sky_block_cache_entry *entry)
+{
+    sky_block_cache_entry **head = (entry->promoted ? &cache->protected_head : &cache->head);
+    sky_block_cache_entry **tail = (entry->promoted ? &cache->protected_tail : &cache->tail);
+    if(entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    }
+    else if(*head == entry) {
+        *head = entry->next;
+    }
+    else {
+        return;
+    }
+    if(entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    }
+    else if(*tail == entry) {
+        *tail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+    if(entry->promoted) {
+        cache->protected_size -= entry->size;
+    }
+}
+
+// Moves the least recently used protected entries back on probation until
+// the protected entries are within their share of the capacity. The cache
+// must be locked.
+//
+// cache - The cache.
+void sky_block_cache_demote(sky_block_cache *cache)
+{
+    size_t protected_capacity = (cache->capacity / 100) * SKY_BLOCK_CACHE_PROTECTED_PERCENT;
+    while(cache->protected_tail != NULL && cache->protected_size > protected_capacity) {
+        sky_block_cache_entry *entry = cache->protected_tail;
+        sky_block_cache_unlink(cache, entry);
+        entry->promoted = false;
+        sky_block_cache_link(cache, entry);
+    }
+}
+
+// Frees the least recently used entries that are not pinned or held until
+// the cache is within its capacity. Entries on probation are evicted before
+// protected entries. The cache must be locked.
+//
+// cache - The cache.
+void sky_block_cache_evict(sky_block_cache *cache)
+{
+    sky_block_cache_evict_list(cache, cache->tail);
+    sky_block_cache_evict_list(cache, cache->protected_tail);
+}
+
+// Frees the entries of one list from its tail until the cache is within its
+// capacity. The cache must be locked.
+//
+// cache - The cache.
+// tail  - The least recently used entry of the list.
+void sky_block_cache_evict_list(sky_block_cache *cache,
+                                sky_block_cache_entry *tail)
+{
+    sky_block_cache_entry *entry = tail;
+    while(entry != NULL && cache->size > cache->capacity) {
+        sky_block_cache_entry *prev = entry->prev;
+        if(entry->pin_count == 0 && !entry->held) {
+            cache->size -= entry->size;
+            cache->entry_count--;
+            sky_block_cache_unlink(cache, entry);
+            sky_block_cache_entry_free(entry);
+        }
+        entry = prev;
+    }
+}
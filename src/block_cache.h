@@ -0,0 +1,127 @@
+#ifndef _block_cache_h
+#define _block_cache_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+typedef struct sky_block_cache sky_block_cache;
+typedef struct sky_block_cache_entry sky_block_cache_entry;
+
+#include "block.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The share of the capacity that protected entries may take up.
+#define SKY_BLOCK_CACHE_PROTECTED_PERCENT 80
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The block cache keeps the decompressed data of recently read compressed
+// blocks. Reading a compressed block through `sky_block_get_ptr()` returns a
+// pointer into its cache entry so callers read compressed and uncompressed
+// blocks the same way.
+//
+// The cache is bounded by the total size of its entries and evicts the least
+// recently used entries first. An entry is never evicted while a caller may
+// still be reading it:
+//
+// 1. Iterators scanning a data file pin the block they are on. Pinned
+//    entries are not evicted and they can be evicted as soon as they are
+//    unpinned.
+//
+// 2. Any other read holds the entry until the owner of the data file calls
+//    `sky_block_cache_release()` at a point where no pointers are
+//    outstanding, such as between requests.
+//
+// The cache can grow past its size while too many entries are pinned or
+// held and shrinks back once they are released. It is shared by the scan
+// threads of a query so it is guarded by a mutex.
+//
+// Eviction is scan resistant. The entries are kept in two recently used
+// lists. New entries start out on probation and only move to the protected
+// list once they are read again after their last reader has let go of
+// them, so a block that is pinned and then read by the same scan does not
+// count twice. Entries are evicted from probation first. A large scan
+// therefore only cycles through the probation list while the blocks of
+// tables that are queried over and over stay protected. The protected list
+// is limited to part of the capacity and its least recently used entries
+// go back on probation once it is full.
+//
+// Each data file has its own cache so the capacity is a quota per table.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+struct sky_block_cache_entry {
+    sky_block *block;
+    void *data;
+    size_t size;
+    uint32_t pin_count;
+    bool held;
+    bool promoted;
+    sky_block_cache_entry *prev;
+    sky_block_cache_entry *next;
+};
+
+struct sky_block_cache {
+    size_t capacity;
+    size_t size;
+    uint32_t entry_count;
+    sky_block_cache_entry *head;
+    sky_block_cache_entry *tail;
+    sky_block_cache_entry *protected_head;
+    sky_block_cache_entry *protected_tail;
+    size_t protected_size;
+    pthread_mutex_t mutex;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_block_cache *sky_block_cache_create(size_t capacity);
+
+void sky_block_cache_free(sky_block_cache *cache);
+
+void sky_block_cache_set_capacity(sky_block_cache *cache, size_t capacity);
+
+
+//--------------------------------------
+// Entry Management
+//--------------------------------------
+
+int sky_block_cache_get(sky_block_cache *cache, sky_block *block,
+    void **ptr);
+
+int sky_block_cache_pin(sky_block_cache *cache, sky_block *block);
+
+void sky_block_cache_unpin(sky_block_cache *cache, sky_block *block);
+
+void sky_block_cache_remove(sky_block_cache *cache, sky_block *block);
+
+void sky_block_cache_release(sky_block_cache *cache);
+
+#endif
@@ -0,0 +1,241 @@
+#include <stdlib.h>
+
+#include "block_column.h"
+#include "cursor.h"
+#include "path.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_block_column_add_path(sky_block_column *column,
+    sky_object_id_t object_id);
+
+int sky_block_column_add_event(sky_block_column *column,
+    sky_action_id_t action_id, sky_timestamp_t timestamp);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty block column.
+//
+// Returns a reference to the new block column if successful. Otherwise
+// returns null.
+sky_block_column *sky_block_column_create()
+{
+    sky_block_column *column = calloc(1, sizeof(sky_block_column));
+    check_mem(column);
+    return column;
+
+error:
+    sky_block_column_free(column);
+    return NULL;
+}
+
+// Removes a block column from memory.
+//
+// column - The block column to free.
+void sky_block_column_free(sky_block_column *column)
+{
+    if(column) {
+        free(column->action_ids);
+        free(column->timestamps);
+        free(column->object_ids);
+        free(column->path_offsets);
+        free(column);
+    }
+}
+
+
+//--------------------------------------
+// Build
+//--------------------------------------
+
+// Rebuilds the column from the raw data of a block. The arrays of the column
+// are reused so rebuilding a column only allocates when the block grows.
+//
+// column - The block column to build.
+// block  - The block to read events from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_column_build(sky_block_column *column, sky_block *block)
+{
+    int rc;
+    check(column != NULL, "Block column required");
+    check(block != NULL, "Block required");
+
+    column->event_count = 0;
+    column->path_count = 0;
+
+    // Retrieve the bounds of the block.
+    void *block_ptr = NULL;
+    rc = sky_block_get_ptr(block, &block_ptr);
+    check(rc == 0, "Unable to retrieve block pointer");
+    void *block_end_ptr = block_ptr + block->data_file->block_size;
+
+    // Loop over each path until the end of the block or until null data.
+    void *path_ptr = block_ptr;
+    while(path_ptr <= block_end_ptr - SKY_PATH_HEADER_LENGTH && *((sky_object_id_t*)path_ptr) != 0) {
+        rc = sky_block_column_add_path(column, *((sky_object_id_t*)path_ptr));
+        check(rc == 0, "Unable to add path to block column");
+
+        // Copy the action id and timestamp of each event.
+        sky_timestamp_t timestamp = 0;
+        if(block->data_file->action_only) {
+            sky_path_foreach_action_only_event(path_ptr, event_ptr) {
+                timestamp = sky_event_get_timestamp(event_ptr, timestamp);
+                rc = sky_block_column_add_event(column, sky_cursor_action_only_get_action_id(event_ptr), timestamp);
+                check(rc == 0, "Unable to add event to block column");
+            }
+        }
+        else {
+            sky_path_foreach_event(path_ptr, event_ptr) {
+                timestamp = sky_event_get_timestamp(event_ptr, timestamp);
+                rc = sky_block_column_add_event(column, sky_cursor_fast_get_action_id(event_ptr), timestamp);
+                check(rc == 0, "Unable to add event to block column");
+            }
+        }
+
+        path_ptr += sky_path_sizeof_raw(path_ptr);
+    }
+
+    // Close off the last path.
+    if(column->path_count > 0) {
+        column->path_offsets[column->path_count] = column->event_count;
+    }
+
+    return 0;
+
+error:
+    column->event_count = 0;
+    column->path_count = 0;
+    return -1;
+}
+
+// Appends an event to the end of the column. The event must belong after
+// every event in the block, either at the end of the last path or in a new
+// path after it.
+//
+// column    - The block column.
+// object_id - The object id of the event.
+// action_id - The action id of the event or zero if it has no action.
+// timestamp - The timestamp of the event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_column_append_event(sky_block_column *column,
+                                  sky_object_id_t object_id,
+                                  sky_action_id_t action_id,
+                                  sky_timestamp_t timestamp)
+{
+    int rc;
+    check(column != NULL, "Block column required");
+    check(column->path_count == 0 || column->object_ids[column->path_count-1] <= object_id, "Event must be after the last path of the column");
+
+    if(column->path_count == 0 || column->object_ids[column->path_count-1] != object_id) {
+        rc = sky_block_column_add_path(column, object_id);
+        check(rc == 0, "Unable to add path to block column");
+    }
+    rc = sky_block_column_add_event(column, action_id, timestamp);
+    check(rc == 0, "Unable to add event to block column");
+    column->path_offsets[column->path_count] = column->event_count;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Appends a path to the path table of the column. The path table always has
+// room for one more offset than there are paths so that the end of the last
+// path can be stored.
+//
+// column    - The block column.
+// object_id - The object id of the path.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_column_add_path(sky_block_column *column,
+                              sky_object_id_t object_id)
+{
+    if(column->path_count+1 >= column->path_capacity) {
+        uint32_t capacity = (column->path_capacity > 0 ? column->path_capacity * 2 : 16);
+        column->object_ids = realloc(column->object_ids, sizeof(*column->object_ids) * capacity);
+        check_mem(column->object_ids);
+        column->path_offsets = realloc(column->path_offsets, sizeof(*column->path_offsets) * capacity);
+        check_mem(column->path_offsets);
+        column->path_capacity = capacity;
+    }
+
+    column->object_ids[column->path_count] = object_id;
+    column->path_offsets[column->path_count] = column->event_count;
+    column->path_count++;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Appends an event to the event arrays of the column.
+//
+// column    - The block column.
+// action_id - The action id of the event or zero if it has no action.
+// timestamp - The timestamp of the event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_block_column_add_event(sky_block_column *column,
+                               sky_action_id_t action_id,
+                               sky_timestamp_t timestamp)
+{
+    if(column->event_count >= column->event_capacity) {
+        uint32_t capacity = (column->event_capacity > 0 ? column->event_capacity * 2 : 256);
+        column->action_ids = realloc(column->action_ids, sizeof(*column->action_ids) * capacity);
+        check_mem(column->action_ids);
+        column->timestamps = realloc(column->timestamps, sizeof(*column->timestamps) * capacity);
+        check_mem(column->timestamps);
+        column->event_capacity = capacity;
+    }
+
+    column->action_ids[column->event_count] = action_id;
+    column->timestamps[column->event_count] = timestamp;
+    column->event_count++;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+// Calculates the heap memory used by a column.
+//
+// column - The column.
+//
+// Returns the number of bytes.
+size_t sky_block_column_get_memory_usage(sky_block_column *column)
+{
+    if(column == NULL) {
+        return 0;
+    }
+
+    size_t size = sizeof(*column);
+    size += (sizeof(*column->action_ids) + sizeof(*column->timestamps)) * column->event_capacity;
+    size += (sizeof(*column->object_ids) + sizeof(*column->path_offsets)) * column->path_capacity;
+    return size;
+}
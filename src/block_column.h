@@ -0,0 +1,85 @@
+#ifndef _block_column_h
+#define _block_column_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+typedef struct sky_block_column sky_block_column;
+
+#include "bstring.h"
+#include "types.h"
+#include "block.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A block column is an in-memory sidecar to a block that stores the action id
+// and timestamp of each event in the block as dense arrays. Queries that only
+// need the action of each event can stream these arrays instead of walking
+// the row-packed events and skipping over their data.
+//
+// The path table lists the object id of each path in the block along with
+// the index of its first event in the event arrays. The events of path `i`
+// are the events from `path_offsets[i]` up to `path_offsets[i+1]`.
+//
+// Columns are optional. A block only builds its column the first time it is
+// requested and from then on the column is rebuilt whenever an event is
+// added to the block or the block is split. Events added after the last
+// event of the block are appended to the column instead. Columns are not persisted and
+// are dropped when the data file is unloaded.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+struct sky_block_column {
+    uint32_t event_count;
+    uint32_t event_capacity;
+    sky_action_id_t *action_ids;
+    sky_timestamp_t *timestamps;
+    uint32_t path_count;
+    uint32_t path_capacity;
+    sky_object_id_t *object_ids;
+    uint32_t *path_offsets;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_block_column *sky_block_column_create();
+
+void sky_block_column_free(sky_block_column *column);
+
+
+//--------------------------------------
+// Build
+//--------------------------------------
+
+int sky_block_column_build(sky_block_column *column, sky_block *block);
+
+int sky_block_column_append_event(sky_block_column *column,
+    sky_object_id_t object_id, sky_action_id_t action_id,
+    sky_timestamp_t timestamp);
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+size_t sky_block_column_get_memory_usage(sky_block_column *column);
+
+#endif
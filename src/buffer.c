@@ -0,0 +1,391 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "minipack.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The largest number of bytes that a packed header or number can take.
+#define SKY_BUFFER_MAX_ELEMENT_SIZE 9
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty buffer. No memory is allocated until the first write.
+//
+// Returns a reference to the new buffer if successful. Otherwise returns null.
+sky_buffer *sky_buffer_create()
+{
+    sky_buffer *buffer = calloc(1, sizeof(sky_buffer)); check_mem(buffer);
+    return buffer;
+
+error:
+    sky_buffer_free(buffer);
+    return NULL;
+}
+
+// Removes a buffer and its memory.
+//
+// buffer - The buffer to free.
+void sky_buffer_free(sky_buffer *buffer)
+{
+    if(buffer) {
+        free(buffer->data);
+        buffer->data = NULL;
+        free(buffer);
+    }
+}
+
+// Empties a buffer but keeps its memory for the next use.
+//
+// buffer - The buffer.
+void sky_buffer_clear(sky_buffer *buffer)
+{
+    buffer->length = 0;
+}
+
+// Empties a buffer and frees its memory. This is used to give back memory
+// after an unusually large response.
+//
+// buffer - The buffer.
+void sky_buffer_release(sky_buffer *buffer)
+{
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+
+//--------------------------------------
+// Writing
+//--------------------------------------
+
+// Makes room for bytes at the end of a buffer. The capacity is doubled
+// until the bytes fit. The caller adds the number of bytes it used to the
+// length of the buffer.
+//
+// buffer - The buffer.
+// length - The number of bytes needed.
+// ret    - A pointer to where the start of the space should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_reserve(sky_buffer *buffer, size_t length, void **ret)
+{
+    check(buffer != NULL, "Buffer required");
+
+    if(buffer->length + length > buffer->capacity) {
+        size_t capacity = (buffer->capacity > 0 ? buffer->capacity : SKY_BUFFER_INITIAL_CAPACITY);
+        while(buffer->length + length > capacity) {
+            capacity *= 2;
+        }
+        char *data = realloc(buffer->data, capacity); check_mem(data);
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+
+    *ret = buffer->data + buffer->length;
+    return 0;
+
+error:
+    *ret = NULL;
+    return -1;
+}
+
+// Appends bytes to the end of a buffer.
+//
+// buffer - The buffer.
+// data   - The bytes to append.
+// length - The number of bytes.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_write(sky_buffer *buffer, void *data, size_t length)
+{
+    void *ptr = NULL;
+    int rc = sky_buffer_reserve(buffer, length, &ptr);
+    check(rc == 0, "Unable to reserve buffer space");
+    if(length > 0) {
+        memcpy(ptr, data, length);
+    }
+    buffer->length += length;
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// MessagePack
+//--------------------------------------
+
+// Appends a MessagePack map header.
+//
+// buffer - The buffer.
+// count  - The number of key/value pairs in the map.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_pack_map(sky_buffer *buffer, uint32_t count)
+{
+    size_t sz;
+    void *ptr = NULL;
+    int rc = sky_buffer_reserve(buffer, SKY_BUFFER_MAX_ELEMENT_SIZE, &ptr);
+    check(rc == 0, "Unable to reserve buffer space");
+    minipack_pack_map(ptr, count, &sz);
+    check(sz > 0, "Unable to pack map");
+    buffer->length += sz;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Appends a MessagePack array header.
+//
+// buffer - The buffer.
+// count  - The number of elements in the array.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_pack_array(sky_buffer *buffer, uint32_t count)
+{
+    size_t sz;
+    void *ptr = NULL;
+    int rc = sky_buffer_reserve(buffer, SKY_BUFFER_MAX_ELEMENT_SIZE, &ptr);
+    check(rc == 0, "Unable to reserve buffer space");
+    minipack_pack_array(ptr, count, &sz);
+    check(sz > 0, "Unable to pack array");
+    buffer->length += sz;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Appends an unsigned integer in its smallest MessagePack encoding.
+//
+// buffer - The buffer.
+// value  - The value.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_pack_uint(sky_buffer *buffer, uint64_t value)
+{
+    size_t sz;
+    void *ptr = NULL;
+    int rc = sky_buffer_reserve(buffer, SKY_BUFFER_MAX_ELEMENT_SIZE, &ptr);
+    check(rc == 0, "Unable to reserve buffer space");
+    minipack_pack_uint(ptr, value, &sz);
+    check(sz > 0, "Unable to pack unsigned integer");
+    buffer->length += sz;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Appends a signed integer in its smallest MessagePack encoding.
+//
+// buffer - The buffer.
+// value  - The value.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_pack_int(sky_buffer *buffer, int64_t value)
+{
+    size_t sz;
+    void *ptr = NULL;
+    int rc = sky_buffer_reserve(buffer, SKY_BUFFER_MAX_ELEMENT_SIZE, &ptr);
+    check(rc == 0, "Unable to reserve buffer space");
+    minipack_pack_int(ptr, value, &sz);
+    check(sz > 0, "Unable to pack integer");
+    buffer->length += sz;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Appends a MessagePack boolean.
+//
+// buffer - The buffer.
+// value  - The value.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_pack_bool(sky_buffer *buffer, bool value)
+{
+    size_t sz;
+    void *ptr = NULL;
+    int rc = sky_buffer_reserve(buffer, SKY_BUFFER_MAX_ELEMENT_SIZE, &ptr);
+    check(rc == 0, "Unable to reserve buffer space");
+    minipack_pack_bool(ptr, value, &sz);
+    check(sz > 0, "Unable to pack boolean");
+    buffer->length += sz;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Appends a MessagePack nil.
+//
+// buffer - The buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_pack_nil(sky_buffer *buffer)
+{
+    size_t sz;
+    void *ptr = NULL;
+    int rc = sky_buffer_reserve(buffer, SKY_BUFFER_MAX_ELEMENT_SIZE, &ptr);
+    check(rc == 0, "Unable to reserve buffer space");
+    minipack_pack_nil(ptr, &sz);
+    check(sz > 0, "Unable to pack nil");
+    buffer->length += sz;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Appends a bstring as MessagePack formatted raw bytes.
+//
+// buffer - The buffer.
+// value  - The string.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_pack_bstring(sky_buffer *buffer, bstring value)
+{
+    check(value != NULL, "String required");
+    return sky_buffer_pack_raw(buffer, value->data, (uint32_t)blength(value));
+
+error:
+    return -1;
+}
+
+// Appends raw bytes with a MessagePack raw header.
+//
+// buffer - The buffer.
+// data   - The bytes to write.
+// length - The number of bytes.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_pack_raw(sky_buffer *buffer, void *data, uint32_t length)
+{
+    size_t sz;
+    void *ptr = NULL;
+    int rc = sky_buffer_reserve(buffer, SKY_BUFFER_MAX_ELEMENT_SIZE + length, &ptr);
+    check(rc == 0, "Unable to reserve buffer space");
+    minipack_pack_raw(ptr, length, &sz);
+    check(sz > 0, "Unable to pack raw header");
+    if(length > 0) {
+        memcpy(ptr + sz, data, length);
+    }
+    buffer->length += sz + length;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Appends a MessagePack raw header and makes room for its bytes so that the
+// caller can write them in place. The caller adds the length of the bytes
+// to the length of the buffer once they are written.
+//
+// buffer - The buffer.
+// length - The number of bytes.
+// ret    - A pointer to where the start of the bytes should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_reserve_raw(sky_buffer *buffer, uint32_t length, void **ret)
+{
+    size_t sz;
+    void *ptr = NULL;
+    int rc = sky_buffer_reserve(buffer, SKY_BUFFER_MAX_ELEMENT_SIZE + length, &ptr);
+    check(rc == 0, "Unable to reserve buffer space");
+    minipack_pack_raw(ptr, length, &sz);
+    check(sz > 0, "Unable to pack raw header");
+    buffer->length += sz;
+    *ret = (char*)ptr + sz;
+    return 0;
+
+error:
+    *ret = NULL;
+    return -1;
+}
+
+
+//--------------------------------------
+// Sending
+//--------------------------------------
+
+// Writes as much of a buffer to a file descriptor as it accepts and removes
+// the written bytes from the front of the buffer. Partial writes are resumed
+// until every byte has been written or a non-blocking descriptor is full, in
+// which case the rest of the bytes are left in the buffer.
+//
+// buffer - The buffer.
+// fd     - The file descriptor to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_send(sky_buffer *buffer, int fd)
+{
+    check(buffer != NULL, "Buffer required");
+
+    size_t offset = 0;
+    while(offset < buffer->length) {
+        ssize_t sz = write(fd, buffer->data + offset, buffer->length - offset);
+        if(sz < 0 && errno == EINTR) {
+            continue;
+        }
+        if(sz < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        check(sz > 0, "Unable to send buffer");
+        offset += sz;
+    }
+
+    if(offset < buffer->length) {
+        memmove(buffer->data, buffer->data + offset, buffer->length - offset);
+    }
+    buffer->length -= offset;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Passes the bytes written to a buffer to its flush function and empties
+// the buffer. Buffers without a flush function keep their bytes.
+//
+// buffer - The buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_buffer_flush(sky_buffer *buffer)
+{
+    check(buffer != NULL, "Buffer required");
+
+    if(buffer->flush != NULL && buffer->length > 0) {
+        int rc = buffer->flush(buffer, buffer->flush_data);
+        check(rc == 0, "Unable to flush buffer");
+        buffer->length = 0;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
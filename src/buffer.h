@@ -0,0 +1,123 @@
+#ifndef _buffer_h
+#define _buffer_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bstring.h"
+
+typedef struct sky_buffer sky_buffer;
+
+typedef int (*sky_buffer_flush_func)(sky_buffer *buffer, void *data);
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A buffer is a growable block of memory that a response is serialized into
+// before it is sent. Values are packed in place with the in-memory MessagePack
+// functions so building a response does not make a call into stdio for every
+// field. The whole response is then written to the socket at once. Sockets
+// are not blocking so a send can stop short once the socket is full. The
+// bytes that were not written stay in the buffer to be sent later.
+//
+// Clearing a buffer keeps its memory so a buffer that is reused for every
+// response on a connection stops allocating once it has grown to the size of
+// a typical response.
+//
+// A response that is too large to build all at once can be written as a
+// series of frames. The writer flushes the buffer after each frame. If the
+// buffer has a flush function then the bytes written so far are passed to
+// it and the buffer is emptied. Otherwise flushing does nothing and the
+// frames collect in the buffer.
+//
+// A buffer is not thread safe. It is only used by the thread that currently
+// owns its connection.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The capacity of a buffer when it first grows.
+#define SKY_BUFFER_INITIAL_CAPACITY 4096
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+struct sky_buffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+    sky_buffer_flush_func flush;
+    void *flush_data;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_buffer *sky_buffer_create();
+
+void sky_buffer_free(sky_buffer *buffer);
+
+void sky_buffer_clear(sky_buffer *buffer);
+
+void sky_buffer_release(sky_buffer *buffer);
+
+//--------------------------------------
+// Writing
+//--------------------------------------
+
+int sky_buffer_reserve(sky_buffer *buffer, size_t length, void **ret);
+
+int sky_buffer_write(sky_buffer *buffer, void *data, size_t length);
+
+//--------------------------------------
+// MessagePack
+//--------------------------------------
+
+int sky_buffer_pack_map(sky_buffer *buffer, uint32_t count);
+
+int sky_buffer_pack_array(sky_buffer *buffer, uint32_t count);
+
+int sky_buffer_pack_uint(sky_buffer *buffer, uint64_t value);
+
+int sky_buffer_pack_int(sky_buffer *buffer, int64_t value);
+
+int sky_buffer_pack_bool(sky_buffer *buffer, bool value);
+
+int sky_buffer_pack_nil(sky_buffer *buffer);
+
+int sky_buffer_pack_bstring(sky_buffer *buffer, bstring value);
+
+int sky_buffer_pack_raw(sky_buffer *buffer, void *data, uint32_t length);
+
+int sky_buffer_reserve_raw(sky_buffer *buffer, uint32_t length, void **ret);
+
+//--------------------------------------
+// Sending
+//--------------------------------------
+
+int sky_buffer_send(sky_buffer *buffer, int fd);
+
+int sky_buffer_flush(sky_buffer *buffer);
+
+#endif
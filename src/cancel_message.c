@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "types.h"
+#include "cancel_message.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+struct tagbstring SKY_CANCEL_KEY_QUERY_ID = bsStatic("queryId");
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a Cancel message object.
+//
+// Returns a new Cancel message.
+sky_cancel_message *sky_cancel_message_create()
+{
+    sky_cancel_message *message = NULL;
+    message = calloc(1, sizeof(sky_cancel_message)); check_mem(message);
+    return message;
+
+error:
+    sky_cancel_message_free(message);
+    return NULL;
+}
+
+// Frees a Cancel message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_cancel_message_free(sky_cancel_message *message)
+{
+    if(message) {
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Serializes a Cancel message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cancel_message_pack(sky_cancel_message *message, FILE *file)
+{
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    check(minipack_fwrite_map(file, 1, &sz) == 0, "Unable to pack map");
+    check(sky_minipack_fwrite_bstring(file, &SKY_CANCEL_KEY_QUERY_ID) == 0, "Unable to pack query id key");
+    check(minipack_fwrite_uint(file, message->query_id, &sz) == 0, "Unable to pack query id");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes a Cancel message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cancel_message_unpack(sky_cancel_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    bstring key = NULL;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    uint32_t map_length = minipack_fread_map(file, &sz);
+    check(sz > 0, "Unable to read map");
+
+    for(i=0; i<map_length; i++) {
+        rc = sky_minipack_fread_bstring(file, &key);
+        check(rc == 0, "Unable to read map key");
+
+        if(biseq(key, &SKY_CANCEL_KEY_QUERY_ID) == 1) {
+            message->query_id = minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack query id");
+        }
+        else {
+            sentinel("Invalid 'Cancel' key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Cancels the running queries with the id of a Cancel message.
+//
+// message - The message.
+// server  - The server that runs the queries.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cancel_message_process(sky_cancel_message *message,
+                               sky_server *server, sky_buffer *output)
+{
+    check(message != NULL, "Message required");
+    check(message->query_id > 0, "Query id required");
+    check(server != NULL, "Server required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring count_str = bsStatic("count");
+
+    uint32_t count = sky_server_cancel_queries(server, message->query_id);
+
+    // Return.
+    //   {status:"ok", count:<count>}
+    check(sky_buffer_pack_map(output, 2) == 0, "Unable to write root map");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    check(sky_buffer_pack_bstring(output, &count_str) == 0, "Unable to write count key");
+    check(sky_buffer_pack_uint(output, count) == 0, "Unable to write count");
+
+    return 0;
+
+error:
+    return -1;
+}
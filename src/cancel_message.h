@@ -0,0 +1,76 @@
+#ifndef _sky_cancel_message_h
+#define _sky_cancel_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "server.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The Cancel message stops the running queries that were sent with a given
+// query id. It is answered by the event loop as soon as it is read instead
+// of waiting behind the queries on their worker. The database and table
+// names in the header are ignored. The message is sent as a map:
+//
+//   {queryId:<int>}
+//
+// The response holds the number of running queries that were cancelled:
+//
+//   {status:"ok", count:<int>}
+//
+// A cancelled query stops before its next block and returns
+// {status:"cancelled"}. Only the queries that are running on the server
+// that receives the message are cancelled.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for cancelling running queries.
+typedef struct sky_cancel_message {
+    uint64_t query_id;
+} sky_cancel_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_cancel_message *sky_cancel_message_create();
+
+void sky_cancel_message_free(sky_cancel_message *message);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int sky_cancel_message_pack(sky_cancel_message *message, FILE *file);
+
+int sky_cancel_message_unpack(sky_cancel_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_cancel_message_process(sky_cancel_message *message,
+    sky_server *server, sky_buffer *output);
+
+#endif
@@ -0,0 +1,541 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "client.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_client_connection_connect(sky_client *client,
+    sky_client_connection *connection);
+
+void sky_client_connection_disconnect(sky_client *client,
+    sky_client_connection *connection);
+
+int sky_client_connection_receive(sky_client *client,
+    sky_client_connection *connection);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a client with the default number of connections.
+//
+// Returns a new client.
+sky_client *sky_client_create()
+{
+    int rc;
+    sky_client *client = NULL;
+    client = calloc(1, sizeof(sky_client)); check_mem(client);
+    client->max_pipelined = SKY_CLIENT_DEFAULT_MAX_PIPELINED;
+    client->batch_size = SKY_CLIENT_DEFAULT_BATCH_SIZE;
+    rc = sky_client_set_connection_count(client, SKY_CLIENT_DEFAULT_CONNECTION_COUNT);
+    check(rc == 0, "Unable to create connections");
+    return client;
+
+error:
+    sky_client_free(client);
+    return NULL;
+}
+
+// Closes the connections of a client and frees it from memory. The
+// callbacks of messages that are still in flight are run with a status of
+// -1 and events that have not been flushed are dropped.
+//
+// client - The client.
+void sky_client_free(sky_client *client)
+{
+    uint32_t i;
+    if(client) {
+        for(i=0; i<client->connection_count; i++) {
+            sky_client_connection_disconnect(client, &client->connections[i]);
+            free(client->connections[i].requests);
+        }
+        free(client->connections);
+        client->connections = NULL;
+        client->connection_count = 0;
+        if(client->batch_file != NULL) fclose(client->batch_file);
+        client->batch_file = NULL;
+        free(client->batch_data);
+        client->batch_data = NULL;
+        bdestroy(client->address);
+        bdestroy(client->database_name);
+        bdestroy(client->table_name);
+        free(client);
+    }
+}
+
+// Sets the address of the server. An address that starts with a slash is
+// the path of a Unix domain socket, otherwise it is HOST:PORT. Open
+// connections are closed.
+//
+// client  - The client.
+// address - The address of the server.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_client_set_address(sky_client *client, bstring address)
+{
+    uint32_t i;
+    check(client != NULL, "Client required");
+    check(address != NULL, "Address required");
+
+    for(i=0; i<client->connection_count; i++) {
+        sky_client_connection_disconnect(client, &client->connections[i]);
+    }
+    bdestroy(client->address);
+    client->address = bstrcpy(address); check_mem(client->address);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sets the table that messages are sent to.
+//
+// client        - The client.
+// database_name - The name of the database.
+// table_name    - The name of the table.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_client_set_table(sky_client *client, bstring database_name,
+                         bstring table_name)
+{
+    check(client != NULL, "Client required");
+    check(database_name != NULL, "Database name required");
+    check(table_name != NULL, "Table name required");
+
+    bdestroy(client->database_name);
+    client->database_name = bstrcpy(database_name); check_mem(client->database_name);
+    bdestroy(client->table_name);
+    client->table_name = bstrcpy(table_name); check_mem(client->table_name);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Changes the number of connections in the client's pool. This can only be
+// done while no messages are in flight.
+//
+// client           - The client.
+// connection_count - The number of connections.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_client_set_connection_count(sky_client *client,
+                                    uint32_t connection_count)
+{
+    uint32_t i;
+    check(client != NULL, "Client required");
+    check(connection_count > 0, "At least one connection is required");
+    check(sky_client_get_pending_count(client) == 0, "Messages are in flight");
+
+    for(i=0; i<client->connection_count; i++) {
+        sky_client_connection_disconnect(client, &client->connections[i]);
+        free(client->connections[i].requests);
+    }
+    free(client->connections);
+    client->connection_count = 0;
+
+    client->connections = calloc(connection_count, sizeof(*client->connections));
+    check_mem(client->connections);
+    for(i=0; i<connection_count; i++) {
+        client->connections[i].socket = -1;
+    }
+    client->connection_count = connection_count;
+    client->next_connection = 0;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Connections
+//--------------------------------------
+
+// Opens a connection to the server if it is not already open.
+//
+// client     - The client.
+// connection - The connection.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_client_connection_connect(sky_client *client,
+                                  sky_client_connection *connection)
+{
+    int rc;
+    int sock = -1, out = -1;
+    struct addrinfo *info = NULL;
+    bstring host = NULL;
+    check(client->address != NULL, "Server address required");
+
+    if(connection->input != NULL) {
+        return 0;
+    }
+
+    if(bchar(client->address, 0) == '/') {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        check((size_t)blength(client->address) < sizeof(addr.sun_path), "Socket path too long: %s", bdata(client->address));
+        memcpy(addr.sun_path, bdata(client->address), blength(client->address));
+
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        check(sock != -1, "Unable to create socket");
+        rc = connect(sock, (struct sockaddr*)&addr, sizeof(addr));
+        check(rc == 0, "Unable to connect to %s", bdata(client->address));
+    }
+    else {
+        int index = bstrrchr(client->address, ':');
+        check(index > 0, "Address must be HOST:PORT: %s", bdata(client->address));
+        host = bmidstr(client->address, 0, index); check_mem(host);
+
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        rc = getaddrinfo(bdata(host), bdataofs(client->address, index+1), &hints, &info);
+        check(rc == 0, "Unable to resolve %s", bdata(client->address));
+
+        sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        check(sock != -1, "Unable to create socket");
+        rc = connect(sock, info->ai_addr, info->ai_addrlen);
+        check(rc == 0, "Unable to connect to %s", bdata(client->address));
+
+        int flag = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    }
+
+    connection->input = fdopen(sock, "r");
+    check(connection->input != NULL, "Unable to open input stream");
+    connection->socket = sock;
+    out = dup(sock);
+    check(out != -1, "Unable to duplicate socket");
+    connection->output = fdopen(out, "w");
+    check(connection->output != NULL, "Unable to open output stream");
+
+    if(info) freeaddrinfo(info);
+    bdestroy(host);
+    return 0;
+
+error:
+    if(info) freeaddrinfo(info);
+    bdestroy(host);
+    if(connection->input == NULL && sock != -1) close(sock);
+    if(connection->output == NULL && out != -1) close(out);
+    sky_client_connection_disconnect(client, connection);
+    return -1;
+}
+
+// Closes a connection. The callbacks of the messages in flight on it are
+// run with a status of -1.
+//
+// client     - The client.
+// connection - The connection.
+void sky_client_connection_disconnect(sky_client *client,
+                                      sky_client_connection *connection)
+{
+    uint32_t i;
+    if(connection->input != NULL) fclose(connection->input);
+    connection->input = NULL;
+    if(connection->output != NULL) fclose(connection->output);
+    connection->output = NULL;
+    connection->socket = -1;
+
+    // The requests are cleared first in case a callback sends a message.
+    uint32_t request_count = connection->request_count;
+    sky_client_request *requests = connection->requests;
+    connection->requests = NULL;
+    connection->request_count = connection->request_capacity = 0;
+    for(i=0; i<request_count; i++) {
+        if(requests[i].callback != NULL) {
+            requests[i].callback(client, -1, NULL, requests[i].data);
+        }
+    }
+    free(requests);
+}
+
+// Reads the next response from a connection and runs the callback of its
+// message. The connection is closed if the response cannot be read.
+//
+// client     - The client.
+// connection - The connection.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_client_connection_receive(sky_client *client,
+                                  sky_client_connection *connection)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    sky_buffer *response = NULL;
+    check(connection->input != NULL, "Connection is not open");
+    check(connection->request_count > 0, "No messages are in flight");
+
+    // Pipelined responses are [<request id>, <response>].
+    uint32_t count = minipack_fread_array(connection->input, &sz);
+    check(sz > 0 && count == 2, "Unable to read response array");
+    uint64_t request_id = minipack_fread_uint(connection->input, &sz);
+    check(sz > 0, "Unable to read request id");
+    response = sky_buffer_create(); check_mem(response);
+    rc = sky_minipack_fread_elem(connection->input, response);
+    check(rc == 0, "Unable to read response");
+
+    // Responses to messages for the same table arrive in order so the
+    // oldest request is usually the one that was answered.
+    for(i=0; i<connection->request_count; i++) {
+        if(connection->requests[i].id == request_id) {
+            break;
+        }
+    }
+    check(i < connection->request_count, "Unexpected request id: %" PRIu64, request_id);
+    sky_client_request request = connection->requests[i];
+    memmove(&connection->requests[i], &connection->requests[i+1], sizeof(*connection->requests) * (connection->request_count - i - 1));
+    connection->request_count--;
+
+    if(request.callback != NULL) {
+        request.callback(client, 0, response, request.data);
+    }
+
+    sky_buffer_free(response);
+    return 0;
+
+error:
+    sky_buffer_free(response);
+    sky_client_connection_disconnect(client, connection);
+    return -1;
+}
+
+
+//--------------------------------------
+// Messaging
+//--------------------------------------
+
+// Sends a message to the client's table on the next connection of the
+// pool. The message is pipelined so this returns as soon as the message has
+// been written unless the connection already has its maximum number of
+// messages in flight, in which case responses are read until it has room.
+// The callback is only run if the message was sent.
+//
+// client   - The client.
+// type     - The type of message.
+// body     - The packed message body. This can be null for messages
+//            without a body.
+// callback - The function to run with the response. This can be null.
+// data     - The data passed to the callback.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_client_send(sky_client *client, sky_message_type_e type,
+                    sky_buffer *body, sky_client_callback callback,
+                    void *data)
+{
+    int rc;
+    sky_client_connection *connection = NULL;
+    bool writing = false;
+    check(client != NULL, "Client required");
+    check(type != SKY_MESSAGE_TYPE_UNKNOWN && type < SKY_MESSAGE_TYPE_COUNT, "Invalid message type");
+    check(client->database_name != NULL && client->table_name != NULL, "Table required");
+
+    connection = &client->connections[client->next_connection];
+    client->next_connection = (client->next_connection + 1) % client->connection_count;
+
+    rc = sky_client_connection_connect(client, connection);
+    check(rc == 0, "Unable to connect to server");
+    while(connection->request_count >= client->max_pipelined) {
+        rc = sky_client_connection_receive(client, connection);
+        check(rc == 0, "Unable to read response");
+    }
+
+    // Make room for the request before anything is written.
+    if(connection->request_count == connection->request_capacity) {
+        uint32_t capacity = (connection->request_capacity > 0 ? connection->request_capacity * 2 : 8);
+        sky_client_request *requests = realloc(connection->requests, sizeof(*requests) * capacity);
+        check_mem(requests);
+        connection->requests = requests;
+        connection->request_capacity = capacity;
+    }
+
+    struct tagbstring name;
+    btfromcstr(name, sky_message_type_get_name(type));
+    sky_message_header header;
+    memset(&header, 0, sizeof(header));
+    header.version = 1;
+    header.name = &name;
+    header.type = type;
+    header.length = (body != NULL ? body->length : 0);
+    header.database_name = client->database_name;
+    header.table_name = client->table_name;
+    header.pipelined = true;
+    header.request_id = ++client->last_request_id;
+
+    // A message that is partly written leaves the stream unusable.
+    writing = true;
+    rc = sky_message_header_pack(&header, connection->output);
+    check(rc == 0, "Unable to write message header");
+    if(body != NULL && body->length > 0) {
+        check(fwrite(body->data, body->length, 1, connection->output) == 1, "Unable to write message body");
+    }
+    check(fflush(connection->output) == 0, "Unable to send message");
+
+    sky_client_request *request = &connection->requests[connection->request_count++];
+    request->id = header.request_id;
+    request->callback = callback;
+    request->data = data;
+
+    return 0;
+
+error:
+    if(writing) sky_client_connection_disconnect(client, connection);
+    return -1;
+}
+
+// Reads the responses of every message in flight and runs their callbacks.
+// A partial batch of events is not sent. See sky_client_flush().
+//
+// client - The client.
+//
+// Returns 0 if every response was read, otherwise returns -1.
+int sky_client_wait(sky_client *client)
+{
+    uint32_t i;
+    bool success = true;
+    check(client != NULL, "Client required");
+
+    for(i=0; i<client->connection_count; i++) {
+        sky_client_connection *connection = &client->connections[i];
+        while(connection->request_count > 0) {
+            if(sky_client_connection_receive(client, connection) != 0) {
+                success = false;
+                break;
+            }
+        }
+    }
+    check(success, "Unable to read every response");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Counts the messages that are waiting for a response.
+//
+// client - The client.
+//
+// Returns the number of messages in flight.
+uint32_t sky_client_get_pending_count(sky_client *client)
+{
+    uint32_t i;
+    uint32_t count = 0;
+    for(i=0; i<client->connection_count; i++) {
+        count += client->connections[i].request_count;
+    }
+    return count;
+}
+
+
+//--------------------------------------
+// Batching
+//--------------------------------------
+
+// Adds an event to the current batch. The event is packed right away so
+// the message can be reused by the caller. The batch is sent as an EBULK
+// message once it holds the batch size of events.
+//
+// client  - The client.
+// message - The EADD message of the event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_client_add_event(sky_client *client, sky_eadd_message *message)
+{
+    int rc;
+    check(client != NULL, "Client required");
+    check(message != NULL, "Message required");
+
+    if(client->batch_file == NULL) {
+        client->batch_file = open_memstream(&client->batch_data, &client->batch_length);
+        check_mem(client->batch_file);
+    }
+    rc = sky_eadd_message_pack(message, client->batch_file);
+    check(rc == 0, "Unable to pack event");
+    client->batch_count++;
+
+    if(client->batch_count >= client->batch_size) {
+        rc = sky_client_flush(client);
+        check(rc == 0, "Unable to send batch");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sends the current batch of events. Nothing is sent if the batch is empty.
+// The batch is dropped if it cannot be sent.
+//
+// client - The client.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_client_flush(sky_client *client)
+{
+    int rc;
+    sky_buffer *body = NULL;
+    check(client != NULL, "Client required");
+
+    if(client->batch_count == 0) {
+        return 0;
+    }
+
+    // The body is an array of the packed EADD bodies.
+    check(fclose(client->batch_file) == 0, "Unable to close batch");
+    client->batch_file = NULL;
+    body = sky_buffer_create(); check_mem(body);
+    check(sky_buffer_pack_array(body, client->batch_count) == 0, "Unable to write batch array");
+    check(sky_buffer_write(body, client->batch_data, client->batch_length) == 0, "Unable to write batch");
+    free(client->batch_data);
+    client->batch_data = NULL;
+    client->batch_length = 0;
+    client->batch_count = 0;
+
+    rc = sky_client_send(client, SKY_MESSAGE_TYPE_EBULK, body, client->batch_callback, client->batch_callback_data);
+    check(rc == 0, "Unable to send batch");
+
+    sky_buffer_free(body);
+    return 0;
+
+error:
+    if(client != NULL) {
+        if(client->batch_file != NULL) fclose(client->batch_file);
+        client->batch_file = NULL;
+        free(client->batch_data);
+        client->batch_data = NULL;
+        client->batch_length = 0;
+        client->batch_count = 0;
+    }
+    sky_buffer_free(body);
+    return -1;
+}
@@ -0,0 +1,154 @@
+#ifndef _sky_client_h
+#define _sky_client_h
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+typedef struct sky_client sky_client;
+
+#include "bstring.h"
+#include "buffer.h"
+#include "types.h"
+#include "message_header.h"
+#include "eadd_message.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The client sends messages to a Sky server for one table. Messages are
+// packed with the same message code that the server uses to unpack them, so
+// every message type the server understands can be sent with its own pack
+// function.
+//
+// The client keeps a pool of connections to the server that are opened the
+// first time they are used and reopened after they fail. Every message is
+// pipelined with a request id so several messages can be in flight on each
+// connection at once. Messages are spread over the connections in turn.
+// Once a connection has its maximum number of messages in flight, the
+// oldest response is read before another message is sent on it.
+//
+// Each message can be given a callback that is run with its response when
+// the response is read. Responses are read while messages are being sent
+// and when the client waits, always on the thread that is using the client.
+// A callback is run with a status of -1 and no response if its connection
+// fails before the response arrives.
+//
+// Events that are added to the client are packed into an EBULK message
+// straight away and the message is sent once the batch is full, so a
+// producer only pays for one round trip per batch. The batch callback is
+// run with the response of each batch. A partial batch is sent when the
+// client is flushed.
+//
+// A client is not thread safe. Producers on several threads should each
+// have their own client.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+#define SKY_CLIENT_DEFAULT_CONNECTION_COUNT 4
+
+#define SKY_CLIENT_DEFAULT_MAX_PIPELINED 64
+
+#define SKY_CLIENT_DEFAULT_BATCH_SIZE 1000
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A function that is run with the response to a message. The status is 0
+// if the response was read and -1 if it was lost. The response is only
+// valid until the callback returns.
+typedef void (*sky_client_callback)(sky_client *client, int status,
+    sky_buffer *response, void *data);
+
+// A message that has been sent and is waiting for its response.
+typedef struct sky_client_request {
+    uint64_t id;
+    sky_client_callback callback;
+    void *data;
+} sky_client_request;
+
+// A connection to the server and the messages in flight on it, oldest
+// first.
+typedef struct sky_client_connection {
+    int socket;
+    FILE *input;
+    FILE *output;
+    sky_client_request *requests;
+    uint32_t request_count;
+    uint32_t request_capacity;
+} sky_client_connection;
+
+struct sky_client {
+    bstring address;
+    bstring database_name;
+    bstring table_name;
+    sky_client_connection *connections;
+    uint32_t connection_count;
+    uint32_t next_connection;
+    uint32_t max_pipelined;
+    uint64_t last_request_id;
+    uint32_t batch_size;
+    uint32_t batch_count;
+    char *batch_data;
+    size_t batch_length;
+    FILE *batch_file;
+    sky_client_callback batch_callback;
+    void *batch_callback_data;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_client *sky_client_create();
+
+void sky_client_free(sky_client *client);
+
+int sky_client_set_address(sky_client *client, bstring address);
+
+int sky_client_set_table(sky_client *client, bstring database_name,
+    bstring table_name);
+
+int sky_client_set_connection_count(sky_client *client,
+    uint32_t connection_count);
+
+//--------------------------------------
+// Messaging
+//--------------------------------------
+
+int sky_client_send(sky_client *client, sky_message_type_e type,
+    sky_buffer *body, sky_client_callback callback, void *data);
+
+int sky_client_wait(sky_client *client);
+
+uint32_t sky_client_get_pending_count(sky_client *client);
+
+//--------------------------------------
+// Batching
+//--------------------------------------
+
+int sky_client_add_event(sky_client *client, sky_eadd_message *message);
+
+int sky_client_flush(sky_client *client);
+
+#endif
@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <arpa/inet.h>
+
+#include "types.h"
+#include "compact_message.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a Compact message object.
+//
+// Returns a new Compact message.
+sky_compact_message *sky_compact_message_create()
+{
+    sky_compact_message *message = NULL;
+    message = calloc(1, sizeof(sky_compact_message)); check_mem(message);
+    return message;
+
+error:
+    sky_compact_message_free(message);
+    return NULL;
+}
+
+// Frees a Compact message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_compact_message_free(sky_compact_message *message)
+{
+    if(message) {
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Calculates the total number of bytes needed to store the message.
+//
+// message - The message.
+//
+// Returns the number of bytes required to store the message.
+size_t sky_compact_message_sizeof(sky_compact_message *message)
+{
+    size_t sz = 0;
+    sz += minipack_sizeof_uint(message->fill_factor);
+    return sz;
+}
+
+// Serializes a Compact message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_compact_message_pack(sky_compact_message *message, FILE *file)
+{
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    minipack_fwrite_uint(file, message->fill_factor, &sz);
+    check(sz > 0, "Unable to pack fill factor");
+    
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes a Compact message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_compact_message_unpack(sky_compact_message *message, FILE *file)
+{
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    message->fill_factor = (uint32_t)minipack_fread_uint(file, &sz);
+    check(sz > 0, "Unable to unpack fill factor");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Applies a Compact message to a table.
+//
+// message - The message.
+// table   - The table to apply the message to.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_compact_message_process(sky_compact_message *message,
+                                sky_table *table, sky_buffer *output)
+{
+    int rc;
+    check(message != NULL, "Message required");
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring block_count_str = bsStatic("blockCount");
+
+    // Compact the table.
+    uint32_t fill_factor = (message->fill_factor > 0 ? message->fill_factor : SKY_DATA_FILE_DEFAULT_FILL_FACTOR);
+    rc = sky_table_compact(table, fill_factor);
+    check(rc == 0, "Unable to compact table");
+
+    // Return {status:"ok", blockCount:<count>}
+    check(sky_buffer_pack_map(output, 2) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &block_count_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_uint(output, sky_table_get_block_count(table)) == 0, "Unable to write output");
+
+    return 0;
+
+error:
+    return -1;
+}
@@ -0,0 +1,72 @@
+#ifndef _sky_compact_message_h
+#define _sky_compact_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The Compact message rewrites a table's data file with its paths packed
+// densely in object id order. The message body is the fill factor, which is
+// the percentage of each block that is filled before the next block is
+// started. A fill factor of zero uses the default fill factor.
+//
+// The response lists the number of blocks after compaction:
+//
+//   {status:"ok", blockCount:0}
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for compacting a table.
+typedef struct sky_compact_message {
+    uint32_t fill_factor;
+} sky_compact_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_compact_message *sky_compact_message_create();
+
+void sky_compact_message_free(sky_compact_message *message);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+size_t sky_compact_message_sizeof(sky_compact_message *message);
+
+int sky_compact_message_pack(sky_compact_message *message, FILE *file);
+
+int sky_compact_message_unpack(sky_compact_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_compact_message_process(sky_compact_message *message,
+    sky_table *table, sky_buffer *output);
+
+#endif
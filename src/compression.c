@@ -0,0 +1,229 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "compression.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+uint8_t *sky_compression_write_length(uint8_t *ptr, size_t length);
+
+uint32_t sky_compression_hash(uint8_t *ptr);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Compression
+//--------------------------------------
+
+// Calculates the largest number of bytes that compressing data can produce.
+// This happens when the data has no matches and is stored as literals.
+//
+// length - The number of bytes to compress.
+//
+// Returns the maximum compressed length.
+size_t sky_compression_bound(size_t length)
+{
+    return length + (length / 255) + 16;
+}
+
+// Compresses data into a buffer.
+//
+// src           - The data to compress.
+// src_length    - The number of bytes to compress.
+// dest          - The buffer to write the compressed data to.
+// dest_capacity - The size of the buffer.
+// dest_length   - A pointer to where the compressed length is returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_compression_compress(void *src, size_t src_length, void *dest,
+                             size_t dest_capacity, size_t *dest_length)
+{
+    check(src != NULL || src_length == 0, "Source required");
+    check(dest != NULL, "Destination required");
+    check(dest_length != NULL, "Destination length return address required");
+    check(dest_capacity >= sky_compression_bound(src_length), "Destination buffer too small");
+
+    uint8_t *ip = src;
+    uint8_t *anchor = src;
+    uint8_t *end = ip + src_length;
+    uint8_t *op = dest;
+    uint32_t table[1 << SKY_COMPRESSION_HASH_BITS];
+    memset(table, 0xFF, sizeof(table));
+
+    // Find matches. The last bytes are always stored as literals so
+    // matching never reads past the end of the source.
+    uint8_t *match_limit = (src_length > SKY_COMPRESSION_MIN_MATCH ? end - SKY_COMPRESSION_MIN_MATCH : (uint8_t*)src);
+    while(ip < match_limit) {
+        uint32_t hash = sky_compression_hash(ip);
+        uint32_t candidate = table[hash];
+        table[hash] = (uint32_t)(ip - (uint8_t*)src);
+
+        uint8_t *ref = (uint8_t*)src + candidate;
+        if(candidate == UINT32_MAX || (size_t)(ip - ref) > SKY_COMPRESSION_MAX_OFFSET || memcmp(ip, ref, SKY_COMPRESSION_MIN_MATCH) != 0) {
+            ip++;
+            continue;
+        }
+
+        // Extend the match.
+        size_t match_length = SKY_COMPRESSION_MIN_MATCH;
+        while(ip + match_length < end && ip[match_length] == ref[match_length]) {
+            match_length++;
+        }
+
+        // Write the token, the literals and the match.
+        size_t literal_length = (size_t)(ip - anchor);
+        size_t extra_length = match_length - SKY_COMPRESSION_MIN_MATCH;
+        uint8_t *token = op++;
+        *token = (uint8_t)(((literal_length < 15 ? literal_length : 15) << 4) | (extra_length < 15 ? extra_length : 15));
+        if(literal_length >= 15) {
+            op = sky_compression_write_length(op, literal_length - 15);
+        }
+        memcpy(op, anchor, literal_length);
+        op += literal_length;
+        uint16_t offset = (uint16_t)(ip - ref);
+        *op++ = (uint8_t)(offset & 0xFF);
+        *op++ = (uint8_t)(offset >> 8);
+        if(extra_length >= 15) {
+            op = sky_compression_write_length(op, extra_length - 15);
+        }
+
+        ip += match_length;
+        anchor = ip;
+    }
+
+    // Write the remaining bytes as literals.
+    size_t literal_length = (size_t)(end - anchor);
+    *op++ = (uint8_t)((literal_length < 15 ? literal_length : 15) << 4);
+    if(literal_length >= 15) {
+        op = sky_compression_write_length(op, literal_length - 15);
+    }
+    memcpy(op, anchor, literal_length);
+    op += literal_length;
+
+    *dest_length = (size_t)(op - (uint8_t*)dest);
+    return 0;
+
+error:
+    if(dest_length != NULL) *dest_length = 0;
+    return -1;
+}
+
+// Writes the part of a length that does not fit in a token nibble.
+//
+// ptr    - The location to write to.
+// length - The remaining length.
+//
+// Returns the location after the length.
+uint8_t *sky_compression_write_length(uint8_t *ptr, size_t length)
+{
+    while(length >= 255) {
+        *ptr++ = 255;
+        length -= 255;
+    }
+    *ptr++ = (uint8_t)length;
+    return ptr;
+}
+
+// Hashes the next four bytes of the source.
+//
+// ptr - The location of the bytes.
+//
+// Returns the hash table slot for the bytes.
+uint32_t sky_compression_hash(uint8_t *ptr)
+{
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return (value * 2654435761U) >> (32 - SKY_COMPRESSION_HASH_BITS);
+}
+
+
+//--------------------------------------
+// Decompression
+//--------------------------------------
+
+// Decompresses data into a buffer. The compressed data is validated as it is
+// read so corrupt data returns an error instead of writing out of bounds.
+//
+// src         - The compressed data.
+// src_length  - The number of compressed bytes.
+// dest        - The buffer to write the data to.
+// dest_length - The number of bytes that the data decompresses to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_compression_decompress(void *src, size_t src_length, void *dest,
+                               size_t dest_length)
+{
+    check(src != NULL, "Source required");
+    check(dest != NULL || dest_length == 0, "Destination required");
+
+    uint8_t *ip = src;
+    uint8_t *ip_end = ip + src_length;
+    uint8_t *op = dest;
+    uint8_t *op_end = op + dest_length;
+
+    while(ip < ip_end) {
+        uint8_t token = *ip++;
+
+        // Copy the literals.
+        size_t literal_length = token >> 4;
+        if(literal_length == 15) {
+            uint8_t b;
+            do {
+                check(ip < ip_end, "Compressed data is truncated");
+                b = *ip++;
+                literal_length += b;
+            } while(b == 255);
+        }
+        check((size_t)(ip_end - ip) >= literal_length, "Compressed data is truncated");
+        check((size_t)(op_end - op) >= literal_length, "Compressed data is too long");
+        memcpy(op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        // The last sequence has no match.
+        if(ip == ip_end) {
+            break;
+        }
+
+        // Copy the match. Matches can overlap their own output so they are
+        // copied a byte at a time.
+        check(ip_end - ip >= 2, "Compressed data is truncated");
+        size_t offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        check(offset > 0 && offset <= (size_t)(op - (uint8_t*)dest), "Invalid match offset");
+        size_t match_length = token & 0x0F;
+        if(match_length == 15) {
+            uint8_t b;
+            do {
+                check(ip < ip_end, "Compressed data is truncated");
+                b = *ip++;
+                match_length += b;
+            } while(b == 255);
+        }
+        match_length += SKY_COMPRESSION_MIN_MATCH;
+        check((size_t)(op_end - op) >= match_length, "Compressed data is too long");
+        uint8_t *ref = op - offset;
+        size_t i;
+        for(i=0; i<match_length; i++) {
+            op[i] = ref[i];
+        }
+        op += match_length;
+    }
+    check(op == op_end, "Compressed data is too short");
+
+    return 0;
+
+error:
+    return -1;
+}
@@ -0,0 +1,60 @@
+#ifndef _compression_h
+#define _compression_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The compression functions implement a small LZ77 codec for compressing
+// block data. It is byte oriented and only uses a hash table of recent
+// positions to find matches so it compresses and decompresses at memory
+// speed. It works best on the repeated property keys and string values of
+// event data.
+//
+// The compressed data is a series of sequences. Each sequence starts with a
+// token byte where the high nibble is the number of literal bytes and the
+// low nibble is the match length minus the minimum match length. A nibble of
+// 15 means that the length continues in the following bytes, which are
+// added to it until a byte that is less than 255. The literals follow the
+// token and then a two byte little endian offset back to the start of the
+// match. The last sequence only has literals.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The shortest match that is encoded.
+#define SKY_COMPRESSION_MIN_MATCH 4
+
+// The furthest back that a match can start.
+#define SKY_COMPRESSION_MAX_OFFSET 65535
+
+// The number of bits in the position hash table.
+#define SKY_COMPRESSION_HASH_BITS 12
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+size_t sky_compression_bound(size_t length);
+
+int sky_compression_compress(void *src, size_t src_length, void *dest,
+    size_t dest_capacity, size_t *dest_length);
+
+int sky_compression_decompress(void *src, size_t src_length, void *dest,
+    size_t dest_length);
+
+#endif
@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "continuous_query.h"
+#include "path.h"
+#include "cursor.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a continuous query with an empty result for a list of prior
+// actions.
+//
+// prior_action_ids      - The actions that precede the counted action.
+// prior_action_id_count - The number of prior actions.
+//
+// Returns a reference to the new continuous query if successful. Otherwise
+// returns null.
+sky_continuous_query *sky_continuous_query_create(sky_action_id_t *prior_action_ids,
+                                                  uint32_t prior_action_id_count)
+{
+    int rc;
+    struct tagbstring count_str = bsStatic("count");
+    sky_continuous_query *continuous_query = NULL;
+    check(prior_action_id_count > 0, "Prior actions must be specified");
+
+    continuous_query = calloc(1, sizeof(sky_continuous_query)); check_mem(continuous_query);
+    continuous_query->query = sky_query_create(); check_mem(continuous_query->query);
+    rc = sky_query_set_sequence(continuous_query->query, prior_action_ids, prior_action_id_count);
+    check(rc == 0, "Unable to set query sequence");
+    rc = sky_query_set_group_by(continuous_query->query, SKY_QUERY_FIELD_ACTION, 0);
+    check(rc == 0, "Unable to set query group by");
+    rc = sky_query_add_aggregate(continuous_query->query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    check(rc == 0, "Unable to add query aggregate");
+
+    continuous_query->result = sky_query_result_create(continuous_query->query);
+    check_mem(continuous_query->result);
+
+    return continuous_query;
+
+error:
+    sky_continuous_query_free(continuous_query);
+    return NULL;
+}
+
+// Removes a continuous query and its result from memory.
+//
+// continuous_query - The continuous query.
+void sky_continuous_query_free(sky_continuous_query *continuous_query)
+{
+    if(continuous_query) {
+        sky_query_result_free(continuous_query->result);
+        continuous_query->result = NULL;
+        sky_query_free(continuous_query->query);
+        continuous_query->query = NULL;
+        free(continuous_query);
+    }
+}
+
+
+//--------------------------------------
+// Matching
+//--------------------------------------
+
+// Checks if a continuous query counts the next actions of a list of prior
+// actions.
+//
+// continuous_query      - The continuous query.
+// prior_action_ids      - The prior actions.
+// prior_action_id_count - The number of prior actions.
+//
+// Returns true if the prior actions are the same.
+bool sky_continuous_query_matches(sky_continuous_query *continuous_query,
+                                  sky_action_id_t *prior_action_ids,
+                                  uint32_t prior_action_id_count)
+{
+    sky_query *query = continuous_query->query;
+    return (query->sequence_length == prior_action_id_count &&
+        memcmp(query->sequence, prior_action_ids, sizeof(*prior_action_ids) * prior_action_id_count) == 0);
+}
+
+
+//--------------------------------------
+// Maintenance
+//--------------------------------------
+
+// Replaces the result of a continuous query with a full scan of a data file.
+//
+// continuous_query - The continuous query.
+// data_file        - The data file to scan.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_continuous_query_execute(sky_continuous_query *continuous_query,
+                                 sky_data_file *data_file)
+{
+    int rc;
+    sky_query_result *result = NULL;
+    check(continuous_query != NULL, "Continuous query required");
+    check(data_file != NULL, "Data file required");
+
+    result = sky_query_result_create(continuous_query->query); check_mem(result);
+    rc = sky_query_execute(continuous_query->query, data_file, result);
+    check(rc == 0, "Unable to execute continuous query");
+
+    sky_query_result_free(continuous_query->result);
+    continuous_query->result = result;
+    return 0;
+
+error:
+    sky_query_result_free(result);
+    return -1;
+}
+
+// Replaces the result of a continuous query with a full scan of every shard
+// in a shard set.
+//
+// continuous_query - The continuous query.
+// shard_set        - The shard set to scan.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_continuous_query_execute_shard_set(sky_continuous_query *continuous_query,
+                                           sky_shard_set *shard_set)
+{
+    int rc;
+    sky_query_result *result = NULL;
+    check(continuous_query != NULL, "Continuous query required");
+    check(shard_set != NULL, "Shard set required");
+
+    result = sky_query_result_create(continuous_query->query); check_mem(result);
+    rc = sky_shard_set_execute_query(shard_set, continuous_query->query, result);
+    check(rc == 0, "Unable to execute continuous query");
+
+    sky_query_result_free(continuous_query->result);
+    continuous_query->result = result;
+    return 0;
+
+error:
+    sky_query_result_free(result);
+    return -1;
+}
+
+// Replaces the result of a continuous query with a full scan of every
+// partition in a partition set.
+//
+// continuous_query - The continuous query.
+// partition_set    - The partition set to scan.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_continuous_query_execute_partition_set(sky_continuous_query *continuous_query,
+                                               sky_partition_set *partition_set)
+{
+    int rc;
+    sky_query_result *result = NULL;
+    check(continuous_query != NULL, "Continuous query required");
+    check(partition_set != NULL, "Partition set required");
+
+    result = sky_query_result_create(continuous_query->query); check_mem(result);
+    rc = sky_query_execute_partition_set(continuous_query->query, partition_set, result);
+    check(rc == 0, "Unable to execute continuous query");
+
+    sky_query_result_free(continuous_query->result);
+    continuous_query->result = result;
+    return 0;
+
+error:
+    sky_query_result_free(result);
+    return -1;
+}
+
+// Adds the counts of a single object's path to the result or subtracts them
+// from it. The sequence is matched the same way as a full scan matches it
+// so that subtracting a path and adding its new version keeps the result
+// equal to a full scan. Groups that drop to zero are removed.
+//
+// continuous_query - The continuous query.
+// paths            - The parts of the object's path in order.
+// path_count       - The number of parts.
+// sign             - 1 to add the counts or -1 to subtract them.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_continuous_query_update(sky_continuous_query *continuous_query,
+                                void **paths, uint32_t path_count,
+                                int64_t sign)
+{
+    int rc;
+    uint32_t i;
+    bool changed = false;
+    check(continuous_query != NULL, "Continuous query required");
+    check(paths != NULL || path_count == 0, "Paths required");
+
+    sky_query *query = continuous_query->query;
+    uint32_t sequence_index = 0;
+    for(i=0; i<path_count; i++) {
+        sky_path_foreach_event(paths[i], event_ptr) {
+            sky_action_id_t action_id = sky_cursor_fast_get_action_id(event_ptr);
+            bool matched = (sequence_index == query->sequence_length);
+            if(matched) {
+                sequence_index = 0;
+            }
+            if(query->sequence[sequence_index] == action_id) {
+                sequence_index++;
+            }
+            else {
+                sequence_index = 0;
+            }
+
+            if(matched) {
+                int64_t *values = NULL;
+                rc = sky_query_result_get_values(continuous_query->result, action_id, &values);
+                check(rc == 0, "Unable to retrieve group values");
+                values[0] += sign;
+                changed = true;
+            }
+        }
+    }
+
+    if(changed && sign < 0) {
+        sky_query_result_remove_empty_groups(continuous_query->result);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
@@ -0,0 +1,86 @@
+#ifndef _sky_continuous_query_h
+#define _sky_continuous_query_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "types.h"
+#include "query.h"
+#include "data_file.h"
+#include "shard_set.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A continuous query is a 'Next Action' query that is registered on a table
+// and whose result is kept up to date as events are inserted so that it can
+// be served without scanning the table.
+//
+// The result is seeded with a full scan when the query is registered. After
+// that, every insert into the data file subtracts the counts of the object's
+// path before the event is added and adds them back once it has been added.
+// Only the path of the changed object is read so the cost of an insert is
+// proportional to the length of its path, and events inserted out of order
+// are counted the same as they would be by a full scan.
+//
+// Continuous queries are kept in memory and are not persisted with the
+// table.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A registered 'Next Action' query. The query matches the prior actions as
+// a sequence and counts the next actions grouped by action id.
+typedef struct sky_continuous_query {
+    sky_query *query;
+    sky_query_result *result;
+} sky_continuous_query;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_continuous_query *sky_continuous_query_create(
+    sky_action_id_t *prior_action_ids, uint32_t prior_action_id_count);
+
+void sky_continuous_query_free(sky_continuous_query *continuous_query);
+
+//--------------------------------------
+// Matching
+//--------------------------------------
+
+bool sky_continuous_query_matches(sky_continuous_query *continuous_query,
+    sky_action_id_t *prior_action_ids, uint32_t prior_action_id_count);
+
+//--------------------------------------
+// Maintenance
+//--------------------------------------
+
+int sky_continuous_query_execute(sky_continuous_query *continuous_query,
+    sky_data_file *data_file);
+
+int sky_continuous_query_execute_shard_set(
+    sky_continuous_query *continuous_query, sky_shard_set *shard_set);
+
+int sky_continuous_query_execute_partition_set(
+    sky_continuous_query *continuous_query, sky_partition_set *partition_set);
+
+int sky_continuous_query_update(sky_continuous_query *continuous_query,
+    void **paths, uint32_t path_count, int64_t sign);
+
+#endif
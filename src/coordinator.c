@@ -0,0 +1,845 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "coordinator.h"
+#include "server.h"
+#include "eadd_message.h"
+#include "eget_message.h"
+#include "query_message.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_coordinator_node_connect(sky_coordinator_node *node);
+
+void sky_coordinator_node_disconnect(sky_coordinator_node *node);
+
+int sky_coordinator_send(sky_coordinator *coordinator, uint32_t index,
+    sky_message_header *header, sky_buffer *body);
+
+int sky_coordinator_receive(sky_coordinator *coordinator, uint32_t index,
+    sky_buffer *response);
+
+int sky_coordinator_broadcast(sky_coordinator *coordinator,
+    sky_message_header *header, sky_buffer **bodies, bool merge,
+    sky_buffer *output);
+
+int sky_coordinator_get_object_id(sky_message_header *header,
+    sky_buffer *body, sky_object_id_t *object_id);
+
+int sky_coordinator_split_ebulk(sky_coordinator *coordinator,
+    sky_buffer *body, sky_buffer **bodies);
+
+int sky_coordinator_check_query(sky_buffer *body);
+
+bool sky_coordinator_is_int(uint8_t type);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a coordinator without any nodes.
+//
+// Returns a reference to the new coordinator if successful. Otherwise
+// returns null.
+sky_coordinator *sky_coordinator_create()
+{
+    sky_coordinator *coordinator = calloc(1, sizeof(sky_coordinator));
+    check_mem(coordinator);
+    return coordinator;
+
+error:
+    sky_coordinator_free(coordinator);
+    return NULL;
+}
+
+// Closes the connections of a coordinator and removes it from memory.
+//
+// coordinator - The coordinator.
+void sky_coordinator_free(sky_coordinator *coordinator)
+{
+    if(coordinator) {
+        uint32_t i;
+        for(i=0; i<coordinator->node_count; i++) {
+            sky_coordinator_node_disconnect(&coordinator->nodes[i]);
+            bdestroy(coordinator->nodes[i].address);
+        }
+        free(coordinator->nodes);
+        coordinator->nodes = NULL;
+        coordinator->node_count = 0;
+        free(coordinator);
+    }
+}
+
+// Adds a backend node to the coordinator. The node is connected to when the
+// first message is sent to it. Nodes must be added in the same order on
+// every coordinator since the order determines which node owns an object.
+//
+// coordinator - The coordinator.
+// address     - The HOST:PORT or Unix socket path of the node.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_add_node(sky_coordinator *coordinator, bstring address)
+{
+    check(coordinator != NULL, "Coordinator required");
+    check(address != NULL, "Address required");
+
+    coordinator->nodes = realloc(coordinator->nodes, sizeof(*coordinator->nodes) * (coordinator->node_count+1));
+    check_mem(coordinator->nodes);
+    sky_coordinator_node *node = &coordinator->nodes[coordinator->node_count];
+    memset(node, 0, sizeof(*node));
+    node->socket = -1;
+    node->address = bstrcpy(address); check_mem(node->address);
+    coordinator->node_count++;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Connections
+//--------------------------------------
+
+// Opens the connection to a node if it is not already open. An address that
+// starts with a slash is the path of a Unix domain socket, otherwise it is
+// HOST:PORT.
+//
+// node - The node.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_node_connect(sky_coordinator_node *node)
+{
+    int rc;
+    int sock = -1, out = -1;
+    struct addrinfo *info = NULL;
+    bstring host = NULL;
+
+    if(node->input != NULL) {
+        return 0;
+    }
+
+    if(bchar(node->address, 0) == '/') {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        check((size_t)blength(node->address) < sizeof(addr.sun_path), "Socket path too long: %s", bdata(node->address));
+        memcpy(addr.sun_path, bdata(node->address), blength(node->address));
+
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        check(sock != -1, "Unable to create socket");
+        rc = connect(sock, (struct sockaddr*)&addr, sizeof(addr));
+        check(rc == 0, "Unable to connect to %s", bdata(node->address));
+    }
+    else {
+        int index = bstrrchr(node->address, ':');
+        check(index > 0, "Address must be HOST:PORT: %s", bdata(node->address));
+        host = bmidstr(node->address, 0, index); check_mem(host);
+
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        rc = getaddrinfo(bdata(host), bdataofs(node->address, index+1), &hints, &info);
+        check(rc == 0, "Unable to resolve %s", bdata(node->address));
+
+        sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        check(sock != -1, "Unable to create socket");
+        rc = connect(sock, info->ai_addr, info->ai_addrlen);
+        check(rc == 0, "Unable to connect to %s", bdata(node->address));
+
+        int flag = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    }
+
+    node->input = fdopen(sock, "r");
+    check(node->input != NULL, "Unable to open input stream");
+    node->socket = sock;
+    out = dup(sock);
+    check(out != -1, "Unable to duplicate socket");
+    node->output = fdopen(out, "w");
+    check(node->output != NULL, "Unable to open output stream");
+
+    if(info) freeaddrinfo(info);
+    bdestroy(host);
+    return 0;
+
+error:
+    if(info) freeaddrinfo(info);
+    bdestroy(host);
+    if(node->input == NULL && sock != -1) close(sock);
+    if(node->output == NULL && out != -1) close(out);
+    sky_coordinator_node_disconnect(node);
+    return -1;
+}
+
+// Closes the connection to a node.
+//
+// node - The node.
+void sky_coordinator_node_disconnect(sky_coordinator_node *node)
+{
+    if(node->input != NULL) fclose(node->input);
+    node->input = NULL;
+    if(node->output != NULL) fclose(node->output);
+    node->output = NULL;
+    node->socket = -1;
+}
+
+// Sends a message to a node. The message is sent without a request id so
+// the node answers it in order.
+//
+// coordinator - The coordinator.
+// index       - The index of the node.
+// header      - The header of the message.
+// body        - The body of the message.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_send(sky_coordinator *coordinator, uint32_t index,
+                         sky_message_header *header, sky_buffer *body)
+{
+    int rc;
+    sky_coordinator_node *node = &coordinator->nodes[index];
+
+    rc = sky_coordinator_node_connect(node);
+    check(rc == 0, "Unable to connect to node: %s", bdata(node->address));
+
+    sky_message_header forward = *header;
+    forward.pipelined = false;
+    forward.request_id = 0;
+    forward.length = body->length;
+    rc = sky_message_header_pack(&forward, node->output);
+    check(rc == 0, "Unable to send message header to node: %s", bdata(node->address));
+    if(body->length > 0) {
+        check(fwrite(body->data, body->length, 1, node->output) == 1, "Unable to send message body to node: %s", bdata(node->address));
+    }
+    check(fflush(node->output) == 0, "Unable to send message to node: %s", bdata(node->address));
+
+    return 0;
+
+error:
+    sky_coordinator_node_disconnect(node);
+    return -1;
+}
+
+// Reads the response to the last message sent to a node.
+//
+// coordinator - The coordinator.
+// index       - The index of the node.
+// response    - The buffer to append the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_receive(sky_coordinator *coordinator, uint32_t index,
+                            sky_buffer *response)
+{
+    int rc;
+    sky_coordinator_node *node = &coordinator->nodes[index];
+    check(node->input != NULL, "Node is not connected: %s", bdata(node->address));
+
+    rc = sky_minipack_fread_elem(node->input, response);
+    check(rc == 0, "Unable to read response from node: %s", bdata(node->address));
+
+    return 0;
+
+error:
+    sky_coordinator_node_disconnect(node);
+    return -1;
+}
+
+
+//--------------------------------------
+// Routing
+//--------------------------------------
+
+// Determines the node that owns an object. The object id is mixed with the
+// finalizer of MurmurHash3 so that sequential ids are spread evenly.
+//
+// coordinator - The coordinator.
+// object_id   - The object id.
+//
+// Returns the index of the node.
+uint32_t sky_coordinator_get_node_index(sky_coordinator *coordinator,
+                                        sky_object_id_t object_id)
+{
+    uint64_t hash = object_id;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return (uint32_t)(hash % coordinator->node_count);
+}
+
+// Routes a message to the nodes that hold the shards of its table and
+// writes the combined response. See the overview for how each type of
+// message is routed.
+//
+// coordinator - The coordinator.
+// header      - The message header.
+// input       - The input stream to read the message body from.
+// output      - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_process_message(sky_coordinator *coordinator,
+                                    sky_message_header *header, FILE *input,
+                                    sky_buffer *output)
+{
+    int rc;
+    uint32_t i;
+    sky_buffer *body = NULL;
+    sky_buffer **bodies = NULL;
+    check(coordinator != NULL, "Coordinator required");
+    check(coordinator->node_count > 0, "Coordinator has no nodes");
+    check(header != NULL, "Message header required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+
+    body = sky_buffer_create(); check_mem(body);
+    if(sky_server_message_has_body(header)) {
+        rc = sky_minipack_fread_elem(input, body);
+        check(rc == 0, "Unable to read message body");
+    }
+
+    bodies = calloc(coordinator->node_count, sizeof(*bodies)); check_mem(bodies);
+
+    switch(header->type) {
+        case SKY_MESSAGE_TYPE_EADD:
+        case SKY_MESSAGE_TYPE_EGET: {
+            sky_object_id_t object_id = 0;
+            rc = sky_coordinator_get_object_id(header, body, &object_id);
+            check(rc == 0, "Unable to read object id");
+            rc = sky_coordinator_route(coordinator, sky_coordinator_get_node_index(coordinator, object_id), header, body, output);
+            break;
+        }
+        case SKY_MESSAGE_TYPE_EBULK: {
+            rc = sky_coordinator_split_ebulk(coordinator, body, bodies);
+            check(rc == 0, "Unable to split EBULK message");
+            rc = sky_coordinator_broadcast(coordinator, header, bodies, true, output);
+            break;
+        }
+        case SKY_MESSAGE_TYPE_QUERY: {
+            rc = sky_coordinator_check_query(body);
+            check(rc == 0, "Unable to coordinate query");
+            for(i=0; i<coordinator->node_count; i++) bodies[i] = body;
+            rc = sky_coordinator_broadcast(coordinator, header, bodies, true, output);
+            break;
+        }
+        case SKY_MESSAGE_TYPE_NEXT_ACTION:
+        case SKY_MESSAGE_TYPE_FUNNEL:
+        case SKY_MESSAGE_TYPE_DAG: {
+            for(i=0; i<coordinator->node_count; i++) bodies[i] = body;
+            rc = sky_coordinator_broadcast(coordinator, header, bodies, true, output);
+            break;
+        }
+        case SKY_MESSAGE_TYPE_AADD:
+        case SKY_MESSAGE_TYPE_PADD:
+        case SKY_MESSAGE_TYPE_COMPACT: {
+            for(i=0; i<coordinator->node_count; i++) bodies[i] = body;
+            rc = sky_coordinator_broadcast(coordinator, header, bodies, false, output);
+            break;
+        }
+        case SKY_MESSAGE_TYPE_AGET:
+        case SKY_MESSAGE_TYPE_AALL:
+        case SKY_MESSAGE_TYPE_PGET:
+        case SKY_MESSAGE_TYPE_PALL: {
+            rc = sky_coordinator_route(coordinator, 0, header, body, output);
+            break;
+        }
+        default:
+            sentinel("Message type cannot be coordinated: %s", bdata(header->name));
+    }
+    check(rc == 0, "Unable to coordinate message: %s", bdata(header->name));
+
+    if(header->type == SKY_MESSAGE_TYPE_EBULK) {
+        for(i=0; i<coordinator->node_count; i++) sky_buffer_free(bodies[i]);
+    }
+    free(bodies);
+    sky_buffer_free(body);
+    return 0;
+
+error:
+    if(bodies && header->type == SKY_MESSAGE_TYPE_EBULK) {
+        for(i=0; i<coordinator->node_count; i++) sky_buffer_free(bodies[i]);
+    }
+    free(bodies);
+    sky_buffer_free(body);
+    return -1;
+}
+
+// Sends a message to a single node and copies its response.
+//
+// coordinator - The coordinator.
+// index       - The index of the node.
+// header      - The message header.
+// body        - The message body.
+// output      - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_route(sky_coordinator *coordinator, uint32_t index,
+                          sky_message_header *header, sky_buffer *body,
+                          sky_buffer *output)
+{
+    int rc;
+    rc = sky_coordinator_send(coordinator, index, header, body);
+    check(rc == 0, "Unable to send message");
+    rc = sky_coordinator_receive(coordinator, index, output);
+    check(rc == 0, "Unable to receive response");
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sends a message to every node. The message is sent to all of the nodes
+// before any response is read so that the nodes work in parallel. The
+// responses are either merged or the first node's response is returned.
+// Every connection is closed if any node fails.
+//
+// coordinator - The coordinator.
+// header      - The message header.
+// bodies      - The body to send to each node.
+// merge       - Whether the responses are merged.
+// output      - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_broadcast(sky_coordinator *coordinator,
+                              sky_message_header *header, sky_buffer **bodies,
+                              bool merge, sky_buffer *output)
+{
+    int rc;
+    uint32_t i;
+    FILE *file = NULL;
+    sky_buffer *response = NULL;
+    sky_coordinator_elem *result = NULL;
+    sky_coordinator_elem *elem = NULL;
+
+    for(i=0; i<coordinator->node_count; i++) {
+        rc = sky_coordinator_send(coordinator, i, header, bodies[i]);
+        check(rc == 0, "Unable to send message");
+    }
+
+    response = sky_buffer_create(); check_mem(response);
+    for(i=0; i<coordinator->node_count; i++) {
+        sky_buffer_clear(response);
+        rc = sky_coordinator_receive(coordinator, i, response);
+        check(rc == 0, "Unable to receive response");
+
+        if(!merge) {
+            if(i == 0) {
+                rc = sky_buffer_write(output, response->data, response->length);
+                check(rc == 0, "Unable to write response");
+            }
+            continue;
+        }
+
+        file = fmemopen(response->data, response->length, "r");
+        check(file != NULL, "Unable to open response");
+        elem = sky_coordinator_elem_create(); check_mem(elem);
+        rc = sky_coordinator_elem_unpack(elem, file);
+        check(rc == 0, "Unable to parse response");
+        fclose(file);
+        file = NULL;
+
+        if(result == NULL) {
+            result = elem;
+        }
+        else {
+            rc = sky_coordinator_elem_merge(result, elem);
+            check(rc == 0, "Unable to merge response");
+            sky_coordinator_elem_free(elem);
+        }
+        elem = NULL;
+    }
+
+    if(merge) {
+        rc = sky_coordinator_elem_pack(result, output);
+        check(rc == 0, "Unable to write merged response");
+    }
+
+    sky_coordinator_elem_free(result);
+    sky_buffer_free(response);
+    return 0;
+
+error:
+    // Responses that were not read would be mistaken for the responses to
+    // later messages so every connection is reopened.
+    for(i=0; i<coordinator->node_count; i++) {
+        sky_coordinator_node_disconnect(&coordinator->nodes[i]);
+    }
+    if(file) fclose(file);
+    sky_coordinator_elem_free(elem);
+    sky_coordinator_elem_free(result);
+    sky_buffer_free(response);
+    return -1;
+}
+
+// Reads the object id of an EADD or EGET message.
+//
+// header    - The message header.
+// body      - The message body.
+// object_id - A pointer to where the object id should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_get_object_id(sky_message_header *header,
+                                  sky_buffer *body,
+                                  sky_object_id_t *object_id)
+{
+    int rc;
+    FILE *file = NULL;
+    sky_eadd_message *eadd_message = NULL;
+    sky_eget_message *eget_message = NULL;
+    check(body->length > 0, "Message body required");
+
+    file = fmemopen(body->data, body->length, "r");
+    check(file != NULL, "Unable to open message body");
+    if(header->type == SKY_MESSAGE_TYPE_EADD) {
+        eadd_message = sky_eadd_message_create(); check_mem(eadd_message);
+        rc = sky_eadd_message_unpack(eadd_message, file);
+        check(rc == 0, "Unable to parse EADD message");
+        *object_id = eadd_message->object_id;
+    }
+    else {
+        eget_message = sky_eget_message_create(); check_mem(eget_message);
+        rc = sky_eget_message_unpack(eget_message, file);
+        check(rc == 0, "Unable to parse EGET message");
+        *object_id = eget_message->object_id;
+    }
+
+    fclose(file);
+    sky_eadd_message_free(eadd_message);
+    sky_eget_message_free(eget_message);
+    return 0;
+
+error:
+    if(file) fclose(file);
+    sky_eadd_message_free(eadd_message);
+    sky_eget_message_free(eget_message);
+    return -1;
+}
+
+// Checks that a query message can be merged across the nodes. Streamed
+// queries are rejected since the frames of their responses are not merged.
+//
+// body - The body of the query message.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_check_query(sky_buffer *body)
+{
+    int rc;
+    FILE *file = NULL;
+    sky_query_message *message = NULL;
+    check(body->length > 0, "Message body required");
+
+    file = fmemopen(body->data, body->length, "r");
+    check(file != NULL, "Unable to open message body");
+    message = sky_query_message_create(); check_mem(message);
+    rc = sky_query_message_unpack(message, file);
+    check(rc == 0, "Unable to parse query message");
+    check(!message->stream, "Streamed queries cannot be coordinated");
+
+    fclose(file);
+    sky_query_message_free(message);
+    return 0;
+
+error:
+    if(file) fclose(file);
+    sky_query_message_free(message);
+    return -1;
+}
+
+// Splits the events of an EBULK message into one EBULK body per node. The
+// events are copied as they were sent. Nodes without any events receive an
+// empty message so that every shard reports a count.
+//
+// coordinator - The coordinator.
+// body        - The body of the EBULK message.
+// bodies      - An array to return the body for each node in.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_split_ebulk(sky_coordinator *coordinator,
+                                sky_buffer *body, sky_buffer **bodies)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    FILE *file = NULL;
+    FILE *event_file = NULL;
+    sky_buffer *event = NULL;
+    sky_buffer **events = NULL;
+    uint32_t *counts = NULL;
+    sky_eadd_message *message = NULL;
+    check(body->length > 0, "Message body required");
+
+    events = calloc(coordinator->node_count, sizeof(*events)); check_mem(events);
+    counts = calloc(coordinator->node_count, sizeof(*counts)); check_mem(counts);
+    for(i=0; i<coordinator->node_count; i++) {
+        events[i] = sky_buffer_create(); check_mem(events[i]);
+    }
+
+    file = fmemopen(body->data, body->length, "r");
+    check(file != NULL, "Unable to open message body");
+    uint32_t count = minipack_fread_array(file, &sz);
+    check(sz > 0, "Unable to read event array");
+
+    // Copy each event to the buffer of the node that owns its object.
+    event = sky_buffer_create(); check_mem(event);
+    for(i=0; i<count; i++) {
+        sky_buffer_clear(event);
+        rc = sky_minipack_fread_elem(file, event);
+        check(rc == 0, "Unable to read event #%d", i);
+
+        event_file = fmemopen(event->data, event->length, "r");
+        check(event_file != NULL, "Unable to open event");
+        message = sky_eadd_message_create(); check_mem(message);
+        rc = sky_eadd_message_unpack(message, event_file);
+        check(rc == 0, "Unable to parse event #%d", i);
+        fclose(event_file);
+        event_file = NULL;
+
+        uint32_t index = sky_coordinator_get_node_index(coordinator, message->object_id);
+        sky_eadd_message_free(message);
+        message = NULL;
+        rc = sky_buffer_write(events[index], event->data, event->length);
+        check(rc == 0, "Unable to copy event #%d", i);
+        counts[index]++;
+    }
+
+    for(i=0; i<coordinator->node_count; i++) {
+        bodies[i] = sky_buffer_create(); check_mem(bodies[i]);
+        rc = sky_buffer_pack_array(bodies[i], counts[i]);
+        check(rc == 0, "Unable to write event array");
+        rc = sky_buffer_write(bodies[i], events[i]->data, events[i]->length);
+        check(rc == 0, "Unable to write events");
+    }
+
+    fclose(file);
+    for(i=0; i<coordinator->node_count; i++) sky_buffer_free(events[i]);
+    free(events);
+    free(counts);
+    sky_buffer_free(event);
+    return 0;
+
+error:
+    if(file) fclose(file);
+    if(event_file) fclose(event_file);
+    sky_eadd_message_free(message);
+    if(events) {
+        for(i=0; i<coordinator->node_count; i++) sky_buffer_free(events[i]);
+    }
+    free(events);
+    free(counts);
+    sky_buffer_free(event);
+    return -1;
+}
+
+
+//--------------------------------------
+// Merging
+//--------------------------------------
+
+// Creates an empty response element.
+//
+// Returns a reference to the new element if successful. Otherwise returns
+// null.
+sky_coordinator_elem *sky_coordinator_elem_create()
+{
+    sky_coordinator_elem *elem = calloc(1, sizeof(sky_coordinator_elem));
+    check_mem(elem);
+    return elem;
+
+error:
+    sky_coordinator_elem_free(elem);
+    return NULL;
+}
+
+// Removes a response element and its children from memory.
+//
+// elem - The element.
+void sky_coordinator_elem_free(sky_coordinator_elem *elem)
+{
+    if(elem) {
+        uint32_t i;
+        for(i=0; i<elem->child_count; i++) {
+            sky_coordinator_elem_free(elem->children[i]);
+        }
+        free(elem->children);
+        elem->children = NULL;
+        sky_buffer_free(elem->key);
+        elem->key = NULL;
+        sky_buffer_free(elem->raw);
+        elem->raw = NULL;
+        free(elem);
+    }
+}
+
+// Checks if a MessagePack type byte starts an integer.
+//
+// type - The type byte.
+//
+// Returns true if the element is an integer.
+bool sky_coordinator_is_int(uint8_t type)
+{
+    return (type <= 0x7F || type >= 0xE0 || (type >= 0xCC && type <= 0xD3));
+}
+
+// Parses a response element from a file stream.
+//
+// elem - The element to parse into.
+// file - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_elem_unpack(sky_coordinator_elem *elem, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    check(elem != NULL, "Element required");
+    check(file != NULL, "File stream required");
+
+    // Read the first byte to determine the type.
+    uint8_t type[1];
+    check(fread(type, sizeof(*type), 1, file) == 1, "Unable to read element type");
+    ungetc(type[0], file);
+
+    if(minipack_is_map((void*)type)) {
+        elem->is_map = true;
+        uint32_t count = minipack_fread_map(file, &sz);
+        check(sz > 0, "Unable to read map");
+        elem->children = calloc(count, sizeof(*elem->children));
+        if(count > 0) check_mem(elem->children);
+        for(i=0; i<count; i++) {
+            sky_coordinator_elem *child = sky_coordinator_elem_create(); check_mem(child);
+            elem->children[i] = child;
+            elem->child_count = i+1;
+            child->key = sky_buffer_create(); check_mem(child->key);
+            rc = sky_minipack_fread_elem(file, child->key);
+            check(rc == 0, "Unable to read map key");
+            rc = sky_coordinator_elem_unpack(child, file);
+            check(rc == 0, "Unable to read map value");
+        }
+    }
+    else if(sky_coordinator_is_int(type[0])) {
+        elem->is_int = true;
+        elem->int_value = minipack_fread_int(file, &sz);
+        check(sz > 0, "Unable to read integer");
+    }
+    else {
+        elem->raw = sky_buffer_create(); check_mem(elem->raw);
+        rc = sky_minipack_fread_elem(file, elem->raw);
+        check(rc == 0, "Unable to read element");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Merges a response element into another. Integers are added together and
+// maps are merged key by key. Keys that only exist in the source are moved
+// into the element. Any other values are left as they are.
+//
+// elem   - The element to merge into.
+// source - The element to merge from. Merged children are taken from it.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_elem_merge(sky_coordinator_elem *elem,
+                               sky_coordinator_elem *source)
+{
+    int rc;
+    uint32_t i, j;
+    check(elem != NULL, "Element required");
+    check(source != NULL, "Source element required");
+
+    if(elem->is_int && source->is_int) {
+        elem->int_value += source->int_value;
+    }
+    else if(elem->is_map && source->is_map) {
+        for(i=0; i<source->child_count; i++) {
+            sky_coordinator_elem *child = source->children[i];
+            sky_coordinator_elem *match = NULL;
+            for(j=0; j<elem->child_count && match == NULL; j++) {
+                sky_buffer *key = elem->children[j]->key;
+                if(key->length == child->key->length && memcmp(key->data, child->key->data, key->length) == 0) {
+                    match = elem->children[j];
+                }
+            }
+
+            if(match != NULL) {
+                rc = sky_coordinator_elem_merge(match, child);
+                check(rc == 0, "Unable to merge map value");
+            }
+            else {
+                elem->children = realloc(elem->children, sizeof(*elem->children) * (elem->child_count+1));
+                check_mem(elem->children);
+                elem->children[elem->child_count++] = child;
+                source->children[i] = NULL;
+            }
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes a response element to a buffer.
+//
+// elem   - The element.
+// buffer - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_coordinator_elem_pack(sky_coordinator_elem *elem, sky_buffer *buffer)
+{
+    int rc;
+    uint32_t i;
+    check(elem != NULL, "Element required");
+    check(buffer != NULL, "Buffer required");
+
+    if(elem->is_map) {
+        rc = sky_buffer_pack_map(buffer, elem->child_count);
+        check(rc == 0, "Unable to write map");
+        for(i=0; i<elem->child_count; i++) {
+            sky_coordinator_elem *child = elem->children[i];
+            rc = sky_buffer_write(buffer, child->key->data, child->key->length);
+            check(rc == 0, "Unable to write map key");
+            rc = sky_coordinator_elem_pack(child, buffer);
+            check(rc == 0, "Unable to write map value");
+        }
+    }
+    else if(elem->is_int) {
+        rc = (elem->int_value >= 0 ? sky_buffer_pack_uint(buffer, (uint64_t)elem->int_value) : sky_buffer_pack_int(buffer, elem->int_value));
+        check(rc == 0, "Unable to write integer");
+    }
+    else {
+        rc = sky_buffer_write(buffer, elem->raw->data, elem->raw->length);
+        check(rc == 0, "Unable to write element");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
@@ -0,0 +1,130 @@
+#ifndef _sky_coordinator_h
+#define _sky_coordinator_h
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "types.h"
+#include "message_header.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A coordinator spreads every table over several backend nodes. Each node is
+// a regular skyd server that holds one shard of each table. Objects are
+// assigned to shards by hashing their object id, so the whole path of an
+// object lives on a single node.
+//
+// Messages are routed by type:
+//
+//   eadd, eget         - Sent to the node that owns the object.
+//   ebulk              - Split into one message per node.
+//   next_action, query - Sent to every node. The results are merged.
+//   funnel, dag          Streamed queries are rejected.
+//   aadd, padd,        - Sent to every node so that action and property ids
+//   compact              stay the same on every shard. The first node's
+//                        response is returned.
+//   aget, aall,        - Sent to the first node.
+//   pget, pall
+//   cancel             - Answered by the coordinator itself. Queries that
+//                        are running on the nodes are not cancelled.
+//
+// Paths never cross objects and every aggregate is a count, a sum or a count
+// of distinct objects, so the results of the shards are merged by adding
+// their integer values together key by key. The same merge adds up the
+// counts of a split ebulk message and the counters of query profiles.
+//
+// A coordinator keeps one connection to each node and is not thread safe.
+// Each worker of a coordinating server owns its own coordinator. A
+// connection that fails is closed and reopened by the next message.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A backend node. The address is HOST:PORT or the path of a Unix domain
+// socket.
+typedef struct sky_coordinator_node {
+    bstring address;
+    int socket;
+    FILE *input;
+    FILE *output;
+} sky_coordinator_node;
+
+typedef struct sky_coordinator {
+    sky_coordinator_node *nodes;
+    uint32_t node_count;
+} sky_coordinator;
+
+typedef struct sky_coordinator_elem sky_coordinator_elem;
+
+// A node's response parsed so that it can be merged with the responses of
+// other nodes. Map entries keep the raw bytes of their key. Values that are
+// neither maps nor integers keep their raw bytes and are taken from the
+// first response.
+struct sky_coordinator_elem {
+    sky_buffer *key;
+    bool is_map;
+    bool is_int;
+    int64_t int_value;
+    sky_buffer *raw;
+    sky_coordinator_elem **children;
+    uint32_t child_count;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_coordinator *sky_coordinator_create();
+
+void sky_coordinator_free(sky_coordinator *coordinator);
+
+int sky_coordinator_add_node(sky_coordinator *coordinator, bstring address);
+
+//--------------------------------------
+// Routing
+//--------------------------------------
+
+uint32_t sky_coordinator_get_node_index(sky_coordinator *coordinator,
+    sky_object_id_t object_id);
+
+int sky_coordinator_process_message(sky_coordinator *coordinator,
+    sky_message_header *header, FILE *input, sky_buffer *output);
+
+int sky_coordinator_route(sky_coordinator *coordinator, uint32_t index,
+    sky_message_header *header, sky_buffer *body, sky_buffer *output);
+
+//--------------------------------------
+// Merging
+//--------------------------------------
+
+sky_coordinator_elem *sky_coordinator_elem_create();
+
+void sky_coordinator_elem_free(sky_coordinator_elem *elem);
+
+int sky_coordinator_elem_unpack(sky_coordinator_elem *elem, FILE *file);
+
+int sky_coordinator_elem_merge(sky_coordinator_elem *elem,
+    sky_coordinator_elem *source);
+
+int sky_coordinator_elem_pack(sky_coordinator_elem *elem, sky_buffer *buffer);
+
+#endif
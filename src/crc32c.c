@@ -0,0 +1,201 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "crc32c.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SKY_CRC32C_X86 1
+#include <immintrin.h>
+#else
+#define SKY_CRC32C_X86 0
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#define SKY_CRC32C_ARM 1
+#include <arm_acle.h>
+#else
+#define SKY_CRC32C_ARM 0
+#endif
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+// The reflected Castagnoli polynomial.
+#define SKY_CRC32C_POLYNOMIAL 0x82F63B78
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef uint32_t (*sky_crc32c_func)(uint32_t crc, uint8_t *bytes,
+    size_t length);
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+void sky_crc32c_init();
+
+uint32_t sky_crc32c_scalar(uint32_t crc, uint8_t *bytes, size_t length);
+
+#if SKY_CRC32C_X86
+uint32_t sky_crc32c_sse42(uint32_t crc, uint8_t *bytes, size_t length);
+#endif
+
+#if SKY_CRC32C_ARM
+uint32_t sky_crc32c_arm(uint32_t crc, uint8_t *bytes, size_t length);
+#endif
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+// The lookup table of the scalar version, which is filled in when the
+// checksum function is chosen.
+uint32_t sky_crc32c_table[256];
+
+// The checksum function chosen for the current CPU.
+pthread_once_t sky_crc32c_once = PTHREAD_ONCE_INIT;
+sky_crc32c_func sky_crc32c_best = sky_crc32c_scalar;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Dispatch
+//--------------------------------------
+
+// Builds the lookup table and chooses the fastest checksum function
+// supported by the CPU.
+void sky_crc32c_init()
+{
+    uint32_t i, j;
+    for(i=0; i<256; i++) {
+        uint32_t value = i;
+        for(j=0; j<8; j++) {
+            value = (value & 1 ? (value >> 1) ^ SKY_CRC32C_POLYNOMIAL : value >> 1);
+        }
+        sky_crc32c_table[i] = value;
+    }
+
+#if SKY_CRC32C_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.2")) {
+        sky_crc32c_best = sky_crc32c_sse42;
+    }
+#elif SKY_CRC32C_ARM
+    sky_crc32c_best = sky_crc32c_arm;
+#endif
+}
+
+
+//--------------------------------------
+// Checksum
+//--------------------------------------
+
+// Calculates the CRC32C checksum of a range of memory.
+//
+// crc    - The checksum of the preceding bytes or zero.
+// ptr    - A pointer to the bytes.
+// length - The number of bytes.
+//
+// Returns the checksum of the preceding bytes and the range.
+uint32_t sky_crc32c(uint32_t crc, void *ptr, size_t length)
+{
+    pthread_once(&sky_crc32c_once, sky_crc32c_init);
+    return ~sky_crc32c_best(~crc, (uint8_t*)ptr, length);
+}
+
+// Calculates a checksum one byte at a time with the lookup table.
+//
+// crc    - The inverted checksum of the preceding bytes.
+// bytes  - A pointer to the bytes.
+// length - The number of bytes.
+//
+// Returns the inverted checksum.
+uint32_t sky_crc32c_scalar(uint32_t crc, uint8_t *bytes, size_t length)
+{
+    size_t i;
+    for(i=0; i<length; i++) {
+        crc = sky_crc32c_table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if SKY_CRC32C_X86
+
+// Calculates a checksum eight bytes at a time with the SSE4.2 CRC32
+// instruction.
+//
+// crc    - The inverted checksum of the preceding bytes.
+// bytes  - A pointer to the bytes.
+// length - The number of bytes.
+//
+// Returns the inverted checksum.
+__attribute__((target("sse4.2")))
+uint32_t sky_crc32c_sse42(uint32_t crc, uint8_t *bytes, size_t length)
+{
+    uint64_t value = crc;
+    while(length >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        value = _mm_crc32_u64(value, word);
+        bytes += sizeof(word);
+        length -= sizeof(word);
+    }
+    crc = (uint32_t)value;
+    while(length > 0) {
+        crc = _mm_crc32_u8(crc, *bytes);
+        bytes++;
+        length--;
+    }
+    return crc;
+}
+
+#endif
+
+#if SKY_CRC32C_ARM
+
+// Calculates a checksum eight bytes at a time with the ARMv8 CRC32
+// instructions.
+//
+// crc    - The inverted checksum of the preceding bytes.
+// bytes  - A pointer to the bytes.
+// length - The number of bytes.
+//
+// Returns the inverted checksum.
+uint32_t sky_crc32c_arm(uint32_t crc, uint8_t *bytes, size_t length)
+{
+    while(length >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        crc = __crc32cd(crc, word);
+        bytes += sizeof(word);
+        length -= sizeof(word);
+    }
+    while(length > 0) {
+        crc = __crc32cb(crc, *bytes);
+        bytes++;
+        length--;
+    }
+    return crc;
+}
+
+#endif
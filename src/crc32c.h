@@ -0,0 +1,33 @@
+#ifndef _crc32c_h
+#define _crc32c_h
+
+#include <stddef.h>
+#include <inttypes.h>
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// CRC32C is the Castagnoli variant of CRC32 that is used to checksum the
+// blocks of a data file. The checksum is calculated with the SSE4.2 CRC32
+// instruction on x86-64 when the CPU supports it and with the ARMv8 CRC32
+// instructions when they are enabled at compile time. Other platforms use a
+// lookup table, which produces the same checksums.
+//
+// A checksum can be calculated in pieces by passing the checksum of the
+// previous pieces as the initial value of the next. The checksum of the
+// first piece starts from zero.
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+uint32_t sky_crc32c(uint32_t crc, void *ptr, size_t length);
+
+#endif
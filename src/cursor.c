@@ -1,6 +1,8 @@
 #include "cursor.h"
 #include "path.h"
 #include "event.h"
+#include "minipack.h"
+#include "minipack_batch.h"
 #include "mem.h"
 #include "dbg.h"
 
@@ -13,6 +15,8 @@
 
 int sky_cursor_set_ptr(sky_cursor *cursor, void *ptr);
 int sky_cursor_set_eof(sky_cursor *cursor);
+sky_timestamp_t sky_cursor_get_path_timestamp(void *ptr);
+int sky_cursor_index_path(sky_cursor *cursor, uint32_t path_index);
 
 
 //==============================================================================
@@ -59,6 +63,8 @@ void sky_cursor_free(sky_cursor *cursor)
 {
     if(cursor) {
         if(cursor->paths) free(cursor->paths);
+        free(cursor->index_ptrs);
+        free(cursor->index_timestamps);
         free(cursor);
     }
 }
@@ -122,11 +128,22 @@ int sky_cursor_set_paths(sky_cursor *cursor, void **ptrs, int count)
     cursor->path_index = 0;
     cursor->event_index = 0;
     cursor->eof = (count == 0);
+    cursor->index_valid = false;
     
+    // Start with an empty state for the new object.
+    if(cursor->track_state) {
+        sky_cursor_clear_state(cursor);
+    }
+
     // Position the pointer at the first path if paths are passed.
     if(count > 0) {
         rc = sky_cursor_set_ptr(cursor, cursor->paths[0]);
         check(rc == 0, "Unable to set paths");
+
+        if(cursor->track_state) {
+            rc = sky_cursor_update_state(cursor);
+            check(rc == 0, "Unable to update cursor state");
+        }
     }
     // Otherwise clear out the pointer.
     else {
@@ -145,7 +162,9 @@ error:
 // Pointer Management
 //--------------------------------------
 
-// Initializes the cursor to point at a new path at a given pointer.
+// Initializes the cursor to point at a new path at a given pointer. The
+// first event of a path always stores its full timestamp so it starts the
+// running timestamp.
 //
 // cursor - The cursor to update.
 // ptr    - The address of the start of a path.
@@ -159,12 +178,14 @@ int sky_cursor_set_ptr(sky_cursor *cursor, void *ptr)
     // Store position of first event and store position of end of path.
     cursor->ptr    = ptr + SKY_PATH_HEADER_LENGTH;
     cursor->endptr = ptr + sky_path_sizeof_raw(ptr);
+    cursor->timestamp = sky_event_get_timestamp(cursor->ptr, 0);
     
     return 0;
 
 error:
     cursor->ptr = NULL;
     cursor->endptr = NULL;
+    cursor->timestamp = 0;
     return -1;
 }
 
@@ -184,26 +205,272 @@ int sky_cursor_next(sky_cursor *cursor)
     cursor->ptr += event_length;
     cursor->event_index++;
 
-    // If pointer is beyond the last event then move to next path.
+    // If pointer is beyond the last event then move to next path. Otherwise
+    // apply the event's timestamp to the running timestamp.
     if(cursor->ptr >= cursor->endptr) {
-        cursor->path_index++;
+        rc = sky_cursor_next_path(cursor);
+        check(rc == 0, "Unable to move to next path");
+    }
+    else {
+        cursor->timestamp = sky_event_get_timestamp(cursor->ptr, cursor->timestamp);
+    }
+
+    // Make sure that we are pointing at an event unless the events were
+    // already verified against the block checksum.
+    if(!cursor->eof) {
+        if(!cursor->verified) {
+            sky_event_flag_t flag = *((sky_event_flag_t*)cursor->ptr);
+            check(flag & (SKY_EVENT_FLAG_ACTION|SKY_EVENT_FLAG_DATA), "Cursor pointing at invalid raw event data: %p", cursor->ptr);
+        }
+
+        if(cursor->track_state) {
+            rc = sky_cursor_update_state(cursor);
+            check(rc == 0, "Unable to update cursor state");
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Moves the cursor to the start of the next path or sets EOF if there are no
+// more paths remaining.
+//
+// cursor - The cursor.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cursor_next_path(sky_cursor *cursor)
+{
+    int rc;
+    check(cursor != NULL, "Cursor required");
+
+    cursor->path_index++;
+
+    // Move to the next path if more paths are remaining.
+    if(cursor->path_index < cursor->path_count) {
+        rc = sky_cursor_set_ptr(cursor, cursor->paths[cursor->path_index]);
+        check(rc == 0, "Unable to set pointer to path");
+    }
+    // Otherwise set EOF.
+    else {
+        rc = sky_cursor_set_eof(cursor);
+        check(rc == 0, "Unable to set EOF on cursor");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
 
-        // Move to the next path if more paths are remaining.
-        if(cursor->path_index < cursor->path_count) {
-            rc = sky_cursor_set_ptr(cursor, cursor->paths[cursor->path_index]);
+// Moves the cursor forward to the first event at or after a timestamp. The
+// events of a path are sorted by timestamp so the cursor stops at the start
+// of a time window and callers can stop iterating once they pass its end.
+// The cursor is set to EOF if no remaining event is at or after the
+// timestamp.
+//
+// When a path is spanned across several blocks, the first event of each
+// block is used as a sparse index. The cursor binary searches for the last
+// block that starts before the timestamp and only scans events from there.
+// Skipped blocks are not counted in the event index. If the cursor is
+// tracking state then every event is visited so the state stays correct.
+//
+// cursor    - The cursor.
+// timestamp - The timestamp to seek to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cursor_seek_timestamp(sky_cursor *cursor, sky_timestamp_t timestamp)
+{
+    int rc;
+    check(cursor != NULL, "Cursor required");
+
+    // Jump to the last path that starts before the timestamp.
+    if(!cursor->eof && !cursor->track_state && cursor->path_index+1 < cursor->path_count) {
+        uint32_t min_index = cursor->path_index;
+        uint32_t max_index = cursor->path_count-1;
+        while(min_index < max_index) {
+            uint32_t index = min_index + (max_index - min_index + 1) / 2;
+            if(sky_cursor_get_path_timestamp(cursor->paths[index]) < timestamp) {
+                min_index = index;
+            }
+            else {
+                max_index = index - 1;
+            }
+        }
+
+        if(min_index > cursor->path_index) {
+            cursor->path_index = min_index;
+            rc = sky_cursor_set_ptr(cursor, cursor->paths[min_index]);
             check(rc == 0, "Unable to set pointer to path");
         }
-        // Otherwise set EOF.
+    }
+
+    // Scan forward to the first event in range.
+    while(!cursor->eof && cursor->timestamp < timestamp) {
+        rc = sky_cursor_next(cursor);
+        check(rc == 0, "Unable to move to next event");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Decodes the cursor's current event and the events after it into arrays
+// and moves the cursor past them. Up to the given number of events are
+// decoded and fewer are only decoded when the cursor reaches EOF. Any of
+// the arrays can be NULL if the caller does not need that field. Events
+// without an action have an action id of zero and events without data have
+// a NULL data pointer.
+//
+// cursor       - The cursor.
+// timestamps   - An array to write the event timestamps to.
+// action_ids   - An array to write the event action ids to.
+// data_ptrs    - An array to write pointers to the event data sections to.
+// data_lengths - An array to write the lengths of the data sections to.
+// size         - The number of events that fit in the arrays.
+// count        - A pointer to where the number of decoded events is returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cursor_next_batch(sky_cursor *cursor, sky_timestamp_t *timestamps,
+                          sky_action_id_t *action_ids, void **data_ptrs,
+                          uint32_t *data_lengths, uint32_t size,
+                          uint32_t *count)
+{
+    int rc;
+    check(cursor != NULL, "Cursor required");
+    check(count != NULL, "Count return pointer required");
+    check(!cursor->track_state, "Cursor cannot decode batches while tracking state");
+    *count = 0;
+
+    uint32_t n = 0;
+    while(n < size && !cursor->eof) {
+        void *ptr = cursor->ptr;
+        sky_event_flag_t flag = *((sky_event_flag_t*)ptr);
+        check(cursor->verified || flag & (SKY_EVENT_FLAG_ACTION|SKY_EVENT_FLAG_DATA), "Cursor pointing at invalid raw event data: %p", ptr);
+
+        if(timestamps != NULL) {
+            timestamps[n] = cursor->timestamp;
+        }
+        if(action_ids != NULL) {
+            action_ids[n] = sky_cursor_fast_get_action_id(ptr);
+        }
+        if(data_ptrs != NULL || data_lengths != NULL) {
+            void *data_ptr = NULL;
+            uint32_t data_length = 0;
+            if(flag & SKY_EVENT_FLAG_DATA) {
+                void *length_ptr = ptr + sky_event_header_length(flag) + ((flag & SKY_EVENT_FLAG_ACTION) ? sizeof(sky_action_id_t) : 0);
+                data_length = *((sky_event_data_length_t*)length_ptr);
+                data_ptr = length_ptr + sizeof(sky_event_data_length_t);
+            }
+            if(data_ptrs != NULL) data_ptrs[n] = data_ptr;
+            if(data_lengths != NULL) data_lengths[n] = data_length;
+        }
+        n++;
+
+        // Move to the next event.
+        cursor->ptr += sky_cursor_fast_sizeof_event(ptr);
+        cursor->event_index++;
+        if(cursor->ptr >= cursor->endptr) {
+            rc = sky_cursor_next_path(cursor);
+            check(rc == 0, "Unable to move to next path");
+        }
         else {
-            rc = sky_cursor_set_eof(cursor);
-            check(rc == 0, "Unable to set EOF on cursor");
+            cursor->timestamp = sky_event_get_timestamp(cursor->ptr, cursor->timestamp);
         }
     }
 
-    // Make sure that we are point at an event.
-    if(!cursor->eof) {
-        sky_event_flag_t flag = *((sky_event_flag_t*)cursor->ptr);
-        check(flag & SKY_EVENT_FLAG_ACTION || flag & SKY_EVENT_FLAG_DATA, "Cursor pointing at invalid raw event data: %p", cursor->ptr);
+    *count = n;
+    return 0;
+
+error:
+    *count = 0;
+    return -1;
+}
+
+// Checks if there is an event before the cursor's current event. A cursor at
+// EOF has a previous event if it has any paths.
+//
+// cursor - The cursor.
+//
+// Returns true if the cursor can move back.
+bool sky_cursor_has_prev(sky_cursor *cursor)
+{
+    if(cursor == NULL || cursor->path_count == 0) {
+        return false;
+    }
+    if(cursor->eof) {
+        return true;
+    }
+    return (cursor->path_index > 0 || cursor->ptr != cursor->paths[cursor->path_index] + SKY_PATH_HEADER_LENGTH);
+}
+
+// Moves the cursor back to the previous event. The previous event is found
+// in the cursor's index of the current path segment, which is built the
+// first time the cursor moves back in the segment. Moving back from the
+// first event of a segment moves to the last event of the segment before
+// it and moving back from EOF moves to the last event of the last segment.
+//
+// cursor - The cursor.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cursor_prev(sky_cursor *cursor)
+{
+    int rc;
+    check(cursor != NULL, "Cursor required");
+    check(!cursor->track_state, "Cursor cannot move back while tracking state");
+    check(sky_cursor_has_prev(cursor), "No previous events are available");
+
+    // Find the segment and the position of the previous event in it.
+    uint32_t path_index = cursor->path_index;
+    uint32_t position = 0;
+    if(cursor->eof) {
+        path_index = cursor->path_count - 1;
+        rc = sky_cursor_index_path(cursor, path_index);
+        check(rc == 0, "Unable to index path");
+        position = cursor->index_count;
+    }
+    else {
+        rc = sky_cursor_index_path(cursor, path_index);
+        check(rc == 0, "Unable to index path");
+
+        // Events are in pointer order so the current event is searched for.
+        uint32_t lo = 0, hi = cursor->index_count;
+        while(lo < hi) {
+            uint32_t mid = lo + ((hi - lo) / 2);
+            if(cursor->index_ptrs[mid] < cursor->ptr) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        position = lo;
+
+        // Move to the end of the previous segment.
+        if(position == 0) {
+            path_index--;
+            rc = sky_cursor_index_path(cursor, path_index);
+            check(rc == 0, "Unable to index path");
+            position = cursor->index_count;
+        }
+    }
+    check(position > 0, "Path has no events");
+
+    // Point at the previous event.
+    if(cursor->eof || path_index != cursor->path_index) {
+        rc = sky_cursor_set_ptr(cursor, cursor->paths[path_index]);
+        check(rc == 0, "Unable to set pointer to path");
+        cursor->path_index = path_index;
+        cursor->eof = false;
+    }
+    cursor->ptr = cursor->index_ptrs[position-1];
+    cursor->timestamp = cursor->index_timestamps[position-1];
+    if(cursor->event_index > 0) {
+        cursor->event_index--;
     }
 
     return 0;
@@ -212,6 +479,60 @@ error:
     return -1;
 }
 
+// Builds the cursor's index of the position and timestamp of each event in
+// a path segment. The index is kept until the cursor moves back in another
+// segment or is given new paths.
+//
+// cursor     - The cursor.
+// path_index - The index of the path segment.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cursor_index_path(sky_cursor *cursor, uint32_t path_index)
+{
+    if(cursor->index_valid && cursor->index_path_index == path_index) {
+        return 0;
+    }
+    cursor->index_valid = false;
+    cursor->index_count = 0;
+
+    void *path_ptr = cursor->paths[path_index];
+    sky_timestamp_t timestamp = 0;
+    sky_path_foreach_event(path_ptr, ptr) {
+        if(cursor->index_count == cursor->index_capacity) {
+            uint32_t capacity = (cursor->index_capacity > 0 ? cursor->index_capacity * 2 : 64);
+            void **ptrs = realloc(cursor->index_ptrs, sizeof(*ptrs) * capacity);
+            check_mem(ptrs);
+            cursor->index_ptrs = ptrs;
+            sky_timestamp_t *timestamps = realloc(cursor->index_timestamps, sizeof(*timestamps) * capacity);
+            check_mem(timestamps);
+            cursor->index_timestamps = timestamps;
+            cursor->index_capacity = capacity;
+        }
+
+        timestamp = sky_event_get_timestamp(ptr, timestamp);
+        cursor->index_ptrs[cursor->index_count] = ptr;
+        cursor->index_timestamps[cursor->index_count] = timestamp;
+        cursor->index_count++;
+    }
+
+    cursor->index_path_index = path_index;
+    cursor->index_valid = true;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Retrieves the timestamp of the first event of a raw path.
+//
+// ptr - A pointer to the raw path.
+//
+// Returns the timestamp of the first event.
+sky_timestamp_t sky_cursor_get_path_timestamp(void *ptr)
+{
+    return sky_event_get_timestamp(ptr + SKY_PATH_HEADER_LENGTH, 0);
+}
+
 // Flags a cursor to say that it is at the end of all its paths.
 //
 // cursor - The cursor to set EOF on.
@@ -226,6 +547,7 @@ int sky_cursor_set_eof(sky_cursor *cursor)
     cursor->eof         = true;
     cursor->ptr         = NULL;
     cursor->endptr      = NULL;
+    cursor->timestamp   = 0;
 
     return 0;
 
@@ -238,6 +560,26 @@ error:
 // Event Management
 //--------------------------------------
 
+// Retrieves the timestamp of the current event.
+//
+// cursor    - The cursor.
+// timestamp - A pointer to where the timestamp should be returned to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cursor_get_timestamp(sky_cursor *cursor, sky_timestamp_t *timestamp)
+{
+    check(cursor != NULL, "Cursor required");
+    check(!cursor->eof, "Cursor cannot be EOF");
+    check(timestamp != NULL, "Timestamp return pointer required");
+
+    *timestamp = cursor->timestamp;
+    return 0;
+
+error:
+    if(timestamp) *timestamp = 0;
+    return -1;
+}
+
 // Retrieves a the action identifier of the current event.
 //
 // cursor    - The cursor.
@@ -251,8 +593,9 @@ int sky_cursor_get_action_id(sky_cursor *cursor, sky_action_id_t *action_id)
     check(action_id != NULL, "Action id return pointer required");
 
     // Retrieve the action id.
-    if(*((sky_event_flag_t*)cursor->ptr) & SKY_EVENT_FLAG_ACTION) {
-        *action_id = *((sky_action_id_t*)(cursor->ptr + sizeof(sky_event_flag_t) + sizeof(sky_timestamp_t)));
+    sky_event_flag_t flag = *((sky_event_flag_t*)cursor->ptr);
+    if(flag & SKY_EVENT_FLAG_ACTION) {
+        *action_id = *((sky_action_id_t*)(cursor->ptr + sky_event_header_length(flag)));
     }
     else {
         *action_id = 0;
@@ -285,7 +628,7 @@ int sky_cursor_get_data_ptr(sky_cursor *cursor, void **data_ptr,
     if(*((sky_event_flag_t*)cursor->ptr) & SKY_EVENT_FLAG_DATA) {
         // Move past the initial header (flag, timestamp, action_id).
         void *ptr = cursor->ptr;
-        ptr += sizeof(sky_event_flag_t) + sizeof(sky_timestamp_t);
+        ptr += sky_event_header_length(*((sky_event_flag_t*)cursor->ptr));
         if(*((sky_event_flag_t*)cursor->ptr) & SKY_EVENT_FLAG_ACTION) {
             ptr += sizeof(sky_action_id_t);
         }
@@ -310,3 +653,134 @@ error:
     return -1;
 }
 
+
+//--------------------------------------
+// State Management
+//--------------------------------------
+
+// Turns object state tracking on or off. When tracking is turned on the
+// state is rebuilt from the current event so it should be turned on before
+// the paths are set.
+//
+// cursor      - The cursor.
+// track_state - A flag stating if the state should be tracked.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cursor_set_track_state(sky_cursor *cursor, bool track_state)
+{
+    int rc;
+    check(cursor != NULL, "Cursor required");
+
+    cursor->track_state = track_state;
+    sky_cursor_clear_state(cursor);
+    if(track_state && !cursor->eof && cursor->ptr != NULL) {
+        rc = sky_cursor_update_state(cursor);
+        check(rc == 0, "Unable to update cursor state");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Applies the data of the current event to the object state. Action
+// properties set by the previous event are cleared first.
+//
+// cursor - The cursor.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cursor_update_state(sky_cursor *cursor)
+{
+    int rc;
+    uint32_t i;
+    check(cursor != NULL, "Cursor required");
+    check(!cursor->eof, "Cursor cannot be EOF");
+
+    // Clear the action properties of the previous event.
+    for(i=0; i<cursor->action_state_count; i++) {
+        cursor->state[(uint8_t)cursor->action_state_ids[i]] = NULL;
+    }
+    cursor->action_state_count = 0;
+
+    // Action-only events do not change the state.
+    sky_event_flag_t flag = *((sky_event_flag_t*)cursor->ptr);
+    if(!(flag & SKY_EVENT_FLAG_DATA)) {
+        return 0;
+    }
+
+    // Point each property's slot at its value in the raw event.
+    void *ptr = cursor->ptr + sky_event_header_length(flag) + ((flag & SKY_EVENT_FLAG_ACTION) ? sizeof(sky_action_id_t) : 0);
+    uint32_t data_length = *((sky_event_data_length_t*)ptr);
+    void *end_ptr = ptr + sizeof(sky_event_data_length_t) + data_length;
+    ptr += sizeof(sky_event_data_length_t);
+
+    // Pack each value of the fixed section into the slot for its property.
+    uint32_t fixed_count = sky_event_data_get_fixed_count(ptr, data_length);
+    for(i=0; i<fixed_count; i++) {
+        sky_event_data_view view;
+        sky_event_data_get_fixed_view(ptr, i, &view);
+        if(view.key < 0) {
+            check(cursor->action_state_count < SKY_CURSOR_ACTION_STATE_SIZE, "Too many action properties on event");
+            cursor->action_state_ids[cursor->action_state_count++] = view.key;
+        }
+        void *slot = cursor->fixed_state[(uint8_t)view.key];
+        rc = sky_event_data_view_pack(&view, slot, NULL);
+        check(rc == 0, "Unable to pack fixed event data value");
+        cursor->state[(uint8_t)view.key] = slot;
+    }
+    ptr += sky_event_data_get_fixed_length(ptr, data_length);
+
+    while(ptr < end_ptr) {
+        sky_property_id_t property_id = *((sky_property_id_t*)ptr);
+        ptr += sizeof(sky_property_id_t);
+
+        if(property_id < 0) {
+            check(cursor->action_state_count < SKY_CURSOR_ACTION_STATE_SIZE, "Too many action properties on event");
+            cursor->action_state_ids[cursor->action_state_count++] = property_id;
+        }
+        cursor->state[(uint8_t)property_id] = ptr;
+
+        size_t sz = sky_minipack_batch_fast_sizeof_elem(ptr);
+        check(sz > 0, "Invalid event data value: %p", ptr);
+        ptr += sz;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Removes all property values from the object state.
+//
+// cursor - The cursor.
+void sky_cursor_clear_state(sky_cursor *cursor)
+{
+    memset(cursor->state, 0, sizeof(cursor->state));
+    cursor->action_state_count = 0;
+}
+
+// Retrieves a pointer to the raw MessagePack value of a property in the
+// object state at the current event.
+//
+// cursor      - The cursor.
+// property_id - The property to retrieve.
+// value_ptr   - A pointer to where the value pointer should be returned. This
+//               is NULL if the property is not set.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_cursor_get_state(sky_cursor *cursor, sky_property_id_t property_id,
+                         void **value_ptr)
+{
+    check(cursor != NULL, "Cursor required");
+    check(cursor->track_state, "Cursor is not tracking state");
+    check(value_ptr != NULL, "Value return pointer required");
+
+    *value_ptr = cursor->state[(uint8_t)property_id];
+    return 0;
+
+error:
+    if(value_ptr) *value_ptr = NULL;
+    return -1;
+}
@@ -7,6 +7,8 @@
 
 #include "bstring.h"
 #include "types.h"
+#include "event.h"
+#include "path.h"
 
 
 //==============================================================================
@@ -20,9 +22,69 @@
 // data file. It also abstracts away the underlying storage of the events by
 // seamlessly combining spanned blocks into a single path.
 //
-// The current API to the cursor is simple. It provides forward-only access to
-// basic event data in a path. However, future releases will allow bidirectional
-// traversal, event search, & object state management.
+// The cursor moves forward over the events of a path and can also move
+// backwards with sky_cursor_prev(). Events have a variable length and can
+// store their timestamp as a delta from the event before them, so the events
+// of a path segment cannot be walked backwards from their bytes alone.
+// Instead the first backward move in a segment scans it once and keeps the
+// position and timestamp of each of its events in an index owned by the
+// cursor. Later backward moves in the segment are constant time. Moving
+// back from EOF moves to the last event, so the last events before a time
+// can be read by seeking to it and moving back. The object state cannot be
+// rewound so a cursor that tracks state only moves forward.
+//
+// The cursor can seek forward to the first event at or after a timestamp.
+// Paths that are spanned across many blocks are searched by the first
+// timestamp of each block so seeks into long paths are logarithmic in the
+// number of blocks.
+//
+// Events can store their timestamp as a delta from the event before them so
+// the cursor keeps the timestamp of the current event as it moves. The first
+// event of each path segment stores its full timestamp so the running
+// timestamp restarts at every path.
+//
+// The cursor can also track the state of the object as it moves along the
+// path. The state holds a pointer to the raw MessagePack value of every
+// property indexed by property id. Object property values persist until the
+// property is set again and action property values only last for the event
+// that set them. The state is updated in place on each move so queries can
+// read an object's state at any event in a single pass without replaying
+// earlier events. State tracking never allocates and is off by default.
+// Values from the fixed section of an event are not MessagePack values so
+// they are packed into a slot owned by the cursor and the state points to
+// the slot instead.
+//
+// Aggregation loops can also decode events in batches with
+// sky_cursor_next_batch(). The timestamps, action ids and data sections of
+// up to a given number of events are written to arrays supplied by the
+// caller so the loop over the batch has no function calls or checks.
+//
+// Tight aggregation loops can use the fast iteration macros instead of the
+// functions. They read the raw event bytes directly without any argument or
+// flag validation. Validation of the event flag is only compiled in when
+// SKY_CURSOR_VALIDATE is defined. The functions always check the flag of
+// each event unless the cursor is marked as verified. A cursor should only
+// be marked as verified when its paths come from a block that matched its
+// saved checksum. Blocks without a saved checksum are never verified so
+// their events are still checked. See block.h.
+//
+// Events of action-only data files never have data so they are walked with
+// a separate set of macros. The length of an action-only event only depends
+// on the timestamp bits of its flag and is computed without a branch, and
+// the action id is read without masking it by the action flag.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of state slots. There is one slot for every property id.
+#define SKY_CURSOR_STATE_SIZE 256
+
+// The maximum number of action properties that can be set by one event.
+#define SKY_CURSOR_ACTION_STATE_SIZE 128
 
 
 //==============================================================================
@@ -31,6 +93,9 @@
 //
 //==============================================================================
 
+// The state is indexed by the property id cast to an unsigned byte. The ids
+// of the action properties set by the current event are kept so they can be
+// cleared when the cursor moves.
 typedef struct sky_cursor {
     void **paths;
     uint32_t path_count;
@@ -38,7 +103,20 @@ typedef struct sky_cursor {
     uint32_t event_index;
     void *ptr;
     void *endptr;
+    sky_timestamp_t timestamp;
     bool eof;
+    bool track_state;
+    bool verified;
+    void *state[SKY_CURSOR_STATE_SIZE];
+    uint8_t fixed_state[SKY_CURSOR_STATE_SIZE][SKY_EVENT_DATA_FIXED_PACKED_LENGTH];
+    sky_property_id_t action_state_ids[SKY_CURSOR_ACTION_STATE_SIZE];
+    uint32_t action_state_count;
+    bool index_valid;
+    uint32_t index_path_index;
+    void **index_ptrs;
+    sky_timestamp_t *index_timestamps;
+    uint32_t index_count;
+    uint32_t index_capacity;
 } sky_cursor;
 
 
@@ -76,15 +154,157 @@ int sky_cursor_set_paths(sky_cursor *cursor, void **ptrs, int count);
 
 int sky_cursor_next(sky_cursor *cursor);
 
+int sky_cursor_next_path(sky_cursor *cursor);
+
+int sky_cursor_seek_timestamp(sky_cursor *cursor, sky_timestamp_t timestamp);
+
+bool sky_cursor_has_prev(sky_cursor *cursor);
+
+int sky_cursor_prev(sky_cursor *cursor);
+
+int sky_cursor_next_batch(sky_cursor *cursor, sky_timestamp_t *timestamps,
+    sky_action_id_t *action_ids, void **data_ptrs, uint32_t *data_lengths,
+    uint32_t size, uint32_t *count);
+
 
 //--------------------------------------
 // Event Management
 //--------------------------------------
 
+int sky_cursor_get_timestamp(sky_cursor *cursor, sky_timestamp_t *timestamp);
+
 int sky_cursor_get_action_id(sky_cursor *cursor, sky_action_id_t *action_id);
 
 int sky_cursor_get_data_ptr(sky_cursor *cursor, void **data_ptr,
     uint32_t *data_length);
 
 
+//--------------------------------------
+// State Management
+//--------------------------------------
+
+int sky_cursor_set_track_state(sky_cursor *cursor, bool track_state);
+
+int sky_cursor_update_state(sky_cursor *cursor);
+
+void sky_cursor_clear_state(sky_cursor *cursor);
+
+int sky_cursor_get_state(sky_cursor *cursor, sky_property_id_t property_id,
+    void **value_ptr);
+
+
+//--------------------------------------
+// Fast Iteration
+//--------------------------------------
+
+// Checks that the cursor is pointing at a valid event. This is only compiled
+// in when SKY_CURSOR_VALIDATE is defined.
+//
+// CURSOR - The cursor.
+#ifdef SKY_CURSOR_VALIDATE
+#define sky_cursor_fast_validate(CURSOR) \
+    check((CURSOR)->eof || (*((sky_event_flag_t*)(CURSOR)->ptr) & (SKY_EVENT_FLAG_ACTION|SKY_EVENT_FLAG_DATA)),\
+        "Cursor pointing at invalid raw event data: %p", (CURSOR)->ptr)
+#else
+#define sky_cursor_fast_validate(CURSOR)
+#endif
+
+// Calculates the length of the raw event at a given pointer. The action
+// length is computed from the flag bits and the data length is only read
+// when the event has data.
+//
+// PTR - A pointer to the raw event data.
+#define sky_cursor_fast_sizeof_event(PTR) \
+    (sky_event_header_length(*((sky_event_flag_t*)(PTR))) +\
+    ((*((sky_event_flag_t*)(PTR)) & SKY_EVENT_FLAG_ACTION) * sizeof(sky_action_id_t)) +\
+    ((*((sky_event_flag_t*)(PTR)) & SKY_EVENT_FLAG_DATA) ?\
+        sizeof(sky_event_data_length_t) + *((sky_event_data_length_t*)((PTR) + sky_event_header_length(*((sky_event_flag_t*)(PTR))) +\
+        ((*((sky_event_flag_t*)(PTR)) & SKY_EVENT_FLAG_ACTION) * sizeof(sky_action_id_t)))) : 0))
+
+// Retrieves the action id of the raw event at a given pointer or zero if the
+// event has no action. Every event has at least an action id or a data length
+// after its header so the action id bytes are always safe to read and are
+// masked by the action flag.
+//
+// PTR - A pointer to the raw event data.
+#define sky_cursor_fast_get_action_id(PTR) \
+    ((sky_action_id_t)(*((sky_action_id_t*)((PTR) + sky_event_header_length(*((sky_event_flag_t*)(PTR))))) *\
+    (*((sky_event_flag_t*)(PTR)) & SKY_EVENT_FLAG_ACTION)))
+
+// Moves the cursor to the next event. Moving to the next path or to EOF only
+// happens at the end of a path and is done by a function call. The running
+// timestamp is updated and the object state is updated if the cursor is
+// tracking it.
+//
+// CURSOR - The cursor.
+// MSG    - The error message to display if the cursor cannot move.
+#define sky_cursor_fast_next(CURSOR, MSG) do {\
+    (CURSOR)->ptr += sky_cursor_fast_sizeof_event((CURSOR)->ptr);\
+    (CURSOR)->event_index++;\
+    if((CURSOR)->ptr >= (CURSOR)->endptr) {\
+        check(sky_cursor_next_path(CURSOR) == 0, MSG);\
+    }\
+    else {\
+        (CURSOR)->timestamp = sky_event_get_timestamp((CURSOR)->ptr, (CURSOR)->timestamp);\
+    }\
+    sky_cursor_fast_validate(CURSOR);\
+    if((CURSOR)->track_state && !(CURSOR)->eof) {\
+        check(sky_cursor_update_state(CURSOR) == 0, MSG);\
+    }\
+} while(0)
+
+// Iterates over each event in a single raw path without using a cursor.
+// Callers that need timestamps must keep a running timestamp with
+// sky_event_get_timestamp() since events can store timestamp deltas.
+//
+// PATH_PTR  - A pointer to the raw path.
+// EVENT_PTR - The name of the variable that points at the current event.
+#define sky_path_foreach_event(PATH_PTR, EVENT_PTR) \
+    for(void *EVENT_PTR = (PATH_PTR) + SKY_PATH_HEADER_LENGTH,\
+        *EVENT_PTR##_endptr = (PATH_PTR) + sky_path_sizeof_raw(PATH_PTR);\
+        EVENT_PTR < EVENT_PTR##_endptr;\
+        EVENT_PTR += sky_cursor_fast_sizeof_event(EVENT_PTR))
+
+
+
+//--------------------------------------
+// Action-Only Iteration
+//--------------------------------------
+
+// Calculates the number of bytes used to store the timestamp of an event
+// without a branch. The delta length is zero for a full timestamp so the
+// full length is added in its place.
+//
+// FLAG - The flag of the raw event.
+#define sky_cursor_action_only_timestamp_length(FLAG) \
+    ((size_t)(((FLAG) & SKY_EVENT_DELTA_MASK) >> SKY_EVENT_DELTA_SHIFT) +\
+    ((size_t)(((FLAG) & SKY_EVENT_DELTA_MASK) == 0) * sizeof(sky_timestamp_t)))
+
+// Calculates the length of a raw event from an action-only data file.
+//
+// PTR - A pointer to the raw event data.
+#define sky_cursor_action_only_sizeof_event(PTR) \
+    (sizeof(sky_event_flag_t) +\
+    sky_cursor_action_only_timestamp_length(*((sky_event_flag_t*)(PTR))) +\
+    sizeof(sky_action_id_t))
+
+// Retrieves the action id of a raw event from an action-only data file.
+//
+// PTR - A pointer to the raw event data.
+#define sky_cursor_action_only_get_action_id(PTR) \
+    (*((sky_action_id_t*)((PTR) + sizeof(sky_event_flag_t) +\
+    sky_cursor_action_only_timestamp_length(*((sky_event_flag_t*)(PTR))))))
+
+// Iterates over each event in a single raw path from an action-only data
+// file without using a cursor.
+//
+// PATH_PTR  - A pointer to the raw path.
+// EVENT_PTR - The name of the variable that points at the current event.
+#define sky_path_foreach_action_only_event(PATH_PTR, EVENT_PTR) \
+    for(void *EVENT_PTR = (PATH_PTR) + SKY_PATH_HEADER_LENGTH,\
+        *EVENT_PTR##_endptr = (PATH_PTR) + sky_path_sizeof_raw(PATH_PTR);\
+        EVENT_PTR < EVENT_PTR##_endptr;\
+        EVENT_PTR += sky_cursor_action_only_sizeof_event(EVENT_PTR))
+
+
 #endif
@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+#include "dag_message.h"
+#include "minipack.h"
+#include "stats.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+struct tagbstring SKY_DAG_KEY_PROFILE = bsStatic("profile");
+
+struct tagbstring SKY_DAG_KEY_COMPACT = bsStatic("compact");
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a 'DAG' message object.
+//
+// Returns a new message.
+sky_dag_message *sky_dag_message_create()
+{
+    sky_dag_message *message = NULL;
+    message = calloc(1, sizeof(sky_dag_message)); check_mem(message);
+    return message;
+
+error:
+    sky_dag_message_free(message);
+    return NULL;
+}
+
+// Frees a 'DAG' message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_dag_message_free(sky_dag_message *message)
+{
+    if(message) {
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Serializes a 'DAG' message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_dag_message_pack(sky_dag_message *message, FILE *file)
+{
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    check(minipack_fwrite_map(file, message->profile + message->compact, &sz) == 0, "Unable to pack map");
+    if(message->profile) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_DAG_KEY_PROFILE) == 0, "Unable to pack profile key");
+        check(minipack_fwrite_bool(file, true, &sz) == 0, "Unable to pack profile flag");
+    }
+    if(message->compact) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_DAG_KEY_COMPACT) == 0, "Unable to pack compact key");
+        check(minipack_fwrite_bool(file, true, &sz) == 0, "Unable to pack compact flag");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes a 'DAG' message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_dag_message_unpack(sky_dag_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    bstring key = NULL;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    uint32_t map_length = minipack_fread_map(file, &sz);
+    check(sz > 0, "Unable to read map");
+
+    for(i=0; i<map_length; i++) {
+        rc = sky_minipack_fread_bstring(file, &key);
+        check(rc == 0, "Unable to read map key");
+
+        if(biseq(key, &SKY_DAG_KEY_PROFILE) == 1) {
+            message->profile = minipack_fread_bool(file, &sz);
+            check(sz > 0, "Unable to unpack profile flag");
+        }
+        else if(biseq(key, &SKY_DAG_KEY_COMPACT) == 1) {
+            message->compact = minipack_fread_bool(file, &sz);
+            check(sz > 0, "Unable to unpack compact flag");
+        }
+        else {
+            sentinel("Invalid 'DAG' key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Counts the transitions between the consecutive actions of every path in a
+// table in a single scan. The matrix is sized from the number of actions in
+// the table.
+//
+// message - The message.
+// table   - The table to apply the message to.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_dag_message_process(sky_dag_message *message,
+                            sky_table *table, sky_buffer *output)
+{
+    int rc;
+    sky_query *query = NULL;
+    sky_query_result *result = NULL;
+    sky_query_profile profile;
+    check(message != NULL, "Message required");
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring data_str = bsStatic("data");
+    struct tagbstring count_str = bsStatic("count");
+
+    // Merge buffered events so the query sees them.
+    memset(&profile, 0, sizeof(profile));
+    int64_t t0 = sky_stats_now();
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge table memtable");
+    profile.memtable_time = sky_stats_now() - t0;
+
+    // Build the query.
+    rc = sky_action_file_ensure_loaded(table->action_file);
+    check(rc == 0, "Unable to load actions");
+    query = sky_query_create(); check_mem(query);
+    rc = sky_query_set_transitions(query, table->action_file->action_count);
+    check(rc == 0, "Unable to set query transitions");
+    rc = sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    check(rc == 0, "Unable to add count aggregate");
+
+    result = sky_query_result_create_with_arena(query, message->arena); check_mem(result);
+    result->profile = (message->profile ? &profile : NULL);
+    rc = sky_table_execute_query(table, query, result);
+    check(rc == 0, "Unable to execute 'DAG' query");
+
+    // Return.
+    //   {status:"ok", data:{<action_id>:{<next_action_id>:{count:0}, ...}, ...}}
+    check(sky_buffer_pack_map(output, (message->profile ? 3 : 2)) == 0, "Unable to write root map");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    check(sky_buffer_pack_bstring(output, &data_str) == 0, "Unable to write data key");
+    t0 = sky_stats_now();
+    if(message->compact) {
+        rc = sky_query_result_pack_columns(result, query, NULL, output);
+    }
+    else {
+        rc = sky_query_result_pack(result, query, NULL, output);
+    }
+    check(rc == 0, "Unable to write query result");
+    profile.encode_time = sky_stats_now() - t0;
+
+    if(message->profile) {
+        check(sky_buffer_pack_bstring(output, &SKY_DAG_KEY_PROFILE) == 0, "Unable to write profile key");
+        rc = sky_query_profile_pack(&profile, output);
+        check(rc == 0, "Unable to write query profile");
+    }
+
+    sky_query_result_free(result);
+    sky_query_free(query);
+    return 0;
+
+error:
+    sky_query_result_free(result);
+    sky_query_free(query);
+    return -1;
+}
@@ -0,0 +1,70 @@
+#ifndef _sky_dag_message_h
+#define _sky_dag_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+#include "query.h"
+#include "arena.h"
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for counting the transitions between the consecutive actions of
+// every path in a table. The results are built in the arena if one is set.
+// The arena is not owned by the message.
+//
+// The message is sent as a map of {profile:<bool>, compact:<bool>}. Both
+// flags are optional. The response is
+// {status:"ok", data:{<action_id>:{<next_action_id>:{count:0}, ...}, ...}}
+// where each pair of actions is counted once for every time that the second
+// action immediately followed the first one in a path. A profiled message
+// returns the profile of its query along with the results. A compact
+// message returns the data as parallel columns instead:
+// {names:["count"], keys:<int64[]>, subkeys:<int64[]>, values:<int64[]>}.
+// See sky_query_result_pack_columns() in query.c.
+typedef struct sky_dag_message {
+    sky_arena *arena;
+    bool profile;
+    bool compact;
+} sky_dag_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_dag_message *sky_dag_message_create();
+
+void sky_dag_message_free(sky_dag_message *message);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int sky_dag_message_pack(sky_dag_message *message, FILE *file);
+
+int sky_dag_message_unpack(sky_dag_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_dag_message_process(sky_dag_message *message,
+    sky_table *table, sky_buffer *output);
+
+#endif
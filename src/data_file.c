@@ -1,7 +1,9 @@
 #include <stdlib.h>
 #include <inttypes.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/mman.h>
 
 #include "dbg.h"
@@ -9,6 +11,19 @@
 #include "bstring.h"
 #include "file.h"
 #include "data_file.h"
+#include "path.h"
+#include "path_iterator.h"
+#include "stats.h"
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+// The last write version handed out to a data file or block.
+uint64_t sky_data_file_last_write_version = 0;
+
 
 //==============================================================================
 //
@@ -18,14 +33,49 @@
 
 int sky_data_file_unmap(sky_data_file *data_file);
 
+int sky_data_file_load_extent(sky_data_file *data_file, uint32_t index,
+    size_t data_length);
+
+size_t sky_data_file_get_grow_length(sky_data_file *data_file,
+    sky_data_extent *extent, size_t data_length);
+
+int sky_data_file_advise_extent(sky_data_file *data_file,
+    sky_data_extent *extent);
+
+int sky_data_file_preload_extent(sky_data_file *data_file,
+    sky_data_extent *extent, size_t offset);
+
 int sky_data_file_load_header(sky_data_file *data_file);
 int sky_data_file_unload_header(sky_data_file *data_file);
 int sky_data_file_create_header(sky_data_file *data_file);
+int sky_data_file_load_checksums(sky_data_file *data_file);
+int sky_data_file_load_journal(sky_data_file *data_file);
+
+int sky_data_file_compact_block(sky_data_file *data_file, sky_block *source,
+    size_t target_size, sky_timestamp_t expire_before, sky_block **block,
+    size_t *offset);
+
+int sky_data_file_copy_blocks(sky_data_file *data_file, sky_block ***ret);
+
+int sky_data_file_publish_blocks(sky_data_file *data_file,
+    sky_block **blocks);
+
+int sky_data_file_index_blocks(sky_data_file *data_file, uint32_t start,
+    uint32_t end);
+
+uint32_t sky_data_file_search_blocks(sky_data_file *data_file,
+    sky_object_id_t object_id);
 
-int sky_data_file_normalize(sky_data_file *data_file);
+int sky_data_file_get_object_blocks(sky_data_file *data_file,
+    sky_object_id_t object_id, sky_block ***blocks, uint32_t *block_count);
+
+int sky_data_file_merge_span(sky_data_file *data_file, sky_block **blocks,
+    uint32_t block_count);
 
 int compare_blocks(const void *_a, const void *_b);
 
+int sky_data_file_compare_path_sizes(const void *_a, const void *_b);
+
 
 //==============================================================================
 //
@@ -45,7 +95,12 @@ sky_data_file *sky_data_file_create()
 {
     sky_data_file *data_file = calloc(sizeof(sky_data_file), 1);
     check_mem(data_file);
+    data_file->version = SKY_DATA_FILE_VERSION;
     data_file->block_size = SKY_DEFAULT_BLOCK_SIZE;
+    data_file->extent_block_count = SKY_DEFAULT_EXTENT_BLOCK_COUNT;
+    data_file->block_cache_size = SKY_DATA_FILE_DEFAULT_BLOCK_CACHE_SIZE;
+    data_file->write_version = __sync_add_and_fetch(&sky_data_file_last_write_version, 1);
+    data_file->epoch = sky_epoch_create(); check_mem(data_file->epoch);
     return data_file;
     
 error:
@@ -59,10 +114,14 @@ error:
 void sky_data_file_free(sky_data_file *data_file)
 {
     if(data_file) {
-        if(data_file->path) bdestroy(data_file->path);
-        data_file->path = NULL;
         sky_data_file_unload(data_file);
         sky_data_file_unload_header(data_file);
+        if(data_file->path) bdestroy(data_file->path);
+        data_file->path = NULL;
+        if(data_file->header_path) bdestroy(data_file->header_path);
+        data_file->header_path = NULL;
+        sky_epoch_free(data_file->epoch);
+        data_file->epoch = NULL;
         free(data_file);
     }
 }
@@ -125,8 +184,9 @@ error:
 // Persistence
 //--------------------------------------
 
-// Loads the data file into memory as a memory-mapped file. If the data file
-// is already loaded into memory then it is remapped.
+// Loads the data file into memory by mapping each of its extents. If the
+// data file is already loaded then only the extents whose number of blocks
+// changed are resized and new extents are created as they are needed.
 //
 // data_file - The data file to load.
 //
@@ -134,7 +194,6 @@ error:
 int sky_data_file_load(sky_data_file *data_file)
 {
     int rc;
-    void *ptr;
     check(data_file != NULL, "Data file required");
     check(data_file->path != NULL, "Data file path required");
 
@@ -144,48 +203,191 @@ int sky_data_file_load(sky_data_file *data_file)
         check(rc == 0, "Unable to load header");
     }
 
+    // Create the cache for compressed blocks.
+    if(data_file->block_cache == NULL) {
+        data_file->block_cache = sky_block_cache_create(data_file->block_cache_size);
+        check_mem(data_file->block_cache);
+    }
+
     // There should always be at least one block.
     check(data_file->block_size > 0, "Data file should have at least one block");
-    
-    // Calculate the data length.
-    size_t data_length = data_file->block_count * data_file->block_size;
+    check(data_file->extent_block_count > 0, "Data file extents must have at least one block");
+
+    // A data file written as one large file keeps using it as its first
+    // extent and all extents become that size.
+    bool mapped = (data_file->extents != NULL);
+    if(!mapped) {
+        bstring path = sky_data_file_get_extent_path(data_file, 0); check_mem(path);
+        off_t file_length = (sky_file_exists(path) ? sky_file_get_size(path) : 0);
+        bdestroy(path);
+        uint32_t block_count = file_length / data_file->block_size;
+        if(block_count > data_file->extent_block_count) {
+            data_file->extent_block_count = block_count;
+        }
+    }
+
+    // Determine the number of extents needed to hold every block.
+    uint32_t extent_block_count = data_file->extent_block_count;
+    uint32_t extent_count = (data_file->block_count + extent_block_count - 1) / extent_block_count;
+    if(extent_count == 0) extent_count = 1;
+    // The extent array is copied instead of resized since readers may still
+    // be using the old one.
+    if(extent_count > data_file->extent_count) {
+        sky_data_extent *extents = calloc(extent_count, sizeof(*extents));
+        check_mem(extents);
+        if(data_file->extent_count > 0) {
+            memcpy(extents, data_file->extents, sizeof(*extents) * data_file->extent_count);
+        }
+        sky_data_extent *old_extents = data_file->extents;
+        data_file->extents = extents;
+        data_file->extent_count = extent_count;
+        rc = sky_epoch_retire(data_file->epoch, old_extents, 0, sky_epoch_free_heap);
+        check(rc == 0, "Unable to retire extents");
+    }
+
+    // Load each extent with its share of the blocks.
+    uint32_t i;
+    data_file->data_length = data_file->mapped_length = 0;
+    for(i=0; i<data_file->extent_count; i++) {
+        uint32_t block_count = 0;
+        if(data_file->block_count > i * extent_block_count) {
+            block_count = data_file->block_count - (i * extent_block_count);
+            if(block_count > extent_block_count) block_count = extent_block_count;
+        }
+
+        rc = sky_data_file_load_extent(data_file, i, (size_t)block_count * data_file->block_size);
+        check(rc == 0, "Unable to load extent #%d", i);
+
+        data_file->data_length += data_file->extents[i].data_length;
+        data_file->mapped_length += data_file->extents[i].mapped_length;
+    }
+
+    // Rebuild the blocks that were changed after the last checkpoint.
+    if(data_file->recovery_pending) {
+        rc = sky_data_file_recover(data_file);
+        check(rc == 0, "Unable to recover data file");
+    }
+
+    // Read back the blocks that were in memory when the data file was last
+    // unloaded.
+    if(!mapped) {
+        rc = sky_data_file_warm(data_file);
+        check(rc == 0, "Unable to warm data file");
+    }
+
+    return 0;
+
+error:
+    sky_data_file_unload(data_file);
+    return -1;
+}
 
-    // Close mapping if remapping isn't supported.
-    if(!MREMAP_AVAILABLE) {
-        rc = sky_data_file_unmap(data_file);
-        check(rc == 0, "Unable to unmap data file");
+// Opens and maps a single extent file. The file is resized to the data
+// length and the mapping is only grown if the data no longer fits inside it.
+//
+// data_file   - The data file.
+// index       - The index of the extent.
+// data_length - The number of bytes of blocks stored in the extent.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_load_extent(sky_data_file *data_file, uint32_t index,
+                              size_t data_length)
+{
+    int rc;
+    void *ptr;
+    bstring path = NULL;
+    sky_data_extent *extent = &data_file->extents[index];
+
+    // Nothing needs to change if the extent already holds the data.
+    if(extent->data != NULL && extent->data_length == data_length) {
+        return 0;
+    }
+
+    // Calculate the length of the mapping needed for the data.
+    size_t mapped_length = sky_data_file_get_grow_length(data_file, extent, data_length);
+
+    // A mapping that needs to grow is replaced by a new mapping if remapping
+    // isn't supported or if readers may still be using it. The old mapping
+    // is retired once the new one is in place.
+    void *old_data = NULL;
+    size_t old_mapped_length = 0;
+    if(extent->data != NULL && mapped_length != extent->mapped_length && (!MREMAP_AVAILABLE || sky_epoch_has_readers(data_file->epoch))) {
+        old_data = extent->data;
+        old_mapped_length = extent->mapped_length;
+    }
+
+    // Open the extent file if it is not currently open.
+    bool opened = (extent->fd != 0);
+    if(!opened) {
+        path = sky_data_file_get_extent_path(data_file, index); check_mem(path);
+        extent->fd = open(bdata(path), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+        check(extent->fd != -1, "Failed to open data file descriptor: %s",  bdata(path));
+        bdestroy(path);
+        path = NULL;
     }
 
-    // Open the data file and map it if it is not currently open.
-    if(data_file->data_fd == 0) {
-        data_file->data_fd = open(bdata(data_file->path), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
-        check(data_file->data_fd != -1, "Failed to open data file descriptor: %s",  bdata(data_file->path));
+    // Reserve disk space for the whole mapping without changing the file
+    // size. Not every file system supports this so failures are ignored.
+#if FALLOCATE_AVAILABLE
+    if(mapped_length > extent->mapped_length) {
+        fallocate(extent->fd, FALLOC_FL_KEEP_SIZE, 0, mapped_length);
+    }
+#endif
 
-        // Truncate the file to the appropriate size (larger or smaller).
-        rc = ftruncate(data_file->data_fd, data_length);
+    // Truncate the file to the appropriate size (larger or smaller).
+    if(!opened || data_length != extent->data_length) {
+        rc = ftruncate(extent->fd, data_length);
         check(rc == 0, "Unable to truncate data file");
+    }
 
-        // Memory map the data file.
-        ptr = mmap(0, data_length, PROT_READ | PROT_WRITE, MAP_SHARED, data_file->data_fd, 0);
+    // An extent is mapped once it holds at least one block.
+    if(mapped_length == 0) {
+        ptr = NULL;
+    }
+    // Memory map the extent if it is not mapped yet or is being replaced.
+    else if(extent->data == NULL || old_data != NULL) {
+        ptr = mmap(0, mapped_length, PROT_READ | PROT_WRITE, MAP_SHARED, extent->fd, 0);
         check(ptr != MAP_FAILED, "Unable to memory map data file");
     }
-    // If we already have the data mapped then simply remap it to the
-    // appropriate size.
-    else {
+    // If the mapping is too small then grow it.
+    else if(mapped_length != extent->mapped_length) {
 #if MREMAP_AVAILABLE
-        ptr = mremap(data_file->data, data_file->data_length, data_length, MREMAP_MAYMOVE);
+        ptr = mremap(extent->data, extent->mapped_length, mapped_length, MREMAP_MAYMOVE);
         check(ptr != MAP_FAILED, "Unable to remap data file");
 #endif
     }
+    else {
+        ptr = extent->data;
+    }
+
+    // Update the extent.
+    bool remapped = (ptr != extent->data || mapped_length != extent->mapped_length);
+    if(remapped) sky_stats_add(remaps, 1);
+    size_t old_data_length = (extent->data != NULL ? extent->data_length : 0);
+    extent->data = ptr;
+    extent->data_length = data_length;
+    extent->mapped_length = mapped_length;
+    if(old_data != NULL) {
+        rc = sky_epoch_retire(data_file->epoch, old_data, old_mapped_length, sky_epoch_free_mapping);
+        check(rc == 0, "Unable to retire extent mapping");
+    }
 
-    // Update the data file.
-    data_file->data = ptr;
-    data_file->data_length = data_length;
+    // Advise the kernel about a new mapping and preload any new blocks.
+    if(ptr != NULL) {
+        if(remapped) {
+            rc = sky_data_file_advise_extent(data_file, extent);
+            check(rc == 0, "Unable to advise extent mapping");
+        }
+        if(data_file->preload && data_length > old_data_length) {
+            rc = sky_data_file_preload_extent(data_file, extent, old_data_length);
+            check(rc == 0, "Unable to preload extent");
+        }
+    }
 
     return 0;
 
 error:
-    sky_data_file_unload(data_file);
+    bdestroy(path);
     return -1;
 }
 
@@ -196,6 +398,20 @@ error:
 // Returns 0 if successful, otherwise returns -1.
 int sky_data_file_unload(sky_data_file *data_file)
 {
+    // Flush any changes from an unfinished batch and record which blocks
+    // are in memory.
+    if(data_file->extents != NULL && data_file->blocks != NULL) {
+        sky_data_file_flush(data_file);
+        if(data_file->header_path != NULL) {
+            sky_data_file_save_residency(data_file);
+        }
+    }
+    data_file->batch_depth = 0;
+
+    // Drop the decompressed blocks.
+    sky_block_cache_free(data_file->block_cache);
+    data_file->block_cache = NULL;
+
     // Unload header.
     sky_data_file_unload_header(data_file);
     
@@ -205,215 +421,245 @@ int sky_data_file_unload(sky_data_file *data_file)
     return 0;
 }
 
-// Unmaps the data file but does not unload the header.
+// Unmaps every extent of the data file but does not unload the header.
 //
 // data_file - The data file to save.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_data_file_unmap(sky_data_file *data_file)
 {
-    // Unmap file.
-    if(data_file->data != NULL) {
-        munmap(data_file->data, data_file->data_length);
-    }
-    
-    // Close file descriptor.
-    if(data_file->data_fd != 0) {
-        close(data_file->data_fd);
+    uint32_t i;
+    for(i=0; i<data_file->extent_count; i++) {
+        sky_data_extent *extent = &data_file->extents[i];
+
+        // Unmap file.
+        if(extent->data != NULL) {
+            munmap(extent->data, extent->mapped_length);
+        }
+
+        // Close file descriptor.
+        if(extent->fd > 0) {
+            close(extent->fd);
+        }
     }
+    free(data_file->extents);
     
-    data_file->data_fd = 0;
-    data_file->data = NULL;
+    data_file->extents = NULL;
+    data_file->extent_count = 0;
     data_file->data_length = 0;
+    data_file->mapped_length = 0;
     
     return 0;
 }
 
-
-//--------------------------------------
-// Header File Management
-//--------------------------------------
-
-// Loads header information for the data file.
+// Calculates the length of the mapping needed to hold a given data length
+// in an extent. The current mapping is kept if the data still fits.
+// Otherwise the mapping doubles in size, growing by no more than
+// SKY_DATA_FILE_MAX_GROWTH at a time and never past the size of a full
+// extent, so that a large number of blocks can be added between remaps. A
+// new mapping is sized to fit the data exactly.
 //
-// data_file - The data file object associated with the header file.
+// data_file   - The data file.
+// extent      - The extent being mapped.
+// data_length - The number of bytes that must fit in the mapping.
 //
-// Returns 0 if successful, otherwise returns -1.
-int sky_data_file_load_header(sky_data_file *data_file)
+// Returns the length of the mapping in bytes.
+size_t sky_data_file_get_grow_length(sky_data_file *data_file,
+                                     sky_data_extent *extent,
+                                     size_t data_length)
 {
-    int rc;
-    size_t sz;
-    FILE *file;
-    uint32_t version = 1;
-    uint8_t buffer[SKY_BLOCK_HEADER_SIZE];
-
-    // Unload existing header information.
-    rc = sky_data_file_unload_header(data_file);
-    check(rc == 0, "Unable to unload header");
+    size_t mapped_length = extent->mapped_length;
+    if(extent->data == NULL || mapped_length == 0) {
+        return data_length;
+    }
+    if(data_length <= mapped_length) {
+        return mapped_length;
+    }
 
-    // If header doesn't exist then create a new one.
-    if(!sky_file_exists(data_file->header_path)) {
-        rc = sky_data_file_create_header(data_file);
-        check(rc == 0, "Unable to create header file");
+    size_t growth = mapped_length;
+    if(growth > SKY_DATA_FILE_MAX_GROWTH) {
+        growth = SKY_DATA_FILE_MAX_GROWTH;
     }
-    
-    file = fopen(bdata(data_file->header_path), "r");
-    check(file, "Failed to open header file for reading: %s",  bdata(data_file->header_path));
+    mapped_length += growth;
 
-    // Read database format version.
-    rc = fread(&version, sizeof(version), 1, file);
-    check(rc == 1, "Unable to read version");
+    // Grow to at least the data length and keep the mapping aligned to
+    // whole blocks.
+    if(mapped_length < data_length) {
+        mapped_length = data_length;
+    }
+    if(mapped_length % data_file->block_size > 0) {
+        mapped_length += data_file->block_size - (mapped_length % data_file->block_size);
+    }
 
-    // Read block size.
-    rc = fread(&data_file->block_size, sizeof(data_file->block_size), 1, file);
-    check(rc == 1, "Unable to read block size");
+    // Extents never hold more than a fixed number of blocks.
+    size_t max_length = (size_t)data_file->extent_block_count * data_file->block_size;
+    if(mapped_length > max_length) {
+        mapped_length = max_length;
+    }
 
-    // Read blocks until end of file.
-    off_t file_length = sky_file_get_size(data_file->header_path);
-    while(ftell(file) < file_length && !feof(file)) {
-        sky_block *block = sky_block_create(data_file); check_mem(block);
-        block->index = data_file->block_count;
+    return mapped_length;
+}
 
-        // Read into buffer.
-        rc = fread(buffer, SKY_BLOCK_HEADER_SIZE, 1, file);
-        check(rc == 1, "Unable to read block #%d", block->index);
-        
-        // Unpack from buffer.
-        rc = sky_block_unpack(block, buffer, &sz);
-        check(rc == 0, "Unable to unpack block #%d", block->index);
-        
-        // Append to blocks
-        data_file->block_count++;
-        data_file->blocks = realloc(data_file->blocks, sizeof(sky_block*) * data_file->block_count);
-        check_mem(data_file->blocks);
-        data_file->blocks[data_file->block_count-1] = block;
+// Determines the path of an extent file. The first extent uses the data
+// file's path and later extents append their index to it (e.g. "data.1").
+//
+// data_file - The data file.
+// index     - The index of the extent.
+//
+// Returns the path of the extent file.
+bstring sky_data_file_get_extent_path(sky_data_file *data_file, uint32_t index)
+{
+    if(index == 0) {
+        return bstrcpy(data_file->path);
     }
+    else {
+        return bformat("%s.%d", bdata(data_file->path), index);
+    }
+}
 
-    // Close the file.
-    fclose(file);
+// Determines the path of the checksum file, which is the header's path with
+// a ".crc" suffix.
+//
+// data_file - The data file.
+//
+// Returns the path of the checksum file.
+bstring sky_data_file_get_checksum_path(sky_data_file *data_file)
+{
+    return bformat("%s.crc", bdata(data_file->header_path));
+}
 
-    rc = sky_data_file_normalize(data_file);
-    check(rc == 0, "Unable to normalize data file");
-    
+// Determines the path of the journal file, which is the header's path with a
+// ".journal" suffix.
+//
+// data_file - The data file.
+//
+// Returns the path of the journal file.
+bstring sky_data_file_get_journal_path(sky_data_file *data_file)
+{
+    return bformat("%s.journal", bdata(data_file->header_path));
+}
 
-    return 0;
+// Determines the path of the residency file, which is the header's path
+// with a ".hot" suffix.
+//
+// data_file - The data file.
+//
+// Returns the path of the residency file.
+bstring sky_data_file_get_residency_path(sky_data_file *data_file)
+{
+    return bformat("%s.hot", bdata(data_file->header_path));
+}
+
+// Finds the extent and offset of a pointer into the mapped data file.
+//
+// data_file - The data file.
+// ptr       - A pointer into one of the data file's extents.
+// index     - A pointer to where the extent index is returned.
+// offset    - A pointer to where the offset within the extent is returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_get_ptr_position(sky_data_file *data_file, void *ptr,
+                                   uint32_t *index, size_t *offset)
+{
+    uint32_t i;
+    for(i=0; i<data_file->extent_count; i++) {
+        sky_data_extent *extent = &data_file->extents[i];
+        if(extent->data != NULL && ptr >= extent->data && ptr < extent->data + extent->mapped_length) {
+            *index = i;
+            *offset = ptr - extent->data;
+            return 0;
+        }
+    }
+    sentinel("Pointer is outside of the data file");
 
 error:
-    if(file) fclose(file);
-    sky_data_file_unload_header(data_file);
+    *index = 0;
+    *offset = 0;
     return -1;
 }
 
-// Unloads header information from memory.
+
+// Starts a batch of changes on the data file. While a batch is open, blocks
+// and header entries are flagged as dirty instead of being synced to disk on
+// every change. Batches can be nested and the changes are flushed when the
+// outermost batch ends.
 //
-// data_file - The data file object associated with the header file.
+// data_file - The data file.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_data_file_unload_header(sky_data_file *data_file)
+int sky_data_file_begin_batch(sky_data_file *data_file)
 {
     check(data_file != NULL, "Data file required");
-    
-    if(data_file->blocks) {
-        uint32_t i;
-        for(i=0; i<data_file->block_count; i++) {
-            sky_block *block = data_file->blocks[i];
-            if(block) {
-                sky_block_free(block);
-                data_file->blocks[i] = NULL;
-            }
-        }
-        free(data_file->blocks);
-    }
-    data_file->blocks = NULL;
-    data_file->block_count = 0;
-    
+    data_file->batch_depth++;
     return 0;
-    
+
 error:
     return -1;
 }
 
-// Creates a new header file. The header file will only be created if one
-// does not already exist.
+// Ends a batch of changes on the data file. If this is the outermost batch
+// then all dirty blocks and header entries are flushed to disk.
 //
-// data_file - The data file object associated with the header file.
+// data_file - The data file.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_data_file_create_header(sky_data_file *data_file)
+int sky_data_file_end_batch(sky_data_file *data_file)
 {
     int rc;
     check(data_file != NULL, "Data file required");
-    check(data_file->header_path != NULL, "Data file header path required");
-    check(!sky_file_exists(data_file->header_path), "Header file already exists");
-
-    // Open the file for writing.
-    FILE *file = fopen(bdata(data_file->header_path), "w");
-    check(file, "Failed to open header file for writing: %s",  bdata(data_file->header_path));
+    check(data_file->batch_depth > 0, "No batch in progress");
 
-    // Write database format version.
-    uint32_t version = SKY_DATA_FILE_VERSION;
-    rc = fwrite(&version, sizeof(version), 1, file);
-    check(rc == 1, "Unable to write version");
+    data_file->batch_depth--;
+    if(data_file->batch_depth == 0) {
+        rc = sky_data_file_flush(data_file);
+        check(rc == 0, "Unable to flush data file");
+    }
 
-    // Write block size.
-    rc = fwrite(&data_file->block_size, sizeof(data_file->block_size), 1, file);
-    check(rc == 1, "Unable to write block size");
-    
-    // Write a single empty block.
-    uint8_t *buffer[SKY_BLOCK_HEADER_SIZE];
-    memset(buffer, 0, SKY_BLOCK_HEADER_SIZE);
-    rc = fwrite(buffer, SKY_BLOCK_HEADER_SIZE, 1, file);
-    check(rc == 1, "Unable to write initial block header");
-    
-    // Close file.
-    fclose(file);
-    
     return 0;
-    
+
 error:
-    if(file) fclose(file);
     return -1;
 }
 
-//--------------------------------------
-// Block Management
-//--------------------------------------
-
-// Appends an empty block at the end of the data file.
+// Syncs every dirty block to disk, writes the dirty header and checksum
+// entries and then empties the journal. Block data is synced first so that
+// the header never references data that has not been written. In async mode
+// the block data is only scheduled to be written by the kernel.
 //
 // data_file - The data file.
-// ret       - A pointer to where the new block should be returned to.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_data_file_create_block(sky_data_file *data_file, sky_block **ret)
+int sky_data_file_flush(sky_data_file *data_file)
 {
     int rc;
-    
-    // Increment block count and resize block memory.
-    data_file->block_count++;
-    data_file->blocks = realloc(data_file->blocks, sizeof(sky_block*) * data_file->block_count);
-    if(data_file->block_count > 0) check_mem(data_file->blocks);
-
-    // Create new block.
-    sky_block *block = sky_block_create(data_file); check_mem(block);
-    block->index = data_file->block_count-1;
-    data_file->blocks[data_file->block_count-1] = block;
+    uint32_t i;
+    check(data_file != NULL, "Data file required");
 
-    // Remap data file.
-    rc = sky_data_file_load(data_file);
-    check(rc == 0, "Unable to reload data file");
+    for(i=0; i<data_file->block_count; i++) {
+        if(data_file->blocks[i]->dirty) {
+            rc = sky_block_sync(data_file->blocks[i]);
+            check(rc == 0, "Unable to sync block #%d", data_file->blocks[i]->index);
+        }
+    }
 
-    // Clear block.
-    void *ptr;
-    rc = sky_block_get_ptr(block, &ptr);
-    check(rc == 0, "Unable to retrieve block pointer");
-    memset(ptr, 0, data_file->block_size);
+    rc = sky_data_file_write_headers(data_file);
+    check(rc == 0, "Unable to write header entries");
+    rc = sky_data_file_write_checksums(data_file);
+    check(rc == 0, "Unable to write checksum entries");
+    rc = sky_data_file_checkpoint(data_file);
+    check(rc == 0, "Unable to checkpoint data file");
+
+    // Take a residency snapshot every few minutes in case the process does
+    // not get to unload the data file.
+    if(data_file->extents != NULL && time(NULL) - data_file->residency_saved_at >= SKY_DATA_FILE_RESIDENCY_INTERVAL) {
+        rc = sky_data_file_save_residency(data_file);
+        check(rc == 0, "Unable to save residency");
+    }
 
-    // Re-sort blocks.
-    qsort(data_file->blocks, data_file->block_count, sizeof(sky_block*), compare_blocks);
+    data_file->unflushed_event_count = 0;
 
-    // Return the new block.
-    *ret = block;
+    // Release the memory that readers were holding on to.
+    sky_epoch_reclaim(data_file->epoch);
 
     return 0;
 
@@ -421,232 +667,2271 @@ error:
     return -1;
 }
 
-// Finds the correct block to add an event to.
+// Determines whether changes to the data file are currently deferred rather
+// than synced immediately.
 //
-// Insertion has several rules to ensure consistency. There are two types of
-// blocks: single object blocks and multi-object blocks. Single object blocks
-// are spans of two or more blocks that have a single object. Multi-object
-// blocks are single blocks that have multiple object ids. An object that is
-// stored in a single block (i.e. doesn't span blocks) is considered a
-// multi-object block since there is probably room to add more objects.
-// 
-// 1. An object id range is unique to a block. If a block has object ids 5 - 8
-//    then no other block can overlap into those ids.
-//
-// 2. Only multi-object blocks can have object ids outside its range added.
-//
-// 3. Objects are added to the first block where the object id is included in
-//    the object id range or is less than the minimum object id of the block.
+// data_file - The data file.
 //
-// 4. If no block is found by the end then the last block is used for insertion.
+// Returns true if blocks should only be flagged as dirty.
+bool sky_data_file_is_deferred(sky_data_file *data_file)
+{
+    return (data_file->batch_depth > 0 || data_file->durability != SKY_DURABILITY_STRICT);
+}
+
+// Changes the durability mode of the data file. Outstanding changes are
+// flushed first so that switching to strict mode leaves nothing unsynced.
 //
-// data_file - The data file that the event is being added to.
-// event     - The event to add to the table.
-// ret       - A pointer to where the insertion block is returned to.
+// data_file  - The data file.
+// durability - The new durability mode.
 //
-// Returns 0 if successfully finds a block. Otherwise returns -1.
-int sky_data_file_find_insertion_block(sky_data_file *data_file,
-                                       sky_event *event,
-                                       sky_block **ret)
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_set_durability(sky_data_file *data_file,
+                                 sky_durability_e durability)
 {
     int rc;
     check(data_file != NULL, "Data file required");
-    check(event != NULL, "Event required");
-    check(event->object_id != 0, "Event object id required");
-    
-    // Initialize return value to NULL.
-    *ret = NULL;
+
+    if(data_file->durability != durability) {
+        if(data_file->extents != NULL && data_file->blocks != NULL) {
+            rc = sky_data_file_flush(data_file);
+            check(rc == 0, "Unable to flush data file");
+        }
+        data_file->durability = durability;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Journal
+//--------------------------------------
+
+// Records a block in the journal before it is first changed after the last
+// checkpoint. In strict mode the journal is synced so that the entry is on
+// disk before the change to the block.
+//
+// data_file - The data file.
+// block     - The block that is about to be changed.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_journal_block(sky_data_file *data_file, sky_block *block)
+{
+    int rc;
+    check(data_file != NULL, "Data file required");
+    check(block != NULL, "Block required");
+    if(block->journaled) {
+        return 0;
+    }
+    check(data_file->journal_fd > 0, "Journal file is not open");
+
+    uint32_t index = block->index;
+    off_t offset = ((off_t)data_file->journal_length) * ((off_t)sizeof(index));
+    ssize_t bytes_written = pwrite(data_file->journal_fd, &index, sizeof(index), offset);
+    check(bytes_written == (ssize_t)sizeof(index), "Unable to write journal entry");
+    if(data_file->durability == SKY_DURABILITY_STRICT) {
+        rc = fsync(data_file->journal_fd);
+        check(rc == 0, "Unable to sync journal");
+    }
+
+    data_file->journal_length++;
+    block->journaled = true;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Empties the journal once every dirty header and checksum entry has been
+// written. In strict mode the header and checksum files are synced first so
+// that the journal is never emptied before the entries that it protects are
+// on disk.
+//
+// data_file - The data file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_checkpoint(sky_data_file *data_file)
+{
+    int rc;
+    uint32_t i;
+    check(data_file != NULL, "Data file required");
+    if(data_file->journal_length == 0) {
+        return 0;
+    }
+    check(data_file->journal_fd > 0, "Journal file is not open");
+
+    if(data_file->durability == SKY_DURABILITY_STRICT) {
+        rc = fsync(data_file->header_fd);
+        check(rc == 0, "Unable to sync header file");
+        if(data_file->checksum_fd > 0) {
+            rc = fsync(data_file->checksum_fd);
+            check(rc == 0, "Unable to sync checksum file");
+        }
+    }
+    rc = ftruncate(data_file->journal_fd, 0);
+    check(rc == 0, "Unable to truncate journal");
+
+    data_file->journal_length = 0;
+    for(i=0; i<data_file->block_count; i++) {
+        data_file->blocks[i]->journaled = false;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Rebuilds the ranges of the blocks listed in the journal that was found
+// when the header was loaded. The blocks are also synced again so that
+// their checksums match their contents. Entries for blocks that are not in
+// the header are ignored. New blocks have their header entries written
+// before anything is moved into them so those blocks were still empty.
+//
+// data_file - The loaded data file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_recover(sky_data_file *data_file)
+{
+    int rc;
+    uint32_t i;
+    bool batching = false;
+    uint32_t *indices = NULL;
+    check(data_file != NULL, "Data file required");
+    check(data_file->extents != NULL, "Data file must be mapped");
+
+    // Read the journal.
+    uint32_t count = data_file->journal_length;
+    if(count > 0) {
+        indices = malloc(sizeof(*indices) * count); check_mem(indices);
+        ssize_t bytes_read = pread(data_file->journal_fd, indices, sizeof(*indices) * count, 0);
+        check(bytes_read == (ssize_t)(sizeof(*indices) * count), "Unable to read journal");
+    }
+
+    // Rebuild the ranges of each block once. The block list is indexed by
+    // position so the blocks are found by their index in the slab.
+    rc = sky_data_file_begin_batch(data_file);
+    check(rc == 0, "Unable to begin batch");
+    batching = true;
+    for(i=0; i<count; i++) {
+        if(indices[i] >= data_file->block_slab_count) {
+            continue;
+        }
+        sky_block *block = &data_file->block_slab[indices[i]];
+        if(block->dirty) {
+            continue;
+        }
+
+        // The checksum may be from before the change to the block.
+        block->checksum_verified = true;
+        rc = sky_block_full_update(block);
+        check(rc == 0, "Unable to recover block #%d", block->index);
+        block->dirty = true;
+        block->journaled = true;
+    }
+    free(indices);
+    indices = NULL;
+
+    // Flushing writes the rebuilt header entries and empties the journal.
+    data_file->recovery_pending = false;
+    batching = false;
+    rc = sky_data_file_end_batch(data_file);
+    check(rc == 0, "Unable to flush recovered blocks");
+
+    return 0;
+
+error:
+    if(batching) sky_data_file_end_batch(data_file);
+    free(indices);
+    return -1;
+}
+
+
+//--------------------------------------
+// Memory Advice
+//--------------------------------------
+
+// Changes the access pattern that the mappings are advised with. Extents
+// that are mapped later are advised with the same pattern.
+//
+// data_file      - The data file.
+// access_pattern - The new access pattern.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_set_access_pattern(sky_data_file *data_file,
+                                     sky_access_pattern_e access_pattern)
+{
+    int rc;
+    uint32_t i;
+    check(data_file != NULL, "Data file required");
+
+    if(data_file->access_pattern != access_pattern) {
+        data_file->access_pattern = access_pattern;
+        for(i=0; i<data_file->extent_count && data_file->extents != NULL; i++) {
+            rc = sky_data_file_advise_extent(data_file, &data_file->extents[i]);
+            check(rc == 0, "Unable to advise extent #%d", i);
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Changes whether blocks are preloaded as they are mapped. Turning
+// preloading on preloads the blocks that are already mapped.
+//
+// data_file - The data file.
+// preload   - Whether blocks are preloaded.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_set_preload(sky_data_file *data_file, bool preload)
+{
+    int rc;
+    uint32_t i;
+    check(data_file != NULL, "Data file required");
+
+    if(data_file->preload != preload) {
+        data_file->preload = preload;
+        for(i=0; preload && i<data_file->extent_count && data_file->extents != NULL; i++) {
+            rc = sky_data_file_preload_extent(data_file, &data_file->extents[i], 0);
+            check(rc == 0, "Unable to preload extent #%d", i);
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Changes whether the mappings ask for transparent huge pages. Mappings
+// that already have huge pages keep them when this is turned off.
+//
+// data_file  - The data file.
+// huge_pages - Whether huge pages are requested.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_set_huge_pages(sky_data_file *data_file, bool huge_pages)
+{
+    int rc;
+    uint32_t i;
+    check(data_file != NULL, "Data file required");
+
+    if(data_file->huge_pages != huge_pages) {
+        data_file->huge_pages = huge_pages;
+        for(i=0; i<data_file->extent_count && data_file->extents != NULL; i++) {
+            rc = sky_data_file_advise_extent(data_file, &data_file->extents[i]);
+            check(rc == 0, "Unable to advise extent #%d", i);
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Advises the kernel of the access pattern of an extent mapping and asks
+// for huge pages if they are enabled. Huge pages are only a hint so the
+// request is ignored if the file system does not support them.
+//
+// data_file - The data file.
+// extent    - The extent.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_advise_extent(sky_data_file *data_file,
+                                sky_data_extent *extent)
+{
+    int rc;
+    if(extent->data == NULL || extent->mapped_length == 0) {
+        return 0;
+    }
+
+    int advice = MADV_NORMAL;
+    switch(data_file->access_pattern) {
+        case SKY_ACCESS_PATTERN_SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+        case SKY_ACCESS_PATTERN_RANDOM: advice = MADV_RANDOM; break;
+        default: break;
+    }
+    rc = madvise(extent->data, extent->mapped_length, advice);
+    check(rc == 0, "Unable to advise extent access pattern");
+
+#if HUGEPAGE_AVAILABLE
+    madvise(extent->data, extent->mapped_length, (data_file->huge_pages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE));
+#endif
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Reads the blocks of an extent after an offset into memory ahead of time.
+// Where the kernel supports it the page tables are filled in as well so
+// reading the blocks does not fault. Preloading is only a hint so failures
+// are ignored.
+//
+// data_file - The data file.
+// extent    - The extent.
+// offset    - The number of bytes at the start of the extent to skip.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_preload_extent(sky_data_file *data_file,
+                                 sky_data_extent *extent, size_t offset)
+{
+    check(data_file != NULL, "Data file required");
+    if(extent->data == NULL || offset >= extent->data_length) {
+        return 0;
+    }
+
+    // Advice must start on a page boundary.
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    offset &= ~(page_size-1);
+
+#if POPULATE_AVAILABLE
+    if(madvise(extent->data + offset, extent->data_length - offset, MADV_POPULATE_READ) == 0) {
+        return 0;
+    }
+#endif
+    madvise(extent->data + offset, extent->data_length - offset, MADV_WILLNEED);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Submits a range of blocks to the data file's prefetcher. Blocks that are
+// stored next to each other are submitted as one request. Nothing is done
+// if the data file has no prefetcher.
+//
+// data_file   - The data file.
+// blocks      - The block array that the positions refer to.
+// start_index - The position of the first block to read.
+// end_index   - The position after the last block to read.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_prefetch_blocks(sky_data_file *data_file,
+                                  sky_block **blocks, uint32_t start_index,
+                                  uint32_t end_index)
+{
+    int rc;
+    uint32_t i;
+    void *ptr = NULL;
+    void *run_ptr = NULL;
+    size_t run_length = 0;
+    check(data_file != NULL, "Data file required");
+    if(data_file->prefetcher == NULL) {
+        return 0;
+    }
+
+    for(i=start_index; i<end_index; i++) {
+        rc = sky_block_get_raw_ptr(blocks[i], &ptr);
+        check(rc == 0, "Unable to retrieve block pointer");
+
+        // Extend the current run if the block follows it on disk.
+        if(run_ptr != NULL && ptr == run_ptr + run_length) {
+            run_length += data_file->block_size;
+        }
+        else {
+            rc = sky_prefetcher_submit(data_file->prefetcher, run_ptr, run_length);
+            check(rc == 0, "Unable to submit blocks");
+            run_ptr = ptr;
+            run_length = data_file->block_size;
+        }
+    }
+
+    rc = sky_prefetcher_submit(data_file->prefetcher, run_ptr, run_length);
+    check(rc == 0, "Unable to submit blocks");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Records which blocks are in the page cache. A block is recorded if any of
+// its pages are resident.
+//
+// data_file - The loaded data file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_save_residency(sky_data_file *data_file)
+{
+    int rc;
+    uint32_t i;
+    uint8_t *bitmap = NULL;
+    unsigned char *pages = NULL;
+    bstring path = NULL;
+    check(data_file != NULL, "Data file required");
+    check(data_file->extents != NULL, "Data file must be mapped");
+
+    size_t bitmap_length = (data_file->block_count + 7) / 8;
+    bitmap = calloc(1, bitmap_length + 1); check_mem(bitmap);
+
+    // Read the residency of every page of each extent at once.
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    for(i=0; i<data_file->extent_count; i++) {
+        sky_data_extent *extent = &data_file->extents[i];
+        if(extent->data == NULL || extent->data_length == 0) {
+            continue;
+        }
+        size_t page_count = (extent->data_length + page_size - 1) / page_size;
+        free(pages);
+        pages = malloc(page_count); check_mem(pages);
+        rc = mincore(extent->data, extent->data_length, pages);
+        check(rc == 0, "Unable to determine residency of extent #%d", i);
+
+        uint32_t j;
+        for(j=0; j<data_file->block_count; j++) {
+            sky_block *block = data_file->blocks[j];
+            if(block->index / data_file->extent_block_count != i) {
+                continue;
+            }
+            size_t offset = ((size_t)data_file->block_size) * (block->index % data_file->extent_block_count);
+            size_t page = offset / page_size;
+            size_t end_page = (offset + data_file->block_size + page_size - 1) / page_size;
+            if(end_page > page_count) end_page = page_count;
+            for(; page<end_page; page++) {
+                if(pages[page] & 1) {
+                    bitmap[block->index / 8] |= (1 << (block->index % 8));
+                    break;
+                }
+            }
+        }
+    }
+
+    path = sky_data_file_get_residency_path(data_file); check_mem(path);
+    rc = sky_file_write(path, bitmap, bitmap_length);
+    check(rc == 0, "Unable to write residency file: %s", bdata(path));
+    data_file->residency_saved_at = time(NULL);
+
+    free(bitmap);
+    free(pages);
+    bdestroy(path);
+    return 0;
+
+error:
+    free(bitmap);
+    free(pages);
+    bdestroy(path);
+    return -1;
+}
+
+// Reads the blocks recorded in the residency file back into memory. Runs of
+// consecutive blocks are submitted to the prefetcher as one range, or are
+// left for the kernel to read ahead if the data file has no prefetcher.
+// Nothing is read if the residency file does not exist.
+//
+// data_file - The loaded data file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_warm(sky_data_file *data_file)
+{
+    int rc;
+    uint32_t i;
+    void *ptr = NULL;
+    void *run_ptr = NULL;
+    size_t run_length = 0;
+    uint8_t *bitmap = NULL;
+    size_t bitmap_length = 0;
+    bstring path = NULL;
+    check(data_file != NULL, "Data file required");
+    check(data_file->extents != NULL, "Data file must be mapped");
+
+    data_file->residency_saved_at = time(NULL);
+    path = sky_data_file_get_residency_path(data_file); check_mem(path);
+    if(!sky_file_exists(path)) {
+        bdestroy(path);
+        return 0;
+    }
+    rc = sky_file_read(path, (void**)&bitmap, &bitmap_length);
+    check(rc == 0, "Unable to read residency file: %s", bdata(path));
+
+    // Blocks are located by index so the last run is sent after the loop.
+    uint32_t block_count = (bitmap_length * 8 < data_file->block_count ? bitmap_length * 8 : data_file->block_count);
+    for(i=0; i<=block_count; i++) {
+        ptr = NULL;
+        if(i < block_count && (bitmap[i / 8] & (1 << (i % 8)))) {
+            sky_data_extent *extent = &data_file->extents[i / data_file->extent_block_count];
+            ptr = extent->data + ((size_t)data_file->block_size) * (i % data_file->extent_block_count);
+        }
+
+        // Extend the current run if the block follows it on disk.
+        if(ptr != NULL && run_ptr != NULL && ptr == run_ptr + run_length) {
+            run_length += data_file->block_size;
+            continue;
+        }
+        if(run_ptr != NULL) {
+            if(data_file->prefetcher != NULL) {
+                rc = sky_prefetcher_submit(data_file->prefetcher, run_ptr, run_length);
+                check(rc == 0, "Unable to submit blocks");
+            }
+            else {
+                madvise(run_ptr, run_length, MADV_WILLNEED);
+            }
+        }
+        run_ptr = ptr;
+        run_length = (ptr != NULL ? data_file->block_size : 0);
+    }
+
+    free(bitmap);
+    bdestroy(path);
+    return 0;
+
+error:
+    free(bitmap);
+    bdestroy(path);
+    return -1;
+}
+
+
+//--------------------------------------
+// Header File Management
+//--------------------------------------
+
+// Loads header information for the data file. The whole header file is read
+// with a single read and the file descriptor is kept open so that header
+// entries can be written back in place.
+//
+// data_file - The data file object associated with the header file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_load_header(sky_data_file *data_file)
+{
+    int rc;
+    size_t sz;
+    uint8_t *buffer = NULL;
+
+    // Unload existing header information.
+    rc = sky_data_file_unload_header(data_file);
+    check(rc == 0, "Unable to unload header");
+
+    // If header doesn't exist then create a new one.
+    if(!sky_file_exists(data_file->header_path)) {
+        rc = sky_data_file_create_header(data_file);
+        check(rc == 0, "Unable to create header file");
+    }
+    
+    data_file->header_fd = open(bdata(data_file->header_path), O_RDWR);
+    check(data_file->header_fd != -1, "Failed to open header file: %s",  bdata(data_file->header_path));
+
+    // Read the entire header into memory.
+    off_t file_length = sky_file_get_size(data_file->header_path);
+    check(file_length >= 0, "Unable to determine header file size: %s", bdata(data_file->header_path));
+    check((size_t)file_length >= SKY_HEADER_FILE_HDR_SIZE, "Header file is truncated: %s", bdata(data_file->header_path));
+    buffer = malloc(file_length); check_mem(buffer);
+
+    // A short read fails the load rather than dropping the entries that
+    // were not read.
+    ssize_t bytes_read = pread(data_file->header_fd, buffer, file_length, 0);
+    check(bytes_read >= 0, "Unable to read header file: %s", bdata(data_file->header_path));
+    check((size_t)bytes_read == (size_t)file_length, "Short read of header file: %s", bdata(data_file->header_path));
+
+    // Read database format version and block size.
+    uint8_t *ptr = buffer;
+    memcpy(&data_file->version, ptr, sizeof(data_file->version));
+    ptr += sizeof(data_file->version);
+    check(data_file->version >= SKY_DATA_FILE_WIDE_OBJECT_ID_VERSION, "Data file format version %d must be migrated: %s", data_file->version, bdata(data_file->header_path));
+    memcpy(&data_file->block_size, ptr, sizeof(data_file->block_size));
+    ptr += sizeof(data_file->block_size);
+
+    // Unpack each block.
+    uint32_t block_count = (file_length - ((off_t)SKY_HEADER_FILE_HDR_SIZE)) / ((off_t)SKY_BLOCK_HEADER_SIZE);
+    if(block_count > 0) {
+        data_file->blocks = calloc(block_count, sizeof(sky_block*));
+        check_mem(data_file->blocks);
+        data_file->block_slab = malloc(block_count * sizeof(sky_block));
+        check_mem(data_file->block_slab);
+        data_file->block_slab_count = block_count;
+    }
+    uint32_t i;
+    for(i=0; i<block_count; i++) {
+        sky_block *block = &data_file->block_slab[i];
+        sky_block_init(block, data_file);
+        block->index = i;
+        data_file->blocks[i] = block;
+        data_file->block_count++;
+
+        rc = sky_block_unpack(block, ptr, &sz);
+        check(rc == 0, "Unable to unpack block #%d", block->index);
+        ptr += sz;
+    }
+
+    free(buffer);
+    buffer = NULL;
+
+    rc = sky_data_file_load_checksums(data_file);
+    check(rc == 0, "Unable to load block checksums");
+    rc = sky_data_file_load_journal(data_file);
+    check(rc == 0, "Unable to load journal");
+
+    rc = sky_data_file_normalize(data_file);
+    check(rc == 0, "Unable to normalize data file");
+
+    return 0;
+
+error:
+    free(buffer);
+    sky_data_file_unload_header(data_file);
+    return -1;
+}
+
+// Unloads header information from memory.
+//
+// data_file - The data file object associated with the header file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_unload_header(sky_data_file *data_file)
+{
+    check(data_file != NULL, "Data file required");
+    
+    // Blocks that were loaded from the header belong to the slab. Blocks
+    // created since then were allocated on their own.
+    if(data_file->blocks) {
+        uint32_t i;
+        sky_block *slab_end = data_file->block_slab + data_file->block_slab_count;
+        for(i=0; i<data_file->block_count; i++) {
+            sky_block *block = data_file->blocks[i];
+            if(block >= data_file->block_slab && block < slab_end) {
+                sky_block_uninit(block);
+            }
+            else {
+                sky_block_free(block);
+            }
+            data_file->blocks[i] = NULL;
+        }
+        free(data_file->blocks);
+    }
+    free(data_file->block_slab);
+    free(data_file->block_min_object_ids);
+    free(data_file->block_max_object_ids);
+    data_file->blocks = NULL;
+    data_file->block_count = 0;
+    data_file->block_slab = NULL;
+    data_file->block_slab_count = 0;
+    data_file->block_min_object_ids = NULL;
+    data_file->block_max_object_ids = NULL;
+    data_file->block_range_count = 0;
+
+    // Close header file descriptor.
+    if(data_file->header_fd > 0) {
+        close(data_file->header_fd);
+    }
+    data_file->header_fd = 0;
+    if(data_file->checksum_fd > 0) {
+        close(data_file->checksum_fd);
+    }
+    data_file->checksum_fd = 0;
+    if(data_file->journal_fd > 0) {
+        close(data_file->journal_fd);
+    }
+    data_file->journal_fd = 0;
+    data_file->journal_length = 0;
+    data_file->recovery_pending = false;
+    
+    return 0;
+    
+error:
+    return -1;
+}
+
+// Opens the checksum file and reads the saved checksum of each loaded
+// block. The checksum file is created if it does not exist. Blocks past the
+// end of the file do not have a saved checksum and are not verified.
+//
+// data_file - The data file whose header has been loaded.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_load_checksums(sky_data_file *data_file)
+{
+    int rc;
+    uint32_t i;
+    uint8_t *buffer = NULL;
+    bstring path = sky_data_file_get_checksum_path(data_file); check_mem(path);
+
+    data_file->checksum_fd = open(bdata(path), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    check(data_file->checksum_fd != -1, "Failed to open checksum file: %s", bdata(path));
+
+    // Read the entries of the loaded blocks in one read.
+    uint32_t entry_count = sky_file_get_size(path) / ((off_t)SKY_BLOCK_CHECKSUM_SIZE);
+    if(entry_count > data_file->block_count) {
+        entry_count = data_file->block_count;
+    }
+    if(entry_count > 0) {
+        size_t length = entry_count * ((size_t)SKY_BLOCK_CHECKSUM_SIZE);
+        buffer = malloc(length); check_mem(buffer);
+        rc = pread(data_file->checksum_fd, buffer, length, 0);
+        check(rc == (int)length, "Unable to read checksum file: %s", bdata(path));
+        for(i=0; i<entry_count; i++) {
+            sky_block_unpack_checksum(data_file->blocks[i], buffer + (i * ((size_t)SKY_BLOCK_CHECKSUM_SIZE)));
+        }
+    }
+
+    free(buffer);
+    bdestroy(path);
+    return 0;
+
+error:
+    free(buffer);
+    bdestroy(path);
+    return -1;
+}
+
+// Opens the journal file. The file is created if it does not exist. Entries
+// left in the journal are blocks that were changed after the last
+// checkpoint and are recovered once the data file is mapped.
+//
+// data_file - The data file whose header has been loaded.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_load_journal(sky_data_file *data_file)
+{
+    bstring path = sky_data_file_get_journal_path(data_file); check_mem(path);
+
+    data_file->journal_fd = open(bdata(path), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    check(data_file->journal_fd != -1, "Failed to open journal file: %s", bdata(path));
+    data_file->journal_length = sky_file_get_size(path) / ((off_t)sizeof(uint32_t));
+    data_file->recovery_pending = (data_file->journal_length > 0);
+
+    bdestroy(path);
+    return 0;
+
+error:
+    bdestroy(path);
+    return -1;
+}
+
+// Creates a new header file. The header file will only be created if one
+// does not already exist.
+//
+// data_file - The data file object associated with the header file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_create_header(sky_data_file *data_file)
+{
+    int rc;
+    check(data_file != NULL, "Data file required");
+    check(data_file->header_path != NULL, "Data file header path required");
+    check(!sky_file_exists(data_file->header_path), "Header file already exists");
+
+    // Open the file for writing.
+    FILE *file = fopen(bdata(data_file->header_path), "w");
+    check(file, "Failed to open header file for writing: %s",  bdata(data_file->header_path));
+
+    // Write database format version.
+    data_file->version = SKY_DATA_FILE_VERSION;
+    rc = fwrite(&data_file->version, sizeof(data_file->version), 1, file);
+    check(rc == 1, "Unable to write version");
+
+    // Write block size.
+    rc = fwrite(&data_file->block_size, sizeof(data_file->block_size), 1, file);
+    check(rc == 1, "Unable to write block size");
+    
+    // Write a single empty block.
+    uint8_t *buffer[SKY_BLOCK_HEADER_SIZE];
+    memset(buffer, 0, SKY_BLOCK_HEADER_SIZE);
+    rc = fwrite(buffer, SKY_BLOCK_HEADER_SIZE, 1, file);
+    check(rc == 1, "Unable to write initial block header");
+    
+    // Close file.
+    fclose(file);
+    
+    return 0;
+    
+error:
+    if(file) fclose(file);
+    return -1;
+}
+
+// Writes all dirty header entries to the header file. Dirty entries are
+// written as a single contiguous range covering the lowest and highest dirty
+// block indices so that a batch of changes costs one write.
+//
+// data_file - The data file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_write_headers(sky_data_file *data_file)
+{
+    int rc;
+    uint32_t i;
+    size_t sz;
+    uint8_t *buffer = NULL;
+    check(data_file != NULL, "Data file required");
+
+    // Determine the range of dirty header entries.
+    bool dirty = false;
+    uint32_t min_index = 0, max_index = 0;
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block *block = data_file->blocks[i];
+        if(block->header_dirty) {
+            if(!dirty || block->index < min_index) min_index = block->index;
+            if(!dirty || block->index > max_index) max_index = block->index;
+            dirty = true;
+        }
+    }
+    if(!dirty) {
+        return 0;
+    }
+    check(data_file->header_fd > 0, "Header file is not open");
+
+    // Pack every entry in the range from the in-memory blocks.
+    size_t length = (max_index - min_index + 1) * ((size_t)SKY_BLOCK_HEADER_SIZE);
+    buffer = calloc(1, length); check_mem(buffer);
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block *block = data_file->blocks[i];
+        if(block->index >= min_index && block->index <= max_index) {
+            rc = sky_block_pack(block, buffer + ((block->index - min_index) * ((size_t)SKY_BLOCK_HEADER_SIZE)), &sz);
+            check(rc == 0, "Unable to pack block header data");
+        }
+    }
+
+    // Write the range in place.
+    off_t offset = ((uint32_t)SKY_HEADER_FILE_HDR_SIZE) + (min_index * ((uint32_t)SKY_BLOCK_HEADER_SIZE));
+    rc = pwrite(data_file->header_fd, buffer, length, offset);
+    check(rc == (int)length, "Unable to write header entries");
+    sky_stats_add(header_writes, 1);
+
+    for(i=0; i<data_file->block_count; i++) {
+        data_file->blocks[i]->header_dirty = false;
+    }
+
+    free(buffer);
+    return 0;
+
+error:
+    free(buffer);
+    return -1;
+}
+
+// Recalculates the checksums of the blocks that were synced since their
+// checksums were last calculated and then writes all dirty checksum entries
+// to the checksum file as a single range covering the lowest and highest
+// dirty block indices.
+//
+// data_file - The data file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_write_checksums(sky_data_file *data_file)
+{
+    int rc;
+    uint32_t i;
+    uint8_t *buffer = NULL;
+    check(data_file != NULL, "Data file required");
+
+    // Determine the range of dirty checksum entries.
+    bool dirty = false;
+    uint32_t min_index = 0, max_index = 0;
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block *block = data_file->blocks[i];
+        if(block->checksum_stale) {
+            rc = sky_block_update_checksum(block);
+            check(rc == 0, "Unable to update checksum of block #%d", block->index);
+        }
+        if(block->checksum_dirty) {
+            if(!dirty || block->index < min_index) min_index = block->index;
+            if(!dirty || block->index > max_index) max_index = block->index;
+            dirty = true;
+        }
+    }
+    if(!dirty) {
+        return 0;
+    }
+    check(data_file->checksum_fd > 0, "Checksum file is not open");
+
+    // Pack every entry in the range from the in-memory blocks.
+    size_t length = (max_index - min_index + 1) * ((size_t)SKY_BLOCK_CHECKSUM_SIZE);
+    buffer = calloc(1, length); check_mem(buffer);
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block *block = data_file->blocks[i];
+        if(block->index >= min_index && block->index <= max_index) {
+            sky_block_pack_checksum(block, buffer + ((block->index - min_index) * ((size_t)SKY_BLOCK_CHECKSUM_SIZE)));
+        }
+    }
+
+    // Write the range in place.
+    off_t offset = ((off_t)min_index) * ((off_t)SKY_BLOCK_CHECKSUM_SIZE);
+    rc = pwrite(data_file->checksum_fd, buffer, length, offset);
+    check(rc == (int)length, "Unable to write checksum entries");
+
+    for(i=0; i<data_file->block_count; i++) {
+        data_file->blocks[i]->checksum_dirty = false;
+    }
+
+    free(buffer);
+    return 0;
+
+error:
+    free(buffer);
+    return -1;
+}
+
+
+//--------------------------------------
+// Block Management
+//--------------------------------------
+
+// Appends an empty block at the end of the data file.
+//
+// data_file - The data file.
+// ret       - A pointer to where the new block should be returned to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_create_block(sky_data_file *data_file, sky_block **ret)
+{
+    return sky_data_file_create_blocks(data_file, 1, ret);
+}
+
+// Appends several empty blocks at the end of the data file. The data file is
+// remapped once for all of the blocks so pointers into the data file only
+// need to be restored once after a split.
+//
+// The header entries of the new blocks are written and the blocks are
+// journaled before they are returned, whether or not the data file is
+// deferring changes. A split moves paths into the new blocks straight
+// away so a crash before the next checkpoint must find them in the header
+// and in the journal for their ranges to be rebuilt.
+//
+// data_file - The data file.
+// count     - The number of blocks to create.
+// ret       - An array of where the new blocks should be returned to. The
+//             blocks are returned in the order of their block index.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_create_blocks(sky_data_file *data_file, uint32_t count,
+                                sky_block **ret)
+{
+    int rc;
+    uint32_t i;
+    check(data_file != NULL, "Data file required");
+    check(count > 0, "Block count must be greater than zero");
+    check(ret != NULL, "Block return array required");
+
+    // Copy the block array instead of resizing it since readers may still
+    // be using the old one.
+    sky_block **blocks = malloc(sizeof(sky_block*) * (data_file->block_count + count));
+    check_mem(blocks);
+    if(data_file->block_count > 0) {
+        memcpy(blocks, data_file->blocks, sizeof(sky_block*) * data_file->block_count);
+    }
+    sky_block **old_blocks = data_file->blocks;
+    data_file->blocks = blocks;
+    rc = sky_epoch_retire(data_file->epoch, old_blocks, 0, sky_epoch_free_heap);
+    check(rc == 0, "Unable to retire block array");
+
+    // Create new blocks.
+    for(i=0; i<count; i++) {
+        sky_block *block = sky_block_create(data_file); check_mem(block);
+        block->index = data_file->block_count;
+        block->position = data_file->block_count;
+        data_file->blocks[data_file->block_count] = block;
+        data_file->block_count++;
+        ret[i] = block;
+    }
+    rc = sky_data_file_index_blocks(data_file, data_file->block_count - count, data_file->block_count);
+    check(rc == 0, "Unable to index new blocks");
+
+    // Remap data file.
+    rc = sky_data_file_load(data_file);
+    check(rc == 0, "Unable to reload data file");
+
+    for(i=0; i<count; i++) {
+        // Clear block.
+        void *ptr;
+        rc = sky_block_get_ptr(ret[i], &ptr);
+        check(rc == 0, "Unable to retrieve block pointer");
+        memset(ptr, 0, data_file->block_size);
+
+        // Move the empty block into sorted order.
+        rc = sky_data_file_sort_block(data_file, ret[i]);
+        check(rc == 0, "Unable to sort new block");
+    }
+
+    // Persist the new blocks before any data is moved into them.
+    for(i=0; i<count; i++) {
+        rc = sky_block_write_header(ret[i]);
+        check(rc == 0, "Unable to write header entry of new block");
+    }
+    if(data_file->durability == SKY_DURABILITY_STRICT) {
+        rc = fsync(data_file->header_fd);
+        check(rc == 0, "Unable to sync header file");
+    }
+    for(i=0; i<count; i++) {
+        rc = sky_data_file_journal_block(data_file, ret[i]);
+        check(rc == 0, "Unable to journal new block");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Finds the correct block to add an event to.
+//
+// Insertion has several rules to ensure consistency. There are two types of
+// blocks: single object blocks and multi-object blocks. Single object blocks
+// are spans of two or more blocks that have a single object. Multi-object
+// blocks are single blocks that have multiple object ids. An object that is
+// stored in a single block (i.e. doesn't span blocks) is considered a
+// multi-object block since there is probably room to add more objects.
+// 
+// 1. An object id range is unique to a block. If a block has object ids 5 - 8
+//    then no other block can overlap into those ids.
+//
+// 2. Only multi-object blocks can have object ids outside its range added.
+//
+// 3. Objects are added to the first block where the object id is included in
+//    the object id range or is less than the minimum object id of the block.
+//
+// 4. If no block is found by the end then the last block is used for insertion.
+//
+// data_file - The data file that the event is being added to.
+// event     - The event to add to the table.
+// ret       - A pointer to where the insertion block is returned to.
+//
+// Returns 0 if successfully finds a block. Otherwise returns -1.
+int sky_data_file_find_insertion_block(sky_data_file *data_file,
+                                       sky_event *event,
+                                       sky_block **ret)
+{
+    int rc;
+    check(data_file != NULL, "Data file required");
+    check(event != NULL, "Event required");
+    check(event->object_id != 0, "Event object id required");
+    
+    // Initialize return value to NULL.
+    *ret = NULL;
+    
+    // Extract object id and timestamp from event.
+    sky_object_id_t object_id = event->object_id;
+    sky_timestamp_t timestamp = event->timestamp;
+
+    // Find the first block whose range ends at or after the object id. No
+    // block before this one can be used for insertion.
+    uint32_t lo = sky_data_file_search_blocks(data_file, object_id);
+
+    // Loop over sorted blocks from there to find the appropriate insertion
+    // point.
+    uint32_t i;
+    sky_block *block = NULL;
+    for(i=lo; i<data_file->block_count; i++) {
+        block = data_file->blocks[i];
+        
+        // If block is within range then use the block.
+        if(object_id >= data_file->block_min_object_ids[i] && object_id <= data_file->block_max_object_ids[i]) {
+            // If this is a single object block then find the appropriate block
+            // based on timestamp.
+            if(block->spanned) {
+                // Find first block where timestamp is before the max.
+                while(i<data_file->block_count && data_file->block_min_object_ids[i] == object_id) {
+                    if(timestamp <= data_file->blocks[i]->max_timestamp) {
+                        *ret = data_file->blocks[i];
+                        break;
+                    }
+                    i++;
+                }
+                
+                // If this event is being appended to the object path then use
+                // the last block.
+                if(*ret == NULL) {
+                    *ret = data_file->blocks[i-1];
+                }
+
+                break;
+            }
+            // If this is a multi-object block then simply use it.
+            else {
+                *ret = block;
+                break;
+            }
+        }
+        // If block is before this object id range, then use the block if it
+        // is a multi-object block.
+        else if(object_id < data_file->block_min_object_ids[i] && !block->spanned) {
+            *ret = block;
+            break;
+        }
+    }
+    
+    // If we haven't found a block then it means that the object id is after all
+    // other object ids or that we are inserting before a single object block or
+    // that we have no blocks.
+    if(*ret == NULL) {
+        // Find the last block if one exists.
+        sky_block *last_block = (data_file->block_count > 0 ? data_file->blocks[data_file->block_count-1] : NULL);
+        
+        // If the last block available is unspanned then use it.
+        if(last_block != NULL && !last_block->spanned) {
+            *ret = last_block;
+        }
+        // Otherwise just create a new block.
+        else {
+            rc = sky_data_file_create_block(data_file, ret);
+            check(rc == 0, "Unable to create block");
+        }
+    }
+    
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sorts the blocks and updates the block information to mark blocks as
+// spanned or not.
+//
+// data_file - The data file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_normalize(sky_data_file *data_file)
+{
+    int rc;
+    sky_block **blocks = NULL;
+
+    // Sort ranges by starting object id. Blocks are usually already in
+    // order, such as after compaction, so they are checked first.
+    uint32_t i;
+    bool sorted = true;
+    for(i=1; i<data_file->block_count && sorted; i++) {
+        sorted = (compare_blocks(&data_file->blocks[i-1], &data_file->blocks[i]) <= 0);
+    }
+    if(!sorted) {
+        rc = sky_data_file_copy_blocks(data_file, &blocks);
+        check(rc == 0, "Unable to copy block array");
+        qsort(blocks, data_file->block_count, sizeof(*blocks), compare_blocks);
+        rc = sky_data_file_publish_blocks(data_file, blocks);
+        check(rc == 0, "Unable to publish block array");
+    }
+
+    // Determine spanned blocks.
+    for(i=0; i<data_file->block_count; i++) {
+        data_file->blocks[i]->position = i;
+        data_file->blocks[i]->spanned = false;
+    }
+    rc = sky_data_file_index_blocks(data_file, 0, data_file->block_count);
+    check(rc == 0, "Unable to index blocks");
+
+    sky_object_id_t last_object_id = -1;
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block *block = data_file->blocks[i];
+        
+        // If this is a single object block then track the object id to
+        // possibly mark it as spanned.
+        if(block->min_object_id == block->max_object_id && block->min_object_id > 0) {
+            // If it has spanned since the last block then mark it and the
+            // previous block.
+            if(block->min_object_id == last_object_id) {
+                block->spanned = true;
+                data_file->blocks[i-1]->spanned = true;
+            }
+            // If this is the first block with one object then store the id.
+            else {
+                last_object_id = block->min_object_id;
+            }
+        }
+        // Clear out last object id for multi-object blocks.
+        else {
+            last_object_id = -1;
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Moves a specific number of bytes from a given pointer to a newly created
+// block. The pointer passed in may change if the data file is remapped to a
+// different memory location.
+//
+// data_file - The data file that contains the pointer.
+// ptr       - A pointer to a location on the data file.
+// sz        - The number of bytes to move to a new block.
+// new_block - A pointer to where the new block should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_move_to_new_block(sky_data_file *data_file, void **ptr,
+                                    size_t sz, sky_block **new_block)
+{
+    int rc;
+    check(data_file != NULL, "Data file required");
+
+    // Store position before data file remap.
+    uint32_t extent_index;
+    size_t ptr_off;
+    rc = sky_data_file_get_ptr_position(data_file, *ptr, &extent_index, &ptr_off);
+    check(rc == 0, "Unable to determine pointer position");
+
+    // Create block.
+    rc = sky_data_file_create_block(data_file, new_block);
+    check(rc == 0, "Unable to create new block");
+    
+    // Restore pointers in case remap relocated data.
+    *ptr = data_file->extents[extent_index].data + ptr_off;
+
+    // Retrieve new block's pointer.
+    void *new_block_ptr = NULL;
+    rc = sky_block_get_ptr(*new_block, &new_block_ptr);
+    check(rc == 0, "Unable to determine new block pointer");
+    
+    // Copy over everything since the checkpoint.
+    memmove(new_block_ptr, (*ptr), sz);
+
+    // Clear out data from the source block.
+    memset((*ptr), 0, sz);
+    
+    // Perform a full update on the block header. This is probably not
+    // needed but we're going to be safe. The amortized cost of this
+    // should be small considering splits shouldn't happen often.
+    rc = sky_block_full_update(*new_block);
+    check(rc == 0, "Unable to update block ranges on new block");
+
+    return 0;
     
-    // Extract object id and timestamp from event.
-    sky_object_id_t object_id = event->object_id;
-    sky_timestamp_t timestamp = event->timestamp;
+error:
+    return -1;
+}
+
+
+// Splits the sorted blocks of the data file into a number of contiguous
+// ranges of roughly equal size that can be scanned independently. Ranges
+// never start in the middle of a span so that a spanned path is always
+// scanned as a whole by the range that contains its first block. Some
+// ranges may be empty if the data file has few blocks.
+//
+// data_file       - The data file.
+// partition_count - The number of ranges to split the blocks into.
+// boundaries      - An array of partition_count+1 elements where the block
+//                   position that starts each range is returned. The last
+//                   element is the block count.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_get_partitions(sky_data_file *data_file,
+                                 uint32_t partition_count,
+                                 uint32_t *boundaries)
+{
+    check(data_file != NULL, "Data file required");
+    check(partition_count > 0, "At least one partition required");
+    check(boundaries != NULL, "Boundaries array required");
+
+    uint32_t i;
+    sky_block **blocks = data_file->blocks;
+    uint32_t block_count = data_file->block_count;
+    boundaries[0] = 0;
+    for(i=1; i<partition_count; i++) {
+        uint32_t index = (uint32_t)(((uint64_t)block_count * i) / partition_count);
+        if(index < boundaries[i-1]) {
+            index = boundaries[i-1];
+        }
+
+        // Move past any span that the boundary falls into.
+        while(index > 0 && index < block_count &&
+              blocks[index]->spanned && blocks[index-1]->spanned &&
+              blocks[index]->min_object_id == blocks[index-1]->min_object_id)
+        {
+            index++;
+        }
+        boundaries[i] = index;
+    }
+    boundaries[partition_count] = block_count;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Path Lookup
+//--------------------------------------
+
+// Finds the path of a single object. The block is located with a binary
+// search over the object id ranges of the blocks. A spanned path returns one
+// pointer for each of its blocks while a path in a multi-object block is
+// found by scanning the block after its bloom filter has been checked.
+//
+// data_file  - The data file.
+// object_id  - The object id.
+// paths      - A pointer to where an array of raw path pointers should be
+//              returned. The caller owns the array. This is NULL if the object
+//              has no path.
+// path_count - A pointer to where the number of paths should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_find_path(sky_data_file *data_file,
+                            sky_object_id_t object_id, void ***paths,
+                            uint32_t *path_count)
+{
+    int rc;
+    uint32_t i;
+    check(data_file != NULL, "Data file required");
+    check(paths != NULL, "Paths return pointer required");
+    check(path_count != NULL, "Path count return pointer required");
+    *paths = NULL;
+    *path_count = 0;
+
+    // Find the first block whose range ends at or after the object id.
+    uint32_t lo = sky_data_file_search_blocks(data_file, object_id);
+    if(lo == data_file->block_count || data_file->block_min_object_ids[lo] > object_id) {
+        return 0;
+    }
+    sky_block *block = data_file->blocks[lo];
+
+    // A spanned path starts at the beginning of each of its blocks.
+    if(block->spanned) {
+        uint32_t span_count;
+        rc = sky_block_get_span_count(block, &span_count);
+        check(rc == 0, "Unable to calculate span count");
+
+        *paths = malloc(sizeof(void*) * span_count); check_mem(*paths);
+        for(i=0; i<span_count; i++) {
+            rc = sky_block_get_ptr(data_file->blocks[lo+i], &(*paths)[i]);
+            check(rc == 0, "Unable to retrieve block pointer");
+        }
+        *path_count = span_count;
+    }
+    // Otherwise search the block for the path.
+    else {
+        void *ptr = NULL;
+        rc = sky_block_find_path(block, object_id, &ptr);
+        check(rc == 0, "Unable to find path in block");
+
+        if(ptr != NULL) {
+            *paths = malloc(sizeof(void*)); check_mem(*paths);
+            (*paths)[0] = ptr;
+            *path_count = 1;
+        }
+    }
+
+    return 0;
+
+error:
+    free(*paths);
+    *paths = NULL;
+    *path_count = 0;
+    return -1;
+}
+
+
+//--------------------------------------
+// Compaction
+//--------------------------------------
+
+// Rewrites the data file with its paths packed densely in object id order.
+// Paths are copied into a new data file next to the current one and each
+// block is filled up to the fill factor before the next block is started.
+// Spanned paths keep one block per part. The new files then replace the
+// current files so the block indices follow the object id order and the
+// header only lists the compacted blocks. Events older than the expiry
+// cutoff are left out so partially expired paths are trimmed.
+//
+// data_file     - The data file to compact.
+// fill_factor   - The percentage of each block to fill, from 1 to 100.
+// expire_before - The timestamp before which events are dropped. Zero keeps
+//                 every event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_compact(sky_data_file *data_file, uint32_t fill_factor,
+                          sky_timestamp_t expire_before)
+{
+    int rc;
+    uint32_t i;
+    bool batching = false;
+    sky_data_file *target = NULL;
+    sky_access_pattern_e access_pattern = SKY_ACCESS_PATTERN_NORMAL;
+    check(data_file != NULL, "Data file required");
+    access_pattern = data_file->access_pattern;
+    check(data_file->blocks != NULL && data_file->extents != NULL, "Data file must be loaded");
+    check(fill_factor > 0 && fill_factor <= 100, "Fill factor must be between 1 and 100");
+
+    // Flush outstanding changes before the blocks are copied.
+    rc = sky_data_file_flush(data_file);
+    check(rc == 0, "Unable to flush data file");
+
+    // The blocks are read once from start to end.
+    rc = sky_data_file_set_access_pattern(data_file, SKY_ACCESS_PATTERN_SEQUENTIAL);
+    check(rc == 0, "Unable to set compaction access pattern");
+
+    // Create the compacted data file and remove anything that was left over
+    // from an interrupted compaction.
+    target = sky_data_file_create(); check_mem(target);
+    target->block_size = data_file->block_size;
+    target->extent_block_count = data_file->extent_block_count;
+    target->action_only = data_file->action_only;
+    target->path = bformat("%s.compact", bdata(data_file->path));
+    check_mem(target->path);
+    target->header_path = bformat("%s.compact", bdata(data_file->header_path));
+    check_mem(target->header_path);
+    rc = sky_data_file_remove_files(target);
+    check(rc == 0, "Unable to remove old compaction files");
+    rc = sky_data_file_load(target);
+    check(rc == 0, "Unable to load compacted data file");
+
+    // Copy the paths of each block in order.
+    rc = sky_data_file_begin_batch(target);
+    check(rc == 0, "Unable to begin batch");
+    batching = true;
+    size_t target_size = ((size_t)data_file->block_size * fill_factor) / 100;
+    sky_block *block = target->blocks[0];
+    size_t offset = 0;
+    for(i=0; i<data_file->block_count; i++) {
+        rc = sky_data_file_compact_block(target, data_file->blocks[i], target_size, expire_before, &block, &offset);
+        check(rc == 0, "Unable to compact block #%d", data_file->blocks[i]->index);
+        sky_data_file_release_cache(data_file);
+    }
+    rc = sky_block_save(block);
+    check(rc == 0, "Unable to save compacted block");
+    rc = sky_block_full_update(block);
+    check(rc == 0, "Unable to update compacted block");
+    batching = false;
+    rc = sky_data_file_end_batch(target);
+    check(rc == 0, "Unable to flush compacted data file");
+    uint32_t extent_count = target->extent_count;
+    sky_data_file_unload(target);
+
+    // Replace the current files with the compacted files.
+    sky_data_file_unload(data_file);
+    rc = sky_data_file_replace_files(data_file, target, extent_count);
+    check(rc == 0, "Unable to replace data file with compacted data file");
+
+    // Load the compacted data file.
+    rc = sky_data_file_load(data_file);
+    check(rc == 0, "Unable to reload data file");
+    rc = sky_data_file_set_access_pattern(data_file, access_pattern);
+    check(rc == 0, "Unable to restore access pattern");
+
+    sky_data_file_free(target);
+    return 0;
+
+error:
+    if(batching) sky_data_file_end_batch(target);
+    if(data_file != NULL) sky_data_file_set_access_pattern(data_file, access_pattern);
+    sky_data_file_free(target);
+    return -1;
+}
+
+// Copies the paths of a block into the end of a data file that is being
+// compacted. A new block is started when a path would fill the current
+// block past the target size. Each part of a spanned path is copied into a
+// block of its own. Events are sorted by timestamp so the expired events of
+// a path are always at its start. The first event that is kept is copied
+// with its full timestamp and the rest are copied as is.
+//
+// data_file     - The data file being compacted into.
+// source        - The block to copy the paths from.
+// target_size   - The number of bytes to fill each block with.
+// expire_before - The timestamp before which events are dropped. Zero keeps
+//                 every event.
+// block         - A pointer to the block being filled. This is updated when
+//                 a new block is started.
+// offset        - A pointer to the number of bytes used in the block being
+//                 filled.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_compact_block(sky_data_file *data_file, sky_block *source,
+                                size_t target_size,
+                                sky_timestamp_t expire_before,
+                                sky_block **block, size_t *offset)
+{
+    int rc;
+    void *block_ptr = NULL;
+    void *path_ptr = NULL;
+
+    sky_path_iterator iterator;
+    sky_path_iterator_init(&iterator);
+    rc = sky_path_iterator_set_block(&iterator, source);
+    check(rc == 0, "Unable to set path iterator block");
+
+    while(!iterator.eof) {
+        rc = sky_path_iterator_get_ptr(&iterator, &path_ptr);
+        check(rc == 0, "Unable to retrieve path pointer");
+        size_t sz = sky_path_sizeof_raw(path_ptr);
+
+        // Skip past the expired events.
+        void *events_ptr = path_ptr + SKY_PATH_HEADER_LENGTH;
+        void *end_ptr = path_ptr + sz;
+        void *kept_ptr = events_ptr;
+        sky_timestamp_t timestamp = 0;
+        while(expire_before != 0 && kept_ptr < end_ptr) {
+            timestamp = sky_event_get_timestamp(kept_ptr, timestamp);
+            if(timestamp >= expire_before) {
+                break;
+            }
+            kept_ptr += sky_event_sizeof_raw(kept_ptr);
+        }
+        if(kept_ptr == end_ptr) {
+            rc = sky_path_iterator_next(&iterator);
+            check(rc == 0, "Unable to move to next path");
+            continue;
+        }
+        size_t first_length = sky_event_sizeof_raw(kept_ptr);
+        size_t event_data_length = (size_t)(end_ptr - kept_ptr);
+        if(kept_ptr > events_ptr) {
+            event_data_length += (SKY_EVENT_HEADER_LENGTH) - sky_event_header_length(*((sky_event_flag_t*)kept_ptr));
+            sz = SKY_PATH_HEADER_LENGTH + event_data_length;
+        }
+
+        // Start a new block if the path does not fit or if either the path
+        // or the current block is part of a span.
+        bool is_full = (*offset > 0 && (*offset + sz > target_size || source->spanned || (*block)->spanned));
+        if(is_full) {
+            rc = sky_block_save(*block);
+            check(rc == 0, "Unable to save compacted block");
+            rc = sky_block_full_update(*block);
+            check(rc == 0, "Unable to update compacted block");
+            rc = sky_data_file_create_block(data_file, block);
+            check(rc == 0, "Unable to create compacted block");
+            *offset = 0;
+        }
+
+        // Copy the path.
+        rc = sky_block_get_ptr(*block, &block_ptr);
+        check(rc == 0, "Unable to retrieve compacted block pointer");
+        if(kept_ptr == events_ptr) {
+            memcpy(block_ptr + *offset, path_ptr, sz);
+        }
+        else {
+            size_t _sz;
+            void *ptr = block_ptr + *offset;
+            rc = sky_path_pack_hdr(*((sky_object_id_t*)path_ptr), (uint32_t)event_data_length, ptr, &_sz);
+            check(rc == 0, "Unable to pack path header");
+            ptr += _sz;
+            rc = sky_event_pack_raw(kept_ptr, timestamp, ptr, &_sz);
+            check(rc == 0, "Unable to pack first event");
+            ptr += _sz;
+            memcpy(ptr, kept_ptr + first_length, end_ptr - (kept_ptr + first_length));
+        }
+        *offset += sz;
+        (*block)->spanned = source->spanned;
+
+        rc = sky_path_iterator_next(&iterator);
+        check(rc == 0, "Unable to move to next path");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Replaces the header, checksum, residency and extent files of a data file
+// with the files of another data file. Extents of the data file past the
+// last extent of the source and the journals of both are removed. Neither
+// data file can be loaded.
+//
+// data_file    - The data file to replace.
+// source       - The data file whose files replace it.
+// extent_count - The number of extents in the source.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_replace_files(sky_data_file *data_file,
+                                sky_data_file *source, uint32_t extent_count)
+{
+    int rc;
+    uint32_t i;
+    bstring src = NULL;
+    bstring dest = NULL;
+    check(data_file != NULL, "Data file required");
+    check(source != NULL, "Source data file required");
+    check(data_file->extents == NULL && source->extents == NULL, "Data files cannot be loaded");
+
+    for(i=0; i<extent_count; i++) {
+        src = sky_data_file_get_extent_path(source, i); check_mem(src);
+        dest = sky_data_file_get_extent_path(data_file, i); check_mem(dest);
+        rc = rename(bdata(src), bdata(dest));
+        check(rc == 0, "Unable to replace extent: %s", bdata(dest));
+        bdestroy(src); src = NULL;
+        bdestroy(dest); dest = NULL;
+    }
+    while(true) {
+        dest = sky_data_file_get_extent_path(data_file, i++); check_mem(dest);
+        if(!sky_file_exists(dest)) break;
+        rc = sky_file_rm(dest);
+        check(rc == 0, "Unable to remove extent: %s", bdata(dest));
+        bdestroy(dest); dest = NULL;
+    }
+    bdestroy(dest); dest = NULL;
+    rc = rename(bdata(source->header_path), bdata(data_file->header_path));
+    check(rc == 0, "Unable to replace header: %s", bdata(data_file->header_path));
+
+    // The old checksums cannot be kept since they are for the old blocks.
+    src = sky_data_file_get_checksum_path(source); check_mem(src);
+    dest = sky_data_file_get_checksum_path(data_file); check_mem(dest);
+    if(sky_file_exists(src)) {
+        rc = rename(bdata(src), bdata(dest));
+        check(rc == 0, "Unable to replace checksums: %s", bdata(dest));
+    }
+    else {
+        rc = sky_file_rm(dest);
+        check(rc == 0, "Unable to remove checksums: %s", bdata(dest));
+    }
+    bdestroy(src); src = NULL;
+    bdestroy(dest); dest = NULL;
+
+    // The blocks of the source were just written so its residency file
+    // replaces the one of the old blocks.
+    src = sky_data_file_get_residency_path(source); check_mem(src);
+    dest = sky_data_file_get_residency_path(data_file); check_mem(dest);
+    if(sky_file_exists(src)) {
+        rc = rename(bdata(src), bdata(dest));
+        check(rc == 0, "Unable to replace residency file: %s", bdata(dest));
+    }
+    else {
+        rc = sky_file_rm(dest);
+        check(rc == 0, "Unable to remove residency file: %s", bdata(dest));
+    }
+    bdestroy(src); src = NULL;
+    bdestroy(dest); dest = NULL;
+
+    // The source was flushed so neither journal has anything to recover.
+    src = sky_data_file_get_journal_path(source); check_mem(src);
+    dest = sky_data_file_get_journal_path(data_file); check_mem(dest);
+    rc = sky_file_rm(src);
+    check(rc == 0, "Unable to remove journal: %s", bdata(src));
+    rc = sky_file_rm(dest);
+    check(rc == 0, "Unable to remove journal: %s", bdata(dest));
+    bdestroy(src);
+    bdestroy(dest);
+
+    return 0;
+
+error:
+    bdestroy(src);
+    bdestroy(dest);
+    return -1;
+}
+
+// Removes the header, checksum, journal, residency and extent files of a
+// data file from disk.
+//
+// data_file - The data file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_remove_files(sky_data_file *data_file)
+{
+    int rc;
+    uint32_t i;
+    bstring path = NULL;
+
+    rc = sky_file_rm(data_file->header_path);
+    check(rc == 0, "Unable to remove header: %s", bdata(data_file->header_path));
+
+    path = sky_data_file_get_checksum_path(data_file); check_mem(path);
+    rc = sky_file_rm(path);
+    check(rc == 0, "Unable to remove checksums: %s", bdata(path));
+    bdestroy(path);
+    path = NULL;
+
+    path = sky_data_file_get_journal_path(data_file); check_mem(path);
+    rc = sky_file_rm(path);
+    check(rc == 0, "Unable to remove journal: %s", bdata(path));
+    bdestroy(path);
+    path = NULL;
+
+    path = sky_data_file_get_residency_path(data_file); check_mem(path);
+    rc = sky_file_rm(path);
+    check(rc == 0, "Unable to remove residency file: %s", bdata(path));
+    bdestroy(path);
+    path = NULL;
+
+    for(i=0; ; i++) {
+        path = sky_data_file_get_extent_path(data_file, i); check_mem(path);
+        if(!sky_file_exists(path)) break;
+        rc = sky_file_rm(path);
+        check(rc == 0, "Unable to remove extent: %s", bdata(path));
+        bdestroy(path);
+        path = NULL;
+    }
+
+    bdestroy(path);
+    return 0;
+
+error:
+    bdestroy(path);
+    return -1;
+}
+
+
+//--------------------------------------
+// Block Sizing
+//--------------------------------------
+
+// Recommends a block size for the data file's paths. The size is the
+// smallest power of two that holds the path at the path size percentile in
+// half a block, which is the size that blocks are split down to. The parts
+// of a spanned path are counted as one path. An empty data file is given
+// the default block size.
+//
+// data_file - The data file.
+// ret       - A pointer to where the block size should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_recommend_block_size(sky_data_file *data_file,
+                                       uint32_t *ret)
+{
+    int rc;
+    uint32_t i, j;
+    size_t *sizes = NULL;
+    sky_block_path_stat *paths = NULL;
+    check(data_file != NULL, "Data file required");
+    check(ret != NULL, "Block size return pointer required");
+    *ret = SKY_DEFAULT_BLOCK_SIZE;
+
+    // Collect the size of every path.
+    uint32_t size_count = 0, size_capacity = 0;
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block *block = data_file->blocks[i];
+        uint32_t path_count = 0;
+        rc = sky_block_get_path_stats(block, NULL, &paths, &path_count);
+        check(rc == 0, "Unable to retrieve path stats for block #%d", block->index);
+
+        if(size_count + path_count > size_capacity) {
+            size_capacity = (size_count + path_count) * 2;
+            size_t *new_sizes = realloc(sizes, sizeof(*sizes) * size_capacity);
+            check_mem(new_sizes);
+            sizes = new_sizes;
+        }
+        for(j=0; j<path_count; j++) {
+            // Continue a spanned path from the previous block.
+            bool continues_span = (j == 0 && i > 0 && block->spanned && size_count > 0 &&
+                data_file->blocks[i-1]->spanned && data_file->blocks[i-1]->min_object_id == paths[j].object_id);
+            if(continues_span) {
+                sizes[size_count-1] += paths[j].sz;
+            }
+            else {
+                sizes[size_count++] = paths[j].sz;
+            }
+        }
+
+        free(paths);
+        paths = NULL;
+    }
+    if(size_count == 0) {
+        free(sizes);
+        return 0;
+    }
+
+    // Fit the path at the percentile into half a block.
+    qsort(sizes, size_count, sizeof(*sizes), sky_data_file_compare_path_sizes);
+    size_t sz = sizes[((size_count-1) * SKY_BLOCK_SIZE_PATH_PERCENTILE) / 100] * 2;
+    uint32_t block_size = SKY_MIN_RECOMMENDED_BLOCK_SIZE;
+    while(block_size < sz && block_size < SKY_MAX_BLOCK_SIZE) {
+        block_size *= 2;
+    }
+    *ret = block_size;
+
+    free(sizes);
+    return 0;
+
+error:
+    free(paths);
+    free(sizes);
+    return -1;
+}
+
+// Compares two path sizes in ascending order.
+int sky_data_file_compare_path_sizes(const void *_a, const void *_b)
+{
+    size_t a = *((size_t*)_a);
+    size_t b = *((size_t*)_b);
+    return (a > b ? 1 : (a < b ? -1 : 0));
+}
+
+
+//--------------------------------------
+// Block Compression
+//--------------------------------------
+
+// Compresses the blocks that have not been written to for a number of
+// seconds. Blocks that have not been written to since the data file was
+// loaded count as idle. Each call checks up to a given number of blocks and
+// the next call continues where the last one stopped so that the work can be
+// spread out. The compressed blocks are synced together.
+//
+// data_file    - The data file.
+// idle_seconds - The number of seconds since a block's last write before it
+//                is compressed.
+// limit        - The number of blocks to check or zero to check every block.
+// count        - A pointer to where the number of compressed blocks is
+//                returned. This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_compress(sky_data_file *data_file, uint32_t idle_seconds,
+                           uint32_t limit, uint32_t *count)
+{
+    int rc;
+    uint32_t i;
+    uint32_t compressed_count = 0;
+    bool batching = false;
+    check(data_file != NULL, "Data file required");
+    check(data_file->blocks != NULL && data_file->extents != NULL, "Data file must be loaded");
+
+    rc = sky_data_file_begin_batch(data_file);
+    check(rc == 0, "Unable to begin batch");
+    batching = true;
+
+    time_t now = time(NULL);
+    if(limit == 0 || limit > data_file->block_count) {
+        limit = data_file->block_count;
+    }
+    for(i=0; i<limit; i++) {
+        if(data_file->compress_index >= data_file->block_count) {
+            data_file->compress_index = 0;
+        }
+        sky_block *block = data_file->blocks[data_file->compress_index++];
+        if(block->spanned || (block->modified_at > 0 && now - block->modified_at < (time_t)idle_seconds)) {
+            continue;
+        }
+
+        bool compressed = false;
+        rc = sky_block_compress(block, &compressed);
+        check(rc == 0, "Unable to compress block #%d", block->index);
+        if(compressed) {
+            compressed_count++;
+        }
+    }
+
+    batching = false;
+    rc = sky_data_file_end_batch(data_file);
+    check(rc == 0, "Unable to end batch");
+
+    if(count != NULL) {
+        *count = compressed_count;
+    }
+    return 0;
+
+error:
+    if(batching) sky_data_file_end_batch(data_file);
+    if(count != NULL) *count = 0;
+    return -1;
+}
+
+// Releases the decompressed blocks that were read without being pinned so
+// that the block cache can shrink back to its size. This must only be
+// called when no pointers into compressed blocks are in use, such as
+// between requests.
+//
+// data_file - The data file.
+void sky_data_file_release_cache(sky_data_file *data_file)
+{
+    if(data_file != NULL) {
+        sky_block_cache_release(data_file->block_cache);
+    }
+}
+
+
+//--------------------------------------
+// Event Management
+//--------------------------------------
+
+// Adds an event to the data file. Events with data cannot be added to an
+// action-only data file.
+//
+// data_file - The data file to add the event to..
+// event     - The event to add.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_add_event(sky_data_file *data_file, sky_event *event)
+{
+    int rc;
+    check(data_file != NULL, "Data file required");
+    check(event != NULL, "Event required");
+    check(!data_file->action_only || event->data_count == 0, "Events with data cannot be added to an action-only data file");
+    
+    // Find insertion block.
+    sky_block *block;
+    rc = sky_data_file_find_insertion_block(data_file, event, &block);
+    check(rc == 0, "Unable to find insertion block");
+    
+    // Add the event to the block.
+    rc = sky_block_add_event(block, event);
+    check(rc == 0, "Unable to add event to block #%d", block->index);
+
+    // Track changes that still need to be flushed.
+    if(sky_data_file_is_deferred(data_file)) {
+        data_file->unflushed_event_count++;
+    }
+    data_file->write_version = __sync_add_and_fetch(&sky_data_file_last_write_version, 1);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Removes every event of an object from the data file. The blocks that held
+// the object keep their place and are left empty if the object was the only
+// one in them. Empty blocks are reclaimed by compaction.
+//
+// data_file - The data file.
+// object_id - The object id.
+// removed   - A pointer to where a flag is returned stating if the object had
+//             any events. This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_remove_object(sky_data_file *data_file,
+                                sky_object_id_t object_id, bool *removed)
+{
+    int rc;
+    uint32_t i;
+    sky_block **blocks = NULL;
+    uint32_t block_count = 0;
+    bool found = false;
+    check(data_file != NULL, "Data file required");
+
+    rc = sky_data_file_get_object_blocks(data_file, object_id, &blocks, &block_count);
+    check(rc == 0, "Unable to find object blocks");
+
+    for(i=0; i<block_count; i++) {
+        bool block_removed;
+        rc = sky_block_remove_path(blocks[i], object_id, &block_removed);
+        check(rc == 0, "Unable to remove path from block #%d", blocks[i]->index);
+        found = found || block_removed;
+    }
+
+    // Track changes that still need to be flushed.
+    if(found) {
+        if(sky_data_file_is_deferred(data_file)) {
+            data_file->unflushed_event_count++;
+        }
+        data_file->write_version = __sync_add_and_fetch(&sky_data_file_last_write_version, 1);
+    }
+
+    free(blocks);
+    if(removed != NULL) *removed = found;
+    return 0;
+
+error:
+    free(blocks);
+    if(removed != NULL) *removed = false;
+    return -1;
+}
 
-    // Loop over sorted blocks to find the appropriate insertion point.
+// Removes the events of an object at a given timestamp from the data file.
+// The parts of a spanned path are merged into fewer blocks once they fit.
+//
+// data_file - The data file.
+// object_id - The object id.
+// timestamp - The timestamp of the events to remove.
+// count     - A pointer to where the number of removed events is returned.
+//             This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_remove_events(sky_data_file *data_file,
+                                sky_object_id_t object_id,
+                                sky_timestamp_t timestamp, uint32_t *count)
+{
+    int rc;
     uint32_t i;
-    sky_block *block = NULL;
-    for(i=0; i<data_file->block_count; i++) {
-        block = data_file->blocks[i];
-        
-        // If block is within range then use the block.
-        if(object_id >= block->min_object_id && object_id <= block->max_object_id) {
-            // If this is a single object block then find the appropriate block
-            // based on timestamp.
-            if(block->spanned) {
-                // Find first block where timestamp is before the max.
-                while(i<data_file->block_count && data_file->blocks[i]->min_object_id == object_id) {
-                    if(timestamp <= data_file->blocks[i]->max_timestamp) {
-                        *ret = block;
-                        break;
-                    }
-                    i++;
-                }
-                
-                // If this event is being appended to the object path then use
-                // the last block.
-                if(*ret == NULL) {
-                    *ret = data_file->blocks[i-1];
-                }
+    sky_block **blocks = NULL;
+    uint32_t block_count = 0;
+    uint32_t removed_count = 0;
+    check(data_file != NULL, "Data file required");
 
-                break;
-            }
-            // If this is a multi-object block then simply use it.
-            else {
-                *ret = block;
-                break;
-            }
-        }
-        // If block is before this object id range, then use the block if it
-        // is a multi-object block.
-        else if(object_id < block->min_object_id && !block->spanned) {
-            *ret = block;
-            break;
-        }
+    rc = sky_data_file_get_object_blocks(data_file, object_id, &blocks, &block_count);
+    check(rc == 0, "Unable to find object blocks");
+
+    for(i=0; i<block_count; i++) {
+        uint32_t block_removed_count;
+        rc = sky_block_remove_events(blocks[i], object_id, timestamp, &block_removed_count);
+        check(rc == 0, "Unable to remove events from block #%d", blocks[i]->index);
+        removed_count += block_removed_count;
     }
-    
-    // If we haven't found a block then it means that the object id is after all
-    // other object ids or that we are inserting before a single object block or
-    // that we have no blocks.
-    if(*ret == NULL) {
-        // Find the last block if one exists.
-        sky_block *last_block = (data_file->block_count > 0 ? data_file->blocks[data_file->block_count-1] : NULL);
-        
-        // If the last block available is unspanned then use it.
-        if(last_block != NULL && !last_block->spanned) {
-            *ret = last_block;
+
+    if(removed_count > 0) {
+        if(block_count > 1) {
+            rc = sky_data_file_merge_span(data_file, blocks, block_count);
+            check(rc == 0, "Unable to merge spanned blocks");
         }
-        // Otherwise just create a new block.
-        else {
-            rc = sky_data_file_create_block(data_file, ret);
-            check(rc == 0, "Unable to create block");
+
+        // Track changes that still need to be flushed.
+        if(sky_data_file_is_deferred(data_file)) {
+            data_file->unflushed_event_count++;
         }
+        data_file->write_version = __sync_add_and_fetch(&sky_data_file_last_write_version, 1);
     }
-    
+
+    free(blocks);
+    if(count != NULL) *count = removed_count;
     return 0;
 
 error:
+    free(blocks);
+    if(count != NULL) *count = 0;
     return -1;
 }
 
-// Updates the block information to mark blocks as spanned or not.
+// Retrieves the blocks that may hold the path of an object. This is every
+// block of a span or the one block whose range contains the object. The
+// blocks are returned in path order.
 //
-// data_file - The data file.
+// data_file   - The data file.
+// object_id   - The object id.
+// blocks      - A pointer to where an array of blocks should be returned. The
+//               caller owns the array.
+// block_count - A pointer to where the number of blocks should be returned.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_data_file_normalize(sky_data_file *data_file)
+int sky_data_file_get_object_blocks(sky_data_file *data_file,
+                                    sky_object_id_t object_id,
+                                    sky_block ***blocks, uint32_t *block_count)
 {
-    // Sort ranges by starting object id.
-    qsort(data_file->blocks, data_file->block_count, sizeof(*data_file->blocks), compare_blocks);
+    int rc;
+    uint32_t i;
+    *blocks = NULL;
+    *block_count = 0;
 
-    // Determine spanned blocks.
+    uint32_t lo = sky_data_file_search_blocks(data_file, object_id);
+    if(lo == data_file->block_count || data_file->block_min_object_ids[lo] > object_id) {
+        return 0;
+    }
+
+    uint32_t count = 1;
+    if(data_file->blocks[lo]->spanned) {
+        rc = sky_block_get_span_count(data_file->blocks[lo], &count);
+        check(rc == 0, "Unable to calculate span count");
+    }
+
+    *blocks = malloc(sizeof(sky_block*) * count); check_mem(*blocks);
+    for(i=0; i<count; i++) {
+        (*blocks)[i] = data_file->blocks[lo+i];
+    }
+    *block_count = count;
+
+    return 0;
+
+error:
+    free(*blocks);
+    *blocks = NULL;
+    *block_count = 0;
+    return -1;
+}
+
+// Moves the parts of a spanned path that shrank into the block holding the
+// part before them when they fit. The moved parts keep their full timestamp
+// on their first event. Blocks that are left empty are reclaimed by
+// compaction and a part that is left on its own is no longer spanned.
+//
+// data_file   - The data file.
+// blocks      - The blocks of the span in path order.
+// block_count - The number of blocks.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_merge_span(sky_data_file *data_file, sky_block **blocks,
+                             uint32_t block_count)
+{
+    int rc;
     uint32_t i;
-    sky_object_id_t last_object_id = -1;
-    for(i=0; i<data_file->block_count; i++) {
-        sky_block *block = data_file->blocks[i];
-        
-        // If this is a single object block then track the object id to
-        // possibly mark it as spanned.
-        if(block->min_object_id == block->max_object_id && block->min_object_id > 0) {
-            // If it has spanned since the last block then mark it and the
-            // previous block.
-            if(block->min_object_id == last_object_id) {
-                block->spanned = true;
-                data_file->blocks[i-1]->spanned = true;
-            }
-            // If this is the first block with one object then store the id.
-            else {
-                last_object_id = block->min_object_id;
+    sky_block *target = NULL;
+    sky_block *last_target = NULL;
+    bool target_changed = false;
+    uint32_t remaining_count = 0;
+
+    for(i=0; i<block_count; i++) {
+        sky_block *block = blocks[i];
+        if(block->min_object_id == 0 && block->max_object_id == 0) {
+            continue;
+        }
+        remaining_count++;
+
+        void *ptr = NULL;
+        rc = sky_block_get_ptr(block, &ptr);
+        check(rc == 0, "Unable to retrieve block pointer");
+
+        // Append the events of the part to the target if they fit.
+        if(target != NULL) {
+            void *target_ptr = NULL;
+            rc = sky_block_get_ptr(target, &target_ptr);
+            check(rc == 0, "Unable to retrieve target block pointer");
+            size_t target_length = sky_path_sizeof_raw(target_ptr);
+            sky_path_event_data_length_t event_data_length = *(sky_path_event_data_length_t*)(ptr + sizeof(sky_object_id_t));
+
+            if(target_length + event_data_length <= data_file->block_size) {
+                memcpy(target_ptr + target_length, ptr + SKY_PATH_HEADER_LENGTH, event_data_length);
+                *(sky_path_event_data_length_t*)(target_ptr + sizeof(sky_object_id_t)) += event_data_length;
+                target_changed = true;
+
+                memset(ptr, 0, SKY_PATH_HEADER_LENGTH + event_data_length);
+                block->spanned = false;
+                rc = sky_block_save(block);
+                check(rc == 0, "Unable to save block");
+                rc = sky_block_full_update(block);
+                check(rc == 0, "Unable to update block ranges");
+                remaining_count--;
+                continue;
             }
         }
-        // Clear out last object id for multi-object blocks.
-        else {
-            last_object_id = -1;
+
+        // Otherwise the part becomes the next target.
+        if(target_changed) {
+            rc = sky_block_save(target);
+            check(rc == 0, "Unable to save block");
+            rc = sky_block_full_update(target);
+            check(rc == 0, "Unable to update block ranges");
         }
+        target = block;
+        target_changed = false;
+        last_target = block;
+    }
+
+    if(target_changed) {
+        rc = sky_block_save(target);
+        check(rc == 0, "Unable to save block");
+        rc = sky_block_full_update(target);
+        check(rc == 0, "Unable to update block ranges");
+    }
+
+    // A path that fits in a single block is no longer spanned.
+    if(remaining_count == 1) {
+        last_target->spanned = false;
     }
 
     return 0;
+
+error:
+    return -1;
 }
 
-// Moves a specific number of bytes from a given pointer to a newly created
-// block. The pointer passed in may change if the data file is remapped to a
-// different memory location.
+
+//--------------------------------------
+// Retention
+//--------------------------------------
+
+// Drops the blocks whose events are all older than a cutoff. The blocks are
+// cleared in place and are reclaimed by the next compaction, which also
+// trims the expired events out of blocks that have only partially expired.
 //
-// data_file - The data file that contains the pointer.
-// ptr       - A pointer to a location on the data file.
-// sz        - The number of bytes to move to a new block.
-// new_block - A pointer to where the new block should be returned.
+// data_file     - The data file.
+// expire_before - The timestamp before which events are dropped.
+// count         - A pointer to where the number of dropped blocks is
+//                 returned. This can be null.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_data_file_move_to_new_block(sky_data_file *data_file, void **ptr,
-                                    size_t sz, sky_block **new_block)
+int sky_data_file_expire(sky_data_file *data_file,
+                         sky_timestamp_t expire_before, uint32_t *count)
 {
     int rc;
+    uint32_t i;
+    sky_block **blocks = NULL;
+    uint32_t block_count = 0;
     check(data_file != NULL, "Data file required");
+    check(data_file->blocks != NULL, "Data file must be loaded");
 
-    // Store offset before data file remap.
-    off_t ptr_off = (*ptr) - data_file->data;
+    // Clearing a block moves it so the expired blocks are found first.
+    blocks = malloc(sizeof(*blocks) * data_file->block_count); check_mem(blocks);
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block *block = data_file->blocks[i];
+        bool is_empty = (block->min_object_id == 0 && block->max_object_id == 0);
+        if(!is_empty && block->max_timestamp < expire_before) {
+            blocks[block_count++] = block;
+        }
+    }
 
-    // Create block.
-    rc = sky_data_file_create_block(data_file, new_block);
-    check(rc == 0, "Unable to create new block");
-    
-    // Restore pointers in case remap relocated data.
-    *ptr = data_file->data + ptr_off;
+    for(i=0; i<block_count; i++) {
+        rc = sky_block_clear(blocks[i]);
+        check(rc == 0, "Unable to clear block #%d", blocks[i]->index);
+    }
 
-    // Retrieve new block's pointer.
-    void *new_block_ptr = NULL;
-    rc = sky_block_get_ptr(*new_block, &new_block_ptr);
-    check(rc == 0, "Unable to determine new block pointer");
-    
-    // Copy over everything since the checkpoint.
-    memmove(new_block_ptr, (*ptr), sz);
+    // A part of a span that is left on its own is no longer spanned.
+    if(block_count > 0) {
+        for(i=0; i<data_file->block_count; i++) {
+            sky_block *block = data_file->blocks[i];
+            if(block->spanned) {
+                bool has_prev = (i > 0 && data_file->blocks[i-1]->spanned && data_file->blocks[i-1]->min_object_id == block->min_object_id);
+                bool has_next = (i+1 < data_file->block_count && data_file->blocks[i+1]->spanned && data_file->blocks[i+1]->min_object_id == block->min_object_id);
+                block->spanned = (has_prev || has_next);
+            }
+        }
 
-    // Clear out data from the source block.
-    memset((*ptr), 0, sz);
-    
-    // Perform a full update on the block header. This is probably not
-    // needed but we're going to be safe. The amortized cost of this
-    // should be small considering splits shouldn't happen often.
-    rc = sky_block_full_update(*new_block);
-    check(rc == 0, "Unable to update block ranges on new block");
+        if(sky_data_file_is_deferred(data_file)) {
+            data_file->unflushed_event_count++;
+        }
+        data_file->write_version = __sync_add_and_fetch(&sky_data_file_last_write_version, 1);
+    }
 
+    free(blocks);
+    if(count != NULL) *count = block_count;
     return 0;
-    
+
 error:
+    free(blocks);
+    if(count != NULL) *count = 0;
     return -1;
 }
 
 
 //--------------------------------------
-// Event Management
+// Memory
 //--------------------------------------
 
-// Adds an event to the data file.
+// Calculates the memory used by a data file. The heap memory is the block
+// list and its ranges along with the metadata of each block. The resident
+// memory is the number of bytes of the extent mappings that are in the page
+// cache. The block cache is not included. See block_cache.h.
 //
-// data_file - The data file to add the event to..
-// event     - The event to add.
+// data_file - The data file.
+// heap      - A pointer to where the heap memory should be returned.
+// resident  - A pointer to where the resident memory should be returned.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_data_file_add_event(sky_data_file *data_file, sky_event *event)
+int sky_data_file_get_memory(sky_data_file *data_file, size_t *heap,
+                             size_t *resident)
 {
     int rc;
+    uint32_t i;
+    unsigned char *pages = NULL;
     check(data_file != NULL, "Data file required");
-    check(event != NULL, "Event required");
-    
-    // Find insertion block.
-    sky_block *block;
-    rc = sky_data_file_find_insertion_block(data_file, event, &block);
-    check(rc == 0, "Unable to find insertion block");
-    
-    // Add the event to the block.
-    rc = sky_block_add_event(block, event);
-    check(rc == 0, "Unable to add event to block [%p]", data_file->data);
+    check(heap != NULL, "Heap return pointer required");
+    check(resident != NULL, "Resident return pointer required");
 
-    // Re-sort blocks.
-    qsort(data_file->blocks, data_file->block_count, sizeof(sky_block*), compare_blocks);
-    
+    size_t size = sizeof(*data_file);
+    size += sizeof(*data_file->blocks) * data_file->block_count;
+    size += (sizeof(*data_file->block_min_object_ids) + sizeof(*data_file->block_max_object_ids)) * data_file->block_range_count;
+    size += sizeof(*data_file->extents) * data_file->extent_count;
+    for(i=0; i<data_file->block_count; i++) {
+        size += sky_block_get_memory_usage(data_file->blocks[i]);
+    }
+    *heap = size;
+
+    // Count the resident pages of each extent's blocks.
+    size_t resident_size = 0;
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    for(i=0; i<data_file->extent_count; i++) {
+        sky_data_extent *extent = &data_file->extents[i];
+        if(extent->data == NULL || extent->data_length == 0) {
+            continue;
+        }
+        size_t page_count = (extent->data_length + page_size - 1) / page_size;
+        free(pages);
+        pages = malloc(page_count); check_mem(pages);
+        rc = mincore(extent->data, extent->data_length, pages);
+        check(rc == 0, "Unable to determine residency of extent #%d", i);
+
+        // The last page is only counted up to the end of the data.
+        size_t j;
+        for(j=0; j<page_count; j++) {
+            if(pages[j] & 1) {
+                size_t remaining = extent->data_length - (j * page_size);
+                resident_size += (remaining < page_size ? remaining : page_size);
+            }
+        }
+    }
+    *resident = resident_size;
+
+    free(pages);
     return 0;
 
 error:
+    free(pages);
     return -1;
 }
 
@@ -655,6 +2940,182 @@ error:
 // Block Sorting
 //--------------------------------------
 
+// Moves a block to its sorted position after its ranges have changed. The
+// rest of the blocks are already in order so the block only needs to be
+// shifted past the neighbors that are now out of order with it. This is
+// usually zero or one position.
+//
+// data_file - The data file.
+// block     - The block whose ranges changed.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_sort_block(sky_data_file *data_file, sky_block *block)
+{
+    check(data_file != NULL, "Data file required");
+    check(block != NULL, "Block required");
+    check(block->position < data_file->block_count && data_file->blocks[block->position] == block, "Block position out of sync: #%d", block->index);
+
+    sky_block **blocks = NULL;
+    int rc = sky_data_file_copy_blocks(data_file, &blocks);
+    check(rc == 0, "Unable to copy block array");
+    uint32_t position = block->position;
+    uint32_t start = position, end = position + 1;
+
+    // Shift towards the start.
+    while(position > 0 && compare_blocks(&blocks[position-1], &block) > 0) {
+        blocks[position] = blocks[position-1];
+        blocks[position]->position = position;
+        position--;
+    }
+
+    // Shift towards the end.
+    while(position < data_file->block_count-1 && compare_blocks(&blocks[position+1], &block) < 0) {
+        blocks[position] = blocks[position+1];
+        blocks[position]->position = position;
+        position++;
+    }
+
+    blocks[position] = block;
+    block->position = position;
+    if(position < start) start = position;
+    if(position >= end) end = position + 1;
+
+    rc = sky_data_file_publish_blocks(data_file, blocks);
+    check(rc == 0, "Unable to publish block array");
+
+    rc = sky_data_file_index_blocks(data_file, start, end);
+    check(rc == 0, "Unable to index blocks");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Retrieves a block array that can be reordered. Without readers this is
+// the data file's own block array. Otherwise it is a copy that readers
+// cannot see until it is published.
+//
+// data_file - The data file.
+// ret       - A pointer to where the block array should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_copy_blocks(sky_data_file *data_file, sky_block ***ret)
+{
+    *ret = data_file->blocks;
+    if(data_file->block_count == 0 || !sky_epoch_has_readers(data_file->epoch)) {
+        return 0;
+    }
+
+    sky_block **blocks = malloc(sizeof(*blocks) * data_file->block_count);
+    check_mem(blocks);
+    memcpy(blocks, data_file->blocks, sizeof(*blocks) * data_file->block_count);
+    *ret = blocks;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Replaces the data file's block array with a copy returned by
+// sky_data_file_copy_blocks(). The old array is retired.
+//
+// data_file - The data file.
+// blocks    - The block array.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_publish_blocks(sky_data_file *data_file,
+                                 sky_block **blocks)
+{
+    if(blocks == data_file->blocks) {
+        return 0;
+    }
+
+    sky_block **old_blocks = data_file->blocks;
+    __sync_synchronize();
+    data_file->blocks = blocks;
+    return sky_epoch_retire(data_file->epoch, old_blocks, 0, sky_epoch_free_heap);
+}
+
+// Copies the object id ranges of the blocks at a span of positions into the
+// data file's range arrays and recounts the span counts that depend on them.
+// The arrays are grown to the block count first.
+//
+// A block's span count is the number of blocks from it up to the first
+// block that starts with a different object id. It only depends on the
+// blocks after it, so the counts are recounted backwards from the end of
+// the changed positions until a count before them is unchanged.
+//
+// data_file - The data file.
+// start     - The first position to copy.
+// end       - The position after the last one to copy.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_data_file_index_blocks(sky_data_file *data_file, uint32_t start,
+                               uint32_t end)
+{
+    if(data_file->block_range_count < data_file->block_count) {
+        size_t sz = sizeof(sky_object_id_t) * data_file->block_count;
+        sky_object_id_t *min_object_ids = realloc(data_file->block_min_object_ids, sz);
+        check_mem(min_object_ids);
+        data_file->block_min_object_ids = min_object_ids;
+        sky_object_id_t *max_object_ids = realloc(data_file->block_max_object_ids, sz);
+        check_mem(max_object_ids);
+        data_file->block_max_object_ids = max_object_ids;
+        data_file->block_range_count = data_file->block_count;
+    }
+
+    uint32_t i;
+    for(i=start; i<end; i++) {
+        data_file->block_min_object_ids[i] = data_file->blocks[i]->min_object_id;
+        data_file->block_max_object_ids[i] = data_file->blocks[i]->max_object_id;
+    }
+
+    sky_object_id_t *min_object_ids = data_file->block_min_object_ids;
+    for(i=end; i>0; i--) {
+        sky_block *block = data_file->blocks[i-1];
+        uint32_t span_count = 1;
+        if(i < data_file->block_count && min_object_ids[i] == min_object_ids[i-1]) {
+            span_count = data_file->blocks[i]->span_count + 1;
+        }
+        if(i-1 < start && block->span_count == span_count) {
+            break;
+        }
+        block->span_count = span_count;
+    }
+    return 0;
+
+error:
+    return -1;
+}
+
+// Binary searches the block ranges for the first block whose range ends at
+// or after an object id. Object id ranges do not overlap so the max object
+// ids are in the same order as the min object ids that the blocks are
+// sorted by.
+//
+// data_file - The data file.
+// object_id - The object id to search for.
+//
+// Returns the position of the block or the block count if no block ends at
+// or after the object id.
+uint32_t sky_data_file_search_blocks(sky_data_file *data_file,
+                                     sky_object_id_t object_id)
+{
+    sky_object_id_t *max_object_ids = data_file->block_max_object_ids;
+    uint32_t lo = 0, hi = data_file->block_count;
+    while(lo < hi) {
+        uint32_t mid = lo + ((hi - lo) / 2);
+        if(max_object_ids[mid] < object_id) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
 // Compares two blocks and sorts them based on starting min object identifier
 // and then by id.
 int compare_blocks(const void *_a, const void *_b)
@@ -3,6 +3,7 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <time.h>
 
 typedef struct sky_data_file sky_data_file;
 
@@ -10,7 +11,10 @@ typedef struct sky_data_file sky_data_file;
 #include "file.h"
 #include "types.h"
 #include "block.h"
+#include "block_cache.h"
+#include "epoch.h"
 #include "event.h"
+#include "prefetcher.h"
 
 //==============================================================================
 //
@@ -22,6 +26,110 @@ typedef struct sky_data_file sky_data_file;
 // structured. The beginning of the file lists the database format version
 // (4-bytes), block size (4-bytes) and block count (4-bytes). From there the
 // blocks are listed out in 
+//
+// The blocks of the data file are stored in a sequence of extent files that
+// each hold a fixed number of blocks. A block is located in the extent given
+// by its index divided by the number of blocks per extent. Extents are mapped
+// independently so that growing the data file adds a new extent instead of
+// remapping all of the existing data.
+//
+// Each extent is mapped with more room than its blocks need so that adding
+// a block does not remap the extent. The data length is the logical length
+// of the blocks while the mapped length is the size of the mappings, which
+// grow geometrically. On Linux the disk space for a mapping is also reserved
+// up front so that growing the file does not need to allocate.
+//
+// The header is read into memory once when the data file is loaded and the
+// block list is the authoritative copy from then on. The header file
+// descriptor stays open while the data file is loaded and changed entries
+// are written back in place with positional writes. The header is read with
+// a single read and its blocks are allocated together in one slab, and the
+// block list is only sorted if the entries are out of order, so a table with
+// millions of blocks opens quickly.
+//
+// The checksums of the blocks are kept next to the header in a checksum file
+// that has the header's path with a ".crc" suffix. It holds an entry for
+// each block by block index and is read along with the header. The
+// checksums of the blocks that were synced since the last flush are
+// calculated when the data file is flushed and the dirty entries are then
+// written in a single range, the same as header entries. The header format is unchanged so a data file can
+// still be read without its checksum file. See block.h.
+//
+// Blocks are written before their header entries so a crash in between
+// leaves header entries whose ranges do not cover their blocks. A block is
+// recorded in the journal file, which has the header's path with a
+// ".journal" suffix, before it is first changed after a checkpoint. A
+// checkpoint happens when a flush has written every dirty header entry and
+// the journal is then emptied. If the journal is not empty when the data
+// file is loaded then only the ranges of the blocks it lists are rebuilt
+// from their paths, so recovery takes as long as the number of blocks that
+// were changed since the last checkpoint instead of the size of the table.
+// New blocks have their header entries written and are journaled as soon as
+// they are created so the paths that a split moves into them are recovered
+// along with the block that they came from.
+//
+// The kernel is given hints about how the mappings will be read. Point
+// lookups and inserts use the random access pattern so each fault only reads
+// the page it needs, while full scans switch the mappings to the sequential
+// pattern for the duration of the scan. Mappings can also be preloaded as
+// they are mapped and can ask for transparent huge pages to cut down on TLB
+// misses. Huge pages only apply to file mappings on file systems that
+// support them and the hint is ignored elsewhere. A data file can also be
+// given a prefetcher whose I/O threads read the blocks that a scan is about
+// to reach while the scan is still on earlier blocks. See prefetcher.h.
+//
+// The blocks that are in the page cache are recorded in a residency file,
+// which has the header's path with a ".hot" suffix, when the data file is
+// unloaded and every few minutes when it is flushed. The file is a bitmap
+// of block indices built with mincore(). When the data file is loaded again
+// exactly those blocks are read back ahead of the first queries, on the
+// prefetcher's I/O threads if there is one and by the kernel otherwise, so a
+// restarted server does not warm up one page fault at a time.
+//
+// Blocks that are not written to for a while can be compressed in place to
+// save disk space and read less data on scans. The decompressed data of
+// compressed blocks is kept in a block cache of a fixed size that is shared
+// by all readers of the data file. See block.h and block_cache.h.
+//
+// Block splits leave blocks partly full. Compaction rewrites the data file
+// with the paths packed in object id order up to a fill factor so that the
+// block indices follow the object id order again.
+//
+// The write version changes every time an event is added so that readers can
+// tell whether anything they derived from the data file is still current.
+// Versions are drawn from a process wide counter so a data file that is
+// reloaded never reuses the version of an earlier copy. Blocks take their
+// change versions from the same counter. See block.h.
+//
+// Readers on other threads can keep using the block array and the extent
+// mappings while the owner of the data file grows it. A reader enters the
+// data file's epoch and the owner retires the block arrays, extent arrays
+// and mappings that it replaces instead of releasing them, so a reader never
+// follows a pointer into freed or unmapped memory. The block array is also
+// copied instead of sorted in place while there are readers. The contents
+// of a block are still changed in place, so the owner must not add events
+// to a block while it is being read. See epoch.h.
+//
+// The object id range of each block is also kept in two contiguous arrays
+// ordered by block position. Finding the block for an object id searches
+// these arrays instead of following a pointer to every block it compares.
+// The arrays are only used by the owner of the data file and are updated
+// whenever blocks are created or change position. The span count of each
+// block is updated at the same time. Only the blocks that moved and the
+// blocks of the span before them are recounted, so splitting a block does
+// not rescan the block list.
+//
+// The block size is fixed when the data file is created. Paths that are
+// larger than half a block are split into spans while small paths leave
+// most of a large block to be scanned for a single lookup, so a block size
+// can be recommended from the distribution of the table's path sizes.
+//
+// A data file can be flagged as action-only by the table that owns it. Its
+// events are then refused if they have data, so every event is a flag byte,
+// a timestamp and an action id. Loops that walk every event of a block use
+// the action-only iteration macros in cursor.h for these data files, which
+// size and decode events without checking for data. The flag is not stored
+// in the header. See table.h.
 
 
 //==============================================================================
@@ -32,22 +140,129 @@ typedef struct sky_data_file sky_data_file;
 
 #define SKY_DEFAULT_BLOCK_SIZE 0x10000
 
-#define SKY_DATA_FILE_VERSION  1
+// The largest block size that a table can be created with.
+#define SKY_MAX_BLOCK_SIZE 0x1000000
+
+// The smallest block size that is recommended for a table.
+#define SKY_MIN_RECOMMENDED_BLOCK_SIZE 0x1000
+
+// The percentile of path sizes that a recommended block size is chosen to
+// hold in half a block.
+#define SKY_BLOCK_SIZE_PATH_PERCENTILE 95
+
+#define SKY_DATA_FILE_VERSION  3
+
+// The first data file format version that stores event timestamps as deltas
+// within a path. Earlier data files are read the same way but new events are
+// written with full timestamps so the files stay readable by older versions.
+#define SKY_DATA_FILE_DELTA_VERSION 2
+
+// The first data file format version that stores 64-bit object ids. Older
+// data files cannot be loaded and must be converted with sky_migration.
+#define SKY_DATA_FILE_WIDE_OBJECT_ID_VERSION 3
 
 #define SKY_HEADER_FILE_HDR_SIZE sizeof(uint32_t) + sizeof(uint32_t)
 
+// The default number of blocks stored in each extent file.
+#define SKY_DEFAULT_EXTENT_BLOCK_COUNT 0x4000
+
+// The default percentage of each block that is filled by compaction.
+#define SKY_DATA_FILE_DEFAULT_FILL_FACTOR 90
+
+// The default number of bytes of decompressed blocks to cache.
+#define SKY_DATA_FILE_DEFAULT_BLOCK_CACHE_SIZE (64 * 1024 * 1024)
+
+// The number of seconds between residency snapshots taken by flushes.
+#define SKY_DATA_FILE_RESIDENCY_INTERVAL 300
+
+// The largest number of bytes that the data file mapping grows by at once.
+// Below this the mapping doubles in size each time it grows.
+#define SKY_DATA_FILE_MAX_GROWTH 0x10000000
+
+// The durability modes control when changes are synced to disk.
+//
+// STRICT - Each change is synced before it is acknowledged.
+// GROUP  - Changes are synced in groups. The owner of the data file is
+//          responsible for flushing and for delaying acknowledgements until
+//          the flush has completed.
+// ASYNC  - Changes are left for the kernel to write back and are flushed
+//          asynchronously in the background.
+typedef enum sky_durability_e {
+    SKY_DURABILITY_STRICT,
+    SKY_DURABILITY_GROUP,
+    SKY_DURABILITY_ASYNC,
+} sky_durability_e;
+
+// The access patterns that the data file mappings are advised with.
+//
+// NORMAL     - The kernel's default read ahead.
+// SEQUENTIAL - The mappings are read in order and read ahead aggressively.
+// RANDOM     - The mappings are read in no particular order so read ahead
+//              is turned off.
+typedef enum sky_access_pattern_e {
+    SKY_ACCESS_PATTERN_NORMAL,
+    SKY_ACCESS_PATTERN_SEQUENTIAL,
+    SKY_ACCESS_PATTERN_RANDOM,
+} sky_access_pattern_e;
+
+// An extent is one of the files that the data file's blocks are stored in.
+// Each extent holds a fixed number of blocks and is mapped on its own.
+typedef struct sky_data_extent {
+    int fd;
+    void *data;
+    size_t data_length;
+    size_t mapped_length;
+} sky_data_extent;
+
 struct sky_data_file {
     bstring path;
     bstring header_path;
+    uint32_t version;
     uint32_t block_size;
     sky_block **blocks;
     uint32_t block_count;
-    int data_fd;
-    void *data;
+    sky_block *block_slab;
+    uint32_t block_slab_count;
+    sky_object_id_t *block_min_object_ids;
+    sky_object_id_t *block_max_object_ids;
+    uint32_t block_range_count;
+    int header_fd;
+    int checksum_fd;
+    int journal_fd;
+    uint32_t journal_length;
+    bool recovery_pending;
+    time_t residency_saved_at;
+    uint32_t extent_block_count;
+    sky_data_extent *extents;
+    uint32_t extent_count;
     size_t data_length;
+    size_t mapped_length;
+    uint32_t batch_depth;
+    sky_durability_e durability;
+    uint32_t unflushed_event_count;
+    sky_access_pattern_e access_pattern;
+    bool preload;
+    bool huge_pages;
+    bool action_only;
+    sky_block_cache *block_cache;
+    size_t block_cache_size;
+    sky_prefetcher *prefetcher;
+    uint32_t compress_index;
+    uint64_t write_version;
+    sky_epoch *epoch;
 };
 
 
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+// The last write version handed out to a data file or block.
+extern uint64_t sky_data_file_last_write_version;
+
+
 //==============================================================================
 //
 // Functions
@@ -71,6 +286,17 @@ int sky_data_file_set_path(sky_data_file *data_file, bstring path);
 
 int sky_data_file_set_header_path(sky_data_file *data_file, bstring path);
 
+bstring sky_data_file_get_extent_path(sky_data_file *data_file, uint32_t index);
+
+bstring sky_data_file_get_checksum_path(sky_data_file *data_file);
+
+bstring sky_data_file_get_journal_path(sky_data_file *data_file);
+
+bstring sky_data_file_get_residency_path(sky_data_file *data_file);
+
+int sky_data_file_get_ptr_position(sky_data_file *data_file, void *ptr,
+    uint32_t *index, size_t *offset);
+
 
 //--------------------------------------
 // Persistence
@@ -80,6 +306,51 @@ int sky_data_file_load(sky_data_file *data_file);
 
 int sky_data_file_unload(sky_data_file *data_file);
 
+int sky_data_file_begin_batch(sky_data_file *data_file);
+
+int sky_data_file_end_batch(sky_data_file *data_file);
+
+int sky_data_file_flush(sky_data_file *data_file);
+
+bool sky_data_file_is_deferred(sky_data_file *data_file);
+
+int sky_data_file_write_headers(sky_data_file *data_file);
+
+int sky_data_file_write_checksums(sky_data_file *data_file);
+
+int sky_data_file_set_durability(sky_data_file *data_file,
+    sky_durability_e durability);
+
+
+//--------------------------------------
+// Journal
+//--------------------------------------
+
+int sky_data_file_journal_block(sky_data_file *data_file, sky_block *block);
+
+int sky_data_file_checkpoint(sky_data_file *data_file);
+
+int sky_data_file_recover(sky_data_file *data_file);
+
+
+//--------------------------------------
+// Memory Advice
+//--------------------------------------
+
+int sky_data_file_set_access_pattern(sky_data_file *data_file,
+    sky_access_pattern_e access_pattern);
+
+int sky_data_file_set_preload(sky_data_file *data_file, bool preload);
+
+int sky_data_file_set_huge_pages(sky_data_file *data_file, bool huge_pages);
+
+int sky_data_file_prefetch_blocks(sky_data_file *data_file,
+    sky_block **blocks, uint32_t start_index, uint32_t end_index);
+
+int sky_data_file_save_residency(sky_data_file *data_file);
+
+int sky_data_file_warm(sky_data_file *data_file);
+
 
 //--------------------------------------
 // Block Management
@@ -87,6 +358,13 @@ int sky_data_file_unload(sky_data_file *data_file);
 
 int sky_data_file_create_block(sky_data_file *data_file, sky_block **ret);
 
+int sky_data_file_create_blocks(sky_data_file *data_file, uint32_t count,
+    sky_block **ret);
+
+int sky_data_file_sort_block(sky_data_file *data_file, sky_block *block);
+
+int sky_data_file_normalize(sky_data_file *data_file);
+
 int sky_data_file_find_insertion_block(sky_data_file *data_file,
     sky_event *event, sky_block **ret);
 
@@ -94,10 +372,75 @@ int sky_data_file_move_to_new_block(sky_data_file *data_file, void **ptr,
     size_t sz, sky_block **new_block);
 
 
+int sky_data_file_get_partitions(sky_data_file *data_file,
+    uint32_t partition_count, uint32_t *boundaries);
+
+
+//--------------------------------------
+// Path Lookup
+//--------------------------------------
+
+int sky_data_file_find_path(sky_data_file *data_file,
+    sky_object_id_t object_id, void ***paths, uint32_t *path_count);
+
+
+//--------------------------------------
+// Compaction
+//--------------------------------------
+
+int sky_data_file_compact(sky_data_file *data_file, uint32_t fill_factor,
+    sky_timestamp_t expire_before);
+
+int sky_data_file_replace_files(sky_data_file *data_file,
+    sky_data_file *source, uint32_t extent_count);
+
+int sky_data_file_remove_files(sky_data_file *data_file);
+
+
+//--------------------------------------
+// Block Sizing
+//--------------------------------------
+
+int sky_data_file_recommend_block_size(sky_data_file *data_file,
+    uint32_t *ret);
+
+
+//--------------------------------------
+// Block Compression
+//--------------------------------------
+
+int sky_data_file_compress(sky_data_file *data_file, uint32_t idle_seconds,
+    uint32_t limit, uint32_t *count);
+
+void sky_data_file_release_cache(sky_data_file *data_file);
+
+
 //--------------------------------------
 // Event Management
 //--------------------------------------
 
 int sky_data_file_add_event(sky_data_file *data_file, sky_event *event);
 
+int sky_data_file_remove_object(sky_data_file *data_file,
+    sky_object_id_t object_id, bool *removed);
+
+int sky_data_file_remove_events(sky_data_file *data_file,
+    sky_object_id_t object_id, sky_timestamp_t timestamp, uint32_t *count);
+
+
+//--------------------------------------
+// Retention
+//--------------------------------------
+
+int sky_data_file_expire(sky_data_file *data_file,
+    sky_timestamp_t expire_before, uint32_t *count);
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+int sky_data_file_get_memory(sky_data_file *data_file, size_t *heap,
+    size_t *resident);
+
 #endif
@@ -0,0 +1,433 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "dictionary_file.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_dictionary_file_replay(sky_dictionary_file *dictionary_file);
+
+int sky_dictionary_file_add_value(sky_dictionary_file *dictionary_file,
+    sky_property_id_t property_id, bstring value, int64_t *code);
+
+sky_dictionary *sky_dictionary_create();
+
+void sky_dictionary_free(sky_dictionary *dictionary);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty dictionary file.
+//
+// Returns a reference to the new dictionary file if successful. Otherwise
+// returns null.
+sky_dictionary_file *sky_dictionary_file_create()
+{
+    sky_dictionary_file *dictionary_file = calloc(1, sizeof(sky_dictionary_file));
+    check_mem(dictionary_file);
+    dictionary_file->fd = -1;
+    return dictionary_file;
+
+error:
+    sky_dictionary_file_free(dictionary_file);
+    return NULL;
+}
+
+// Removes a dictionary file from memory.
+//
+// dictionary_file - The dictionary file to free.
+void sky_dictionary_file_free(sky_dictionary_file *dictionary_file)
+{
+    if(dictionary_file) {
+        sky_dictionary_file_close(dictionary_file);
+        free(dictionary_file);
+    }
+}
+
+// Creates an empty dictionary for a single property.
+//
+// Returns a reference to the new dictionary if successful. Otherwise returns
+// null.
+sky_dictionary *sky_dictionary_create()
+{
+    sky_dictionary *dictionary = calloc(1, sizeof(sky_dictionary));
+    check_mem(dictionary);
+    dictionary->index = sky_name_index_create(); check_mem(dictionary->index);
+    return dictionary;
+
+error:
+    sky_dictionary_free(dictionary);
+    return NULL;
+}
+
+// Removes a dictionary and its values from memory.
+//
+// dictionary - The dictionary to free.
+void sky_dictionary_free(sky_dictionary *dictionary)
+{
+    if(dictionary) {
+        uint32_t i;
+        for(i=0; i<dictionary->value_count; i++) {
+            bdestroy(dictionary->values[i]);
+        }
+        free(dictionary->values);
+        sky_name_index_free(dictionary->index);
+        free(dictionary);
+    }
+}
+
+
+//--------------------------------------
+// Persistence
+//--------------------------------------
+
+// Opens the dictionary file and loads the values that are already in it.
+// The file is created if it does not exist.
+//
+// dictionary_file - The dictionary file.
+// path            - The path to the file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_dictionary_file_open(sky_dictionary_file *dictionary_file,
+                             bstring path)
+{
+    int rc;
+    check(dictionary_file != NULL, "Dictionary file required");
+    check(path != NULL, "Dictionary file path required");
+    check(dictionary_file->fd == -1, "Dictionary file is already open");
+
+    dictionary_file->path = bstrcpy(path); check_mem(dictionary_file->path);
+    dictionary_file->fd = open(bdata(dictionary_file->path), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    check(dictionary_file->fd != -1, "Unable to open dictionary file: %s", bdata(dictionary_file->path));
+
+    rc = sky_dictionary_file_replay(dictionary_file);
+    check(rc == 0, "Unable to load dictionary file: %s", bdata(dictionary_file->path));
+
+    return 0;
+
+error:
+    sky_dictionary_file_close(dictionary_file);
+    return -1;
+}
+
+// Closes the dictionary file and releases its values.
+//
+// dictionary_file - The dictionary file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_dictionary_file_close(sky_dictionary_file *dictionary_file)
+{
+    uint32_t i;
+    check(dictionary_file != NULL, "Dictionary file required");
+
+    if(dictionary_file->fd != -1) {
+        close(dictionary_file->fd);
+        dictionary_file->fd = -1;
+    }
+    bdestroy(dictionary_file->path);
+    dictionary_file->path = NULL;
+    dictionary_file->length = 0;
+
+    for(i=0; i<SKY_PROPERTY_FILE_ID_INDEX_SIZE; i++) {
+        sky_dictionary_free(dictionary_file->dictionaries[i]);
+        dictionary_file->dictionaries[i] = NULL;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Reads every record in the file into memory. A record that runs past the
+// end of the file was only partially written so it is dropped and the file
+// is truncated to the last complete record.
+//
+// dictionary_file - The dictionary file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_dictionary_file_replay(sky_dictionary_file *dictionary_file)
+{
+    int rc;
+    size_t sz;
+    int64_t code;
+    void *data = NULL;
+    off_t size = lseek(dictionary_file->fd, 0, SEEK_END);
+    check(size != -1, "Unable to determine dictionary file size");
+    if(size == 0) {
+        return 0;
+    }
+
+    // Read the whole file. The bytes after the file are zeroed so that the
+    // header of a partial record can be read safely.
+    size_t padding = sizeof(sky_property_id_t) + sizeof(uint32_t) + 1;
+    data = calloc(1, (size_t)size + padding); check_mem(data);
+    ssize_t bytes_read = pread(dictionary_file->fd, data, (size_t)size, 0);
+    check(bytes_read == (ssize_t)size, "Unable to read dictionary file");
+
+    // Load the complete records.
+    void *ptr = data;
+    void *endptr = data + size;
+    while(ptr + sizeof(sky_property_id_t) < endptr) {
+        sky_property_id_t property_id = *((sky_property_id_t*)ptr);
+        void *value_ptr = ptr + sizeof(sky_property_id_t);
+        if(!minipack_is_raw(value_ptr)) {
+            break;
+        }
+        uint32_t length = minipack_unpack_raw(value_ptr, &sz);
+        if(sz == 0 || value_ptr + sz + length > endptr) {
+            break;
+        }
+
+        struct tagbstring value = {-1, (int)length, (unsigned char*)(value_ptr + sz)};
+        rc = sky_dictionary_file_add_value(dictionary_file, property_id, &value, &code);
+        check(rc == 0, "Unable to load dictionary value");
+        ptr = value_ptr + sz + length;
+    }
+    dictionary_file->length = (ptr - data);
+
+    // Drop a partial record.
+    if(dictionary_file->length < (size_t)size) {
+        rc = ftruncate(dictionary_file->fd, dictionary_file->length);
+        check(rc == 0, "Unable to truncate partial dictionary record");
+    }
+
+    free(data);
+    return 0;
+
+error:
+    free(data);
+    return -1;
+}
+
+
+//--------------------------------------
+// Value Management
+//--------------------------------------
+
+// Retrieves the code for a value of a property. The value is added to the
+// property's dictionary and synced to disk if it has not been seen before.
+//
+// dictionary_file - The dictionary file.
+// property_id     - The property that the value belongs to.
+// value           - The string value.
+// code            - A pointer to where the code should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_dictionary_file_encode(sky_dictionary_file *dictionary_file,
+                               sky_property_id_t property_id, bstring value,
+                               int64_t *code)
+{
+    int rc;
+    size_t sz;
+    void *record = NULL;
+    check(dictionary_file != NULL, "Dictionary file required");
+    check(dictionary_file->fd != -1, "Dictionary file must be open to encode a value");
+    check(value != NULL, "Value required");
+    check(code != NULL, "Return address required");
+
+    rc = sky_dictionary_file_find_code(dictionary_file, property_id, value, code);
+    check(rc == 0, "Unable to find dictionary code");
+    if(*code != -1) {
+        return 0;
+    }
+
+    // Write the record to the end of the file and sync it before the code
+    // can be used.
+    size_t record_sz = sizeof(sky_property_id_t) + minipack_sizeof_raw(blength(value)) + blength(value);
+    record = malloc(record_sz); check_mem(record);
+    *((sky_property_id_t*)record) = property_id;
+    minipack_pack_raw(record + sizeof(sky_property_id_t), blength(value), &sz);
+    check(sz != 0, "Unable to pack dictionary value header");
+    memcpy(record + sizeof(sky_property_id_t) + sz, bdata(value), blength(value));
+
+    ssize_t bytes_written = pwrite(dictionary_file->fd, record, record_sz, dictionary_file->length);
+    check(bytes_written == (ssize_t)record_sz, "Unable to write dictionary record");
+    rc = fsync(dictionary_file->fd);
+    check(rc == 0, "Unable to sync dictionary file");
+    dictionary_file->length += record_sz;
+
+    rc = sky_dictionary_file_add_value(dictionary_file, property_id, value, code);
+    check(rc == 0, "Unable to add dictionary value");
+
+    free(record);
+    return 0;
+
+error:
+    free(record);
+    if(code) *code = -1;
+    return -1;
+}
+
+// Retrieves the code for a value of a property without adding it.
+//
+// dictionary_file - The dictionary file.
+// property_id     - The property that the value belongs to.
+// value           - The string value.
+// code            - A pointer to where the code should be returned. This is
+//                   set to -1 if the value is not in the dictionary.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_dictionary_file_find_code(sky_dictionary_file *dictionary_file,
+                                  sky_property_id_t property_id, bstring value,
+                                  int64_t *code)
+{
+    check(dictionary_file != NULL, "Dictionary file required");
+    check(value != NULL, "Value required");
+    check(code != NULL, "Return address required");
+
+    sky_dictionary *dictionary = dictionary_file->dictionaries[(uint8_t)property_id];
+    uintptr_t entry = (uintptr_t)(dictionary != NULL ? sky_name_index_get(dictionary->index, value) : NULL);
+    *code = (entry > 0 ? (int64_t)(entry - 1) : -1);
+
+    return 0;
+
+error:
+    if(code) *code = -1;
+    return -1;
+}
+
+// Retrieves the value for a code of a property.
+//
+// dictionary_file - The dictionary file.
+// property_id     - The property that the code belongs to.
+// code            - The code.
+// ret             - A pointer to where the value should be returned. The
+//                   value is not copied. This is set to null if the code is
+//                   not in the dictionary.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_dictionary_file_find_value(sky_dictionary_file *dictionary_file,
+                                   sky_property_id_t property_id, int64_t code,
+                                   bstring *ret)
+{
+    check(dictionary_file != NULL, "Dictionary file required");
+    check(ret != NULL, "Return address required");
+
+    sky_dictionary *dictionary = dictionary_file->dictionaries[(uint8_t)property_id];
+    if(dictionary != NULL && code >= 0 && code < dictionary->value_count) {
+        *ret = dictionary->values[code];
+    }
+    else {
+        *ret = NULL;
+    }
+
+    return 0;
+
+error:
+    if(ret) *ret = NULL;
+    return -1;
+}
+
+// Checks if any values have been encoded for a property.
+//
+// dictionary_file - The dictionary file.
+// property_id     - The property.
+//
+// Returns true if the property has a dictionary. Otherwise returns false.
+bool sky_dictionary_file_has_property(sky_dictionary_file *dictionary_file,
+                                      sky_property_id_t property_id)
+{
+    return (dictionary_file != NULL && dictionary_file->dictionaries[(uint8_t)property_id] != NULL);
+}
+
+// Adds a value to the in-memory dictionary of a property and assigns it the
+// next code.
+//
+// dictionary_file - The dictionary file.
+// property_id     - The property that the value belongs to.
+// value           - The value. This is copied.
+// code            - A pointer to where the new code should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_dictionary_file_add_value(sky_dictionary_file *dictionary_file,
+                                  sky_property_id_t property_id, bstring value,
+                                  int64_t *code)
+{
+    int rc;
+    bstring copy = NULL;
+
+    // Create the property's dictionary on its first value.
+    sky_dictionary *dictionary = dictionary_file->dictionaries[(uint8_t)property_id];
+    if(dictionary == NULL) {
+        dictionary = sky_dictionary_create(); check_mem(dictionary);
+        dictionary_file->dictionaries[(uint8_t)property_id] = dictionary;
+    }
+    check(dictionary->value_count < INT32_MAX, "No additional dictionary codes available");
+
+    // Grow the values array.
+    if(dictionary->value_count == dictionary->value_capacity) {
+        uint32_t capacity = (dictionary->value_capacity > 0 ? dictionary->value_capacity * 2 : SKY_DICTIONARY_INITIAL_CAPACITY);
+        bstring *values = realloc(dictionary->values, sizeof(*values) * capacity);
+        check_mem(values);
+        dictionary->values = values;
+        dictionary->value_capacity = capacity;
+    }
+
+    copy = bstrcpy(value); check_mem(copy);
+    uint32_t index = dictionary->value_count;
+    rc = sky_name_index_put(dictionary->index, copy, (void*)(uintptr_t)(index + 1));
+    check(rc == 0, "Unable to index dictionary value");
+    dictionary->values[index] = copy;
+    dictionary->value_count++;
+
+    *code = (int64_t)index;
+    return 0;
+
+error:
+    bdestroy(copy);
+    *code = -1;
+    return -1;
+}
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+// Calculates the heap memory used by the values of every dictionary and
+// their indexes.
+//
+// dictionary_file - The dictionary file.
+//
+// Returns the number of bytes.
+size_t sky_dictionary_file_get_memory_usage(sky_dictionary_file *dictionary_file)
+{
+    uint32_t i, j;
+    if(dictionary_file == NULL) {
+        return 0;
+    }
+
+    size_t size = sizeof(*dictionary_file);
+    for(i=0; i<SKY_PROPERTY_FILE_ID_INDEX_SIZE; i++) {
+        sky_dictionary *dictionary = dictionary_file->dictionaries[i];
+        if(dictionary == NULL) {
+            continue;
+        }
+        size += sizeof(*dictionary) + (sizeof(*dictionary->values) * dictionary->value_capacity);
+        size += sky_name_index_get_memory_usage(dictionary->index);
+        for(j=0; j<dictionary->value_count; j++) {
+            if(dictionary->values[j] != NULL) size += sizeof(*dictionary->values[j]) + dictionary->values[j]->mlen;
+        }
+    }
+    return size;
+}
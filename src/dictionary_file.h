@@ -0,0 +1,123 @@
+#ifndef _dictionary_file_h
+#define _dictionary_file_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct sky_dictionary_file sky_dictionary_file;
+
+#include "bstring.h"
+#include "types.h"
+#include "name_index.h"
+#include "property_file.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The dictionary file stores the distinct values of the string properties
+// of a table. Each property has its own dictionary that maps every value to
+// a small integer code, starting from zero in the order the values were
+// first seen. Events store the code of a string value instead of the string
+// itself so repeated values take a byte or two and equality tests on string
+// properties are integer compares.
+//
+// The file is an append-only log of records. Each record is a property id
+// followed by the value as a MessagePack raw. A value's code is its position
+// among the records of its property. New values are synced to disk before
+// their codes are returned so a code is never written to an event before
+// its value is durable. A partially written record at the end of the file
+// is dropped when the file is opened.
+//
+// Values are indexed by code with an array and by string with a hash table
+// so both lookups run in constant time.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The name of the dictionary file in the table directory.
+#define SKY_DICTIONARY_FILE_NAME "dictionary"
+
+// The number of values allocated for the first value of a property.
+#define SKY_DICTIONARY_INITIAL_CAPACITY 16
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// The values of a single property. The index maps a value to its code plus
+// one so that a missing value can be told apart from code zero.
+typedef struct sky_dictionary {
+    bstring *values;
+    uint32_t value_count;
+    uint32_t value_capacity;
+    sky_name_index *index;
+} sky_dictionary;
+
+struct sky_dictionary_file {
+    bstring path;
+    int fd;
+    size_t length;
+    sky_dictionary *dictionaries[SKY_PROPERTY_FILE_ID_INDEX_SIZE];
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_dictionary_file *sky_dictionary_file_create();
+
+void sky_dictionary_file_free(sky_dictionary_file *dictionary_file);
+
+
+//--------------------------------------
+// Persistence
+//--------------------------------------
+
+int sky_dictionary_file_open(sky_dictionary_file *dictionary_file,
+    bstring path);
+
+int sky_dictionary_file_close(sky_dictionary_file *dictionary_file);
+
+
+//--------------------------------------
+// Value Management
+//--------------------------------------
+
+int sky_dictionary_file_encode(sky_dictionary_file *dictionary_file,
+    sky_property_id_t property_id, bstring value, int64_t *code);
+
+int sky_dictionary_file_find_code(sky_dictionary_file *dictionary_file,
+    sky_property_id_t property_id, bstring value, int64_t *code);
+
+int sky_dictionary_file_find_value(sky_dictionary_file *dictionary_file,
+    sky_property_id_t property_id, int64_t code, bstring *ret);
+
+bool sky_dictionary_file_has_property(sky_dictionary_file *dictionary_file,
+    sky_property_id_t property_id);
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+size_t sky_dictionary_file_get_memory_usage(sky_dictionary_file *dictionary_file);
+
+#endif
@@ -156,7 +156,12 @@ size_t sky_eadd_message_sizeof_data(sky_eadd_message *message)
     sz += minipack_sizeof_map(message->data_count);
     for(i=0; i<message->data_count; i++) {
         sky_eadd_message_data *data = message->data[i];
-        sz += minipack_sizeof_raw(blength(data->key)) + blength(data->key);
+        if(data->key != NULL) {
+            sz += minipack_sizeof_raw(blength(data->key)) + blength(data->key);
+        }
+        else {
+            sz += minipack_sizeof_int(data->property_id);
+        }
         
         if(data->data_type == &SKY_DATA_TYPE_STRING) {
             sz += minipack_sizeof_raw(blength(data->string_value)) + blength(data->string_value);
@@ -193,7 +198,7 @@ int sky_eadd_message_pack(sky_eadd_message *message, FILE *file)
     
     // Object ID
     check(sky_minipack_fwrite_bstring(file, &SKY_EADD_KEY_OBJECT_ID) == 0, "Unable to pack object id key");
-    minipack_fwrite_int(file, message->object_id, &sz);
+    minipack_fwrite_uint(file, message->object_id, &sz);
     check(sz != 0, "Unable to pack object id");
 
     // Timestamp
@@ -203,7 +208,7 @@ int sky_eadd_message_pack(sky_eadd_message *message, FILE *file)
 
     // Action ID
     check(sky_minipack_fwrite_bstring(file, &SKY_EADD_KEY_ACTION_ID) == 0, "Unable to pack action_id key");
-    minipack_fwrite_int(file, message->action_id, &sz);
+    minipack_fwrite_uint(file, message->action_id, &sz);
     check(sz != 0, "Unable to pack action id");
     
     // Data
@@ -239,9 +244,15 @@ int sky_eadd_message_pack_data(sky_eadd_message *message, FILE *file)
     for(i=0; i<message->data_count; i++) {
         sky_eadd_message_data *data = message->data[i];
         
-        // Write key.
-        rc = sky_minipack_fwrite_bstring(file, data->key);
-        check(rc == 0, "Unable to pack data key");
+        // Write key as a name or as a property id.
+        if(data->key != NULL) {
+            rc = sky_minipack_fwrite_bstring(file, data->key);
+            check(rc == 0, "Unable to pack data key");
+        }
+        else {
+            minipack_fwrite_int(file, data->property_id, &sz);
+            check(sz > 0, "Unable to pack data property id");
+        }
         
         // Write in the appropriate data type.
         if(data->data_type == &SKY_DATA_TYPE_STRING) {
@@ -346,12 +357,23 @@ int sky_eadd_message_unpack_data(sky_eadd_message *message, FILE *file)
     uint32_t i;
     for(i=0; i<map_length; i++) {
         sky_eadd_message_data *data = sky_eadd_message_data_create(); check_mem(data);
+        message->data[i] = data;
+        message->data_count = i+1;
         
-        rc = sky_minipack_fread_bstring(file, &data->key);
-        check(rc == 0, "Unable to read data key");
+        // Read the key as a name or as a property id.
+        uint8_t buffer[1];
+        check(fread(buffer, sizeof(*buffer), 1, file) == 1, "Unable to read data key type");
+        ungetc(buffer[0], file);
+        if(minipack_is_raw((void*)buffer)) {
+            rc = sky_minipack_fread_bstring(file, &data->key);
+            check(rc == 0, "Unable to read data key");
+        }
+        else {
+            data->property_id = (sky_property_id_t)minipack_fread_int(file, &sz);
+            check(sz != 0, "Unable to read data property id");
+        }
         
         // Read the first byte of the message to determine the type.
-        uint8_t buffer[1];
         check(fread(buffer, sizeof(*buffer), 1, file) == 1, "Unable to read data type");
         ungetc(buffer[0], file);
         
@@ -389,31 +411,31 @@ error:
 // Processing
 //--------------------------------------
 
-// Applies an EADD message to a table.
+// Creates an event from an EADD message. Data keys are converted to the
+// table's property identifiers unless they are already property ids.
 //
 // message - The message.
-// table   - The table to apply the message to.
-// output  - The output stream to write to.
+// table   - The table that the event will be added to.
+// ret     - A pointer to where the new event should be returned.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_eadd_message_process(sky_eadd_message *message, sky_table *table,
-                             FILE *output)
+int sky_eadd_message_create_event(sky_eadd_message *message, sky_table *table,
+                                  sky_event **ret)
 {
     int rc;
-    size_t sz;
+    sky_event *event = NULL;
     check(message != NULL, "Message required");
     check(table != NULL, "Table required");
-    check(output != NULL, "Output stream required");
-
-    struct tagbstring status_str = bsStatic("status");
-    struct tagbstring ok_str = bsStatic("ok");
+    check(ret != NULL, "Event return pointer required");
 
     // Create event object.
-    sky_event *event = sky_event_create(message->object_id, message->timestamp, message->action_id);
+    event = sky_event_create(message->object_id, message->timestamp, message->action_id);
+    check_mem(event);
     
     // Allocate space for event data.
     event->data_count = message->data_count;
-    event->data = calloc(message->data_count, sizeof(*event->data)); check_mem(event->data);
+    event->data = calloc(message->data_count, sizeof(*event->data));
+    if(message->data_count > 0) check_mem(event->data);
     
     // Copy data from message.
     uint32_t i;
@@ -421,10 +443,16 @@ int sky_eadd_message_process(sky_eadd_message *message, sky_table *table,
         sky_event_data *data = NULL;
         sky_eadd_message_data *message_data = message->data[i];
         
-        // Look up property id by name
+        // Look up property by name or by id.
         sky_property *property = NULL;
-        rc = sky_property_file_find_by_name(table->property_file, message_data->key, &property);
-        check(rc == 0 && property != NULL, "Unable to find property '%s' in table: %s", bdata(message_data->key), bdata(table->path));
+        if(message_data->key != NULL) {
+            rc = sky_property_file_find_by_name(table->property_file, message_data->key, &property);
+            check(rc == 0 && property != NULL, "Unable to find property '%s' in table: %s", bdata(message_data->key), bdata(table->path));
+        }
+        else {
+            rc = sky_property_file_find_by_id(table->property_file, message_data->property_id, &property);
+            check(rc == 0 && property != NULL, "Unable to find property #%d in table: %s", message_data->property_id, bdata(table->path));
+        }
         
         // Create event data based on data type.
         if(message_data->data_type == &SKY_DATA_TYPE_STRING) {
@@ -445,18 +473,52 @@ int sky_eadd_message_process(sky_eadd_message *message, sky_table *table,
         
         event->data[i] = data;
     }
+
+    *ret = event;
+    return 0;
+
+error:
+    sky_event_free(event);
+    *ret = NULL;
+    return -1;
+}
+
+// Applies an EADD message to a table.
+//
+// message - The message.
+// table   - The table to apply the message to.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_eadd_message_process(sky_eadd_message *message, sky_table *table,
+                             sky_buffer *output)
+{
+    int rc;
+    sky_event *event = NULL;
+    check(message != NULL, "Message required");
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+
+    // Create event object.
+    rc = sky_eadd_message_create_event(message, table, &event);
+    check(rc == 0, "Unable to create event");
     
     // Add event to table.
     rc = sky_table_add_event(table, event);
     check(rc == 0, "Unable to add event to table");
     
     // Return {status:"OK"}
-    check(minipack_fwrite_map(output, 1, &sz) == 0, "Unable to write output");
-    check(sky_minipack_fwrite_bstring(output, &status_str) == 0, "Unable to write output");
-    check(sky_minipack_fwrite_bstring(output, &ok_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_map(output, 1) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write output");
     
+    sky_event_free(event);
     return 0;
 
 error:
+    sky_event_free(event);
     return -1;
-}
\ No newline at end of file
+}
@@ -6,6 +6,7 @@
 #include <netinet/in.h>
 
 #include "bstring.h"
+#include "buffer.h"
 #include "table.h"
 #include "event.h"
 
@@ -27,9 +28,12 @@ typedef struct sky_eadd_message {
     sky_eadd_message_data **data;
 } sky_eadd_message;
 
-// A key/value used to store event data.
+// A key/value used to store event data. The key is either the name of the
+// property or, when the name is NULL, the property's id. Clients that have
+// cached property ids can send integer keys to skip name resolution.
 struct sky_eadd_message_data {
     bstring key;
+    sky_property_id_t property_id;
     bstring data_type;
     union {
         bool boolean_value;
@@ -73,7 +77,10 @@ int sky_eadd_message_unpack(sky_eadd_message *message, FILE *file);
 // Processing
 //--------------------------------------
 
+int sky_eadd_message_create_event(sky_eadd_message *message, sky_table *table,
+    sky_event **ret);
+
 int sky_eadd_message_process(sky_eadd_message *message, sky_table *table,
-    FILE *output);
+    sky_buffer *output);
 
 #endif
@@ -0,0 +1,206 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <arpa/inet.h>
+
+#include "types.h"
+#include "ebulk_message.h"
+#include "minipack.h"
+#include "endian.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an EBULK message object.
+//
+// Returns a new EBULK message.
+sky_ebulk_message *sky_ebulk_message_create()
+{
+    sky_ebulk_message *message = NULL;
+    message = calloc(1, sizeof(sky_ebulk_message)); check_mem(message);
+    return message;
+
+error:
+    sky_ebulk_message_free(message);
+    return NULL;
+}
+
+// Frees an EBULK message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_ebulk_message_free(sky_ebulk_message *message)
+{
+    if(message) {
+        uint32_t i;
+        for(i=0; i<message->message_count; i++) {
+            sky_eadd_message_free(message->messages[i]);
+            message->messages[i] = NULL;
+        }
+        free(message->messages);
+        message->messages = NULL;
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Calculates the total number of bytes needed to store the message.
+//
+// message - The message.
+//
+// Returns the number of bytes required to store the message.
+size_t sky_ebulk_message_sizeof(sky_ebulk_message *message)
+{
+    uint32_t i;
+    size_t sz = 0;
+    sz += minipack_sizeof_array(message->message_count);
+    for(i=0; i<message->message_count; i++) {
+        sz += sky_eadd_message_sizeof(message->messages[i]);
+    }
+    return sz;
+}
+
+// Serializes an EBULK message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_ebulk_message_pack(sky_ebulk_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    // Array
+    minipack_fwrite_array(file, message->message_count, &sz);
+    check(sz > 0, "Unable to write array");
+
+    // Events
+    uint32_t i;
+    for(i=0; i<message->message_count; i++) {
+        rc = sky_eadd_message_pack(message->messages[i], file);
+        check(rc == 0, "Unable to pack event #%d", i);
+    }
+    
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes an EBULK message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_ebulk_message_unpack(sky_ebulk_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    // Array
+    uint32_t count = minipack_fread_array(file, &sz);
+    check(sz > 0, "Unable to read array");
+
+    // Allocate messages.
+    message->messages = calloc(count, sizeof(*message->messages));
+    if(count > 0) check_mem(message->messages);
+
+    // Events
+    uint32_t i;
+    for(i=0; i<count; i++) {
+        message->messages[i] = sky_eadd_message_create();
+        check_mem(message->messages[i]);
+        message->message_count = i+1;
+
+        rc = sky_eadd_message_unpack(message->messages[i], file);
+        check(rc == 0, "Unable to unpack event #%d", i);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Applies an EBULK message to a table. All events are converted and then
+// sorted before any are inserted so that an invalid event causes the whole
+// message to be rejected.
+//
+// message - The message.
+// table   - The table to apply the message to.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_ebulk_message_process(sky_ebulk_message *message, sky_table *table,
+                              sky_buffer *output)
+{
+    int rc;
+    uint32_t i;
+    sky_event **events = NULL;
+    check(message != NULL, "Message required");
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring count_str = bsStatic("count");
+
+    // Create event objects.
+    events = calloc(message->message_count, sizeof(*events));
+    if(message->message_count > 0) check_mem(events);
+    for(i=0; i<message->message_count; i++) {
+        rc = sky_eadd_message_create_event(message->messages[i], table, &events[i]);
+        check(rc == 0, "Unable to create event #%d", i);
+    }
+
+    // Add events to the table and sync all changes at the end.
+    rc = sky_table_add_events(table, events, message->message_count);
+    check(rc == 0, "Unable to add events to table");
+
+    // Return {status:"OK", count:N}
+    check(sky_buffer_pack_map(output, 2) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &count_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_uint(output, message->message_count) == 0, "Unable to write output");
+    
+    for(i=0; i<message->message_count; i++) {
+        sky_event_free(events[i]);
+    }
+    free(events);
+    return 0;
+
+error:
+    if(events) {
+        for(i=0; i<message->message_count; i++) {
+            sky_event_free(events[i]);
+        }
+        free(events);
+    }
+    return -1;
+}
@@ -0,0 +1,72 @@
+#ifndef _sky_ebulk_message_h
+#define _sky_ebulk_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+#include "event.h"
+#include "eadd_message.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The Event Bulk (EBULK) message adds many events to a table at once. The
+// message body is an array of EADD message bodies. The events are sorted by
+// object id and timestamp before they are inserted so that each block is
+// visited in order, and each modified block and header entry is synced to
+// disk once after all events have been added instead of once per event.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for adding many events to the database at once.
+typedef struct sky_ebulk_message {
+    uint32_t message_count;
+    sky_eadd_message **messages;
+} sky_ebulk_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_ebulk_message *sky_ebulk_message_create();
+
+void sky_ebulk_message_free(sky_ebulk_message *message);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+size_t sky_ebulk_message_sizeof(sky_ebulk_message *message);
+
+int sky_ebulk_message_pack(sky_ebulk_message *message, FILE *file);
+
+int sky_ebulk_message_unpack(sky_ebulk_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_ebulk_message_process(sky_ebulk_message *message, sky_table *table,
+    sky_buffer *output);
+
+#endif
@@ -0,0 +1,430 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <arpa/inet.h>
+
+#include "types.h"
+#include "eget_message.h"
+#include "cursor.h"
+#include "minipack.h"
+#include "minipack_batch.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_eget_message_pack_event(sky_table *table, void *ptr,
+    sky_timestamp_t timestamp, sky_buffer *output);
+
+int sky_eget_message_pack_event_fields(sky_table *table, void *ptr,
+    sky_timestamp_t timestamp, sky_buffer *output);
+
+int sky_eget_message_pack_event_data(sky_table *table, void *ptr,
+    uint32_t length, sky_buffer *output);
+
+int sky_eget_message_pack_data_key(sky_table *table,
+    sky_property_id_t property_id, sky_buffer *output, sky_property **ret);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an EGET message object.
+//
+// Returns a new EGET message.
+sky_eget_message *sky_eget_message_create()
+{
+    sky_eget_message *message = NULL;
+    message = calloc(1, sizeof(sky_eget_message)); check_mem(message);
+    return message;
+
+error:
+    sky_eget_message_free(message);
+    return NULL;
+}
+
+// Frees an EGET message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_eget_message_free(sky_eget_message *message)
+{
+    if(message) {
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Calculates the total number of bytes needed to store the message.
+//
+// message - The message.
+//
+// Returns the number of bytes required to store the message.
+size_t sky_eget_message_sizeof(sky_eget_message *message)
+{
+    size_t sz = 0;
+    sz += minipack_sizeof_uint(message->object_id);
+    return sz;
+}
+
+// Serializes an EGET message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_eget_message_pack(sky_eget_message *message, FILE *file)
+{
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    minipack_fwrite_uint(file, message->object_id, &sz);
+    check(sz > 0, "Unable to pack object id");
+    
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes an EGET message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_eget_message_unpack(sky_eget_message *message, FILE *file)
+{
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    message->object_id = (sky_object_id_t)minipack_fread_uint(file, &sz);
+    check(sz > 0, "Unable to unpack object id");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Applies an EGET message to a table.
+//
+// message - The message.
+// table   - The table to apply the message to.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_eget_message_process(sky_eget_message *message, sky_table *table,
+                             sky_buffer *output)
+{
+    int rc;
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    check(message != NULL, "Message required");
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring events_str = bsStatic("events");
+
+    // Merge buffered events so the lookup sees them.
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge table memtable");
+
+    // Find the path of the object.
+    rc = sky_table_find_path(table, message->object_id, &paths, &path_count);
+    check(rc == 0, "Unable to find path for object: %llu", (unsigned long long)message->object_id);
+
+    // Return.
+    //   {status:"OK", events:[...]}
+    check(sky_buffer_pack_map(output, 2) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    check(sky_buffer_pack_bstring(output, &events_str) == 0, "Unable to write events key");
+    rc = sky_eget_message_pack_path(table, paths, path_count, output);
+    check(rc == 0, "Unable to write events");
+
+    free(paths);
+    return 0;
+
+error:
+    free(paths);
+    return -1;
+}
+
+// Serializes the events of a path as an array in timestamp order. The parts
+// of a spanned path are written one after the other.
+//
+// table      - The table that the path belongs to.
+// paths      - The raw parts of the path.
+// path_count - The number of parts.
+// output     - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_eget_message_pack_path(sky_table *table, void **paths,
+                               uint32_t path_count, sky_buffer *output)
+{
+    int rc;
+    uint32_t i;
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+
+    // Count the events so the array length can be written first.
+    uint32_t event_count = 0;
+    for(i=0; i<path_count; i++) {
+        sky_path_foreach_event(paths[i], event_ptr) {
+            event_count++;
+        }
+    }
+    check(sky_buffer_pack_array(output, event_count) == 0, "Unable to write events array");
+
+    for(i=0; i<path_count; i++) {
+        sky_timestamp_t timestamp = 0;
+        sky_path_foreach_event(paths[i], event_ptr) {
+            timestamp = sky_event_get_timestamp(event_ptr, timestamp);
+            rc = sky_eget_message_pack_event(table, event_ptr, timestamp, output);
+            check(rc == 0, "Unable to write event");
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes a raw event as a map of its timestamp, action id and data.
+//
+// table     - The table that the event belongs to.
+// ptr       - A pointer to the raw event.
+// timestamp - The timestamp of the event.
+// output    - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_eget_message_pack_event(sky_table *table, void *ptr,
+                                sky_timestamp_t timestamp, sky_buffer *output)
+{
+    int rc;
+
+    // {timestamp:0, actionId:0, data:{}}
+    check(sky_buffer_pack_map(output, 3) == 0, "Unable to write event map");
+    rc = sky_eget_message_pack_event_fields(table, ptr, timestamp, output);
+    check(rc == 0, "Unable to write event");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes a raw event that stores its full timestamp as a map that also
+// holds the id of its object.
+//
+// table     - The table that the event belongs to.
+// object_id - The object id of the event.
+// ptr       - A pointer to the raw event.
+// output    - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_eget_message_pack_object_event(sky_table *table,
+                                       sky_object_id_t object_id, void *ptr,
+                                       sky_buffer *output)
+{
+    int rc;
+    check(table != NULL, "Table required");
+    check(ptr != NULL, "Event required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring object_id_str = bsStatic("objectId");
+
+    // {objectId:0, timestamp:0, actionId:0, data:{}}
+    check(sky_buffer_pack_map(output, 4) == 0, "Unable to write event map");
+    check(sky_buffer_pack_bstring(output, &object_id_str) == 0, "Unable to write object id key");
+    check(sky_buffer_pack_uint(output, object_id) == 0, "Unable to write object id");
+    rc = sky_eget_message_pack_event_fields(table, ptr, sky_event_get_timestamp(ptr, 0), output);
+    check(rc == 0, "Unable to write event");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes the timestamp, action id and data keys and values of a raw event.
+//
+// table     - The table that the event belongs to.
+// ptr       - A pointer to the raw event.
+// timestamp - The timestamp of the event.
+// output    - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_eget_message_pack_event_fields(sky_table *table, void *ptr,
+                                       sky_timestamp_t timestamp,
+                                       sky_buffer *output)
+{
+    int rc;
+
+    struct tagbstring timestamp_str = bsStatic("timestamp");
+    struct tagbstring action_id_str = bsStatic("actionId");
+    struct tagbstring data_str = bsStatic("data");
+
+    // Read the event header.
+    sky_event_flag_t flag = *((sky_event_flag_t*)ptr);
+    sky_action_id_t action_id = sky_cursor_fast_get_action_id(ptr);
+    void *data_ptr = NULL;
+    uint32_t data_length = 0;
+    if(flag & SKY_EVENT_FLAG_DATA) {
+        void *length_ptr = ptr + sky_event_header_length(flag) + ((flag & SKY_EVENT_FLAG_ACTION) ? sizeof(sky_action_id_t) : 0);
+        data_length = *((sky_event_data_length_t*)length_ptr);
+        data_ptr = length_ptr + sizeof(sky_event_data_length_t);
+    }
+
+    check(sky_buffer_pack_bstring(output, &timestamp_str) == 0, "Unable to write timestamp key");
+    check(sky_buffer_pack_int(output, timestamp) == 0, "Unable to write timestamp");
+    check(sky_buffer_pack_bstring(output, &action_id_str) == 0, "Unable to write action id key");
+    check(sky_buffer_pack_uint(output, action_id) == 0, "Unable to write action id");
+    check(sky_buffer_pack_bstring(output, &data_str) == 0, "Unable to write data key");
+    rc = sky_eget_message_pack_event_data(table, data_ptr, data_length, output);
+    check(rc == 0, "Unable to write event data");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes the raw data section of an event as a map keyed by property
+// name. The values are copied as they are stored except for dictionary codes
+// of String properties which are written as their string values and values
+// of the fixed section which are packed as MessagePack values.
+//
+// table  - The table that the event belongs to.
+// ptr    - A pointer to the data section or NULL.
+// length - The length of the data section.
+// output - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_eget_message_pack_event_data(sky_table *table, void *ptr,
+                                     uint32_t length, sky_buffer *output)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    void *end_ptr = ptr + length;
+    uint32_t fixed_count = sky_event_data_get_fixed_count(ptr, length);
+    void *items_ptr = ptr + sky_event_data_get_fixed_length(ptr, length);
+
+    // Count the data items.
+    uint32_t count = fixed_count;
+    void *item_ptr = items_ptr;
+    while(item_ptr != NULL && item_ptr < end_ptr) {
+        item_ptr += sizeof(sky_property_id_t);
+        sz = sky_minipack_batch_sizeof_elem(item_ptr);
+        check(sz > 0, "Invalid event data value");
+        item_ptr += sz;
+        count++;
+    }
+
+    check(sky_buffer_pack_map(output, count) == 0, "Unable to write data map");
+
+    // Write each fixed value.
+    for(i=0; i<fixed_count; i++) {
+        sky_event_data_view view;
+        uint8_t value[SKY_EVENT_DATA_FIXED_PACKED_LENGTH];
+        sky_event_data_get_fixed_view(ptr, i, &view);
+        rc = sky_eget_message_pack_data_key(table, view.key, output, NULL);
+        check(rc == 0, "Unable to write data key");
+        rc = sky_event_data_view_pack(&view, value, &sz);
+        check(rc == 0, "Unable to pack fixed value");
+        check(sky_buffer_write(output, value, sz) == 0, "Unable to write data value");
+    }
+
+    // Write each key and value.
+    item_ptr = items_ptr;
+    while(item_ptr != NULL && item_ptr < end_ptr) {
+        sky_property_id_t property_id = *((sky_property_id_t*)item_ptr);
+        item_ptr += sizeof(sky_property_id_t);
+
+        sky_property *property = NULL;
+        rc = sky_eget_message_pack_data_key(table, property_id, output, &property);
+        check(rc == 0, "Unable to write data key");
+
+        // Decode dictionary codes.
+        bstring value = NULL;
+        if(property != NULL && !minipack_is_raw(item_ptr) && biseq(property->data_type, &SKY_DATA_TYPE_STRING) == 1) {
+            int64_t code = minipack_unpack_int(item_ptr, &sz);
+            check(sz > 0, "Unable to read dictionary code");
+            rc = sky_dictionary_file_find_value(table->dictionary_file, property_id, code, &value);
+            check(rc == 0, "Unable to decode value for property: %d", property_id);
+        }
+
+        sz = sky_minipack_batch_sizeof_elem(item_ptr);
+        if(value != NULL) {
+            check(sky_buffer_pack_bstring(output, value) == 0, "Unable to write data value");
+        }
+        else {
+            check(sky_buffer_write(output, item_ptr, sz) == 0, "Unable to write data value");
+        }
+        item_ptr += sz;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes the key of a data value, which is the name of its property or the
+// property id if the property is not defined.
+//
+// table       - The table that the event belongs to.
+// property_id - The property id of the value.
+// output      - The buffer to write the response to.
+// ret         - A pointer to where the property should be returned or NULL.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_eget_message_pack_data_key(sky_table *table,
+                                   sky_property_id_t property_id,
+                                   sky_buffer *output, sky_property **ret)
+{
+    sky_property *property = NULL;
+    int rc = sky_property_file_find_by_id(table->property_file, property_id, &property);
+    check(rc == 0, "Unable to find property: %d", property_id);
+    if(property != NULL) {
+        check(sky_buffer_pack_bstring(output, property->name) == 0, "Unable to write data key");
+    }
+    else {
+        check(sky_buffer_pack_int(output, property_id) == 0, "Unable to write data property id");
+    }
+
+    if(ret != NULL) *ret = property;
+    return 0;
+
+error:
+    if(ret) *ret = NULL;
+    return -1;
+}
@@ -0,0 +1,82 @@
+#ifndef _sky_eget_message_h
+#define _sky_eget_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+#include "event.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The Event Get (EGET) message retrieves every event of a single object. The
+// message body is the object id. The path is located with a binary search
+// over the block object id ranges so the cost of the lookup does not depend
+// on the size of the table.
+//
+// The response lists the events in timestamp order:
+//
+//   {status:"ok", events:[{timestamp:0, actionId:0, data:{name:value}}]}
+//
+// Data keys are property names. Properties that are no longer defined on
+// the table are keyed by their property id.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for retrieving the events of an object from a table.
+typedef struct sky_eget_message {
+    sky_object_id_t object_id;
+} sky_eget_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_eget_message *sky_eget_message_create();
+
+void sky_eget_message_free(sky_eget_message *message);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+size_t sky_eget_message_sizeof(sky_eget_message *message);
+
+int sky_eget_message_pack(sky_eget_message *message, FILE *file);
+
+int sky_eget_message_unpack(sky_eget_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_eget_message_process(sky_eget_message *message, sky_table *table,
+    sky_buffer *output);
+
+int sky_eget_message_pack_path(sky_table *table, void **paths,
+    uint32_t path_count, sky_buffer *output);
+
+int sky_eget_message_pack_object_event(sky_table *table,
+    sky_object_id_t object_id, void *ptr, sky_buffer *output);
+
+#endif
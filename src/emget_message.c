@@ -0,0 +1,521 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "types.h"
+#include "emget_message.h"
+#include "eget_message.h"
+#include "path_iterator.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// A requested object that falls inside the object id range of a block. The
+// position is where the block is in the sorted block list of the data file
+// and the block index is where it is stored.
+typedef struct sky_emget_message_lookup {
+    sky_object_id_t object_id;
+    uint32_t position;
+    uint32_t block_index;
+} sky_emget_message_lookup;
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_emget_message_process_data_file(sky_table *table,
+    sky_data_file *data_file, sky_object_id_t *object_ids,
+    uint32_t object_id_count, sky_object_id_t *found_ids,
+    sky_emget_message_lookup *lookups, sky_block **blocks, void **paths,
+    sky_buffer *output);
+
+int sky_emget_message_process_block(sky_table *table, sky_data_file *data_file,
+    sky_emget_message_lookup *lookups, uint32_t lookup_count,
+    sky_object_id_t *object_ids, void **paths, sky_buffer *output);
+
+int sky_emget_message_process_span(sky_table *table, sky_data_file *data_file,
+    sky_object_id_t object_id, uint32_t position, void **paths,
+    sky_buffer *output);
+
+int sky_emget_message_pack_frame_header(uint32_t object_count,
+    sky_buffer *output);
+
+int sky_emget_message_compare_object_ids(const void *_a, const void *_b);
+
+int sky_emget_message_compare_lookups(const void *_a, const void *_b);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an EMGET message object.
+//
+// Returns a new EMGET message.
+sky_emget_message *sky_emget_message_create()
+{
+    sky_emget_message *message = NULL;
+    message = calloc(1, sizeof(sky_emget_message)); check_mem(message);
+    return message;
+
+error:
+    sky_emget_message_free(message);
+    return NULL;
+}
+
+// Frees an EMGET message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_emget_message_free(sky_emget_message *message)
+{
+    if(message) {
+        free(message->object_ids);
+        message->object_ids = NULL;
+        message->object_id_count = 0;
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Calculates the total number of bytes needed to store the message.
+//
+// message - The message.
+//
+// Returns the number of bytes required to store the message.
+size_t sky_emget_message_sizeof(sky_emget_message *message)
+{
+    uint32_t i;
+    size_t sz = 0;
+    sz += minipack_sizeof_array(message->object_id_count);
+    for(i=0; i<message->object_id_count; i++) {
+        sz += minipack_sizeof_uint(message->object_ids[i]);
+    }
+    return sz;
+}
+
+// Serializes an EMGET message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_emget_message_pack(sky_emget_message *message, FILE *file)
+{
+    size_t sz;
+    uint32_t i;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    minipack_fwrite_array(file, message->object_id_count, &sz);
+    check(sz > 0, "Unable to pack object id array");
+
+    for(i=0; i<message->object_id_count; i++) {
+        minipack_fwrite_uint(file, message->object_ids[i], &sz);
+        check(sz > 0, "Unable to pack object id");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes an EMGET message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_emget_message_unpack(sky_emget_message *message, FILE *file)
+{
+    size_t sz;
+    uint32_t i;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    uint32_t count = minipack_fread_array(file, &sz);
+    check(sz > 0, "Unable to unpack object id array");
+
+    free(message->object_ids);
+    message->object_ids = calloc(count, sizeof(*message->object_ids));
+    if(count > 0) check_mem(message->object_ids);
+    message->object_id_count = count;
+
+    for(i=0; i<count; i++) {
+        message->object_ids[i] = (sky_object_id_t)minipack_fread_uint(file, &sz);
+        check(sz > 0, "Unable to unpack object id #%d", i);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Applies an EMGET message to a table. The sorted object ids are matched
+// against the block ranges of each data file in one pass and the matches
+// are regrouped by the storage order of their blocks. Each block is then
+// read once and written as one frame of the response.
+//
+// message - The message.
+// table   - The table to apply the message to.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_emget_message_process(sky_emget_message *message, sky_table *table,
+                              sky_buffer *output)
+{
+    int rc;
+    uint32_t i;
+    sky_object_id_t *object_ids = NULL;
+    sky_object_id_t *found_ids = NULL;
+    sky_emget_message_lookup *lookups = NULL;
+    sky_block **blocks = NULL;
+    void **paths = NULL;
+    check(message != NULL, "Message required");
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+
+    // Merge buffered events so the lookups see them.
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge table memtable");
+
+    // Sort the requested ids and drop duplicates.
+    uint32_t object_id_count = message->object_id_count;
+    if(object_id_count > 0) {
+        object_ids = malloc(sizeof(*object_ids) * object_id_count); check_mem(object_ids);
+        memcpy(object_ids, message->object_ids, sizeof(*object_ids) * object_id_count);
+        qsort(object_ids, object_id_count, sizeof(*object_ids), sky_emget_message_compare_object_ids);
+
+        uint32_t unique_count = 1;
+        for(i=1; i<object_id_count; i++) {
+            if(object_ids[i] != object_ids[unique_count-1]) {
+                object_ids[unique_count++] = object_ids[i];
+            }
+        }
+        object_id_count = unique_count;
+
+        found_ids = malloc(sizeof(*found_ids) * object_id_count); check_mem(found_ids);
+        lookups = malloc(sizeof(*lookups) * object_id_count); check_mem(lookups);
+        blocks = malloc(sizeof(*blocks) * object_id_count); check_mem(blocks);
+        paths = malloc(sizeof(*paths) * object_id_count); check_mem(paths);
+    }
+
+    // Look up the objects of each data file. The shards of a sharded table
+    // each hold a disjoint set of the objects. An object of a partitioned
+    // table is written in a frame for each partition it has events in, in
+    // time order.
+    //   {data:{<objectId>:[...]}} ... {status:"ok"}
+    for(i=0; i<sky_table_get_data_file_count(table) && object_id_count > 0; i++) {
+        rc = sky_emget_message_process_data_file(table, sky_table_get_data_file(table, i), object_ids, object_id_count, found_ids, lookups, blocks, paths, output);
+        check(rc == 0, "Unable to process data file #%d", i);
+    }
+
+    check(sky_buffer_pack_map(output, 1) == 0, "Unable to write final frame map");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+
+    free(paths);
+    free(blocks);
+    free(lookups);
+    free(found_ids);
+    free(object_ids);
+    return 0;
+
+error:
+    free(paths);
+    free(blocks);
+    free(lookups);
+    free(found_ids);
+    free(object_ids);
+    return -1;
+}
+
+// Writes the frames of the requested objects whose paths are in one data
+// file of the table.
+//
+// table           - The table.
+// data_file       - The data file to read.
+// object_ids      - The sorted, unique ids of the requested objects.
+// object_id_count - The number of requested objects.
+// found_ids       - Scratch space for the ids of the paths that are found.
+// lookups         - Scratch space for the lookups of the data file.
+// blocks          - Scratch space for the blocks that are prefetched.
+// paths           - Scratch space for the paths that are found.
+// output          - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_emget_message_process_data_file(sky_table *table,
+                                        sky_data_file *data_file,
+                                        sky_object_id_t *object_ids,
+                                        uint32_t object_id_count,
+                                        sky_object_id_t *found_ids,
+                                        sky_emget_message_lookup *lookups,
+                                        sky_block **blocks, void **paths,
+                                        sky_buffer *output)
+{
+    int rc;
+    uint32_t i, j;
+
+    // Match the ids against the block ranges. Both are sorted so each block
+    // range is passed over at most once. Objects that belong to another
+    // shard are skipped. The partitions of a partitioned table each hold a
+    // part of any object's path.
+    uint32_t lookup_count = 0;
+    for(i=0, j=0; i<object_id_count; i++) {
+        sky_data_file *object_data_file = sky_table_get_object_data_file(table, object_ids[i]);
+        if(object_data_file != NULL && object_data_file != data_file) continue;
+        while(j < data_file->block_count && data_file->block_max_object_ids[j] < object_ids[i]) {
+            j++;
+        }
+        if(j == data_file->block_count) break;
+        if(data_file->block_min_object_ids[j] > object_ids[i]) continue;
+
+        lookups[lookup_count].object_id = object_ids[i];
+        lookups[lookup_count].position = j;
+        lookups[lookup_count].block_index = data_file->blocks[j]->index;
+        lookup_count++;
+    }
+
+    // Order the lookups by where their blocks are stored.
+    qsort(lookups, lookup_count, sizeof(*lookups), sky_emget_message_compare_lookups);
+
+    // Queue every block that will be read, including the later parts of
+    // spanned paths, so that reads run ahead of the sweep.
+    if(data_file->prefetcher != NULL && lookup_count > 0) {
+        uint32_t block_count = 0;
+        for(i=0; i<lookup_count; i++) {
+            if(i > 0 && lookups[i].position == lookups[i-1].position) continue;
+            sky_block *block = data_file->blocks[lookups[i].position];
+            if(block->spanned) {
+                rc = sky_data_file_prefetch_blocks(data_file, data_file->blocks, lookups[i].position, lookups[i].position + block->span_count);
+                check(rc == 0, "Unable to prefetch spanned path");
+            }
+            else {
+                blocks[block_count++] = block;
+            }
+        }
+        rc = sky_data_file_prefetch_blocks(data_file, blocks, 0, block_count);
+        check(rc == 0, "Unable to prefetch blocks");
+    }
+
+    // Read each block once and write the paths found in it as a frame.
+    for(i=0; i<lookup_count; i=j) {
+        for(j=i+1; j<lookup_count && lookups[j].position == lookups[i].position; j++);
+        rc = sky_emget_message_process_block(table, data_file, &lookups[i], j-i, found_ids, paths, output);
+        check(rc == 0, "Unable to process block: %d", lookups[i].block_index);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Finds the paths of the lookups that share a block with one walk over the
+// block and writes them as a frame. Nothing is written if none of the
+// objects have a path in the block.
+//
+// table        - The table.
+// data_file    - The data file of the block.
+// lookups      - The lookups of the block in object id order.
+// lookup_count - The number of lookups.
+// object_ids   - Scratch space for the ids of the paths that are found.
+// paths        - Scratch space for the paths that are found.
+// output       - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_emget_message_process_block(sky_table *table,
+                                    sky_data_file *data_file,
+                                    sky_emget_message_lookup *lookups,
+                                    uint32_t lookup_count,
+                                    sky_object_id_t *object_ids, void **paths,
+                                    sky_buffer *output)
+{
+    int rc;
+    uint32_t i;
+    bool pinned = false;
+    sky_path_iterator iterator;
+    sky_path_iterator_init(&iterator);
+    sky_block *block = data_file->blocks[lookups[0].position];
+
+    // A spanned block holds the first part of a single path.
+    if(block->spanned) {
+        rc = sky_emget_message_process_span(table, data_file, lookups[0].object_id, lookups[0].position, paths, output);
+        check(rc == 0, "Unable to process spanned path");
+        return 0;
+    }
+
+    // Keep a compressed block decompressed until its frame is written.
+    rc = sky_block_pin(block);
+    check(rc == 0, "Unable to pin block");
+    pinned = true;
+
+    rc = sky_path_iterator_set_block(&iterator, block);
+    check(rc == 0, "Unable to set path iterator block");
+
+    uint32_t found_count = 0;
+    for(i=0; i<lookup_count && !iterator.eof; i++) {
+        while(!iterator.eof && iterator.current_object_id < lookups[i].object_id) {
+            rc = sky_path_iterator_next(&iterator);
+            check(rc == 0, "Unable to move to next path");
+        }
+        if(!iterator.eof && iterator.current_object_id == lookups[i].object_id) {
+            rc = sky_path_iterator_get_ptr(&iterator, &paths[found_count]);
+            check(rc == 0, "Unable to retrieve path pointer");
+            object_ids[found_count++] = lookups[i].object_id;
+        }
+    }
+
+    if(found_count > 0) {
+        rc = sky_emget_message_pack_frame_header(found_count, output);
+        check(rc == 0, "Unable to write frame header");
+        for(i=0; i<found_count; i++) {
+            check(sky_buffer_pack_uint(output, object_ids[i]) == 0, "Unable to write object id");
+            rc = sky_eget_message_pack_path(table, &paths[i], 1, output);
+            check(rc == 0, "Unable to write events");
+        }
+        rc = sky_buffer_flush(output);
+        check(rc == 0, "Unable to flush frame");
+    }
+
+    sky_path_iterator_uninit(&iterator);
+    sky_block_unpin(block);
+    return 0;
+
+error:
+    sky_path_iterator_uninit(&iterator);
+    if(pinned) sky_block_unpin(block);
+    return -1;
+}
+
+// Writes a spanned path as a frame. The parts of the path are read in the
+// order of their blocks.
+//
+// table     - The table.
+// data_file - The data file of the path.
+// object_id - The object id of the path.
+// position  - The sorted position of the first block of the span.
+// paths     - Scratch space with room for at least one pointer.
+// output    - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_emget_message_process_span(sky_table *table, sky_data_file *data_file,
+                                   sky_object_id_t object_id, uint32_t position,
+                                   void **paths, sky_buffer *output)
+{
+    int rc;
+    uint32_t i;
+    uint32_t span_count = 0;
+    uint32_t pinned_count = 0;
+    void **parts = NULL;
+
+    rc = sky_block_get_span_count(data_file->blocks[position], &span_count);
+    check(rc == 0, "Unable to calculate span count");
+
+    parts = (span_count == 1 ? paths : malloc(sizeof(*parts) * span_count));
+    check_mem(parts);
+    for(i=0; i<span_count; i++) {
+        rc = sky_block_pin(data_file->blocks[position+i]);
+        check(rc == 0, "Unable to pin block");
+        pinned_count++;
+        rc = sky_block_get_ptr(data_file->blocks[position+i], &parts[i]);
+        check(rc == 0, "Unable to retrieve block pointer");
+    }
+
+    rc = sky_emget_message_pack_frame_header(1, output);
+    check(rc == 0, "Unable to write frame header");
+    check(sky_buffer_pack_uint(output, object_id) == 0, "Unable to write object id");
+    rc = sky_eget_message_pack_path(table, parts, span_count, output);
+    check(rc == 0, "Unable to write events");
+    rc = sky_buffer_flush(output);
+    check(rc == 0, "Unable to flush frame");
+
+    for(i=0; i<pinned_count; i++) {
+        sky_block_unpin(data_file->blocks[position+i]);
+    }
+    if(parts != paths) free(parts);
+    return 0;
+
+error:
+    for(i=0; i<pinned_count; i++) {
+        sky_block_unpin(data_file->blocks[position+i]);
+    }
+    if(parts != paths) free(parts);
+    return -1;
+}
+
+// Writes the start of a frame up to the map of object ids.
+//
+// object_count - The number of objects in the frame.
+// output       - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_emget_message_pack_frame_header(uint32_t object_count,
+                                        sky_buffer *output)
+{
+    struct tagbstring data_str = bsStatic("data");
+    check(sky_buffer_pack_map(output, 1) == 0, "Unable to write frame map");
+    check(sky_buffer_pack_bstring(output, &data_str) == 0, "Unable to write data key");
+    check(sky_buffer_pack_map(output, object_count) == 0, "Unable to write objects map");
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Sorting
+//--------------------------------------
+
+// Compares two object ids.
+int sky_emget_message_compare_object_ids(const void *_a, const void *_b)
+{
+    sky_object_id_t a = *((sky_object_id_t*)_a);
+    sky_object_id_t b = *((sky_object_id_t*)_b);
+    return (a > b) - (a < b);
+}
+
+// Compares two lookups by the storage index of their block and then by
+// object id.
+int sky_emget_message_compare_lookups(const void *_a, const void *_b)
+{
+    sky_emget_message_lookup *a = (sky_emget_message_lookup*)_a;
+    sky_emget_message_lookup *b = (sky_emget_message_lookup*)_b;
+    if(a->block_index != b->block_index) {
+        return (a->block_index > b->block_index) - (a->block_index < b->block_index);
+    }
+    return (a->object_id > b->object_id) - (a->object_id < b->object_id);
+}
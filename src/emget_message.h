@@ -0,0 +1,87 @@
+#ifndef _sky_emget_message_h
+#define _sky_emget_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+#include "event.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The Event Multi Get (EMGET) message retrieves every event of many objects
+// at once. The message body is an array of object ids. Looking each object
+// up with an EGET message reads the blocks in the order of the requests,
+// which is random I/O for large batches. Instead the ids are sorted and
+// resolved against the block object id ranges in a single merge pass. The
+// blocks that may hold a requested object are then sorted by where they are
+// stored in the data file, handed to the prefetcher and read once each in
+// that order, so a batch costs about one sequential sweep of the blocks it
+// touches. Duplicate ids are only returned once.
+//
+// The response is streamed like a streamed query. Each block that holds at
+// least one requested path is written as a frame that maps object ids to
+// their events and is sent as soon as it is encoded:
+//
+//   {data:{<objectId>:[{timestamp:0, actionId:0, data:{name:value}}]}}
+//
+// Objects without a path are left out. The stream ends with a {status:"ok"}
+// frame. Frames are in storage order rather than object id order and
+// clients combine them into one map. Events are written as in an EGET
+// response. A failed stream is ended by closing the connection, so EMGET
+// messages are sent straight to a node instead of through a coordinator.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for retrieving the events of many objects from a table.
+typedef struct sky_emget_message {
+    sky_object_id_t *object_ids;
+    uint32_t object_id_count;
+} sky_emget_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_emget_message *sky_emget_message_create();
+
+void sky_emget_message_free(sky_emget_message *message);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+size_t sky_emget_message_sizeof(sky_emget_message *message);
+
+int sky_emget_message_pack(sky_emget_message *message, FILE *file);
+
+int sky_emget_message_unpack(sky_emget_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_emget_message_process(sky_emget_message *message, sky_table *table,
+    sky_buffer *output);
+
+#endif
@@ -38,9 +38,13 @@ uint64_t bswap64(uint64_t value);
 #if (BYTE_ORDER == LITTLE_ENDIAN)
 #define htonll(x) bswap64(x)
 #define ntohll(x) bswap64(x)
+#define htolell(x) x
+#define letohll(x) x
 #else
 #define htonll(x) x
 #define ntohll(x) x
+#define htolell(x) bswap64(x)
+#define letohll(x) bswap64(x)
 #endif
 
 #endif
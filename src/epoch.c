@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "epoch.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+void sky_epoch_release(sky_epoch *epoch, uint64_t value);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an epoch with no readers.
+//
+// Returns a reference to the new epoch if successful. Otherwise returns null.
+sky_epoch *sky_epoch_create()
+{
+    sky_epoch *epoch = calloc(1, sizeof(sky_epoch)); check_mem(epoch);
+    return epoch;
+
+error:
+    sky_epoch_free(epoch);
+    return NULL;
+}
+
+// Releases all retired memory and removes an epoch from memory. There must
+// be no readers left.
+//
+// epoch - The epoch to free.
+void sky_epoch_free(sky_epoch *epoch)
+{
+    if(epoch) {
+        sky_epoch_release(epoch, UINT64_MAX);
+        free(epoch->retirees);
+        epoch->retirees = NULL;
+        free(epoch);
+    }
+}
+
+
+//--------------------------------------
+// Readers
+//--------------------------------------
+
+// Enters the current epoch. Memory that is retired while the reader is in
+// the epoch is not released until the reader exits.
+//
+// epoch - The epoch.
+//
+// Returns the epoch that was entered. This must be passed to
+// sky_epoch_exit().
+uint64_t sky_epoch_enter(sky_epoch *epoch)
+{
+    // The epoch may advance between reading it and counting the reader. The
+    // writer may have missed the count so the reader tries again.
+    while(true) {
+        uint64_t value = __sync_add_and_fetch(&epoch->value, 0);
+        __sync_add_and_fetch(&epoch->reader_counts[value & 1], 1);
+        if(__sync_add_and_fetch(&epoch->value, 0) == value) {
+            return value;
+        }
+        __sync_sub_and_fetch(&epoch->reader_counts[value & 1], 1);
+    }
+}
+
+// Exits an epoch that was entered by a reader.
+//
+// epoch - The epoch.
+// value - The epoch returned by sky_epoch_enter().
+void sky_epoch_exit(sky_epoch *epoch, uint64_t value)
+{
+    __sync_sub_and_fetch(&epoch->reader_counts[value & 1], 1);
+}
+
+// Checks if any reader is currently in the epoch. Writers can update memory
+// in place when there are no readers.
+//
+// epoch - The epoch.
+//
+// Returns true if there are readers.
+bool sky_epoch_has_readers(sky_epoch *epoch)
+{
+    return __sync_add_and_fetch(&epoch->reader_counts[0], 0) > 0
+        || __sync_add_and_fetch(&epoch->reader_counts[1], 0) > 0;
+}
+
+
+//--------------------------------------
+// Reclamation
+//--------------------------------------
+
+// Retires memory that readers may still be using. The memory must already
+// be unreachable for new readers. Any memory that is no longer in use is
+// reclaimed afterwards.
+//
+// epoch     - The epoch.
+// ptr       - The memory to retire.
+// length    - The length of the memory.
+// free_func - The function that releases the memory.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_epoch_retire(sky_epoch *epoch, void *ptr, size_t length,
+                     sky_epoch_free_func free_func)
+{
+    check(epoch != NULL, "Epoch required");
+    check(free_func != NULL, "Free function required");
+    if(ptr == NULL) {
+        return 0;
+    }
+
+    sky_epoch_retiree *retirees = realloc(epoch->retirees, sizeof(*retirees) * (epoch->retiree_count+1));
+    check_mem(retirees);
+    epoch->retirees = retirees;
+
+    __sync_synchronize();
+    sky_epoch_retiree *retiree = &epoch->retirees[epoch->retiree_count++];
+    retiree->ptr = ptr;
+    retiree->length = length;
+    retiree->free_func = free_func;
+    retiree->value = epoch->value;
+
+    sky_epoch_reclaim(epoch);
+    return 0;
+
+error:
+    return -1;
+}
+
+// Advances the epoch as far as the readers allow and releases the memory
+// that no reader can be using anymore.
+//
+// epoch - The epoch.
+void sky_epoch_reclaim(sky_epoch *epoch)
+{
+    if(epoch == NULL || epoch->retiree_count == 0) {
+        return;
+    }
+
+    // The epoch can advance once the readers of the previous epoch are gone.
+    uint32_t i;
+    for(i=0; i<2; i++) {
+        uint64_t value = epoch->value;
+        if(__sync_add_and_fetch(&epoch->reader_counts[(value+1) & 1], 0) > 0) {
+            break;
+        }
+        __sync_add_and_fetch(&epoch->value, 1);
+    }
+
+    if(epoch->value >= 2) {
+        sky_epoch_release(epoch, epoch->value - 2);
+    }
+}
+
+// Releases the memory retired in an epoch or earlier.
+//
+// epoch - The epoch.
+// value - The last epoch to release memory from.
+void sky_epoch_release(sky_epoch *epoch, uint64_t value)
+{
+    uint32_t i, count = 0;
+    for(i=0; i<epoch->retiree_count; i++) {
+        sky_epoch_retiree *retiree = &epoch->retirees[i];
+        if(retiree->value <= value) {
+            retiree->free_func(retiree->ptr, retiree->length);
+        }
+        else {
+            epoch->retirees[count++] = *retiree;
+        }
+    }
+    epoch->retiree_count = count;
+}
+
+// Releases retired heap memory.
+//
+// ptr    - The memory.
+// length - The length of the memory.
+void sky_epoch_free_heap(void *ptr, size_t length)
+{
+    (void)length;
+    free(ptr);
+}
+
+// Releases a retired memory mapping.
+//
+// ptr    - The mapping.
+// length - The length of the mapping.
+void sky_epoch_free_mapping(void *ptr, size_t length)
+{
+    munmap(ptr, length);
+}
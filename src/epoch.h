@@ -0,0 +1,96 @@
+#ifndef _epoch_h
+#define _epoch_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct sky_epoch sky_epoch;
+typedef struct sky_epoch_retiree sky_epoch_retiree;
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// An epoch lets readers on other threads keep using memory that a single
+// writer has replaced. Readers enter the current epoch before they read and
+// exit it once they are done. Instead of freeing the memory it replaces, the
+// writer retires it and the memory is only released once every reader that
+// could still hold a pointer to it has exited.
+//
+// Memory retired in epoch N is released once the epoch has advanced to N+2.
+// The writer only advances the epoch from N to N+1 once no reader is left
+// in epoch N-1, so by the time the epoch reaches N+2 every reader that
+// entered in epoch N or earlier is gone. Readers are only counted, so
+// entering and exiting is a pair of atomic increments and never waits on
+// the writer.
+//
+// Retiring and reclaiming is not thread safe. Only the writer that owns the
+// memory may do it.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// Releases retired memory.
+typedef void (*sky_epoch_free_func)(void *ptr, size_t length);
+
+struct sky_epoch_retiree {
+    void *ptr;
+    size_t length;
+    sky_epoch_free_func free_func;
+    uint64_t value;
+};
+
+struct sky_epoch {
+    uint64_t value;
+    uint32_t reader_counts[2];
+    sky_epoch_retiree *retirees;
+    uint32_t retiree_count;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_epoch *sky_epoch_create();
+
+void sky_epoch_free(sky_epoch *epoch);
+
+//--------------------------------------
+// Readers
+//--------------------------------------
+
+uint64_t sky_epoch_enter(sky_epoch *epoch);
+
+void sky_epoch_exit(sky_epoch *epoch, uint64_t value);
+
+bool sky_epoch_has_readers(sky_epoch *epoch);
+
+//--------------------------------------
+// Reclamation
+//--------------------------------------
+
+int sky_epoch_retire(sky_epoch *epoch, void *ptr, size_t length,
+    sky_epoch_free_func free_func);
+
+void sky_epoch_reclaim(sky_epoch *epoch);
+
+void sky_epoch_free_heap(void *ptr, size_t length);
+
+void sky_epoch_free_mapping(void *ptr, size_t length);
+
+#endif
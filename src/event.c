@@ -1,13 +1,34 @@
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "dbg.h"
 #include "endian.h"
 #include "bstring.h"
 #include "event.h"
+#include "minipack.h"
+#include "minipack_batch.h"
 #include "mem.h"
 
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_event_pack_with_delta(sky_event *event,
+    sky_timestamp_t previous_timestamp, size_t delta_length, void *ptr,
+    size_t *sz);
+
+int sky_event_pack_hdr_with_delta(sky_timestamp_t timestamp,
+    sky_timestamp_t previous_timestamp, size_t delta_length,
+    sky_action_id_t action_id, sky_event_data_length_t data_length,
+    void *ptr, size_t *sz);
+
+void sky_event_write_delta(void *ptr, uint64_t delta, size_t length);
+
+
 //==============================================================================
 //
 // Functions
@@ -232,12 +253,14 @@ size_t sky_event_sizeof(sky_event *event)
 // of the event.
 sky_event_data_length_t sky_event_sizeof_data(sky_event *event)
 {
-    size_t sz = 0;
+    size_t sz = sky_event_data_sizeof_fixed(event->data, event->data_count);
     
-    // Add size for each data item.
+    // Add size for each data item outside of the fixed section.
     uint64_t i;
     for(i=0; i<event->data_count; i++) {
-        sz += sky_event_data_sizeof(event->data[i]);
+        if(!sky_event_data_is_fixed(event->data[i])) {
+            sz += sky_event_data_sizeof(event->data[i]);
+        }
     }
     
     return sz;
@@ -255,8 +278,7 @@ size_t sky_event_sizeof_raw(void *ptr)
     char event_flag = *((sky_event_flag_t*)ptr);
 
     // Add event flag and timestamp.
-    sz += sizeof(sky_event_flag_t);
-    sz += sizeof(sky_timestamp_t);
+    sz += sky_event_header_length(event_flag);
 
     // Add action length.
     if(event_flag & SKY_EVENT_FLAG_ACTION) {
@@ -273,13 +295,56 @@ size_t sky_event_sizeof_raw(void *ptr)
     return sz;
 }    
 
+// Calculates the number of bytes needed to store an event after an event
+// with a given timestamp. The timestamp is stored as a delta if the delta
+// fits in a delta field.
+//
+// event              - The event.
+// previous_timestamp - The timestamp of the event before it in the path.
+//
+// Returns the length of the raw event.
+size_t sky_event_sizeof_delta(sky_event *event,
+                              sky_timestamp_t previous_timestamp)
+{
+    size_t sz = sky_event_sizeof(event);
+    size_t delta_length = sky_event_sizeof_timestamp_delta(event->timestamp, previous_timestamp);
+    if(delta_length > 0) {
+        sz -= sizeof(sky_timestamp_t) - delta_length;
+    }
+    return sz;
+}
+
+// Calculates the number of bytes needed to store the difference between a
+// timestamp and the timestamp of the event before it.
+//
+// timestamp          - The timestamp.
+// previous_timestamp - The timestamp of the event before it in the path.
+//
+// Returns the number of bytes in the delta or zero if the delta cannot be
+// stored in a delta field.
+size_t sky_event_sizeof_timestamp_delta(sky_timestamp_t timestamp,
+                                        sky_timestamp_t previous_timestamp)
+{
+    if(timestamp < previous_timestamp) {
+        return 0;
+    }
+
+    uint64_t delta = (uint64_t)timestamp - (uint64_t)previous_timestamp;
+    size_t length = 1;
+    while(length <= SKY_EVENT_DELTA_MAX_LENGTH && (delta >> (length * 8)) > 0) {
+        length++;
+    }
+    return (length <= SKY_EVENT_DELTA_MAX_LENGTH ? length : 0);
+}
+
 
 
 //--------------------------------------
 // Pack
 //--------------------------------------
 
-// Serializes an event to memory at a given pointer location.
+// Serializes an event to memory at a given pointer location. The full
+// timestamp is stored.
 //
 // event - The event to pack.
 // ptr   - The pointer to the current location.
@@ -287,6 +352,41 @@ size_t sky_event_sizeof_raw(void *ptr)
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_event_pack(sky_event *event, void *ptr, size_t *sz)
+{
+    return sky_event_pack_with_delta(event, 0, 0, ptr, sz);
+}
+
+// Serializes an event to memory after an event with a given timestamp. The
+// timestamp is stored as a delta from the previous timestamp if the delta
+// fits in a delta field. Otherwise the full timestamp is stored.
+//
+// event              - The event to pack.
+// previous_timestamp - The timestamp of the event before it in the path.
+// ptr                - The pointer to the current location.
+// sz                 - The number of bytes written.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_event_pack_delta(sky_event *event, sky_timestamp_t previous_timestamp,
+                         void *ptr, size_t *sz)
+{
+    size_t delta_length = (event != NULL ? sky_event_sizeof_timestamp_delta(event->timestamp, previous_timestamp) : 0);
+    return sky_event_pack_with_delta(event, previous_timestamp, delta_length, ptr, sz);
+}
+
+// Serializes an event to memory with its timestamp stored in a given number
+// of bytes.
+//
+// event              - The event to pack.
+// previous_timestamp - The timestamp of the event before it in the path.
+// delta_length       - The number of bytes in the timestamp delta or zero if
+//                      the full timestamp is stored.
+// ptr                - The pointer to the current location.
+// sz                 - The number of bytes written.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_event_pack_with_delta(sky_event *event,
+                              sky_timestamp_t previous_timestamp,
+                              size_t delta_length, void *ptr, size_t *sz)
 {
     int rc;
     size_t _sz;
@@ -298,13 +398,20 @@ int sky_event_pack(sky_event *event, void *ptr, size_t *sz)
     
     // Pack header.
     size_t data_length = sky_event_sizeof_data(event);
-    rc = sky_event_pack_hdr(event->timestamp, event->action_id, data_length, ptr, &_sz);
+    rc = sky_event_pack_hdr_with_delta(event->timestamp, previous_timestamp, delta_length, event->action_id, data_length, ptr, &_sz);
     check(rc == 0, "Unable to pack event header");
     ptr += _sz;
 
-    // Pack data.
+    // Pack the fixed section and then the rest of the data.
+    rc = sky_event_data_pack_fixed(event->data, event->data_count, ptr, &_sz);
+    check(rc == 0, "Unable to pack fixed event data at %p", ptr);
+    ptr += _sz;
+
     uint64_t i;
     for(i=0; i<event->data_count; i++) {
+        if(sky_event_data_is_fixed(event->data[i])) {
+            continue;
+        }
         rc = sky_event_data_pack(event->data[i], ptr, &_sz);
         check(rc == 0, "Unable to pack event data at %p", ptr);
         ptr += _sz;
@@ -323,6 +430,7 @@ error:
 }
 
 // Serializes the header of an event to memory at a given pointer location.
+// The full timestamp is stored.
 //
 // timestamp   - The timestamp of the event.
 // action_id   - The action id of the event.
@@ -335,20 +443,51 @@ int sky_event_pack_hdr(sky_timestamp_t timestamp,
                        sky_action_id_t action_id,
                        sky_event_data_length_t data_length,
                        void *ptr, size_t *sz)
+{
+    return sky_event_pack_hdr_with_delta(timestamp, 0, 0, action_id, data_length, ptr, sz);
+}
+
+// Serializes the header of an event to memory with its timestamp stored in
+// a given number of bytes.
+//
+// timestamp          - The timestamp of the event.
+// previous_timestamp - The timestamp of the event before it in the path.
+// delta_length       - The number of bytes in the timestamp delta or zero if
+//                      the full timestamp is stored.
+// action_id          - The action id of the event.
+// data_length        - The length, in bytes, of the data section of the event.
+// ptr                - The pointer to the current location.
+// sz                 - The number of bytes written.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_event_pack_hdr_with_delta(sky_timestamp_t timestamp,
+                                  sky_timestamp_t previous_timestamp,
+                                  size_t delta_length,
+                                  sky_action_id_t action_id,
+                                  sky_event_data_length_t data_length,
+                                  void *ptr, size_t *sz)
 {
     void *start = ptr;
     
     // Validate.
     check(ptr != NULL, "Pointer required");
+    check(delta_length <= SKY_EVENT_DELTA_MAX_LENGTH, "Invalid timestamp delta length: %ld", delta_length);
     
     // Write event flag.
     sky_event_flag_t flag = sky_event_get_flag(action_id, data_length);
+    flag |= (sky_event_flag_t)(delta_length << SKY_EVENT_DELTA_SHIFT);
     *((sky_event_flag_t*)ptr) = flag;
     ptr += sizeof(flag);
     
-    // Write timestamp.
-    *((sky_timestamp_t*)ptr) = timestamp;
-    ptr += sizeof(sky_timestamp_t);
+    // Write timestamp or timestamp delta.
+    if(delta_length > 0) {
+        sky_event_write_delta(ptr, (uint64_t)timestamp - (uint64_t)previous_timestamp, delta_length);
+        ptr += delta_length;
+    }
+    else {
+        *((sky_timestamp_t*)ptr) = timestamp;
+        ptr += sizeof(sky_timestamp_t);
+    }
     
     // Write action id.
     if(action_id != 0) {
@@ -374,7 +513,94 @@ error:
     return -1;
 }
 
-// Deserializes an event from a given file at the file's current offset.
+// Copies a raw event to memory and stores its full timestamp. This is used
+// when an event becomes the first event of a path segment.
+//
+// source    - A pointer to the raw event to copy.
+// timestamp - The timestamp of the event.
+// ptr       - The pointer to the current location.
+// sz        - The number of bytes written.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_event_pack_raw(void *source, sky_timestamp_t timestamp, void *ptr,
+                       size_t *sz)
+{
+    check(source != NULL, "Source pointer required");
+    check(ptr != NULL, "Pointer required");
+
+    // Write the flag without a delta length and then the timestamp.
+    sky_event_flag_t flag = *((sky_event_flag_t*)source);
+    size_t header_length = sky_event_header_length(flag);
+    size_t body_length = sky_event_sizeof_raw(source) - header_length;
+    *((sky_event_flag_t*)ptr) = (flag & ~SKY_EVENT_DELTA_MASK);
+    *((sky_timestamp_t*)(ptr + sizeof(sky_event_flag_t))) = timestamp;
+
+    // Copy the action id and data.
+    memmove(ptr + (SKY_EVENT_HEADER_LENGTH), source + header_length, body_length);
+
+    if(sz != NULL) {
+        *sz = (SKY_EVENT_HEADER_LENGTH) + body_length;
+    }
+    return 0;
+
+error:
+    if(sz) *sz = 0;
+    return -1;
+}
+
+// Copies a raw event to memory and stores its timestamp as a delta from the
+// timestamp of the event before it. The full timestamp is kept if the source
+// event stores one or if the delta does not fit in a delta field. The target
+// may overlap the source.
+//
+// source             - A pointer to the raw event to copy.
+// timestamp          - The timestamp of the event.
+// previous_timestamp - The timestamp of the event before it in the path.
+// ptr                - The pointer to the current location.
+// sz                 - The number of bytes written.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_event_pack_raw_delta(void *source, sky_timestamp_t timestamp,
+                             sky_timestamp_t previous_timestamp, void *ptr,
+                             size_t *sz)
+{
+    check(source != NULL, "Source pointer required");
+    check(ptr != NULL, "Pointer required");
+
+    sky_event_flag_t flag = *((sky_event_flag_t*)source);
+    size_t header_length = sky_event_header_length(flag);
+    size_t body_length = sky_event_sizeof_raw(source) - header_length;
+    size_t delta_length = 0;
+    if(flag & SKY_EVENT_DELTA_MASK) {
+        delta_length = sky_event_sizeof_timestamp_delta(timestamp, previous_timestamp);
+    }
+
+    // Move the action id and data first so the new header cannot overwrite
+    // them when the copy overlaps.
+    size_t new_header_length = sizeof(sky_event_flag_t) + (delta_length > 0 ? delta_length : sizeof(sky_timestamp_t));
+    memmove(ptr + new_header_length, source + header_length, body_length);
+
+    *((sky_event_flag_t*)ptr) = (flag & ~SKY_EVENT_DELTA_MASK) | (sky_event_flag_t)(delta_length << SKY_EVENT_DELTA_SHIFT);
+    if(delta_length > 0) {
+        sky_event_write_delta(ptr + sizeof(sky_event_flag_t), (uint64_t)timestamp - (uint64_t)previous_timestamp, delta_length);
+    }
+    else {
+        *((sky_timestamp_t*)(ptr + sizeof(sky_event_flag_t))) = timestamp;
+    }
+
+    if(sz != NULL) {
+        *sz = new_header_length + body_length;
+    }
+    return 0;
+
+error:
+    if(sz) *sz = 0;
+    return -1;
+}
+
+// Deserializes an event from memory. If the raw event stores a timestamp
+// delta then the event's timestamp must be set to the timestamp of the event
+// before it in the path.
 //
 // event - The event to unpack into.
 // ptr   - The pointer to the current location.
@@ -399,13 +625,47 @@ int sky_event_unpack(sky_event *event, void *ptr, size_t *sz)
 
     // Clear existing data.
     clear_data(event);
-    
-    // Unpack data.
-    int index = 0;
+
+    // Count the data items so the data array is only allocated once.
     void *endptr = ptr + data_length;
-    while(ptr < endptr) {
-        check(allocate_data(event) == 0, "Unable to append event data");
+    uint32_t fixed_count = sky_event_data_get_fixed_count(ptr, data_length);
+    uint32_t data_count = fixed_count;
+    void *item_ptr = ptr + sky_event_data_get_fixed_length(ptr, data_length);
+    while(item_ptr < endptr) {
+        size_t value_sz = sky_minipack_batch_sizeof_elem(item_ptr + sizeof(sky_property_id_t));
+        check(value_sz > 0, "Invalid event data at %p", item_ptr);
+        item_ptr += sizeof(sky_property_id_t) + value_sz;
+        data_count++;
+    }
+    if(data_count > 0) {
+        event->data = calloc(data_count, sizeof(*event->data)); check_mem(event->data);
+    }
+
+    // Unpack the fixed section. Its values stay fixed when repacked.
+    uint32_t index = 0;
+    for(; index<fixed_count; index++) {
+        sky_event_data_view view;
+        sky_event_data_get_fixed_view(ptr, index, &view);
+        if(view.type == SKY_EVENT_DATA_TYPE_INT) {
+            event->data[index] = sky_event_data_create_int(view.key, view.int_value);
+        }
+        else if(view.type == SKY_EVENT_DATA_TYPE_FLOAT) {
+            event->data[index] = sky_event_data_create_float(view.key, view.float_value);
+        }
+        else {
+            event->data[index] = sky_event_data_create_boolean(view.key, view.boolean_value);
+        }
+        check_mem(event->data[index]);
+        event->data[index]->fixed = true;
+        event->data_count++;
+    }
+    ptr += sky_event_data_get_fixed_length(ptr, data_length);
+
+    // Unpack the rest of the data.
+    while(ptr < endptr && index < data_count) {
         event->data[index] = sky_event_data_create(0);
+        check_mem(event->data[index]);
+        event->data_count++;
 
         rc = sky_event_data_unpack(event->data[index], ptr, &_sz);
         check(rc == 0, "Unable to unpack event data at %p", ptr);
@@ -424,7 +684,9 @@ error:
     return -1;
 }
 
-// Deserializes an event header from memory.
+// Deserializes an event header from memory. If the raw event stores a
+// timestamp delta then the timestamp must point to the timestamp of the
+// event before it in the path.
 //
 // timestamp   - A pointer to where the event timestamp will be returned.
 // action_id   - A pointer to where the event's action id will be returned.
@@ -448,8 +710,8 @@ int sky_event_unpack_hdr(sky_timestamp_t *timestamp,
     ptr += sizeof(flag);
 
     // Read timestamp.
-    *timestamp = *((sky_timestamp_t*)ptr);
-    ptr += sizeof(sky_timestamp_t);
+    *timestamp = sky_event_get_timestamp(start, *timestamp);
+    ptr += sky_event_timestamp_length(flag);
     
     // Read action if one exists.
     if(flag & SKY_EVENT_FLAG_ACTION) {
@@ -481,6 +743,114 @@ error:
     return -1;
 }
 
+// Deserializes a raw event into a view without allocating. The data section
+// is not decoded but can be read with sky_event_view_get_data() or
+// sky_event_data_view_unpack(). If the raw event stores a timestamp delta
+// then the view's timestamp must be set to the timestamp of the event before
+// it in the path.
+//
+// view - The event view to unpack into.
+// ptr  - The pointer to the current location.
+// sz   - The number of bytes read.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_event_unpack_view(sky_event_view *view, void *ptr, size_t *sz)
+{
+    int rc;
+    size_t _sz;
+    check(view != NULL, "Event view required");
+    check(ptr != NULL, "Pointer required");
+
+    rc = sky_event_unpack_hdr(&view->timestamp, &view->action_id, &view->data_length, ptr, &_sz);
+    check(rc == 0, "Unable to unpack event header");
+    view->data_ptr = (view->data_length > 0 ? ptr + _sz : NULL);
+
+    // Store number of bytes read.
+    if(sz != NULL) *sz = _sz + view->data_length;
+
+    return 0;
+
+error:
+    if(sz) *sz = 0;
+    return -1;
+}
+
+
+
+//--------------------------------------
+// Timestamps
+//--------------------------------------
+
+// Retrieves the timestamp of a raw event.
+//
+// ptr                - A pointer to the raw event.
+// previous_timestamp - The timestamp of the event before it in the path. This
+//                      is ignored if the event stores its full timestamp.
+//
+// Returns the timestamp of the event.
+sky_timestamp_t sky_event_get_timestamp(void *ptr,
+                                        sky_timestamp_t previous_timestamp)
+{
+    sky_event_flag_t flag = *((sky_event_flag_t*)ptr);
+    size_t delta_length = (flag & SKY_EVENT_DELTA_MASK) >> SKY_EVENT_DELTA_SHIFT;
+    if(delta_length == 0) {
+        return *((sky_timestamp_t*)(ptr + sizeof(sky_event_flag_t)));
+    }
+
+    // Read the little endian delta.
+    uint8_t *bytes = ptr + sizeof(sky_event_flag_t);
+    uint64_t delta = 0;
+    size_t i;
+    for(i=0; i<delta_length; i++) {
+        delta |= ((uint64_t)bytes[i]) << (i * 8);
+    }
+    return (sky_timestamp_t)((uint64_t)previous_timestamp + delta);
+}
+
+// Changes the timestamp of a raw event in place without changing the length
+// of the event. A delta is rewritten against the new previous timestamp so
+// the new delta must fit in the existing delta field.
+//
+// ptr                - A pointer to the raw event.
+// timestamp          - The timestamp of the event.
+// previous_timestamp - The timestamp of the event before it in the path.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_event_set_timestamp(void *ptr, sky_timestamp_t timestamp,
+                            sky_timestamp_t previous_timestamp)
+{
+    check(ptr != NULL, "Pointer required");
+
+    sky_event_flag_t flag = *((sky_event_flag_t*)ptr);
+    size_t delta_length = (flag & SKY_EVENT_DELTA_MASK) >> SKY_EVENT_DELTA_SHIFT;
+    if(delta_length == 0) {
+        *((sky_timestamp_t*)(ptr + sizeof(sky_event_flag_t))) = timestamp;
+    }
+    else {
+        size_t length = sky_event_sizeof_timestamp_delta(timestamp, previous_timestamp);
+        check(length > 0 && length <= delta_length, "Timestamp delta does not fit in event");
+        sky_event_write_delta(ptr + sizeof(sky_event_flag_t), (uint64_t)timestamp - (uint64_t)previous_timestamp, delta_length);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes a timestamp delta as a little endian unsigned integer.
+//
+// ptr    - The pointer to write to.
+// delta  - The delta to write.
+// length - The number of bytes to write.
+void sky_event_write_delta(void *ptr, uint64_t delta, size_t length)
+{
+    uint8_t *bytes = ptr;
+    size_t i;
+    for(i=0; i<length; i++) {
+        bytes[i] = (uint8_t)(delta >> (i * 8));
+    }
+}
 
 
 //--------------------------------------
@@ -524,6 +894,44 @@ error:
     return -1;
 }
 
+// Retrieves the data element for a given key from an event view without
+// allocating.
+//
+// view - The event view containing the data.
+// key  - The key to lookup.
+// data - The data view to unpack into. Its type is set to
+//        SKY_EVENT_DATA_TYPE_NONE if the key is not found.
+//
+// Returns 0 if successful, otherwise -1.
+int sky_event_view_get_data(sky_event_view *view, sky_property_id_t key,
+                            sky_event_data_view *data)
+{
+    int rc;
+    size_t sz;
+    check(view != NULL, "Event view required");
+    check(data != NULL, "Event data view required");
+
+    if(sky_event_data_find_fixed(view->data_ptr, view->data_length, key, data)) {
+        return 0;
+    }
+
+    void *ptr = sky_event_data_find(view->data_ptr, view->data_length, key);
+    if(ptr != NULL) {
+        ptr -= sizeof(sky_property_id_t);
+        rc = sky_event_data_view_unpack(data, ptr, &sz);
+        check(rc == 0, "Unable to unpack event data at %p", ptr);
+        return 0;
+    }
+
+    data->key = key;
+    data->type = SKY_EVENT_DATA_TYPE_NONE;
+    return 0;
+
+error:
+    if(data) data->type = SKY_EVENT_DATA_TYPE_NONE;
+    return -1;
+}
+
 // Sets data on an event.
 //
 // key - The key id to set for the data.
@@ -32,6 +32,13 @@
  * change over time without destroying data stored in the past. That also means
  * that searches across the data will take into account the state of an object
  * at a specific point in time.
+ *
+ * Within a path, the timestamp of an event can be stored as the difference
+ * from the timestamp of the event before it. Bits 2-4 of the flag hold the
+ * number of bytes in the delta, which is stored as a little endian unsigned
+ * integer. When the bits are zero the full 8-byte timestamp is stored
+ * instead. The first event of every path segment in a block always stores
+ * its full timestamp so that a segment can be read on its own.
  */
 
 
@@ -48,8 +55,30 @@
 #define SKY_EVENT_FLAG_ACTION  1
 #define SKY_EVENT_FLAG_DATA    2
 
+#define SKY_EVENT_DELTA_SHIFT  2
+#define SKY_EVENT_DELTA_MASK   0x1C
+
+// The largest number of bytes that a timestamp delta can be stored in.
+#define SKY_EVENT_DELTA_MAX_LENGTH 7
+
+// The length of an event header that stores a full timestamp. This is the
+// largest that an event header can be.
 #define SKY_EVENT_HEADER_LENGTH sizeof(sky_event_flag_t) + sizeof(sky_timestamp_t)
 
+// Calculates the number of bytes used to store the timestamp of an event.
+//
+// FLAG - The flag of the raw event.
+#define sky_event_timestamp_length(FLAG) \
+    (((FLAG) & SKY_EVENT_DELTA_MASK) ?\
+        (size_t)(((FLAG) & SKY_EVENT_DELTA_MASK) >> SKY_EVENT_DELTA_SHIFT) : sizeof(sky_timestamp_t))
+
+// Calculates the length of the header of a raw event, which is the flag and
+// the timestamp.
+//
+// FLAG - The flag of the raw event.
+#define sky_event_header_length(FLAG) \
+    (sizeof(sky_event_flag_t) + sky_event_timestamp_length(FLAG))
+
 
 //==============================================================================
 //
@@ -65,6 +94,16 @@ typedef struct sky_event {
     sky_event_data **data;
 } sky_event;
 
+// A non-owning view of a raw event. The data pointer points into the raw
+// event so a view is only valid for as long as the memory it was unpacked
+// from.
+typedef struct sky_event_view {
+    sky_timestamp_t timestamp;
+    sky_action_id_t action_id;
+    void *data_ptr;
+    sky_event_data_length_t data_length;
+} sky_event_view;
+
 
 //==============================================================================
 //
@@ -95,8 +134,23 @@ sky_event_data_length_t sky_event_sizeof_data(sky_event *event);
 
 size_t sky_event_sizeof_raw(void *ptr);
 
+size_t sky_event_sizeof_delta(sky_event *event,
+    sky_timestamp_t previous_timestamp);
+
+size_t sky_event_sizeof_timestamp_delta(sky_timestamp_t timestamp,
+    sky_timestamp_t previous_timestamp);
+
 int sky_event_pack(sky_event *event, void *ptr, size_t *sz);
 
+int sky_event_pack_delta(sky_event *event, sky_timestamp_t previous_timestamp,
+    void *ptr, size_t *sz);
+
+int sky_event_pack_raw(void *source, sky_timestamp_t timestamp, void *ptr,
+    size_t *sz);
+
+int sky_event_pack_raw_delta(void *source, sky_timestamp_t timestamp,
+    sky_timestamp_t previous_timestamp, void *ptr, size_t *sz);
+
 int sky_event_pack_hdr(sky_timestamp_t timestamp, sky_action_id_t action_id,
     sky_event_data_length_t data_length, void *ptr, size_t *sz);
 
@@ -105,6 +159,19 @@ int sky_event_unpack(sky_event *event, void *ptr, size_t *sz);
 int sky_event_unpack_hdr(sky_timestamp_t *timestamp, sky_action_id_t *action_id,
     sky_event_data_length_t *data_length, void *ptr, size_t *sz);
 
+int sky_event_unpack_view(sky_event_view *view, void *ptr, size_t *sz);
+
+
+//--------------------------------------
+// Timestamps
+//--------------------------------------
+
+sky_timestamp_t sky_event_get_timestamp(void *ptr,
+    sky_timestamp_t previous_timestamp);
+
+int sky_event_set_timestamp(void *ptr, sky_timestamp_t timestamp,
+    sky_timestamp_t previous_timestamp);
+
 
 //--------------------------------------
 // Data Management
@@ -118,5 +185,8 @@ int sky_event_set_data(sky_event *event, sky_property_id_t key,
 
 int sky_event_unset_data(sky_event *event, sky_property_id_t key);
 
+int sky_event_view_get_data(sky_event_view *view, sky_property_id_t key,
+                            sky_event_data_view *data);
+
 
 #endif
@@ -1,13 +1,16 @@
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "dbg.h"
 #include "bstring.h"
+#include "endian.h"
 #include "event.h"
 #include "property.h"
 #include "mem.h"
 #include "minipack.h"
+#include "minipack_batch.h"
 
 //==============================================================================
 //
@@ -142,6 +145,8 @@ int sky_event_data_copy(sky_event_data *source, sky_event_data **target)
     else {
         sentinel("Invalid data type for event data: '%s'", bdata(source->data_type));
     }
+    check_mem(*target);
+    (*target)->fixed = source->fixed;
 
     return 0;
     
@@ -153,6 +158,66 @@ error:
 }
 
 
+//--------------------------------------
+// Values
+//--------------------------------------
+
+// Retrieves the value of event data as an integer the same way that query
+// filters read it. Booleans are 0 or 1 and floats are truncated.
+//
+// data  - The event data.
+// value - A pointer to where the value should be returned.
+//
+// Returns true if the data is numeric.
+bool sky_event_data_get_numeric_value(sky_event_data *data, int64_t *value)
+{
+    if(data->data_type == &SKY_DATA_TYPE_INT) {
+        *value = data->int_value;
+    }
+    else if(data->data_type == &SKY_DATA_TYPE_FLOAT) {
+        *value = (int64_t)data->float_value;
+    }
+    else if(data->data_type == &SKY_DATA_TYPE_BOOLEAN) {
+        *value = (data->boolean_value ? 1 : 0);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+// Retrieves the value of an event data view as an integer the same way that
+// query filters read it. Booleans are 0 or 1 and floats are truncated.
+//
+// view  - The event data view.
+// value - A pointer to where the value should be returned.
+//
+// Returns true if the view is numeric.
+bool sky_event_data_view_get_numeric_value(sky_event_data_view *view,
+                                           int64_t *value)
+{
+    switch(view->type) {
+        case SKY_EVENT_DATA_TYPE_INT: *value = view->int_value; return true;
+        case SKY_EVENT_DATA_TYPE_FLOAT: *value = (int64_t)view->float_value; return true;
+        case SKY_EVENT_DATA_TYPE_BOOLEAN: *value = (view->boolean_value ? 1 : 0); return true;
+        default: return false;
+    }
+}
+
+// Checks whether event data is stored in the fixed section of an event.
+// Only data of fixed Int, Float and Boolean properties is.
+//
+// data - The event data.
+//
+// Returns true if the data is stored in the fixed section.
+bool sky_event_data_is_fixed(sky_event_data *data)
+{
+    return (data->fixed && (data->data_type == &SKY_DATA_TYPE_INT ||
+        data->data_type == &SKY_DATA_TYPE_FLOAT ||
+        data->data_type == &SKY_DATA_TYPE_BOOLEAN));
+}
+
+
 //--------------------------------------
 // Serialization
 //--------------------------------------
@@ -320,3 +385,365 @@ error:
     *sz = 0;
     return -1;
 }
+
+// Deserializes event data into a view without allocating. The view's type
+// is determined from the data and string values point into the raw data.
+//
+// view - The event data view to unpack into.
+// ptr  - The pointer to the current location.
+// sz   - The number of bytes read.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_event_data_view_unpack(sky_event_data_view *view, void *ptr,
+                               size_t *sz)
+{
+    size_t _sz;
+    void *start = ptr;
+
+    // Validate.
+    check(view != NULL, "Event data view required");
+    check(ptr != NULL, "Pointer required");
+
+    // Read key.
+    view->key = *((sky_property_id_t*)ptr);
+    ptr += sizeof(view->key);
+
+    // Read value.
+    if(minipack_is_raw(ptr)) {
+        view->type = SKY_EVENT_DATA_TYPE_STRING;
+        view->string_value.length = minipack_unpack_raw(ptr, &_sz);
+        check(_sz != 0, "Unable to unpack event value header at %p", ptr);
+        ptr += _sz;
+        view->string_value.ptr = (char*)ptr;
+        ptr += view->string_value.length;
+    }
+    else if(minipack_is_bool(ptr)) {
+        view->type = SKY_EVENT_DATA_TYPE_BOOLEAN;
+        view->boolean_value = minipack_unpack_bool(ptr, &_sz);
+        check(_sz != 0, "Unable to unpack event boolean value");
+        ptr += _sz;
+    }
+    else if(minipack_is_double(ptr)) {
+        view->type = SKY_EVENT_DATA_TYPE_FLOAT;
+        view->float_value = minipack_unpack_double(ptr, &_sz);
+        check(_sz != 0, "Unable to unpack event float value");
+        ptr += _sz;
+    }
+    else {
+        view->type = SKY_EVENT_DATA_TYPE_INT;
+        view->int_value = minipack_unpack_int(ptr, &_sz);
+        check(_sz != 0, "Unable to unpack event int value");
+        ptr += _sz;
+    }
+
+    // Store number of bytes read.
+    if(sz != NULL) *sz = (ptr-start);
+
+    return 0;
+
+error:
+    if(view) view->type = SKY_EVENT_DATA_TYPE_NONE;
+    if(sz) *sz = 0;
+    return -1;
+}
+
+// Serializes an event data view as a MessagePack value. This is used to hand
+// values from the fixed section to code that reads MessagePack values.
+//
+// view - The event data view to pack.
+// ptr  - The pointer to the current location.
+// sz   - The number of bytes written.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_event_data_view_pack(sky_event_data_view *view, void *ptr,
+                             size_t *sz)
+{
+    size_t _sz = 0;
+    check(view != NULL, "Event data view required");
+    check(ptr != NULL, "Pointer required");
+
+    switch(view->type) {
+        case SKY_EVENT_DATA_TYPE_INT: {
+            minipack_pack_int(ptr, view->int_value, &_sz);
+            break;
+        }
+        case SKY_EVENT_DATA_TYPE_FLOAT: {
+            minipack_pack_double(ptr, view->float_value, &_sz);
+            break;
+        }
+        case SKY_EVENT_DATA_TYPE_BOOLEAN: {
+            minipack_pack_bool(ptr, view->boolean_value, &_sz);
+            break;
+        }
+        case SKY_EVENT_DATA_TYPE_STRING: {
+            minipack_pack_raw(ptr, view->string_value.length, &_sz);
+            check(_sz != 0, "Unable to pack string header");
+            memmove(ptr + _sz, view->string_value.ptr, view->string_value.length);
+            _sz += view->string_value.length;
+            break;
+        }
+        default: {
+            sentinel("Event data view has no value");
+        }
+    }
+    check(_sz != 0, "Unable to pack event data view");
+
+    if(sz != NULL) *sz = _sz;
+    return 0;
+
+error:
+    if(sz) *sz = 0;
+    return -1;
+}
+
+
+//--------------------------------------
+// Fixed Section
+//--------------------------------------
+
+// Calculates the number of bytes needed to store the fixed section for a
+// list of event data.
+//
+// data  - The event data of an event.
+// count - The number of event data items.
+//
+// Returns the length of the fixed section or zero if none of the data is
+// fixed.
+size_t sky_event_data_sizeof_fixed(sky_event_data **data, uint32_t count)
+{
+    uint32_t i;
+    uint32_t fixed_count = 0;
+    size_t sz = 0;
+    for(i=0; i<count; i++) {
+        if(sky_event_data_is_fixed(data[i])) {
+            fixed_count++;
+            sz += (data[i]->data_type == &SKY_DATA_TYPE_BOOLEAN ? 1 : SKY_EVENT_DATA_FIXED_VALUE_LENGTH);
+        }
+    }
+    if(fixed_count == 0) {
+        return 0;
+    }
+    return SKY_EVENT_DATA_FIXED_HEADER_LENGTH + (fixed_count * sizeof(sky_property_id_t)) + sz;
+}
+
+// Serializes the fixed section for a list of event data. Nothing is written
+// if none of the data is fixed.
+//
+// data  - The event data of an event.
+// count - The number of event data items.
+// ptr   - The pointer to the current location.
+// sz    - The number of bytes written.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_event_data_pack_fixed(sky_event_data **data, uint32_t count,
+                              void *ptr, size_t *sz)
+{
+    uint32_t i;
+    uint32_t int_count = 0, float_count = 0, boolean_count = 0;
+    check(data != NULL || count == 0, "Event data required");
+    check(ptr != NULL, "Pointer required");
+
+    for(i=0; i<count; i++) {
+        if(sky_event_data_is_fixed(data[i])) {
+            if(data[i]->data_type == &SKY_DATA_TYPE_INT) int_count++;
+            else if(data[i]->data_type == &SKY_DATA_TYPE_FLOAT) float_count++;
+            else boolean_count++;
+        }
+    }
+    check(int_count <= UINT8_MAX && float_count <= UINT8_MAX && boolean_count <= UINT8_MAX, "Too many fixed values on event");
+
+    uint32_t fixed_count = int_count + float_count + boolean_count;
+    if(fixed_count == 0) {
+        if(sz != NULL) *sz = 0;
+        return 0;
+    }
+
+    // Write the header.
+    uint8_t *counts = ptr + sizeof(sky_property_id_t);
+    *((sky_property_id_t*)ptr) = SKY_EVENT_DATA_FIXED_MARKER;
+    counts[0] = (uint8_t)int_count;
+    counts[1] = (uint8_t)float_count;
+    counts[2] = (uint8_t)boolean_count;
+
+    // Write the property ids and values grouped by type.
+    sky_property_id_t *keys = ptr + SKY_EVENT_DATA_FIXED_HEADER_LENGTH;
+    uint8_t *values = (uint8_t*)(keys + fixed_count);
+    uint32_t int_index = 0;
+    uint32_t float_index = int_count;
+    uint32_t boolean_index = int_count + float_count;
+    for(i=0; i<count; i++) {
+        sky_event_data *item = data[i];
+        if(!sky_event_data_is_fixed(item)) {
+            continue;
+        }
+
+        uint64_t value;
+        if(item->data_type == &SKY_DATA_TYPE_INT) {
+            keys[int_index] = item->key;
+            value = htolell((uint64_t)item->int_value);
+            memcpy(values + (int_index * SKY_EVENT_DATA_FIXED_VALUE_LENGTH), &value, sizeof(value));
+            int_index++;
+        }
+        else if(item->data_type == &SKY_DATA_TYPE_FLOAT) {
+            keys[float_index] = item->key;
+            memcpy(&value, &item->float_value, sizeof(value));
+            value = htolell(value);
+            memcpy(values + (float_index * SKY_EVENT_DATA_FIXED_VALUE_LENGTH), &value, sizeof(value));
+            float_index++;
+        }
+        else {
+            keys[boolean_index] = item->key;
+            values[((int_count + float_count) * SKY_EVENT_DATA_FIXED_VALUE_LENGTH) + (boolean_index - int_count - float_count)] = (item->boolean_value ? 1 : 0);
+            boolean_index++;
+        }
+    }
+
+    if(sz != NULL) *sz = sky_event_data_sizeof_fixed(data, count);
+    return 0;
+
+error:
+    if(sz) *sz = 0;
+    return -1;
+}
+
+// Calculates the length of the fixed section of a data section.
+//
+// data_ptr    - A pointer to the data section or NULL.
+// data_length - The length of the data section.
+//
+// Returns the length of the fixed section or zero if the data section does
+// not have one or it is invalid.
+size_t sky_event_data_get_fixed_length(void *data_ptr, uint32_t data_length)
+{
+    if(!sky_event_data_has_fixed(data_ptr, data_length)) {
+        return 0;
+    }
+
+    uint8_t *counts = data_ptr + sizeof(sky_property_id_t);
+    size_t count = (size_t)counts[0] + counts[1] + counts[2];
+    size_t length = SKY_EVENT_DATA_FIXED_HEADER_LENGTH + (count * sizeof(sky_property_id_t)) +
+        (((size_t)counts[0] + counts[1]) * SKY_EVENT_DATA_FIXED_VALUE_LENGTH) + counts[2];
+    return (length <= data_length ? length : 0);
+}
+
+// Retrieves the number of values in the fixed section of a data section.
+//
+// data_ptr    - A pointer to the data section or NULL.
+// data_length - The length of the data section.
+//
+// Returns the number of fixed values.
+uint32_t sky_event_data_get_fixed_count(void *data_ptr, uint32_t data_length)
+{
+    if(sky_event_data_get_fixed_length(data_ptr, data_length) == 0) {
+        return 0;
+    }
+    uint8_t *counts = data_ptr + sizeof(sky_property_id_t);
+    return (uint32_t)counts[0] + counts[1] + counts[2];
+}
+
+// Reads a value from the fixed section into a view. The value is loaded
+// from an offset computed from its position so nothing before it is read.
+//
+// data_ptr - A pointer to a data section with a valid fixed section.
+// index    - The position of the value in the fixed section.
+// view     - The event data view to unpack into.
+void sky_event_data_get_fixed_view(void *data_ptr, uint32_t index,
+                                   sky_event_data_view *view)
+{
+    uint8_t *counts = data_ptr + sizeof(sky_property_id_t);
+    uint32_t int_count = counts[0];
+    uint32_t float_count = counts[1];
+    uint32_t count = int_count + float_count + counts[2];
+    sky_property_id_t *keys = data_ptr + SKY_EVENT_DATA_FIXED_HEADER_LENGTH;
+    uint8_t *values = (uint8_t*)(keys + count);
+
+    uint64_t value;
+    view->key = keys[index];
+    if(index < int_count) {
+        memcpy(&value, values + (index * SKY_EVENT_DATA_FIXED_VALUE_LENGTH), sizeof(value));
+        view->type = SKY_EVENT_DATA_TYPE_INT;
+        view->int_value = (int64_t)letohll(value);
+    }
+    else if(index < int_count + float_count) {
+        memcpy(&value, values + (index * SKY_EVENT_DATA_FIXED_VALUE_LENGTH), sizeof(value));
+        value = letohll(value);
+        view->type = SKY_EVENT_DATA_TYPE_FLOAT;
+        memcpy(&view->float_value, &value, sizeof(value));
+    }
+    else {
+        view->type = SKY_EVENT_DATA_TYPE_BOOLEAN;
+        view->boolean_value = (values[((int_count + float_count) * SKY_EVENT_DATA_FIXED_VALUE_LENGTH) + (index - int_count - float_count)] != 0);
+    }
+}
+
+// Finds the value of a property in the fixed section of a data section.
+//
+// data_ptr    - A pointer to the data section or NULL.
+// data_length - The length of the data section.
+// key         - The property id to look for.
+// view        - The event data view to unpack into.
+//
+// Returns true if the fixed section has a value for the key.
+bool sky_event_data_find_fixed(void *data_ptr, uint32_t data_length,
+                               sky_property_id_t key,
+                               sky_event_data_view *view)
+{
+    uint32_t count = sky_event_data_get_fixed_count(data_ptr, data_length);
+    if(count == 0) {
+        return false;
+    }
+
+    sky_property_id_t *keys = data_ptr + SKY_EVENT_DATA_FIXED_HEADER_LENGTH;
+    sky_property_id_t *match = memchr(keys, (uint8_t)key, count * sizeof(sky_property_id_t));
+    if(match == NULL) {
+        return false;
+    }
+
+    sky_event_data_get_fixed_view(data_ptr, (uint32_t)(match - keys), view);
+    return true;
+}
+
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+// Finds the value of a property in the packed data section of an event
+// without unpacking the pairs before it. Each value that does not belong to
+// the key is skipped by the size of its type so nothing is decoded except
+// the keys.
+//
+// Values in the fixed section are not returned since they are not stored as
+// MessagePack values. Use sky_event_data_find_fixed() to read those.
+//
+// data_ptr    - A pointer to the data section of the event or NULL.
+// data_length - The length of the data section.
+// key         - The property id to look for.
+//
+// Returns a pointer to the packed value or NULL if the event has no value
+// for the key or the data is invalid.
+void *sky_event_data_find(void *data_ptr, uint32_t data_length,
+                          sky_property_id_t key)
+{
+    if(data_ptr == NULL) {
+        return NULL;
+    }
+
+    uint8_t *ptr = (uint8_t*)data_ptr + sky_event_data_get_fixed_length(data_ptr, data_length);
+    uint8_t *end_ptr = (uint8_t*)data_ptr + data_length;
+    while(ptr < end_ptr) {
+        sky_property_id_t property_id = *((sky_property_id_t*)ptr);
+        ptr += sizeof(sky_property_id_t);
+        if(property_id == key) {
+            return ptr;
+        }
+
+        size_t sz = sky_minipack_batch_fast_sizeof_elem(ptr);
+        if(sz == 0) {
+            return NULL;
+        }
+        ptr += sz;
+    }
+
+    return NULL;
+}
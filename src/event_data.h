@@ -9,15 +9,85 @@
 #include "types.h"
 
 
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// Event data is a single key/value pair of an event. The sky_event_data
+// type owns its value and is used when building events to be written.
+//
+// Read paths can use the sky_event_data_view type instead. A view is filled
+// directly from the raw event bytes without allocating: its type is an enum
+// instead of an interned type name and string values point into the raw
+// data instead of being copied. A view is only valid for as long as the
+// memory it was unpacked from.
+//
+// The data section of an event is a list of property ids that are each
+// followed by a MessagePack value. Values of properties that are declared
+// as fixed are stored before the list in a fixed section instead:
+//
+//   [0][int count][float count][boolean count]
+//   [property ids]
+//   [ints][floats][booleans]
+//
+// The section starts with a zero property id, which no property uses, and
+// the number of values of each type as single bytes. The property ids of
+// the values follow in value order. Integers and floats are stored as eight
+// byte little endian fields and booleans as single bytes, without type tags.
+// Reading a fixed value is a search of the property ids followed by a load
+// at an offset computed from its position. Events without fixed values do
+// not have the section.
+
+
 //==============================================================================
 //
 // Definitions
 //
 //==============================================================================
 
+// The type of value held by an event data view.
+// The property id that marks the start of the fixed section.
+#define SKY_EVENT_DATA_FIXED_MARKER 0
+
+// The length of the fixed section before its property ids.
+#define SKY_EVENT_DATA_FIXED_HEADER_LENGTH (sizeof(sky_property_id_t) + 3)
+
+// The length of a fixed integer or float value.
+#define SKY_EVENT_DATA_FIXED_VALUE_LENGTH 8
+
+// The largest number of bytes a fixed value takes once it is packed as a
+// MessagePack value.
+#define SKY_EVENT_DATA_FIXED_PACKED_LENGTH 9
+
+// Checks whether a data section starts with a fixed section.
+//
+// DATA_PTR    - A pointer to the data section or NULL.
+// DATA_LENGTH - The length of the data section.
+#define sky_event_data_has_fixed(DATA_PTR, DATA_LENGTH) \
+    ((DATA_PTR) != NULL && (DATA_LENGTH) >= SKY_EVENT_DATA_FIXED_HEADER_LENGTH &&\
+        *((sky_property_id_t*)(DATA_PTR)) == SKY_EVENT_DATA_FIXED_MARKER)
+
+// Retrieves the property id of a value in the fixed section.
+//
+// DATA_PTR - A pointer to a data section with a valid fixed section.
+// INDEX    - The position of the value in the fixed section.
+#define sky_event_data_fixed_key(DATA_PTR, INDEX) \
+    (((sky_property_id_t*)((DATA_PTR) + SKY_EVENT_DATA_FIXED_HEADER_LENGTH))[(INDEX)])
+
+typedef enum sky_event_data_type_e {
+    SKY_EVENT_DATA_TYPE_NONE,
+    SKY_EVENT_DATA_TYPE_INT,
+    SKY_EVENT_DATA_TYPE_FLOAT,
+    SKY_EVENT_DATA_TYPE_BOOLEAN,
+    SKY_EVENT_DATA_TYPE_STRING,
+} sky_event_data_type_e;
+
 typedef struct sky_event_data {
     sky_property_id_t key;
     bstring data_type;
+    bool fixed;
     union {
         bool boolean_value;
         int64_t int_value;
@@ -26,6 +96,20 @@ typedef struct sky_event_data {
     };
 } sky_event_data;
 
+typedef struct sky_event_data_view {
+    sky_property_id_t key;
+    sky_event_data_type_e type;
+    union {
+        bool boolean_value;
+        int64_t int_value;
+        double float_value;
+        struct {
+            char *ptr;
+            uint32_t length;
+        } string_value;
+    };
+} sky_event_data_view;
+
 
 //==============================================================================
 //
@@ -52,6 +136,18 @@ void sky_event_data_free(sky_event_data *event);
 int sky_event_data_copy(sky_event_data *source, sky_event_data **target);
 
 
+//--------------------------------------
+// Values
+//--------------------------------------
+
+bool sky_event_data_get_numeric_value(sky_event_data *data, int64_t *value);
+
+bool sky_event_data_view_get_numeric_value(sky_event_data_view *view,
+    int64_t *value);
+
+bool sky_event_data_is_fixed(sky_event_data *data);
+
+
 //--------------------------------------
 // Serialization
 //--------------------------------------
@@ -62,5 +158,39 @@ int sky_event_data_pack(sky_event_data *data, void *addr, size_t *length);
 
 int sky_event_data_unpack(sky_event_data *data, void *addr, size_t *length);
 
+int sky_event_data_view_unpack(sky_event_data_view *view, void *ptr,
+    size_t *sz);
+
+int sky_event_data_view_pack(sky_event_data_view *view, void *ptr,
+    size_t *sz);
+
+
+//--------------------------------------
+// Fixed Section
+//--------------------------------------
+
+size_t sky_event_data_sizeof_fixed(sky_event_data **data, uint32_t count);
+
+int sky_event_data_pack_fixed(sky_event_data **data, uint32_t count,
+    void *ptr, size_t *sz);
+
+uint32_t sky_event_data_get_fixed_count(void *data_ptr, uint32_t data_length);
+
+size_t sky_event_data_get_fixed_length(void *data_ptr, uint32_t data_length);
+
+void sky_event_data_get_fixed_view(void *data_ptr, uint32_t index,
+    sky_event_data_view *view);
+
+bool sky_event_data_find_fixed(void *data_ptr, uint32_t data_length,
+    sky_property_id_t key, sky_event_data_view *view);
+
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+void *sky_event_data_find(void *data_ptr, uint32_t data_length,
+    sky_property_id_t key);
+
 
 #endif
@@ -0,0 +1,836 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "exporter.h"
+#include "importer.h"
+#include "path_iterator.h"
+#include "cursor.h"
+#include "timestamp.h"
+#include "minipack.h"
+#include "minipack_batch.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// Parts of a block that are shorter than this are copied into the scratch
+// buffer instead of being referenced by their own vector.
+#define SKY_EXPORTER_MIN_REFERENCE_LENGTH 64
+
+// The largest number of bytes written by a single formatted write.
+#define SKY_EXPORTER_FORMAT_LENGTH 64
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_exporter_export_block(sky_exporter *exporter, sky_block *block);
+
+int sky_exporter_export_event(sky_exporter *exporter,
+    sky_object_id_t object_id, sky_timestamp_t timestamp, void *event_ptr);
+
+int sky_exporter_export_binary_event(sky_exporter *exporter,
+    sky_object_id_t object_id, sky_timestamp_t timestamp, void *event_ptr);
+
+int sky_exporter_export_json_event(sky_exporter *exporter,
+    sky_object_id_t object_id, sky_timestamp_t timestamp, void *event_ptr);
+
+int sky_exporter_export_json_value(sky_exporter *exporter,
+    sky_property_id_t property_id, void *ptr);
+
+int sky_exporter_decode_value(sky_exporter *exporter,
+    sky_property_id_t property_id, void *ptr, bstring *ret);
+
+int sky_exporter_reserve(sky_exporter *exporter, size_t length, char **ret);
+
+int sky_exporter_write(sky_exporter *exporter, void *data, size_t length);
+
+int sky_exporter_writef(sky_exporter *exporter, const char *format, ...);
+
+int sky_exporter_write_json_string(sky_exporter *exporter, char *data,
+    size_t length);
+
+int sky_exporter_write_ref(sky_exporter *exporter, void *ptr, size_t length);
+
+void sky_exporter_close_segment(sky_exporter *exporter);
+
+int sky_exporter_flush(sky_exporter *exporter);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an exporter.
+//
+// Returns an exporter.
+sky_exporter *sky_exporter_create()
+{
+    sky_exporter *exporter = calloc(1, sizeof(sky_exporter));
+    check_mem(exporter);
+    exporter->fd = -1;
+    return exporter;
+
+error:
+    sky_exporter_free(exporter);
+    return NULL;
+}
+
+// Frees an exporter.
+//
+// Returns nothing.
+void sky_exporter_free(sky_exporter *exporter)
+{
+    if(exporter) {
+        free(exporter->iovecs);
+        exporter->iovecs = NULL;
+        free(exporter->buffer);
+        exporter->buffer = NULL;
+        free(exporter);
+    }
+}
+
+
+//--------------------------------------
+// Export
+//--------------------------------------
+
+// Writes every event in a table to a file descriptor in the format of the
+// exporter.
+//
+// exporter - The exporter.
+// table    - The opened table to export.
+// fd       - The file descriptor to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_export(sky_exporter *exporter, sky_table *table, int fd)
+{
+    int rc;
+    uint32_t i, j;
+    check(exporter != NULL, "Exporter required");
+    check(table != NULL && table->opened, "Opened table required");
+    check(fd >= 0, "File descriptor required");
+
+    exporter->table = table;
+    exporter->fd = fd;
+    exporter->iovec_count = 0;
+    exporter->buffer_length = 0;
+    exporter->buffer_start = 0;
+    exporter->event_count = 0;
+
+    if(exporter->iovecs == NULL) {
+        exporter->iovecs = calloc(SKY_EXPORTER_IOVEC_COUNT, sizeof(*exporter->iovecs));
+        check_mem(exporter->iovecs);
+    }
+
+    // Include buffered events.
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge table");
+
+    if(exporter->format == SKY_EXPORTER_FORMAT_BINARY) {
+        rc = sky_exporter_write(exporter, SKY_IMPORTER_BINARY_MAGIC, strlen(SKY_IMPORTER_BINARY_MAGIC));
+        check(rc == 0, "Unable to write magic number");
+    }
+
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        sky_data_file *data_file = sky_table_get_data_file(table, i);
+        for(j=0; j<data_file->block_count; j++) {
+            rc = sky_exporter_export_block(exporter, data_file->blocks[j]);
+            check(rc == 0, "Unable to export block #%d", j);
+        }
+    }
+
+    rc = sky_exporter_flush(exporter);
+    check(rc == 0, "Unable to flush export");
+
+    exporter->table = NULL;
+    exporter->fd = -1;
+    return 0;
+
+error:
+    if(exporter) {
+        exporter->table = NULL;
+        exporter->fd = -1;
+        exporter->iovec_count = 0;
+        exporter->buffer_length = 0;
+        exporter->buffer_start = 0;
+    }
+    return -1;
+}
+
+// Writes the events of every path in a block. Each segment of a spanned path
+// starts with a full timestamp so the blocks of a span can be exported on
+// their own.
+//
+// exporter - The exporter.
+// block    - The block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_export_block(sky_exporter *exporter, sky_block *block)
+{
+    int rc;
+    bool pinned = false;
+    sky_path_iterator iterator;
+    sky_path_iterator_init(&iterator);
+
+    // Keep a compressed block decompressed while references into it are
+    // waiting to be written.
+    rc = sky_block_pin(block);
+    check(rc == 0, "Unable to pin block");
+    pinned = true;
+
+    rc = sky_path_iterator_set_block(&iterator, block);
+    check(rc == 0, "Unable to set path iterator block");
+
+    while(!iterator.eof) {
+        void *path_ptr = NULL;
+        rc = sky_path_iterator_get_ptr(&iterator, &path_ptr);
+        check(rc == 0, "Unable to retrieve the path iterator pointer");
+
+        sky_timestamp_t timestamp = 0;
+        sky_path_foreach_event(path_ptr, event_ptr) {
+            timestamp = sky_event_get_timestamp(event_ptr, timestamp);
+            rc = sky_exporter_export_event(exporter, iterator.current_object_id, timestamp, event_ptr);
+            check(rc == 0, "Unable to export event");
+        }
+
+        rc = sky_path_iterator_next(&iterator);
+        check(rc == 0, "Unable to find next path");
+    }
+
+    if(block->compression == SKY_BLOCK_COMPRESSION_COMPRESSED) {
+        rc = sky_exporter_flush(exporter);
+        check(rc == 0, "Unable to flush compressed block");
+    }
+
+    sky_path_iterator_uninit(&iterator);
+    sky_block_unpin(block);
+    return 0;
+
+error:
+    sky_path_iterator_uninit(&iterator);
+    if(pinned) sky_block_unpin(block);
+    return -1;
+}
+
+// Writes a single raw event in the format of the exporter.
+//
+// exporter  - The exporter.
+// object_id - The object id of the path that the event belongs to.
+// timestamp - The full timestamp of the event.
+// event_ptr - A pointer to the raw event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_export_event(sky_exporter *exporter,
+                              sky_object_id_t object_id,
+                              sky_timestamp_t timestamp, void *event_ptr)
+{
+    int rc;
+    if(exporter->format == SKY_EXPORTER_FORMAT_JSON) {
+        rc = sky_exporter_export_json_event(exporter, object_id, timestamp, event_ptr);
+    }
+    else {
+        rc = sky_exporter_export_binary_event(exporter, object_id, timestamp, event_ptr);
+    }
+    check(rc == 0, "Unable to export event for object: %" PRIu64, object_id);
+    exporter->event_count++;
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Binary Format
+//--------------------------------------
+
+// Writes a raw event as a binary import record. The record header and the
+// event header are written to the scratch buffer and the action and data
+// are referenced from the block unless they contain dictionary codes.
+//
+// exporter  - The exporter.
+// object_id - The object id of the path that the event belongs to.
+// timestamp - The full timestamp of the event.
+// event_ptr - A pointer to the raw event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_export_binary_event(sky_exporter *exporter,
+                                     sky_object_id_t object_id,
+                                     sky_timestamp_t timestamp,
+                                     void *event_ptr)
+{
+    int rc;
+    size_t sz;
+    char *ptr = NULL;
+    sky_event_flag_t flag = *((sky_event_flag_t*)event_ptr);
+    void *body_ptr = event_ptr + sky_event_header_length(flag);
+    size_t body_length = sky_event_sizeof_raw(event_ptr) - sky_event_header_length(flag);
+
+    // Locate the data section and find the length it has once dictionary
+    // codes are replaced with their values.
+    bool decoded = false;
+    void *data_ptr = NULL;
+    uint32_t data_length = 0;
+    uint32_t decoded_length = 0;
+    if(flag & SKY_EVENT_FLAG_DATA) {
+        void *length_ptr = body_ptr + ((flag & SKY_EVENT_FLAG_ACTION) ? sizeof(sky_action_id_t) : 0);
+        data_length = *((sky_event_data_length_t*)length_ptr);
+        data_ptr = length_ptr + sizeof(sky_event_data_length_t);
+
+        // The fixed section has no dictionary codes and is copied as is.
+        decoded_length = sky_event_data_get_fixed_length(data_ptr, data_length);
+        void *item_ptr = data_ptr + decoded_length;
+        while(item_ptr < data_ptr + data_length) {
+            sky_property_id_t property_id = *((sky_property_id_t*)item_ptr);
+            item_ptr += sizeof(sky_property_id_t);
+            sz = sky_minipack_batch_sizeof_elem(item_ptr);
+            check(sz > 0, "Invalid event data value");
+
+            bstring value = NULL;
+            rc = sky_exporter_decode_value(exporter, property_id, item_ptr, &value);
+            check(rc == 0, "Unable to decode value");
+            if(value != NULL) {
+                decoded = true;
+                decoded_length += sizeof(sky_property_id_t) + minipack_sizeof_raw(blength(value)) + blength(value);
+            }
+            else {
+                decoded_length += sizeof(sky_property_id_t) + sz;
+            }
+            item_ptr += sz;
+        }
+    }
+    if(decoded) {
+        body_length = body_length - data_length + decoded_length;
+    }
+
+    // Write the record length, object id and event header.
+    uint32_t record_length = (uint32_t)(sizeof(sky_object_id_t) + SKY_EVENT_HEADER_LENGTH + body_length);
+    size_t header_length = sizeof(record_length) + sizeof(sky_object_id_t) + SKY_EVENT_HEADER_LENGTH;
+    rc = sky_exporter_reserve(exporter, header_length, &ptr);
+    check(rc == 0, "Unable to reserve record header");
+    sky_event_flag_t full_flag = flag & ~SKY_EVENT_DELTA_MASK;
+    memcpy(ptr, &record_length, sizeof(record_length));
+    memcpy(ptr + sizeof(record_length), &object_id, sizeof(object_id));
+    memcpy(ptr + sizeof(record_length) + sizeof(object_id), &full_flag, sizeof(full_flag));
+    memcpy(ptr + sizeof(record_length) + sizeof(object_id) + sizeof(full_flag), &timestamp, sizeof(timestamp));
+    exporter->buffer_length += header_length;
+
+    // Reference the rest of the event from the block when possible.
+    if(!decoded) {
+        rc = sky_exporter_write_ref(exporter, body_ptr, body_length);
+        check(rc == 0, "Unable to write event");
+        return 0;
+    }
+
+    // Otherwise rewrite the data section with the string values.
+    if(flag & SKY_EVENT_FLAG_ACTION) {
+        rc = sky_exporter_write(exporter, body_ptr, sizeof(sky_action_id_t));
+        check(rc == 0, "Unable to write action id");
+    }
+    rc = sky_exporter_write(exporter, &decoded_length, sizeof(decoded_length));
+    check(rc == 0, "Unable to write data length");
+
+    size_t fixed_length = sky_event_data_get_fixed_length(data_ptr, data_length);
+    if(fixed_length > 0) {
+        rc = sky_exporter_write(exporter, data_ptr, fixed_length);
+        check(rc == 0, "Unable to write fixed data");
+    }
+
+    void *item_ptr = data_ptr + fixed_length;
+    while(item_ptr < data_ptr + data_length) {
+        sky_property_id_t property_id = *((sky_property_id_t*)item_ptr);
+        sz = sky_minipack_batch_sizeof_elem(item_ptr + sizeof(sky_property_id_t));
+
+        bstring value = NULL;
+        rc = sky_exporter_decode_value(exporter, property_id, item_ptr + sizeof(sky_property_id_t), &value);
+        check(rc == 0, "Unable to decode value");
+        if(value != NULL) {
+            size_t value_length = sizeof(sky_property_id_t) + minipack_sizeof_raw(blength(value)) + blength(value);
+            rc = sky_exporter_reserve(exporter, value_length, &ptr);
+            check(rc == 0, "Unable to reserve data value");
+            size_t raw_sz = 0;
+            memcpy(ptr, &property_id, sizeof(property_id));
+            minipack_pack_raw(ptr + sizeof(property_id), blength(value), &raw_sz);
+            check(raw_sz > 0, "Unable to pack string value");
+            memcpy(ptr + sizeof(property_id) + raw_sz, value->data, blength(value));
+            exporter->buffer_length += value_length;
+        }
+        else {
+            rc = sky_exporter_write(exporter, item_ptr, sizeof(sky_property_id_t) + sz);
+            check(rc == 0, "Unable to write data value");
+        }
+        item_ptr += sizeof(sky_property_id_t) + sz;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// JSON Format
+//--------------------------------------
+
+// Writes a raw event as a line of JSON.
+//
+// exporter  - The exporter.
+// object_id - The object id of the path that the event belongs to.
+// timestamp - The full timestamp of the event.
+// event_ptr - A pointer to the raw event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_export_json_event(sky_exporter *exporter,
+                                   sky_object_id_t object_id,
+                                   sky_timestamp_t timestamp, void *event_ptr)
+{
+    int rc;
+    size_t sz;
+    sky_event_flag_t flag = *((sky_event_flag_t*)event_ptr);
+
+    char timestamp_str[SKY_TIMESTAMP_FORMAT_LENGTH];
+    rc = sky_timestamp_format(timestamp, timestamp_str, sizeof(timestamp_str));
+    check(rc == 0, "Unable to format timestamp");
+    rc = sky_exporter_writef(exporter, "{\"objectId\":%" PRIu64 ",\"timestamp\":\"%s\"", object_id, timestamp_str);
+    check(rc == 0, "Unable to write event header");
+
+    // Write the action name.
+    sky_action_id_t action_id = sky_cursor_fast_get_action_id(event_ptr);
+    if(action_id != 0) {
+        sky_action *action = NULL;
+        rc = sky_action_file_find_action_by_id(exporter->table->action_file, action_id, &action);
+        check(rc == 0, "Unable to find action: %d", action_id);
+        if(action != NULL) {
+            rc = sky_exporter_writef(exporter, ",\"action\":");
+            check(rc == 0, "Unable to write action key");
+            rc = sky_exporter_write_json_string(exporter, bdatae(action->name, ""), blength(action->name));
+        }
+        else {
+            rc = sky_exporter_writef(exporter, ",\"action\":%d", action_id);
+        }
+        check(rc == 0, "Unable to write action");
+    }
+
+    // Write the data as an object keyed by property name.
+    if(flag & SKY_EVENT_FLAG_DATA) {
+        void *length_ptr = event_ptr + sky_event_header_length(flag) + ((flag & SKY_EVENT_FLAG_ACTION) ? sizeof(sky_action_id_t) : 0);
+        uint32_t data_length = *((sky_event_data_length_t*)length_ptr);
+        void *data_ptr = length_ptr + sizeof(sky_event_data_length_t);
+
+        rc = sky_exporter_writef(exporter, ",\"data\":{");
+        check(rc == 0, "Unable to write data key");
+
+        // Values of the fixed section are packed so they are written the
+        // same way as the rest of the data.
+        uint32_t i;
+        uint32_t fixed_count = sky_event_data_get_fixed_count(data_ptr, data_length);
+        uint8_t fixed_value[SKY_EVENT_DATA_FIXED_PACKED_LENGTH];
+        void *item_ptr = data_ptr + sky_event_data_get_fixed_length(data_ptr, data_length);
+        for(i=0; ; i++) {
+            sky_property_id_t property_id;
+            void *value_ptr = NULL;
+            if(i < fixed_count) {
+                sky_event_data_view view;
+                sky_event_data_get_fixed_view(data_ptr, i, &view);
+                rc = sky_event_data_view_pack(&view, fixed_value, NULL);
+                check(rc == 0, "Unable to pack fixed value");
+                property_id = view.key;
+                value_ptr = fixed_value;
+            }
+            else if(item_ptr < data_ptr + data_length) {
+                property_id = *((sky_property_id_t*)item_ptr);
+                item_ptr += sizeof(sky_property_id_t);
+                sz = sky_minipack_batch_sizeof_elem(item_ptr);
+                check(sz > 0, "Invalid event data value");
+                value_ptr = item_ptr;
+                item_ptr += sz;
+            }
+            else {
+                break;
+            }
+
+            if(i > 0) {
+                rc = sky_exporter_writef(exporter, ",");
+                check(rc == 0, "Unable to write separator");
+            }
+
+            sky_property *property = NULL;
+            rc = sky_property_file_find_by_id(exporter->table->property_file, property_id, &property);
+            check(rc == 0, "Unable to find property: %d", property_id);
+            if(property != NULL) {
+                rc = sky_exporter_write_json_string(exporter, bdatae(property->name, ""), blength(property->name));
+            }
+            else {
+                rc = sky_exporter_writef(exporter, "\"%d\"", property_id);
+            }
+            check(rc == 0, "Unable to write property key");
+
+            rc = sky_exporter_writef(exporter, ":");
+            check(rc == 0, "Unable to write separator");
+            rc = sky_exporter_export_json_value(exporter, property_id, value_ptr);
+            check(rc == 0, "Unable to write property value");
+        }
+
+        rc = sky_exporter_writef(exporter, "}");
+        check(rc == 0, "Unable to write data end");
+    }
+
+    rc = sky_exporter_writef(exporter, "}\n");
+    check(rc == 0, "Unable to write event end");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes a MessagePack encoded property value as JSON. Dictionary codes are
+// written as their string values and floats that JSON cannot represent are
+// written as null.
+//
+// exporter    - The exporter.
+// property_id - The property that the value belongs to.
+// ptr         - A pointer to the encoded value.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_export_json_value(sky_exporter *exporter,
+                                   sky_property_id_t property_id, void *ptr)
+{
+    int rc;
+    size_t sz = 0;
+
+    bstring value = NULL;
+    rc = sky_exporter_decode_value(exporter, property_id, ptr, &value);
+    check(rc == 0, "Unable to decode value");
+
+    if(value != NULL) {
+        rc = sky_exporter_write_json_string(exporter, (char*)value->data, blength(value));
+    }
+    else if(minipack_is_raw(ptr)) {
+        uint32_t length = minipack_unpack_raw(ptr, &sz);
+        check(sz > 0, "Unable to read string value");
+        rc = sky_exporter_write_json_string(exporter, ptr + sz, length);
+    }
+    else if(minipack_is_bool(ptr)) {
+        rc = sky_exporter_writef(exporter, "%s", (minipack_unpack_bool(ptr, &sz) ? "true" : "false"));
+    }
+    else if(minipack_is_nil(ptr)) {
+        rc = sky_exporter_writef(exporter, "null");
+    }
+    else if(minipack_is_double(ptr) || minipack_is_float(ptr)) {
+        double number = (minipack_is_double(ptr) ? minipack_unpack_double(ptr, &sz) : minipack_unpack_float(ptr, &sz));
+        if(isfinite(number)) {
+            rc = sky_exporter_writef(exporter, "%.17g", number);
+        }
+        else {
+            rc = sky_exporter_writef(exporter, "null");
+        }
+    }
+    else if(minipack_is_uint64(ptr)) {
+        rc = sky_exporter_writef(exporter, "%" PRIu64, minipack_unpack_uint64(ptr, &sz));
+    }
+    else {
+        int64_t number = minipack_unpack_int(ptr, &sz);
+        check(sz > 0, "Unsupported value type");
+        rc = sky_exporter_writef(exporter, "%" PRId64, number);
+    }
+    check(rc == 0, "Unable to write value");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Dictionary
+//--------------------------------------
+
+// Retrieves the string value of a dictionary code. Only values of String
+// properties that are not stored as raw strings are codes.
+//
+// exporter    - The exporter.
+// property_id - The property that the value belongs to.
+// ptr         - A pointer to the encoded value.
+// ret         - A pointer to where the value should be returned. The value is
+//               not copied. This is set to null if the value is not a code.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_decode_value(sky_exporter *exporter,
+                              sky_property_id_t property_id, void *ptr,
+                              bstring *ret)
+{
+    int rc;
+    size_t sz;
+    *ret = NULL;
+
+    if(minipack_is_raw(ptr)) {
+        return 0;
+    }
+
+    sky_property *property = NULL;
+    rc = sky_property_file_find_by_id(exporter->table->property_file, property_id, &property);
+    check(rc == 0, "Unable to find property: %d", property_id);
+    if(property == NULL || biseq(property->data_type, &SKY_DATA_TYPE_STRING) != 1) {
+        return 0;
+    }
+
+    int64_t code = minipack_unpack_int(ptr, &sz);
+    check(sz > 0, "Unable to read dictionary code");
+    rc = sky_dictionary_file_find_value(exporter->table->dictionary_file, property_id, code, ret);
+    check(rc == 0 && *ret != NULL, "Unable to decode value for property: %d", property_id);
+
+    return 0;
+
+error:
+    *ret = NULL;
+    return -1;
+}
+
+
+//--------------------------------------
+// Output
+//--------------------------------------
+
+// Retrieves space for bytes at the end of the scratch buffer. Pending output
+// is flushed when the buffer is full and the buffer is only grown for
+// values that are larger than the whole buffer. The caller adds the number
+// of bytes that it used to the buffer length.
+//
+// exporter - The exporter.
+// length   - The number of bytes needed.
+// ret      - A pointer to where the start of the space should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_reserve(sky_exporter *exporter, size_t length, char **ret)
+{
+    int rc;
+
+    if(exporter->buffer_length + length > exporter->buffer_capacity) {
+        rc = sky_exporter_flush(exporter);
+        check(rc == 0, "Unable to flush export");
+
+        // Vectors no longer point into the buffer so it can be moved.
+        if(length > exporter->buffer_capacity) {
+            size_t capacity = (exporter->buffer_capacity == 0 ? SKY_EXPORTER_BUFFER_SIZE : exporter->buffer_capacity);
+            while(length > capacity) {
+                capacity *= 2;
+            }
+            exporter->buffer = realloc(exporter->buffer, capacity);
+            check_mem(exporter->buffer);
+            exporter->buffer_capacity = capacity;
+        }
+    }
+
+    *ret = exporter->buffer + exporter->buffer_length;
+    return 0;
+
+error:
+    *ret = NULL;
+    return -1;
+}
+
+// Copies bytes into the scratch buffer.
+//
+// exporter - The exporter.
+// data     - The bytes to write.
+// length   - The number of bytes.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_write(sky_exporter *exporter, void *data, size_t length)
+{
+    int rc;
+    char *ptr = NULL;
+    rc = sky_exporter_reserve(exporter, length, &ptr);
+    check(rc == 0, "Unable to reserve output");
+    memcpy(ptr, data, length);
+    exporter->buffer_length += length;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Formats a short string into the scratch buffer.
+//
+// exporter - The exporter.
+// format   - The printf() style format.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_writef(sky_exporter *exporter, const char *format, ...)
+{
+    int rc;
+    char *ptr = NULL;
+    rc = sky_exporter_reserve(exporter, SKY_EXPORTER_FORMAT_LENGTH, &ptr);
+    check(rc == 0, "Unable to reserve output");
+
+    va_list args;
+    va_start(args, format);
+    rc = vsnprintf(ptr, SKY_EXPORTER_FORMAT_LENGTH, format, args);
+    va_end(args);
+    check(rc >= 0 && rc < SKY_EXPORTER_FORMAT_LENGTH, "Formatted output too long");
+    exporter->buffer_length += rc;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes a quoted and escaped JSON string into the scratch buffer.
+//
+// exporter - The exporter.
+// data     - The characters of the string.
+// length   - The number of characters.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_write_json_string(sky_exporter *exporter, char *data,
+                                   size_t length)
+{
+    int rc;
+    size_t i;
+    char *ptr = NULL;
+
+    // Every character takes at most six bytes once escaped.
+    rc = sky_exporter_reserve(exporter, (length * 6) + 2, &ptr);
+    check(rc == 0, "Unable to reserve output");
+
+    char *start = ptr;
+    *(ptr++) = '"';
+    for(i=0; i<length; i++) {
+        unsigned char ch = (unsigned char)data[i];
+        switch(ch) {
+            case '"': *(ptr++) = '\\'; *(ptr++) = '"'; break;
+            case '\\': *(ptr++) = '\\'; *(ptr++) = '\\'; break;
+            case '\n': *(ptr++) = '\\'; *(ptr++) = 'n'; break;
+            case '\r': *(ptr++) = '\\'; *(ptr++) = 'r'; break;
+            case '\t': *(ptr++) = '\\'; *(ptr++) = 't'; break;
+            default: {
+                if(ch < 0x20) {
+                    ptr += sprintf(ptr, "\\u%04x", ch);
+                }
+                else {
+                    *(ptr++) = (char)ch;
+                }
+            }
+        }
+    }
+    *(ptr++) = '"';
+    exporter->buffer_length += (ptr - start);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Adds a vector that references bytes outside the scratch buffer. The bytes
+// must stay valid until the exporter is flushed. Short runs of bytes are
+// copied instead since a vector costs more than the copy.
+//
+// exporter - The exporter.
+// ptr      - A pointer to the bytes.
+// length   - The number of bytes.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_write_ref(sky_exporter *exporter, void *ptr, size_t length)
+{
+    int rc;
+    if(length < SKY_EXPORTER_MIN_REFERENCE_LENGTH) {
+        return (length > 0 ? sky_exporter_write(exporter, ptr, length) : 0);
+    }
+
+    sky_exporter_close_segment(exporter);
+    exporter->iovecs[exporter->iovec_count].iov_base = ptr;
+    exporter->iovecs[exporter->iovec_count].iov_len = length;
+    exporter->iovec_count++;
+
+    // Keep room for the segment that closes the next flush.
+    if(exporter->iovec_count + 1 >= SKY_EXPORTER_IOVEC_COUNT) {
+        rc = sky_exporter_flush(exporter);
+        check(rc == 0, "Unable to flush export");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Adds a vector for the bytes written to the scratch buffer since the last
+// vector.
+//
+// exporter - The exporter.
+//
+// Returns nothing.
+void sky_exporter_close_segment(sky_exporter *exporter)
+{
+    if(exporter->buffer_length > exporter->buffer_start) {
+        exporter->iovecs[exporter->iovec_count].iov_base = exporter->buffer + exporter->buffer_start;
+        exporter->iovecs[exporter->iovec_count].iov_len = exporter->buffer_length - exporter->buffer_start;
+        exporter->iovec_count++;
+        exporter->buffer_start = exporter->buffer_length;
+    }
+}
+
+// Writes all pending vectors to the file descriptor and empties the scratch
+// buffer. Partial writes are resumed from where they stopped.
+//
+// exporter - The exporter.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_exporter_flush(sky_exporter *exporter)
+{
+    sky_exporter_close_segment(exporter);
+
+    uint32_t index = 0;
+    while(index < exporter->iovec_count) {
+        ssize_t sz = writev(exporter->fd, &exporter->iovecs[index], (int)(exporter->iovec_count - index));
+        if(sz < 0 && errno == EINTR) {
+            continue;
+        }
+        check(sz >= 0, "Unable to write export");
+
+        // Skip past the vectors that were written.
+        while(sz > 0) {
+            struct iovec *iovec = &exporter->iovecs[index];
+            if((size_t)sz >= iovec->iov_len) {
+                sz -= iovec->iov_len;
+                index++;
+            }
+            else {
+                iovec->iov_base += sz;
+                iovec->iov_len -= sz;
+                sz = 0;
+            }
+        }
+    }
+
+    exporter->iovec_count = 0;
+    exporter->buffer_length = 0;
+    exporter->buffer_start = 0;
+    return 0;
+
+error:
+    return -1;
+}
@@ -0,0 +1,101 @@
+#ifndef _sky_exporter_h
+#define _sky_exporter_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <sys/uio.h>
+
+#include "bstring.h"
+#include "table.h"
+#include "types.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The exporter streams every event in a table to a file descriptor. Blocks
+// are visited in object id order and the raw events of each path are read
+// in place from the mapped block, so no paths or events are deserialized.
+// Buffered events are merged into the data file before the export starts.
+//
+// The binary format is the same stream that the importer accepts: the
+// magic number followed by a record for each event. Each record header is
+// written to a scratch buffer with the full timestamp of the event and the
+// rest of the event is referenced directly from the block. Dictionary codes
+// are the only exception; events with encoded String properties are
+// rewritten into the scratch buffer with the string values so that the
+// stream does not depend on the table's dictionary.
+//
+// The JSON format writes one object per line with the same keys as an
+// imported event, which is convenient for loading into other systems.
+//
+// Output is collected into an array of I/O vectors that is written with a
+// single writev() call once it is full. Compressed blocks are only
+// decompressed while they are pinned, so the vectors are flushed before the
+// exporter moves past a compressed block.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of I/O vectors written at a time.
+#define SKY_EXPORTER_IOVEC_COUNT 512
+
+// The initial size of the scratch buffer.
+#define SKY_EXPORTER_BUFFER_SIZE 65536
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef enum sky_exporter_format_e {
+    SKY_EXPORTER_FORMAT_BINARY,
+    SKY_EXPORTER_FORMAT_JSON,
+} sky_exporter_format_e;
+
+// The scratch buffer holds the bytes that are not referenced from a block.
+// The bytes after buffer_start have not been added to the vectors yet.
+typedef struct {
+    sky_table *table;
+    sky_exporter_format_e format;
+    int fd;
+    struct iovec *iovecs;
+    uint32_t iovec_count;
+    char *buffer;
+    size_t buffer_capacity;
+    size_t buffer_length;
+    size_t buffer_start;
+    uint64_t event_count;
+} sky_exporter;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_exporter *sky_exporter_create();
+
+void sky_exporter_free(sky_exporter *exporter);
+
+//--------------------------------------
+// Export
+//--------------------------------------
+
+int sky_exporter_export(sky_exporter *exporter, sky_table *table, int fd);
+
+#endif
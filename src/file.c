@@ -1,4 +1,17 @@
+#if defined(__linux__)
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
 #include <dirent.h>
 
@@ -62,6 +75,89 @@ off_t sky_file_get_size(bstring path)
 }
 
 
+//--------------------------------------
+// File Contents
+//--------------------------------------
+
+// Reads the entire contents of a file into memory.
+//
+// path   - The path of the file.
+// data   - A pointer to where the contents should be returned. The caller
+//          is responsible for freeing the contents.
+// length - A pointer to where the number of bytes should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_file_read(bstring path, void **data, size_t *length)
+{
+    FILE *file = NULL;
+    check(path != NULL, "Path required");
+    check(data != NULL, "Data return pointer required");
+    check(length != NULL, "Length return pointer required");
+    *data = NULL;
+    *length = 0;
+
+    file = fopen(bdata(path), "r");
+    check(file != NULL, "Unable to open file for reading: %s", bdata(path));
+
+    size_t sz = (size_t)sky_file_get_size(path);
+    *data = malloc(sz > 0 ? sz : 1); check_mem(*data);
+    if(sz > 0) {
+        check(fread(*data, sz, 1, file) == 1, "Unable to read file: %s", bdata(path));
+    }
+    *length = sz;
+
+    fclose(file);
+    return 0;
+
+error:
+    if(file) fclose(file);
+    if(data) {
+        free(*data);
+        *data = NULL;
+    }
+    return -1;
+}
+
+// Replaces the contents of a file. The contents are written to a temporary
+// file first which is then renamed over the file so that readers never see
+// a partially written file.
+//
+// path   - The path of the file.
+// data   - The contents to write.
+// length - The number of bytes to write.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_file_write(bstring path, void *data, size_t length)
+{
+    int rc;
+    FILE *file = NULL;
+    bstring tmp_path = NULL;
+    check(path != NULL, "Path required");
+    check(data != NULL || length == 0, "Data required");
+
+    tmp_path = bformat("%s.tmp", bdata(path)); check_mem(tmp_path);
+    file = fopen(bdata(tmp_path), "w");
+    check(file != NULL, "Unable to open file for writing: %s", bdata(tmp_path));
+    if(length > 0) {
+        check(fwrite(data, length, 1, file) == 1, "Unable to write file: %s", bdata(tmp_path));
+    }
+    rc = fclose(file);
+    file = NULL;
+    check(rc == 0, "Unable to close file: %s", bdata(tmp_path));
+
+    rc = rename(bdata(tmp_path), bdata(path));
+    check(rc == 0, "Unable to replace file: %s", bdata(path));
+
+    bdestroy(tmp_path);
+    return 0;
+
+error:
+    if(file) fclose(file);
+    bdestroy(tmp_path);
+    return -1;
+}
+
+
 //--------------------------------------
 // File Copy
 //--------------------------------------
@@ -176,6 +272,140 @@ error:
     return -1;
 }
 
+// Copies a single file by sharing its extents with the copy when the file
+// system supports reflinks. Otherwise the file is copied inside the kernel
+// with copy_file_range() and then through user space if that is not
+// supported either. A reflinked copy takes the same time whatever the size
+// of the file and does not use any more disk space until either file is
+// changed.
+//
+// src    - The path of the file to copy.
+// dest   - The path where the copy should be placed.
+// cloned - A pointer to where a flag is returned that is set if the copy
+//          was reflinked. This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_file_clone(bstring src, bstring dest, bool *cloned)
+{
+    int rc;
+    int src_fd = -1;
+    int dest_fd = -1;
+    check(src != NULL, "Source path required");
+    check(dest != NULL, "Destination path required");
+    check(!sky_file_is_dir(src), "Source file cannot be a directory");
+    if(cloned != NULL) *cloned = false;
+
+    struct stat st;
+    rc = stat(bdata(src), &st);
+    check(rc == 0, "Unable to stat source file: %s", bdata(src));
+
+    src_fd = open(bdata(src), O_RDONLY);
+    check(src_fd != -1, "Unable to open source file: %s", bdata(src));
+    dest_fd = open(bdata(dest), O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 0777);
+    check(dest_fd != -1, "Unable to open destination file: %s", bdata(dest));
+
+#if defined(__linux__)
+    // Share the extents of the source.
+    if(ioctl(dest_fd, FICLONE, src_fd) == 0) {
+        if(cloned != NULL) *cloned = true;
+        close(src_fd);
+        close(dest_fd);
+        return 0;
+    }
+
+    // Copy inside the kernel. Nothing has been written if the very first
+    // call is refused so the copy can still go through user space.
+    off_t offset = 0;
+    while(offset < st.st_size) {
+        ssize_t sz = copy_file_range(src_fd, NULL, dest_fd, NULL, (size_t)(st.st_size - offset), 0);
+        if(sz == -1 && offset == 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+            break;
+        }
+        check(sz != -1, "Unable to copy file: %s", bdata(src));
+        if(sz == 0) break;
+        offset += sz;
+    }
+    if(offset > 0 || st.st_size == 0) {
+        close(src_fd);
+        close(dest_fd);
+        return 0;
+    }
+#endif
+
+    close(src_fd);
+    close(dest_fd);
+    return sky_file_cp(src, dest);
+
+error:
+    if(src_fd != -1) close(src_fd);
+    if(dest_fd != -1) close(dest_fd);
+    return -1;
+}
+
+// Recursively clones a directory. Each file is cloned with
+// sky_file_clone().
+//
+// src    - The path of the file or directory to clone.
+// dest   - The path where the copy should be placed.
+// cloned - A pointer to where a flag is returned that is set if every file
+//          was reflinked. This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_file_clone_r(bstring src, bstring dest, bool *cloned)
+{
+    int rc;
+    DIR *dir = NULL;
+    bstring ent_src = NULL;
+    bstring ent_dest = NULL;
+    check(src != NULL, "Source path required");
+    check(dest != NULL, "Destination path required");
+    check(sky_file_exists(src), "Source file does not exist");
+    if(cloned != NULL) *cloned = true;
+
+    if(sky_file_is_dir(src)) {
+        if(!sky_file_exists(dest)) {
+            struct stat st;
+            rc = stat(bdata(src), &st);
+            check(rc == 0, "Unable to stat source directory: %s", bdata(src));
+            rc = mkdir(bdata(dest), st.st_mode);
+            check(rc == 0, "Unable to create directory: %s", bdata(dest));
+        }
+
+        dir = opendir(bdata(src));
+        check(dir != NULL, "Unable to open directory: %s", bdata(src));
+
+        struct dirent *ent;
+        while((ent = readdir(dir))) {
+            if(strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0) {
+                ent_src  = bformat("%s/%s", bdata(src), ent->d_name); check_mem(ent_src);
+                ent_dest = bformat("%s/%s", bdata(dest), ent->d_name); check_mem(ent_dest);
+
+                bool ent_cloned = false;
+                rc = sky_file_clone_r(ent_src, ent_dest, &ent_cloned);
+                check(rc == 0, "Unable to clone: %s", bdata(ent_src));
+                if(cloned != NULL && !ent_cloned) *cloned = false;
+
+                bdestroy(ent_src); ent_src = NULL;
+                bdestroy(ent_dest); ent_dest = NULL;
+            }
+        }
+
+        closedir(dir);
+    }
+    else {
+        rc = sky_file_clone(src, dest, cloned);
+        check(rc == 0, "Unable to clone file: %s", bdata(src));
+    }
+
+    return 0;
+
+error:
+    if(dir != NULL) closedir(dir);
+    bdestroy(ent_src);
+    bdestroy(ent_dest);
+    return -1;
+}
+
 
 //--------------------------------------
 // File Delete
@@ -33,6 +33,15 @@ bool sky_file_is_dir(bstring path);
 off_t sky_file_get_size(bstring path);
 
 
+//--------------------------------------
+// File Contents
+//--------------------------------------
+
+int sky_file_read(bstring path, void **data, size_t *length);
+
+int sky_file_write(bstring path, void *data, size_t length);
+
+
 //--------------------------------------
 // File Copy
 //--------------------------------------
@@ -41,6 +50,10 @@ int sky_file_cp(bstring src, bstring dest);
 
 int sky_file_cp_r(bstring src, bstring dest);
 
+int sky_file_clone(bstring src, bstring dest, bool *cloned);
+
+int sky_file_clone_r(bstring src, bstring dest, bool *cloned);
+
 
 //--------------------------------------
 // File Delete
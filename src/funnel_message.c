@@ -0,0 +1,315 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+#include "funnel_message.h"
+#include "minipack.h"
+#include "stats.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+struct tagbstring SKY_FUNNEL_KEY_STEPS = bsStatic("steps");
+
+struct tagbstring SKY_FUNNEL_KEY_ACTION_ID = bsStatic("actionId");
+
+struct tagbstring SKY_FUNNEL_KEY_WINDOW = bsStatic("window");
+
+struct tagbstring SKY_FUNNEL_KEY_PROFILE = bsStatic("profile");
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_funnel_message_unpack_steps(sky_funnel_message *message, FILE *file);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a 'Funnel' message object.
+//
+// Returns a new message.
+sky_funnel_message *sky_funnel_message_create()
+{
+    sky_funnel_message *message = NULL;
+    message = calloc(1, sizeof(sky_funnel_message)); check_mem(message);
+    return message;
+
+error:
+    sky_funnel_message_free(message);
+    return NULL;
+}
+
+// Frees a 'Funnel' message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_funnel_message_free(sky_funnel_message *message)
+{
+    if(message) {
+        sky_funnel_message_free_deps(message);
+        free(message);
+    }
+}
+
+// Frees message object dependencies from memory.
+//
+// message - The message object.
+//
+// Returns nothing.
+void sky_funnel_message_free_deps(sky_funnel_message *message)
+{
+    if(message) {
+        free(message->steps);
+        message->steps = NULL;
+        message->step_count = 0;
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Serializes a 'Funnel' message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_funnel_message_pack(sky_funnel_message *message, FILE *file)
+{
+    size_t sz;
+    uint32_t i;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    check(minipack_fwrite_map(file, (message->profile ? 2 : 1), &sz) == 0, "Unable to pack map");
+    check(sky_minipack_fwrite_bstring(file, &SKY_FUNNEL_KEY_STEPS) == 0, "Unable to pack steps key");
+    check(minipack_fwrite_array(file, message->step_count, &sz) == 0, "Unable to pack steps array");
+    for(i=0; i<message->step_count; i++) {
+        sky_query_funnel_step *step = &message->steps[i];
+        check(minipack_fwrite_map(file, 2, &sz) == 0, "Unable to pack step map");
+        check(sky_minipack_fwrite_bstring(file, &SKY_FUNNEL_KEY_ACTION_ID) == 0, "Unable to pack action id key");
+        check(minipack_fwrite_uint(file, step->action_id, &sz) == 0, "Unable to pack action id");
+        check(sky_minipack_fwrite_bstring(file, &SKY_FUNNEL_KEY_WINDOW) == 0, "Unable to pack window key");
+        check(minipack_fwrite_int(file, step->window, &sz) == 0, "Unable to pack window");
+    }
+
+    if(message->profile) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_FUNNEL_KEY_PROFILE) == 0, "Unable to pack profile key");
+        check(minipack_fwrite_bool(file, true, &sz) == 0, "Unable to pack profile flag");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes a 'Funnel' message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_funnel_message_unpack(sky_funnel_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    bstring key = NULL;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    uint32_t map_length = minipack_fread_map(file, &sz);
+    check(sz > 0, "Unable to read map");
+
+    for(i=0; i<map_length; i++) {
+        rc = sky_minipack_fread_bstring(file, &key);
+        check(rc == 0, "Unable to read map key");
+
+        if(biseq(key, &SKY_FUNNEL_KEY_STEPS) == 1) {
+            rc = sky_funnel_message_unpack_steps(message, file);
+            check(rc == 0, "Unable to unpack steps");
+        }
+        else if(biseq(key, &SKY_FUNNEL_KEY_PROFILE) == 1) {
+            message->profile = minipack_fread_bool(file, &sz);
+            check(sz > 0, "Unable to unpack profile flag");
+        }
+        else {
+            sentinel("Invalid 'Funnel' key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+// Deserializes the array of funnel steps.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_funnel_message_unpack_steps(sky_funnel_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i, j;
+    bstring key = NULL;
+
+    sky_funnel_message_free_deps(message);
+    uint32_t step_count = minipack_fread_array(file, &sz);
+    check(sz > 0, "Unable to unpack steps array");
+
+    if(step_count > 0) {
+        message->steps = calloc(step_count, sizeof(*message->steps));
+        check_mem(message->steps);
+    }
+    message->step_count = step_count;
+
+    for(i=0; i<step_count; i++) {
+        sky_query_funnel_step *step = &message->steps[i];
+        uint32_t map_length = minipack_fread_map(file, &sz);
+        check(sz > 0, "Unable to unpack step map");
+
+        for(j=0; j<map_length; j++) {
+            rc = sky_minipack_fread_bstring(file, &key);
+            check(rc == 0, "Unable to read step key");
+
+            if(biseq(key, &SKY_FUNNEL_KEY_ACTION_ID) == 1) {
+                step->action_id = (sky_action_id_t)minipack_fread_uint(file, &sz);
+                check(sz > 0, "Unable to unpack step action id");
+            }
+            else if(biseq(key, &SKY_FUNNEL_KEY_WINDOW) == 1) {
+                step->window = minipack_fread_int(file, &sz);
+                check(sz > 0, "Unable to unpack step window");
+            }
+            else {
+                sentinel("Invalid funnel step key: %s", bdata(key));
+            }
+
+            bdestroy(key);
+            key = NULL;
+        }
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Counts the objects of a table that reach each step of a funnel in a single
+// scan. Only the objects that performed the first action can enter the
+// funnel so the scan is restricted to them.
+//
+// message - The message.
+// table   - The table to apply the message to.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_funnel_message_process(sky_funnel_message *message,
+                               sky_table *table, sky_buffer *output)
+{
+    int rc;
+    sky_query *query = NULL;
+    sky_query_result *result = NULL;
+    sky_query_profile profile;
+    sky_object_id_t *object_ids = NULL;
+    uint32_t object_id_count = 0;
+    check(message != NULL, "Message required");
+    check(message->step_count > 0, "Funnel steps must be specified");
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring data_str = bsStatic("data");
+
+    // Build the query.
+    query = sky_query_create(); check_mem(query);
+    rc = sky_query_set_funnel(query, message->steps, message->step_count);
+    check(rc == 0, "Unable to set query funnel");
+
+    // Merge buffered events so the query sees them.
+    memset(&profile, 0, sizeof(profile));
+    int64_t t0 = sky_stats_now();
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge table memtable");
+    profile.memtable_time = sky_stats_now() - t0;
+
+    // Restrict the scan to the objects that performed the first step.
+    sky_action_index *action_index = NULL;
+    rc = sky_table_get_action_index(table, &action_index);
+    check(rc == 0, "Unable to retrieve action index");
+    rc = sky_action_index_get_object_ids(action_index, &message->steps[0].action_id, 1, &object_ids, &object_id_count);
+    check(rc == 0, "Unable to find candidate objects");
+    rc = sky_query_set_object_ids(query, object_ids, object_id_count);
+    check(rc == 0, "Unable to restrict query objects");
+
+    result = sky_query_result_create_with_arena(query, message->arena); check_mem(result);
+    result->profile = (message->profile ? &profile : NULL);
+    rc = sky_table_execute_query(table, query, result);
+    check(rc == 0, "Unable to execute 'Funnel' query");
+
+    // Return.
+    //   {status:"ok", data:{<step>:{count:0}, ...}, profile:<profile>}
+    check(sky_buffer_pack_map(output, (message->profile ? 3 : 2)) == 0, "Unable to write root map");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    check(sky_buffer_pack_bstring(output, &data_str) == 0, "Unable to write data key");
+    t0 = sky_stats_now();
+    rc = sky_query_result_pack(result, query, NULL, output);
+    check(rc == 0, "Unable to write query result");
+    profile.encode_time = sky_stats_now() - t0;
+
+    if(message->profile) {
+        check(sky_buffer_pack_bstring(output, &SKY_FUNNEL_KEY_PROFILE) == 0, "Unable to write profile key");
+        rc = sky_query_profile_pack(&profile, output);
+        check(rc == 0, "Unable to write query profile");
+    }
+
+    free(object_ids);
+    sky_query_result_free(result);
+    sky_query_free(query);
+    return 0;
+
+error:
+    free(object_ids);
+    sky_query_result_free(result);
+    sky_query_free(query);
+    return -1;
+}
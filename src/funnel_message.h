@@ -0,0 +1,71 @@
+#ifndef _sky_funnel_message_h
+#define _sky_funnel_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+#include "query.h"
+#include "arena.h"
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for counting the objects that reach each step of a funnel. Each
+// step is an action that must happen within a window of time after the
+// previous step. Other events may happen between the steps. The results are
+// built in the arena if one is set. The arena is not owned by the message.
+//
+// The message is sent as a map of
+// {steps:[{actionId:<action_id>, window:<int>}, ...], profile:<bool>}. The
+// window is optional and defaults to no limit. It is ignored for the first
+// step. The response is {status:"ok", data:{<step>:{count:0}, ...}} where
+// each step is counted once for every object that reached it. A profiled
+// message returns the profile of its query along with the results.
+typedef struct sky_funnel_message {
+    sky_query_funnel_step *steps;
+    uint32_t step_count;
+    sky_arena *arena;
+    bool profile;
+} sky_funnel_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_funnel_message *sky_funnel_message_create();
+
+void sky_funnel_message_free(sky_funnel_message *message);
+
+void sky_funnel_message_free_deps(sky_funnel_message *message);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int sky_funnel_message_pack(sky_funnel_message *message, FILE *file);
+
+int sky_funnel_message_unpack(sky_funnel_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_funnel_message_process(sky_funnel_message *message,
+    sky_table *table, sky_buffer *output);
+
+#endif
@@ -0,0 +1,185 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hll.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The largest rank that a register can hold.
+#define SKY_HLL_MAX_RANK (64 - SKY_HLL_PRECISION + 1)
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+uint64_t sky_hll_hash(uint64_t value);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty sketch.
+//
+// Returns a reference to the new sketch if successful. Otherwise returns
+// null.
+sky_hll *sky_hll_create()
+{
+    sky_hll *hll = calloc(1, sizeof(sky_hll)); check_mem(hll);
+    return hll;
+
+error:
+    sky_hll_free(hll);
+    return NULL;
+}
+
+// Removes a sketch from memory.
+//
+// hll - The sketch.
+void sky_hll_free(sky_hll *hll)
+{
+    if(hll) {
+        free(hll);
+    }
+}
+
+
+//--------------------------------------
+// Counting
+//--------------------------------------
+
+// Mixes the bits of a value so that sequential ids are spread evenly over
+// the registers. This is the finalizer of MurmurHash3.
+//
+// value - The value to hash.
+//
+// Returns the hash of the value.
+uint64_t sky_hll_hash(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+// Adds a value to the sketch.
+//
+// hll   - The sketch.
+// value - The value to add.
+void sky_hll_add(sky_hll *hll, uint64_t value)
+{
+    uint64_t hash = sky_hll_hash(value);
+    uint32_t index = (uint32_t)(hash >> (64 - SKY_HLL_PRECISION));
+    uint64_t bits = hash << SKY_HLL_PRECISION;
+    uint8_t rank = (bits == 0 ? SKY_HLL_MAX_RANK : (uint8_t)(__builtin_clzll(bits) + 1));
+    if(rank > hll->registers[index]) {
+        hll->registers[index] = rank;
+    }
+}
+
+// Merges another sketch into a sketch. The result estimates the number of
+// distinct values added to either sketch.
+//
+// hll    - The sketch to merge into.
+// source - The sketch to merge from.
+void sky_hll_merge(sky_hll *hll, sky_hll *source)
+{
+    uint32_t i;
+    for(i=0; i<SKY_HLL_REGISTER_COUNT; i++) {
+        if(source->registers[i] > hll->registers[i]) {
+            hll->registers[i] = source->registers[i];
+        }
+    }
+}
+
+// Estimates the number of distinct values added to the sketch. Small
+// cardinalities are estimated by linear counting of the empty registers.
+//
+// hll - The sketch.
+//
+// Returns the estimated number of distinct values.
+uint64_t sky_hll_count(sky_hll *hll)
+{
+    uint32_t i;
+    uint32_t zero_count = 0;
+    double sum = 0;
+    double m = SKY_HLL_REGISTER_COUNT;
+
+    for(i=0; i<SKY_HLL_REGISTER_COUNT; i++) {
+        sum += ldexp(1.0, -hll->registers[i]);
+        if(hll->registers[i] == 0) {
+            zero_count++;
+        }
+    }
+
+    double alpha = 0.7213 / (1.0 + (1.079 / m));
+    double estimate = (alpha * m * m) / sum;
+    if(estimate <= 2.5 * m && zero_count > 0) {
+        estimate = m * log(m / zero_count);
+    }
+
+    return (uint64_t)(estimate + 0.5);
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Appends the registers of a sketch to a buffer as a MessagePack raw.
+//
+// hll    - The sketch.
+// buffer - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_hll_pack(sky_hll *hll, sky_buffer *buffer)
+{
+    check(hll != NULL, "Sketch required");
+    check(buffer != NULL, "Buffer required");
+    return sky_buffer_pack_raw(buffer, hll->registers, SKY_HLL_REGISTER_COUNT);
+
+error:
+    return -1;
+}
+
+// Reads the registers of a sketch from a file stream.
+//
+// hll  - The sketch.
+// file - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_hll_unpack(sky_hll *hll, FILE *file)
+{
+    size_t sz;
+    check(hll != NULL, "Sketch required");
+    check(file != NULL, "File stream required");
+
+    uint32_t length = minipack_fread_raw(file, &sz);
+    check(sz > 0, "Unable to read raw header");
+    check(length == SKY_HLL_REGISTER_COUNT, "Invalid sketch length: %d", length);
+    check(fread(hll->registers, 1, length, file) == length, "Unable to read registers");
+    return 0;
+
+error:
+    return -1;
+}
@@ -0,0 +1,83 @@
+#ifndef _sky_hll_h
+#define _sky_hll_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "buffer.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A HyperLogLog sketch estimates the number of distinct values added to it
+// in constant memory. Each value is hashed to 64 bits. The top bits of the
+// hash select a register and the register keeps the longest run of leading
+// zeros seen in the remaining bits.
+//
+// Sketches with the same precision are merged by taking the maximum of each
+// register so partial sketches from parallel scans or from other servers can
+// be combined without losing accuracy. The standard error of an estimate is
+// about 1.04/sqrt(register count), or 1.6% for the default precision.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of hash bits used to select a register.
+#define SKY_HLL_PRECISION 12
+
+#define SKY_HLL_REGISTER_COUNT (1 << SKY_HLL_PRECISION)
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef struct sky_hll {
+    uint8_t registers[SKY_HLL_REGISTER_COUNT];
+} sky_hll;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_hll *sky_hll_create();
+
+void sky_hll_free(sky_hll *hll);
+
+//--------------------------------------
+// Counting
+//--------------------------------------
+
+void sky_hll_add(sky_hll *hll, uint64_t value);
+
+void sky_hll_merge(sky_hll *hll, sky_hll *source);
+
+uint64_t sky_hll_count(sky_hll *hll);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int sky_hll_pack(sky_hll *hll, sky_buffer *buffer);
+
+int sky_hll_unpack(sky_hll *hll, FILE *file);
+
+#endif
@@ -1,4 +1,8 @@
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "jsmn/jsmn.h"
 #include "importer.h"
@@ -6,22 +10,76 @@
 #include "dbg.h"
 
 
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// A batch of events moving through the import pipeline. The raw text or
+// binary record of each event is stored null terminated in the data buffer
+// and the parsed events are sorted by object id and timestamp.
+typedef struct sky_importer_batch {
+    char *data;
+    size_t length;
+    size_t capacity;
+    size_t *offsets;
+    uint32_t value_count;
+    sky_event **events;
+    uint32_t event_count;
+    jsmntok_t *tokens;
+    uint32_t token_count;
+    bool binary;
+    bool parsed;
+} sky_importer_batch;
+
+// The state shared by the stages of the import pipeline. Batches are
+// numbered in the order they are read and batch n is stored in slot n modulo
+// the batch count. The reader fills batches, the parsers claim them in order
+// and the writer adds them to the table in order. The counters and flags
+// are protected by the mutex.
+typedef struct sky_importer_pipeline {
+    sky_importer *importer;
+    sky_importer_batch *batches;
+    uint32_t batch_count;
+    uint64_t fill_index;
+    uint64_t parse_index;
+    uint64_t write_index;
+    bool done;
+    bool failed;
+    bool initialized;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t *threads;
+    uint32_t thread_count;
+    pthread_t writer;
+    bool writer_started;
+} sky_importer_pipeline;
+
+
 //==============================================================================
 //
 // Forward Declarations
 //
 //==============================================================================
 
-int sky_importer_tokenize(sky_importer *importer, bstring source,
-    jsmntok_t **tokens);
+int sky_importer_fill(sky_importer *importer, FILE *file);
 
-int sky_importer_parse(sky_importer *importer, FILE *file);
+int sky_importer_peek(sky_importer *importer, FILE *file, char *ret);
 
-int sky_importer_process(sky_importer *importer, bstring source,
-    jsmntok_t *tokens);
+int sky_importer_expect(sky_importer *importer, FILE *file, char ch);
 
-int sky_importer_process_table(sky_importer *importer, bstring source,
-    jsmntok_t *tokens, uint32_t *index);
+int sky_importer_read_value(sky_importer *importer, FILE *file,
+    struct tagbstring *ret);
+
+void sky_importer_release_value(sky_importer *importer);
+
+int sky_importer_tokenize(bstring source, jsmntok_t **tokens,
+    uint32_t *token_count);
+
+int sky_importer_parse(sky_importer *importer, FILE *file);
+
+int sky_importer_process_table(sky_importer *importer, FILE *file);
 
 int sky_importer_process_actions(sky_importer *importer, bstring source,
     jsmntok_t *tokens, uint32_t *index);
@@ -35,21 +93,53 @@ int sky_importer_process_properties(sky_importer *importer, bstring source,
 int sky_importer_process_property(sky_importer *importer, bstring source,
     jsmntok_t *tokens, uint32_t *index);
 
-int sky_importer_process_events(sky_importer *importer, bstring source,
-    jsmntok_t *tokens, uint32_t *index);
+int sky_importer_process_events(sky_importer *importer, FILE *file);
 
-int sky_importer_process_event(sky_importer *importer, bstring source,
-    jsmntok_t *tokens, uint32_t *index);
+int sky_importer_process_records(sky_importer *importer, FILE *file);
+
+int sky_importer_require(sky_importer *importer, FILE *file, size_t length);
+
+int sky_importer_parse_event(sky_importer *importer, bstring source,
+    jsmntok_t *tokens, uint32_t *index, sky_event **ret);
 
 int sky_importer_process_event_data(sky_importer *importer, sky_event *event,
     bstring source, jsmntok_t *tokens, uint32_t *index);
 
+int sky_importer_pipeline_start(sky_importer_pipeline *pipeline,
+    sky_importer *importer);
+
+int sky_importer_pipeline_finish(sky_importer_pipeline *pipeline);
+
+int sky_importer_pipeline_acquire(sky_importer_pipeline *pipeline,
+    sky_importer_batch **ret);
+
+void sky_importer_pipeline_submit(sky_importer_pipeline *pipeline);
+
+void sky_importer_pipeline_fail(sky_importer_pipeline *pipeline);
+
+void *sky_importer_run_parser(void *arg);
+
+void *sky_importer_run_writer(void *arg);
+
+uint32_t sky_importer_get_thread_count(sky_importer *importer);
+
+int sky_importer_batch_append(sky_importer_batch *batch, bstring value);
+
+int sky_importer_batch_parse(sky_importer *importer,
+    sky_importer_batch *batch);
+
+int sky_importer_batch_unpack(sky_importer_batch *batch);
+
+void sky_importer_batch_clear(sky_importer_batch *batch);
+
+void sky_importer_batch_free(sky_importer_batch *batch);
+
+
+bool sky_importer_key_equal(bstring key, const char *str);
 
 bool sky_importer_tokstr_equal(bstring source, jsmntok_t *token,
     const char *str);
 
-int32_t sky_importer_token_parse_int(bstring source, jsmntok_t *token);
-
 bstring sky_importer_token_parse_bstring(bstring source, jsmntok_t *token);
 
 
@@ -85,7 +175,18 @@ void sky_importer_free(sky_importer *importer)
     if(importer) {
         if(importer->path) bdestroy(importer->path);
         importer->path = NULL;
-        
+
+        if(importer->table) {
+            if(importer->table->opened) sky_table_close(importer->table);
+            sky_table_free(importer->table);
+        }
+        importer->table = NULL;
+
+        free(importer->tokens);
+        importer->tokens = NULL;
+        free(importer->buffer);
+        importer->buffer = NULL;
+
         free(importer);
     }
 }
@@ -104,13 +205,13 @@ void sky_importer_free(sky_importer *importer)
 int sky_importer_set_path(sky_importer *importer, bstring path)
 {
     check(importer != NULL, "Importer required");
-    
+
     if(importer->path) bdestroy(importer->path);
     importer->path = bstrcpy(path);
     if(path) check_mem(importer->path);
 
     return 0;
-    
+
 error:
     return -1;
 }
@@ -121,7 +222,8 @@ error:
 
 // Imports a JSON-formatted data stream. The data stream contains table
 // information such as properties, actions and block size followed by a series
-// of events.
+// of events. The stream is read incrementally so it does not need to fit in
+// memory.
 //
 // importer - The importer.
 // file     - The data stream.
@@ -132,186 +234,451 @@ int sky_importer_import(sky_importer *importer, FILE *file)
     int rc;
     check(importer != NULL, "Importer required");
     check(file != NULL, "File stream required");
-    
-    // Process json into table structure and events.
-    rc = sky_importer_parse(importer, file);
-    check(rc == 0, "Unable to process import file");
 
-    // TODO: Create table if a structure exists.
-    // TODO: Create events.
+    // Start with an empty buffer.
+    importer->buffer_length = 0;
+    importer->buffer_position = 0;
+    importer->value_end = 0;
+    importer->eof = false;
+
+    // Binary streams start with a magic number. Anything else is json.
+    rc = sky_importer_fill(importer, file);
+    check(rc == 0, "Unable to read import stream");
+    size_t magic_length = strlen(SKY_IMPORTER_BINARY_MAGIC);
+    if(importer->buffer_length >= magic_length && memcmp(importer->buffer, SKY_IMPORTER_BINARY_MAGIC, magic_length) == 0) {
+        importer->buffer_position += magic_length;
+        rc = sky_importer_process_records(importer, file);
+        check(rc == 0, "Unable to process binary import file");
+    }
+    else {
+        // Process json into table structure and events.
+        rc = sky_importer_parse(importer, file);
+        check(rc == 0, "Unable to process import file");
+    }
 
     return 0;
-    
+
 error:
     return -1;
 }
 
 
 //--------------------------------------
-// Parsing
+// Streaming
 //--------------------------------------
 
-// Parses a JSON document into an array of tokens.
+// Reads the next chunk of the stream into the buffer. Bytes that have already
+// been consumed are dropped from the front of the buffer first and the buffer
+// is only grown when it is full of unconsumed bytes. The buffer is always
+// null terminated.
 //
 // importer - The importer.
-// source   - The import file contents.
-// tokens   - A pointer to where the tokens should be returned.
+// file     - The data stream.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_importer_tokenize(sky_importer *importer, bstring source,
-                          jsmntok_t **tokens)
+int sky_importer_fill(sky_importer *importer, FILE *file)
 {
     check(importer != NULL, "Importer required");
-    check(source != NULL, "File source required");
-    check(tokens != NULL, "Tokens return pointer required");
-    
-    // Initialize return values.
-    *tokens = NULL;
-    
-    // Create JSON parser.
-    jsmn_parser parser;
-    jsmn_init(&parser);
+    check(file != NULL, "File stream required");
 
-    // Parse tokens until we're done.
-    uint32_t token_count = 1024;
-    jsmnerr_t ret;
-    do {
-        *tokens = realloc(*tokens, token_count * sizeof(jsmntok_t));
-        ret = jsmn_parse(&parser, bdata(source), *tokens, token_count);
-        check(ret != JSMN_ERROR_INVAL, "Invalid json token");
-        check(ret != JSMN_ERROR_PART, "Unexpected end in json data");
-        
-        // If we didn't have enough tokens then reallocate and try again.
-        if(ret == JSMN_ERROR_NOMEM) token_count *= 2;
-    } while(ret != JSMN_SUCCESS);
+    // Drop consumed bytes.
+    if(importer->buffer_position > 0) {
+        memmove(importer->buffer, importer->buffer + importer->buffer_position, importer->buffer_length - importer->buffer_position);
+        importer->buffer_length -= importer->buffer_position;
+        importer->buffer_position = 0;
+    }
+
+    // Grow the buffer if there is no room left.
+    if(importer->buffer_length == importer->buffer_capacity) {
+        size_t capacity = (importer->buffer_capacity == 0 ? SKY_IMPORTER_CHUNK_SIZE : importer->buffer_capacity * 2);
+        importer->buffer = realloc(importer->buffer, capacity + 1);
+        check_mem(importer->buffer);
+        importer->buffer_capacity = capacity;
+    }
+
+    // Read the next chunk.
+    size_t sz = fread(importer->buffer + importer->buffer_length, 1, importer->buffer_capacity - importer->buffer_length, file);
+    check(!ferror(file), "Unable to read import stream");
+    importer->buffer_length += sz;
+    importer->buffer[importer->buffer_length] = '\0';
+    if(sz == 0) {
+        importer->eof = true;
+    }
 
     return 0;
 
 error:
-    free(*tokens);
-    *tokens = NULL;
     return -1;
 }
 
-// Parses a json import file into an importer structure.
+// Skips whitespace and separators and returns the next character in the
+// stream without consuming it. A null character is returned at the end of
+// the stream.
 //
-// importer    - The importer.
-// file        - The data stream.
+// importer - The importer.
+// file     - The data stream.
+// ret      - A pointer to where the character should be returned.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_importer_parse(sky_importer *importer, FILE *file)
+int sky_importer_peek(sky_importer *importer, FILE *file, char *ret)
 {
     int rc;
     check(importer != NULL, "Importer required");
-    check(file != NULL, "File stream required");
+    check(ret != NULL, "Return pointer required");
+
+    sky_importer_release_value(importer);
+
+    while(true) {
+        if(importer->buffer_position == importer->buffer_length) {
+            if(importer->eof) {
+                *ret = '\0';
+                return 0;
+            }
+            rc = sky_importer_fill(importer, file);
+            check(rc == 0, "Unable to fill import buffer");
+            continue;
+        }
+
+        char ch = importer->buffer[importer->buffer_position];
+        if(isspace(ch) || ch == ',' || ch == ':') {
+            importer->buffer_position++;
+        }
+        else {
+            *ret = ch;
+            return 0;
+        }
+    }
+
+error:
+    return -1;
+}
+
+// Consumes the next character in the stream and verifies that it matches
+// an expected character.
+//
+// importer - The importer.
+// file     - The data stream.
+// ch       - The expected character.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_expect(sky_importer *importer, FILE *file, char ch)
+{
+    int rc;
+    char next;
+    rc = sky_importer_peek(importer, file, &next);
+    check(rc == 0, "Unable to read import stream");
+    check(next == ch, "Expected '%c' in import stream", ch);
+    importer->buffer_position++;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Reads the next complete JSON value from the stream. Objects and arrays are
+// read up to their closing bracket and primitives up to the next delimiter.
+// The value is null terminated in place so that it can be tokenized and it
+// stays valid until the next read from the stream.
+//
+// importer - The importer.
+// file     - The data stream.
+// ret      - A pointer to where the value should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_read_value(sky_importer *importer, FILE *file,
+                            struct tagbstring *ret)
+{
+    int rc;
+    char ch;
+    check(importer != NULL, "Importer required");
+    check(ret != NULL, "Return pointer required");
+
+    rc = sky_importer_peek(importer, file, &ch);
+    check(rc == 0, "Unable to read import stream");
+    check(ch != '\0', "Unexpected end of import stream");
+
+    // Scan to the end of the value, reading more of the stream as needed.
+    size_t length = 0;
+    uint32_t depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    bool done = false;
+    while(!done) {
+        if(importer->buffer_position + length == importer->buffer_length) {
+            if(importer->eof) {
+                break;
+            }
+            rc = sky_importer_fill(importer, file);
+            check(rc == 0, "Unable to fill import buffer");
+            continue;
+        }
+
+        char c = importer->buffer[importer->buffer_position + length];
+        if(in_string) {
+            if(escaped) {
+                escaped = false;
+            }
+            else if(c == '\\') {
+                escaped = true;
+            }
+            else if(c == '"') {
+                in_string = false;
+                done = (depth == 0);
+            }
+            length++;
+        }
+        else if(c == '"') {
+            in_string = true;
+            length++;
+        }
+        else if(c == '{' || c == '[') {
+            depth++;
+            length++;
+        }
+        else if(c == '}' || c == ']') {
+            if(depth == 0) {
+                done = true;
+            }
+            else {
+                depth--;
+                length++;
+                done = (depth == 0);
+            }
+        }
+        else if(depth == 0 && (isspace(c) || c == ',' || c == ':')) {
+            done = true;
+        }
+        else {
+            length++;
+        }
+    }
+    check(length > 0, "Unexpected '%c' in import stream", ch);
+    check(depth == 0 && !in_string, "Unexpected end of import stream");
+
+    // Terminate the value in place and consume it.
+    char *ptr = importer->buffer + importer->buffer_position;
+    importer->value_end = importer->buffer_position + length;
+    importer->value_end_char = ptr[length];
+    ptr[length] = '\0';
+    blk2tbstr(*ret, ptr, length);
+    importer->buffer_position += length;
 
-    // Read in entire stream.
-    bstring source = bread((bNread)fread, file); check_mem(source);
+    return 0;
+
+error:
+    return -1;
+}
 
-    // Read json into tokens.
-    jsmntok_t *tokens = NULL;
-    rc = sky_importer_tokenize(importer, source, &tokens);
-    check(rc == 0, "Unable to tokenize import file");
+// Restores the character that was replaced by the terminator of the last
+// value that was read.
+//
+// importer - The importer.
+//
+// Returns nothing.
+void sky_importer_release_value(sky_importer *importer)
+{
+    if(importer->value_end > 0) {
+        importer->buffer[importer->value_end] = importer->value_end_char;
+        importer->value_end = 0;
+    }
+}
 
-    // Process the tokens.
-    rc = sky_importer_process(importer, source, tokens);
-    check(rc == 0, "Unable to parse import root")
 
-    bdestroy(source);
-    free(tokens);
+// Reads from the stream until a given number of unconsumed bytes are in the
+// buffer or the stream ends.
+//
+// importer - The importer.
+// file     - The data stream.
+// length   - The number of bytes required.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_require(sky_importer *importer, FILE *file, size_t length)
+{
+    int rc;
+    check(importer != NULL, "Importer required");
+
+    while(!importer->eof && importer->buffer_length - importer->buffer_position < length) {
+        rc = sky_importer_fill(importer, file);
+        check(rc == 0, "Unable to fill import buffer");
+    }
+
     return 0;
 
 error:
-    bdestroy(source);
-    free(tokens);
     return -1;
 }
 
 
 //--------------------------------------
-// Processing
+// Parsing
 //--------------------------------------
 
-// Processes the JSON tokens.
+// Parses a single JSON value into a token array. The array is reused
+// between values and only grows when a value has more tokens than any value
+// before it.
 //
-// importer - The importer.
-// source   - The JSON source text.
-// tokens   - The tokens.
+// source      - The null terminated JSON value.
+// tokens      - A pointer to the token array.
+// token_count - A pointer to the number of tokens in the array.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_tokenize(bstring source, jsmntok_t **tokens,
+                          uint32_t *token_count)
+{
+    check(source != NULL, "File source required");
+    check(tokens != NULL, "Tokens pointer required");
+    check(token_count != NULL, "Token count pointer required");
+
+    // Create JSON parser.
+    jsmn_parser parser;
+    jsmn_init(&parser);
+
+    if(*tokens == NULL) {
+        *token_count = SKY_IMPORTER_INITIAL_TOKEN_COUNT;
+        *tokens = malloc(*token_count * sizeof(jsmntok_t));
+        check_mem(*tokens);
+    }
+
+    // Parse tokens until we're done.
+    jsmnerr_t ret;
+    while(true) {
+        ret = jsmn_parse(&parser, bdata(source), *tokens, *token_count);
+        check(ret != JSMN_ERROR_INVAL, "Invalid json token");
+        check(ret != JSMN_ERROR_PART, "Unexpected end in json data");
+        if(ret == JSMN_SUCCESS) break;
+
+        // If we didn't have enough tokens then reallocate and continue.
+        *token_count *= 2;
+        *tokens = realloc(*tokens, *token_count * sizeof(jsmntok_t));
+        check_mem(*tokens);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Parses a json import stream into an importer structure.
+//
+// importer    - The importer.
+// file        - The data stream.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_importer_process(sky_importer *importer, bstring source,
-                         jsmntok_t *tokens)
+int sky_importer_parse(sky_importer *importer, FILE *file)
 {
     int rc;
+    char ch;
     check(importer != NULL, "Importer required");
-    check(source != NULL, "Source required");
-    check(tokens != NULL, "Tokens required");
+    check(file != NULL, "File stream required");
 
-    // Setup index to track current token and root token.
-    uint32_t index = 1;
-    jsmntok_t *root_token = &tokens[0];
-    
-    // Process over child tokens.
-    int32_t i;
-    for(i=0; i<root_token->size; i++) {
-        jsmntok_t *token = &tokens[index];
-        index++;
-        
-        if(sky_importer_tokstr_equal(source, token, "table")) {
-            rc = sky_importer_process_table(importer, source, tokens, &index);
+    // Process over each key of the root object.
+    rc = sky_importer_expect(importer, file, '{');
+    check(rc == 0, "Import root must be an object");
+    while(true) {
+        rc = sky_importer_peek(importer, file, &ch);
+        check(rc == 0 && ch != '\0', "Unexpected end of import stream");
+        if(ch == '}') {
+            importer->buffer_position++;
+            break;
+        }
+
+        struct tagbstring key;
+        rc = sky_importer_read_value(importer, file, &key);
+        check(rc == 0, "Unable to read import key");
+        if(sky_importer_key_equal(&key, "table")) {
+            rc = sky_importer_process_table(importer, file);
             check(rc == 0, "Unable to process table import");
         }
+        else {
+            sentinel("Invalid import key: %s", bdata(&key));
+        }
     }
-    
+    sky_importer_release_value(importer);
+
     return 0;
 
 error:
     return -1;
 }
 
-int sky_importer_process_table(sky_importer *importer, bstring source,
-                               jsmntok_t *tokens, uint32_t *index)
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Processes the table object of the import stream. The block size, actions
+// and properties are read as whole values while events are streamed one at
+// a time.
+//
+// importer - The importer.
+// file     - The data stream.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_process_table(sky_importer *importer, FILE *file)
 {
     int rc;
+    char ch;
+    uint32_t index;
+    struct tagbstring key;
+    struct tagbstring value;
     check(importer != NULL, "Importer required");
-    check(source != NULL, "Source required");
-    check(tokens != NULL, "Tokens required");
-    check(index != NULL, "Token index required");
+    check(file != NULL, "File stream required");
 
-    jsmntok_t *table_token = &tokens[*index];
-    (*index)++;
-    
     // Initialize import table.
     importer->table = sky_table_create(); check_mem(importer->table);
     importer->table->path = bstrcpy(importer->path);
-    
-    // Process over child tokens.
-    int32_t i;
-    for(i=0; i<(table_token->size/2); i++) {
-        jsmntok_t *token = &tokens[*index];
-        (*index)++;
-        
-        if(sky_importer_tokstr_equal(source, token, "blockSize")) {
-            importer->table->default_block_size = (uint32_t)sky_importer_token_parse_int(source, &tokens[(*index)++]);
+
+    // Process over each key.
+    rc = sky_importer_expect(importer, file, '{');
+    check(rc == 0, "Table must be an object");
+    while(true) {
+        rc = sky_importer_peek(importer, file, &ch);
+        check(rc == 0 && ch != '\0', "Unexpected end of import stream");
+        if(ch == '}') {
+            importer->buffer_position++;
+            break;
         }
-        else if(sky_importer_tokstr_equal(source, token, "actions")) {
-            rc = sky_importer_process_actions(importer, source, tokens, index);
+
+        rc = sky_importer_read_value(importer, file, &key);
+        check(rc == 0, "Unable to read table key");
+
+        if(sky_importer_key_equal(&key, "blockSize")) {
+            rc = sky_importer_read_value(importer, file, &value);
+            check(rc == 0, "Unable to read block size");
+            importer->table->default_block_size = (uint32_t)atoi(bdata(&value));
+        }
+        else if(sky_importer_key_equal(&key, "actions")) {
+            rc = sky_importer_read_value(importer, file, &value);
+            check(rc == 0, "Unable to read actions");
+            rc = sky_importer_tokenize(&value, &importer->tokens, &importer->token_count);
+            check(rc == 0, "Unable to tokenize actions");
+            index = 0;
+            rc = sky_importer_process_actions(importer, &value, importer->tokens, &index);
             check(rc == 0, "Unable to process actions import");
         }
-        else if(sky_importer_tokstr_equal(source, token, "properties")) {
-            rc = sky_importer_process_properties(importer, source, tokens, index);
+        else if(sky_importer_key_equal(&key, "properties")) {
+            rc = sky_importer_read_value(importer, file, &value);
+            check(rc == 0, "Unable to read properties");
+            rc = sky_importer_tokenize(&value, &importer->tokens, &importer->token_count);
+            check(rc == 0, "Unable to tokenize properties");
+            index = 0;
+            rc = sky_importer_process_properties(importer, &value, importer->tokens, &index);
             check(rc == 0, "Unable to process properties import");
         }
-        else if(sky_importer_tokstr_equal(source, token, "events")) {
-            rc = sky_importer_process_events(importer, source, tokens, index);
+        else if(sky_importer_key_equal(&key, "events")) {
+            rc = sky_importer_process_events(importer, file);
             check(rc == 0, "Unable to process events import");
         }
         else {
-            sentinel("Invalid token at char %d", tokens[*index].start);
+            sentinel("Invalid table key: %s", bdata(&key));
         }
     }
-    
-    sky_table_close(importer->table);
+
+    if(importer->table->opened) {
+        rc = sky_table_close(importer->table);
+        check(rc == 0, "Unable to close table");
+    }
 
     return 0;
 
@@ -472,71 +839,217 @@ error:
     return -1;
 }
 
-int sky_importer_process_events(sky_importer *importer, bstring source,
-                                jsmntok_t *tokens, uint32_t *index)
+
+// Processes the events array of the import stream. The raw text of each
+// event is collected into batches that are parsed and added to the table by
+// the import pipeline.
+//
+// importer - The importer.
+// file     - The data stream.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_process_events(sky_importer *importer, FILE *file)
 {
     int rc;
+    char ch;
+    bool started = false;
+    struct tagbstring value;
+    sky_importer_batch *batch = NULL;
+    sky_importer_pipeline pipeline;
     check(importer != NULL, "Importer required");
-    check(source != NULL, "Source required");
-    check(tokens != NULL, "Tokens required");
-    check(index != NULL, "Token index required");
+    check(file != NULL, "File stream required");
 
-    jsmntok_t *events_token = &tokens[*index];
-    (*index)++;
-    
-    // Process over each event.
-    int32_t i;
-    for(i=0; i<events_token->size; i++) {
-        rc = sky_importer_process_event(importer, source, tokens, index);
-        check(rc == 0, "Unable to process event import");
+    rc = sky_importer_expect(importer, file, '[');
+    check(rc == 0, "Events must be an array");
+
+    // Open the table before the parsers look up actions and properties.
+    if(!importer->table->opened) {
+        check(sky_table_open(importer->table) == 0, "Unable to open table");
     }
-    
+
+    rc = sky_importer_pipeline_start(&pipeline, importer);
+    check(rc == 0, "Unable to start import pipeline");
+    started = true;
+
+    // Read each event into the current batch and submit the batch once it
+    // is full.
+    while(true) {
+        rc = sky_importer_peek(importer, file, &ch);
+        check(rc == 0 && ch != '\0', "Unexpected end of import stream");
+        if(ch == ']') {
+            importer->buffer_position++;
+            break;
+        }
+        check(ch == '{', "Event must be an object");
+
+        rc = sky_importer_read_value(importer, file, &value);
+        check(rc == 0, "Unable to read event");
+
+        if(batch == NULL) {
+            rc = sky_importer_pipeline_acquire(&pipeline, &batch);
+            check(rc == 0, "Import pipeline failed");
+        }
+        rc = sky_importer_batch_append(batch, &value);
+        check(rc == 0, "Unable to add event to batch");
+
+        if(batch->value_count == SKY_IMPORTER_BATCH_SIZE) {
+            sky_importer_pipeline_submit(&pipeline);
+            batch = NULL;
+        }
+    }
+    if(batch != NULL) {
+        sky_importer_pipeline_submit(&pipeline);
+        batch = NULL;
+    }
+
+    // Wait for the remaining batches to be added.
+    started = false;
+    rc = sky_importer_pipeline_finish(&pipeline);
+    check(rc == 0, "Unable to import events");
+
     return 0;
 
 error:
+    if(started) {
+        sky_importer_pipeline_fail(&pipeline);
+        sky_importer_pipeline_finish(&pipeline);
+    }
     return -1;
 }
 
-int sky_importer_process_event(sky_importer *importer, bstring source,
-                               jsmntok_t *tokens, uint32_t *index)
+// Processes a binary import stream. Each record is a 32-bit length followed
+// by the object id and the raw event, encoded the same way as a write-ahead
+// log record. The table must already define the actions and properties that
+// the records refer to.
+//
+// importer - The importer.
+// file     - The data stream.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_process_records(sky_importer *importer, FILE *file)
 {
     int rc;
+    bool started = false;
+    sky_importer_batch *batch = NULL;
+    sky_importer_pipeline pipeline;
+    check(importer != NULL, "Importer required");
+    check(file != NULL, "File stream required");
+
+    importer->table = sky_table_create(); check_mem(importer->table);
+    importer->table->path = bstrcpy(importer->path);
+    check(sky_table_open(importer->table) == 0, "Unable to open table");
+
+    rc = sky_importer_pipeline_start(&pipeline, importer);
+    check(rc == 0, "Unable to start import pipeline");
+    started = true;
+
+    // Copy each record into the current batch and submit the batch once it
+    // is full.
+    while(true) {
+        uint32_t length = 0;
+        rc = sky_importer_require(importer, file, sizeof(length));
+        check(rc == 0, "Unable to read record length");
+        size_t available = importer->buffer_length - importer->buffer_position;
+        if(available == 0) {
+            break;
+        }
+        check(available >= sizeof(length), "Truncated record length");
+        length = *((uint32_t*)(importer->buffer + importer->buffer_position));
+        check(length <= sky_table_get_block_size(importer->table), "Record is larger than a block: %d bytes", length);
+
+        rc = sky_importer_require(importer, file, sizeof(length) + length);
+        check(rc == 0, "Unable to read record");
+        available = importer->buffer_length - importer->buffer_position;
+        check(available >= sizeof(length) + length, "Truncated record");
+
+        if(batch == NULL) {
+            rc = sky_importer_pipeline_acquire(&pipeline, &batch);
+            check(rc == 0, "Import pipeline failed");
+            batch->binary = true;
+        }
+        struct tagbstring record;
+        blk2tbstr(record, importer->buffer + importer->buffer_position + sizeof(length), (int)length);
+        rc = sky_importer_batch_append(batch, &record);
+        check(rc == 0, "Unable to add record to batch");
+        importer->buffer_position += sizeof(length) + length;
+
+        if(batch->value_count == SKY_IMPORTER_BATCH_SIZE) {
+            sky_importer_pipeline_submit(&pipeline);
+            batch = NULL;
+        }
+    }
+    if(batch != NULL) {
+        sky_importer_pipeline_submit(&pipeline);
+        batch = NULL;
+    }
+
+    // Wait for the remaining batches to be added.
+    started = false;
+    rc = sky_importer_pipeline_finish(&pipeline);
+    check(rc == 0, "Unable to import records");
+
+    rc = sky_table_close(importer->table);
+    check(rc == 0, "Unable to close table");
+
+    return 0;
+
+error:
+    if(started) {
+        sky_importer_pipeline_fail(&pipeline);
+        sky_importer_pipeline_finish(&pipeline);
+    }
+    return -1;
+}
+
+// Creates an event from its JSON tokens.
+//
+// importer - The importer.
+// source   - The JSON source text.
+// tokens   - The tokens.
+// index    - A pointer to the index of the event token.
+// ret      - A pointer to where the event should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_parse_event(sky_importer *importer, bstring source,
+                             jsmntok_t *tokens, uint32_t *index,
+                             sky_event **ret)
+{
+    int rc;
+    sky_event *event = NULL;
     check(importer != NULL, "Importer required");
     check(source != NULL, "Source required");
     check(tokens != NULL, "Tokens required");
     check(index != NULL, "Token index required");
+    check(ret != NULL, "Return pointer required");
 
     jsmntok_t *event_token = &tokens[*index];
     (*index)++;
 
-    // Open table if it hasn't been already.
-    if(!importer->table->opened) {
-        check(sky_table_open(importer->table) == 0, "Unable to open table");
-    }
-
     // Create the event object.
-    sky_event *event = sky_event_create(0, 0, 0); check_mem(event);
-        
+    event = sky_event_create(0, 0, 0); check_mem(event);
+
     // Process over child tokens.
     int32_t i;
     for(i=0; i<(event_token->size/2); i++) {
         jsmntok_t *token = &tokens[*index];
         (*index)++;
-        
+
         if(sky_importer_tokstr_equal(source, token, "timestamp")) {
             bstring timestamp = sky_importer_token_parse_bstring(source, &tokens[(*index)++]);
             rc = sky_timestamp_parse(timestamp, &event->timestamp);
-            check(rc == 0, "Unable to parse timestamp");
             bdestroy(timestamp);
+            check(rc == 0, "Unable to parse timestamp");
         }
         else if(sky_importer_tokstr_equal(source, token, "objectId")) {
-            event->object_id = (sky_object_id_t)sky_importer_token_parse_int(source, &tokens[(*index)++]);
+            // Object ids are parsed in place since the value is terminated.
+            event->object_id = (sky_object_id_t)strtoull(bdata(source) + tokens[(*index)++].start, NULL, 10);
         }
         else if(sky_importer_tokstr_equal(source, token, "action")) {
             sky_action *action = NULL;
             bstring action_name = sky_importer_token_parse_bstring(source, &tokens[(*index)++]);
             rc = sky_action_file_find_action_by_name(importer->table->action_file, action_name, &action);
-            check(rc == 0, "Unable to find action: %s", bdata(action_name));
+            check(rc == 0 && action != NULL, "Unable to find action: %s", bdata(action_name));
+            bdestroy(action_name);
             event->action_id = action->id;
         }
         else if(sky_importer_tokstr_equal(source, token, "data")) {
@@ -547,14 +1060,13 @@ int sky_importer_process_event(sky_importer *importer, bstring source,
             sentinel("Invalid token at char %d", tokens[*index].start);
         }
     }
-    
-    // Add event.
-    rc = sky_table_add_event(importer->table, event);
-    check(rc == 0, "Unable to add event");
-    
+
+    *ret = event;
     return 0;
 
 error:
+    sky_event_free(event);
+    *ret = NULL;
     return -1;
 }
 
@@ -579,11 +1091,13 @@ int sky_importer_process_event_data(sky_importer *importer, sky_event *event,
         jsmntok_t *value_token = &tokens[*index];
         (*index)++;
         
-        // Retrieve property name.
+        // Retrieve property name. The name is looked up through a view on the
+        // source so that no string is allocated.
         sky_property *property = NULL;
-        bstring property_name = sky_importer_token_parse_bstring(source, key_token);
-        rc = sky_property_file_find_by_name(importer->table->property_file, property_name, &property);
-        check(rc == 0 && property != NULL, "Unable to find property: %s", bdata(property_name));
+        struct tagbstring property_name;
+        blk2tbstr(property_name, bdata(source) + key_token->start, key_token->end - key_token->start);
+        rc = sky_property_file_find_by_name(importer->table->property_file, &property_name, &property);
+        check(rc == 0 && property != NULL, "Unable to find property: %s", bdata(&property_name));
 
         // Reallocate event data array.
         event->data_count++;
@@ -591,33 +1105,33 @@ int sky_importer_process_event_data(sky_importer *importer, sky_event *event,
         check_mem(event->data);
 
         // Parse string.
-        char ch = bdata(source)[value_token->start];
-        bstring value = sky_importer_token_parse_bstring(source, value_token);
+        char *value_ptr = bdata(source) + value_token->start;
         if(value_token->type == JSMN_STRING) {
-            event_data = sky_event_data_create_string(property->id, value); check_mem(event_data);
+            struct tagbstring value;
+            blk2tbstr(value, value_ptr, value_token->end - value_token->start);
+            event_data = sky_event_data_create_string(property->id, &value); check_mem(event_data);
         }
         // Parse primitives.
         else if(value_token->type == JSMN_PRIMITIVE) {
             // True
-            if(ch == 't') {
+            if(*value_ptr == 't') {
                 event_data = sky_event_data_create_boolean(property->id, true); check_mem(event_data);
             }
             // False
-            else if(ch == 'f') {
+            else if(*value_ptr == 'f') {
                 event_data = sky_event_data_create_boolean(property->id, false); check_mem(event_data);
             }
-            // Numbers (or null, which evaluates to Int 0).
+            // Numbers (or null, which evaluates to Int 0). Numbers are parsed
+            // in place since the token is always followed by a delimiter.
             else {
-                bstring value = sky_importer_token_parse_bstring(source, value_token);
                 if(biseqcstr(property->data_type, "Float") == 1) {
-                    event_data = sky_event_data_create_float(property->id, atof(bdata(value))); check_mem(event_data);
+                    event_data = sky_event_data_create_float(property->id, strtod(value_ptr, NULL)); check_mem(event_data);
                 }
                 else {
-                    event_data = sky_event_data_create_int(property->id, atoll(bdata(value))); check_mem(event_data);
+                    event_data = sky_event_data_create_int(property->id, strtoll(value_ptr, NULL, 10)); check_mem(event_data);
                 }
             }
         }
-        bdestroy(value);
 
         // Make sure data was generated.
         check(event_data != NULL, "Event data could not be parsed for: %s", bdata(property->name));
@@ -631,10 +1145,459 @@ error:
 }
 
 
+//--------------------------------------
+// Pipeline
+//--------------------------------------
+
+// Starts the parser threads and the writer thread of an import pipeline.
+//
+// pipeline - The pipeline to initialize.
+// importer - The importer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_pipeline_start(sky_importer_pipeline *pipeline,
+                                sky_importer *importer)
+{
+    int rc;
+    uint32_t i;
+    check(pipeline != NULL, "Pipeline required");
+    check(importer != NULL, "Importer required");
+
+    memset(pipeline, 0, sizeof(*pipeline));
+    pipeline->importer = importer;
+    uint32_t thread_count = sky_importer_get_thread_count(importer);
+    pipeline->batch_count = thread_count * SKY_IMPORTER_BATCHES_PER_THREAD;
+    pipeline->batches = calloc(pipeline->batch_count, sizeof(*pipeline->batches));
+    check_mem(pipeline->batches);
+    pipeline->threads = calloc(thread_count, sizeof(*pipeline->threads));
+    check_mem(pipeline->threads);
+    pthread_mutex_init(&pipeline->mutex, NULL);
+    pthread_cond_init(&pipeline->cond, NULL);
+    pipeline->initialized = true;
+
+    // Start the writer and then the parsers.
+    rc = pthread_create(&pipeline->writer, NULL, sky_importer_run_writer, pipeline);
+    check(rc == 0, "Unable to create writer thread");
+    pipeline->writer_started = true;
+
+    for(i=0; i<thread_count; i++) {
+        rc = pthread_create(&pipeline->threads[i], NULL, sky_importer_run_parser, pipeline);
+        check(rc == 0, "Unable to create parser thread");
+        pipeline->thread_count++;
+    }
+
+    return 0;
+
+error:
+    sky_importer_pipeline_fail(pipeline);
+    sky_importer_pipeline_finish(pipeline);
+    return -1;
+}
+
+// Waits for all submitted batches to be added to the table, stops the
+// threads and frees the pipeline's batches.
+//
+// pipeline - The pipeline.
+//
+// Returns 0 if every batch was added, otherwise returns -1.
+int sky_importer_pipeline_finish(sky_importer_pipeline *pipeline)
+{
+    uint32_t i;
+    check(pipeline != NULL, "Pipeline required");
+
+    if(pipeline->initialized) {
+        pthread_mutex_lock(&pipeline->mutex);
+        pipeline->done = true;
+        pthread_cond_broadcast(&pipeline->cond);
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+
+    for(i=0; i<pipeline->thread_count; i++) {
+        pthread_join(pipeline->threads[i], NULL);
+    }
+    if(pipeline->writer_started) {
+        pthread_join(pipeline->writer, NULL);
+    }
+
+    bool failed = pipeline->failed;
+    if(pipeline->batches) {
+        for(i=0; i<pipeline->batch_count; i++) {
+            sky_importer_batch_free(&pipeline->batches[i]);
+        }
+    }
+    free(pipeline->batches);
+    free(pipeline->threads);
+    if(pipeline->initialized) {
+        pthread_mutex_destroy(&pipeline->mutex);
+        pthread_cond_destroy(&pipeline->cond);
+    }
+    memset(pipeline, 0, sizeof(*pipeline));
+
+    return (failed ? -1 : 0);
+
+error:
+    return -1;
+}
+
+// Waits for a free batch that the reader can fill. The batch is not visible
+// to the other stages until it is submitted.
+//
+// pipeline - The pipeline.
+// ret      - A pointer to where the batch should be returned.
+//
+// Returns 0 if successful, otherwise returns -1 if the pipeline failed.
+int sky_importer_pipeline_acquire(sky_importer_pipeline *pipeline,
+                                  sky_importer_batch **ret)
+{
+    check(pipeline != NULL, "Pipeline required");
+    check(ret != NULL, "Return pointer required");
+
+    pthread_mutex_lock(&pipeline->mutex);
+    while(!pipeline->failed && pipeline->fill_index >= pipeline->write_index + pipeline->batch_count) {
+        pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+    }
+    bool failed = pipeline->failed;
+    uint64_t index = pipeline->fill_index;
+    pthread_mutex_unlock(&pipeline->mutex);
+    check(!failed, "Import pipeline failed");
+
+    sky_importer_batch *batch = &pipeline->batches[index % pipeline->batch_count];
+    batch->length = 0;
+    batch->value_count = 0;
+    batch->binary = false;
+    *ret = batch;
+    return 0;
+
+error:
+    *ret = NULL;
+    return -1;
+}
+
+// Hands the batch that was last acquired to the parser threads.
+//
+// pipeline - The pipeline.
+//
+// Returns nothing.
+void sky_importer_pipeline_submit(sky_importer_pipeline *pipeline)
+{
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->fill_index++;
+    pthread_cond_broadcast(&pipeline->cond);
+    pthread_mutex_unlock(&pipeline->mutex);
+}
+
+// Marks the pipeline as failed so that every stage stops.
+//
+// pipeline - The pipeline.
+//
+// Returns nothing.
+void sky_importer_pipeline_fail(sky_importer_pipeline *pipeline)
+{
+    if(pipeline->initialized) {
+        pthread_mutex_lock(&pipeline->mutex);
+        pipeline->failed = true;
+        pthread_cond_broadcast(&pipeline->cond);
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+    else {
+        pipeline->failed = true;
+    }
+}
+
+// Parses submitted batches until the reader is done. Each parser takes the
+// oldest batch that has not been claimed yet.
+//
+// arg - The pipeline.
+//
+// Returns NULL.
+void *sky_importer_run_parser(void *arg)
+{
+    int rc;
+    sky_importer_pipeline *pipeline = (sky_importer_pipeline*)arg;
+
+    while(true) {
+        pthread_mutex_lock(&pipeline->mutex);
+        while(!pipeline->failed && !pipeline->done && pipeline->parse_index == pipeline->fill_index) {
+            pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+        }
+        if(pipeline->failed || pipeline->parse_index == pipeline->fill_index) {
+            pthread_mutex_unlock(&pipeline->mutex);
+            break;
+        }
+        sky_importer_batch *batch = &pipeline->batches[pipeline->parse_index % pipeline->batch_count];
+        pipeline->parse_index++;
+        pthread_mutex_unlock(&pipeline->mutex);
+
+        rc = sky_importer_batch_parse(pipeline->importer, batch);
+
+        pthread_mutex_lock(&pipeline->mutex);
+        if(rc == 0) {
+            batch->parsed = true;
+        }
+        else {
+            pipeline->failed = true;
+        }
+        pthread_cond_broadcast(&pipeline->cond);
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+
+    return NULL;
+}
+
+// Adds parsed batches to the table in the order they were read until the
+// reader is done and every batch has been added.
+//
+// arg - The pipeline.
+//
+// Returns NULL.
+void *sky_importer_run_writer(void *arg)
+{
+    int rc;
+    sky_importer_pipeline *pipeline = (sky_importer_pipeline*)arg;
+
+    while(true) {
+        pthread_mutex_lock(&pipeline->mutex);
+        sky_importer_batch *batch = &pipeline->batches[pipeline->write_index % pipeline->batch_count];
+        while(!pipeline->failed &&
+              !(pipeline->write_index < pipeline->fill_index && batch->parsed) &&
+              !(pipeline->done && pipeline->write_index == pipeline->fill_index))
+        {
+            pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+        }
+        if(pipeline->failed || pipeline->write_index == pipeline->fill_index) {
+            pthread_mutex_unlock(&pipeline->mutex);
+            break;
+        }
+        pthread_mutex_unlock(&pipeline->mutex);
+
+        rc = sky_table_add_sorted_events(pipeline->importer->table, batch->events, batch->event_count);
+        sky_importer_batch_clear(batch);
+
+        pthread_mutex_lock(&pipeline->mutex);
+        if(rc == 0) {
+            batch->parsed = false;
+            pipeline->write_index++;
+        }
+        else {
+            pipeline->failed = true;
+        }
+        pthread_cond_broadcast(&pipeline->cond);
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+
+    return NULL;
+}
+
+// Determines the number of parser threads to use for an import.
+//
+// importer - The importer.
+//
+// Returns the number of threads.
+uint32_t sky_importer_get_thread_count(sky_importer *importer)
+{
+    long thread_count = importer->thread_count;
+    if(thread_count == 0) {
+        thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if(thread_count < 1) {
+        thread_count = 1;
+    }
+    if(thread_count > SKY_IMPORTER_MAX_THREAD_COUNT) {
+        thread_count = SKY_IMPORTER_MAX_THREAD_COUNT;
+    }
+    return (uint32_t)thread_count;
+}
+
+
+//--------------------------------------
+// Batches
+//--------------------------------------
+
+// Copies the raw text of an event into a batch.
+//
+// batch - The batch.
+// value - The raw event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_batch_append(sky_importer_batch *batch, bstring value)
+{
+    check(batch != NULL, "Batch required");
+    check(value != NULL, "Value required");
+    check(batch->value_count < SKY_IMPORTER_BATCH_SIZE, "Batch is full");
+
+    if(batch->offsets == NULL) {
+        batch->offsets = calloc(SKY_IMPORTER_BATCH_SIZE, sizeof(*batch->offsets));
+        check_mem(batch->offsets);
+        batch->events = calloc(SKY_IMPORTER_BATCH_SIZE, sizeof(*batch->events));
+        check_mem(batch->events);
+    }
+
+    // Grow the buffer to fit the value and its terminator.
+    size_t length = blength(value);
+    if(batch->length + length + 1 > batch->capacity) {
+        size_t capacity = (batch->capacity == 0 ? SKY_IMPORTER_CHUNK_SIZE : batch->capacity);
+        while(batch->length + length + 1 > capacity) {
+            capacity *= 2;
+        }
+        batch->data = realloc(batch->data, capacity);
+        check_mem(batch->data);
+        batch->capacity = capacity;
+    }
+
+    memcpy(batch->data + batch->length, value->data, length);
+    batch->data[batch->length + length] = '\0';
+    batch->offsets[batch->value_count++] = batch->length;
+    batch->length += length + 1;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Parses the raw events of a batch and sorts them by object id and
+// timestamp. Parsing only reads the table's actions and properties so
+// batches can be parsed on several threads at once.
+//
+// importer - The importer.
+// batch    - The batch.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_batch_parse(sky_importer *importer, sky_importer_batch *batch)
+{
+    int rc;
+    uint32_t i;
+    check(importer != NULL, "Importer required");
+    check(batch != NULL, "Batch required");
+
+    if(batch->binary) {
+        return sky_importer_batch_unpack(batch);
+    }
+
+    for(i=0; i<batch->value_count; i++) {
+        size_t start = batch->offsets[i];
+        size_t end = (i+1 < batch->value_count ? batch->offsets[i+1] : batch->length) - 1;
+        struct tagbstring source;
+        blk2tbstr(source, batch->data + start, (int)(end - start));
+
+        rc = sky_importer_tokenize(&source, &batch->tokens, &batch->token_count);
+        check(rc == 0, "Unable to tokenize event");
+        uint32_t index = 0;
+        rc = sky_importer_parse_event(importer, &source, batch->tokens, &index, &batch->events[batch->event_count]);
+        check(rc == 0, "Unable to process event import");
+        batch->event_count++;
+    }
+
+    sky_table_sort_events(batch->events, batch->event_count);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Unpacks the binary records of a batch and sorts the events by object id
+// and timestamp. Each record is validated before it is unpacked so that a
+// bad record cannot be read past its end.
+//
+// batch - The batch.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_importer_batch_unpack(sky_importer_batch *batch)
+{
+    int rc;
+    uint32_t i;
+    size_t sz;
+    check(batch != NULL, "Batch required");
+
+    for(i=0; i<batch->value_count; i++) {
+        void *ptr = batch->data + batch->offsets[i];
+        size_t end = (i+1 < batch->value_count ? batch->offsets[i+1] : batch->length) - 1;
+        size_t length = end - batch->offsets[i];
+        check(length > sizeof(sky_object_id_t), "Binary record #%d is too short", i);
+
+        // Validate the event header and length.
+        sky_object_id_t object_id = *((sky_object_id_t*)ptr);
+        void *event_ptr = ptr + sizeof(sky_object_id_t);
+        size_t event_length = length - sizeof(sky_object_id_t);
+        sky_event_flag_t flag = *((sky_event_flag_t*)event_ptr);
+        check((flag & SKY_EVENT_DELTA_MASK) == 0, "Binary record #%d must store a full timestamp", i);
+        size_t header_length = SKY_EVENT_HEADER_LENGTH;
+        if(flag & SKY_EVENT_FLAG_ACTION) header_length += sizeof(sky_action_id_t);
+        if(flag & SKY_EVENT_FLAG_DATA) header_length += sizeof(sky_event_data_length_t);
+        check(event_length >= header_length, "Binary record #%d is too short", i);
+        check(sky_event_sizeof_raw(event_ptr) == event_length, "Binary record #%d has an invalid length", i);
+
+        sky_event *event = sky_event_create(object_id, 0, 0); check_mem(event);
+        batch->events[batch->event_count++] = event;
+        rc = sky_event_unpack(event, event_ptr, &sz);
+        check(rc == 0 && sz == event_length, "Unable to unpack binary record #%d", i);
+    }
+
+    sky_table_sort_events(batch->events, batch->event_count);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Frees the events of a batch.
+//
+// batch - The batch.
+//
+// Returns nothing.
+void sky_importer_batch_clear(sky_importer_batch *batch)
+{
+    uint32_t i;
+    for(i=0; i<batch->event_count; i++) {
+        sky_event_free(batch->events[i]);
+        batch->events[i] = NULL;
+    }
+    batch->event_count = 0;
+}
+
+// Frees the events and buffers of a batch.
+//
+// batch - The batch.
+//
+// Returns nothing.
+void sky_importer_batch_free(sky_importer_batch *batch)
+{
+    sky_importer_batch_clear(batch);
+    free(batch->data);
+    batch->data = NULL;
+    free(batch->offsets);
+    batch->offsets = NULL;
+    free(batch->events);
+    batch->events = NULL;
+    free(batch->tokens);
+    batch->tokens = NULL;
+}
+
+
 //--------------------------------------
 // Utility
 //--------------------------------------
 
+// Compares a key read from the stream to another string. Quoted and unquoted
+// keys are both accepted.
+//
+// key - The key.
+// str - The string to compare with.
+//
+// Returns true if the key matches the string, otherwise returns false.
+bool sky_importer_key_equal(bstring key, const char *str)
+{
+    char *ptr = bdata(key);
+    int length = blength(key);
+    if(length >= 2 && ptr[0] == '"' && ptr[length-1] == '"') {
+        ptr++;
+        length -= 2;
+    }
+    return ((int)strlen(str) == length && strncmp(ptr, str, length) == 0);
+}
+
 // Compares a token string to another string.
 //
 // source - The import file contents.
@@ -655,20 +1618,6 @@ bool sky_importer_tokstr_equal(bstring source, jsmntok_t *token,
     }
 }
 
-int32_t sky_importer_token_parse_int(bstring source, jsmntok_t *token)
-{
-    if(token->type == JSMN_PRIMITIVE) {
-        int toklen = token->end - token->start;
-        bstring str;
-        str = bmidstr(source, token->start, toklen);
-        int32_t value = (int32_t)atoi(bdata(str));
-        bdestroy(str);
-        return value;
-    }
-    
-    return 0;
-}
-
 bstring sky_importer_token_parse_bstring(bstring source, jsmntok_t *token)
 {
     int toklen = token->end - token->start;
@@ -6,19 +6,86 @@
 #include <stdio.h>
 
 #include "bstring.h"
+#include "jsmn/jsmn.h"
 #include "table.h"
 #include "types.h"
 
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The importer loads a JSON-formatted data stream into a table. The stream
+// is read in fixed size chunks and only one value is held in memory at a
+// time: the table settings, the action list, the property list or a single
+// event. Each value is tokenized on its own so the tokens only cover the
+// value being processed. The buffer only grows past the chunk size when a
+// single value is larger than a chunk.
+//
+// The importer also accepts a binary stream of events, which is recognized
+// by the magic number at its start. Each record in the stream is a 32-bit
+// length followed by the 64-bit object id and the raw event packed with
+// sky_event_pack(), which stores its data with the same MessagePack encoding
+// as blocks. Records refer to actions and properties by id so the table has
+// to be set up before a binary stream is imported. Integers are in host byte
+// order like the rest of the table files.
+//
+// Events are imported by a pipeline. The calling thread reads the raw text
+// or record of each event from the stream and collects it into a batch. Parser threads
+// turn batches into sorted events in parallel and a single writer thread
+// adds each parsed batch to the table, in the order the batches were read,
+// through sky_table_add_sorted_events(). A fixed number of batches is in
+// flight at a time so memory stays bounded when the writer falls behind.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The magic number at the start of a binary import stream.
+#define SKY_IMPORTER_BINARY_MAGIC "SKYE"
+
+// The number of bytes read from the stream at a time.
+#define SKY_IMPORTER_CHUNK_SIZE 65536
+
+// The number of events added to the table at a time.
+#define SKY_IMPORTER_BATCH_SIZE 1024
+
+// The initial number of tokens allocated for a value.
+#define SKY_IMPORTER_INITIAL_TOKEN_COUNT 64
+
+// The maximum number of parser threads.
+#define SKY_IMPORTER_MAX_THREAD_COUNT 32
+
+// The number of batches in flight for each parser thread.
+#define SKY_IMPORTER_BATCHES_PER_THREAD 2
+
+
 //==============================================================================
 //
 // Typedefs
 //
 //==============================================================================
 
+// The number of parser threads defaults to the number of online processors
+// when the thread count is zero.
 typedef struct {
     bstring path;
     sky_table *table;
-    sky_event **events;
+    uint32_t thread_count;
+    jsmntok_t *tokens;
+    uint32_t token_count;
+    char *buffer;
+    size_t buffer_capacity;
+    size_t buffer_length;
+    size_t buffer_position;
+    size_t value_end;
+    char value_end_char;
+    bool eof;
 } sky_importer;
 
 
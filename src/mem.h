@@ -2,6 +2,7 @@
 #define _mem_h
 
 #include <string.h>
+#include <sys/mman.h>
 
 //==============================================================================
 //
@@ -31,6 +32,37 @@
 #endif
 
 
+//--------------------------------------
+// FALLOCATE
+//--------------------------------------
+
+#ifdef __linux
+#define FALLOCATE_AVAILABLE 1
+#else
+#define FALLOCATE_AVAILABLE 0
+#endif
+
+
+//--------------------------------------
+// MADVISE
+//--------------------------------------
+
+// Transparent huge pages can be requested for a mapping.
+#ifdef MADV_HUGEPAGE
+#define HUGEPAGE_AVAILABLE 1
+#else
+#define HUGEPAGE_AVAILABLE 0
+#endif
+
+// The page tables of a mapping can be filled in ahead of time. Otherwise
+// preloading falls back to reading the pages into the page cache.
+#ifdef MADV_POPULATE_READ
+#define POPULATE_AVAILABLE 1
+#else
+#define POPULATE_AVAILABLE 0
+#endif
+
+
 //--------------------------------------
 // Memory writes
 //--------------------------------------
@@ -74,17 +106,16 @@
     SRC += N;\
 } while(0)\
 
-// Reads a bstring from memory.
+// Reads a bstring from memory. The bytes are copied straight into the
+// bstring without an intermediate buffer.
 #define memread_bstr(SRC, DEST, N, MSG) do {\
     if(DEST != NULL) {\
         bdestroy(DEST);\
         DEST = NULL;\
     }\
-    char *str = calloc(1, N+1); check_mem(str);\
-    memread(SRC, str, N, MSG);\
-    DEST = bfromcstr(str);\
-    free(str);\
-    check_mem(DEST);\
+    DEST = blk2bstr(SRC, N);\
+    check(DEST != NULL, "Unable to read " MSG);\
+    SRC += N;\
 } while(0)
     
 
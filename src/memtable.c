@@ -0,0 +1,580 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "memtable.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_memtable_replay(sky_memtable *memtable);
+
+int sky_memtable_reserve(sky_memtable *memtable, size_t sz);
+
+int sky_memtable_reset(sky_memtable *memtable);
+
+int sky_memtable_rewrite(sky_memtable *memtable, void *data, size_t length,
+    uint32_t event_count);
+
+sky_timestamp_t sky_memtable_get_record_timestamp(void *record);
+
+int sky_memtable_compare_records(const void *a, const void *b);
+
+int sky_memtable_compare_object_ids(const void *a, const void *b);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty memtable.
+//
+// Returns a reference to the new memtable if successful. Otherwise returns
+// null.
+sky_memtable *sky_memtable_create()
+{
+    sky_memtable *memtable = calloc(1, sizeof(sky_memtable)); check_mem(memtable);
+    memtable->fd = -1;
+    return memtable;
+
+error:
+    sky_memtable_free(memtable);
+    return NULL;
+}
+
+// Removes a memtable from memory. Buffered events that have not been merged
+// remain in the log.
+//
+// memtable - The memtable to free.
+void sky_memtable_free(sky_memtable *memtable)
+{
+    if(memtable) {
+        sky_memtable_close(memtable);
+        free(memtable);
+    }
+}
+
+
+//--------------------------------------
+// Persistence
+//--------------------------------------
+
+// Opens the write-ahead log and replays the events that are already in it.
+//
+// memtable - The memtable.
+// path     - The path to the log file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_memtable_open(sky_memtable *memtable, bstring path)
+{
+    int rc;
+    check(memtable != NULL, "Memtable required");
+    check(path != NULL, "Log path required");
+    check(memtable->fd == -1, "Memtable is already open");
+
+    memtable->path = bstrcpy(path); check_mem(memtable->path);
+    memtable->fd = open(bdata(memtable->path), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    check(memtable->fd != -1, "Unable to open log: %s", bdata(memtable->path));
+
+    rc = sky_memtable_replay(memtable);
+    check(rc == 0, "Unable to replay log: %s", bdata(memtable->path));
+
+    return 0;
+
+error:
+    sky_memtable_close(memtable);
+    return -1;
+}
+
+// Closes the write-ahead log and releases the buffered events.
+//
+// memtable - The memtable.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_memtable_close(sky_memtable *memtable)
+{
+    check(memtable != NULL, "Memtable required");
+
+    if(memtable->fd != -1) {
+        close(memtable->fd);
+        memtable->fd = -1;
+    }
+    bdestroy(memtable->path);
+    memtable->path = NULL;
+    free(memtable->data);
+    memtable->data = NULL;
+    memtable->length = memtable->capacity = 0;
+    memtable->event_count = 0;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Reads the log into memory. A record that runs past the end of the log was
+// only partially written so it is dropped and the log is truncated to the
+// last complete record.
+//
+// memtable - The memtable.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_memtable_replay(sky_memtable *memtable)
+{
+    int rc;
+    off_t size = lseek(memtable->fd, 0, SEEK_END);
+    check(size != -1, "Unable to determine log size");
+    if(size == 0) {
+        return 0;
+    }
+
+    // Read the whole log. The bytes after the log are zeroed so that the
+    // header of a partial record can be read safely.
+    size_t padding = sizeof(sky_action_id_t) + sizeof(sky_event_data_length_t);
+    rc = sky_memtable_reserve(memtable, (size_t)size + padding);
+    check(rc == 0, "Unable to allocate log buffer");
+    memset(memtable->data + size, 0, padding);
+    ssize_t bytes_read = pread(memtable->fd, memtable->data, (size_t)size, 0);
+    check(bytes_read == (ssize_t)size, "Unable to read log");
+
+    // Count the complete records.
+    void *ptr = memtable->data;
+    void *endptr = memtable->data + size;
+    while(ptr + sizeof(sky_object_id_t) + (SKY_EVENT_HEADER_LENGTH) < endptr) {
+        size_t sz = sizeof(sky_object_id_t) + sky_event_sizeof_raw(ptr + sizeof(sky_object_id_t));
+        if(ptr + sz > endptr) {
+            break;
+        }
+        sky_timestamp_t timestamp = sky_memtable_get_record_timestamp(ptr);
+        if(memtable->event_count == 0 || timestamp > memtable->max_timestamp) {
+            memtable->max_timestamp = timestamp;
+        }
+        ptr += sz;
+        memtable->event_count++;
+    }
+    memtable->length = (ptr - memtable->data);
+
+    // Drop a partial record.
+    if(memtable->length < (size_t)size) {
+        rc = ftruncate(memtable->fd, memtable->length);
+        check(rc == 0, "Unable to truncate partial log record");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Event Management
+//--------------------------------------
+
+// Appends an event to the log and to the buffered events. The log is only
+// synced before returning if the memtable is in sync mode. Otherwise the
+// event is durable once the memtable has been merged.
+//
+// memtable - The memtable.
+// event    - The event to append.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_memtable_append(sky_memtable *memtable, sky_event *event)
+{
+    int rc;
+    size_t sz;
+    check(memtable != NULL, "Memtable required");
+    check(memtable->fd != -1, "Memtable must be open to append an event");
+    check(event != NULL, "Event required");
+    check(event->object_id != 0, "Object id cannot be zero");
+
+    // Pack the record after the buffered events.
+    size_t record_sz = sizeof(sky_object_id_t) + sky_event_sizeof(event);
+    rc = sky_memtable_reserve(memtable, memtable->length + record_sz);
+    check(rc == 0, "Unable to allocate log record");
+    void *ptr = memtable->data + memtable->length;
+    *((sky_object_id_t*)ptr) = event->object_id;
+    rc = sky_event_pack(event, ptr + sizeof(sky_object_id_t), &sz);
+    check(rc == 0, "Unable to pack log record");
+
+    // Write the record to the end of the log.
+    ssize_t bytes_written = pwrite(memtable->fd, ptr, record_sz, memtable->length);
+    check(bytes_written == (ssize_t)record_sz, "Unable to write log record");
+    if(memtable->sync) {
+        rc = fsync(memtable->fd);
+        check(rc == 0, "Unable to sync log");
+    }
+
+    if(memtable->event_count == 0 || event->timestamp > memtable->max_timestamp) {
+        memtable->max_timestamp = event->timestamp;
+    }
+    memtable->length += record_sz;
+    memtable->event_count++;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Adds all buffered events to a data file in order of object id and
+// timestamp. Events with the same object id and timestamp keep the order
+// they were appended in. The events are added in a single data file batch
+// and the log is emptied once the batch has been flushed.
+//
+// memtable  - The memtable.
+// data_file - The data file to merge the events into.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_memtable_merge(sky_memtable *memtable, sky_data_file *data_file)
+{
+    return sky_memtable_merge_before(memtable, data_file, INT64_MAX);
+}
+
+// Adds the buffered events at or before a cutoff timestamp to a data file
+// in order of object id and timestamp. The later events stay buffered and
+// the log is rewritten with only those events once the batch has been
+// flushed. Nothing is merged if every event is after the cutoff.
+//
+// memtable  - The memtable.
+// data_file - The data file to merge the events into.
+// cutoff    - The timestamp of the latest event to merge.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_memtable_merge_before(sky_memtable *memtable,
+                              sky_data_file *data_file,
+                              sky_timestamp_t cutoff)
+{
+    int rc;
+    uint32_t i;
+    size_t sz;
+    bool batching = false;
+    void **records = NULL;
+    void *data = NULL;
+    sky_event *event = NULL;
+    check(memtable != NULL, "Memtable required");
+    check(data_file != NULL, "Data file required");
+
+    if(memtable->event_count == 0) {
+        return 0;
+    }
+
+    // Sort the records that are due.
+    uint32_t record_count = 0;
+    records = malloc(sizeof(*records) * memtable->event_count); check_mem(records);
+    void *ptr = memtable->data;
+    for(i=0; i<memtable->event_count; i++) {
+        if(sky_memtable_get_record_timestamp(ptr) <= cutoff) {
+            records[record_count++] = ptr;
+        }
+        ptr += sizeof(sky_object_id_t) + sky_event_sizeof_raw(ptr + sizeof(sky_object_id_t));
+    }
+    if(record_count == 0) {
+        free(records);
+        return 0;
+    }
+    qsort(records, record_count, sizeof(*records), sky_memtable_compare_records);
+
+    // Add each event to the data file.
+    rc = sky_data_file_begin_batch(data_file);
+    check(rc == 0, "Unable to begin data file batch");
+    batching = true;
+    for(i=0; i<record_count; i++) {
+        event = sky_event_create(*((sky_object_id_t*)records[i]), 0, 0);
+        check_mem(event);
+        rc = sky_event_unpack(event, records[i] + sizeof(sky_object_id_t), &sz);
+        check(rc == 0, "Unable to unpack log record");
+
+        rc = sky_data_file_add_event(data_file, event);
+        check(rc == 0, "Unable to merge event into data file");
+        sky_event_free(event);
+        event = NULL;
+    }
+    batching = false;
+    rc = sky_data_file_end_batch(data_file);
+    check(rc == 0, "Unable to end data file batch");
+
+    // The events are in the data file so the log can be emptied or
+    // rewritten with the events that are held back, in the order they were
+    // appended.
+    if(record_count == memtable->event_count) {
+        rc = sky_memtable_reset(memtable);
+        check(rc == 0, "Unable to reset memtable");
+    }
+    else {
+        data = malloc(memtable->capacity); check_mem(data);
+        size_t length = 0;
+        ptr = memtable->data;
+        for(i=0; i<memtable->event_count; i++) {
+            sz = sizeof(sky_object_id_t) + sky_event_sizeof_raw(ptr + sizeof(sky_object_id_t));
+            if(sky_memtable_get_record_timestamp(ptr) > cutoff) {
+                memcpy(data + length, ptr, sz);
+                length += sz;
+            }
+            ptr += sz;
+        }
+        rc = sky_memtable_rewrite(memtable, data, length, memtable->event_count - record_count);
+        data = NULL;
+        check(rc == 0, "Unable to rewrite memtable");
+    }
+
+    free(records);
+    return 0;
+
+error:
+    if(batching) sky_data_file_end_batch(data_file);
+    sky_event_free(event);
+    free(records);
+    free(data);
+    return -1;
+}
+
+// Syncs the log to disk so that the buffered events are durable without
+// merging them.
+//
+// memtable - The memtable.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_memtable_sync(sky_memtable *memtable)
+{
+    check(memtable != NULL, "Memtable required");
+    check(memtable->fd != -1, "Memtable must be open to sync");
+
+    check(fsync(memtable->fd) == 0, "Unable to sync log");
+    return 0;
+
+error:
+    return -1;
+}
+
+// Retrieves the distinct object ids of the buffered events in ascending
+// order.
+//
+// memtable   - The memtable.
+// object_ids - A pointer to where the object ids should be returned. The
+//              caller must free the array.
+// count      - A pointer to where the number of object ids should be
+//              returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_memtable_get_object_ids(sky_memtable *memtable,
+                                sky_object_id_t **object_ids, uint32_t *count)
+{
+    uint32_t i;
+    check(memtable != NULL, "Memtable required");
+    check(object_ids != NULL, "Object ids return pointer required");
+    check(count != NULL, "Count return pointer required");
+    *object_ids = NULL;
+    *count = 0;
+
+    if(memtable->event_count == 0) {
+        return 0;
+    }
+
+    *object_ids = malloc(sizeof(**object_ids) * memtable->event_count); check_mem(*object_ids);
+    void *ptr = memtable->data;
+    for(i=0; i<memtable->event_count; i++) {
+        (*object_ids)[i] = *((sky_object_id_t*)ptr);
+        ptr += sizeof(sky_object_id_t) + sky_event_sizeof_raw(ptr + sizeof(sky_object_id_t));
+    }
+    qsort(*object_ids, memtable->event_count, sizeof(**object_ids), sky_memtable_compare_object_ids);
+
+    // Remove the duplicates.
+    uint32_t n = 1;
+    for(i=1; i<memtable->event_count; i++) {
+        if((*object_ids)[i] != (*object_ids)[n-1]) {
+            (*object_ids)[n++] = (*object_ids)[i];
+        }
+    }
+    *count = n;
+
+    return 0;
+
+error:
+    if(object_ids) {
+        free(*object_ids);
+        *object_ids = NULL;
+    }
+    return -1;
+}
+
+// Orders log records by object id, then timestamp and then by their
+// position in the log.
+//
+// a - A pointer to the first record pointer.
+// b - A pointer to the second record pointer.
+//
+// Returns -1 if a comes before b and 1 if it comes after.
+int sky_memtable_compare_records(const void *a, const void *b)
+{
+    void *ra = *((void**)a);
+    void *rb = *((void**)b);
+
+    sky_object_id_t object_id_a = *((sky_object_id_t*)ra);
+    sky_object_id_t object_id_b = *((sky_object_id_t*)rb);
+    if(object_id_a != object_id_b) {
+        return (object_id_a < object_id_b ? -1 : 1);
+    }
+
+    sky_timestamp_t timestamp_a = sky_memtable_get_record_timestamp(ra);
+    sky_timestamp_t timestamp_b = sky_memtable_get_record_timestamp(rb);
+    if(timestamp_a != timestamp_b) {
+        return (timestamp_a < timestamp_b ? -1 : 1);
+    }
+
+    return (ra < rb ? -1 : (ra > rb ? 1 : 0));
+}
+
+
+//--------------------------------------
+// Buffer Management
+//--------------------------------------
+
+// Grows the buffer so that it can hold a given number of bytes.
+//
+// memtable - The memtable.
+// sz       - The number of bytes the buffer must hold.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_memtable_reserve(sky_memtable *memtable, size_t sz)
+{
+    if(sz <= memtable->capacity) {
+        return 0;
+    }
+
+    size_t capacity = (memtable->capacity > 0 ? memtable->capacity : SKY_MEMTABLE_INITIAL_CAPACITY);
+    while(capacity < sz) {
+        capacity *= 2;
+    }
+
+    void *data = realloc(memtable->data, capacity); check_mem(data);
+    memtable->data = data;
+    memtable->capacity = capacity;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Empties the buffer and the log. The buffer memory is kept for reuse.
+//
+// memtable - The memtable.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_memtable_reset(sky_memtable *memtable)
+{
+    int rc = ftruncate(memtable->fd, 0);
+    check(rc == 0, "Unable to truncate log");
+
+    memtable->length = 0;
+    memtable->event_count = 0;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Replaces the buffered events and the log. The new log is written next to
+// the old one and renamed over it so that a failure leaves one of the two
+// logs intact.
+//
+// memtable    - The memtable.
+// data        - The records to keep, which the memtable takes ownership of.
+//               The buffer must be as large as the memtable's capacity.
+// length      - The number of bytes of records.
+// event_count - The number of records.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_memtable_rewrite(sky_memtable *memtable, void *data, size_t length,
+                         uint32_t event_count)
+{
+    int rc;
+    int fd = -1;
+    bstring tmp_path = NULL;
+
+    tmp_path = bformat("%s.tmp", bdata(memtable->path)); check_mem(tmp_path);
+    fd = open(bdata(tmp_path), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    check(fd != -1, "Unable to open log: %s", bdata(tmp_path));
+    ssize_t bytes_written = pwrite(fd, data, length, 0);
+    check(bytes_written == (ssize_t)length, "Unable to write log");
+    if(memtable->sync) {
+        rc = fsync(fd);
+        check(rc == 0, "Unable to sync log");
+    }
+    rc = rename(bdata(tmp_path), bdata(memtable->path));
+    check(rc == 0, "Unable to replace log: %s", bdata(memtable->path));
+
+    close(memtable->fd);
+    memtable->fd = fd;
+    free(memtable->data);
+    memtable->data = data;
+    memtable->length = length;
+    memtable->event_count = event_count;
+
+    bdestroy(tmp_path);
+    return 0;
+
+error:
+    if(fd != -1) close(fd);
+    if(tmp_path != NULL) unlink(bdata(tmp_path));
+    bdestroy(tmp_path);
+    free(data);
+    return -1;
+}
+
+// Reads the timestamp of a log record.
+//
+// record - A pointer to the record.
+//
+// Returns the timestamp of the record's event.
+sky_timestamp_t sky_memtable_get_record_timestamp(void *record)
+{
+    return *((sky_timestamp_t*)(record + sizeof(sky_object_id_t) + sizeof(sky_event_flag_t)));
+}
+
+// Compares two object ids.
+//
+// a - A pointer to the first object id.
+// b - A pointer to the second object id.
+//
+// Returns -1 if a comes before b, 1 if it comes after and 0 if they are the
+// same.
+int sky_memtable_compare_object_ids(const void *a, const void *b)
+{
+    sky_object_id_t object_id_a = *((sky_object_id_t*)a);
+    sky_object_id_t object_id_b = *((sky_object_id_t*)b);
+    return (object_id_a < object_id_b ? -1 : (object_id_a > object_id_b ? 1 : 0));
+}
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+// Calculates the heap memory used by the buffered events of a memtable.
+//
+// memtable - The memtable.
+//
+// Returns the number of bytes.
+size_t sky_memtable_get_memory_usage(sky_memtable *memtable)
+{
+    if(memtable == NULL) {
+        return 0;
+    }
+    return sizeof(*memtable) + memtable->capacity;
+}
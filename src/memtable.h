@@ -0,0 +1,127 @@
+#ifndef _memtable_h
+#define _memtable_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct sky_memtable sky_memtable;
+
+#include "bstring.h"
+#include "types.h"
+#include "event.h"
+#include "data_file.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The memtable is an append-only write buffer that sits in front of a
+// table's data file. Inserting an event into the middle of a block moves
+// the rest of the block and can split it, so out-of-order writes are slow.
+// Events that go to the memtable are only appended to a write-ahead log on
+// disk and to an in-memory copy of the log, and can be acknowledged right
+// away.
+//
+// The buffered events are merged into the data file in batches. A merge
+// sorts the events by object id and timestamp and adds them to the data
+// file in a single data file batch so each block is synced once. The log
+// is truncated once the merge has been flushed.
+//
+// A merge can also hold back the most recent events so that events which
+// arrive late are still merged in order. Only the events at or before a
+// cutoff timestamp are merged and the rest stay buffered. The log is then
+// rewritten with the remaining events. Callers use the latest timestamp in
+// the memtable less a reorder window as the cutoff, so an event that is late
+// by less than the window is sorted in with its neighbours and is appended
+// to the end of its path instead of being inserted into the middle.
+//
+// Each log record is the object id of the event followed by the raw event.
+// When a memtable is opened, the records in an existing log are replayed
+// into memory. A partially written record at the end of the log is dropped.
+//
+// The memtable belongs to its table and has no locking. Readers see the
+// buffered events by merging the memtable before they read the data file.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The name of the write-ahead log file in the table directory.
+#define SKY_MEMTABLE_LOG_NAME "wal"
+
+// The number of bytes allocated for the first record.
+#define SKY_MEMTABLE_INITIAL_CAPACITY 4096
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+struct sky_memtable {
+    bstring path;
+    int fd;
+    bool sync;
+    void *data;
+    size_t length;
+    size_t capacity;
+    uint32_t event_count;
+    sky_timestamp_t max_timestamp;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_memtable *sky_memtable_create();
+
+void sky_memtable_free(sky_memtable *memtable);
+
+
+//--------------------------------------
+// Persistence
+//--------------------------------------
+
+int sky_memtable_open(sky_memtable *memtable, bstring path);
+
+int sky_memtable_close(sky_memtable *memtable);
+
+
+//--------------------------------------
+// Event Management
+//--------------------------------------
+
+int sky_memtable_append(sky_memtable *memtable, sky_event *event);
+
+int sky_memtable_merge(sky_memtable *memtable, sky_data_file *data_file);
+
+int sky_memtable_merge_before(sky_memtable *memtable,
+    sky_data_file *data_file, sky_timestamp_t cutoff);
+
+int sky_memtable_sync(sky_memtable *memtable);
+
+int sky_memtable_get_object_ids(sky_memtable *memtable,
+    sky_object_id_t **object_ids, uint32_t *count);
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+size_t sky_memtable_get_memory_usage(sky_memtable *memtable);
+
+#endif
@@ -17,6 +17,17 @@
 
 #define SKY_MESSAGE_HEADER_ITEM_COUNT 5
 
+// The number of header items when a request id is included.
+#define SKY_MESSAGE_HEADER_PIPELINED_ITEM_COUNT 6
+
+// The message names indexed by message type.
+const char *sky_message_type_names[SKY_MESSAGE_TYPE_COUNT] = {
+    "unknown", "eadd", "ebulk", "eget", "next_action", "query", "aadd",
+    "aget", "aall", "padd", "pget", "pall", "compact", "multi", "stats",
+    "replicate", "funnel", "dag", "cancel", "emget",
+    "subscribe", "tail", "snapshot",
+};
+
 
 //==============================================================================
 //
@@ -73,7 +84,7 @@ void sky_message_header_free(sky_message_header *header)
 size_t sky_message_header_sizeof(sky_message_header *header)
 {
     size_t sz = 0;
-    sz += minipack_sizeof_array(SKY_MESSAGE_HEADER_ITEM_COUNT);
+    sz += minipack_sizeof_array(header->pipelined ? SKY_MESSAGE_HEADER_PIPELINED_ITEM_COUNT : SKY_MESSAGE_HEADER_ITEM_COUNT);
     sz += minipack_sizeof_uint(header->version);
     sz += minipack_sizeof_raw(blength(header->name));
     sz += blength(header->name);
@@ -81,7 +92,10 @@ size_t sky_message_header_sizeof(sky_message_header *header)
     sz += minipack_sizeof_raw(blength(header->database_name));
     sz += blength(header->database_name);
     sz += minipack_sizeof_raw(blength(header->table_name));
-    sz += blength(header->database_name);
+    sz += blength(header->table_name);
+    if(header->pipelined) {
+        sz += minipack_sizeof_uint(header->request_id);
+    }
     return sz;
 }
 
@@ -99,7 +113,7 @@ int sky_message_header_pack(sky_message_header *header, FILE *file)
     check(file != NULL, "File stream required");
 
     // Item count
-    minipack_fwrite_array(file, SKY_MESSAGE_HEADER_ITEM_COUNT, &sz);
+    minipack_fwrite_array(file, (header->pipelined ? SKY_MESSAGE_HEADER_PIPELINED_ITEM_COUNT : SKY_MESSAGE_HEADER_ITEM_COUNT), &sz);
     check(sz != 0, "Unable to pack item count");
 
     // Version
@@ -122,6 +136,12 @@ int sky_message_header_pack(sky_message_header *header, FILE *file)
     rc = sky_minipack_fwrite_bstring(file, header->table_name);
     check(rc == 0, "Unable to pack table name");
 
+    // Request id
+    if(header->pipelined) {
+        minipack_fwrite_uint(file, header->request_id, &sz);
+        check(sz != 0, "Unable to pack request id");
+    }
+
     return 0;
 
 error:
@@ -144,7 +164,7 @@ int sky_message_header_unpack(sky_message_header *header, FILE *file)
     // Item Count
     uint32_t count = minipack_fread_array(file, &sz);
     check(sz != 0, "Unable to unpack version");
-    check(count == SKY_MESSAGE_HEADER_ITEM_COUNT, "Invalid header item count: %d; expected: %d", count, SKY_MESSAGE_HEADER_ITEM_COUNT);
+    check(count == SKY_MESSAGE_HEADER_ITEM_COUNT || count == SKY_MESSAGE_HEADER_PIPELINED_ITEM_COUNT, "Invalid header item count: %d; expected: %d", count, SKY_MESSAGE_HEADER_ITEM_COUNT);
 
     // Version
     header->version = minipack_fread_uint(file, &sz);
@@ -153,6 +173,7 @@ int sky_message_header_unpack(sky_message_header *header, FILE *file)
     // Message name
     rc = sky_minipack_fread_bstring(file, &header->name);
     check(rc == 0, "Unable to pack name");
+    header->type = sky_message_type_from_name(header->name);
 
     // Length
     header->length = minipack_fread_uint(file, &sz);
@@ -166,6 +187,13 @@ int sky_message_header_unpack(sky_message_header *header, FILE *file)
     rc = sky_minipack_fread_bstring(file, &header->table_name);
     check(rc == 0, "Unable to pack table name");
 
+    // Request id
+    header->pipelined = (count == SKY_MESSAGE_HEADER_PIPELINED_ITEM_COUNT);
+    if(header->pipelined) {
+        header->request_id = minipack_fread_uint(file, &sz);
+        check(sz != 0, "Unable to unpack request id");
+    }
+
     debug("MHDR[recv]: v%lld / %s / len:%lld / db:%s / tbl:%s", header->version, bdata(header->name), header->length, bdata(header->database_name), bdata(header->table_name));
 
     return 0;
@@ -173,3 +201,39 @@ int sky_message_header_unpack(sky_message_header *header, FILE *file)
 error:
     return -1;
 }
+
+
+//--------------------------------------
+// Message Types
+//--------------------------------------
+
+// Resolves a message name to its message type.
+//
+// name - The message name.
+//
+// Returns the message type or SKY_MESSAGE_TYPE_UNKNOWN if the name is not a
+// known message.
+sky_message_type_e sky_message_type_from_name(bstring name)
+{
+    uint32_t i;
+    for(i=SKY_MESSAGE_TYPE_UNKNOWN+1; i<SKY_MESSAGE_TYPE_COUNT; i++) {
+        if(biseqcstr(name, sky_message_type_names[i]) == 1) {
+            return (sky_message_type_e)i;
+        }
+    }
+
+    return SKY_MESSAGE_TYPE_UNKNOWN;
+}
+
+// Retrieves the name of a message type.
+//
+// type - The message type.
+//
+// Returns the message name or "unknown" for an unknown message type.
+const char *sky_message_type_get_name(sky_message_type_e type)
+{
+    if(type <= SKY_MESSAGE_TYPE_UNKNOWN || type >= SKY_MESSAGE_TYPE_COUNT) {
+        return sky_message_type_names[SKY_MESSAGE_TYPE_UNKNOWN];
+    }
+    return sky_message_type_names[type];
+}
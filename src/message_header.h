@@ -3,24 +3,80 @@
 
 #include <stdio.h>
 #include <inttypes.h>
+#include <stdbool.h>
 
 #include "bstring.h"
 #include "types.h"
 
 
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// Every message starts with a header array of the protocol version, the
+// message name, the body length, the database name and the table name.
+//
+// A client can add a request id as a sixth item to pipeline the message.
+// Pipelined messages must set the length to the number of bytes in the body
+// so that the server can read the body before the message is processed and
+// continue reading further messages from the connection. The response to a
+// pipelined message is written as a two item array of the request id and
+// the usual response as soon as the message has been processed, so responses
+// to messages for different tables can arrive in a different order than the
+// messages were sent.
+//
+// The message name is resolved to a message type when the header is read so
+// that the server can dispatch the message without comparing the name again.
+
+
 //==============================================================================
 //
 // Typedefs
 //
 //==============================================================================
 
+// The types of messages that the server can process.
+typedef enum sky_message_type_e {
+    SKY_MESSAGE_TYPE_UNKNOWN,
+    SKY_MESSAGE_TYPE_EADD,
+    SKY_MESSAGE_TYPE_EBULK,
+    SKY_MESSAGE_TYPE_EGET,
+    SKY_MESSAGE_TYPE_NEXT_ACTION,
+    SKY_MESSAGE_TYPE_QUERY,
+    SKY_MESSAGE_TYPE_AADD,
+    SKY_MESSAGE_TYPE_AGET,
+    SKY_MESSAGE_TYPE_AALL,
+    SKY_MESSAGE_TYPE_PADD,
+    SKY_MESSAGE_TYPE_PGET,
+    SKY_MESSAGE_TYPE_PALL,
+    SKY_MESSAGE_TYPE_COMPACT,
+    SKY_MESSAGE_TYPE_MULTI,
+    SKY_MESSAGE_TYPE_STATS,
+    SKY_MESSAGE_TYPE_REPLICATE,
+    SKY_MESSAGE_TYPE_FUNNEL,
+    SKY_MESSAGE_TYPE_DAG,
+    SKY_MESSAGE_TYPE_CANCEL,
+    SKY_MESSAGE_TYPE_EMGET,
+    SKY_MESSAGE_TYPE_SUBSCRIBE,
+    SKY_MESSAGE_TYPE_TAIL,
+    SKY_MESSAGE_TYPE_SNAPSHOT,
+} sky_message_type_e;
+
+// The number of message types including the unknown type.
+#define SKY_MESSAGE_TYPE_COUNT (SKY_MESSAGE_TYPE_SNAPSHOT + 1)
+
 // The header info for a message.
 typedef struct {
     uint64_t version;
     bstring name;
+    sky_message_type_e type;
     uint64_t length;
     bstring database_name;
     bstring table_name;
+    bool pipelined;
+    uint64_t request_id;
 } sky_message_header;
 
 
@@ -46,4 +102,12 @@ int sky_message_header_pack(sky_message_header *header, FILE *file);
 
 int sky_message_header_unpack(sky_message_header *header, FILE *file);
 
+//--------------------------------------
+// Message Types
+//--------------------------------------
+
+sky_message_type_e sky_message_type_from_name(bstring name);
+
+const char *sky_message_type_get_name(sky_message_type_e type);
+
 #endif
@@ -0,0 +1,579 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "migration.h"
+#include "compression.h"
+#include "memtable.h"
+#include "event.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_migration_read_block(sky_data_file *source, uint32_t index, int *fd,
+    uint32_t *fd_extent_index, void *raw, void *data, void **ret);
+
+int sky_migration_migrate_block(sky_data_file *target, void *data,
+    sky_block **block, size_t *offset, bool *spanned);
+
+int sky_migration_migrate_path(sky_data_file *target,
+    sky_object_id_t object_id, void *events, uint32_t event_data_length,
+    sky_block **block, size_t *offset, bool *spanned);
+
+int sky_migration_finish_block(sky_block *block);
+
+int sky_migration_next_block(sky_data_file *target, sky_block **block,
+    size_t *offset, bool *spanned);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Detection
+//--------------------------------------
+
+// Determines if a data file was written by a format version that stores
+// legacy object ids. A data file without a header has nothing to migrate.
+//
+// header_path - The path to the header file of the data file.
+// ret         - A pointer to where the flag is returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_migration_is_required(bstring header_path, bool *ret)
+{
+    int rc;
+    uint32_t version = 0;
+    FILE *file = NULL;
+    check(header_path != NULL, "Header path required");
+    check(ret != NULL, "Return address required");
+    *ret = false;
+
+    if(!sky_file_exists(header_path)) {
+        return 0;
+    }
+
+    file = fopen(bdata(header_path), "r");
+    check(file != NULL, "Unable to open header file: %s", bdata(header_path));
+    rc = fread(&version, sizeof(version), 1, file);
+    check(rc == 1, "Unable to read data file version: %s", bdata(header_path));
+    fclose(file);
+
+    *ret = (version < SKY_DATA_FILE_WIDE_OBJECT_ID_VERSION);
+    return 0;
+
+error:
+    if(file) fclose(file);
+    return -1;
+}
+
+
+//--------------------------------------
+// Tables
+//--------------------------------------
+
+// Migrates the data file and write-ahead log of a table to the current data
+// file format. Nothing is changed if the table is already up to date. A
+// converted log that was left behind by an interrupted migration is moved
+// into place.
+//
+// path - The path to the table directory.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_migration_migrate_table(bstring path)
+{
+    int rc;
+    bool required;
+    bstring data_path = NULL;
+    bstring header_path = NULL;
+    bstring log_path = NULL;
+    bstring log_target_path = NULL;
+    check(path != NULL, "Table path required");
+
+    data_path = bformat("%s/0/data", bdata(path)); check_mem(data_path);
+    header_path = bformat("%s/0/header", bdata(path)); check_mem(header_path);
+    log_path = bformat("%s/%s", bdata(path), SKY_MEMTABLE_LOG_NAME); check_mem(log_path);
+    log_target_path = bformat("%s.%s", bdata(log_path), SKY_MIGRATION_SUFFIX); check_mem(log_target_path);
+
+    rc = sky_migration_is_required(header_path, &required);
+    check(rc == 0, "Unable to determine data file version: %s", bdata(header_path));
+
+    // Convert the log first so that it is ready to move into place as soon
+    // as the data file has been replaced.
+    if(required) {
+        if(sky_file_exists(log_path)) {
+            rc = sky_migration_migrate_log(log_path, log_target_path);
+            check(rc == 0, "Unable to migrate log: %s", bdata(log_path));
+        }
+        rc = sky_migration_migrate_data_file(data_path, header_path);
+        check(rc == 0, "Unable to migrate data file: %s", bdata(data_path));
+    }
+
+    if(sky_file_exists(log_target_path)) {
+        rc = rename(bdata(log_target_path), bdata(log_path));
+        check(rc == 0, "Unable to replace log: %s", bdata(log_path));
+    }
+
+    bdestroy(data_path);
+    bdestroy(header_path);
+    bdestroy(log_path);
+    bdestroy(log_target_path);
+    return 0;
+
+error:
+    bdestroy(data_path);
+    bdestroy(header_path);
+    bdestroy(log_path);
+    bdestroy(log_target_path);
+    return -1;
+}
+
+
+//--------------------------------------
+// Data Files
+//--------------------------------------
+
+// Rewrites a legacy data file with 64-bit object ids. The legacy blocks are
+// read one at a time in the order of their index and the paths of each
+// block are written to the new data file starting at a new block so that
+// spans keep their order.
+//
+// path        - The path to the first extent of the data file.
+// header_path - The path to the header file of the data file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_migration_migrate_data_file(bstring path, bstring header_path)
+{
+    int rc;
+    uint32_t i;
+    int fd = -1;
+    uint32_t fd_extent_index = 0;
+    bool batching = false;
+    void *raw = NULL;
+    void *data = NULL;
+    FILE *file = NULL;
+    sky_data_file *source = NULL;
+    sky_data_file *target = NULL;
+    check(path != NULL, "Data file path required");
+    check(header_path != NULL, "Header path required");
+
+    source = sky_data_file_create(); check_mem(source);
+    source->path = bstrcpy(path); check_mem(source->path);
+    source->header_path = bstrcpy(header_path); check_mem(source->header_path);
+
+    // Read the version and block size. The block header entries are not
+    // needed since the ranges are rebuilt from the paths.
+    off_t header_length = sky_file_get_size(header_path);
+    check(header_length >= 0, "Unable to determine header file size: %s", bdata(header_path));
+    check((size_t)header_length >= SKY_HEADER_FILE_HDR_SIZE, "Header file is truncated: %s", bdata(header_path));
+    file = fopen(bdata(header_path), "r");
+    check(file != NULL, "Unable to open header file: %s", bdata(header_path));
+    rc = fread(&source->version, sizeof(source->version), 1, file);
+    check(rc == 1, "Unable to read data file version");
+    rc = fread(&source->block_size, sizeof(source->block_size), 1, file);
+    check(rc == 1, "Unable to read block size");
+    fclose(file);
+    file = NULL;
+    check(source->version < SKY_DATA_FILE_WIDE_OBJECT_ID_VERSION, "Data file does not need to be migrated: %s", bdata(path));
+    check(source->block_size > SKY_PATH_HEADER_LENGTH, "Invalid block size: %d", source->block_size);
+    uint32_t block_count = (header_length - ((off_t)SKY_HEADER_FILE_HDR_SIZE)) / ((off_t)SKY_MIGRATION_LEGACY_BLOCK_HEADER_SIZE);
+
+    // Create the new data file and remove anything that was left over from
+    // an interrupted migration.
+    target = sky_data_file_create(); check_mem(target);
+    target->block_size = source->block_size;
+    target->path = bformat("%s.%s", bdata(path), SKY_MIGRATION_SUFFIX);
+    check_mem(target->path);
+    target->header_path = bformat("%s.%s", bdata(header_path), SKY_MIGRATION_SUFFIX);
+    check_mem(target->header_path);
+    rc = sky_data_file_remove_files(target);
+    check(rc == 0, "Unable to remove old migration files");
+    rc = sky_data_file_load(target);
+    check(rc == 0, "Unable to load migrated data file");
+
+    // Rewrite each block.
+    raw = malloc(source->block_size); check_mem(raw);
+    data = malloc(source->block_size); check_mem(data);
+    rc = sky_data_file_begin_batch(target);
+    check(rc == 0, "Unable to begin batch");
+    batching = true;
+    sky_block *block = target->blocks[0];
+    size_t offset = 0;
+    bool spanned = false;
+    for(i=0; i<block_count; i++) {
+        void *ptr = NULL;
+        rc = sky_migration_read_block(source, i, &fd, &fd_extent_index, raw, data, &ptr);
+        check(rc == 0, "Unable to read legacy block #%d", i);
+        rc = sky_migration_migrate_block(target, ptr, &block, &offset, &spanned);
+        check(rc == 0, "Unable to migrate legacy block #%d", i);
+    }
+    if(fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+    rc = sky_migration_finish_block(block);
+    check(rc == 0, "Unable to finish migrated block");
+    batching = false;
+    rc = sky_data_file_end_batch(target);
+    check(rc == 0, "Unable to flush migrated data file");
+    uint32_t extent_count = target->extent_count;
+    sky_data_file_unload(target);
+
+    // Replace the legacy files with the migrated files.
+    rc = sky_data_file_replace_files(source, target, extent_count);
+    check(rc == 0, "Unable to replace legacy data file");
+
+    free(raw);
+    free(data);
+    sky_data_file_free(source);
+    sky_data_file_free(target);
+    return 0;
+
+error:
+    if(batching) sky_data_file_end_batch(target);
+    if(fd != -1) close(fd);
+    if(file) fclose(file);
+    free(raw);
+    free(data);
+    sky_data_file_free(source);
+    sky_data_file_free(target);
+    return -1;
+}
+
+// Reads a legacy block from its extent. Compressed blocks are decompressed
+// into the data buffer. The extent that was read last is kept open so that
+// consecutive blocks only open each extent once.
+//
+// source          - The legacy data file.
+// index           - The index of the block.
+// fd              - A pointer to the open extent file descriptor.
+// fd_extent_index - A pointer to the index of the open extent.
+// raw             - A buffer of a block size to read the block into.
+// data            - A buffer of a block size to decompress into.
+// ret             - A pointer to where the uncompressed block data is
+//                   returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_migration_read_block(sky_data_file *source, uint32_t index, int *fd,
+                             uint32_t *fd_extent_index, void *raw, void *data,
+                             void **ret)
+{
+    int rc;
+    bstring extent_path = NULL;
+    size_t block_size = source->block_size;
+
+    // Open the extent that holds the block.
+    uint32_t extent_index = index / SKY_DEFAULT_EXTENT_BLOCK_COUNT;
+    if(*fd == -1 || *fd_extent_index != extent_index) {
+        if(*fd != -1) close(*fd);
+        extent_path = sky_data_file_get_extent_path(source, extent_index);
+        check_mem(extent_path);
+        *fd = open(bdata(extent_path), O_RDONLY);
+        check(*fd != -1, "Unable to open extent: %s", bdata(extent_path));
+        *fd_extent_index = extent_index;
+        bdestroy(extent_path);
+        extent_path = NULL;
+    }
+
+    // Extents can end before the last block when its tail was never written
+    // so the rest of the buffer is cleared.
+    off_t offset = ((off_t)(index % SKY_DEFAULT_EXTENT_BLOCK_COUNT)) * block_size;
+    ssize_t bytes_read = pread(*fd, raw, block_size, offset);
+    check(bytes_read >= 0, "Unable to read block");
+    memset(raw + bytes_read, 0, block_size - bytes_read);
+
+    // Decompress the block if it starts with the compressed block marker.
+    bool compressed = (*((sky_legacy_object_id_t*)raw) == 0 &&
+        *((uint32_t*)(raw + sizeof(sky_legacy_object_id_t))) == SKY_BLOCK_COMPRESSED_MAGIC);
+    if(compressed) {
+        uint32_t data_length = *((uint32_t*)(raw + sizeof(sky_legacy_object_id_t) + sizeof(uint32_t)));
+        uint32_t compressed_length = *((uint32_t*)(raw + sizeof(sky_legacy_object_id_t) + (sizeof(uint32_t) * 2)));
+        check(data_length <= block_size, "Invalid compressed block data length: %d", data_length);
+        check(SKY_MIGRATION_LEGACY_COMPRESSED_HEADER_SIZE + compressed_length <= block_size, "Invalid compressed block length: %d", compressed_length);
+        rc = sky_compression_decompress(raw + SKY_MIGRATION_LEGACY_COMPRESSED_HEADER_SIZE, compressed_length, data, data_length);
+        check(rc == 0, "Unable to decompress block data");
+        memset(data + data_length, 0, block_size - data_length);
+        *ret = data;
+    }
+    else {
+        *ret = raw;
+    }
+
+    return 0;
+
+error:
+    bdestroy(extent_path);
+    *ret = NULL;
+    return -1;
+}
+
+// Rewrites the paths of a legacy block into the migrated data file. The
+// paths start in a new block unless nothing has been written yet.
+//
+// target  - The migrated data file.
+// data    - The uncompressed data of the legacy block.
+// block   - A pointer to the block being filled. This is updated when a new
+//           block is started.
+// offset  - A pointer to the number of bytes used in the block being filled.
+// spanned - A pointer to a flag stating if the block being filled holds
+//           part of a split path.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_migration_migrate_block(sky_data_file *target, void *data,
+                                sky_block **block, size_t *offset,
+                                bool *spanned)
+{
+    int rc;
+    void *ptr = data;
+    void *endptr = data + target->block_size;
+
+    while(ptr + SKY_MIGRATION_LEGACY_PATH_HEADER_LENGTH <= endptr) {
+        // A zero object id marks the end of the block data.
+        sky_object_id_t object_id = *((sky_legacy_object_id_t*)ptr);
+        if(object_id == 0) {
+            break;
+        }
+        uint32_t event_data_length = *((sky_path_event_data_length_t*)(ptr + sizeof(sky_legacy_object_id_t)));
+        void *events = ptr + SKY_MIGRATION_LEGACY_PATH_HEADER_LENGTH;
+        check(events + event_data_length <= endptr, "Legacy path overruns its block: %llu", (unsigned long long)object_id);
+
+        // Separate legacy blocks so that spans keep their boundaries.
+        if(ptr == data && *offset > 0) {
+            rc = sky_migration_next_block(target, block, offset, spanned);
+            check(rc == 0, "Unable to start migrated block");
+        }
+
+        rc = sky_migration_migrate_path(target, object_id, events, event_data_length, block, offset, spanned);
+        check(rc == 0, "Unable to migrate path: %llu", (unsigned long long)object_id);
+
+        ptr = events + event_data_length;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes a path to the migrated data file with a 64-bit object id. A path
+// that does not fit in the rest of the block is moved to a new block and a
+// path that does not fit in a block on its own is split at event boundaries
+// into a span. The first event of each new segment is rewritten with its
+// full timestamp.
+//
+// target            - The migrated data file.
+// object_id         - The object id of the path.
+// events            - A pointer to the raw events of the path.
+// event_data_length - The number of bytes of raw events.
+// block             - A pointer to the block being filled.
+// offset            - A pointer to the number of bytes used in the block.
+// spanned           - A pointer to the span flag of the block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_migration_migrate_path(sky_data_file *target,
+                               sky_object_id_t object_id, void *events,
+                               uint32_t event_data_length, sky_block **block,
+                               size_t *offset, bool *spanned)
+{
+    int rc;
+    size_t sz;
+    void *block_ptr = NULL;
+    size_t block_size = target->block_size;
+
+    // Start a new block if the path does not fit or if the current block is
+    // part of a span.
+    size_t path_length = SKY_PATH_HEADER_LENGTH + event_data_length;
+    if(*offset > 0 && (*offset + path_length > block_size || *spanned)) {
+        rc = sky_migration_next_block(target, block, offset, spanned);
+        check(rc == 0, "Unable to start migrated block");
+    }
+
+    // Copy the path as is if it fits.
+    if(*offset + path_length <= block_size) {
+        rc = sky_block_get_ptr(*block, &block_ptr);
+        check(rc == 0, "Unable to retrieve migrated block pointer");
+        rc = sky_path_pack_hdr(object_id, event_data_length, block_ptr + *offset, &sz);
+        check(rc == 0, "Unable to pack path header");
+        memcpy(block_ptr + *offset + sz, events, event_data_length);
+        *offset += sz + event_data_length;
+        return 0;
+    }
+
+    // Otherwise split the path into segments that each fill a block.
+    *spanned = true;
+    sky_timestamp_t timestamp = 0;
+    uint32_t segment_length = 0;
+    void *ptr = events;
+    void *endptr = events + event_data_length;
+    while(ptr < endptr) {
+        timestamp = sky_event_get_timestamp(ptr, timestamp);
+        size_t event_length = sky_event_sizeof_raw(ptr);
+        size_t rebased_length = event_length - sky_event_timestamp_length(*((sky_event_flag_t*)ptr)) + sizeof(sky_timestamp_t);
+
+        // Close the segment and start a new block when the event does not fit.
+        if(segment_length > 0 && *offset + SKY_PATH_HEADER_LENGTH + segment_length + event_length > block_size) {
+            rc = sky_block_get_ptr(*block, &block_ptr);
+            check(rc == 0, "Unable to retrieve migrated block pointer");
+            rc = sky_path_pack_hdr(object_id, segment_length, block_ptr + *offset, &sz);
+            check(rc == 0, "Unable to pack path header");
+            *offset += sz + segment_length;
+            segment_length = 0;
+
+            rc = sky_migration_next_block(target, block, offset, spanned);
+            check(rc == 0, "Unable to start migrated block");
+            *spanned = true;
+        }
+        size_t length = (segment_length == 0 ? rebased_length : event_length);
+        check(*offset + SKY_PATH_HEADER_LENGTH + segment_length + length <= block_size, "Event does not fit in a block: %llu", (unsigned long long)object_id);
+
+        // The first event of a segment always has its full timestamp.
+        rc = sky_block_get_ptr(*block, &block_ptr);
+        check(rc == 0, "Unable to retrieve migrated block pointer");
+        void *dest = block_ptr + *offset + SKY_PATH_HEADER_LENGTH + segment_length;
+        if(segment_length == 0) {
+            rc = sky_event_pack_raw(ptr, timestamp, dest, &sz);
+            check(rc == 0, "Unable to pack rebased event");
+        }
+        else {
+            memcpy(dest, ptr, event_length);
+        }
+        segment_length += length;
+        ptr += event_length;
+    }
+
+    rc = sky_block_get_ptr(*block, &block_ptr);
+    check(rc == 0, "Unable to retrieve migrated block pointer");
+    rc = sky_path_pack_hdr(object_id, segment_length, block_ptr + *offset, &sz);
+    check(rc == 0, "Unable to pack path header");
+    *offset += sz + segment_length;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Saves a filled block and updates its ranges.
+//
+// block - The block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_migration_finish_block(sky_block *block)
+{
+    int rc;
+    rc = sky_block_save(block);
+    check(rc == 0, "Unable to save migrated block");
+    rc = sky_block_full_update(block);
+    check(rc == 0, "Unable to update migrated block");
+    return 0;
+
+error:
+    return -1;
+}
+
+// Finishes the block being filled and starts an empty one.
+//
+// target  - The migrated data file.
+// block   - A pointer to the block being filled.
+// offset  - A pointer to the number of bytes used in the block.
+// spanned - A pointer to the span flag of the block.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_migration_next_block(sky_data_file *target, sky_block **block,
+                             size_t *offset, bool *spanned)
+{
+    int rc;
+    rc = sky_migration_finish_block(*block);
+    check(rc == 0, "Unable to finish migrated block");
+    rc = sky_data_file_create_block(target, block);
+    check(rc == 0, "Unable to create migrated block");
+    *offset = 0;
+    *spanned = false;
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Logs
+//--------------------------------------
+
+// Rewrites a legacy write-ahead log with 64-bit object ids. Each record is a
+// legacy object id followed by a raw event. A partially written record at
+// the end of the log is dropped, the same way a memtable drops it on replay.
+// The log is bounded by the memtable size so it is read in one piece.
+//
+// path        - The path to the legacy log.
+// target_path - The path to write the migrated log to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_migration_migrate_log(bstring path, bstring target_path)
+{
+    int rc;
+    void *buffer = NULL;
+    FILE *file = NULL;
+    check(path != NULL, "Log path required");
+    check(target_path != NULL, "Target log path required");
+
+    // Read the log. The bytes after the log are zeroed so that the header of
+    // a partial record can be read safely.
+    off_t size = sky_file_get_size(path);
+    check(size >= 0, "Unable to determine log size: %s", bdata(path));
+    size_t padding = SKY_EVENT_HEADER_LENGTH + sizeof(sky_action_id_t) + sizeof(sky_event_data_length_t);
+    buffer = calloc(1, (size_t)size + padding); check_mem(buffer);
+    file = fopen(bdata(path), "r");
+    check(file != NULL, "Unable to open log: %s", bdata(path));
+    if(size > 0) {
+        rc = fread(buffer, (size_t)size, 1, file);
+        check(rc == 1, "Unable to read log: %s", bdata(path));
+    }
+    fclose(file);
+    file = NULL;
+
+    // Write each complete record with a wider object id.
+    file = fopen(bdata(target_path), "w");
+    check(file != NULL, "Unable to open migrated log: %s", bdata(target_path));
+    void *ptr = buffer;
+    void *endptr = buffer + size;
+    while(ptr + sizeof(sky_legacy_object_id_t) + (SKY_EVENT_HEADER_LENGTH) < endptr) {
+        void *event_ptr = ptr + sizeof(sky_legacy_object_id_t);
+        size_t event_length = sky_event_sizeof_raw(event_ptr);
+        if(event_ptr + event_length > endptr) {
+            break;
+        }
+
+        sky_object_id_t object_id = *((sky_legacy_object_id_t*)ptr);
+        rc = fwrite(&object_id, sizeof(object_id), 1, file);
+        check(rc == 1, "Unable to write migrated log record");
+        rc = fwrite(event_ptr, event_length, 1, file);
+        check(rc == 1, "Unable to write migrated log record");
+        ptr = event_ptr + event_length;
+    }
+
+    rc = fflush(file);
+    check(rc == 0, "Unable to flush migrated log");
+    rc = fsync(fileno(file));
+    check(rc == 0, "Unable to sync migrated log");
+    fclose(file);
+
+    free(buffer);
+    return 0;
+
+error:
+    if(file) fclose(file);
+    free(buffer);
+    return -1;
+}
@@ -0,0 +1,74 @@
+#ifndef _migration_h
+#define _migration_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bstring.h"
+#include "types.h"
+#include "path.h"
+#include "data_file.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The migration functions convert tables written by data file format
+// versions before 3, which stored 32-bit object ids, to the current format
+// with 64-bit object ids. Only the data file and the write-ahead log store
+// object ids so the action, property and dictionary files are left as they
+// are.
+//
+// Data files are converted one block at a time so a table never has to fit
+// in memory. Each legacy block is read from its extent, decompressed if it
+// is compressed and its paths are rewritten with wider object ids into one
+// or more blocks of a new data file. The wider path headers can push the
+// paths of a full block past the end of the block, in which case the paths
+// that do not fit are moved to a new block and a path that does not fit in
+// a block on its own is split into a span. The new files replace the old
+// ones once the new data file has been flushed.
+//
+// The write-ahead log is converted to a new log next to the old one before
+// the data file is replaced and is only moved into place afterwards, so a
+// migration that is interrupted can be run again. Tables must be closed
+// while they are migrated.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The suffix added to the paths of the files that a migration writes.
+#define SKY_MIGRATION_SUFFIX "migrate"
+
+// The length of a path header with a legacy object id.
+#define SKY_MIGRATION_LEGACY_PATH_HEADER_LENGTH (sizeof(sky_legacy_object_id_t) + sizeof(sky_path_event_data_length_t))
+
+// The length of a legacy block header entry in the header file.
+#define SKY_MIGRATION_LEGACY_BLOCK_HEADER_SIZE ((sizeof(sky_legacy_object_id_t) * 2) + (sizeof(sky_timestamp_t) * 2))
+
+// The length of the header at the start of a compressed legacy block.
+#define SKY_MIGRATION_LEGACY_COMPRESSED_HEADER_SIZE (sizeof(sky_legacy_object_id_t) + (sizeof(uint32_t) * 3))
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+int sky_migration_is_required(bstring header_path, bool *ret);
+
+int sky_migration_migrate_table(bstring path);
+
+int sky_migration_migrate_data_file(bstring path, bstring header_path);
+
+int sky_migration_migrate_log(bstring path, bstring target_path);
+
+#endif
@@ -1,6 +1,7 @@
 #include "minipack.h"
 #include "dbg.h"
 #include "stdlib.h"
+#include <stdbool.h>
 
 //==============================================================================
 //
@@ -21,31 +22,24 @@
 int sky_minipack_fread_bstring(FILE *file, bstring *ret)
 {
     size_t sz;
+    bstring str = NULL;
     
     // Read string length.
     uint32_t length = minipack_fread_raw(file, &sz);
     check(sz != 0, "Unable to read raw byte element at byte %ld", ftell(file));
 
-    // Initialize buffer.
-    char *buffer = malloc(length+1); check_mem(buffer);
-    buffer[length] = 0;
-
-    // Read into buffer.
-    sz = fread(buffer, sizeof(char), length, file);
+    // Read directly into the string's buffer.
+    str = bfromcstralloc(length+1, ""); check_mem(str);
+    sz = fread(str->data, sizeof(char), length, file);
     check(sz == length, "Expected %d bytes, received %ld bytes at byte %ld", length, sz, ftell(file));
-
-    // Create bstring from buffer and return.
-    bstring str = blk2bstr(buffer, length); check_mem(str);
+    str->data[length] = 0;
+    str->slen = length;
     *ret = str;
-    
-    // Clean up.
-    free(buffer);
 
     return 0;
     
 error:
     if(str) bdestroy(str);
-    str = NULL;
     *ret = NULL;
     return -1;
 }
@@ -75,3 +69,218 @@ int sky_minipack_fwrite_bstring(FILE *file, bstring str)
 error:
     return -1; 
 }
+
+
+//--------------------------------------
+// Elements
+//--------------------------------------
+
+// Copies a single MessagePack element from a file stream to the end of a
+// buffer without decoding it. Maps and arrays are copied along with all of
+// their items.
+//
+// file   - The file stream to read from.
+// buffer - The buffer to append the element to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_minipack_fread_elem(FILE *file, sky_buffer *buffer)
+{
+    int rc;
+    uint32_t i;
+    void *ptr = NULL;
+    check(file != NULL, "File stream required");
+    check(buffer != NULL, "Buffer required");
+
+    uint64_t remaining = 1;
+    while(remaining > 0) {
+        remaining--;
+
+        // Read the type byte.
+        int c = fgetc(file);
+        check(c != EOF, "Unable to read element type");
+        uint8_t type = (uint8_t)c;
+        check(sky_buffer_write(buffer, &type, 1) == 0, "Unable to copy element type");
+
+        // Determine the length of the rest of the header, the number of
+        // data bytes and the number of child elements.
+        size_t header_length = 0;
+        uint64_t data_length = 0;
+        uint64_t children = 0;
+        uint8_t child_multiplier = 0;
+        rc = sky_minipack_elem_layout(type, &header_length, &data_length, &children, &child_multiplier);
+        check(rc == 0, "Unable to determine element layout");
+
+        // Read the big endian length or count that follows the type.
+        if(header_length > 0) {
+            rc = sky_buffer_reserve(buffer, header_length, &ptr);
+            check(rc == 0, "Unable to reserve element header");
+            check(fread(ptr, header_length, 1, file) == 1, "Unable to read element header");
+            uint64_t value = 0;
+            for(i=0; i<header_length; i++) {
+                value = (value << 8) | ((uint8_t*)ptr)[i];
+            }
+            buffer->length += header_length;
+
+            if(child_multiplier == 0) {
+                data_length = value;
+            }
+            else {
+                children = value * child_multiplier;
+            }
+        }
+
+        // Copy the data bytes.
+        if(data_length > 0) {
+            rc = sky_buffer_reserve(buffer, data_length, &ptr);
+            check(rc == 0, "Unable to reserve element data");
+            check(fread(ptr, data_length, 1, file) == 1, "Unable to read element data");
+            buffer->length += data_length;
+        }
+
+        remaining += children;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Determines how an element is laid out from its type byte. The header is
+// followed either by a big endian length of the data or by a big endian
+// count of children that is multiplied by the child multiplier.
+//
+// type             - The type byte of the element.
+// header_length    - A pointer to where the number of header bytes that
+//                    follow the type byte should be returned.
+// data_length      - A pointer to where the number of data bytes should be
+//                    returned if they are not given in the header.
+// children         - A pointer to where the number of child elements should
+//                    be returned if they are not given in the header.
+// child_multiplier - A pointer to where the number of children per count in
+//                    the header should be returned. This is zero if the
+//                    header holds a data length.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_minipack_elem_layout(uint8_t type, size_t *header_length,
+                             uint64_t *data_length, uint64_t *children,
+                             uint8_t *child_multiplier)
+{
+    *header_length = 0;
+    *data_length = 0;
+    *children = 0;
+    *child_multiplier = 0;
+
+    if(type <= 0x7F || type >= 0xE0 || type == 0xC0 || type == 0xC2 || type == 0xC3) {
+        // Fixnums, nil and booleans have no data.
+    }
+    else if(type <= 0x8F) {
+        *children = (type & 0x0F) * 2;
+    }
+    else if(type <= 0x9F) {
+        *children = (type & 0x0F);
+    }
+    else if(type <= 0xBF) {
+        *data_length = (type & 0x1F);
+    }
+    else {
+        switch(type) {
+            case 0xCC: case 0xD0: *data_length = 1; break;
+            case 0xCD: case 0xD1: *data_length = 2; break;
+            case 0xCA: case 0xCE: case 0xD2: *data_length = 4; break;
+            case 0xCB: case 0xCF: case 0xD3: *data_length = 8; break;
+            case 0xDA: *header_length = 2; break;
+            case 0xDB: *header_length = 4; break;
+            case 0xDC: *header_length = 2; *child_multiplier = 1; break;
+            case 0xDD: *header_length = 4; *child_multiplier = 1; break;
+            case 0xDE: *header_length = 2; *child_multiplier = 2; break;
+            case 0xDF: *header_length = 4; *child_multiplier = 2; break;
+            default: sentinel("Unsupported element type: 0x%02x", type);
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Decoder
+//--------------------------------------
+
+// Starts a decoder on a single element.
+//
+// decoder - The decoder.
+// offset  - The position of the element in the buffer.
+void sky_minipack_decoder_init(sky_minipack_decoder *decoder, size_t offset)
+{
+    decoder->offset = offset;
+    decoder->remaining = 1;
+}
+
+// Reads past as many elements as are fully contained in a buffer. An
+// element that has only partially arrived is left unread and the decoder
+// continues from it on the next call. Nothing is copied or allocated.
+//
+// decoder  - The decoder.
+// data     - The start of the buffer.
+// length   - The number of bytes in the buffer.
+// complete - Set to true once the end of the last element has been found.
+//            Otherwise more bytes are needed.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_minipack_decoder_skip(sky_minipack_decoder *decoder, void *data,
+                              size_t length, bool *complete)
+{
+    int rc;
+    uint32_t i;
+    check(decoder != NULL, "Decoder required");
+    *complete = false;
+
+    uint8_t *bytes = (uint8_t*)data;
+    while(decoder->remaining > 0) {
+        if(decoder->offset >= length) {
+            return 0;
+        }
+
+        size_t header_length = 0;
+        uint64_t data_length = 0;
+        uint64_t children = 0;
+        uint8_t child_multiplier = 0;
+        rc = sky_minipack_elem_layout(bytes[decoder->offset], &header_length, &data_length, &children, &child_multiplier);
+        check(rc == 0, "Unable to determine element layout");
+
+        // Read the big endian length or count once it has arrived.
+        size_t available = length - decoder->offset - 1;
+        if(header_length > available) {
+            return 0;
+        }
+        if(header_length > 0) {
+            uint64_t value = 0;
+            for(i=0; i<header_length; i++) {
+                value = (value << 8) | bytes[decoder->offset+1+i];
+            }
+            if(child_multiplier == 0) {
+                data_length = value;
+            }
+            else {
+                children = value * child_multiplier;
+            }
+        }
+        if(data_length > available - header_length) {
+            return 0;
+        }
+
+        decoder->offset += 1 + header_length + (size_t)data_length;
+        decoder->remaining += children;
+        decoder->remaining--;
+    }
+
+    *complete = true;
+    return 0;
+
+error:
+    return -1;
+}
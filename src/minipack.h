@@ -4,9 +4,29 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include <stdbool.h>
 
 #include "minipack/minipack.h"
 #include "bstring.h"
+#include "buffer.h"
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A decoder finds the end of MessagePack elements in a byte buffer that may
+// not hold all of them yet. The offset is how far into the buffer the
+// decoder has read and the remaining count is the number of elements that
+// still have to be read, including the children of maps and arrays. The
+// decoder only ever stops between elements so it can be resumed once more
+// bytes have been appended to the buffer, even if the buffer has moved.
+typedef struct sky_minipack_decoder {
+    size_t offset;
+    uint64_t remaining;
+} sky_minipack_decoder;
 
 
 //==============================================================================
@@ -23,5 +43,23 @@ int sky_minipack_fread_bstring(FILE *file, bstring *ret);
 
 int sky_minipack_fwrite_bstring(FILE *file, bstring str);
 
+//--------------------------------------
+// Elements
+//--------------------------------------
+
+int sky_minipack_fread_elem(FILE *file, sky_buffer *buffer);
+
+int sky_minipack_elem_layout(uint8_t type, size_t *header_length,
+    uint64_t *data_length, uint64_t *children, uint8_t *child_multiplier);
+
+//--------------------------------------
+// Decoder
+//--------------------------------------
+
+void sky_minipack_decoder_init(sky_minipack_decoder *decoder, size_t offset);
+
+int sky_minipack_decoder_skip(sky_minipack_decoder *decoder, void *data,
+    size_t length, bool *complete);
+
 
 #endif
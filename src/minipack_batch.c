@@ -0,0 +1,559 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#include "minipack_batch.h"
+#include "dbg.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define SKY_MINIPACK_BATCH_X86 1
+#include <immintrin.h>
+#else
+#define SKY_MINIPACK_BATCH_X86 0
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SKY_MINIPACK_BATCH_NEON 1
+#include <arm_neon.h>
+#else
+#define SKY_MINIPACK_BATCH_NEON 0
+#endif
+
+
+//==============================================================================
+//
+// Constants
+//
+//==============================================================================
+
+#define SKY_MINIPACK_BATCH_DOUBLE_TYPE 0xCB
+#define SKY_MINIPACK_BATCH_DOUBLE_SIZE 9
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef void (*sky_minipack_batch_pack_int_func)(void *ptr, int64_t *values,
+    uint32_t count, size_t *sz);
+
+typedef int (*sky_minipack_batch_unpack_int_func)(void *ptr, int64_t *values,
+    uint32_t count, size_t *sz);
+
+typedef void (*sky_minipack_batch_pack_double_func)(void *ptr, double *values,
+    uint32_t count, size_t *sz);
+
+typedef int (*sky_minipack_batch_unpack_double_func)(void *ptr,
+    double *values, uint32_t count, size_t *sz);
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+void sky_minipack_batch_init();
+
+void sky_minipack_batch_pack_int_scalar(void *ptr, int64_t *values,
+    uint32_t count, size_t *sz);
+
+int sky_minipack_batch_unpack_int_scalar(void *ptr, int64_t *values,
+    uint32_t count, size_t *sz);
+
+void sky_minipack_batch_pack_double_scalar(void *ptr, double *values,
+    uint32_t count, size_t *sz);
+
+int sky_minipack_batch_unpack_double_scalar(void *ptr, double *values,
+    uint32_t count, size_t *sz);
+
+#if SKY_MINIPACK_BATCH_X86
+void sky_minipack_batch_pack_int_avx2(void *ptr, int64_t *values,
+    uint32_t count, size_t *sz);
+
+int sky_minipack_batch_unpack_int_sse2(void *ptr, int64_t *values,
+    uint32_t count, size_t *sz);
+
+void sky_minipack_batch_pack_double_ssse3(void *ptr, double *values,
+    uint32_t count, size_t *sz);
+
+int sky_minipack_batch_unpack_double_ssse3(void *ptr, double *values,
+    uint32_t count, size_t *sz);
+#endif
+
+#if SKY_MINIPACK_BATCH_NEON
+void sky_minipack_batch_pack_double_neon(void *ptr, double *values,
+    uint32_t count, size_t *sz);
+
+int sky_minipack_batch_unpack_double_neon(void *ptr, double *values,
+    uint32_t count, size_t *sz);
+#endif
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+// The total size of each element type by its type byte. Maps, arrays and
+// unused types are zero.
+const uint8_t sky_minipack_batch_sizes[256] = {
+    [0x00 ... 0x7F] = 1,
+    [0xA0] = 1, [0xA1] = 2, [0xA2] = 3, [0xA3] = 4, [0xA4] = 5, [0xA5] = 6, [0xA6] = 7, [0xA7] = 8,
+    [0xA8] = 9, [0xA9] = 10, [0xAA] = 11, [0xAB] = 12, [0xAC] = 13, [0xAD] = 14, [0xAE] = 15, [0xAF] = 16,
+    [0xB0] = 17, [0xB1] = 18, [0xB2] = 19, [0xB3] = 20, [0xB4] = 21, [0xB5] = 22, [0xB6] = 23, [0xB7] = 24,
+    [0xB8] = 25, [0xB9] = 26, [0xBA] = 27, [0xBB] = 28, [0xBC] = 29, [0xBD] = 30, [0xBE] = 31, [0xBF] = 32,
+    [0xC0] = 1, [0xC2] = 1, [0xC3] = 1,
+    [0xCA] = 5, [0xCB] = 9,
+    [0xCC] = 2, [0xCD] = 3, [0xCE] = 5, [0xCF] = 9,
+    [0xD0] = 2, [0xD1] = 3, [0xD2] = 5, [0xD3] = 9,
+    [0xDA] = SKY_MINIPACK_BATCH_RAW16, [0xDB] = SKY_MINIPACK_BATCH_RAW32,
+    [0xE0 ... 0xFF] = 1,
+};
+
+// The batch functions chosen for the current CPU.
+pthread_once_t sky_minipack_batch_once = PTHREAD_ONCE_INIT;
+sky_minipack_batch_pack_int_func sky_minipack_batch_pack_int_best = sky_minipack_batch_pack_int_scalar;
+sky_minipack_batch_unpack_int_func sky_minipack_batch_unpack_int_best = sky_minipack_batch_unpack_int_scalar;
+sky_minipack_batch_pack_double_func sky_minipack_batch_pack_double_best = sky_minipack_batch_pack_double_scalar;
+sky_minipack_batch_unpack_double_func sky_minipack_batch_unpack_double_best = sky_minipack_batch_unpack_double_scalar;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Dispatch
+//--------------------------------------
+
+// Chooses the widest batch functions supported by the CPU.
+void sky_minipack_batch_init()
+{
+#if SKY_MINIPACK_BATCH_X86
+    __builtin_cpu_init();
+    sky_minipack_batch_unpack_int_best = sky_minipack_batch_unpack_int_sse2;
+    if(__builtin_cpu_supports("avx2")) {
+        sky_minipack_batch_pack_int_best = sky_minipack_batch_pack_int_avx2;
+    }
+    if(__builtin_cpu_supports("ssse3")) {
+        sky_minipack_batch_pack_double_best = sky_minipack_batch_pack_double_ssse3;
+        sky_minipack_batch_unpack_double_best = sky_minipack_batch_unpack_double_ssse3;
+    }
+#elif SKY_MINIPACK_BATCH_NEON
+    sky_minipack_batch_pack_double_best = sky_minipack_batch_pack_double_neon;
+    sky_minipack_batch_unpack_double_best = sky_minipack_batch_unpack_double_neon;
+#endif
+}
+
+
+//--------------------------------------
+// Sizing
+//--------------------------------------
+
+// Retrieves the number of bytes of an element along with its data. This
+// returns the same size as minipack_sizeof_elem_and_data() with a single
+// table lookup for all types except raw16 and raw32 values.
+//
+// ptr - A pointer to the element.
+//
+// Returns the number of bytes of the element or zero for maps, arrays and
+// unknown types.
+size_t sky_minipack_batch_sizeof_elem(void *ptr)
+{
+    uint8_t *bytes = (uint8_t*)ptr;
+    uint8_t size = sky_minipack_batch_sizes[bytes[0]];
+    if(size == SKY_MINIPACK_BATCH_RAW16) {
+        uint16_t length;
+        memcpy(&length, bytes + 1, sizeof(length));
+        return 3 + ntohs(length);
+    }
+    else if(size == SKY_MINIPACK_BATCH_RAW32) {
+        uint32_t length;
+        memcpy(&length, bytes + 1, sizeof(length));
+        return 5 + ntohl(length);
+    }
+    return size;
+}
+
+
+//--------------------------------------
+// Integers
+//--------------------------------------
+
+// Serializes an array of integers as consecutive MessagePack elements. Each
+// value is packed the same way as by minipack_pack_int().
+//
+// ptr    - The pointer to write to. There must be room for nine bytes per
+//          value.
+// values - The values to pack.
+// count  - The number of values.
+// sz     - The number of bytes written.
+void sky_minipack_batch_pack_int(void *ptr, int64_t *values, uint32_t count,
+                                 size_t *sz)
+{
+    pthread_once(&sky_minipack_batch_once, sky_minipack_batch_init);
+    sky_minipack_batch_pack_int_best(ptr, values, count, sz);
+}
+
+// Deserializes consecutive MessagePack integer elements into an array.
+//
+// ptr    - The pointer to read from.
+// values - The array to read into.
+// count  - The number of values to read.
+// sz     - The number of bytes read.
+//
+// Returns 0 if successful, otherwise returns -1 if an element is not an
+// integer.
+int sky_minipack_batch_unpack_int(void *ptr, int64_t *values, uint32_t count,
+                                  size_t *sz)
+{
+    pthread_once(&sky_minipack_batch_once, sky_minipack_batch_init);
+    return sky_minipack_batch_unpack_int_best(ptr, values, count, sz);
+}
+
+// Serializes an array of integers one value at a time.
+//
+// ptr    - The pointer to write to.
+// values - The values to pack.
+// count  - The number of values.
+// sz     - The number of bytes written.
+void sky_minipack_batch_pack_int_scalar(void *ptr, int64_t *values,
+                                        uint32_t count, size_t *sz)
+{
+    uint32_t i;
+    size_t _sz;
+    uint8_t *bytes = (uint8_t*)ptr;
+    for(i=0; i<count; i++) {
+        minipack_pack_int(bytes, values[i], &_sz);
+        bytes += _sz;
+    }
+    *sz = (size_t)(bytes - (uint8_t*)ptr);
+}
+
+// Deserializes integers one element at a time.
+//
+// ptr    - The pointer to read from.
+// values - The array to read into.
+// count  - The number of values to read.
+// sz     - The number of bytes read.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_minipack_batch_unpack_int_scalar(void *ptr, int64_t *values,
+                                         uint32_t count, size_t *sz)
+{
+    uint32_t i;
+    size_t _sz;
+    uint8_t *bytes = (uint8_t*)ptr;
+    for(i=0; i<count; i++) {
+        values[i] = minipack_unpack_int(bytes, &_sz);
+        check(_sz != 0, "Unable to unpack integer %d of %d", i, count);
+        bytes += _sz;
+    }
+    *sz = (size_t)(bytes - (uint8_t*)ptr);
+    return 0;
+
+error:
+    *sz = 0;
+    return -1;
+}
+
+#if SKY_MINIPACK_BATCH_X86
+
+// Serializes an array of integers four values at a time using AVX2. A group
+// of values that are all fixnums is written as the low byte of each value.
+// Any other group falls back to packing one value at a time.
+//
+// ptr    - The pointer to write to.
+// values - The values to pack.
+// count  - The number of values.
+// sz     - The number of bytes written.
+__attribute__((target("avx2")))
+void sky_minipack_batch_pack_int_avx2(void *ptr, int64_t *values,
+                                      uint32_t count, size_t *sz)
+{
+    uint32_t i = 0;
+    size_t _sz;
+    uint8_t *bytes = (uint8_t*)ptr;
+    __m256i min = _mm256_set1_epi64x(-33);
+    __m256i max = _mm256_set1_epi64x(128);
+    for(; i+4 <= count; i+=4) {
+        __m256i chunk = _mm256_loadu_si256((__m256i*)(values + i));
+        __m256i fixnum = _mm256_and_si256(_mm256_cmpgt_epi64(chunk, min), _mm256_cmpgt_epi64(max, chunk));
+        if(_mm256_movemask_pd(_mm256_castsi256_pd(fixnum)) == 0x0F) {
+            bytes[0] = (uint8_t)values[i];
+            bytes[1] = (uint8_t)values[i+1];
+            bytes[2] = (uint8_t)values[i+2];
+            bytes[3] = (uint8_t)values[i+3];
+            bytes += 4;
+        }
+        else {
+            sky_minipack_batch_pack_int_scalar(bytes, values + i, 4, &_sz);
+            bytes += _sz;
+        }
+    }
+    sky_minipack_batch_pack_int_scalar(bytes, values + i, count - i, &_sz);
+    *sz = (size_t)(bytes - (uint8_t*)ptr) + _sz;
+}
+
+// Deserializes integers sixteen type bytes at a time using SSE2. Fixnum type
+// bytes are the only ones that are greater than -33 as signed bytes so a
+// single compare finds the run of fixnums at the front of the chunk, which
+// are sign extended directly. The element after the run is unpacked on its
+// own. A chunk is only loaded while at least sixteen elements are left so
+// that it cannot read past the last element.
+//
+// ptr    - The pointer to read from.
+// values - The array to read into.
+// count  - The number of values to read.
+// sz     - The number of bytes read.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_minipack_batch_unpack_int_sse2(void *ptr, int64_t *values,
+                                       uint32_t count, size_t *sz)
+{
+    int rc;
+    uint32_t i = 0, j;
+    size_t _sz;
+    uint8_t *bytes = (uint8_t*)ptr;
+    __m128i min = _mm_set1_epi8(-33);
+    while(i+16 <= count) {
+        __m128i chunk = _mm_loadu_si128((__m128i*)bytes);
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(chunk, min));
+        uint32_t run = (uint32_t)__builtin_ctz(~mask);
+        for(j=0; j<run; j++) {
+            values[i+j] = (int8_t)bytes[j];
+        }
+        i += run;
+        bytes += run;
+        if(run < 16) {
+            values[i] = minipack_unpack_int(bytes, &_sz);
+            check(_sz != 0, "Unable to unpack integer %d of %d", i, count);
+            bytes += _sz;
+            i++;
+        }
+    }
+    rc = sky_minipack_batch_unpack_int_scalar(bytes, values + i, count - i, &_sz);
+    check(rc == 0, "Unable to unpack integers");
+    *sz = (size_t)(bytes - (uint8_t*)ptr) + _sz;
+    return 0;
+
+error:
+    *sz = 0;
+    return -1;
+}
+
+#endif
+
+
+//--------------------------------------
+// Doubles
+//--------------------------------------
+
+// Serializes an array of doubles as consecutive MessagePack elements.
+//
+// ptr    - The pointer to write to. There must be room for nine bytes per
+//          value.
+// values - The values to pack.
+// count  - The number of values.
+// sz     - The number of bytes written.
+void sky_minipack_batch_pack_double(void *ptr, double *values, uint32_t count,
+                                    size_t *sz)
+{
+    pthread_once(&sky_minipack_batch_once, sky_minipack_batch_init);
+    sky_minipack_batch_pack_double_best(ptr, values, count, sz);
+}
+
+// Deserializes consecutive MessagePack double elements into an array.
+//
+// ptr    - The pointer to read from.
+// values - The array to read into.
+// count  - The number of values to read.
+// sz     - The number of bytes read.
+//
+// Returns 0 if successful, otherwise returns -1 if an element is not a
+// double.
+int sky_minipack_batch_unpack_double(void *ptr, double *values,
+                                     uint32_t count, size_t *sz)
+{
+    pthread_once(&sky_minipack_batch_once, sky_minipack_batch_init);
+    return sky_minipack_batch_unpack_double_best(ptr, values, count, sz);
+}
+
+// Serializes an array of doubles one value at a time.
+//
+// ptr    - The pointer to write to.
+// values - The values to pack.
+// count  - The number of values.
+// sz     - The number of bytes written.
+void sky_minipack_batch_pack_double_scalar(void *ptr, double *values,
+                                           uint32_t count, size_t *sz)
+{
+    uint32_t i;
+    size_t _sz;
+    uint8_t *bytes = (uint8_t*)ptr;
+    for(i=0; i<count; i++) {
+        minipack_pack_double(bytes, values[i], &_sz);
+        bytes += _sz;
+    }
+    *sz = (size_t)(bytes - (uint8_t*)ptr);
+}
+
+// Deserializes doubles one element at a time.
+//
+// ptr    - The pointer to read from.
+// values - The array to read into.
+// count  - The number of values to read.
+// sz     - The number of bytes read.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_minipack_batch_unpack_double_scalar(void *ptr, double *values,
+                                            uint32_t count, size_t *sz)
+{
+    uint32_t i;
+    size_t _sz;
+    uint8_t *bytes = (uint8_t*)ptr;
+    for(i=0; i<count; i++) {
+        check(minipack_is_double(bytes), "Unable to unpack double %d of %d", i, count);
+        values[i] = minipack_unpack_double(bytes, &_sz);
+        bytes += _sz;
+    }
+    *sz = (size_t)(bytes - (uint8_t*)ptr);
+    return 0;
+
+error:
+    *sz = 0;
+    return -1;
+}
+
+#if SKY_MINIPACK_BATCH_X86
+
+// Serializes an array of doubles two values at a time. Both values are byte
+// swapped with a single SSSE3 shuffle.
+//
+// ptr    - The pointer to write to.
+// values - The values to pack.
+// count  - The number of values.
+// sz     - The number of bytes written.
+__attribute__((target("ssse3")))
+void sky_minipack_batch_pack_double_ssse3(void *ptr, double *values,
+                                          uint32_t count, size_t *sz)
+{
+    uint32_t i = 0;
+    size_t _sz;
+    uint8_t *bytes = (uint8_t*)ptr;
+    __m128i swap = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    for(; i+2 <= count; i+=2) {
+        __m128i chunk = _mm_shuffle_epi8(_mm_loadu_si128((__m128i*)(values + i)), swap);
+        bytes[0] = SKY_MINIPACK_BATCH_DOUBLE_TYPE;
+        _mm_storel_epi64((__m128i*)(bytes + 1), chunk);
+        bytes[9] = SKY_MINIPACK_BATCH_DOUBLE_TYPE;
+        _mm_storel_epi64((__m128i*)(bytes + 10), _mm_srli_si128(chunk, 8));
+        bytes += SKY_MINIPACK_BATCH_DOUBLE_SIZE * 2;
+    }
+    sky_minipack_batch_pack_double_scalar(bytes, values + i, count - i, &_sz);
+    *sz = (size_t)(bytes - (uint8_t*)ptr) + _sz;
+}
+
+// Deserializes doubles two elements at a time with a single SSSE3 shuffle.
+//
+// ptr    - The pointer to read from.
+// values - The array to read into.
+// count  - The number of values to read.
+// sz     - The number of bytes read.
+//
+// Returns 0 if successful, otherwise returns -1.
+__attribute__((target("ssse3")))
+int sky_minipack_batch_unpack_double_ssse3(void *ptr, double *values,
+                                           uint32_t count, size_t *sz)
+{
+    int rc;
+    uint32_t i = 0;
+    size_t _sz;
+    uint8_t *bytes = (uint8_t*)ptr;
+    __m128i swap = _mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    for(; i+2 <= count; i+=2) {
+        check(bytes[0] == SKY_MINIPACK_BATCH_DOUBLE_TYPE && bytes[9] == SKY_MINIPACK_BATCH_DOUBLE_TYPE, "Unable to unpack double %d of %d", i, count);
+        __m128i lo = _mm_loadl_epi64((__m128i*)(bytes + 1));
+        __m128i hi = _mm_loadl_epi64((__m128i*)(bytes + 10));
+        _mm_storeu_si128((__m128i*)(values + i), _mm_shuffle_epi8(_mm_unpacklo_epi64(lo, hi), swap));
+        bytes += SKY_MINIPACK_BATCH_DOUBLE_SIZE * 2;
+    }
+    rc = sky_minipack_batch_unpack_double_scalar(bytes, values + i, count - i, &_sz);
+    check(rc == 0, "Unable to unpack doubles");
+    *sz = (size_t)(bytes - (uint8_t*)ptr) + _sz;
+    return 0;
+
+error:
+    *sz = 0;
+    return -1;
+}
+
+#endif
+
+#if SKY_MINIPACK_BATCH_NEON
+
+// Serializes an array of doubles two values at a time. Both values are byte
+// swapped with a single NEON byte reversal.
+//
+// ptr    - The pointer to write to.
+// values - The values to pack.
+// count  - The number of values.
+// sz     - The number of bytes written.
+void sky_minipack_batch_pack_double_neon(void *ptr, double *values,
+                                         uint32_t count, size_t *sz)
+{
+    uint32_t i = 0;
+    size_t _sz;
+    uint8_t *bytes = (uint8_t*)ptr;
+    for(; i+2 <= count; i+=2) {
+        uint8x16_t chunk = vrev64q_u8(vld1q_u8((uint8_t*)(values + i)));
+        bytes[0] = SKY_MINIPACK_BATCH_DOUBLE_TYPE;
+        vst1_u8(bytes + 1, vget_low_u8(chunk));
+        bytes[9] = SKY_MINIPACK_BATCH_DOUBLE_TYPE;
+        vst1_u8(bytes + 10, vget_high_u8(chunk));
+        bytes += SKY_MINIPACK_BATCH_DOUBLE_SIZE * 2;
+    }
+    sky_minipack_batch_pack_double_scalar(bytes, values + i, count - i, &_sz);
+    *sz = (size_t)(bytes - (uint8_t*)ptr) + _sz;
+}
+
+// Deserializes doubles two elements at a time with a single NEON byte
+// reversal.
+//
+// ptr    - The pointer to read from.
+// values - The array to read into.
+// count  - The number of values to read.
+// sz     - The number of bytes read.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_minipack_batch_unpack_double_neon(void *ptr, double *values,
+                                          uint32_t count, size_t *sz)
+{
+    int rc;
+    uint32_t i = 0;
+    size_t _sz;
+    uint8_t *bytes = (uint8_t*)ptr;
+    for(; i+2 <= count; i+=2) {
+        check(bytes[0] == SKY_MINIPACK_BATCH_DOUBLE_TYPE && bytes[9] == SKY_MINIPACK_BATCH_DOUBLE_TYPE, "Unable to unpack double %d of %d", i, count);
+        uint8x16_t chunk = vcombine_u8(vld1_u8(bytes + 1), vld1_u8(bytes + 10));
+        vst1q_u8((uint8_t*)(values + i), vrev64q_u8(chunk));
+        bytes += SKY_MINIPACK_BATCH_DOUBLE_SIZE * 2;
+    }
+    rc = sky_minipack_batch_unpack_double_scalar(bytes, values + i, count - i, &_sz);
+    check(rc == 0, "Unable to unpack doubles");
+    *sz = (size_t)(bytes - (uint8_t*)ptr) + _sz;
+    return 0;
+
+error:
+    *sz = 0;
+    return -1;
+}
+
+#endif
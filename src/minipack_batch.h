@@ -0,0 +1,94 @@
+#ifndef _minipack_batch_h
+#define _minipack_batch_h
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "minipack/minipack.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The batch routines encode and decode runs of MessagePack values instead
+// of one value at a time. Event data is stored as property id and value
+// pairs so walking it is dominated by finding the size of each value. The
+// size of every element type is looked up in a table instead of testing the
+// type byte against each type in turn.
+//
+// Arrays of doubles are byte swapped two at a time with SSSE3 on x86-64 and
+// with NEON on ARM. Arrays of integers are classified four at a time with
+// AVX2 so that runs of fixnums are written without a branch per value. The
+// widest version supported by the CPU is chosen at runtime the first time a
+// batch is encoded. Other platforms use the scalar versions, which produce
+// the same bytes.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// Size table entries for raw types whose length follows the type byte.
+#define SKY_MINIPACK_BATCH_RAW16 0xFE
+#define SKY_MINIPACK_BATCH_RAW32 0xFF
+
+// Retrieves the size of an element from the size table and only calls out
+// for the long raw types. This is for loops that size every element. The
+// pointer is evaluated more than once.
+//
+// PTR - A pointer to the element.
+#define sky_minipack_batch_fast_sizeof_elem(PTR) \
+    (sky_minipack_batch_sizes[*((uint8_t*)(PTR))] < SKY_MINIPACK_BATCH_RAW16 ?\
+        (size_t)sky_minipack_batch_sizes[*((uint8_t*)(PTR))] : sky_minipack_batch_sizeof_elem(PTR))
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+extern const uint8_t sky_minipack_batch_sizes[256];
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Sizing
+//--------------------------------------
+
+size_t sky_minipack_batch_sizeof_elem(void *ptr);
+
+
+//--------------------------------------
+// Integers
+//--------------------------------------
+
+void sky_minipack_batch_pack_int(void *ptr, int64_t *values, uint32_t count,
+    size_t *sz);
+
+int sky_minipack_batch_unpack_int(void *ptr, int64_t *values, uint32_t count,
+    size_t *sz);
+
+
+//--------------------------------------
+// Doubles
+//--------------------------------------
+
+void sky_minipack_batch_pack_double(void *ptr, double *values,
+    uint32_t count, size_t *sz);
+
+int sky_minipack_batch_unpack_double(void *ptr, double *values,
+    uint32_t count, size_t *sz);
+
+#endif
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+
+#include "mpsc_queue.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Initializes an empty queue.
+//
+// queue - The queue.
+void sky_mpsc_queue_init(sky_mpsc_queue *queue)
+{
+    queue->stub.next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+}
+
+
+//--------------------------------------
+// Queueing
+//--------------------------------------
+
+// Adds a node to the queue. This can be called from any thread.
+//
+// queue - The queue.
+// node  - The node to add.
+void sky_mpsc_queue_push(sky_mpsc_queue *queue, sky_mpsc_node *node)
+{
+    node->next = NULL;
+    __sync_synchronize();
+
+    // Become the head and then link the previous head to the node.
+    sky_mpsc_node *prev;
+    do {
+        prev = queue->head;
+    } while(!__sync_bool_compare_and_swap(&queue->head, prev, node));
+    prev->next = node;
+    __sync_synchronize();
+}
+
+// Removes the oldest node from the queue. This may only be called by the
+// consumer.
+//
+// queue - The queue.
+//
+// Returns the node or NULL if the queue is empty or the next node is still
+// being pushed.
+sky_mpsc_node *sky_mpsc_queue_pop(sky_mpsc_queue *queue)
+{
+    sky_mpsc_node *tail = queue->tail;
+    sky_mpsc_node *next = tail->next;
+
+    // Skip over the stub.
+    if(tail == &queue->stub) {
+        if(next == NULL) {
+            return NULL;
+        }
+        queue->tail = next;
+        tail = next;
+        next = next->next;
+    }
+
+    // The tail can be returned once another node follows it.
+    if(next != NULL) {
+        queue->tail = next;
+        return tail;
+    }
+
+    // A push is in progress if the tail is not the head.
+    if(tail != queue->head) {
+        return NULL;
+    }
+
+    // The tail is the last node so the stub is pushed behind it.
+    sky_mpsc_queue_push(queue, &queue->stub);
+    next = tail->next;
+    if(next != NULL) {
+        queue->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
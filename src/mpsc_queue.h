@@ -0,0 +1,75 @@
+#ifndef _mpsc_queue_h
+#define _mpsc_queue_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct sky_mpsc_node sky_mpsc_node;
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A multi-producer single-consumer queue lets any number of threads hand
+// items to one consumer without a lock. The queue is intrusive: each item
+// embeds a node and the queue only links the nodes together, so pushing
+// never allocates.
+//
+// Producers swap themselves in as the head of the queue with a single
+// atomic exchange and then link the previous head to themselves. The
+// consumer pops from the other end. For a moment after the exchange the
+// new node is not linked yet, so the consumer can see an empty queue while
+// a push is still in progress. That push becomes visible as soon as its
+// producer returns. A consumer that sleeps when the queue is empty must
+// therefore be woken by the producer after the push, not before.
+//
+// A stub node keeps the queue from ever being truly empty so that pushes
+// and pops never touch the same pointer. Items are popped in the order
+// that their exchanges happened, which keeps every producer's items in
+// order.
+//
+// Only one thread may pop at a time.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+struct sky_mpsc_node {
+    sky_mpsc_node *volatile next;
+};
+
+typedef struct sky_mpsc_queue {
+    sky_mpsc_node *volatile head;
+    sky_mpsc_node *tail;
+    sky_mpsc_node stub;
+} sky_mpsc_queue;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+void sky_mpsc_queue_init(sky_mpsc_queue *queue);
+
+//--------------------------------------
+// Queueing
+//--------------------------------------
+
+void sky_mpsc_queue_push(sky_mpsc_queue *queue, sky_mpsc_node *node);
+
+sky_mpsc_node *sky_mpsc_queue_pop(sky_mpsc_queue *queue);
+
+#endif
@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "name_index.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of entries allocated for the first insert.
+#define SKY_NAME_INDEX_INITIAL_CAPACITY 16
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+uint32_t sky_name_index_hash(bstring name);
+
+sky_name_index_entry *sky_name_index_find_entry(sky_name_index *index,
+    bstring name, uint32_t hash);
+
+int sky_name_index_resize(sky_name_index *index, uint32_t capacity);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty name index.
+//
+// Returns a reference to the new index if successful. Otherwise returns null.
+sky_name_index *sky_name_index_create()
+{
+    sky_name_index *index = calloc(1, sizeof(sky_name_index)); check_mem(index);
+    return index;
+
+error:
+    sky_name_index_free(index);
+    return NULL;
+}
+
+// Removes a name index from memory. The names and values are not freed.
+//
+// index - The index to free.
+void sky_name_index_free(sky_name_index *index)
+{
+    if(index) {
+        free(index->entries);
+        free(index);
+    }
+}
+
+
+//--------------------------------------
+// Entry Management
+//--------------------------------------
+
+// Adds a value to the index. The value replaces any existing value with the
+// same name.
+//
+// index - The index.
+// name  - The name of the value. This is not copied.
+// value - The value.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_name_index_put(sky_name_index *index, bstring name, void *value)
+{
+    int rc;
+    check(index != NULL, "Name index required");
+    check(name != NULL, "Name required");
+
+    // Keep the table at most half full so probe sequences stay short.
+    if((index->count+1) * 2 > index->capacity) {
+        rc = sky_name_index_resize(index, (index->capacity > 0 ? index->capacity * 2 : SKY_NAME_INDEX_INITIAL_CAPACITY));
+        check(rc == 0, "Unable to resize name index");
+    }
+
+    uint32_t hash = sky_name_index_hash(name);
+    sky_name_index_entry *entry = sky_name_index_find_entry(index, name, hash);
+    if(entry->name == NULL) {
+        entry->name = name;
+        entry->hash = hash;
+        index->count++;
+    }
+    entry->value = value;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Retrieves the value for a name.
+//
+// index - The index.
+// name  - The name to look up.
+//
+// Returns the value if found. Otherwise returns null.
+void *sky_name_index_get(sky_name_index *index, bstring name)
+{
+    if(index == NULL || name == NULL || index->count == 0) {
+        return NULL;
+    }
+    return sky_name_index_find_entry(index, name, sky_name_index_hash(name))->value;
+}
+
+// Removes all entries from the index.
+//
+// index - The index.
+void sky_name_index_clear(sky_name_index *index)
+{
+    if(index) {
+        if(index->entries != NULL) {
+            memset(index->entries, 0, sizeof(*index->entries) * index->capacity);
+        }
+        index->count = 0;
+    }
+}
+
+
+//--------------------------------------
+// Hashing
+//--------------------------------------
+
+// Calculates the hash of a name using the djb2 algorithm.
+//
+// name - The name.
+//
+// Returns the hash.
+uint32_t sky_name_index_hash(bstring name)
+{
+    int i;
+    uint32_t hash = 5381;
+    for(i=0; i<blength(name); i++) {
+        hash = ((hash << 5) + hash) + (uint8_t)bchar(name, i);
+    }
+    return hash;
+}
+
+// Finds the entry for a name or the empty entry where it would be inserted.
+// The index must have at least one empty entry.
+//
+// index - The index.
+// name  - The name.
+// hash  - The hash of the name.
+//
+// Returns the entry.
+sky_name_index_entry *sky_name_index_find_entry(sky_name_index *index,
+                                                bstring name, uint32_t hash)
+{
+    uint32_t mask = index->capacity - 1;
+    uint32_t i = hash & mask;
+    while(true) {
+        sky_name_index_entry *entry = &index->entries[i];
+        if(entry->name == NULL || (entry->hash == hash && biseq(entry->name, name) == 1)) {
+            return entry;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+// Changes the number of entries in the index and reinserts every entry.
+//
+// index    - The index.
+// capacity - The new number of entries. This must be a power of two.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_name_index_resize(sky_name_index *index, uint32_t capacity)
+{
+    uint32_t i;
+    sky_name_index_entry *old_entries = index->entries;
+    uint32_t old_capacity = index->capacity;
+
+    index->entries = calloc(capacity, sizeof(*index->entries));
+    check_mem(index->entries);
+    index->capacity = capacity;
+
+    for(i=0; i<old_capacity; i++) {
+        if(old_entries[i].name != NULL) {
+            *sky_name_index_find_entry(index, old_entries[i].name, old_entries[i].hash) = old_entries[i];
+        }
+    }
+
+    free(old_entries);
+    return 0;
+
+error:
+    index->entries = old_entries;
+    index->capacity = old_capacity;
+    return -1;
+}
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+// Calculates the heap memory used by a name index. The names are owned by
+// the index's users and are not counted.
+//
+// index - The index.
+//
+// Returns the number of bytes.
+size_t sky_name_index_get_memory_usage(sky_name_index *index)
+{
+    if(index == NULL) {
+        return 0;
+    }
+    return sizeof(*index) + (sizeof(*index->entries) * index->capacity);
+}
@@ -0,0 +1,77 @@
+#ifndef _name_index_h
+#define _name_index_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+typedef struct sky_name_index sky_name_index;
+
+#include "bstring.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The name index is a hash table that maps names to values. It is used by
+// the action and property files to look up definitions by name in constant
+// time. The names are not copied so they must live as long as their entries
+// in the index.
+//
+// The table uses open addressing with linear probing and doubles in size
+// when it is more than half full. Entries are never removed individually.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef struct sky_name_index_entry {
+    bstring name;
+    uint32_t hash;
+    void *value;
+} sky_name_index_entry;
+
+struct sky_name_index {
+    sky_name_index_entry *entries;
+    uint32_t capacity;
+    uint32_t count;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_name_index *sky_name_index_create();
+
+void sky_name_index_free(sky_name_index *index);
+
+
+//--------------------------------------
+// Entry Management
+//--------------------------------------
+
+int sky_name_index_put(sky_name_index *index, bstring name, void *value);
+
+void *sky_name_index_get(sky_name_index *index, bstring name);
+
+void sky_name_index_clear(sky_name_index *index);
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+size_t sky_name_index_get_memory_usage(sky_name_index *index);
+
+#endif
@@ -1,13 +1,14 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <arpa/inet.h>
-#include <sys/time.h>
 
 #include "types.h"
 #include "next_action_message.h"
-#include "path_iterator.h"
+#include "query.h"
 #include "action.h"
 #include "minipack.h"
+#include "stats.h"
 #include "mem.h"
 #include "dbg.h"
 
@@ -18,10 +19,33 @@
 //
 //==============================================================================
 
-// The result data to send back to the client.
-typedef struct sky_next_action_result {
-    uint32_t count;
-} sky_next_action_result;
+struct tagbstring SKY_NEXT_ACTION_KEY_PRIOR_ACTION_IDS = bsStatic("priorActionIds");
+
+struct tagbstring SKY_NEXT_ACTION_KEY_PROFILE = bsStatic("profile");
+
+struct tagbstring SKY_NEXT_ACTION_KEY_DISTINCT = bsStatic("distinct");
+
+struct tagbstring SKY_NEXT_ACTION_KEY_CONTINUOUS = bsStatic("continuous");
+
+struct tagbstring SKY_NEXT_ACTION_KEY_COMPACT = bsStatic("compact");
+
+struct tagbstring SKY_NEXT_ACTION_KEY_GROUP_BY = bsStatic("groupBy");
+
+struct tagbstring SKY_NEXT_ACTION_KEY_QUERY_ID = bsStatic("queryId");
+
+struct tagbstring SKY_NEXT_ACTION_KEY_TIMEOUT = bsStatic("timeout");
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+uint32_t sky_next_action_message_get_option_count(sky_next_action_message *message);
+
+int sky_next_action_message_unpack_prior_action_ids(sky_next_action_message *message,
+    FILE *file);
 
 
 //==============================================================================
@@ -87,6 +111,39 @@ void sky_next_action_message_free_deps(sky_next_action_message *message)
 size_t sky_next_action_message_sizeof(sky_next_action_message *message)
 {
     size_t sz = 0;
+    uint32_t option_count = sky_next_action_message_get_option_count(message);
+    if(option_count > 0) {
+        sz += minipack_sizeof_map(1 + option_count);
+        sz += minipack_sizeof_raw(blength(&SKY_NEXT_ACTION_KEY_PRIOR_ACTION_IDS)) + blength(&SKY_NEXT_ACTION_KEY_PRIOR_ACTION_IDS);
+    }
+    if(message->profile) {
+        sz += minipack_sizeof_raw(blength(&SKY_NEXT_ACTION_KEY_PROFILE)) + blength(&SKY_NEXT_ACTION_KEY_PROFILE);
+        sz += minipack_sizeof_bool();
+    }
+    if(message->distinct) {
+        sz += minipack_sizeof_raw(blength(&SKY_NEXT_ACTION_KEY_DISTINCT)) + blength(&SKY_NEXT_ACTION_KEY_DISTINCT);
+        sz += minipack_sizeof_bool();
+    }
+    if(message->continuous) {
+        sz += minipack_sizeof_raw(blength(&SKY_NEXT_ACTION_KEY_CONTINUOUS)) + blength(&SKY_NEXT_ACTION_KEY_CONTINUOUS);
+        sz += minipack_sizeof_bool();
+    }
+    if(message->compact) {
+        sz += minipack_sizeof_raw(blength(&SKY_NEXT_ACTION_KEY_COMPACT)) + blength(&SKY_NEXT_ACTION_KEY_COMPACT);
+        sz += minipack_sizeof_bool();
+    }
+    if(message->grouped) {
+        sz += minipack_sizeof_raw(blength(&SKY_NEXT_ACTION_KEY_GROUP_BY)) + blength(&SKY_NEXT_ACTION_KEY_GROUP_BY);
+        sz += minipack_sizeof_int(message->group_property_id);
+    }
+    if(message->query_id > 0) {
+        sz += minipack_sizeof_raw(blength(&SKY_NEXT_ACTION_KEY_QUERY_ID)) + blength(&SKY_NEXT_ACTION_KEY_QUERY_ID);
+        sz += minipack_sizeof_uint(message->query_id);
+    }
+    if(message->timeout > 0) {
+        sz += minipack_sizeof_raw(blength(&SKY_NEXT_ACTION_KEY_TIMEOUT)) + blength(&SKY_NEXT_ACTION_KEY_TIMEOUT);
+        sz += minipack_sizeof_int(message->timeout);
+    }
     sz += minipack_sizeof_array(message->prior_action_id_count);
 
     uint32_t i;
@@ -97,7 +154,8 @@ size_t sky_next_action_message_sizeof(sky_next_action_message *message)
     return sz;
 }
 
-// Serializes a 'Next Action' message to a file stream.
+// Serializes a 'Next Action' message to a file stream. A message without
+// any options is written as a plain array of prior action ids.
 //
 // message - The message.
 // file    - The file stream to write to.
@@ -109,6 +167,40 @@ int sky_next_action_message_pack(sky_next_action_message *message, FILE *file)
     check(message != NULL, "Message required");
     check(file != NULL, "File stream required");
 
+    uint32_t option_count = sky_next_action_message_get_option_count(message);
+    if(option_count > 0) {
+        check(minipack_fwrite_map(file, 1 + option_count, &sz) == 0, "Unable to pack map");
+        if(message->profile) {
+            check(sky_minipack_fwrite_bstring(file, &SKY_NEXT_ACTION_KEY_PROFILE) == 0, "Unable to pack profile key");
+            check(minipack_fwrite_bool(file, true, &sz) == 0, "Unable to pack profile flag");
+        }
+        if(message->distinct) {
+            check(sky_minipack_fwrite_bstring(file, &SKY_NEXT_ACTION_KEY_DISTINCT) == 0, "Unable to pack distinct key");
+            check(minipack_fwrite_bool(file, true, &sz) == 0, "Unable to pack distinct flag");
+        }
+        if(message->continuous) {
+            check(sky_minipack_fwrite_bstring(file, &SKY_NEXT_ACTION_KEY_CONTINUOUS) == 0, "Unable to pack continuous key");
+            check(minipack_fwrite_bool(file, true, &sz) == 0, "Unable to pack continuous flag");
+        }
+        if(message->compact) {
+            check(sky_minipack_fwrite_bstring(file, &SKY_NEXT_ACTION_KEY_COMPACT) == 0, "Unable to pack compact key");
+            check(minipack_fwrite_bool(file, true, &sz) == 0, "Unable to pack compact flag");
+        }
+        if(message->grouped) {
+            check(sky_minipack_fwrite_bstring(file, &SKY_NEXT_ACTION_KEY_GROUP_BY) == 0, "Unable to pack group by key");
+            check(minipack_fwrite_int(file, message->group_property_id, &sz) == 0, "Unable to pack group by property id");
+        }
+        if(message->query_id > 0) {
+            check(sky_minipack_fwrite_bstring(file, &SKY_NEXT_ACTION_KEY_QUERY_ID) == 0, "Unable to pack query id key");
+            check(minipack_fwrite_uint(file, message->query_id, &sz) == 0, "Unable to pack query id");
+        }
+        if(message->timeout > 0) {
+            check(sky_minipack_fwrite_bstring(file, &SKY_NEXT_ACTION_KEY_TIMEOUT) == 0, "Unable to pack timeout key");
+            check(minipack_fwrite_int(file, message->timeout, &sz) == 0, "Unable to pack timeout");
+        }
+        check(sky_minipack_fwrite_bstring(file, &SKY_NEXT_ACTION_KEY_PRIOR_ACTION_IDS) == 0, "Unable to pack prior action ids key");
+    }
+
     minipack_fwrite_array(file, message->prior_action_id_count, &sz);
     check(sz > 0, "Unable to pack prior action id array");
 
@@ -124,7 +216,8 @@ error:
     return -1;
 }
 
-// Deserializes an next_action message from a file stream.
+// Deserializes an next_action message from a file stream. The message can
+// either be an array of prior action ids or a map.
 //
 // message - The message.
 // file    - The file stream to read from.
@@ -132,10 +225,105 @@ error:
 // Returns 0 if successful, otherwise returns -1.
 int sky_next_action_message_unpack(sky_next_action_message *message, FILE *file)
 {
+    int rc;
     size_t sz;
+    bstring key = NULL;
     check(message != NULL, "Message required");
     check(file != NULL, "File stream required");
 
+    // Read the first byte to determine the form of the message.
+    uint8_t buffer[1];
+    check(fread(buffer, sizeof(*buffer), 1, file) == 1, "Unable to read message type");
+    ungetc(buffer[0], file);
+
+    if(!minipack_is_map((void*)buffer)) {
+        rc = sky_next_action_message_unpack_prior_action_ids(message, file);
+        check(rc == 0, "Unable to unpack prior action ids");
+        return 0;
+    }
+
+    uint32_t map_length = minipack_fread_map(file, &sz);
+    check(sz > 0, "Unable to read map");
+
+    uint32_t i;
+    for(i=0; i<map_length; i++) {
+        rc = sky_minipack_fread_bstring(file, &key);
+        check(rc == 0, "Unable to read map key");
+
+        if(biseq(key, &SKY_NEXT_ACTION_KEY_PRIOR_ACTION_IDS) == 1) {
+            rc = sky_next_action_message_unpack_prior_action_ids(message, file);
+            check(rc == 0, "Unable to unpack prior action ids");
+        }
+        else if(biseq(key, &SKY_NEXT_ACTION_KEY_PROFILE) == 1) {
+            message->profile = minipack_fread_bool(file, &sz);
+            check(sz > 0, "Unable to unpack profile flag");
+        }
+        else if(biseq(key, &SKY_NEXT_ACTION_KEY_DISTINCT) == 1) {
+            message->distinct = minipack_fread_bool(file, &sz);
+            check(sz > 0, "Unable to unpack distinct flag");
+        }
+        else if(biseq(key, &SKY_NEXT_ACTION_KEY_CONTINUOUS) == 1) {
+            message->continuous = minipack_fread_bool(file, &sz);
+            check(sz > 0, "Unable to unpack continuous flag");
+        }
+        else if(biseq(key, &SKY_NEXT_ACTION_KEY_COMPACT) == 1) {
+            message->compact = minipack_fread_bool(file, &sz);
+            check(sz > 0, "Unable to unpack compact flag");
+        }
+        else if(biseq(key, &SKY_NEXT_ACTION_KEY_GROUP_BY) == 1) {
+            message->grouped = true;
+            message->group_property_id = (sky_property_id_t)minipack_fread_int(file, &sz);
+            check(sz > 0, "Unable to unpack group by property id");
+        }
+        else if(biseq(key, &SKY_NEXT_ACTION_KEY_QUERY_ID) == 1) {
+            message->query_id = minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack query id");
+        }
+        else if(biseq(key, &SKY_NEXT_ACTION_KEY_TIMEOUT) == 1) {
+            message->timeout = minipack_fread_int(file, &sz);
+            check(sz > 0, "Unable to unpack timeout");
+            check(message->timeout >= 0, "Invalid timeout: %lld", (long long)message->timeout);
+        }
+        else {
+            sentinel("Invalid 'Next Action' key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+// Counts the options that are set on a message. A message with options is
+// written as a map instead of a plain array.
+//
+// message - The message.
+//
+// Returns the number of options.
+uint32_t sky_next_action_message_get_option_count(sky_next_action_message *message)
+{
+    return message->profile + message->distinct + message->continuous + message->compact + message->grouped
+        + (message->query_id > 0) + (message->timeout > 0);
+}
+
+// Deserializes the array of prior action ids.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+uint32_t sky_next_action_message_get_option_count(sky_next_action_message *message);
+
+int sky_next_action_message_unpack_prior_action_ids(sky_next_action_message *message,
+                                                    FILE *file)
+{
+    size_t sz;
+
     message->prior_action_id_count = minipack_fread_array(file, &sz);
     check(sz > 0, "Unable to unpack prior action id array");
 
@@ -160,127 +348,141 @@ error:
 //--------------------------------------
 
 // Queries a table to determine the number of occurrences of the action
-// immediately following a series of actions.
+// immediately following a series of actions. The query is executed as a
+// sequence match grouped by action. If a continuous query is registered for
+// the prior actions then its counts are returned without scanning the table.
+// A continuous message registers the query if it is not registered yet.
+// A grouped message is grouped by its property and subgrouped by action so
+// every property value is counted in the same scan.
 //
 // message - The message.
 // table   - The table to apply the message to.
-// output  - The output stream to write to.
+// output  - The buffer to write the response to.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_next_action_message_process(sky_next_action_message *message,
-                                    sky_table *table, FILE *output)
+                                    sky_table *table, sky_buffer *output)
 {
     int rc;
-    uint32_t i;
-    size_t sz;
+    sky_query *query = NULL;
+    sky_query_result *result = NULL;
+    sky_query_profile profile;
+    sky_object_id_t *object_ids = NULL;
+    uint32_t object_id_count = 0;
     check(message != NULL, "Message required");
     check(message->prior_action_id_count > 0, "Prior actions must be specified");
     check(table != NULL, "Table required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
 
     struct tagbstring status_str = bsStatic("status");
     struct tagbstring ok_str = bsStatic("ok");
     struct tagbstring data_str = bsStatic("data");
     struct tagbstring count_str = bsStatic("count");
 
-    // Create an array to store data.
-    uint32_t action_count = table->action_file->action_count;
-    sky_next_action_result *results = calloc(action_count+1, sizeof(*results));
-    check_mem(results);
-
-    // Initialize the path iterator.
-    sky_path_iterator iterator;
-    sky_path_iterator_init(&iterator);
-    rc = sky_path_iterator_set_data_file(&iterator, table->data_file);
-    check(rc == 0, "Unable to initialze path iterator");
-
-    // Start benchmark.
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    int64_t t0 = (tv.tv_sec*1000) + (tv.tv_usec/1000);
-
-    // Iterate over each path.
-    uint64_t event_count = 0;
-    while(!iterator.eof) {
-        // Retrieve the path pointer.
-        void *path_ptr = NULL;
-        rc = sky_path_iterator_get_ptr(&iterator, &path_ptr);
-        check(rc == 0, "Unable to retrieve the path iterator pointer");
-    
-        // Initialize the cursor.
-        sky_cursor cursor;
-        sky_cursor_init(&cursor);
-        rc = sky_cursor_set_path(&cursor, path_ptr);
-        check(rc == 0, "Unable to set cursor path");
-
-        // Loop over each event in the path.
-        uint32_t prior_action_index = 0;
-        while(!cursor.eof) {
-            // Retrieve action.
-            sky_action_id_t action_id;
-            rc = sky_cursor_get_action_id(&cursor, &action_id);
-            check(rc == 0, "Unable to retrieve first action");
-
-            // Aggregate if we've reached the match.
-            if(prior_action_index == message->prior_action_id_count) {
-                results[action_id].count++;
-                prior_action_index = 0;
-            }
-
-            // Match against action list.
-            if(message->prior_action_ids[prior_action_index] == action_id) {
-                prior_action_index++;
-            }
-            else {
-                prior_action_index = 0;
-            }
-
-            // Find next event.
-            rc = sky_cursor_next(&cursor);
-            check(rc == 0, "Unable to find next event");
-            
-            // Increment event count.
-            event_count++;
-        }
+    // Build the query.
+    query = sky_query_create(); check_mem(query);
+    rc = sky_query_set_sequence(query, message->prior_action_ids, message->prior_action_id_count);
+    check(rc == 0, "Unable to set query sequence");
+    if(message->grouped) {
+        rc = sky_query_set_group_by(query, SKY_QUERY_FIELD_PROPERTY, message->group_property_id);
+        check(rc == 0, "Unable to set query group by");
+        rc = sky_query_set_subgroup_by(query, SKY_QUERY_FIELD_ACTION, 0);
+        check(rc == 0, "Unable to set query subgroup by");
+    }
+    else {
+        rc = sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+        check(rc == 0, "Unable to set query group by");
+    }
+    rc = sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    check(rc == 0, "Unable to add query aggregate");
+    rc = sky_query_set_timeout(query, message->timeout * 1000);
+    check(rc == 0, "Unable to set query timeout");
+    rc = sky_query_set_cancel_flag(query, message->cancelled);
+    check(rc == 0, "Unable to set query cancel flag");
+    if(message->distinct) {
+        rc = sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_DISTINCT, 0, &SKY_NEXT_ACTION_KEY_DISTINCT);
+        check(rc == 0, "Unable to add distinct aggregate");
+    }
 
-        // Move to next path.
-        rc = sky_path_iterator_next(&iterator);
-        check(rc == 0, "Unable to find next path");
+    // Merge buffered events so the query sees them.
+    memset(&profile, 0, sizeof(profile));
+    int64_t t0 = sky_stats_now();
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge table memtable");
+    profile.memtable_time = sky_stats_now() - t0;
+
+    // Find or register the continuous query for the prior actions. It can
+    // only answer plain counts by action.
+    sky_continuous_query *continuous_query = sky_table_find_continuous_query(table, message->prior_action_ids, message->prior_action_id_count);
+    if(continuous_query == NULL && message->continuous) {
+        rc = sky_table_add_continuous_query(table, message->prior_action_ids, message->prior_action_id_count, &continuous_query);
+        check(rc == 0, "Unable to register continuous query");
     }
-    
-    // End benchmark.
-    gettimeofday(&tv, NULL);
-    int64_t t1 = (tv.tv_sec*1000) + (tv.tv_usec/1000);
-    debug("'Next Action' queried %lld events in: %.3f seconds\n", event_count, ((float)(t1-t0))/1000);
-    
-    // Count the total number of return elements.
-    uint32_t key_count = 0;
-    for(i=0; i<action_count; i++) {
-        if(results[i].count > 0) {
-            key_count++;
-        }
+
+    // Execute the query unless the continuous query has the counts.
+    sky_query_result *packed_result = NULL;
+    if(continuous_query != NULL && !message->distinct && !message->profile && !message->grouped) {
+        packed_result = continuous_query->result;
     }
-    
-    // Return.
-    //   {status:"ok", data:{<action_id>:{count:0}, ...}}
-    check(minipack_fwrite_map(output, 2, &sz) == 0, "Unable to write root map");
-    check(sky_minipack_fwrite_bstring(output, &status_str) == 0, "Unable to write status key");
-    check(sky_minipack_fwrite_bstring(output, &ok_str) == 0, "Unable to write status value");
-    check(sky_minipack_fwrite_bstring(output, &data_str) == 0, "Unable to write data key");
-    check(minipack_fwrite_map(output, key_count, &sz) == 0, "Unable to write data key");
-    for(i=0; i<action_count+1; i++) {
-        if(results[i].count > 0) {
-            check(minipack_fwrite_uint(output, i, &sz) == 0, "Unable to write action id");
-            check(minipack_fwrite_map(output, 1, &sz) == 0, "Unable to write result map");
-            check(sky_minipack_fwrite_bstring(output, &count_str) == 0, "Unable to write result count key");
-            check(minipack_fwrite_uint(output, results[i].count, &sz) == 0, "Unable to write result count");
+    else {
+        // Only objects that performed every prior action can match so the
+        // scan is restricted to them.
+        sky_action_index *action_index = NULL;
+        rc = sky_table_get_action_index(table, &action_index);
+        check(rc == 0, "Unable to retrieve action index");
+        rc = sky_action_index_get_object_ids(action_index, message->prior_action_ids, message->prior_action_id_count, &object_ids, &object_id_count);
+        check(rc == 0, "Unable to find candidate objects");
+        rc = sky_query_set_object_ids(query, object_ids, object_id_count);
+        check(rc == 0, "Unable to restrict query objects");
+
+        result = sky_query_result_create_with_arena(query, message->arena); check_mem(result);
+        result->profile = (message->profile ? &profile : NULL);
+        rc = sky_table_execute_query(table, query, result);
+        if(rc != 0 && sky_query_result_is_stopped(result)) {
+            message->stopped = true;
+            rc = sky_query_result_pack_stopped(result, output);
+            check(rc == 0, "Unable to write stopped query");
+            free(object_ids);
+            sky_query_result_free(result);
+            sky_query_free(query);
+            return 0;
         }
+        check(rc == 0, "Unable to execute 'Next Action' query");
+        packed_result = result;
     }
     
-    free(results);
+    // Return. String property values are decoded for grouped messages.
+    //   {status:"ok", data:{<action_id>:{count:0, distinct:0}, ...}, profile:<profile>}
+    //   {status:"ok", data:{names:[...], keys:<int64[]>, values:<int64[]>}}
+    check(sky_buffer_pack_map(output, (message->profile ? 3 : 2)) == 0, "Unable to write root map");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    check(sky_buffer_pack_bstring(output, &data_str) == 0, "Unable to write data key");
+    t0 = sky_stats_now();
+    sky_dictionary_file *dictionary_file = (message->grouped ? table->dictionary_file : NULL);
+    if(message->compact) {
+        rc = sky_query_result_pack_columns(packed_result, query, dictionary_file, output);
+    }
+    else {
+        rc = sky_query_result_pack(packed_result, query, dictionary_file, output);
+    }
+    check(rc == 0, "Unable to write query result");
+    profile.encode_time = sky_stats_now() - t0;
+
+    if(message->profile) {
+        check(sky_buffer_pack_bstring(output, &SKY_NEXT_ACTION_KEY_PROFILE) == 0, "Unable to write profile key");
+        rc = sky_query_profile_pack(&profile, output);
+        check(rc == 0, "Unable to write query profile");
+    }
+
+    free(object_ids);
+    sky_query_result_free(result);
+    sky_query_free(query);
     return 0;
 
 error:
-    free(results);
+    free(object_ids);
+    sky_query_result_free(result);
+    sky_query_free(query);
     return -1;
-}
\ No newline at end of file
+}
@@ -6,8 +6,10 @@
 #include <netinet/in.h>
 
 #include "bstring.h"
+#include "buffer.h"
 #include "table.h"
 #include "event.h"
+#include "arena.h"
 
 
 //==============================================================================
@@ -17,10 +19,44 @@
 //==============================================================================
 
 // A message for retrieving a count of the next immediate action following a
-// series of actions.
+// series of actions. The results are built in the arena if one is set. The
+// arena is not owned by the message.
+//
+// The message is sent as an array of prior action ids or as a map of
+// {priorActionIds:[<action_id>, ...], profile:<bool>, distinct:<bool>,
+// continuous:<bool>, groupBy:<property_id>}. A profiled message returns the
+// profile of its query along with the results. A distinct message also
+// estimates the number of distinct objects that performed each next action.
+// A continuous message registers its prior actions as a continuous query on
+// the table so that later messages for them are answered without a scan.
+// A grouped message breaks the counts down by the value of a property in a
+// single scan and returns {<value>:{<action_id>:{count:0}, ...}, ...}.
+// Events without a value for the property are not counted.
+//
+// A message with {compact:true} returns its data as parallel columns of
+// keys and values instead of nested maps. A grouped message then has
+// subkeys as well. See sky_query_result_pack_columns() in query.c.
+//
+// A message with a timeout of {timeout:<ms>} stops its scan once it has run
+// for that long and returns {status:"timeout"}. A message sent with a
+// {queryId:<int>} can be stopped with a Cancel message for that id and then
+// returns {status:"cancelled"}. The cancellation flag is set by the server
+// while the message is processed and is not owned by the message. The
+// stopped flag is set when the scan was stopped before it finished.
 typedef struct sky_next_action_message {
     sky_action_id_t *prior_action_ids;
     uint32_t prior_action_id_count;
+    sky_arena *arena;
+    bool profile;
+    bool distinct;
+    bool continuous;
+    bool compact;
+    bool grouped;
+    sky_property_id_t group_property_id;
+    uint64_t query_id;
+    int64_t timeout;
+    volatile bool *cancelled;
+    bool stopped;
 } sky_next_action_message;
 
 
@@ -55,6 +91,6 @@ int sky_next_action_message_unpack(sky_next_action_message *message,
 //--------------------------------------
 
 int sky_next_action_message_process(sky_next_action_message *message,
-    sky_table *table, FILE *output);
+    sky_table *table, sky_buffer *output);
 
 #endif
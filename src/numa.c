@@ -0,0 +1,329 @@
+#if defined(__linux__)
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "numa.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_numa_read_list(bstring path, uint32_t **values, uint32_t *count);
+
+int sky_numa_set_mempolicy(int mode, sky_numa_node *nodes, uint32_t node_count);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty NUMA topology.
+//
+// Returns a reference to the new topology if successful. Otherwise returns
+// null.
+sky_numa *sky_numa_create()
+{
+    sky_numa *numa = calloc(1, sizeof(sky_numa)); check_mem(numa);
+    return numa;
+
+error:
+    sky_numa_free(numa);
+    return NULL;
+}
+
+// Removes a NUMA topology from memory.
+//
+// numa - The topology to free.
+void sky_numa_free(sky_numa *numa)
+{
+    if(numa) {
+        uint32_t i;
+        for(i=0; i<numa->node_count; i++) {
+            free(numa->nodes[i].cpus);
+        }
+        free(numa->nodes);
+        numa->nodes = NULL;
+        numa->node_count = 0;
+        free(numa);
+    }
+}
+
+
+//--------------------------------------
+// Topology
+//--------------------------------------
+
+// Reads the online nodes and their CPUs from a sysfs node directory. Nodes
+// without any CPUs are skipped since no thread can run on them. The
+// topology is left empty on platforms without NUMA placement.
+//
+// numa - The topology.
+// path - The node directory, usually SKY_NUMA_SYSFS_PATH.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_numa_load(sky_numa *numa, bstring path)
+{
+    int rc;
+    uint32_t i;
+    uint32_t *ids = NULL;
+    uint32_t id_count = 0;
+    bstring list_path = NULL;
+    check(numa != NULL, "Topology required");
+    check(path != NULL, "Path required");
+    check(numa->node_count == 0, "Topology already loaded");
+
+#if defined(__linux__)
+    list_path = bformat("%s/online", bdata(path)); check_mem(list_path);
+    rc = sky_numa_read_list(list_path, &ids, &id_count);
+    check(rc == 0, "Unable to read online nodes: %s", bdata(list_path));
+    bdestroy(list_path);
+    list_path = NULL;
+
+    numa->nodes = calloc(id_count > 0 ? id_count : 1, sizeof(*numa->nodes));
+    check_mem(numa->nodes);
+    for(i=0; i<id_count; i++) {
+        sky_numa_node *node = &numa->nodes[numa->node_count];
+        check(ids[i] < SKY_NUMA_MAX_NODES, "Node id too large: %d", ids[i]);
+        list_path = bformat("%s/node%d/cpulist", bdata(path), ids[i]); check_mem(list_path);
+        rc = sky_numa_read_list(list_path, &node->cpus, &node->cpu_count);
+        check(rc == 0, "Unable to read node CPUs: %s", bdata(list_path));
+        bdestroy(list_path);
+        list_path = NULL;
+
+        node->id = ids[i];
+        if(node->cpu_count > 0) {
+            numa->node_count++;
+        }
+        else {
+            free(node->cpus);
+            node->cpus = NULL;
+        }
+    }
+#endif
+
+    free(ids);
+    return 0;
+
+error:
+    bdestroy(list_path);
+    free(ids);
+    return -1;
+}
+
+// Reads a single sysfs list file.
+//
+// path   - The path of the file.
+// values - A pointer to where the values should be returned.
+// count  - A pointer to where the number of values should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_numa_read_list(bstring path, uint32_t **values, uint32_t *count)
+{
+    int rc;
+    char line[4096];
+    bstring str = NULL;
+    FILE *file = fopen(bdata(path), "r");
+    check(file != NULL, "Unable to open file: %s", bdata(path));
+    if(fgets(line, sizeof(line), file) == NULL) {
+        line[0] = '\0';
+    }
+    fclose(file);
+
+    str = bfromcstr(line); check_mem(str);
+    rc = sky_numa_parse_list(str, values, count);
+    check(rc == 0, "Unable to parse list: %s", bdata(path));
+
+    bdestroy(str);
+    return 0;
+
+error:
+    bdestroy(str);
+    return -1;
+}
+
+// Parses a sysfs list of numbers and ranges such as "0-3,8,10-11". An empty
+// list has no values.
+//
+// str    - The list.
+// values - A pointer to where the values should be returned. The caller
+//          is responsible for freeing the values.
+// count  - A pointer to where the number of values should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_numa_parse_list(bstring str, uint32_t **values, uint32_t *count)
+{
+    int i;
+    struct bstrList *parts = NULL;
+    check(str != NULL, "List required");
+    check(values != NULL, "Values return pointer required");
+    check(count != NULL, "Count return pointer required");
+    *values = NULL;
+    *count = 0;
+
+    parts = bsplit(str, ','); check_mem(parts);
+    for(i=0; i<parts->qty; i++) {
+        btrimws(parts->entry[i]);
+        if(blength(parts->entry[i]) == 0) {
+            continue;
+        }
+
+        // Read a single value or the bounds of a range.
+        char *end = NULL;
+        const char *start = bdata(parts->entry[i]);
+        errno = 0;
+        unsigned long min = strtoul(start, &end, 10);
+        unsigned long max = min;
+        check(errno == 0 && end != start, "Invalid list item: %s", start);
+        if(*end == '-') {
+            const char *next = end + 1;
+            max = strtoul(next, &end, 10);
+            check(errno == 0 && end != next, "Invalid list range: %s", start);
+        }
+        check(*end == '\0' && min <= max && max < UINT32_MAX, "Invalid list item: %s", start);
+
+        uint32_t *new_values = realloc(*values, sizeof(**values) * (*count + (max - min + 1)));
+        check_mem(new_values);
+        *values = new_values;
+        unsigned long value;
+        for(value=min; value<=max; value++) {
+            (*values)[(*count)++] = (uint32_t)value;
+        }
+    }
+
+    bstrListDestroy(parts);
+    return 0;
+
+error:
+    if(parts) bstrListDestroy(parts);
+    if(values) {
+        free(*values);
+        *values = NULL;
+    }
+    if(count) *count = 0;
+    return -1;
+}
+
+// Finds the node that a thread with a given index is placed on. Threads are
+// spread over the nodes in turn.
+//
+// numa  - The topology.
+// index - The index of the thread.
+//
+// Returns the node or NULL if the topology is empty.
+sky_numa_node *sky_numa_get_node(sky_numa *numa, uint32_t index)
+{
+    if(numa == NULL || numa->node_count == 0) {
+        return NULL;
+    }
+    return &numa->nodes[index % numa->node_count];
+}
+
+
+//--------------------------------------
+// Placement
+//--------------------------------------
+
+// Limits the calling thread to the CPUs of a node and prefers the node's
+// memory for the pages that it allocates.
+//
+// numa - The topology.
+// node - The node to place the thread on.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_numa_bind_thread(sky_numa *numa, sky_numa_node *node)
+{
+    check(numa != NULL, "Topology required");
+    check(node != NULL, "Node required");
+
+#if defined(__linux__)
+    uint32_t i;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(i=0; i<node->cpu_count; i++) {
+        if(node->cpus[i] < CPU_SETSIZE) {
+            CPU_SET(node->cpus[i], &set);
+        }
+    }
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    check(rc == 0, "Unable to set CPU affinity for node %d", node->id);
+    rc = sky_numa_set_mempolicy(MPOL_PREFERRED, node, 1);
+    check(rc == 0, "Unable to prefer memory of node %d", node->id);
+#endif
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Spreads the pages that the calling thread allocates across every node.
+// The thread may run on any CPU.
+//
+// numa - The topology.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_numa_interleave_thread(sky_numa *numa)
+{
+    check(numa != NULL, "Topology required");
+
+#if defined(__linux__)
+    if(numa->node_count > 0) {
+        int rc = sky_numa_set_mempolicy(MPOL_INTERLEAVE, numa->nodes, numa->node_count);
+        check(rc == 0, "Unable to interleave memory");
+    }
+#endif
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sets the memory policy of the calling thread for a set of nodes.
+//
+// mode       - The policy mode.
+// nodes      - The nodes.
+// node_count - The number of nodes.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_numa_set_mempolicy(int mode, sky_numa_node *nodes, uint32_t node_count)
+{
+#if defined(__linux__)
+    uint32_t i;
+    unsigned long mask[SKY_NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    for(i=0; i<node_count; i++) {
+        mask[nodes[i].id / (8 * sizeof(unsigned long))] |= (1UL << (nodes[i].id % (8 * sizeof(unsigned long))));
+    }
+    long rc = syscall(SYS_set_mempolicy, mode, mask, (unsigned long)SKY_NUMA_MAX_NODES);
+    check(rc == 0, "Unable to set memory policy");
+    return 0;
+
+error:
+    return -1;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,103 @@
+#ifndef _sky_numa_h
+#define _sky_numa_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "bstring.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The NUMA topology lists the memory nodes of the machine and the CPUs that
+// belong to each of them. It is read from sysfs, where each online node has
+// a directory named `node<N>` with a `cpulist` file such as "0-3,8-11".
+//
+// A thread is placed on a node by limiting it to the node's CPUs and by
+// preferring the node's memory for the pages it allocates. This covers the
+// page cache pages that a thread faults in through a file mapping as well
+// as its heap, so the data of the tables that a thread scans ends up on the
+// thread's own node. Threads created by a placed thread, such as the scan
+// threads of a query, inherit its placement. A thread can also interleave
+// its pages across every node so that no node's memory bandwidth becomes a
+// hot spot.
+//
+// Placement is only supported on Linux. Elsewhere the topology is always
+// empty and placing a thread does nothing.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The directory that the topology is read from.
+#define SKY_NUMA_SYSFS_PATH "/sys/devices/system/node"
+
+// The highest node id that a thread can be placed on plus one.
+#define SKY_NUMA_MAX_NODES 1024
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// How the threads of a server are placed on the nodes.
+typedef enum sky_numa_placement_e {
+    SKY_NUMA_PLACEMENT_NONE,
+    SKY_NUMA_PLACEMENT_LOCAL,
+    SKY_NUMA_PLACEMENT_INTERLEAVE,
+} sky_numa_placement_e;
+
+typedef struct sky_numa_node {
+    uint32_t id;
+    uint32_t *cpus;
+    uint32_t cpu_count;
+} sky_numa_node;
+
+typedef struct sky_numa {
+    sky_numa_node *nodes;
+    uint32_t node_count;
+} sky_numa;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_numa *sky_numa_create();
+
+void sky_numa_free(sky_numa *numa);
+
+//--------------------------------------
+// Topology
+//--------------------------------------
+
+int sky_numa_load(sky_numa *numa, bstring path);
+
+int sky_numa_parse_list(bstring str, uint32_t **values, uint32_t *count);
+
+sky_numa_node *sky_numa_get_node(sky_numa *numa, uint32_t index);
+
+//--------------------------------------
+// Placement
+//--------------------------------------
+
+int sky_numa_bind_thread(sky_numa *numa, sky_numa_node *node);
+
+int sky_numa_interleave_thread(sky_numa *numa);
+
+#endif
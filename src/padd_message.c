@@ -6,6 +6,7 @@
 #include "padd_message.h"
 #include "property.h"
 #include "minipack.h"
+#include "name_index.h"
 #include "mem.h"
 #include "dbg.h"
 
@@ -61,6 +62,16 @@ void sky_padd_message_free_property(sky_padd_message *message)
             sky_property_free(message->property);
         }
         message->property = NULL;
+
+        uint32_t i;
+        for(i=0; i<message->property_count; i++) {
+            if(message->properties[i] && message->properties[i]->property_file == NULL) {
+                sky_property_free(message->properties[i]);
+            }
+        }
+        free(message->properties);
+        message->properties = NULL;
+        message->property_count = 0;
     }
 }
 
@@ -77,7 +88,16 @@ void sky_padd_message_free_property(sky_padd_message *message)
 size_t sky_padd_message_sizeof(sky_padd_message *message)
 {
     size_t sz = 0;
-    sz += sky_property_sizeof(message->property);
+    if(message->property_count > 0) {
+        uint32_t i;
+        sz += minipack_sizeof_array(message->property_count);
+        for(i=0; i<message->property_count; i++) {
+            sz += sky_property_sizeof(message->properties[i]);
+        }
+    }
+    else {
+        sz += sky_property_sizeof(message->property);
+    }
     return sz;
 }
 
@@ -93,8 +113,21 @@ int sky_padd_message_pack(sky_padd_message *message, FILE *file)
     check(message != NULL, "Message required");
     check(file != NULL, "File stream required");
 
-    rc = sky_property_pack(message->property, file);
-    check(rc == 0, "Unable to pack property");
+    // Write a batch as an array of properties.
+    if(message->property_count > 0) {
+        size_t sz;
+        uint32_t i;
+        rc = minipack_fwrite_array(file, message->property_count, &sz);
+        check(rc == 0, "Unable to pack property array");
+        for(i=0; i<message->property_count; i++) {
+            rc = sky_property_pack(message->properties[i], file);
+            check(rc == 0, "Unable to pack property");
+        }
+    }
+    else {
+        rc = sky_property_pack(message->property, file);
+        check(rc == 0, "Unable to pack property");
+    }
     
     return 0;
 
@@ -114,8 +147,28 @@ int sky_padd_message_unpack(sky_padd_message *message, FILE *file)
     check(message != NULL, "Message required");
     check(file != NULL, "File stream required");
 
-    rc = sky_property_unpack(message->property, file);
-    check(rc == 0, "Unable to unpack property");
+    // Peek at the first byte to see if the body is a batch.
+    uint8_t buffer[1];
+    check(fread(buffer, sizeof(*buffer), 1, file) == 1, "Unable to read message body type");
+    ungetc(buffer[0], file);
+
+    if(minipack_is_array((void*)buffer)) {
+        size_t sz;
+        uint32_t i, count = minipack_fread_array(file, &sz);
+        check(sz != 0, "Unable to unpack property array");
+        check(count > 0, "Property array cannot be empty");
+        message->properties = calloc(count, sizeof(*message->properties)); check_mem(message->properties);
+        message->property_count = count;
+        for(i=0; i<count; i++) {
+            message->properties[i] = sky_property_create(); check_mem(message->properties[i]);
+            rc = sky_property_unpack(message->properties[i], file);
+            check(rc == 0, "Unable to unpack property");
+        }
+    }
+    else {
+        rc = sky_property_unpack(message->property, file);
+        check(rc == 0, "Unable to unpack property");
+    }
 
     return 0;
 
@@ -128,45 +181,82 @@ error:
 // Processing
 //--------------------------------------
 
-// Applies an PADD message to a table.
+// Applies an PADD message to a table. A batch is checked for names that
+// are already defined or repeated before any property is added.
 //
 // message - The message.
 // table   - The table to apply the message to.
-// output  - The output stream to write to.
+// output  - The buffer to write the response to.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_padd_message_process(sky_padd_message *message, sky_table *table,
-                             FILE *output)
+                             sky_buffer *output)
 {
     int rc;
-    size_t sz;
+    uint32_t i;
+    sky_name_index *names = NULL;
     check(message != NULL, "Message required");
     check(table != NULL, "Table required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
 
     struct tagbstring status_str = bsStatic("status");
     struct tagbstring ok_str = bsStatic("ok");
     struct tagbstring property_str = bsStatic("property");
+    struct tagbstring properties_str = bsStatic("properties");
 
-    // Add property.
-    rc = sky_property_file_add_property(table->property_file, message->property);
-    check(rc == 0, "Unable to add property");
+    // Add a single property.
+    if(message->property_count == 0) {
+        rc = sky_property_file_add_property(table->property_file, message->property);
+        check(rc == 0, "Unable to add property");
+    }
+    // Or check the names of a batch and then add each property.
+    else {
+        names = sky_name_index_create(); check_mem(names);
+        for(i=0; i<message->property_count; i++) {
+            sky_property *existing = NULL;
+            rc = sky_property_file_find_by_name(table->property_file, message->properties[i]->name, &existing);
+            check(rc == 0 && existing == NULL, "Property already exists with the same name");
+            check(sky_name_index_get(names, message->properties[i]->name) == NULL, "Property name repeated in batch");
+            rc = sky_name_index_put(names, message->properties[i]->name, message->properties[i]);
+            check(rc == 0, "Unable to index property name");
+        }
+        sky_name_index_free(names);
+        names = NULL;
+
+        for(i=0; i<message->property_count; i++) {
+            rc = sky_property_file_add_property(table->property_file, message->properties[i]);
+            if(rc != 0) {
+                // Keep the file in step with the properties that were added.
+                sky_property_file_save(table->property_file);
+            }
+            check(rc == 0, "Unable to add property");
+        }
+    }
     
     // Save property file.
     rc = sky_property_file_save(table->property_file);
     check(rc == 0, "Unable to save property file");
     
     // Return.
-    //   {status:"OK", property:{...}}
-    minipack_fwrite_map(output, 2, &sz);
-    check(sz > 0, "Unable to write output");
-    check(sky_minipack_fwrite_bstring(output, &status_str) == 0, "Unable to write status key");
-    check(sky_minipack_fwrite_bstring(output, &ok_str) == 0, "Unable to write status value");
-    check(sky_minipack_fwrite_bstring(output, &property_str) == 0, "Unable to write property key");
-    check(sky_property_pack(message->property, output) == 0, "Unable to write property value");
+    //   {status:"OK", property:{...}} or {status:"OK", properties:[...]}
+    check(sky_buffer_pack_map(output, 2) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    if(message->property_count == 0) {
+        check(sky_buffer_pack_bstring(output, &property_str) == 0, "Unable to write property key");
+        check(sky_property_pack_buffer(message->property, output) == 0, "Unable to write property value");
+    }
+    else {
+        check(sky_buffer_pack_bstring(output, &properties_str) == 0, "Unable to write properties key");
+        check(sky_buffer_pack_array(output, message->property_count) == 0, "Unable to write properties array");
+        for(i=0; i<message->property_count; i++) {
+            check(sky_property_pack_buffer(message->properties[i], output) == 0, "Unable to write property value");
+        }
+    }
     
     return 0;
 
 error:
+    sky_name_index_free(names);
     return -1;
-}
\ No newline at end of file
+}
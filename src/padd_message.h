@@ -6,10 +6,23 @@
 #include <netinet/in.h>
 
 #include "bstring.h"
+#include "buffer.h"
 #include "table.h"
 #include "event.h"
 
 
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The PADD message body is either a single property or an array of properties. All
+// properties in an array are added to the table and the property file is saved once
+// so that defining many properties at a time, such as during an import, does not
+// write one record at a time.
+
+
 //==============================================================================
 //
 // Typedefs
@@ -19,6 +32,8 @@
 // A message for adding properties to a table.
 typedef struct sky_padd_message {
     sky_property* property;
+    sky_property **properties;
+    uint32_t property_count;
 } sky_padd_message;
 
 
@@ -51,6 +66,6 @@ int sky_padd_message_unpack(sky_padd_message *message, FILE *file);
 //--------------------------------------
 
 int sky_padd_message_process(sky_padd_message *message, sky_table *table,
-    FILE *output);
+    sky_buffer *output);
 
 #endif
@@ -109,16 +109,15 @@ error:
 //
 // message - The message.
 // table   - The table to apply the message to.
-// output  - The output stream to write to.
+// output  - The buffer to write the response to.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_pall_message_process(sky_pall_message *message, sky_table *table,
-                             FILE *output)
+                             sky_buffer *output)
 {
-    size_t sz;
     check(message != NULL, "Message required");
     check(table != NULL, "Table required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
 
     struct tagbstring status_str = bsStatic("status");
     struct tagbstring ok_str = bsStatic("ok");
@@ -126,20 +125,19 @@ int sky_pall_message_process(sky_pall_message *message, sky_table *table,
 
     // Return.
     //   {status:"OK", properties:[{...}]}
-    minipack_fwrite_map(output, 2, &sz);
-    check(sz > 0, "Unable to write output");
-    check(sky_minipack_fwrite_bstring(output, &status_str) == 0, "Unable to write status key");
-    check(sky_minipack_fwrite_bstring(output, &ok_str) == 0, "Unable to write status value");
-    check(sky_minipack_fwrite_bstring(output, &properties_str) == 0, "Unable to write properties key");
+    check(sky_buffer_pack_map(output, 2) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    check(sky_buffer_pack_bstring(output, &properties_str) == 0, "Unable to write properties key");
 
     // Loop over properties and serialize them.
-    minipack_fwrite_array(output, table->property_file->property_count, &sz);
-    check(sz > 0, "Unable to write properties array");
+    check(sky_property_file_ensure_loaded(table->property_file) == 0, "Unable to load properties");
+    check(sky_buffer_pack_array(output, table->property_file->property_count) == 0, "Unable to write properties array");
     
     uint32_t i;
     for(i=0; i<table->property_file->property_count; i++) {
         sky_property *property = table->property_file->properties[i];
-        check(sky_property_pack(property, output) == 0, "Unable to write property");
+        check(sky_property_pack_buffer(property, output) == 0, "Unable to write property");
     }
     
     return 0;
@@ -6,6 +6,7 @@
 #include <netinet/in.h>
 
 #include "bstring.h"
+#include "buffer.h"
 #include "table.h"
 #include "event.h"
 
@@ -49,6 +50,6 @@ int sky_pall_message_unpack(sky_pall_message *message, FILE *file);
 //--------------------------------------
 
 int sky_pall_message_process(sky_pall_message *message, sky_table *table,
-    FILE *output);
+    sky_buffer *output);
 
 #endif
@@ -0,0 +1,673 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "partition_set.h"
+#include "block.h"
+#include "file.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_partition_set_load_period(sky_partition_set *partition_set);
+
+int sky_partition_set_load_partition(sky_partition_set *partition_set,
+    sky_timestamp_t min_timestamp, sky_partition **ret);
+
+sky_timestamp_t sky_partition_set_get_period_length(
+    sky_partition_set *partition_set);
+
+int sky_partition_set_compare_partitions(const void *_a, const void *_b);
+
+int sky_partition_iterator_load_paths(sky_partition_iterator *iterator);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty partition set.
+//
+// Returns a reference to the new partition set if successful. Otherwise
+// returns null.
+sky_partition_set *sky_partition_set_create()
+{
+    sky_partition_set *partition_set = calloc(1, sizeof(sky_partition_set));
+    check_mem(partition_set);
+    partition_set->block_size = SKY_DEFAULT_BLOCK_SIZE;
+    return partition_set;
+
+error:
+    sky_partition_set_free(partition_set);
+    return NULL;
+}
+
+// Removes a partition set from memory. Its partitions are unloaded first.
+//
+// partition_set - The partition set to free.
+void sky_partition_set_free(sky_partition_set *partition_set)
+{
+    if(partition_set) {
+        sky_partition_set_unload(partition_set);
+        bdestroy(partition_set->path);
+        partition_set->path = NULL;
+        free(partition_set);
+    }
+}
+
+
+//--------------------------------------
+// Persistence
+//--------------------------------------
+
+// Loads every partition in the directory of the set. The directory is
+// created if it does not exist yet. The period of an existing set replaces
+// the period on the set.
+//
+// partition_set - The partition set.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_partition_set_load(sky_partition_set *partition_set)
+{
+    int rc;
+    DIR *dir = NULL;
+    check(partition_set != NULL, "Partition set required");
+    check(partition_set->path != NULL, "Partition set path required");
+
+    sky_partition_set_unload(partition_set);
+
+    if(!sky_file_exists(partition_set->path)) {
+        rc = mkdir(bdata(partition_set->path), S_IRWXU);
+        check(rc == 0, "Unable to create partition directory: %s", bdata(partition_set->path));
+    }
+    rc = sky_partition_set_load_period(partition_set);
+    check(rc == 0, "Unable to load partition period");
+
+    // Each directory named after a timestamp is a partition.
+    dir = opendir(bdata(partition_set->path));
+    check(dir != NULL, "Unable to open partition directory: %s", bdata(partition_set->path));
+    struct dirent *ent;
+    while((ent = readdir(dir))) {
+        char *end = NULL;
+        errno = 0;
+        long long seconds = strtoll(ent->d_name, &end, 10);
+        if(ent->d_name[0] == '\0' || *end != '\0' || errno != 0) {
+            continue;
+        }
+
+        rc = sky_partition_set_load_partition(partition_set, (sky_timestamp_t)seconds * 1000000, NULL);
+        check(rc == 0, "Unable to load partition: %s", ent->d_name);
+    }
+    closedir(dir);
+    dir = NULL;
+
+    if(partition_set->partition_count > 1) {
+        qsort(partition_set->partitions, partition_set->partition_count, sizeof(*partition_set->partitions), sky_partition_set_compare_partitions);
+    }
+
+    return 0;
+
+error:
+    if(dir) closedir(dir);
+    sky_partition_set_unload(partition_set);
+    return -1;
+}
+
+// Unloads every partition of the set. The files are left on disk.
+//
+// partition_set - The partition set.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_partition_set_unload(sky_partition_set *partition_set)
+{
+    uint32_t i;
+    check(partition_set != NULL, "Partition set required");
+
+    for(i=0; i<partition_set->partition_count; i++) {
+        sky_data_file_free(partition_set->partitions[i].data_file);
+    }
+    free(partition_set->partitions);
+    partition_set->partitions = NULL;
+    partition_set->partition_count = 0;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Reads the period of the set from its period file. The file is written
+// with the period on the set if the set does not have one yet.
+//
+// partition_set - The partition set.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_partition_set_load_period(sky_partition_set *partition_set)
+{
+    int rc;
+    char str[16];
+    void *data = NULL;
+    size_t length = 0;
+    bstring path = bformat("%s/period", bdata(partition_set->path));
+    check_mem(path);
+
+    if(sky_file_exists(path)) {
+        rc = sky_file_read(path, &data, &length);
+        check(rc == 0, "Unable to read partition period: %s", bdata(path));
+        length = (length < sizeof(str)-1 ? length : sizeof(str)-1);
+        memcpy(str, data, length);
+        str[length] = '\0';
+
+        char *end = NULL;
+        errno = 0;
+        unsigned long period = strtoul(str, &end, 10);
+        check(errno == 0 && end != str && period > 0 && period <= UINT32_MAX, "Invalid partition period: %s", bdata(path));
+        partition_set->period = (uint32_t)period;
+    }
+    else {
+        check(partition_set->period > 0, "Partition period required");
+        int str_length = snprintf(str, sizeof(str), "%u\n", partition_set->period);
+        rc = sky_file_write(path, str, (size_t)str_length);
+        check(rc == 0, "Unable to write partition period: %s", bdata(path));
+    }
+
+    free(data);
+    bdestroy(path);
+    return 0;
+
+error:
+    free(data);
+    bdestroy(path);
+    return -1;
+}
+
+// Loads the data file of a partition and appends the partition to the set.
+// The directory of the partition is created if it does not exist yet.
+//
+// partition_set - The partition set.
+// min_timestamp - The start of the partition's period.
+// ret           - A pointer to where the partition should be returned. This
+//                 can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_partition_set_load_partition(sky_partition_set *partition_set,
+                                     sky_timestamp_t min_timestamp,
+                                     sky_partition **ret)
+{
+    int rc;
+    bstring path = NULL;
+    sky_data_file *data_file = NULL;
+
+    path = bformat("%s/%lld", bdata(partition_set->path), (long long)(min_timestamp / 1000000));
+    check_mem(path);
+    if(!sky_file_exists(path)) {
+        rc = mkdir(bdata(path), S_IRWXU);
+        check(rc == 0, "Unable to create partition directory: %s", bdata(path));
+    }
+
+    data_file = sky_data_file_create(); check_mem(data_file);
+    data_file->block_size = partition_set->block_size;
+    data_file->durability = partition_set->durability;
+    data_file->preload = partition_set->preload;
+    data_file->huge_pages = partition_set->huge_pages;
+    data_file->action_only = partition_set->action_only;
+    if(partition_set->block_cache_size > 0) {
+        data_file->block_cache_size = partition_set->block_cache_size;
+    }
+    data_file->prefetcher = partition_set->prefetcher;
+    data_file->access_pattern = SKY_ACCESS_PATTERN_RANDOM;
+    data_file->path = bformat("%s/data", bdata(path)); check_mem(data_file->path);
+    data_file->header_path = bformat("%s/header", bdata(path)); check_mem(data_file->header_path);
+    rc = sky_data_file_load(data_file);
+    check(rc == 0, "Unable to load partition data file: %s", bdata(path));
+
+    sky_partition *partitions = realloc(partition_set->partitions, sizeof(*partitions) * (partition_set->partition_count+1));
+    check_mem(partitions);
+    partition_set->partitions = partitions;
+    sky_partition *partition = &partitions[partition_set->partition_count++];
+    partition->min_timestamp = min_timestamp;
+    partition->data_file = data_file;
+
+    bdestroy(path);
+    if(ret != NULL) *ret = partition;
+    return 0;
+
+error:
+    bdestroy(path);
+    sky_data_file_free(data_file);
+    if(ret != NULL) *ret = NULL;
+    return -1;
+}
+
+
+//--------------------------------------
+// Partition Management
+//--------------------------------------
+
+// Calculates the start of the period that a timestamp falls in.
+//
+// partition_set - The partition set.
+// timestamp     - The timestamp.
+//
+// Returns the timestamp at the start of the period.
+sky_timestamp_t sky_partition_set_get_period_start(sky_partition_set *partition_set,
+                                                   sky_timestamp_t timestamp)
+{
+    sky_timestamp_t length = sky_partition_set_get_period_length(partition_set);
+    sky_timestamp_t remainder = timestamp % length;
+    return timestamp - remainder - (remainder < 0 ? length : 0);
+}
+
+// Calculates the length of each period in microseconds.
+//
+// partition_set - The partition set.
+//
+// Returns the period length.
+sky_timestamp_t sky_partition_set_get_period_length(sky_partition_set *partition_set)
+{
+    return (sky_timestamp_t)partition_set->period * 1000000;
+}
+
+// Retrieves the partition that holds the events at a timestamp.
+//
+// partition_set - The partition set.
+// timestamp     - The timestamp.
+// create        - Whether the partition is created if it does not exist.
+// ret           - A pointer to where the partition should be returned. This
+//                 is null if the partition does not exist and is not
+//                 created.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_partition_set_get_partition(sky_partition_set *partition_set,
+                                    sky_timestamp_t timestamp, bool create,
+                                    sky_partition **ret)
+{
+    int rc;
+    uint32_t i;
+    check(partition_set != NULL, "Partition set required");
+    check(partition_set->period > 0, "Partition period required");
+    check(ret != NULL, "Return pointer required");
+    *ret = NULL;
+
+    // Events usually go to the latest partition so search from the end.
+    sky_timestamp_t min_timestamp = sky_partition_set_get_period_start(partition_set, timestamp);
+    for(i=partition_set->partition_count; i>0; i--) {
+        if(partition_set->partitions[i-1].min_timestamp == min_timestamp) {
+            *ret = &partition_set->partitions[i-1];
+            return 0;
+        }
+        else if(partition_set->partitions[i-1].min_timestamp < min_timestamp) {
+            break;
+        }
+    }
+    if(!create) {
+        return 0;
+    }
+
+    // Add the new partition and move it to its sorted position.
+    sky_partition *partition = NULL;
+    rc = sky_partition_set_load_partition(partition_set, min_timestamp, &partition);
+    check(rc == 0, "Unable to create partition");
+    sky_partition tmp = *partition;
+    memmove(&partition_set->partitions[i+1], &partition_set->partitions[i], sizeof(*partition_set->partitions) * (partition_set->partition_count-i-1));
+    partition_set->partitions[i] = tmp;
+    *ret = &partition_set->partitions[i];
+
+    return 0;
+
+error:
+    if(ret) *ret = NULL;
+    return -1;
+}
+
+// Removes the partitions whose period ends at or before a cutoff. Their
+// data files are unloaded and their directories are removed.
+//
+// partition_set - The partition set.
+// expire_before - The timestamp before which events are dropped.
+// count         - A pointer to where the number of removed partitions is
+//                 returned. This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_partition_set_expire(sky_partition_set *partition_set,
+                             sky_timestamp_t expire_before, uint32_t *count)
+{
+    int rc;
+    uint32_t expired_count = 0;
+    bstring path = NULL;
+    check(partition_set != NULL, "Partition set required");
+
+    // Partitions are sorted so the expired ones are at the start.
+    sky_timestamp_t length = sky_partition_set_get_period_length(partition_set);
+    while(expired_count < partition_set->partition_count &&
+          partition_set->partitions[expired_count].min_timestamp + length <= expire_before)
+    {
+        sky_partition *partition = &partition_set->partitions[expired_count];
+        sky_data_file_free(partition->data_file);
+        partition->data_file = NULL;
+
+        path = bformat("%s/%lld", bdata(partition_set->path), (long long)(partition->min_timestamp / 1000000));
+        check_mem(path);
+        rc = sky_file_rm_r(path);
+        check(rc == 0, "Unable to remove partition: %s", bdata(path));
+        bdestroy(path);
+        path = NULL;
+        expired_count++;
+    }
+
+    partition_set->partition_count -= expired_count;
+    memmove(partition_set->partitions, &partition_set->partitions[expired_count], sizeof(*partition_set->partitions) * partition_set->partition_count);
+
+    if(count != NULL) *count = expired_count;
+    return 0;
+
+error:
+    bdestroy(path);
+    if(count != NULL) *count = 0;
+    return -1;
+}
+
+// Compares two partitions by the start of their period.
+int sky_partition_set_compare_partitions(const void *_a, const void *_b)
+{
+    const sky_partition *a = _a;
+    const sky_partition *b = _b;
+    if(a->min_timestamp > b->min_timestamp) {
+        return 1;
+    }
+    else if(a->min_timestamp < b->min_timestamp) {
+        return -1;
+    }
+    return 0;
+}
+
+
+//--------------------------------------
+// Event Management
+//--------------------------------------
+
+// Adds an event to the partition of its timestamp. The partition is created
+// if it does not exist yet.
+//
+// partition_set - The partition set.
+// event         - The event to add.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_partition_set_add_event(sky_partition_set *partition_set,
+                                sky_event *event)
+{
+    int rc;
+    check(partition_set != NULL, "Partition set required");
+    check(event != NULL, "Event required");
+
+    sky_partition *partition = NULL;
+    rc = sky_partition_set_get_partition(partition_set, event->timestamp, true, &partition);
+    check(rc == 0, "Unable to retrieve partition");
+
+    rc = sky_data_file_add_event(partition->data_file, event);
+    check(rc == 0, "Unable to add event to partition");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Path Lookup
+//--------------------------------------
+
+// Finds the parts of an object's path in the partitions that overlap a
+// timestamp range. The parts are returned in time order.
+//
+// partition_set - The partition set.
+// object_id     - The object id.
+// min_timestamp - The start of the range.
+// max_timestamp - The end of the range.
+// paths         - A pointer to where an array of raw path pointers should be
+//                 returned. The caller owns the array. This is NULL if the
+//                 object has no path in the range.
+// path_count    - A pointer to where the number of paths should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_partition_set_find_path(sky_partition_set *partition_set,
+                                sky_object_id_t object_id,
+                                sky_timestamp_t min_timestamp,
+                                sky_timestamp_t max_timestamp,
+                                void ***paths, uint32_t *path_count)
+{
+    int rc;
+    uint32_t i;
+    void **partition_paths = NULL;
+    check(partition_set != NULL, "Partition set required");
+    check(paths != NULL, "Paths return pointer required");
+    check(path_count != NULL, "Path count return pointer required");
+    *paths = NULL;
+    *path_count = 0;
+
+    sky_timestamp_t length = sky_partition_set_get_period_length(partition_set);
+    for(i=0; i<partition_set->partition_count; i++) {
+        sky_partition *partition = &partition_set->partitions[i];
+        if(partition->min_timestamp > max_timestamp || partition->min_timestamp + length <= min_timestamp) {
+            continue;
+        }
+
+        uint32_t partition_path_count = 0;
+        rc = sky_data_file_find_path(partition->data_file, object_id, &partition_paths, &partition_path_count);
+        check(rc == 0, "Unable to find path in partition");
+        if(partition_path_count > 0) {
+            void **ptrs = realloc(*paths, sizeof(void*) * (*path_count + partition_path_count));
+            check_mem(ptrs);
+            *paths = ptrs;
+            memcpy(&(*paths)[*path_count], partition_paths, sizeof(void*) * partition_path_count);
+            *path_count += partition_path_count;
+        }
+        free(partition_paths);
+        partition_paths = NULL;
+    }
+
+    return 0;
+
+error:
+    free(partition_paths);
+    free(*paths);
+    *paths = NULL;
+    *path_count = 0;
+    return -1;
+}
+
+
+//--------------------------------------
+// Iteration
+//--------------------------------------
+
+// Initializes a partition iterator.
+//
+// iterator - The iterator.
+void sky_partition_iterator_init(sky_partition_iterator *iterator)
+{
+    memset(iterator, 0, sizeof(*iterator));
+    iterator->eof = true;
+}
+
+// Releases the path iterators and path array held by a partition iterator.
+//
+// iterator - The iterator.
+void sky_partition_iterator_uninit(sky_partition_iterator *iterator)
+{
+    uint32_t i;
+    for(i=0; i<iterator->iterator_count; i++) {
+        sky_path_iterator_uninit(&iterator->iterators[i]);
+    }
+    free(iterator->iterators);
+    iterator->iterators = NULL;
+    iterator->iterator_count = 0;
+    free(iterator->paths);
+    iterator->paths = NULL;
+    iterator->path_count = 0;
+    iterator->path_capacity = 0;
+    iterator->eof = true;
+}
+
+// Starts iterating over the paths of the partitions that overlap a
+// timestamp range. The iterator is moved to the first object.
+//
+// iterator      - The iterator.
+// partition_set - The partition set.
+// min_timestamp - The start of the range.
+// max_timestamp - The end of the range.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_partition_iterator_set_partition_set(sky_partition_iterator *iterator,
+                                             sky_partition_set *partition_set,
+                                             sky_timestamp_t min_timestamp,
+                                             sky_timestamp_t max_timestamp)
+{
+    int rc;
+    uint32_t i;
+    check(iterator != NULL, "Iterator required");
+    check(partition_set != NULL, "Partition set required");
+
+    sky_partition_iterator_uninit(iterator);
+    iterator->partition_set = partition_set;
+
+    // Only the partitions that overlap the range are read.
+    sky_timestamp_t length = sky_partition_set_get_period_length(partition_set);
+    if(partition_set->partition_count > 0) {
+        iterator->iterators = calloc(partition_set->partition_count, sizeof(*iterator->iterators));
+        check_mem(iterator->iterators);
+    }
+    for(i=0; i<partition_set->partition_count; i++) {
+        sky_partition *partition = &partition_set->partitions[i];
+        if(partition->min_timestamp > max_timestamp || partition->min_timestamp + length <= min_timestamp) {
+            continue;
+        }
+
+        sky_path_iterator *path_iterator = &iterator->iterators[iterator->iterator_count++];
+        sky_path_iterator_init(path_iterator);
+        rc = sky_path_iterator_set_timestamp_range(path_iterator, min_timestamp, max_timestamp);
+        check(rc == 0, "Unable to set path iterator timestamp range");
+        rc = sky_path_iterator_set_data_file(path_iterator, partition->data_file);
+        check(rc == 0, "Unable to set path iterator data file");
+    }
+
+    rc = sky_partition_iterator_load_paths(iterator);
+    check(rc == 0, "Unable to load paths");
+
+    return 0;
+
+error:
+    sky_partition_iterator_uninit(iterator);
+    return -1;
+}
+
+// Moves the iterator to the next object.
+//
+// iterator - The iterator.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_partition_iterator_next(sky_partition_iterator *iterator)
+{
+    int rc;
+    uint32_t i;
+    check(iterator != NULL, "Iterator required");
+    check(!iterator->eof, "Iterator is at end-of-file");
+
+    for(i=0; i<iterator->iterator_count; i++) {
+        sky_path_iterator *path_iterator = &iterator->iterators[i];
+        if(!path_iterator->eof && path_iterator->current_object_id == iterator->current_object_id) {
+            rc = sky_path_iterator_next(path_iterator);
+            check(rc == 0, "Unable to move to next path");
+        }
+    }
+
+    rc = sky_partition_iterator_load_paths(iterator);
+    check(rc == 0, "Unable to load paths");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Finds the lowest object id that the path iterators are on and collects
+// the parts of its path from each of them. A spanned path contributes one
+// part per block.
+//
+// iterator - The iterator.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_partition_iterator_load_paths(sky_partition_iterator *iterator)
+{
+    int rc;
+    uint32_t i, j;
+
+    iterator->eof = true;
+    iterator->path_count = 0;
+    for(i=0; i<iterator->iterator_count; i++) {
+        sky_path_iterator *path_iterator = &iterator->iterators[i];
+        if(!path_iterator->eof && (iterator->eof || path_iterator->current_object_id < iterator->current_object_id)) {
+            iterator->current_object_id = path_iterator->current_object_id;
+            iterator->eof = false;
+        }
+    }
+    if(iterator->eof) {
+        iterator->current_object_id = 0;
+        return 0;
+    }
+
+    for(i=0; i<iterator->iterator_count; i++) {
+        sky_path_iterator *path_iterator = &iterator->iterators[i];
+        if(path_iterator->eof || path_iterator->current_object_id != iterator->current_object_id) {
+            continue;
+        }
+
+        sky_data_file *data_file = path_iterator->data_file;
+        sky_block *block = data_file->blocks[path_iterator->block_index];
+        uint32_t span_count = 1;
+        if(block->spanned) {
+            rc = sky_block_get_span_count(block, &span_count);
+            check(rc == 0, "Unable to calculate span count");
+        }
+
+        if(iterator->path_count + span_count > iterator->path_capacity) {
+            uint32_t capacity = iterator->path_count + span_count;
+            void **paths = realloc(iterator->paths, sizeof(void*) * capacity);
+            check_mem(paths);
+            iterator->paths = paths;
+            iterator->path_capacity = capacity;
+        }
+
+        if(block->spanned) {
+            for(j=0; j<span_count; j++) {
+                rc = sky_block_get_ptr(data_file->blocks[path_iterator->block_index+j], &iterator->paths[iterator->path_count++]);
+                check(rc == 0, "Unable to retrieve block pointer");
+            }
+        }
+        else {
+            rc = sky_path_iterator_get_ptr(path_iterator, &iterator->paths[iterator->path_count++]);
+            check(rc == 0, "Unable to retrieve path pointer");
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
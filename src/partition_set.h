@@ -0,0 +1,153 @@
+#ifndef _partition_set_h
+#define _partition_set_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+typedef struct sky_partition_set sky_partition_set;
+
+#include "bstring.h"
+#include "types.h"
+#include "event.h"
+#include "data_file.h"
+#include "path_iterator.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A partition set splits the events of a table across several data files
+// by time. Each partition holds the events of one period, such as a month,
+// and is stored in its own directory that is named after the start of the
+// period in seconds. The path of an object is split into one path per
+// partition that the object has events in.
+//
+// Reads that are bounded by time only open the partitions that overlap
+// their range so the older partitions are never mapped. A path iterator
+// over the set walks the partitions side by side in object id order and
+// returns the parts of the current object's path from every partition.
+// The parts are in time order so they can be passed straight to
+// `sky_cursor_set_paths()`, which stitches them together.
+//
+// Expiring events is done by removing the partitions that end before the
+// cutoff, which only unlinks their files.
+//
+// The period is written to a file in the directory of the set when the set
+// is first created. An existing set is always loaded with the period it was
+// created with.
+//
+// These are not to be confused with the block partitions of a data file
+// returned by `sky_data_file_get_partitions()`, which are only used to
+// split a scan between threads.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef struct sky_partition {
+    sky_timestamp_t min_timestamp;
+    sky_data_file *data_file;
+} sky_partition;
+
+struct sky_partition_set {
+    bstring path;
+    uint32_t period;
+    uint32_t block_size;
+    sky_durability_e durability;
+    bool preload;
+    bool huge_pages;
+    bool action_only;
+    size_t block_cache_size;
+    sky_prefetcher *prefetcher;
+    sky_partition *partitions;
+    uint32_t partition_count;
+};
+
+typedef struct sky_partition_iterator {
+    sky_partition_set *partition_set;
+    sky_path_iterator *iterators;
+    uint32_t iterator_count;
+    bool eof;
+    sky_object_id_t current_object_id;
+    void **paths;
+    uint32_t path_count;
+    uint32_t path_capacity;
+} sky_partition_iterator;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_partition_set *sky_partition_set_create();
+
+void sky_partition_set_free(sky_partition_set *partition_set);
+
+
+//--------------------------------------
+// Persistence
+//--------------------------------------
+
+int sky_partition_set_load(sky_partition_set *partition_set);
+
+int sky_partition_set_unload(sky_partition_set *partition_set);
+
+
+//--------------------------------------
+// Partition Management
+//--------------------------------------
+
+sky_timestamp_t sky_partition_set_get_period_start(
+    sky_partition_set *partition_set, sky_timestamp_t timestamp);
+
+int sky_partition_set_get_partition(sky_partition_set *partition_set,
+    sky_timestamp_t timestamp, bool create, sky_partition **ret);
+
+int sky_partition_set_expire(sky_partition_set *partition_set,
+    sky_timestamp_t expire_before, uint32_t *count);
+
+
+//--------------------------------------
+// Event Management
+//--------------------------------------
+
+int sky_partition_set_add_event(sky_partition_set *partition_set,
+    sky_event *event);
+
+
+//--------------------------------------
+// Path Lookup
+//--------------------------------------
+
+int sky_partition_set_find_path(sky_partition_set *partition_set,
+    sky_object_id_t object_id, sky_timestamp_t min_timestamp,
+    sky_timestamp_t max_timestamp, void ***paths, uint32_t *path_count);
+
+
+//--------------------------------------
+// Iteration
+//--------------------------------------
+
+void sky_partition_iterator_init(sky_partition_iterator *iterator);
+
+void sky_partition_iterator_uninit(sky_partition_iterator *iterator);
+
+int sky_partition_iterator_set_partition_set(sky_partition_iterator *iterator,
+    sky_partition_set *partition_set, sky_timestamp_t min_timestamp,
+    sky_timestamp_t max_timestamp);
+
+int sky_partition_iterator_next(sky_partition_iterator *iterator);
+
+#endif
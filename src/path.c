@@ -254,17 +254,20 @@ int sky_path_unpack(sky_path *path, void *ptr, size_t *sz)
     size_t event_data_length = *((sky_path_event_data_length_t*)ptr);
     ptr += sizeof(sky_path_event_data_length_t);
 
-    // Unpack events.
+    // Unpack events. Each event is created with the timestamp of the event
+    // before it in case it stores a timestamp delta.
     int index = 0;
+    sky_timestamp_t timestamp = 0;
     void *endptr = ptr + event_data_length;
     while(ptr < endptr) {
         path->event_count++;
         path->events = realloc(path->events, sizeof(sky_event*) * path->event_count);
         check_mem(path->events);
 
-        path->events[index] = sky_event_create(path->object_id, 0, 0);
+        path->events[index] = sky_event_create(path->object_id, timestamp, 0);
         rc = sky_event_unpack(path->events[index], ptr, &_sz);
         check(rc == 0, "Unable to unpack event at %p", ptr);
+        timestamp = path->events[index]->timestamp;
         ptr += _sz;
         
         index++;
@@ -322,12 +325,7 @@ int sky_path_get_event_stats(void *path_ptr, sky_event *event,
     sky_timestamp_t last_timestamp = SKY_TIMESTAMP_MIN;
     while(!cursor.eof) {
         // Retrieve timestamp from current event.
-        sky_timestamp_t timestamp;
-        sky_action_id_t action_id;
-        sky_event_data_length_t data_length;
-        size_t sz;
-        rc = sky_event_unpack_hdr(&timestamp, &action_id, &data_length, cursor.ptr, &sz);
-        check(rc == 0, "Unable to unpack current event header");
+        sky_timestamp_t timestamp = cursor.timestamp;
         
         // Check if event is inserted between the last event and current event.
         if(event != NULL && event->timestamp >= last_timestamp && event->timestamp < timestamp) {
@@ -394,7 +392,7 @@ int sky_path_add_event(sky_path *path, sky_event *event)
     check(path != NULL, "Path required");
     check(path->object_id != 0, "Path object id cannot be null");
     check(event != NULL, "Event required");
-    check(path->object_id == event->object_id, "Event object id (%d) does not match path object id (%d)", event->object_id, path->object_id);
+    check(path->object_id == event->object_id, "Event object id (%llu) does not match path object id (%llu)", (unsigned long long)event->object_id, (unsigned long long)path->object_id);
 
     // Raise error if event has already been added.
     unsigned int i;
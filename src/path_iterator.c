@@ -1,4 +1,6 @@
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "path_iterator.h"
 #include "block.h"
@@ -20,6 +22,20 @@ int sky_path_iterator_get_current_block(sky_path_iterator *iterator,
 
 int sky_path_iterator_fast_forward(sky_path_iterator *iterator);
 
+int sky_path_iterator_get_pruned_block_count(sky_path_iterator *iterator,
+    sky_block *block, uint32_t *count);
+
+int sky_path_iterator_prefetch(sky_path_iterator *iterator,
+    uint32_t max_block_index);
+
+int sky_path_iterator_pin(sky_path_iterator *iterator, sky_block *block);
+
+int sky_path_iterator_advise(void *ptr, size_t length);
+
+void sky_path_iterator_prefetch_path(void *ptr, size_t length);
+
+void sky_path_iterator_prefetch_next_block(sky_path_iterator *iterator);
+
 
 //==============================================================================
 //
@@ -69,11 +85,24 @@ void sky_path_iterator_init(sky_path_iterator *iterator)
 void sky_path_iterator_free(sky_path_iterator *iterator)
 {
     if(iterator) {
+        sky_path_iterator_uninit(iterator);
         iterator->data_file = NULL;
         free(iterator);
     }
 }
 
+// Releases the block that an iterator has pinned. Iterators on the stack
+// that stop before the end of a data file should be uninitialized.
+// 
+// iterator - The iterator.
+void sky_path_iterator_uninit(sky_path_iterator *iterator)
+{
+    if(iterator) {
+        sky_block_unpin(iterator->pinned_block);
+        iterator->pinned_block = NULL;
+    }
+}
+
 
 //--------------------------------------
 // Source
@@ -89,10 +118,15 @@ int sky_path_iterator_set_data_file(sky_path_iterator *iterator, sky_data_file *
 {
     int rc;
     check(iterator != NULL, "Iterator required");
+    sky_path_iterator_uninit(iterator);
     iterator->data_file   = data_file;
     iterator->block_index = 0;
+    iterator->end_block_index = 0;
+    iterator->prefetch_block_index = 0;
     iterator->block       = NULL;
     iterator->byte_index  = 0;
+    iterator->eof         = false;
+    iterator->batch_pending = false;
 
     // Position iterator at the first path.
     rc = sky_path_iterator_fast_forward(iterator);
@@ -114,10 +148,14 @@ int sky_path_iterator_set_block(sky_path_iterator *iterator, sky_block *block)
 {
     int rc;
     check(iterator != NULL, "Iterator required");
+    sky_path_iterator_uninit(iterator);
     iterator->block       = block;
     iterator->data_file   = NULL;
     iterator->block_index = 0;
+    iterator->end_block_index = 0;
     iterator->byte_index  = 0;
+    iterator->eof         = false;
+    iterator->batch_pending = false;
 
     // Position iterator at the first path.
     rc = sky_path_iterator_fast_forward(iterator);
@@ -130,6 +168,75 @@ error:
 }
 
 
+// Assigns a range of blocks in a data file as the source. Blocks are
+// referenced by their sorted position in the data file.
+// 
+// iterator          - The iterator.
+// data_file         - The data file to iterate over.
+// start_block_index - The position of the first block to iterate over.
+// end_block_index   - The position after the last block to iterate over.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_path_iterator_set_block_range(sky_path_iterator *iterator,
+                                      sky_data_file *data_file,
+                                      uint32_t start_block_index,
+                                      uint32_t end_block_index)
+{
+    int rc;
+    check(iterator != NULL, "Iterator required");
+    check(data_file != NULL, "Data file required");
+    check(start_block_index <= end_block_index, "Invalid block range");
+    sky_path_iterator_uninit(iterator);
+    iterator->data_file   = data_file;
+    iterator->block_index = start_block_index;
+    iterator->end_block_index = end_block_index;
+    iterator->prefetch_block_index = 0;
+    iterator->block       = NULL;
+    iterator->byte_index  = 0;
+    iterator->eof         = false;
+    iterator->batch_pending = false;
+
+    // An empty range has no paths.
+    if(start_block_index == end_block_index) {
+        iterator->block_index = 0;
+        iterator->eof = true;
+        return 0;
+    }
+
+    // Position iterator at the first path.
+    rc = sky_path_iterator_fast_forward(iterator);
+    check(rc == 0, "Unable to find next available path");
+
+    return 0;
+    
+error:
+    return -1;
+}
+
+
+// Limits the iterator to the blocks that contain events in a timestamp
+// range. The range must be set before the source is assigned.
+// 
+// iterator      - The iterator.
+// min_timestamp - The smallest timestamp in the range.
+// max_timestamp - The largest timestamp in the range.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_path_iterator_set_timestamp_range(sky_path_iterator *iterator,
+                                          sky_timestamp_t min_timestamp,
+                                          sky_timestamp_t max_timestamp)
+{
+    check(iterator != NULL, "Iterator required");
+    iterator->has_timestamp_range = true;
+    iterator->min_timestamp = min_timestamp;
+    iterator->max_timestamp = max_timestamp;
+    return 0;
+    
+error:
+    return -1;
+}
+
+
 //--------------------------------------
 // Block Management
 //--------------------------------------
@@ -260,6 +367,81 @@ error:
     return -1;
 }
 
+// Fills a batch with the paths that follow the previous batch. The paths of
+// a batch all come from the same block and the event data of each one is
+// prefetched as it is found. The iterator is left on the last path of the
+// batch so that its block stays pinned and moves past it when the next
+// batch is requested. A batch with no paths is returned once the iterator
+// reaches the end.
+// 
+// iterator - The iterator.
+// batch    - The batch to fill.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_path_iterator_next_batch(sky_path_iterator *iterator,
+                                 sky_path_iterator_batch *batch)
+{
+    int rc;
+    check(iterator != NULL, "Iterator required");
+    check(batch != NULL, "Batch required");
+    batch->count = 0;
+
+    // Move past the last path of the previous batch.
+    if(iterator->batch_pending) {
+        iterator->batch_pending = false;
+        rc = sky_path_iterator_next(iterator);
+        check(rc == 0, "Unable to move to next path");
+    }
+    if(iterator->eof) {
+        return 0;
+    }
+
+    // Resolve the block once for the whole batch.
+    sky_block *block;
+    void *block_ptr = NULL;
+    rc = sky_path_iterator_get_current_block(iterator, &block);
+    check(rc == 0, "Unable to retrieve current block");
+    rc = sky_block_get_ptr(block, &block_ptr);
+    check(rc == 0, "Unable to retrieve block pointer");
+    size_t block_size = block->data_file->block_size;
+    bool spanned = (iterator->data_file != NULL && block->spanned);
+
+    // Walk the path headers until the batch is full or the block ends.
+    while(true) {
+        void *ptr = block_ptr + iterator->byte_index;
+        size_t sz = sky_path_sizeof_raw(ptr);
+        batch->object_ids[batch->count] = iterator->current_object_id;
+        batch->paths[batch->count] = ptr;
+        batch->count++;
+        sky_path_iterator_prefetch_path(ptr, sz);
+
+        if(spanned || batch->count == SKY_PATH_ITERATOR_BATCH_SIZE) {
+            break;
+        }
+
+        // Stop on the last path of the block.
+        size_t byte_index = iterator->byte_index + sz;
+        void *next_ptr = block_ptr + byte_index;
+        if(byte_index + SKY_PATH_HEADER_LENGTH > block_size || *((sky_object_id_t*)next_ptr) == 0) {
+            sky_path_iterator_prefetch_next_block(iterator);
+            break;
+        }
+
+        iterator->byte_index = (uint32_t)byte_index;
+        iterator->current_object_id = *((sky_object_id_t*)next_ptr);
+        if(iterator->block != NULL) {
+            iterator->block_data_length = byte_index;
+        }
+    }
+    iterator->batch_pending = true;
+
+    return 0;
+    
+error:
+    if(batch) batch->count = 0;
+    return -1;
+}
+
 
 // Moves the iterator to the next available path if it is not currently on a
 // valid path. This can occur when the current location has null data or if
@@ -280,7 +462,11 @@ int sky_path_iterator_fast_forward(sky_path_iterator *iterator)
     while(true) {
         // If the block index is out of range then mark as EOF and exit.
         uint32_t max_block_index = (data_file != NULL ? data_file->block_count-1 : 0);
+        if(data_file != NULL && iterator->end_block_index > 0 && iterator->end_block_index-1 < max_block_index) {
+            max_block_index = iterator->end_block_index-1;
+        }
         if(iterator->block_index > max_block_index) {
+            sky_path_iterator_uninit(iterator);
             iterator->block_index = 0;
             iterator->byte_index  = 0;
             iterator->eof = true;
@@ -292,10 +478,31 @@ int sky_path_iterator_fast_forward(sky_path_iterator *iterator)
         void *block_end_ptr = NULL;
         rc = sky_path_iterator_get_current_block(iterator, &block);
         check(rc == 0, "Unable to retrieve current block");
+        if(data_file != NULL) {
+            rc = sky_path_iterator_pin(iterator, block);
+            check(rc == 0, "Unable to pin block");
+        }
         rc = sky_block_get_ptr(block, &block_end_ptr);
         check(rc == 0, "Unable to retrieve block pointer");
         block_end_ptr += block->data_file->block_size;
 
+        // Read ahead the blocks that follow a new block.
+        if(data_file != NULL && iterator->byte_index == 0) {
+            rc = sky_path_iterator_prefetch(iterator, max_block_index);
+            check(rc == 0, "Unable to prefetch blocks");
+        }
+
+        // Skip blocks that are outside the timestamp range.
+        if(iterator->has_timestamp_range && iterator->byte_index == 0) {
+            uint32_t pruned_count = 0;
+            rc = sky_path_iterator_get_pruned_block_count(iterator, block, &pruned_count);
+            check(rc == 0, "Unable to check block timestamp range");
+            if(pruned_count > 0) {
+                iterator->block_index += pruned_count;
+                continue;
+            }
+        }
+
         // If there is null data then move to the next block.
         void *ptr = NULL;
         rc = sky_path_iterator_get_ptr(iterator, &ptr);
@@ -320,3 +527,212 @@ int sky_path_iterator_fast_forward(sky_path_iterator *iterator)
 error:
     return -1;
 }
+
+// Calculates the number of blocks that can be skipped at the start of a
+// block because none of their events are in the iterator's timestamp range.
+// The blocks of a spanned path are skipped together so that the iterator
+// never starts in the middle of a span.
+// 
+// iterator - The iterator.
+// block    - The block the iterator is at the start of.
+// count    - A pointer to where the number of blocks to skip is returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_path_iterator_get_pruned_block_count(sky_path_iterator *iterator,
+                                             sky_block *block, uint32_t *count)
+{
+    int rc;
+    uint32_t i;
+    *count = 0;
+
+    // Single block iterators only prune their own block.
+    uint32_t span_count = 1;
+    if(iterator->data_file != NULL && block->spanned) {
+        rc = sky_block_get_span_count(block, &span_count);
+        check(rc == 0, "Unable to calculate span count");
+    }
+
+    // Keep the blocks if any of them overlap the range.
+    for(i=0; i<span_count; i++) {
+        sky_block *span_block = (i == 0 ? block : iterator->data_file->blocks[iterator->block_index+i]);
+        if(span_block->max_timestamp >= iterator->min_timestamp && span_block->min_timestamp <= iterator->max_timestamp) {
+            return 0;
+        }
+    }
+    
+    *count = span_count;
+    return 0;
+
+error:
+    *count = 0;
+    return -1;
+}
+
+
+//--------------------------------------
+// Prefetching
+//--------------------------------------
+
+// Advises the kernel to read the blocks after the current block. Blocks are
+// advised in sorted order up to the prefetch block count past the current
+// block. Blocks that have already been advised are not advised again and
+// blocks that are stored next to each other are advised with one call. If
+// the data file has a prefetcher the blocks are read by its I/O threads
+// instead.
+//
+// iterator        - The iterator.
+// max_block_index - The position of the last block in the iterator's range.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_path_iterator_prefetch(sky_path_iterator *iterator,
+                               uint32_t max_block_index)
+{
+    int rc;
+    void *ptr = NULL;
+    void *run_ptr = NULL;
+    size_t run_length = 0;
+    sky_data_file *data_file = iterator->data_file;
+
+    // Blocks up to the current block are already being read.
+    if(iterator->prefetch_block_index <= iterator->block_index) {
+        iterator->prefetch_block_index = iterator->block_index+1;
+    }
+
+    uint32_t end_block_index = iterator->block_index + SKY_PATH_ITERATOR_PREFETCH_BLOCK_COUNT;
+    if(end_block_index > max_block_index) {
+        end_block_index = max_block_index;
+    }
+
+    // Hand the blocks to the I/O threads if the data file has a prefetcher.
+    if(data_file->prefetcher != NULL) {
+        if(iterator->prefetch_block_index <= end_block_index) {
+            rc = sky_data_file_prefetch_blocks(data_file, data_file->blocks, iterator->prefetch_block_index, end_block_index+1);
+            check(rc == 0, "Unable to prefetch blocks");
+            iterator->prefetch_block_index = end_block_index+1;
+        }
+        return 0;
+    }
+
+    for(; iterator->prefetch_block_index <= end_block_index; iterator->prefetch_block_index++) {
+        rc = sky_block_get_raw_ptr(data_file->blocks[iterator->prefetch_block_index], &ptr);
+        check(rc == 0, "Unable to retrieve block pointer");
+
+        // Extend the current run if the block follows it on disk.
+        if(run_ptr != NULL && ptr == run_ptr + run_length) {
+            run_length += data_file->block_size;
+        }
+        else {
+            rc = sky_path_iterator_advise(run_ptr, run_length);
+            check(rc == 0, "Unable to advise blocks");
+            run_ptr = ptr;
+            run_length = data_file->block_size;
+        }
+    }
+
+    rc = sky_path_iterator_advise(run_ptr, run_length);
+    check(rc == 0, "Unable to advise blocks");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Advises the kernel that a range of mapped data will be needed soon. The
+// range is widened to page boundaries.
+//
+// ptr    - The start of the range.
+// length - The number of bytes in the range.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_path_iterator_advise(void *ptr, size_t length)
+{
+    if(ptr == NULL || length == 0) {
+        return 0;
+    }
+
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)ptr) & ~(page_size-1);
+    uintptr_t end = ((uintptr_t)ptr) + length;
+    int rc = madvise((void*)start, end - start, MADV_WILLNEED);
+    check(rc == 0, "Unable to advise block range");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Prefetches the start of a path into the CPU cache. Only the first few
+// cache lines are prefetched so that long paths do not push the rest of the
+// batch out of the cache.
+//
+// ptr    - A pointer to the path.
+// length - The length of the path in bytes.
+void sky_path_iterator_prefetch_path(void *ptr, size_t length)
+{
+    size_t offset;
+    size_t max_length = SKY_PATH_ITERATOR_PREFETCH_LINE_COUNT * SKY_PATH_ITERATOR_CACHE_LINE_SIZE;
+    if(length > max_length) {
+        length = max_length;
+    }
+    for(offset=0; offset<length; offset+=SKY_PATH_ITERATOR_CACHE_LINE_SIZE) {
+        __builtin_prefetch(ptr + offset, 0, 3);
+    }
+}
+
+// Prefetches the start of the block after the current block into the CPU
+// cache. Compressed blocks are skipped since their data is not read from the
+// data file.
+//
+// iterator - The iterator.
+void sky_path_iterator_prefetch_next_block(sky_path_iterator *iterator)
+{
+    sky_data_file *data_file = iterator->data_file;
+    if(data_file == NULL) {
+        return;
+    }
+
+    uint32_t block_index = iterator->block_index + 1;
+    if(block_index >= data_file->block_count || (iterator->end_block_index > 0 && block_index >= iterator->end_block_index)) {
+        return;
+    }
+
+    void *ptr = NULL;
+    sky_block *block = data_file->blocks[block_index];
+    if(block->compression != SKY_BLOCK_COMPRESSION_NONE || sky_block_get_raw_ptr(block, &ptr) != 0) {
+        return;
+    }
+    sky_path_iterator_prefetch_path(ptr, data_file->block_size);
+}
+
+
+//--------------------------------------
+// Pinning
+//--------------------------------------
+
+// Pins the block that the iterator is on so that the decompressed data of a
+// compressed block stays in the block cache while its paths are read. The
+// previously pinned block is unpinned.
+//
+// iterator - The iterator.
+// block    - The block the iterator is on.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_path_iterator_pin(sky_path_iterator *iterator, sky_block *block)
+{
+    int rc;
+    if(iterator->pinned_block == block) {
+        return 0;
+    }
+
+    sky_path_iterator_uninit(iterator);
+    rc = sky_block_pin(block);
+    check(rc == 0, "Unable to pin block #%d", block->index);
+    iterator->pinned_block = block;
+
+    return 0;
+
+error:
+    return -1;
+}
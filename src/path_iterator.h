@@ -24,12 +24,69 @@
 // The path iterator operates as a forward-only iterator. Jumping to the
 // previous path or jumping to a path by index is not allowed.
 //
+// An iterator over a data file can be limited to a range of blocks so that
+// several iterators can scan different parts of the same data file in
+// parallel. Ranges should start on a partition boundary returned by
+// `sky_data_file_get_partitions()` so that spanned paths are only visited by
+// one iterator. An iterator that starts a span finishes it even if the span
+// continues past the end of its range.
+//
+// An iterator can also be limited to a timestamp range. Blocks whose
+// timestamp range does not overlap it are pruned using the block headers
+// without reading their data. A spanned path is only pruned when none of its
+// blocks overlap the range. Events inside visited blocks are not filtered so
+// callers should still check each event or seek the cursor to the start of
+// the range.
+//
+// Blocks are visited in sorted order, which does not match the order they
+// are stored in once blocks have been split. While iterating over a data
+// file, the iterator asks the kernel to read ahead the next few blocks in
+// sorted order so that a scan does not wait on a page fault each time it
+// jumps to a block somewhere else in the file. Blocks that are next to each
+// other on disk are advised together. Compacting the data file stores the
+// blocks in sorted order again.
+//
+// An iterator over a data file pins the block it is on in the block cache so
+// that a compressed block stays decompressed while its paths are read. The
+// pin is released when the iterator moves on, reaches the end or is
+// uninitialized.
+//
+// Paths can also be read in batches with `sky_path_iterator_next_batch()`,
+// which returns the pointers of up to a batch size of paths from the current
+// block at once. The paths of a batch are found by walking the path headers
+// in the block without resolving the block again for each path. The event
+// data of each path in the batch is prefetched into the CPU cache as it is
+// found so that it is loading while the caller works through the earlier
+// paths. The start of the next block is prefetched once a batch reaches the
+// end of its block. The paths of a batch stay valid until the next batch is
+// requested. A spanned path is returned in a batch of its own. Batches
+// should not be mixed with calls to `sky_path_iterator_next()`.
+//
 // The path iterator does not currently support full consistency if events are
 // added or removed after the iterator has been created and before the iteration
 // is complete. The biggest issue is that a block split can cause paths to not
 // be counted. This will be fixed in a future version.
 
 
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of blocks after the current block to read ahead.
+#define SKY_PATH_ITERATOR_PREFETCH_BLOCK_COUNT 8
+
+// The largest number of paths returned in one batch.
+#define SKY_PATH_ITERATOR_BATCH_SIZE 16
+
+// The number of cache lines of each batched path to prefetch.
+#define SKY_PATH_ITERATOR_PREFETCH_LINE_COUNT 2
+
+// The size of a cache line used when prefetching.
+#define SKY_PATH_ITERATOR_CACHE_LINE_SIZE 64
+
+
 //==============================================================================
 //
 // Typedefs
@@ -40,12 +97,25 @@ typedef struct sky_path_iterator {
     sky_block *block;
     sky_data_file *data_file;
     uint32_t block_index;
+    uint32_t end_block_index;
     uint32_t byte_index;
     bool eof;
     sky_object_id_t current_object_id;
     size_t block_data_length;
+    bool has_timestamp_range;
+    sky_timestamp_t min_timestamp;
+    sky_timestamp_t max_timestamp;
+    uint32_t prefetch_block_index;
+    sky_block *pinned_block;
+    bool batch_pending;
 } sky_path_iterator;
 
+typedef struct sky_path_iterator_batch {
+    uint32_t count;
+    sky_object_id_t object_ids[SKY_PATH_ITERATOR_BATCH_SIZE];
+    void *paths[SKY_PATH_ITERATOR_BATCH_SIZE];
+} sky_path_iterator_batch;
+
 
 //==============================================================================
 //
@@ -65,6 +135,8 @@ void sky_path_iterator_init(sky_path_iterator *iterator);
 
 void sky_path_iterator_free(sky_path_iterator *iterator);
 
+void sky_path_iterator_uninit(sky_path_iterator *iterator);
+
 
 //--------------------------------------
 // Source
@@ -76,6 +148,13 @@ int sky_path_iterator_set_data_file(sky_path_iterator *iterator,
 int sky_path_iterator_set_block(sky_path_iterator *iterator,
     sky_block *block);
 
+int sky_path_iterator_set_block_range(sky_path_iterator *iterator,
+    sky_data_file *data_file, uint32_t start_block_index,
+    uint32_t end_block_index);
+
+int sky_path_iterator_set_timestamp_range(sky_path_iterator *iterator,
+    sky_timestamp_t min_timestamp, sky_timestamp_t max_timestamp);
+
 
 //--------------------------------------
 // Iteration
@@ -85,5 +164,8 @@ int sky_path_iterator_get_ptr(sky_path_iterator *iterator, void **ptr);
 
 int sky_path_iterator_next(sky_path_iterator *iterator);
 
+int sky_path_iterator_next_batch(sky_path_iterator *iterator,
+    sky_path_iterator_batch *batch);
+
 
 #endif
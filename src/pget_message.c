@@ -114,17 +114,16 @@ error:
 //
 // message - The message.
 // table   - The table to apply the message to.
-// output  - The output stream to write to.
+// output  - The buffer to write the response to.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_pget_message_process(sky_pget_message *message, sky_table *table,
-                             FILE *output)
+                             sky_buffer *output)
 {
     int rc;
-    size_t sz;
     check(message != NULL, "Message required");
     check(table != NULL, "Table required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
 
     struct tagbstring status_str = bsStatic("status");
     struct tagbstring ok_str = bsStatic("ok");
@@ -137,18 +136,16 @@ int sky_pget_message_process(sky_pget_message *message, sky_table *table,
     
     // Return.
     //   {status:"OK", property:{...}}
-    minipack_fwrite_map(output, 2, &sz);
-    check(sz > 0, "Unable to write output");
-    check(sky_minipack_fwrite_bstring(output, &status_str) == 0, "Unable to write status key");
-    check(sky_minipack_fwrite_bstring(output, &ok_str) == 0, "Unable to write status value");
-    check(sky_minipack_fwrite_bstring(output, &property_str) == 0, "Unable to write property key");
+    check(sky_buffer_pack_map(output, 2) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    check(sky_buffer_pack_bstring(output, &property_str) == 0, "Unable to write property key");
     
     if(property != NULL) {
-        check(sky_property_pack(property, output) == 0, "Unable to write property value");
+        check(sky_property_pack_buffer(property, output) == 0, "Unable to write property value");
     }
     else {
-        minipack_fwrite_nil(output, &sz);
-        check(sz > 0, "Unable to write null property value");
+        check(sky_buffer_pack_nil(output) == 0, "Unable to write null property value");
     }
     
     return 0;
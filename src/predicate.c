@@ -0,0 +1,482 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "predicate.h"
+#include "minipack.h"
+#include "minipack_batch.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+bool sky_predicate_eval_true(sky_predicate *predicate,
+    sky_action_id_t action_id, sky_timestamp_t timestamp, void *data_ptr,
+    uint32_t data_length);
+
+bool sky_predicate_eval_false(sky_predicate *predicate,
+    sky_action_id_t action_id, sky_timestamp_t timestamp, void *data_ptr,
+    uint32_t data_length);
+
+bool sky_predicate_eval_action(sky_predicate *predicate,
+    sky_action_id_t action_id, sky_timestamp_t timestamp, void *data_ptr,
+    uint32_t data_length);
+
+bool sky_predicate_eval_timestamp(sky_predicate *predicate,
+    sky_action_id_t action_id, sky_timestamp_t timestamp, void *data_ptr,
+    uint32_t data_length);
+
+bool sky_predicate_eval_header(sky_predicate *predicate,
+    sky_action_id_t action_id, sky_timestamp_t timestamp, void *data_ptr,
+    uint32_t data_length);
+
+bool sky_predicate_eval_data(sky_predicate *predicate,
+    sky_action_id_t action_id, sky_timestamp_t timestamp, void *data_ptr,
+    uint32_t data_length);
+
+void sky_predicate_intersect(int64_t *min, int64_t *max, int64_t filter_min,
+    int64_t filter_max);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a predicate that accepts every event.
+//
+// Returns a reference to the new predicate if successful. Otherwise returns
+// null.
+sky_predicate *sky_predicate_create()
+{
+    sky_predicate *predicate = NULL;
+    predicate = calloc(1, sizeof(sky_predicate)); check_mem(predicate);
+    predicate->eval = sky_predicate_eval_true;
+    return predicate;
+
+error:
+    sky_predicate_free(predicate);
+    return NULL;
+}
+
+// Removes a predicate from memory.
+//
+// predicate - The predicate to free.
+void sky_predicate_free(sky_predicate *predicate)
+{
+    if(predicate) {
+        free(predicate->property_ranges);
+        free(predicate);
+    }
+}
+
+
+//--------------------------------------
+// Compilation
+//--------------------------------------
+
+// Compiles a list of filters into the predicate. An event matches the
+// predicate when it is accepted by every filter.
+//
+// predicate    - The predicate.
+// filters      - The filters to compile.
+// filter_count - The number of filters.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_predicate_compile(sky_predicate *predicate, sky_query_filter *filters,
+                          uint32_t filter_count)
+{
+    uint32_t i;
+    check(predicate != NULL, "Predicate required");
+    check(filter_count == 0 || filters != NULL, "Filters required");
+
+    // Reset the predicate to accept everything.
+    free(predicate->property_ranges);
+    predicate->property_ranges = NULL;
+    predicate->property_count = 0;
+    memset(predicate->property_slots, 0, sizeof(predicate->property_slots));
+    predicate->min_action_id = predicate->min_timestamp = INT64_MIN;
+    predicate->max_action_id = predicate->max_timestamp = INT64_MAX;
+
+    // Intersect the ranges of each field.
+    bool uses_action = false, uses_timestamp = false;
+    for(i=0; i<filter_count; i++) {
+        sky_query_filter *filter = &filters[i];
+        switch(filter->field) {
+            case SKY_QUERY_FIELD_ACTION: {
+                sky_predicate_intersect(&predicate->min_action_id, &predicate->max_action_id, filter->min, filter->max);
+                uses_action = true;
+                break;
+            }
+            case SKY_QUERY_FIELD_TIMESTAMP: {
+                sky_predicate_intersect(&predicate->min_timestamp, &predicate->max_timestamp, filter->min, filter->max);
+                uses_timestamp = true;
+                break;
+            }
+            case SKY_QUERY_FIELD_PROPERTY: {
+                uint8_t *slot = &predicate->property_slots[(uint8_t)filter->property_id];
+                if(*slot == 0) {
+                    check(predicate->property_count < UINT8_MAX, "Too many property filters");
+                    predicate->property_ranges = realloc(predicate->property_ranges, sizeof(*predicate->property_ranges) * (predicate->property_count+1));
+                    check_mem(predicate->property_ranges);
+                    predicate->property_ranges[predicate->property_count].property_id = filter->property_id;
+                    predicate->property_ranges[predicate->property_count].min = INT64_MIN;
+                    predicate->property_ranges[predicate->property_count].max = INT64_MAX;
+                    predicate->property_count++;
+                    *slot = predicate->property_count;
+                }
+                sky_predicate_range *range = &predicate->property_ranges[*slot-1];
+                sky_predicate_intersect(&range->min, &range->max, filter->min, filter->max);
+                break;
+            }
+        }
+    }
+
+    // A predicate with an empty range can never match.
+    bool empty = (predicate->min_action_id > predicate->max_action_id || predicate->min_timestamp > predicate->max_timestamp);
+    for(i=0; i<predicate->property_count; i++) {
+        empty = empty || (predicate->property_ranges[i].min > predicate->property_ranges[i].max);
+    }
+
+    // Choose the evaluator for the fields that are used.
+    if(empty) {
+        predicate->eval = sky_predicate_eval_false;
+    }
+    else if(predicate->property_count > 0) {
+        predicate->eval = sky_predicate_eval_data;
+    }
+    else if(uses_action && uses_timestamp) {
+        predicate->eval = sky_predicate_eval_header;
+    }
+    else if(uses_action) {
+        predicate->eval = sky_predicate_eval_action;
+    }
+    else if(uses_timestamp) {
+        predicate->eval = sky_predicate_eval_timestamp;
+    }
+    else {
+        predicate->eval = sky_predicate_eval_true;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Narrows a range to the part that overlaps a filter's range.
+//
+// min        - A pointer to the smallest value of the range.
+// max        - A pointer to the largest value of the range.
+// filter_min - The smallest value accepted by the filter.
+// filter_max - The largest value accepted by the filter.
+void sky_predicate_intersect(int64_t *min, int64_t *max, int64_t filter_min,
+                             int64_t filter_max)
+{
+    if(filter_min > *min) {
+        *min = filter_min;
+    }
+    if(filter_max < *max) {
+        *max = filter_max;
+    }
+}
+
+
+//--------------------------------------
+// Evaluation
+//--------------------------------------
+
+// Checks whether the predicate reads the data section of events.
+//
+// predicate - The predicate.
+//
+// Returns true if the predicate tests properties.
+bool sky_predicate_uses_data(sky_predicate *predicate)
+{
+    return (predicate->eval == sky_predicate_eval_data);
+}
+
+// Checks whether any event in a block could match the predicate based on
+// the block's timestamp range and the zones of the filtered properties. A
+// block without a numeric value for a filtered property cannot match.
+//
+// predicate - The predicate.
+// block     - The block.
+//
+// Returns false if no event in the block can match.
+bool sky_predicate_may_match_block(sky_predicate *predicate, sky_block *block)
+{
+    uint32_t i;
+    if(predicate->eval == sky_predicate_eval_false) {
+        return false;
+    }
+    if(block->max_timestamp < predicate->min_timestamp || block->min_timestamp > predicate->max_timestamp) {
+        return false;
+    }
+
+    // Blocks whose zone map cannot be built are scanned.
+    for(i=0; i<predicate->property_count; i++) {
+        sky_predicate_range *range = &predicate->property_ranges[i];
+        sky_block_zone *zone = NULL;
+        if(sky_block_get_zone(block, range->property_id, &zone) != 0) {
+            return true;
+        }
+        if(zone == NULL || zone->max < range->min || zone->min > range->max) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Checks whether a path may contain an event that matches a predicate. Only
+// the timestamp and action ranges are compared to the summary of the path.
+// Narrow action ranges are tested against the action mask of the path.
+// Ranges that include events without an action are never rejected.
+//
+// predicate - The predicate.
+// entry     - The directory entry of the path.
+//
+// Returns true if the path has to be scanned.
+bool sky_predicate_may_match_path(sky_predicate *predicate,
+                                  sky_block_directory_entry *entry)
+{
+    int64_t action_id;
+    if(predicate->eval == sky_predicate_eval_false) {
+        return false;
+    }
+    if(entry->max_timestamp < predicate->min_timestamp || entry->min_timestamp > predicate->max_timestamp) {
+        return false;
+    }
+    if(predicate->min_action_id > 0 && predicate->max_action_id - predicate->min_action_id < 64) {
+        uint64_t mask = 0;
+        for(action_id=predicate->min_action_id; action_id<=predicate->max_action_id; action_id++) {
+            mask |= sky_block_action_bit(action_id);
+        }
+        return (entry->action_mask & mask) != 0;
+    }
+    return true;
+}
+
+// Decodes a MessagePack integer, boolean or float value. Booleans are
+// decoded to 0 or 1 and floats are truncated.
+//
+// ptr   - A pointer to the value.
+// value - A pointer to where the value should be returned.
+//
+// Returns true if the value is numeric.
+bool sky_predicate_unpack_value(void *ptr, int64_t *value)
+{
+    size_t sz;
+    uint8_t type = *((uint8_t*)ptr);
+
+    // Fixnums are by far the most common values so decode them inline.
+    if(type <= 0x7F) {
+        *value = type;
+        return true;
+    }
+    else if(type >= 0xE0) {
+        *value = (int8_t)type;
+        return true;
+    }
+    else if(minipack_is_bool(ptr)) {
+        *value = (minipack_is_true(ptr) ? 1 : 0);
+        return true;
+    }
+    else if(minipack_is_double(ptr)) {
+        *value = (int64_t)minipack_unpack_double(ptr, &sz);
+        return true;
+    }
+    else if(minipack_is_float(ptr)) {
+        *value = (int64_t)minipack_unpack_float(ptr, &sz);
+        return true;
+    }
+
+    *value = minipack_unpack_int(ptr, &sz);
+    return (sz > 0);
+}
+
+
+//--------------------------------------
+// Evaluators
+//--------------------------------------
+
+// Accepts every event.
+//
+// predicate   - The predicate.
+// action_id   - The action id of the event.
+// timestamp   - The timestamp of the event.
+// data_ptr    - A pointer to the data section of the event or NULL.
+// data_length - The length of the data section.
+//
+// Returns true.
+bool sky_predicate_eval_true(sky_predicate *predicate,
+                             sky_action_id_t action_id,
+                             sky_timestamp_t timestamp, void *data_ptr,
+                             uint32_t data_length)
+{
+    (void)predicate;
+    (void)action_id;
+    (void)timestamp;
+    (void)data_ptr;
+    (void)data_length;
+    return true;
+}
+
+// Rejects every event.
+//
+// predicate   - The predicate.
+// action_id   - The action id of the event.
+// timestamp   - The timestamp of the event.
+// data_ptr    - A pointer to the data section of the event or NULL.
+// data_length - The length of the data section.
+//
+// Returns false.
+bool sky_predicate_eval_false(sky_predicate *predicate,
+                              sky_action_id_t action_id,
+                              sky_timestamp_t timestamp, void *data_ptr,
+                              uint32_t data_length)
+{
+    (void)predicate;
+    (void)action_id;
+    (void)timestamp;
+    (void)data_ptr;
+    (void)data_length;
+    return false;
+}
+
+// Tests the action id of an event.
+//
+// predicate   - The predicate.
+// action_id   - The action id of the event.
+// timestamp   - The timestamp of the event.
+// data_ptr    - A pointer to the data section of the event or NULL.
+// data_length - The length of the data section.
+//
+// Returns true if the event matches.
+bool sky_predicate_eval_action(sky_predicate *predicate,
+                               sky_action_id_t action_id,
+                               sky_timestamp_t timestamp, void *data_ptr,
+                               uint32_t data_length)
+{
+    (void)timestamp;
+    (void)data_ptr;
+    (void)data_length;
+    return (action_id >= predicate->min_action_id && action_id <= predicate->max_action_id);
+}
+
+// Tests the timestamp of an event.
+//
+// predicate   - The predicate.
+// action_id   - The action id of the event.
+// timestamp   - The timestamp of the event.
+// data_ptr    - A pointer to the data section of the event or NULL.
+// data_length - The length of the data section.
+//
+// Returns true if the event matches.
+bool sky_predicate_eval_timestamp(sky_predicate *predicate,
+                                  sky_action_id_t action_id,
+                                  sky_timestamp_t timestamp, void *data_ptr,
+                                  uint32_t data_length)
+{
+    (void)action_id;
+    (void)data_ptr;
+    (void)data_length;
+    return (timestamp >= predicate->min_timestamp && timestamp <= predicate->max_timestamp);
+}
+
+// Tests the action id and the timestamp of an event.
+//
+// predicate   - The predicate.
+// action_id   - The action id of the event.
+// timestamp   - The timestamp of the event.
+// data_ptr    - A pointer to the data section of the event or NULL.
+// data_length - The length of the data section.
+//
+// Returns true if the event matches.
+bool sky_predicate_eval_header(sky_predicate *predicate,
+                               sky_action_id_t action_id,
+                               sky_timestamp_t timestamp, void *data_ptr,
+                               uint32_t data_length)
+{
+    (void)data_ptr;
+    (void)data_length;
+    return (action_id >= predicate->min_action_id && action_id <= predicate->max_action_id &&
+            timestamp >= predicate->min_timestamp && timestamp <= predicate->max_timestamp);
+}
+
+// Tests the action id, the timestamp and the properties of an event. The
+// data section is read in a single pass and the event is rejected as soon as
+// a property is out of range. Events missing a tested property are rejected.
+//
+// predicate   - The predicate.
+// action_id   - The action id of the event.
+// timestamp   - The timestamp of the event.
+// data_ptr    - A pointer to the data section of the event or NULL.
+// data_length - The length of the data section.
+//
+// Returns true if the event matches.
+bool sky_predicate_eval_data(sky_predicate *predicate,
+                             sky_action_id_t action_id,
+                             sky_timestamp_t timestamp, void *data_ptr,
+                             uint32_t data_length)
+{
+    if(!sky_predicate_eval_header(predicate, action_id, timestamp, data_ptr, data_length)) {
+        return false;
+    }
+
+    int64_t value;
+    uint32_t i;
+    uint32_t match_count = 0;
+
+    // Values in the fixed section are loaded directly.
+    uint32_t fixed_count = sky_event_data_get_fixed_count(data_ptr, data_length);
+    for(i=0; i<fixed_count; i++) {
+        uint8_t slot = predicate->property_slots[(uint8_t)sky_event_data_fixed_key(data_ptr, i)];
+        if(slot != 0) {
+            sky_event_data_view view;
+            sky_event_data_get_fixed_view(data_ptr, i, &view);
+            sky_predicate_range *range = &predicate->property_ranges[slot-1];
+            if(!sky_event_data_view_get_numeric_value(&view, &value) || value < range->min || value > range->max) {
+                return false;
+            }
+            if(++match_count == predicate->property_count) {
+                return true;
+            }
+        }
+    }
+
+    void *ptr = data_ptr + sky_event_data_get_fixed_length(data_ptr, data_length);
+    void *end_ptr = data_ptr + data_length;
+    while(ptr != NULL && ptr < end_ptr) {
+        uint8_t slot = predicate->property_slots[*((uint8_t*)ptr)];
+        ptr += sizeof(sky_property_id_t);
+
+        if(slot != 0) {
+            sky_predicate_range *range = &predicate->property_ranges[slot-1];
+            if(!sky_predicate_unpack_value(ptr, &value) || value < range->min || value > range->max) {
+                return false;
+            }
+            if(++match_count == predicate->property_count) {
+                return true;
+            }
+        }
+
+        size_t sz = sky_minipack_batch_fast_sizeof_elem(ptr);
+        if(sz == 0) {
+            break;
+        }
+        ptr += sz;
+    }
+
+    return false;
+}
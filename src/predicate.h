@@ -0,0 +1,118 @@
+#ifndef _predicate_h
+#define _predicate_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+typedef struct sky_predicate sky_predicate;
+
+#include "types.h"
+#include "block.h"
+#include "query.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A predicate is the compiled form of the filters of a query. Filters are
+// compiled once per query so that each event is tested without looking at
+// the plan again:
+//
+//   * Ranges on the same field are intersected so that each field is only
+//     tested once. A predicate with an empty range never matches.
+//
+//   * An evaluator specialized for the fields that are used is chosen so
+//     that predicates on actions and timestamps never touch event data.
+//
+//   * Property ranges are indexed by property id so that the data section
+//     of an event is read in a single pass. MessagePack values are decoded
+//     directly from the raw event without unpacking the event.
+//
+// The timestamp range is also used to skip blocks that cannot contain a
+// matching event, and so are the property ranges, which are compared to the
+// zone map of each block. Paths are skipped by comparing the timestamp and
+// action ranges to the summary of each path in the block directory.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of distinct property ids.
+#define SKY_PREDICATE_PROPERTY_SLOT_COUNT 256
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// Tests an event against a predicate.
+typedef bool (*sky_predicate_eval_func)(sky_predicate *predicate,
+    sky_action_id_t action_id, sky_timestamp_t timestamp, void *data_ptr,
+    uint32_t data_length);
+
+// The range of accepted values of a property.
+typedef struct sky_predicate_range {
+    sky_property_id_t property_id;
+    int64_t min;
+    int64_t max;
+} sky_predicate_range;
+
+// Property slots map a property id to the index of its range plus one. A
+// slot of zero means the property is not tested.
+struct sky_predicate {
+    sky_predicate_eval_func eval;
+    int64_t min_action_id;
+    int64_t max_action_id;
+    int64_t min_timestamp;
+    int64_t max_timestamp;
+    uint8_t property_slots[SKY_PREDICATE_PROPERTY_SLOT_COUNT];
+    sky_predicate_range *property_ranges;
+    uint32_t property_count;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_predicate *sky_predicate_create();
+
+void sky_predicate_free(sky_predicate *predicate);
+
+
+//--------------------------------------
+// Compilation
+//--------------------------------------
+
+int sky_predicate_compile(sky_predicate *predicate, sky_query_filter *filters,
+    uint32_t filter_count);
+
+
+//--------------------------------------
+// Evaluation
+//--------------------------------------
+
+bool sky_predicate_uses_data(sky_predicate *predicate);
+
+bool sky_predicate_may_match_block(sky_predicate *predicate, sky_block *block);
+
+bool sky_predicate_may_match_path(sky_predicate *predicate,
+    sky_block_directory_entry *entry);
+
+bool sky_predicate_unpack_value(void *ptr, int64_t *value);
+
+#endif
@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "prefetcher.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+void *sky_prefetcher_run(void *arg);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a prefetcher with a number of I/O threads.
+//
+// thread_count - The number of ranges that are read at once.
+//
+// Returns a reference to the new prefetcher if successful. Otherwise returns
+// null.
+sky_prefetcher *sky_prefetcher_create(uint32_t thread_count)
+{
+    sky_prefetcher *prefetcher = NULL;
+    check(thread_count > 0, "At least one I/O thread required");
+    prefetcher = calloc(1, sizeof(sky_prefetcher)); check_mem(prefetcher);
+    prefetcher->thread_count = thread_count;
+    prefetcher->threads = calloc(thread_count, sizeof(*prefetcher->threads));
+    check_mem(prefetcher->threads);
+    pthread_mutex_init(&prefetcher->mutex, NULL);
+    pthread_cond_init(&prefetcher->cond, NULL);
+    return prefetcher;
+
+error:
+    if(prefetcher) free(prefetcher->threads);
+    free(prefetcher);
+    return NULL;
+}
+
+// Removes a prefetcher from memory. The prefetcher must be stopped first.
+//
+// prefetcher - The prefetcher to free.
+void sky_prefetcher_free(sky_prefetcher *prefetcher)
+{
+    if(prefetcher) {
+        free(prefetcher->threads);
+        prefetcher->threads = NULL;
+        pthread_mutex_destroy(&prefetcher->mutex);
+        pthread_cond_destroy(&prefetcher->cond);
+        free(prefetcher);
+    }
+}
+
+
+//--------------------------------------
+// State
+//--------------------------------------
+
+// Starts the I/O threads of the prefetcher.
+//
+// prefetcher - The prefetcher.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_prefetcher_start(sky_prefetcher *prefetcher)
+{
+    int rc;
+    check(prefetcher != NULL, "Prefetcher required");
+    check(!prefetcher->running, "Prefetcher already running");
+
+    prefetcher->running = true;
+    for(; prefetcher->started_count<prefetcher->thread_count; prefetcher->started_count++) {
+        rc = pthread_create(&prefetcher->threads[prefetcher->started_count], NULL, sky_prefetcher_run, prefetcher);
+        check(rc == 0, "Unable to create I/O thread");
+    }
+
+    return 0;
+
+error:
+    sky_prefetcher_stop(prefetcher);
+    return -1;
+}
+
+// Stops the I/O threads of the prefetcher. Requests that have not been
+// read yet are dropped.
+//
+// prefetcher - The prefetcher.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_prefetcher_stop(sky_prefetcher *prefetcher)
+{
+    uint32_t i;
+    check(prefetcher != NULL, "Prefetcher required");
+
+    pthread_mutex_lock(&prefetcher->mutex);
+    prefetcher->running = false;
+    prefetcher->request_count = 0;
+    pthread_cond_broadcast(&prefetcher->cond);
+    pthread_mutex_unlock(&prefetcher->mutex);
+
+    for(i=0; i<prefetcher->started_count; i++) {
+        pthread_join(prefetcher->threads[i], NULL);
+    }
+    prefetcher->started_count = 0;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Requests
+//--------------------------------------
+
+// Queues a range of mapped data to be read by one of the I/O threads. The
+// request is dropped if the queue is full or the prefetcher is stopped.
+//
+// prefetcher - The prefetcher.
+// ptr        - The start of the range.
+// length     - The number of bytes in the range.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_prefetcher_submit(sky_prefetcher *prefetcher, void *ptr,
+                          size_t length)
+{
+    check(prefetcher != NULL, "Prefetcher required");
+    if(ptr == NULL || length == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&prefetcher->mutex);
+    if(prefetcher->running && prefetcher->request_count < SKY_PREFETCHER_QUEUE_SIZE) {
+        uint32_t index = (prefetcher->head + prefetcher->request_count) % SKY_PREFETCHER_QUEUE_SIZE;
+        prefetcher->requests[index].ptr = ptr;
+        prefetcher->requests[index].length = length;
+        prefetcher->request_count++;
+        pthread_cond_signal(&prefetcher->cond);
+    }
+    else {
+        prefetcher->dropped_count++;
+    }
+    pthread_mutex_unlock(&prefetcher->mutex);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Reads a range of mapped data into memory and fills in its page tables
+// where the kernel supports it. The range is widened to page boundaries.
+// This blocks until the range has been read.
+//
+// ptr    - The start of the range.
+// length - The number of bytes in the range.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_prefetcher_read(void *ptr, size_t length)
+{
+    if(ptr == NULL || length == 0) {
+        return 0;
+    }
+
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)ptr) & ~(page_size-1);
+    uintptr_t end = ((uintptr_t)ptr) + length;
+
+#if POPULATE_AVAILABLE
+    if(madvise((void*)start, end - start, MADV_POPULATE_READ) == 0) {
+        return 0;
+    }
+#endif
+    // Failures are not logged since the range may have been unmapped.
+    return (madvise((void*)start, end - start, MADV_WILLNEED) == 0 ? 0 : -1);
+}
+
+// The main loop of an I/O thread. Ranges are read in the order they were
+// submitted until the prefetcher is stopped. Ranges that can no longer be
+// read are ignored.
+//
+// arg - The prefetcher.
+//
+// Returns NULL.
+void *sky_prefetcher_run(void *arg)
+{
+    sky_prefetcher *prefetcher = (sky_prefetcher*)arg;
+
+    pthread_mutex_lock(&prefetcher->mutex);
+    while(prefetcher->running) {
+        if(prefetcher->request_count == 0) {
+            pthread_cond_wait(&prefetcher->cond, &prefetcher->mutex);
+            continue;
+        }
+        sky_prefetch_request request = prefetcher->requests[prefetcher->head];
+        prefetcher->head = (prefetcher->head + 1) % SKY_PREFETCHER_QUEUE_SIZE;
+        prefetcher->request_count--;
+        pthread_mutex_unlock(&prefetcher->mutex);
+
+        sky_prefetcher_read(request.ptr, request.length);
+
+        pthread_mutex_lock(&prefetcher->mutex);
+    }
+    pthread_mutex_unlock(&prefetcher->mutex);
+
+    return NULL;
+}
@@ -0,0 +1,102 @@
+#ifndef _prefetcher_h
+#define _prefetcher_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+typedef struct sky_prefetcher sky_prefetcher;
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A prefetcher reads mapped data into memory on its own pool of I/O threads
+// so that scans over data that is not in memory do not stall on one page
+// fault at a time. Scans submit the ranges of the blocks they are about to
+// read and carry on with the blocks they already have. Each I/O thread
+// fills in the pages and page tables of one range at a time, so a pool of
+// threads keeps as many reads in flight as it has threads and the device
+// sees a deep queue instead of a single fault.
+//
+// The mappings remain the cache. The prefetcher only touches them through
+// madvise() so a range that was unmapped before it was read is skipped
+// instead of faulting. Where the kernel cannot fill in page tables the
+// pages are only read into the page cache. Requests are hints, and when
+// the queue is full new requests are dropped.
+//
+// The prefetcher is shared by every table of a server and is only used when
+// the server is started with I/O threads.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of ranges that can wait to be read.
+#define SKY_PREFETCHER_QUEUE_SIZE 1024
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef struct sky_prefetch_request {
+    void *ptr;
+    size_t length;
+} sky_prefetch_request;
+
+struct sky_prefetcher {
+    uint32_t thread_count;
+    pthread_t *threads;
+    uint32_t started_count;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool running;
+    sky_prefetch_request requests[SKY_PREFETCHER_QUEUE_SIZE];
+    uint32_t head;
+    uint32_t request_count;
+    uint64_t dropped_count;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_prefetcher *sky_prefetcher_create(uint32_t thread_count);
+
+void sky_prefetcher_free(sky_prefetcher *prefetcher);
+
+//--------------------------------------
+// State
+//--------------------------------------
+
+int sky_prefetcher_start(sky_prefetcher *prefetcher);
+
+int sky_prefetcher_stop(sky_prefetcher *prefetcher);
+
+//--------------------------------------
+// Requests
+//--------------------------------------
+
+int sky_prefetcher_submit(sky_prefetcher *prefetcher, void *ptr,
+    size_t length);
+
+int sky_prefetcher_read(void *ptr, size_t length);
+
+#endif
@@ -94,6 +94,10 @@ size_t sky_property_sizeof(sky_property *property)
     sz += blength(property->data_type);
     sz += minipack_sizeof_raw(strlen("name")) + strlen("name");
     sz += blength(property->name);
+    if(property->fixed) {
+        sz += minipack_sizeof_raw(strlen("fixed")) + strlen("fixed");
+        sz += minipack_sizeof_bool();
+    }
     return sz;
 }
 
@@ -114,13 +118,14 @@ int sky_property_pack(sky_property *property, FILE *file)
     struct tagbstring type_str = bsStatic("type");
     struct tagbstring data_type_str = bsStatic("dataType");
     struct tagbstring name_str = bsStatic("name");
+    struct tagbstring fixed_str = bsStatic("fixed");
 
     // Update the type just in case.
     rc = sky_property_update_type(property);
     check(rc == 0, "Unable to update property type");
 
     // Map
-    minipack_fwrite_map(file, 4, &sz);
+    minipack_fwrite_map(file, (property->fixed ? 5 : 4), &sz);
     check(sz > 0, "Unable to write map");
     
     // ID
@@ -141,6 +146,66 @@ int sky_property_pack(sky_property *property, FILE *file)
     check(sky_minipack_fwrite_bstring(file, &name_str) == 0, "Unable to write name key");
     check(sky_minipack_fwrite_bstring(file, property->name) == 0, "Unable to write name value");
 
+    // Fixed
+    if(property->fixed) {
+        check(sky_minipack_fwrite_bstring(file, &fixed_str) == 0, "Unable to write fixed key");
+        minipack_fwrite_bool(file, property->fixed, &sz);
+        check(sz > 0, "Unable to write fixed value");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes a property to a buffer.
+//
+// property - The property.
+// buffer   - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_property_pack_buffer(sky_property *property, sky_buffer *buffer)
+{
+    int rc;
+    check(property != NULL, "Property required");
+    check(buffer != NULL, "Buffer required");
+
+    struct tagbstring id_str = bsStatic("id");
+    struct tagbstring type_str = bsStatic("type");
+    struct tagbstring data_type_str = bsStatic("dataType");
+    struct tagbstring name_str = bsStatic("name");
+    struct tagbstring fixed_str = bsStatic("fixed");
+
+    // Update the type just in case.
+    rc = sky_property_update_type(property);
+    check(rc == 0, "Unable to update property type");
+
+    // Map
+    check(sky_buffer_pack_map(buffer, (property->fixed ? 5 : 4)) == 0, "Unable to write map");
+
+    // ID
+    check(sky_buffer_pack_bstring(buffer, &id_str) == 0, "Unable to write id key");
+    check(sky_buffer_pack_int(buffer, property->id) == 0, "Unable to write id value");
+
+    // Type
+    check(sky_buffer_pack_bstring(buffer, &type_str) == 0, "Unable to write type key");
+    check(sky_buffer_pack_uint(buffer, property->type) == 0, "Unable to write type value");
+
+    // Data Type
+    check(sky_buffer_pack_bstring(buffer, &data_type_str) == 0, "Unable to write data type key");
+    check(sky_buffer_pack_bstring(buffer, property->data_type) == 0, "Unable to write data type value");
+
+    // Name
+    check(sky_buffer_pack_bstring(buffer, &name_str) == 0, "Unable to write name key");
+    check(sky_buffer_pack_bstring(buffer, property->name) == 0, "Unable to write name value");
+
+    // Fixed
+    if(property->fixed) {
+        check(sky_buffer_pack_bstring(buffer, &fixed_str) == 0, "Unable to write fixed key");
+        check(sky_buffer_pack_bool(buffer, property->fixed) == 0, "Unable to write fixed value");
+    }
+
     return 0;
 
 error:
@@ -188,6 +253,10 @@ int sky_property_unpack(sky_property *property, FILE *file)
             rc = sky_minipack_fread_bstring(file, &property->name);
             check(rc == 0, "Unable to read property id");
         }
+        else if(biseqcstr(key, "fixed")) {
+            property->fixed = minipack_fread_bool(file, &sz);
+            check(sz > 0, "Unable to read property fixed flag");
+        }
         
         bdestroy(key);
     }
@@ -274,3 +343,15 @@ error:
     return -1;
 }
 
+// Checks whether values of a data type can be stored in the fixed section of
+// an event.
+//
+// data_type - The name of the data type.
+//
+// Returns true if the data type is Int, Float or Boolean.
+bool sky_property_is_fixed_data_type(bstring data_type)
+{
+    return (biseq(data_type, &SKY_DATA_TYPE_INT) == 1 ||
+        biseq(data_type, &SKY_DATA_TYPE_FLOAT) == 1 ||
+        biseq(data_type, &SKY_DATA_TYPE_BOOLEAN) == 1);
+}
@@ -8,9 +8,26 @@
 typedef struct sky_property sky_property;
 
 #include "bstring.h"
+#include "buffer.h"
 #include "file.h"
 #include "property_file.h"
 
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A property is a named key of event data. Every property is declared with
+// a data type but values are stored with their own MessagePack type so the
+// declared type is only a hint to readers.
+//
+// Int, Float and Boolean properties can also be declared as fixed. Values of
+// fixed properties are stored in the fixed section at the start of the data
+// section of an event as untagged, fixed width fields instead of as
+// MessagePack values. See `event_data.h` for the layout of the section.
+
 //==============================================================================
 //
 // Typedefs
@@ -37,6 +54,7 @@ struct sky_property {
     sky_property_type_e type;
     bstring data_type;
     bstring name;
+    bool fixed;
 };
 
 
@@ -63,6 +81,8 @@ size_t sky_property_sizeof(sky_property *property);
 
 int sky_property_pack(sky_property *property, FILE *file);
 
+int sky_property_pack_buffer(sky_property *property, sky_buffer *buffer);
+
 int sky_property_unpack(sky_property *property, FILE *file);
 
 //--------------------------------------
@@ -71,4 +91,6 @@ int sky_property_unpack(sky_property *property, FILE *file);
 
 int sky_property_get_standard_data_type_name(bstring type_name, bstring *ret);
 
+bool sky_property_is_fixed_data_type(bstring data_type);
+
 #endif
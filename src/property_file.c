@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <inttypes.h>
+#include <string.h>
 
 #include "dbg.h"
 #include "mem.h"
@@ -8,6 +9,23 @@
 #include "property_file.h"
 #include "minipack.h"
 
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_property_file_index_property(sky_property_file *property_file,
+    sky_property *property);
+
+int sky_property_file_read_property(sky_property_file *property_file,
+    FILE *file, sky_property **ret);
+
+int sky_property_file_save_snapshot(sky_property_file *property_file);
+
+int sky_property_file_append(sky_property_file *property_file);
+
+
 //==============================================================================
 //
 // Functions
@@ -26,6 +44,9 @@ sky_property_file *sky_property_file_create()
 {
     sky_property_file *property_file = calloc(sizeof(sky_property_file), 1);
     check_mem(property_file);
+    property_file->name_index = sky_name_index_create();
+    check_mem(property_file->name_index);
+    property_file->loaded = true;
     return property_file;
     
 error:
@@ -42,6 +63,8 @@ void sky_property_file_free(sky_property_file *property_file)
         if(property_file->path) bdestroy(property_file->path);
         property_file->path = NULL;
         sky_property_file_unload(property_file);
+        sky_name_index_free(property_file->name_index);
+        property_file->name_index = NULL;
         free(property_file);
     }
 }
@@ -83,6 +106,10 @@ int sky_property_file_set_path(sky_property_file *property_file, bstring path)
 
     if(property_file->path) bdestroy(property_file->path);
     
+    // Nothing is known about the contents of the new file.
+    property_file->snapshot_count = 0;
+    property_file->saved_count = 0;
+
     property_file->path = bstrcpy(path);
     if(path) check_mem(property_file->path);
 
@@ -98,16 +125,17 @@ error:
 // Persistence
 //--------------------------------------
 
-// Loads properties from file.
+// Loads properties from file. The snapshot is read first and then any
+// properties that were appended after it.
 //
 // property_file - The property file to load.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_property_file_load(sky_property_file *property_file)
 {
-    FILE *file;
+    FILE *file = NULL;
     sky_property **properties = NULL;
-    uint32_t count = 0;
+    uint32_t i, count = 0, snapshot_count = 0, capacity = 0;
     size_t sz;
 
     int rc;
@@ -123,55 +151,154 @@ int sky_property_file_load(sky_property_file *property_file)
         file = fopen(bdata(property_file->path), "r");
         check(file, "Failed to open property file: %s",  bdata(property_file->path));
 
-        // Read property count.
-        count = minipack_fread_array(file, &sz);
+        // Read snapshot count.
+        snapshot_count = minipack_fread_array(file, &sz);
         check(sz != 0, "Unable to read properties array at byte: %ld", ftell(file));
 
         // Allocate properties.
-        properties = malloc(sizeof(sky_property*) * count);
-        if(count > 0) check_mem(properties);
-
-        // Read properties.
-        uint32_t i;
-        for(i=0; i<count; i++) {
-            sky_property *property = sky_property_create(); check_mem(property);
-
-            rc = sky_property_unpack(property, file);
-            check(rc == 0, "Unable to unpack property");
+        capacity = snapshot_count;
+        properties = malloc(sizeof(sky_property*) * capacity);
+        if(capacity > 0) check_mem(properties);
+
+        // Read the snapshot.
+        for(count=0; count<snapshot_count; count++) {
+            rc = sky_property_file_read_property(property_file, file, &properties[count]);
+            check(rc == 0, "Unable to read property");
+        }
 
-            // Append to array.
-            property->property_file = property_file;
-            properties[i] = property;
+        // Read the properties appended after the snapshot.
+        int c;
+        while((c = fgetc(file)) != EOF) {
+            ungetc(c, file);
+            if(count >= capacity) {
+                capacity = (capacity > 0 ? capacity * 2 : 16);
+                sky_property **new_properties = realloc(properties, sizeof(sky_property*) * capacity);
+                check_mem(new_properties);
+                properties = new_properties;
+            }
+            rc = sky_property_file_read_property(property_file, file, &properties[count]);
+            check(rc == 0, "Unable to read appended property");
+            count++;
         }
 
         // Close the file.
         fclose(file);
+        file = NULL;
     }
 
     // Store property list on property file.
     property_file->properties = properties;
     property_file->property_count = count;
+    property_file->snapshot_count = snapshot_count;
+    property_file->saved_count = count;
+    property_file->loaded = true;
+
+    // Index the properties.
+    for(i=0; i<count; i++) {
+        rc = sky_property_file_index_property(property_file, properties[i]);
+        check(rc == 0, "Unable to index property");
+    }
 
     return 0;
 
 error:
     if(file) fclose(file);
+    if(property_file->properties == NULL && properties != NULL) {
+        for(i=0; i<count; i++) {
+            sky_property_free(properties[i]);
+        }
+        free(properties);
+    }
+    return -1;
+}
+
+// Reads a single property from a property file.
+//
+// property_file - The property file that the property belongs to.
+// file          - The file stream to read from.
+// ret           - A pointer to where the property should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_property_file_read_property(sky_property_file *property_file,
+                                    FILE *file, sky_property **ret)
+{
+    int rc;
+    sky_property *property = sky_property_create(); check_mem(property);
+
+    rc = sky_property_unpack(property, file);
+    check(rc == 0, "Unable to unpack property");
+
+    property->property_file = property_file;
+    *ret = property;
+    return 0;
+
+error:
+    sky_property_free(property);
+    *ret = NULL;
     return -1;
 }
 
-// Saves properties to file.
+// Loads the properties from file unless they have already been loaded.
+//
+// property_file - The property file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_property_file_ensure_loaded(sky_property_file *property_file)
+{
+    check(property_file != NULL, "Property file required");
+    if(property_file->loaded) {
+        return 0;
+    }
+    return sky_property_file_load(property_file);
+
+error:
+    return -1;
+}
+
+// Saves properties to file. Properties added since the last save are
+// appended to the file. The whole file is rewritten instead if its contents
+// are not known or if the appended properties would outnumber the snapshot.
 //
 // property_file - The property file to save.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_property_file_save(sky_property_file *property_file)
 {
-    FILE *file;
-    size_t sz;
-
     int rc;
     check(property_file != NULL, "Property file required");
     check(property_file->path != NULL, "Property file path required");
+    rc = sky_property_file_ensure_loaded(property_file);
+    check(rc == 0, "Unable to load properties");
+
+    bool appendable = property_file->saved_count > 0 &&
+        property_file->saved_count <= property_file->property_count &&
+        property_file->property_count - property_file->snapshot_count <= property_file->snapshot_count &&
+        sky_file_exists(property_file->path);
+    if(appendable) {
+        rc = sky_property_file_append(property_file);
+        check(rc == 0, "Unable to append to property file");
+    }
+    else {
+        rc = sky_property_file_save_snapshot(property_file);
+        check(rc == 0, "Unable to save property file snapshot");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Rewrites the property file as a snapshot of every property.
+//
+// property_file - The property file to save.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_property_file_save_snapshot(sky_property_file *property_file)
+{
+    FILE *file = NULL;
+    size_t sz;
+    int rc;
 
     // Open file.
     file = fopen(bdata(property_file->path), "w");
@@ -184,19 +311,62 @@ int sky_property_file_save(sky_property_file *property_file)
     // Write properties.
     uint32_t i;
     for(i=0; i<property_file->property_count; i++) {
-        sky_property *property = property_file->properties[i];
-
-        rc = sky_property_pack(property, file);
+        rc = sky_property_pack(property_file->properties[i], file);
         check(rc == 0, "Unable to pack property");
     }
 
     // Close the file.
-    fclose(file);
+    rc = fclose(file);
+    file = NULL;
+    check(rc == 0, "Unable to close property file: %s", bdata(property_file->path));
+
+    property_file->snapshot_count = property_file->property_count;
+    property_file->saved_count = property_file->property_count;
 
     return 0;
 
 error:
     if(file) fclose(file);
+    property_file->snapshot_count = 0;
+    property_file->saved_count = 0;
+    return -1;
+}
+
+// Appends the properties that have not been saved yet to the property file.
+//
+// property_file - The property file to save.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_property_file_append(sky_property_file *property_file)
+{
+    FILE *file = NULL;
+    int rc;
+
+    if(property_file->saved_count == property_file->property_count) {
+        return 0;
+    }
+
+    file = fopen(bdata(property_file->path), "a");
+    check(file, "Failed to open property file: %s", bdata(property_file->path));
+
+    uint32_t i;
+    for(i=property_file->saved_count; i<property_file->property_count; i++) {
+        rc = sky_property_pack(property_file->properties[i], file);
+        check(rc == 0, "Unable to append property");
+    }
+
+    rc = fclose(file);
+    file = NULL;
+    check(rc == 0, "Unable to close property file: %s", bdata(property_file->path));
+
+    property_file->saved_count = property_file->property_count;
+
+    return 0;
+
+error:
+    if(file) fclose(file);
+    // The file may end with a partial property so it is rewritten next time.
+    property_file->saved_count = 0;
     return -1;
 }
 
@@ -221,6 +391,13 @@ int sky_property_file_unload(sky_property_file *property_file)
         }
         
         property_file->property_count = 0;
+        property_file->fixed_count = 0;
+        property_file->snapshot_count = 0;
+        property_file->saved_count = 0;
+
+        // Release indexes.
+        sky_name_index_clear(property_file->name_index);
+        memset(property_file->id_index, 0, sizeof(property_file->id_index));
     }
     
     return 0;
@@ -243,19 +420,13 @@ int sky_property_file_find_by_id(sky_property_file *property_file,
                                  sky_property **ret)
 {
     check(property_file != NULL, "Property file required");
-    
-    // Initialize return values.
-    *ret = NULL;
-    
-    // Loop over properties to find matching name.
-    uint32_t i;
-    for(i=0; i<property_file->property_count; i++) {
-        if(property_file->properties[i]->id == property_id) {
-            *ret = property_file->properties[i];
-            break;
-        }
+    if(!property_file->loaded) {
+        check(sky_property_file_ensure_loaded(property_file) == 0, "Unable to load properties");
     }
     
+    // Look up the property in the id index.
+    *ret = property_file->id_index[(uint8_t)property_id];
+    
     return 0;
 
 error:
@@ -275,19 +446,13 @@ int sky_property_file_find_by_name(sky_property_file *property_file,
 {
     check(property_file != NULL, "Property file required");
     check(name != NULL, "Property name required");
-    
-    // Initialize return value.
-    *ret = NULL;
-    
-    // Loop over properties to find matching name.
-    uint32_t i;
-    for(i=0; i<property_file->property_count; i++) {
-        if(biseq(property_file->properties[i]->name, name) == 1) {
-            *ret = property_file->properties[i];
-            break;
-        }
+    if(!property_file->loaded) {
+        check(sky_property_file_ensure_loaded(property_file) == 0, "Unable to load properties");
     }
     
+    // Look up the property in the name index.
+    *ret = sky_name_index_get(property_file->name_index, name);
+    
     return 0;
 
 error:
@@ -310,6 +475,7 @@ int sky_property_file_add_property(sky_property_file *property_file,
     check(property != NULL, "Property required");
     check(property->id == 0, "Property ID must be zero");
     check(property->property_file == NULL, "Property must not be attached to a property file");
+    check(!property->fixed || sky_property_is_fixed_data_type(property->data_type), "Only Int, Float and Boolean properties can be fixed");
     
     // Make sure an property with that name doesn't already exist.
     sky_property *_property;
@@ -350,6 +516,10 @@ int sky_property_file_add_property(sky_property_file *property_file,
     property_file->properties = realloc(property_file->properties, sizeof(sky_property*) * property_file->property_count);
     check_mem(property_file->properties);
     property_file->properties[property_file->property_count-1] = property;
+
+    // Index the property.
+    rc = sky_property_file_index_property(property_file, property);
+    check(rc == 0, "Unable to index property");
     
     return 0;
 
@@ -357,3 +527,58 @@ error:
     return -1;
 }
 
+// Adds a property to the name and id indexes of a property file and counts
+// it if it is fixed.
+//
+// property_file - The property file.
+// property      - The property to index.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_property_file_index_property(sky_property_file *property_file,
+                                     sky_property *property)
+{
+    int rc;
+
+    property_file->id_index[(uint8_t)property->id] = property;
+    if(property->fixed) {
+        property_file->fixed_count++;
+    }
+
+    rc = sky_name_index_put(property_file->name_index, property->name, property);
+    check(rc == 0, "Unable to add property to name index");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+// Calculates the heap memory used by the properties of a property file and
+// their indexes.
+//
+// property_file - The property file.
+//
+// Returns the number of bytes.
+size_t sky_property_file_get_memory_usage(sky_property_file *property_file)
+{
+    uint32_t i;
+    if(property_file == NULL) {
+        return 0;
+    }
+
+    size_t size = sizeof(*property_file);
+    size += sizeof(*property_file->properties) * property_file->property_count;
+    size += sky_name_index_get_memory_usage(property_file->name_index);
+    for(i=0; i<property_file->property_count; i++) {
+        sky_property *property = property_file->properties[i];
+        size += sizeof(*property);
+        if(property->name != NULL) size += sizeof(*property->name) + property->name->mlen;
+        if(property->data_type != NULL) size += sizeof(*property->data_type) + property->data_type->mlen;
+    }
+    return size;
+}
@@ -10,6 +10,43 @@ typedef struct sky_property_file sky_property_file;
 #include "file.h"
 #include "types.h"
 #include "property.h"
+#include "name_index.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The property file stores the properties defined on a table. Properties are
+// indexed by name with a hash table and by id with an array that has a slot
+// for every possible property id, so both lookups run in constant time. The
+// indexes are built when the file is loaded and are updated as properties are
+// added.
+//
+// Like the action file, the property file of a table is only loaded the
+// first time a property is looked up, added or saved. Code that reads the
+// property list directly must load it first with
+// sky_property_file_ensure_loaded().
+//
+// The property file is also a log like the action file. Properties added
+// after the snapshot array are appended to the file and the file is only
+// rewritten once the appended properties outnumber the snapshot.
+//
+// The number of fixed properties is kept with the indexes so that writers
+// of tables without any can skip looking up the property of each value.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of slots in the id index. Property ids are signed bytes so the
+// index has one slot per possible id.
+#define SKY_PROPERTY_FILE_ID_INDEX_SIZE 256
 
 
 //==============================================================================
@@ -22,6 +59,12 @@ struct sky_property_file {
     bstring path;
     sky_property **properties;
     uint32_t property_count;
+    sky_name_index *name_index;
+    sky_property *id_index[SKY_PROPERTY_FILE_ID_INDEX_SIZE];
+    bool loaded;
+    uint32_t fixed_count;
+    uint32_t snapshot_count;
+    uint32_t saved_count;
 };
 
 
@@ -55,6 +98,8 @@ int sky_property_file_get_path(sky_property_file *property_file, bstring *path);
 
 int sky_property_file_load(sky_property_file *property_file);
 
+int sky_property_file_ensure_loaded(sky_property_file *property_file);
+
 int sky_property_file_unload(sky_property_file *property_file);
 
 int sky_property_file_save(sky_property_file *property_file);
@@ -72,4 +117,10 @@ int sky_property_file_find_by_name(sky_property_file *property_file,
 
 int sky_property_file_add_property(sky_property_file *property_file, sky_property *ret);
 
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+size_t sky_property_file_get_memory_usage(sky_property_file *property_file);
+
 #endif
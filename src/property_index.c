@@ -0,0 +1,428 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "property_index.h"
+#include "predicate.h"
+#include "block.h"
+#include "path_iterator.h"
+#include "cursor.h"
+#include "minipack.h"
+#include "minipack_batch.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+bool sky_property_index_find_value(sky_property_index *index, int64_t value,
+    uint32_t *ret);
+
+bool sky_property_index_get_event_value(sky_property_index *index,
+    void *event_ptr, int64_t *value);
+
+int sky_property_index_compare_object_ids(const void *_a, const void *_b);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty index for a property. The index is not built until
+// sky_property_index_build() is called.
+//
+// property_id - The property to index.
+//
+// Returns a reference to the new index if successful. Otherwise returns
+// null.
+sky_property_index *sky_property_index_create(sky_property_id_t property_id)
+{
+    sky_property_index *index = calloc(1, sizeof(sky_property_index)); check_mem(index);
+    index->property_id = property_id;
+    return index;
+
+error:
+    sky_property_index_free(index);
+    return NULL;
+}
+
+// Removes a property index from memory.
+//
+// index - The index to free.
+void sky_property_index_free(sky_property_index *index)
+{
+    if(index) {
+        sky_property_index_clear(index);
+        free(index);
+    }
+}
+
+// Removes every value from the index and marks it as not built.
+//
+// index - The index.
+void sky_property_index_clear(sky_property_index *index)
+{
+    uint32_t i;
+    if(index == NULL) return;
+
+    for(i=0; i<index->value_count; i++) {
+        free(index->values[i].object_ids);
+    }
+    free(index->values);
+    index->values = NULL;
+    index->value_count = 0;
+    index->built = false;
+}
+
+
+//--------------------------------------
+// Maintenance
+//--------------------------------------
+
+// Rebuilds the index from every event in a data file.
+//
+// index     - The index.
+// data_file - The data file to read.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_property_index_build(sky_property_index *index,
+                             sky_data_file *data_file)
+{
+    int rc;
+    check(index != NULL, "Property index required");
+
+    sky_property_index_clear(index);
+    rc = sky_property_index_add_data_file(index, data_file);
+    check(rc == 0, "Unable to add data file to property index");
+
+    index->built = true;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Adds every event in a data file to the index. The index is cleared if
+// the data file cannot be read.
+//
+// index     - The index.
+// data_file - The data file to read.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_property_index_add_data_file(sky_property_index *index,
+                                     sky_data_file *data_file)
+{
+    int rc;
+    uint32_t i;
+    int64_t value;
+    sky_block *pinned_block = NULL;
+    check(index != NULL, "Property index required");
+    check(data_file != NULL, "Data file required");
+
+    // Every part of a spanned path is read so each block is walked alone.
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block *block = data_file->blocks[i];
+        rc = sky_block_pin(block);
+        check(rc == 0, "Unable to pin block");
+        pinned_block = block;
+
+        sky_path_iterator iterator;
+        sky_path_iterator_init(&iterator);
+        rc = sky_path_iterator_set_block(&iterator, block);
+        check(rc == 0, "Unable to set path iterator block");
+
+        while(!iterator.eof) {
+            void *path_ptr = NULL;
+            rc = sky_path_iterator_get_ptr(&iterator, &path_ptr);
+            check(rc == 0, "Unable to retrieve the path iterator pointer");
+
+            sky_path_foreach_event(path_ptr, event_ptr) {
+                if(sky_property_index_get_event_value(index, event_ptr, &value)) {
+                    rc = sky_property_index_add(index, value, iterator.current_object_id);
+                    check(rc == 0, "Unable to add event to property index");
+                }
+            }
+
+            rc = sky_path_iterator_next(&iterator);
+            check(rc == 0, "Unable to find next path");
+        }
+
+        sky_block_unpin(block);
+        pinned_block = NULL;
+    }
+
+    return 0;
+
+error:
+    sky_block_unpin(pinned_block);
+    sky_property_index_clear(index);
+    return -1;
+}
+
+// Records that an object has an event with a value of the property.
+//
+// index     - The index.
+// value     - The value.
+// object_id - The object id.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_property_index_add(sky_property_index *index, int64_t value,
+                           sky_object_id_t object_id)
+{
+    uint32_t i;
+    check(index != NULL, "Property index required");
+
+    // Add the value if it is new.
+    if(!sky_property_index_find_value(index, value, &i)) {
+        sky_property_index_value *values = realloc(index->values, sizeof(*values) * (index->value_count+1));
+        check_mem(values);
+        index->values = values;
+        memmove(&values[i+1], &values[i], sizeof(*values) * (index->value_count - i));
+        memset(&values[i], 0, sizeof(*values));
+        values[i].value = value;
+        index->value_count++;
+    }
+
+    // Objects are mostly added in order so the end is checked first.
+    sky_property_index_value *entry = &index->values[i];
+    uint32_t insert_index = entry->count;
+    if(entry->count > 0 && entry->object_ids[entry->count-1] >= object_id) {
+        uint32_t min = 0, max = entry->count;
+        while(min < max) {
+            uint32_t mid = min + ((max - min) / 2);
+            if(entry->object_ids[mid] < object_id) {
+                min = mid + 1;
+            }
+            else {
+                max = mid;
+            }
+        }
+        if(entry->object_ids[min] == object_id) {
+            return 0;
+        }
+        insert_index = min;
+    }
+
+    if(entry->count == entry->capacity) {
+        uint32_t capacity = (entry->capacity > 0 ? entry->capacity * 2 : 8);
+        sky_object_id_t *object_ids = realloc(entry->object_ids, sizeof(*object_ids) * capacity);
+        check_mem(object_ids);
+        entry->object_ids = object_ids;
+        entry->capacity = capacity;
+    }
+    memmove(&entry->object_ids[insert_index+1], &entry->object_ids[insert_index], sizeof(*entry->object_ids) * (entry->count - insert_index));
+    entry->object_ids[insert_index] = object_id;
+    entry->count++;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Records the value of the property on an event that is being added. The
+// String values of the event must already be encoded as dictionary codes.
+// Events without the property are ignored.
+//
+// index - The index.
+// event - The event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_property_index_add_event(sky_property_index *index, sky_event *event)
+{
+    int rc;
+    uint32_t i;
+    check(index != NULL, "Property index required");
+    check(event != NULL, "Event required");
+
+    for(i=0; i<event->data_count; i++) {
+        sky_event_data *data = event->data[i];
+        if(data->key != index->property_id) {
+            continue;
+        }
+
+        int64_t value;
+        if(!sky_event_data_get_numeric_value(data, &value)) {
+            continue;
+        }
+
+        rc = sky_property_index_add(index, value, event->object_id);
+        check(rc == 0, "Unable to add value to property index");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+// Finds the objects that have an event with a value of the property within
+// a range.
+//
+// index           - The index.
+// min             - The lowest value (inclusive).
+// max             - The highest value (inclusive).
+// object_ids      - A pointer to where the sorted object ids should be
+//                   returned. The caller owns the array. This is NULL if no
+//                   object has a value in the range.
+// object_id_count - A pointer to where the number of object ids should be
+//                   returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_property_index_get_object_ids(sky_property_index *index, int64_t min,
+                                      int64_t max,
+                                      sky_object_id_t **object_ids,
+                                      uint32_t *object_id_count)
+{
+    uint32_t i, j;
+    check(index != NULL, "Property index required");
+    check(object_ids != NULL, "Object ids return pointer required");
+    check(object_id_count != NULL, "Object id count return pointer required");
+    *object_ids = NULL;
+    *object_id_count = 0;
+
+    // Count the objects of the values in the range.
+    uint32_t start_index, end_index;
+    sky_property_index_find_value(index, min, &start_index);
+    uint32_t total = 0;
+    for(end_index=start_index; end_index<index->value_count && index->values[end_index].value <= max; end_index++) {
+        total += index->values[end_index].count;
+    }
+    if(total == 0) {
+        return 0;
+    }
+
+    // Concatenate the lists. The result only has to be sorted again if more
+    // than one value matched.
+    *object_ids = malloc(sizeof(**object_ids) * total);
+    check_mem(*object_ids);
+    for(i=start_index; i<end_index; i++) {
+        memcpy(&(*object_ids)[*object_id_count], index->values[i].object_ids, sizeof(**object_ids) * index->values[i].count);
+        *object_id_count += index->values[i].count;
+    }
+    if(end_index - start_index > 1) {
+        qsort(*object_ids, *object_id_count, sizeof(**object_ids), sky_property_index_compare_object_ids);
+        for(i=1, j=1; i<*object_id_count; i++) {
+            if((*object_ids)[i] != (*object_ids)[j-1]) {
+                (*object_ids)[j++] = (*object_ids)[i];
+            }
+        }
+        *object_id_count = j;
+    }
+
+    return 0;
+
+error:
+    if(object_ids) {
+        free(*object_ids);
+        *object_ids = NULL;
+    }
+    if(object_id_count) *object_id_count = 0;
+    return -1;
+}
+
+// Searches the sorted values of the index.
+//
+// index - The index.
+// value - The value to find.
+// ret   - A pointer to where the index of the value, or the index it would
+//         be inserted at, is returned.
+//
+// Returns true if the index has the value.
+bool sky_property_index_find_value(sky_property_index *index, int64_t value,
+                                   uint32_t *ret)
+{
+    uint32_t min = 0, max = index->value_count;
+    while(min < max) {
+        uint32_t mid = min + ((max - min) / 2);
+        if(index->values[mid].value < value) {
+            min = mid + 1;
+        }
+        else {
+            max = mid;
+        }
+    }
+
+    *ret = min;
+    return (min < index->value_count && index->values[min].value == value);
+}
+
+// Reads the value of the indexed property from a raw event.
+//
+// index     - The index.
+// event_ptr - A pointer to the raw event.
+// value     - A pointer to where the value should be returned.
+//
+// Returns true if the event has a value for the property.
+bool sky_property_index_get_event_value(sky_property_index *index,
+                                        void *event_ptr, int64_t *value)
+{
+    sky_event_flag_t flag = *((sky_event_flag_t*)event_ptr);
+    if(!(flag & SKY_EVENT_FLAG_DATA)) {
+        return false;
+    }
+
+    void *ptr = event_ptr + sky_event_header_length(flag) + ((flag & SKY_EVENT_FLAG_ACTION) ? sizeof(sky_action_id_t) : 0);
+    uint32_t data_length = *((sky_event_data_length_t*)ptr);
+    ptr += sizeof(sky_event_data_length_t);
+
+    sky_event_data_view view;
+    if(sky_event_data_find_fixed(ptr, data_length, index->property_id, &view)) {
+        return sky_event_data_view_get_numeric_value(&view, value);
+    }
+
+    ptr = sky_event_data_find(ptr, data_length, index->property_id);
+    return (ptr != NULL && sky_predicate_unpack_value(ptr, value));
+}
+
+// Compares two object ids.
+int sky_property_index_compare_object_ids(const void *_a, const void *_b)
+{
+    sky_object_id_t a = *((sky_object_id_t*)_a);
+    sky_object_id_t b = *((sky_object_id_t*)_b);
+    if(a > b) {
+        return 1;
+    }
+    else if(a < b) {
+        return -1;
+    }
+    return 0;
+}
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+// Calculates the heap memory used by the values of a property index.
+//
+// index - The index.
+//
+// Returns the number of bytes.
+size_t sky_property_index_get_memory_usage(sky_property_index *index)
+{
+    uint32_t i;
+    if(index == NULL) {
+        return 0;
+    }
+
+    size_t size = sizeof(*index) + (sizeof(*index->values) * index->value_count);
+    for(i=0; i<index->value_count; i++) {
+        size += sizeof(*index->values[i].object_ids) * index->values[i].capacity;
+    }
+    return size;
+}
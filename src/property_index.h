@@ -0,0 +1,103 @@
+#ifndef _sky_property_index_h
+#define _sky_property_index_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "types.h"
+#include "event.h"
+#include "data_file.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A property index maps each value of one property to the sorted list of
+// object ids that have an event with that value. A query that filters on
+// the property only has to scan the objects in the lists of the values that
+// pass the filter, and the blocks that hold them.
+//
+// Values are indexed the same way that filters read them. Integers and
+// booleans are kept as they are, floats are truncated to integers and
+// String properties are indexed by their dictionary codes.
+//
+// Like the action index, a property index is built from the data file the
+// first time it is used and is then kept up to date as events are added.
+// Removed events are left in the lists since the lists are only used to
+// rule objects out.
+//
+// A property index is not thread safe. It is updated on the worker that
+// owns its table.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// The sorted object ids that have an event with one value.
+typedef struct sky_property_index_value {
+    int64_t value;
+    sky_object_id_t *object_ids;
+    uint32_t count;
+    uint32_t capacity;
+} sky_property_index_value;
+
+// The values are kept sorted.
+typedef struct sky_property_index {
+    sky_property_id_t property_id;
+    bool built;
+    sky_property_index_value *values;
+    uint32_t value_count;
+} sky_property_index;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_property_index *sky_property_index_create(sky_property_id_t property_id);
+
+void sky_property_index_free(sky_property_index *index);
+
+void sky_property_index_clear(sky_property_index *index);
+
+//--------------------------------------
+// Maintenance
+//--------------------------------------
+
+int sky_property_index_build(sky_property_index *index,
+    sky_data_file *data_file);
+
+int sky_property_index_add_data_file(sky_property_index *index,
+    sky_data_file *data_file);
+
+int sky_property_index_add(sky_property_index *index, int64_t value,
+    sky_object_id_t object_id);
+
+int sky_property_index_add_event(sky_property_index *index, sky_event *event);
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+int sky_property_index_get_object_ids(sky_property_index *index, int64_t min,
+    int64_t max, sky_object_id_t **object_ids, uint32_t *object_id_count);
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+size_t sky_property_index_get_memory_usage(sky_property_index *index);
+
+#endif
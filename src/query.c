@@ -0,0 +1,2798 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "query.h"
+#include "predicate.h"
+#include "block.h"
+#include "block_column.h"
+#include "path_iterator.h"
+#include "cursor.h"
+#include "action_scan.h"
+#include "minipack.h"
+#include "minipack_batch.h"
+#include "endian.h"
+#include "stats.h"
+#include "trace.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The smallest number of blocks that is worth scanning on its own thread.
+#define SKY_QUERY_MIN_BLOCKS_PER_THREAD 64
+
+// The maximum number of threads used to scan a table.
+#define SKY_QUERY_MAX_THREAD_COUNT 64
+
+// The number of blocks in each task of a parallel scan.
+#define SKY_QUERY_BLOCKS_PER_TASK 16
+
+// The largest action id whose transitions are counted in a dense matrix. The
+// transitions of larger action sets are only kept for the pairs that occur.
+#define SKY_QUERY_MAX_DENSE_TRANSITION_ACTIONS 255
+
+// The maximum number of periods after its own that a cohort can track.
+#define SKY_QUERY_MAX_COHORT_PERIODS 63
+
+// The maximum number of buckets that a bucketed result can be packed into.
+#define SKY_QUERY_MAX_BUCKET_COUNT 1000000
+
+// Page faults are counted for the scan thread itself where possible.
+#ifdef RUSAGE_THREAD
+#define SKY_QUERY_RUSAGE_WHO RUSAGE_THREAD
+#else
+#define SKY_QUERY_RUSAGE_WHO RUSAGE_SELF
+#endif
+
+// A scan on one thread. The blocks of a table are split into small tasks
+// that never split a spanned path and each scan starts with an even share
+// of them. A scan takes its own tasks from the front and once they run out
+// it steals half of the remaining tasks of another scan from the back. The
+// tasks are packed into a single word with the first task in the high half
+// and the end in the low half so that both ends can be taken with a
+// compare and swap. Each scan aggregates into its
+// own result so that scans can run in parallel without locking. The
+// sequence state is kept on the scan so that it carries across the blocks of
+// a spanned path, as is the funnel or cohort state of the current object and
+// the previous action of its path and the state of the query function. The
+// filters
+// of the query are compiled once into a predicate that is shared by all
+// scans. A profiled scan counts into its own
+// profile which is added to the result's profile at the end.
+typedef struct sky_query_scan {
+    sky_query *query;
+    sky_predicate *predicate;
+    sky_data_file *data_file;
+    sky_block **blocks;
+    uint32_t *task_boundaries;
+    volatile uint64_t tasks;
+    struct sky_query_scan *scans;
+    uint32_t scan_count;
+    uint32_t index;
+    uint32_t prefetched_task;
+    sky_query_result *result;
+    sky_object_id_t object_id;
+    uint32_t sequence_index;
+    sky_timestamp_t *funnel_timestamps;
+    uint32_t funnel_index;
+    bool cohort_found;
+    int64_t cohort_period;
+    uint64_t cohort_offsets;
+    sky_action_id_t previous_action_id;
+    uint64_t *transition_counts;
+    void *function_state;
+    bool function_active;
+    bool profiling;
+    sky_query_profile profile;
+    bool timed_out;
+    bool cancelled;
+    pthread_t thread;
+    int rc;
+} sky_query_scan;
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_query_scan_blocks(sky_query_scan *scan);
+
+bool sky_query_scan_take_task(sky_query_scan *scan, uint32_t *task);
+
+bool sky_query_scan_steal_task(sky_query_scan *scan, uint32_t *task);
+
+int sky_query_scan_task(sky_query_scan *scan, uint32_t task);
+
+void *sky_query_run_scan(void *arg);
+
+uint32_t sky_query_get_thread_count(sky_data_file *data_file);
+
+bool sky_query_uses_data(sky_query *query, sky_predicate *predicate);
+
+int sky_query_scan_column(sky_query_scan *scan, sky_block *block);
+
+int sky_query_scan_rows(sky_query_scan *scan, sky_block *block);
+
+int sky_query_scan_path(sky_query_scan *scan, void *path_ptr);
+
+int sky_query_scan_object(sky_query_scan *scan, sky_object_id_t object_id,
+    void **paths, uint32_t path_count);
+
+bool sky_query_may_match_path(sky_query_scan *scan, sky_block *block,
+    sky_block_directory_entry *entry);
+
+int sky_query_scan_set_object_id(sky_query_scan *scan, sky_block *block,
+    sky_object_id_t object_id);
+
+void sky_query_advance_funnel(sky_query_scan *scan, sky_action_id_t action_id,
+    sky_timestamp_t timestamp);
+
+void sky_query_advance_cohort(sky_query_scan *scan, sky_action_id_t action_id,
+    sky_timestamp_t timestamp);
+
+int sky_query_finish_object(sky_query_scan *scan);
+
+bool sky_query_uses_dense_transitions(sky_query *query);
+
+int sky_query_flush_transitions(sky_query_scan *scan);
+
+int sky_query_aggregate_object(sky_query_scan *scan, int64_t key,
+    int64_t subkey);
+
+int64_t sky_query_get_period(int64_t timestamp, int64_t interval);
+
+int sky_query_process_event(sky_query_scan *scan, sky_action_id_t action_id,
+    sky_timestamp_t timestamp, void *data_ptr, uint32_t data_length);
+
+bool sky_query_get_field(sky_query_field_e field, sky_property_id_t property_id,
+    sky_action_id_t action_id, sky_timestamp_t timestamp, void *data_ptr,
+    uint32_t data_length, int64_t *value);
+
+void sky_query_profile_add(sky_query_profile *profile,
+    sky_query_profile *source);
+
+int sky_query_result_pack_buckets(sky_query_result *result,
+    sky_query *query, sky_buffer *buffer);
+
+int sky_query_result_pack_funnel(sky_query_result *result,
+    sky_query *query, sky_buffer *buffer);
+
+int sky_query_result_pack_values(sky_query_result *result, sky_query *query,
+    int64_t *values, sky_buffer *buffer);
+
+int sky_query_result_pack_groups(sky_query_result *result, sky_query *query,
+    sky_dictionary_file *dictionary_file, uint32_t start, uint32_t end,
+    sky_buffer *buffer);
+
+bool sky_query_is_grouped(sky_query *query);
+
+int sky_query_result_pack_key(sky_query_field_e field,
+    sky_property_id_t property_id, int64_t key,
+    sky_dictionary_file *dictionary_file, sky_buffer *buffer);
+
+int sky_query_result_pack_column(sky_query_result *result, int64_t *values,
+    uint32_t count, bool resolve, sky_buffer *buffer);
+
+int sky_query_result_pack_key_column(sky_query_result *result,
+    sky_query_field_e field, sky_property_id_t property_id, int64_t *keys,
+    sky_dictionary_file *dictionary_file, sky_buffer *buffer);
+
+bool sky_query_has_object_in_range(sky_query *query,
+    sky_object_id_t min_object_id, sky_object_id_t max_object_id);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty query. A query without aggregates counts events.
+//
+// Returns a reference to the new query if successful. Otherwise returns null.
+sky_query *sky_query_create()
+{
+    sky_query *query = calloc(1, sizeof(sky_query)); check_mem(query);
+    return query;
+
+error:
+    sky_query_free(query);
+    return NULL;
+}
+
+// Removes a query from memory.
+//
+// query - The query to free.
+void sky_query_free(sky_query *query)
+{
+    if(query) {
+        uint32_t i;
+        for(i=0; i<query->aggregate_count; i++) {
+            bdestroy(query->aggregates[i].name);
+        }
+        free(query->aggregates);
+        free(query->filters);
+        free(query->sequence);
+        free(query->funnel);
+        free(query->object_ids);
+        free(query);
+    }
+}
+
+// Creates an empty result for a query.
+//
+// query - The query that the result is for.
+//
+// Returns a reference to the new result if successful. Otherwise returns
+// null.
+sky_query_result *sky_query_result_create(sky_query *query)
+{
+    return sky_query_result_create_with_arena(query, NULL);
+}
+
+// Creates an empty result for a query whose memory is allocated from an
+// arena. The result and its groups are released when the arena is reset.
+//
+// query - The query that the result is for.
+// arena - The arena to allocate from or NULL to allocate from the heap.
+//
+// Returns a reference to the new result if successful. Otherwise returns
+// null.
+sky_query_result *sky_query_result_create_with_arena(sky_query *query,
+                                                     sky_arena *arena)
+{
+    sky_query_result *result = NULL;
+    check(query != NULL, "Query required");
+
+    if(arena != NULL) {
+        result = sky_arena_calloc(arena, 1, sizeof(sky_query_result)); check_mem(result);
+    }
+    else {
+        result = calloc(1, sizeof(sky_query_result)); check_mem(result);
+    }
+    result->arena = arena;
+    result->value_count = (query->aggregate_count > 0 ? query->aggregate_count : 1);
+
+    // Mark the values that refer to sketches.
+    uint32_t i;
+    for(i=0; i<query->aggregate_count; i++) {
+        if(query->aggregates[i].type == SKY_QUERY_AGGREGATE_DISTINCT) {
+            if(result->distinct == NULL) {
+                result->distinct = (arena != NULL ? sky_arena_calloc(arena, result->value_count, sizeof(*result->distinct)) : calloc(result->value_count, sizeof(*result->distinct)));
+                check_mem(result->distinct);
+            }
+            result->distinct[i] = true;
+        }
+    }
+
+    return result;
+
+error:
+    sky_query_result_free(result);
+    return NULL;
+}
+
+// Removes a query result from memory. Results allocated from an arena are
+// left for the arena to release.
+//
+// result - The result to free.
+void sky_query_result_free(sky_query_result *result)
+{
+    if(result && result->arena == NULL) {
+        uint32_t i;
+        for(i=0; i<result->sketch_count; i++) {
+            sky_hll_free(result->sketches[i]);
+        }
+        free(result->sketches);
+        free(result->distinct);
+        free(result->keys);
+        free(result->subkeys);
+        free(result->values);
+        free(result);
+    }
+}
+
+
+//--------------------------------------
+// Plan
+//--------------------------------------
+
+// Adds a filter to the query.
+//
+// query       - The query.
+// field       - The field to filter on.
+// property_id - The property to filter on if the field is a property.
+// min         - The smallest value accepted.
+// max         - The largest value accepted.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_add_filter(sky_query *query, sky_query_field_e field,
+                         sky_property_id_t property_id, int64_t min,
+                         int64_t max)
+{
+    check(query != NULL, "Query required");
+
+    query->filters = realloc(query->filters, sizeof(*query->filters) * (query->filter_count+1));
+    check_mem(query->filters);
+
+    sky_query_filter *filter = &query->filters[query->filter_count++];
+    filter->field = field;
+    filter->property_id = property_id;
+    filter->min = min;
+    filter->max = max;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sets the sequence of actions that must immediately precede an event for it
+// to be aggregated.
+//
+// query      - The query.
+// action_ids - The sequence of action ids. This is copied.
+// length     - The number of actions in the sequence.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_set_sequence(sky_query *query, sky_action_id_t *action_ids,
+                           uint32_t length)
+{
+    check(query != NULL, "Query required");
+    check(length == 0 || action_ids != NULL, "Action ids required");
+
+    free(query->sequence);
+    query->sequence = NULL;
+    query->sequence_length = 0;
+
+    if(length > 0) {
+        query->sequence = malloc(sizeof(*query->sequence) * length);
+        check_mem(query->sequence);
+        memcpy(query->sequence, action_ids, sizeof(*query->sequence) * length);
+        query->sequence_length = length;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sets the steps of a funnel that objects are matched against. A funnel
+// query ignores the sequence and the group by of the query and groups the
+// objects by the steps they reached instead.
+//
+// query  - The query.
+// steps  - The steps of the funnel. These are copied.
+// length - The number of steps.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_set_funnel(sky_query *query, sky_query_funnel_step *steps,
+                         uint32_t length)
+{
+    uint32_t i;
+    check(query != NULL, "Query required");
+    check(length == 0 || steps != NULL, "Funnel steps required");
+    for(i=1; i<length; i++) {
+        check(steps[i].window >= 0, "Funnel step windows cannot be negative");
+    }
+
+    free(query->funnel);
+    query->funnel = NULL;
+    query->funnel_length = 0;
+
+    if(length > 0) {
+        query->funnel = malloc(sizeof(*query->funnel) * length);
+        check_mem(query->funnel);
+        memcpy(query->funnel, steps, sizeof(*query->funnel) * length);
+        query->funnel_length = length;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sets up a cohort retention analysis. Like a funnel, a cohort query
+// ignores the sequence and the group by of the query.
+//
+// query            - The query.
+// action_id        - The action that places an object in a cohort.
+// return_action_id - The action that counts an object as retained.
+// interval         - The width of each period.
+// period_count     - The number of periods to track after the cohort's own.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_set_cohort(sky_query *query, sky_action_id_t action_id,
+                         sky_action_id_t return_action_id,
+                         sky_timestamp_t interval, uint32_t period_count)
+{
+    check(query != NULL, "Query required");
+    check(interval > 0, "Cohort interval must be positive");
+    check(period_count <= SKY_QUERY_MAX_COHORT_PERIODS, "Cohorts can track at most %d periods", SKY_QUERY_MAX_COHORT_PERIODS);
+
+    query->cohorted = true;
+    query->cohort.action_id = action_id;
+    query->cohort.return_action_id = return_action_id;
+    query->cohort.interval = interval;
+    query->cohort.period_count = period_count;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Counts the transitions between consecutive actions of each path. A
+// transitions query ignores the sequence and the group by of the query and
+// groups each event by the action of the previous event in its path and
+// its own action.
+//
+// query        - The query.
+// action_count - The number of actions in the table. Small action sets are
+//                counted in a dense matrix of this size.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_set_transitions(sky_query *query, uint32_t action_count)
+{
+    check(query != NULL, "Query required");
+
+    query->transitions = true;
+    query->transition_action_count = action_count;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Passes the events of each object to a query function instead of the
+// sequence, group by and aggregate operators. Distinct aggregates cannot be
+// used with a function since its values are merged by adding them up.
+//
+// query    - The query.
+// function - The function.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_set_function(sky_query *query, sky_query_function *function)
+{
+    uint32_t i;
+    check(query != NULL, "Query required");
+    check(function != NULL, "Function required");
+    for(i=0; i<query->aggregate_count; i++) {
+        check(query->aggregates[i].type != SKY_QUERY_AGGREGATE_DISTINCT, "Distinct aggregates cannot be used with a query function");
+    }
+
+    query->function = function;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Groups the results of the query by the value of a field.
+//
+// query       - The query.
+// field       - The field to group by.
+// property_id - The property to group by if the field is a property.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_set_group_by(sky_query *query, sky_query_field_e field,
+                           sky_property_id_t property_id)
+{
+    check(query != NULL, "Query required");
+
+    query->grouped = true;
+    query->group_field = field;
+    query->group_property_id = property_id;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Groups the events of a query grouped by timestamp into buckets of a fixed
+// width. The key of each group is the first timestamp of its bucket.
+//
+// query    - The query.
+// interval - The width of each bucket.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_set_group_interval(sky_query *query, int64_t interval)
+{
+    check(query != NULL, "Query required");
+    check(query->grouped && query->group_field == SKY_QUERY_FIELD_TIMESTAMP, "Query must be grouped by timestamp to be bucketed");
+    check(interval > 0, "Bucket interval must be positive");
+
+    query->group_interval = interval;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Subgroups each group of the results by the value of a second field. The
+// query must already be grouped.
+//
+// query       - The query.
+// field       - The field to subgroup by.
+// property_id - The property to subgroup by if the field is a property.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_set_subgroup_by(sky_query *query, sky_query_field_e field,
+                              sky_property_id_t property_id)
+{
+    check(query != NULL, "Query required");
+    check(query->grouped, "Query must be grouped to be subgrouped");
+
+    query->subgrouped = true;
+    query->subgroup_field = field;
+    query->subgroup_property_id = property_id;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Adds an aggregate that is calculated for each group.
+//
+// query       - The query.
+// type        - The type of aggregate.
+// property_id - The property to sum for a sum aggregate.
+// name        - The name of the aggregate in the results. This is copied.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_add_aggregate(sky_query *query, sky_query_aggregate_e type,
+                            sky_property_id_t property_id, bstring name)
+{
+    check(query != NULL, "Query required");
+    check(blength(name) > 0, "Aggregate name required");
+    check(type != SKY_QUERY_AGGREGATE_DISTINCT || query->function == NULL, "Distinct aggregates cannot be used with a query function");
+
+    query->aggregates = realloc(query->aggregates, sizeof(*query->aggregates) * (query->aggregate_count+1));
+    check_mem(query->aggregates);
+
+    sky_query_aggregate *aggregate = &query->aggregates[query->aggregate_count];
+    aggregate->type = type;
+    aggregate->property_id = property_id;
+    aggregate->name = bstrcpy(name); check_mem(aggregate->name);
+    query->aggregate_count++;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Restricts the query to a set of objects. The events of other objects are
+// not scanned.
+//
+// query           - The query.
+// object_ids      - The sorted object ids. These are copied.
+// object_id_count - The number of object ids. A query restricted to no
+//                   objects matches nothing.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_set_object_ids(sky_query *query, sky_object_id_t *object_ids,
+                             uint32_t object_id_count)
+{
+    check(query != NULL, "Query required");
+    check(object_id_count == 0 || object_ids != NULL, "Object ids required");
+
+    free(query->object_ids);
+    query->object_ids = NULL;
+    query->object_id_count = 0;
+    query->restricted = true;
+
+    if(object_id_count > 0) {
+        query->object_ids = malloc(sizeof(*query->object_ids) * object_id_count);
+        check_mem(query->object_ids);
+        memcpy(query->object_ids, object_ids, sizeof(*query->object_ids) * object_id_count);
+        query->object_id_count = object_id_count;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+// Restricts the query to the objects that are in a set and in the set that
+// it is already restricted to, if any.
+//
+// query           - The query.
+// object_ids      - The sorted object ids.
+// object_id_count - The number of object ids.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_restrict_object_ids(sky_query *query,
+                                  sky_object_id_t *object_ids,
+                                  uint32_t object_id_count)
+{
+    uint32_t i, j, count = 0;
+    check(query != NULL, "Query required");
+    check(object_id_count == 0 || object_ids != NULL, "Object ids required");
+
+    if(!query->restricted) {
+        return sky_query_set_object_ids(query, object_ids, object_id_count);
+    }
+
+    // Both sets are sorted so they are merged in a single pass.
+    for(i=0, j=0; i<query->object_id_count && j<object_id_count;) {
+        if(query->object_ids[i] < object_ids[j]) {
+            i++;
+        }
+        else if(query->object_ids[i] > object_ids[j]) {
+            j++;
+        }
+        else {
+            query->object_ids[count++] = query->object_ids[i];
+            i++;
+            j++;
+        }
+    }
+    query->object_id_count = count;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sets how long the query may run before its scans stop.
+//
+// query   - The query.
+// timeout - The number of microseconds from now until the deadline. Zero
+//           removes the deadline.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_set_timeout(sky_query *query, int64_t timeout)
+{
+    check(query != NULL, "Query required");
+    check(timeout >= 0, "Invalid query timeout: %lld", (long long)timeout);
+
+    query->deadline = (timeout > 0 ? sky_stats_now() + timeout : 0);
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sets a flag that stops the scans of the query once it is set. The flag
+// can be set from another thread while the query runs.
+//
+// query     - The query.
+// cancelled - The flag. This is not owned by the query and can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_set_cancel_flag(sky_query *query, volatile bool *cancelled)
+{
+    check(query != NULL, "Query required");
+    query->cancelled = cancelled;
+    return 0;
+
+error:
+    return -1;
+}
+
+//--------------------------------------
+// Execution
+//--------------------------------------
+
+// Executes a query over all the events in a data file. Large data files are
+// split into small block ranges that are scanned in parallel. Threads that
+// finish their ranges early steal ranges from the others so that a few
+// long paths or selective filters do not leave one thread with most of the
+// work. The results of each thread are merged into the result at the end.
+//
+// query     - The query to execute.
+// data_file - The data file to scan.
+// result    - The result to aggregate into.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_execute(sky_query *query, sky_data_file *data_file,
+                      sky_query_result *result)
+{
+    int rc;
+    uint32_t i;
+    uint32_t *boundaries = NULL;
+    uint32_t scan_count = 0;
+    sky_arena *arena = NULL;
+    sky_query_scan *scans = NULL;
+    sky_predicate *predicate = NULL;
+    sky_access_pattern_e access_pattern = SKY_ACCESS_PATTERN_NORMAL;
+    bool reading = false;
+    uint64_t epoch = 0;
+    check(query != NULL, "Query required");
+    check(data_file != NULL, "Data file required");
+    check(result != NULL, "Result required");
+    access_pattern = data_file->access_pattern;
+
+    // Scan a snapshot of the block array. The array and the mappings stay
+    // valid until the scan leaves the epoch even if the data file grows.
+    epoch = sky_epoch_enter(data_file->epoch);
+    reading = true;
+    sky_block **blocks = data_file->blocks;
+    int64_t plan_t0 = sky_stats_now();
+
+    // Compile the filters.
+    predicate = sky_predicate_create(); check_mem(predicate);
+    rc = sky_predicate_compile(predicate, query->filters, query->filter_count);
+    check(rc == 0, "Unable to compile query filters");
+
+    // Split the blocks into tasks. The scan temporaries come from the
+    // result's arena if it has one.
+    arena = result->arena;
+    uint32_t thread_count = sky_query_get_thread_count(data_file);
+    uint32_t task_count = (data_file->block_count + SKY_QUERY_BLOCKS_PER_TASK - 1) / SKY_QUERY_BLOCKS_PER_TASK;
+    if(task_count < thread_count) {
+        task_count = thread_count;
+    }
+    if(arena != NULL) {
+        boundaries = sky_arena_calloc(arena, task_count+1, sizeof(*boundaries));
+    }
+    else {
+        boundaries = calloc(task_count+1, sizeof(*boundaries));
+    }
+    check_mem(boundaries);
+    rc = sky_data_file_get_partitions(data_file, task_count, boundaries);
+    check(rc == 0, "Unable to partition data file");
+
+    // Create a scan for each thread with an even share of the tasks. The
+    // first scan aggregates directly into the caller's result. The other
+    // scans grow their results on their own threads so they are allocated
+    // from the heap.
+    if(arena != NULL) {
+        scans = sky_arena_calloc(arena, thread_count, sizeof(*scans));
+    }
+    else {
+        scans = calloc(thread_count, sizeof(*scans));
+    }
+    check_mem(scans);
+    for(i=0; i<thread_count; i++) {
+        sky_query_scan *scan = &scans[i];
+        scan->query = query;
+        scan->predicate = predicate;
+        scan->data_file = data_file;
+        scan->blocks = blocks;
+        scan->task_boundaries = boundaries;
+        scan->tasks = ((uint64_t)(((uint64_t)task_count * i) / thread_count) << 32)
+            | (uint64_t)(((uint64_t)task_count * (i+1)) / thread_count);
+        scan->scans = scans;
+        scan->scan_count = thread_count;
+        scan->index = i;
+        scan->prefetched_task = UINT32_MAX;
+        scan->result = (i == 0 ? result : sky_query_result_create(query));
+        check_mem(scan->result);
+        scan->profiling = (result->profile != NULL);
+        scan_count++;
+        if(query->funnel_length > 0) {
+            scan->funnel_timestamps = calloc(query->funnel_length, sizeof(*scan->funnel_timestamps));
+            check_mem(scan->funnel_timestamps);
+        }
+        if(sky_query_uses_dense_transitions(query)) {
+            uint32_t width = query->transition_action_count + 1;
+            scan->transition_counts = calloc(width * width, sizeof(*scan->transition_counts));
+            check_mem(scan->transition_counts);
+        }
+        if(query->function != NULL) {
+            scan->function_state = calloc(1, (query->function->state_size > 0 ? query->function->state_size : 1));
+            check_mem(scan->function_state);
+        }
+    }
+
+    // Read the mappings sequentially while they are scanned.
+    rc = sky_data_file_set_access_pattern(data_file, SKY_ACCESS_PATTERN_SEQUENTIAL);
+    check(rc == 0, "Unable to set scan access pattern");
+
+    // Start benchmark.
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t t0 = (tv.tv_sec*1000) + (tv.tv_usec/1000);
+    int64_t scan_t0 = sky_stats_now();
+
+    // Scan on this thread and on one thread for every other scan.
+    uint32_t started_count = 1;
+    for(i=1; i<scan_count; i++) {
+        rc = pthread_create(&scans[i].thread, NULL, sky_query_run_scan, &scans[i]);
+        if(rc != 0) {
+            debug("Unable to create scan thread");
+            break;
+        }
+        started_count++;
+    }
+    sky_query_scan_blocks(&scans[0]);
+
+    // The tasks of scans that could not be started on their own thread have
+    // been stolen by the others by now.
+    for(i=1; i<started_count; i++) {
+        pthread_join(scans[i].thread, NULL);
+    }
+    sky_epoch_exit(data_file->epoch, epoch);
+    reading = false;
+    int64_t scan_t1 = sky_stats_now();
+    rc = sky_data_file_set_access_pattern(data_file, access_pattern);
+    check(rc == 0, "Unable to restore access pattern");
+
+    // Merge the results into the caller's result. A stopped scan marks the
+    // result so the caller can report why the query failed.
+    for(i=0; i<scan_count; i++) {
+        result->timed_out = result->timed_out || scans[i].timed_out;
+        result->cancelled = result->cancelled || scans[i].cancelled;
+    }
+    for(i=0; i<scan_count; i++) {
+        check(scans[i].rc == 0, "Unable to scan blocks on thread %d", i);
+        if(i > 0) {
+            rc = sky_query_result_merge(result, scans[i].result);
+            check(rc == 0, "Unable to merge query results");
+        }
+    }
+
+    // Add up the profiles of the scans.
+    if(result->profile != NULL) {
+        for(i=0; i<scan_count; i++) {
+            sky_query_profile_add(result->profile, &scans[i].profile);
+        }
+        result->profile->plan_time += scan_t0 - plan_t0;
+        result->profile->scan_time += scan_t1 - scan_t0;
+        result->profile->merge_time += sky_stats_now() - scan_t1;
+    }
+
+    // End benchmark.
+    gettimeofday(&tv, NULL);
+    int64_t t1 = (tv.tv_sec*1000) + (tv.tv_usec/1000);
+    debug("Query scanned %lld events in: %.3f seconds\n", (long long)result->event_count, ((float)(t1-t0))/1000);
+    sky_stats_add(scanned_events, result->event_count);
+    sky_stats_add(scan_time, (t1-t0) * 1000);
+
+    // Add the scan to the trace of the message that is executing it.
+    uint64_t blocks_visited = 0, blocks_skipped = 0;
+    for(i=0; i<scan_count; i++) {
+        blocks_visited += scans[i].profile.blocks_visited;
+        blocks_skipped += scans[i].profile.blocks_skipped;
+    }
+    sky_trace_add_scan(result->event_count, blocks_visited, blocks_skipped);
+
+    for(i=0; i<scan_count; i++) {
+        if(i > 0) sky_query_result_free(scans[i].result);
+        free(scans[i].funnel_timestamps);
+        free(scans[i].transition_counts);
+        free(scans[i].function_state);
+    }
+    if(arena == NULL) {
+        free(scans);
+        free(boundaries);
+    }
+    sky_predicate_free(predicate);
+    return 0;
+
+error:
+    if(reading) sky_epoch_exit(data_file->epoch, epoch);
+    if(data_file != NULL) sky_data_file_set_access_pattern(data_file, access_pattern);
+    for(i=0; i<scan_count; i++) {
+        if(i > 0) sky_query_result_free(scans[i].result);
+        free(scans[i].funnel_timestamps);
+        free(scans[i].transition_counts);
+        free(scans[i].function_state);
+    }
+    if(arena == NULL) {
+        free(scans);
+        free(boundaries);
+    }
+    sky_predicate_free(predicate);
+    return -1;
+}
+
+// Executes a query over the partitions of a partitioned table. Only the
+// partitions that overlap the timestamp range of the filters are read, so a
+// query over a recent window never maps the older partitions. The parts of
+// each object's path are stitched together in time order and scanned as one
+// path on the calling thread, which must be the owner of the set.
+//
+// query         - The query to execute.
+// partition_set - The partition set to scan.
+// result        - The result to aggregate into.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_execute_partition_set(sky_query *query,
+                                    sky_partition_set *partition_set,
+                                    sky_query_result *result)
+{
+    int rc;
+    sky_query_scan scan;
+    sky_partition_iterator iterator;
+    sky_predicate *predicate = NULL;
+    memset(&scan, 0, sizeof(scan));
+    sky_partition_iterator_init(&iterator);
+    check(query != NULL, "Query required");
+    check(partition_set != NULL, "Partition set required");
+    check(result != NULL, "Result required");
+    int64_t plan_t0 = sky_stats_now();
+
+    // Compile the filters.
+    predicate = sky_predicate_create(); check_mem(predicate);
+    rc = sky_predicate_compile(predicate, query->filters, query->filter_count);
+    check(rc == 0, "Unable to compile query filters");
+
+    scan.query = query;
+    scan.predicate = predicate;
+    scan.result = result;
+    scan.scan_count = 1;
+    scan.prefetched_task = UINT32_MAX;
+    scan.profiling = (result->profile != NULL);
+    if(query->funnel_length > 0) {
+        scan.funnel_timestamps = calloc(query->funnel_length, sizeof(*scan.funnel_timestamps));
+        check_mem(scan.funnel_timestamps);
+    }
+    if(sky_query_uses_dense_transitions(query)) {
+        uint32_t width = query->transition_action_count + 1;
+        scan.transition_counts = calloc(width * width, sizeof(*scan.transition_counts));
+        check_mem(scan.transition_counts);
+    }
+    if(query->function != NULL) {
+        scan.function_state = calloc(1, (query->function->state_size > 0 ? query->function->state_size : 1));
+        check_mem(scan.function_state);
+    }
+
+    // Walk the overlapping partitions side by side in object id order.
+    rc = sky_partition_iterator_set_partition_set(&iterator, partition_set, predicate->min_timestamp, predicate->max_timestamp);
+    check(rc == 0, "Unable to set partition iterator");
+
+    int64_t scan_t0 = sky_stats_now();
+    while(!iterator.eof) {
+        // Stop once the query is out of time or has been cancelled.
+        if(query->cancelled != NULL && *query->cancelled) {
+            result->cancelled = true;
+            sentinel("Query cancelled");
+        }
+        if(query->deadline > 0 && sky_stats_now() >= query->deadline) {
+            result->timed_out = true;
+            sentinel("Query timed out");
+        }
+
+        if(!query->restricted || sky_query_has_object_in_range(query, iterator.current_object_id, iterator.current_object_id)) {
+            rc = sky_query_scan_object(&scan, iterator.current_object_id, iterator.paths, iterator.path_count);
+            check(rc == 0, "Unable to scan object");
+        }
+
+        rc = sky_partition_iterator_next(&iterator);
+        check(rc == 0, "Unable to move to next object");
+    }
+
+    // Count the last object and move the dense transition counts into the
+    // result.
+    rc = sky_query_finish_object(&scan);
+    check(rc == 0, "Unable to count object");
+    rc = sky_query_flush_transitions(&scan);
+    check(rc == 0, "Unable to count transitions");
+    int64_t scan_t1 = sky_stats_now();
+
+    if(result->profile != NULL) {
+        sky_query_profile_add(result->profile, &scan.profile);
+        result->profile->plan_time += scan_t0 - plan_t0;
+        result->profile->scan_time += scan_t1 - scan_t0;
+    }
+    sky_stats_add(scanned_events, result->event_count);
+    sky_stats_add(scan_time, scan_t1 - scan_t0);
+    sky_trace_add_scan(result->event_count, 0, 0);
+
+    sky_partition_iterator_uninit(&iterator);
+    free(scan.funnel_timestamps);
+    free(scan.transition_counts);
+    free(scan.function_state);
+    sky_predicate_free(predicate);
+    return 0;
+
+error:
+    sky_partition_iterator_uninit(&iterator);
+    free(scan.funnel_timestamps);
+    free(scan.transition_counts);
+    free(scan.function_state);
+    sky_predicate_free(predicate);
+    return -1;
+}
+
+// Determines the number of threads to scan a data file with. This is one
+// thread per CPU but a thread is only used if it has enough blocks to scan.
+//
+// data_file - The data file to scan.
+//
+// Returns the number of threads.
+uint32_t sky_query_get_thread_count(sky_data_file *data_file)
+{
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t thread_count = (cpu_count > 0 ? (uint32_t)cpu_count : 1);
+    if(thread_count > SKY_QUERY_MAX_THREAD_COUNT) {
+        thread_count = SKY_QUERY_MAX_THREAD_COUNT;
+    }
+
+    uint32_t max_thread_count = data_file->block_count / SKY_QUERY_MIN_BLOCKS_PER_THREAD;
+    if(thread_count > max_thread_count) {
+        thread_count = max_thread_count;
+    }
+
+    return (thread_count > 0 ? thread_count : 1);
+}
+
+// The entry point for scan threads.
+//
+// arg - The scan to perform.
+//
+// Returns NULL.
+void *sky_query_run_scan(void *arg)
+{
+    sky_query_scan_blocks((sky_query_scan*)arg);
+    return NULL;
+}
+
+// Scans tasks until there are none left in any scan. The scan's own tasks
+// are scanned first and then the tasks of the other scans.
+//
+// scan - The scan to perform.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_scan_blocks(sky_query_scan *scan)
+{
+    int rc;
+    uint32_t task;
+    struct rusage usage;
+    if(scan->profiling) {
+        getrusage(SKY_QUERY_RUSAGE_WHO, &usage);
+        scan->profile.minor_faults -= usage.ru_minflt;
+        scan->profile.major_faults -= usage.ru_majflt;
+    }
+
+    while(sky_query_scan_take_task(scan, &task) || sky_query_scan_steal_task(scan, &task)) {
+        rc = sky_query_scan_task(scan, task);
+        check(rc == 0, "Unable to scan task");
+    }
+
+    // Move the dense transition counts into the result.
+    rc = sky_query_flush_transitions(scan);
+    check(rc == 0, "Unable to count transitions");
+
+    if(scan->profiling) {
+        getrusage(SKY_QUERY_RUSAGE_WHO, &usage);
+        scan->profile.minor_faults += usage.ru_minflt;
+        scan->profile.major_faults += usage.ru_majflt;
+    }
+
+    scan->rc = 0;
+    return 0;
+
+error:
+    scan->rc = -1;
+    return -1;
+}
+
+// Takes the first of the scan's own tasks.
+//
+// scan - The scan.
+// task - A pointer to where the index of the task should be returned.
+//
+// Returns true if a task was taken.
+bool sky_query_scan_take_task(sky_query_scan *scan, uint32_t *task)
+{
+    while(true) {
+        uint64_t tasks = scan->tasks;
+        uint32_t start = (uint32_t)(tasks >> 32);
+        uint32_t end = (uint32_t)tasks;
+        if(start >= end) {
+            return false;
+        }
+        if(__sync_bool_compare_and_swap(&scan->tasks, tasks, ((uint64_t)(start+1) << 32) | end)) {
+            *task = start;
+            return true;
+        }
+    }
+}
+
+// Steals the back half of the remaining tasks of another scan. The first of
+// the stolen tasks is returned and the rest become the scan's own tasks.
+// This is only called once the scan has no tasks left so no other scan can
+// take from it while its tasks are replaced.
+//
+// scan - The scan.
+// task - A pointer to where the index of the task should be returned.
+//
+// Returns true if a task was stolen.
+bool sky_query_scan_steal_task(sky_query_scan *scan, uint32_t *task)
+{
+    uint32_t i;
+    for(i=1; i<scan->scan_count; i++) {
+        sky_query_scan *victim = &scan->scans[(scan->index + i) % scan->scan_count];
+        while(true) {
+            uint64_t tasks = victim->tasks;
+            uint32_t start = (uint32_t)(tasks >> 32);
+            uint32_t end = (uint32_t)tasks;
+            if(start >= end) {
+                break;
+            }
+            uint32_t middle = end - (end - start + 1) / 2;
+            if(__sync_bool_compare_and_swap(&victim->tasks, tasks, ((uint64_t)start << 32) | middle)) {
+                scan->tasks = ((uint64_t)(middle+1) << 32) | end;
+                __sync_synchronize();
+                *task = middle;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Scans each block of a task. Tasks never split a spanned path so the last
+// object of the task is counted at the end. If the data file has a
+// prefetcher the scan's next task is read while this one is scanned.
+//
+// scan - The scan.
+// task - The index of the task.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_scan_task(sky_query_scan *scan, uint32_t task)
+{
+    int rc;
+    uint32_t i;
+    sky_block *pinned_block = NULL;
+    bool uses_data = sky_query_uses_data(scan->query, scan->predicate);
+
+    // Read ahead on the prefetcher's I/O threads. Tasks that were stolen
+    // have not been read ahead yet. Their first block is left out because
+    // it is read on this thread straight away, before a prefetch would
+    // finish. The next task is read ahead in full since it is only
+    // scanned after this one.
+    if(scan->data_file->prefetcher != NULL) {
+        if(task != scan->prefetched_task) {
+            rc = sky_data_file_prefetch_blocks(scan->data_file, scan->blocks, scan->task_boundaries[task]+1, scan->task_boundaries[task+1]);
+            check(rc == 0, "Unable to prefetch task");
+        }
+        uint64_t tasks = scan->tasks;
+        uint32_t next_task = (uint32_t)(tasks >> 32);
+        if(next_task < (uint32_t)tasks) {
+            rc = sky_data_file_prefetch_blocks(scan->data_file, scan->blocks, scan->task_boundaries[next_task], scan->task_boundaries[next_task+1]);
+            check(rc == 0, "Unable to prefetch next task");
+            scan->prefetched_task = next_task;
+        }
+    }
+
+    scan->object_id = 0;
+    scan->sequence_index = 0;
+    scan->previous_action_id = 0;
+    for(i=scan->task_boundaries[task]; i<scan->task_boundaries[task+1]; i++) {
+        sky_block *block = scan->blocks[i];
+
+        // Stop once the query is out of time or has been cancelled.
+        if(scan->query->cancelled != NULL && *scan->query->cancelled) {
+            scan->cancelled = true;
+            sentinel("Query cancelled");
+        }
+        if(scan->query->deadline > 0 && sky_stats_now() >= scan->query->deadline) {
+            scan->timed_out = true;
+            sentinel("Query timed out");
+        }
+
+        // Events that fail the filters do not affect the sequence so blocks
+        // without any matching events can be skipped entirely.
+        if(!sky_predicate_may_match_block(scan->predicate, block)) {
+            scan->profile.blocks_skipped++;
+            continue;
+        }
+        if(scan->query->restricted && !sky_query_has_object_in_range(scan->query, block->min_object_id, block->max_object_id)) {
+            scan->profile.blocks_skipped++;
+            continue;
+        }
+        scan->profile.blocks_visited++;
+
+        // Keep a compressed block decompressed while it is scanned.
+        rc = sky_block_pin(block);
+        check(rc == 0, "Unable to pin block");
+        pinned_block = block;
+
+        if(uses_data) {
+            rc = sky_query_scan_rows(scan, block);
+            check(rc == 0, "Unable to scan block rows");
+        }
+        else {
+            rc = sky_query_scan_column(scan, block);
+            check(rc == 0, "Unable to scan block column");
+        }
+
+        sky_block_unpin(block);
+        pinned_block = NULL;
+    }
+
+    // Count the last object in the task.
+    rc = sky_query_finish_object(scan);
+    check(rc == 0, "Unable to count object");
+
+    return 0;
+
+error:
+    sky_block_unpin(pinned_block);
+    return -1;
+}
+
+// Checks whether any operator of the query reads event properties.
+//
+// query     - The query.
+// predicate - The compiled filters of the query.
+//
+// Returns true if the raw event data is needed to execute the query.
+bool sky_query_uses_data(sky_query *query, sky_predicate *predicate)
+{
+    uint32_t i;
+    if(sky_predicate_uses_data(predicate) || query->function != NULL) {
+        return true;
+    }
+    if(query->funnel_length > 0 || query->cohorted) {
+        return false;
+    }
+    for(i=0; i<query->aggregate_count; i++) {
+        if(query->aggregates[i].type == SKY_QUERY_AGGREGATE_SUM) return true;
+    }
+    if(query->transitions) {
+        return false;
+    }
+    return (query->grouped && query->group_field == SKY_QUERY_FIELD_PROPERTY)
+        || (query->subgrouped && query->subgroup_field == SKY_QUERY_FIELD_PROPERTY);
+}
+
+// Scans the events of a block through its action column. When there are no
+// filters, events that cannot start the sequence are skipped with a
+// vectorized search for the first action of the sequence.
+//
+// scan  - The scan.
+// block - The block to scan.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_scan_column(sky_query_scan *scan, sky_block *block)
+{
+    int rc;
+    uint32_t i, j;
+    sky_query *query = scan->query;
+    bool skip_ahead = (query->sequence_length > 0 && query->filter_count == 0 && query->funnel_length == 0 && !query->cohorted && !query->transitions);
+
+    sky_block_column *column = NULL;
+    rc = sky_block_get_column(block, &column);
+    check(rc == 0, "Unable to retrieve block column");
+
+    // The directory lists the same paths in the same order as the column.
+    sky_block_directory_entry *entries = NULL;
+    uint32_t entry_count = 0;
+    rc = sky_block_get_directory(block, &entries, &entry_count);
+    check(rc == 0, "Unable to retrieve block directory");
+    if(entry_count != column->path_count) {
+        entries = NULL;
+    }
+
+    uint32_t path_count = 0, event_count = 0;
+    for(i=0; i<column->path_count; i++) {
+        if(query->restricted && !sky_query_has_object_in_range(query, column->object_ids[i], column->object_ids[i])) {
+            continue;
+        }
+        if(entries != NULL && !sky_query_may_match_path(scan, block, &entries[i])) {
+            scan->profile.paths_skipped++;
+            continue;
+        }
+        rc = sky_query_scan_set_object_id(scan, block, column->object_ids[i]);
+        check(rc == 0, "Unable to move scan to path");
+
+        uint32_t end_index = column->path_offsets[i+1];
+        path_count++;
+        event_count += end_index - column->path_offsets[i];
+        for(j=column->path_offsets[i]; j<end_index; j++) {
+            // When no match is in progress only the first action of the
+            // sequence can change the state so skip ahead to it.
+            if(skip_ahead && scan->sequence_index == 0) {
+                j = sky_action_scan_find(column->action_ids, j, end_index, query->sequence[0]);
+                if(j == end_index) {
+                    break;
+                }
+                scan->sequence_index = 1;
+                continue;
+            }
+
+            rc = sky_query_process_event(scan, column->action_ids[j], column->timestamps[j], NULL, 0);
+            check(rc == 0, "Unable to process event");
+        }
+    }
+
+    scan->result->event_count += event_count;
+    scan->profile.path_count += path_count;
+    scan->profile.event_count += event_count;
+    scan->profile.byte_count += (path_count * (sizeof(*column->object_ids) + sizeof(*column->path_offsets))) +
+        (event_count * (sizeof(*column->action_ids) + sizeof(*column->timestamps)));
+    return 0;
+
+error:
+    return -1;
+}
+
+// Scans the raw events of each path in a block.
+//
+// scan  - The scan.
+// block - The block to scan.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_scan_rows(sky_query_scan *scan, sky_block *block)
+{
+    int rc;
+
+    // The directory lists the paths of the block in iteration order.
+    sky_block_directory_entry *entries = NULL;
+    uint32_t entry_index = 0, entry_count = 0;
+    rc = sky_block_get_directory(block, &entries, &entry_count);
+    check(rc == 0, "Unable to retrieve block directory");
+
+    // Paths are read in batches so that the following paths are loading
+    // while the events of the current path are processed.
+    uint32_t i;
+    sky_path_iterator_batch batch;
+    sky_path_iterator iterator;
+    sky_path_iterator_init(&iterator);
+    rc = sky_path_iterator_set_block(&iterator, block);
+    check(rc == 0, "Unable to set path iterator block");
+
+    while(true) {
+        rc = sky_path_iterator_next_batch(&iterator, &batch);
+        check(rc == 0, "Unable to find next paths");
+        if(batch.count == 0) {
+            break;
+        }
+
+        for(i=0; i<batch.count; i++, entry_index++) {
+            sky_object_id_t object_id = batch.object_ids[i];
+            sky_block_directory_entry *entry = (entry_index < entry_count ? &entries[entry_index] : NULL);
+            if(entry != NULL && entry->object_id != object_id) {
+                entry = NULL;
+            }
+            if(scan->query->restricted && !sky_query_has_object_in_range(scan->query, object_id, object_id)) {
+                continue;
+            }
+            if(entry != NULL && !sky_query_may_match_path(scan, block, entry)) {
+                scan->profile.paths_skipped++;
+                continue;
+            }
+
+            rc = sky_query_scan_set_object_id(scan, block, object_id);
+            check(rc == 0, "Unable to move scan to path");
+            rc = sky_query_scan_path(scan, batch.paths[i]);
+            check(rc == 0, "Unable to scan path");
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Passes the raw events of a path through the operators of the query.
+//
+// scan     - The scan.
+// path_ptr - A pointer to the raw path.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_scan_path(sky_query_scan *scan, void *path_ptr)
+{
+    int rc;
+    scan->profile.path_count++;
+    scan->profile.byte_count += sky_path_sizeof_raw(path_ptr);
+
+    sky_timestamp_t timestamp = 0;
+    sky_path_foreach_event(path_ptr, event_ptr) {
+        sky_event_flag_t flag = *((sky_event_flag_t*)event_ptr);
+        timestamp = sky_event_get_timestamp(event_ptr, timestamp);
+
+        // Locate the data section if the event has one.
+        void *data_ptr = NULL;
+        uint32_t data_length = 0;
+        if(flag & SKY_EVENT_FLAG_DATA) {
+            void *ptr = event_ptr + sky_event_header_length(flag) + ((flag & SKY_EVENT_FLAG_ACTION) ? sizeof(sky_action_id_t) : 0);
+            data_length = *((sky_event_data_length_t*)ptr);
+            data_ptr = ptr + sizeof(sky_event_data_length_t);
+        }
+
+        rc = sky_query_process_event(scan, sky_cursor_fast_get_action_id(event_ptr), timestamp, data_ptr, data_length);
+        check(rc == 0, "Unable to process event");
+        scan->result->event_count++;
+        scan->profile.event_count++;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Passes every part of an object's path through the operators of the query
+// as a single path. The previous object is counted first.
+//
+// scan       - The scan.
+// object_id  - The object id.
+// paths      - The parts of the object's path in time order.
+// path_count - The number of parts.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_scan_object(sky_query_scan *scan, sky_object_id_t object_id,
+                          void **paths, uint32_t path_count)
+{
+    int rc;
+    uint32_t i;
+
+    rc = sky_query_finish_object(scan);
+    check(rc == 0, "Unable to count object");
+    scan->object_id = object_id;
+    scan->sequence_index = 0;
+    scan->previous_action_id = 0;
+
+    for(i=0; i<path_count; i++) {
+        rc = sky_query_scan_path(scan, paths[i]);
+        check(rc == 0, "Unable to scan path part #%d", i);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Checks whether a path can affect the result of a query by comparing the
+// summary of the path to the filters and to the actions that the query
+// needs. Paths that are part of a spanned path are always scanned since
+// their state carries over between blocks.
+//
+// scan  - The scan.
+// block - The block that the path is in.
+// entry - The directory entry of the path.
+//
+// Returns true if the path has to be scanned.
+bool sky_query_may_match_path(sky_query_scan *scan, sky_block *block,
+                              sky_block_directory_entry *entry)
+{
+    uint32_t i;
+    sky_query *query = scan->query;
+    if(block->spanned) {
+        return true;
+    }
+    if(!sky_predicate_may_match_path(scan->predicate, entry)) {
+        return false;
+    }
+
+    // A funnel or cohort counts nothing until its first action is seen, a
+    // transition needs two events and a sequence needs all of its actions.
+    // A function may count any path.
+    uint64_t required = 0;
+    if(query->function != NULL) {
+        return true;
+    }
+    else if(query->funnel_length > 0) {
+        required = sky_block_action_bit(query->funnel[0].action_id);
+    }
+    else if(query->cohorted) {
+        required = sky_block_action_bit(query->cohort.action_id);
+    }
+    else if(query->transitions) {
+        return entry->event_count >= 2;
+    }
+    else {
+        for(i=0; i<query->sequence_length; i++) {
+            required |= sky_block_action_bit(query->sequence[i]);
+        }
+    }
+    return (entry->action_mask & required) == required;
+}
+
+// Moves the scan to a new path. The sequence is restarted unless the path
+// continues a spanned path from the previous block, as is the previous action
+// of the path. The funnel or cohort of the previous object is counted when
+// the scan moves to a new object.
+//
+// scan      - The scan.
+// block     - The block that the path is in.
+// object_id - The object id of the path.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_scan_set_object_id(sky_query_scan *scan, sky_block *block,
+                                 sky_object_id_t object_id)
+{
+    int rc;
+    if(!block->spanned || object_id != scan->object_id) {
+        rc = sky_query_finish_object(scan);
+        check(rc == 0, "Unable to count object");
+        scan->sequence_index = 0;
+        scan->previous_action_id = 0;
+    }
+    scan->object_id = object_id;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Passes a single event through the operators of the query.
+//
+// scan        - The scan.
+// action_id   - The action id of the event.
+// timestamp   - The timestamp of the event.
+// data_ptr    - A pointer to the data section of the event or NULL.
+// data_length - The length of the data section.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_process_event(sky_query_scan *scan, sky_action_id_t action_id,
+                            sky_timestamp_t timestamp, void *data_ptr,
+                            uint32_t data_length)
+{
+    int rc;
+    uint32_t i;
+    int64_t value;
+    sky_query *query = scan->query;
+
+    // Filter.
+    if(!scan->predicate->eval(scan->predicate, action_id, timestamp, data_ptr, data_length)) {
+        return 0;
+    }
+
+    // Functions, funnels and cohorts only track the state of the object
+    // until the object is finished.
+    if(query->function != NULL) {
+        scan->function_active = true;
+        rc = query->function->event(scan->function_state, action_id, timestamp, data_ptr, data_length);
+        check(rc == 0, "Unable to pass event to query function");
+        return 0;
+    }
+    if(query->funnel_length > 0) {
+        sky_query_advance_funnel(scan, action_id, timestamp);
+        return 0;
+    }
+    if(query->cohorted) {
+        sky_query_advance_cohort(scan, action_id, timestamp);
+        return 0;
+    }
+
+    // Transitions are keyed by the previous action of the path and the
+    // action of the event. Small action sets are counted in the scan's dense
+    // matrix instead of the result.
+    int64_t key = 0, subkey = 0;
+    if(query->transitions) {
+        sky_action_id_t previous_action_id = scan->previous_action_id;
+        scan->previous_action_id = action_id;
+        if(previous_action_id == 0) {
+            return 0;
+        }
+        uint32_t width = query->transition_action_count + 1;
+        if(scan->transition_counts != NULL && previous_action_id < width && action_id < width) {
+            scan->transition_counts[(previous_action_id * width) + action_id]++;
+            return 0;
+        }
+        key = previous_action_id;
+        subkey = action_id;
+    }
+    else {
+        // Match the sequence. The event is only kept if it immediately
+        // follows a completed sequence.
+        if(query->sequence_length > 0) {
+            bool matched = (scan->sequence_index == query->sequence_length);
+            if(matched) {
+                scan->sequence_index = 0;
+            }
+            if(query->sequence[scan->sequence_index] == action_id) {
+                scan->sequence_index++;
+            }
+            else {
+                scan->sequence_index = 0;
+            }
+
+            if(!matched) {
+                return 0;
+            }
+        }
+
+        // Group.
+        if(query->grouped && !sky_query_get_field(query->group_field, query->group_property_id, action_id, timestamp, data_ptr, data_length, &key)) {
+            return 0;
+        }
+        if(query->group_interval > 0) {
+            key = sky_query_get_period(key, query->group_interval) * query->group_interval;
+        }
+        if(query->subgrouped && !sky_query_get_field(query->subgroup_field, query->subgroup_property_id, action_id, timestamp, data_ptr, data_length, &subkey)) {
+            return 0;
+        }
+    }
+
+    int64_t *values = NULL;
+    rc = sky_query_result_get_subgroup_values(scan->result, key, subkey, &values);
+    check(rc == 0, "Unable to retrieve group values");
+
+    // Aggregate.
+    if(query->aggregate_count == 0) {
+        values[0]++;
+    }
+    for(i=0; i<query->aggregate_count; i++) {
+        sky_query_aggregate *aggregate = &query->aggregates[i];
+        if(aggregate->type == SKY_QUERY_AGGREGATE_COUNT) {
+            values[i]++;
+        }
+        else if(aggregate->type == SKY_QUERY_AGGREGATE_DISTINCT) {
+            sky_hll *sketch = NULL;
+            rc = sky_query_result_get_sketch(scan->result, &values[i], &sketch);
+            check(rc == 0, "Unable to retrieve group sketch");
+            sky_hll_add(sketch, (uint64_t)scan->object_id);
+        }
+        else if(sky_query_get_property(aggregate->property_id, data_ptr, data_length, &value)) {
+            values[i] += value;
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Funnels
+//--------------------------------------
+
+// Advances the funnel of the current object with an event. A step is
+// reached when its action happens within the window of the time that the
+// previous step was last reached. Steps are checked from the last to the
+// first so that an event cannot reach two steps at once.
+//
+// scan      - The scan.
+// action_id - The action id of the event.
+// timestamp - The timestamp of the event.
+void sky_query_advance_funnel(sky_query_scan *scan, sky_action_id_t action_id,
+                              sky_timestamp_t timestamp)
+{
+    uint32_t i;
+    sky_query *query = scan->query;
+    sky_query_funnel_step *steps = query->funnel;
+    sky_timestamp_t *timestamps = scan->funnel_timestamps;
+
+    i = (scan->funnel_index < query->funnel_length ? scan->funnel_index : query->funnel_length - 1);
+    for(; i>0; i--) {
+        if(steps[i].action_id == action_id && (steps[i].window == 0 || timestamp - timestamps[i-1] <= steps[i].window)) {
+            timestamps[i] = timestamp;
+            if(scan->funnel_index == i) {
+                scan->funnel_index++;
+            }
+        }
+    }
+    if(steps[0].action_id == action_id) {
+        timestamps[0] = timestamp;
+        if(scan->funnel_index == 0) {
+            scan->funnel_index = 1;
+        }
+    }
+}
+
+// Tracks the cohort of the current object and the periods in which it
+// returned.
+//
+// scan      - The scan.
+// action_id - The action id of the event.
+// timestamp - The timestamp of the event.
+void sky_query_advance_cohort(sky_query_scan *scan, sky_action_id_t action_id,
+                              sky_timestamp_t timestamp)
+{
+    sky_query_cohort *cohort = &scan->query->cohort;
+
+    if(!scan->cohort_found) {
+        if(action_id == cohort->action_id) {
+            scan->cohort_found = true;
+            scan->cohort_period = sky_query_get_period(timestamp, cohort->interval);
+            scan->cohort_offsets = 1;
+        }
+    }
+    else if(action_id == cohort->return_action_id) {
+        int64_t offset = sky_query_get_period(timestamp, cohort->interval) - scan->cohort_period;
+        if(offset > 0 && offset <= cohort->period_count) {
+            scan->cohort_offsets |= ((uint64_t)1) << offset;
+        }
+    }
+}
+
+// Counts the current object in the groups of the funnel steps or cohort
+// offsets it reached and resets the state for the next object.
+//
+// scan - The scan.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_finish_object(sky_query_scan *scan)
+{
+    int rc;
+    uint32_t i;
+    sky_query *query = scan->query;
+
+    for(i=0; i<scan->funnel_index; i++) {
+        rc = sky_query_aggregate_object(scan, i, 0);
+        check(rc == 0, "Unable to count funnel step");
+    }
+    scan->funnel_index = 0;
+
+    if(scan->cohort_found) {
+        int64_t key = scan->cohort_period * query->cohort.interval;
+        for(i=0; i<=query->cohort.period_count; i++) {
+            if(scan->cohort_offsets & (((uint64_t)1) << i)) {
+                rc = sky_query_aggregate_object(scan, key, i);
+                check(rc == 0, "Unable to count cohort offset");
+            }
+        }
+        scan->cohort_found = false;
+        scan->cohort_offsets = 0;
+    }
+
+    if(scan->function_active) {
+        rc = query->function->finish(scan->function_state, scan->object_id, scan->result);
+        check(rc == 0, "Unable to finish object in query function");
+        memset(scan->function_state, 0, query->function->state_size);
+        scan->function_active = false;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Counts the current object in a group of the scan's result. Count
+// aggregates are incremented and distinct aggregates add the object id.
+//
+// scan   - The scan.
+// key    - The key of the group.
+// subkey - The subkey of the group.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_aggregate_object(sky_query_scan *scan, int64_t key,
+                               int64_t subkey)
+{
+    int rc;
+    uint32_t i;
+    sky_query *query = scan->query;
+
+    int64_t *values = NULL;
+    rc = sky_query_result_get_subgroup_values(scan->result, key, subkey, &values);
+    check(rc == 0, "Unable to retrieve group values");
+
+    if(query->aggregate_count == 0) {
+        values[0]++;
+    }
+    for(i=0; i<query->aggregate_count; i++) {
+        sky_query_aggregate *aggregate = &query->aggregates[i];
+        if(aggregate->type == SKY_QUERY_AGGREGATE_COUNT) {
+            values[i]++;
+        }
+        else if(aggregate->type == SKY_QUERY_AGGREGATE_DISTINCT) {
+            sky_hll *sketch = NULL;
+            rc = sky_query_result_get_sketch(scan->result, &values[i], &sketch);
+            check(rc == 0, "Unable to retrieve group sketch");
+            sky_hll_add(sketch, (uint64_t)scan->object_id);
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Calculates the index of the period that a timestamp falls in. Periods
+// before the epoch have negative indexes.
+//
+// timestamp - The timestamp.
+// interval  - The width of each period.
+//
+// Returns the index of the period.
+int64_t sky_query_get_period(int64_t timestamp, int64_t interval)
+{
+    return (timestamp >= 0 ? timestamp / interval : ((timestamp + 1) / interval) - 1);
+}
+
+
+//--------------------------------------
+// Transitions
+//--------------------------------------
+
+// Checks whether the scans of a transitions query count into dense matrices.
+// A matrix is only used when the action set is small and every aggregate is
+// a count, since the cells can only hold counts.
+//
+// query - The query.
+//
+// Returns true if the scans use dense transition matrices.
+bool sky_query_uses_dense_transitions(sky_query *query)
+{
+    uint32_t i;
+    if(!query->transitions || query->transition_action_count > SKY_QUERY_MAX_DENSE_TRANSITION_ACTIONS) {
+        return false;
+    }
+    for(i=0; i<query->aggregate_count; i++) {
+        if(query->aggregates[i].type != SKY_QUERY_AGGREGATE_COUNT) return false;
+    }
+    return true;
+}
+
+// Adds the non-empty cells of a scan's dense transition matrix to its
+// result and clears the matrix.
+//
+// scan - The scan.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_flush_transitions(sky_query_scan *scan)
+{
+    int rc;
+    uint32_t i, j, k;
+    sky_query *query = scan->query;
+    if(scan->transition_counts == NULL) {
+        return 0;
+    }
+
+    uint32_t width = query->transition_action_count + 1;
+    for(i=0; i<width; i++) {
+        for(j=0; j<width; j++) {
+            uint64_t count = scan->transition_counts[(i * width) + j];
+            if(count == 0) {
+                continue;
+            }
+            int64_t *values = NULL;
+            rc = sky_query_result_get_subgroup_values(scan->result, i, j, &values);
+            check(rc == 0, "Unable to retrieve transition values");
+            for(k=0; k<scan->result->value_count; k++) {
+                values[k] += count;
+            }
+            scan->transition_counts[(i * width) + j] = 0;
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Fields
+//--------------------------------------
+
+// Retrieves the value of a field of an event.
+//
+// field       - The field to retrieve.
+// property_id - The property to retrieve if the field is a property.
+// action_id   - The action id of the event.
+// timestamp   - The timestamp of the event.
+// data_ptr    - A pointer to the data section of the event or NULL.
+// data_length - The length of the data section.
+// value       - A pointer to where the value should be returned.
+//
+// Returns true if the event has the field.
+bool sky_query_get_field(sky_query_field_e field, sky_property_id_t property_id,
+                         sky_action_id_t action_id, sky_timestamp_t timestamp,
+                         void *data_ptr, uint32_t data_length, int64_t *value)
+{
+    switch(field) {
+        case SKY_QUERY_FIELD_ACTION: *value = action_id; return true;
+        case SKY_QUERY_FIELD_TIMESTAMP: *value = timestamp; return true;
+        case SKY_QUERY_FIELD_PROPERTY: return sky_query_get_property(property_id, data_ptr, data_length, value);
+    }
+    return false;
+}
+
+// Retrieves the value of a property from the raw data section of an event.
+// Values in the fixed section are loaded directly. Otherwise each item in the
+// data section is a property id followed by a MessagePack value. String
+// values are not supported and are treated as missing. Values that are
+// dictionary encoded are read as their integer codes.
+//
+// property_id - The property to retrieve.
+// data_ptr    - A pointer to the data section of the event or NULL.
+// data_length - The length of the data section.
+// value       - A pointer to where the value should be returned.
+//
+// Returns true if the event has an integer, boolean or float value for the
+// property.
+bool sky_query_get_property(sky_property_id_t property_id, void *data_ptr,
+                            uint32_t data_length, int64_t *value)
+{
+    sky_event_data_view view;
+    if(sky_event_data_find_fixed(data_ptr, data_length, property_id, &view)) {
+        return sky_event_data_view_get_numeric_value(&view, value);
+    }
+
+    void *ptr = sky_event_data_find(data_ptr, data_length, property_id);
+    return (ptr != NULL && sky_predicate_unpack_value(ptr, value));
+}
+
+// Checks whether any of the objects that a restricted query is limited to
+// has an id within a range.
+//
+// query         - The query.
+// min_object_id - The lowest object id of the range.
+// max_object_id - The highest object id of the range.
+//
+// Returns true if an object of the query is in the range.
+bool sky_query_has_object_in_range(sky_query *query,
+                                   sky_object_id_t min_object_id,
+                                   sky_object_id_t max_object_id)
+{
+    uint32_t min = 0, max = query->object_id_count;
+    while(min < max) {
+        uint32_t mid = min + ((max - min) / 2);
+        if(query->object_ids[mid] < min_object_id) {
+            min = mid + 1;
+        }
+        else {
+            max = mid;
+        }
+    }
+    return (min < query->object_id_count && query->object_ids[min] <= max_object_id);
+}
+
+
+//--------------------------------------
+// Results
+//--------------------------------------
+
+// Retrieves the aggregate values of a group in the result. The group is
+// created with zeroed values if it does not exist yet.
+//
+// result - The result.
+// key    - The key of the group.
+// values - A pointer to where the group's values should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_get_values(sky_query_result *result, int64_t key,
+                                int64_t **values)
+{
+    return sky_query_result_get_subgroup_values(result, key, 0, values);
+}
+
+// Retrieves the aggregate values of a subgroup in the result. The group is
+// created with zeroed values if it does not exist yet.
+//
+// result - The result.
+// key    - The key of the group.
+// subkey - The key of the subgroup within the group.
+// values - A pointer to where the group's values should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_get_subgroup_values(sky_query_result *result,
+                                         int64_t key, int64_t subkey,
+                                         int64_t **values)
+{
+    check(result != NULL, "Result required");
+    check(values != NULL, "Values return pointer required");
+
+    // Binary search for the group.
+    uint32_t lo = 0, hi = result->group_count;
+    while(lo < hi) {
+        uint32_t mid = lo + ((hi - lo) / 2);
+        if(result->keys[mid] < key || (result->keys[mid] == key && result->subkeys[mid] < subkey)) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    // Insert a new group if the key was not found.
+    if(lo == result->group_count || result->keys[lo] != key || result->subkeys[lo] != subkey) {
+        if(result->group_count == result->group_capacity) {
+            uint32_t capacity = (result->group_capacity > 0 ? result->group_capacity * 2 : 16);
+            size_t value_count = result->value_count;
+            if(result->arena != NULL) {
+                result->keys = sky_arena_realloc(result->arena, result->keys, sizeof(*result->keys) * result->group_capacity, sizeof(*result->keys) * capacity);
+                check_mem(result->keys);
+                result->subkeys = sky_arena_realloc(result->arena, result->subkeys, sizeof(*result->subkeys) * result->group_capacity, sizeof(*result->subkeys) * capacity);
+                check_mem(result->subkeys);
+                result->values = sky_arena_realloc(result->arena, result->values, sizeof(*result->values) * result->group_capacity * value_count, sizeof(*result->values) * capacity * value_count);
+                check_mem(result->values);
+            }
+            else {
+                result->keys = realloc(result->keys, sizeof(*result->keys) * capacity);
+                check_mem(result->keys);
+                result->subkeys = realloc(result->subkeys, sizeof(*result->subkeys) * capacity);
+                check_mem(result->subkeys);
+                result->values = realloc(result->values, sizeof(*result->values) * capacity * value_count);
+                check_mem(result->values);
+            }
+            result->group_capacity = capacity;
+        }
+
+        size_t value_size = sizeof(*result->values) * result->value_count;
+        memmove(&result->keys[lo+1], &result->keys[lo], sizeof(*result->keys) * (result->group_count-lo));
+        memmove(&result->subkeys[lo+1], &result->subkeys[lo], sizeof(*result->subkeys) * (result->group_count-lo));
+        memmove(&result->values[(lo+1) * result->value_count], &result->values[lo * result->value_count], value_size * (result->group_count-lo));
+        result->keys[lo] = key;
+        result->subkeys[lo] = subkey;
+        memset(&result->values[lo * result->value_count], 0, value_size);
+        result->group_count++;
+    }
+
+    *values = &result->values[lo * result->value_count];
+    return 0;
+
+error:
+    if(values) *values = NULL;
+    return -1;
+}
+
+// Retrieves the sketch of a distinct aggregate value. A new empty sketch is
+// created if the value does not refer to one yet.
+//
+// result - The result.
+// value  - A pointer to the aggregate value.
+// sketch - A pointer to where the sketch should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_get_sketch(sky_query_result *result, int64_t *value,
+                                sky_hll **sketch)
+{
+    check(result != NULL, "Result required");
+    check(value != NULL, "Value required");
+    check(sketch != NULL, "Sketch return pointer required");
+
+    if(*value == 0) {
+        if(result->sketch_count == result->sketch_capacity) {
+            uint32_t capacity = (result->sketch_capacity > 0 ? result->sketch_capacity * 2 : 16);
+            if(result->arena != NULL) {
+                result->sketches = sky_arena_realloc(result->arena, result->sketches, sizeof(*result->sketches) * result->sketch_capacity, sizeof(*result->sketches) * capacity);
+            }
+            else {
+                result->sketches = realloc(result->sketches, sizeof(*result->sketches) * capacity);
+            }
+            check_mem(result->sketches);
+            result->sketch_capacity = capacity;
+        }
+
+        sky_hll *hll = (result->arena != NULL ? sky_arena_calloc(result->arena, 1, sizeof(sky_hll)) : sky_hll_create());
+        check_mem(hll);
+        result->sketches[result->sketch_count++] = hll;
+        *value = result->sketch_count;
+    }
+
+    *sketch = result->sketches[*value - 1];
+    return 0;
+
+error:
+    if(sketch) *sketch = NULL;
+    return -1;
+}
+
+// Removes the groups whose aggregate values are all zero.
+//
+// result - The result.
+void sky_query_result_remove_empty_groups(sky_query_result *result)
+{
+    uint32_t i, j;
+    uint32_t group_count = 0;
+    size_t value_size = sizeof(*result->values) * result->value_count;
+
+    for(i=0; i<result->group_count; i++) {
+        int64_t *values = &result->values[i * result->value_count];
+        bool empty = true;
+        for(j=0; j<result->value_count && empty; j++) {
+            empty = (values[j] == 0);
+        }
+        if(!empty) {
+            if(group_count != i) {
+                result->keys[group_count] = result->keys[i];
+                result->subkeys[group_count] = result->subkeys[i];
+                memmove(&result->values[group_count * result->value_count], values, value_size);
+            }
+            group_count++;
+        }
+    }
+    result->group_count = group_count;
+}
+
+// Adds the groups of one result into another result. Both results must be
+// for the same query. The sketches of distinct aggregates are merged.
+//
+// result - The result to merge into.
+// source - The result to merge from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_merge(sky_query_result *result, sky_query_result *source)
+{
+    int rc;
+    uint32_t i, j;
+    check(result != NULL, "Result required");
+    check(source != NULL, "Source result required");
+    check(result->value_count == source->value_count, "Results must have the same aggregates");
+
+    for(i=0; i<source->group_count; i++) {
+        int64_t *values = NULL;
+        rc = sky_query_result_get_subgroup_values(result, source->keys[i], source->subkeys[i], &values);
+        check(rc == 0, "Unable to retrieve group values");
+        for(j=0; j<source->value_count; j++) {
+            int64_t value = source->values[(i * source->value_count) + j];
+            if(source->distinct != NULL && source->distinct[j]) {
+                if(value > 0) {
+                    sky_hll *sketch = NULL;
+                    rc = sky_query_result_get_sketch(result, &values[j], &sketch);
+                    check(rc == 0, "Unable to retrieve group sketch");
+                    sky_hll_merge(sketch, source->sketches[value - 1]);
+                }
+            }
+            else {
+                values[j] += value;
+            }
+        }
+    }
+    result->event_count += source->event_count;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes the aggregates of a result to a file stream. Grouped results
+// are written as a map of group keys to aggregate maps. Subgrouped results
+// nest a map of subgroup keys inside each group, as do cohort results with
+// the cohort periods and offsets. Bucketed results are written as a dense
+// array of buckets and funnel results as a map of every step. Ungrouped
+// results are written as a single aggregate map.
+//
+//   Grouped:    {<key>:{<name>:<value>, ...}, ...}
+//   Subgrouped: {<key>:{<subkey>:{<name>:<value>, ...}, ...}, ...}
+//   Cohort:     {<period>:{<offset>:{<name>:<value>, ...}, ...}, ...}
+//   Transition: {<action_id>:{<next_action_id>:{<name>:<value>, ...}, ...}, ...}
+//   Ungrouped:  {<name>:<value>, ...}
+//
+// Keys of a property with dictionary encoded values are written as their
+// string values. Distinct aggregates are written as their estimates.
+//
+// result          - The result.
+// query           - The query that produced the result.
+// dictionary_file - The dictionary file used to decode group keys. This can
+//                   be null.
+// buffer          - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_pack(sky_query_result *result, sky_query *query,
+                          sky_dictionary_file *dictionary_file, sky_buffer *buffer)
+{
+    int rc;
+    check(result != NULL, "Result required");
+    check(query != NULL, "Query required");
+    check(buffer != NULL, "Buffer required");
+
+    if(query->funnel_length > 0) {
+        return sky_query_result_pack_funnel(result, query, buffer);
+    }
+    if(query->grouped && query->group_interval > 0 && !query->subgrouped) {
+        return sky_query_result_pack_buckets(result, query, buffer);
+    }
+
+    // An ungrouped result without any events is written as zeros.
+    if(!sky_query_is_grouped(query)) {
+        rc = sky_query_result_pack_values(result, query, (result->group_count > 0 ? result->values : NULL), buffer);
+        check(rc == 0, "Unable to write aggregates");
+        return 0;
+    }
+
+    rc = sky_query_result_pack_groups(result, query, dictionary_file, 0, result->group_count, buffer);
+    check(rc == 0, "Unable to write groups");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes the aggregates of a result as a series of frames so that a
+// large result does not have to be encoded all at once. Grouped results are
+// split into frames of up to a given number of top level keys. Other
+// results are written as a single frame. The buffer is flushed after each
+// frame.
+//
+//   {data:<part>}
+//
+// The parts of a grouped result are maps in the format written by
+// `sky_query_result_pack()` and together they hold every key once.
+//
+// result          - The result.
+// query           - The query that produced the result.
+// dictionary_file - The dictionary file used to decode group keys. This can
+//                   be null.
+// key_count       - The maximum number of top level keys in each frame.
+// buffer          - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_pack_stream(sky_query_result *result, sky_query *query,
+                                 sky_dictionary_file *dictionary_file,
+                                 uint32_t key_count, sky_buffer *buffer)
+{
+    int rc;
+    check(result != NULL, "Result required");
+    check(query != NULL, "Query required");
+    check(key_count > 0, "Frame key count required");
+    check(buffer != NULL, "Buffer required");
+
+    struct tagbstring data_str = bsStatic("data");
+
+    // Funnels and buckets are written whole since each is a fixed shape.
+    bool chunked = sky_query_is_grouped(query) && query->funnel_length == 0
+        && !(query->grouped && query->group_interval > 0 && !query->subgrouped);
+    if(!chunked || result->group_count == 0) {
+        check(sky_buffer_pack_map(buffer, 1) == 0, "Unable to write frame map");
+        check(sky_buffer_pack_bstring(buffer, &data_str) == 0, "Unable to write data key");
+        rc = sky_query_result_pack(result, query, dictionary_file, buffer);
+        check(rc == 0, "Unable to write result");
+        rc = sky_buffer_flush(buffer);
+        check(rc == 0, "Unable to flush frame");
+        return 0;
+    }
+
+    // Split the groups on key boundaries so that the subgroups of a key are
+    // never spread over two frames.
+    bool subgrouped = (query->cohorted || query->transitions || (query->grouped && query->subgrouped));
+    uint32_t start = 0;
+    while(start < result->group_count) {
+        uint32_t end = start, count = 0;
+        while(end < result->group_count) {
+            bool new_key = (end == start || !subgrouped || result->keys[end] != result->keys[end-1]);
+            if(new_key && count == key_count) break;
+            if(new_key) count++;
+            end++;
+        }
+
+        check(sky_buffer_pack_map(buffer, 1) == 0, "Unable to write frame map");
+        check(sky_buffer_pack_bstring(buffer, &data_str) == 0, "Unable to write data key");
+        rc = sky_query_result_pack_groups(result, query, dictionary_file, start, end, buffer);
+        check(rc == 0, "Unable to write groups");
+        rc = sky_buffer_flush(buffer);
+        check(rc == 0, "Unable to flush frame");
+        start = end;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes the aggregates of a grouped result as parallel columns instead
+// of nested maps. Each group is a row of the columns and the rows are in key
+// order. The keys, subkeys and values are raw blobs of little-endian 64-bit
+// integers so a client can copy them straight into an array. The values are
+// stored row by row with one value for each name. Subkeys are only written
+// for subgrouped results.
+//
+//   {names:[<name>, ...], keys:<int64[]>, subkeys:<int64[]>, values:<int64[]>}
+//
+// Keys of a property with dictionary encoded values are written as an
+// array of their string values instead of a blob. Distinct aggregates are
+// written as their estimates. Ungrouped, bucketed and funnel results are
+// already compact and are written as `sky_query_result_pack()` does.
+//
+// result          - The result.
+// query           - The query that produced the result.
+// dictionary_file - The dictionary file used to decode group keys. This can
+//                   be null.
+// buffer          - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_pack_columns(sky_query_result *result, sky_query *query,
+                                  sky_dictionary_file *dictionary_file,
+                                  sky_buffer *buffer)
+{
+    int rc;
+    uint32_t i;
+    check(result != NULL, "Result required");
+    check(query != NULL, "Query required");
+    check(buffer != NULL, "Buffer required");
+
+    struct tagbstring names_str = bsStatic("names");
+    struct tagbstring keys_str = bsStatic("keys");
+    struct tagbstring subkeys_str = bsStatic("subkeys");
+    struct tagbstring values_str = bsStatic("values");
+    struct tagbstring count_str = bsStatic("count");
+
+    bool chunked = sky_query_is_grouped(query) && query->funnel_length == 0
+        && !(query->grouped && query->group_interval > 0 && !query->subgrouped);
+    if(!chunked) {
+        return sky_query_result_pack(result, query, dictionary_file, buffer);
+    }
+
+    bool subgrouped = (query->cohorted || query->transitions || (query->grouped && query->subgrouped));
+    sky_query_field_e group_field = (query->cohorted ? SKY_QUERY_FIELD_TIMESTAMP : (query->transitions ? SKY_QUERY_FIELD_ACTION : query->group_field));
+    sky_query_field_e subgroup_field = (query->cohorted ? SKY_QUERY_FIELD_TIMESTAMP : (query->transitions ? SKY_QUERY_FIELD_ACTION : query->subgroup_field));
+
+    check(sky_buffer_pack_map(buffer, (subgrouped ? 4 : 3)) == 0, "Unable to write column map");
+    check(sky_buffer_pack_bstring(buffer, &names_str) == 0, "Unable to write names key");
+    check(sky_buffer_pack_array(buffer, result->value_count) == 0, "Unable to write names");
+    for(i=0; i<result->value_count; i++) {
+        bstring name = (query->aggregate_count > 0 ? query->aggregates[i].name : &count_str);
+        check(sky_buffer_pack_bstring(buffer, name) == 0, "Unable to write aggregate name");
+    }
+
+    check(sky_buffer_pack_bstring(buffer, &keys_str) == 0, "Unable to write keys key");
+    rc = sky_query_result_pack_key_column(result, group_field, query->group_property_id, result->keys, dictionary_file, buffer);
+    check(rc == 0, "Unable to write keys");
+    if(subgrouped) {
+        check(sky_buffer_pack_bstring(buffer, &subkeys_str) == 0, "Unable to write subkeys key");
+        rc = sky_query_result_pack_key_column(result, subgroup_field, query->subgroup_property_id, result->subkeys, dictionary_file, buffer);
+        check(rc == 0, "Unable to write subkeys");
+    }
+
+    check(sky_buffer_pack_bstring(buffer, &values_str) == 0, "Unable to write values key");
+    check(result->group_count <= UINT32_MAX / result->value_count, "Too many values for a column: %d", result->group_count);
+    rc = sky_query_result_pack_column(result, result->values, result->group_count * result->value_count, true, buffer);
+    check(rc == 0, "Unable to write values");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes a range of the groups of a grouped result as a map of group
+// keys to aggregate maps. Groups that share a key are written under a single
+// key when the result is subgrouped so the range must not split a key.
+// Cohort results are keyed by period and offset and transition results by
+// the previous action and the action.
+//
+// result          - The result.
+// query           - The query that produced the result.
+// dictionary_file - The dictionary file used to decode group keys. This can
+//                   be null.
+// start           - The index of the first group to write.
+// end             - The index after the last group to write.
+// buffer          - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_pack_groups(sky_query_result *result, sky_query *query,
+                                 sky_dictionary_file *dictionary_file,
+                                 uint32_t start, uint32_t end,
+                                 sky_buffer *buffer)
+{
+    int rc;
+    uint32_t i;
+
+    bool subgrouped = (query->cohorted || query->transitions || (query->grouped && query->subgrouped));
+    sky_query_field_e group_field = (query->cohorted ? SKY_QUERY_FIELD_TIMESTAMP : (query->transitions ? SKY_QUERY_FIELD_ACTION : query->group_field));
+    sky_query_field_e subgroup_field = (query->cohorted ? SKY_QUERY_FIELD_TIMESTAMP : (query->transitions ? SKY_QUERY_FIELD_ACTION : query->subgroup_field));
+    uint32_t key_count = end - start;
+    if(subgrouped) {
+        for(i=start+1; i<end; i++) {
+            if(result->keys[i] == result->keys[i-1]) key_count--;
+        }
+    }
+    check(sky_buffer_pack_map(buffer, key_count) == 0, "Unable to write group map");
+
+    for(i=start; i<end; i++) {
+        if(i == start || !subgrouped || result->keys[i] != result->keys[i-1]) {
+            rc = sky_query_result_pack_key(group_field, query->group_property_id, result->keys[i], dictionary_file, buffer);
+            check(rc == 0, "Unable to write group key");
+
+            if(subgrouped) {
+                uint32_t subkey_count = 1;
+                while(i+subkey_count < end && result->keys[i+subkey_count] == result->keys[i]) {
+                    subkey_count++;
+                }
+                check(sky_buffer_pack_map(buffer, subkey_count) == 0, "Unable to write subgroup map");
+            }
+        }
+        if(subgrouped) {
+            rc = sky_query_result_pack_key(subgroup_field, query->subgroup_property_id, result->subkeys[i], dictionary_file, buffer);
+            check(rc == 0, "Unable to write subgroup key");
+        }
+
+        rc = sky_query_result_pack_values(result, query, &result->values[i * result->value_count], buffer);
+        check(rc == 0, "Unable to write aggregates");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Checks whether the results of a query are keyed by group. Cohort,
+// transition and function results are always grouped.
+//
+// query - The query.
+//
+// Returns true if the results are grouped.
+bool sky_query_is_grouped(sky_query *query)
+{
+    return (query->grouped || query->cohorted || query->transitions || query->function != NULL);
+}
+
+// Checks whether the query of a result was stopped by its deadline or its
+// cancellation flag.
+//
+// result - The result.
+//
+// Returns true if the query was stopped.
+bool sky_query_result_is_stopped(sky_query_result *result)
+{
+    return (result != NULL && (result->timed_out || result->cancelled));
+}
+
+// Serializes the response to a query that was stopped.
+//
+//   {status:"timeout"} or {status:"cancelled"}
+//
+// result - The result of the stopped query.
+// buffer - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_pack_stopped(sky_query_result *result,
+                                  sky_buffer *buffer)
+{
+    check(result != NULL, "Result required");
+    check(buffer != NULL, "Buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring timeout_str = bsStatic("timeout");
+    struct tagbstring cancelled_str = bsStatic("cancelled");
+
+    check(sky_buffer_pack_map(buffer, 1) == 0, "Unable to write status map");
+    check(sky_buffer_pack_bstring(buffer, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(buffer, (result->cancelled ? &cancelled_str : &timeout_str)) == 0, "Unable to write status");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes a bucketed result as a dense array of aggregate maps. Buckets
+// without events are written as zeros.
+//
+//   {start:<timestamp>, interval:<interval>, buckets:[{<name>:<value>, ...}, ...]}
+//
+// result - The result.
+// query  - The query that produced the result.
+// buffer - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_pack_buckets(sky_query_result *result, sky_query *query,
+                                  sky_buffer *buffer)
+{
+    int rc;
+    uint32_t i;
+    struct tagbstring start_str = bsStatic("start");
+    struct tagbstring interval_str = bsStatic("interval");
+    struct tagbstring buckets_str = bsStatic("buckets");
+
+    int64_t start = (result->group_count > 0 ? result->keys[0] : 0);
+    uint64_t bucket_count = 0;
+    if(result->group_count > 0) {
+        bucket_count = ((uint64_t)(result->keys[result->group_count-1] - start) / query->group_interval) + 1;
+    }
+    check(bucket_count <= SKY_QUERY_MAX_BUCKET_COUNT, "Too many buckets in result: %llu", (unsigned long long)bucket_count);
+
+    check(sky_buffer_pack_map(buffer, 3) == 0, "Unable to write bucket map");
+    check(sky_buffer_pack_bstring(buffer, &start_str) == 0, "Unable to write start key");
+    rc = (start >= 0 ? sky_buffer_pack_uint(buffer, (uint64_t)start) : sky_buffer_pack_int(buffer, start));
+    check(rc == 0, "Unable to write start");
+    check(sky_buffer_pack_bstring(buffer, &interval_str) == 0, "Unable to write interval key");
+    check(sky_buffer_pack_uint(buffer, (uint64_t)query->group_interval) == 0, "Unable to write interval");
+    check(sky_buffer_pack_bstring(buffer, &buckets_str) == 0, "Unable to write buckets key");
+    check(sky_buffer_pack_array(buffer, (uint32_t)bucket_count) == 0, "Unable to write bucket array");
+
+    // Walk the groups alongside the buckets since both are in time order.
+    uint32_t index = 0;
+    for(i=0; i<bucket_count; i++) {
+        int64_t *values = NULL;
+        if(index < result->group_count && result->keys[index] == start + ((int64_t)i * query->group_interval)) {
+            values = &result->values[index * result->value_count];
+            index++;
+        }
+        rc = sky_query_result_pack_values(result, query, values, buffer);
+        check(rc == 0, "Unable to write bucket aggregates");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes a funnel result as a map of step indexes to aggregate maps.
+// Every step is written, with zeros for steps that no object reached.
+//
+//   {<step>:{<name>:<value>, ...}, ...}
+//
+// result - The result.
+// query  - The query that produced the result.
+// buffer - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_pack_funnel(sky_query_result *result, sky_query *query,
+                                 sky_buffer *buffer)
+{
+    int rc;
+    uint32_t i;
+
+    check(sky_buffer_pack_map(buffer, query->funnel_length) == 0, "Unable to write funnel map");
+
+    // The groups are keyed by step index and are already in step order.
+    uint32_t index = 0;
+    for(i=0; i<query->funnel_length; i++) {
+        int64_t *values = NULL;
+        if(index < result->group_count && result->keys[index] == i) {
+            values = &result->values[index * result->value_count];
+            index++;
+        }
+        check(sky_buffer_pack_uint(buffer, i) == 0, "Unable to write funnel step");
+        rc = sky_query_result_pack_values(result, query, values, buffer);
+        check(rc == 0, "Unable to write funnel step aggregates");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes the aggregate values of a single group as a map.
+//
+// result - The result.
+// query  - The query that produced the result.
+// values - The values of the group or NULL to write zeros.
+// buffer - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_pack_values(sky_query_result *result, sky_query *query,
+                                 int64_t *values, sky_buffer *buffer)
+{
+    int rc;
+    uint32_t i;
+    struct tagbstring count_str = bsStatic("count");
+
+    check(sky_buffer_pack_map(buffer, result->value_count) == 0, "Unable to write aggregate map");
+    for(i=0; i<result->value_count; i++) {
+        bstring name = (query->aggregate_count > 0 ? query->aggregates[i].name : &count_str);
+        check(sky_buffer_pack_bstring(buffer, name) == 0, "Unable to write aggregate name");
+        int64_t value = (values != NULL ? values[i] : 0);
+        if(result->distinct != NULL && result->distinct[i]) {
+            value = (value > 0 ? (int64_t)sky_hll_count(result->sketches[value - 1]) : 0);
+        }
+        rc = (value >= 0 ? sky_buffer_pack_uint(buffer, (uint64_t)value) : sky_buffer_pack_int(buffer, value));
+        check(rc == 0, "Unable to write aggregate value");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes a group key. Keys of a property with dictionary encoded values
+// are written as their string values.
+//
+// field           - The field that the key is a value of.
+// property_id     - The property if the field is a property.
+// key             - The key.
+// dictionary_file - The dictionary file used to decode the key. This can be
+//                   null.
+// buffer          - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_pack_key(sky_query_field_e field,
+                              sky_property_id_t property_id, int64_t key,
+                              sky_dictionary_file *dictionary_file,
+                              sky_buffer *buffer)
+{
+    int rc;
+    bstring value = NULL;
+    if(field == SKY_QUERY_FIELD_PROPERTY && sky_dictionary_file_has_property(dictionary_file, property_id)) {
+        rc = sky_dictionary_file_find_value(dictionary_file, property_id, key, &value);
+        check(rc == 0, "Unable to decode group key");
+    }
+    if(value != NULL) {
+        rc = sky_buffer_pack_bstring(buffer, value);
+    }
+    else {
+        rc = (key >= 0 ? sky_buffer_pack_uint(buffer, (uint64_t)key) : sky_buffer_pack_int(buffer, key));
+    }
+    check(rc == 0, "Unable to write group key");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+// Serializes a column of 64-bit integers as a raw blob in little-endian
+// order. On little-endian machines a column without distinct values is
+// copied in one piece.
+//
+// result  - The result.
+// values  - The integers.
+// count   - The number of integers.
+// resolve - Whether the integers are aggregate values whose distinct
+//           aggregates are replaced with their estimates.
+// buffer  - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_pack_column(sky_query_result *result, int64_t *values,
+                                 uint32_t count, bool resolve,
+                                 sky_buffer *buffer)
+{
+    uint32_t i;
+    void *ptr = NULL;
+    check(count <= UINT32_MAX / sizeof(*values), "Column too large: %d", count);
+    uint32_t length = count * sizeof(*values);
+
+    int rc = sky_buffer_reserve_raw(buffer, length, &ptr);
+    check(rc == 0, "Unable to reserve column");
+
+    uint8_t *data = (uint8_t*)ptr;
+    bool distinct = (resolve && result->distinct != NULL);
+    if(!distinct && BYTE_ORDER == LITTLE_ENDIAN) {
+        if(length > 0) {
+            memcpy(data, values, length);
+        }
+    }
+    else {
+        for(i=0; i<count; i++) {
+            int64_t value = values[i];
+            if(distinct && result->distinct[i % result->value_count]) {
+                value = (value > 0 ? (int64_t)sky_hll_count(result->sketches[value - 1]) : 0);
+            }
+            uint64_t word = htolell((uint64_t)value);
+            memcpy(data + (i * sizeof(word)), &word, sizeof(word));
+        }
+    }
+    buffer->length += length;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Serializes a column of group keys. Keys of a property with dictionary
+// encoded values are written as an array of their string values and other
+// keys as a raw blob of integers.
+//
+// result          - The result.
+// field           - The field that the keys are values of.
+// property_id     - The property if the field is a property.
+// keys            - The keys of every group.
+// dictionary_file - The dictionary file used to decode the keys. This can
+//                   be null.
+// buffer          - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_result_pack_key_column(sky_query_result *result,
+                                     sky_query_field_e field,
+                                     sky_property_id_t property_id,
+                                     int64_t *keys,
+                                     sky_dictionary_file *dictionary_file,
+                                     sky_buffer *buffer)
+{
+    int rc;
+    uint32_t i;
+
+    if(field != SKY_QUERY_FIELD_PROPERTY || !sky_dictionary_file_has_property(dictionary_file, property_id)) {
+        return sky_query_result_pack_column(result, keys, result->group_count, false, buffer);
+    }
+
+    check(sky_buffer_pack_array(buffer, result->group_count) == 0, "Unable to write key array");
+    for(i=0; i<result->group_count; i++) {
+        rc = sky_query_result_pack_key(field, property_id, keys[i], dictionary_file, buffer);
+        check(rc == 0, "Unable to write key");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Profiling
+//--------------------------------------
+
+// Adds the counters and timings of one profile to another.
+//
+// profile - The profile to add to.
+// source  - The profile to add.
+void sky_query_profile_add(sky_query_profile *profile, sky_query_profile *source)
+{
+    profile->blocks_visited += source->blocks_visited;
+    profile->blocks_skipped += source->blocks_skipped;
+    profile->paths_skipped += source->paths_skipped;
+    profile->path_count += source->path_count;
+    profile->event_count += source->event_count;
+    profile->byte_count += source->byte_count;
+    profile->minor_faults += source->minor_faults;
+    profile->major_faults += source->major_faults;
+    profile->memtable_time += source->memtable_time;
+    profile->plan_time += source->plan_time;
+    profile->scan_time += source->scan_time;
+    profile->merge_time += source->merge_time;
+    profile->encode_time += source->encode_time;
+}
+
+// Serializes a query profile to a buffer as a map:
+//
+//   {blocksVisited:<n>, blocksSkipped:<n>, paths:<n>, events:<n>,
+//    bytes:<n>, minorFaults:<n>, majorFaults:<n>, time:{memtable:<us>,
+//    plan:<us>, scan:<us>, merge:<us>, encode:<us>}}
+//
+// The count of skipped paths is only kept in memory so that the layout of
+// the map stays the same for clients.
+//
+// profile - The profile.
+// buffer  - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_profile_pack(sky_query_profile *profile, sky_buffer *buffer)
+{
+    uint32_t i;
+    check(profile != NULL, "Profile required");
+    check(buffer != NULL, "Buffer required");
+
+    struct tagbstring time_str = bsStatic("time");
+    struct tagbstring counter_names[] = {
+        bsStatic("blocksVisited"), bsStatic("blocksSkipped"), bsStatic("paths"),
+        bsStatic("events"), bsStatic("bytes"), bsStatic("minorFaults"),
+        bsStatic("majorFaults"),
+    };
+    uint64_t counters[] = {
+        profile->blocks_visited, profile->blocks_skipped, profile->path_count,
+        profile->event_count, profile->byte_count, profile->minor_faults,
+        profile->major_faults,
+    };
+    struct tagbstring time_names[] = {
+        bsStatic("memtable"), bsStatic("plan"), bsStatic("scan"),
+        bsStatic("merge"), bsStatic("encode"),
+    };
+    int64_t times[] = {
+        profile->memtable_time, profile->plan_time, profile->scan_time,
+        profile->merge_time, profile->encode_time,
+    };
+    uint32_t counter_count = sizeof(counters) / sizeof(*counters);
+    uint32_t time_count = sizeof(times) / sizeof(*times);
+
+    check(sky_buffer_pack_map(buffer, counter_count + 1) == 0, "Unable to write profile map");
+    for(i=0; i<counter_count; i++) {
+        check(sky_buffer_pack_bstring(buffer, &counter_names[i]) == 0, "Unable to write profile key");
+        check(sky_buffer_pack_uint(buffer, counters[i]) == 0, "Unable to write profile value");
+    }
+    check(sky_buffer_pack_bstring(buffer, &time_str) == 0, "Unable to write time key");
+    check(sky_buffer_pack_map(buffer, time_count) == 0, "Unable to write time map");
+    for(i=0; i<time_count; i++) {
+        check(sky_buffer_pack_bstring(buffer, &time_names[i]) == 0, "Unable to write time key");
+        check(sky_buffer_pack_uint(buffer, (uint64_t)(times[i] > 0 ? times[i] : 0)) == 0, "Unable to write time value");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
@@ -0,0 +1,385 @@
+#ifndef _query_h
+#define _query_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct sky_query sky_query;
+typedef struct sky_query_result sky_query_result;
+
+#include "bstring.h"
+#include "buffer.h"
+#include "types.h"
+#include "data_file.h"
+#include "partition_set.h"
+#include "dictionary_file.h"
+#include "arena.h"
+#include "hll.h"
+#include "query_function.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A query is a plan that is executed over every event in a table in a single
+// scan. Each event passes through the operators of the plan in order:
+//
+//   1. Filters   - The event is dropped unless every filter accepts it. A
+//                  filter accepts an event when a field of the event is
+//                  within an inclusive range.
+//   2. Sequence  - If a sequence of action ids is set then only the event
+//                  immediately following the sequence in a path is kept. The
+//                  sequence only sees events that passed the filters.
+//   3. Group By  - The event is assigned to a group by the value of a field.
+//                  Events missing the field are dropped. Without a group by
+//                  all events belong to a single group. A grouped query can
+//                  also be subgrouped by a second field, in which case each
+//                  group is keyed by the pair of values. Queries grouped by
+//                  timestamp can set an interval to group events into time
+//                  buckets of that width.
+//   4. Aggregate - Each aggregate of the event's group is updated. A count
+//                  aggregate counts events, a sum aggregate adds up the
+//                  integer values of a property and a distinct aggregate
+//                  estimates the number of distinct objects.
+//
+// Fields are either the action id or the timestamp of an event or the value
+// of one of its properties. Integer, boolean and float property values can
+// be used. Floats are truncated to integers.
+//
+// The blocks of the table are split into ranges that are scanned in parallel
+// and the partial results are merged at the end. Plans that only use actions
+// and timestamps are scanned through the block columns instead of the raw
+// events. The scan works from a snapshot of the block array taken inside the
+// data file's epoch, so the array can be replaced while the scan runs.
+//
+// A partitioned table is scanned one object at a time on the calling thread
+// instead. Only the partitions that overlap the timestamp filters are read
+// and the parts of each path are passed through the operators in time
+// order, so a sequence, funnel or cohort carries across partitions.
+//
+// A funnel replaces the sequence, group by and aggregate operators with a
+// per object match of a series of steps. Each step is an action that must
+// happen within a window of time after the previous step, with any other
+// events allowed in between. The scan keeps the latest time that each step
+// was reached for the current object so later attempts can still complete
+// the funnel after an earlier one runs out of time. When the scan moves to
+// the next object, the object is counted in one group for each step that it
+// reached, keyed by step index. Count aggregates count the objects and
+// distinct aggregates estimate them. Sum aggregates are ignored.
+//
+// A cohort query also replaces those operators. Each object joins the
+// cohort of the period in which it first performs the cohort action and is
+// counted at offset zero of that cohort. It is counted again at each later
+// offset, up to the number of periods, in which it performs the return
+// action. The whole retention matrix is built in one scan and each group is
+// keyed by the first timestamp of the cohort's period with the offset as the
+// subkey. Aggregates work the same way as for funnels.
+//
+// A transitions query replaces the sequence and group by operators. Each
+// event after the first one of a path is grouped by the action of the event
+// before it in the path and its own action, which builds the whole graph of
+// action transitions in one scan. Scans over small action sets with only
+// count aggregates count into a dense matrix that is indexed by the pair of
+// actions and is moved into the result when the scan ends.
+//
+// Bucketed results are packed as a dense array that runs from the first
+// bucket with events to the last one, with zeros for the empty buckets in
+// between. The scan computes the bucket of each event on the fly so plans
+// that only need actions and timestamps still run through the block columns,
+// and a timestamp filter limits the scan to the blocks in its range.
+//
+// A query function also replaces the sequence, group by and aggregate
+// operators with a user defined aggregation that is called on the events
+// of each object and adds the object to the groups of its choice when the
+// scan moves past it. See query_function.h.
+//
+// A query can be restricted to a sorted set of candidate objects, such as
+// the objects that an action index says have performed every action of the
+// sequence. Restrictions from several indexes are intersected. Blocks whose
+// object id range holds no candidate are skipped and the paths of other
+// objects are not read.
+//
+// Paths are also skipped by their summary in the block directory. A path
+// is not read if its timestamps are outside the filter range, if it never
+// performs an action that the filters, sequence, funnel or cohort need, or
+// if a transitions query finds fewer than two events in it.
+//
+// A query can be given a deadline and a cancellation flag. Every scan
+// thread checks both before each block it scans and stops once the
+// deadline has passed or the flag is set. The query then fails and its
+// result is marked as timed out or cancelled so that the caller can tell a
+// stopped query from a failed one. Checking once per block keeps the cost
+// to a clock read per block while bounding how long a stopped scan runs.
+//
+// Distinct aggregates keep a HyperLogLog sketch of object ids for each group
+// so they use constant memory per group however many objects match. The
+// value of a distinct aggregate in a result is the index of its sketch plus
+// one, or zero if the group has no sketch yet. Sketches are merged when
+// partial results are merged and the estimate is written when the result is
+// packed.
+//
+// A result can have a profile attached to it before the query is executed.
+// The scan then counts the blocks it visits and skips, the paths, events and
+// bytes it reads and the page faults taken by the scan threads, and times
+// each phase of the execution. Page faults are counted per thread where the
+// platform supports it and for the whole process otherwise. Callers can add
+// their own phases, such as merging the memtable or encoding the result,
+// before packing the profile.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// The fields of an event that operators can read.
+typedef enum sky_query_field_e {
+    SKY_QUERY_FIELD_ACTION,
+    SKY_QUERY_FIELD_TIMESTAMP,
+    SKY_QUERY_FIELD_PROPERTY,
+} sky_query_field_e;
+
+// The types of aggregates that can be calculated for each group.
+typedef enum sky_query_aggregate_e {
+    SKY_QUERY_AGGREGATE_COUNT,
+    SKY_QUERY_AGGREGATE_SUM,
+    SKY_QUERY_AGGREGATE_DISTINCT,
+} sky_query_aggregate_e;
+
+// A step of a funnel. The window is the longest time allowed since the
+// previous step was reached or zero for no limit. The window of the first
+// step is not used.
+typedef struct sky_query_funnel_step {
+    sky_action_id_t action_id;
+    sky_timestamp_t window;
+} sky_query_funnel_step;
+
+// A retention analysis of objects grouped by the period of their first
+// cohort action. Periods are `interval` wide and up to `period_count`
+// periods after the cohort's own period are tracked.
+typedef struct sky_query_cohort {
+    sky_action_id_t action_id;
+    sky_action_id_t return_action_id;
+    sky_timestamp_t interval;
+    uint32_t period_count;
+} sky_query_cohort;
+
+// Accepts events whose field value is between min and max (inclusive).
+typedef struct sky_query_filter {
+    sky_query_field_e field;
+    sky_property_id_t property_id;
+    int64_t min;
+    int64_t max;
+} sky_query_filter;
+
+// A value calculated for each group. The name is used as its key in the
+// results.
+typedef struct sky_query_aggregate {
+    sky_query_aggregate_e type;
+    sky_property_id_t property_id;
+    bstring name;
+} sky_query_aggregate;
+
+struct sky_query {
+    sky_query_filter *filters;
+    uint32_t filter_count;
+    sky_action_id_t *sequence;
+    uint32_t sequence_length;
+    sky_query_funnel_step *funnel;
+    uint32_t funnel_length;
+    bool cohorted;
+    sky_query_cohort cohort;
+    bool transitions;
+    uint32_t transition_action_count;
+    sky_query_function *function;
+    bool grouped;
+    sky_query_field_e group_field;
+    sky_property_id_t group_property_id;
+    int64_t group_interval;
+    bool subgrouped;
+    sky_query_field_e subgroup_field;
+    sky_property_id_t subgroup_property_id;
+    sky_query_aggregate *aggregates;
+    uint32_t aggregate_count;
+    bool restricted;
+    sky_object_id_t *object_ids;
+    uint32_t object_id_count;
+    int64_t deadline;
+    volatile bool *cancelled;
+};
+
+// The counters and phase timings of a profiled query. Times are in
+// microseconds.
+typedef struct sky_query_profile {
+    uint64_t blocks_visited;
+    uint64_t blocks_skipped;
+    uint64_t paths_skipped;
+    uint64_t path_count;
+    uint64_t event_count;
+    uint64_t byte_count;
+    uint64_t minor_faults;
+    uint64_t major_faults;
+    int64_t memtable_time;
+    int64_t plan_time;
+    int64_t scan_time;
+    int64_t merge_time;
+    int64_t encode_time;
+} sky_query_profile;
+
+// The groups of a query result are kept sorted by key and then by subkey.
+// The subkeys are zero unless the query is subgrouped. The aggregate values
+// of group `i` start at `values[i * value_count]`. A result with an arena
+// allocates its groups from the arena instead of the heap. A result with a
+// profile adds the counters of each execution to it. The profile is not
+// owned by the result. The `distinct` flags mark the values that refer to
+// sketches and are only set if the query has distinct aggregates. A result
+// whose query was stopped is marked as timed out or cancelled.
+struct sky_query_result {
+    sky_arena *arena;
+    uint32_t value_count;
+    int64_t *keys;
+    int64_t *subkeys;
+    int64_t *values;
+    uint32_t group_count;
+    uint32_t group_capacity;
+    uint64_t event_count;
+    bool *distinct;
+    sky_hll **sketches;
+    uint32_t sketch_count;
+    uint32_t sketch_capacity;
+    sky_query_profile *profile;
+    bool timed_out;
+    bool cancelled;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_query *sky_query_create();
+
+void sky_query_free(sky_query *query);
+
+sky_query_result *sky_query_result_create(sky_query *query);
+
+sky_query_result *sky_query_result_create_with_arena(sky_query *query,
+    sky_arena *arena);
+
+void sky_query_result_free(sky_query_result *result);
+
+
+//--------------------------------------
+// Plan
+//--------------------------------------
+
+int sky_query_add_filter(sky_query *query, sky_query_field_e field,
+    sky_property_id_t property_id, int64_t min, int64_t max);
+
+int sky_query_set_sequence(sky_query *query, sky_action_id_t *action_ids,
+    uint32_t length);
+
+int sky_query_set_funnel(sky_query *query, sky_query_funnel_step *steps,
+    uint32_t length);
+
+int sky_query_set_cohort(sky_query *query, sky_action_id_t action_id,
+    sky_action_id_t return_action_id, sky_timestamp_t interval,
+    uint32_t period_count);
+
+int sky_query_set_transitions(sky_query *query, uint32_t action_count);
+
+int sky_query_set_function(sky_query *query, sky_query_function *function);
+
+int sky_query_set_group_by(sky_query *query, sky_query_field_e field,
+    sky_property_id_t property_id);
+
+int sky_query_set_group_interval(sky_query *query, int64_t interval);
+
+int sky_query_set_subgroup_by(sky_query *query, sky_query_field_e field,
+    sky_property_id_t property_id);
+
+int sky_query_add_aggregate(sky_query *query, sky_query_aggregate_e type,
+    sky_property_id_t property_id, bstring name);
+
+int sky_query_set_object_ids(sky_query *query, sky_object_id_t *object_ids,
+    uint32_t object_id_count);
+
+int sky_query_restrict_object_ids(sky_query *query,
+    sky_object_id_t *object_ids, uint32_t object_id_count);
+
+int sky_query_set_timeout(sky_query *query, int64_t timeout);
+
+int sky_query_set_cancel_flag(sky_query *query, volatile bool *cancelled);
+
+
+//--------------------------------------
+// Execution
+//--------------------------------------
+
+int sky_query_execute(sky_query *query, sky_data_file *data_file,
+    sky_query_result *result);
+
+int sky_query_execute_partition_set(sky_query *query,
+    sky_partition_set *partition_set, sky_query_result *result);
+
+
+//--------------------------------------
+// Fields
+//--------------------------------------
+
+bool sky_query_get_property(sky_property_id_t property_id, void *data_ptr,
+    uint32_t data_length, int64_t *value);
+
+
+//--------------------------------------
+// Results
+//--------------------------------------
+
+int sky_query_result_get_values(sky_query_result *result, int64_t key,
+    int64_t **values);
+
+int sky_query_result_get_subgroup_values(sky_query_result *result,
+    int64_t key, int64_t subkey, int64_t **values);
+
+int sky_query_result_merge(sky_query_result *result,
+    sky_query_result *source);
+
+void sky_query_result_remove_empty_groups(sky_query_result *result);
+
+int sky_query_result_get_sketch(sky_query_result *result, int64_t *value,
+    sky_hll **sketch);
+
+int sky_query_result_pack(sky_query_result *result, sky_query *query,
+    sky_dictionary_file *dictionary_file, sky_buffer *buffer);
+
+int sky_query_result_pack_stream(sky_query_result *result, sky_query *query,
+    sky_dictionary_file *dictionary_file, uint32_t key_count,
+    sky_buffer *buffer);
+
+int sky_query_result_pack_columns(sky_query_result *result, sky_query *query,
+    sky_dictionary_file *dictionary_file, sky_buffer *buffer);
+
+bool sky_query_result_is_stopped(sky_query_result *result);
+
+int sky_query_result_pack_stopped(sky_query_result *result,
+    sky_buffer *buffer);
+
+
+//--------------------------------------
+// Profiling
+//--------------------------------------
+
+int sky_query_profile_pack(sky_query_profile *profile, sky_buffer *buffer);
+
+#endif
@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include <dlfcn.h>
+
+#include "dbg.h"
+#include "bstring.h"
+#include "query_function.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_query_function_path_length_event(void *state,
+    sky_action_id_t action_id, sky_timestamp_t timestamp, void *data_ptr,
+    uint32_t data_length);
+
+int sky_query_function_path_length_finish(void *state,
+    sky_object_id_t object_id, sky_query_result *result);
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+struct tagbstring SKY_QUERY_FUNCTION_PATH_LENGTH_NAME = bsStatic("pathLength");
+
+sky_query_function SKY_QUERY_FUNCTION_PATH_LENGTH = {
+    &SKY_QUERY_FUNCTION_PATH_LENGTH_NAME,
+    sizeof(uint32_t),
+    sky_query_function_path_length_event,
+    sky_query_function_path_length_finish
+};
+
+sky_query_function *sky_query_functions[SKY_QUERY_FUNCTION_MAX_COUNT] = {
+    &SKY_QUERY_FUNCTION_PATH_LENGTH
+};
+
+uint32_t sky_query_function_count = 1;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Registry
+//--------------------------------------
+
+// Adds a function to the registry so that queries can select it by name.
+// The function is not copied and must outlive every query that uses it.
+//
+// function - The function to register.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_function_register(sky_query_function *function)
+{
+    int rc;
+    sky_query_function *existing = NULL;
+    check(function != NULL, "Function required");
+    check(function->name != NULL && blength(function->name) > 0, "Function name required");
+    check(function->event != NULL && function->finish != NULL, "Function callbacks required");
+    check(sky_query_function_count < SKY_QUERY_FUNCTION_MAX_COUNT, "Too many query functions");
+
+    rc = sky_query_function_find(function->name, &existing);
+    check(rc == 0, "Unable to search query functions");
+    check(existing == NULL, "Query function is already registered: %s", bdata(function->name));
+
+    sky_query_functions[sky_query_function_count++] = function;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Finds a registered function by name.
+//
+// name - The name of the function.
+// ret  - A pointer to where the function should be returned. This is NULL
+//        if no function has the name.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_function_find(bstring name, sky_query_function **ret)
+{
+    uint32_t i;
+    check(name != NULL, "Name required");
+    check(ret != NULL, "Return pointer required");
+
+    *ret = NULL;
+    for(i=0; i<sky_query_function_count; i++) {
+        if(biseq(sky_query_functions[i]->name, name) == 1) {
+            *ret = sky_query_functions[i];
+            break;
+        }
+    }
+    return 0;
+
+error:
+    return -1;
+}
+
+// Loads a shared object and registers the functions that it defines by
+// calling its init function. If the init function fails then the functions
+// it registered are removed again and the object is unloaded.
+//
+// path - The path of the shared object.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_function_load(bstring path)
+{
+    int rc;
+    void *handle = NULL;
+    uint32_t count = sky_query_function_count;
+    check(path != NULL, "Path required");
+
+    handle = dlopen(bdata(path), RTLD_NOW | RTLD_LOCAL);
+    check(handle != NULL, "Unable to load query functions: %s", dlerror());
+
+    sky_query_function_init_fn init = (sky_query_function_init_fn)dlsym(handle, SKY_QUERY_FUNCTION_INIT_SYMBOL);
+    check(init != NULL, "Query function init not found: %s", bdata(path));
+    rc = init();
+    check(rc == 0, "Unable to register query functions: %s", bdata(path));
+
+    return 0;
+
+error:
+    sky_query_function_count = count;
+    if(handle) dlclose(handle);
+    return -1;
+}
+
+
+//--------------------------------------
+// Path Length
+//--------------------------------------
+
+// Counts an event of the current object.
+//
+// state       - The event count of the object.
+// action_id   - The action id of the event.
+// timestamp   - The timestamp of the event.
+// data_ptr    - A pointer to the data section of the event or NULL.
+// data_length - The length of the data section.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_function_path_length_event(void *state,
+                                         sky_action_id_t action_id,
+                                         sky_timestamp_t timestamp,
+                                         void *data_ptr, uint32_t data_length)
+{
+    (void)action_id;
+    (void)timestamp;
+    (void)data_ptr;
+    (void)data_length;
+    (*((uint32_t*)state))++;
+    return 0;
+}
+
+// Counts the object in the group keyed by its number of events.
+//
+// state     - The event count of the object.
+// object_id - The object id.
+// result    - The result to add the object to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_function_path_length_finish(void *state,
+                                          sky_object_id_t object_id,
+                                          sky_query_result *result)
+{
+    int rc;
+    (void)object_id;
+    int64_t *values = NULL;
+    rc = sky_query_result_get_values(result, *((uint32_t*)state), &values);
+    check(rc == 0, "Unable to retrieve group values");
+    values[0]++;
+    return 0;
+
+error:
+    return -1;
+}
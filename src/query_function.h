@@ -0,0 +1,120 @@
+#ifndef _query_function_h
+#define _query_function_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct sky_query_function sky_query_function;
+
+#include "bstring.h"
+#include "types.h"
+#include "query.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A query function is a user defined aggregation that is compiled into the
+// server and called on every path that a query scans. It is registered
+// under a name and a query selects it by that name in place of the
+// sequence, group by and aggregate operators.
+//
+// The scan keeps a block of state of the function's state size for the
+// current object. The state is zeroed when the scan moves to a new object.
+// Each event of the object that passes the filters of the query is passed
+// to the function's event callback along with the raw data section of the
+// event, whose property values can be read with sky_query_get_property().
+// Once the scan moves past the object the finish callback adds the object
+// to groups of the result with sky_query_result_get_values().
+//
+// Each scan thread keeps its own state and result, and the results of the
+// threads are merged by adding up the values of each group. Functions
+// should only emit values that are meaningful when summed, such as counts
+// and totals. The values of a group are laid out by the aggregates of the
+// query, which name them in the packed result. Distinct aggregates cannot
+// be used with a function.
+//
+// Functions are registered before the server starts its workers. The
+// registry is not locked and lookups are only safe once registration has
+// finished. A 'pathLength' function is built in. It counts the objects by
+// the number of events in their path.
+//
+// Functions can also be loaded from a shared object without recompiling
+// the server. The object exports a 'sky_query_function_init' function that
+// registers each of its functions with sky_query_function_register(). The
+// object stays loaded for the life of the process. It is linked against the
+// server's own symbols, so it must be built against the same headers.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The largest number of functions that can be registered.
+#define SKY_QUERY_FUNCTION_MAX_COUNT 64
+
+// The name of the function that registers the functions of a shared object.
+#define SKY_QUERY_FUNCTION_INIT_SYMBOL "sky_query_function_init"
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// Called for each event of the current object that passes the filters.
+typedef int (*sky_query_function_event_fn)(void *state,
+    sky_action_id_t action_id, sky_timestamp_t timestamp, void *data_ptr,
+    uint32_t data_length);
+
+// Called once the scan moves past an object that had at least one event
+// pass the filters.
+typedef int (*sky_query_function_finish_fn)(void *state,
+    sky_object_id_t object_id, sky_query_result *result);
+
+// Registers the functions of a shared object.
+typedef int (*sky_query_function_init_fn)();
+
+struct sky_query_function {
+    bstring name;
+    size_t state_size;
+    sky_query_function_event_fn event;
+    sky_query_function_finish_fn finish;
+};
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+extern sky_query_function *sky_query_functions[SKY_QUERY_FUNCTION_MAX_COUNT];
+
+extern uint32_t sky_query_function_count;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Registry
+//--------------------------------------
+
+int sky_query_function_register(sky_query_function *function);
+
+int sky_query_function_find(bstring name, sky_query_function **ret);
+
+int sky_query_function_load(bstring path);
+
+#endif
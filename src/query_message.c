@@ -0,0 +1,1004 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+#include "query_message.h"
+#include "minipack.h"
+#include "stats.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+struct tagbstring SKY_QUERY_KEY_FILTERS = bsStatic("filters");
+
+struct tagbstring SKY_QUERY_KEY_SEQUENCE = bsStatic("sequence");
+
+struct tagbstring SKY_QUERY_KEY_GROUP_BY = bsStatic("groupBy");
+
+struct tagbstring SKY_QUERY_KEY_AGGREGATES = bsStatic("aggregates");
+
+struct tagbstring SKY_QUERY_KEY_PROFILE = bsStatic("profile");
+
+struct tagbstring SKY_QUERY_KEY_STREAM = bsStatic("stream");
+
+struct tagbstring SKY_QUERY_KEY_QUERY_ID = bsStatic("queryId");
+
+struct tagbstring SKY_QUERY_KEY_TIMEOUT = bsStatic("timeout");
+
+struct tagbstring SKY_QUERY_KEY_FIELD = bsStatic("field");
+
+struct tagbstring SKY_QUERY_KEY_PROPERTY_ID = bsStatic("propertyId");
+
+struct tagbstring SKY_QUERY_KEY_MIN = bsStatic("min");
+
+struct tagbstring SKY_QUERY_KEY_MAX = bsStatic("max");
+
+struct tagbstring SKY_QUERY_KEY_VALUE = bsStatic("value");
+
+struct tagbstring SKY_QUERY_KEY_TYPE = bsStatic("type");
+
+struct tagbstring SKY_QUERY_KEY_NAME = bsStatic("name");
+
+struct tagbstring SKY_QUERY_KEY_INTERVAL = bsStatic("interval");
+
+struct tagbstring SKY_QUERY_KEY_COHORT = bsStatic("cohort");
+
+struct tagbstring SKY_QUERY_KEY_FUNCTION = bsStatic("function");
+
+struct tagbstring SKY_QUERY_KEY_ACTION_ID = bsStatic("actionId");
+
+struct tagbstring SKY_QUERY_KEY_RETURN_ACTION_ID = bsStatic("returnActionId");
+
+struct tagbstring SKY_QUERY_KEY_PERIODS = bsStatic("periods");
+
+struct tagbstring SKY_QUERY_FIELD_ACTION_STR = bsStatic("action");
+
+struct tagbstring SKY_QUERY_FIELD_TIMESTAMP_STR = bsStatic("timestamp");
+
+struct tagbstring SKY_QUERY_FIELD_PROPERTY_STR = bsStatic("property");
+
+struct tagbstring SKY_QUERY_AGGREGATE_COUNT_STR = bsStatic("count");
+
+struct tagbstring SKY_QUERY_AGGREGATE_SUM_STR = bsStatic("sum");
+
+struct tagbstring SKY_QUERY_AGGREGATE_DISTINCT_STR = bsStatic("distinct");
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_query_message_unpack_filters(sky_query_message *message, FILE *file);
+
+int sky_query_message_unpack_sequence(sky_query_message *message, FILE *file);
+
+int sky_query_message_unpack_group_by(sky_query_message *message, FILE *file);
+
+int sky_query_message_unpack_aggregates(sky_query_message *message, FILE *file);
+
+int sky_query_message_unpack_cohort(sky_query_message *message, FILE *file);
+
+int sky_query_message_unpack_function(sky_query_message *message, FILE *file);
+
+int sky_query_message_unpack_field(FILE *file, sky_query_field_e *field);
+
+int sky_query_message_pack_field(FILE *file, sky_query_field_e field);
+
+int sky_query_message_resolve_string_filters(sky_query_message *message,
+    sky_table *table);
+
+int sky_query_message_restrict_objects(sky_query_message *message,
+    sky_table *table);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a query message object with an empty query.
+//
+// Returns a new message.
+sky_query_message *sky_query_message_create()
+{
+    sky_query_message *message = NULL;
+    message = calloc(1, sizeof(sky_query_message)); check_mem(message);
+    message->query = sky_query_create(); check_mem(message->query);
+    message->frame_key_count = SKY_QUERY_MESSAGE_DEFAULT_FRAME_KEY_COUNT;
+    return message;
+
+error:
+    sky_query_message_free(message);
+    return NULL;
+}
+
+// Frees a query message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_query_message_free(sky_query_message *message)
+{
+    if(message) {
+        uint32_t i;
+        for(i=0; i<message->string_filter_count; i++) {
+            bdestroy(message->string_filters[i].value);
+        }
+        free(message->string_filters);
+        message->string_filters = NULL;
+        sky_query_free(message->query);
+        message->query = NULL;
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Filters
+//--------------------------------------
+
+// Adds a filter that matches events where a property has a given string
+// value.
+//
+// message     - The message.
+// property_id - The property to test.
+// value       - The value to match. This is copied.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_add_string_filter(sky_query_message *message,
+                                        sky_property_id_t property_id,
+                                        bstring value)
+{
+    check(message != NULL, "Message required");
+    check(value != NULL, "Value required");
+
+    message->string_filters = realloc(message->string_filters, sizeof(*message->string_filters) * (message->string_filter_count+1));
+    check_mem(message->string_filters);
+
+    sky_query_message_string_filter *filter = &message->string_filters[message->string_filter_count];
+    filter->property_id = property_id;
+    filter->value = bstrcpy(value); check_mem(filter->value);
+    message->string_filter_count++;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Adds the string filters of a message to its query as ranges over the
+// dictionary codes of their values. A value that is not in the dictionary
+// cannot match any event so its filter is added as an empty range.
+//
+// message - The message.
+// table   - The table that the query is executed against.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_resolve_string_filters(sky_query_message *message,
+                                             sky_table *table)
+{
+    int rc;
+    uint32_t i;
+    int64_t code;
+
+    for(i=0; i<message->string_filter_count; i++) {
+        sky_query_message_string_filter *filter = &message->string_filters[i];
+        rc = sky_dictionary_file_find_code(table->dictionary_file, filter->property_id, filter->value, &code);
+        check(rc == 0, "Unable to find dictionary code");
+
+        int64_t min = (code != -1 ? code : 1);
+        int64_t max = (code != -1 ? code : 0);
+        rc = sky_query_add_filter(message->query, SKY_QUERY_FIELD_PROPERTY, filter->property_id, min, max);
+        check(rc == 0, "Unable to add string filter");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+// Restricts the query of a message to the objects that can pass its
+// property filters. Filters that match a single value are looked up in the
+// property index of the table. An empty filter leaves no objects. Other
+// filters are only applied during the scan. A cohort query is also limited
+// to the objects that performed its cohort action.
+//
+// message - The message.
+// table   - The table that the query is executed against.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_restrict_objects(sky_query_message *message,
+                                       sky_table *table)
+{
+    int rc;
+    uint32_t i;
+    sky_object_id_t *object_ids = NULL;
+    uint32_t object_id_count = 0;
+    sky_query *query = message->query;
+
+    for(i=0; i<query->filter_count; i++) {
+        sky_query_filter *filter = &query->filters[i];
+        if(filter->field != SKY_QUERY_FIELD_PROPERTY || filter->min < filter->max) {
+            continue;
+        }
+
+        if(filter->min == filter->max) {
+            sky_property_index *index = NULL;
+            rc = sky_table_get_property_index(table, filter->property_id, &index);
+            check(rc == 0, "Unable to retrieve property index");
+            rc = sky_property_index_get_object_ids(index, filter->min, filter->max, &object_ids, &object_id_count);
+            check(rc == 0, "Unable to find objects for property value");
+        }
+
+        rc = sky_query_restrict_object_ids(query, object_ids, object_id_count);
+        check(rc == 0, "Unable to restrict query objects");
+        free(object_ids);
+        object_ids = NULL;
+        object_id_count = 0;
+    }
+
+    // Only objects that performed the cohort action can join a cohort.
+    if(query->cohorted) {
+        sky_action_index *action_index = NULL;
+        rc = sky_table_get_action_index(table, &action_index);
+        check(rc == 0, "Unable to retrieve action index");
+        rc = sky_action_index_get_object_ids(action_index, &query->cohort.action_id, 1, &object_ids, &object_id_count);
+        check(rc == 0, "Unable to find cohort objects");
+        rc = sky_query_restrict_object_ids(query, object_ids, object_id_count);
+        check(rc == 0, "Unable to restrict query objects");
+        free(object_ids);
+    }
+
+    return 0;
+
+error:
+    free(object_ids);
+    return -1;
+}
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Serializes a query message to a file stream. Empty parts of the plan are
+// left out.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_pack(sky_query_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    sky_query *query = message->query;
+    uint32_t filter_count = query->filter_count + message->string_filter_count;
+    uint32_t key_count = (filter_count > 0) + (query->sequence_length > 0) + (query->grouped ? 1 : 0) + (query->aggregate_count > 0) + (query->cohorted ? 1 : 0) + (query->function != NULL ? 1 : 0) + (message->profile ? 1 : 0) + (message->stream ? 1 : 0) + (message->query_id > 0 ? 1 : 0) + (message->timeout > 0 ? 1 : 0);
+    check(minipack_fwrite_map(file, key_count, &sz) == 0, "Unable to pack query map");
+
+    // Filters
+    if(filter_count > 0) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_FILTERS) == 0, "Unable to pack filters key");
+        check(minipack_fwrite_array(file, filter_count, &sz) == 0, "Unable to pack filters array");
+        for(i=0; i<query->filter_count; i++) {
+            sky_query_filter *filter = &query->filters[i];
+            check(minipack_fwrite_map(file, 4, &sz) == 0, "Unable to pack filter map");
+            check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_FIELD) == 0, "Unable to pack field key");
+            rc = sky_query_message_pack_field(file, filter->field);
+            check(rc == 0, "Unable to pack filter field");
+            check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_PROPERTY_ID) == 0, "Unable to pack property id key");
+            check(minipack_fwrite_int(file, filter->property_id, &sz) == 0, "Unable to pack filter property id");
+            check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_MIN) == 0, "Unable to pack min key");
+            check(minipack_fwrite_int(file, filter->min, &sz) == 0, "Unable to pack filter min");
+            check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_MAX) == 0, "Unable to pack max key");
+            check(minipack_fwrite_int(file, filter->max, &sz) == 0, "Unable to pack filter max");
+        }
+        for(i=0; i<message->string_filter_count; i++) {
+            sky_query_message_string_filter *filter = &message->string_filters[i];
+            check(minipack_fwrite_map(file, 3, &sz) == 0, "Unable to pack filter map");
+            check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_FIELD) == 0, "Unable to pack field key");
+            rc = sky_query_message_pack_field(file, SKY_QUERY_FIELD_PROPERTY);
+            check(rc == 0, "Unable to pack filter field");
+            check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_PROPERTY_ID) == 0, "Unable to pack property id key");
+            check(minipack_fwrite_int(file, filter->property_id, &sz) == 0, "Unable to pack filter property id");
+            check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_VALUE) == 0, "Unable to pack value key");
+            check(sky_minipack_fwrite_bstring(file, filter->value) == 0, "Unable to pack filter value");
+        }
+    }
+
+    // Sequence
+    if(query->sequence_length > 0) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_SEQUENCE) == 0, "Unable to pack sequence key");
+        check(minipack_fwrite_array(file, query->sequence_length, &sz) == 0, "Unable to pack sequence array");
+        for(i=0; i<query->sequence_length; i++) {
+            check(minipack_fwrite_uint(file, query->sequence[i], &sz) == 0, "Unable to pack sequence action id");
+        }
+    }
+
+    // Group By
+    if(query->grouped) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_GROUP_BY) == 0, "Unable to pack group by key");
+        check(minipack_fwrite_map(file, (query->group_interval > 0 ? 3 : 2), &sz) == 0, "Unable to pack group by map");
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_FIELD) == 0, "Unable to pack field key");
+        rc = sky_query_message_pack_field(file, query->group_field);
+        check(rc == 0, "Unable to pack group by field");
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_PROPERTY_ID) == 0, "Unable to pack property id key");
+        check(minipack_fwrite_int(file, query->group_property_id, &sz) == 0, "Unable to pack group by property id");
+        if(query->group_interval > 0) {
+            check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_INTERVAL) == 0, "Unable to pack interval key");
+            check(minipack_fwrite_int(file, query->group_interval, &sz) == 0, "Unable to pack group by interval");
+        }
+    }
+
+    // Aggregates
+    if(query->aggregate_count > 0) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_AGGREGATES) == 0, "Unable to pack aggregates key");
+        check(minipack_fwrite_array(file, query->aggregate_count, &sz) == 0, "Unable to pack aggregates array");
+        for(i=0; i<query->aggregate_count; i++) {
+            sky_query_aggregate *aggregate = &query->aggregates[i];
+            bstring type = &SKY_QUERY_AGGREGATE_COUNT_STR;
+            if(aggregate->type == SKY_QUERY_AGGREGATE_SUM) {
+                type = &SKY_QUERY_AGGREGATE_SUM_STR;
+            }
+            else if(aggregate->type == SKY_QUERY_AGGREGATE_DISTINCT) {
+                type = &SKY_QUERY_AGGREGATE_DISTINCT_STR;
+            }
+            check(minipack_fwrite_map(file, 3, &sz) == 0, "Unable to pack aggregate map");
+            check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_TYPE) == 0, "Unable to pack type key");
+            check(sky_minipack_fwrite_bstring(file, type) == 0, "Unable to pack aggregate type");
+            check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_PROPERTY_ID) == 0, "Unable to pack property id key");
+            check(minipack_fwrite_int(file, aggregate->property_id, &sz) == 0, "Unable to pack aggregate property id");
+            check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_NAME) == 0, "Unable to pack name key");
+            check(sky_minipack_fwrite_bstring(file, aggregate->name) == 0, "Unable to pack aggregate name");
+        }
+    }
+
+    // Cohort
+    if(query->cohorted) {
+        sky_query_cohort *cohort = &query->cohort;
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_COHORT) == 0, "Unable to pack cohort key");
+        check(minipack_fwrite_map(file, 4, &sz) == 0, "Unable to pack cohort map");
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_ACTION_ID) == 0, "Unable to pack action id key");
+        check(minipack_fwrite_uint(file, cohort->action_id, &sz) == 0, "Unable to pack cohort action id");
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_RETURN_ACTION_ID) == 0, "Unable to pack return action id key");
+        check(minipack_fwrite_uint(file, cohort->return_action_id, &sz) == 0, "Unable to pack cohort return action id");
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_INTERVAL) == 0, "Unable to pack interval key");
+        check(minipack_fwrite_int(file, cohort->interval, &sz) == 0, "Unable to pack cohort interval");
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_PERIODS) == 0, "Unable to pack periods key");
+        check(minipack_fwrite_uint(file, cohort->period_count, &sz) == 0, "Unable to pack cohort periods");
+    }
+
+    // Function
+    if(query->function != NULL) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_FUNCTION) == 0, "Unable to pack function key");
+        check(sky_minipack_fwrite_bstring(file, query->function->name) == 0, "Unable to pack function name");
+    }
+
+    // Profile
+    if(message->profile) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_PROFILE) == 0, "Unable to pack profile key");
+        check(minipack_fwrite_bool(file, true, &sz) == 0, "Unable to pack profile flag");
+    }
+
+    // Stream
+    if(message->stream) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_STREAM) == 0, "Unable to pack stream key");
+        check(minipack_fwrite_bool(file, true, &sz) == 0, "Unable to pack stream flag");
+    }
+
+    // Cancellation
+    if(message->query_id > 0) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_QUERY_ID) == 0, "Unable to pack query id key");
+        check(minipack_fwrite_uint(file, message->query_id, &sz) == 0, "Unable to pack query id");
+    }
+    if(message->timeout > 0) {
+        check(sky_minipack_fwrite_bstring(file, &SKY_QUERY_KEY_TIMEOUT) == 0, "Unable to pack timeout key");
+        check(minipack_fwrite_int(file, message->timeout, &sz) == 0, "Unable to pack timeout");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes a query message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_unpack(sky_query_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    bstring key = NULL;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    // Map
+    uint32_t map_length = minipack_fread_map(file, &sz);
+    check(sz > 0, "Unable to read map");
+
+    // Map items
+    uint32_t i;
+    for(i=0; i<map_length; i++) {
+        rc = sky_minipack_fread_bstring(file, &key);
+        check(rc == 0, "Unable to read map key");
+
+        if(biseq(key, &SKY_QUERY_KEY_FILTERS) == 1) {
+            rc = sky_query_message_unpack_filters(message, file);
+            check(rc == 0, "Unable to unpack filters");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_SEQUENCE) == 1) {
+            rc = sky_query_message_unpack_sequence(message, file);
+            check(rc == 0, "Unable to unpack sequence");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_GROUP_BY) == 1) {
+            rc = sky_query_message_unpack_group_by(message, file);
+            check(rc == 0, "Unable to unpack group by");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_AGGREGATES) == 1) {
+            rc = sky_query_message_unpack_aggregates(message, file);
+            check(rc == 0, "Unable to unpack aggregates");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_COHORT) == 1) {
+            rc = sky_query_message_unpack_cohort(message, file);
+            check(rc == 0, "Unable to unpack cohort");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_FUNCTION) == 1) {
+            rc = sky_query_message_unpack_function(message, file);
+            check(rc == 0, "Unable to unpack function");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_PROFILE) == 1) {
+            message->profile = minipack_fread_bool(file, &sz);
+            check(sz > 0, "Unable to unpack profile flag");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_STREAM) == 1) {
+            message->stream = minipack_fread_bool(file, &sz);
+            check(sz > 0, "Unable to unpack stream flag");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_QUERY_ID) == 1) {
+            message->query_id = minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack query id");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_TIMEOUT) == 1) {
+            message->timeout = minipack_fread_int(file, &sz);
+            check(sz > 0, "Unable to unpack timeout");
+            check(message->timeout >= 0, "Invalid timeout: %lld", (long long)message->timeout);
+        }
+        else {
+            sentinel("Invalid query key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+// Deserializes the filters of a query.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_unpack_filters(sky_query_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i, j;
+    bstring key = NULL;
+    bstring value = NULL;
+
+    uint32_t filter_count = minipack_fread_array(file, &sz);
+    check(sz > 0, "Unable to read filters array");
+
+    for(i=0; i<filter_count; i++) {
+        sky_query_field_e field = SKY_QUERY_FIELD_ACTION;
+        sky_property_id_t property_id = 0;
+        int64_t min = INT64_MIN, max = INT64_MAX;
+
+        uint32_t map_length = minipack_fread_map(file, &sz);
+        check(sz > 0, "Unable to read filter map");
+        for(j=0; j<map_length; j++) {
+            rc = sky_minipack_fread_bstring(file, &key);
+            check(rc == 0, "Unable to read filter key");
+
+            if(biseq(key, &SKY_QUERY_KEY_FIELD) == 1) {
+                rc = sky_query_message_unpack_field(file, &field);
+                check(rc == 0, "Unable to unpack filter field");
+            }
+            else if(biseq(key, &SKY_QUERY_KEY_PROPERTY_ID) == 1) {
+                property_id = (sky_property_id_t)minipack_fread_int(file, &sz);
+                check(sz > 0, "Unable to unpack filter property id");
+            }
+            else if(biseq(key, &SKY_QUERY_KEY_MIN) == 1) {
+                min = minipack_fread_int(file, &sz);
+                check(sz > 0, "Unable to unpack filter min");
+            }
+            else if(biseq(key, &SKY_QUERY_KEY_MAX) == 1) {
+                max = minipack_fread_int(file, &sz);
+                check(sz > 0, "Unable to unpack filter max");
+            }
+            else if(biseq(key, &SKY_QUERY_KEY_VALUE) == 1) {
+                bdestroy(value);
+                rc = sky_minipack_fread_bstring(file, &value);
+                check(rc == 0, "Unable to unpack filter value");
+            }
+            else {
+                sentinel("Invalid filter key: %s", bdata(key));
+            }
+
+            bdestroy(key);
+            key = NULL;
+        }
+
+        if(value != NULL) {
+            check(field == SKY_QUERY_FIELD_PROPERTY, "String filters are only supported on properties");
+            rc = sky_query_message_add_string_filter(message, property_id, value);
+            check(rc == 0, "Unable to add string filter");
+            bdestroy(value);
+            value = NULL;
+        }
+        else {
+            rc = sky_query_add_filter(message->query, field, property_id, min, max);
+            check(rc == 0, "Unable to add filter");
+        }
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    bdestroy(value);
+    return -1;
+}
+
+// Deserializes the action sequence of a query.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_unpack_sequence(sky_query_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    sky_action_id_t *action_ids = NULL;
+
+    uint32_t length = minipack_fread_array(file, &sz);
+    check(sz > 0, "Unable to read sequence array");
+
+    if(length > 0) {
+        action_ids = calloc(length, sizeof(*action_ids)); check_mem(action_ids);
+        for(i=0; i<length; i++) {
+            action_ids[i] = (sky_action_id_t)minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack sequence action id");
+        }
+    }
+
+    rc = sky_query_set_sequence(message->query, action_ids, length);
+    check(rc == 0, "Unable to set sequence");
+
+    free(action_ids);
+    return 0;
+
+error:
+    free(action_ids);
+    return -1;
+}
+
+// Deserializes the group by of a query.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_unpack_group_by(sky_query_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    bstring key = NULL;
+    sky_query_field_e field = SKY_QUERY_FIELD_ACTION;
+    sky_property_id_t property_id = 0;
+    int64_t interval = 0;
+
+    uint32_t map_length = minipack_fread_map(file, &sz);
+    check(sz > 0, "Unable to read group by map");
+    for(i=0; i<map_length; i++) {
+        rc = sky_minipack_fread_bstring(file, &key);
+        check(rc == 0, "Unable to read group by key");
+
+        if(biseq(key, &SKY_QUERY_KEY_FIELD) == 1) {
+            rc = sky_query_message_unpack_field(file, &field);
+            check(rc == 0, "Unable to unpack group by field");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_PROPERTY_ID) == 1) {
+            property_id = (sky_property_id_t)minipack_fread_int(file, &sz);
+            check(sz > 0, "Unable to unpack group by property id");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_INTERVAL) == 1) {
+            interval = minipack_fread_int(file, &sz);
+            check(sz > 0, "Unable to unpack group by interval");
+        }
+        else {
+            sentinel("Invalid group by key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    rc = sky_query_set_group_by(message->query, field, property_id);
+    check(rc == 0, "Unable to set group by");
+    if(interval != 0) {
+        rc = sky_query_set_group_interval(message->query, interval);
+        check(rc == 0, "Unable to set group by interval");
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+// Deserializes the aggregates of a query.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_unpack_aggregates(sky_query_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i, j;
+    bstring key = NULL;
+    bstring type = NULL;
+    bstring name = NULL;
+
+    uint32_t aggregate_count = minipack_fread_array(file, &sz);
+    check(sz > 0, "Unable to read aggregates array");
+
+    for(i=0; i<aggregate_count; i++) {
+        sky_property_id_t property_id = 0;
+
+        uint32_t map_length = minipack_fread_map(file, &sz);
+        check(sz > 0, "Unable to read aggregate map");
+        for(j=0; j<map_length; j++) {
+            rc = sky_minipack_fread_bstring(file, &key);
+            check(rc == 0, "Unable to read aggregate key");
+
+            if(biseq(key, &SKY_QUERY_KEY_TYPE) == 1) {
+                bdestroy(type);
+                rc = sky_minipack_fread_bstring(file, &type);
+                check(rc == 0, "Unable to unpack aggregate type");
+            }
+            else if(biseq(key, &SKY_QUERY_KEY_PROPERTY_ID) == 1) {
+                property_id = (sky_property_id_t)minipack_fread_int(file, &sz);
+                check(sz > 0, "Unable to unpack aggregate property id");
+            }
+            else if(biseq(key, &SKY_QUERY_KEY_NAME) == 1) {
+                bdestroy(name);
+                rc = sky_minipack_fread_bstring(file, &name);
+                check(rc == 0, "Unable to unpack aggregate name");
+            }
+            else {
+                sentinel("Invalid aggregate key: %s", bdata(key));
+            }
+
+            bdestroy(key);
+            key = NULL;
+        }
+
+        // Determine the aggregate type. Aggregates are named after their type
+        // if no name is given.
+        sky_query_aggregate_e aggregate_type;
+        if(type == NULL || biseq(type, &SKY_QUERY_AGGREGATE_COUNT_STR) == 1) {
+            aggregate_type = SKY_QUERY_AGGREGATE_COUNT;
+        }
+        else if(biseq(type, &SKY_QUERY_AGGREGATE_SUM_STR) == 1) {
+            aggregate_type = SKY_QUERY_AGGREGATE_SUM;
+        }
+        else if(biseq(type, &SKY_QUERY_AGGREGATE_DISTINCT_STR) == 1) {
+            aggregate_type = SKY_QUERY_AGGREGATE_DISTINCT;
+        }
+        else {
+            sentinel("Invalid aggregate type: %s", bdata(type));
+        }
+
+        bstring aggregate_name = (name != NULL ? name : (type != NULL ? type : &SKY_QUERY_AGGREGATE_COUNT_STR));
+        rc = sky_query_add_aggregate(message->query, aggregate_type, property_id, aggregate_name);
+        check(rc == 0, "Unable to add aggregate");
+
+        bdestroy(type);
+        type = NULL;
+        bdestroy(name);
+        name = NULL;
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    bdestroy(type);
+    bdestroy(name);
+    return -1;
+}
+
+// Deserializes the cohort of a query.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_unpack_cohort(sky_query_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    bstring key = NULL;
+    sky_query_cohort cohort;
+    memset(&cohort, 0, sizeof(cohort));
+
+    uint32_t map_length = minipack_fread_map(file, &sz);
+    check(sz > 0, "Unable to read cohort map");
+    for(i=0; i<map_length; i++) {
+        rc = sky_minipack_fread_bstring(file, &key);
+        check(rc == 0, "Unable to read cohort key");
+
+        if(biseq(key, &SKY_QUERY_KEY_ACTION_ID) == 1) {
+            cohort.action_id = (sky_action_id_t)minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack cohort action id");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_RETURN_ACTION_ID) == 1) {
+            cohort.return_action_id = (sky_action_id_t)minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack cohort return action id");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_INTERVAL) == 1) {
+            cohort.interval = minipack_fread_int(file, &sz);
+            check(sz > 0, "Unable to unpack cohort interval");
+        }
+        else if(biseq(key, &SKY_QUERY_KEY_PERIODS) == 1) {
+            cohort.period_count = (uint32_t)minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack cohort periods");
+        }
+        else {
+            sentinel("Invalid cohort key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    rc = sky_query_set_cohort(message->query, cohort.action_id, cohort.return_action_id, cohort.interval, cohort.period_count);
+    check(rc == 0, "Unable to set cohort");
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+// Deserializes the name of a query function and looks up the function in
+// the registry.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_unpack_function(sky_query_message *message, FILE *file)
+{
+    int rc;
+    bstring name = NULL;
+    sky_query_function *function = NULL;
+
+    rc = sky_minipack_fread_bstring(file, &name);
+    check(rc == 0, "Unable to read function name");
+    rc = sky_query_function_find(name, &function);
+    check(rc == 0, "Unable to find function");
+    check(function != NULL, "Unknown query function: %s", bdata(name));
+
+    rc = sky_query_set_function(message->query, function);
+    check(rc == 0, "Unable to set function");
+
+    bdestroy(name);
+    return 0;
+
+error:
+    bdestroy(name);
+    return -1;
+}
+
+// Deserializes the name of an event field.
+//
+// file  - The file stream to read from.
+// field - A pointer to where the field should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_unpack_field(FILE *file, sky_query_field_e *field)
+{
+    int rc;
+    bstring name = NULL;
+
+    rc = sky_minipack_fread_bstring(file, &name);
+    check(rc == 0, "Unable to read field name");
+
+    if(biseq(name, &SKY_QUERY_FIELD_ACTION_STR) == 1) {
+        *field = SKY_QUERY_FIELD_ACTION;
+    }
+    else if(biseq(name, &SKY_QUERY_FIELD_TIMESTAMP_STR) == 1) {
+        *field = SKY_QUERY_FIELD_TIMESTAMP;
+    }
+    else if(biseq(name, &SKY_QUERY_FIELD_PROPERTY_STR) == 1) {
+        *field = SKY_QUERY_FIELD_PROPERTY;
+    }
+    else {
+        sentinel("Invalid field: %s", bdata(name));
+    }
+
+    bdestroy(name);
+    return 0;
+
+error:
+    bdestroy(name);
+    return -1;
+}
+
+// Serializes the name of an event field.
+//
+// file  - The file stream to write to.
+// field - The field.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_pack_field(FILE *file, sky_query_field_e field)
+{
+    bstring name = &SKY_QUERY_FIELD_ACTION_STR;
+    if(field == SKY_QUERY_FIELD_TIMESTAMP) {
+        name = &SKY_QUERY_FIELD_TIMESTAMP_STR;
+    }
+    else if(field == SKY_QUERY_FIELD_PROPERTY) {
+        name = &SKY_QUERY_FIELD_PROPERTY_STR;
+    }
+    return sky_minipack_fwrite_bstring(file, name);
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Executes the query of the message against a table and writes the results.
+// A profiled query also times the memtable merge and the encoding of the
+// results and writes its profile after the results. A streamed query writes
+// its results in frames and flushes the output after each one. A query that
+// runs out of time or is cancelled writes why it stopped instead.
+//
+// message - The message.
+// table   - The table to apply the message to.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_message_process(sky_query_message *message, sky_table *table,
+                              sky_buffer *output)
+{
+    int rc;
+    sky_query_result *result = NULL;
+    sky_query_profile profile;
+    check(message != NULL, "Message required");
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring data_str = bsStatic("data");
+
+    // Start the clock on the timeout.
+    rc = sky_query_set_timeout(message->query, message->timeout * 1000);
+    check(rc == 0, "Unable to set query timeout");
+    rc = sky_query_set_cancel_flag(message->query, message->cancelled);
+    check(rc == 0, "Unable to set query cancel flag");
+
+    // Merge buffered events so the query sees them.
+    memset(&profile, 0, sizeof(profile));
+    int64_t t0 = sky_stats_now();
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge table memtable");
+    profile.memtable_time = sky_stats_now() - t0;
+
+    // Look up the codes of string filter values.
+    rc = sky_query_message_resolve_string_filters(message, table);
+    check(rc == 0, "Unable to resolve string filters");
+
+    // Only scan the objects that can pass the filters on single values.
+    rc = sky_query_message_restrict_objects(message, table);
+    check(rc == 0, "Unable to restrict query objects");
+
+    // Execute the query.
+    result = sky_query_result_create_with_arena(message->query, message->arena); check_mem(result);
+    result->profile = (message->profile ? &profile : NULL);
+    rc = sky_table_execute_query(table, message->query, result);
+    if(rc != 0 && sky_query_result_is_stopped(result)) {
+        message->stopped = true;
+        rc = sky_query_result_pack_stopped(result, output);
+        check(rc == 0, "Unable to write stopped query");
+        sky_query_result_free(result);
+        return 0;
+    }
+    check(rc == 0, "Unable to execute query");
+
+    // Stream.
+    //   {data:<part>} ... {status:"ok", profile:<profile>}
+    if(message->stream) {
+        t0 = sky_stats_now();
+        rc = sky_query_result_pack_stream(result, message->query, table->dictionary_file, message->frame_key_count, output);
+        check(rc == 0, "Unable to stream query result");
+        profile.encode_time = sky_stats_now() - t0;
+
+        check(sky_buffer_pack_map(output, (message->profile ? 2 : 1)) == 0, "Unable to write final frame map");
+        check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+        check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+        if(message->profile) {
+            check(sky_buffer_pack_bstring(output, &SKY_QUERY_KEY_PROFILE) == 0, "Unable to write profile key");
+            rc = sky_query_profile_pack(&profile, output);
+            check(rc == 0, "Unable to write query profile");
+        }
+
+        sky_query_result_free(result);
+        return 0;
+    }
+
+    // Return.
+    //   {status:"ok", data:<results>, profile:<profile>}
+    check(sky_buffer_pack_map(output, (message->profile ? 3 : 2)) == 0, "Unable to write root map");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    check(sky_buffer_pack_bstring(output, &data_str) == 0, "Unable to write data key");
+    t0 = sky_stats_now();
+    rc = sky_query_result_pack(result, message->query, table->dictionary_file, output);
+    check(rc == 0, "Unable to write query result");
+    profile.encode_time = sky_stats_now() - t0;
+
+    if(message->profile) {
+        check(sky_buffer_pack_bstring(output, &SKY_QUERY_KEY_PROFILE) == 0, "Unable to write profile key");
+        rc = sky_query_profile_pack(&profile, output);
+        check(rc == 0, "Unable to write query profile");
+    }
+
+    sky_query_result_free(result);
+    return 0;
+
+error:
+    sky_query_result_free(result);
+    return -1;
+}
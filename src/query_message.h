@@ -0,0 +1,160 @@
+#ifndef _sky_query_message_h
+#define _sky_query_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+#include "query.h"
+#include "arena.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The query message executes an arbitrary query plan against a table. The
+// plan is sent as a map with the following optional keys:
+//
+//   filters    - [{field:"action"|"timestamp"|"property", propertyId:<id>,
+//                  min:<int>, max:<int>, value:<string>}, ...]
+//   sequence   - [<action_id>, ...]
+//   groupBy    - {field:"action"|"timestamp"|"property", propertyId:<id>,
+//                  interval:<int>}
+//   aggregates - [{type:"count"|"sum"|"distinct", propertyId:<id>,
+//                  name:<name>}, ...]
+//   cohort     - {actionId:<action_id>, returnActionId:<action_id>,
+//                  interval:<int>, periods:<int>}
+//   function   - <name>
+//   profile    - <bool>
+//   stream     - <bool>
+//   queryId    - <int>
+//   timeout    - <int>
+//
+// A filter with a string value matches events where a String property has
+// that value. String values are looked up in the table's dictionary when the
+// message is processed so that they are tested as integer codes.
+//
+// Filters that match a single property value are looked up in the table's
+// property index for that property so only the objects that have the value
+// are scanned. The index is built the first time a property is filtered on.
+//
+// A group by timestamp with an interval buckets events by time, such as by
+// the hour, and returns a dense array of buckets.
+//
+// A cohort query builds a retention matrix of the objects that performed an
+// action in each period and performed the return action in each of the
+// following periods. Only the objects in the table's action index for the
+// cohort action are scanned.
+//
+// A function query passes the events of each object to the query function
+// registered under the name, such as "pathLength". See query_function.h.
+//
+// A distinct aggregate estimates the number of distinct objects in each group
+// and ignores its property id.
+//
+// The results are returned as {status:"ok", data:<results>}. See query.h for
+// how the operators are applied and how the results are laid out. A profiled
+// query also returns the counters and phase timings of its execution as
+// {status:"ok", data:<results>, profile:<profile>}.
+//
+// A query with a timeout stops once it has run for that many milliseconds
+// and returns {status:"timeout"}. A query sent with an id can be stopped
+// with a Cancel message for that id and then returns {status:"cancelled"}.
+// See cancel_message.h. Stopped responses are not cached.
+//
+// A streamed query returns its results as a series of {data:<part>} frames
+// that are sent as soon as each one is encoded, followed by a final
+// {status:"ok"} frame that also holds the profile of a profiled query. The
+// parts of grouped results each hold some of the top level keys and clients
+// combine them into one map. A failed stream is ended by closing the
+// connection. Streamed queries are sent straight to a node since the
+// coordinator only merges single responses.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The default number of top level result keys in each frame of a streamed
+// response.
+#define SKY_QUERY_MESSAGE_DEFAULT_FRAME_KEY_COUNT 1000
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A filter on the string value of a property.
+typedef struct sky_query_message_string_filter {
+    sky_property_id_t property_id;
+    bstring value;
+} sky_query_message_string_filter;
+
+// A message for executing a query plan. The results are built in the arena
+// if one is set. The arena is not owned by the message. The frame key count
+// sets the size of the frames of a streamed response and is not sent. The
+// cancellation flag is set by the server while the message is processed
+// and is not owned by the message. The stopped flag is set when the query
+// was stopped before it finished.
+typedef struct sky_query_message {
+    sky_query *query;
+    sky_arena *arena;
+    sky_query_message_string_filter *string_filters;
+    uint32_t string_filter_count;
+    bool profile;
+    bool stream;
+    uint32_t frame_key_count;
+    uint64_t query_id;
+    int64_t timeout;
+    volatile bool *cancelled;
+    bool stopped;
+} sky_query_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_query_message *sky_query_message_create();
+
+void sky_query_message_free(sky_query_message *message);
+
+//--------------------------------------
+// Filters
+//--------------------------------------
+
+int sky_query_message_add_string_filter(sky_query_message *message,
+    sky_property_id_t property_id, bstring value);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int sky_query_message_pack(sky_query_message *message, FILE *file);
+
+int sky_query_message_unpack(sky_query_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_query_message_process(sky_query_message *message, sky_table *table,
+    sky_buffer *output);
+
+#endif
@@ -0,0 +1,513 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "replica.h"
+#include "replicate_message.h"
+#include "minipack.h"
+#include "stats.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_replica_apply_blocks(sky_table *table, FILE *input, bool full,
+    uint32_t block_size, uint32_t block_count, bool *stale);
+
+int sky_replica_apply_file(bstring path, FILE *input, bool full,
+    bool *changed);
+
+int sky_replica_apply_dictionary(sky_table *table, FILE *input,
+    size_t offset, bool full, bool *changed, bool *stale);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a replica of a primary server.
+//
+// address  - The address of the primary. This is HOST:PORT or the path of a
+//            Unix domain socket.
+// interval - The number of milliseconds between syncs of a table.
+//
+// Returns a reference to the new replica if successful. Otherwise returns
+// null.
+sky_replica *sky_replica_create(bstring address, uint32_t interval)
+{
+    sky_replica *replica = NULL;
+    check(address != NULL, "Primary address required");
+
+    replica = calloc(1, sizeof(sky_replica)); check_mem(replica);
+    replica->interval = interval;
+    replica->coordinator = sky_coordinator_create(); check_mem(replica->coordinator);
+    check(sky_coordinator_add_node(replica->coordinator, address) == 0, "Unable to add primary");
+    return replica;
+
+error:
+    sky_replica_free(replica);
+    return NULL;
+}
+
+// Closes the connection to the primary and removes a replica from memory.
+//
+// replica - The replica.
+void sky_replica_free(sky_replica *replica)
+{
+    if(replica) {
+        sky_coordinator_free(replica->coordinator);
+        replica->coordinator = NULL;
+        free(replica);
+    }
+}
+
+
+//--------------------------------------
+// Syncing
+//--------------------------------------
+
+// Checks whether a replica can serve a type of message. Only messages that
+// read a table are served.
+//
+// type - The message type.
+//
+// Returns true if the message can be served by a replica.
+bool sky_replica_accepts_message(sky_message_type_e type)
+{
+    switch(type) {
+        case SKY_MESSAGE_TYPE_EGET:
+        case SKY_MESSAGE_TYPE_EMGET:
+        case SKY_MESSAGE_TYPE_NEXT_ACTION:
+        case SKY_MESSAGE_TYPE_QUERY:
+        case SKY_MESSAGE_TYPE_FUNNEL:
+        case SKY_MESSAGE_TYPE_DAG:
+        case SKY_MESSAGE_TYPE_AGET:
+        case SKY_MESSAGE_TYPE_AALL:
+        case SKY_MESSAGE_TYPE_PGET:
+        case SKY_MESSAGE_TYPE_PALL:
+        case SKY_MESSAGE_TYPE_STATS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Copies the changes of a table from the primary if the last sync is older
+// than the replication interval. A table whose copy cannot be updated in
+// place is copied again in full.
+//
+// replica - The replica.
+// header  - The header of the message that the table is synced for. Only
+//           the version and the database and table names are used.
+// table   - The table to sync.
+// force   - Whether to sync even if the last sync is recent.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_replica_sync(sky_replica *replica, sky_message_header *header,
+                     sky_table *table, bool force)
+{
+    int rc;
+    uint32_t attempt;
+    char *data = NULL;
+    size_t length = 0;
+    FILE *file = NULL;
+    sky_buffer *body = NULL;
+    sky_buffer *response = NULL;
+    sky_replicate_message *message = NULL;
+    struct tagbstring name = bsStatic("replicate");
+    check(replica != NULL, "Replica required");
+    check(header != NULL, "Message header required");
+    check(table != NULL, "Table required");
+
+    int64_t now = sky_stats_now();
+    if(!force && table->replicated_at > 0 && now - table->replicated_at < ((int64_t)replica->interval * 1000)) {
+        return 0;
+    }
+
+    body = sky_buffer_create(); check_mem(body);
+    response = sky_buffer_create(); check_mem(response);
+    message = sky_replicate_message_create(); check_mem(message);
+
+    sky_message_header request = *header;
+    request.name = &name;
+    request.type = SKY_MESSAGE_TYPE_REPLICATE;
+
+    // A copy that turns out to be stale is discarded and copied in full.
+    for(attempt=0; attempt<2; attempt++) {
+        rc = sky_action_file_ensure_loaded(table->action_file);
+        check(rc == 0, "Unable to load actions");
+        rc = sky_property_file_ensure_loaded(table->property_file);
+        check(rc == 0, "Unable to load properties");
+        message->epoch = table->replica_epoch;
+        message->version = table->replica_version;
+        message->action_count = table->action_file->action_count;
+        message->property_count = table->property_file->property_count;
+        message->dictionary_length = table->dictionary_file->length;
+
+        file = open_memstream(&data, &length); check_mem(file);
+        rc = sky_replicate_message_pack(message, file);
+        check(rc == 0, "Unable to pack Replicate message");
+        fclose(file);
+        file = NULL;
+        sky_buffer_clear(body);
+        rc = sky_buffer_write(body, data, length);
+        check(rc == 0, "Unable to write message body");
+        free(data);
+        data = NULL;
+
+        sky_buffer_clear(response);
+        rc = sky_coordinator_route(replica->coordinator, 0, &request, body, response);
+        check(rc == 0, "Unable to request changes from primary");
+
+        bool stale = false;
+        file = fmemopen(response->data, response->length, "r"); check_mem(file);
+        rc = sky_replica_apply(table, file, &stale);
+        check(rc == 0, "Unable to apply changes from primary");
+        fclose(file);
+        file = NULL;
+
+        if(!stale) break;
+        table->replica_epoch = 0;
+        table->replica_version = 0;
+    }
+    table->replicated_at = now;
+
+    sky_replicate_message_free(message);
+    sky_buffer_free(body);
+    sky_buffer_free(response);
+    return 0;
+
+error:
+    if(file) fclose(file);
+    free(data);
+    sky_replicate_message_free(message);
+    sky_buffer_free(body);
+    sky_buffer_free(response);
+    return -1;
+}
+
+// Applies the response to a Replicate message to the replica's copy of a
+// table. Nothing is changed if the copy is found to be stale, which happens
+// when the primary's data file shrank or was recreated with a different
+// block size while the replica still expects changes to its current copy.
+//
+// table - The table.
+// input - The input stream to read the response from.
+// stale - A pointer to where a flag is returned stating if the copy must be
+//         copied in full instead.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_replica_apply(sky_table *table, FILE *input, bool *stale)
+{
+    int rc;
+    size_t sz;
+    bstring key = NULL;
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(stale != NULL, "Stale return pointer required");
+    *stale = false;
+
+    uint64_t epoch = 0, version = 0;
+    bool full = false;
+    uint32_t block_size = 0, block_count = 0;
+    size_t dictionary_offset = 0;
+    bool changed = false, metadata_changed = false;
+
+    uint32_t map_length = minipack_fread_map(input, &sz);
+    check(sz > 0, "Unable to read response map");
+
+    uint32_t i;
+    for(i=0; i<map_length && !*stale; i++) {
+        rc = sky_minipack_fread_bstring(input, &key);
+        check(rc == 0, "Unable to read response key");
+
+        if(biseqcstr(key, "status") == 1) {
+            bstring status = NULL;
+            rc = sky_minipack_fread_bstring(input, &status);
+            check(rc == 0, "Unable to read status");
+            bool ok = (biseqcstr(status, "ok") == 1);
+            bdestroy(status);
+            check(ok, "Primary did not return changes");
+        }
+        else if(biseqcstr(key, "epoch") == 1) {
+            epoch = minipack_fread_uint(input, &sz);
+            check(sz > 0, "Unable to read epoch");
+        }
+        else if(biseqcstr(key, "version") == 1) {
+            version = minipack_fread_uint(input, &sz);
+            check(sz > 0, "Unable to read version");
+        }
+        else if(biseqcstr(key, "full") == 1) {
+            full = minipack_fread_bool(input, &sz);
+            check(sz > 0, "Unable to read full flag");
+        }
+        else if(biseqcstr(key, "blockSize") == 1) {
+            block_size = (uint32_t)minipack_fread_uint(input, &sz);
+            check(sz > 0, "Unable to read block size");
+        }
+        else if(biseqcstr(key, "blockCount") == 1) {
+            block_count = (uint32_t)minipack_fread_uint(input, &sz);
+            check(sz > 0, "Unable to read block count");
+        }
+        else if(biseqcstr(key, "blocks") == 1) {
+            rc = sky_replica_apply_blocks(table, input, full, block_size, block_count, stale);
+            check(rc == 0, "Unable to apply blocks");
+            changed = true;
+        }
+        else if(biseqcstr(key, "actions") == 1) {
+            rc = sky_replica_apply_file(table->action_file->path, input, full, &metadata_changed);
+            check(rc == 0, "Unable to apply action file");
+        }
+        else if(biseqcstr(key, "properties") == 1) {
+            rc = sky_replica_apply_file(table->property_file->path, input, full, &metadata_changed);
+            check(rc == 0, "Unable to apply property file");
+        }
+        else if(biseqcstr(key, "dictionaryOffset") == 1) {
+            dictionary_offset = (size_t)minipack_fread_uint(input, &sz);
+            check(sz > 0, "Unable to read dictionary offset");
+        }
+        else if(biseqcstr(key, "dictionary") == 1) {
+            rc = sky_replica_apply_dictionary(table, input, dictionary_offset, full, &metadata_changed, stale);
+            check(rc == 0, "Unable to apply dictionary");
+        }
+        else {
+            sentinel("Invalid 'Replicate' response key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    if(metadata_changed) {
+        rc = sky_table_reload_metadata(table);
+        check(rc == 0, "Unable to reload table metadata");
+    }
+    if(changed || metadata_changed) {
+        sky_table_invalidate(table);
+    }
+    if(!*stale) {
+        table->replica_epoch = epoch;
+        table->replica_version = version;
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+// Writes the changed blocks of a response over the replica's data file. A
+// full copy replaces the data file first. The blocks are sorted again once
+// they have all been written.
+//
+// table       - The table.
+// input       - The input stream positioned at the block array.
+// full        - Whether the response is a full copy.
+// block_size  - The block size of the primary's data file.
+// block_count - The number of blocks in the primary's data file.
+// stale       - A pointer to where a flag is returned stating if the copy
+//               must be copied in full instead.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_replica_apply_blocks(sky_table *table, FILE *input, bool full,
+                             uint32_t block_size, uint32_t block_count,
+                             bool *stale)
+{
+    int rc;
+    uint32_t i;
+    size_t sz;
+    void *data = NULL;
+    sky_block **blocks = NULL;
+    bool batching = false;
+    check(table->shard_set == NULL, "Sharded tables cannot be replicated");
+    check(table->partition_set == NULL, "Partitioned tables cannot be replicated");
+    check(block_size > 0 && block_count > 0, "Block size and count must precede blocks");
+
+    if(full) {
+        rc = sky_table_reset_data_file(table, block_size);
+        check(rc == 0, "Unable to reset data file");
+    }
+    sky_data_file *data_file = table->data_file;
+    if(data_file->block_size != block_size || data_file->block_count > block_count) {
+        *stale = true;
+        return 0;
+    }
+
+    rc = sky_data_file_begin_batch(data_file);
+    check(rc == 0, "Unable to begin batch");
+    batching = true;
+
+    // Add the blocks that the primary created since the last sync.
+    if(block_count > data_file->block_count) {
+        uint32_t count = block_count - data_file->block_count;
+        blocks = calloc(count, sizeof(*blocks)); check_mem(blocks);
+        rc = sky_data_file_create_blocks(data_file, count, blocks);
+        check(rc == 0, "Unable to create blocks");
+        free(blocks);
+        blocks = NULL;
+    }
+
+    // Blocks are kept in sorted order so look them up by index.
+    blocks = calloc(data_file->block_count, sizeof(*blocks)); check_mem(blocks);
+    for(i=0; i<data_file->block_count; i++) {
+        blocks[data_file->blocks[i]->index] = data_file->blocks[i];
+    }
+
+    data = malloc(block_size); check_mem(data);
+    uint32_t count = minipack_fread_array(input, &sz);
+    check(sz > 0, "Unable to read block array");
+    for(i=0; i<count; i++) {
+        uint8_t header[SKY_BLOCK_HEADER_SIZE];
+        check(minipack_fread_array(input, &sz) == 3 && sz > 0, "Invalid block entry");
+        uint32_t index = (uint32_t)minipack_fread_uint(input, &sz);
+        check(sz > 0 && index < data_file->block_count, "Invalid block index: %d", index);
+        check(minipack_fread_raw(input, &sz) == SKY_BLOCK_HEADER_SIZE && sz > 0, "Invalid block header entry");
+        check(fread(header, SKY_BLOCK_HEADER_SIZE, 1, input) == 1, "Unable to read block header entry");
+        uint32_t length = minipack_fread_raw(input, &sz);
+        check(sz > 0 && length <= block_size, "Invalid block data");
+        if(length > 0) {
+            check(fread(data, length, 1, input) == 1, "Unable to read block data");
+        }
+
+        rc = sky_block_replace(blocks[index], header, data, length);
+        check(rc == 0, "Unable to replace block #%d", index);
+    }
+
+    rc = sky_data_file_normalize(data_file);
+    check(rc == 0, "Unable to normalize data file");
+
+    batching = false;
+    rc = sky_data_file_end_batch(data_file);
+    check(rc == 0, "Unable to end batch");
+
+    free(data);
+    free(blocks);
+    return 0;
+
+error:
+    if(batching) sky_data_file_end_batch(data_file);
+    free(data);
+    free(blocks);
+    return -1;
+}
+
+// Replaces a file of the replica's table with the copy in a response. A nil
+// value means the file did not change, except for a full copy where it
+// means that the primary has no such file.
+//
+// path    - The path of the replica's file.
+// input   - The input stream positioned at the value.
+// full    - Whether the response is a full copy.
+// changed - A pointer to a flag that is set if the file was changed.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_replica_apply_file(bstring path, FILE *input, bool full,
+                           bool *changed)
+{
+    int rc;
+    size_t sz;
+    void *data = NULL;
+
+    int c = fgetc(input);
+    check(c != EOF, "Unable to read file contents");
+    ungetc(c, input);
+    uint8_t type = (uint8_t)c;
+
+    if(minipack_is_nil(&type)) {
+        minipack_fread_nil(input, &sz);
+        check(sz > 0, "Unable to read nil");
+        if(full && sky_file_exists(path)) {
+            rc = sky_file_rm(path);
+            check(rc == 0, "Unable to remove file: %s", bdata(path));
+            *changed = true;
+        }
+        return 0;
+    }
+
+    uint32_t length = minipack_fread_raw(input, &sz);
+    check(sz > 0, "Unable to read file contents");
+    data = malloc(length > 0 ? length : 1); check_mem(data);
+    if(length > 0) {
+        check(fread(data, length, 1, input) == 1, "Unable to read file contents");
+    }
+    rc = sky_file_write(path, data, length);
+    check(rc == 0, "Unable to write file: %s", bdata(path));
+    *changed = true;
+
+    free(data);
+    return 0;
+
+error:
+    free(data);
+    return -1;
+}
+
+// Appends the new records of the primary's dictionary file to the replica's
+// dictionary file. A full copy replaces the whole file.
+//
+// table   - The table.
+// input   - The input stream positioned at the dictionary records.
+// offset  - The offset of the records in the dictionary file.
+// full    - Whether the response is a full copy.
+// changed - A pointer to a flag that is set if the file was changed.
+// stale   - A pointer to where a flag is returned stating if the copy must
+//           be copied in full instead.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_replica_apply_dictionary(sky_table *table, FILE *input,
+                                 size_t offset, bool full, bool *changed,
+                                 bool *stale)
+{
+    int rc;
+    size_t sz;
+    int fd = -1;
+    void *data = NULL;
+    sky_dictionary_file *dictionary_file = table->dictionary_file;
+
+    uint32_t length = minipack_fread_raw(input, &sz);
+    check(sz > 0, "Unable to read dictionary records");
+    if(length == 0 && !full) {
+        return 0;
+    }
+    if(!full && offset != dictionary_file->length) {
+        *stale = true;
+        return 0;
+    }
+
+    data = malloc(length > 0 ? length : 1); check_mem(data);
+    if(length > 0) {
+        check(fread(data, length, 1, input) == 1, "Unable to read dictionary records");
+    }
+
+    fd = open(bdata(dictionary_file->path), O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+    check(fd != -1, "Unable to open dictionary file: %s", bdata(dictionary_file->path));
+    if(length > 0) {
+        check(pwrite(fd, data, length, offset) == (ssize_t)length, "Unable to write dictionary file");
+    }
+    rc = ftruncate(fd, offset + length);
+    check(rc == 0, "Unable to truncate dictionary file");
+    close(fd);
+    fd = -1;
+    *changed = true;
+
+    free(data);
+    return 0;
+
+error:
+    if(fd != -1) close(fd);
+    free(data);
+    return -1;
+}
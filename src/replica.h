@@ -0,0 +1,88 @@
+#ifndef _sky_replica_h
+#define _sky_replica_h
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+#include "coordinator.h"
+#include "message_header.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A replica keeps read-only copies of the tables of a primary server so that
+// queries can be spread across several servers. Tables are copied at the
+// block level. The primary tracks the write version at which each block was
+// last changed, so a replica only asks for the blocks that changed since its
+// last sync and writes them over its own copy of the data file, which has
+// the same format. See replicate_message.h for what is sent.
+//
+// Tables are synced on demand. Before a replica serves a message for a
+// table, it syncs the table if the last sync is older than the replication
+// interval. A table's first sync after it is opened copies the whole table.
+// Messages that change a table are rejected since the replica's copy would
+// be overwritten by the next sync.
+//
+// A replica keeps one connection to the primary and is not thread safe.
+// Each worker of a replica server owns its own replica, just like the
+// coordinator of a coordinating server. The connection is reused from the
+// coordinator with the primary as its only node.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The default number of milliseconds a replica's copy of a table may lag
+// behind the primary before it is synced again.
+#define SKY_DEFAULT_REPLICATION_INTERVAL 1000
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef struct sky_replica {
+    sky_coordinator *coordinator;
+    uint32_t interval;
+} sky_replica;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_replica *sky_replica_create(bstring address, uint32_t interval);
+
+void sky_replica_free(sky_replica *replica);
+
+//--------------------------------------
+// Syncing
+//--------------------------------------
+
+bool sky_replica_accepts_message(sky_message_type_e type);
+
+int sky_replica_sync(sky_replica *replica, sky_message_header *header,
+    sky_table *table, bool force);
+
+int sky_replica_apply(sky_table *table, FILE *input, bool *stale);
+
+#endif
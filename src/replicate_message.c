@@ -0,0 +1,421 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "types.h"
+#include "replicate_message.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+struct tagbstring SKY_REPLICATE_KEY_EPOCH = bsStatic("epoch");
+
+struct tagbstring SKY_REPLICATE_KEY_VERSION = bsStatic("version");
+
+struct tagbstring SKY_REPLICATE_KEY_ACTION_COUNT = bsStatic("actionCount");
+
+struct tagbstring SKY_REPLICATE_KEY_PROPERTY_COUNT = bsStatic("propertyCount");
+
+struct tagbstring SKY_REPLICATE_KEY_DICTIONARY_LENGTH = bsStatic("dictionaryLength");
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+// The epoch of this process. It is chosen the first time it is needed.
+uint64_t sky_replicate_message_epoch = 0;
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_replicate_message_pack_file(sky_buffer *output, bstring path,
+    bool changed);
+
+int sky_replicate_message_pack_dictionary(sky_replicate_message *message,
+    sky_table *table, bool full, sky_buffer *output);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a Replicate message object.
+//
+// Returns a new Replicate message.
+sky_replicate_message *sky_replicate_message_create()
+{
+    sky_replicate_message *message = NULL;
+    message = calloc(1, sizeof(sky_replicate_message)); check_mem(message);
+    return message;
+
+error:
+    sky_replicate_message_free(message);
+    return NULL;
+}
+
+// Frees a Replicate message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_replicate_message_free(sky_replicate_message *message)
+{
+    if(message) {
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Epoch
+//--------------------------------------
+
+// Retrieves the epoch of this process. The epoch combines the start time
+// with the process id so that a restarted primary never reuses the epoch
+// of an earlier run.
+//
+// Returns the epoch.
+uint64_t sky_replicate_message_get_epoch()
+{
+    if(sky_replicate_message_epoch == 0) {
+        uint64_t epoch = (((uint64_t)time(NULL)) << 24) | (((uint64_t)getpid()) & 0xFFFFFF);
+        __sync_bool_compare_and_swap(&sky_replicate_message_epoch, 0, epoch);
+    }
+    return sky_replicate_message_epoch;
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Calculates the total number of bytes needed to store the message.
+//
+// message - The message.
+//
+// Returns the number of bytes required to store the message.
+size_t sky_replicate_message_sizeof(sky_replicate_message *message)
+{
+    size_t sz = 0;
+    sz += minipack_sizeof_map(5);
+    sz += minipack_sizeof_raw(blength(&SKY_REPLICATE_KEY_EPOCH)) + blength(&SKY_REPLICATE_KEY_EPOCH);
+    sz += minipack_sizeof_uint(message->epoch);
+    sz += minipack_sizeof_raw(blength(&SKY_REPLICATE_KEY_VERSION)) + blength(&SKY_REPLICATE_KEY_VERSION);
+    sz += minipack_sizeof_uint(message->version);
+    sz += minipack_sizeof_raw(blength(&SKY_REPLICATE_KEY_ACTION_COUNT)) + blength(&SKY_REPLICATE_KEY_ACTION_COUNT);
+    sz += minipack_sizeof_uint(message->action_count);
+    sz += minipack_sizeof_raw(blength(&SKY_REPLICATE_KEY_PROPERTY_COUNT)) + blength(&SKY_REPLICATE_KEY_PROPERTY_COUNT);
+    sz += minipack_sizeof_uint(message->property_count);
+    sz += minipack_sizeof_raw(blength(&SKY_REPLICATE_KEY_DICTIONARY_LENGTH)) + blength(&SKY_REPLICATE_KEY_DICTIONARY_LENGTH);
+    sz += minipack_sizeof_uint(message->dictionary_length);
+    return sz;
+}
+
+// Serializes a Replicate message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_replicate_message_pack(sky_replicate_message *message, FILE *file)
+{
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    check(minipack_fwrite_map(file, 5, &sz) == 0, "Unable to pack map");
+    check(sky_minipack_fwrite_bstring(file, &SKY_REPLICATE_KEY_EPOCH) == 0, "Unable to pack epoch key");
+    check(minipack_fwrite_uint(file, message->epoch, &sz) == 0, "Unable to pack epoch");
+    check(sky_minipack_fwrite_bstring(file, &SKY_REPLICATE_KEY_VERSION) == 0, "Unable to pack version key");
+    check(minipack_fwrite_uint(file, message->version, &sz) == 0, "Unable to pack version");
+    check(sky_minipack_fwrite_bstring(file, &SKY_REPLICATE_KEY_ACTION_COUNT) == 0, "Unable to pack action count key");
+    check(minipack_fwrite_uint(file, message->action_count, &sz) == 0, "Unable to pack action count");
+    check(sky_minipack_fwrite_bstring(file, &SKY_REPLICATE_KEY_PROPERTY_COUNT) == 0, "Unable to pack property count key");
+    check(minipack_fwrite_uint(file, message->property_count, &sz) == 0, "Unable to pack property count");
+    check(sky_minipack_fwrite_bstring(file, &SKY_REPLICATE_KEY_DICTIONARY_LENGTH) == 0, "Unable to pack dictionary length key");
+    check(minipack_fwrite_uint(file, message->dictionary_length, &sz) == 0, "Unable to pack dictionary length");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes a Replicate message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_replicate_message_unpack(sky_replicate_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    bstring key = NULL;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    uint32_t map_length = minipack_fread_map(file, &sz);
+    check(sz > 0, "Unable to read map");
+
+    uint32_t i;
+    for(i=0; i<map_length; i++) {
+        rc = sky_minipack_fread_bstring(file, &key);
+        check(rc == 0, "Unable to read map key");
+
+        if(biseq(key, &SKY_REPLICATE_KEY_EPOCH) == 1) {
+            message->epoch = minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack epoch");
+        }
+        else if(biseq(key, &SKY_REPLICATE_KEY_VERSION) == 1) {
+            message->version = minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack version");
+        }
+        else if(biseq(key, &SKY_REPLICATE_KEY_ACTION_COUNT) == 1) {
+            message->action_count = (uint32_t)minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack action count");
+        }
+        else if(biseq(key, &SKY_REPLICATE_KEY_PROPERTY_COUNT) == 1) {
+            message->property_count = (uint32_t)minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack property count");
+        }
+        else if(biseq(key, &SKY_REPLICATE_KEY_DICTIONARY_LENGTH) == 1) {
+            message->dictionary_length = minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack dictionary length");
+        }
+        else {
+            sentinel("Invalid 'Replicate' key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Collects the changes of a table since the replica's version and writes
+// them to the output.
+//
+// message - The message.
+// table   - The table to replicate.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_replicate_message_process(sky_replicate_message *message,
+                                  sky_table *table, sky_buffer *output)
+{
+    int rc;
+    uint32_t i;
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(table != NULL, "Table required");
+    check(table->shard_set == NULL, "Sharded tables cannot be replicated");
+    check(table->partition_set == NULL, "Partitioned tables cannot be replicated");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring epoch_str = bsStatic("epoch");
+    struct tagbstring version_str = bsStatic("version");
+    struct tagbstring full_str = bsStatic("full");
+    struct tagbstring block_size_str = bsStatic("blockSize");
+    struct tagbstring block_count_str = bsStatic("blockCount");
+    struct tagbstring blocks_str = bsStatic("blocks");
+    struct tagbstring actions_str = bsStatic("actions");
+    struct tagbstring properties_str = bsStatic("properties");
+
+    // Merge buffered events so that every acknowledged event is sent.
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge table");
+
+    // The version is read after the merge. Every later change to a block
+    // of this table is given a higher version.
+    sky_data_file *data_file = table->data_file;
+    uint64_t epoch = sky_replicate_message_get_epoch();
+    uint64_t version = __sync_add_and_fetch(&sky_data_file_last_write_version, 0);
+    bool full = (message->epoch != epoch || message->version == 0);
+
+    // Count the changed blocks.
+    uint32_t changed_count = 0;
+    for(i=0; i<data_file->block_count; i++) {
+        if(full || data_file->blocks[i]->write_version > message->version) {
+            changed_count++;
+        }
+    }
+
+    check(sky_buffer_pack_map(output, 11) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &epoch_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_uint(output, epoch) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &version_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_uint(output, version) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &full_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_bool(output, full) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &block_size_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_uint(output, data_file->block_size) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &block_count_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_uint(output, data_file->block_count) == 0, "Unable to write output");
+
+    // Write each changed block as [index, header, data].
+    check(sky_buffer_pack_bstring(output, &blocks_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_array(output, changed_count) == 0, "Unable to write output");
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block *block = data_file->blocks[i];
+        if(!full && block->write_version <= message->version) {
+            continue;
+        }
+
+        uint8_t header[SKY_BLOCK_HEADER_SIZE];
+        rc = sky_block_pack(block, header, &sz);
+        check(rc == 0, "Unable to pack block header entry");
+        // Make sure a damaged block is not sent to the replica.
+        rc = sky_block_verify_checksum(block);
+        check(rc == 0, "Unable to verify block #%d", block->index);
+        void *ptr = NULL;
+        rc = sky_block_get_raw_ptr(block, &ptr);
+        check(rc == 0, "Unable to retrieve raw block pointer");
+        size_t length;
+        rc = sky_block_get_stored_length(block, &length);
+        check(rc == 0, "Unable to determine stored block length");
+
+        check(sky_buffer_pack_array(output, 3) == 0, "Unable to write output");
+        check(sky_buffer_pack_uint(output, block->index) == 0, "Unable to write output");
+        check(sky_buffer_pack_raw(output, header, SKY_BLOCK_HEADER_SIZE) == 0, "Unable to write output");
+        check(sky_buffer_pack_raw(output, ptr, (uint32_t)length) == 0, "Unable to write output");
+    }
+
+    // Write the action and property files if they changed.
+    rc = sky_action_file_ensure_loaded(table->action_file);
+    check(rc == 0, "Unable to load actions");
+    rc = sky_property_file_ensure_loaded(table->property_file);
+    check(rc == 0, "Unable to load properties");
+    check(sky_buffer_pack_bstring(output, &actions_str) == 0, "Unable to write output");
+    rc = sky_replicate_message_pack_file(output, table->action_file->path,
+        full || message->action_count != table->action_file->action_count);
+    check(rc == 0, "Unable to write action file");
+    check(sky_buffer_pack_bstring(output, &properties_str) == 0, "Unable to write output");
+    rc = sky_replicate_message_pack_file(output, table->property_file->path,
+        full || message->property_count != table->property_file->property_count);
+    check(rc == 0, "Unable to write property file");
+
+    rc = sky_replicate_message_pack_dictionary(message, table, full, output);
+    check(rc == 0, "Unable to write dictionary");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes the contents of a file as a raw value if it changed. A file that
+// did not change or that does not exist is written as nil.
+//
+// output  - The output buffer.
+// path    - The path of the file.
+// changed - Whether the replica's copy of the file is out of date.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_replicate_message_pack_file(sky_buffer *output, bstring path,
+                                    bool changed)
+{
+    int rc;
+    void *data = NULL;
+    size_t length = 0;
+
+    if(!changed || !sky_file_exists(path)) {
+        check(sky_buffer_pack_nil(output) == 0, "Unable to write output");
+        return 0;
+    }
+
+    rc = sky_file_read(path, &data, &length);
+    check(rc == 0, "Unable to read file: %s", bdata(path));
+    check(sky_buffer_pack_raw(output, data, (uint32_t)length) == 0, "Unable to write output");
+
+    free(data);
+    return 0;
+
+error:
+    free(data);
+    return -1;
+}
+
+// Writes the part of the dictionary file after the end of the replica's
+// copy. The whole file is sent for a full copy or if the replica's copy is
+// longer than the file.
+//
+// message - The message.
+// table   - The table.
+// full    - Whether the replica is sent a full copy.
+// output  - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_replicate_message_pack_dictionary(sky_replicate_message *message,
+                                          sky_table *table, bool full,
+                                          sky_buffer *output)
+{
+    int rc;
+    struct tagbstring dictionary_offset_str = bsStatic("dictionaryOffset");
+    struct tagbstring dictionary_str = bsStatic("dictionary");
+
+    sky_dictionary_file *dictionary_file = table->dictionary_file;
+    size_t offset = (size_t)message->dictionary_length;
+    if(full || offset > dictionary_file->length) {
+        offset = 0;
+    }
+    uint32_t length = (uint32_t)(dictionary_file->length - offset);
+
+    check(sky_buffer_pack_bstring(output, &dictionary_offset_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_uint(output, offset) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &dictionary_str) == 0, "Unable to write output");
+
+    // Read the tail of the file straight into the output.
+    if(length == 0) {
+        check(sky_buffer_pack_raw(output, NULL, 0) == 0, "Unable to write output");
+    }
+    else {
+        size_t sz;
+        void *ptr = NULL;
+        rc = sky_buffer_reserve(output, minipack_sizeof_raw(length) + length, &ptr);
+        check(rc == 0, "Unable to reserve output");
+        minipack_pack_raw(ptr, length, &sz);
+        check(pread(dictionary_file->fd, ptr + sz, length, offset) == (ssize_t)length, "Unable to read dictionary file");
+        output->length += sz + length;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
@@ -0,0 +1,96 @@
+#ifndef _sky_replicate_message_h
+#define _sky_replicate_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The Replicate message is sent by a replica to copy the changes of a table
+// from its primary. The message body lists what the replica already has:
+//
+//   {epoch:0, version:0, actionCount:0, propertyCount:0, dictionaryLength:0}
+//
+// The epoch identifies the primary process that the replica last synced
+// with and the version is the write version it was synced to. Write
+// versions restart with the primary process, so a replica with a different
+// epoch or a version of zero is sent a full copy of the table.
+//
+// The response holds every block whose data or header entry changed since
+// the version. Each block is sent as its index, its packed header entry and
+// its stored bytes. The action and property files are sent whole when their
+// counts differ and the dictionary file is sent from the end of the
+// replica's copy since it is only ever appended to:
+//
+//   {status:"ok", epoch:0, version:0, full:false, blockSize:0,
+//    blockCount:0, blocks:[[index, header, data]], actions:nil,
+//    properties:nil, dictionaryOffset:0, dictionary:""}
+//
+// Buffered events are merged into the data file before the changes are
+// collected so the replica receives everything that was acknowledged.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for copying the changes of a table to a replica.
+typedef struct sky_replicate_message {
+    uint64_t epoch;
+    uint64_t version;
+    uint32_t action_count;
+    uint32_t property_count;
+    uint64_t dictionary_length;
+} sky_replicate_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_replicate_message *sky_replicate_message_create();
+
+void sky_replicate_message_free(sky_replicate_message *message);
+
+//--------------------------------------
+// Epoch
+//--------------------------------------
+
+uint64_t sky_replicate_message_get_epoch();
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+size_t sky_replicate_message_sizeof(sky_replicate_message *message);
+
+int sky_replicate_message_pack(sky_replicate_message *message, FILE *file);
+
+int sky_replicate_message_unpack(sky_replicate_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_replicate_message_process(sky_replicate_message *message,
+    sky_table *table, sky_buffer *output);
+
+#endif
@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "result_cache.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+uint32_t sky_result_cache_hash(bstring key);
+
+sky_result_cache_entry *sky_result_cache_find(sky_result_cache *cache,
+    bstring key, uint32_t hash);
+
+void sky_result_cache_remove(sky_result_cache *cache,
+    sky_result_cache_entry *entry);
+
+void sky_result_cache_link(sky_result_cache *cache,
+    sky_result_cache_entry *entry);
+
+void sky_result_cache_unlink(sky_result_cache *cache,
+    sky_result_cache_entry *entry);
+
+int sky_result_cache_grow(sky_result_cache *cache);
+
+size_t sky_result_cache_entry_size(sky_result_cache_entry *entry);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty result cache.
+//
+// capacity - The maximum number of bytes of keys and responses to hold.
+//
+// Returns a reference to the new cache if successful. Otherwise returns
+// null.
+sky_result_cache *sky_result_cache_create(size_t capacity)
+{
+    sky_result_cache *cache = calloc(1, sizeof(sky_result_cache)); check_mem(cache);
+    cache->capacity = capacity;
+    cache->bucket_count = SKY_RESULT_CACHE_INITIAL_BUCKET_COUNT;
+    cache->buckets = calloc(cache->bucket_count, sizeof(*cache->buckets));
+    check_mem(cache->buckets);
+    return cache;
+
+error:
+    sky_result_cache_free(cache);
+    return NULL;
+}
+
+// Removes a result cache and all of its entries from memory.
+//
+// cache - The cache.
+void sky_result_cache_free(sky_result_cache *cache)
+{
+    if(cache) {
+        while(cache->head != NULL) {
+            sky_result_cache_remove(cache, cache->head);
+        }
+        free(cache->buckets);
+        cache->buckets = NULL;
+        free(cache);
+    }
+}
+
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+// Retrieves the cached response for a key. An entry that was built from an
+// older version of the table is removed and counts as a miss.
+//
+// cache   - The cache.
+// key     - The key of the message.
+// version - The current write version of the table.
+// data    - A pointer to where the response should be returned. This is
+//           set to null on a miss. The response is owned by the cache and is
+//           only valid until the cache is changed.
+// length  - A pointer to where the response length should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_result_cache_get(sky_result_cache *cache, bstring key,
+                         uint64_t version, void **data, size_t *length)
+{
+    check(cache != NULL, "Cache required");
+    check(key != NULL, "Key required");
+    check(data != NULL, "Data return pointer required");
+    check(length != NULL, "Length return pointer required");
+    *data = NULL;
+    *length = 0;
+
+    sky_result_cache_entry *entry = sky_result_cache_find(cache, key, sky_result_cache_hash(key));
+    if(entry != NULL && entry->version != version) {
+        sky_result_cache_remove(cache, entry);
+        entry = NULL;
+    }
+
+    if(entry == NULL) {
+        cache->miss_count++;
+        return 0;
+    }
+
+    // Move the entry to the front of the list.
+    sky_result_cache_unlink(cache, entry);
+    sky_result_cache_link(cache, entry);
+    cache->hit_count++;
+
+    *data = entry->data;
+    *length = entry->length;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Stores the response for a key, replacing any existing entry. The least
+// recently used entries are evicted to make room.
+//
+// cache   - The cache.
+// key     - The key of the message. This is copied.
+// version - The write version of the table the response was built from.
+// data    - The response. This is copied.
+// length  - The length of the response.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_result_cache_put(sky_result_cache *cache, bstring key,
+                         uint64_t version, void *data, size_t length)
+{
+    int rc;
+    sky_result_cache_entry *entry = NULL;
+    check(cache != NULL, "Cache required");
+    check(key != NULL, "Key required");
+    check(data != NULL || length == 0, "Data required");
+
+    uint32_t hash = sky_result_cache_hash(key);
+    sky_result_cache_entry *existing = sky_result_cache_find(cache, key, hash);
+    if(existing != NULL) {
+        sky_result_cache_remove(cache, existing);
+    }
+
+    // Responses that could never fit are not stored.
+    size_t size = sizeof(sky_result_cache_entry) + blength(key) + length;
+    if(size > cache->capacity) {
+        return 0;
+    }
+    while(cache->size + size > cache->capacity && cache->tail != NULL) {
+        sky_result_cache_remove(cache, cache->tail);
+    }
+
+    if(cache->entry_count >= cache->bucket_count) {
+        rc = sky_result_cache_grow(cache);
+        check(rc == 0, "Unable to grow cache");
+    }
+
+    entry = calloc(1, sizeof(sky_result_cache_entry)); check_mem(entry);
+    entry->key = bstrcpy(key); check_mem(entry->key);
+    entry->hash = hash;
+    entry->version = version;
+    entry->length = length;
+    if(length > 0) {
+        entry->data = malloc(length); check_mem(entry->data);
+        memcpy(entry->data, data, length);
+    }
+
+    uint32_t index = hash & (cache->bucket_count - 1);
+    entry->next_in_bucket = cache->buckets[index];
+    cache->buckets[index] = entry;
+    sky_result_cache_link(cache, entry);
+    cache->entry_count++;
+    cache->size += size;
+
+    return 0;
+
+error:
+    if(entry) {
+        bdestroy(entry->key);
+        free(entry->data);
+        free(entry);
+    }
+    return -1;
+}
+
+
+//--------------------------------------
+// Entries
+//--------------------------------------
+
+// Hashes a key with FNV-1a.
+//
+// key - The key.
+//
+// Returns the hash of the key.
+uint32_t sky_result_cache_hash(bstring key)
+{
+    int i;
+    uint32_t hash = 2166136261u;
+    for(i=0; i<blength(key); i++) {
+        hash ^= key->data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Finds the entry for a key.
+//
+// cache - The cache.
+// key   - The key.
+// hash  - The hash of the key.
+//
+// Returns the entry or null if the key is not cached.
+sky_result_cache_entry *sky_result_cache_find(sky_result_cache *cache,
+                                              bstring key, uint32_t hash)
+{
+    sky_result_cache_entry *entry = cache->buckets[hash & (cache->bucket_count - 1)];
+    while(entry != NULL) {
+        if(entry->hash == hash && biseq(entry->key, key) == 1) {
+            return entry;
+        }
+        entry = entry->next_in_bucket;
+    }
+    return NULL;
+}
+
+// Removes an entry from the cache and frees it.
+//
+// cache - The cache.
+// entry - The entry to remove.
+void sky_result_cache_remove(sky_result_cache *cache,
+                             sky_result_cache_entry *entry)
+{
+    sky_result_cache_entry **ptr = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+    while(*ptr != entry) {
+        ptr = &(*ptr)->next_in_bucket;
+    }
+    *ptr = entry->next_in_bucket;
+
+    sky_result_cache_unlink(cache, entry);
+    cache->entry_count--;
+    cache->size -= sky_result_cache_entry_size(entry);
+
+    bdestroy(entry->key);
+    free(entry->data);
+    free(entry);
+}
+
+// Adds an entry to the front of the recently used list.
+//
+// cache - The cache.
+// entry - The entry.
+void sky_result_cache_link(sky_result_cache *cache,
+                           sky_result_cache_entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = cache->head;
+    if(cache->head != NULL) {
+        cache->head->prev = entry;
+    }
+    cache->head = entry;
+    if(cache->tail == NULL) {
+        cache->tail = entry;
+    }
+}
+
+// Removes an entry from the recently used list.
+//
+// cache - The cache.
+// entry - The entry.
+void sky_result_cache_unlink(sky_result_cache *cache,
+                             sky_result_cache_entry *entry)
+{
+    if(entry->prev != NULL) {
+        entry->prev->next = entry->next;
+    }
+    else {
+        cache->head = entry->next;
+    }
+    if(entry->next != NULL) {
+        entry->next->prev = entry->prev;
+    }
+    else {
+        cache->tail = entry->prev;
+    }
+    entry->prev = entry->next = NULL;
+}
+
+// Doubles the number of hash buckets and rehashes the entries.
+//
+// cache - The cache.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_result_cache_grow(sky_result_cache *cache)
+{
+    uint32_t i;
+    uint32_t bucket_count = cache->bucket_count * 2;
+    sky_result_cache_entry **buckets = calloc(bucket_count, sizeof(*buckets));
+    check_mem(buckets);
+
+    for(i=0; i<cache->bucket_count; i++) {
+        sky_result_cache_entry *entry = cache->buckets[i];
+        while(entry != NULL) {
+            sky_result_cache_entry *next = entry->next_in_bucket;
+            uint32_t index = entry->hash & (bucket_count - 1);
+            entry->next_in_bucket = buckets[index];
+            buckets[index] = entry;
+            entry = next;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = bucket_count;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Calculates the number of bytes an entry counts against the capacity.
+//
+// entry - The entry.
+//
+// Returns the size of the entry.
+size_t sky_result_cache_entry_size(sky_result_cache_entry *entry)
+{
+    return sizeof(sky_result_cache_entry) + blength(entry->key) + entry->length;
+}
@@ -0,0 +1,106 @@
+#ifndef _sky_result_cache_h
+#define _sky_result_cache_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bstring.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The result cache keeps the responses of recent read-only messages so that
+// a repeated message is answered from memory instead of scanning its table
+// again. Each entry is keyed by the bytes of the message and stores the
+// write version of the table's data file that the response was built from.
+// A lookup only hits if the table has not been written to since, so entries
+// never have to be invalidated explicitly. Stale entries are dropped when
+// they are found.
+//
+// The cache holds up to a fixed number of bytes of keys and responses. When
+// it is full the least recently used entries are evicted. Entries that are
+// larger than the whole cache are not stored.
+//
+// A result cache is not thread safe. Each worker owns its own cache, which
+// matches the tables it owns.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The default number of bytes of responses that a table caches.
+#define SKY_RESULT_CACHE_DEFAULT_SIZE (4 * 1024 * 1024)
+
+// The number of hash buckets in a new cache.
+#define SKY_RESULT_CACHE_INITIAL_BUCKET_COUNT 64
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef struct sky_result_cache_entry sky_result_cache_entry;
+
+// A cached response. Entries are chained in their hash bucket and linked in
+// least recently used order.
+struct sky_result_cache_entry {
+    bstring key;
+    uint32_t hash;
+    uint64_t version;
+    void *data;
+    size_t length;
+    sky_result_cache_entry *next_in_bucket;
+    sky_result_cache_entry *prev;
+    sky_result_cache_entry *next;
+};
+
+// The entries are linked from the most recently used at the head to the
+// least recently used at the tail.
+typedef struct sky_result_cache {
+    size_t capacity;
+    size_t size;
+    sky_result_cache_entry **buckets;
+    uint32_t bucket_count;
+    uint32_t entry_count;
+    sky_result_cache_entry *head;
+    sky_result_cache_entry *tail;
+    uint64_t hit_count;
+    uint64_t miss_count;
+} sky_result_cache;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_result_cache *sky_result_cache_create(size_t capacity);
+
+void sky_result_cache_free(sky_result_cache *cache);
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+int sky_result_cache_get(sky_result_cache *cache, bstring key,
+    uint64_t version, void **data, size_t *length);
+
+int sky_result_cache_put(sky_result_cache *cache, bstring key,
+    uint64_t version, void *data, size_t length);
+
+#endif
@@ -1,21 +1,51 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/tcp.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#else
+#include <sys/types.h>
+#include <sys/event.h>
+#endif
 
 #include "bstring.h"
 #include "server.h"
 #include "message_header.h"
 #include "eadd_message.h"
+#include "ebulk_message.h"
 #include "next_action_message.h"
+#include "funnel_message.h"
+#include "dag_message.h"
+#include "cancel_message.h"
+#include "query_message.h"
 #include "aadd_message.h"
 #include "aget_message.h"
+#include "eget_message.h"
+#include "emget_message.h"
+#include "subscribe_message.h"
+#include "tail_message.h"
 #include "aall_message.h"
 #include "padd_message.h"
 #include "pget_message.h"
 #include "pall_message.h"
+#include "compact_message.h"
+#include "snapshot_message.h"
+#include "replicate_message.h"
+#include "replica.h"
 #include "multi_message.h"
+#include "stats_message.h"
+#include "minipack.h"
 #include "dbg.h"
 
 
@@ -25,10 +55,50 @@
 //
 //==============================================================================
 
-int sky_server_open_table(sky_server *server, bstring database_name,
-    bstring table_name, sky_table **table);
+int sky_server_listen_unix(sky_server *server);
 
-int sky_server_close_table(sky_server *server, sky_table *table);
+int sky_server_poll_add(sky_server *server, int socket, void *ptr);
+
+int sky_server_poll_arm(sky_server *server, sky_connection *connection);
+
+int sky_server_poll_register(sky_server *server, sky_connection *connection);
+
+int sky_server_poll_remove(sky_server *server, int socket);
+
+int sky_server_poll_wait(sky_server *server, void **ptrs, uint32_t *events,
+    int max);
+
+int sky_connection_next_frame(sky_connection *connection, bool *ready);
+
+int sky_connection_fill(sky_connection *connection);
+
+int sky_connection_find_frame(sky_connection *connection, bool *complete);
+
+void sky_connection_reset_frame(sky_connection *connection);
+
+void sky_connection_end_message(sky_connection *connection, size_t offset,
+    bool *complete);
+
+int sky_server_read_body(FILE *input, sky_message_header *header,
+    sky_buffer *body);
+
+int sky_connection_send(sky_connection *connection, size_t min_length);
+
+int sky_connection_flush(sky_connection *connection);
+
+void sky_server_free_multi_responses(sky_connection *connection);
+
+int sky_connection_read_body(sky_connection *connection,
+    sky_message_header *header, sky_buffer **ret);
+
+int sky_server_read_message_body(FILE *input, sky_buffer **body,
+    FILE **body_input);
+
+int sky_server_get_cached_response(sky_table *table, const char *type,
+    sky_buffer *body, sky_buffer *output, bstring *key, bool *hit);
+
+int sky_server_put_cached_response(sky_table *table, bstring key,
+    sky_buffer *output, size_t start);
 
 
 //==============================================================================
@@ -50,9 +120,32 @@ sky_server *sky_server_create(bstring path)
 {
     sky_server *server = NULL;
     server = calloc(1, sizeof(sky_server)); check_mem(server);
+    pthread_mutex_init(&server->query_mutex, NULL);
     server->path = bstrcpy(path);
     if(path) check_mem(server->path);
     server->port = SKY_DEFAULT_PORT;
+    server->durability = SKY_DURABILITY_STRICT;
+    server->group_commit_interval = SKY_DEFAULT_GROUP_COMMIT_INTERVAL;
+    server->group_commit_events = SKY_DEFAULT_GROUP_COMMIT_EVENTS;
+    server->async_flush_interval = SKY_DEFAULT_ASYNC_FLUSH_INTERVAL;
+    server->max_queued_writes = SKY_DEFAULT_MAX_QUEUED_WRITES;
+    server->block_cache_size = SKY_DATA_FILE_DEFAULT_BLOCK_CACHE_SIZE;
+    server->result_cache_size = SKY_RESULT_CACHE_DEFAULT_SIZE;
+    server->replication_interval = SKY_DEFAULT_REPLICATION_INTERVAL;
+
+    // Default to one worker per processor.
+    long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+    server->worker_count = (processor_count > 0 ? (uint32_t)processor_count : SKY_DEFAULT_WORKER_COUNT);
+
+    // Reserve half of the process's file descriptors for open tables and
+    // leave the rest for connections.
+    struct rlimit rl;
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY) {
+        server->max_open_files = (uint32_t)(rl.rlim_cur / 2);
+    }
+    else {
+        server->max_open_files = SKY_DEFAULT_MAX_OPEN_FILES;
+    }
     
     return server;
 
@@ -68,17 +161,78 @@ void sky_server_free(sky_server *server)
 {
     if(server) {
         if(server->path) bdestroy(server->path);
+        if(server->socket_path) bdestroy(server->socket_path);
+        sky_numa_free(server->numa);
+        server->numa = NULL;
+        uint32_t i;
+        for(i=0; i<server->shard_count; i++) {
+            bdestroy(server->shards[i]);
+        }
+        free(server->shards);
+        bdestroy(server->primary);
+        bdestroy(server->trace_log_path);
+        free(server->queries);
+        pthread_mutex_destroy(&server->query_mutex);
         free(server);
     }
 }
 
 
+// Adds a shard node to the server. A server with shard nodes coordinates
+// its tables across the nodes instead of storing them. The order of the
+// nodes determines which node owns each object.
+//
+// server  - The server.
+// address - The HOST:PORT or Unix socket path of the node.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_add_shard(sky_server *server, bstring address)
+{
+    check(server != NULL, "Server required");
+    check(address != NULL, "Address required");
+
+    server->shards = realloc(server->shards, sizeof(*server->shards) * (server->shard_count+1));
+    check_mem(server->shards);
+    server->shards[server->shard_count] = bstrcpy(address);
+    check_mem(server->shards[server->shard_count]);
+    server->shard_count++;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sets the primary server of a replica. A server with a primary serves
+// read-only copies of the primary's tables.
+//
+// server  - The server.
+// address - The HOST:PORT or Unix socket path of the primary.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_set_primary(sky_server *server, bstring address)
+{
+    check(server != NULL, "Server required");
+    check(address != NULL, "Address required");
+
+    bdestroy(server->primary);
+    server->primary = bstrcpy(address); check_mem(server->primary);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
 //--------------------------------------
 // State
 //--------------------------------------
 
 // Starts a server. Once a server is started, it can accept messages over TCP
-// on the bind address and port number specified by the server object.
+// on the bind address and port number specified by the server object. If the
+// server has a socket path then it also accepts messages on a Unix domain
+// socket at that path. A stale socket left at the path is replaced.
 //
 // server - The server to start.
 //
@@ -114,7 +268,82 @@ int sky_server_start(sky_server *server)
     // Listen on socket.
     rc = listen(server->socket, SKY_LISTEN_BACKLOG);
     check(rc != -1, "Unable to listen on socket");
+
+    // Listen on the Unix domain socket.
+    if(server->socket_path != NULL) {
+        rc = sky_server_listen_unix(server);
+        check(rc == 0, "Unable to listen on Unix domain socket: %s", bdata(server->socket_path));
+    }
+
+    // Read the NUMA topology if the workers are placed on nodes.
+    if(server->numa_placement != SKY_NUMA_PLACEMENT_NONE && server->numa == NULL) {
+        struct tagbstring numa_path = bsStatic(SKY_NUMA_SYSFS_PATH);
+        server->numa = sky_numa_create(); check_mem(server->numa);
+        rc = sky_numa_load(server->numa, &numa_path);
+        check(rc == 0, "Unable to read NUMA topology");
+    }
+
+    // Start the I/O threads that read blocks ahead of scans.
+    if(server->prefetch_thread_count > 0 && server->prefetcher == NULL) {
+        server->prefetcher = sky_prefetcher_create(server->prefetch_thread_count);
+        check_mem(server->prefetcher);
+        rc = sky_prefetcher_start(server->prefetcher);
+        check(rc == 0, "Unable to start prefetcher");
+    }
+
+    // Trace messages if they are sampled or slow queries are logged.
+    if((server->trace_sample_rate > 0 || server->slow_query_threshold > 0) && server->tracer == NULL) {
+        server->tracer = sky_tracer_create(); check_mem(server->tracer);
+        server->tracer->sample_rate = server->trace_sample_rate;
+        server->tracer->slow_threshold = (int64_t)server->slow_query_threshold * 1000;
+        if(server->trace_log_path != NULL) {
+            rc = sky_tracer_open(server->tracer, server->trace_log_path);
+            check(rc == 0, "Unable to open trace log");
+        }
+    }
+
+    // Start workers.
+    check(server->worker_count > 0, "At least one worker required");
+    server->workers = calloc(server->worker_count, sizeof(*server->workers));
+    check_mem(server->workers);
+    uint32_t table_file_count = SKY_TABLE_FILE_COUNT + (server->local_shard_count > 1 ? server->local_shard_count - 1 : 0);
+    uint32_t max_tables = (server->max_open_files / table_file_count) / server->worker_count;
+    if(max_tables == 0) max_tables = 1;
+    size_t max_mapped_bytes = server->max_mapped_bytes / server->worker_count;
+    uint32_t i;
+    for(i=0; i<server->worker_count; i++) {
+        server->workers[i] = sky_worker_create(server, i, max_tables, max_mapped_bytes);
+        check_mem(server->workers[i]);
+        rc = sky_worker_start(server->workers[i]);
+        check(rc == 0, "Unable to start worker");
+    }
     
+    // Accept connections without blocking so that the event loop can drain
+    // every pending connection at once.
+    int flags = fcntl(server->socket, F_GETFL, 0);
+    check(flags != -1, "Unable to read socket flags");
+    rc = fcntl(server->socket, F_SETFL, flags | O_NONBLOCK);
+    check(rc == 0, "Unable to set socket as non-blocking");
+
+    // Create the event poller and watch the listening socket. The listening
+    // socket is registered with a NULL reference to distinguish it from
+    // client connections.
+#if defined(__linux__)
+    server->poll_fd = epoll_create(SKY_SERVER_MAX_EVENTS);
+#else
+    server->poll_fd = kqueue();
+#endif
+    check(server->poll_fd != -1, "Unable to create event poller");
+    rc = sky_server_poll_add(server, server->socket, NULL);
+    check(rc == 0, "Unable to watch listening socket");
+
+    // The Unix domain socket is registered with a reference to its own
+    // descriptor for the same reason.
+    if(server->unix_socket > 0) {
+        rc = sky_server_poll_add(server, server->unix_socket, &server->unix_socket);
+        check(rc == 0, "Unable to watch Unix domain socket");
+    }
+
     // Update server state.
     server->state = SKY_SERVER_STATE_RUNNING;
     
@@ -125,7 +354,7 @@ error:
     return -1;
 }
 
-// Stops a server. This actions closes the TCP socket and in-process messages
+// Stops a server. This actions closes the listening sockets and in-process messages
 // will be aborted.
 //
 // server - The server to stop.
@@ -139,6 +368,41 @@ int sky_server_stop(sky_server *server)
     }
     server->socket = 0;
 
+    // Close the Unix domain socket and remove it from the file system.
+    if(server->unix_socket > 0) {
+        close(server->unix_socket);
+        unlink(bdata(server->socket_path));
+    }
+    server->unix_socket = 0;
+
+    // Close event poller if open.
+    if(server->poll_fd > 0) {
+        close(server->poll_fd);
+    }
+    server->poll_fd = 0;
+
+    // Stop workers.
+    if(server->workers) {
+        uint32_t i;
+        for(i=0; i<server->worker_count; i++) {
+            sky_worker_stop(server->workers[i]);
+            sky_worker_free(server->workers[i]);
+        }
+        free(server->workers);
+    }
+    server->workers = NULL;
+
+    // Stop the I/O threads once no table can submit to them.
+    if(server->prefetcher) {
+        sky_prefetcher_stop(server->prefetcher);
+        sky_prefetcher_free(server->prefetcher);
+    }
+    server->prefetcher = NULL;
+
+    // Close the trace log once no worker can finish a trace.
+    sky_tracer_free(server->tracer);
+    server->tracer = NULL;
+
     // Clear socket info.
     if(server->sockaddr) {
         free(server->sockaddr);
@@ -151,280 +415,1804 @@ int sky_server_stop(sky_server *server)
     return 0;
 }
 
-
-//--------------------------------------
-// Connection Management
-//--------------------------------------
-
-// Accepts a connection on a running server. Once a connection is accepted then
-// the message is parsed and processed.
+// Binds and listens on the server's Unix domain socket. Connections on the
+// socket are accepted without blocking like the TCP listener.
 //
 // server - The server.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_server_accept(sky_server *server)
+int sky_server_listen_unix(sky_server *server)
 {
     int rc;
+    struct sockaddr_un sockaddr;
+    check(blength(server->socket_path) > 0, "Socket path required");
+    check((size_t)blength(server->socket_path) < sizeof(sockaddr.sun_path), "Socket path too long");
+
+    memset(&sockaddr, 0, sizeof(sockaddr));
+    sockaddr.sun_family = AF_UNIX;
+    memcpy(sockaddr.sun_path, bdata(server->socket_path), blength(server->socket_path));
+
+    // Remove a socket left behind by a server that did not stop cleanly.
+    // Anything else at the path is left alone and the bind fails.
+    struct stat info;
+    if(stat(bdata(server->socket_path), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(bdata(server->socket_path));
+    }
 
-    // Accept the next connection.
-    int sockaddr_size = sizeof(struct sockaddr_in);
-    int socket = accept(server->socket, (struct sockaddr*)server->sockaddr, (socklen_t *)&sockaddr_size);
-    check(socket != -1, "Unable to accept connection");
+    server->unix_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    check(server->unix_socket != -1, "Unable to create a Unix domain socket");
 
-    // Wrap socket in a buffered file reference.
-    FILE *input = fdopen(socket, "r");
-    FILE *output = fdopen(dup(socket), "w");
-    check(input != NULL, "Unable to open buffered socket input");
-    check(output != NULL, "Unable to open buffered socket output");
-    
-    // Process message.
-    rc = sky_server_process_message(server, input, output);
-    check(rc == 0, "Unable to process message");
-    
-    fclose(input);
-    fclose(output);
+    rc = bind(server->unix_socket, (struct sockaddr*)&sockaddr, sizeof(sockaddr));
+    if(rc != 0) {
+        close(server->unix_socket);
+        server->unix_socket = 0;
+    }
+    check(rc == 0, "Unable to bind Unix domain socket");
+
+    rc = listen(server->unix_socket, SKY_LISTEN_BACKLOG);
+    check(rc != -1, "Unable to listen on Unix domain socket");
+
+    int flags = fcntl(server->unix_socket, F_GETFL, 0);
+    check(flags != -1, "Unable to read socket flags");
+    rc = fcntl(server->unix_socket, F_SETFL, flags | O_NONBLOCK);
+    check(rc == 0, "Unable to set socket as non-blocking");
 
     return 0;
 
 error:
-    fclose(input);
-    fclose(output);
     return -1;
 }
 
 
 //--------------------------------------
-// Message Processing
+// Connection Management
 //--------------------------------------
 
-// Processes a single message.
+// Runs the event loop for a started server. The loop waits for activity on
+// the listening socket and on open connections and dispatches each one until
+// the server is stopped.
 //
 // server - The server.
-// input  - The input stream.
-// output - The output stream.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_server_process_message(sky_server *server, FILE *input, FILE *output)
+int sky_server_run(sky_server *server)
+{
+    int i;
+    void *ptrs[SKY_SERVER_MAX_EVENTS];
+    uint32_t events[SKY_SERVER_MAX_EVENTS];
+    check(server != NULL, "Server required");
+    check(server->state == SKY_SERVER_STATE_RUNNING, "Server not running");
+
+    while(server->state == SKY_SERVER_STATE_RUNNING) {
+        int count = sky_server_poll_wait(server, ptrs, events, SKY_SERVER_MAX_EVENTS);
+        check(count >= 0, "Unable to wait for socket events");
+
+        for(i=0; i<count; i++) {
+            // A NULL reference is the listening socket.
+            if(ptrs[i] == NULL) {
+                sky_server_accept(server, server->socket);
+            }
+            else if(ptrs[i] == &server->unix_socket) {
+                sky_server_accept(server, server->unix_socket);
+            }
+            else {
+                sky_server_handle_events(server, ptrs[i], events[i]);
+            }
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Accepts all pending connections on one of a running server's listening
+// sockets. Each connection is given its buffers and registered with the
+// event poller so that its messages are processed as they arrive.
+//
+// server   - The server.
+// listener - The listening socket to accept connections from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_accept(sky_server *server, int listener)
 {
     int rc;
-    sky_message_header *header = NULL;
-    
-    // Parse message header.
-    header = sky_message_header_create(); check_mem(header);
-    rc = sky_message_header_unpack(header, input);
-    check(rc == 0, "Unable to unpack message header");
+    int socket = -1;
+    sky_connection *connection = NULL;
+
+    while(true) {
+        // Accept the next connection. Stop once no connections remain.
+        socket = accept(listener, NULL, NULL);
+        if(socket == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            break;
+        }
+        check(socket != -1, "Unable to accept connection");
+
+        // Connections are never read or written with waiting. Accepted
+        // sockets do not inherit non-blocking mode from the listener on
+        // every platform so it is always set.
+        int flags = fcntl(socket, F_GETFL, 0);
+        check(flags != -1, "Unable to read socket flags");
+        rc = fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+        check(rc == 0, "Unable to set socket as non-blocking");
+
+        // Responses are small so send them as soon as they are flushed.
+        if(listener == server->socket) {
+            int optval = 1;
+            setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+        }
 
-    // Ignore the database/table if this is a multi message.
-    if(biseqcstr(header->name, "multi") == 1) {
-        rc = sky_server_process_multi_message(server, input, output);
-        check(rc == 0, "Unable to process multi message");
+        // Collect incoming bytes in a pending buffer and responses in an
+        // output buffer.
+        connection = calloc(1, sizeof(sky_connection)); check_mem(connection);
+        pthread_mutex_init(&connection->mutex, NULL);
+        connection->ref_count = 1;
+        connection->server = server;
+        connection->socket = socket;
+        socket = -1;
+        connection->output = sky_buffer_create(); check_mem(connection->output);
+        connection->unsent = sky_buffer_create(); check_mem(connection->unsent);
+        connection->pending = sky_buffer_create(); check_mem(connection->pending);
+        sky_connection_reset_frame(connection);
+        __sync_fetch_and_add(&server->connection_count, 1);
+
+        // Watch the connection for incoming messages.
+        rc = sky_server_poll_arm(server, connection);
+        check(rc == 0, "Unable to watch connection");
+        connection = NULL;
     }
-    else {
-        // Open database & table.
-        sky_table *table = NULL;
-        rc = sky_server_open_table(server, header->database_name, header->table_name, &table);
-        check(rc == 0, "Unable to open table");
 
-        // Parse appropriate message type.
-        if(biseqcstr(header->name, "eadd") == 1) {
-            rc = sky_server_process_eadd_message(server, table, input, output);
+    return 0;
+
+error:
+    if(socket != -1) close(socket);
+    sky_server_close_connection(server, connection);
+    return -1;
+}
+
+// Dispatches the next message on a connection. The header is read on the
+// calling thread and the message is queued on the worker that owns its table.
+// The bodies of pipelined messages are read here as well so that dispatching
+// can continue with the next message. If no complete message is waiting then
+// the connection is returned to the event poller. This is called by the event
+// loop when a connection becomes readable and by workers once they finish a
+// message.
+//
+// server     - The server.
+// connection - The connection to read messages from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_dispatch(sky_server *server, sky_connection *connection)
+{
+    int rc;
+    bool ready;
+    sky_message_header *header = NULL;
+    sky_trace *trace = NULL;
+    check(server != NULL, "Server required");
+    check(connection != NULL, "Connection required");
+
+    while(true) {
+        // Send any responses before waiting for more data.
+        rc = sky_connection_send(connection, 0);
+        check(rc == 0, "Unable to send connection output");
+
+        // Stop reading while the client is not reading its responses. The
+        // connection is dispatched again once they have been sent.
+        pthread_mutex_lock(&connection->mutex);
+        bool blocked = connection->write_armed;
+        connection->read_blocked = blocked;
+        pthread_mutex_unlock(&connection->mutex);
+        if(blocked) {
+            return 0;
         }
-        else if(biseqcstr(header->name, "next_action") == 1) {
-            rc = sky_server_process_next_action_message(server, table, input, output);
+
+        rc = sky_connection_next_frame(connection, &ready);
+        check(rc == 0, "Unable to read from connection");
+
+        // Stop reading once the client has disconnected. The socket is left
+        // open for the responses to any pipelined messages that are still
+        // being processed.
+        if(!ready && connection->eof) {
+            sky_server_release_connection(server, connection);
+            return 0;
         }
-        else if(biseqcstr(header->name, "aadd") == 1) {
-            rc = sky_server_process_aadd_message(server, table, input, output);
+        // Wait for the rest of the message. The connection cannot be touched
+        // once it is handed back.
+        else if(!ready) {
+            rc = sky_server_poll_arm(server, connection);
+            check(rc == 0, "Unable to watch connection");
+            return 0;
         }
-        else if(biseqcstr(header->name, "aget") == 1) {
-            rc = sky_server_process_aget_message(server, table, input, output);
+
+        // Parse message header.
+        int64_t t0 = (server->tracer != NULL ? sky_stats_now() : 0);
+        header = sky_message_header_create(); check_mem(header);
+        rc = sky_message_header_unpack(header, connection->input);
+        check(rc == 0, "Unable to unpack message header");
+
+        // Messages that are handled here are not traced.
+        bool traced = (header->type != SKY_MESSAGE_TYPE_CANCEL && header->type != SKY_MESSAGE_TYPE_MULTI);
+        if(traced && server->tracer != NULL) {
+            trace = sky_tracer_start(server->tracer, header, t0);
+            if(trace != NULL) trace->body_offset = (size_t)ftell(connection->input);
         }
-        else if(biseqcstr(header->name, "aall") == 1) {
-            rc = sky_server_process_aall_message(server, table, input, output);
+
+        // Cancel messages are answered here since the workers may be busy
+        // with the queries that they cancel.
+        if(header->type == SKY_MESSAGE_TYPE_CANCEL) {
+            rc = sky_server_process_cancel_message(server, connection, header);
+            check(rc == 0, "Unable to process cancel message");
+            sky_message_header_free(header);
+            header = NULL;
         }
-        else if(biseqcstr(header->name, "padd") == 1) {
-            rc = sky_server_process_padd_message(server, table, input, output);
+        // Writes are turned away while too many are waiting on the worker.
+        else if(sky_server_should_slow_down(server, header)) {
+            sky_trace_free(trace);
+            trace = NULL;
+            rc = sky_server_process_slow_down(server, connection, header);
+            check(rc == 0, "Unable to process slow down");
+            sky_message_header_free(header);
+            header = NULL;
         }
-        else if(biseqcstr(header->name, "pget") == 1) {
-            rc = sky_server_process_pget_message(server, table, input, output);
+        // Multi messages are expanded into their child messages. The
+        // connection belongs to the children once they are queued.
+        else if(header->type == SKY_MESSAGE_TYPE_MULTI) {
+            bool queued = false;
+            sky_message_header_free(header);
+            header = NULL;
+            rc = sky_server_process_multi_message(server, connection, &queued);
+            check(rc == 0, "Unable to process multi message");
+            if(queued) {
+                return 0;
+            }
         }
-        else if(biseqcstr(header->name, "pall") == 1) {
-            rc = sky_server_process_pall_message(server, table, input, output);
+        // Pipelined messages are read in full and hold a reference to the
+        // connection while they wait on the worker.
+        else if(header->pipelined) {
+            sky_worker *worker = sky_server_get_worker(server, header);
+            check(worker != NULL, "Unable to find worker");
+            sky_buffer *body = NULL;
+            rc = sky_connection_read_body(connection, header, &body);
+            check(rc == 0, "Unable to read pipelined message body");
+            sky_trace_mark(trace, SKY_TRACE_SPAN_BODY);
+            __sync_fetch_and_add(&connection->ref_count, 1);
+            rc = sky_worker_enqueue(worker, connection, header, body, trace, SKY_WORKER_REPLY_PIPELINED, 0);
+            if(rc != 0) {
+                sky_server_release_connection(server, connection);
+                sky_buffer_free(body);
+            }
+            check(rc == 0, "Unable to queue message");
+            header = NULL;
+            trace = NULL;
         }
+        // All other messages are passed to the table's worker.
         else {
-            sentinel("Invalid message type");
+            sky_worker *worker = sky_server_get_worker(server, header);
+            check(worker != NULL, "Unable to find worker");
+            rc = sky_worker_enqueue(worker, connection, header, NULL, trace, SKY_WORKER_REPLY_DISPATCH, 0);
+            check(rc == 0, "Unable to queue message");
+            return 0;
         }
-        check(rc == 0, "Unable to process message: %s", bdata(header->name));
     }
-    
-    sky_message_header_free(header);
+
     return 0;
 
 error:
+    sky_trace_free(trace);
     sky_message_header_free(header);
+    sky_server_close_connection(server, connection);
     return -1;
 }
 
+// Handles the socket events of a connection that were returned by the event
+// poller. Events are only acted on if the connection was armed for them. A
+// writable socket continues sending the connection's unsent responses and a
+// readable socket dispatches the connection's next message.
+//
+// server     - The server.
+// connection - The connection.
+// events     - The kinds of events that occurred.
+void sky_server_handle_events(sky_server *server, sky_connection *connection,
+                              uint32_t events)
+{
+    int rc = 0;
+    pthread_mutex_lock(&connection->mutex);
+    bool read = (connection->read_armed && (events & SKY_SERVER_POLL_READ));
+    bool write = (connection->write_armed && (events & SKY_SERVER_POLL_WRITE));
+    if(read) connection->read_armed = false;
+    if(write) connection->write_armed = false;
+
+    // An epoll registration is disabled once any of its events fire so the
+    // events that are still wanted are registered again.
+#if defined(__linux__)
+    if(connection->read_armed || connection->write_armed) {
+        rc = sky_server_poll_register(server, connection);
+    }
+#endif
+    pthread_mutex_unlock(&connection->mutex);
+    if(rc != 0) {
+        sky_connection_shutdown(connection);
+    }
 
-//--------------------------------------
-// Table management
-//--------------------------------------
+    // The reference held by the poller for the write is released once the
+    // write has continued.
+    if(write) {
+        sky_connection_flush(connection);
+        sky_server_release_connection(server, connection);
+    }
+    if(read) {
+        sky_server_dispatch(server, connection);
+    }
+}
 
-// Opens an table.
+// Finds the worker that owns the table targeted by a message.
 //
-// server        - The server that is opening the table.
-// database_name - The name of the database to open.
-// table_name    - The name of the table to open.
-// table         - Returns the instance of the table to the caller. 
+// server - The server.
+// header - The message header.
 //
-// Returns 0 if successful, otherwise returns -1.
-int sky_server_open_table(sky_server *server, bstring database_name,
-                          bstring table_name,  sky_table **table)
+// Returns the worker that owns the table.
+sky_worker *sky_server_get_worker(sky_server *server,
+                                  sky_message_header *header)
 {
-    int rc;
+    uint32_t i;
+    uint32_t hash = 5381;
     check(server != NULL, "Server required");
-    check(blength(database_name) > 0, "Database name required");
-    check(blength(table_name) > 0, "Table name required");
-    
-    // Initialize return values.
-    *table = NULL;
+    check(header != NULL, "Message header required");
+    check(server->worker_count > 0, "No workers available");
+
+    // Hash the database and table name using djb2.
+    for(i=0; i<(uint32_t)blength(header->database_name); i++) {
+        hash = ((hash << 5) + hash) + (uint8_t)bchar(header->database_name, i);
+    }
+    hash = ((hash << 5) + hash) + '/';
+    for(i=0; i<(uint32_t)blength(header->table_name); i++) {
+        hash = ((hash << 5) + hash) + (uint8_t)bchar(header->table_name, i);
+    }
+
+    return server->workers[hash % server->worker_count];
+
+error:
+    return NULL;
+}
+
+// Closes a connection and releases the reference held by its reader. The
+// connection is freed once every pipelined message on it has finished.
+//
+// server     - The server.
+// connection - The connection to close.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_close_connection(sky_server *server,
+                                sky_connection *connection)
+{
+    if(connection) {
+        sky_connection_shutdown(connection);
+        sky_server_release_connection(server, connection);
+    }
     
-    // Determine the path to the table.
-    bstring path = bformat("%s/%s/%s", bdata(server->path), bdata(database_name), bdata(table_name));
-    check_mem(path);
+    return 0;
+}
 
-    // If the table is already open then reuse it.
-    if(server->last_table != NULL && biseq(server->last_table->path, path) == 1) {
-        *table = server->last_table;
+// Releases a reference to a connection and frees the connection once no
+// references remain.
+//
+// server     - The server.
+// connection - The connection to release.
+void sky_server_release_connection(sky_server *server,
+                                   sky_connection *connection)
+{
+    if(__sync_sub_and_fetch(&connection->ref_count, 1) > 0) {
+        return;
     }
-    // Otherwise open the table.
-    else {
-        // Close the currently open table if one exists
-        if(server->last_table != NULL) {
-            rc = sky_server_close_table(server, server->last_table);
-            check(rc == 0, "Unable to close current table");
+
+    // Remove the registration before the socket is closed so that the
+    // poller never holds a descriptor that has been reused.
+    sky_server_poll_remove(server, connection->socket);
+
+    if(connection->input) {
+        fclose(connection->input);
+    }
+    if(connection->pending) {
+        __sync_fetch_and_sub(&server->connection_count, 1);
+        sky_buffer_free(connection->pending);
+    }
+    if(connection->socket > 0) {
+        close(connection->socket);
+    }
+    sky_buffer_free(connection->output);
+    sky_buffer_free(connection->unsent);
+    sky_server_free_multi_responses(connection);
+    pthread_mutex_destroy(&connection->mutex);
+    free(connection);
+}
+
+// Moves a connection on to its next complete message. The previous frame
+// is removed from the pending buffer and the socket is read without waiting
+// if the buffer does not hold a complete message yet.
+//
+// connection - The connection.
+// ready      - Set to true if the input holds a complete message.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_connection_next_frame(sky_connection *connection, bool *ready)
+{
+    int rc;
+    bool complete = false;
+    *ready = false;
+    sky_buffer *pending = connection->pending;
+
+    // Drop the previous message.
+    if(connection->input != NULL) {
+        fclose(connection->input);
+        connection->input = NULL;
+        memmove(pending->data, pending->data + connection->frame_length, pending->length - connection->frame_length);
+        pending->length -= connection->frame_length;
+        sky_connection_reset_frame(connection);
+        if(pending->length == 0 && pending->capacity > SKY_CONNECTION_MAX_OUTPUT_CAPACITY) {
+            sky_buffer_release(pending);
         }
-        
-        // Create the table.
-        *table = sky_table_create(); check_mem(*table);
-        rc = sky_table_set_path(*table, path);
-        check(rc == 0, "Unable to set table path");
-    
-        // Open the table.
-        rc = sky_table_open(*table);
-        check(rc == 0, "Unable to open table");
-    
-        // Save the reference as the currently open table.
-        server->last_table = *table;
     }
 
-    bdestroy(path);
+    // Look for a complete message in what has arrived so far and read more
+    // from the socket if there is none.
+    rc = sky_connection_find_frame(connection, &complete);
+    check(rc == 0, "Unable to parse message");
+    if(!complete && !connection->eof) {
+        rc = sky_connection_fill(connection);
+        check(rc == 0, "Unable to read from connection");
+        rc = sky_connection_find_frame(connection, &complete);
+        check(rc == 0, "Unable to parse message");
+    }
+    if(!complete) {
+        check(pending->length <= SKY_CONNECTION_MAX_FRAME_LENGTH, "Message too large");
+        return 0;
+    }
+
+    connection->input = fmemopen(pending->data, connection->frame_length, "r");
+    check(connection->input != NULL, "Unable to open message");
+    *ready = true;
     return 0;
 
 error:
-    bdestroy(path);
-    sky_table_free(*table);
-    *table = NULL;
     return -1;
 }
 
-// Closes a table.
+// Reads everything that is waiting on a connection's socket into its pending
+// buffer without blocking. The end of the input is set once the client has
+// closed the connection.
 //
-// server - The server.
-// table  - The table to close.
+// connection - The connection.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_server_close_table(sky_server *server, sky_table *table)
+int sky_connection_fill(sky_connection *connection)
 {
     int rc;
-    check(server != NULL, "Server required");
-    check(table != NULL, "Table required");
-    
-    // Close the table.
-    rc = sky_table_close(table);
-    check(rc == 0, "Unable to close table");
+    void *ptr = NULL;
+    sky_buffer *pending = connection->pending;
+
+    while(true) {
+        rc = sky_buffer_reserve(pending, SKY_CONNECTION_READ_SIZE, &ptr);
+        check(rc == 0, "Unable to grow connection input");
+        ssize_t n = recv(connection->socket, ptr, SKY_CONNECTION_READ_SIZE, MSG_DONTWAIT);
+        if(n > 0) {
+            pending->length += (size_t)n;
+            if(pending->length > SKY_CONNECTION_MAX_FRAME_LENGTH) {
+                break;
+            }
+        }
+        else if(n == -1 && errno == EINTR) {
+            continue;
+        }
+        else if(n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        else {
+            connection->eof = true;
+            break;
+        }
+    }
 
-    // Free the table.
-    sky_table_free(table);
-    
     return 0;
 
 error:
-    sky_table_free(table);
     return -1;
 }
 
-
-//--------------------------------------
-// Event Messages
-//--------------------------------------
-
-// Parses and process an Event Add (EADD) message.
+// Continues looking for the end of the message at the start of a
+// connection's pending buffer. Only the bytes that arrived since the last
+// call are scanned. The header of each message is unpacked once it has
+// fully arrived to find out how its body is framed.
 //
-// server - The server.
-// table  - The table to apply the message to.
-// input  - The input file stream.
-// output - The output file stream.
+// connection - The connection.
+// complete   - Set to true if a complete message is waiting. The frame
+//              length is then the length of the message.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_server_process_eadd_message(sky_server *server, sky_table *table,
-                                    FILE *input, FILE *output)
+int sky_connection_find_frame(sky_connection *connection, bool *complete)
 {
     int rc;
-    check(server != NULL, "Server required");
-    check(table != NULL, "Table required");
-    check(input != NULL, "Input required");
-    check(output != NULL, "Output stream required");
-    
-    debug("Message received: [EADD]");
-    
-    // Parse message.
-    sky_eadd_message *message = sky_eadd_message_create(); check_mem(message);
-    rc = sky_eadd_message_unpack(message, input);
-    check(rc == 0, "Unable to parse EADD message");
-    
-    // Process message.
-    rc = sky_eadd_message_process(message, table, output);
-    check(rc == 0, "Unable to process EADD message");
-    
+    bool done = false;
+    FILE *file = NULL;
+    sky_message_header *header = NULL;
+    sky_buffer *pending = connection->pending;
+    sky_minipack_decoder *decoder = &connection->decoder;
+    *complete = false;
+
+    while(!*complete) {
+        if(connection->frame_stage == SKY_CONNECTION_FRAME_PIPELINED_BODY) {
+            if(pending->length < connection->frame_offset) {
+                break;
+            }
+            sky_connection_end_message(connection, connection->frame_offset, complete);
+            continue;
+        }
+
+        rc = sky_minipack_decoder_skip(decoder, pending->data, pending->length, &done);
+        check(rc == 0, "Invalid message");
+        if(!done) {
+            break;
+        }
+
+        // Unpack the header in place to find where its body ends.
+        if(connection->frame_stage == SKY_CONNECTION_FRAME_HEADER) {
+            file = fmemopen(pending->data + connection->frame_offset, decoder->offset - connection->frame_offset, "r");
+            check(file != NULL, "Unable to open message header");
+            header = sky_message_header_create(); check_mem(header);
+            rc = sky_message_header_unpack(header, file);
+            check(rc == 0, "Unable to unpack message header");
+            fclose(file);
+            file = NULL;
+
+            if(header->type == SKY_MESSAGE_TYPE_MULTI && !connection->frame_multi) {
+                connection->frame_multi = true;
+                connection->frame_stage = SKY_CONNECTION_FRAME_COUNT;
+                connection->frame_offset = decoder->offset;
+                sky_minipack_decoder_init(decoder, decoder->offset);
+            }
+            else if(header->pipelined) {
+                check(header->length <= SKY_CONNECTION_MAX_PIPELINED_LENGTH, "Pipelined message too large: %llu", (unsigned long long)header->length);
+                connection->frame_stage = SKY_CONNECTION_FRAME_PIPELINED_BODY;
+                connection->frame_offset = decoder->offset + (size_t)header->length;
+            }
+            else if(sky_server_message_has_body(header)) {
+                connection->frame_stage = SKY_CONNECTION_FRAME_BODY;
+                sky_minipack_decoder_init(decoder, decoder->offset);
+            }
+            else {
+                sky_connection_end_message(connection, decoder->offset, complete);
+            }
+            sky_message_header_free(header);
+            header = NULL;
+        }
+        // The count of a multi message is followed by its messages.
+        else if(connection->frame_stage == SKY_CONNECTION_FRAME_COUNT) {
+            size_t sz;
+            void *ptr = pending->data + connection->frame_offset;
+            connection->frame_children = minipack_unpack_uint(ptr, &sz);
+            check(sz > 0, "Unable to read message count");
+            if(connection->frame_children == 0) {
+                connection->frame_multi = false;
+                connection->frame_length = decoder->offset;
+                *complete = true;
+            }
+            else {
+                connection->frame_stage = SKY_CONNECTION_FRAME_HEADER;
+                connection->frame_offset = decoder->offset;
+                sky_minipack_decoder_init(decoder, decoder->offset);
+            }
+        }
+        else {
+            sky_connection_end_message(connection, decoder->offset, complete);
+        }
+    }
+
     return 0;
 
 error:
+    if(file) fclose(file);
+    sky_message_header_free(header);
     return -1;
 }
 
+// Starts looking for a new message at the start of a connection's pending
+// buffer.
+//
+// connection - The connection.
+void sky_connection_reset_frame(sky_connection *connection)
+{
+    connection->frame_length = 0;
+    connection->frame_stage = SKY_CONNECTION_FRAME_HEADER;
+    connection->frame_offset = 0;
+    connection->frame_children = 0;
+    connection->frame_multi = false;
+    sky_minipack_decoder_init(&connection->decoder, 0);
+}
 
-//--------------------------------------
-// Query Messages
-//--------------------------------------
+// Moves past the end of a message. The frame is complete unless more
+// messages of a multi message are still to come.
+//
+// connection - The connection.
+// offset     - The position just past the end of the message.
+// complete   - Set to true if the frame is complete.
+void sky_connection_end_message(sky_connection *connection, size_t offset,
+                                bool *complete)
+{
+    if(connection->frame_multi && --connection->frame_children == 0) {
+        connection->frame_multi = false;
+    }
+    if(connection->frame_multi) {
+        connection->frame_stage = SKY_CONNECTION_FRAME_HEADER;
+        connection->frame_offset = offset;
+        sky_minipack_decoder_init(&connection->decoder, offset);
+    }
+    else {
+        connection->frame_length = offset;
+        *complete = true;
+    }
+}
 
-// Parses and process a 'Next Action' message.
+// Sends the buffered responses of a connection once at least a minimum
+// number of bytes are waiting. Nothing is sent if another thread is already
+// writing to the connection since that thread sends the new responses as
+// well once it is done.
 //
-// server - The server.
-// table  - The table to apply the message to.
-// input  - The input file stream.
-// output - The output file stream.
+// connection - The connection.
+// min_length - The number of bytes that must be waiting before sending.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_server_process_next_action_message(sky_server *server, sky_table *table,
-                                           FILE *input, FILE *output)
+int sky_connection_send(sky_connection *connection, size_t min_length)
 {
-    int rc;
-    check(server != NULL, "Server required");
-    check(table != NULL, "Table required");
-    check(input != NULL, "Input required");
-    check(output != NULL, "Output stream required");
-    
-    debug("Message received: [Next Action]");
+    int rc = 0;
+    bool write = false;
+    check(connection != NULL, "Connection required");
+
+    pthread_mutex_lock(&connection->mutex);
+    if(connection->closed) {
+        rc = -1;
+    }
+    else if(!connection->writing && connection->output->length > 0 && connection->output->length >= min_length) {
+        sky_buffer *unsent = connection->unsent;
+        connection->unsent = connection->output;
+        connection->output = unsent;
+        connection->writing = true;
+        sky_stats_add(bytes_out, connection->unsent->length);
+        write = true;
+    }
+    pthread_mutex_unlock(&connection->mutex);
+    check(rc == 0, "Unable to write to socket");
+
+    if(write) {
+        rc = sky_connection_flush(connection);
+        check(rc == 0, "Unable to write to socket");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes the unsent responses of a connection to its socket without
+// waiting. This is only called by the thread that set the writing flag and
+// the mutex is not held while the socket is written. Responses that were
+// added to the output in the meantime are sent afterward. If the socket is
+// full then the connection is armed for writing and the event loop calls
+// this again once the socket is writable. A reader that stopped while the
+// responses were stuck is resumed once they have all been sent. Buffers
+// that have grown past the maximum output capacity are freed once they are
+// sent.
+//
+// connection - The connection.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_connection_flush(sky_connection *connection)
+{
+    int rc;
+    bool more = true;
+    bool blocked = false;
+    check(connection != NULL, "Connection required");
+
+    while(more) {
+        rc = sky_buffer_send(connection->unsent, connection->socket);
+
+        pthread_mutex_lock(&connection->mutex);
+        if(rc == 0 && connection->unsent->length > 0) {
+            // The poller holds a reference until the socket is writable.
+            __sync_fetch_and_add(&connection->ref_count, 1);
+            connection->write_armed = true;
+            rc = sky_server_poll_register(connection->server, connection);
+            if(rc == 0) {
+                pthread_mutex_unlock(&connection->mutex);
+                return 0;
+            }
+            connection->write_armed = false;
+            __sync_fetch_and_sub(&connection->ref_count, 1);
+        }
+
+        if(connection->unsent->capacity > SKY_CONNECTION_MAX_OUTPUT_CAPACITY) {
+            sky_buffer_release(connection->unsent);
+        }
+        sky_buffer_clear(connection->unsent);
+        more = (rc == 0 && !connection->closed && connection->output->length > 0);
+        if(more) {
+            sky_buffer *unsent = connection->unsent;
+            connection->unsent = connection->output;
+            connection->output = unsent;
+            sky_stats_add(bytes_out, connection->unsent->length);
+        }
+        else {
+            connection->writing = false;
+            blocked = connection->read_blocked;
+            connection->read_blocked = false;
+        }
+        pthread_mutex_unlock(&connection->mutex);
+    }
+
+    // A failed write closes the connection. A stopped reader is resumed or,
+    // if the write failed, its reference is released.
+    if(rc != 0) {
+        sky_connection_shutdown(connection);
+    }
+    if(blocked && rc == 0) {
+        sky_server_dispatch(connection->server, connection);
+    }
+    else if(blocked) {
+        sky_server_release_connection(connection->server, connection);
+    }
+    check(rc == 0, "Unable to write to socket");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Copies a response to the output buffer of a connection.
+//
+// connection - The connection.
+// response   - The response to copy.
+// send       - Whether the output should be sent immediately.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_connection_write(sky_connection *connection, sky_buffer *response,
+                         bool send)
+{
+    int rc = 0;
+    check(connection != NULL, "Connection required");
+    check(response != NULL, "Response required");
+
+    pthread_mutex_lock(&connection->mutex);
+    if(connection->closed) {
+        rc = -1;
+    }
+    else {
+        rc = sky_buffer_write(connection->output, response->data, response->length);
+    }
+    pthread_mutex_unlock(&connection->mutex);
+    check(rc == 0, "Unable to write response");
+
+    if(send) {
+        rc = sky_connection_send(connection, 0);
+        check(rc == 0, "Unable to send response");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Shuts down the socket of a connection so that no more responses are
+// written and the reader of the connection stops at the next read.
+//
+// connection - The connection.
+void sky_connection_shutdown(sky_connection *connection)
+{
+    pthread_mutex_lock(&connection->mutex);
+    if(!connection->closed) {
+        connection->closed = true;
+        shutdown(connection->socket, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&connection->mutex);
+}
+
+// Reads the body of a message from a connection into memory.
+//
+// connection - The connection.
+// header     - The header of the message.
+// ret        - A pointer to where the body should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_connection_read_body(sky_connection *connection,
+                             sky_message_header *header, sky_buffer **ret)
+{
+    int rc;
+    void *ptr = NULL;
+    sky_buffer *body = NULL;
+    check(connection != NULL, "Connection required");
+    check(header != NULL, "Message header required");
+
+    body = sky_buffer_create(); check_mem(body);
+    rc = sky_server_read_body(connection->input, header, body);
+    check(rc == 0, "Unable to read message body");
+
+    sky_stats_add(read_ahead_bytes, body->length);
+
+    // Make sure there is memory to read from even if the body is empty.
+    rc = sky_buffer_reserve(body, 1, &ptr);
+    check(rc == 0, "Unable to allocate message body");
+
+    *ret = body;
+    return 0;
+
+error:
+    sky_buffer_free(body);
+    *ret = NULL;
+    return -1;
+}
+
+// Reads the body of a message from a stream. Pipelined messages specify the
+// length of their body. Other bodies are copied one MessagePack element at a
+// time since their length is not known.
+//
+// input  - The input stream.
+// header - The header of the message.
+// body   - The buffer to append the body to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_read_body(FILE *input, sky_message_header *header,
+                         sky_buffer *body)
+{
+    int rc;
+    void *ptr = NULL;
+
+    if(header->pipelined) {
+        check(header->length <= SKY_CONNECTION_MAX_PIPELINED_LENGTH, "Pipelined message too large: %llu", (unsigned long long)header->length);
+        rc = sky_buffer_reserve(body, header->length, &ptr);
+        check(rc == 0, "Unable to allocate message body");
+        if(header->length > 0) {
+            check_debug(fread(ptr, header->length, 1, input) == 1, "Unable to read message body");
+        }
+        body->length += header->length;
+    }
+    else if(sky_server_message_has_body(header)) {
+        rc = sky_minipack_fread_elem(input, body);
+        check_debug(rc == 0, "Unable to read message body");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Event Polling
+//--------------------------------------
+
+// Registers a socket with the server's event poller for read events.
+//
+// server - The server.
+// socket - The socket to watch.
+// ptr    - A reference returned when the socket becomes readable.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_poll_add(sky_server *server, int socket, void *ptr)
+{
+    int rc;
+
+#if defined(__linux__)
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = ptr;
+    rc = epoll_ctl(server->poll_fd, EPOLL_CTL_ADD, socket, &event);
+#else
+    struct kevent event;
+    EV_SET(&event, socket, EVFILT_READ, EV_ADD, 0, 0, ptr);
+    rc = kevent(server->poll_fd, &event, 1, NULL, 0, NULL);
+#endif
+    check(rc != -1, "Unable to register socket with poller");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Registers a connection with the server's event poller for a single read
+// event. Once the event fires the connection is disabled until it is armed
+// again so that only one thread processes a connection at a time.
+//
+// server     - The server.
+// connection - The connection to watch.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_poll_arm(sky_server *server, sky_connection *connection)
+{
+    int rc;
+    pthread_mutex_lock(&connection->mutex);
+    connection->read_armed = true;
+    rc = sky_server_poll_register(server, connection);
+    if(rc != 0) connection->read_armed = false;
+    pthread_mutex_unlock(&connection->mutex);
+    check(rc == 0, "Unable to arm connection");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Registers a connection with the server's event poller for a single event
+// of each kind that it is armed for. The connection's mutex must be held by
+// the caller.
+//
+// server     - The server.
+// connection - The connection to watch.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_poll_register(sky_server *server, sky_connection *connection)
+{
+    int rc;
+    bool registered = connection->registered;
+    connection->registered = true;
+
+#if defined(__linux__)
+    struct epoll_event event;
+    event.events = EPOLLONESHOT;
+    if(connection->read_armed) event.events |= EPOLLIN;
+    if(connection->write_armed) event.events |= EPOLLOUT;
+    event.data.ptr = connection;
+    rc = epoll_ctl(server->poll_fd, (registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD), connection->socket, &event);
+#else
+    (void)registered;
+    int count = 0;
+    struct kevent events[2];
+    if(connection->read_armed) {
+        EV_SET(&events[count++], connection->socket, EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, connection);
+    }
+    if(connection->write_armed) {
+        EV_SET(&events[count++], connection->socket, EVFILT_WRITE, EV_ADD | EV_ONESHOT, 0, 0, connection);
+    }
+    rc = kevent(server->poll_fd, events, count, NULL, 0, NULL);
+#endif
+    if(rc == -1) connection->registered = registered;
+    check(rc != -1, "Unable to register connection with poller");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Removes a socket from the server's event poller.
+//
+// server - The server.
+// socket - The socket to stop watching.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_poll_remove(sky_server *server, int socket)
+{
+    int rc;
+
+#if defined(__linux__)
+    struct epoll_event event;
+    rc = epoll_ctl(server->poll_fd, EPOLL_CTL_DEL, socket, &event);
+#else
+    struct kevent event;
+    EV_SET(&event, socket, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+    rc = kevent(server->poll_fd, &event, 1, NULL, 0, NULL);
+    if(rc != -1 || errno == ENOENT) {
+        EV_SET(&event, socket, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+        rc = kevent(server->poll_fd, &event, 1, NULL, 0, NULL);
+    }
+#endif
+
+    // Sockets that have never been armed or whose single event has already
+    // fired may not be registered.
+    if(rc == -1 && errno == ENOENT) {
+        return 0;
+    }
+    check(rc != -1, "Unable to remove socket from poller");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Waits for one or more registered sockets to become readable or writable.
+// Errors and hang ups are returned as both kinds of events so that the next
+// read or write on the socket fails.
+//
+// server - The server.
+// ptrs   - An array that receives the reference of each socket.
+// events - An array that receives the kinds of events of each socket.
+// max    - The maximum number of references to return.
+//
+// Returns the number of sockets or -1 if an error occurred.
+int sky_server_poll_wait(sky_server *server, void **ptrs, uint32_t *events,
+                         int max)
+{
+    int i, count;
+    check(max <= SKY_SERVER_MAX_EVENTS, "Too many events requested");
+
+#if defined(__linux__)
+    struct epoll_event results[SKY_SERVER_MAX_EVENTS];
+    count = epoll_wait(server->poll_fd, results, max, -1);
+#else
+    struct kevent results[SKY_SERVER_MAX_EVENTS];
+    count = kevent(server->poll_fd, NULL, 0, results, max, NULL);
+#endif
+
+    // Signals interrupt the wait but are not errors.
+    if(count == -1 && errno == EINTR) {
+        return 0;
+    }
+    check(count != -1, "Unable to wait on poller");
+    
+    for(i=0; i<count; i++) {
+#if defined(__linux__)
+        ptrs[i] = results[i].data.ptr;
+        events[i] = 0;
+        if(results[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) events[i] |= SKY_SERVER_POLL_READ;
+        if(results[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) events[i] |= SKY_SERVER_POLL_WRITE;
+#else
+        ptrs[i] = results[i].udata;
+        events[i] = (results[i].filter == EVFILT_WRITE ? SKY_SERVER_POLL_WRITE : SKY_SERVER_POLL_READ);
+#endif
+    }
+
+    return count;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Message Processing
+//--------------------------------------
+
+// Checks whether a message is followed by a body. Every message body is a
+// single MessagePack element except for the messages that list all actions
+// or properties, which have no body.
+//
+// header - The message header.
+//
+// Returns true if the message has a body.
+bool sky_server_message_has_body(sky_message_header *header)
+{
+    return !(header->type == SKY_MESSAGE_TYPE_AALL || header->type == SKY_MESSAGE_TYPE_PALL);
+}
+
+// Processes a single message whose header has already been read. This is
+// called by the worker that owns the table.
+//
+// server - The server.
+// table  - The table the message is targeting or NULL for a Stats message.
+// header - The message header.
+// arena  - The arena for temporary memory used while processing the message.
+// input  - The input stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_message(sky_server *server, sky_table *table,
+                               sky_message_header *header, sky_arena *arena,
+                               FILE *input, sky_buffer *output)
+{
+    int rc;
+    check(server != NULL, "Server required");
+    check(header != NULL, "Message header required");
+    check(table != NULL || header->type == SKY_MESSAGE_TYPE_STATS, "Table required");
+
+    // Dispatch on the message type resolved when the header was read.
+    switch(header->type) {
+        case SKY_MESSAGE_TYPE_EADD:
+            rc = sky_server_process_eadd_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_EBULK:
+            rc = sky_server_process_ebulk_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_EGET:
+            rc = sky_server_process_eget_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_EMGET:
+            rc = sky_server_process_emget_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_SUBSCRIBE:
+            rc = sky_server_process_subscribe_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_TAIL:
+            rc = sky_server_process_tail_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_NEXT_ACTION:
+            rc = sky_server_process_next_action_message(server, table, arena, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_QUERY:
+            rc = sky_server_process_query_message(server, table, arena, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_FUNNEL:
+            rc = sky_server_process_funnel_message(server, table, arena, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_DAG:
+            rc = sky_server_process_dag_message(server, table, arena, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_AADD:
+            rc = sky_server_process_aadd_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_AGET:
+            rc = sky_server_process_aget_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_AALL:
+            rc = sky_server_process_aall_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_PADD:
+            rc = sky_server_process_padd_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_PGET:
+            rc = sky_server_process_pget_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_PALL:
+            rc = sky_server_process_pall_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_COMPACT:
+            rc = sky_server_process_compact_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_SNAPSHOT:
+            rc = sky_server_process_snapshot_message(server, table, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_STATS:
+            rc = sky_server_process_stats_message(server, input, output);
+            break;
+        case SKY_MESSAGE_TYPE_REPLICATE:
+            rc = sky_server_process_replicate_message(server, table, input, output);
+            break;
+        default:
+            sentinel("Invalid message type: %s", bdata(header->name));
+    }
+    check(rc == 0, "Unable to process message: %s", bdata(header->name));
+    
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Event Messages
+//--------------------------------------
+
+// Parses and process an Event Add (EADD) message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_eadd_message(sky_server *server, sky_table *table,
+                                    FILE *input, sky_buffer *output)
+{
+    int rc;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+    
+    debug("Message received: [EADD]");
     
     // Parse message.
-    sky_next_action_message *message = sky_next_action_message_create(); check_mem(message);
-    rc = sky_next_action_message_unpack(message, input);
-    check(rc == 0, "Unable to parse 'Next Action' message");
+    sky_eadd_message *message = sky_eadd_message_create(); check_mem(message);
+    rc = sky_eadd_message_unpack(message, input);
+    check(rc == 0, "Unable to parse EADD message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
     
     // Process message.
-    rc = sky_next_action_message_process(message, table, output);
-    check(rc == 0, "Unable to process 'Next Action' message");
+    rc = sky_eadd_message_process(message, table, output);
+    check(rc == 0, "Unable to process EADD message");
+    
+    return 0;
+
+error:
+    return -1;
+}
+
+
+// Parses and process an Event Get (EGET) message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_eget_message(sky_server *server, sky_table *table,
+                                    FILE *input, sky_buffer *output)
+{
+    int rc;
+    sky_eget_message *message = NULL;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+    
+    debug("Message received: [EGET]");
     
+    // Parse message.
+    message = sky_eget_message_create(); check_mem(message);
+    rc = sky_eget_message_unpack(message, input);
+    check(rc == 0, "Unable to parse EGET message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+    
+    // Process message.
+    rc = sky_eget_message_process(message, table, output);
+    check(rc == 0, "Unable to process EGET message");
+    
+    sky_eget_message_free(message);
+    return 0;
+
+error:
+    sky_eget_message_free(message);
+    return -1;
+}
+
+// Parses and process an Event Multi Get (EMGET) message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_emget_message(sky_server *server, sky_table *table,
+                                     FILE *input, sky_buffer *output)
+{
+    int rc;
+    sky_emget_message *message = NULL;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+
+    debug("Message received: [EMGET]");
+
+    // Parse message.
+    message = sky_emget_message_create(); check_mem(message);
+    rc = sky_emget_message_unpack(message, input);
+    check(rc == 0, "Unable to parse EMGET message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+
+    // Process message.
+    rc = sky_emget_message_process(message, table, output);
+    check(rc == 0, "Unable to process EMGET message");
+
+    sky_emget_message_free(message);
+    return 0;
+
+error:
+    sky_emget_message_free(message);
+    return -1;
+}
+
+// Parses and process a Subscribe message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_subscribe_message(sky_server *server, sky_table *table,
+                                         FILE *input, sky_buffer *output)
+{
+    int rc;
+    sky_subscribe_message *message = NULL;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+
+    debug("Message received: [SUBSCRIBE]");
+
+    // Parse message.
+    message = sky_subscribe_message_create(); check_mem(message);
+    rc = sky_subscribe_message_unpack(message, input);
+    check(rc == 0, "Unable to parse Subscribe message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+
+    // Process message.
+    rc = sky_subscribe_message_process(message, table, output);
+    check(rc == 0, "Unable to process Subscribe message");
+
+    sky_subscribe_message_free(message);
+    return 0;
+
+error:
+    sky_subscribe_message_free(message);
+    return -1;
+}
+
+// Parses and process a Tail message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_tail_message(sky_server *server, sky_table *table,
+                                    FILE *input, sky_buffer *output)
+{
+    int rc;
+    sky_tail_message *message = NULL;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+
+    debug("Message received: [TAIL]");
+
+    // Parse message.
+    message = sky_tail_message_create(); check_mem(message);
+    rc = sky_tail_message_unpack(message, input);
+    check(rc == 0, "Unable to parse Tail message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+
+    // Process message.
+    rc = sky_tail_message_process(message, table, output);
+    check(rc == 0, "Unable to process Tail message");
+
+    sky_tail_message_free(message);
+    return 0;
+
+error:
+    sky_tail_message_free(message);
+    return -1;
+}
+
+// Parses and process an Event Bulk (EBULK) message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_ebulk_message(sky_server *server, sky_table *table,
+                                     FILE *input, sky_buffer *output)
+{
+    int rc;
+    sky_ebulk_message *message = NULL;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+    
+    debug("Message received: [EBULK]");
+    
+    // Parse message.
+    message = sky_ebulk_message_create(); check_mem(message);
+    rc = sky_ebulk_message_unpack(message, input);
+    check(rc == 0, "Unable to parse EBULK message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+    
+    // Process message.
+    rc = sky_ebulk_message_process(message, table, output);
+    check(rc == 0, "Unable to process EBULK message");
+    
+    sky_ebulk_message_free(message);
+    return 0;
+
+error:
+    sky_ebulk_message_free(message);
+    return -1;
+}
+
+
+//--------------------------------------
+// Query Messages
+//--------------------------------------
+
+// Parses and process a 'Next Action' message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// arena  - The arena for temporary memory.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_next_action_message(sky_server *server, sky_table *table,
+                                           sky_arena *arena, FILE *input,
+                                           sky_buffer *output)
+{
+    int rc;
+    bool hit = false;
+    bstring key = NULL;
+    sky_buffer *body = NULL;
+    FILE *body_input = NULL;
+    sky_next_action_message *message = NULL;
+    sky_server_query running_query = {0, false};
+    bool running = false;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+    
+    debug("Message received: [Next Action]");
+    
+    // Parse message. The body is kept so that it can key the result cache.
+    rc = sky_server_read_message_body(input, &body, &body_input);
+    check(rc == 0, "Unable to read 'Next Action' message");
+    message = sky_next_action_message_create(); check_mem(message);
+    message->arena = arena;
+    rc = sky_next_action_message_unpack(message, body_input);
+    check(rc == 0, "Unable to parse 'Next Action' message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+    
+    // Answer from the result cache if the table has not changed. Profiled
+    // messages are always executed and continuous messages are already
+    // answered without a scan.
+    size_t start = output->length;
+    if(!message->profile && !message->continuous) {
+        rc = sky_server_get_cached_response(table, "next_action", body, output, &key, &hit);
+        check(rc == 0, "Unable to read result cache");
+    }
+
+    // Process message. Queries with an id can be cancelled while they run.
+    if(!hit) {
+        if(message->query_id > 0) {
+            running_query.id = message->query_id;
+            rc = sky_server_add_query(server, &running_query);
+            check(rc == 0, "Unable to register query");
+            running = true;
+            message->cancelled = &running_query.cancelled;
+        }
+        rc = sky_next_action_message_process(message, table, output);
+        check(rc == 0, "Unable to process 'Next Action' message");
+        if(!message->stopped) {
+            rc = sky_server_put_cached_response(table, key, output, start);
+            check(rc == 0, "Unable to write result cache");
+        }
+    }
+    
+    if(running) sky_server_remove_query(server, &running_query);
+    bdestroy(key);
+    fclose(body_input);
+    sky_buffer_free(body);
+    sky_next_action_message_free(message);
+    return 0;
+
+error:
+    if(running) sky_server_remove_query(server, &running_query);
+    bdestroy(key);
+    if(body_input) fclose(body_input);
+    sky_buffer_free(body);
+    sky_next_action_message_free(message);
+    return -1;
+}
+
+// Parses and process a generic 'Query' message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// arena  - The arena for temporary memory.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_query_message(sky_server *server, sky_table *table,
+                                     sky_arena *arena, FILE *input,
+                                     sky_buffer *output)
+{
+    int rc;
+    bool hit = false;
+    bstring key = NULL;
+    sky_buffer *body = NULL;
+    FILE *body_input = NULL;
+    sky_query_message *message = NULL;
+    sky_server_query running_query = {0, false};
+    bool running = false;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+    
+    debug("Message received: [Query]");
+    
+    // Parse message. The body is kept so that it can key the result cache.
+    rc = sky_server_read_message_body(input, &body, &body_input);
+    check(rc == 0, "Unable to read 'Query' message");
+    message = sky_query_message_create(); check_mem(message);
+    message->arena = arena;
+    rc = sky_query_message_unpack(message, body_input);
+    check(rc == 0, "Unable to parse 'Query' message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+    
+    // Answer from the result cache if the table has not changed. Profiled
+    // messages are always executed and streamed responses are sent before
+    // they could be cached.
+    size_t start = output->length;
+    if(!message->profile && !message->stream) {
+        rc = sky_server_get_cached_response(table, "query", body, output, &key, &hit);
+        check(rc == 0, "Unable to read result cache");
+    }
+
+    // Process message. Queries with an id can be cancelled while they run.
+    if(!hit) {
+        if(message->query_id > 0) {
+            running_query.id = message->query_id;
+            rc = sky_server_add_query(server, &running_query);
+            check(rc == 0, "Unable to register query");
+            running = true;
+            message->cancelled = &running_query.cancelled;
+        }
+        rc = sky_query_message_process(message, table, output);
+        check(rc == 0, "Unable to process 'Query' message");
+        if(!message->stopped) {
+            rc = sky_server_put_cached_response(table, key, output, start);
+            check(rc == 0, "Unable to write result cache");
+        }
+    }
+    
+    if(running) sky_server_remove_query(server, &running_query);
+    bdestroy(key);
+    fclose(body_input);
+    sky_buffer_free(body);
+    sky_query_message_free(message);
+    return 0;
+
+error:
+    if(running) sky_server_remove_query(server, &running_query);
+    bdestroy(key);
+    if(body_input) fclose(body_input);
+    sky_buffer_free(body);
+    sky_query_message_free(message);
+    return -1;
+}
+
+
+// Parses and process a 'Funnel' message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// arena  - The arena for temporary memory.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_funnel_message(sky_server *server, sky_table *table,
+                                      sky_arena *arena, FILE *input,
+                                      sky_buffer *output)
+{
+    int rc;
+    bool hit = false;
+    bstring key = NULL;
+    sky_buffer *body = NULL;
+    FILE *body_input = NULL;
+    sky_funnel_message *message = NULL;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+
+    debug("Message received: [Funnel]");
+
+    // Parse message. The body is kept so that it can key the result cache.
+    rc = sky_server_read_message_body(input, &body, &body_input);
+    check(rc == 0, "Unable to read 'Funnel' message");
+    message = sky_funnel_message_create(); check_mem(message);
+    message->arena = arena;
+    rc = sky_funnel_message_unpack(message, body_input);
+    check(rc == 0, "Unable to parse 'Funnel' message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+
+    // Answer from the result cache if the table has not changed. Profiled
+    // messages are always executed.
+    size_t start = output->length;
+    if(!message->profile) {
+        rc = sky_server_get_cached_response(table, "funnel", body, output, &key, &hit);
+        check(rc == 0, "Unable to read result cache");
+    }
+
+    // Process message.
+    if(!hit) {
+        rc = sky_funnel_message_process(message, table, output);
+        check(rc == 0, "Unable to process 'Funnel' message");
+        rc = sky_server_put_cached_response(table, key, output, start);
+        check(rc == 0, "Unable to write result cache");
+    }
+
+    bdestroy(key);
+    fclose(body_input);
+    sky_buffer_free(body);
+    sky_funnel_message_free(message);
+    return 0;
+
+error:
+    bdestroy(key);
+    if(body_input) fclose(body_input);
+    sky_buffer_free(body);
+    sky_funnel_message_free(message);
+    return -1;
+}
+
+// Parses and process a 'DAG' message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// arena  - The arena for temporary memory.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_dag_message(sky_server *server, sky_table *table,
+                                   sky_arena *arena, FILE *input,
+                                   sky_buffer *output)
+{
+    int rc;
+    bool hit = false;
+    bstring key = NULL;
+    sky_buffer *body = NULL;
+    FILE *body_input = NULL;
+    sky_dag_message *message = NULL;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+
+    debug("Message received: [DAG]");
+
+    // Parse message. The body is kept so that it can key the result cache.
+    rc = sky_server_read_message_body(input, &body, &body_input);
+    check(rc == 0, "Unable to read 'DAG' message");
+    message = sky_dag_message_create(); check_mem(message);
+    message->arena = arena;
+    rc = sky_dag_message_unpack(message, body_input);
+    check(rc == 0, "Unable to parse 'DAG' message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+
+    // Answer from the result cache if the table has not changed. Profiled
+    // messages are always executed.
+    size_t start = output->length;
+    if(!message->profile) {
+        rc = sky_server_get_cached_response(table, "dag", body, output, &key, &hit);
+        check(rc == 0, "Unable to read result cache");
+    }
+
+    // Process message.
+    if(!hit) {
+        rc = sky_dag_message_process(message, table, output);
+        check(rc == 0, "Unable to process 'DAG' message");
+        rc = sky_server_put_cached_response(table, key, output, start);
+        check(rc == 0, "Unable to write result cache");
+    }
+
+    bdestroy(key);
+    fclose(body_input);
+    sky_buffer_free(body);
+    sky_dag_message_free(message);
+    return 0;
+
+error:
+    bdestroy(key);
+    if(body_input) fclose(body_input);
+    sky_buffer_free(body);
+    sky_dag_message_free(message);
+    return -1;
+}
+
+
+//--------------------------------------
+// Result Cache
+//--------------------------------------
+
+// Reads the body of a message into memory and opens a stream over it so
+// that the body can be parsed and its bytes can still be used afterward.
+//
+// input      - The input file stream.
+// body       - A pointer to where the body should be returned.
+// body_input - A pointer to where the stream over the body should be
+//              returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_read_message_body(FILE *input, sky_buffer **body,
+                                 FILE **body_input)
+{
+    int rc;
+    *body_input = NULL;
+    *body = sky_buffer_create(); check_mem(*body);
+    rc = sky_minipack_fread_elem(input, *body);
+    check(rc == 0, "Unable to read message body");
+    *body_input = fmemopen((*body)->data, (*body)->length, "r");
+    check(*body_input != NULL, "Unable to open message body");
+    return 0;
+
+error:
+    sky_buffer_free(*body);
+    *body = NULL;
+    return -1;
+}
+
+// Writes the cached response to a message if the table has not changed
+// since it was cached. The table's memtable is merged first so that the
+// version of the data file reflects every added event.
+//
+// table  - The table the message is applied to.
+// type   - The name of the message type.
+// body   - The body of the message.
+// output - The output buffer.
+// key    - A pointer to where the cache key should be returned. This is
+//          null if the table does not cache results.
+// hit    - A pointer to where the flag should be returned that states if
+//          the response was written from the cache.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_get_cached_response(sky_table *table, const char *type,
+                                   sky_buffer *body, sky_buffer *output,
+                                   bstring *key, bool *hit)
+{
+    int rc;
+    void *data = NULL;
+    size_t length = 0;
+    *key = NULL;
+    *hit = false;
+    if(table->result_cache == NULL || sky_table_get_data_file_count(table) == 0) {
+        return 0;
+    }
+
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge table memtable");
+
+    *key = bfromcstr(type); check_mem(*key);
+    rc = bconchar(*key, ':');
+    check(rc == BSTR_OK, "Unable to build cache key");
+    rc = bcatblk(*key, body->data, (int)body->length);
+    check(rc == BSTR_OK, "Unable to build cache key");
+
+    rc = sky_result_cache_get(table->result_cache, *key, sky_table_get_write_version(table), &data, &length);
+    check(rc == 0, "Unable to look up cached response");
+    if(data != NULL) {
+        rc = sky_buffer_write(output, data, length);
+        check(rc == 0, "Unable to write cached response");
+        sky_stats_add(result_cache_hits, 1);
+        *hit = true;
+    }
+    else {
+        sky_stats_add(result_cache_misses, 1);
+    }
+
+    return 0;
+
+error:
+    bdestroy(*key);
+    *key = NULL;
+    return -1;
+}
+
+// Caches the response to a message against the current version of the
+// table.
+//
+// table  - The table the message was applied to.
+// key    - The cache key of the message. Nothing is cached if this is null.
+// output - The output buffer.
+// start  - The position in the output buffer where the response starts.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_put_cached_response(sky_table *table, bstring key,
+                                   sky_buffer *output, size_t start)
+{
+    int rc;
+    if(key == NULL || table->result_cache == NULL || sky_table_get_data_file_count(table) == 0) {
+        return 0;
+    }
+
+    rc = sky_result_cache_put(table->result_cache, key, sky_table_get_write_version(table), output->data + start, output->length - start);
+    check(rc == 0, "Unable to cache response");
     return 0;
 
 error:
@@ -442,17 +2230,17 @@ error:
 // server - The server.
 // table  - The table to apply the message to.
 // input  - The input file stream.
-// output - The output file stream.
+// output - The output buffer.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_server_process_aadd_message(sky_server *server, sky_table *table,
-                                    FILE *input, FILE *output)
+                                    FILE *input, sky_buffer *output)
 {
     int rc;
     check(server != NULL, "Server required");
     check(table != NULL, "Table required");
     check(input != NULL, "Input required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
     
     debug("Message received: [AADD]");
 
@@ -460,6 +2248,7 @@ int sky_server_process_aadd_message(sky_server *server, sky_table *table,
     sky_aadd_message *message = sky_aadd_message_create(); check_mem(message);
     rc = sky_aadd_message_unpack(message, input);
     check(rc == 0, "Unable to parse AADD message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
     
     // Process message.
     rc = sky_aadd_message_process(message, table, output);
@@ -476,17 +2265,17 @@ error:
 // server - The server.
 // table  - The table to apply the message to.
 // input  - The input file stream.
-// output - The output file stream.
+// output - The output buffer.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_server_process_aget_message(sky_server *server, sky_table *table,
-                                    FILE *input, FILE *output)
+                                    FILE *input, sky_buffer *output)
 {
     int rc;
     check(server != NULL, "Server required");
     check(table != NULL, "Table required");
     check(input != NULL, "Input required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
     
     debug("Message received: [AGET]");
 
@@ -494,6 +2283,7 @@ int sky_server_process_aget_message(sky_server *server, sky_table *table,
     sky_aget_message *message = sky_aget_message_create(); check_mem(message);
     rc = sky_aget_message_unpack(message, input);
     check(rc == 0, "Unable to parse AGET message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
     
     // Process message.
     rc = sky_aget_message_process(message, table, output);
@@ -510,17 +2300,17 @@ error:
 // server - The server.
 // table  - The table to apply the message to.
 // input  - The input file stream.
-// output - The output file stream.
+// output - The output buffer.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_server_process_aall_message(sky_server *server, sky_table *table,
-                                    FILE *input, FILE *output)
+                                    FILE *input, sky_buffer *output)
 {
     int rc;
     check(server != NULL, "Server required");
     check(table != NULL, "Table required");
     check(input != NULL, "Input required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
     
     debug("Message received: [AALL]");
 
@@ -528,6 +2318,7 @@ int sky_server_process_aall_message(sky_server *server, sky_table *table,
     sky_aall_message *message = sky_aall_message_create(); check_mem(message);
     rc = sky_aall_message_unpack(message, input);
     check(rc == 0, "Unable to parse AALL message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
     
     // Process message.
     rc = sky_aall_message_process(message, table, output);
@@ -549,17 +2340,17 @@ error:
 // server - The server.
 // table  - The table to apply the message to.
 // input  - The input file stream.
-// output - The output file stream.
+// output - The output buffer.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_server_process_padd_message(sky_server *server, sky_table *table,
-                                    FILE *input, FILE *output)
+                                    FILE *input, sky_buffer *output)
 {
     int rc;
     check(server != NULL, "Server required");
     check(table != NULL, "Table required");
     check(input != NULL, "Input required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
     
     debug("Message received: [PADD]");
 
@@ -567,6 +2358,7 @@ int sky_server_process_padd_message(sky_server *server, sky_table *table,
     sky_padd_message *message = sky_padd_message_create(); check_mem(message);
     rc = sky_padd_message_unpack(message, input);
     check(rc == 0, "Unable to parse PADD message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
     
     // Process message.
     rc = sky_padd_message_process(message, table, output);
@@ -583,17 +2375,17 @@ error:
 // server - The server.
 // table  - The table to apply the message to.
 // input  - The input file stream.
-// output - The output file stream.
+// output - The output buffer.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_server_process_pget_message(sky_server *server, sky_table *table,
-                                    FILE *input, FILE *output)
+                                    FILE *input, sky_buffer *output)
 {
     int rc;
     check(server != NULL, "Server required");
     check(table != NULL, "Table required");
     check(input != NULL, "Input required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
     
     debug("Message received: [PGET]");
 
@@ -601,6 +2393,7 @@ int sky_server_process_pget_message(sky_server *server, sky_table *table,
     sky_pget_message *message = sky_pget_message_create(); check_mem(message);
     rc = sky_pget_message_unpack(message, input);
     check(rc == 0, "Unable to parse PGET message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
     
     // Process message.
     rc = sky_pget_message_process(message, table, output);
@@ -617,17 +2410,17 @@ error:
 // server - The server.
 // table  - The table to apply the message to.
 // input  - The input file stream.
-// output - The output file stream.
+// output - The output buffer.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_server_process_pall_message(sky_server *server, sky_table *table,
-                                    FILE *input, FILE *output)
+                                    FILE *input, sky_buffer *output)
 {
     int rc;
     check(server != NULL, "Server required");
     check(table != NULL, "Table required");
     check(input != NULL, "Input required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
     
     debug("Message received: [PALL]");
 
@@ -635,6 +2428,7 @@ int sky_server_process_pall_message(sky_server *server, sky_table *table,
     sky_pall_message *message = sky_pall_message_create(); check_mem(message);
     rc = sky_pall_message_unpack(message, input);
     check(rc == 0, "Unable to parse PALL message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
     
     // Process message.
     rc = sky_pall_message_process(message, table, output);
@@ -648,50 +2442,661 @@ error:
 
 
 //--------------------------------------
-// Multi Message
+// Table Messages
+//--------------------------------------
+
+// Parses and process a Compact message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_compact_message(sky_server *server, sky_table *table,
+                                       FILE *input, sky_buffer *output)
+{
+    int rc;
+    sky_compact_message *message = NULL;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+    
+    debug("Message received: [COMPACT]");
+    
+    // Parse message.
+    message = sky_compact_message_create(); check_mem(message);
+    rc = sky_compact_message_unpack(message, input);
+    check(rc == 0, "Unable to parse COMPACT message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+    
+    // Process message.
+    rc = sky_compact_message_process(message, table, output);
+    check(rc == 0, "Unable to process COMPACT message");
+    
+    sky_compact_message_free(message);
+    return 0;
+
+error:
+    sky_compact_message_free(message);
+    return -1;
+}
+
+// Parses and process a Snapshot message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_snapshot_message(sky_server *server, sky_table *table,
+                                        FILE *input, sky_buffer *output)
+{
+    int rc;
+    sky_snapshot_message *message = NULL;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+
+    debug("Message received: [SNAPSHOT]");
+
+    // Parse message.
+    message = sky_snapshot_message_create(); check_mem(message);
+    rc = sky_snapshot_message_unpack(message, input);
+    check(rc == 0, "Unable to parse SNAPSHOT message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+
+    // Process message.
+    rc = sky_snapshot_message_process(message, table, output);
+    check(rc == 0, "Unable to process SNAPSHOT message");
+
+    sky_snapshot_message_free(message);
+    return 0;
+
+error:
+    sky_snapshot_message_free(message);
+    return -1;
+}
+
+
+//--------------------------------------
+// Replication Messages
+//--------------------------------------
+
+// Parses and process a Replicate message.
+//
+// server - The server.
+// table  - The table to apply the message to.
+// input  - The input file stream.
+// output - The output buffer.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_replicate_message(sky_server *server, sky_table *table,
+                                         FILE *input, sky_buffer *output)
+{
+    int rc;
+    sky_replicate_message *message = NULL;
+    check(server != NULL, "Server required");
+    check(table != NULL, "Table required");
+    check(input != NULL, "Input required");
+    check(output != NULL, "Output buffer required");
+    
+    debug("Message received: [REPLICATE]");
+    
+    // Parse message.
+    message = sky_replicate_message_create(); check_mem(message);
+    rc = sky_replicate_message_unpack(message, input);
+    check(rc == 0, "Unable to parse REPLICATE message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+    
+    // Process message.
+    rc = sky_replicate_message_process(message, table, output);
+    check(rc == 0, "Unable to process REPLICATE message");
+    
+    sky_replicate_message_free(message);
+    return 0;
+
+error:
+    sky_replicate_message_free(message);
+    return -1;
+}
+
+
+//--------------------------------------
+// Stats Messages
 //--------------------------------------
 
-// Parses and process a multi message.
+// Parses and processes a Stats message. The stats are copied from the global
+// counters and the number of tables open on each worker is added to them.
+// The table counts of other workers are read without locking them.
 //
 // server - The server.
 // input  - The input file stream.
-// output - The output file stream.
+// output - The output buffer.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_server_process_multi_message(sky_server *server, FILE *input,
-                                     FILE *output)
+int sky_server_process_stats_message(sky_server *server, FILE *input,
+                                     sky_buffer *output)
 {
     int rc;
+    uint32_t i, j;
+    sky_stats stats;
+    sky_stats_message *message = NULL;
+    sky_table_memory *tables = NULL;
+    uint32_t table_count = 0;
     check(server != NULL, "Server required");
     check(input != NULL, "Input required");
-    check(output != NULL, "Output stream required");
+    check(output != NULL, "Output buffer required");
+
+    debug("Message received: [Stats]");
+
+    // Parse message.
+    message = sky_stats_message_create(); check_mem(message);
+    rc = sky_stats_message_unpack(message, input);
+    check(rc == 0, "Unable to unpack stats message");
+    sky_trace_mark_current(SKY_TRACE_SPAN_BODY);
+
+    // Collect stats.
+    sky_stats_snapshot(&stats);
+    stats.open_table_count = 0;
+    for(i=0; i<server->worker_count; i++) {
+        stats.open_table_count += server->workers[i]->table_cache->table_count;
+    }
+
+    // Copy the latest memory measurements of each worker. The names are
+    // borrowed from the workers while their mutexes are held.
+    uint32_t table_capacity = 0;
+    for(i=0; i<server->worker_count; i++) {
+        sky_worker *worker = server->workers[i];
+        pthread_mutex_lock(&worker->mutex);
+        if(table_count + worker->table_memory_count > table_capacity) {
+            table_capacity = table_count + worker->table_memory_count;
+            sky_table_memory *ptr = realloc(tables, sizeof(*tables) * table_capacity);
+            if(ptr == NULL) {
+                pthread_mutex_unlock(&worker->mutex);
+            }
+            check_mem(ptr);
+            tables = ptr;
+        }
+        for(j=0; j<worker->table_memory_count; j++) {
+            tables[table_count] = worker->table_memory[j];
+            tables[table_count].name = bstrcpy(worker->table_memory[j].name);
+            table_count++;
+        }
+        pthread_mutex_unlock(&worker->mutex);
+    }
+
+    // Process message.
+    rc = sky_stats_message_process(message, &stats, tables, table_count, output);
+    check(rc == 0, "Unable to process stats message");
+
+    for(i=0; i<table_count; i++) {
+        sky_table_memory_free(&tables[i]);
+    }
+    free(tables);
+    sky_stats_message_free(message);
+    return 0;
+
+error:
+    for(i=0; i<table_count; i++) {
+        sky_table_memory_free(&tables[i]);
+    }
+    free(tables);
+    sky_stats_message_free(message);
+    return -1;
+}
+
+
+//--------------------------------------
+// Admission
+//--------------------------------------
+
+// Takes one of the server's scan slots so that a worker can start a scan.
+// Every scan may run at once if the server has no scan limit.
+//
+// server - The server.
+//
+// Returns true if a slot was taken.
+bool sky_server_acquire_scan(sky_server *server)
+{
+    if(server == NULL || server->max_concurrent_scans == 0) {
+        return true;
+    }
+
+    while(true) {
+        uint32_t count = __sync_add_and_fetch(&server->active_scan_count, 0);
+        if(count >= server->max_concurrent_scans) {
+            return false;
+        }
+        if(__sync_bool_compare_and_swap(&server->active_scan_count, count, count+1)) {
+            return true;
+        }
+    }
+}
+
+// Returns a scan slot once its scan has finished and wakes the workers so
+// that any scan waiting for a slot can take it.
+//
+// server - The server.
+void sky_server_release_scan(sky_server *server)
+{
+    uint32_t i;
+    if(server == NULL || server->max_concurrent_scans == 0) {
+        return;
+    }
+
+    __sync_sub_and_fetch(&server->active_scan_count, 1);
+    for(i=0; i<server->worker_count; i++) {
+        sky_worker *worker = server->workers[i];
+        pthread_mutex_lock(&worker->mutex);
+        pthread_cond_signal(&worker->cond);
+        pthread_mutex_unlock(&worker->mutex);
+    }
+}
+
+// Checks whether a write should be turned away because too many writes are
+// already waiting on the worker that owns its table.
+//
+// server - The server.
+// header - The message header.
+//
+// Returns true if the client should slow down.
+bool sky_server_should_slow_down(sky_server *server,
+                                 sky_message_header *header)
+{
+    if(!sky_worker_is_write(header->type) || server->max_queued_writes == 0) {
+        return false;
+    }
+    sky_worker *worker = sky_server_get_worker(server, header);
+    return (worker != NULL && !sky_worker_accepts_write(worker));
+}
+
+// Skips the body of a write that was turned away and sends the slow down
+// response from the event loop. Pipelined responses are prefixed with their
+// request id.
+//
+//   {status:"slow down"}
+//
+// server     - The server.
+// connection - The connection the message is being read from.
+// header     - The message header.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_slow_down(sky_server *server,
+                                 sky_connection *connection,
+                                 sky_message_header *header)
+{
+    int rc;
+    sky_buffer *body = NULL;
+    sky_buffer *output = NULL;
+    check(server != NULL, "Server required");
+    check(connection != NULL, "Connection required");
+    check(header != NULL, "Message header required");
+
+    debug("Message rejected: [%s]", bdata(header->name));
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring slow_down_str = bsStatic("slow down");
+
+    rc = sky_connection_read_body(connection, header, &body);
+    check(rc == 0, "Unable to skip message body");
+
+    output = sky_buffer_create(); check_mem(output);
+    if(header->pipelined) {
+        check(sky_buffer_pack_array(output, 2) == 0, "Unable to write response array");
+        check(sky_buffer_pack_uint(output, header->request_id) == 0, "Unable to write request id");
+    }
+    check(sky_buffer_pack_map(output, 1) == 0, "Unable to write status map");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &slow_down_str) == 0, "Unable to write status");
+    rc = sky_connection_write(connection, output, true);
+    check(rc == 0, "Unable to write slow down response");
+
+    sky_buffer_free(body);
+    sky_buffer_free(output);
+    return 0;
+
+error:
+    sky_buffer_free(body);
+    sky_buffer_free(output);
+    return -1;
+}
+
+
+//--------------------------------------
+// Running Queries
+//--------------------------------------
+
+// Registers a running query so that it can be cancelled by its id. The
+// query must be removed before it goes out of scope.
+//
+// server - The server.
+// query  - The running query.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_add_query(sky_server *server, sky_server_query *query)
+{
+    int rc = 0;
+    check(server != NULL, "Server required");
+    check(query != NULL, "Query required");
+
+    pthread_mutex_lock(&server->query_mutex);
+    sky_server_query **queries = realloc(server->queries, sizeof(*queries) * (server->query_count+1));
+    if(queries != NULL) {
+        server->queries = queries;
+        server->queries[server->query_count++] = query;
+    }
+    else {
+        rc = -1;
+    }
+    pthread_mutex_unlock(&server->query_mutex);
+    check(rc == 0, "Unable to register query");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Removes a running query once it has finished.
+//
+// server - The server.
+// query  - The running query.
+void sky_server_remove_query(sky_server *server, sky_server_query *query)
+{
+    uint32_t i;
+    pthread_mutex_lock(&server->query_mutex);
+    for(i=0; i<server->query_count; i++) {
+        if(server->queries[i] == query) {
+            server->queries[i] = server->queries[--server->query_count];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&server->query_mutex);
+}
+
+// Sets the cancel flag of every running query with an id.
+//
+// server - The server.
+// id     - The query id.
+//
+// Returns the number of queries that were cancelled.
+uint32_t sky_server_cancel_queries(sky_server *server, uint64_t id)
+{
+    uint32_t i, count = 0;
+    pthread_mutex_lock(&server->query_mutex);
+    for(i=0; i<server->query_count; i++) {
+        if(server->queries[i]->id == id) {
+            server->queries[i]->cancelled = true;
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&server->query_mutex);
+    return count;
+}
+
+
+//--------------------------------------
+// Cancel Messages
+//--------------------------------------
+
+// Reads and processes a Cancel message on the event loop and sends the
+// response right away. Pipelined responses are prefixed with their request
+// id.
+//
+// server     - The server.
+// connection - The connection the message is being read from.
+// header     - The message header.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_cancel_message(sky_server *server,
+                                      sky_connection *connection,
+                                      sky_message_header *header)
+{
+    int rc;
+    sky_buffer *body = NULL;
+    sky_buffer *output = NULL;
+    FILE *input = NULL;
+    sky_cancel_message *message = NULL;
+    check(server != NULL, "Server required");
+    check(connection != NULL, "Connection required");
+    check(header != NULL, "Message header required");
+
+    debug("Message received: [Cancel]");
+
+    // Parse message.
+    rc = sky_connection_read_body(connection, header, &body);
+    check(rc == 0, "Unable to read 'Cancel' message");
+    input = fmemopen(body->data, body->length, "r");
+    check(input != NULL, "Unable to open message body");
+    message = sky_cancel_message_create(); check_mem(message);
+    rc = sky_cancel_message_unpack(message, input);
+    check(rc == 0, "Unable to parse 'Cancel' message");
+
+    // Process message.
+    output = sky_buffer_create(); check_mem(output);
+    if(header->pipelined) {
+        check(sky_buffer_pack_array(output, 2) == 0, "Unable to write response array");
+        check(sky_buffer_pack_uint(output, header->request_id) == 0, "Unable to write request id");
+    }
+    rc = sky_cancel_message_process(message, server, output);
+    check(rc == 0, "Unable to process 'Cancel' message");
+    rc = sky_connection_write(connection, output, true);
+    check(rc == 0, "Unable to write 'Cancel' response");
+
+    fclose(input);
+    sky_buffer_free(body);
+    sky_buffer_free(output);
+    sky_cancel_message_free(message);
+    return 0;
+
+error:
+    if(input) fclose(input);
+    sky_buffer_free(body);
+    sky_buffer_free(output);
+    sky_cancel_message_free(message);
+    return -1;
+}
+
+
+//--------------------------------------
+// Multi Message
+//--------------------------------------
+
+// Parses a multi message and reads all of the child messages that follow
+// it. The children are then queued on the workers that own their tables so
+// that they are processed at the same time. Once the children are queued the
+// connection belongs to them until the last one completes.
+//
+// server     - The server.
+// connection - The connection the message is being read from.
+// queued     - Set to true if child messages were queued.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_server_process_multi_message(sky_server *server,
+                                     sky_connection *connection, bool *queued)
+{
+    int rc;
+    uint32_t i;
+    uint32_t count = 0;
+    sky_multi_message *message = NULL;
+    sky_message_header **headers = NULL;
+    sky_buffer **bodies = NULL;
+    sky_worker **workers = NULL;
+    *queued = false;
+    check(server != NULL, "Server required");
+    check(connection != NULL, "Connection required");
     
     debug("Message received: [MULTI]");
     
     // Parse message.
-    sky_multi_message *message = sky_multi_message_create(); check_mem(message);
-    rc = sky_multi_message_unpack(message, input);
+    message = sky_multi_message_create(); check_mem(message);
+    rc = sky_multi_message_unpack(message, connection->input);
     check(rc == 0, "Unable to parse MULTI message");
+    debug("MULTI: %d messages", message->message_count);
+
+    count = message->message_count;
+    if(count == 0) {
+        sky_multi_message_free(message);
+        return 0;
+    }
 
     // Start time.
     struct timeval tv;
     gettimeofday(&tv, NULL);
-    int64_t t0 = (tv.tv_sec*1000) + (tv.tv_usec/1000);
+    connection->multi_t0 = (tv.tv_sec*1000) + (tv.tv_usec/1000);
+
+    // Read every child message before any of them are processed.
+    headers = calloc(count, sizeof(*headers)); check_mem(headers);
+    bodies = calloc(count, sizeof(*bodies)); check_mem(bodies);
+    workers = calloc(count, sizeof(*workers)); check_mem(workers);
+    for(i=0; i<count; i++) {
+        headers[i] = sky_message_header_create(); check_mem(headers[i]);
+        rc = sky_message_header_unpack(headers[i], connection->input);
+        check(rc == 0, "Unable to unpack child message header");
+        check(headers[i]->type != SKY_MESSAGE_TYPE_MULTI, "Multi messages cannot be nested");
+        workers[i] = sky_server_get_worker(server, headers[i]);
+        check(workers[i] != NULL, "Unable to find worker");
+        rc = sky_connection_read_body(connection, headers[i], &bodies[i]);
+        check(rc == 0, "Unable to read child message body");
+    }
 
-    // Process message.
-    uint32_t i;
-    for(i=0; i<message->message_count; i++) {
-        rc = sky_server_process_message(server, input, output);
-        check(rc == 0, "Unable to process child message");
+    // Prepare the slots for the responses.
+    connection->multi_responses = calloc(count, sizeof(*connection->multi_responses));
+    check_mem(connection->multi_responses);
+    connection->multi_count = count;
+    connection->multi_completed = 0;
+    connection->multi_next = 0;
+    connection->multi_failed = false;
+
+    // Queue child messages. A child that cannot be queued fails the multi
+    // message once the others complete.
+    *queued = true;
+    for(i=0; i<count; i++) {
+        rc = sky_worker_enqueue(workers[i], connection, headers[i], bodies[i], NULL, SKY_WORKER_REPLY_MULTI, i);
+        if(rc != 0) {
+            sky_message_header_free(headers[i]);
+            sky_buffer_free(bodies[i]);
+            sky_server_complete_multi_child(server, connection, i, NULL);
+        }
     }
 
-    // End time.
-    gettimeofday(&tv, NULL);
-    int64_t t1 = (tv.tv_sec*1000) + (tv.tv_usec/1000);
-    printf("MULTI: %d messages processed in %.3f seconds\n", message->message_count, ((float)(t1-t0))/1000);
-    
+    free(headers);
+    free(bodies);
+    free(workers);
+    sky_multi_message_free(message);
     return 0;
 
 error:
+    for(i=0; i<count; i++) {
+        if(headers) sky_message_header_free(headers[i]);
+        if(bodies) sky_buffer_free(bodies[i]);
+    }
+    free(headers);
+    free(bodies);
+    free(workers);
+    sky_multi_message_free(message);
     return -1;
 }
+
+// Records the response of a child message of a multi message. Responses are
+// written to the connection in the order of the child messages, so a
+// response is kept until the children before it have completed. Once every
+// child has completed the connection is handed back to the server to
+// dispatch its next message. If any child failed then the connection is
+// closed instead.
+//
+// server     - The server.
+// connection - The connection.
+// index      - The position of the child message.
+// response   - The response of the child or NULL if the child failed.
+void sky_server_complete_multi_child(sky_server *server,
+                                     sky_connection *connection,
+                                     uint32_t index, sky_buffer *response)
+{
+    int rc = 0;
+    pthread_mutex_lock(&connection->mutex);
+
+    // Keep a copy of the response until it can be written.
+    if(response == NULL) {
+        connection->multi_failed = true;
+    }
+    else if(!connection->multi_failed) {
+        if(index == connection->multi_next) {
+            rc = sky_buffer_write(connection->output, response->data, response->length);
+            connection->multi_next++;
+        }
+        else {
+            sky_buffer *copy = sky_buffer_create();
+            rc = (copy != NULL ? sky_buffer_write(copy, response->data, response->length) : -1);
+            connection->multi_responses[index] = copy;
+        }
+        if(rc != 0) connection->multi_failed = true;
+    }
+
+    // Write the responses that are now in order.
+    while(!connection->multi_failed && connection->multi_next < connection->multi_count && connection->multi_responses[connection->multi_next] != NULL) {
+        sky_buffer *next = connection->multi_responses[connection->multi_next];
+        if(sky_buffer_write(connection->output, next->data, next->length) != 0) {
+            connection->multi_failed = true;
+        }
+        sky_buffer_free(next);
+        connection->multi_responses[connection->multi_next++] = NULL;
+    }
+
+    bool failed = connection->multi_failed;
+    pthread_mutex_unlock(&connection->mutex);
+
+    // Send responses as they build up so a large multi message does not
+    // collect all of its responses in memory. The child is only counted as
+    // completed afterward so that the connection stays open while it sends.
+    if(!failed && sky_connection_send(connection, SKY_CONNECTION_OUTPUT_FLUSH_SIZE) != 0) {
+        failed = true;
+    }
+
+    pthread_mutex_lock(&connection->mutex);
+    if(failed) connection->multi_failed = true;
+    bool done = (++connection->multi_completed == connection->multi_count);
+    pthread_mutex_unlock(&connection->mutex);
+
+    // Only the last child can continue with the connection.
+    if(done) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        int64_t t1 = (tv.tv_sec*1000) + (tv.tv_usec/1000);
+        printf("MULTI: messages processed in %.3f seconds\n", ((float)(t1-connection->multi_t0))/1000);
+        sky_stats_record(&sky_stats_global.messages[SKY_MESSAGE_TYPE_MULTI], (t1-connection->multi_t0) * 1000);
+        connection->multi_t0 = 0;
+
+        failed = connection->multi_failed;
+        sky_server_free_multi_responses(connection);
+        if(failed) {
+            sky_server_close_connection(server, connection);
+        }
+        else {
+            sky_server_dispatch(server, connection);
+        }
+    }
+}
+
+// Frees the response slots of a multi message on a connection.
+//
+// connection - The connection.
+void sky_server_free_multi_responses(sky_connection *connection)
+{
+    uint32_t i;
+    if(connection->multi_responses) {
+        for(i=0; i<connection->multi_count; i++) {
+            sky_buffer_free(connection->multi_responses[i]);
+        }
+        free(connection->multi_responses);
+    }
+    connection->multi_responses = NULL;
+    connection->multi_count = 0;
+    connection->multi_completed = 0;
+    connection->multi_next = 0;
+    connection->multi_failed = false;
+}
@@ -5,11 +5,23 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <netinet/in.h>
+#include <pthread.h>
+
+typedef struct sky_server sky_server;
+typedef struct sky_connection sky_connection;
 
 #include "bstring.h"
 #include "database.h"
 #include "table.h"
 #include "event.h"
+#include "message_header.h"
+#include "worker.h"
+#include "arena.h"
+#include "buffer.h"
+#include "minipack.h"
+#include "numa.h"
+#include "prefetcher.h"
+#include "trace.h"
 
 
 //==============================================================================
@@ -21,6 +33,98 @@
 // The server acts as the interface to external applications. It communicates
 // over TCP sockets using a specific Sky protocol. See the message.h file for
 // more detail on the protocol.
+//
+// If a socket path is set then the server also listens on a Unix domain
+// socket at that path. Clients on the same host can connect to it to skip
+// the TCP stack. The protocol is the same on both listeners.
+//
+// Connections are persistent. The server runs a single event loop (epoll on
+// Linux, kqueue elsewhere) that watches the listening socket and every open
+// connection. When a connection becomes readable, each message that is
+// waiting on it is processed in turn and the connection remains open until
+// the client closes it.
+//
+// Nothing ever blocks on a slow client. The sockets are only read without
+// waiting, into a buffer on each connection, and a message is not parsed
+// until all of it has arrived. A connection whose message is incomplete is
+// handed back to the event poller and parsing starts over at the beginning
+// of the message once more bytes arrive, so a single event loop thread can
+// serve any number of slow clients. The message handlers then read complete
+// messages from memory.
+//
+// Responses are written the same way. Whatever a socket does not take is
+// kept on the connection and the connection is watched for the socket to
+// become writable again, at which point the event loop sends the rest. A
+// connection stops reading messages while its responses are stuck so a
+// client that does not read its responses cannot make the server buffer
+// them without limit.
+//
+// The event loop only parses message headers. The rest of each message is
+// processed by the worker thread that owns the message's table. See worker.h
+// for more detail.
+//
+// Writes are answered by the event loop with a slow down status while too
+// many writes are already waiting on their worker, and the number of scans
+// that run at once across the workers can be limited. See worker.h for how
+// each worker orders its writes and scans.
+//
+// Pipelined messages are the exception. The event loop reads their bodies as
+// well and keeps reading the connection while the workers process them, so
+// a client can send many messages without waiting for each response. See
+// message_header.h for the format.
+//
+// The child messages of a multi message are also read ahead in full and
+// processed on their workers at the same time. The responses are collected
+// on the connection and written in the order of the child messages.
+//
+// Open tables are cached by their workers. The server's file descriptor and
+// mapped byte limits are divided evenly between the workers.
+//
+// On machines with several NUMA nodes, the workers can be spread over the
+// nodes in turn. Each worker then runs on its node's CPUs and its tables'
+// pages are allocated from its node's memory, so scans do not cross
+// sockets. The workers can also interleave their memory across the nodes
+// instead. See numa.h.
+//
+// When the tables do not fit in memory, scans can have their blocks read
+// ahead by a pool of I/O threads that is shared by every worker so that
+// several reads are in flight at once. See prefetcher.h.
+//
+// Messages can be traced to find where their time goes. One in every trace
+// sample rate messages is traced and written to the trace log, along with
+// every message that takes longer than the slow query threshold in
+// milliseconds. The log is standard error unless a trace log path is set.
+// See trace.h.
+//
+// The server's durability mode is applied to every table it opens. In group
+// commit mode, workers hold responses to writes until the changes have been
+// synced. In async mode, workers flush their tables in the background.
+//
+// If a memtable size is set then every table buffers up to that many events
+// in a write-ahead log before merging them into its data file. A reorder
+// window additionally holds back that many seconds of the latest events so
+// that late events are merged in order with them.
+//
+// If a block size is set then tables that do not exist yet are created with
+// blocks of that size. Existing tables keep the block size they were
+// created with. A local shard count likewise splits the objects of new
+// tables across that many data files on this server and a partition period
+// splits the events of new tables into one data file per period of that many
+// seconds. See table.h.
+//
+// If shard nodes are set then the server is a coordinator. It does not store
+// any tables itself. Instead each worker routes the table messages it
+// receives to the nodes, which are regular servers that each hold one shard
+// of every table. See coordinator.h for how messages are routed.
+//
+// Queries that are sent with an id are registered with the server while
+// they run so that a Cancel message can stop them. Cancel messages are
+// answered by the event loop as soon as they are read since the worker that
+// owns the table is busy with the query. See cancel_message.h.
+//
+// If a primary is set then the server is a read-only replica of that
+// server. Each worker syncs the tables it serves from the primary at most
+// once per replication interval. See replica.h.
 
 
 //==============================================================================
@@ -33,6 +137,70 @@
 
 #define SKY_LISTEN_BACKLOG 511
 
+// The maximum number of socket events returned by a single wait.
+#define SKY_SERVER_MAX_EVENTS 64
+
+// The kinds of socket events returned by a wait.
+#define SKY_SERVER_POLL_READ  1
+#define SKY_SERVER_POLL_WRITE 2
+
+// The number of workers used if the number of processors is unknown.
+#define SKY_DEFAULT_WORKER_COUNT 4
+
+// The number of file descriptors used for tables if the process limit is
+// unknown.
+#define SKY_DEFAULT_MAX_OPEN_FILES 256
+
+// The default number of milliseconds that group commit waits for more changes
+// before syncing.
+#define SKY_DEFAULT_GROUP_COMMIT_INTERVAL 10
+
+// The default number of events after which group commit syncs immediately.
+#define SKY_DEFAULT_GROUP_COMMIT_EVENTS 1000
+
+// The default number of milliseconds between background flushes of async
+// tables.
+#define SKY_DEFAULT_ASYNC_FLUSH_INTERVAL 200
+
+// The number of milliseconds between passes over a worker's tables to
+// compress idle blocks.
+#define SKY_DEFAULT_COMPRESS_INTERVAL 1000
+
+// The number of blocks of each table that are checked on each compression
+// pass.
+#define SKY_DEFAULT_COMPRESS_BLOCK_COUNT 256
+
+// The number of milliseconds between passes over a worker's tables to drop
+// expired blocks.
+#define SKY_DEFAULT_EXPIRE_INTERVAL 60000
+
+// The number of milliseconds between measurements of the memory used by a
+// worker's tables.
+#define SKY_DEFAULT_MEMORY_INTERVAL 10000
+
+// The default number of writes that can wait on a worker before new writes
+// for its tables are answered with a slow down status.
+#define SKY_DEFAULT_MAX_QUEUED_WRITES 10000
+
+// The number of response bytes that a connection collects from the child
+// messages of a multi message before sending them.
+#define SKY_CONNECTION_OUTPUT_FLUSH_SIZE 65536
+
+// Output buffers that grow larger than this are freed once they are sent so
+// that a single large response does not hold memory for the life of the
+// connection.
+#define SKY_CONNECTION_MAX_OUTPUT_CAPACITY 1048576
+
+// The largest body that is read ahead for a pipelined message.
+#define SKY_CONNECTION_MAX_PIPELINED_LENGTH 67108864
+
+// The largest message that a connection buffers while waiting for the rest
+// of it to arrive.
+#define SKY_CONNECTION_MAX_FRAME_LENGTH 134217728
+
+// The number of bytes that are read from a socket at once.
+#define SKY_CONNECTION_READ_SIZE 65536
+
 
 //==============================================================================
 //
@@ -47,15 +215,132 @@ typedef enum sky_server_state_e {
 } sky_server_state_e;
 
 
-typedef struct {
+// The part of a message that a connection is waiting to arrive.
+typedef enum sky_connection_frame_stage_e {
+    SKY_CONNECTION_FRAME_HEADER,
+    SKY_CONNECTION_FRAME_COUNT,
+    SKY_CONNECTION_FRAME_BODY,
+    SKY_CONNECTION_FRAME_PIPELINED_BODY,
+} sky_connection_frame_stage_e;
+
+// A query that is running on a worker. The cancel flag is set from the
+// event loop and read by the query's scan threads.
+typedef struct sky_server_query {
+    uint64_t id;
+    volatile bool cancelled;
+} sky_server_query;
+
+// A persistent client connection. The socket is read into a pending buffer
+// without blocking. Once the buffer holds a complete message the frame is
+// the length of that message and the input is a stream over it so that
+// messages can be parsed with the same stream based serialization as the
+// rest of the system. The frame is removed from the buffer before the next
+// message is read.
+//
+// The end of the frame is found incrementally as bytes arrive. The stage is
+// the part of the message that is being read and the decoder tracks the
+// elements of that part, so bytes are only ever scanned once. The frame
+// offset is the start of the current header or the end of a pipelined body
+// and the frame children are the messages left in a multi message. The end
+// of the input is set once the client has closed its side of the socket.
+//
+// Responses are collected in an output buffer that is reused across
+// messages. Sending swaps the output with the unsent buffer and writes it
+// without holding the mutex, so only one thread writes at a time and other
+// threads keep adding responses to the output meanwhile. The writing flag
+// is set while a thread owns the unsent buffer. If the socket is full then
+// the rest of the unsent buffer waits for the socket to become writable and
+// the event poller holds a reference to the connection until it does. The
+// reader stops and sets the read blocked flag if it finds the connection
+// waiting to write, and the write resumes the reader once every response
+// has been sent. The read and write armed flags show which events the
+// connection is registered with the poller for.
+//
+// The input is only ever read by one thread at a time: either the event loop
+// or the worker processing a message that is not pipelined. Workers that
+// process pipelined messages or the children of a multi message do not read
+// the input. They only write to the output and the multi responses, which
+// are guarded by the mutex along with the flags. The connection is freed once the reader and
+// every pipelined message have released it.
+struct sky_connection {
+    int socket;
+    sky_buffer *pending;
+    size_t frame_length;
+    sky_connection_frame_stage_e frame_stage;
+    sky_minipack_decoder decoder;
+    size_t frame_offset;
+    uint64_t frame_children;
+    bool frame_multi;
+    bool eof;
+    FILE *input;
+    sky_buffer *output;
+    sky_buffer *unsent;
+    bool writing;
+    bool read_blocked;
+    sky_server *server;
+    pthread_mutex_t mutex;
+    uint32_t ref_count;
+    bool closed;
+    bool registered;
+    bool read_armed;
+    bool write_armed;
+    sky_buffer **multi_responses;
+    uint32_t multi_count;
+    uint32_t multi_completed;
+    uint32_t multi_next;
+    bool multi_failed;
+    int64_t multi_t0;
+};
+
+struct sky_server {
     sky_server_state_e state;
     bstring path;
     int port;
     struct sockaddr_in* sockaddr;
     int socket;
-    sky_database *last_database;
-    sky_table *last_table;
-} sky_server;
+    bstring socket_path;
+    int unix_socket;
+    int poll_fd;
+    uint32_t connection_count;
+    sky_worker **workers;
+    uint32_t worker_count;
+    uint32_t max_open_files;
+    size_t max_mapped_bytes;
+    sky_durability_e durability;
+    uint32_t group_commit_interval;
+    uint32_t group_commit_events;
+    uint32_t async_flush_interval;
+    uint32_t memtable_size;
+    uint32_t reorder_window;
+    bool preload;
+    bool huge_pages;
+    uint32_t block_size;
+    bool action_only;
+    uint32_t local_shard_count;
+    uint32_t partition_period;
+    size_t block_cache_size;
+    size_t result_cache_size;
+    uint32_t compress_after;
+    uint32_t retention;
+    bstring *shards;
+    uint32_t shard_count;
+    bstring primary;
+    uint32_t replication_interval;
+    sky_server_query **queries;
+    uint32_t query_count;
+    pthread_mutex_t query_mutex;
+    uint32_t max_queued_writes;
+    uint32_t max_concurrent_scans;
+    uint32_t active_scan_count;
+    sky_numa_placement_e numa_placement;
+    sky_numa *numa;
+    uint32_t prefetch_thread_count;
+    sky_prefetcher *prefetcher;
+    uint32_t trace_sample_rate;
+    uint32_t slow_query_threshold;
+    bstring trace_log_path;
+    sky_tracer *tracer;
+};
 
 
 
@@ -74,6 +359,10 @@ sky_server *sky_server_create(bstring path);
 
 void sky_server_free(sky_server *server);
 
+int sky_server_add_shard(sky_server *server, bstring address);
+
+int sky_server_set_primary(sky_server *server, bstring address);
+
 
 //--------------------------------------
 // State
@@ -88,59 +377,173 @@ int sky_server_stop(sky_server *server);
 // Connection Management
 //--------------------------------------
 
-int sky_server_accept(sky_server *server);
+int sky_server_run(sky_server *server);
+
+int sky_server_accept(sky_server *server, int listener);
+
+int sky_server_dispatch(sky_server *server, sky_connection *connection);
+
+void sky_server_handle_events(sky_server *server, sky_connection *connection,
+    uint32_t events);
+
+int sky_server_close_connection(sky_server *server,
+    sky_connection *connection);
+
+void sky_server_release_connection(sky_server *server,
+    sky_connection *connection);
+
+int sky_connection_write(sky_connection *connection, sky_buffer *response,
+    bool send);
+
+void sky_connection_shutdown(sky_connection *connection);
+
+//--------------------------------------
+// Worker Management
+//--------------------------------------
+
+sky_worker *sky_server_get_worker(sky_server *server,
+    sky_message_header *header);
 
 //--------------------------------------
 // Message Processing
 //--------------------------------------
 
-int sky_server_process_message(sky_server *server, FILE *input, FILE *output);
+int sky_server_process_message(sky_server *server, sky_table *table,
+    sky_message_header *header, sky_arena *arena, FILE *input, sky_buffer *output);
+
+bool sky_server_message_has_body(sky_message_header *header);
 
 //--------------------------------------
 // Event Messages
 //--------------------------------------
 
 int sky_server_process_eadd_message(sky_server *server, sky_table *table,
-    FILE *input, FILE *output);
+    FILE *input, sky_buffer *output);
+
+int sky_server_process_ebulk_message(sky_server *server, sky_table *table,
+    FILE *input, sky_buffer *output);
+
+int sky_server_process_eget_message(sky_server *server, sky_table *table,
+    FILE *input, sky_buffer *output);
+
+int sky_server_process_emget_message(sky_server *server, sky_table *table,
+    FILE *input, sky_buffer *output);
+
+//--------------------------------------
+// Subscription Messages
+//--------------------------------------
+
+int sky_server_process_subscribe_message(sky_server *server,
+    sky_table *table, FILE *input, sky_buffer *output);
+
+int sky_server_process_tail_message(sky_server *server, sky_table *table,
+    FILE *input, sky_buffer *output);
+
+//--------------------------------------
+// Admission
+//--------------------------------------
+
+bool sky_server_acquire_scan(sky_server *server);
+
+void sky_server_release_scan(sky_server *server);
+
+bool sky_server_should_slow_down(sky_server *server,
+    sky_message_header *header);
+
+int sky_server_process_slow_down(sky_server *server,
+    sky_connection *connection, sky_message_header *header);
+
+//--------------------------------------
+// Running Queries
+//--------------------------------------
+
+int sky_server_add_query(sky_server *server, sky_server_query *query);
+
+void sky_server_remove_query(sky_server *server, sky_server_query *query);
+
+uint32_t sky_server_cancel_queries(sky_server *server, uint64_t id);
 
 //--------------------------------------
 // Query Messages
 //--------------------------------------
 
 int sky_server_process_next_action_message(sky_server *server, sky_table *table,
-    FILE *input, FILE *output);
+    sky_arena *arena, FILE *input, sky_buffer *output);
+
+int sky_server_process_query_message(sky_server *server, sky_table *table,
+    sky_arena *arena, FILE *input, sky_buffer *output);
+
+int sky_server_process_funnel_message(sky_server *server, sky_table *table,
+    sky_arena *arena, FILE *input, sky_buffer *output);
+
+int sky_server_process_dag_message(sky_server *server, sky_table *table,
+    sky_arena *arena, FILE *input, sky_buffer *output);
 
 //--------------------------------------
 // Action Messages
 //--------------------------------------
 
 int sky_server_process_aadd_message(sky_server *server, sky_table *table,
-    FILE *input, FILE *output);
+    FILE *input, sky_buffer *output);
 
 int sky_server_process_aget_message(sky_server *server, sky_table *table,
-    FILE *input, FILE *output);
+    FILE *input, sky_buffer *output);
 
 int sky_server_process_aall_message(sky_server *server, sky_table *table,
-    FILE *input, FILE *output);
+    FILE *input, sky_buffer *output);
 
 //--------------------------------------
 // Property Messages
 //--------------------------------------
 
 int sky_server_process_padd_message(sky_server *server, sky_table *table,
-    FILE *input, FILE *output);
+    FILE *input, sky_buffer *output);
 
 int sky_server_process_pget_message(sky_server *server, sky_table *table,
-    FILE *input, FILE *output);
+    FILE *input, sky_buffer *output);
 
 int sky_server_process_pall_message(sky_server *server, sky_table *table,
-    FILE *input, FILE *output);
+    FILE *input, sky_buffer *output);
+
+//--------------------------------------
+// Table Messages
+//--------------------------------------
+
+int sky_server_process_compact_message(sky_server *server, sky_table *table,
+    FILE *input, sky_buffer *output);
+
+int sky_server_process_snapshot_message(sky_server *server, sky_table *table,
+    FILE *input, sky_buffer *output);
+
+//--------------------------------------
+// Replication Messages
+//--------------------------------------
+
+int sky_server_process_replicate_message(sky_server *server, sky_table *table,
+    FILE *input, sky_buffer *output);
+
+//--------------------------------------
+// Cancel Messages
+//--------------------------------------
+
+int sky_server_process_cancel_message(sky_server *server,
+    sky_connection *connection, sky_message_header *header);
+
+//--------------------------------------
+// Stats Messages
+//--------------------------------------
+
+int sky_server_process_stats_message(sky_server *server, FILE *input,
+    sky_buffer *output);
 
 //--------------------------------------
 // Multi Message
 //--------------------------------------
 
-int sky_server_process_multi_message(sky_server *server, FILE *input,
-    FILE *output);
+int sky_server_process_multi_message(sky_server *server,
+    sky_connection *connection, bool *queued);
+
+void sky_server_complete_multi_child(sky_server *server,
+    sky_connection *connection, uint32_t index, sky_buffer *response);
 
 #endif
@@ -0,0 +1,423 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "shard_set.h"
+#include "block.h"
+#include "file.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+void *sky_shard_set_run_writer(void *arg);
+
+void sky_shard_set_write(sky_shard_writer *writer);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates an empty shard set.
+//
+// Returns a reference to the new shard set if successful. Otherwise returns
+// null.
+sky_shard_set *sky_shard_set_create()
+{
+    sky_shard_set *shard_set = calloc(1, sizeof(sky_shard_set));
+    check_mem(shard_set);
+    shard_set->block_size = SKY_DEFAULT_BLOCK_SIZE;
+    return shard_set;
+
+error:
+    sky_shard_set_free(shard_set);
+    return NULL;
+}
+
+// Removes a shard set from memory. Its shards are unloaded first.
+//
+// shard_set - The shard set to free.
+void sky_shard_set_free(sky_shard_set *shard_set)
+{
+    if(shard_set) {
+        sky_shard_set_unload(shard_set);
+        bdestroy(shard_set->path);
+        shard_set->path = NULL;
+        free(shard_set);
+    }
+}
+
+
+//--------------------------------------
+// Persistence
+//--------------------------------------
+
+// Loads the data file of every shard in the directory of the set. The
+// directories are created if they do not exist yet.
+//
+// shard_set   - The shard set.
+// shard_count - The number of shards.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_shard_set_load(sky_shard_set *shard_set, uint32_t shard_count)
+{
+    int rc;
+    uint32_t i;
+    bstring path = NULL;
+    check(shard_set != NULL, "Shard set required");
+    check(shard_set->path != NULL, "Shard set path required");
+    check(shard_count > 0, "Shard count required");
+
+    sky_shard_set_unload(shard_set);
+
+    if(!sky_file_exists(shard_set->path)) {
+        rc = mkdir(bdata(shard_set->path), S_IRWXU);
+        check(rc == 0, "Unable to create shard directory: %s", bdata(shard_set->path));
+    }
+
+    // The objects of an existing set are routed by its own shard count.
+    uint32_t existing_count = sky_shard_set_count_shard_dirs(shard_set);
+    check(existing_count == 0 || existing_count == shard_count, "Shard set has %d shards, not %d", existing_count, shard_count);
+
+    shard_set->shards = calloc(shard_count, sizeof(*shard_set->shards));
+    check_mem(shard_set->shards);
+    for(i=0; i<shard_count; i++) {
+        path = bformat("%s/%d", bdata(shard_set->path), i); check_mem(path);
+        if(!sky_file_exists(path)) {
+            rc = mkdir(bdata(path), S_IRWXU);
+            check(rc == 0, "Unable to create shard directory: %s", bdata(path));
+        }
+
+        sky_shard *shard = &shard_set->shards[shard_set->shard_count++];
+        shard->index = i;
+        shard->data_file = sky_data_file_create(); check_mem(shard->data_file);
+        shard->data_file->block_size = shard_set->block_size;
+        shard->data_file->durability = shard_set->durability;
+        shard->data_file->preload = shard_set->preload;
+        shard->data_file->huge_pages = shard_set->huge_pages;
+        shard->data_file->action_only = shard_set->action_only;
+        if(shard_set->block_cache_size > 0) {
+            shard->data_file->block_cache_size = shard_set->block_cache_size;
+        }
+        shard->data_file->prefetcher = shard_set->prefetcher;
+        shard->data_file->access_pattern = SKY_ACCESS_PATTERN_RANDOM;
+        shard->data_file->path = bformat("%s/data", bdata(path)); check_mem(shard->data_file->path);
+        shard->data_file->header_path = bformat("%s/header", bdata(path)); check_mem(shard->data_file->header_path);
+        rc = sky_data_file_load(shard->data_file);
+        check(rc == 0, "Unable to load shard data file: %s", bdata(path));
+
+        bdestroy(path);
+        path = NULL;
+    }
+
+    return 0;
+
+error:
+    bdestroy(path);
+    sky_shard_set_unload(shard_set);
+    return -1;
+}
+
+// Unloads every shard of the set. The files are left on disk.
+//
+// shard_set - The shard set.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_shard_set_unload(sky_shard_set *shard_set)
+{
+    uint32_t i;
+    check(shard_set != NULL, "Shard set required");
+
+    for(i=0; i<shard_set->shard_count; i++) {
+        sky_data_file_free(shard_set->shards[i].data_file);
+    }
+    free(shard_set->shards);
+    shard_set->shards = NULL;
+    shard_set->shard_count = 0;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Counts the shard directories that already exist in the set's directory.
+//
+// shard_set - The shard set.
+//
+// Returns the number of directories named after a shard index.
+uint32_t sky_shard_set_count_shard_dirs(sky_shard_set *shard_set)
+{
+    uint32_t count = 0;
+    DIR *dir = opendir(bdata(shard_set->path));
+    if(dir == NULL) {
+        return 0;
+    }
+
+    struct dirent *ent;
+    while((ent = readdir(dir))) {
+        char *end = NULL;
+        errno = 0;
+        strtoul(ent->d_name, &end, 10);
+        if(ent->d_name[0] != '\0' && *end == '\0' && errno == 0) {
+            count++;
+        }
+    }
+    closedir(dir);
+
+    return count;
+}
+
+
+//--------------------------------------
+// Routing
+//--------------------------------------
+
+// Determines the shard that owns an object.
+//
+// shard_set - The shard set.
+// object_id - The object id.
+//
+// Returns the index of the shard.
+uint32_t sky_shard_set_get_shard_index(sky_shard_set *shard_set,
+                                       sky_object_id_t object_id)
+{
+    uint64_t hash = (uint64_t)object_id * 0x9e3779b97f4a7c15ULL;
+    return (uint32_t)(((hash >> 32) * shard_set->shard_count) >> 32);
+}
+
+
+//--------------------------------------
+// Event Management
+//--------------------------------------
+
+// Adds an event to the shard of its object.
+//
+// shard_set - The shard set.
+// event     - The event to add.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_shard_set_add_event(sky_shard_set *shard_set, sky_event *event)
+{
+    int rc;
+    check(shard_set != NULL, "Shard set required");
+    check(shard_set->shard_count > 0, "Shard set not loaded");
+    check(event != NULL, "Event required");
+
+    sky_shard *shard = &shard_set->shards[sky_shard_set_get_shard_index(shard_set, event->object_id)];
+    rc = sky_data_file_add_event(shard->data_file, event);
+    check(rc == 0, "Unable to add event to shard %d", shard->index);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Adds a batch of events to their shards. The events of each shard are
+// written on their own thread inside a single batch of the shard's data
+// file. The events of one object keep their order.
+//
+// shard_set   - The shard set.
+// events      - The events to add.
+// event_count - The number of events.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_shard_set_add_events(sky_shard_set *shard_set, sky_event **events,
+                             uint32_t event_count)
+{
+    int rc;
+    uint32_t i;
+    sky_shard_writer *writers = NULL;
+    sky_event **shard_events = NULL;
+    uint32_t *indexes = NULL;
+    check(shard_set != NULL, "Shard set required");
+    check(shard_set->shard_count > 0, "Shard set not loaded");
+    check(events != NULL || event_count == 0, "Events required");
+    if(event_count == 0) {
+        return 0;
+    }
+
+    // Count the events of each shard and then group them by shard.
+    writers = calloc(shard_set->shard_count, sizeof(*writers)); check_mem(writers);
+    indexes = calloc(event_count, sizeof(*indexes)); check_mem(indexes);
+    shard_events = calloc(event_count, sizeof(*shard_events)); check_mem(shard_events);
+    for(i=0; i<event_count; i++) {
+        indexes[i] = sky_shard_set_get_shard_index(shard_set, events[i]->object_id);
+        writers[indexes[i]].event_count++;
+    }
+    uint32_t offset = 0;
+    for(i=0; i<shard_set->shard_count; i++) {
+        writers[i].shard = &shard_set->shards[i];
+        writers[i].events = &shard_events[offset];
+        offset += writers[i].event_count;
+        writers[i].event_count = 0;
+    }
+    for(i=0; i<event_count; i++) {
+        sky_shard_writer *writer = &writers[indexes[i]];
+        writer->events[writer->event_count++] = events[i];
+    }
+
+    // Start a writer for every shard with events except the last one, which
+    // is written on this thread. Writers that cannot be started are written
+    // here as well.
+    uint32_t last = shard_set->shard_count;
+    for(i=0; i<shard_set->shard_count; i++) {
+        if(writers[i].event_count > 0) last = i;
+    }
+    bool *started = calloc(shard_set->shard_count, sizeof(*started)); check_mem(started);
+    for(i=0; i<last; i++) {
+        if(writers[i].event_count > 0) {
+            started[i] = (pthread_create(&writers[i].thread, NULL, sky_shard_set_run_writer, &writers[i]) == 0);
+            if(!started[i]) debug("Unable to create shard writer thread");
+        }
+    }
+    for(i=0; i<shard_set->shard_count; i++) {
+        if(writers[i].event_count > 0 && !started[i]) {
+            sky_shard_set_write(&writers[i]);
+        }
+    }
+    for(i=0; i<shard_set->shard_count; i++) {
+        if(started[i]) pthread_join(writers[i].thread, NULL);
+    }
+    free(started);
+
+    rc = 0;
+    for(i=0; i<shard_set->shard_count; i++) {
+        if(writers[i].rc != 0) {
+            log_err("Unable to add events to shard %d", i);
+            rc = -1;
+        }
+    }
+    check(rc == 0, "Unable to add events to shards");
+
+    free(writers);
+    free(indexes);
+    free(shard_events);
+    return 0;
+
+error:
+    free(writers);
+    free(indexes);
+    free(shard_events);
+    return -1;
+}
+
+// The main function of a shard writer thread.
+//
+// arg - The shard writer.
+//
+// Returns NULL.
+void *sky_shard_set_run_writer(void *arg)
+{
+    sky_shard_set_write((sky_shard_writer*)arg);
+    return NULL;
+}
+
+// Writes the events of a shard writer to its shard. The result is set on
+// the writer.
+//
+// writer - The shard writer.
+void sky_shard_set_write(sky_shard_writer *writer)
+{
+    int rc;
+    uint32_t i;
+    sky_data_file *data_file = writer->shard->data_file;
+
+    rc = sky_data_file_begin_batch(data_file);
+    check(rc == 0, "Unable to begin shard batch");
+    for(i=0; i<writer->event_count; i++) {
+        rc = sky_data_file_add_event(data_file, writer->events[i]);
+        if(rc != 0) break;
+    }
+    int end_rc = sky_data_file_end_batch(data_file);
+    check(rc == 0, "Unable to add event to shard %d", writer->shard->index);
+    check(end_rc == 0, "Unable to end shard batch");
+
+    writer->rc = 0;
+    return;
+
+error:
+    writer->rc = -1;
+}
+
+
+//--------------------------------------
+// Path Lookup
+//--------------------------------------
+
+// Finds the path of an object in its shard.
+//
+// shard_set  - The shard set.
+// object_id  - The object id.
+// paths      - A pointer to where an array of raw path pointers should be
+//              returned. The caller owns the array. This is NULL if the
+//              object has no path.
+// path_count - A pointer to where the number of paths should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_shard_set_find_path(sky_shard_set *shard_set,
+                            sky_object_id_t object_id, void ***paths,
+                            uint32_t *path_count)
+{
+    int rc;
+    check(shard_set != NULL, "Shard set required");
+    check(shard_set->shard_count > 0, "Shard set not loaded");
+
+    sky_shard *shard = &shard_set->shards[sky_shard_set_get_shard_index(shard_set, object_id)];
+    rc = sky_data_file_find_path(shard->data_file, object_id, paths, path_count);
+    check(rc == 0, "Unable to find path in shard %d", shard->index);
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Querying
+//--------------------------------------
+
+// Executes a query over every shard. Each shard is scanned in parallel by
+// the query itself and aggregates into the same result. A query that is
+// stopped in one shard is not run on the rest.
+//
+// shard_set - The shard set.
+// query     - The query to execute.
+// result    - The result to aggregate into.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_shard_set_execute_query(sky_shard_set *shard_set, sky_query *query,
+                                sky_query_result *result)
+{
+    int rc;
+    uint32_t i;
+    check(shard_set != NULL, "Shard set required");
+    check(query != NULL, "Query required");
+    check(result != NULL, "Result required");
+
+    for(i=0; i<shard_set->shard_count; i++) {
+        rc = sky_query_execute(query, shard_set->shards[i].data_file, result);
+        check(rc == 0, "Unable to query shard %d", i);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
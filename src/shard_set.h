@@ -0,0 +1,141 @@
+#ifndef _shard_set_h
+#define _shard_set_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef struct sky_shard_set sky_shard_set;
+
+#include "bstring.h"
+#include "types.h"
+#include "event.h"
+#include "data_file.h"
+#include "query.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A shard set splits the objects of a table across several data files by
+// hashing their object ids. Each shard has its own header, block array and
+// extents in a directory named after its index, so writes to different
+// shards never touch the same data file and can be applied by separate
+// threads. The whole path of an object lives in a single shard.
+//
+// Batches of events are split by shard and each shard that receives events
+// writes them on its own writer thread. The batch completes once every
+// writer has finished. Queries fan out over the shards and aggregate into
+// one result, which is the same merge that the scan threads of a single
+// data file already use.
+//
+// The number of shards is fixed when the set is first created. Loading a
+// set with a different number of shards fails since objects would be
+// routed to the wrong shard.
+//
+// The object ids are mixed with a Fibonacci hash rather than the hash the
+// coordinator uses to pick a node so that the objects of one node are still
+// spread over all of its local shards.
+//
+// The settings of the set are applied to the data file of every shard as it
+// is loaded. A table that is created with a shard count keeps its data in a
+// shard set instead of a single data file. See table.h.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef struct sky_shard {
+    uint32_t index;
+    sky_data_file *data_file;
+} sky_shard;
+
+struct sky_shard_set {
+    bstring path;
+    uint32_t block_size;
+    sky_durability_e durability;
+    bool preload;
+    bool huge_pages;
+    bool action_only;
+    size_t block_cache_size;
+    sky_prefetcher *prefetcher;
+    sky_shard *shards;
+    uint32_t shard_count;
+};
+
+// The events of a batch that are written to one shard.
+typedef struct sky_shard_writer {
+    sky_shard *shard;
+    sky_event **events;
+    uint32_t event_count;
+    pthread_t thread;
+    int rc;
+} sky_shard_writer;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_shard_set *sky_shard_set_create();
+
+void sky_shard_set_free(sky_shard_set *shard_set);
+
+
+//--------------------------------------
+// Persistence
+//--------------------------------------
+
+int sky_shard_set_load(sky_shard_set *shard_set, uint32_t shard_count);
+
+int sky_shard_set_unload(sky_shard_set *shard_set);
+
+uint32_t sky_shard_set_count_shard_dirs(sky_shard_set *shard_set);
+
+
+//--------------------------------------
+// Routing
+//--------------------------------------
+
+uint32_t sky_shard_set_get_shard_index(sky_shard_set *shard_set,
+    sky_object_id_t object_id);
+
+
+//--------------------------------------
+// Event Management
+//--------------------------------------
+
+int sky_shard_set_add_event(sky_shard_set *shard_set, sky_event *event);
+
+int sky_shard_set_add_events(sky_shard_set *shard_set, sky_event **events,
+    uint32_t event_count);
+
+
+//--------------------------------------
+// Path Lookup
+//--------------------------------------
+
+int sky_shard_set_find_path(sky_shard_set *shard_set,
+    sky_object_id_t object_id, void ***paths, uint32_t *path_count);
+
+
+//--------------------------------------
+// Querying
+//--------------------------------------
+
+int sky_shard_set_execute_query(sky_shard_set *shard_set, sky_query *query,
+    sky_query_result *result);
+
+#endif
@@ -1,7 +1,25 @@
+#if defined(__linux__)
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <time.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "bstring.h"
 #include "dbg.h"
@@ -9,6 +27,15 @@
 #include "table.h"
 #include "cursor.h"
 #include "path_iterator.h"
+#include "message_header.h"
+#include "eadd_message.h"
+#include "next_action_message.h"
+#include "dag_message.h"
+#include "multi_message.h"
+#include "minipack.h"
+#include "query.h"
+#include "stats.h"
+#include "file.h"
 #include "version.h"
 
 
@@ -18,9 +45,86 @@
 //
 //==============================================================================
 
-// The sky-bench application is used for benchmarking databases in different
-// ways. The tool currently only supports basic iteration through the entire
-// database.
+// The sky-bench application is a suite of benchmarks over tables. Each
+// workload can be selected by name and reports its throughput, the median
+// and 99th percentile latency of its operations and the peak resident set
+// size of the process:
+//
+//   seq-eadd    - Adds events one at a time in object and timestamp order.
+//   random-eadd - Adds events one at a time for random objects and times.
+//   bulk        - Adds random events in sorted batches.
+//   split       - Adds events to every object in turn so that blocks split
+//                 as their paths grow.
+//   next-action - Counts the actions following an action over every path.
+//   dag         - Counts the transitions between every pair of actions.
+//   window      - Counts the events within a tenth of the time range.
+//   lookup      - Finds the paths of random objects.
+//
+// The benchmarks run in a working directory. Every insert workload writes
+// to a fresh table named after the workload. The read workloads share a
+// table named "read" which is generated the first time it is needed and
+// reused on later runs.
+//
+// The JSON format writes one object per workload on its own line so that
+// results can be collected for regression tracking.
+//
+// When a server is given with `--connect` the benchmark runs against a
+// running skyd instead. Each connection is driven by its own thread which
+// sends a weighted mix of EADD, NEXT_ACTION and MULTI messages and waits for
+// the responses before sending the next one. The total message rate can be
+// capped so the server can be measured at a given load. Latencies are
+// reported per message type and throughput is measured over the wall clock.
+// Events are added to the `--database` and `--table` given, and the
+// database directory must already exist in the server's data path.
+//
+// When layouts are given with `--layouts` the benchmark compares storage
+// formats instead. The events of a source table are read once and loaded
+// into a fresh table for every layout and block size:
+//
+//   base        - The default format.
+//   fixed       - Int, Float and Boolean properties are stored as fixed
+//                 values.
+//   action-only - An action-only table. The events are loaded without
+//                 their data.
+//   compressed  - Every block is compressed after the load.
+//   compacted   - The table is compacted with full blocks after the load.
+//
+// The source is a table built by sky-gen and given with `--source`, or the
+// "read" table when none is given. Each table reports its stored and
+// allocated bytes per event and its insert throughput, which covers adding
+// the events and flushing the table but not compressing or compacting it.
+// The next-action, dag and window queries are then run over a warm cache
+// and once each over a cold cache. The cache is made cold by closing the
+// table and dropping its extents from the page cache before it is
+// reopened. The scan rate of each query is the number of events it
+// scanned per second.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+#define SKY_BENCH_DEFAULT_EVENT_COUNT 100000
+
+#define SKY_BENCH_DEFAULT_OBJECT_COUNT 1000
+
+#define SKY_BENCH_DEFAULT_ITERATIONS 5
+
+#define SKY_BENCH_ACTION_COUNT 10
+
+#define SKY_BENCH_BATCH_SIZE 1000
+
+#define SKY_BENCH_READ_TABLE_NAME "read"
+
+#define SKY_BENCH_DEFAULT_CONNECTION_COUNT 4
+
+#define SKY_BENCH_DEFAULT_MIX "eadd=80,next_action=10,multi=10"
+
+#define SKY_BENCH_MULTI_SIZE 10
+
+#define SKY_BENCH_DEFAULT_BLOCK_SIZES "16384,65536,262144"
 
 
 //==============================================================================
@@ -29,12 +133,122 @@
 //
 //==============================================================================
 
+typedef enum Format {
+    FORMAT_TEXT,
+    FORMAT_JSON,
+} Format;
+
+// The messages sent by the network benchmark.
+typedef enum NetMessageType {
+    NET_MESSAGE_EADD,
+    NET_MESSAGE_NEXT_ACTION,
+    NET_MESSAGE_MULTI,
+    NET_MESSAGE_COUNT,
+} NetMessageType;
+
 typedef struct Options {
     bstring path;
-    bstring table_name;
+    bstring workloads;
+    uint32_t event_count;
+    uint32_t object_count;
     int32_t iterations;
+    uint32_t seed;
+    int durability;
+    Format format;
+    bstring connect;
+    bstring database_name;
+    bstring table_name;
+    uint32_t connection_count;
+    uint32_t rate;
+    uint32_t mix[NET_MESSAGE_COUNT];
+    bstring layouts;
+    bstring block_sizes;
+    bstring source;
 } Options;
 
+// The measurements of a single workload. Latencies are in nanoseconds.
+typedef struct Result {
+    const char *name;
+    uint64_t op_count;
+    uint64_t event_count;
+    int64_t elapsed;
+    int64_t *latencies;
+    uint64_t latency_count;
+    uint64_t block_splits;
+} Result;
+
+typedef int (*Workload)(Options *options, Result *result);
+
+// The state of a single connection of the network benchmark.
+typedef struct Client {
+    Options *options;
+    uint32_t index;
+    uint32_t message_count;
+    unsigned int seed;
+    FILE *input;
+    FILE *output;
+    sky_message_header *headers[NET_MESSAGE_COUNT];
+    sky_eadd_message *eadd_message;
+    sky_next_action_message *next_action_message;
+    sky_multi_message *multi_message;
+    sky_buffer *response;
+    int64_t *latencies[NET_MESSAGE_COUNT];
+    uint64_t counts[NET_MESSAGE_COUNT];
+    int rc;
+} Client;
+
+// The storage formats compared by the layout benchmark.
+typedef enum Layout {
+    LAYOUT_BASE,
+    LAYOUT_FIXED,
+    LAYOUT_ACTION_ONLY,
+    LAYOUT_COMPRESSED,
+    LAYOUT_COMPACTED,
+    LAYOUT_COUNT,
+} Layout;
+
+// The queries run by the layout benchmark.
+typedef enum LayoutQuery {
+    LAYOUT_QUERY_NEXT_ACTION,
+    LAYOUT_QUERY_DAG,
+    LAYOUT_QUERY_WINDOW,
+    LAYOUT_QUERY_COUNT,
+} LayoutQuery;
+
+// The events of the source table that are loaded into every layout. The
+// events keep their data for the action-only layout, which leaves it out
+// while it loads them.
+typedef struct Dataset {
+    sky_table *source;
+    sky_event **events;
+    uint32_t event_count;
+    sky_timestamp_t min_timestamp;
+    sky_timestamp_t max_timestamp;
+} Dataset;
+
+// The messages and query that are run over each layout.
+typedef struct LayoutQueries {
+    sky_next_action_message *next_action_message;
+    sky_dag_message *dag_message;
+    sky_query *window_query;
+    sky_buffer *output;
+} LayoutQueries;
+
+// The measurements of a single layout and block size. Times are in
+// nanoseconds.
+typedef struct LayoutResult {
+    const char *name;
+    uint32_t block_size;
+    uint64_t event_count;
+    uint32_t block_count;
+    size_t stored_bytes;
+    size_t allocated_bytes;
+    int64_t insert_elapsed;
+    uint64_t hot_event_counts[LAYOUT_QUERY_COUNT];
+    int64_t hot_elapsed[LAYOUT_QUERY_COUNT];
+    uint64_t cold_event_counts[LAYOUT_QUERY_COUNT];
+    int64_t cold_elapsed[LAYOUT_QUERY_COUNT];
+} LayoutResult;
 
 // A data structure used for aggregation information between events in the path.
 typedef struct Step {
@@ -42,74 +256,302 @@ typedef struct Step {
 } Step;
 
 
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int benchmark_seq_eadd(Options *options, Result *result);
+
+int benchmark_random_eadd(Options *options, Result *result);
+
+int benchmark_bulk(Options *options, Result *result);
+
+int benchmark_split(Options *options, Result *result);
+
+int benchmark_next_action(Options *options, Result *result);
+
+int benchmark_dag(Options *options, Result *result);
+
+int benchmark_window(Options *options, Result *result);
+
+int benchmark_lookup(Options *options, Result *result);
+
+int benchmark_network(Options *options);
+
+int benchmark_layouts(Options *options);
+
+bool is_listed(bstring names, const char *name);
+
+int parse_mix(Options *options, const char *str);
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+const char *workload_names[] = {
+    "seq-eadd", "random-eadd", "bulk", "split", "next-action", "dag",
+    "window", "lookup",
+};
+
+Workload workload_funcs[] = {
+    benchmark_seq_eadd, benchmark_random_eadd, benchmark_bulk,
+    benchmark_split, benchmark_next_action, benchmark_dag, benchmark_window,
+    benchmark_lookup,
+};
+
+#define WORKLOAD_COUNT (sizeof(workload_names) / sizeof(workload_names[0]))
+
+const char *net_message_names[] = {"eadd", "next_action", "multi"};
+
+const char *net_result_names[] = {"net-eadd", "net-next-action", "net-multi"};
+
+const char *layout_names[] = {
+    "base", "fixed", "action-only", "compressed", "compacted",
+};
+
+const char *layout_query_names[] = {"next-action", "dag", "window"};
+
+
 //==============================================================================
 //
 // Command Line Arguments
 //
 //==============================================================================
 
+void print_version();
+void usage();
+
 Options *parseopts(int argc, char **argv)
 {
     Options *options = (Options*)calloc(1, sizeof(Options));
     check_mem(options);
-    
+    options->event_count = SKY_BENCH_DEFAULT_EVENT_COUNT;
+    options->object_count = SKY_BENCH_DEFAULT_OBJECT_COUNT;
+    options->iterations = SKY_BENCH_DEFAULT_ITERATIONS;
+    options->seed = 1;
+    options->durability = -1;
+    options->format = FORMAT_TEXT;
+    options->connection_count = SKY_BENCH_DEFAULT_CONNECTION_COUNT;
+    if(parse_mix(options, SKY_BENCH_DEFAULT_MIX) != 0) {
+        exit(1);
+    }
+
     // Command line options.
     struct option long_options[] = {
-        {"table-name", required_argument, 0, 't'},
+        {"workload", required_argument, 0, 'w'},
+        {"events", required_argument, 0, 'n'},
+        {"objects", required_argument, 0, 'o'},
         {"iterations", required_argument, 0, 'i'},
+        {"seed", required_argument, 0, 's'},
+        {"durability", required_argument, 0, 'd'},
+        {"format", required_argument, 0, 'f'},
+        {"connect", required_argument, 0, 'c'},
+        {"connections", required_argument, 0, 'C'},
+        {"rate", required_argument, 0, 'r'},
+        {"mix", required_argument, 0, 'm'},
+        {"database", required_argument, 0, 'D'},
+        {"table", required_argument, 0, 'T'},
+        {"layouts", required_argument, 0, 'L'},
+        {"block-sizes", required_argument, 0, 'B'},
+        {"source", required_argument, 0, 'S'},
+        {"version", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
 
     // Parse command line options.
     while(1) {
         int option_index = 0;
-        int c = getopt_long(argc, argv, "o:i:", long_options, &option_index);
-        
+        int c = getopt_long(argc, argv, "w:n:o:i:s:d:f:c:C:r:m:D:T:L:B:S:vh", long_options, &option_index);
+
         // Check for end of options.
         if(c == -1) {
             break;
         }
-        
+
         // Parse each option.
         switch(c) {
-            case 't': {
-                options->table_name = bfromcstr(optarg);
-                check_mem(options->table_name);
+            case 'w': {
+                bdestroy(options->workloads);
+                options->workloads = bfromcstr(optarg);
+                check_mem(options->workloads);
+                break;
+            }
+
+            case 'n': {
+                options->event_count = (uint32_t)atol(optarg);
+                break;
+            }
+
+            case 'o': {
+                options->object_count = (uint32_t)atol(optarg);
                 break;
             }
-            
+
             case 'i': {
                 options->iterations = atoi(optarg);
                 break;
             }
+
+            case 's': {
+                options->seed = (uint32_t)atol(optarg);
+                break;
+            }
+
+            case 'd': {
+                if(strcmp(optarg, "strict") == 0) {
+                    options->durability = SKY_DURABILITY_STRICT;
+                }
+                else if(strcmp(optarg, "group") == 0) {
+                    options->durability = SKY_DURABILITY_GROUP;
+                }
+                else if(strcmp(optarg, "async") == 0) {
+                    options->durability = SKY_DURABILITY_ASYNC;
+                }
+                else {
+                    fprintf(stderr, "Error: Invalid durability: %s\n\n", optarg);
+                    exit(1);
+                }
+                break;
+            }
+
+            case 'f': {
+                if(strcmp(optarg, "json") == 0) {
+                    options->format = FORMAT_JSON;
+                }
+                else if(strcmp(optarg, "text") == 0) {
+                    options->format = FORMAT_TEXT;
+                }
+                else {
+                    fprintf(stderr, "Error: Invalid format: %s\n\n", optarg);
+                    exit(1);
+                }
+                break;
+            }
+
+            case 'c': {
+                bdestroy(options->connect);
+                options->connect = bfromcstr(optarg);
+                check_mem(options->connect);
+                break;
+            }
+
+            case 'C': {
+                options->connection_count = (uint32_t)atol(optarg);
+                break;
+            }
+
+            case 'r': {
+                options->rate = (uint32_t)atol(optarg);
+                break;
+            }
+
+            case 'm': {
+                if(parse_mix(options, optarg) != 0) {
+                    exit(1);
+                }
+                break;
+            }
+
+            case 'D': {
+                bdestroy(options->database_name);
+                options->database_name = bfromcstr(optarg);
+                check_mem(options->database_name);
+                break;
+            }
+
+            case 'T': {
+                bdestroy(options->table_name);
+                options->table_name = bfromcstr(optarg);
+                check_mem(options->table_name);
+                break;
+            }
+
+            case 'L': {
+                bdestroy(options->layouts);
+                options->layouts = bfromcstr(optarg);
+                check_mem(options->layouts);
+                break;
+            }
+
+            case 'B': {
+                bdestroy(options->block_sizes);
+                options->block_sizes = bfromcstr(optarg);
+                check_mem(options->block_sizes);
+                break;
+            }
+
+            case 'S': {
+                bdestroy(options->source);
+                options->source = bfromcstr(optarg);
+                check_mem(options->source);
+                break;
+            }
+
+            case 'v': {
+                print_version();
+                break;
+            }
+
+            case 'h': {
+                usage();
+                break;
+            }
         }
     }
-    
+
     argc -= optind;
     argv += optind;
 
-    // Retrieve path as first non-getopts option.
-    if(argc < 1) {
-        fprintf(stderr, "Error: Table path required.\n\n");
+    // Retrieve path as first non-getopts option. The network benchmark does
+    // not use a working directory.
+    if(argc >= 1) {
+        options->path = bfromcstr(argv[0]);
+        check_mem(options->path);
+    }
+    else if(options->connect == NULL) {
+        fprintf(stderr, "Error: Working directory required.\n\n");
         exit(1);
     }
-    options->path = bfromcstr(argv[0]);
 
     // Validate input.
-    /*
-    if(options->object_type == NULL) {
-        fprintf(stderr, "Error: Object type (-o) is required.\n\n");
+    if(options->event_count == 0 || options->object_count == 0) {
+        fprintf(stderr, "Error: Event and object counts must be positive.\n\n");
+        exit(1);
+    }
+    if(options->connection_count == 0) {
+        fprintf(stderr, "Error: At least one connection is required.\n\n");
         exit(1);
     }
-    */
 
     // Default input.
     if(options->iterations <= 0) {
         options->iterations = 1;
     }
+    if(options->workloads == NULL) {
+        options->workloads = bfromcstr("all");
+        check_mem(options->workloads);
+    }
+    if(options->database_name == NULL) {
+        options->database_name = bfromcstr("bench");
+        check_mem(options->database_name);
+    }
+    if(options->table_name == NULL) {
+        options->table_name = bfromcstr("bench");
+        check_mem(options->table_name);
+    }
+    if(options->block_sizes == NULL) {
+        options->block_sizes = bfromcstr(SKY_BENCH_DEFAULT_BLOCK_SIZES);
+        check_mem(options->block_sizes);
+    }
 
     return options;
-    
+
 error:
     exit(1);
 }
@@ -118,8 +560,13 @@ void Options_free(Options *options)
 {
     if(options) {
         bdestroy(options->path);
+        bdestroy(options->workloads);
+        bdestroy(options->connect);
+        bdestroy(options->database_name);
         bdestroy(options->table_name);
-        options->table_name = NULL;
+        bdestroy(options->layouts);
+        bdestroy(options->block_sizes);
+        bdestroy(options->source);
         free(options);
     }
 }
@@ -139,158 +586,1813 @@ void print_version()
 
 void usage()
 {
-    fprintf(stderr, "usage: sky-bench [OPTIONS] [PATH]\n\n");
+    uint32_t i;
+    fprintf(stderr, "usage: sky-bench [OPTIONS] PATH\n");
+    fprintf(stderr, "       sky-bench [OPTIONS] --connect HOST:PORT|SOCKET\n\n");
+    fprintf(stderr, "  -w, --workload LIST    comma separated workloads or all (default)\n");
+    fprintf(stderr, "  -n, --events COUNT     events to insert, objects to look up or\n");
+    fprintf(stderr, "                         messages to send\n");
+    fprintf(stderr, "  -o, --objects COUNT    number of distinct objects\n");
+    fprintf(stderr, "  -i, --iterations N     number of times each scan is run\n");
+    fprintf(stderr, "  -s, --seed SEED        random number seed\n");
+    fprintf(stderr, "  -d, --durability MODE  strict, group or async\n");
+    fprintf(stderr, "  -f, --format FORMAT    text (default) or json\n");
+    fprintf(stderr, "  -c, --connect ADDRESS  benchmark a running server\n");
+    fprintf(stderr, "  -C, --connections N    number of concurrent connections\n");
+    fprintf(stderr, "  -r, --rate N           messages per second over all connections\n");
+    fprintf(stderr, "  -m, --mix MIX          message weights (" SKY_BENCH_DEFAULT_MIX ")\n");
+    fprintf(stderr, "  -D, --database NAME    database used on the server\n");
+    fprintf(stderr, "  -T, --table NAME       table used on the server\n");
+    fprintf(stderr, "  -L, --layouts LIST     compare comma separated storage layouts or all\n");
+    fprintf(stderr, "  -B, --block-sizes LIST block sizes of each layout\n");
+    fprintf(stderr, "                         (" SKY_BENCH_DEFAULT_BLOCK_SIZES ")\n");
+    fprintf(stderr, "  -S, --source PATH      table loaded into each layout (default read)\n\n");
+    fprintf(stderr, "workloads:");
+    for(i=0; i<WORKLOAD_COUNT; i++) {
+        fprintf(stderr, " %s", workload_names[i]);
+    }
+    fprintf(stderr, "\n");
+    fprintf(stderr, "layouts:  ");
+    for(i=0; i<LAYOUT_COUNT; i++) {
+        fprintf(stderr, " %s", layout_names[i]);
+    }
+    fprintf(stderr, "\n\n");
     exit(0);
 }
 
 
 //==============================================================================
 //
-// Benchmark
+// Measurement
+//
+//==============================================================================
+
+// Returns the current time from the monotonic clock in nanoseconds.
+int64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+// Prepares a result to record a given number of latencies.
+//
+// result - The result.
+// name   - The name of the workload.
+// count  - The maximum number of latencies recorded.
+//
+// Returns 0 if successful, otherwise returns -1.
+int Result_init(Result *result, const char *name, uint64_t count)
+{
+    memset(result, 0, sizeof(*result));
+    result->name = name;
+    result->latencies = calloc(count > 0 ? count : 1, sizeof(*result->latencies));
+    check_mem(result->latencies);
+    return 0;
+
+error:
+    return -1;
+}
+
+void Result_free_deps(Result *result)
+{
+    free(result->latencies);
+    result->latencies = NULL;
+}
+
+// Records the latency of a single operation.
+//
+// result - The result.
+// t0     - When the operation started.
+// t1     - When the operation ended.
+void Result_record(Result *result, int64_t t0, int64_t t1)
+{
+    result->latencies[result->latency_count++] = t1 - t0;
+    result->elapsed += t1 - t0;
+    result->op_count++;
+}
+
+int compare_latencies(const void *a, const void *b)
+{
+    int64_t x = *((int64_t*)a), y = *((int64_t*)b);
+    return (x > y) - (x < y);
+}
+
+// Returns the latency at a percentile of the sorted latencies in
+// microseconds.
+double percentile(Result *result, double p)
+{
+    if(result->latency_count == 0) return 0;
+    uint64_t index = (uint64_t)(p * (result->latency_count - 1));
+    return (double)result->latencies[index] / 1000;
+}
+
+// Prints the measurements of a workload.
+//
+// options - The options.
+// result  - The result of the workload.
+void report(Options *options, Result *result)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    qsort(result->latencies, result->latency_count, sizeof(*result->latencies), compare_latencies);
+
+    double seconds = (double)result->elapsed / 1000000000;
+    double ops_per_second = (seconds > 0 ? result->op_count / seconds : 0);
+    double events_per_second = (seconds > 0 ? result->event_count / seconds : 0);
+
+    if(options->format == FORMAT_JSON) {
+        printf("{\"workload\":\"%s\",\"ops\":%" PRIu64 ",\"events\":%" PRIu64
+               ",\"seconds\":%.6f,\"opsPerSecond\":%.1f,\"eventsPerSecond\":%.1f"
+               ",\"p50Us\":%.3f,\"p99Us\":%.3f,\"maxRssKb\":%ld,\"blockSplits\":%" PRIu64 "}\n",
+            result->name, result->op_count, result->event_count, seconds,
+            ops_per_second, events_per_second, percentile(result, 0.5),
+            percentile(result, 0.99), (long)usage.ru_maxrss, result->block_splits);
+    }
+    else {
+        printf("%-12s %10" PRIu64 " ops %9.3fs %12.1f ops/s %12.1f events/s  p50 %9.3fus  p99 %9.3fus  rss %ldKB  splits %" PRIu64 "\n",
+            result->name, result->op_count, seconds, ops_per_second,
+            events_per_second, percentile(result, 0.5), percentile(result, 0.99),
+            (long)usage.ru_maxrss, result->block_splits);
+    }
+    fflush(stdout);
+}
+
+
+//==============================================================================
+//
+// Tables
 //
 //==============================================================================
 
-// Executes the benchmark over the database to compute step counts in order to
-// generate a directed acyclic graph (DAG).
+// Opens a table in the working directory. Its actions are created if it does
+// not have any yet.
 //
-// options - A list of options to use.
-void benchmark_dag(Options *options)
+// options - The options.
+// name    - The name of the table.
+// fresh   - Whether an existing table is removed first.
+// ret     - A pointer to where the table should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int open_table(Options *options, const char *name, bool fresh, sky_table **ret)
 {
     int rc;
-    sky_event *event = NULL;
-    uint32_t event_count = 0;
-    int32_t action_count = 100;     // TODO: Retrieve action count from actions file.
-    
-    // Initialize table.
-    sky_table *table = sky_table_create(); check_mem(table);
-    rc = sky_table_set_path(table, options->path);
+    uint32_t i;
+    sky_table *table = NULL;
+    bstring path = bformat("%s/%s", bdata(options->path), name);
+    check_mem(path);
+
+    if(!sky_file_exists(options->path)) {
+        rc = mkdir(bdata(options->path), S_IRWXU);
+        check(rc == 0, "Unable to create working directory: %s", bdata(options->path));
+    }
+    if(fresh && sky_file_exists(path)) {
+        rc = sky_file_rm_r(path);
+        check(rc == 0, "Unable to remove table: %s", bdata(path));
+    }
+
+    table = sky_table_create(); check_mem(table);
+    rc = sky_table_set_path(table, path);
     check(rc == 0, "Unable to set path on table");
-    
-    // Open table
     rc = sky_table_open(table);
-    check(rc == 0, "Unable to open table");
+    check(rc == 0, "Unable to open table: %s", bdata(path));
+    if(options->durability >= 0) {
+        rc = sky_table_set_durability(table, (sky_durability_e)options->durability);
+        check(rc == 0, "Unable to set table durability");
+    }
 
-    // Loop for desired number of iterations.
-    int i;
-    for(i=0; i<options->iterations; i++) {
-        sky_path_iterator iterator;
-        sky_path_iterator_init(&iterator);
-        
-        // Attach data file.
-        rc = sky_path_iterator_set_data_file(&iterator, table->data_file);
-        check(rc == 0, "Unable to initialze path iterator");
-        
-        // Create a square matrix of structs.
-        Step *steps = calloc(action_count*action_count, sizeof(Step));
+    // Register the actions used by the generated events.
+    rc = sky_action_file_ensure_loaded(table->action_file);
+    check(rc == 0, "Unable to load actions");
+    if(table->action_file->action_count == 0) {
+        for(i=0; i<SKY_BENCH_ACTION_COUNT; i++) {
+            sky_action *action = sky_action_create(); check_mem(action);
+            action->name = bformat("action%d", i+1); check_mem(action->name);
+            rc = sky_action_file_add_action(table->action_file, action);
+            check(rc == 0, "Unable to add action");
+        }
+        rc = sky_action_file_save(table->action_file);
+        check(rc == 0, "Unable to save actions");
+    }
 
-        // Iterate over each path.
-        while(!iterator.eof) {
-            sky_action_id_t action_id, prev_action_id;
+    bdestroy(path);
+    *ret = table;
+    return 0;
 
-            // Retrieve the path pointer.
-            void *path_ptr;
-            rc = sky_path_iterator_get_ptr(&iterator, &path_ptr);
-            check(rc == 0, "Unable to retrieve the path iterator pointer");
-        
-            // Initialize the cursor.
-            sky_cursor cursor;
-            sky_cursor_init(&cursor);
-            rc = sky_cursor_set_path(&cursor, path_ptr);
-            check(rc == 0, "Unable to set cursor path");
-
-            // Increment total event count.
-            event_count++;
-            
-            // Initialize the previous action.
-            rc = sky_cursor_get_action_id(&cursor, &prev_action_id);
-            check(rc == 0, "Unable to retrieve first action");
-
-            // Find next event.
-            rc = sky_cursor_next(&cursor);
-            check(rc == 0, "Unable to find next event");
+error:
+    bdestroy(path);
+    if(table && table->opened) sky_table_close(table);
+    sky_table_free(table);
+    *ret = NULL;
+    return -1;
+}
 
-            // Loop over each event in the path.
-            while(!cursor.eof) {
-                // Increment total event count.
-                event_count++;
+void close_table(sky_table *table)
+{
+    if(table) {
+        if(table->opened) sky_table_close(table);
+        sky_table_free(table);
+    }
+}
+
+// Creates an event for a random action.
+sky_event *create_event(sky_object_id_t object_id, sky_timestamp_t timestamp)
+{
+    return sky_event_create(object_id, timestamp, 1 + (rand() % SKY_BENCH_ACTION_COUNT));
+}
 
-                // Retrieve action.
-                rc = sky_cursor_get_action_id(&cursor, &action_id);
-                check(rc == 0, "Unable to retrieve first action");
+// Opens the table shared by the read workloads. The table is generated with
+// random events the first time it is opened.
+//
+// options - The options.
+// ret     - A pointer to where the table should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int open_read_table(Options *options, sky_table **ret)
+{
+    int rc;
+    uint32_t i, j;
+    sky_table *table = NULL;
+    sky_event **events = NULL;
 
-                // Aggregate step information.
-                int32_t index = ((prev_action_id-1)*action_count) + (action_id-1);
-                steps[index].count++;
+    bstring path = bformat("%s/%s", bdata(options->path), SKY_BENCH_READ_TABLE_NAME);
+    check_mem(path);
+    bool exists = sky_file_exists(path);
+    bdestroy(path);
 
-                // Assign current action as previous action.
-                prev_action_id = action_id;
+    rc = open_table(options, SKY_BENCH_READ_TABLE_NAME, false, &table);
+    check(rc == 0, "Unable to open read table");
 
-                // Find next event.
-                rc = sky_cursor_next(&cursor);
-                check(rc == 0, "Unable to find next event");
+    if(!exists) {
+        events = calloc(SKY_BENCH_BATCH_SIZE, sizeof(*events)); check_mem(events);
+        for(i=0; i<options->event_count; i+=SKY_BENCH_BATCH_SIZE) {
+            uint32_t count = 0;
+            for(j=i; j<options->event_count && count<SKY_BENCH_BATCH_SIZE; j++) {
+                events[count] = create_event(1 + (rand() % options->object_count), rand() % options->event_count);
+                check_mem(events[count]);
+                count++;
             }
-            
-            rc = sky_path_iterator_next(&iterator);
-            check(rc == 0, "Unable to find next path");
+            rc = sky_table_add_events(table, events, count);
+            for(j=0; j<count; j++) {
+                sky_event_free(events[j]);
+            }
+            check(rc == 0, "Unable to generate read table");
         }
-        
-        // Show DAG data.
-        //int x;
-        //int total=0;
-        //for(x=0; x<action_count*action_count; x++) {
-        //    printf("%06d %d\n", x, steps[x].count);
-        //    total += steps[x].count;
-        //}
-        //printf("total: %d\n", total);
-    }
-    
-    // Clean up
-    rc = sky_table_close(table);
-    check(rc == 0, "Unable to close table");
-    sky_table_free(table);
+        free(events);
+        events = NULL;
+    }
+
+    *ret = table;
+    return 0;
 
-    // Show stats.
-    printf("Total events processed: %d\n", event_count);
-    
-    return;
-    
 error:
-    sky_event_free(event);
-    sky_table_free(table);
+    free(events);
+    close_table(table);
+    *ret = NULL;
+    return -1;
 }
 
 
-
 //==============================================================================
 //
-// Main
+// Insert Workloads
 //
 //==============================================================================
 
-int main(int argc, char **argv)
+// Adds a single event to a table and records its latency.
+int add_event(sky_table *table, Result *result, sky_object_id_t object_id,
+              sky_timestamp_t timestamp)
 {
-    struct timeval tv;
-
-    // Parse command line options.
-    Options *options = parseopts(argc, argv);
+    sky_event *event = create_event(object_id, timestamp); check_mem(event);
+    int64_t t0 = now_ns();
+    int rc = sky_table_add_event(table, event);
+    Result_record(result, t0, now_ns());
+    sky_event_free(event);
+    check(rc == 0, "Unable to add event");
+    result->event_count++;
+    return 0;
 
-    // Start time.
-    gettimeofday(&tv, NULL);
-    int64_t t0 = (tv.tv_sec*1000) + (tv.tv_usec/1000);
+error:
+    return -1;
+}
 
-    // Benchmark computation of a DAG.
-    benchmark_dag(options);
+// Adds events in object and timestamp order.
+//
+// options - The options.
+// result  - The result to record to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int benchmark_seq_eadd(Options *options, Result *result)
+{
+    int rc;
+    uint32_t i;
+    sky_table *table = NULL;
+    uint32_t events_per_object = options->event_count / options->object_count;
+    if(events_per_object == 0) events_per_object = 1;
 
-    // End time.
-    gettimeofday(&tv, NULL);
-    int64_t t1 = (tv.tv_sec*1000) + (tv.tv_usec/1000);
+    rc = open_table(options, "seq-eadd", true, &table);
+    check(rc == 0, "Unable to open table");
 
-    // Show wall clock time.
-    printf("Elapsed Time: %.3f seconds\n", ((float)(t1-t0))/1000);
+    for(i=0; i<options->event_count; i++) {
+        rc = add_event(table, result, 1 + (i / events_per_object), i);
+        check(rc == 0, "Unable to add event");
+    }
 
-    // Clean up.
-    Options_free(options);
-    
+    close_table(table);
     return 0;
+
+error:
+    close_table(table);
+    return -1;
 }
 
+// Adds events for random objects at random times.
+//
+// options - The options.
+// result  - The result to record to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int benchmark_random_eadd(Options *options, Result *result)
+{
+    int rc;
+    uint32_t i;
+    sky_table *table = NULL;
+
+    rc = open_table(options, "random-eadd", true, &table);
+    check(rc == 0, "Unable to open table");
+
+    for(i=0; i<options->event_count; i++) {
+        rc = add_event(table, result, 1 + (rand() % options->object_count), rand() % options->event_count);
+        check(rc == 0, "Unable to add event");
+    }
+
+    close_table(table);
+    return 0;
+
+error:
+    close_table(table);
+    return -1;
+}
+
+// Adds random events in batches. Each batch is one operation.
+//
+// options - The options.
+// result  - The result to record to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int benchmark_bulk(Options *options, Result *result)
+{
+    int rc;
+    uint32_t i, j;
+    sky_table *table = NULL;
+    sky_event **events = NULL;
+
+    rc = open_table(options, "bulk", true, &table);
+    check(rc == 0, "Unable to open table");
+
+    events = calloc(SKY_BENCH_BATCH_SIZE, sizeof(*events)); check_mem(events);
+    for(i=0; i<options->event_count; i+=SKY_BENCH_BATCH_SIZE) {
+        uint32_t count = 0;
+        for(j=i; j<options->event_count && count<SKY_BENCH_BATCH_SIZE; j++) {
+            events[count] = create_event(1 + (rand() % options->object_count), rand() % options->event_count);
+            check_mem(events[count]);
+            count++;
+        }
+
+        int64_t t0 = now_ns();
+        rc = sky_table_add_events(table, events, count);
+        Result_record(result, t0, now_ns());
+        for(j=0; j<count; j++) {
+            sky_event_free(events[j]);
+        }
+        check(rc == 0, "Unable to add events");
+        result->event_count += count;
+    }
+
+    free(events);
+    close_table(table);
+    return 0;
+
+error:
+    free(events);
+    close_table(table);
+    return -1;
+}
+
+// Adds one event to every object in turn so that each path grows inside its
+// block until the block splits.
+//
+// options - The options.
+// result  - The result to record to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int benchmark_split(Options *options, Result *result)
+{
+    int rc;
+    uint32_t i;
+    sky_table *table = NULL;
+    uint64_t block_splits = sky_stats_global.block_splits;
+
+    rc = open_table(options, "split", true, &table);
+    check(rc == 0, "Unable to open table");
+
+    for(i=0; i<options->event_count; i++) {
+        rc = add_event(table, result, 1 + (i % options->object_count), i / options->object_count);
+        check(rc == 0, "Unable to add event");
+    }
+    rc = sky_table_flush(table);
+    check(rc == 0, "Unable to flush table");
+    result->block_splits = sky_stats_global.block_splits - block_splits;
+
+    close_table(table);
+    return 0;
+
+error:
+    close_table(table);
+    return -1;
+}
+
+
+//==============================================================================
+//
+// Read Workloads
+//
+//==============================================================================
+
+// Counts the actions that follow the first action over the whole table.
+//
+// options - The options.
+// result  - The result to record to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int benchmark_next_action(Options *options, Result *result)
+{
+    int rc;
+    int32_t i;
+    sky_table *table = NULL;
+    sky_next_action_message *message = NULL;
+    sky_buffer *output = NULL;
+
+    rc = open_read_table(options, &table);
+    check(rc == 0, "Unable to open read table");
+
+    message = sky_next_action_message_create(); check_mem(message);
+    message->prior_action_ids = calloc(1, sizeof(*message->prior_action_ids));
+    check_mem(message->prior_action_ids);
+    message->prior_action_ids[0] = 1;
+    message->prior_action_id_count = 1;
+    output = sky_buffer_create(); check_mem(output);
+
+    for(i=0; i<options->iterations; i++) {
+        uint64_t scanned_events = sky_stats_global.scanned_events;
+        sky_buffer_clear(output);
+        int64_t t0 = now_ns();
+        rc = sky_next_action_message_process(message, table, output);
+        Result_record(result, t0, now_ns());
+        check(rc == 0, "Unable to process next action message");
+        result->event_count += sky_stats_global.scanned_events - scanned_events;
+    }
+
+    sky_buffer_free(output);
+    sky_next_action_message_free(message);
+    close_table(table);
+    return 0;
+
+error:
+    sky_buffer_free(output);
+    sky_next_action_message_free(message);
+    close_table(table);
+    return -1;
+}
+
+// Computes step counts in order to generate a directed acyclic graph (DAG)
+// of the transitions between actions.
+//
+// options - The options.
+// result  - The result to record to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int benchmark_dag(Options *options, Result *result)
+{
+    int rc;
+    int32_t i;
+    sky_table *table = NULL;
+    Step *steps = NULL;
+
+    rc = open_read_table(options, &table);
+    check(rc == 0, "Unable to open read table");
+    rc = sky_action_file_ensure_loaded(table->action_file);
+    check(rc == 0, "Unable to load actions");
+    int32_t action_count = (int32_t)table->action_file->action_count;
+
+    // Create a square matrix of structs.
+    steps = calloc(action_count*action_count + 1, sizeof(Step));
+    check_mem(steps);
+
+    // Loop for desired number of iterations.
+    for(i=0; i<options->iterations; i++) {
+        int64_t t0 = now_ns();
+        sky_path_iterator iterator;
+        sky_path_iterator_init(&iterator);
+
+        // Attach data file.
+        rc = sky_path_iterator_set_data_file(&iterator, table->data_file);
+        check(rc == 0, "Unable to initialze path iterator");
+
+        // Iterate over each path.
+        while(!iterator.eof) {
+            sky_action_id_t action_id, prev_action_id = 0;
+
+            // Retrieve the path pointer.
+            void *path_ptr;
+            rc = sky_path_iterator_get_ptr(&iterator, &path_ptr);
+            check(rc == 0, "Unable to retrieve the path iterator pointer");
+
+            // Loop over each event in the path.
+            sky_path_foreach_event(path_ptr, event_ptr) {
+                result->event_count++;
+
+                // Aggregate step information for registered actions.
+                action_id = sky_cursor_fast_get_action_id(event_ptr);
+                if(prev_action_id > 0 && prev_action_id <= action_count && action_id > 0 && action_id <= action_count) {
+                    int32_t index = ((prev_action_id-1)*action_count) + (action_id-1);
+                    steps[index].count++;
+                }
+
+                // Assign current action as previous action.
+                prev_action_id = action_id;
+            }
+
+            rc = sky_path_iterator_next(&iterator);
+            check(rc == 0, "Unable to find next path");
+        }
+        Result_record(result, t0, now_ns());
+    }
+
+    free(steps);
+    close_table(table);
+    return 0;
+
+error:
+    free(steps);
+    close_table(table);
+    return -1;
+}
+
+// Counts the events in the middle tenth of the table's time range.
+//
+// options - The options.
+// result  - The result to record to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int benchmark_window(Options *options, Result *result)
+{
+    int rc;
+    int32_t i;
+    sky_table *table = NULL;
+    sky_query *query = NULL;
+    sky_query_result *query_result = NULL;
+    struct tagbstring count_str = bsStatic("count");
+
+    rc = open_read_table(options, &table);
+    check(rc == 0, "Unable to open read table");
+
+    int64_t width = options->event_count / 10;
+    int64_t min = (options->event_count - width) / 2;
+    query = sky_query_create(); check_mem(query);
+    rc = sky_query_add_filter(query, SKY_QUERY_FIELD_TIMESTAMP, 0, min, min + width);
+    check(rc == 0, "Unable to add timestamp filter");
+    rc = sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    check(rc == 0, "Unable to add count aggregate");
+
+    for(i=0; i<options->iterations; i++) {
+        query_result = sky_query_result_create(query); check_mem(query_result);
+        int64_t t0 = now_ns();
+        rc = sky_query_execute(query, table->data_file, query_result);
+        Result_record(result, t0, now_ns());
+        check(rc == 0, "Unable to execute query");
+        result->event_count += query_result->event_count;
+        sky_query_result_free(query_result);
+        query_result = NULL;
+    }
+
+    sky_query_free(query);
+    close_table(table);
+    return 0;
+
+error:
+    sky_query_result_free(query_result);
+    sky_query_free(query);
+    close_table(table);
+    return -1;
+}
+
+// Finds the paths of random objects. Each lookup is one operation.
+//
+// options - The options.
+// result  - The result to record to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int benchmark_lookup(Options *options, Result *result)
+{
+    int rc;
+    uint32_t i;
+    sky_table *table = NULL;
+
+    rc = open_read_table(options, &table);
+    check(rc == 0, "Unable to open read table");
+
+    for(i=0; i<options->event_count; i++) {
+        void **paths = NULL;
+        uint32_t path_count = 0;
+        sky_object_id_t object_id = 1 + (rand() % options->object_count);
+        int64_t t0 = now_ns();
+        rc = sky_data_file_find_path(table->data_file, object_id, &paths, &path_count);
+        Result_record(result, t0, now_ns());
+        free(paths);
+        check(rc == 0, "Unable to find path");
+        result->event_count += path_count;
+    }
+
+    close_table(table);
+    return 0;
+
+error:
+    close_table(table);
+    return -1;
+}
+
+
+//==============================================================================
+//
+// Layout Workload
+//
+//==============================================================================
+
+//--------------------------------------
+// Dataset
+//--------------------------------------
+
+// Reads every event of the source table into memory. The source is opened
+// from its own path or is the read table when no source is given.
+//
+// dataset - The dataset.
+// options - The options.
+//
+// Returns 0 if successful, otherwise returns -1.
+int Dataset_load(Dataset *dataset, Options *options)
+{
+    int rc;
+    uint32_t capacity = 0;
+    sky_path_iterator iterator;
+    memset(dataset, 0, sizeof(*dataset));
+    sky_path_iterator_init(&iterator);
+
+    if(options->source != NULL) {
+        dataset->source = sky_table_create(); check_mem(dataset->source);
+        rc = sky_table_set_path(dataset->source, options->source);
+        check(rc == 0, "Unable to set path on source table");
+        rc = sky_table_open(dataset->source);
+        check(rc == 0, "Unable to open source table: %s", bdata(options->source));
+    }
+    else {
+        rc = open_read_table(options, &dataset->source);
+        check(rc == 0, "Unable to open read table");
+    }
+    rc = sky_table_flush(dataset->source);
+    check(rc == 0, "Unable to flush source table");
+
+    rc = sky_path_iterator_set_data_file(&iterator, dataset->source->data_file);
+    check(rc == 0, "Unable to initialize path iterator");
+    while(!iterator.eof) {
+        void *path_ptr;
+        rc = sky_path_iterator_get_ptr(&iterator, &path_ptr);
+        check(rc == 0, "Unable to retrieve the path iterator pointer");
+
+        sky_timestamp_t timestamp = 0;
+        sky_path_foreach_event(path_ptr, event_ptr) {
+            if(dataset->event_count == capacity) {
+                capacity = (capacity > 0 ? capacity * 2 : SKY_BENCH_BATCH_SIZE);
+                sky_event **events = realloc(dataset->events, capacity * sizeof(*events));
+                check_mem(events);
+                dataset->events = events;
+            }
+
+            // Delta timestamps are read relative to the previous event.
+            size_t sz;
+            sky_event *event = sky_event_create(iterator.current_object_id, timestamp, 0);
+            check_mem(event);
+            dataset->events[dataset->event_count++] = event;
+            rc = sky_event_unpack(event, event_ptr, &sz);
+            check(rc == 0, "Unable to unpack source event");
+            timestamp = event->timestamp;
+
+            if(dataset->event_count == 1 || timestamp < dataset->min_timestamp) {
+                dataset->min_timestamp = timestamp;
+            }
+            if(dataset->event_count == 1 || timestamp > dataset->max_timestamp) {
+                dataset->max_timestamp = timestamp;
+            }
+        }
+
+        rc = sky_path_iterator_next(&iterator);
+        check(rc == 0, "Unable to find next path");
+    }
+    sky_path_iterator_uninit(&iterator);
+    sky_table_release_cache(dataset->source);
+    check(dataset->event_count > 0, "Source table has no events");
+
+    return 0;
+
+error:
+    sky_path_iterator_uninit(&iterator);
+    return -1;
+}
+
+void Dataset_free_deps(Dataset *dataset)
+{
+    uint32_t i;
+    for(i=0; i<dataset->event_count; i++) {
+        sky_event_free(dataset->events[i]);
+    }
+    free(dataset->events);
+    dataset->events = NULL;
+    dataset->event_count = 0;
+    close_table(dataset->source);
+    dataset->source = NULL;
+}
+
+
+//--------------------------------------
+// Tables
+//--------------------------------------
+
+// Copies the actions and properties of the source table into a new table.
+// The copies must receive the same ids as the originals so that the events
+// can be loaded unchanged.
+//
+// source - The source table.
+// table  - The new table.
+// fixed  - Whether Int, Float and Boolean properties are stored as fixed
+//          values.
+//
+// Returns 0 if successful, otherwise returns -1.
+int copy_schema(sky_table *source, sky_table *table, bool fixed)
+{
+    int rc;
+    uint32_t i;
+
+    rc = sky_action_file_ensure_loaded(source->action_file);
+    check(rc == 0, "Unable to load source actions");
+    rc = sky_action_file_ensure_loaded(table->action_file);
+    check(rc == 0, "Unable to load actions");
+    for(i=0; i<source->action_file->action_count; i++) {
+        sky_action *source_action = source->action_file->actions[i];
+        sky_action *action = sky_action_create(); check_mem(action);
+        action->name = bstrcpy(source_action->name); check_mem(action->name);
+        rc = sky_action_file_add_action(table->action_file, action);
+        check(rc == 0, "Unable to add action");
+        check(action->id == source_action->id, "Source action ids are not sequential: %s", bdata(action->name));
+    }
+    rc = sky_action_file_save(table->action_file);
+    check(rc == 0, "Unable to save actions");
+
+    rc = sky_property_file_ensure_loaded(source->property_file);
+    check(rc == 0, "Unable to load source properties");
+    rc = sky_property_file_ensure_loaded(table->property_file);
+    check(rc == 0, "Unable to load properties");
+    for(i=0; i<source->property_file->property_count; i++) {
+        sky_property *source_property = source->property_file->properties[i];
+        sky_property *property = sky_property_create(); check_mem(property);
+        property->type = source_property->type;
+        property->name = bstrcpy(source_property->name); check_mem(property->name);
+        property->data_type = bstrcpy(source_property->data_type); check_mem(property->data_type);
+        property->fixed = (fixed && sky_property_is_fixed_data_type(property->data_type));
+        rc = sky_property_file_add_property(table->property_file, property);
+        check(rc == 0, "Unable to add property");
+        check(property->id == source_property->id, "Source property ids are not sequential: %s", bdata(property->name));
+    }
+    rc = sky_property_file_save(table->property_file);
+    check(rc == 0, "Unable to save properties");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Opens the table of a layout and block size in the working directory. A
+// fresh table is created with the schema of the source table.
+//
+// options    - The options.
+// dataset    - The dataset.
+// layout     - The layout.
+// block_size - The block size.
+// fresh      - Whether an existing table is replaced.
+// ret        - A pointer to where the table should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int open_layout_table(Options *options, Dataset *dataset, Layout layout,
+                      uint32_t block_size, bool fresh, sky_table **ret)
+{
+    int rc;
+    sky_table *table = NULL;
+    bstring path = bformat("%s/layout-%s-%u", bdata(options->path), layout_names[layout], block_size);
+    check_mem(path);
+
+    if(!sky_file_exists(options->path)) {
+        rc = mkdir(bdata(options->path), S_IRWXU);
+        check(rc == 0, "Unable to create working directory: %s", bdata(options->path));
+    }
+    if(fresh && sky_file_exists(path)) {
+        rc = sky_file_rm_r(path);
+        check(rc == 0, "Unable to remove table: %s", bdata(path));
+    }
+
+    table = sky_table_create(); check_mem(table);
+    table->default_block_size = block_size;
+    rc = sky_table_set_path(table, path);
+    check(rc == 0, "Unable to set path on table");
+    if(fresh) {
+        rc = sky_table_set_action_only(table, layout == LAYOUT_ACTION_ONLY);
+        check(rc == 0, "Unable to set table format");
+    }
+    rc = sky_table_open(table);
+    check(rc == 0, "Unable to open table: %s", bdata(path));
+    if(options->durability >= 0) {
+        rc = sky_table_set_durability(table, (sky_durability_e)options->durability);
+        check(rc == 0, "Unable to set table durability");
+    }
+
+    if(fresh) {
+        rc = copy_schema(dataset->source, table, layout == LAYOUT_FIXED);
+        check(rc == 0, "Unable to copy schema");
+    }
+
+    bdestroy(path);
+    *ret = table;
+    return 0;
+
+error:
+    bdestroy(path);
+    close_table(table);
+    *ret = NULL;
+    return -1;
+}
+
+// Closes a table and drops its extents from the page cache so that the
+// next scan after it is reopened reads from disk. Pages are only dropped on
+// systems that support it.
+//
+// table - The table.
+//
+// Returns 0 if successful, otherwise returns -1.
+int close_cold_table(sky_table *table)
+{
+    uint32_t i;
+    uint32_t path_count = table->data_file->extent_count;
+    bstring *paths = calloc(path_count + 1, sizeof(*paths)); check_mem(paths);
+    for(i=0; i<path_count; i++) {
+        paths[i] = sky_data_file_get_extent_path(table->data_file, i);
+        check_mem(paths[i]);
+    }
+    close_table(table);
+
+#if defined(POSIX_FADV_DONTNEED)
+    for(i=0; i<path_count; i++) {
+        int fd = open(bdata(paths[i]), O_RDONLY);
+        check(fd != -1, "Unable to open extent: %s", bdata(paths[i]));
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#endif
+
+    for(i=0; i<path_count; i++) {
+        bdestroy(paths[i]);
+    }
+    free(paths);
+    return 0;
+
+error:
+    for(i=0; paths && i<path_count; i++) {
+        bdestroy(paths[i]);
+    }
+    free(paths);
+    return -1;
+}
+
+// Adds the events of the dataset to the table of a layout in batches and
+// then applies the layout's compression or compaction. Only adding the
+// events and flushing the table are timed.
+//
+// dataset - The dataset.
+// layout  - The layout.
+// table   - The table.
+// result  - The result to record to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int load_layout_table(Dataset *dataset, Layout layout, sky_table *table,
+                      LayoutResult *result)
+{
+    int rc;
+    uint32_t i, j;
+    uint32_t *data_counts = NULL;
+
+    // Events are marked fixed by the table that they were last added to.
+    for(i=0; i<dataset->event_count; i++) {
+        for(j=0; j<dataset->events[i]->data_count; j++) {
+            dataset->events[i]->data[j]->fixed = false;
+        }
+    }
+
+    data_counts = calloc(SKY_BENCH_BATCH_SIZE, sizeof(*data_counts));
+    check_mem(data_counts);
+
+    int64_t t0 = now_ns();
+    for(i=0; i<dataset->event_count; i+=SKY_BENCH_BATCH_SIZE) {
+        sky_event **events = &dataset->events[i];
+        uint32_t count = dataset->event_count - i;
+        if(count > SKY_BENCH_BATCH_SIZE) count = SKY_BENCH_BATCH_SIZE;
+
+        // Action-only tables refuse data so it is hidden while it loads.
+        if(layout == LAYOUT_ACTION_ONLY) {
+            for(j=0; j<count; j++) {
+                data_counts[j] = events[j]->data_count;
+                events[j]->data_count = 0;
+            }
+        }
+        rc = sky_table_add_events(table, events, count);
+        if(layout == LAYOUT_ACTION_ONLY) {
+            for(j=0; j<count; j++) {
+                events[j]->data_count = data_counts[j];
+            }
+        }
+        check(rc == 0, "Unable to add events");
+    }
+    rc = sky_table_flush(table);
+    check(rc == 0, "Unable to flush table");
+    result->insert_elapsed = now_ns() - t0;
+    result->event_count = dataset->event_count;
+
+    if(layout == LAYOUT_COMPRESSED) {
+        rc = sky_table_compress(table, 0, 0, NULL);
+        check(rc == 0, "Unable to compress table");
+    }
+    else if(layout == LAYOUT_COMPACTED) {
+        rc = sky_table_compact(table, 100);
+        check(rc == 0, "Unable to compact table");
+    }
+    rc = sky_table_flush(table);
+    check(rc == 0, "Unable to flush table");
+
+    free(data_counts);
+    return 0;
+
+error:
+    free(data_counts);
+    return -1;
+}
+
+// Measures the space taken by a table's blocks. The stored bytes are the
+// bytes that each block needs to be reproduced, which is its compressed
+// data or everything up to its last non-zero byte. The allocated bytes are
+// the full size of every block.
+//
+// table  - The table.
+// result - The result to record to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int measure_layout_table(sky_table *table, LayoutResult *result)
+{
+    int rc;
+    uint32_t i;
+    sky_data_file *data_file = table->data_file;
+
+    result->block_count = data_file->block_count;
+    result->stored_bytes = 0;
+    result->allocated_bytes = (size_t)data_file->block_count * data_file->block_size;
+    for(i=0; i<data_file->block_count; i++) {
+        size_t length = 0;
+        rc = sky_block_get_stored_length(data_file->blocks[i], &length);
+        check(rc == 0, "Unable to determine stored block length");
+        result->stored_bytes += length;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Queries
+//--------------------------------------
+
+// Creates the queries that are run over every layout. The window query
+// counts the events in the middle tenth of the dataset's time range.
+//
+// queries - The queries.
+// dataset - The dataset.
+//
+// Returns 0 if successful, otherwise returns -1.
+int LayoutQueries_init(LayoutQueries *queries, Dataset *dataset)
+{
+    int rc;
+    struct tagbstring count_str = bsStatic("count");
+    memset(queries, 0, sizeof(*queries));
+
+    queries->next_action_message = sky_next_action_message_create();
+    check_mem(queries->next_action_message);
+    queries->next_action_message->prior_action_ids = calloc(1, sizeof(*queries->next_action_message->prior_action_ids));
+    check_mem(queries->next_action_message->prior_action_ids);
+    queries->next_action_message->prior_action_ids[0] = 1;
+    queries->next_action_message->prior_action_id_count = 1;
+
+    queries->dag_message = sky_dag_message_create();
+    check_mem(queries->dag_message);
+
+    int64_t width = (dataset->max_timestamp - dataset->min_timestamp) / 10;
+    int64_t min = dataset->min_timestamp + ((dataset->max_timestamp - dataset->min_timestamp - width) / 2);
+    queries->window_query = sky_query_create(); check_mem(queries->window_query);
+    rc = sky_query_add_filter(queries->window_query, SKY_QUERY_FIELD_TIMESTAMP, 0, min, min + width);
+    check(rc == 0, "Unable to add timestamp filter");
+    rc = sky_query_add_aggregate(queries->window_query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    check(rc == 0, "Unable to add count aggregate");
+
+    queries->output = sky_buffer_create(); check_mem(queries->output);
+    return 0;
+
+error:
+    return -1;
+}
+
+void LayoutQueries_free_deps(LayoutQueries *queries)
+{
+    sky_next_action_message_free(queries->next_action_message);
+    queries->next_action_message = NULL;
+    sky_dag_message_free(queries->dag_message);
+    queries->dag_message = NULL;
+    sky_query_free(queries->window_query);
+    queries->window_query = NULL;
+    sky_buffer_free(queries->output);
+    queries->output = NULL;
+}
+
+// Runs a single query over a table.
+//
+// queries     - The queries.
+// query       - The query to run.
+// table       - The table.
+// elapsed     - A pointer to where the time taken is added.
+// event_count - A pointer to where the number of scanned events is added.
+//
+// Returns 0 if successful, otherwise returns -1.
+int run_layout_query(LayoutQueries *queries, LayoutQuery query,
+                     sky_table *table, int64_t *elapsed,
+                     uint64_t *event_count)
+{
+    int rc;
+    sky_query_result *result = NULL;
+    uint64_t scanned_events = sky_stats_global.scanned_events;
+    sky_buffer_clear(queries->output);
+
+    int64_t t0 = now_ns();
+    switch(query) {
+        case LAYOUT_QUERY_NEXT_ACTION: {
+            rc = sky_next_action_message_process(queries->next_action_message, table, queries->output);
+            check(rc == 0, "Unable to process next action message");
+            break;
+        }
+
+        case LAYOUT_QUERY_DAG: {
+            rc = sky_dag_message_process(queries->dag_message, table, queries->output);
+            check(rc == 0, "Unable to process dag message");
+            break;
+        }
+
+        default: {
+            result = sky_query_result_create(queries->window_query); check_mem(result);
+            rc = sky_query_execute(queries->window_query, table->data_file, result);
+            check(rc == 0, "Unable to execute window query");
+            break;
+        }
+    }
+    *elapsed += now_ns() - t0;
+    *event_count += sky_stats_global.scanned_events - scanned_events;
+
+    sky_query_result_free(result);
+    sky_table_release_cache(table);
+    return 0;
+
+error:
+    sky_query_result_free(result);
+    sky_table_release_cache(table);
+    return -1;
+}
+
+
+//--------------------------------------
+// Reporting
+//--------------------------------------
+
+// Returns the number of items handled per second over a time in
+// nanoseconds.
+double per_second(uint64_t count, int64_t elapsed)
+{
+    return (elapsed > 0 ? (double)count * 1000000000 / elapsed : 0);
+}
+
+// Prints the measurements of a layout.
+//
+// options - The options.
+// result  - The result of the layout.
+void report_layout(Options *options, LayoutResult *result)
+{
+    uint32_t i;
+    double stored = (double)result->stored_bytes / result->event_count;
+    double allocated = (double)result->allocated_bytes / result->event_count;
+    double insert = per_second(result->event_count, result->insert_elapsed);
+
+    if(options->format == FORMAT_JSON) {
+        printf("{\"layout\":\"%s\",\"blockSize\":%u,\"events\":%" PRIu64
+               ",\"blocks\":%u,\"storedBytesPerEvent\":%.3f,\"allocatedBytesPerEvent\":%.3f"
+               ",\"insertEventsPerSecond\":%.1f,\"queries\":{",
+            result->name, result->block_size, result->event_count,
+            result->block_count, stored, allocated, insert);
+        for(i=0; i<LAYOUT_QUERY_COUNT; i++) {
+            printf("%s\"%s\":{\"hotEventsPerSecond\":%.1f,\"coldEventsPerSecond\":%.1f}",
+                (i > 0 ? "," : ""), layout_query_names[i],
+                per_second(result->hot_event_counts[i], result->hot_elapsed[i]),
+                per_second(result->cold_event_counts[i], result->cold_elapsed[i]));
+        }
+        printf("}}\n");
+    }
+    else {
+        printf("%-12s %8u %10" PRIu64 " %10.2f %10.2f %12.1f",
+            result->name, result->block_size, result->event_count, stored,
+            allocated, insert);
+        for(i=0; i<LAYOUT_QUERY_COUNT; i++) {
+            printf(" %12.1f %12.1f",
+                per_second(result->hot_event_counts[i], result->hot_elapsed[i]),
+                per_second(result->cold_event_counts[i], result->cold_elapsed[i]));
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+// Prints the column names of the text report.
+void report_layout_header()
+{
+    uint32_t i;
+    printf("%-12s %8s %10s %10s %10s %12s", "layout", "block", "events",
+        "stored B/e", "alloc B/e", "insert e/s");
+    for(i=0; i<LAYOUT_QUERY_COUNT; i++) {
+        bstring hot = bformat("%s hot", layout_query_names[i]);
+        bstring cold = bformat("%s cold", layout_query_names[i]);
+        printf(" %12s %12s", (hot ? bdata(hot) : ""), (cold ? bdata(cold) : ""));
+        bdestroy(hot);
+        bdestroy(cold);
+    }
+    printf("\n");
+}
+
+
+//--------------------------------------
+// Benchmark
+//--------------------------------------
+
+// Loads the dataset into a fresh table for a layout and block size and
+// runs every query over it with a warm cache and then with a cold cache.
+//
+// options    - The options.
+// dataset    - The dataset.
+// queries    - The queries.
+// layout     - The layout.
+// block_size - The block size.
+// result     - The result to record to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int benchmark_layout(Options *options, Dataset *dataset, LayoutQueries *queries,
+                     Layout layout, uint32_t block_size, LayoutResult *result)
+{
+    int rc;
+    int32_t i;
+    uint32_t j;
+    sky_table *table = NULL;
+    memset(result, 0, sizeof(*result));
+    result->name = layout_names[layout];
+    result->block_size = block_size;
+
+    rc = open_layout_table(options, dataset, layout, block_size, true, &table);
+    check(rc == 0, "Unable to open layout table");
+    rc = load_layout_table(dataset, layout, table, result);
+    check(rc == 0, "Unable to load layout table");
+    rc = measure_layout_table(table, result);
+    check(rc == 0, "Unable to measure layout table");
+
+    // Each query is run once to warm the cache before it is timed.
+    for(j=0; j<LAYOUT_QUERY_COUNT; j++) {
+        int64_t elapsed = 0;
+        uint64_t event_count = 0;
+        rc = run_layout_query(queries, j, table, &elapsed, &event_count);
+        check(rc == 0, "Unable to warm query: %s", layout_query_names[j]);
+        for(i=0; i<options->iterations; i++) {
+            rc = run_layout_query(queries, j, table, &result->hot_elapsed[j], &result->hot_event_counts[j]);
+            check(rc == 0, "Unable to run query: %s", layout_query_names[j]);
+        }
+    }
+
+    // Each cold query starts from a reopened table with nothing cached.
+    for(j=0; j<LAYOUT_QUERY_COUNT; j++) {
+        rc = close_cold_table(table);
+        table = NULL;
+        check(rc == 0, "Unable to drop cached table");
+        rc = open_layout_table(options, dataset, layout, block_size, false, &table);
+        check(rc == 0, "Unable to reopen layout table");
+        rc = run_layout_query(queries, j, table, &result->cold_elapsed[j], &result->cold_event_counts[j]);
+        check(rc == 0, "Unable to run cold query: %s", layout_query_names[j]);
+    }
+
+    close_table(table);
+    return 0;
+
+error:
+    close_table(table);
+    return -1;
+}
+
+// Compares the selected layouts at every block size over the same dataset.
+//
+// options - The options.
+//
+// Returns 0 if successful, otherwise returns -1.
+int benchmark_layouts(Options *options)
+{
+    int rc;
+    int i;
+    uint32_t j;
+    bool found = false;
+    Dataset dataset;
+    LayoutQueries queries;
+    memset(&dataset, 0, sizeof(dataset));
+    memset(&queries, 0, sizeof(queries));
+
+    struct bstrList *block_sizes = bsplit(options->block_sizes, ',');
+    check_mem(block_sizes);
+    for(i=0; i<block_sizes->qty; i++) {
+        check(atol(bdatae(block_sizes->entry[i], "")) > 0, "Invalid block size: %s", bdatae(block_sizes->entry[i], ""));
+    }
+
+    rc = Dataset_load(&dataset, options);
+    check(rc == 0, "Unable to load dataset");
+    rc = LayoutQueries_init(&queries, &dataset);
+    check(rc == 0, "Unable to create queries");
+
+    if(options->format == FORMAT_TEXT) {
+        report_layout_header();
+    }
+    for(j=0; j<LAYOUT_COUNT; j++) {
+        if(!is_listed(options->layouts, layout_names[j])) {
+            continue;
+        }
+        found = true;
+
+        for(i=0; i<block_sizes->qty; i++) {
+            LayoutResult result;
+            uint32_t block_size = (uint32_t)atol(bdata(block_sizes->entry[i]));
+            rc = benchmark_layout(options, &dataset, &queries, j, block_size, &result);
+            check(rc == 0, "Layout failed: %s (%u)", layout_names[j], block_size);
+            report_layout(options, &result);
+        }
+    }
+    check(found, "No layouts matched: %s", bdata(options->layouts));
+
+    LayoutQueries_free_deps(&queries);
+    Dataset_free_deps(&dataset);
+    bstrListDestroy(block_sizes);
+    return 0;
+
+error:
+    LayoutQueries_free_deps(&queries);
+    Dataset_free_deps(&dataset);
+    bstrListDestroy(block_sizes);
+    return -1;
+}
+
+
+//==============================================================================
+//
+// Network Workload
+//
+//==============================================================================
+
+// Parses the weights of the message types sent by the network benchmark.
+// The mix is a comma separated list of NAME=WEIGHT pairs such as
+// "eadd=80,next_action=10,multi=10". Types that are not listed are not sent.
+//
+// options - The options.
+// str     - The mix.
+//
+// Returns 0 if successful, otherwise returns -1.
+int parse_mix(Options *options, const char *str)
+{
+    int i;
+    uint32_t j, total = 0;
+    struct bstrList *list = NULL;
+    bstring mix = bfromcstr(str); check_mem(mix);
+
+    memset(options->mix, 0, sizeof(options->mix));
+    list = bsplit(mix, ','); check_mem(list);
+    for(i=0; i<list->qty; i++) {
+        int index = bstrchr(list->entry[i], '=');
+        check(index > 0, "Invalid mix entry: %s", bdata(list->entry[i]));
+
+        bool found = false;
+        for(j=0; j<NET_MESSAGE_COUNT; j++) {
+            if(bisstemeqblk(list->entry[i], net_message_names[j], index) == 1 && (int)strlen(net_message_names[j]) == index) {
+                options->mix[j] = (uint32_t)atol(bdataofs(list->entry[i], index+1));
+                total += options->mix[j];
+                found = true;
+            }
+        }
+        check(found, "Invalid mix message: %s", bdata(list->entry[i]));
+    }
+    check(total > 0, "Mix requires at least one message");
+
+    bstrListDestroy(list);
+    bdestroy(mix);
+    return 0;
+
+error:
+    bstrListDestroy(list);
+    bdestroy(mix);
+    return -1;
+}
+
+// Opens a connection to the server. An address that starts with a slash is
+// treated as the path of a Unix domain socket, otherwise it is HOST:PORT.
+//
+// address - The address of the server.
+// ret     - A pointer to where the socket descriptor should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int client_connect(bstring address, int *ret)
+{
+    int rc;
+    int sock = -1;
+    struct addrinfo *info = NULL;
+    bstring host = NULL;
+
+    if(bchar(address, 0) == '/') {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        check((size_t)blength(address) < sizeof(addr.sun_path), "Socket path too long: %s", bdata(address));
+        memcpy(addr.sun_path, bdata(address), blength(address));
+
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        check(sock != -1, "Unable to create socket");
+        rc = connect(sock, (struct sockaddr*)&addr, sizeof(addr));
+        check(rc == 0, "Unable to connect to %s", bdata(address));
+    }
+    else {
+        int index = bstrrchr(address, ':');
+        check(index > 0, "Address must be HOST:PORT: %s", bdata(address));
+        host = bmidstr(address, 0, index); check_mem(host);
+
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        rc = getaddrinfo(bdata(host), bdataofs(address, index+1), &hints, &info);
+        check(rc == 0, "Unable to resolve %s", bdata(address));
+
+        sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        check(sock != -1, "Unable to create socket");
+        rc = connect(sock, info->ai_addr, info->ai_addrlen);
+        check(rc == 0, "Unable to connect to %s", bdata(address));
+
+        int flag = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    }
+
+    if(info) freeaddrinfo(info);
+    bdestroy(host);
+    *ret = sock;
+    return 0;
+
+error:
+    if(info) freeaddrinfo(info);
+    bdestroy(host);
+    if(sock != -1) close(sock);
+    *ret = -1;
+    return -1;
+}
+
+// Creates a message header for the benchmark table.
+sky_message_header *create_header(Options *options, const char *name)
+{
+    sky_message_header *header = sky_message_header_create(); check_mem(header);
+    header->version = 1;
+    header->name = bfromcstr(name); check_mem(header->name);
+    header->type = sky_message_type_from_name(header->name);
+    header->database_name = bstrcpy(options->database_name); check_mem(header->database_name);
+    header->table_name = bstrcpy(options->table_name); check_mem(header->table_name);
+    return header;
+
+error:
+    sky_message_header_free(header);
+    return NULL;
+}
+
+// Connects a client and creates the messages that it sends.
+//
+// client  - The client.
+// options - The options.
+// index   - The index of the connection.
+// count   - The number of messages to send.
+//
+// Returns 0 if successful, otherwise returns -1.
+int Client_init(Client *client, Options *options, uint32_t index, uint32_t count)
+{
+    int rc;
+    uint32_t i;
+    int sock = -1, out = -1;
+
+    memset(client, 0, sizeof(*client));
+    client->options = options;
+    client->index = index;
+    client->message_count = count;
+    client->seed = options->seed + index;
+
+    for(i=0; i<NET_MESSAGE_COUNT; i++) {
+        client->headers[i] = create_header(options, net_message_names[i]);
+        check_mem(client->headers[i]);
+        client->latencies[i] = calloc(count > 0 ? count : 1, sizeof(*client->latencies[i]));
+        check_mem(client->latencies[i]);
+    }
+    client->eadd_message = sky_eadd_message_create(); check_mem(client->eadd_message);
+    client->next_action_message = sky_next_action_message_create(); check_mem(client->next_action_message);
+    client->next_action_message->prior_action_ids = calloc(1, sizeof(sky_action_id_t));
+    check_mem(client->next_action_message->prior_action_ids);
+    client->next_action_message->prior_action_ids[0] = 1;
+    client->next_action_message->prior_action_id_count = 1;
+    client->multi_message = sky_multi_message_create(); check_mem(client->multi_message);
+    client->multi_message->message_count = SKY_BENCH_MULTI_SIZE;
+    client->response = sky_buffer_create(); check_mem(client->response);
+
+    // Responses are read and messages are written through separate streams
+    // on the same socket.
+    rc = client_connect(options->connect, &sock);
+    check(rc == 0, "Unable to connect client");
+    client->input = fdopen(sock, "r");
+    check(client->input != NULL, "Unable to open input stream");
+    out = dup(sock);
+    check(out != -1, "Unable to duplicate socket");
+    client->output = fdopen(out, "w");
+    check(client->output != NULL, "Unable to open output stream");
+
+    return 0;
+
+error:
+    if(sock != -1 && client->input == NULL) close(sock);
+    if(out != -1 && client->output == NULL) close(out);
+    return -1;
+}
+
+void Client_free_deps(Client *client)
+{
+    uint32_t i;
+    if(client->input) fclose(client->input);
+    if(client->output) fclose(client->output);
+    for(i=0; i<NET_MESSAGE_COUNT; i++) {
+        sky_message_header_free(client->headers[i]);
+        free(client->latencies[i]);
+    }
+    sky_eadd_message_free(client->eadd_message);
+    sky_next_action_message_free(client->next_action_message);
+    sky_multi_message_free(client->multi_message);
+    sky_buffer_free(client->response);
+    memset(client, 0, sizeof(*client));
+}
+
+// Writes an EADD message for a random object and action.
+//
+// client - The client.
+// seq    - The sequence number of the event on this connection.
+//
+// Returns 0 if successful, otherwise returns -1.
+int client_write_eadd(Client *client, uint64_t seq)
+{
+    int rc;
+    sky_eadd_message *message = client->eadd_message;
+    message->object_id = 1 + (rand_r(&client->seed) % client->options->object_count);
+    message->timestamp = (sky_timestamp_t)((seq * client->options->connection_count) + client->index);
+    message->action_id = 1 + (rand_r(&client->seed) % SKY_BENCH_ACTION_COUNT);
+
+    rc = sky_message_header_pack(client->headers[NET_MESSAGE_EADD], client->output);
+    check(rc == 0, "Unable to pack EADD header");
+    rc = sky_eadd_message_pack(message, client->output);
+    check(rc == 0, "Unable to pack EADD message");
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sends a single message and waits for all of its responses.
+//
+// client - The client.
+// type   - The type of message to send.
+// seq    - The sequence number of the message on this connection.
+//
+// Returns 0 if successful, otherwise returns -1.
+int client_send(Client *client, NetMessageType type, uint64_t seq)
+{
+    int rc;
+    uint32_t i, response_count = 1;
+
+    switch(type) {
+        case NET_MESSAGE_EADD: {
+            rc = client_write_eadd(client, seq);
+            check(rc == 0, "Unable to write EADD message");
+            break;
+        }
+        case NET_MESSAGE_NEXT_ACTION: {
+            rc = sky_message_header_pack(client->headers[type], client->output);
+            check(rc == 0, "Unable to pack NEXT_ACTION header");
+            rc = sky_next_action_message_pack(client->next_action_message, client->output);
+            check(rc == 0, "Unable to pack NEXT_ACTION message");
+            break;
+        }
+        case NET_MESSAGE_MULTI: {
+            rc = sky_message_header_pack(client->headers[type], client->output);
+            check(rc == 0, "Unable to pack MULTI header");
+            rc = sky_multi_message_pack(client->multi_message, client->output);
+            check(rc == 0, "Unable to pack MULTI message");
+            for(i=0; i<SKY_BENCH_MULTI_SIZE; i++) {
+                rc = client_write_eadd(client, (seq * SKY_BENCH_MULTI_SIZE) + i);
+                check(rc == 0, "Unable to write MULTI child");
+            }
+            response_count = SKY_BENCH_MULTI_SIZE;
+            break;
+        }
+        default: sentinel("Invalid network message type: %d", type);
+    }
+    rc = fflush(client->output);
+    check(rc == 0, "Unable to send message");
+
+    // A MULTI message is answered with one response per child.
+    for(i=0; i<response_count; i++) {
+        sky_buffer_clear(client->response);
+        rc = sky_minipack_fread_elem(client->input, client->response);
+        check(rc == 0, "Unable to read response");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Selects the type of the next message using the weights of the mix.
+NetMessageType client_choose_message(Client *client)
+{
+    uint32_t i, total = 0;
+    for(i=0; i<NET_MESSAGE_COUNT; i++) {
+        total += client->options->mix[i];
+    }
+    uint32_t value = rand_r(&client->seed) % total;
+    for(i=0; i<NET_MESSAGE_COUNT; i++) {
+        if(value < client->options->mix[i]) {
+            return (NetMessageType)i;
+        }
+        value -= client->options->mix[i];
+    }
+    return NET_MESSAGE_EADD;
+}
+
+// Sends the messages of a single connection. When a rate is given the
+// messages are spread evenly over time, otherwise the next message is sent
+// as soon as the previous one has been answered.
+//
+// arg - The client.
+//
+// Returns NULL.
+void *client_run(void *arg)
+{
+    int rc;
+    uint64_t i;
+    Client *client = (Client*)arg;
+    int64_t interval = 0;
+    if(client->options->rate > 0) {
+        interval = ((int64_t)client->options->connection_count * 1000000000) / client->options->rate;
+    }
+
+    int64_t start = now_ns();
+    for(i=0; i<client->message_count; i++) {
+        if(interval > 0) {
+            int64_t delay = (start + ((int64_t)i * interval)) - now_ns();
+            if(delay > 0) {
+                struct timespec ts = {delay / 1000000000, delay % 1000000000};
+                nanosleep(&ts, NULL);
+            }
+        }
+
+        NetMessageType type = client_choose_message(client);
+        int64_t t0 = now_ns();
+        rc = client_send(client, type, i);
+        check(rc == 0, "Unable to send %s message", net_message_names[type]);
+        client->latencies[type][client->counts[type]++] = now_ns() - t0;
+    }
+
+    client->rc = 0;
+    return NULL;
+
+error:
+    client->rc = -1;
+    return NULL;
+}
+
+// Adds the latencies of each client for a message type to a result.
+//
+// result  - The result.
+// clients - The clients.
+// count   - The number of clients.
+// type    - The message type or NET_MESSAGE_COUNT for every type.
+void merge_latencies(Result *result, Client *clients, uint32_t count, uint32_t type)
+{
+    uint32_t i, j;
+    uint64_t k;
+    for(i=0; i<count; i++) {
+        for(j=0; j<NET_MESSAGE_COUNT; j++) {
+            if(type != NET_MESSAGE_COUNT && type != j) continue;
+            for(k=0; k<clients[i].counts[j]; k++) {
+                result->latencies[result->latency_count++] = clients[i].latencies[j][k];
+            }
+            result->op_count += clients[i].counts[j];
+            if(j == NET_MESSAGE_EADD) {
+                result->event_count += clients[i].counts[j];
+            }
+            else if(j == NET_MESSAGE_MULTI) {
+                result->event_count += clients[i].counts[j] * SKY_BENCH_MULTI_SIZE;
+            }
+        }
+    }
+}
+
+// Replays a mix of messages against a running server over concurrent
+// connections and reports the results for each message type and overall.
+//
+// options - The options.
+//
+// Returns 0 if successful, otherwise returns -1.
+int benchmark_network(Options *options)
+{
+    int rc;
+    uint32_t i;
+    uint32_t count = options->connection_count;
+    Client *clients = NULL;
+    pthread_t *threads = NULL;
+    Result result;
+    memset(&result, 0, sizeof(result));
+
+    clients = calloc(count, sizeof(*clients)); check_mem(clients);
+    threads = calloc(count, sizeof(*threads)); check_mem(threads);
+    for(i=0; i<count; i++) {
+        uint32_t message_count = (options->event_count / count) + (i < options->event_count % count ? 1 : 0);
+        rc = Client_init(&clients[i], options, i, message_count);
+        check(rc == 0, "Unable to initialize client");
+    }
+
+    // Run every connection concurrently.
+    int64_t t0 = now_ns();
+    for(i=0; i<count; i++) {
+        rc = pthread_create(&threads[i], NULL, client_run, &clients[i]);
+        check(rc == 0, "Unable to start client thread");
+    }
+    for(i=0; i<count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    int64_t elapsed = now_ns() - t0;
+    for(i=0; i<count; i++) {
+        check(clients[i].rc == 0, "Client %d failed", i);
+    }
+
+    // Report each message type that was sent and then every message.
+    for(i=0; i<=NET_MESSAGE_COUNT; i++) {
+        if(i < NET_MESSAGE_COUNT && options->mix[i] == 0) continue;
+        rc = Result_init(&result, (i < NET_MESSAGE_COUNT ? net_result_names[i] : "network"), options->event_count);
+        check(rc == 0, "Unable to initialize result");
+        merge_latencies(&result, clients, count, i);
+        result.elapsed = elapsed;
+        report(options, &result);
+        Result_free_deps(&result);
+    }
+
+    for(i=0; i<count; i++) {
+        Client_free_deps(&clients[i]);
+    }
+    free(clients);
+    free(threads);
+    return 0;
+
+error:
+    Result_free_deps(&result);
+    for(i=0; clients && i<count; i++) {
+        Client_free_deps(&clients[i]);
+    }
+    free(clients);
+    free(threads);
+    return -1;
+}
+
+
+//==============================================================================
+//
+// Main
+//
+//==============================================================================
+
+// Checks whether a name is in a comma separated list or the list is "all".
+bool is_listed(bstring names, const char *name)
+{
+    int i;
+    bool selected = false;
+    struct bstrList *list = bsplit(names, ',');
+    if(list == NULL) return false;
+    for(i=0; i<list->qty; i++) {
+        if(biseqcstr(list->entry[i], "all") == 1 || biseqcstr(list->entry[i], name) == 1) {
+            selected = true;
+        }
+    }
+    bstrListDestroy(list);
+    return selected;
+}
+
+// Checks whether a workload was selected on the command line.
+bool is_selected(Options *options, const char *name)
+{
+    return is_listed(options->workloads, name);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t i;
+    int rc = 0;
+    bool found = false;
+
+    // Parse command line options.
+    Options *options = parseopts(argc, argv);
+    srand(options->seed);
+
+    // Benchmark a running server instead of a local table.
+    if(options->connect != NULL) {
+        rc = (benchmark_network(options) == 0 ? 0 : 1);
+        Options_free(options);
+        return rc;
+    }
+
+    // Compare storage layouts instead of running the workloads.
+    if(options->layouts != NULL) {
+        rc = (benchmark_layouts(options) == 0 ? 0 : 1);
+        Options_free(options);
+        return rc;
+    }
+
+    // Run each selected workload in order.
+    for(i=0; i<WORKLOAD_COUNT; i++) {
+        if(!is_selected(options, workload_names[i])) {
+            continue;
+        }
+        found = true;
+
+        Result result;
+        uint64_t capacity = options->event_count;
+        if((uint64_t)options->iterations > capacity) capacity = options->iterations;
+        if(Result_init(&result, workload_names[i], capacity) != 0) {
+            rc = 1;
+            break;
+        }
+        if(workload_funcs[i](options, &result) == 0) {
+            report(options, &result);
+        }
+        else {
+            fprintf(stderr, "Error: Workload failed: %s\n", workload_names[i]);
+            rc = 1;
+        }
+        Result_free_deps(&result);
+    }
+
+    if(!found) {
+        fprintf(stderr, "Error: No workloads matched: %s\n\n", bdata(options->workloads));
+        rc = 1;
+    }
+
+    // Clean up.
+    Options_free(options);
+
+    return rc;
+}
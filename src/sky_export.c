@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "bstring.h"
+#include "dbg.h"
+#include "mem.h"
+#include "table.h"
+#include "exporter.h"
+#include "version.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The sky-export application writes every event in a table to standard
+// output or to a file. The binary format can be loaded back into a table
+// with the same actions and properties by the importer and the JSON format
+// writes one event per line. Tables must not be open in a running server
+// while they are exported.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef struct Options {
+    bstring path;
+    bstring output_path;
+    sky_exporter_format_e format;
+} Options;
+
+
+//==============================================================================
+//
+// Command Line Arguments
+//
+//==============================================================================
+
+void print_version();
+void usage();
+
+Options *parseopts(int argc, char **argv)
+{
+    Options *options = (Options*)calloc(1, sizeof(Options));
+    check_mem(options);
+    options->format = SKY_EXPORTER_FORMAT_BINARY;
+
+    // Command line options.
+    struct option long_options[] = {
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
+        {"version", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    // Parse command line options.
+    while(1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "f:o:vh", long_options, &option_index);
+
+        // Check for end of options.
+        if(c == -1) {
+            break;
+        }
+
+        // Parse each option.
+        switch(c) {
+            case 'f': {
+                if(strcmp(optarg, "json") == 0) {
+                    options->format = SKY_EXPORTER_FORMAT_JSON;
+                }
+                else if(strcmp(optarg, "binary") == 0) {
+                    options->format = SKY_EXPORTER_FORMAT_BINARY;
+                }
+                else {
+                    fprintf(stderr, "Error: Invalid format: %s\n\n", optarg);
+                    exit(1);
+                }
+                break;
+            }
+
+            case 'o': {
+                options->output_path = bfromcstr(optarg);
+                check_mem(options->output_path);
+                break;
+            }
+
+            case 'v': {
+                print_version();
+                break;
+            }
+
+            case 'h': {
+                usage();
+                break;
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    // Retrieve the table path as the non-getopts option.
+    if(argc < 1) {
+        fprintf(stderr, "Error: Table path required.\n\n");
+        exit(1);
+    }
+    options->path = bfromcstr(argv[0]);
+    check_mem(options->path);
+
+    return options;
+
+error:
+    exit(1);
+}
+
+void Options_free(Options *options)
+{
+    if(options) {
+        bdestroy(options->path);
+        bdestroy(options->output_path);
+        free(options);
+    }
+}
+
+
+//==============================================================================
+//
+// Usage & Version
+//
+//==============================================================================
+
+void print_version()
+{
+    printf("sky-export " SKY_VERSION "\n");
+    exit(0);
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: sky-export [OPTIONS] TABLE_PATH\n\n");
+    fprintf(stderr, "  -f, --format FORMAT   binary (default) or json\n");
+    fprintf(stderr, "  -o, --output PATH     file to write to instead of standard output\n\n");
+    exit(0);
+}
+
+
+//==============================================================================
+//
+// Main
+//
+//==============================================================================
+
+int main(int argc, char **argv)
+{
+    int rc;
+    int fd = STDOUT_FILENO;
+    sky_table *table = NULL;
+    sky_exporter *exporter = NULL;
+    time_t t0 = time(NULL);
+
+    // Parse command line options.
+    Options *options = parseopts(argc, argv);
+
+    // Open the output file.
+    if(options->output_path != NULL) {
+        fd = open(bdata(options->output_path), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        check(fd >= 0, "Unable to open output file: %s", bdata(options->output_path));
+    }
+
+    // Open the table.
+    table = sky_table_create(); check_mem(table);
+    table->path = bstrcpy(options->path); check_mem(table->path);
+    rc = sky_table_open(table);
+    check(rc == 0, "Unable to open table: %s", bdata(options->path));
+
+    // Export the table.
+    exporter = sky_exporter_create(); check_mem(exporter);
+    exporter->format = options->format;
+    rc = sky_exporter_export(exporter, table, fd);
+    check(rc == 0, "Unable to export table: %s", bdata(options->path));
+    fprintf(stderr, "Exported %" PRIu64 " events from %s in %ld seconds\n", exporter->event_count, bdata(options->path), (time(NULL)-t0));
+
+    // Clean up.
+    sky_exporter_free(exporter);
+    sky_table_close(table);
+    sky_table_free(table);
+    if(fd != STDOUT_FILENO) close(fd);
+    Options_free(options);
+
+    return 0;
+
+error:
+    sky_exporter_free(exporter);
+    if(table && table->opened) sky_table_close(table);
+    sky_table_free(table);
+    if(fd >= 0 && fd != STDOUT_FILENO) close(fd);
+    Options_free(options);
+    return 1;
+}
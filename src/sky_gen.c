@@ -1,7 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 #include <time.h>
+#include <math.h>
+#include <pthread.h>
 
 #include "bstring.h"
 #include "dbg.h"
@@ -20,6 +23,51 @@
 // The sky-gen application is used for generating random datasets for
 // performance testing. It allows a user to set options such as the number of
 // paths to generate and the average number of events to generate per path.
+//
+// The shape of the data can be skewed to look like production data:
+//
+//   --object-skew  - Object activity follows a Zipf distribution with the
+//                    given exponent so that a few objects have most of the
+//                    events. Zero gives every path a uniform random length.
+//   --action-skew  - Action popularity follows a power law with the given
+//                    exponent. Zero picks actions uniformly.
+//   --burst        - Events arrive in sessions of this many events on
+//                    average. Events in a session are seconds apart while
+//                    sessions are about a day apart.
+//   --properties   - Every event sets about half of this many properties.
+//                    Properties cycle through the Int, Float, Boolean and
+//                    String data types and alternate between object and
+//                    action properties. Strings are drawn from a vocabulary
+//                    of --string-cardinality values using the action skew.
+//
+// Objects are split into work units of consecutive object ids. Generator
+// threads take units in turn and queue their events in sorted batches, and
+// the main thread adds the batches to the table through the bulk insert path
+// in unit order. Every object has its own random number stream derived from
+// the seed and the object id, so the same options and seed produce the same
+// table regardless of the number of threads.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+#define SKY_GEN_OBJECTS_PER_UNIT 64
+
+#define SKY_GEN_DEFAULT_BATCH_SIZE 10000
+
+#define SKY_GEN_MAX_QUEUED_BATCHES 4
+
+// The first timestamp generated (2012-01-01) and the range over which paths
+// start, in microseconds.
+#define SKY_GEN_BASE_TIMESTAMP 1325376000000000LL
+#define SKY_GEN_START_RANGE (365LL * 86400 * 1000000)
+
+// The mean gap between events in a session and between sessions.
+#define SKY_GEN_EVENT_GAP (30.0 * 1000000)
+#define SKY_GEN_SESSION_GAP (86400.0 * 1000000)
 
 
 //==============================================================================
@@ -35,8 +83,59 @@ typedef struct Options {
     int32_t avg_event_count;
     int32_t action_count;
     int32_t seed;
+    double object_skew;
+    double action_skew;
+    int32_t burst;
+    int32_t property_count;
+    int32_t string_cardinality;
+    int32_t thread_count;
+    int32_t batch_size;
 } Options;
 
+// A cumulative distribution over the values 1 to count.
+typedef struct Distribution {
+    double *cdf;
+    uint32_t count;
+} Distribution;
+
+// A sorted batch of generated events. The last batch of a unit is flagged
+// so that the inserter knows when to move on to the next unit.
+typedef struct Batch {
+    sky_event **events;
+    uint32_t event_count;
+    bool last;
+    struct Batch *next;
+} Batch;
+
+// The batches queued by a single generator thread.
+typedef struct Queue {
+    Batch *head;
+    Batch *tail;
+    uint32_t count;
+} Queue;
+
+// The state shared between the generator threads and the inserter.
+typedef struct Generator {
+    Options *options;
+    sky_table *table;
+    uint32_t unit_count;
+    double object_weight_sum;
+    Distribution actions;
+    Distribution strings;
+    bstring *string_values;
+    sky_property_id_t *property_ids;
+    Queue *queues;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool failed;
+} Generator;
+
+// The arguments for a single generator thread.
+typedef struct Worker {
+    Generator *generator;
+    uint32_t index;
+} Worker;
+
 
 //==============================================================================
 //
@@ -44,11 +143,15 @@ typedef struct Options {
 //
 //==============================================================================
 
+void usage();
+
 Options *parseopts(int argc, char **argv)
 {
     Options *options = (Options*)calloc(1, sizeof(Options));
     check_mem(options);
-    
+    options->burst = 1;
+    options->string_cardinality = 1000;
+
     // Command line options.
     struct option long_options[] = {
         {"table-name", required_argument, 0, 't'},
@@ -56,19 +159,27 @@ Options *parseopts(int argc, char **argv)
         {"avg-event-count", required_argument, 0, 'e'},
         {"action-count", required_argument, 0, 'a'},
         {"seed", optional_argument, 0, 's'},
+        {"object-skew", required_argument, 0, 'z'},
+        {"action-skew", required_argument, 0, 'k'},
+        {"burst", required_argument, 0, 'b'},
+        {"properties", required_argument, 0, 'n'},
+        {"string-cardinality", required_argument, 0, 'c'},
+        {"threads", required_argument, 0, 'j'},
+        {"batch-size", required_argument, 0, 'B'},
+        {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
 
     // Parse command line options.
     while(1) {
         int option_index = 0;
-        int c = getopt_long(argc, argv, "t:p:e:s:a:", long_options, &option_index);
-        
+        int c = getopt_long(argc, argv, "t:p:e:s:a:z:k:b:n:c:j:B:h", long_options, &option_index);
+
         // Check for end of options.
         if(c == -1) {
             break;
         }
-        
+
         // Parse each option.
         switch(c) {
             case 't': {
@@ -76,7 +187,7 @@ Options *parseopts(int argc, char **argv)
                 check_mem(options->table_name);
                 break;
             }
-            
+
             case 'p': {
                 options->path_count = atoi(optarg);
                 break;
@@ -96,9 +207,49 @@ Options *parseopts(int argc, char **argv)
                 options->seed = atoi(optarg);
                 break;
             }
+
+            case 'z': {
+                options->object_skew = atof(optarg);
+                break;
+            }
+
+            case 'k': {
+                options->action_skew = atof(optarg);
+                break;
+            }
+
+            case 'b': {
+                options->burst = atoi(optarg);
+                break;
+            }
+
+            case 'n': {
+                options->property_count = atoi(optarg);
+                break;
+            }
+
+            case 'c': {
+                options->string_cardinality = atoi(optarg);
+                break;
+            }
+
+            case 'j': {
+                options->thread_count = atoi(optarg);
+                break;
+            }
+
+            case 'B': {
+                options->batch_size = atoi(optarg);
+                break;
+            }
+
+            case 'h': {
+                usage();
+                break;
+            }
         }
     }
-    
+
     argc -= optind;
     argv += optind;
 
@@ -110,12 +261,14 @@ Options *parseopts(int argc, char **argv)
     options->path = bfromcstr(argv[0]);
 
     // Validate input.
-    /*
-    if(options->table_name == NULL) {
-        fprintf(stderr, "Error: Object type (-o) is required.\n\n");
+    if(options->object_skew < 0 || options->action_skew < 0) {
+        fprintf(stderr, "Error: Skew must not be negative.\n\n");
+        exit(1);
+    }
+    if(options->property_count < 0 || options->property_count > INT8_MAX) {
+        fprintf(stderr, "Error: Property count must be between 0 and %d.\n\n", INT8_MAX);
         exit(1);
     }
-    */
 
     // Default input.
     if(options->path_count <= 0) {
@@ -127,7 +280,19 @@ Options *parseopts(int argc, char **argv)
     if(options->action_count <= 0) {
         options->action_count = 100;
     }
-    
+    if(options->burst <= 0) {
+        options->burst = 1;
+    }
+    if(options->string_cardinality <= 0) {
+        options->string_cardinality = 1;
+    }
+    if(options->thread_count <= 0) {
+        options->thread_count = 1;
+    }
+    if(options->batch_size <= 0) {
+        options->batch_size = SKY_GEN_DEFAULT_BATCH_SIZE;
+    }
+
     // Randomize seed if not provided.
     if(options->seed == 0) {
         options->seed = time(NULL);
@@ -135,7 +300,7 @@ Options *parseopts(int argc, char **argv)
     }
 
     return options;
-    
+
 error:
     exit(1);
 }
@@ -143,6 +308,8 @@ error:
 void Options_free(Options *options)
 {
     if(options) {
+        bdestroy(options->path);
+        options->path = NULL;
         bdestroy(options->table_name);
         options->table_name = NULL;
         free(options);
@@ -165,69 +332,586 @@ void print_version()
 void usage()
 {
     fprintf(stderr, "usage: sky-gen [OPTIONS] [PATH]\n\n");
+    fprintf(stderr, "  -p, --path-count N          number of objects\n");
+    fprintf(stderr, "  -e, --avg-event-count N     average events per object\n");
+    fprintf(stderr, "  -a, --action-count N        number of actions\n");
+    fprintf(stderr, "  -s, --seed N                random number seed\n");
+    fprintf(stderr, "  -z, --object-skew S         Zipf exponent of object activity\n");
+    fprintf(stderr, "  -k, --action-skew S         power law exponent of action popularity\n");
+    fprintf(stderr, "  -b, --burst N               average events per session\n");
+    fprintf(stderr, "  -n, --properties N          number of properties\n");
+    fprintf(stderr, "  -c, --string-cardinality N  distinct string property values\n");
+    fprintf(stderr, "  -j, --threads N             number of generator threads\n");
+    fprintf(stderr, "  -B, --batch-size N          events per bulk insert\n\n");
     exit(0);
 }
 
+
+//==============================================================================
+//
+// Random Numbers
+//
+//==============================================================================
+
+// Returns the next value of a SplitMix64 random number stream.
+uint64_t random_next(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Returns a uniform random number in [0, 1).
+double random_uniform(uint64_t *state)
+{
+    return (double)(random_next(state) >> 11) / (double)(1ULL << 53);
+}
+
+// Returns an exponentially distributed random number.
+double random_exponential(uint64_t *state, double mean)
+{
+    return -mean * log(1.0 - random_uniform(state));
+}
+
+// Initializes a distribution where the value k is chosen with a weight of
+// 1/k^skew.
+//
+// distribution - The distribution.
+// count        - The number of values.
+// skew         - The exponent of the power law.
+//
+// Returns 0 if successful, otherwise returns -1.
+int Distribution_init(Distribution *distribution, uint32_t count, double skew)
+{
+    uint32_t i;
+    double sum = 0;
+
+    distribution->count = count;
+    distribution->cdf = calloc(count, sizeof(*distribution->cdf));
+    check_mem(distribution->cdf);
+    for(i=0; i<count; i++) {
+        sum += pow(i+1, -skew);
+        distribution->cdf[i] = sum;
+    }
+    for(i=0; i<count; i++) {
+        distribution->cdf[i] /= sum;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+void Distribution_free_deps(Distribution *distribution)
+{
+    free(distribution->cdf);
+    distribution->cdf = NULL;
+}
+
+// Returns a random value between 1 and the distribution's count.
+uint32_t Distribution_sample(Distribution *distribution, uint64_t *state)
+{
+    double value = random_uniform(state);
+    uint32_t min = 0, max = distribution->count - 1;
+    while(min < max) {
+        uint32_t mid = (min + max) / 2;
+        if(distribution->cdf[mid] < value) {
+            min = mid + 1;
+        }
+        else {
+            max = mid;
+        }
+    }
+    return min + 1;
+}
+
+
+//==============================================================================
+//
+// Schema
+//
+//==============================================================================
+
+// Adds the generated actions and properties to the table if they do not
+// already exist and records the ids of the properties.
+//
+// generator - The generator.
+//
+// Returns 0 if successful, otherwise returns -1.
+int create_schema(Generator *generator)
+{
+    int rc;
+    int32_t i;
+    sky_action *action = NULL;
+    sky_property *property = NULL;
+    sky_table *table = generator->table;
+    bstring name = NULL;
+    bstring data_types[] = {&SKY_DATA_TYPE_INT, &SKY_DATA_TYPE_FLOAT, &SKY_DATA_TYPE_BOOLEAN, &SKY_DATA_TYPE_STRING};
+
+    // Actions.
+    rc = sky_action_file_ensure_loaded(table->action_file);
+    check(rc == 0, "Unable to load actions");
+    if(table->action_file->action_count == 0) {
+        for(i=0; i<generator->options->action_count; i++) {
+            action = sky_action_create(); check_mem(action);
+            action->name = bformat("action%d", i+1); check_mem(action->name);
+            rc = sky_action_file_add_action(table->action_file, action);
+            check(rc == 0, "Unable to add action");
+            action = NULL;
+        }
+        rc = sky_action_file_save(table->action_file);
+        check(rc == 0, "Unable to save actions");
+    }
+
+    // Properties.
+    generator->property_ids = calloc(generator->options->property_count + 1, sizeof(*generator->property_ids));
+    check_mem(generator->property_ids);
+    for(i=0; i<generator->options->property_count; i++) {
+        name = bformat("property%d", i+1); check_mem(name);
+        rc = sky_property_file_find_by_name(table->property_file, name, &property);
+        check(rc == 0, "Unable to find property");
+
+        if(property == NULL) {
+            property = sky_property_create(); check_mem(property);
+            property->type = (i % 2 == 0 ? SKY_PROPERTY_TYPE_OBJECT : SKY_PROPERTY_TYPE_ACTION);
+            property->data_type = bstrcpy(data_types[i % 4]); check_mem(property->data_type);
+            property->name = name;
+            name = NULL;
+            rc = sky_property_file_add_property(table->property_file, property);
+            check(rc == 0, "Unable to add property");
+        }
+        check(biseq(property->data_type, data_types[i % 4]) == 1, "Property has a different data type: %s", bdata(property->name));
+        generator->property_ids[i] = property->id;
+        property = NULL;
+        bdestroy(name);
+        name = NULL;
+    }
+    if(generator->options->property_count > 0) {
+        rc = sky_property_file_save(table->property_file);
+        check(rc == 0, "Unable to save properties");
+    }
+
+    return 0;
+
+error:
+    sky_action_free(action);
+    if(property && property->property_file == NULL) sky_property_free(property);
+    bdestroy(name);
+    return -1;
+}
+
+
 //==============================================================================
 //
-// Event Management
+// Event Generation
 //
 //==============================================================================
 
+// Returns the number of events generated for an object.
+uint64_t get_object_event_count(Generator *generator, sky_object_id_t object_id,
+                                uint64_t *state)
+{
+    Options *options = generator->options;
+
+    // Uniform path lengths between 1 and twice the average.
+    if(options->object_skew == 0) {
+        return 1 + (random_next(state) % ((options->avg_event_count*2) - 1));
+    }
+
+    // Zipfian activity where the object's share of the events is
+    // proportional to 1/id^skew. Fractions are rounded randomly.
+    double total = (double)options->path_count * options->avg_event_count;
+    double expected = total * pow((double)object_id, -options->object_skew) / generator->object_weight_sum;
+    uint64_t count = (uint64_t)expected;
+    if(random_uniform(state) < expected - (double)count) {
+        count++;
+    }
+    return (count > 0 ? count : 1);
+}
+
+// Creates the data of a generated event. About half of the properties are
+// set on each event.
+//
+// generator - The generator.
+// event     - The event.
+// state     - The random number stream of the object.
+//
+// Returns 0 if successful, otherwise returns -1.
+int create_event_data(Generator *generator, sky_event *event, uint64_t *state)
+{
+    int32_t i;
+    int32_t property_count = generator->options->property_count;
+    if(property_count == 0) {
+        return 0;
+    }
+
+    event->data = calloc(property_count, sizeof(*event->data));
+    check_mem(event->data);
+    for(i=0; i<property_count; i++) {
+        uint64_t value = random_next(state);
+        if(value & 1) {
+            continue;
+        }
+
+        sky_event_data *data = NULL;
+        sky_property_id_t key = generator->property_ids[i];
+        switch(i % 4) {
+            case 0: data = sky_event_data_create_int(key, (int64_t)((value >> 1) % 1000000)); break;
+            case 1: data = sky_event_data_create_float(key, random_uniform(state) * 1000); break;
+            case 2: data = sky_event_data_create_boolean(key, (value & 2) != 0); break;
+            case 3: {
+                uint32_t index = Distribution_sample(&generator->strings, state) - 1;
+                data = sky_event_data_create_string(key, generator->string_values[index]);
+                break;
+            }
+        }
+        check_mem(data);
+        event->data[event->data_count++] = data;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Adds a batch to the end of a generator thread's queue. The caller blocks
+// while the queue is full so that threads that are ahead of the inserter do
+// not buffer an unbounded number of events.
+//
+// generator - The generator.
+// index     - The index of the generator thread.
+// batch     - The batch.
+//
+// Returns 0 if successful, otherwise returns -1.
+int push_batch(Generator *generator, uint32_t index, Batch *batch)
+{
+    Queue *queue = &generator->queues[index];
+
+    pthread_mutex_lock(&generator->mutex);
+    while(queue->count >= SKY_GEN_MAX_QUEUED_BATCHES && !generator->failed) {
+        pthread_cond_wait(&generator->cond, &generator->mutex);
+    }
+    bool failed = generator->failed;
+    if(!failed) {
+        if(queue->tail) queue->tail->next = batch;
+        else queue->head = batch;
+        queue->tail = batch;
+        queue->count++;
+        pthread_cond_broadcast(&generator->cond);
+    }
+    pthread_mutex_unlock(&generator->mutex);
+
+    return (failed ? -1 : 0);
+}
+
+// Removes the batch at the head of a generator thread's queue, waiting
+// until one is available.
+//
+// generator - The generator.
+// index     - The index of the generator thread.
+//
+// Returns the batch or NULL if generation failed.
+Batch *pop_batch(Generator *generator, uint32_t index)
+{
+    Queue *queue = &generator->queues[index];
+    Batch *batch = NULL;
+
+    pthread_mutex_lock(&generator->mutex);
+    while(queue->head == NULL && !generator->failed) {
+        pthread_cond_wait(&generator->cond, &generator->mutex);
+    }
+    if(queue->head != NULL) {
+        batch = queue->head;
+        queue->head = batch->next;
+        if(queue->head == NULL) queue->tail = NULL;
+        queue->count--;
+        pthread_cond_broadcast(&generator->cond);
+    }
+    pthread_mutex_unlock(&generator->mutex);
+
+    return batch;
+}
+
+void Batch_free(Batch *batch)
+{
+    uint32_t i;
+    if(batch) {
+        for(i=0; i<batch->event_count; i++) {
+            sky_event_free(batch->events[i]);
+        }
+        free(batch->events);
+        free(batch);
+    }
+}
+
+Batch *Batch_create(uint32_t capacity)
+{
+    Batch *batch = calloc(1, sizeof(Batch)); check_mem(batch);
+    batch->events = calloc(capacity, sizeof(*batch->events));
+    check_mem(batch->events);
+    return batch;
+
+error:
+    Batch_free(batch);
+    return NULL;
+}
+
+// Generates the events of a single unit of objects. Events are generated in
+// object and timestamp order so every batch is already sorted.
+//
+// generator - The generator.
+// index     - The index of the generator thread.
+// unit      - The index of the unit.
+//
+// Returns 0 if successful, otherwise returns -1.
+int generate_unit(Generator *generator, uint32_t index, uint32_t unit)
+{
+    int rc;
+    uint64_t i;
+    Options *options = generator->options;
+    Batch *batch = NULL;
+    sky_object_id_t object_id;
+    sky_object_id_t min_object_id = ((sky_object_id_t)unit * SKY_GEN_OBJECTS_PER_UNIT) + 1;
+    sky_object_id_t max_object_id = min_object_id + SKY_GEN_OBJECTS_PER_UNIT - 1;
+    if(max_object_id > (sky_object_id_t)options->path_count) {
+        max_object_id = options->path_count;
+    }
+
+    batch = Batch_create(options->batch_size); check_mem(batch);
+    for(object_id=min_object_id; object_id<=max_object_id; object_id++) {
+        uint64_t state = ((uint64_t)(uint32_t)options->seed << 32) ^ (object_id * 0xD1B54A32D192ED03ULL);
+        uint64_t event_count = get_object_event_count(generator, object_id, &state);
+        double timestamp = SKY_GEN_BASE_TIMESTAMP + (double)(random_next(&state) % SKY_GEN_START_RANGE);
+
+        for(i=0; i<event_count; i++) {
+            // Start a new session with a probability of one over the burst
+            // size, otherwise continue the current one.
+            if(i > 0) {
+                bool session = (random_next(&state) % options->burst) == 0;
+                timestamp += 1 + random_exponential(&state, (session ? SKY_GEN_SESSION_GAP : SKY_GEN_EVENT_GAP));
+            }
+            sky_action_id_t action_id = Distribution_sample(&generator->actions, &state);
+            sky_event *event = sky_event_create(object_id, (sky_timestamp_t)timestamp, action_id);
+            check_mem(event);
+            batch->events[batch->event_count++] = event;
+            rc = create_event_data(generator, event, &state);
+            check(rc == 0, "Unable to create event data");
+
+            // Hand off full batches.
+            if(batch->event_count == (uint32_t)options->batch_size) {
+                rc = push_batch(generator, index, batch);
+                check(rc == 0, "Unable to queue batch");
+                batch = Batch_create(options->batch_size); check_mem(batch);
+            }
+        }
+    }
+
+    batch->last = true;
+    rc = push_batch(generator, index, batch);
+    check(rc == 0, "Unable to queue batch");
+
+    return 0;
+
+error:
+    Batch_free(batch);
+    return -1;
+}
+
+// Generates every unit assigned to a generator thread. Units are assigned in
+// turn so that thread `i` of `n` generates the units `i`, `i+n`, `i+2n` ...
+//
+// arg - The worker.
+//
+// Returns NULL.
+void *generate_units(void *arg)
+{
+    int rc;
+    Worker *worker = (Worker*)arg;
+    Generator *generator = worker->generator;
+    uint32_t unit;
+
+    for(unit=worker->index; unit<generator->unit_count; unit+=generator->options->thread_count) {
+        rc = generate_unit(generator, worker->index, unit);
+        check(rc == 0, "Unable to generate unit: %d", unit);
+    }
+    return NULL;
+
+error:
+    pthread_mutex_lock(&generator->mutex);
+    generator->failed = true;
+    pthread_cond_broadcast(&generator->cond);
+    pthread_mutex_unlock(&generator->mutex);
+    return NULL;
+}
+
+// Adds the batches of every unit to the table in unit order.
+//
+// generator - The generator.
+// total     - A pointer to where the number of events added is returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int insert_units(Generator *generator, uint64_t *total)
+{
+    int rc;
+    uint32_t unit;
+    Batch *batch = NULL;
+
+    for(unit=0; unit<generator->unit_count; unit++) {
+        uint32_t index = unit % generator->options->thread_count;
+        bool last = false;
+        while(!last) {
+            batch = pop_batch(generator, index);
+            check(batch != NULL, "Generation failed");
+            rc = sky_table_add_sorted_events(generator->table, batch->events, batch->event_count);
+            check(rc == 0, "Unable to add events");
+            *total += batch->event_count;
+            last = batch->last;
+            Batch_free(batch);
+            batch = NULL;
+        }
+    }
+
+    return 0;
+
+error:
+    Batch_free(batch);
+    pthread_mutex_lock(&generator->mutex);
+    generator->failed = true;
+    pthread_cond_broadcast(&generator->cond);
+    pthread_mutex_unlock(&generator->mutex);
+    return -1;
+}
+
+void Generator_free_deps(Generator *generator)
+{
+    int32_t i;
+    Batch *batch;
+    if(generator->queues) {
+        for(i=0; i<generator->options->thread_count; i++) {
+            while((batch = generator->queues[i].head) != NULL) {
+                generator->queues[i].head = batch->next;
+                Batch_free(batch);
+            }
+        }
+        free(generator->queues);
+    }
+    if(generator->string_values) {
+        for(i=0; i<generator->options->string_cardinality; i++) {
+            bdestroy(generator->string_values[i]);
+        }
+        free(generator->string_values);
+    }
+    free(generator->property_ids);
+    Distribution_free_deps(&generator->actions);
+    Distribution_free_deps(&generator->strings);
+    pthread_mutex_destroy(&generator->mutex);
+    pthread_cond_destroy(&generator->cond);
+}
+
 // Generates a database with random data at a given path.
 //
 // options - A list of options to use while generating the database.
-// event_count - The number of events generated.
-void generate(Options *options, uint32_t *total)
+// total   - The number of events generated.
+//
+// Returns 0 if successful, otherwise returns -1.
+int generate(Options *options, uint64_t *total)
 {
     int rc;
-    sky_event *event = NULL;
-    
+    int32_t i;
+    int32_t started = 0;
+    pthread_t *threads = NULL;
+    Worker *workers = NULL;
+    sky_table *table = NULL;
+    Generator generator;
+    memset(&generator, 0, sizeof(generator));
+    pthread_mutex_init(&generator.mutex, NULL);
+    pthread_cond_init(&generator.cond, NULL);
+    generator.options = options;
+
     // Initialize the return value.
     *total = 0;
-    
-    // Seed the randomizer.
-    srandom(options->seed);
-    
-    // Initialize table.
-    sky_table *table = sky_table_create(); check_mem(table);
+
+    // Initialize table. Durability is relaxed while loading and the table is
+    // flushed once at the end.
+    table = sky_table_create(); check_mem(table);
+    generator.table = table;
     rc = sky_table_set_path(table, options->path);
     check(rc == 0, "Unable to set table path");
-    
-    // Open table.
     rc = sky_table_open(table);
     check(rc == 0, "Unable to open table");
-
-    // Loop over paths and create events.
-    int i, j;
-    for(i=0; i<options->path_count; i++) {
-        sky_object_id_t object_id = (sky_timestamp_t)(i+1);
-        int32_t event_count = (random() % ((options->avg_event_count*2) - 1)) + 1;
-        
-        // Create a bunch of events.
-        for(j=0; j<event_count; j++) {
-            sky_timestamp_t timestamp = random() % INT64_MAX;
-            sky_action_id_t action_id = (random() % options->action_count) + 1;
-            event = sky_event_create(object_id, timestamp, action_id);
-            rc = sky_table_add_event(table, event);
-            check(rc == 0, "Unable to add event: ts:%lld, oid:%d, action:%d", event->timestamp, event->object_id, event->action_id);
-            sky_event_free(event);
-            
-            // Increment event count.
-            (*total)++;
+    rc = sky_table_set_durability(table, SKY_DURABILITY_ASYNC);
+    check(rc == 0, "Unable to set table durability");
+    rc = create_schema(&generator);
+    check(rc == 0, "Unable to create schema");
+
+    // Precompute the distributions.
+    if(options->object_skew > 0) {
+        for(i=0; i<options->path_count; i++) {
+            generator.object_weight_sum += pow(i+1, -options->object_skew);
         }
     }
-    
+    rc = Distribution_init(&generator.actions, options->action_count, options->action_skew);
+    check(rc == 0, "Unable to initialize action distribution");
+    rc = Distribution_init(&generator.strings, options->string_cardinality, options->action_skew);
+    check(rc == 0, "Unable to initialize string distribution");
+    generator.string_values = calloc(options->string_cardinality, sizeof(*generator.string_values));
+    check_mem(generator.string_values);
+    for(i=0; i<options->string_cardinality; i++) {
+        generator.string_values[i] = bformat("value%d", i+1);
+        check_mem(generator.string_values[i]);
+    }
+
+    // Start the generator threads and insert on this thread.
+    generator.unit_count = (options->path_count + SKY_GEN_OBJECTS_PER_UNIT - 1) / SKY_GEN_OBJECTS_PER_UNIT;
+    generator.queues = calloc(options->thread_count, sizeof(*generator.queues));
+    check_mem(generator.queues);
+    threads = calloc(options->thread_count, sizeof(*threads)); check_mem(threads);
+    workers = calloc(options->thread_count, sizeof(*workers)); check_mem(workers);
+    for(i=0; i<options->thread_count; i++) {
+        workers[i].generator = &generator;
+        workers[i].index = i;
+        rc = pthread_create(&threads[i], NULL, generate_units, &workers[i]);
+        check(rc == 0, "Unable to start generator thread");
+        started++;
+    }
+    rc = insert_units(&generator, total);
+    for(i=0; i<started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    started = 0;
+    check(rc == 0, "Unable to insert events");
+
     // Clean up
-    sky_table_close(table);
+    rc = sky_table_flush(table);
+    check(rc == 0, "Unable to flush table");
+    rc = sky_table_close(table);
     check(rc == 0, "Unable to close table");
     sky_table_free(table);
-    
-    return;
-    
+    Generator_free_deps(&generator);
+    free(threads);
+    free(workers);
+
+    return 0;
+
 error:
-    sky_event_free(event);
+    if(started > 0) {
+        pthread_mutex_lock(&generator.mutex);
+        generator.failed = true;
+        pthread_cond_broadcast(&generator.cond);
+        pthread_mutex_unlock(&generator.mutex);
+        for(i=0; i<started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+    if(table && table->opened) sky_table_close(table);
     sky_table_free(table);
+    Generator_free_deps(&generator);
+    free(threads);
+    free(workers);
+    return -1;
 }
 
 
@@ -246,16 +930,15 @@ int main(int argc, char **argv)
     time_t t0 = time(NULL);
 
     // Generate database.
-    uint32_t total;
-    generate(options, &total);
+    uint64_t total;
+    int rc = generate(options, &total);
 
     // Show wall clock time.
-    printf("Event Count: %d events\n", total);
+    printf("Event Count: %llu events\n", (unsigned long long)total);
     printf("Elapsed Time: %ld seconds\n", (time(NULL)-t0));
 
     // Clean up.
     Options_free(options);
-    
-    return 0;
-}
 
+    return (rc == 0 ? 0 : 1);
+}
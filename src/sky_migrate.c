@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "bstring.h"
+#include "dbg.h"
+#include "mem.h"
+#include "migration.h"
+#include "table.h"
+#include "version.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The sky-migrate application converts tables written by older versions of
+// Sky to the current data file format. Each table is rewritten block by
+// block so tables of any size can be converted. Tables must not be open in
+// a running server while they are migrated.
+//
+// With `--recommend-block-size` the tables are not migrated. Instead the
+// sizes of their paths are measured and the block size that new tables
+// with similar paths should be created with is printed for each table.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+typedef struct Options {
+    bstring *paths;
+    int32_t path_count;
+    bool recommend_block_size;
+} Options;
+
+
+//==============================================================================
+//
+// Command Line Arguments
+//
+//==============================================================================
+
+void print_version();
+void usage();
+
+Options *parseopts(int argc, char **argv)
+{
+    Options *options = (Options*)calloc(1, sizeof(Options));
+    check_mem(options);
+
+    // Command line options.
+    struct option long_options[] = {
+        {"recommend-block-size", no_argument, 0, 'r'},
+        {"version", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    // Parse command line options.
+    while(1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "rvh", long_options, &option_index);
+
+        // Check for end of options.
+        if(c == -1) {
+            break;
+        }
+
+        // Parse each option.
+        switch(c) {
+            case 'r': {
+                options->recommend_block_size = true;
+                break;
+            }
+
+            case 'v': {
+                print_version();
+                break;
+            }
+
+            case 'h': {
+                usage();
+                break;
+            }
+        }
+    }
+
+    argc -= optind;
+    argv += optind;
+
+    // Retrieve table paths as the non-getopts options.
+    if(argc < 1) {
+        fprintf(stderr, "Error: Table path required.\n\n");
+        exit(1);
+    }
+    options->paths = calloc(argc, sizeof(*options->paths));
+    check_mem(options->paths);
+    int i;
+    for(i=0; i<argc; i++) {
+        options->paths[i] = bfromcstr(argv[i]);
+        check_mem(options->paths[i]);
+        options->path_count++;
+    }
+
+    return options;
+
+error:
+    exit(1);
+}
+
+void Options_free(Options *options)
+{
+    if(options) {
+        int i;
+        for(i=0; i<options->path_count; i++) {
+            bdestroy(options->paths[i]);
+        }
+        free(options->paths);
+        free(options);
+    }
+}
+
+
+//==============================================================================
+//
+// Usage & Version
+//
+//==============================================================================
+
+void print_version()
+{
+    printf("sky-migrate " SKY_VERSION "\n");
+    exit(0);
+}
+
+void usage()
+{
+    fprintf(stderr, "usage: sky-migrate [OPTIONS] TABLE_PATH...\n\n");
+    exit(0);
+}
+
+
+//==============================================================================
+//
+// Block Sizing
+//
+//==============================================================================
+
+// Prints the current and recommended block size of a table.
+//
+// path - The path to the table.
+//
+// Returns 0 if successful, otherwise returns -1.
+int recommend_block_size(bstring path)
+{
+    int rc;
+    sky_table *table = sky_table_create(); check_mem(table);
+    rc = sky_table_set_path(table, path);
+    check(rc == 0, "Unable to set table path");
+    rc = sky_table_open(table);
+    check(rc == 0, "Unable to open table");
+    check(table->shard_set == NULL, "Sharded tables are not supported: %s", bdata(path));
+    check(table->partition_set == NULL, "Partitioned tables are not supported: %s", bdata(path));
+
+    uint32_t block_size = 0;
+    rc = sky_data_file_recommend_block_size(table->data_file, &block_size);
+    check(rc == 0, "Unable to recommend block size");
+    printf("%s: block size %d KB, recommended %d KB\n", bdata(path),
+        table->data_file->block_size / 1024, block_size / 1024);
+
+    rc = sky_table_close(table);
+    check(rc == 0, "Unable to close table");
+    sky_table_free(table);
+    return 0;
+
+error:
+    sky_table_free(table);
+    return -1;
+}
+
+
+//==============================================================================
+//
+// Main
+//
+//==============================================================================
+
+int main(int argc, char **argv)
+{
+    int rc;
+    int ret = 0;
+
+    // Parse command line options.
+    Options *options = parseopts(argc, argv);
+
+    // Migrate each table.
+    int i;
+    for(i=0; i<options->path_count; i++) {
+        bstring path = options->paths[i];
+        if(options->recommend_block_size) {
+            if(recommend_block_size(path) != 0) {
+                fprintf(stderr, "Error: Unable to recommend a block size for %s\n", bdata(path));
+                ret = 1;
+            }
+            continue;
+        }
+
+        time_t t0 = time(NULL);
+        rc = sky_migration_migrate_table(path);
+        if(rc == 0) {
+            printf("Migrated %s in %ld seconds\n", bdata(path), (time(NULL)-t0));
+        }
+        else {
+            fprintf(stderr, "Error: Unable to migrate %s\n", bdata(path));
+            ret = 1;
+        }
+    }
+
+    // Clean up.
+    Options_free(options);
+
+    return ret;
+}
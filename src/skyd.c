@@ -1,11 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 #include <signal.h>
 
 #include "bstring.h"
 #include "dbg.h"
 #include "server.h"
+#include "query_function.h"
 #include "version.h"
 
 
@@ -20,6 +22,35 @@
 typedef struct Options {
     bstring path;
     int port;
+    bstring socket_path;
+    int worker_count;
+    int max_open_files;
+    long max_mapped_mb;
+    int durability;
+    int flush_interval;
+    int memtable_size;
+    int reorder_window;
+    bool preload;
+    bool huge_pages;
+    long block_size_kb;
+    bool action_only;
+    int local_shard_count;
+    long partition_period;
+    long block_cache_mb;
+    long result_cache_mb;
+    int compress_after;
+    long retention;
+    struct bstrList *shards;
+    struct bstrList *query_functions;
+    bstring primary;
+    int replication_interval;
+    long max_queued_writes;
+    int max_scans;
+    int numa_placement;
+    int prefetch_threads;
+    int trace_sample_rate;
+    int slow_query_threshold;
+    bstring trace_log_path;
 } Options;
 
 
@@ -33,17 +64,49 @@ Options *parseopts(int argc, char **argv)
 {
     Options *options = (Options*)calloc(1, sizeof(Options));
     check_mem(options);
+    options->durability = -1;
+    options->result_cache_mb = -1;
+    options->max_queued_writes = -1;
     
     // Command line options.
     struct option long_options[] = {
         {"port", optional_argument, 0, 'p'},
+        {"socket", required_argument, 0, 's'},
+        {"workers", optional_argument, 0, 'w'},
+        {"max-files", optional_argument, 0, 'f'},
+        {"max-mapped", optional_argument, 0, 'm'},
+        {"durability", optional_argument, 0, 'd'},
+        {"flush-interval", optional_argument, 0, 'i'},
+        {"memtable-size", optional_argument, 0, 't'},
+        {"reorder-window", required_argument, 0, 'z'},
+        {"preload", no_argument, 0, 'l'},
+        {"huge-pages", no_argument, 0, 'g'},
+        {"block-size", required_argument, 0, 'k'},
+        {"action-only", no_argument, 0, 'y'},
+        {"local-shards", required_argument, 0, 'N'},
+        {"partition-period", required_argument, 0, 'P'},
+        {"block-cache", optional_argument, 0, 'b'},
+        {"compress-after", optional_argument, 0, 'c'},
+        {"retention", required_argument, 0, 'x'},
+        {"result-cache", required_argument, 0, 'r'},
+        {"shard", required_argument, 0, 'n'},
+        {"query-function", required_argument, 0, 'F'},
+        {"replica-of", required_argument, 0, 'o'},
+        {"replication-interval", required_argument, 0, 'e'},
+        {"max-queued-writes", required_argument, 0, 'q'},
+        {"max-scans", required_argument, 0, 'a'},
+        {"numa", required_argument, 0, 'u'},
+        {"io-threads", required_argument, 0, 'j'},
+        {"trace-sample", required_argument, 0, 'T'},
+        {"slow-query", required_argument, 0, 'Q'},
+        {"trace-log", required_argument, 0, 'L'},
         {0, 0, 0, 0}
     };
 
     // Parse command line options.
     while(1) {
         int option_index = 0;
-        int c = getopt_long(argc, argv, "p:", long_options, &option_index);
+        int c = getopt_long(argc, argv, "p:s:w:f:m:d:i:t:z:lgk:yN:P:b:c:x:r:n:F:o:e:q:a:u:j:T:Q:L:", long_options, &option_index);
         
         // Check for end of options.
         if(c == -1) {
@@ -52,10 +115,208 @@ Options *parseopts(int argc, char **argv)
         
         // Parse each option.
         switch(c) {
-            case 'i': {
+            case 'p': {
                 options->port = atoi(optarg);
                 break;
             }
+            case 's': {
+                options->socket_path = bfromcstr(optarg); check_mem(options->socket_path);
+                break;
+            }
+            case 'w': {
+                options->worker_count = atoi(optarg);
+                break;
+            }
+            case 'f': {
+                options->max_open_files = atoi(optarg);
+                break;
+            }
+            case 'm': {
+                options->max_mapped_mb = atol(optarg);
+                break;
+            }
+            case 'd': {
+                if(strcmp(optarg, "strict") == 0) {
+                    options->durability = SKY_DURABILITY_STRICT;
+                }
+                else if(strcmp(optarg, "group") == 0) {
+                    options->durability = SKY_DURABILITY_GROUP;
+                }
+                else if(strcmp(optarg, "async") == 0) {
+                    options->durability = SKY_DURABILITY_ASYNC;
+                }
+                else {
+                    fprintf(stderr, "Error: Invalid durability mode: %s\n\n", optarg);
+                    exit(1);
+                }
+                break;
+            }
+            case 'i': {
+                options->flush_interval = atoi(optarg);
+                break;
+            }
+            case 't': {
+                options->memtable_size = atoi(optarg);
+                break;
+            }
+            case 'z': {
+                options->reorder_window = atoi(optarg);
+                break;
+            }
+            case 'l': {
+                options->preload = true;
+                break;
+            }
+            case 'g': {
+                options->huge_pages = true;
+                break;
+            }
+            case 'k': {
+                options->block_size_kb = atol(optarg);
+                if(options->block_size_kb <= 0 || options->block_size_kb > (SKY_MAX_BLOCK_SIZE / 1024)) {
+                    fprintf(stderr, "Error: Block size must be between 1 and %d KB.\n\n", SKY_MAX_BLOCK_SIZE / 1024);
+                    exit(1);
+                }
+                break;
+            }
+            case 'y': {
+                options->action_only = true;
+                break;
+            }
+            case 'N': {
+                options->local_shard_count = atoi(optarg);
+                if(options->local_shard_count <= 0) {
+                    fprintf(stderr, "Error: Invalid local shard count.\n\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'P': {
+                options->partition_period = atol(optarg);
+                if(options->partition_period <= 0 || options->partition_period > UINT32_MAX) {
+                    fprintf(stderr, "Error: Invalid partition period.\n\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'b': {
+                options->block_cache_mb = atol(optarg);
+                break;
+            }
+            case 'c': {
+                options->compress_after = atoi(optarg);
+                break;
+            }
+            case 'x': {
+                options->retention = atol(optarg);
+                if(options->retention <= 0 || options->retention > UINT32_MAX) {
+                    fprintf(stderr, "Error: Invalid retention.\n\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'r': {
+                options->result_cache_mb = atol(optarg);
+                if(options->result_cache_mb < 0) {
+                    fprintf(stderr, "Error: Invalid result cache size.\n\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'n': {
+                if(options->shards == NULL) {
+                    options->shards = bstrListCreate(); check_mem(options->shards);
+                }
+                check(bstrListAlloc(options->shards, options->shards->qty+1) == BSTR_OK, "Unable to add shard");
+                options->shards->entry[options->shards->qty] = bfromcstr(optarg);
+                check_mem(options->shards->entry[options->shards->qty]);
+                options->shards->qty++;
+                break;
+            }
+            case 'F': {
+                if(options->query_functions == NULL) {
+                    options->query_functions = bstrListCreate(); check_mem(options->query_functions);
+                }
+                check(bstrListAlloc(options->query_functions, options->query_functions->qty+1) == BSTR_OK, "Unable to add query function library");
+                options->query_functions->entry[options->query_functions->qty] = bfromcstr(optarg);
+                check_mem(options->query_functions->entry[options->query_functions->qty]);
+                options->query_functions->qty++;
+                break;
+            }
+            case 'o': {
+                bdestroy(options->primary);
+                options->primary = bfromcstr(optarg); check_mem(options->primary);
+                break;
+            }
+            case 'e': {
+                options->replication_interval = atoi(optarg);
+                if(options->replication_interval <= 0) {
+                    fprintf(stderr, "Error: Invalid replication interval.\n\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'q': {
+                options->max_queued_writes = atol(optarg);
+                if(options->max_queued_writes < 0 || options->max_queued_writes > UINT32_MAX) {
+                    fprintf(stderr, "Error: Invalid queued write limit.\n\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'u': {
+                if(strcmp(optarg, "none") == 0) {
+                    options->numa_placement = SKY_NUMA_PLACEMENT_NONE;
+                }
+                else if(strcmp(optarg, "local") == 0) {
+                    options->numa_placement = SKY_NUMA_PLACEMENT_LOCAL;
+                }
+                else if(strcmp(optarg, "interleave") == 0) {
+                    options->numa_placement = SKY_NUMA_PLACEMENT_INTERLEAVE;
+                }
+                else {
+                    fprintf(stderr, "Error: Invalid NUMA placement: %s\n\n", optarg);
+                    exit(1);
+                }
+                break;
+            }
+            case 'a': {
+                options->max_scans = atoi(optarg);
+                if(options->max_scans < 0) {
+                    fprintf(stderr, "Error: Invalid scan limit.\n\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'j': {
+                options->prefetch_threads = atoi(optarg);
+                if(options->prefetch_threads < 0) {
+                    fprintf(stderr, "Error: Invalid I/O thread count.\n\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'T': {
+                options->trace_sample_rate = atoi(optarg);
+                if(options->trace_sample_rate < 0) {
+                    fprintf(stderr, "Error: Invalid trace sample rate.\n\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'Q': {
+                options->slow_query_threshold = atoi(optarg);
+                if(options->slow_query_threshold < 0) {
+                    fprintf(stderr, "Error: Invalid slow query threshold.\n\n");
+                    exit(1);
+                }
+                break;
+            }
+            case 'L': {
+                bdestroy(options->trace_log_path);
+                options->trace_log_path = bfromcstr(optarg); check_mem(options->trace_log_path);
+                break;
+            }
         }
     }
     
@@ -75,6 +336,58 @@ Options *parseopts(int argc, char **argv)
         fprintf(stderr, "Error: Invalid port number.\n\n");
         exit(1);
     }
+    if(options->worker_count < 0) {
+        fprintf(stderr, "Error: Invalid worker count.\n\n");
+        exit(1);
+    }
+    if(options->max_open_files < 0 || options->max_mapped_mb < 0) {
+        fprintf(stderr, "Error: Invalid table cache limit.\n\n");
+        exit(1);
+    }
+    if(options->flush_interval < 0) {
+        fprintf(stderr, "Error: Invalid flush interval.\n\n");
+        exit(1);
+    }
+    if(options->memtable_size < 0) {
+        fprintf(stderr, "Error: Invalid memtable size.\n\n");
+        exit(1);
+    }
+    if(options->reorder_window < 0) {
+        fprintf(stderr, "Error: Invalid reorder window.\n\n");
+        exit(1);
+    }
+    if(options->reorder_window > 0 && options->memtable_size == 0) {
+        fprintf(stderr, "Error: A reorder window requires a memtable size.\n\n");
+        exit(1);
+    }
+    if(options->local_shard_count > 1 && options->memtable_size > 0) {
+        fprintf(stderr, "Error: Local shards cannot buffer writes in a memtable.\n\n");
+        exit(1);
+    }
+    if(options->local_shard_count > 1 && options->primary != NULL) {
+        fprintf(stderr, "Error: A replica cannot have local shards.\n\n");
+        exit(1);
+    }
+    if(options->partition_period > 0 && options->local_shard_count > 1) {
+        fprintf(stderr, "Error: Partitioned tables cannot have local shards.\n\n");
+        exit(1);
+    }
+    if(options->partition_period > 0 && options->memtable_size > 0) {
+        fprintf(stderr, "Error: Partitioned tables cannot buffer writes in a memtable.\n\n");
+        exit(1);
+    }
+    if(options->partition_period > 0 && options->primary != NULL) {
+        fprintf(stderr, "Error: A replica cannot have partitioned tables.\n\n");
+        exit(1);
+    }
+    if(options->block_cache_mb < 0) {
+        fprintf(stderr, "Error: Invalid block cache size.\n\n");
+        exit(1);
+    }
+    if(options->compress_after < 0) {
+        fprintf(stderr, "Error: Invalid compression idle time.\n\n");
+        exit(1);
+    }
 
     return options;
     
@@ -86,6 +399,11 @@ void Options_free(Options *options)
 {
     if(options) {
         bdestroy(options->path);
+        bdestroy(options->socket_path);
+        if(options->shards) bstrListDestroy(options->shards);
+        if(options->query_functions) bstrListDestroy(options->query_functions);
+        bdestroy(options->primary);
+        bdestroy(options->trace_log_path);
         free(options);
     }
 }
@@ -126,6 +444,91 @@ int main(int argc, char **argv)
     if(options->port > 0) {
         server->port = options->port;
     }
+    if(options->socket_path != NULL) {
+        server->socket_path = bstrcpy(options->socket_path);
+    }
+    if(options->worker_count > 0) {
+        server->worker_count = options->worker_count;
+    }
+    if(options->max_open_files > 0) {
+        server->max_open_files = options->max_open_files;
+    }
+    if(options->max_mapped_mb > 0) {
+        server->max_mapped_bytes = (size_t)options->max_mapped_mb * 1024 * 1024;
+    }
+    if(options->durability >= 0) {
+        server->durability = (sky_durability_e)options->durability;
+    }
+    if(options->flush_interval > 0) {
+        server->group_commit_interval = options->flush_interval;
+        server->async_flush_interval = options->flush_interval;
+    }
+    if(options->memtable_size > 0) {
+        server->memtable_size = options->memtable_size;
+    }
+    server->reorder_window = (uint32_t)options->reorder_window;
+    server->preload = options->preload;
+    server->huge_pages = options->huge_pages;
+    if(options->block_size_kb > 0) {
+        server->block_size = (uint32_t)options->block_size_kb * 1024;
+    }
+    server->action_only = options->action_only;
+    server->local_shard_count = (uint32_t)options->local_shard_count;
+    server->partition_period = (uint32_t)options->partition_period;
+    if(options->block_cache_mb > 0) {
+        server->block_cache_size = (size_t)options->block_cache_mb * 1024 * 1024;
+    }
+    if(options->result_cache_mb >= 0) {
+        server->result_cache_size = (size_t)options->result_cache_mb * 1024 * 1024;
+    }
+    server->compress_after = (uint32_t)options->compress_after;
+    server->retention = (uint32_t)options->retention;
+    if(options->shards != NULL) {
+        int i;
+        for(i=0; i<options->shards->qty; i++) {
+            if(sky_server_add_shard(server, options->shards->entry[i]) != 0) {
+                fprintf(stderr, "Error: Unable to add shard.\n\n");
+                exit(1);
+            }
+        }
+    }
+    if(options->primary != NULL) {
+        if(server->shard_count > 0) {
+            fprintf(stderr, "Error: A coordinator cannot be a replica.\n\n");
+            exit(1);
+        }
+        if(sky_server_set_primary(server, options->primary) != 0) {
+            fprintf(stderr, "Error: Unable to set primary.\n\n");
+            exit(1);
+        }
+    }
+    if(options->replication_interval > 0) {
+        server->replication_interval = (uint32_t)options->replication_interval;
+    }
+    if(options->max_queued_writes >= 0) {
+        server->max_queued_writes = (uint32_t)options->max_queued_writes;
+    }
+    server->max_concurrent_scans = (uint32_t)options->max_scans;
+    server->numa_placement = (sky_numa_placement_e)options->numa_placement;
+    server->prefetch_thread_count = (uint32_t)options->prefetch_threads;
+    server->trace_sample_rate = (uint32_t)options->trace_sample_rate;
+    server->slow_query_threshold = (uint32_t)options->slow_query_threshold;
+    if(options->trace_log_path != NULL) {
+        server->trace_log_path = bstrcpy(options->trace_log_path);
+    }
+
+    // Register query functions from shared objects before the workers start.
+    int query_function_library_count = 0;
+    if(options->query_functions != NULL) {
+        int i;
+        for(i=0; i<options->query_functions->qty; i++) {
+            if(sky_query_function_load(options->query_functions->entry[i]) != 0) {
+                fprintf(stderr, "Error: Unable to load query functions: %s\n\n", bdata(options->query_functions->entry[i]));
+                exit(1);
+            }
+        }
+        query_function_library_count = options->query_functions->qty;
+    }
     
     // Clean up options.
     Options_free(options);
@@ -133,17 +536,36 @@ int main(int argc, char **argv)
     // Display status.
     printf("Sky Server v%s\n", SKY_VERSION);
     printf("Listening on 0.0.0.0:%d, CTRL+C to stop\n", server->port);
+    if(server->socket_path != NULL) {
+        printf("Listening on %s\n", bdata(server->socket_path));
+    }
+    if(server->shard_count > 0) {
+        printf("Coordinating %d shards\n", server->shard_count);
+    }
+    if(server->local_shard_count > 1) {
+        printf("Sharding new tables %d ways\n", server->local_shard_count);
+    }
+    if(query_function_library_count > 0) {
+        printf("Loaded %d query function libraries, %d functions registered\n", query_function_library_count, sky_query_function_count);
+    }
+    if(server->partition_period > 0) {
+        printf("Partitioning new tables every %u seconds\n", server->partition_period);
+    }
+    if(server->primary != NULL) {
+        printf("Replicating %s every %dms\n", bdata(server->primary), server->replication_interval);
+    }
     
     // Signal handlers.
     signal(SIGPIPE, SIG_IGN);
 
     // Start server.
-    sky_server_start(server);
-    
-    // Continuously accept connections.
-    while(true) {
-        sky_server_accept(server);
+    if(sky_server_start(server) != 0) {
+        fprintf(stderr, "Error: Unable to start server.\n\n");
+        exit(1);
     }
+    
+    // Process connections until the server stops.
+    sky_server_run(server);
 
     sky_server_stop(server);
     sky_server_free(server);
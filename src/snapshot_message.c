@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "types.h"
+#include "snapshot_message.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+struct tagbstring SKY_SNAPSHOT_KEY_PATH = bsStatic("path");
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a Snapshot message object.
+//
+// Returns a new Snapshot message.
+sky_snapshot_message *sky_snapshot_message_create()
+{
+    sky_snapshot_message *message = NULL;
+    message = calloc(1, sizeof(sky_snapshot_message)); check_mem(message);
+    return message;
+
+error:
+    sky_snapshot_message_free(message);
+    return NULL;
+}
+
+// Frees a Snapshot message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_snapshot_message_free(sky_snapshot_message *message)
+{
+    if(message) {
+        bdestroy(message->path);
+        message->path = NULL;
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Serializes a Snapshot message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_snapshot_message_pack(sky_snapshot_message *message, FILE *file)
+{
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    check(minipack_fwrite_map(file, 1, &sz) == 0, "Unable to pack map");
+    check(sky_minipack_fwrite_bstring(file, &SKY_SNAPSHOT_KEY_PATH) == 0, "Unable to pack path key");
+    check(sky_minipack_fwrite_bstring(file, message->path) == 0, "Unable to pack path");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes a Snapshot message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_snapshot_message_unpack(sky_snapshot_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    bstring key = NULL;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    uint32_t map_length = minipack_fread_map(file, &sz);
+    check(sz > 0, "Unable to read map");
+
+    for(i=0; i<map_length; i++) {
+        rc = sky_minipack_fread_bstring(file, &key);
+        check(rc == 0, "Unable to read map key");
+
+        if(biseq(key, &SKY_SNAPSHOT_KEY_PATH) == 1) {
+            bdestroy(message->path);
+            message->path = NULL;
+            rc = sky_minipack_fread_bstring(file, &message->path);
+            check(rc == 0, "Unable to unpack path");
+        }
+        else {
+            sentinel("Invalid 'Snapshot' key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Copies a table to the directory of a Snapshot message.
+//
+// message - The message.
+// table   - The table to copy.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_snapshot_message_process(sky_snapshot_message *message,
+                                 sky_table *table, sky_buffer *output)
+{
+    int rc;
+    check(message != NULL, "Message required");
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+    check(message->path != NULL, "Snapshot path required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring cloned_str = bsStatic("cloned");
+
+    bool cloned = false;
+    rc = sky_table_snapshot(table, message->path, &cloned);
+    check(rc == 0, "Unable to snapshot table");
+
+    // Return {status:"ok", cloned:<bool>}
+    check(sky_buffer_pack_map(output, 2) == 0, "Unable to write root map");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    check(sky_buffer_pack_bstring(output, &cloned_str) == 0, "Unable to write cloned key");
+    check(sky_buffer_pack_bool(output, cloned) == 0, "Unable to write cloned flag");
+
+    return 0;
+
+error:
+    return -1;
+}
@@ -0,0 +1,74 @@
+#ifndef _sky_snapshot_message_h
+#define _sky_snapshot_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The Snapshot message copies a table to a new directory on the server
+// while the table stays open. The message is sent as a map:
+//
+//   {path:"/backups/users.1"}
+//
+// The directory must not already exist. Buffered events are merged and the
+// data file is flushed before it is copied so the snapshot can be opened as
+// a table. Files are reflinked when the file system supports it and are
+// otherwise copied by the kernel. The response says whether every file was
+// reflinked:
+//
+//   {status:"ok", cloned:true}
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for taking a snapshot of a table.
+typedef struct sky_snapshot_message {
+    bstring path;
+} sky_snapshot_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_snapshot_message *sky_snapshot_message_create();
+
+void sky_snapshot_message_free(sky_snapshot_message *message);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int sky_snapshot_message_pack(sky_snapshot_message *message, FILE *file);
+
+int sky_snapshot_message_unpack(sky_snapshot_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_snapshot_message_process(sky_snapshot_message *message,
+    sky_table *table, sky_buffer *output);
+
+#endif
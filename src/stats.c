@@ -0,0 +1,339 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "stats.h"
+#include "timestamp.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+sky_stats sky_stats_global;
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_stats_pack_histogram(sky_stats_histogram *histogram,
+    sky_buffer *buffer);
+
+int sky_stats_write_line(sky_buffer *buffer, const char *format, ...);
+
+int sky_stats_write_histogram(sky_stats_histogram *histogram,
+    const char *name, const char *label, sky_buffer *buffer);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Recording
+//--------------------------------------
+
+// Retrieves the current time for measuring durations.
+//
+// Returns the number of microseconds since the epoch.
+int64_t sky_stats_now()
+{
+    sky_timestamp_t now = 0;
+    sky_timestamp_now(&now);
+    return now;
+}
+
+// Records a duration in a histogram.
+//
+// histogram - The histogram.
+// duration  - The duration in microseconds.
+void sky_stats_record(sky_stats_histogram *histogram, int64_t duration)
+{
+    if(duration < 0) duration = 0;
+    __sync_fetch_and_add(&histogram->count, 1);
+    __sync_fetch_and_add(&histogram->sum, (uint64_t)duration);
+    __sync_fetch_and_add(&histogram->buckets[sky_stats_get_bucket_index(duration)], 1);
+}
+
+// Finds the histogram bucket that a duration is counted in.
+//
+// duration - The duration in microseconds.
+//
+// Returns the bucket index.
+uint32_t sky_stats_get_bucket_index(int64_t duration)
+{
+    uint32_t index = 0;
+    while(duration > 0 && index < SKY_STATS_HISTOGRAM_BUCKET_COUNT-1) {
+        duration >>= 1;
+        index++;
+    }
+    return index;
+}
+
+// Copies the global stats. The counters keep changing while they are copied
+// so the copy is only approximately consistent.
+//
+// stats - The stats to copy into.
+void sky_stats_snapshot(sky_stats *stats)
+{
+    __sync_synchronize();
+    memcpy(stats, &sky_stats_global, sizeof(*stats));
+}
+
+
+//--------------------------------------
+// MessagePack
+//--------------------------------------
+
+// Packs the stats as a MessagePack map.
+//
+// stats  - The stats.
+// buffer - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_stats_pack(sky_stats *stats, sky_buffer *buffer)
+{
+    uint32_t i;
+    check(stats != NULL, "Stats required");
+    check(buffer != NULL, "Buffer required");
+
+    struct tagbstring messages_str = bsStatic("messages");
+    struct tagbstring syncs_str = bsStatic("syncs");
+    struct tagbstring read_ahead_bytes_str = bsStatic("readAheadBytes");
+    struct tagbstring bytes_out_str = bsStatic("bytesOut");
+    struct tagbstring events_inserted_str = bsStatic("eventsInserted");
+    struct tagbstring block_splits_str = bsStatic("blockSplits");
+    struct tagbstring block_spans_str = bsStatic("blockSpans");
+    struct tagbstring header_writes_str = bsStatic("headerWrites");
+    struct tagbstring remaps_str = bsStatic("remaps");
+    struct tagbstring scanned_events_str = bsStatic("scannedEvents");
+    struct tagbstring scan_time_str = bsStatic("scanTime");
+    struct tagbstring open_tables_str = bsStatic("openTables");
+    struct tagbstring result_cache_hits_str = bsStatic("resultCacheHits");
+    struct tagbstring result_cache_misses_str = bsStatic("resultCacheMisses");
+
+    check(sky_buffer_pack_map(buffer, 14) == 0, "Unable to pack stats map");
+
+    // Messages by type.
+    check(sky_buffer_pack_bstring(buffer, &messages_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_map(buffer, SKY_MESSAGE_TYPE_COUNT-1) == 0, "Unable to pack messages map");
+    for(i=SKY_MESSAGE_TYPE_UNKNOWN+1; i<SKY_MESSAGE_TYPE_COUNT; i++) {
+        const char *name = sky_message_type_get_name((sky_message_type_e)i);
+        struct tagbstring name_str = {-1, (int)strlen(name), (unsigned char*)name};
+        check(sky_buffer_pack_bstring(buffer, &name_str) == 0, "Unable to pack message name");
+        check(sky_stats_pack_histogram(&stats->messages[i], buffer) == 0, "Unable to pack message histogram");
+    }
+
+    // Syncs.
+    check(sky_buffer_pack_bstring(buffer, &syncs_str) == 0, "Unable to pack key");
+    check(sky_stats_pack_histogram(&stats->syncs, buffer) == 0, "Unable to pack sync histogram");
+
+    // Counters.
+    check(sky_buffer_pack_bstring(buffer, &read_ahead_bytes_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->read_ahead_bytes) == 0, "Unable to pack value");
+    check(sky_buffer_pack_bstring(buffer, &bytes_out_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->bytes_out) == 0, "Unable to pack value");
+    check(sky_buffer_pack_bstring(buffer, &events_inserted_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->events_inserted) == 0, "Unable to pack value");
+    check(sky_buffer_pack_bstring(buffer, &block_splits_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->block_splits) == 0, "Unable to pack value");
+    check(sky_buffer_pack_bstring(buffer, &block_spans_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->block_spans) == 0, "Unable to pack value");
+    check(sky_buffer_pack_bstring(buffer, &header_writes_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->header_writes) == 0, "Unable to pack value");
+    check(sky_buffer_pack_bstring(buffer, &remaps_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->remaps) == 0, "Unable to pack value");
+    check(sky_buffer_pack_bstring(buffer, &scanned_events_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->scanned_events) == 0, "Unable to pack value");
+    check(sky_buffer_pack_bstring(buffer, &scan_time_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->scan_time) == 0, "Unable to pack value");
+    check(sky_buffer_pack_bstring(buffer, &open_tables_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->open_table_count) == 0, "Unable to pack value");
+    check(sky_buffer_pack_bstring(buffer, &result_cache_hits_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->result_cache_hits) == 0, "Unable to pack value");
+    check(sky_buffer_pack_bstring(buffer, &result_cache_misses_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, stats->result_cache_misses) == 0, "Unable to pack value");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Packs a histogram as a map of its count, the sum of its durations and the
+// counts in each of its buckets.
+//
+// histogram - The histogram.
+// buffer    - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_stats_pack_histogram(sky_stats_histogram *histogram,
+                             sky_buffer *buffer)
+{
+    uint32_t i;
+    struct tagbstring count_str = bsStatic("count");
+    struct tagbstring sum_str = bsStatic("sum");
+    struct tagbstring buckets_str = bsStatic("buckets");
+
+    check(sky_buffer_pack_map(buffer, 3) == 0, "Unable to pack histogram map");
+    check(sky_buffer_pack_bstring(buffer, &count_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, histogram->count) == 0, "Unable to pack count");
+    check(sky_buffer_pack_bstring(buffer, &sum_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_uint(buffer, histogram->sum) == 0, "Unable to pack sum");
+    check(sky_buffer_pack_bstring(buffer, &buckets_str) == 0, "Unable to pack key");
+    check(sky_buffer_pack_array(buffer, SKY_STATS_HISTOGRAM_BUCKET_COUNT) == 0, "Unable to pack buckets");
+    for(i=0; i<SKY_STATS_HISTOGRAM_BUCKET_COUNT; i++) {
+        check(sky_buffer_pack_uint(buffer, histogram->buckets[i]) == 0, "Unable to pack bucket");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Prometheus
+//--------------------------------------
+
+// Writes the stats in the Prometheus text exposition format. Durations are
+// converted to seconds.
+//
+// stats  - The stats.
+// buffer - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_stats_write_prometheus(sky_stats *stats, sky_buffer *buffer)
+{
+    int rc;
+    uint32_t i;
+    check(stats != NULL, "Stats required");
+    check(buffer != NULL, "Buffer required");
+
+    // Messages by type.
+    rc = sky_stats_write_line(buffer, "# TYPE sky_message_duration_seconds histogram\n");
+    check(rc == 0, "Unable to write type");
+    for(i=SKY_MESSAGE_TYPE_UNKNOWN+1; i<SKY_MESSAGE_TYPE_COUNT; i++) {
+        rc = sky_stats_write_histogram(&stats->messages[i], "sky_message_duration_seconds", sky_message_type_get_name((sky_message_type_e)i), buffer);
+        check(rc == 0, "Unable to write message histogram");
+    }
+
+    // Syncs.
+    rc = sky_stats_write_line(buffer, "# TYPE sky_sync_duration_seconds histogram\n");
+    check(rc == 0, "Unable to write type");
+    rc = sky_stats_write_histogram(&stats->syncs, "sky_sync_duration_seconds", NULL, buffer);
+    check(rc == 0, "Unable to write sync histogram");
+
+    // Counters.
+    rc = sky_stats_write_line(buffer,
+        "# TYPE sky_read_ahead_bytes_total counter\nsky_read_ahead_bytes_total %" PRIu64 "\n"
+        "# TYPE sky_output_bytes_total counter\nsky_output_bytes_total %" PRIu64 "\n"
+        "# TYPE sky_events_inserted_total counter\nsky_events_inserted_total %" PRIu64 "\n"
+        "# TYPE sky_block_splits_total counter\nsky_block_splits_total %" PRIu64 "\n"
+        "# TYPE sky_block_spans_total counter\nsky_block_spans_total %" PRIu64 "\n"
+        "# TYPE sky_header_writes_total counter\nsky_header_writes_total %" PRIu64 "\n"
+        "# TYPE sky_remaps_total counter\nsky_remaps_total %" PRIu64 "\n"
+        "# TYPE sky_scanned_events_total counter\nsky_scanned_events_total %" PRIu64 "\n"
+        "# TYPE sky_scan_seconds_total counter\nsky_scan_seconds_total %.6f\n"
+        "# TYPE sky_open_tables gauge\nsky_open_tables %" PRIu64 "\n"
+        "# TYPE sky_result_cache_hits_total counter\nsky_result_cache_hits_total %" PRIu64 "\n"
+        "# TYPE sky_result_cache_misses_total counter\nsky_result_cache_misses_total %" PRIu64 "\n",
+        stats->read_ahead_bytes, stats->bytes_out, stats->events_inserted,
+        stats->block_splits, stats->block_spans, stats->header_writes,
+        stats->remaps, stats->scanned_events, (double)stats->scan_time / 1000000,
+        stats->open_table_count, stats->result_cache_hits,
+        stats->result_cache_misses);
+    check(rc == 0, "Unable to write counters");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes a formatted line of text to a buffer.
+//
+// buffer - The buffer to write to.
+// format - The printf format.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_stats_write_line(sky_buffer *buffer, const char *format, ...)
+{
+    int rc;
+    char line[1024];
+    va_list args;
+
+    va_start(args, format);
+    rc = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    check(rc >= 0 && (size_t)rc < sizeof(line), "Unable to format line");
+
+    rc = sky_buffer_write(buffer, line, (size_t)rc);
+    check(rc == 0, "Unable to write line");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes a histogram in the Prometheus text format. Prometheus buckets are
+// cumulative so each bucket includes the counts of the buckets before it.
+//
+// histogram - The histogram.
+// name      - The metric name.
+// label     - The value of the type label or NULL if there is no label.
+// buffer    - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_stats_write_histogram(sky_stats_histogram *histogram,
+                              const char *name, const char *label,
+                              sky_buffer *buffer)
+{
+    int rc;
+    uint32_t i;
+    uint64_t count = 0;
+    char labels[256];
+
+    // The type label is shared by every line of the histogram.
+    labels[0] = '\0';
+    if(label != NULL) {
+        rc = snprintf(labels, sizeof(labels), "{type=\"%s\"}", label);
+        check(rc >= 0 && (size_t)rc < sizeof(labels), "Unable to format labels");
+    }
+
+    // Bucket lines add the bound inside the braces of the type label.
+    char prefix[256];
+    rc = snprintf(prefix, sizeof(prefix), "%.*s%s", (label != NULL ? (int)strlen(labels)-1 : 0), labels, (label != NULL ? "," : "{"));
+    check(rc >= 0 && (size_t)rc < sizeof(prefix), "Unable to format labels");
+
+    for(i=0; i<SKY_STATS_HISTOGRAM_BUCKET_COUNT-1; i++) {
+        count += histogram->buckets[i];
+        rc = sky_stats_write_line(buffer, "%s_bucket%sle=\"%g\"} %" PRIu64 "\n", name, prefix, (double)(1ULL << i) / 1000000, count);
+        check(rc == 0, "Unable to write bucket");
+    }
+
+    rc = sky_stats_write_line(buffer,
+        "%s_bucket%sle=\"+Inf\"} %" PRIu64 "\n"
+        "%s_sum%s %.6f\n"
+        "%s_count%s %" PRIu64 "\n",
+        name, prefix, histogram->count,
+        name, labels, (double)histogram->sum / 1000000,
+        name, labels, histogram->count);
+    check(rc == 0, "Unable to write histogram totals");
+
+    return 0;
+
+error:
+    return -1;
+}
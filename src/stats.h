@@ -0,0 +1,110 @@
+#ifndef _sky_stats_h
+#define _sky_stats_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "message_header.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The stats keep process wide counters for the hot paths of the server:
+// messages processed, bytes sent, events inserted, block splits and spans,
+// block syncs, header writes, remaps, scans and result cache lookups. Counters are updated with
+// atomic adds so that every worker can update them without taking a lock.
+//
+// Durations are recorded in microseconds into histograms whose buckets are
+// powers of two. Bucket `i` counts the durations that are less than `2^i`
+// microseconds and at least `2^(i-1)` microseconds. The last bucket counts
+// everything longer.
+//
+// The stats can be packed as a MessagePack map or written in the Prometheus
+// text exposition format.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+#define SKY_STATS_HISTOGRAM_BUCKET_COUNT 24
+
+// Adds a value to one of the global counters.
+#define sky_stats_add(FIELD, VALUE) __sync_fetch_and_add(&sky_stats_global.FIELD, (uint64_t)(VALUE))
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A histogram of durations in microseconds.
+typedef struct sky_stats_histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t buckets[SKY_STATS_HISTOGRAM_BUCKET_COUNT];
+} sky_stats_histogram;
+
+typedef struct sky_stats {
+    sky_stats_histogram messages[SKY_MESSAGE_TYPE_COUNT];
+    sky_stats_histogram syncs;
+    uint64_t read_ahead_bytes;
+    uint64_t bytes_out;
+    uint64_t events_inserted;
+    uint64_t block_splits;
+    uint64_t block_spans;
+    uint64_t header_writes;
+    uint64_t remaps;
+    uint64_t scanned_events;
+    uint64_t scan_time;
+    uint64_t open_table_count;
+    uint64_t result_cache_hits;
+    uint64_t result_cache_misses;
+} sky_stats;
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+extern sky_stats sky_stats_global;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Recording
+//--------------------------------------
+
+int64_t sky_stats_now();
+
+void sky_stats_record(sky_stats_histogram *histogram, int64_t duration);
+
+uint32_t sky_stats_get_bucket_index(int64_t duration);
+
+void sky_stats_snapshot(sky_stats *stats);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int sky_stats_pack(sky_stats *stats, sky_buffer *buffer);
+
+int sky_stats_write_prometheus(sky_stats *stats, sky_buffer *buffer);
+
+#endif
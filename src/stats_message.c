@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "types.h"
+#include "stats_message.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of memory categories of a table.
+#define SKY_STATS_MESSAGE_MEMORY_COUNT 11
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+void sky_stats_message_get_memory_fields(sky_table_memory *memory,
+    const char **names, const char **types, size_t *values);
+
+int sky_stats_message_pack_tables(sky_table_memory *tables,
+    uint32_t table_count, sky_buffer *output);
+
+int sky_stats_message_write_tables(sky_table_memory *tables,
+    uint32_t table_count, sky_buffer *text);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a Stats message object.
+//
+// Returns a new Stats message.
+sky_stats_message *sky_stats_message_create()
+{
+    sky_stats_message *message = NULL;
+    message = calloc(1, sizeof(sky_stats_message)); check_mem(message);
+    return message;
+
+error:
+    sky_stats_message_free(message);
+    return NULL;
+}
+
+// Frees a Stats message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_stats_message_free(sky_stats_message *message)
+{
+    if(message) {
+        bdestroy(message->format);
+        message->format = NULL;
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Calculates the total number of bytes needed to store the message.
+//
+// message - The message.
+//
+// Returns the number of bytes required to store the message.
+size_t sky_stats_message_sizeof(sky_stats_message *message)
+{
+    size_t sz = 0;
+    sz += minipack_sizeof_raw(blength(message->format));
+    sz += blength(message->format);
+    return sz;
+}
+
+// Serializes a Stats message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_stats_message_pack(sky_stats_message *message, FILE *file)
+{
+    int rc;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    rc = sky_minipack_fwrite_bstring(file, message->format);
+    check(rc == 0, "Unable to pack format");
+    
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes a Stats message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_stats_message_unpack(sky_stats_message *message, FILE *file)
+{
+    int rc;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    bdestroy(message->format);
+    rc = sky_minipack_fread_bstring(file, &message->format);
+    check(rc == 0, "Unable to unpack format");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Writes a set of stats in the format requested by a Stats message.
+//
+// message     - The message.
+// stats       - The stats to return.
+// tables      - The memory used by each open table.
+// table_count - The number of tables.
+// output      - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_stats_message_process(sky_stats_message *message, sky_stats *stats,
+                              sky_table_memory *tables, uint32_t table_count,
+                              sky_buffer *output)
+{
+    int rc;
+    sky_buffer *text = NULL;
+    check(message != NULL, "Message required");
+    check(stats != NULL, "Stats required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring stats_str = bsStatic("stats");
+    struct tagbstring text_str = bsStatic("text");
+    struct tagbstring tables_str = bsStatic("tables");
+
+    bool prometheus = (biseqcstr(message->format, "prometheus") == 1);
+    check(sky_buffer_pack_map(output, (prometheus ? 2 : 3)) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write output");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write output");
+
+    // Return {status:"ok", text:"..."}
+    if(prometheus) {
+        text = sky_buffer_create(); check_mem(text);
+        rc = sky_stats_write_prometheus(stats, text);
+        check(rc == 0, "Unable to write stats text");
+        rc = sky_stats_message_write_tables(tables, table_count, text);
+        check(rc == 0, "Unable to write table memory text");
+
+        struct tagbstring value = {-1, (int)text->length, (unsigned char*)text->data};
+        check(sky_buffer_pack_bstring(output, &text_str) == 0, "Unable to write output");
+        check(sky_buffer_pack_bstring(output, &value) == 0, "Unable to write output");
+        sky_buffer_free(text);
+        text = NULL;
+    }
+    // Return {status:"ok", stats:{...}, tables:[...]}
+    else {
+        check(blength(message->format) == 0, "Invalid stats format: %s", bdata(message->format));
+        check(sky_buffer_pack_bstring(output, &stats_str) == 0, "Unable to write output");
+        rc = sky_stats_pack(stats, output);
+        check(rc == 0, "Unable to write stats");
+        check(sky_buffer_pack_bstring(output, &tables_str) == 0, "Unable to write output");
+        rc = sky_stats_message_pack_tables(tables, table_count, output);
+        check(rc == 0, "Unable to write table memory");
+    }
+
+    return 0;
+
+error:
+    sky_buffer_free(text);
+    return -1;
+}
+
+
+//--------------------------------------
+// Table Memory
+//--------------------------------------
+
+// Lists the memory categories of a table with their names in the map
+// format, their types in the Prometheus format and their byte counts.
+//
+// memory - The memory used by the table.
+// names  - The array to write the map keys to.
+// types  - The array to write the Prometheus types to.
+// values - The array to write the byte counts to.
+void sky_stats_message_get_memory_fields(sky_table_memory *memory,
+                                         const char **names, const char **types,
+                                         size_t *values)
+{
+    uint32_t i = 0;
+    names[i] = "mappedBytes"; types[i] = "mapped"; values[i++] = memory->mapped_bytes;
+    names[i] = "dataBytes"; types[i] = "data"; values[i++] = memory->data_bytes;
+    names[i] = "residentBytes"; types[i] = "resident"; values[i++] = memory->resident_bytes;
+    names[i] = "blockBytes"; types[i] = "block"; values[i++] = memory->block_bytes;
+    names[i] = "schemaBytes"; types[i] = "schema"; values[i++] = memory->schema_bytes;
+    names[i] = "dictionaryBytes"; types[i] = "dictionary"; values[i++] = memory->dictionary_bytes;
+    names[i] = "indexBytes"; types[i] = "index"; values[i++] = memory->index_bytes;
+    names[i] = "memtableBytes"; types[i] = "memtable"; values[i++] = memory->memtable_bytes;
+    names[i] = "blockCacheBytes"; types[i] = "block_cache"; values[i++] = memory->block_cache_bytes;
+    names[i] = "resultCacheBytes"; types[i] = "result_cache"; values[i++] = memory->result_cache_bytes;
+    names[i] = "subscriptionBytes"; types[i] = "subscription"; values[i++] = memory->subscription_bytes;
+}
+
+// Writes the memory used by each table as an array of maps.
+//
+// tables      - The memory used by each table.
+// table_count - The number of tables.
+// output      - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_stats_message_pack_tables(sky_table_memory *tables,
+                                  uint32_t table_count, sky_buffer *output)
+{
+    uint32_t i, j;
+    const char *names[SKY_STATS_MESSAGE_MEMORY_COUNT];
+    const char *types[SKY_STATS_MESSAGE_MEMORY_COUNT];
+    size_t values[SKY_STATS_MESSAGE_MEMORY_COUNT];
+    struct tagbstring name_str = bsStatic("name");
+
+    check(sky_buffer_pack_array(output, table_count) == 0, "Unable to write table count");
+    for(i=0; i<table_count; i++) {
+        sky_stats_message_get_memory_fields(&tables[i], names, types, values);
+        check(sky_buffer_pack_map(output, SKY_STATS_MESSAGE_MEMORY_COUNT + 1) == 0, "Unable to write table");
+        check(sky_buffer_pack_bstring(output, &name_str) == 0, "Unable to write table name key");
+        check(sky_buffer_pack_raw(output, bdatae(tables[i].name, ""), (uint32_t)blength(tables[i].name)) == 0, "Unable to write table name");
+        for(j=0; j<SKY_STATS_MESSAGE_MEMORY_COUNT; j++) {
+            struct tagbstring key = {-1, (int)strlen(names[j]), (unsigned char*)names[j]};
+            check(sky_buffer_pack_bstring(output, &key) == 0, "Unable to write memory key");
+            check(sky_buffer_pack_uint(output, (uint64_t)values[j]) == 0, "Unable to write memory value");
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Writes the memory used by each table as Prometheus gauges.
+//
+// tables      - The memory used by each table.
+// table_count - The number of tables.
+// text        - The buffer to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_stats_message_write_tables(sky_table_memory *tables,
+                                   uint32_t table_count, sky_buffer *text)
+{
+    int rc;
+    uint32_t i, j;
+    char line[1024];
+    const char *names[SKY_STATS_MESSAGE_MEMORY_COUNT];
+    const char *types[SKY_STATS_MESSAGE_MEMORY_COUNT];
+    size_t values[SKY_STATS_MESSAGE_MEMORY_COUNT];
+
+    rc = snprintf(line, sizeof(line), "# TYPE sky_table_memory_bytes gauge\n");
+    check(sky_buffer_write(text, line, (size_t)rc) == 0, "Unable to write type");
+    for(i=0; i<table_count; i++) {
+        sky_stats_message_get_memory_fields(&tables[i], names, types, values);
+        for(j=0; j<SKY_STATS_MESSAGE_MEMORY_COUNT; j++) {
+            rc = snprintf(line, sizeof(line), "sky_table_memory_bytes{table=\"%s\",type=\"%s\"} %zu\n", bdatae(tables[i].name, ""), types[j], values[j]);
+            check(rc >= 0 && (size_t)rc < sizeof(line), "Unable to format table memory");
+            check(sky_buffer_write(text, line, (size_t)rc) == 0, "Unable to write table memory");
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
@@ -0,0 +1,86 @@
+#ifndef _sky_stats_message_h
+#define _sky_stats_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "stats.h"
+#include "table.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The Stats message returns the server's counters and latency histograms. It
+// does not target a table so the database and table names in the header are
+// ignored. The message body is the format of the response. An empty format
+// returns the stats as a map:
+//
+//   {status:"ok", stats:{messages:{eadd:{count:0, sum:0, buckets:[...]}}, ...}}
+//
+// The "prometheus" format returns the stats in the Prometheus text exposition
+// format so that a scraper can serve them as they are:
+//
+//   {status:"ok", text:"# TYPE sky_message_duration_seconds histogram\n..."}
+//
+// The memory used by each open table is returned along with the stats as
+// of the last time that the table's worker measured it. Tables are listed by their database and table
+// names and their memory is broken down by category:
+//
+//   {status:"ok", stats:{...}, tables:[{name:"db/t", mappedBytes:0, ...}]}
+//
+// The Prometheus format has a gauge for each table and category instead:
+//
+//   sky_table_memory_bytes{table="db/t",type="mapped"} 0
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for retrieving server stats.
+typedef struct sky_stats_message {
+    bstring format;
+} sky_stats_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_stats_message *sky_stats_message_create();
+
+void sky_stats_message_free(sky_stats_message *message);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+size_t sky_stats_message_sizeof(sky_stats_message *message);
+
+int sky_stats_message_pack(sky_stats_message *message, FILE *file);
+
+int sky_stats_message_unpack(sky_stats_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_stats_message_process(sky_stats_message *message, sky_stats *stats,
+    sky_table_memory *tables, uint32_t table_count, sky_buffer *output);
+
+#endif
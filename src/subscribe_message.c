@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "types.h"
+#include "subscribe_message.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+struct tagbstring SKY_SUBSCRIBE_KEY_ACTION_IDS = bsStatic("actionIds");
+
+struct tagbstring SKY_SUBSCRIBE_KEY_CAPACITY = bsStatic("capacity");
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_subscribe_message_unpack_action_ids(sky_subscribe_message *message,
+    FILE *file);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a Subscribe message object.
+//
+// Returns a new Subscribe message.
+sky_subscribe_message *sky_subscribe_message_create()
+{
+    sky_subscribe_message *message = NULL;
+    message = calloc(1, sizeof(sky_subscribe_message)); check_mem(message);
+    return message;
+
+error:
+    sky_subscribe_message_free(message);
+    return NULL;
+}
+
+// Frees a Subscribe message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_subscribe_message_free(sky_subscribe_message *message)
+{
+    if(message) {
+        free(message->action_ids);
+        message->action_ids = NULL;
+        message->action_id_count = 0;
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Serializes a Subscribe message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_subscribe_message_pack(sky_subscribe_message *message, FILE *file)
+{
+    size_t sz;
+    uint32_t i;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    check(minipack_fwrite_map(file, 2, &sz) == 0, "Unable to pack map");
+    check(sky_minipack_fwrite_bstring(file, &SKY_SUBSCRIBE_KEY_ACTION_IDS) == 0, "Unable to pack action ids key");
+    check(minipack_fwrite_array(file, message->action_id_count, &sz) == 0, "Unable to pack action id array");
+    for(i=0; i<message->action_id_count; i++) {
+        check(minipack_fwrite_uint(file, message->action_ids[i], &sz) == 0, "Unable to pack action id");
+    }
+    check(sky_minipack_fwrite_bstring(file, &SKY_SUBSCRIBE_KEY_CAPACITY) == 0, "Unable to pack capacity key");
+    check(minipack_fwrite_uint(file, message->capacity, &sz) == 0, "Unable to pack capacity");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes a Subscribe message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_subscribe_message_unpack(sky_subscribe_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    bstring key = NULL;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    uint32_t map_length = minipack_fread_map(file, &sz);
+    check(sz > 0, "Unable to read map");
+
+    for(i=0; i<map_length; i++) {
+        rc = sky_minipack_fread_bstring(file, &key);
+        check(rc == 0, "Unable to read map key");
+
+        if(biseq(key, &SKY_SUBSCRIBE_KEY_ACTION_IDS) == 1) {
+            rc = sky_subscribe_message_unpack_action_ids(message, file);
+            check(rc == 0, "Unable to unpack action ids");
+        }
+        else if(biseq(key, &SKY_SUBSCRIBE_KEY_CAPACITY) == 1) {
+            message->capacity = (uint32_t)minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack capacity");
+        }
+        else {
+            sentinel("Invalid 'Subscribe' key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+// Deserializes the array of action ids that a subscription is filtered by.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_subscribe_message_unpack_action_ids(sky_subscribe_message *message,
+                                            FILE *file)
+{
+    size_t sz;
+    uint32_t i;
+
+    uint32_t count = minipack_fread_array(file, &sz);
+    check(sz > 0, "Unable to unpack action id array");
+
+    free(message->action_ids);
+    message->action_ids = calloc(count, sizeof(*message->action_ids));
+    if(count > 0) check_mem(message->action_ids);
+    message->action_id_count = count;
+
+    for(i=0; i<count; i++) {
+        message->action_ids[i] = (sky_action_id_t)minipack_fread_uint(file, &sz);
+        check(sz > 0, "Unable to unpack action id");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Registers a subscription on a table.
+//
+// message - The message.
+// table   - The table to subscribe to.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_subscribe_message_process(sky_subscribe_message *message,
+                                  sky_table *table, sky_buffer *output)
+{
+    int rc;
+    sky_subscription *subscription = NULL;
+    check(message != NULL, "Message required");
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring subscription_id_str = bsStatic("subscriptionId");
+
+    rc = sky_table_add_subscription(table, message->capacity, message->action_ids, message->action_id_count, &subscription);
+    check(rc == 0, "Unable to add subscription");
+
+    // Return.
+    //   {status:"ok", subscriptionId:<id>}
+    check(sky_buffer_pack_map(output, 2) == 0, "Unable to write root map");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    check(sky_buffer_pack_bstring(output, &subscription_id_str) == 0, "Unable to write subscription id key");
+    check(sky_buffer_pack_uint(output, subscription->id) == 0, "Unable to write subscription id");
+
+    return 0;
+
+error:
+    return -1;
+}
@@ -0,0 +1,83 @@
+#ifndef _sky_subscribe_message_h
+#define _sky_subscribe_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The Subscribe message registers a subscription on a table so that the
+// events added to the table from then on are buffered for the client. The
+// message is sent as a map:
+//
+//   {actionIds:[<int>], capacity:<int>}
+//
+// Only events of the listed actions are buffered. Every event is buffered
+// if no action ids are given. The capacity is the number of events that are
+// buffered before the oldest are dropped and defaults to
+// SKY_SUBSCRIPTION_DEFAULT_CAPACITY. Both keys are optional.
+//
+// The response holds the id that the buffered events are read with:
+//
+//   {status:"ok", subscriptionId:<int>}
+//
+// See tail_message.h for reading the events and subscription.h for how they
+// are buffered. Subscriptions belong to the server that holds the table, so
+// Subscribe and Tail messages are sent straight to a node and are not served
+// by replicas, which do not add events themselves.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for subscribing to the new events of a table.
+typedef struct sky_subscribe_message {
+    sky_action_id_t *action_ids;
+    uint32_t action_id_count;
+    uint32_t capacity;
+} sky_subscribe_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_subscribe_message *sky_subscribe_message_create();
+
+void sky_subscribe_message_free(sky_subscribe_message *message);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int sky_subscribe_message_pack(sky_subscribe_message *message, FILE *file);
+
+int sky_subscribe_message_unpack(sky_subscribe_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_subscribe_message_process(sky_subscribe_message *message,
+    sky_table *table, sky_buffer *output);
+
+#endif
@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "subscription.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a subscription with an empty ring buffer.
+//
+// capacity        - The number of events the ring can hold or zero for the
+//                   default capacity.
+// action_ids      - The actions whose events are buffered.
+// action_id_count - The number of actions. Every event is buffered if zero.
+//
+// Returns a new subscription.
+sky_subscription *sky_subscription_create(uint32_t capacity,
+                                          sky_action_id_t *action_ids,
+                                          uint32_t action_id_count)
+{
+    sky_subscription *subscription = NULL;
+    if(capacity == 0) capacity = SKY_SUBSCRIPTION_DEFAULT_CAPACITY;
+    check(capacity <= SKY_SUBSCRIPTION_MAX_CAPACITY, "Subscription capacity too large: %d", capacity);
+    check(action_ids != NULL || action_id_count == 0, "Action ids required");
+
+    subscription = calloc(1, sizeof(sky_subscription)); check_mem(subscription);
+    subscription->capacity = capacity;
+    subscription->events = calloc(capacity, sizeof(*subscription->events));
+    check_mem(subscription->events);
+
+    if(action_id_count > 0) {
+        subscription->action_ids = malloc(sizeof(*action_ids) * action_id_count);
+        check_mem(subscription->action_ids);
+        memcpy(subscription->action_ids, action_ids, sizeof(*action_ids) * action_id_count);
+        subscription->action_id_count = action_id_count;
+    }
+
+    return subscription;
+
+error:
+    sky_subscription_free(subscription);
+    return NULL;
+}
+
+// Frees a subscription and its buffered events.
+//
+// subscription - The subscription.
+//
+// Returns nothing.
+void sky_subscription_free(sky_subscription *subscription)
+{
+    uint32_t i;
+    if(subscription) {
+        if(subscription->events != NULL) {
+            for(i=0; i<subscription->capacity; i++) {
+                free(subscription->events[i].data);
+            }
+        }
+        free(subscription->events);
+        subscription->events = NULL;
+        free(subscription->action_ids);
+        subscription->action_ids = NULL;
+        free(subscription);
+    }
+}
+
+
+//--------------------------------------
+// Ring Buffer
+//--------------------------------------
+
+// Checks whether events of an action pass the filter of a subscription.
+//
+// subscription - The subscription.
+// action_id    - The action id of the event.
+//
+// Returns true if the event should be buffered.
+bool sky_subscription_matches(sky_subscription *subscription,
+                              sky_action_id_t action_id)
+{
+    uint32_t i;
+    if(subscription->action_id_count == 0) {
+        return true;
+    }
+    for(i=0; i<subscription->action_id_count; i++) {
+        if(subscription->action_ids[i] == action_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Buffers an event at the head of the ring. The oldest event is dropped if
+// the ring is full. Events that do not pass the filter are ignored.
+//
+// subscription - The subscription.
+// event        - The event that was added to the table.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_subscription_push(sky_subscription *subscription, sky_event *event)
+{
+    int rc;
+    size_t sz;
+    check(subscription != NULL, "Subscription required");
+    check(event != NULL, "Event required");
+
+    if(!sky_subscription_matches(subscription, event->action_id)) {
+        return 0;
+    }
+
+    // Make room by dropping the oldest event.
+    if(subscription->head - subscription->tail == subscription->capacity) {
+        subscription->tail++;
+        subscription->dropped++;
+    }
+
+    // Grow the slot if the event does not fit in memory left by an older one.
+    sky_subscription_event *slot = &subscription->events[subscription->head % subscription->capacity];
+    size_t length = sky_event_sizeof(event);
+    if(length > slot->capacity) {
+        void *data = realloc(slot->data, length); check_mem(data);
+        slot->data = data;
+        slot->capacity = length;
+    }
+
+    rc = sky_event_pack(event, slot->data, &sz);
+    check(rc == 0 && sz == length, "Unable to pack subscribed event");
+    slot->object_id = event->object_id;
+    slot->length = length;
+    subscription->head++;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Retrieves the number of events buffered on a subscription.
+//
+// subscription - The subscription.
+//
+// Returns the number of events in the ring.
+uint32_t sky_subscription_get_event_count(sky_subscription *subscription)
+{
+    return (uint32_t)(subscription->head - subscription->tail);
+}
+
+// Retrieves a buffered event without removing it.
+//
+// subscription - The subscription.
+// index        - The position of the event from the oldest buffered event.
+//
+// Returns the event or NULL if fewer events are buffered.
+sky_subscription_event *sky_subscription_peek(sky_subscription *subscription,
+                                              uint32_t index)
+{
+    if(index >= sky_subscription_get_event_count(subscription)) {
+        return NULL;
+    }
+    return &subscription->events[(subscription->tail + index) % subscription->capacity];
+}
+
+// Removes the oldest events from the ring.
+//
+// subscription - The subscription.
+// count        - The number of events to remove.
+//
+// Returns nothing.
+void sky_subscription_shift(sky_subscription *subscription, uint32_t count)
+{
+    uint32_t event_count = sky_subscription_get_event_count(subscription);
+    subscription->tail += (count < event_count ? count : event_count);
+}
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+// Calculates the heap memory used by the ring of a subscription.
+//
+// subscription - The subscription.
+//
+// Returns the number of bytes.
+size_t sky_subscription_get_memory_usage(sky_subscription *subscription)
+{
+    if(subscription == NULL) {
+        return 0;
+    }
+
+    size_t size = sizeof(*subscription);
+    size += sizeof(*subscription->action_ids) * subscription->action_id_count;
+    size += sizeof(*subscription->events) * subscription->capacity;
+    return size;
+}
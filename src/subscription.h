@@ -0,0 +1,119 @@
+#ifndef _sky_subscription_h
+#define _sky_subscription_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "types.h"
+#include "event.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A subscription is registered on a table by a consumer that wants to be
+// told about new events instead of scanning for them. Every event that is
+// added to the table is pushed onto the ring buffer of each subscription
+// whose action filter it passes. The consumer then takes the buffered
+// events off the ring with a Tail message. See tail_message.h.
+//
+// The ring holds at most the capacity of the subscription. A consumer that
+// falls behind does not hold up writers. Instead the oldest buffered event
+// is dropped to make room and the number of dropped events is counted so
+// the consumer can tell that it missed some.
+//
+// Events are stored as raw events with their full timestamp after their
+// string values have been encoded, so each slot can be read back with the
+// same routines as the paths of the data file. The memory of each slot is
+// kept and reused once the ring wraps around.
+//
+// A subscription belongs to the worker that owns its table and is not
+// locked. Subscriptions are kept in memory and are dropped when their table
+// is closed.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of events that a subscription buffers if no capacity is given.
+#define SKY_SUBSCRIPTION_DEFAULT_CAPACITY 1024
+
+// The largest number of events that a subscription can buffer.
+#define SKY_SUBSCRIPTION_MAX_CAPACITY 1048576
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A buffered event and the object it belongs to.
+typedef struct sky_subscription_event {
+    sky_object_id_t object_id;
+    void *data;
+    size_t length;
+    size_t capacity;
+} sky_subscription_event;
+
+// A ring buffer of the events added to a table that pass the action filter
+// of the subscription. An empty filter passes every event. The head is the
+// number of events ever pushed and the tail is the number taken or dropped,
+// so the ring holds head minus tail events.
+typedef struct sky_subscription {
+    uint64_t id;
+    sky_action_id_t *action_ids;
+    uint32_t action_id_count;
+    sky_subscription_event *events;
+    uint32_t capacity;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t dropped;
+} sky_subscription;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_subscription *sky_subscription_create(uint32_t capacity,
+    sky_action_id_t *action_ids, uint32_t action_id_count);
+
+void sky_subscription_free(sky_subscription *subscription);
+
+//--------------------------------------
+// Ring Buffer
+//--------------------------------------
+
+bool sky_subscription_matches(sky_subscription *subscription,
+    sky_action_id_t action_id);
+
+int sky_subscription_push(sky_subscription *subscription, sky_event *event);
+
+uint32_t sky_subscription_get_event_count(sky_subscription *subscription);
+
+sky_subscription_event *sky_subscription_peek(sky_subscription *subscription,
+    uint32_t index);
+
+void sky_subscription_shift(sky_subscription *subscription, uint32_t count);
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+size_t sky_subscription_get_memory_usage(sky_subscription *subscription);
+
+#endif
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <inttypes.h>
 #include <unistd.h>
@@ -14,6 +15,8 @@
 #include "database.h"
 #include "block.h"
 #include "table.h"
+#include "stats.h"
+#include "timestamp.h"
 
 //==============================================================================
 //
@@ -30,12 +33,25 @@ int sky_table_lock(sky_table *table);
 int sky_table_unlock(sky_table *table);
 
 
+//--------------------------------------
+// Format
+//--------------------------------------
+
+int sky_table_load_format(sky_table *table);
+
+
 //--------------------------------------
 // Data file
 //--------------------------------------
 
 int sky_table_load_data_file(sky_table *table);
 
+int sky_table_load_shard_set(sky_table *table);
+
+int sky_table_load_partition_set(sky_table *table);
+
+bool sky_table_has_data_files(sky_table *table);
+
 int sky_table_unload_data_file(sky_table *table);
 
 
@@ -55,6 +71,166 @@ int sky_table_load_property_file(sky_table *table);
 
 int sky_table_unload_property_file(sky_table *table);
 
+//--------------------------------------
+// Dictionary file
+//--------------------------------------
+
+int sky_table_load_dictionary_file(sky_table *table);
+
+int sky_table_unload_dictionary_file(sky_table *table);
+
+//--------------------------------------
+// Event encoding
+//--------------------------------------
+
+int sky_table_encode_event(sky_table *table, sky_event *event);
+
+int sky_table_compare_events(const void *_a, const void *_b);
+
+
+//--------------------------------------
+// Memtable
+//--------------------------------------
+
+int sky_table_load_memtable(sky_table *table);
+
+int sky_table_unload_memtable(sky_table *table);
+
+int sky_table_merge_before(sky_table *table, sky_timestamp_t cutoff);
+
+sky_timestamp_t sky_table_get_reorder_cutoff(sky_table *table);
+
+
+//--------------------------------------
+// Event Management
+//--------------------------------------
+
+int sky_table_add_shard_events(sky_table *table, sky_event **events,
+    uint32_t event_count);
+
+
+//--------------------------------------
+// Indexes
+//--------------------------------------
+
+int sky_table_add_event_to_indexes(sky_table *table, sky_event *event);
+
+void sky_table_clear_indexes(sky_table *table);
+
+
+
+//--------------------------------------
+// Replication
+//--------------------------------------
+
+// Removes the data file of the table from disk and loads an empty data file
+// with a given block size in its place.
+//
+// table      - The table.
+// block_size - The block size of the new data file.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_reset_data_file(sky_table *table, uint32_t block_size)
+{
+    int rc;
+    check(table != NULL, "Table required");
+    check(table->shard_set == NULL, "Sharded tables cannot be replicated");
+    check(table->partition_set == NULL, "Partitioned tables cannot be replicated");
+    check(table->data_file != NULL, "Table must be open to reset");
+
+    rc = sky_data_file_remove_files(table->data_file);
+    check(rc == 0, "Unable to remove data file");
+
+    table->default_block_size = block_size;
+    rc = sky_table_load_data_file(table);
+    check(rc == 0, "Unable to load data file");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Reloads the action, property and dictionary files from disk after they
+// have been replaced.
+//
+// table - The table.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_reload_metadata(sky_table *table)
+{
+    int rc;
+    check(table != NULL, "Table required");
+
+    rc = sky_table_load_action_file(table);
+    check(rc == 0, "Unable to load action file");
+
+    rc = sky_table_load_property_file(table);
+    check(rc == 0, "Unable to load property file");
+
+    rc = sky_table_load_dictionary_file(table);
+    check(rc == 0, "Unable to load dictionary file");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Marks everything derived from the data file as stale after its blocks
+// have been replaced without adding events. Cached results are invalidated
+// by moving the data file to a new write version. Continuous queries and the
+// action index are dropped so that they are rebuilt with a full scan when
+// next requested.
+//
+// table - The table.
+void sky_table_invalidate(sky_table *table)
+{
+    uint32_t i;
+    if(table == NULL) return;
+
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        sky_data_file *data_file = sky_table_get_data_file(table, i);
+        data_file->write_version = __sync_add_and_fetch(&sky_data_file_last_write_version, 1);
+    }
+
+    for(i=0; i<table->continuous_query_count; i++) {
+        sky_continuous_query_free(table->continuous_queries[i]);
+    }
+    free(table->continuous_queries);
+    table->continuous_queries = NULL;
+    table->continuous_query_count = 0;
+
+    sky_table_clear_indexes(table);
+}
+
+
+//--------------------------------------
+// Continuous Queries
+//--------------------------------------
+
+int sky_table_update_continuous_queries(sky_table *table,
+    sky_object_id_t object_id, int64_t sign);
+
+int sky_table_execute_continuous_queries(sky_table *table);
+
+int sky_table_execute_continuous_query(sky_table *table,
+    sky_continuous_query *continuous_query);
+
+
+//--------------------------------------
+// Subscriptions
+//--------------------------------------
+
+int sky_table_publish_event(sky_table *table, sky_event *event);
+
+
+//--------------------------------------
+// Retention
+//--------------------------------------
+
+sky_timestamp_t sky_table_get_expiry_cutoff(sky_table *table);
+
 
 //==============================================================================
 //
@@ -91,8 +267,38 @@ void sky_table_free(sky_table *table)
         table->name = NULL;
         bdestroy(table->path);
         table->path = NULL;
+        sky_table_unload_memtable(table);
         sky_table_unload_action_file(table);
         sky_table_unload_property_file(table);
+        sky_table_unload_dictionary_file(table);
+
+        uint32_t i;
+        for(i=0; i<table->continuous_query_count; i++) {
+            sky_continuous_query_free(table->continuous_queries[i]);
+        }
+        free(table->continuous_queries);
+        table->continuous_queries = NULL;
+        table->continuous_query_count = 0;
+
+        for(i=0; i<table->subscription_count; i++) {
+            sky_subscription_free(table->subscriptions[i]);
+        }
+        free(table->subscriptions);
+        table->subscriptions = NULL;
+        table->subscription_count = 0;
+
+        sky_result_cache_free(table->result_cache);
+        table->result_cache = NULL;
+
+        sky_action_index_free(table->action_index);
+        table->action_index = NULL;
+        for(i=0; i<table->property_index_count; i++) {
+            sky_property_index_free(table->property_indexes[i]);
+        }
+        free(table->property_indexes);
+        table->property_indexes = NULL;
+        table->property_index_count = 0;
+
         free(table);
     }
 }
@@ -139,14 +345,28 @@ error:
 int sky_table_load_data_file(sky_table *table)
 {
     int rc;
+    bstring tablespace_path = NULL;
     check(table != NULL, "Table required");
     check(table->path != NULL, "Table path required");
     
     // Unload any existing data file.
     sky_table_unload_data_file(table);
+
+    // Partitioned tables keep a data file for each period and sharded
+    // tables keep one for each shard instead.
+    rc = sky_table_load_partition_set(table);
+    check(rc == 0, "Unable to load partition set");
+    if(table->partition_set != NULL) {
+        return 0;
+    }
+    rc = sky_table_load_shard_set(table);
+    check(rc == 0, "Unable to load shard set");
+    if(table->shard_set != NULL) {
+        return 0;
+    }
     
     // Initialize table space (0).
-    bstring tablespace_path = bformat("%s/0", bdata(table->path));
+    tablespace_path = bformat("%s/0", bdata(table->path));
     if(!sky_file_exists(tablespace_path)) {
         rc = mkdir(bdata(tablespace_path), S_IRWXU);
         check(rc == 0, "Unable to create tablespace directory: %s", bdata(tablespace_path));
@@ -165,6 +385,18 @@ int sky_table_load_data_file(sky_table *table)
     if(table->default_block_size > 0) {
         table->data_file->block_size = table->default_block_size;
     }
+    table->data_file->durability = table->durability;
+    table->data_file->preload = table->preload;
+    table->data_file->huge_pages = table->huge_pages;
+    table->data_file->action_only = table->action_only;
+    if(table->block_cache_size > 0) {
+        table->data_file->block_cache_size = table->block_cache_size;
+    }
+    table->data_file->prefetcher = table->prefetcher;
+
+    // Tables mostly look up and insert single paths. Scans switch the data
+    // file to sequential access while they run.
+    table->data_file->access_pattern = SKY_ACCESS_PATTERN_RANDOM;
     
     // Load data
     rc = sky_data_file_load(table->data_file);
@@ -177,6 +409,116 @@ error:
     return -1;
 }
 
+// Opens the shard set of a sharded table. An existing table keeps the
+// number of shard directories it has, so a table without shards has one
+// and is left to its single data file. The shard count of the table is set
+// to the number of shards it ends up with.
+//
+// table - The table to open the shard set for.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_load_shard_set(sky_table *table)
+{
+    int rc;
+    check(table != NULL, "Table required");
+
+    table->shard_set = sky_shard_set_create(); check_mem(table->shard_set);
+    table->shard_set->path = bstrcpy(table->path); check_mem(table->shard_set->path);
+    uint32_t existing_count = sky_shard_set_count_shard_dirs(table->shard_set);
+    table->shard_count = (existing_count > 0 ? existing_count : table->shard_count);
+    if(table->shard_count <= 1) {
+        sky_shard_set_free(table->shard_set);
+        table->shard_set = NULL;
+        table->shard_count = 1;
+        return 0;
+    }
+
+    // Initialize settings on the shards.
+    if(table->default_block_size > 0) {
+        table->shard_set->block_size = table->default_block_size;
+    }
+    table->shard_set->durability = table->durability;
+    table->shard_set->preload = table->preload;
+    table->shard_set->huge_pages = table->huge_pages;
+    table->shard_set->action_only = table->action_only;
+    table->shard_set->block_cache_size = table->block_cache_size;
+    table->shard_set->prefetcher = table->prefetcher;
+
+    rc = sky_shard_set_load(table->shard_set, table->shard_count);
+    check(rc == 0, "Unable to load shards");
+
+    return 0;
+
+error:
+    if(table) {
+        sky_shard_set_free(table->shard_set);
+        table->shard_set = NULL;
+    }
+    return -1;
+}
+
+// Opens the partition set of a partitioned table. A table is partitioned
+// if it has a partitions directory. A new table is also partitioned if it
+// has a partition period, but a table that already has its data file stays
+// in it. The partition period of the table is set to the period of the set
+// or to zero if the table is not partitioned.
+//
+// table - The table to open the partition set for.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_load_partition_set(sky_table *table)
+{
+    int rc;
+    bstring path = NULL;
+    bstring tablespace_path = NULL;
+    check(table != NULL, "Table required");
+
+    path = bformat("%s/%s", bdata(table->path), SKY_TABLE_PARTITIONS_NAME);
+    check_mem(path);
+    tablespace_path = bformat("%s/0", bdata(table->path));
+    check_mem(tablespace_path);
+    if(!sky_file_exists(path) && (table->partition_period == 0 || sky_file_exists(tablespace_path))) {
+        table->partition_period = 0;
+        bdestroy(path);
+        bdestroy(tablespace_path);
+        return 0;
+    }
+    bdestroy(tablespace_path);
+    tablespace_path = NULL;
+
+    table->partition_set = sky_partition_set_create(); check_mem(table->partition_set);
+    table->partition_set->path = path;
+    path = NULL;
+    table->partition_set->period = table->partition_period;
+
+    // Initialize settings on the partitions.
+    if(table->default_block_size > 0) {
+        table->partition_set->block_size = table->default_block_size;
+    }
+    table->partition_set->durability = table->durability;
+    table->partition_set->preload = table->preload;
+    table->partition_set->huge_pages = table->huge_pages;
+    table->partition_set->action_only = table->action_only;
+    table->partition_set->block_cache_size = table->block_cache_size;
+    table->partition_set->prefetcher = table->prefetcher;
+
+    rc = sky_partition_set_load(table->partition_set);
+    check(rc == 0, "Unable to load partitions");
+    table->partition_period = table->partition_set->period;
+    table->shard_count = 1;
+
+    return 0;
+
+error:
+    bdestroy(path);
+    bdestroy(tablespace_path);
+    if(table) {
+        sky_partition_set_free(table->partition_set);
+        table->partition_set = NULL;
+    }
+    return -1;
+}
+
 // Initializes and opens the data file on the table.
 //
 // table - The table to initialize the data file for.
@@ -190,25 +532,148 @@ int sky_table_unload_data_file(sky_table *table)
         sky_data_file_free(table->data_file);
         table->data_file = NULL;
     }
+    if(table->shard_set) {
+        sky_shard_set_free(table->shard_set);
+        table->shard_set = NULL;
+    }
+    if(table->partition_set) {
+        sky_partition_set_free(table->partition_set);
+        table->partition_set = NULL;
+    }
+    sky_table_clear_indexes(table);
 
     return 0;
 error:
     return -1;
 }
 
+// Counts the data files of the table. A sharded table has one for each
+// shard, a partitioned table has one for each partition, in time order, and
+// an unsharded table has a single one while it is open.
+//
+// table - The table.
+//
+// Returns the number of data files.
+uint32_t sky_table_get_data_file_count(sky_table *table)
+{
+    if(table->shard_set != NULL) {
+        return table->shard_set->shard_count;
+    }
+    if(table->partition_set != NULL) {
+        return table->partition_set->partition_count;
+    }
+    return (table->data_file != NULL ? 1 : 0);
+}
+
+// Retrieves a data file of the table.
+//
+// table - The table.
+// index - The index of the data file, below the data file count.
+//
+// Returns the data file.
+sky_data_file *sky_table_get_data_file(sky_table *table, uint32_t index)
+{
+    if(table->shard_set != NULL) {
+        return table->shard_set->shards[index].data_file;
+    }
+    if(table->partition_set != NULL) {
+        return table->partition_set->partitions[index].data_file;
+    }
+    return table->data_file;
+}
+
+// Checks whether the data files of the table are loaded. A partitioned
+// table may have no partitions yet while it is open.
+//
+// table - The table.
+//
+// Returns true if the data files are loaded.
+bool sky_table_has_data_files(sky_table *table)
+{
+    return (table->data_file != NULL || table->shard_set != NULL || table->partition_set != NULL);
+}
+
+// Retrieves the data file that holds the path of an object. The path of an
+// object in a partitioned table is split across its partitions so no single
+// data file holds it.
+//
+// table     - The table.
+// object_id - The object id.
+//
+// Returns the data file or null if the table is partitioned.
+sky_data_file *sky_table_get_object_data_file(sky_table *table,
+                                              sky_object_id_t object_id)
+{
+    if(table->shard_set != NULL) {
+        return table->shard_set->shards[sky_shard_set_get_shard_index(table->shard_set, object_id)].data_file;
+    }
+    if(table->partition_set != NULL) {
+        return NULL;
+    }
+    return table->data_file;
+}
+
+// Counts the blocks in every data file of the table.
+//
+// table - The table.
+//
+// Returns the number of blocks.
+uint32_t sky_table_get_block_count(sky_table *table)
+{
+    uint32_t i;
+    uint32_t block_count = 0;
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        block_count += sky_table_get_data_file(table, i)->block_count;
+    }
+    return block_count;
+}
+
+// Retrieves the block size of the table's data files. A partitioned table
+// creates its partitions with the block size of its partition set.
+//
+// table - The table.
+//
+// Returns the block size.
+uint32_t sky_table_get_block_size(sky_table *table)
+{
+    if(table->partition_set != NULL) {
+        return table->partition_set->block_size;
+    }
+    return sky_table_get_data_file(table, 0)->block_size;
+}
+
+// Determines the latest write version of the table's data files. Any
+// change to the table moves it forward.
+//
+// table - The table.
+//
+// Returns the write version.
+uint64_t sky_table_get_write_version(sky_table *table)
+{
+    uint32_t i;
+    uint64_t write_version = 0;
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        sky_data_file *data_file = sky_table_get_data_file(table, i);
+        if(data_file->write_version > write_version) {
+            write_version = data_file->write_version;
+        }
+    }
+    return write_version;
+}
+
 
 //--------------------------------------
 // Action file management
 //--------------------------------------
 
-// Initializes and opens the action file on the table.
+// Initializes the action file on the table. The actions are loaded from
+// disk the first time they are used.
 //
 // table - The table to initialize the action file for.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_table_load_action_file(sky_table *table)
 {
-    int rc;
     check(table != NULL, "Table required");
     check(table->path != NULL, "Table path required");
     
@@ -220,10 +685,7 @@ int sky_table_load_action_file(sky_table *table)
     check_mem(table->action_file);
     table->action_file->path = bformat("%s/actions", bdata(table->path));
     check_mem(table->action_file->path);
-    
-    // Load data
-    rc = sky_action_file_load(table->action_file);
-    check(rc == 0, "Unable to load actions");
+    table->action_file->loaded = false;
 
     return 0;
 error:
@@ -255,14 +717,14 @@ error:
 // Property file management
 //--------------------------------------
 
-// Initializes and opens the property file on the table.
+// Initializes the property file on the table. The properties are loaded
+// from disk the first time they are used.
 //
 // table - The table to initialize the property file for.
 //
 // Returns 0 if successful, otherwise returns -1.
 int sky_table_load_property_file(sky_table *table)
 {
-    int rc;
     check(table != NULL, "Table required");
     check(table->path != NULL, "Table path required");
     
@@ -274,10 +736,7 @@ int sky_table_load_property_file(sky_table *table)
     check_mem(table->property_file);
     table->property_file->path = bformat("%s/properties", bdata(table->path));
     check_mem(table->property_file->path);
-    
-    // Load data
-    rc = sky_property_file_load(table->property_file);
-    check(rc == 0, "Unable to load properties");
+    table->property_file->loaded = false;
 
     return 0;
 error:
@@ -306,50 +765,196 @@ error:
 
 
 //--------------------------------------
-// State
+// Dictionary file management
 //--------------------------------------
 
-// Opens the table for reading and writing events.
-// 
-// table - The table to open.
+// Initializes and opens the dictionary file on the table.
+//
+// table - The table to initialize the dictionary file for.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_table_open(sky_table *table)
+int sky_table_load_dictionary_file(sky_table *table)
 {
     int rc;
+    bstring path = NULL;
     check(table != NULL, "Table required");
-    check(table->path != NULL, "Table path is required");
-    check(!table->opened, "Table is already open");
-
-    // Create directory if it doesn't exist.
-    if(!sky_file_exists(table->path)) {
-        rc = mkdir(bdata(table->path), S_IRWXU);
-        check(rc == 0, "Unable to create table directory: %s", bdata(table->path));
-    }
+    check(table->path != NULL, "Table path required");
 
-    // Obtain a lock.
-    rc = sky_table_lock(table);
-    check(rc == 0, "Unable to obtain lock");
+    // Unload any existing dictionary file.
+    sky_table_unload_dictionary_file(table);
 
-    // Load data file.
-    rc = sky_table_load_data_file(table);
-    check(rc == 0, "Unable to load data file");
-    
-    // Load action file.
-    rc = sky_table_load_action_file(table);
-    check(rc == 0, "Unable to load action file");
-    
-    // Load property file.
-    rc = sky_table_load_property_file(table);
-    check(rc == 0, "Unable to load property file");
-    
-    // Flag the table as open.
-    table->opened = true;
+    // Open the dictionary file.
+    table->dictionary_file = sky_dictionary_file_create();
+    check_mem(table->dictionary_file);
+    path = bformat("%s/%s", bdata(table->path), SKY_DICTIONARY_FILE_NAME);
+    check_mem(path);
+    rc = sky_dictionary_file_open(table->dictionary_file, path);
+    check(rc == 0, "Unable to open dictionary file");
 
+    bdestroy(path);
     return 0;
 
 error:
-    sky_table_close(table);
+    bdestroy(path);
+    sky_table_unload_dictionary_file(table);
+    return -1;
+}
+
+// Closes the dictionary file on the table.
+//
+// table - The table to close the dictionary file for.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_unload_dictionary_file(sky_table *table)
+{
+    check(table != NULL, "Table required");
+
+    if(table->dictionary_file) {
+        sky_dictionary_file_free(table->dictionary_file);
+        table->dictionary_file = NULL;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Memtable management
+//--------------------------------------
+
+// Initializes the memtable on the table and replays its write-ahead log.
+//
+// table - The table to initialize the memtable for.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_load_memtable(sky_table *table)
+{
+    int rc;
+    bstring path = NULL;
+    check(table != NULL, "Table required");
+    check(table->path != NULL, "Table path required");
+    check(table->shard_set == NULL, "Sharded tables cannot buffer writes in a memtable");
+    check(table->partition_set == NULL, "Partitioned tables cannot buffer writes in a memtable");
+
+    // Unload any existing memtable.
+    sky_table_unload_memtable(table);
+
+    // Initialize memtable.
+    table->memtable = sky_memtable_create();
+    check_mem(table->memtable);
+    table->memtable->sync = (table->durability == SKY_DURABILITY_STRICT);
+
+    // Open the log.
+    path = bformat("%s/%s", bdata(table->path), SKY_MEMTABLE_LOG_NAME);
+    check_mem(path);
+    rc = sky_memtable_open(table->memtable, path);
+    check(rc == 0, "Unable to open memtable");
+
+    bdestroy(path);
+    return 0;
+
+error:
+    bdestroy(path);
+    sky_table_unload_memtable(table);
+    return -1;
+}
+
+// Merges the buffered events into the data file and removes the memtable.
+//
+// table - The table to remove the memtable from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_unload_memtable(sky_table *table)
+{
+    int rc;
+    check(table != NULL, "Table required");
+
+    if(table->memtable) {
+        rc = sky_table_merge(table);
+        check(rc == 0, "Unable to merge memtable");
+        sky_memtable_free(table->memtable);
+        table->memtable = NULL;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// State
+//--------------------------------------
+
+// Opens the table for reading and writing events.
+// 
+// table - The table to open.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_open(sky_table *table)
+{
+    int rc;
+    check(table != NULL, "Table required");
+    check(table->path != NULL, "Table path is required");
+    check(!table->opened, "Table is already open");
+
+    // Create directory if it doesn't exist.
+    if(!sky_file_exists(table->path)) {
+        rc = mkdir(bdata(table->path), S_IRWXU);
+        check(rc == 0, "Unable to create table directory: %s", bdata(table->path));
+    }
+
+    // Obtain a lock.
+    rc = sky_table_lock(table);
+    check(rc == 0, "Unable to obtain lock");
+
+    // Determine the format of the table. A new table is marked as
+    // action-only before its data file is created.
+    rc = sky_table_load_format(table);
+    check(rc == 0, "Unable to load table format");
+
+    // Load data file.
+    rc = sky_table_load_data_file(table);
+    check(rc == 0, "Unable to load data file");
+    
+    // Load action file.
+    rc = sky_table_load_action_file(table);
+    check(rc == 0, "Unable to load action file");
+    
+    // Load property file.
+    rc = sky_table_load_property_file(table);
+    check(rc == 0, "Unable to load property file");
+
+    // Load dictionary file.
+    rc = sky_table_load_dictionary_file(table);
+    check(rc == 0, "Unable to load dictionary file");
+    
+    // Load the memtable if writes are buffered or if events were left in the
+    // log. Leftover events are merged right away if buffering is off.
+    bstring log_path = bformat("%s/%s", bdata(table->path), SKY_MEMTABLE_LOG_NAME);
+    check_mem(log_path);
+    bool has_log = (sky_file_exists(log_path) && sky_file_get_size(log_path) > 0);
+    bdestroy(log_path);
+    if(table->memtable_size > 0 || has_log) {
+        rc = sky_table_load_memtable(table);
+        check(rc == 0, "Unable to load memtable");
+    }
+    if(table->memtable_size == 0) {
+        rc = sky_table_unload_memtable(table);
+        check(rc == 0, "Unable to merge memtable");
+    }
+
+    // Flag the table as open.
+    table->opened = true;
+
+    return 0;
+
+error:
+    sky_table_close(table);
     return -1;
 }
 
@@ -363,6 +968,10 @@ int sky_table_close(sky_table *table)
     int rc;
     check(table != NULL, "Table required to close");
 
+    // Merge buffered events before the data file is unloaded.
+    rc = sky_table_unload_memtable(table);
+    check(rc == 0, "Unable to unload memtable");
+
     // Unload data file.
     rc = sky_table_unload_data_file(table);
     check(rc == 0, "Unable to unload data file");
@@ -375,6 +984,10 @@ int sky_table_close(sky_table *table)
     rc = sky_table_unload_property_file(table);
     check(rc == 0, "Unable to unload property file");
 
+    // Unload dictionary data.
+    rc = sky_table_unload_dictionary_file(table);
+    check(rc == 0, "Unable to unload dictionary file");
+
     // Update state to closed.
     table->opened = false;
 
@@ -389,94 +1002,1724 @@ error:
 }
 
 
-//--------------------------------------
-// Locking
-//--------------------------------------
+// Changes the durability mode of the table.
+//
+// table      - The table.
+// durability - The durability mode.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_set_durability(sky_table *table, sky_durability_e durability)
+{
+    int rc;
+    uint32_t i;
+    check(table != NULL, "Table required");
 
-// Creates a lock file for the table.
-// 
-// table - The table to lock.
+    table->durability = durability;
+    if(table->partition_set != NULL) {
+        table->partition_set->durability = durability;
+    }
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        rc = sky_data_file_set_durability(sky_table_get_data_file(table, i), durability);
+        check(rc == 0, "Unable to set data file durability");
+    }
+    if(table->memtable != NULL) {
+        table->memtable->sync = (durability == SKY_DURABILITY_STRICT);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Syncs all outstanding changes on the table to disk. Buffered events that
+// are inside the reorder window stay in the memtable and the log is synced
+// instead.
+//
+// table - The table.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_table_lock(sky_table *table)
+int sky_table_flush(sky_table *table)
 {
-    check(table != NULL, "Table required to lock");
+    int rc;
+    uint32_t i;
+    check(table != NULL, "Table required");
 
-    // Construct path to lock.
-    bstring path = bformat("%s/%s", bdata(table->path), SKY_LOCK_NAME); check_mem(path);
+    if(table->opened && sky_table_get_data_file_count(table) > 0) {
+        rc = sky_table_merge_before(table, sky_table_get_reorder_cutoff(table));
+        check(rc == 0, "Unable to merge memtable");
 
-    // Open file with an exclusive lock. If this fails then it means another
-    // process already has obtained a lock.
-    table->lock_file = fopen(bdata(path), "w");
-    check(table->lock_file != NULL, "Table is already locked: %s", bdata(table->path));
+        for(i=0; i<sky_table_get_data_file_count(table); i++) {
+            rc = sky_data_file_flush(sky_table_get_data_file(table, i));
+            check(rc == 0, "Unable to flush data file");
+        }
 
-    // Clean up.
-    bdestroy(path);
+        // Events held back by the reorder window are made durable in the log.
+        if(table->memtable != NULL && table->memtable->event_count > 0) {
+            rc = sky_memtable_sync(table->memtable);
+            check(rc == 0, "Unable to sync memtable");
+        }
+    }
 
     return 0;
 
 error:
-    bdestroy(path);
     return -1;
 }
 
-// Unlocks an table.
-// 
-// table - The table to unlock.
+// Changes the number of events that the table buffers in its memtable before
+// merging them into the data file. A size of zero turns buffering off and
+// merges any buffered events.
+//
+// table         - The table.
+// memtable_size - The maximum number of buffered events.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_table_unlock(sky_table *table)
+int sky_table_set_memtable_size(sky_table *table, uint32_t memtable_size)
 {
-    check(table != NULL, "Table required to unlock");
+    int rc;
+    check(table != NULL, "Table required");
 
-    // Generate lock file path.
-    bstring path = NULL;
+    table->memtable_size = memtable_size;
+    if(table->opened && memtable_size > 0 && table->memtable == NULL) {
+        rc = sky_table_load_memtable(table);
+        check(rc == 0, "Unable to load memtable");
+    }
+    else if(memtable_size == 0 && table->memtable != NULL) {
+        rc = sky_table_unload_memtable(table);
+        check(rc == 0, "Unable to unload memtable");
+    }
 
-    // Only attempt to remove the lock if one has been obtained.
-    if(table->lock_file != NULL) {
-        // Close the lock file descriptor.
-        fclose(table->lock_file);
+    return 0;
 
-        // Remove the lock file. We don't necessarily care if it gets cleaned
-        // up so don't check for an error. The write lock is the more
-        // important piece.
-        path = bformat("%s/%s", bdata(table->path), SKY_LOCK_NAME); check_mem(path);
-        unlink(bdata(path));
-    }
+error:
+    return -1;
+}
 
-    bdestroy(path);
+// Changes how long the memtable holds back the most recent events so that
+// late events can be sorted in with them. A window of zero merges every
+// buffered event. The window has no effect without a memtable.
+//
+// table          - The table.
+// reorder_window - The number of seconds of event time to hold back.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_set_reorder_window(sky_table *table, uint32_t reorder_window)
+{
+    check(table != NULL, "Table required");
+    table->reorder_window = reorder_window;
     return 0;
 
 error:
-    bdestroy(path);
     return -1;
 }
 
+// Changes whether the data file's blocks are read into memory as they are
+// mapped.
+//
+// table   - The table.
+// preload - Whether blocks are preloaded.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_set_preload(sky_table *table, bool preload)
+{
+    int rc;
+    uint32_t i;
+    check(table != NULL, "Table required");
+
+    table->preload = preload;
+    if(table->partition_set != NULL) {
+        table->partition_set->preload = preload;
+    }
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        rc = sky_data_file_set_preload(sky_table_get_data_file(table, i), preload);
+        check(rc == 0, "Unable to set data file preloading");
+    }
 
-//--------------------------------------
-// Event Management
-//--------------------------------------
+    return 0;
+
+error:
+    return -1;
+}
 
-// Adds an event to the table.
+// Changes whether the data file's mappings ask for transparent huge pages.
 //
-// table - The table to add the event to..
-// event - The event to add.
+// table      - The table.
+// huge_pages - Whether huge pages are requested.
 //
 // Returns 0 if successful, otherwise returns -1.
-int sky_table_add_event(sky_table *table, sky_event *event)
+int sky_table_set_huge_pages(sky_table *table, bool huge_pages)
 {
     int rc;
+    uint32_t i;
     check(table != NULL, "Table required");
-    check(event != NULL, "Event required");
-    check(table->opened, "Table must be open to add an event");
 
-    // Delegate to the data file.
-    rc = sky_data_file_add_event(table->data_file, event);
-    check(rc == 0, "Unable to add event to data file");
-    
+    table->huge_pages = huge_pages;
+    if(table->partition_set != NULL) {
+        table->partition_set->huge_pages = huge_pages;
+    }
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        rc = sky_data_file_set_huge_pages(sky_table_get_data_file(table, i), huge_pages);
+        check(rc == 0, "Unable to set data file huge pages");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Changes the number of bytes of decompressed blocks that the table's data
+// file caches.
+//
+// table            - The table.
+// block_cache_size - The number of bytes to cache.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_set_block_cache_size(sky_table *table, size_t block_cache_size)
+{
+    uint32_t i;
+    check(table != NULL, "Table required");
+
+    table->block_cache_size = block_cache_size;
+    if(table->partition_set != NULL) {
+        table->partition_set->block_cache_size = block_cache_size;
+    }
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        sky_data_file *data_file = sky_table_get_data_file(table, i);
+        data_file->block_cache_size = block_cache_size;
+        sky_block_cache_set_capacity(data_file->block_cache, block_cache_size);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Changes the prefetcher that reads the table's blocks ahead of scans.
+//
+// table      - The table.
+// prefetcher - The prefetcher or NULL to read blocks as they are scanned.
+//              This is not owned by the table.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_set_prefetcher(sky_table *table, sky_prefetcher *prefetcher)
+{
+    uint32_t i;
+    check(table != NULL, "Table required");
+
+    table->prefetcher = prefetcher;
+    if(table->partition_set != NULL) {
+        table->partition_set->prefetcher = prefetcher;
+    }
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        sky_table_get_data_file(table, i)->prefetcher = prefetcher;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Changes the number of bytes of query responses that the table caches. The
+// cached responses are discarded. A size of zero disables the cache.
+//
+// table             - The table.
+// result_cache_size - The number of bytes to cache.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_set_result_cache_size(sky_table *table, size_t result_cache_size)
+{
+    check(table != NULL, "Table required");
+
+    sky_result_cache_free(table->result_cache);
+    table->result_cache = NULL;
+    table->result_cache_size = result_cache_size;
+    if(result_cache_size > 0) {
+        table->result_cache = sky_result_cache_create(result_cache_size);
+        check_mem(table->result_cache);
+    }
+
     return 0;
 
 error:
     return -1;
 }
 
+// Changes the number of seconds that the events of the table are kept for.
+// Expired events are dropped by sky_table_expire() and sky_table_compact().
+// A retention of zero keeps events forever.
+//
+// table     - The table.
+// retention - The number of seconds to keep events for.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_set_retention(sky_table *table, uint32_t retention)
+{
+    check(table != NULL, "Table required");
+    table->retention = retention;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Requests that the table is created as action-only. This only affects a
+// table that does not exist yet and must be set before the table is opened.
+// Opening the table sets the flag to the table's actual format.
+//
+// table       - The table.
+// action_only - Whether events with data are refused.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_set_action_only(sky_table *table, bool action_only)
+{
+    check(table != NULL, "Table required");
+    check(!table->opened, "Table format cannot be changed while it is open");
+    table->action_only = action_only;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Requests that the table is created with a number of shards. Like the
+// action-only format this only affects a table that does not exist yet and
+// must be set before the table is opened. A count of zero or one keeps the
+// table in a single data file. Opening the table sets the count to the
+// number of shards that the table actually has.
+//
+// table       - The table.
+// shard_count - The number of shards.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_set_shard_count(sky_table *table, uint32_t shard_count)
+{
+    check(table != NULL, "Table required");
+    check(!table->opened, "Table shards cannot be changed while it is open");
+    table->shard_count = shard_count;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Requests that the table is created with one partition for every period
+// of a number of seconds. Like the shard count this only affects a table
+// that does not exist yet and must be set before the table is opened. A
+// period of zero keeps the table in a single data file. The period takes
+// precedence over the shard count. Opening the table sets the period to
+// the period that the table actually has.
+//
+// table            - The table.
+// partition_period - The length of each partition in seconds.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_set_partition_period(sky_table *table, uint32_t partition_period)
+{
+    check(table != NULL, "Table required");
+    check(!table->opened, "Table partitions cannot be changed while it is open");
+    table->partition_period = partition_period;
+    return 0;
+
+error:
+    return -1;
+}
+
+// Reads whether the table is action-only from its marker file. A requested
+// action-only format is only applied to a table whose data file has not
+// been created yet.
+//
+// table - The table.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_load_format(sky_table *table)
+{
+    int rc;
+    bstring path = NULL;
+    bstring header_path = NULL;
+    check(table != NULL, "Table required");
+
+    path = bformat("%s/%s", bdata(table->path), SKY_TABLE_ACTION_ONLY_NAME);
+    check_mem(path);
+    header_path = bformat("%s/0/header", bdata(table->path));
+    check_mem(header_path);
+
+    if(sky_file_exists(path)) {
+        table->action_only = true;
+    }
+    else if(table->action_only && sky_file_exists(header_path)) {
+        table->action_only = false;
+    }
+    else if(table->action_only) {
+        rc = sky_file_write(path, NULL, 0);
+        check(rc == 0, "Unable to write action-only marker: %s", bdata(path));
+    }
+
+    bdestroy(path);
+    bdestroy(header_path);
+    return 0;
+
+error:
+    bdestroy(path);
+    bdestroy(header_path);
+    return -1;
+}
+
+// Counts the events that have been added to the table but are not yet
+// synced into the data file. This includes the events in the memtable.
+//
+// table - The table.
+//
+// Returns the number of events.
+uint32_t sky_table_get_unflushed_event_count(sky_table *table)
+{
+    uint32_t i;
+    uint32_t count = 0;
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        count += sky_table_get_data_file(table, i)->unflushed_event_count;
+    }
+    if(table->memtable != NULL) {
+        count += table->memtable->event_count;
+    }
+    return count;
+}
+
+
+//--------------------------------------
+// Locking
+//--------------------------------------
+
+// Creates a lock file for the table.
+// 
+// table - The table to lock.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_lock(sky_table *table)
+{
+    check(table != NULL, "Table required to lock");
+
+    // Construct path to lock.
+    bstring path = bformat("%s/%s", bdata(table->path), SKY_LOCK_NAME); check_mem(path);
+
+    // Open file with an exclusive lock. If this fails then it means another
+    // process already has obtained a lock.
+    table->lock_file = fopen(bdata(path), "w");
+    check(table->lock_file != NULL, "Table is already locked: %s", bdata(table->path));
+
+    // Clean up.
+    bdestroy(path);
+
+    return 0;
+
+error:
+    bdestroy(path);
+    return -1;
+}
+
+// Unlocks an table.
+// 
+// table - The table to unlock.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_unlock(sky_table *table)
+{
+    check(table != NULL, "Table required to unlock");
+
+    // Generate lock file path.
+    bstring path = NULL;
+
+    // Only attempt to remove the lock if one has been obtained.
+    if(table->lock_file != NULL) {
+        // Close the lock file descriptor.
+        fclose(table->lock_file);
+
+        // Remove the lock file. We don't necessarily care if it gets cleaned
+        // up so don't check for an error. The write lock is the more
+        // important piece.
+        path = bformat("%s/%s", bdata(table->path), SKY_LOCK_NAME); check_mem(path);
+        unlink(bdata(path));
+    }
+
+    bdestroy(path);
+    return 0;
+
+error:
+    bdestroy(path);
+    return -1;
+}
+
+
+//--------------------------------------
+// Event Management
+//--------------------------------------
+
+// Adds an event to the table. String values of properties with a String
+// data type are replaced on the event by their dictionary codes. Once the
+// event has been added it is pushed to the subscriptions of the table.
+//
+// table - The table to add the event to..
+// event - The event to add.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_add_event(sky_table *table, sky_event *event)
+{
+    int rc;
+    check(table != NULL, "Table required");
+    check(event != NULL, "Event required");
+    check(table->opened, "Table must be open to add an event");
+    check(!table->action_only || event->data_count == 0, "Events with data cannot be added to an action-only table");
+
+    rc = sky_table_encode_event(table, event);
+    check(rc == 0, "Unable to encode event");
+
+    rc = sky_table_add_event_to_indexes(table, event);
+    check(rc == 0, "Unable to index event");
+
+    // Buffer the event in the memtable and merge once it is full.
+    if(table->memtable != NULL) {
+        rc = sky_memtable_append(table->memtable, event);
+        check(rc == 0, "Unable to add event to memtable");
+
+        // Events inside the reorder window are held back unless the
+        // memtable would stay full.
+        if(table->memtable->event_count >= table->memtable_size) {
+            rc = sky_table_merge_before(table, sky_table_get_reorder_cutoff(table));
+            check(rc == 0, "Unable to merge memtable");
+        }
+        if(table->memtable->event_count >= table->memtable_size) {
+            rc = sky_table_merge(table);
+            check(rc == 0, "Unable to merge memtable");
+        }
+    }
+    // Otherwise delegate to the data file. Continuous queries recount the
+    // path of the object around the insert.
+    else {
+        if(table->continuous_query_count > 0) {
+            rc = sky_table_update_continuous_queries(table, event->object_id, -1);
+            check(rc == 0, "Unable to subtract path from continuous queries");
+        }
+
+        if(table->shard_set != NULL) {
+            rc = sky_shard_set_add_event(table->shard_set, event);
+            check(rc == 0, "Unable to add event to shard set");
+        }
+        else if(table->partition_set != NULL) {
+            rc = sky_partition_set_add_event(table->partition_set, event);
+            check(rc == 0, "Unable to add event to partition set");
+        }
+        else {
+            rc = sky_data_file_add_event(table->data_file, event);
+            check(rc == 0, "Unable to add event to data file");
+        }
+
+        if(table->continuous_query_count > 0) {
+            rc = sky_table_update_continuous_queries(table, event->object_id, 1);
+            check(rc == 0, "Unable to add path to continuous queries");
+        }
+    }
+    sky_stats_add(events_inserted, 1);
+
+    // Buffer the event for subscribers.
+    if(table->subscription_count > 0) {
+        rc = sky_table_publish_event(table, event);
+        check(rc == 0, "Unable to publish event");
+    }
+    
+    return 0;
+
+error:
+    return -1;
+}
+
+// Adds a list of events to the table. The events are sorted by object id and
+// timestamp so that blocks are filled in order and all changes are synced
+// once at the end.
+//
+// table       - The table to add the events to.
+// events      - The events to add. The array is sorted in place.
+// event_count - The number of events.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_add_events(sky_table *table, sky_event **events,
+                         uint32_t event_count)
+{
+    check(events != NULL || event_count == 0, "Events required");
+    sky_table_sort_events(events, event_count);
+    return sky_table_add_sorted_events(table, events, event_count);
+
+error:
+    return -1;
+}
+
+// Adds a list of events that are already sorted by object id and timestamp
+// to the table. All changes are synced once at the end and events that were
+// added before a failure are still flushed. The shards of a sharded table
+// are written in parallel unless continuous queries need to recount each
+// path as its events are added. The partitions of a partitioned table that
+// the events fall in are created before the batch starts.
+//
+// table       - The table to add the events to.
+// events      - The sorted events to add.
+// event_count - The number of events.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_add_sorted_events(sky_table *table, sky_event **events,
+                                uint32_t event_count)
+{
+    int rc;
+    uint32_t i;
+    uint32_t batch_count = 0;
+    check(table != NULL, "Table required");
+    check(events != NULL || event_count == 0, "Events required");
+    check(table->opened, "Table must be open to add events");
+
+    if(table->shard_set != NULL && table->continuous_query_count == 0) {
+        rc = sky_table_add_shard_events(table, events, event_count);
+        check(rc == 0, "Unable to add events to shards");
+        return 0;
+    }
+    if(table->partition_set != NULL) {
+        for(i=0; i<event_count; i++) {
+            sky_partition *partition = NULL;
+            rc = sky_partition_set_get_partition(table->partition_set, events[i]->timestamp, true, &partition);
+            check(rc == 0, "Unable to create partition for event #%d", i);
+        }
+    }
+
+    for(batch_count=0; batch_count<sky_table_get_data_file_count(table); batch_count++) {
+        rc = sky_data_file_begin_batch(sky_table_get_data_file(table, batch_count));
+        check(rc == 0, "Unable to begin batch");
+    }
+
+    for(i=0; i<event_count; i++) {
+        rc = sky_table_add_event(table, events[i]);
+        check(rc == 0, "Unable to add event #%d", i);
+    }
+
+    while(batch_count > 0) {
+        rc = sky_data_file_end_batch(sky_table_get_data_file(table, --batch_count));
+        check(rc == 0, "Unable to end batch");
+    }
+
+    return 0;
+
+error:
+    while(batch_count > 0) {
+        sky_data_file_end_batch(sky_table_get_data_file(table, --batch_count));
+    }
+    return -1;
+}
+
+// Adds a list of events to the shards of a sharded table. The events are
+// encoded and indexed here and the shard set then writes the events of each
+// shard on its own thread.
+//
+// table       - The table to add the events to.
+// events      - The sorted events to add.
+// event_count - The number of events.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_add_shard_events(sky_table *table, sky_event **events,
+                               uint32_t event_count)
+{
+    int rc;
+    uint32_t i;
+
+    for(i=0; i<event_count; i++) {
+        check(!table->action_only || events[i]->data_count == 0, "Events with data cannot be added to an action-only table");
+
+        rc = sky_table_encode_event(table, events[i]);
+        check(rc == 0, "Unable to encode event #%d", i);
+
+        rc = sky_table_add_event_to_indexes(table, events[i]);
+        check(rc == 0, "Unable to index event #%d", i);
+    }
+
+    rc = sky_shard_set_add_events(table->shard_set, events, event_count);
+    check(rc == 0, "Unable to add events to shard set");
+    sky_stats_add(events_inserted, event_count);
+
+    // Buffer the events for subscribers.
+    if(table->subscription_count > 0) {
+        for(i=0; i<event_count; i++) {
+            rc = sky_table_publish_event(table, events[i]);
+            check(rc == 0, "Unable to publish event #%d", i);
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Removes every event of an object from the table. Buffered events are
+// merged first so they are removed too. The object is removed from every
+// partition of a partitioned table.
+//
+// table     - The table.
+// object_id - The object id.
+// removed   - A pointer to where a flag is returned stating if the object had
+//             any events. This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_remove_object(sky_table *table, sky_object_id_t object_id,
+                            bool *removed)
+{
+    int rc;
+    uint32_t i;
+    check(table != NULL, "Table required");
+    check(table->opened, "Table must be open to remove an object");
+
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge memtable");
+
+    if(table->continuous_query_count > 0) {
+        rc = sky_table_update_continuous_queries(table, object_id, -1);
+        check(rc == 0, "Unable to subtract path from continuous queries");
+    }
+
+    if(table->partition_set != NULL) {
+        if(removed != NULL) *removed = false;
+        for(i=0; i<table->partition_set->partition_count; i++) {
+            bool partition_removed = false;
+            rc = sky_data_file_remove_object(table->partition_set->partitions[i].data_file, object_id, &partition_removed);
+            check(rc == 0, "Unable to remove object from partition");
+            if(removed != NULL) *removed = *removed || partition_removed;
+        }
+    }
+    else {
+        rc = sky_data_file_remove_object(sky_table_get_object_data_file(table, object_id), object_id, removed);
+        check(rc == 0, "Unable to remove object from data file");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Removes the events of an object at a given timestamp from the table.
+// Buffered events are merged first so they are removed too.
+//
+// table     - The table.
+// object_id - The object id.
+// timestamp - The timestamp of the events to remove.
+// count     - A pointer to where the number of removed events is returned.
+//             This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_remove_events(sky_table *table, sky_object_id_t object_id,
+                            sky_timestamp_t timestamp, uint32_t *count)
+{
+    int rc;
+    check(table != NULL, "Table required");
+    check(table->opened, "Table must be open to remove events");
+
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge memtable");
+
+    // Continuous queries recount the path of the object around the removal.
+    if(table->continuous_query_count > 0) {
+        rc = sky_table_update_continuous_queries(table, object_id, -1);
+        check(rc == 0, "Unable to subtract path from continuous queries");
+    }
+
+    if(table->partition_set != NULL) {
+        sky_partition *partition = NULL;
+        rc = sky_partition_set_get_partition(table->partition_set, timestamp, false, &partition);
+        check(rc == 0, "Unable to retrieve partition");
+        if(partition != NULL) {
+            rc = sky_data_file_remove_events(partition->data_file, object_id, timestamp, count);
+            check(rc == 0, "Unable to remove events from partition");
+        }
+        else if(count != NULL) {
+            *count = 0;
+        }
+    }
+    else {
+        rc = sky_data_file_remove_events(sky_table_get_object_data_file(table, object_id), object_id, timestamp, count);
+        check(rc == 0, "Unable to remove events from data file");
+    }
+
+    if(table->continuous_query_count > 0) {
+        rc = sky_table_update_continuous_queries(table, object_id, 1);
+        check(rc == 0, "Unable to add path to continuous queries");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Sorts a list of events by object id and then by timestamp. Sorting does
+// not touch the table so it can run on any thread.
+//
+// events      - The events to sort.
+// event_count - The number of events.
+//
+// Returns nothing.
+void sky_table_sort_events(sky_event **events, uint32_t event_count)
+{
+    if(event_count > 1) {
+        qsort(events, event_count, sizeof(*events), sky_table_compare_events);
+    }
+}
+
+// Compares two events by object id and then by timestamp.
+int sky_table_compare_events(const void *_a, const void *_b)
+{
+    sky_event *a = *((sky_event **)_a);
+    sky_event *b = *((sky_event **)_b);
+
+    if(a->object_id > b->object_id) {
+        return 1;
+    }
+    else if(a->object_id < b->object_id) {
+        return -1;
+    }
+    else if(a->timestamp > b->timestamp) {
+        return 1;
+    }
+    else if(a->timestamp < b->timestamp) {
+        return -1;
+    }
+    else {
+        return 0;
+    }
+}
+
+// Replaces the string values of an event with their dictionary codes. Only
+// values of properties with a String data type are encoded so that the
+// codes can be told apart from integer values when they are read.
+//
+// Values of fixed properties are marked so that they are stored in the fixed
+// section of the event.
+//
+// table - The table.
+// event - The event to encode.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_encode_event(sky_table *table, sky_event *event)
+{
+    int rc;
+    uint32_t i;
+    int64_t code;
+
+    if(event->data_count > 0) {
+        rc = sky_property_file_ensure_loaded(table->property_file);
+        check(rc == 0, "Unable to load property file");
+    }
+
+    for(i=0; i<event->data_count; i++) {
+        sky_event_data *data = event->data[i];
+        bool is_string = (data->data_type == &SKY_DATA_TYPE_STRING && data->string_value != NULL);
+        if(!is_string && table->property_file->fixed_count == 0) {
+            continue;
+        }
+
+        sky_property *property = NULL;
+        rc = sky_property_file_find_by_id(table->property_file, data->key, &property);
+        check(rc == 0, "Unable to find property: %d", data->key);
+        if(property != NULL && property->fixed) {
+            data->fixed = true;
+        }
+        if(!is_string || property == NULL || biseq(property->data_type, &SKY_DATA_TYPE_STRING) != 1) {
+            continue;
+        }
+
+        rc = sky_dictionary_file_encode(table->dictionary_file, data->key, data->string_value, &code);
+        check(rc == 0, "Unable to encode value for property: %d", data->key);
+        bdestroy(data->string_value);
+        data->string_value = NULL;
+        data->data_type = &SKY_DATA_TYPE_INT;
+        data->int_value = code;
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Merges the events buffered in the memtable into the data file. This is
+// called before the data file is read so that readers see every event that
+// has been added to the table.
+//
+// table - The table.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_merge(sky_table *table)
+{
+    return sky_table_merge_before(table, INT64_MAX);
+}
+
+// Merges the events buffered in the memtable at or before a cutoff
+// timestamp into the data file. Later events stay in the memtable.
+//
+// table  - The table.
+// cutoff - The timestamp of the latest event to merge.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_merge_before(sky_table *table, sky_timestamp_t cutoff)
+{
+    int rc;
+    uint32_t i;
+    sky_object_id_t *object_ids = NULL;
+    uint32_t object_id_count = 0;
+    check(table != NULL, "Table required");
+
+    if(table->memtable != NULL && table->data_file != NULL) {
+        // Continuous queries recount the paths of the buffered objects
+        // around the merge.
+        if(table->continuous_query_count > 0) {
+            rc = sky_memtable_get_object_ids(table->memtable, &object_ids, &object_id_count);
+            check(rc == 0, "Unable to retrieve memtable object ids");
+            for(i=0; i<object_id_count; i++) {
+                rc = sky_table_update_continuous_queries(table, object_ids[i], -1);
+                check(rc == 0, "Unable to subtract path from continuous queries");
+            }
+        }
+
+        rc = sky_memtable_merge_before(table->memtable, table->data_file, cutoff);
+        check(rc == 0, "Unable to merge memtable into data file");
+
+        for(i=0; i<object_id_count; i++) {
+            rc = sky_table_update_continuous_queries(table, object_ids[i], 1);
+            check(rc == 0, "Unable to add path to continuous queries");
+        }
+    }
+
+    free(object_ids);
+    return 0;
+
+error:
+    free(object_ids);
+    return -1;
+}
+
+// Calculates the timestamp of the latest buffered event that is outside of
+// the table's reorder window. Events after it may still have late events
+// arriving before them.
+//
+// table - The table.
+//
+// Returns the cutoff timestamp.
+sky_timestamp_t sky_table_get_reorder_cutoff(sky_table *table)
+{
+    if(table->reorder_window == 0 || table->memtable == NULL) {
+        return INT64_MAX;
+    }
+    return table->memtable->max_timestamp - ((sky_timestamp_t)table->reorder_window * 1000000);
+}
+
+// Rewrites the table's data files with their paths packed densely in object
+// id order. Buffered events are merged first so they are compacted too.
+// Events that are past the table's retention are left out.
+//
+// table       - The table.
+// fill_factor - The percentage of each block to fill, from 1 to 100.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_compact(sky_table *table, uint32_t fill_factor)
+{
+    int rc;
+    uint32_t i;
+    check(table != NULL, "Table required");
+    check(table->opened, "Table must be open to compact");
+
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge memtable");
+
+    sky_timestamp_t cutoff = sky_table_get_expiry_cutoff(table);
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        rc = sky_data_file_compact(sky_table_get_data_file(table, i), fill_factor, cutoff);
+        check(rc == 0, "Unable to compact data file");
+    }
+
+    // Expired events may have been trimmed from the paths.
+    if(table->retention > 0) {
+        rc = sky_table_execute_continuous_queries(table);
+        check(rc == 0, "Unable to execute continuous queries");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Drops the blocks of the table whose events are all past the table's
+// retention. Nothing is dropped if the table keeps events forever. The
+// partitions of a partitioned table that are past the retention are
+// removed as a whole and their blocks are counted as dropped.
+//
+// table - The table.
+// count - A pointer to where the number of dropped blocks is returned. This
+//         can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_expire(sky_table *table, uint32_t *count)
+{
+    int rc;
+    uint32_t i;
+    uint32_t block_count = 0;
+    check(table != NULL, "Table required");
+    check(table->opened, "Table must be open to expire events");
+
+    if(table->retention > 0) {
+        rc = sky_table_merge(table);
+        check(rc == 0, "Unable to merge memtable");
+
+        sky_timestamp_t cutoff = sky_table_get_expiry_cutoff(table);
+        if(table->partition_set != NULL) {
+            uint32_t total_block_count = sky_table_get_block_count(table);
+            uint32_t partition_count = 0;
+            rc = sky_partition_set_expire(table->partition_set, cutoff, &partition_count);
+            check(rc == 0, "Unable to expire partitions");
+            block_count = total_block_count - sky_table_get_block_count(table);
+
+            // The remaining partitions keep their write versions so cached
+            // results are invalidated explicitly.
+            if(partition_count > 0) {
+                sky_table_invalidate(table);
+            }
+        }
+        for(i=0; i<sky_table_get_data_file_count(table); i++) {
+            uint32_t data_file_block_count = 0;
+            rc = sky_data_file_expire(sky_table_get_data_file(table, i), cutoff, &data_file_block_count);
+            check(rc == 0, "Unable to expire data file");
+            block_count += data_file_block_count;
+        }
+
+        if(block_count > 0) {
+            rc = sky_table_execute_continuous_queries(table);
+            check(rc == 0, "Unable to execute continuous queries");
+        }
+    }
+
+    if(count != NULL) *count = block_count;
+    return 0;
+
+error:
+    if(count != NULL) *count = 0;
+    return -1;
+}
+
+// Calculates the timestamp before which the events of the table have
+// expired.
+//
+// table - The table.
+//
+// Returns the cutoff timestamp or zero if the table keeps events forever.
+sky_timestamp_t sky_table_get_expiry_cutoff(sky_table *table)
+{
+    if(table->retention == 0) {
+        return 0;
+    }
+
+    sky_timestamp_t now = 0;
+    sky_timestamp_now(&now);
+    return now - ((sky_timestamp_t)table->retention * 1000000);
+}
+
+// Compresses the blocks of the table that have not been written to for a
+// number of seconds.
+//
+// table        - The table.
+// idle_seconds - The number of seconds since a block's last write before it
+//                is compressed.
+// limit        - The number of blocks to check in each data file or zero to
+//                check every block.
+// count        - A pointer to where the number of compressed blocks is
+//                returned. This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_compress(sky_table *table, uint32_t idle_seconds,
+                       uint32_t limit, uint32_t *count)
+{
+    int rc;
+    uint32_t i;
+    uint32_t compressed_count = 0;
+    check(table != NULL, "Table required");
+    check(table->opened, "Table must be open to compress");
+
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        uint32_t data_file_count = 0;
+        rc = sky_data_file_compress(sky_table_get_data_file(table, i), idle_seconds, limit, &data_file_count);
+        check(rc == 0, "Unable to compress data file");
+        compressed_count += data_file_count;
+    }
+
+    if(count != NULL) *count = compressed_count;
+    return 0;
+
+error:
+    if(count != NULL) *count = compressed_count;
+    return -1;
+}
+
+// Releases the decompressed blocks that were read while processing a
+// message. This must be called between messages.
+//
+// table - The table.
+void sky_table_release_cache(sky_table *table)
+{
+    uint32_t i;
+    if(table != NULL) {
+        for(i=0; i<sky_table_get_data_file_count(table); i++) {
+            sky_data_file_release_cache(sky_table_get_data_file(table, i));
+        }
+    }
+}
+
+
+//--------------------------------------
+// Querying
+//--------------------------------------
+
+// Finds the path of an object in the data file that holds it. The path of
+// an object in a partitioned table is returned as one part per partition
+// in time order.
+//
+// table      - The table.
+// object_id  - The object id.
+// paths      - A pointer to where an array of raw path pointers should be
+//              returned. The caller owns the array. This is NULL if the
+//              object has no path.
+// path_count - A pointer to where the number of paths should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_find_path(sky_table *table, sky_object_id_t object_id,
+                        void ***paths, uint32_t *path_count)
+{
+    int rc;
+    check(table != NULL, "Table required");
+    check(sky_table_has_data_files(table), "Table must be open to find a path");
+
+    if(table->shard_set != NULL) {
+        rc = sky_shard_set_find_path(table->shard_set, object_id, paths, path_count);
+        check(rc == 0, "Unable to find path in shard set");
+    }
+    else if(table->partition_set != NULL) {
+        rc = sky_partition_set_find_path(table->partition_set, object_id, INT64_MIN, INT64_MAX, paths, path_count);
+        check(rc == 0, "Unable to find path in partition set");
+    }
+    else {
+        rc = sky_data_file_find_path(table->data_file, object_id, paths, path_count);
+        check(rc == 0, "Unable to find path in data file");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Executes a query over every data file of the table and aggregates into
+// a single result. Buffered events must be merged first.
+//
+// table  - The table.
+// query  - The query to execute.
+// result - The result to aggregate into.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_execute_query(sky_table *table, sky_query *query,
+                            sky_query_result *result)
+{
+    int rc;
+    check(table != NULL, "Table required");
+    check(sky_table_has_data_files(table), "Table must be open to query");
+
+    if(table->shard_set != NULL) {
+        rc = sky_shard_set_execute_query(table->shard_set, query, result);
+        check(rc == 0, "Unable to query shard set");
+    }
+    else if(table->partition_set != NULL) {
+        rc = sky_query_execute_partition_set(query, table->partition_set, result);
+        check(rc == 0, "Unable to query partition set");
+    }
+    else {
+        rc = sky_query_execute(query, table->data_file, result);
+        check(rc == 0, "Unable to query data file");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Snapshots
+//--------------------------------------
+
+// Copies the table's directory to a new directory as it is at this moment.
+// Buffered events are merged and the data file is flushed first so the
+// copy can be opened as a table of its own. Files are reflinked when the
+// file system supports it so the copy is almost instant and shares its disk
+// space with the table until either one changes. The table must not be
+// written to while it is copied, which holds for the worker that owns it.
+//
+// table  - The table.
+// path   - The path of the directory to create. It must not already exist
+//          and cannot be inside the table's directory.
+// cloned - A pointer to where a flag is returned that is set if every file
+//          was reflinked. This can be null.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_snapshot(sky_table *table, bstring path, bool *cloned)
+{
+    int rc;
+    bool created = false;
+    bstring lock_path = NULL;
+    check(table != NULL, "Table required");
+    check(table->opened, "Table must be open to snapshot");
+    check(path != NULL && blength(path) > 0, "Snapshot path required");
+    check(!sky_file_exists(path), "Snapshot path already exists: %s", bdata(path));
+    check(bstrncmp(path, table->path, blength(table->path)) != 0 || bchar(path, blength(table->path)) != '/', "Snapshot cannot be inside the table: %s", bdata(path));
+
+    rc = sky_table_flush(table);
+    check(rc == 0, "Unable to flush table");
+
+    created = true;
+    rc = sky_file_clone_r(table->path, path, cloned);
+    check(rc == 0, "Unable to copy table to snapshot: %s", bdata(path));
+
+    // The lock belongs to the running table, not the copy.
+    lock_path = bformat("%s/%s", bdata(path), SKY_LOCK_NAME); check_mem(lock_path);
+    rc = sky_file_rm(lock_path);
+    check(rc == 0, "Unable to remove snapshot lock: %s", bdata(lock_path));
+
+    bdestroy(lock_path);
+    return 0;
+
+error:
+    if(created) sky_file_rm_r(path);
+    bdestroy(lock_path);
+    return -1;
+}
+
+
+//--------------------------------------
+// Continuous Queries
+//--------------------------------------
+
+// Registers a continuous 'Next Action' query on the table. The result is
+// calculated with a full scan when the query is registered and is then kept
+// up to date as events are added. An existing query for the same prior
+// actions is returned instead of registering a new one.
+//
+// table                 - The table.
+// prior_action_ids      - The actions that precede the counted action.
+// prior_action_id_count - The number of prior actions.
+// ret                   - A pointer to where the query should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_add_continuous_query(sky_table *table,
+                                   sky_action_id_t *prior_action_ids,
+                                   uint32_t prior_action_id_count,
+                                   sky_continuous_query **ret)
+{
+    int rc;
+    sky_continuous_query *continuous_query = NULL;
+    check(table != NULL, "Table required");
+    check(table->opened, "Table must be open to add a continuous query");
+    check(ret != NULL, "Return pointer required");
+
+    *ret = sky_table_find_continuous_query(table, prior_action_ids, prior_action_id_count);
+    if(*ret != NULL) {
+        return 0;
+    }
+
+    // Merge buffered events before the query is seeded so that they are not
+    // counted twice.
+    rc = sky_table_merge(table);
+    check(rc == 0, "Unable to merge table memtable");
+
+    continuous_query = sky_continuous_query_create(prior_action_ids, prior_action_id_count);
+    check_mem(continuous_query);
+    rc = sky_table_execute_continuous_query(table, continuous_query);
+    check(rc == 0, "Unable to execute continuous query");
+
+    table->continuous_queries = realloc(table->continuous_queries, sizeof(*table->continuous_queries) * (table->continuous_query_count+1));
+    check_mem(table->continuous_queries);
+    table->continuous_queries[table->continuous_query_count++] = continuous_query;
+
+    *ret = continuous_query;
+    return 0;
+
+error:
+    sky_continuous_query_free(continuous_query);
+    if(ret) *ret = NULL;
+    return -1;
+}
+
+// Unregisters a continuous query from the table. Nothing is done if no query
+// is registered for the prior actions.
+//
+// table                 - The table.
+// prior_action_ids      - The prior actions of the query.
+// prior_action_id_count - The number of prior actions.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_remove_continuous_query(sky_table *table,
+                                      sky_action_id_t *prior_action_ids,
+                                      uint32_t prior_action_id_count)
+{
+    uint32_t i;
+    check(table != NULL, "Table required");
+
+    for(i=0; i<table->continuous_query_count; i++) {
+        if(sky_continuous_query_matches(table->continuous_queries[i], prior_action_ids, prior_action_id_count)) {
+            sky_continuous_query_free(table->continuous_queries[i]);
+            memmove(&table->continuous_queries[i], &table->continuous_queries[i+1], sizeof(*table->continuous_queries) * (table->continuous_query_count-i-1));
+            table->continuous_query_count--;
+            break;
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Finds the continuous query registered for a list of prior actions.
+//
+// table                 - The table.
+// prior_action_ids      - The prior actions of the query.
+// prior_action_id_count - The number of prior actions.
+//
+// Returns the continuous query or null if none is registered.
+sky_continuous_query *sky_table_find_continuous_query(sky_table *table,
+                                                      sky_action_id_t *prior_action_ids,
+                                                      uint32_t prior_action_id_count)
+{
+    uint32_t i;
+    for(i=0; i<table->continuous_query_count; i++) {
+        if(sky_continuous_query_matches(table->continuous_queries[i], prior_action_ids, prior_action_id_count)) {
+            return table->continuous_queries[i];
+        }
+    }
+    return NULL;
+}
+
+// Adds the counts of an object's path in the data file to every continuous
+// query or subtracts them.
+//
+// table     - The table.
+// object_id - The object whose path changed.
+// sign      - 1 to add the counts or -1 to subtract them.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_update_continuous_queries(sky_table *table,
+                                        sky_object_id_t object_id,
+                                        int64_t sign)
+{
+    int rc;
+    uint32_t i;
+    void **paths = NULL;
+    uint32_t path_count = 0;
+
+    rc = sky_table_find_path(table, object_id, &paths, &path_count);
+    check(rc == 0, "Unable to find path for object: %llu", (unsigned long long)object_id);
+
+    for(i=0; i<table->continuous_query_count; i++) {
+        rc = sky_continuous_query_update(table->continuous_queries[i], paths, path_count, sign);
+        check(rc == 0, "Unable to update continuous query");
+    }
+
+    free(paths);
+    return 0;
+
+error:
+    free(paths);
+    return -1;
+}
+
+// Recalculates every continuous query with a full scan. This is used after
+// changes that cannot be tracked per object, such as dropping whole blocks.
+//
+// table - The table.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_execute_continuous_queries(sky_table *table)
+{
+    int rc;
+    uint32_t i;
+
+    for(i=0; i<table->continuous_query_count; i++) {
+        rc = sky_table_execute_continuous_query(table, table->continuous_queries[i]);
+        check(rc == 0, "Unable to execute continuous query");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Recalculates a continuous query with a full scan of the table's data
+// files.
+//
+// table            - The table.
+// continuous_query - The continuous query.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_execute_continuous_query(sky_table *table,
+                                       sky_continuous_query *continuous_query)
+{
+    if(table->shard_set != NULL) {
+        return sky_continuous_query_execute_shard_set(continuous_query, table->shard_set);
+    }
+    if(table->partition_set != NULL) {
+        return sky_continuous_query_execute_partition_set(continuous_query, table->partition_set);
+    }
+    return sky_continuous_query_execute(continuous_query, table->data_file);
+}
+
+
+//--------------------------------------
+// Subscriptions
+//--------------------------------------
+
+// Registers a subscription on the table. The subscription only buffers the
+// events that are added after it is registered.
+//
+// table           - The table.
+// capacity        - The number of events the subscription can buffer or
+//                   zero for the default capacity.
+// action_ids      - The actions whose events are buffered.
+// action_id_count - The number of actions. Every event is buffered if zero.
+// ret             - A pointer to where the subscription should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_add_subscription(sky_table *table, uint32_t capacity,
+                               sky_action_id_t *action_ids,
+                               uint32_t action_id_count,
+                               sky_subscription **ret)
+{
+    sky_subscription *subscription = NULL;
+    check(table != NULL, "Table required");
+    check(table->opened, "Table must be open to add a subscription");
+    check(ret != NULL, "Return pointer required");
+
+    subscription = sky_subscription_create(capacity, action_ids, action_id_count);
+    check_mem(subscription);
+    subscription->id = ++table->last_subscription_id;
+
+    sky_subscription **subscriptions = realloc(table->subscriptions, sizeof(*table->subscriptions) * (table->subscription_count+1));
+    check_mem(subscriptions);
+    table->subscriptions = subscriptions;
+    table->subscriptions[table->subscription_count++] = subscription;
+
+    *ret = subscription;
+    return 0;
+
+error:
+    sky_subscription_free(subscription);
+    if(ret) *ret = NULL;
+    return -1;
+}
+
+// Unregisters a subscription from the table and frees its buffered events.
+// Nothing is done if no subscription has the id.
+//
+// table - The table.
+// id    - The id of the subscription.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_remove_subscription(sky_table *table, uint64_t id)
+{
+    uint32_t i;
+    check(table != NULL, "Table required");
+
+    for(i=0; i<table->subscription_count; i++) {
+        if(table->subscriptions[i]->id == id) {
+            sky_subscription_free(table->subscriptions[i]);
+            memmove(&table->subscriptions[i], &table->subscriptions[i+1], sizeof(*table->subscriptions) * (table->subscription_count-i-1));
+            table->subscription_count--;
+            break;
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Finds a subscription of the table by id.
+//
+// table - The table.
+// id    - The id of the subscription.
+//
+// Returns the subscription or null if none has the id.
+sky_subscription *sky_table_find_subscription(sky_table *table, uint64_t id)
+{
+    uint32_t i;
+    for(i=0; i<table->subscription_count; i++) {
+        if(table->subscriptions[i]->id == id) {
+            return table->subscriptions[i];
+        }
+    }
+    return NULL;
+}
+
+// Pushes an event that was added to the table onto every subscription.
+//
+// table - The table.
+// event - The event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_publish_event(sky_table *table, sky_event *event)
+{
+    int rc;
+    uint32_t i;
+    for(i=0; i<table->subscription_count; i++) {
+        rc = sky_subscription_push(table->subscriptions[i], event);
+        check(rc == 0, "Unable to push event to subscription: %llu", (unsigned long long)table->subscriptions[i]->id);
+    }
+    return 0;
+
+error:
+    return -1;
+}
+
+//--------------------------------------
+// Indexes
+//--------------------------------------
+
+// Retrieves the action index of the table. The index is built from the data
+// file the first time it is requested. Buffered events are merged first so
+// that they are indexed too.
+//
+// table - The table.
+// ret   - A pointer to where the index should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_get_action_index(sky_table *table, sky_action_index **ret)
+{
+    int rc;
+    uint32_t i;
+    check(table != NULL, "Table required");
+    check(sky_table_has_data_files(table), "Table must be open to index actions");
+    check(ret != NULL, "Return pointer required");
+    *ret = NULL;
+
+    if(table->action_index == NULL) {
+        table->action_index = sky_action_index_create();
+        check_mem(table->action_index);
+    }
+    if(!table->action_index->built) {
+        rc = sky_table_merge(table);
+        check(rc == 0, "Unable to merge table memtable");
+        if(table->data_file == NULL) {
+            sky_action_index_clear(table->action_index);
+            for(i=0; i<sky_table_get_data_file_count(table); i++) {
+                rc = sky_action_index_add_data_file(table->action_index, sky_table_get_data_file(table, i));
+                check(rc == 0, "Unable to index data file %d", i);
+            }
+            table->action_index->built = true;
+        }
+        else {
+            rc = sky_action_index_build(table->action_index, table->data_file);
+            check(rc == 0, "Unable to build action index");
+        }
+    }
+
+    *ret = table->action_index;
+    return 0;
+
+error:
+    if(ret) *ret = NULL;
+    return -1;
+}
+
+// Retrieves the index of a property of the table. The index is created and
+// built from the data file the first time it is requested. Buffered events
+// are merged first so that they are indexed too.
+//
+// table       - The table.
+// property_id - The property.
+// ret         - A pointer to where the index should be returned.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_get_property_index(sky_table *table,
+                                 sky_property_id_t property_id,
+                                 sky_property_index **ret)
+{
+    int rc;
+    uint32_t i;
+    sky_property_index *index = NULL;
+    check(table != NULL, "Table required");
+    check(sky_table_has_data_files(table), "Table must be open to index properties");
+    check(ret != NULL, "Return pointer required");
+    *ret = NULL;
+
+    for(i=0; i<table->property_index_count; i++) {
+        if(table->property_indexes[i]->property_id == property_id) {
+            index = table->property_indexes[i];
+            break;
+        }
+    }
+    if(index == NULL) {
+        sky_property_index **property_indexes = realloc(table->property_indexes, sizeof(*property_indexes) * (table->property_index_count+1));
+        check_mem(property_indexes);
+        table->property_indexes = property_indexes;
+        index = sky_property_index_create(property_id);
+        check_mem(index);
+        table->property_indexes[table->property_index_count++] = index;
+    }
+
+    if(!index->built) {
+        rc = sky_table_merge(table);
+        check(rc == 0, "Unable to merge table memtable");
+        if(table->data_file == NULL) {
+            sky_property_index_clear(index);
+            for(i=0; i<sky_table_get_data_file_count(table); i++) {
+                rc = sky_property_index_add_data_file(index, sky_table_get_data_file(table, i));
+                check(rc == 0, "Unable to index data file %d", i);
+            }
+            index->built = true;
+        }
+        else {
+            rc = sky_property_index_build(index, table->data_file);
+            check(rc == 0, "Unable to build property index");
+        }
+    }
+
+    *ret = index;
+    return 0;
+
+error:
+    if(ret) *ret = NULL;
+    return -1;
+}
+
+// Adds an event to every index of the table that has been built. String
+// values must already be encoded.
+//
+// table - The table.
+// event - The event.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_add_event_to_indexes(sky_table *table, sky_event *event)
+{
+    int rc;
+    uint32_t i;
+
+    if(table->action_index != NULL && table->action_index->built) {
+        rc = sky_action_index_add(table->action_index, event->action_id, event->object_id);
+        check(rc == 0, "Unable to add event to action index");
+    }
+
+    for(i=0; i<table->property_index_count; i++) {
+        if(table->property_indexes[i]->built) {
+            rc = sky_property_index_add_event(table->property_indexes[i], event);
+            check(rc == 0, "Unable to add event to property index");
+        }
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Drops the contents of every index of the table so that they are rebuilt
+// when next requested.
+//
+// table - The table.
+void sky_table_clear_indexes(sky_table *table)
+{
+    uint32_t i;
+    sky_action_index_clear(table->action_index);
+    for(i=0; i<table->property_index_count; i++) {
+        sky_property_index_clear(table->property_indexes[i]);
+    }
+}
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+// Measures the memory used by an open table. The name of the measurement is
+// left unchanged.
+//
+// table  - The table.
+// memory - The measurement to fill in.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_get_memory(sky_table *table, sky_table_memory *memory)
+{
+    int rc;
+    uint32_t i;
+    check(table != NULL, "Table required");
+    check(memory != NULL, "Memory required");
+    check(table->opened, "Table must be open");
+
+    memory->mapped_bytes = 0;
+    memory->data_bytes = 0;
+    memory->block_bytes = 0;
+    memory->resident_bytes = 0;
+    memory->block_cache_bytes = 0;
+    for(i=0; i<sky_table_get_data_file_count(table); i++) {
+        sky_data_file *data_file = sky_table_get_data_file(table, i);
+        size_t block_bytes = 0, resident_bytes = 0;
+        memory->mapped_bytes += data_file->mapped_length;
+        memory->data_bytes += data_file->data_length;
+        rc = sky_data_file_get_memory(data_file, &block_bytes, &resident_bytes);
+        check(rc == 0, "Unable to measure data file memory");
+        memory->block_bytes += block_bytes;
+        memory->resident_bytes += resident_bytes;
+
+        // The block cache is shared with readers on other threads.
+        if(data_file->block_cache != NULL) {
+            pthread_mutex_lock(&data_file->block_cache->mutex);
+            memory->block_cache_bytes += data_file->block_cache->size;
+            pthread_mutex_unlock(&data_file->block_cache->mutex);
+        }
+    }
+
+    memory->schema_bytes = sky_action_file_get_memory_usage(table->action_file)
+        + sky_property_file_get_memory_usage(table->property_file);
+    memory->dictionary_bytes = sky_dictionary_file_get_memory_usage(table->dictionary_file);
+
+    memory->index_bytes = sky_action_index_get_memory_usage(table->action_index)
+        + (sizeof(*table->property_indexes) * table->property_index_count);
+    for(i=0; i<table->property_index_count; i++) {
+        memory->index_bytes += sky_property_index_get_memory_usage(table->property_indexes[i]);
+    }
+
+    memory->memtable_bytes = sky_memtable_get_memory_usage(table->memtable);
+    memory->result_cache_bytes = (table->result_cache != NULL ? table->result_cache->size : 0);
+
+    memory->subscription_bytes = sizeof(*table->subscriptions) * table->subscription_count;
+    for(i=0; i<table->subscription_count; i++) {
+        memory->subscription_bytes += sky_subscription_get_memory_usage(table->subscriptions[i]);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Frees the name of a memory measurement and clears its counts.
+//
+// memory - The measurement.
+void sky_table_memory_free(sky_table_memory *memory)
+{
+    if(memory) {
+        bdestroy(memory->name);
+        memset(memory, 0, sizeof(*memory));
+    }
+}
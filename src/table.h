@@ -17,6 +17,15 @@ typedef struct sky_table sky_table;
 #include "data_file.h"
 #include "action_file.h"
 #include "property_file.h"
+#include "dictionary_file.h"
+#include "memtable.h"
+#include "continuous_query.h"
+#include "subscription.h"
+#include "result_cache.h"
+#include "action_index.h"
+#include "property_index.h"
+#include "shard_set.h"
+#include "partition_set.h"
 
 //==============================================================================
 //
@@ -27,9 +36,11 @@ typedef struct sky_table sky_table;
 // The table represents the storage for a type of object. The table
 // is analogous to a table in a relational database. The table is
 // represented on the file system as a directory that contains a header file
-// and multiple data extent files numbered sequentially (1, 2, 3, etc).
+// and multiple data extent files numbered sequentially (data, data.1, data.2,
+// etc).
 //
-// Extents are a collection of 64k blocks. Each block can store any number of
+// Extents are a fixed-size collection of 64k blocks that are each mapped
+// separately. Each block can store any number of
 // paths that can fit into it. If the size of the paths is larger than the block
 // can handle then the block is split into multiple blocks.
 //
@@ -42,6 +53,91 @@ typedef struct sky_table sky_table;
 // Because of the redundancy of action names and data keys, those strings are
 // cached and converted into integer identifiers. The action cache is located
 // in the 'actions' file and the data keys cache is located in the 'keys' file.
+//
+// String property values are stored as integer codes too. The values of each
+// string property are kept in the 'dictionary' file and are encoded when an
+// event is added to the table. Readers decode the codes of properties with a
+// String data type back into their values.
+//
+// A table can buffer its writes in a memtable by setting a memtable size.
+// Added events are then appended to the table's write-ahead log ('wal') and
+// are merged into the data file in sorted batches once the memtable is full,
+// when the table is flushed or before the table is read. A log that is left
+// behind by a table that was not closed is merged when the table is opened.
+//
+// A memtable can also hold back its most recent events with a reorder
+// window. When the memtable fills up or the table is flushed, only events
+// older than the latest buffered timestamp less the window are merged, so
+// events that arrive late by less than the window are sorted in with the
+// rest and are appended to their paths instead of being inserted into the
+// middle. Everything is still merged before the table is read or when the
+// memtable stays full.
+//
+// Continuous queries can be registered on a table to keep the results of
+// 'Next Action' queries up to date as events are inserted. See
+// continuous_query.h for how they are maintained.
+//
+// Consumers that want new events as they arrive can subscribe to a table
+// instead of scanning it repeatedly. Each event that is added is pushed onto
+// the bounded ring buffer of every subscription whose action filter it
+// passes. See subscription.h.
+//
+// A table can also keep the responses of recent queries by setting a result
+// cache size. A repeated query is then answered from the cache as long as no
+// event has been added to the data file since. See result_cache.h.
+//
+// A table keeps an action index of the objects that have performed each
+// action. It is built from the data file the first time it is requested and
+// then maintained as events are added. See action_index.h. Property indexes
+// are kept the same way for each property that queries filter on by value.
+// See property_index.h.
+//
+// A table can bound its size with a retention period. Blocks whose events
+// have all passed the retention are cleared in place when the table is
+// expired and compaction trims the expired events from the rest.
+//
+// A table on a replica server is a copy of the same table on its primary.
+// The table remembers the primary's epoch and the write version it was last
+// synced to so that the next sync only copies what changed. See replica.h.
+//
+// A table can be copied while it is open with a snapshot. The snapshot is a
+// directory that holds a consistent copy of the table's files and can be
+// opened as a table of its own. Files are reflinked where the file system
+// supports it so a snapshot takes about as long whatever the table's size.
+//
+// A table can be created with a shard count to split its objects across
+// several data files. The data file of each shard lives in a directory
+// named after its index, so the first shard is where an unsharded table
+// keeps its data file. Events are routed to the shard of their object, a
+// batch is written by one thread per shard, and paths are looked up in the
+// owning shard. Queries and maintenance such as flushes, compaction and
+// expiry run over every shard. Like the format, the shard count is fixed
+// when the table is created. Sharded tables cannot buffer writes in a
+// memtable or be replicated. See shard_set.h.
+//
+// A table can instead be created with a partition period to split its
+// events across one data file per period, such as a day or a month. The
+// partitions live under a 'partitions' directory in the table directory.
+// Events are routed to the partition of their timestamp and the path of an
+// object is looked up as one part per partition, in time order, which a
+// cursor reads as a single path. Queries only read the partitions that
+// overlap their timestamp filters and expiry removes the partitions that
+// are past the retention as a whole. Like the shard count, the period is
+// fixed when the table is created and a partitioned table cannot buffer
+// writes in a memtable or be replicated. See partition_set.h.
+//
+// A table can be created as action-only for objects that never store
+// properties. Events with data are refused by an action-only table so its
+// data file can be walked with the action-only iteration macros. The format
+// is chosen when the table is created and is kept by an 'action_only' file
+// in the table directory. Requesting it for a table that already exists
+// leaves the table's format unchanged.
+//
+// The memory used by an open table can be measured by category. The mapped
+// bytes are the size of the data file's mappings and the resident bytes are
+// the part of the data that is in the page cache. The rest is heap memory
+// held by the block list, the schema files, the dictionaries, the indexes,
+// the memtable, the caches and the subscriptions.
 
 
 //==============================================================================
@@ -52,21 +148,72 @@ typedef struct sky_table sky_table;
 
 #define SKY_LOCK_NAME ".skylock"
 
+// The name of the file that marks a table as action-only.
+#define SKY_TABLE_ACTION_ONLY_NAME "action_only"
+
+// The name of the directory that holds the partitions of a table.
+#define SKY_TABLE_PARTITIONS_NAME "partitions"
+
 // The table is a reference to the disk location where data is stored. The
 // table also maintains a cache of block info and predefined actions and
 // properties.
 struct sky_table {
     sky_database *database;
     sky_data_file *data_file;
+    sky_shard_set *shard_set;
+    uint32_t shard_count;
+    sky_partition_set *partition_set;
+    uint32_t partition_period;
     sky_action_file *action_file;
     sky_property_file *property_file;
+    sky_dictionary_file *dictionary_file;
     bstring name;
     bstring path;
     bool opened;
     uint32_t default_block_size;
+    sky_durability_e durability;
+    uint32_t memtable_size;
+    sky_memtable *memtable;
+    uint32_t reorder_window;
+    bool preload;
+    bool huge_pages;
+    size_t block_cache_size;
+    sky_prefetcher *prefetcher;
     FILE *lock_file;
+    sky_continuous_query **continuous_queries;
+    uint32_t continuous_query_count;
+    sky_subscription **subscriptions;
+    uint32_t subscription_count;
+    uint64_t last_subscription_id;
+    size_t result_cache_size;
+    sky_result_cache *result_cache;
+    sky_action_index *action_index;
+    sky_property_index **property_indexes;
+    uint32_t property_index_count;
+    uint32_t retention;
+    bool action_only;
+    uint64_t replica_epoch;
+    uint64_t replica_version;
+    int64_t replicated_at;
 };
 
+// The memory used by a table in bytes. The name identifies the table to
+// whoever took the measurement and is not set by the table.
+typedef struct sky_table_memory {
+    bstring name;
+    size_t mapped_bytes;
+    size_t data_bytes;
+    size_t resident_bytes;
+    size_t block_bytes;
+    size_t schema_bytes;
+    size_t dictionary_bytes;
+    size_t index_bytes;
+    size_t memtable_bytes;
+    size_t block_cache_bytes;
+    size_t result_cache_bytes;
+    size_t subscription_bytes;
+} sky_table_memory;
+
 
 //==============================================================================
 //
@@ -98,6 +245,52 @@ int sky_table_open(sky_table *table);
 
 int sky_table_close(sky_table *table);
 
+int sky_table_set_durability(sky_table *table, sky_durability_e durability);
+
+int sky_table_flush(sky_table *table);
+
+int sky_table_set_memtable_size(sky_table *table, uint32_t memtable_size);
+
+int sky_table_set_reorder_window(sky_table *table, uint32_t reorder_window);
+
+int sky_table_set_preload(sky_table *table, bool preload);
+
+int sky_table_set_huge_pages(sky_table *table, bool huge_pages);
+
+int sky_table_set_block_cache_size(sky_table *table, size_t block_cache_size);
+
+int sky_table_set_prefetcher(sky_table *table, sky_prefetcher *prefetcher);
+
+int sky_table_set_result_cache_size(sky_table *table, size_t result_cache_size);
+
+int sky_table_set_retention(sky_table *table, uint32_t retention);
+
+int sky_table_set_action_only(sky_table *table, bool action_only);
+
+int sky_table_set_shard_count(sky_table *table, uint32_t shard_count);
+
+int sky_table_set_partition_period(sky_table *table, uint32_t partition_period);
+
+uint32_t sky_table_get_unflushed_event_count(sky_table *table);
+
+
+//--------------------------------------
+// Data Files
+//--------------------------------------
+
+uint32_t sky_table_get_data_file_count(sky_table *table);
+
+sky_data_file *sky_table_get_data_file(sky_table *table, uint32_t index);
+
+sky_data_file *sky_table_get_object_data_file(sky_table *table,
+    sky_object_id_t object_id);
+
+uint32_t sky_table_get_block_count(sky_table *table);
+
+uint32_t sky_table_get_block_size(sky_table *table);
+
+uint64_t sky_table_get_write_version(sky_table *table);
+
 
 //--------------------------------------
 // Event Management
@@ -105,4 +298,98 @@ int sky_table_close(sky_table *table);
 
 int sky_table_add_event(sky_table *table, sky_event *event);
 
+int sky_table_add_events(sky_table *table, sky_event **events,
+    uint32_t event_count);
+
+int sky_table_add_sorted_events(sky_table *table, sky_event **events,
+    uint32_t event_count);
+
+int sky_table_remove_object(sky_table *table, sky_object_id_t object_id,
+    bool *removed);
+
+int sky_table_remove_events(sky_table *table, sky_object_id_t object_id,
+    sky_timestamp_t timestamp, uint32_t *count);
+
+void sky_table_sort_events(sky_event **events, uint32_t event_count);
+
+int sky_table_merge(sky_table *table);
+
+int sky_table_compact(sky_table *table, uint32_t fill_factor);
+
+int sky_table_expire(sky_table *table, uint32_t *count);
+
+int sky_table_compress(sky_table *table, uint32_t idle_seconds,
+    uint32_t limit, uint32_t *count);
+
+void sky_table_release_cache(sky_table *table);
+
+//--------------------------------------
+// Querying
+//--------------------------------------
+
+int sky_table_find_path(sky_table *table, sky_object_id_t object_id,
+    void ***paths, uint32_t *path_count);
+
+int sky_table_execute_query(sky_table *table, sky_query *query,
+    sky_query_result *result);
+
+//--------------------------------------
+// Replication
+//--------------------------------------
+
+int sky_table_reset_data_file(sky_table *table, uint32_t block_size);
+
+int sky_table_reload_metadata(sky_table *table);
+
+void sky_table_invalidate(sky_table *table);
+
+//--------------------------------------
+// Snapshots
+//--------------------------------------
+
+int sky_table_snapshot(sky_table *table, bstring path, bool *cloned);
+
+//--------------------------------------
+// Continuous Queries
+//--------------------------------------
+
+int sky_table_add_continuous_query(sky_table *table,
+    sky_action_id_t *prior_action_ids, uint32_t prior_action_id_count,
+    sky_continuous_query **ret);
+
+int sky_table_remove_continuous_query(sky_table *table,
+    sky_action_id_t *prior_action_ids, uint32_t prior_action_id_count);
+
+sky_continuous_query *sky_table_find_continuous_query(sky_table *table,
+    sky_action_id_t *prior_action_ids, uint32_t prior_action_id_count);
+
+//--------------------------------------
+// Subscriptions
+//--------------------------------------
+
+int sky_table_add_subscription(sky_table *table, uint32_t capacity,
+    sky_action_id_t *action_ids, uint32_t action_id_count,
+    sky_subscription **ret);
+
+int sky_table_remove_subscription(sky_table *table, uint64_t id);
+
+sky_subscription *sky_table_find_subscription(sky_table *table, uint64_t id);
+
+//--------------------------------------
+// Action Index
+//--------------------------------------
+
+int sky_table_get_action_index(sky_table *table, sky_action_index **ret);
+
+int sky_table_get_property_index(sky_table *table,
+    sky_property_id_t property_id, sky_property_index **ret);
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+int sky_table_get_memory(sky_table *table, sky_table_memory *memory);
+
+void sky_table_memory_free(sky_table_memory *memory);
+
 #endif
@@ -0,0 +1,263 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "bstring.h"
+#include "table_cache.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_table_cache_remove(sky_table_cache *cache, uint32_t index);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a table cache.
+//
+// max_tables       - The maximum number of tables to keep open.
+// max_mapped_bytes - The maximum number of data bytes mapped across all open
+//                    tables. A value of zero means there is no limit.
+//
+// Returns a reference to the new cache.
+sky_table_cache *sky_table_cache_create(uint32_t max_tables,
+                                        size_t max_mapped_bytes)
+{
+    sky_table_cache *cache = NULL;
+    check(max_tables > 0, "At least one table must be allowed in the cache");
+
+    cache = calloc(1, sizeof(sky_table_cache)); check_mem(cache);
+    cache->max_tables = max_tables;
+    cache->max_mapped_bytes = max_mapped_bytes;
+    cache->tables = calloc(max_tables, sizeof(*cache->tables));
+    check_mem(cache->tables);
+
+    return cache;
+
+error:
+    sky_table_cache_free(cache);
+    return NULL;
+}
+
+// Closes all tables in the cache and frees it from memory.
+//
+// cache - The cache.
+void sky_table_cache_free(sky_table_cache *cache)
+{
+    if(cache) {
+        sky_table_cache_close_all(cache);
+        free(cache->tables);
+        free(cache);
+    }
+}
+
+
+//--------------------------------------
+// Table Management
+//--------------------------------------
+
+// Finds an open table in the cache without opening it or changing its
+// position in the cache.
+//
+// cache - The cache.
+// path  - The path to the table.
+//
+// Returns the cached table or NULL if it is not open.
+sky_table *sky_table_cache_find(sky_table_cache *cache, bstring path)
+{
+    uint32_t i;
+    for(i=0; i<cache->table_count; i++) {
+        if(biseq(cache->tables[i]->path, path) == 1) {
+            return cache->tables[i];
+        }
+    }
+    return NULL;
+}
+
+// Retrieves an open table from the cache or opens it if it is not cached.
+// The table becomes the most recently used table and other tables are
+// evicted if the cache is over its limits.
+//
+// cache - The cache.
+// path  - The path to the table.
+// table - Returns the open table to the caller.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_cache_open(sky_table_cache *cache, bstring path,
+                         sky_table **table)
+{
+    int rc;
+    uint32_t i;
+    check(cache != NULL, "Cache required");
+    check(path != NULL, "Table path required");
+    check(table != NULL, "Table return reference required");
+
+    *table = NULL;
+
+    // Look up the table in the cache.
+    for(i=0; i<cache->table_count; i++) {
+        if(biseq(cache->tables[i]->path, path) == 1) {
+            *table = cache->tables[i];
+            break;
+        }
+    }
+
+    // Move a cached table to the front.
+    if(*table != NULL) {
+        memmove(&cache->tables[1], &cache->tables[0], sizeof(*cache->tables) * i);
+        cache->tables[0] = *table;
+        return 0;
+    }
+
+    // Make room for the table before it is opened so that the file
+    // descriptor limit is never exceeded.
+    if(cache->table_count == cache->max_tables) {
+        rc = sky_table_cache_remove(cache, cache->table_count-1);
+        check(rc == 0, "Unable to evict table");
+    }
+
+    // Otherwise open the table.
+    *table = sky_table_create(); check_mem(*table);
+    rc = sky_table_set_path(*table, path);
+    check(rc == 0, "Unable to set table path");
+    (*table)->default_block_size = cache->default_block_size;
+    rc = sky_table_set_action_only(*table, cache->default_action_only);
+    check(rc == 0, "Unable to set table format");
+    rc = sky_table_set_shard_count(*table, cache->default_shard_count);
+    check(rc == 0, "Unable to set table shard count");
+    rc = sky_table_set_partition_period(*table, cache->default_partition_period);
+    check(rc == 0, "Unable to set table partition period");
+    rc = sky_table_open(*table);
+    check(rc == 0, "Unable to open table");
+
+    // Add it to the front of the cache.
+    memmove(&cache->tables[1], &cache->tables[0], sizeof(*cache->tables) * cache->table_count);
+    cache->tables[0] = *table;
+    cache->table_count++;
+
+    // Close older tables if there is too much data mapped.
+    rc = sky_table_cache_evict(cache);
+    check(rc == 0, "Unable to evict tables");
+
+    return 0;
+
+error:
+    if(table && *table) {
+        sky_table_free(*table);
+        *table = NULL;
+    }
+    return -1;
+}
+
+// Closes the least recently used tables until the cache is within its
+// limits. The most recently used table is always kept open.
+//
+// cache - The cache.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_cache_evict(sky_table_cache *cache)
+{
+    int rc;
+    check(cache != NULL, "Cache required");
+
+    while(cache->table_count > 1) {
+        bool over_count = (cache->table_count > cache->max_tables);
+        bool over_bytes = (cache->max_mapped_bytes > 0 && sky_table_cache_mapped_bytes(cache) > cache->max_mapped_bytes);
+        if(!over_count && !over_bytes) {
+            break;
+        }
+
+        rc = sky_table_cache_remove(cache, cache->table_count-1);
+        check(rc == 0, "Unable to evict table");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Closes every table in the cache.
+//
+// cache - The cache.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_cache_close_all(sky_table_cache *cache)
+{
+    int rc = 0;
+    check(cache != NULL, "Cache required");
+
+    while(cache->table_count > 0) {
+        if(sky_table_cache_remove(cache, cache->table_count-1) != 0) {
+            rc = -1;
+        }
+    }
+
+    return rc;
+
+error:
+    return -1;
+}
+
+// Closes and frees a table and removes it from the cache.
+//
+// cache - The cache.
+// index - The index of the table in the cache.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_table_cache_remove(sky_table_cache *cache, uint32_t index)
+{
+    int rc;
+    check(index < cache->table_count, "Table index out of range");
+
+    sky_table *table = cache->tables[index];
+    memmove(&cache->tables[index], &cache->tables[index+1], sizeof(*cache->tables) * (cache->table_count-index-1));
+    cache->table_count--;
+    cache->tables[cache->table_count] = NULL;
+
+    debug("Closing table: %s", bdata(table->path));
+    rc = sky_table_close(table);
+    sky_table_free(table);
+    check(rc == 0, "Unable to close table");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Stats
+//--------------------------------------
+
+// Calculates the total number of data bytes mapped by all open tables.
+//
+// cache - The cache.
+//
+// Returns the number of mapped bytes.
+size_t sky_table_cache_mapped_bytes(sky_table_cache *cache)
+{
+    uint32_t i, j;
+    size_t sz = 0;
+    for(i=0; i<cache->table_count; i++) {
+        sky_table *table = cache->tables[i];
+        for(j=0; j<sky_table_get_data_file_count(table); j++) {
+            sz += sky_table_get_data_file(table, j)->mapped_length;
+        }
+    }
+    return sz;
+}
@@ -0,0 +1,92 @@
+#ifndef _table_cache_h
+#define _table_cache_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct sky_table_cache sky_table_cache;
+
+#include "bstring.h"
+#include "table.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The table cache keeps recently used tables open so that clients that
+// interleave messages across many tables do not pay for reopening the data,
+// header, action and property files on every message.
+//
+// Tables are kept in most recently used order. When the number of open
+// tables or the total number of mapped data bytes exceeds the cache's
+// limits, the least recently used tables are closed. The most recently used
+// table is never evicted, even if it exceeds the mapped byte limit on its own.
+//
+// Tables that the cache opens are given its default block size, format,
+// shard count and partition period, which are only used when the table's
+// data file is created.
+//
+// A cache is not thread safe. Each worker owns its own cache.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// The number of file descriptors held open by a single table (lock file and
+// data file).
+#define SKY_TABLE_FILE_COUNT 2
+
+struct sky_table_cache {
+    sky_table **tables;
+    uint32_t table_count;
+    uint32_t max_tables;
+    size_t max_mapped_bytes;
+    uint32_t default_block_size;
+    bool default_action_only;
+    uint32_t default_shard_count;
+    uint32_t default_partition_period;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_table_cache *sky_table_cache_create(uint32_t max_tables,
+    size_t max_mapped_bytes);
+
+void sky_table_cache_free(sky_table_cache *cache);
+
+//--------------------------------------
+// Table Management
+//--------------------------------------
+
+sky_table *sky_table_cache_find(sky_table_cache *cache, bstring path);
+
+int sky_table_cache_open(sky_table_cache *cache, bstring path,
+    sky_table **table);
+
+int sky_table_cache_close_all(sky_table_cache *cache);
+
+int sky_table_cache_evict(sky_table_cache *cache);
+
+//--------------------------------------
+// Stats
+//--------------------------------------
+
+size_t sky_table_cache_mapped_bytes(sky_table_cache *cache);
+
+#endif
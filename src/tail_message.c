@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "types.h"
+#include "tail_message.h"
+#include "eget_message.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+struct tagbstring SKY_TAIL_KEY_SUBSCRIPTION_ID = bsStatic("subscriptionId");
+
+struct tagbstring SKY_TAIL_KEY_LIMIT = bsStatic("limit");
+
+struct tagbstring SKY_TAIL_KEY_CLOSE = bsStatic("close");
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a Tail message object.
+//
+// Returns a new Tail message.
+sky_tail_message *sky_tail_message_create()
+{
+    sky_tail_message *message = NULL;
+    message = calloc(1, sizeof(sky_tail_message)); check_mem(message);
+    return message;
+
+error:
+    sky_tail_message_free(message);
+    return NULL;
+}
+
+// Frees a Tail message object from memory.
+//
+// message - The message object to be freed.
+//
+// Returns nothing.
+void sky_tail_message_free(sky_tail_message *message)
+{
+    if(message) {
+        free(message);
+    }
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Serializes a Tail message to a file stream.
+//
+// message - The message.
+// file    - The file stream to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_tail_message_pack(sky_tail_message *message, FILE *file)
+{
+    size_t sz;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    check(minipack_fwrite_map(file, 3, &sz) == 0, "Unable to pack map");
+    check(sky_minipack_fwrite_bstring(file, &SKY_TAIL_KEY_SUBSCRIPTION_ID) == 0, "Unable to pack subscription id key");
+    check(minipack_fwrite_uint(file, message->subscription_id, &sz) == 0, "Unable to pack subscription id");
+    check(sky_minipack_fwrite_bstring(file, &SKY_TAIL_KEY_LIMIT) == 0, "Unable to pack limit key");
+    check(minipack_fwrite_uint(file, message->limit, &sz) == 0, "Unable to pack limit");
+    check(sky_minipack_fwrite_bstring(file, &SKY_TAIL_KEY_CLOSE) == 0, "Unable to pack close key");
+    check(minipack_fwrite_bool(file, message->close, &sz) == 0, "Unable to pack close flag");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Deserializes a Tail message from a file stream.
+//
+// message - The message.
+// file    - The file stream to read from.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_tail_message_unpack(sky_tail_message *message, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    bstring key = NULL;
+    check(message != NULL, "Message required");
+    check(file != NULL, "File stream required");
+
+    uint32_t map_length = minipack_fread_map(file, &sz);
+    check(sz > 0, "Unable to read map");
+
+    for(i=0; i<map_length; i++) {
+        rc = sky_minipack_fread_bstring(file, &key);
+        check(rc == 0, "Unable to read map key");
+
+        if(biseq(key, &SKY_TAIL_KEY_SUBSCRIPTION_ID) == 1) {
+            message->subscription_id = minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack subscription id");
+        }
+        else if(biseq(key, &SKY_TAIL_KEY_LIMIT) == 1) {
+            message->limit = (uint32_t)minipack_fread_uint(file, &sz);
+            check(sz > 0, "Unable to unpack limit");
+        }
+        else if(biseq(key, &SKY_TAIL_KEY_CLOSE) == 1) {
+            message->close = minipack_fread_bool(file, &sz);
+            check(sz > 0, "Unable to unpack close flag");
+        }
+        else {
+            sentinel("Invalid 'Tail' key: %s", bdata(key));
+        }
+
+        bdestroy(key);
+        key = NULL;
+    }
+
+    return 0;
+
+error:
+    bdestroy(key);
+    return -1;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Writes the buffered events of a subscription and removes them from its
+// ring. A closing message also removes the subscription from the table.
+//
+// message - The message.
+// table   - The table of the subscription.
+// output  - The buffer to write the response to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_tail_message_process(sky_tail_message *message, sky_table *table,
+                             sky_buffer *output)
+{
+    int rc;
+    uint32_t i;
+    check(message != NULL, "Message required");
+    check(table != NULL, "Table required");
+    check(output != NULL, "Output buffer required");
+
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring not_found_str = bsStatic("not found");
+    struct tagbstring dropped_str = bsStatic("dropped");
+    struct tagbstring events_str = bsStatic("events");
+
+    // Return.
+    //   {status:"not found"}
+    sky_subscription *subscription = sky_table_find_subscription(table, message->subscription_id);
+    if(subscription == NULL) {
+        check(sky_buffer_pack_map(output, 1) == 0, "Unable to write root map");
+        check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+        check(sky_buffer_pack_bstring(output, &not_found_str) == 0, "Unable to write status value");
+        return 0;
+    }
+
+    uint32_t count = sky_subscription_get_event_count(subscription);
+    if(message->limit > 0 && message->limit < count) {
+        count = message->limit;
+    }
+
+    // Return.
+    //   {status:"ok", dropped:<count>, events:[...]}
+    check(sky_buffer_pack_map(output, 3) == 0, "Unable to write root map");
+    check(sky_buffer_pack_bstring(output, &status_str) == 0, "Unable to write status key");
+    check(sky_buffer_pack_bstring(output, &ok_str) == 0, "Unable to write status value");
+    check(sky_buffer_pack_bstring(output, &dropped_str) == 0, "Unable to write dropped key");
+    check(sky_buffer_pack_uint(output, subscription->dropped) == 0, "Unable to write dropped count");
+    check(sky_buffer_pack_bstring(output, &events_str) == 0, "Unable to write events key");
+    check(sky_buffer_pack_array(output, count) == 0, "Unable to write events array");
+
+    for(i=0; i<count; i++) {
+        sky_subscription_event *event = sky_subscription_peek(subscription, i);
+        rc = sky_eget_message_pack_object_event(table, event->object_id, event->data, output);
+        check(rc == 0, "Unable to write event");
+    }
+
+    // Only remove the events once the whole response has been written.
+    sky_subscription_shift(subscription, count);
+    subscription->dropped = 0;
+
+    if(message->close) {
+        rc = sky_table_remove_subscription(table, subscription->id);
+        check(rc == 0, "Unable to remove subscription");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
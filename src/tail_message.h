@@ -0,0 +1,85 @@
+#ifndef _sky_tail_message_h
+#define _sky_tail_message_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "bstring.h"
+#include "buffer.h"
+#include "table.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// The Tail message takes the events that have been buffered on a
+// subscription since the last Tail message. It never scans the table and
+// returns right away, so a consumer that tails in a loop sees new events as
+// soon as its next message arrives. The message is sent as a map:
+//
+//   {subscriptionId:<int>, limit:<int>, close:<bool>}
+//
+// At most limit events are returned and the rest stay buffered. Every
+// buffered event is returned if the limit is zero or missing. A closing
+// message ends the subscription once its events have been returned.
+//
+// The events are returned oldest first along with the number of events that
+// were dropped since the last Tail message because the subscription was
+// full:
+//
+//   {status:"ok", dropped:<int>, events:[{objectId:0, timestamp:0,
+//     actionId:0, data:{name:value}}]}
+//
+// Data is written as in an EGET response. A subscription that does not
+// exist, for example because its table was closed by the server, is
+// answered with {status:"not found"} and the client should subscribe again.
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// A message for reading the buffered events of a subscription.
+typedef struct sky_tail_message {
+    uint64_t subscription_id;
+    uint32_t limit;
+    bool close;
+} sky_tail_message;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_tail_message *sky_tail_message_create();
+
+void sky_tail_message_free(sky_tail_message *message);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int sky_tail_message_pack(sky_tail_message *message, FILE *file);
+
+int sky_tail_message_unpack(sky_tail_message *message, FILE *file);
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int sky_tail_message_process(sky_tail_message *message, sky_table *table,
+    sky_buffer *output);
+
+#endif
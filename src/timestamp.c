@@ -1,4 +1,7 @@
 #include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
 #include <sys/time.h>
 
 #include "timestamp.h"
@@ -29,6 +32,7 @@ int sky_timestamp_parse(bstring str, sky_timestamp_t *ret)
     
     // Parse date.
     struct tm tp;
+    memset(&tp, 0, sizeof(tp));
     char *ch;
     ch = strptime(bdata(str2), "%Y-%m-%dT%H:%M:%SZ %Z", &tp);
     check(ch != NULL, "Unable to parse timestamp");
@@ -39,6 +43,7 @@ int sky_timestamp_parse(bstring str, sky_timestamp_t *ret)
     sky_timestamp_t value = atoll(buffer);
     *ret = value * 1000000;
     
+    bdestroy(str2);
     return 0;
 
 error:
@@ -46,6 +51,51 @@ error:
     return -1;
 }
 
+// Formats a timestamp as an ISO 8601 date in UTC. Fractional seconds are
+// only included when the timestamp is not on a whole second.
+//
+// timestamp - The number of microseconds since the epoch.
+// buffer    - The buffer to write the null terminated date into.
+// length    - The size of the buffer. SKY_TIMESTAMP_FORMAT_LENGTH bytes is
+//             always enough.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_timestamp_format(sky_timestamp_t timestamp, char *buffer,
+                         size_t length)
+{
+    check(buffer != NULL, "Buffer required");
+
+    // Split into whole seconds and microseconds, rounding down so that the
+    // fraction is never negative.
+    int64_t seconds = timestamp / 1000000;
+    int64_t microseconds = timestamp % 1000000;
+    if(microseconds < 0) {
+        microseconds += 1000000;
+        seconds--;
+    }
+
+    struct tm tp;
+    time_t t = (time_t)seconds;
+    check(gmtime_r(&t, &tp) != NULL, "Unable to convert timestamp");
+    size_t sz = strftime(buffer, length, "%Y-%m-%dT%H:%M:%S", &tp);
+    check(sz > 0, "Timestamp buffer too small");
+
+    int rc;
+    if(microseconds != 0) {
+        rc = snprintf(buffer + sz, length - sz, ".%06dZ", (int)microseconds);
+    }
+    else {
+        rc = snprintf(buffer + sz, length - sz, "Z");
+    }
+    check(rc > 0 && (size_t)rc < length - sz, "Timestamp buffer too small");
+
+    return 0;
+
+error:
+    if(buffer != NULL && length > 0) buffer[0] = '\0';
+    return -1;
+}
+
 // Returns the number of microseconds since the epoch.
 // 
 // ret - The reference to the variable that will be assigned the timestamp.
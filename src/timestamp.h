@@ -1,6 +1,7 @@
 #ifndef _timestamp_h
 #define _timestamp_h
 
+#include <stddef.h>
 #include <inttypes.h>
 
 #include "bstring.h"
@@ -17,6 +18,16 @@
 // The functions provided by the library can parse and format human readable
 // ISO 8601 dates (YYYY-MM-DDTHH:MM:SSZ) to and from this format.
 
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The size of a buffer that can hold any formatted timestamp.
+#define SKY_TIMESTAMP_FORMAT_LENGTH 64
+
+
 //==============================================================================
 //
 // Functions
@@ -25,6 +36,9 @@
 
 int sky_timestamp_parse(bstring str, sky_timestamp_t *ret);
 
+int sky_timestamp_format(sky_timestamp_t timestamp, char *buffer,
+    size_t length);
+
 int sky_timestamp_now(sky_timestamp_t *ret);
 
 #endif
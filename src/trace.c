@@ -0,0 +1,514 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "trace.h"
+#include "stats.h"
+#include "minipack.h"
+#include "mem.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int sky_trace_write_msgpack_elem(uint8_t *bytes, size_t *offset,
+    uint32_t depth, FILE *file);
+
+int sky_trace_write_json_string(void *data, size_t length, FILE *file);
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+// The names of the spans in the trace log.
+const char *sky_trace_span_names[SKY_TRACE_SPAN_COUNT] = {
+    "header", "queue", "table", "body", "execute", "commit", "write",
+};
+
+// The trace of the message that the current thread is executing.
+__thread sky_trace *sky_trace_current = NULL;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a tracer that neither samples nor logs slow queries and writes to
+// standard error until a log is opened.
+//
+// Returns a new tracer.
+sky_tracer *sky_tracer_create()
+{
+    sky_tracer *tracer = NULL;
+    tracer = calloc(1, sizeof(sky_tracer)); check_mem(tracer);
+    pthread_mutex_init(&tracer->mutex, NULL);
+    tracer->file = stderr;
+    return tracer;
+
+error:
+    sky_tracer_free(tracer);
+    return NULL;
+}
+
+// Closes the trace log and frees a tracer from memory.
+//
+// tracer - The tracer.
+void sky_tracer_free(sky_tracer *tracer)
+{
+    if(tracer) {
+        if(tracer->owns_file) fclose(tracer->file);
+        tracer->file = NULL;
+        pthread_mutex_destroy(&tracer->mutex);
+        free(tracer);
+    }
+}
+
+// Opens the file that traces are appended to.
+//
+// tracer - The tracer.
+// path   - The path of the trace log.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_tracer_open(sky_tracer *tracer, bstring path)
+{
+    check(tracer != NULL, "Tracer required");
+    check(path != NULL, "Path required");
+
+    FILE *file = fopen(bdata(path), "a");
+    check(file != NULL, "Unable to open trace log: %s", bdata(path));
+    if(tracer->owns_file) fclose(tracer->file);
+    tracer->file = file;
+    tracer->owns_file = true;
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Frees a trace from memory.
+//
+// trace - The trace.
+void sky_trace_free(sky_trace *trace)
+{
+    if(trace) {
+        bdestroy(trace->database_name);
+        bdestroy(trace->table_name);
+        sky_buffer_free(trace->body);
+        free(trace);
+    }
+}
+
+
+//--------------------------------------
+// Tracing
+//--------------------------------------
+
+// Starts the trace of a message if it is sampled or if slow queries are
+// logged. The header span starts when the message started to be read.
+//
+// tracer     - The tracer.
+// header     - The header of the message.
+// started_at - The time that the message started to be read.
+//
+// Returns a new trace or NULL if the message is not traced.
+sky_trace *sky_tracer_start(sky_tracer *tracer, sky_message_header *header,
+                            int64_t started_at)
+{
+    sky_trace *trace = NULL;
+    if(tracer == NULL || header == NULL) {
+        return NULL;
+    }
+
+    bool sampled = false;
+    if(tracer->sample_rate > 0) {
+        uint64_t count = __sync_fetch_and_add(&tracer->message_count, 1);
+        sampled = ((count % tracer->sample_rate) == 0);
+    }
+    if(!sampled && tracer->slow_threshold == 0) {
+        return NULL;
+    }
+
+    trace = calloc(1, sizeof(sky_trace)); check_mem(trace);
+    trace->type = header->type;
+    trace->database_name = bstrcpy(header->database_name); check_mem(trace->database_name);
+    trace->table_name = bstrcpy(header->table_name); check_mem(trace->table_name);
+    trace->pipelined = header->pipelined;
+    trace->request_id = header->request_id;
+    trace->body_length = header->length;
+    trace->sampled = sampled;
+    trace->started_at = started_at;
+    trace->mark = started_at;
+    sky_trace_mark(trace, SKY_TRACE_SPAN_HEADER);
+
+    return trace;
+
+error:
+    sky_trace_free(trace);
+    return NULL;
+}
+
+// Ends the current span of a trace and starts the next one.
+//
+// trace - The trace. Nothing is recorded if this is NULL.
+// span  - The span that ends now.
+void sky_trace_mark(sky_trace *trace, sky_trace_span_e span)
+{
+    if(trace != NULL) {
+        int64_t now = sky_stats_now();
+        trace->spans[span] += now - trace->mark;
+        trace->mark = now;
+    }
+}
+
+// Ends the current span of the trace of the message that the current
+// thread is executing.
+//
+// span - The span that ends now.
+void sky_trace_mark_current(sky_trace_span_e span)
+{
+    sky_trace_mark(sky_trace_current, span);
+}
+
+// Adds the counts of a scan to the trace of the message that the current
+// thread is executing.
+//
+// event_count    - The number of events that were scanned.
+// blocks_visited - The number of blocks that were read.
+// blocks_skipped - The number of blocks that were skipped.
+void sky_trace_add_scan(uint64_t event_count, uint64_t blocks_visited,
+                        uint64_t blocks_skipped)
+{
+    sky_trace *trace = sky_trace_current;
+    if(trace != NULL) {
+        trace->scanned_events += event_count;
+        trace->blocks_visited += blocks_visited;
+        trace->blocks_skipped += blocks_skipped;
+    }
+}
+
+// Checks if a trace will be written to the log based on how long its
+// message has taken so far.
+//
+// tracer - The tracer.
+// trace  - The trace.
+//
+// Returns true if the trace is sampled or slow.
+bool sky_tracer_should_log(sky_tracer *tracer, sky_trace *trace)
+{
+    if(tracer == NULL || trace == NULL) {
+        return false;
+    }
+    if(trace->sampled) {
+        return true;
+    }
+    return (tracer->slow_threshold > 0 && (sky_stats_now() - trace->started_at) >= tracer->slow_threshold);
+}
+
+// Copies the body of a message into its trace if the trace will be logged.
+// This must be called while the body is still in memory, which is before
+// the response is written. The commit and write spans are not known yet so
+// a message that only becomes slow while it waits for a group commit is
+// logged without its body.
+//
+// tracer - The tracer.
+// trace  - The trace.
+// data   - The body of the message.
+// length - The number of bytes in the body.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_tracer_capture_body(sky_tracer *tracer, sky_trace *trace,
+                            void *data, size_t length)
+{
+    if(trace == NULL || trace->body != NULL || length == 0 || length > SKY_TRACE_MAX_BODY_LENGTH) {
+        return 0;
+    }
+    if(!sky_tracer_should_log(tracer, trace)) {
+        return 0;
+    }
+
+    trace->body = sky_buffer_create(); check_mem(trace->body);
+    check(sky_buffer_write(trace->body, data, length) == 0, "Unable to copy message body");
+    return 0;
+
+error:
+    sky_buffer_free(trace->body);
+    trace->body = NULL;
+    return -1;
+}
+
+// Ends a trace and writes it to the log if it was sampled or if its message
+// took longer than the slow query threshold. The trace is freed.
+//
+// tracer - The tracer.
+// trace  - The trace.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_tracer_finish(sky_tracer *tracer, sky_trace *trace)
+{
+    int rc;
+    if(tracer == NULL || trace == NULL) {
+        sky_trace_free(trace);
+        return 0;
+    }
+
+    int64_t duration = trace->mark - trace->started_at;
+    bool slow = (tracer->slow_threshold > 0 && duration >= tracer->slow_threshold);
+    if(slow) __sync_add_and_fetch(&tracer->slow_count, 1);
+    if(trace->sampled) __sync_add_and_fetch(&tracer->sampled_count, 1);
+
+    if(slow || trace->sampled) {
+        pthread_mutex_lock(&tracer->mutex);
+        rc = sky_trace_write_json(trace, slow, tracer->file);
+        if(rc == 0) rc = fflush(tracer->file);
+        pthread_mutex_unlock(&tracer->mutex);
+        check(rc == 0, "Unable to write trace");
+    }
+
+    sky_trace_free(trace);
+    return 0;
+
+error:
+    sky_trace_free(trace);
+    return -1;
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+// Writes a trace to a file as one line of JSON.
+//
+// trace - The trace.
+// slow  - Whether the message was slower than the slow query threshold.
+// file  - The file to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_trace_write_json(sky_trace *trace, bool slow, FILE *file)
+{
+    int rc;
+    uint32_t i;
+    check(trace != NULL, "Trace required");
+    check(file != NULL, "File required");
+
+    const char *name = sky_message_type_get_name(trace->type);
+    fprintf(file, "{\"time\":%" PRId64 ",\"slow\":%s,\"sampled\":%s,\"type\":",
+        trace->started_at, (slow ? "true" : "false"), (trace->sampled ? "true" : "false"));
+    check(sky_trace_write_json_string((void*)name, strlen(name), file) == 0, "Unable to write type");
+    fprintf(file, ",\"database\":");
+    check(sky_trace_write_json_string(bdatae(trace->database_name, ""), blength(trace->database_name), file) == 0, "Unable to write database name");
+    fprintf(file, ",\"table\":");
+    check(sky_trace_write_json_string(bdatae(trace->table_name, ""), blength(trace->table_name), file) == 0, "Unable to write table name");
+    if(trace->pipelined) {
+        fprintf(file, ",\"requestId\":%" PRIu64, trace->request_id);
+    }
+    fprintf(file, ",\"failed\":%s,\"duration\":%" PRId64 ",\"spans\":{",
+        (trace->failed ? "true" : "false"), trace->mark - trace->started_at);
+    for(i=0; i<SKY_TRACE_SPAN_COUNT; i++) {
+        fprintf(file, "%s\"%s\":%" PRId64, (i > 0 ? "," : ""), sky_trace_span_names[i], trace->spans[i]);
+    }
+    fprintf(file, "},\"scannedEvents\":%" PRIu64 ",\"blocksVisited\":%" PRIu64 ",\"blocksSkipped\":%" PRIu64 ",\"responseLength\":%zu",
+        trace->scanned_events, trace->blocks_visited, trace->blocks_skipped, trace->response_length);
+
+    // The body is only written if it converts cleanly so a bad body cannot
+    // break the line.
+    if(trace->body != NULL) {
+        char *data = NULL;
+        size_t length = 0;
+        FILE *body_file = open_memstream(&data, &length); check_mem(body_file);
+        rc = sky_trace_write_msgpack_json(trace->body->data, trace->body->length, body_file);
+        fclose(body_file);
+        if(rc == 0) {
+            fprintf(file, ",\"body\":");
+            fwrite(data, length, 1, file);
+        }
+        free(data);
+    }
+    fprintf(file, "}\n");
+    check(!ferror(file), "Unable to write trace");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Converts a MessagePack element to JSON. Keys that are not strings are
+// written as the string of their JSON.
+//
+// data   - The MessagePack bytes.
+// length - The number of bytes.
+// file   - The file to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_trace_write_msgpack_json(void *data, size_t length, FILE *file)
+{
+    int rc;
+    bool complete = false;
+    sky_minipack_decoder decoder;
+    check(data != NULL, "Data required");
+    check(file != NULL, "File required");
+
+    // Make sure the whole element is in the buffer before it is walked.
+    sky_minipack_decoder_init(&decoder, 0);
+    rc = sky_minipack_decoder_skip(&decoder, data, length, &complete);
+    check(rc == 0 && complete, "Incomplete MessagePack element");
+
+    size_t offset = 0;
+    rc = sky_trace_write_msgpack_elem((uint8_t*)data, &offset, 0, file);
+    check(rc == 0, "Unable to convert MessagePack element");
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Converts a single element that is known to be complete to JSON.
+//
+// bytes  - The MessagePack bytes.
+// offset - The position of the element. This is moved past the element.
+// depth  - The number of maps and arrays that contain the element.
+// file   - The file to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_trace_write_msgpack_elem(uint8_t *bytes, size_t *offset,
+                                 uint32_t depth, FILE *file)
+{
+    int rc;
+    size_t sz;
+    uint32_t i;
+    char *key_data = NULL;
+    check(depth < SKY_TRACE_MAX_DEPTH, "MessagePack element nested too deeply");
+
+    uint8_t *ptr = bytes + *offset;
+    uint8_t type = *ptr;
+    if(minipack_is_nil(ptr)) {
+        minipack_unpack_nil(ptr, &sz);
+        fprintf(file, "null");
+    }
+    else if(minipack_is_bool(ptr)) {
+        fprintf(file, (minipack_unpack_bool(ptr, &sz) ? "true" : "false"));
+    }
+    else if(type <= 0x7F || (type >= 0xCC && type <= 0xCF)) {
+        fprintf(file, "%" PRIu64, minipack_unpack_uint(ptr, &sz));
+    }
+    else if(type >= 0xE0 || (type >= 0xD0 && type <= 0xD3)) {
+        fprintf(file, "%" PRId64, minipack_unpack_int(ptr, &sz));
+    }
+    else if(minipack_is_float(ptr) || minipack_is_double(ptr)) {
+        double value = (minipack_is_float(ptr) ? minipack_unpack_float(ptr, &sz) : minipack_unpack_double(ptr, &sz));
+        if(isfinite(value)) {
+            fprintf(file, "%.17g", value);
+        }
+        else {
+            fprintf(file, "null");
+        }
+    }
+    else if(minipack_is_raw(ptr)) {
+        uint32_t length = minipack_unpack_raw(ptr, &sz);
+        rc = sky_trace_write_json_string(ptr + sz, length, file);
+        check(rc == 0, "Unable to write string");
+        sz += length;
+    }
+    else if(minipack_is_array(ptr)) {
+        uint32_t count = minipack_unpack_array(ptr, &sz);
+        *offset += sz;
+        fprintf(file, "[");
+        for(i=0; i<count; i++) {
+            if(i > 0) fprintf(file, ",");
+            rc = sky_trace_write_msgpack_elem(bytes, offset, depth+1, file);
+            check(rc == 0, "Unable to write array element");
+        }
+        fprintf(file, "]");
+        return 0;
+    }
+    else if(minipack_is_map(ptr)) {
+        uint32_t count = minipack_unpack_map(ptr, &sz);
+        *offset += sz;
+        fprintf(file, "{");
+        for(i=0; i<count; i++) {
+            if(i > 0) fprintf(file, ",");
+            if(minipack_is_raw(bytes + *offset)) {
+                rc = sky_trace_write_msgpack_elem(bytes, offset, depth+1, file);
+                check(rc == 0, "Unable to write map key");
+            }
+            else {
+                size_t key_length = 0;
+                FILE *key_file = open_memstream(&key_data, &key_length); check_mem(key_file);
+                rc = sky_trace_write_msgpack_elem(bytes, offset, depth+1, key_file);
+                fclose(key_file);
+                check(rc == 0, "Unable to write map key");
+                check(sky_trace_write_json_string(key_data, key_length, file) == 0, "Unable to write map key");
+                free(key_data);
+                key_data = NULL;
+            }
+            fprintf(file, ":");
+            rc = sky_trace_write_msgpack_elem(bytes, offset, depth+1, file);
+            check(rc == 0, "Unable to write map value");
+        }
+        fprintf(file, "}");
+        return 0;
+    }
+    else {
+        sentinel("Unsupported element type: 0x%02x", type);
+    }
+
+    *offset += sz;
+    return 0;
+
+error:
+    free(key_data);
+    return -1;
+}
+
+// Writes bytes as a quoted JSON string. Control characters are escaped.
+//
+// data   - The bytes of the string.
+// length - The number of bytes.
+// file   - The file to write to.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_trace_write_json_string(void *data, size_t length, FILE *file)
+{
+    size_t i;
+    uint8_t *bytes = (uint8_t*)data;
+
+    fputc('"', file);
+    for(i=0; i<length; i++) {
+        uint8_t ch = bytes[i];
+        if(ch == '"' || ch == '\\') {
+            fputc('\\', file);
+            fputc(ch, file);
+        }
+        else if(ch == '\n') {
+            fputs("\\n", file);
+        }
+        else if(ch == '\t') {
+            fputs("\\t", file);
+        }
+        else if(ch < 0x20) {
+            fprintf(file, "\\u%04x", ch);
+        }
+        else {
+            fputc(ch, file);
+        }
+    }
+    fputc('"', file);
+
+    return (ferror(file) ? -1 : 0);
+}
@@ -0,0 +1,175 @@
+#ifndef _sky_trace_h
+#define _sky_trace_h
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef struct sky_tracer sky_tracer;
+typedef struct sky_trace sky_trace;
+
+#include "bstring.h"
+#include "buffer.h"
+#include "message_header.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A trace follows a single message through the server and records how long
+// it spent in each stage: parsing the header, waiting in the worker's
+// queue, opening the table, unpacking the body, executing, waiting for a
+// group commit and writing the response. Each span ends when the next one
+// starts, so the spans of a message add up to its total duration. Stages
+// that are not marked separately are counted in the span that follows
+// them. For example, the body of a message that is unpacked while it is
+// executed is counted as execution. Scans that run while a message is
+// executed add their event and block counts to the message's trace.
+//
+// The tracer decides which messages are traced. One in every sample rate
+// messages is sampled and every sampled trace is written to the trace log.
+// When the tracer has a slow query threshold, every message is traced so
+// that the ones that take longer than the threshold can be written to the
+// log as well. A traced message costs a handful of clock reads, and the
+// body is only copied once the message is known to be logged.
+//
+// The log holds one JSON object per line with the header of the message,
+// its spans in microseconds, its scan counts and its body converted from
+// MessagePack to JSON. Bodies larger than the maximum body length are left
+// out of the log.
+//
+// The trace of the message that a thread is executing is kept in a thread
+// local so that the message and query code can mark spans and add scan
+// counts without passing the trace through every call.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The largest body that is written to the trace log.
+#define SKY_TRACE_MAX_BODY_LENGTH 65536
+
+// The deepest nesting of maps and arrays that is written to the trace log.
+#define SKY_TRACE_MAX_DEPTH 32
+
+// The stages of a message.
+typedef enum sky_trace_span_e {
+    SKY_TRACE_SPAN_HEADER,
+    SKY_TRACE_SPAN_QUEUE,
+    SKY_TRACE_SPAN_TABLE,
+    SKY_TRACE_SPAN_BODY,
+    SKY_TRACE_SPAN_EXECUTE,
+    SKY_TRACE_SPAN_COMMIT,
+    SKY_TRACE_SPAN_WRITE,
+} sky_trace_span_e;
+
+#define SKY_TRACE_SPAN_COUNT (SKY_TRACE_SPAN_WRITE + 1)
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// The trace of a single message. Times are in microseconds. The mark is
+// the time that the current span started. The body offset is where the
+// body of a message that was not read ahead starts in its frame.
+struct sky_trace {
+    sky_message_type_e type;
+    bstring database_name;
+    bstring table_name;
+    bool pipelined;
+    uint64_t request_id;
+    uint64_t body_length;
+    size_t body_offset;
+    sky_buffer *body;
+    bool sampled;
+    bool failed;
+    int64_t started_at;
+    int64_t mark;
+    int64_t spans[SKY_TRACE_SPAN_COUNT];
+    uint64_t scanned_events;
+    uint64_t blocks_visited;
+    uint64_t blocks_skipped;
+    size_t response_length;
+};
+
+// The slow query threshold is in microseconds. A sample rate or threshold
+// of zero turns sampling or the slow query log off.
+struct sky_tracer {
+    uint32_t sample_rate;
+    int64_t slow_threshold;
+    FILE *file;
+    bool owns_file;
+    pthread_mutex_t mutex;
+    uint64_t message_count;
+    uint64_t sampled_count;
+    uint64_t slow_count;
+};
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+extern __thread sky_trace *sky_trace_current;
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_tracer *sky_tracer_create();
+
+void sky_tracer_free(sky_tracer *tracer);
+
+int sky_tracer_open(sky_tracer *tracer, bstring path);
+
+void sky_trace_free(sky_trace *trace);
+
+//--------------------------------------
+// Tracing
+//--------------------------------------
+
+sky_trace *sky_tracer_start(sky_tracer *tracer, sky_message_header *header,
+    int64_t started_at);
+
+void sky_trace_mark(sky_trace *trace, sky_trace_span_e span);
+
+void sky_trace_mark_current(sky_trace_span_e span);
+
+void sky_trace_add_scan(uint64_t event_count, uint64_t blocks_visited,
+    uint64_t blocks_skipped);
+
+bool sky_tracer_should_log(sky_tracer *tracer, sky_trace *trace);
+
+int sky_tracer_capture_body(sky_tracer *tracer, sky_trace *trace,
+    void *data, size_t length);
+
+int sky_tracer_finish(sky_tracer *tracer, sky_trace *trace);
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int sky_trace_write_json(sky_trace *trace, bool slow, FILE *file);
+
+int sky_trace_write_msgpack_json(void *data, size_t length, FILE *file);
+
+#endif
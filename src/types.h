@@ -38,11 +38,14 @@
 //--------------------------------------
 
 // Stores an object identifier.
-#define sky_object_id_t uint32_t
+#define sky_object_id_t uint64_t
 
 #define SKY_OBJECT_ID_MIN 1
 
-#define SKY_OBJECT_ID_MAX UINT32_MAX
+#define SKY_OBJECT_ID_MAX UINT64_MAX
+
+// The object identifier stored by data file format versions before 3.
+#define sky_legacy_object_id_t uint32_t
 
 
 //--------------------------------------
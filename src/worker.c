@@ -0,0 +1,1033 @@
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include <stdio.h>
+
+#include "bstring.h"
+#include "worker.h"
+#include "timestamp.h"
+#include "stats.h"
+#include "dbg.h"
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+void *sky_worker_run(void *arg);
+
+void sky_worker_place(sky_worker *worker);
+
+void sky_worker_drain_inbox(sky_worker *worker);
+
+void sky_worker_process_job(sky_worker *worker, sky_worker_job *job);
+
+int sky_worker_hold(sky_worker *worker, sky_connection *connection,
+    sky_trace *trace, sky_worker_reply_e reply, uint32_t index);
+
+void sky_worker_respond(sky_worker *worker, sky_connection *connection,
+    sky_buffer *response, sky_worker_reply_e reply, uint32_t index,
+    bool success);
+
+int sky_worker_stream_output(sky_buffer *buffer, void *data);
+
+void sky_worker_schedule_flush(sky_worker *worker, uint32_t interval);
+
+bool sky_worker_flush_due(sky_worker *worker);
+
+void sky_worker_compress(sky_worker *worker);
+
+void sky_worker_expire(sky_worker *worker);
+
+void sky_worker_account_memory(sky_worker *worker);
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+// Creates a worker for a server.
+//
+// server           - The server that the worker processes messages for.
+// index            - The position of the worker in the server's worker list.
+// max_tables       - The maximum number of tables the worker keeps open.
+// max_mapped_bytes - The maximum number of data bytes the worker keeps mapped.
+//
+// Returns a reference to the worker.
+sky_worker *sky_worker_create(sky_server *server, uint32_t index,
+                              uint32_t max_tables, size_t max_mapped_bytes)
+{
+    sky_worker *worker = NULL;
+    worker = calloc(1, sizeof(sky_worker)); check_mem(worker);
+    worker->server = server;
+    worker->index = index;
+    worker->table_cache = sky_table_cache_create(max_tables, max_mapped_bytes);
+    check_mem(worker->table_cache);
+    if(server != NULL) {
+        worker->table_cache->default_block_size = server->block_size;
+
+        // Replicas copy the format of the primary's tables.
+        worker->table_cache->default_action_only = (server->action_only && server->primary == NULL);
+        worker->table_cache->default_shard_count = server->local_shard_count;
+        worker->table_cache->default_partition_period = server->partition_period;
+    }
+    worker->table_path = bfromcstr(""); check_mem(worker->table_path);
+    worker->arena = sky_arena_create(0); check_mem(worker->arena);
+    worker->output = sky_buffer_create(); check_mem(worker->output);
+
+    // Coordinating workers route messages to the shard nodes.
+    if(server != NULL && server->shard_count > 0) {
+        uint32_t i;
+        worker->coordinator = sky_coordinator_create(); check_mem(worker->coordinator);
+        for(i=0; i<server->shard_count; i++) {
+            check(sky_coordinator_add_node(worker->coordinator, server->shards[i]) == 0, "Unable to add shard node");
+        }
+    }
+
+    // Workers are spread over the NUMA nodes with local placement.
+    if(server != NULL && server->numa_placement == SKY_NUMA_PLACEMENT_LOCAL) {
+        worker->numa_node = sky_numa_get_node(server->numa, index);
+    }
+
+    // Replica workers sync their tables from the primary.
+    if(server != NULL && server->primary != NULL) {
+        worker->replica = sky_replica_create(server->primary, server->replication_interval);
+        check_mem(worker->replica);
+    }
+
+    sky_mpsc_queue_init(&worker->inbox);
+    pthread_mutex_init(&worker->mutex, NULL);
+    pthread_cond_init(&worker->cond, NULL);
+
+    return worker;
+
+error:
+    sky_worker_free(worker);
+    return NULL;
+}
+
+// Frees a worker. The worker must be stopped before it is freed.
+//
+// worker - The worker to free.
+void sky_worker_free(sky_worker *worker)
+{
+    if(worker) {
+        sky_table_cache_free(worker->table_cache);
+        bdestroy(worker->table_path);
+        worker->table_cache = NULL;
+        sky_arena_free(worker->arena);
+        worker->arena = NULL;
+        sky_buffer_free(worker->output);
+        worker->output = NULL;
+        sky_coordinator_free(worker->coordinator);
+        worker->coordinator = NULL;
+        sky_replica_free(worker->replica);
+        worker->replica = NULL;
+        uint32_t i;
+        for(i=0; i<worker->pending_count; i++) {
+            sky_buffer_free(worker->pending[i].buffer);
+            sky_trace_free(worker->pending[i].trace);
+        }
+        free(worker->pending);
+        worker->pending = NULL;
+        worker->pending_count = 0;
+        for(i=0; i<worker->table_memory_count; i++) {
+            sky_table_memory_free(&worker->table_memory[i]);
+        }
+        free(worker->table_memory);
+        worker->table_memory = NULL;
+        worker->table_memory_count = 0;
+        pthread_mutex_destroy(&worker->mutex);
+        pthread_cond_destroy(&worker->cond);
+        free(worker);
+    }
+}
+
+
+//--------------------------------------
+// State
+//--------------------------------------
+
+// Starts the worker's thread.
+//
+// worker - The worker to start.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_worker_start(sky_worker *worker)
+{
+    int rc;
+    check(worker != NULL, "Worker required");
+    check(!worker->running, "Worker already running");
+
+    worker->running = true;
+    rc = pthread_create(&worker->thread, NULL, sky_worker_run, worker);
+    check(rc == 0, "Unable to create worker thread");
+
+    return 0;
+
+error:
+    if(worker) worker->running = false;
+    return -1;
+}
+
+// Stops the worker's thread once all queued jobs have been processed.
+//
+// worker - The worker to stop.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_worker_stop(sky_worker *worker)
+{
+    int rc;
+    check(worker != NULL, "Worker required");
+
+    if(worker->running) {
+        pthread_mutex_lock(&worker->mutex);
+        worker->running = false;
+        pthread_cond_signal(&worker->cond);
+        pthread_mutex_unlock(&worker->mutex);
+
+        rc = pthread_join(worker->thread, NULL);
+        check(rc == 0, "Unable to join worker thread");
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Admission
+//--------------------------------------
+
+// Finds the queue that a type of message waits in. Scans and batch lookups
+// wait in the low priority queue.
+//
+// type - The message type.
+//
+// Returns the queue for the message.
+sky_worker_queue_e sky_worker_get_queue(sky_message_type_e type)
+{
+    switch(type) {
+        case SKY_MESSAGE_TYPE_NEXT_ACTION:
+        case SKY_MESSAGE_TYPE_QUERY:
+        case SKY_MESSAGE_TYPE_FUNNEL:
+        case SKY_MESSAGE_TYPE_DAG:
+        case SKY_MESSAGE_TYPE_COMPACT:
+        case SKY_MESSAGE_TYPE_SNAPSHOT:
+        case SKY_MESSAGE_TYPE_EMGET:
+            return SKY_WORKER_QUEUE_LOW;
+        default:
+            return SKY_WORKER_QUEUE_HIGH;
+    }
+}
+
+// Checks whether a type of message writes to a table. Queued writes are
+// limited by the server.
+//
+// type - The message type.
+//
+// Returns true if the message is a write.
+bool sky_worker_is_write(sky_message_type_e type)
+{
+    switch(type) {
+        case SKY_MESSAGE_TYPE_EADD:
+        case SKY_MESSAGE_TYPE_EBULK:
+        case SKY_MESSAGE_TYPE_AADD:
+        case SKY_MESSAGE_TYPE_PADD:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Checks whether the worker can queue another write. The count is read
+// while other threads may be queuing writes so the limit is approximate.
+//
+// worker - The worker.
+//
+// Returns true if fewer than the server's maximum number of writes are
+// waiting on the worker.
+bool sky_worker_accepts_write(sky_worker *worker)
+{
+    if(worker->server == NULL || worker->server->max_queued_writes == 0) {
+        return true;
+    }
+    return (__sync_add_and_fetch(&worker->queued_write_count, 0) < worker->server->max_queued_writes);
+}
+
+
+//--------------------------------------
+// Job Management
+//--------------------------------------
+
+// Adds a message to the worker's inbox. The worker takes ownership of the
+// header, the body and the trace. For messages that are not pipelined the worker also
+// takes ownership of the connection until the message has been processed.
+// Pipelined messages hold a reference to the connection instead. This can
+// be called from any thread and only locks the worker's mutex when the
+// worker is sleeping.
+//
+// worker     - The worker.
+// connection - The connection the message is being read from.
+// header     - The message header that has already been read.
+// body       - The body of a message that was read ahead or NULL.
+// trace      - The trace of the message or NULL if it is not traced.
+// reply      - How the response is returned to the connection.
+// index      - The position of a child message in its multi message.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_worker_enqueue(sky_worker *worker, sky_connection *connection,
+                       sky_message_header *header, sky_buffer *body,
+                       sky_trace *trace, sky_worker_reply_e reply,
+                       uint32_t index)
+{
+    check(worker != NULL, "Worker required");
+    check(connection != NULL, "Connection required");
+    check(header != NULL, "Message header required");
+
+    sky_worker_job *job = calloc(1, sizeof(sky_worker_job)); check_mem(job);
+    job->connection = connection;
+    job->header = header;
+    job->body = body;
+    job->trace = trace;
+    job->reply = reply;
+    job->index = index;
+    job->queue = sky_worker_get_queue(header->type);
+    job->write = sky_worker_is_write(header->type);
+
+    if(job->write) {
+        __sync_add_and_fetch(&worker->queued_write_count, 1);
+    }
+    sky_mpsc_queue_push(&worker->inbox, &job->node);
+
+    // The worker checks its inbox again after it marks itself as sleeping
+    // so it either sees the job or is woken up here.
+    __sync_synchronize();
+    if(worker->sleeping) {
+        pthread_mutex_lock(&worker->mutex);
+        pthread_cond_signal(&worker->cond);
+        pthread_mutex_unlock(&worker->mutex);
+    }
+
+    return 0;
+
+error:
+    return -1;
+}
+
+// Moves every job in the worker's inbox into its queues. The caller must be
+// the worker's thread or hold the worker's mutex.
+//
+// worker - The worker.
+void sky_worker_drain_inbox(sky_worker *worker)
+{
+    sky_mpsc_node *node;
+    while((node = sky_mpsc_queue_pop(&worker->inbox)) != NULL) {
+        sky_worker_job *job = (sky_worker_job*)node;
+        job->sequence = worker->next_sequence++;
+        if(worker->tails[job->queue]) {
+            worker->tails[job->queue]->next = job;
+        }
+        else {
+            worker->heads[job->queue] = job;
+        }
+        worker->tails[job->queue] = job;
+    }
+}
+
+// Removes the next job to process from the worker's queues after moving the
+// jobs in its inbox into them. The caller must hold the worker's mutex. High
+// priority jobs go first. A scan goes first when there are no high priority
+// jobs or when the worker has processed SKY_WORKER_MAX_HIGH_STREAK high
+// priority jobs in a row and the scan was queued before the next one. The
+// scan must also get one of the server's scan slots unless the queues are
+// being drained.
+//
+// worker - The worker.
+// drain  - Whether scans are started without a scan slot.
+//
+// Returns the next job or NULL if there is nothing that can be processed.
+sky_worker_job *sky_worker_dequeue(sky_worker *worker, bool drain)
+{
+    sky_worker_drain_inbox(worker);
+    sky_worker_job *high = worker->heads[SKY_WORKER_QUEUE_HIGH];
+    sky_worker_job *low = worker->heads[SKY_WORKER_QUEUE_LOW];
+
+    // Pick the queue.
+    sky_worker_queue_e queue = SKY_WORKER_QUEUE_HIGH;
+    bool scan_slot = false;
+    if(low != NULL && (high == NULL || (worker->high_streak >= SKY_WORKER_MAX_HIGH_STREAK && low->sequence < high->sequence))) {
+        if(drain) {
+            queue = SKY_WORKER_QUEUE_LOW;
+        }
+        else if(sky_server_acquire_scan(worker->server)) {
+            queue = SKY_WORKER_QUEUE_LOW;
+            scan_slot = true;
+        }
+    }
+
+    // Remove the job from its queue.
+    sky_worker_job *job = worker->heads[queue];
+    if(job == NULL) {
+        return NULL;
+    }
+    worker->heads[queue] = job->next;
+    if(worker->heads[queue] == NULL) worker->tails[queue] = NULL;
+    job->next = NULL;
+    job->scan_slot = scan_slot;
+    if(job->write) {
+        __sync_sub_and_fetch(&worker->queued_write_count, 1);
+    }
+    worker->high_streak = (queue == SKY_WORKER_QUEUE_HIGH ? worker->high_streak + 1 : 0);
+
+    return job;
+}
+
+// The main loop of the worker thread. Jobs are processed in priority order
+// until the worker is stopped. While a flush is scheduled the worker only
+// waits for new jobs until the flush deadline. A stopped worker drains its
+// queues without waiting for scan slots.
+//
+// arg - The worker.
+//
+// Returns NULL.
+void *sky_worker_run(void *arg)
+{
+    sky_worker *worker = (sky_worker*)arg;
+    sky_worker_place(worker);
+
+    while(true) {
+        // Wait for the next job or for the flush deadline.
+        pthread_mutex_lock(&worker->mutex);
+        sky_worker_job *job = NULL;
+        while(worker->running && (job = sky_worker_dequeue(worker, false)) == NULL) {
+            // Check the inbox once more after going to sleep so that a job
+            // pushed in between is not missed.
+            worker->sleeping = true;
+            __sync_synchronize();
+            if((job = sky_worker_dequeue(worker, false)) != NULL) {
+                worker->sleeping = false;
+                break;
+            }
+
+            int rc = 0;
+            int64_t deadline = worker->flush_deadline;
+            if(worker->compress_deadline > 0 && (deadline == 0 || worker->compress_deadline < deadline)) {
+                deadline = worker->compress_deadline;
+            }
+            if(worker->expire_deadline > 0 && (deadline == 0 || worker->expire_deadline < deadline)) {
+                deadline = worker->expire_deadline;
+            }
+            if(worker->memory_deadline > 0 && (deadline == 0 || worker->memory_deadline < deadline)) {
+                deadline = worker->memory_deadline;
+            }
+            if(deadline > 0) {
+                struct timespec ts;
+                ts.tv_sec = (time_t)(deadline / 1000000);
+                ts.tv_nsec = (long)(deadline % 1000000) * 1000;
+                rc = pthread_cond_timedwait(&worker->cond, &worker->mutex, &ts);
+            }
+            else {
+                pthread_cond_wait(&worker->cond, &worker->mutex);
+            }
+            worker->sleeping = false;
+            if(rc == ETIMEDOUT) {
+                break;
+            }
+        }
+        if(job == NULL && !worker->running) {
+            job = sky_worker_dequeue(worker, true);
+        }
+        bool running = worker->running;
+        pthread_mutex_unlock(&worker->mutex);
+
+        if(job != NULL) {
+            sky_worker_process_job(worker, job);
+        }
+
+        // Sync outstanding changes once they are due and before exiting.
+        if(!running || sky_worker_flush_due(worker)) {
+            sky_worker_commit(worker);
+        }
+
+        // Compress idle blocks, drop expired blocks and measure memory once
+        // they are due.
+        if(running) {
+            sky_worker_compress(worker);
+            sky_worker_expire(worker);
+            sky_worker_account_memory(worker);
+        }
+
+        // Exit once the worker is stopped and the queue is drained.
+        if(job == NULL && !running) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+// Places the worker's thread on its NUMA node or interleaves its memory
+// across the nodes. Failures are logged and the worker runs unplaced.
+//
+// worker - The worker.
+void sky_worker_place(sky_worker *worker)
+{
+    sky_server *server = worker->server;
+    if(server == NULL || server->numa == NULL) {
+        return;
+    }
+
+    if(worker->numa_node != NULL) {
+        if(sky_numa_bind_thread(server->numa, worker->numa_node) != 0) {
+            log_warn("Unable to place worker %d on NUMA node %d", worker->index, worker->numa_node->id);
+        }
+    }
+    else if(server->numa_placement == SKY_NUMA_PLACEMENT_INTERLEAVE) {
+        if(sky_numa_interleave_thread(server->numa) != 0) {
+            log_warn("Unable to interleave memory of worker %d", worker->index);
+        }
+    }
+}
+
+// Processes a single queued message and hands the connection back to the
+// server so that the next message can be dispatched. The connection is
+// closed if the message fails since the stream position is unknown.
+//
+// worker - The worker.
+// job    - The job to process.
+void sky_worker_process_job(sky_worker *worker, sky_worker_job *job)
+{
+    int rc;
+    sky_table *table = NULL;
+    sky_server *server = worker->server;
+    sky_connection *connection = job->connection;
+    sky_message_header *header = job->header;
+    sky_worker_reply_e reply = job->reply;
+    uint32_t index = job->index;
+    sky_buffer *body = job->body;
+    sky_trace *trace = job->trace;
+    bool scan_slot = job->scan_slot;
+    FILE *input = connection->input;
+    free(job);
+    sky_trace_mark(trace, SKY_TRACE_SPAN_QUEUE);
+
+    // Messages that were read ahead are read from their body.
+    if(body != NULL) {
+        input = fmemopen(body->data, body->length, "r");
+        check(input != NULL, "Unable to open message body");
+    }
+
+    // Open table. Stats messages do not target a table and coordinating
+    // workers do not store tables.
+    bool coordinated = (worker->coordinator != NULL && header->type != SKY_MESSAGE_TYPE_STATS);
+    check(worker->replica == NULL || sky_replica_accepts_message(header->type), "Replica cannot process message: %s", bdata(header->name));
+    if(header->type != SKY_MESSAGE_TYPE_STATS && !coordinated) {
+        rc = sky_worker_open_table(worker, header->database_name, header->table_name, &table);
+        check(rc == 0, "Unable to open table");
+    }
+
+    // Replicas only serve reads and bring the table up to date first.
+    if(worker->replica != NULL && table != NULL) {
+        rc = sky_replica_sync(worker->replica, header, table, false);
+        check(rc == 0, "Unable to sync table from primary");
+    }
+    sky_trace_mark(trace, SKY_TRACE_SPAN_TABLE);
+
+    // Pipelined responses are prefixed with the request id.
+    sky_buffer_clear(worker->output);
+    if(header->pipelined) {
+        check(sky_buffer_pack_array(worker->output, 2) == 0, "Unable to write response array");
+        check(sky_buffer_pack_uint(worker->output, header->request_id) == 0, "Unable to write request id");
+    }
+
+    // Frames of a streamed response are sent as soon as they are written if
+    // the response does not share the connection with other responses and
+    // does not have to wait for a group commit.
+    bool held = (table != NULL && table->durability == SKY_DURABILITY_GROUP && sky_table_get_unflushed_event_count(table) > 0);
+    if(reply == SKY_WORKER_REPLY_DISPATCH && !header->pipelined && !coordinated && !held) {
+        worker->output->flush = sky_worker_stream_output;
+        worker->output->flush_data = connection;
+    }
+
+    // Process message. Temporary memory from the message is released as soon
+    // as it has been processed.
+    int64_t t0 = sky_stats_now();
+    sky_trace_current = trace;
+    if(coordinated) {
+        rc = sky_coordinator_process_message(worker->coordinator, header, input, worker->output);
+    }
+    else {
+        rc = sky_server_process_message(server, table, header, worker->arena, input, worker->output);
+    }
+    sky_trace_current = NULL;
+    sky_trace_mark(trace, SKY_TRACE_SPAN_EXECUTE);
+    sky_stats_record(&sky_stats_global.messages[header->type], sky_stats_now() - t0);
+    worker->output->flush = NULL;
+    worker->output->flush_data = NULL;
+    if(scan_slot) sky_server_release_scan(server);
+    scan_slot = false;
+    sky_arena_reset(worker->arena);
+    if(table != NULL) sky_table_release_cache(table);
+    check(rc == 0, "Unable to process message: %s", bdata(header->name));
+
+    // The body of a message that was not read ahead is still in the
+    // connection's frame after its header.
+    if(trace != NULL) {
+        if(body != NULL) {
+            sky_tracer_capture_body(server->tracer, trace, body->data, body->length);
+        }
+        else if(connection->frame_length > trace->body_offset) {
+            sky_tracer_capture_body(server->tracer, trace, connection->pending->data + trace->body_offset, connection->frame_length - trace->body_offset);
+        }
+        trace->response_length = worker->output->length;
+    }
+
+    sky_message_header_free(header);
+    header = NULL;
+    if(body != NULL) fclose(input);
+    input = NULL;
+    sky_buffer_free(body);
+    body = NULL;
+
+    // Hold the response until the next group commit if the table has changes
+    // that have not been synced yet.
+    uint32_t unflushed_event_count = (table != NULL ? sky_table_get_unflushed_event_count(table) : 0);
+    if(unflushed_event_count > 0 && table->durability == SKY_DURABILITY_GROUP) {
+        rc = sky_worker_hold(worker, connection, trace, reply, index);
+        check(rc == 0, "Unable to hold response");
+        trace = NULL;
+        sky_worker_schedule_flush(worker, server->group_commit_interval);
+
+        if(unflushed_event_count >= server->group_commit_events) {
+            sky_worker_commit(worker);
+        }
+        return;
+    }
+    else if(unflushed_event_count > 0) {
+        sky_worker_schedule_flush(worker, server->async_flush_interval);
+    }
+
+    sky_worker_respond(worker, connection, worker->output, reply, index, true);
+    sky_trace_mark(trace, SKY_TRACE_SPAN_WRITE);
+    sky_tracer_finish(server->tracer, trace);
+    return;
+
+error:
+    sky_trace_current = NULL;
+    if(scan_slot) sky_server_release_scan(server);
+    sky_message_header_free(header);
+    if(body != NULL && input != NULL) fclose(input);
+    sky_buffer_free(body);
+    sky_worker_respond(worker, connection, NULL, reply, index, false);
+    if(trace != NULL) {
+        trace->failed = true;
+        sky_trace_mark(trace, SKY_TRACE_SPAN_WRITE);
+        sky_tracer_finish(server->tracer, trace);
+    }
+}
+
+// Sends a response to a connection. The connection of a message that is
+// not pipelined is then handed back to the server to dispatch its next
+// message and the reference held by a pipelined message is released. The
+// responses of child messages are passed to the server to be assembled in
+// order. The connection is closed if the message failed.
+//
+// worker     - The worker.
+// connection - The connection.
+// response   - The response to write.
+// reply      - How the response is returned to the connection.
+// index      - The position of a child message in its multi message.
+// success    - Whether the message was processed successfully.
+void sky_worker_respond(sky_worker *worker, sky_connection *connection,
+                        sky_buffer *response, sky_worker_reply_e reply,
+                        uint32_t index, bool success)
+{
+    sky_server *server = worker->server;
+
+    if(reply == SKY_WORKER_REPLY_PIPELINED) {
+        if(!success || sky_connection_write(connection, response, true) != 0) {
+            sky_connection_shutdown(connection);
+        }
+        sky_server_release_connection(server, connection);
+    }
+    else if(reply == SKY_WORKER_REPLY_MULTI) {
+        sky_server_complete_multi_child(server, connection, index, (success ? response : NULL));
+    }
+    else {
+        if(success && sky_connection_write(connection, response, false) == 0) {
+            sky_server_dispatch(server, connection);
+        }
+        else {
+            sky_server_close_connection(server, connection);
+        }
+    }
+}
+
+
+// Sends the frames that a streamed response has written so far to its
+// connection. This is the flush function of the worker's output buffer
+// while a message is processed.
+//
+// buffer - The output buffer.
+// data   - The connection.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_worker_stream_output(sky_buffer *buffer, void *data)
+{
+    sky_connection *connection = data;
+    int rc = sky_connection_write(connection, buffer, true);
+    check(rc == 0, "Unable to stream response");
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Durability
+//--------------------------------------
+
+// Holds the response in the worker's output buffer until the next group
+// commit. The held response takes over the output buffer.
+//
+// worker     - The worker.
+// connection - The connection whose response is waiting on the commit.
+// trace      - The trace of the message. The held response takes it over.
+// reply      - How the response is returned to the connection.
+// index      - The position of a child message in its multi message.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_worker_hold(sky_worker *worker, sky_connection *connection,
+                    sky_trace *trace, sky_worker_reply_e reply,
+                    uint32_t index)
+{
+    sky_buffer *output = sky_buffer_create(); check_mem(output);
+    worker->pending = realloc(worker->pending, sizeof(*worker->pending) * (worker->pending_count+1));
+    check_mem(worker->pending);
+
+    sky_worker_response *response = &worker->pending[worker->pending_count++];
+    response->connection = connection;
+    response->buffer = worker->output;
+    response->trace = trace;
+    response->reply = reply;
+    response->index = index;
+    worker->output = output;
+    return 0;
+
+error:
+    sky_buffer_free(output);
+    return -1;
+}
+
+// Schedules a flush of the worker's tables. A flush that is already
+// scheduled earlier than the interval is left as is.
+//
+// worker   - The worker.
+// interval - The number of milliseconds until the flush.
+void sky_worker_schedule_flush(sky_worker *worker, uint32_t interval)
+{
+    sky_timestamp_t now = 0;
+    sky_timestamp_now(&now);
+
+    int64_t deadline = now + ((int64_t)interval * 1000);
+    if(worker->flush_deadline == 0 || deadline < worker->flush_deadline) {
+        worker->flush_deadline = deadline;
+    }
+}
+
+// Checks whether a scheduled flush has reached its deadline.
+//
+// worker - The worker.
+//
+// Returns true if the worker's tables should be flushed.
+bool sky_worker_flush_due(sky_worker *worker)
+{
+    if(worker->flush_deadline == 0) {
+        return false;
+    }
+
+    sky_timestamp_t now = 0;
+    sky_timestamp_now(&now);
+    return (now >= worker->flush_deadline);
+}
+
+// Compresses idle blocks on each of the worker's tables if compression is
+// turned on and the compression interval has passed since the last pass.
+// The next pass is scheduled afterward.
+//
+// worker - The worker.
+void sky_worker_compress(sky_worker *worker)
+{
+    uint32_t i;
+    sky_server *server = worker->server;
+    if(server->compress_after == 0) {
+        return;
+    }
+
+    sky_timestamp_t now = 0;
+    sky_timestamp_now(&now);
+    if(worker->compress_deadline > 0 && now >= worker->compress_deadline) {
+        sky_table_cache *cache = worker->table_cache;
+        for(i=0; i<cache->table_count; i++) {
+            if(sky_table_compress(cache->tables[i], server->compress_after, SKY_DEFAULT_COMPRESS_BLOCK_COUNT, NULL) != 0) {
+                debug("Unable to compress table: %s", bdata(cache->tables[i]->path));
+            }
+        }
+        worker->compress_deadline = 0;
+    }
+    if(worker->compress_deadline == 0) {
+        worker->compress_deadline = now + ((int64_t)SKY_DEFAULT_COMPRESS_INTERVAL * 1000);
+    }
+}
+
+// Drops the expired blocks of each of the worker's tables if a retention is
+// set and the expiry interval has passed since the last pass. The next pass
+// is scheduled afterward. Replicas receive the cleared blocks from their
+// primary instead.
+//
+// worker - The worker.
+void sky_worker_expire(sky_worker *worker)
+{
+    uint32_t i;
+    sky_server *server = worker->server;
+    if(server->retention == 0 || server->primary != NULL) {
+        return;
+    }
+
+    sky_timestamp_t now = 0;
+    sky_timestamp_now(&now);
+    if(worker->expire_deadline > 0 && now >= worker->expire_deadline) {
+        sky_table_cache *cache = worker->table_cache;
+        for(i=0; i<cache->table_count; i++) {
+            if(sky_table_expire(cache->tables[i], NULL) != 0) {
+                debug("Unable to expire table: %s", bdata(cache->tables[i]->path));
+            }
+        }
+        worker->expire_deadline = 0;
+    }
+    if(worker->expire_deadline == 0) {
+        worker->expire_deadline = now + ((int64_t)SKY_DEFAULT_EXPIRE_INTERVAL * 1000);
+    }
+}
+
+// Measures the memory used by each of the worker's tables once the memory
+// interval has passed since the last measurement. The measurements replace
+// the worker's previous ones under its mutex so that the server can copy
+// them while the worker keeps running. Tables are named by their path
+// under the server's data directory. The next measurement is scheduled
+// afterward.
+//
+// worker - The worker.
+void sky_worker_account_memory(sky_worker *worker)
+{
+    uint32_t i;
+    sky_server *server = worker->server;
+
+    sky_timestamp_t now = 0;
+    sky_timestamp_now(&now);
+    if(worker->memory_deadline > 0 && now >= worker->memory_deadline) {
+        sky_table_cache *cache = worker->table_cache;
+        uint32_t count = 0;
+        sky_table_memory *tables = NULL;
+        if(cache->table_count > 0) {
+            tables = calloc(cache->table_count, sizeof(*tables));
+        }
+        if(tables != NULL) {
+            for(i=0; i<cache->table_count; i++) {
+                sky_table *table = cache->tables[i];
+                if(sky_table_get_memory(table, &tables[count]) != 0) {
+                    debug("Unable to measure table memory: %s", bdata(table->path));
+                    continue;
+                }
+                int offset = blength(server->path);
+                if(offset > 0 && binstr(table->path, 0, server->path) == 0 && blength(table->path) > offset) {
+                    offset += (bchar(table->path, offset) == '/' ? 1 : 0);
+                    tables[count].name = bmidstr(table->path, offset, blength(table->path) - offset);
+                }
+                else {
+                    tables[count].name = bstrcpy(table->path);
+                }
+                count++;
+            }
+        }
+
+        pthread_mutex_lock(&worker->mutex);
+        sky_table_memory *previous = worker->table_memory;
+        uint32_t previous_count = worker->table_memory_count;
+        worker->table_memory = tables;
+        worker->table_memory_count = count;
+        pthread_mutex_unlock(&worker->mutex);
+
+        for(i=0; i<previous_count; i++) {
+            sky_table_memory_free(&previous[i]);
+        }
+        free(previous);
+        worker->memory_deadline = 0;
+    }
+    if(worker->memory_deadline == 0) {
+        worker->memory_deadline = now + ((int64_t)SKY_DEFAULT_MEMORY_INTERVAL * 1000);
+    }
+}
+
+// Syncs the changes on all tables in the worker's cache and then sends the
+// responses that were held for the commit. If the sync fails then the
+// connections of the held responses are closed since their writes may not
+// be durable.
+//
+// worker - The worker.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_worker_commit(sky_worker *worker)
+{
+    int rc;
+    uint32_t i;
+    bool success = true;
+    check(worker != NULL, "Worker required");
+
+    worker->flush_deadline = 0;
+
+    // Flush tables.
+    sky_table_cache *cache = worker->table_cache;
+    for(i=0; i<cache->table_count; i++) {
+        rc = sky_table_flush(cache->tables[i]);
+        if(rc != 0) {
+            debug("Unable to flush table: %s", bdata(cache->tables[i]->path));
+            success = false;
+        }
+    }
+
+    // Send held responses.
+    for(i=0; i<worker->pending_count; i++) {
+        sky_worker_response *response = &worker->pending[i];
+        sky_trace_mark(response->trace, SKY_TRACE_SPAN_COMMIT);
+        sky_worker_respond(worker, response->connection, response->buffer, response->reply, response->index, success);
+        sky_buffer_free(response->buffer);
+        if(response->trace != NULL) {
+            response->trace->failed = !success;
+            sky_trace_mark(response->trace, SKY_TRACE_SPAN_WRITE);
+            sky_tracer_finish(worker->server->tracer, response->trace);
+            response->trace = NULL;
+        }
+    }
+    worker->pending_count = 0;
+
+    check(success, "Unable to commit worker tables");
+    return 0;
+
+error:
+    return -1;
+}
+
+
+//--------------------------------------
+// Table Management
+//--------------------------------------
+
+// Opens a table owned by the worker. Tables are kept open in the worker's
+// table cache between messages. The table path is built in a buffer that is
+// reused for every message.
+//
+// worker        - The worker that is opening the table.
+// database_name - The name of the database to open.
+// table_name    - The name of the table to open.
+// table         - Returns the instance of the table to the caller.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_worker_open_table(sky_worker *worker, bstring database_name,
+                          bstring table_name, sky_table **table)
+{
+    int rc;
+    bstring path = NULL;
+    check(worker != NULL, "Worker required");
+    check(blength(database_name) > 0, "Database name required");
+    check(blength(table_name) > 0, "Table name required");
+
+    // Determine the path to the table.
+    path = worker->table_path;
+    rc = bassignformat(path, "%s/%s/%s", bdata(worker->server->path), bdata(database_name), bdata(table_name));
+    check(rc == BSTR_OK, "Unable to build table path");
+
+    // Commit before opening an uncached table since opening it may close a
+    // table with changes that held responses are waiting on.
+    if(worker->pending_count > 0 && sky_table_cache_find(worker->table_cache, path) == NULL) {
+        rc = sky_worker_commit(worker);
+        check(rc == 0, "Unable to commit before opening table");
+    }
+
+    // Retrieve the table from the cache.
+    rc = sky_table_cache_open(worker->table_cache, path, table);
+    check(rc == 0, "Unable to open table: %s", bdata(path));
+
+    // Apply the server's durability mode.
+    if((*table)->durability != worker->server->durability) {
+        rc = sky_table_set_durability(*table, worker->server->durability);
+        check(rc == 0, "Unable to set table durability");
+    }
+
+    // Apply the server's write buffering.
+    if((*table)->memtable_size != worker->server->memtable_size) {
+        rc = sky_table_set_memtable_size(*table, worker->server->memtable_size);
+        check(rc == 0, "Unable to set table memtable size");
+    }
+
+    // Apply the server's reorder window.
+    if((*table)->reorder_window != worker->server->reorder_window) {
+        rc = sky_table_set_reorder_window(*table, worker->server->reorder_window);
+        check(rc == 0, "Unable to set table reorder window");
+    }
+
+    // Apply the server's block cache size.
+    if((*table)->block_cache_size != worker->server->block_cache_size) {
+        rc = sky_table_set_block_cache_size(*table, worker->server->block_cache_size);
+        check(rc == 0, "Unable to set table block cache size");
+    }
+
+    // Read blocks ahead of scans on the server's I/O threads.
+    if((*table)->prefetcher != worker->server->prefetcher) {
+        rc = sky_table_set_prefetcher(*table, worker->server->prefetcher);
+        check(rc == 0, "Unable to set table prefetcher");
+    }
+
+    // Apply the server's retention.
+    if((*table)->retention != worker->server->retention) {
+        rc = sky_table_set_retention(*table, worker->server->retention);
+        check(rc == 0, "Unable to set table retention");
+    }
+
+    // Apply the server's result cache size.
+    if((*table)->result_cache_size != worker->server->result_cache_size) {
+        rc = sky_table_set_result_cache_size(*table, worker->server->result_cache_size);
+        check(rc == 0, "Unable to set table result cache size");
+    }
+
+    // Apply the server's mapping options.
+    if((*table)->preload != worker->server->preload) {
+        rc = sky_table_set_preload(*table, worker->server->preload);
+        check(rc == 0, "Unable to set table preloading");
+    }
+    if((*table)->huge_pages != worker->server->huge_pages) {
+        rc = sky_table_set_huge_pages(*table, worker->server->huge_pages);
+        check(rc == 0, "Unable to set table huge pages");
+    }
+
+    return 0;
+
+error:
+    *table = NULL;
+    return -1;
+}
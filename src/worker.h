@@ -0,0 +1,273 @@
+#ifndef _worker_h
+#define _worker_h
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef struct sky_worker sky_worker;
+typedef struct sky_worker_job sky_worker_job;
+typedef struct sky_worker_response sky_worker_response;
+
+#include "bstring.h"
+#include "table.h"
+#include "table_cache.h"
+#include "message_header.h"
+#include "server.h"
+#include "arena.h"
+#include "buffer.h"
+#include "coordinator.h"
+#include "replica.h"
+#include "numa.h"
+#include "mpsc_queue.h"
+#include "trace.h"
+
+
+//==============================================================================
+//
+// Overview
+//
+//==============================================================================
+
+// A worker is a thread that processes messages on behalf of the server. Each
+// table is owned by exactly one worker, which is determined by hashing the
+// database and table name. Because only the owning worker ever opens or
+// modifies a table, tables do not need any locking and messages for
+// different tables are processed in parallel on different cores.
+//
+// The server's event loop reads the header of each message and then hands
+// the connection to the owning worker as a job. The worker reads the rest of
+// the message, writes the response and then returns the connection to the
+// server so that the next message can be dispatched. The body of a pipelined
+// message has already been read by the event loop, so the worker reads it
+// from memory and sends the response without returning the connection. The
+// child messages of a multi message are also read ahead so that they can be
+// processed on several workers at once. The worker that finishes the last
+// child returns the connection.
+//
+// Jobs are handed to a worker through a lock-free inbox so that the event
+// loop and the workers finishing multi children never contend on the
+// worker's mutex while the worker is busy. The worker moves everything in
+// its inbox into its queues in one batch before it picks a job, so a burst
+// of writes from many connections is picked up at once and applied back to
+// back, and group commit then syncs them together. The mutex is only taken
+// to wake a worker that is sleeping.
+//
+// Each worker has two queues. Scans (next_action, query, funnel, dag,
+// compact, snapshot and emget messages) wait in the low priority queue so
+// that writes and point lookups are never stuck behind a long scan. A queued scan is still started
+// once the worker has processed a run of high priority jobs that were queued
+// after it, so a steady flood of writes cannot starve it. The number of
+// scans that run at once across all workers can be limited as well. A scan
+// waits in its queue until one of the server's scan slots is free while the
+// worker carries on with its other jobs.
+//
+// Writes (eadd, ebulk, aadd and padd messages) are counted while they wait.
+// Once too many writes are waiting on a worker, the server answers new
+// writes for its tables with {status:"slow down"} instead of queuing them
+// so that a client that writes faster than the tables can be flushed does
+// not exhaust the server's memory. Clients should back off and retry.
+//
+// Responses are packed into the worker's output buffer and then copied to
+// the connection so that responses from different workers never interleave.
+// Streamed responses are the exception when the worker has the connection
+// to itself. Each frame is copied to the connection and sent as soon as it
+// is flushed so that the buffer only ever holds one frame. Pipelined
+// messages, child messages, coordinated messages and responses that wait
+// for a group commit collect their frames in the buffer instead.
+//
+// With local NUMA placement, each worker is placed on a node when its thread
+// starts. The pages of the tables that it maps and the memory that it
+// allocates then come from that node and the scan threads of its queries
+// run on the same node. With interleaved placement the worker's pages are
+// spread across every node instead. A worker that cannot be placed logs a
+// warning and runs unplaced.
+//
+// Each worker keeps its own cache of open tables so that a worker never
+// touches another worker's tables. Each worker also has its own arena for
+// the temporary memory of the message it is processing. The arena is reset
+// after every message so steady state processing does not contend on the
+// allocator.
+//
+// Because workers own their tables they also own their durability. In group
+// commit mode, the responses to writes are held by the worker until the
+// worker syncs its tables. This happens once enough events have
+// accumulated, once the group commit interval has passed, before the worker
+// opens another table or when the worker stops. The connections then receive
+// their responses. In async mode the worker flushes its tables on an
+// interval instead of on every write.
+//
+// Tables that buffer writes in a memtable are merged by their worker in the
+// background. The merge happens when the table is flushed, so the worker
+// also schedules a flush on the async interval when a table only has
+// buffered events.
+//
+// If idle blocks are compressed, the worker also wakes up on the compression
+// interval and compresses a few idle blocks of each of its tables. The
+// decompressed blocks that were read while processing a message are
+// released once the message has been processed. Tables with a retention
+// are expired on a longer interval in the same way.
+//
+// The workers of a coordinating server do not open tables. Each worker has
+// its own coordinator with its own connections to the shard nodes and
+// routes the table messages it is given through it. Stats messages are
+// still answered locally.
+//
+// The workers of a replica server each have their own replica with its own
+// connection to the primary. A table is synced before the worker serves a
+// message for it once its last sync is older than the replication interval,
+// and messages that would change the table are rejected.
+
+
+//==============================================================================
+//
+// Definitions
+//
+//==============================================================================
+
+// The number of job queues of a worker.
+#define SKY_WORKER_QUEUE_COUNT 2
+
+// The number of high priority jobs queued after a scan that may be processed
+// before the scan is started.
+#define SKY_WORKER_MAX_HIGH_STREAK 64
+
+
+//==============================================================================
+//
+// Typedefs
+//
+//==============================================================================
+
+// The queues of a worker. Scans wait in the low priority queue.
+typedef enum sky_worker_queue_e {
+    SKY_WORKER_QUEUE_HIGH,
+    SKY_WORKER_QUEUE_LOW,
+} sky_worker_queue_e;
+
+// How the response to a message is returned to its connection. The index is
+// the position of a child message within its multi message.
+typedef enum sky_worker_reply_e {
+    SKY_WORKER_REPLY_DISPATCH,
+    SKY_WORKER_REPLY_PIPELINED,
+    SKY_WORKER_REPLY_MULTI,
+} sky_worker_reply_e;
+
+// A message waiting to be processed by a worker. The body is only set for
+// messages that were read ahead by the event loop. The node links the job
+// into the worker's inbox and must stay the first member. The sequence is
+// the order the job was moved out of the inbox in across both queues. Scans that were started
+// with one of the server's scan slots release it once they are processed.
+struct sky_worker_job {
+    sky_mpsc_node node;
+    sky_connection *connection;
+    sky_message_header *header;
+    sky_buffer *body;
+    sky_trace *trace;
+    sky_worker_reply_e reply;
+    uint32_t index;
+    sky_worker_queue_e queue;
+    bool write;
+    bool scan_slot;
+    uint64_t sequence;
+    sky_worker_job *next;
+};
+
+// A response that is held until the next group commit.
+struct sky_worker_response {
+    sky_connection *connection;
+    sky_buffer *buffer;
+    sky_trace *trace;
+    sky_worker_reply_e reply;
+    uint32_t index;
+};
+
+struct sky_worker {
+    sky_server *server;
+    uint32_t index;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool running;
+    volatile bool sleeping;
+    sky_mpsc_queue inbox;
+    sky_worker_job *heads[SKY_WORKER_QUEUE_COUNT];
+    sky_worker_job *tails[SKY_WORKER_QUEUE_COUNT];
+    uint64_t next_sequence;
+    uint32_t queued_write_count;
+    uint32_t high_streak;
+    sky_table_cache *table_cache;
+    bstring table_path;
+    sky_arena *arena;
+    sky_buffer *output;
+    sky_worker_response *pending;
+    uint32_t pending_count;
+    int64_t flush_deadline;
+    int64_t compress_deadline;
+    int64_t expire_deadline;
+    sky_table_memory *table_memory;
+    uint32_t table_memory_count;
+    int64_t memory_deadline;
+    sky_coordinator *coordinator;
+    sky_replica *replica;
+    sky_numa_node *numa_node;
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+//--------------------------------------
+// Lifecycle
+//--------------------------------------
+
+sky_worker *sky_worker_create(sky_server *server, uint32_t index,
+    uint32_t max_tables, size_t max_mapped_bytes);
+
+void sky_worker_free(sky_worker *worker);
+
+//--------------------------------------
+// State
+//--------------------------------------
+
+int sky_worker_start(sky_worker *worker);
+
+int sky_worker_stop(sky_worker *worker);
+
+//--------------------------------------
+// Admission
+//--------------------------------------
+
+sky_worker_queue_e sky_worker_get_queue(sky_message_type_e type);
+
+bool sky_worker_is_write(sky_message_type_e type);
+
+bool sky_worker_accepts_write(sky_worker *worker);
+
+//--------------------------------------
+// Job Management
+//--------------------------------------
+
+int sky_worker_enqueue(sky_worker *worker, sky_connection *connection,
+    sky_message_header *header, sky_buffer *body, sky_trace *trace,
+    sky_worker_reply_e reply, uint32_t index);
+
+sky_worker_job *sky_worker_dequeue(sky_worker *worker, bool drain);
+
+//--------------------------------------
+// Durability
+//--------------------------------------
+
+int sky_worker_commit(sky_worker *worker);
+
+//--------------------------------------
+// Table Management
+//--------------------------------------
+
+int sky_worker_open_table(sky_worker *worker, bstring database_name,
+    bstring table_name, sky_table **table);
+
+#endif
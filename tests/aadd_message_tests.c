@@ -55,9 +55,10 @@ int test_sky_aadd_message_process() {
     sky_aadd_message *message = sky_aadd_message_create();
     message->action->name = bfromcstr("foo");
 
-    FILE *output = fopen("tmp/output", "w");
+    sky_buffer *output = sky_buffer_create();
     mu_assert(sky_aadd_message_process(message, table, output) == 0, "");
-    fclose(output);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
     mu_assert_file("tmp/actions", "tests/fixtures/aadd_message/1/table/actions");
     mu_assert_file("tmp/output", "tests/fixtures/aadd_message/1/output");
 
@@ -67,6 +68,61 @@ int test_sky_aadd_message_process() {
 }
 
 
+int test_sky_aadd_message_process_batch() {
+    uint32_t i;
+    cleantmp();
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    sky_table_open(table);
+
+    // Pack a batch and read it back.
+    char *names[] = {"foo", "bar", "baz"};
+    sky_aadd_message *message = sky_aadd_message_create();
+    message->actions = calloc(3, sizeof(*message->actions));
+    message->action_count = 3;
+    for(i=0; i<3; i++) {
+        message->actions[i] = sky_action_create();
+        message->actions[i]->name = bfromcstr(names[i]);
+    }
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_aadd_message_pack(message, file), 0);
+    fclose(file);
+    sky_aadd_message_free(message);
+
+    message = sky_aadd_message_create();
+    file = fopen("tmp/message", "r");
+    mu_assert_int_equals(sky_aadd_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_int_equals(message->action_count, 3);
+
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_aadd_message_process(message, table, output), 0);
+    sky_buffer_free(output);
+    mu_assert_int_equals(table->action_file->action_count, 3);
+    for(i=0; i<3; i++) {
+        mu_assert_bstring(table->action_file->actions[i]->name, names[i]);
+    }
+    sky_aadd_message_free(message);
+
+    // A batch with a name that is already defined adds nothing.
+    message = sky_aadd_message_create();
+    message->actions = calloc(2, sizeof(*message->actions));
+    message->action_count = 2;
+    for(i=0; i<2; i++) {
+        message->actions[i] = sky_action_create();
+        message->actions[i]->name = bfromcstr(i == 0 ? "qux" : "foo");
+    }
+    output = sky_buffer_create();
+    mu_assert_int_equals(sky_aadd_message_process(message, table, output), -1);
+    sky_buffer_free(output);
+    mu_assert_int_equals(table->action_file->action_count, 3);
+
+    sky_aadd_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
 //==============================================================================
 //
 // Setup
@@ -77,6 +133,7 @@ int all_tests() {
     mu_run_test(test_sky_aadd_message_pack);
     mu_run_test(test_sky_aadd_message_unpack);
     mu_run_test(test_sky_aadd_message_process);
+    mu_run_test(test_sky_aadd_message_process_batch);
     return 0;
 }
 
@@ -52,9 +52,10 @@ int test_sky_aall_message_process() {
     
     sky_aall_message *message = sky_aall_message_create();
 
-    FILE *output = fopen("tmp/output", "w");
+    sky_buffer *output = sky_buffer_create();
     mu_assert(sky_aall_message_process(message, table, output) == 0, "");
-    fclose(output);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
     mu_assert_file("tmp/actions", "tests/fixtures/aall_message/1/table/actions");
     mu_assert_file("tmp/output", "tests/fixtures/aall_message/1/output");
 
@@ -74,6 +74,54 @@ int test_sky_action_file_save() {
 }
 
 
+int test_sky_action_file_save_appends() {
+    int rc;
+    uint32_t i;
+    cleantmp();
+    struct tagbstring path = bsStatic("tmp/actions");
+    sky_action_file *action_file = sky_action_file_create();
+    sky_action_file_set_path(action_file, &path);
+
+    // Save a snapshot of two actions and then append to it.
+    char *names[] = {"a0", "a1", "a2", "a3", "a4"};
+    for(i=0; i<5; i++) {
+        sky_action *action = sky_action_create();
+        action->name = bfromcstr(names[i]);
+        rc = sky_action_file_add_action(action_file, action);
+        mu_assert_int_equals(rc, 0);
+        if(i == 0) continue;
+        rc = sky_action_file_save(action_file);
+        mu_assert_int_equals(rc, 0);
+        mu_assert_int_equals(action_file->saved_count, i+1);
+
+        // The file is rewritten once the appended actions outnumber the
+        // snapshot.
+        if(i == 1) mu_assert_int_equals(action_file->snapshot_count, 2);
+        if(i == 3) mu_assert_int_equals(action_file->snapshot_count, 2);
+        if(i == 4) mu_assert_int_equals(action_file->snapshot_count, 5);
+    }
+    sky_action_file_free(action_file);
+
+    // Reload the appended actions.
+    action_file = sky_action_file_create();
+    sky_action_file_set_path(action_file, &path);
+    sky_action *action = sky_action_create();
+    action->name = bfromcstr("a5");
+    mu_assert_int_equals(sky_action_file_load(action_file), 0);
+    mu_assert_int_equals(sky_action_file_add_action(action_file, action), 0);
+    mu_assert_int_equals(sky_action_file_save(action_file), 0);
+    mu_assert_int_equals(sky_action_file_load(action_file), 0);
+    mu_assert_int_equals(action_file->action_count, 6);
+    mu_assert_int_equals(action_file->snapshot_count, 5);
+    for(i=0; i<6; i++) {
+        mu_assert_int_equals(action_file->actions[i]->id, i+1);
+    }
+    mu_assert_bstring(action_file->actions[5]->name, "a5");
+    sky_action_file_free(action_file);
+    return 0;
+}
+
+
 //--------------------------------------
 // Load
 //--------------------------------------
@@ -91,6 +139,19 @@ int test_sky_action_file_load() {
     // Assert actions.
     mu_assert_int_equals(action_file->action_count, 2);
 
+    // Assert lookups.
+    sky_action *action;
+    struct tagbstring name = bsStatic("this_is_a_really_long_action_name_woohoo");
+    struct tagbstring missing = bsStatic("bar");
+    sky_action_file_find_action_by_name(action_file, &name, &action);
+    mu_assert_bool(action != NULL && action->id == 2);
+    sky_action_file_find_action_by_name(action_file, &missing, &action);
+    mu_assert_bool(action == NULL);
+    sky_action_file_find_action_by_id(action_file, 1, &action);
+    mu_assert_bool(action != NULL && biseqcstr(action->name, "foo") == 1);
+    sky_action_file_find_action_by_id(action_file, 3, &action);
+    mu_assert_bool(action == NULL);
+
     sky_action_file_free(action_file);
     return 0;
 }
@@ -105,6 +166,7 @@ int test_sky_action_file_load() {
 int all_tests() {
     mu_run_test(test_sky_action_file_path);
     mu_run_test(test_sky_action_file_save);
+    mu_run_test(test_sky_action_file_save_appends);
     mu_run_test(test_sky_action_file_load);
     return 0;
 }
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <table.h>
+#include <action_index.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// Asserts the objects that have performed every one of a set of actions.
+#define mu_assert_object_ids(INDEX, ACTION_IDS, ...) do {\
+    sky_action_id_t _action_ids[] = ACTION_IDS; \
+    sky_object_id_t _expected[] = {__VA_ARGS__}; \
+    uint32_t _i, _count = sizeof(_expected) / sizeof(*_expected); \
+    sky_object_id_t *_object_ids = NULL; \
+    uint32_t _object_id_count = 0; \
+    mu_assert_int_equals(sky_action_index_get_object_ids(INDEX, _action_ids, sizeof(_action_ids) / sizeof(*_action_ids), &_object_ids, &_object_id_count), 0); \
+    mu_assert_int_equals(_object_id_count, _count); \
+    for(_i=0; _i<_count; _i++) { \
+        mu_assert_int64_equals((long long)_object_ids[_i], (long long)_expected[_i]); \
+    } \
+    free(_object_ids); \
+} while(0)
+
+#define LIST(...) {__VA_ARGS__}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Maintenance
+//--------------------------------------
+
+int test_sky_action_index_add() {
+    sky_action_index *index = sky_action_index_create();
+    mu_assert_int_equals(sky_action_index_add(index, 1, 10), 0);
+    mu_assert_int_equals(sky_action_index_add(index, 1, 30), 0);
+    mu_assert_int_equals(sky_action_index_add(index, 1, 20), 0);
+    mu_assert_int_equals(sky_action_index_add(index, 1, 30), 0);
+    mu_assert_int_equals(sky_action_index_add(index, 1, 5), 0);
+    mu_assert_int_equals(sky_action_index_add(index, 3, 20), 0);
+    mu_assert_int_equals(sky_action_index_add(index, 3, 40), 0);
+    mu_assert_int_equals(sky_action_index_add(index, 0, 50), 0);
+    mu_assert_int_equals(index->list_count, 4);
+    mu_assert_int_equals(index->lists[0].count, 0);
+
+    // Lists are kept sorted without duplicates.
+    mu_assert_object_ids(index, LIST(1), 5, 10, 20, 30);
+    mu_assert_object_ids(index, LIST(3), 20, 40);
+
+    // Multiple actions are intersected.
+    mu_assert_object_ids(index, LIST(1, 3), 20);
+    mu_assert_object_ids(index, LIST(3, 1, 3), 20);
+
+    // An action that nobody performed leaves no objects.
+    sky_action_id_t missing[] = {1, 2};
+    sky_object_id_t *object_ids = NULL;
+    uint32_t object_id_count = 1;
+    mu_assert_int_equals(sky_action_index_get_object_ids(index, missing, 2, &object_ids, &object_id_count), 0);
+    mu_assert_int_equals(object_id_count, 0);
+    mu_assert_bool(object_ids == NULL);
+    missing[1] = 100;
+    mu_assert_int_equals(sky_action_index_get_object_ids(index, missing, 2, &object_ids, &object_id_count), 0);
+    mu_assert_int_equals(object_id_count, 0);
+
+    sky_action_index_clear(index);
+    mu_assert_int_equals(index->list_count, 0);
+    mu_assert_bool(!index->built);
+    sky_action_index_free(index);
+    return 0;
+}
+
+int test_sky_action_index_build() {
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // The index is built from the data file when it is first requested.
+    mu_assert_bool(table->action_index == NULL);
+    sky_action_index *index = NULL;
+    mu_assert_int_equals(sky_table_get_action_index(table, &index), 0);
+    mu_assert_bool(index != NULL && index->built);
+    mu_assert_object_ids(index, LIST(1), 1, 2);
+    mu_assert_object_ids(index, LIST(2), 1, 2, 3);
+    mu_assert_object_ids(index, LIST(2, 1), 1, 2);
+
+    // Added events are indexed as they are inserted.
+    sky_event *event = sky_event_create(4, 10000000LL, 1);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    sky_event_free(event);
+    mu_assert_object_ids(index, LIST(1), 1, 2, 4);
+
+    // Replacing the blocks drops the index until it is requested again.
+    sky_table_invalidate(table);
+    mu_assert_bool(!index->built);
+    mu_assert_int_equals(sky_table_get_action_index(table, &index), 0);
+    mu_assert_object_ids(index, LIST(1), 1, 2, 4);
+
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_action_index_add);
+    mu_run_test(test_sky_action_index_build);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <action_scan.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Dispatch
+//--------------------------------------
+
+int test_sky_action_scan_get_width() {
+    uint32_t width = sky_action_scan_get_width();
+    mu_assert_bool(width == 1 || width == 8 || width == 16);
+    mu_assert_bool(sky_action_scan_get_find_func(width) != NULL);
+    mu_assert_bool(sky_action_scan_get_find_func(1) != NULL);
+    mu_assert_bool(sky_action_scan_get_find_func(3) == NULL);
+    return 0;
+}
+
+
+//--------------------------------------
+// Search
+//--------------------------------------
+
+int test_sky_action_scan_find() {
+    uint32_t i, width, start;
+    sky_action_id_t action_ids[100];
+    for(i=0; i<100; i++) {
+        action_ids[i] = (sky_action_id_t)(10 + (i % 7));
+    }
+    action_ids[41] = 3;
+    action_ids[97] = 3;
+
+    // Every supported width must agree with the scalar search.
+    sky_action_scan_find_func scalar = sky_action_scan_get_find_func(1);
+    for(width=1; width<=16; width++) {
+        sky_action_scan_find_func find = sky_action_scan_get_find_func(width);
+        if(find == NULL) continue;
+
+        for(start=0; start<=100; start++) {
+            mu_assert_int_equals(find(action_ids, start, 100, 3), scalar(action_ids, start, 100, 3));
+            mu_assert_int_equals(find(action_ids, start, 100, 12), scalar(action_ids, start, 100, 12));
+            mu_assert_int_equals(find(action_ids, start, 100, 99), 100);
+        }
+        mu_assert_int_equals(find(action_ids, 0, 100, 3), 41);
+        mu_assert_int_equals(find(action_ids, 42, 100, 3), 97);
+        mu_assert_int_equals(find(action_ids, 42, 97, 3), 97);
+    }
+
+    mu_assert_int_equals(sky_action_scan_find(action_ids, 0, 100, 3), 41);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_action_scan_get_width);
+    mu_run_test(test_sky_action_scan_find);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <arena.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Allocation
+//--------------------------------------
+
+int test_sky_arena_alloc() {
+    sky_arena *arena = sky_arena_create(64);
+    mu_assert_bool(arena->head == NULL);
+
+    // Allocations are aligned and come from the same chunk.
+    void *a = sky_arena_alloc(arena, 3);
+    void *b = sky_arena_alloc(arena, 20);
+    mu_assert_bool(a != NULL && b != NULL);
+    mu_assert_long_equals((long)(b - a), 16L);
+    mu_assert_long_equals((long)((uintptr_t)b % SKY_ARENA_ALIGNMENT), 0L);
+    mu_assert_bool(arena->head->next == NULL);
+
+    // A full chunk adds a new chunk.
+    sky_arena_alloc(arena, 32);
+    mu_assert_bool(arena->head->next != NULL);
+
+    // Oversized allocations get their own chunk.
+    int *c = sky_arena_calloc(arena, 100, sizeof(int));
+    mu_assert_int_equals(c[99], 0);
+    mu_assert_bool(arena->current->size >= 100 * sizeof(int));
+
+    sky_arena_free(arena);
+    return 0;
+}
+
+int test_sky_arena_realloc() {
+    sky_arena *arena = sky_arena_create(256);
+    char *a = sky_arena_alloc(arena, 16);
+    memcpy(a, "hello", 6);
+
+    // The last allocation grows in place.
+    char *b = sky_arena_realloc(arena, a, 16, 64);
+    mu_assert_bool(a == b);
+
+    // Other allocations are copied.
+    sky_arena_alloc(arena, 16);
+    char *c = sky_arena_realloc(arena, b, 64, 128);
+    mu_assert_bool(c != b);
+    mu_assert_bool(strcmp(c, "hello") == 0);
+
+    sky_arena_free(arena);
+    return 0;
+}
+
+int test_sky_arena_reset() {
+    sky_arena *arena = sky_arena_create(64);
+    void *a = sky_arena_alloc(arena, 48);
+    sky_arena_alloc(arena, 48);
+    sky_arena_chunk *second = arena->current;
+    mu_assert_bool(second != arena->head);
+
+    // Chunks are reused after a reset.
+    sky_arena_reset(arena);
+    mu_assert_bool(sky_arena_alloc(arena, 48) == a);
+    sky_arena_alloc(arena, 48);
+    mu_assert_bool(arena->current == second);
+    mu_assert_bool(second->next == NULL);
+
+    sky_arena_free(arena);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_arena_alloc);
+    mu_run_test(test_sky_arena_realloc);
+    mu_run_test(test_sky_arena_reset);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <path.h>
+#include <cursor.h>
+
+#include "minibench.h"
+
+
+//==============================================================================
+//
+// Fixtures
+//
+//==============================================================================
+
+#define EVENT_COUNT 1000
+
+// Packs a path of EVENT_COUNT events. Every fourth event has data and the
+// others only have an action.
+void *create_path()
+{
+    uint32_t i;
+    size_t sz;
+    sky_path *path = sky_path_create(10);
+    for(i=0; i<EVENT_COUNT; i++) {
+        sky_event *event = sky_event_create(10, (i+1) * 1000, (i % 4 == 0 ? 0 : 1 + (i % 7)));
+        if(i % 4 == 0) {
+            event->data_count = 1;
+            event->data = calloc(1, sizeof(*event->data));
+            event->data[0] = sky_event_data_create_int(1, i);
+        }
+        sky_path_add_event(path, event);
+    }
+
+    void *ptr = calloc(1, sky_path_sizeof(path));
+    sky_path_pack(path, ptr, &sz);
+    sky_path_free(path);
+    return ptr;
+}
+
+
+//==============================================================================
+//
+// Benchmarks
+//
+//==============================================================================
+
+int bench_sky_cursor_next(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    uint64_t count = 0;
+    void *ptr = create_path();
+    sky_cursor *cursor = sky_cursor_create();
+
+    mb_timer_start(timer);
+    for(i=0; i<ops/EVENT_COUNT; i++) {
+        sky_cursor_set_path(cursor, ptr);
+        while(!cursor->eof) {
+            sky_cursor_next(cursor);
+            count++;
+        }
+    }
+    mb_timer_stop(timer);
+
+    mb_assert(count == ops);
+    sky_cursor_free(cursor);
+    free(ptr);
+    return 0;
+}
+
+int bench_sky_cursor_next_with_state(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    uint64_t count = 0;
+    void *ptr = create_path();
+    sky_cursor *cursor = sky_cursor_create();
+    sky_cursor_set_track_state(cursor, true);
+
+    mb_timer_start(timer);
+    for(i=0; i<ops/EVENT_COUNT; i++) {
+        sky_cursor_set_path(cursor, ptr);
+        while(!cursor->eof) {
+            sky_cursor_next(cursor);
+            count++;
+        }
+    }
+    mb_timer_stop(timer);
+
+    mb_assert(count == ops);
+    sky_cursor_free(cursor);
+    free(ptr);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+// Each operation moves the cursor over a single event.
+int all_benchmarks() {
+    mb_run_bench(bench_sky_cursor_next, 1000000);
+    mb_run_bench(bench_sky_cursor_next_with_state, 1000000);
+    return 0;
+}
+
+RUN_BENCHMARKS()
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <data_file.h>
+#include <block.h>
+
+#include "minibench.h"
+
+
+//==============================================================================
+//
+// Fixtures
+//
+//==============================================================================
+
+#define OBJECT_COUNT 2000
+
+#define EVENTS_PER_OBJECT 20
+
+#define EVENT_COUNT (OBJECT_COUNT * EVENTS_PER_OBJECT)
+
+// Creates an empty data file in the temporary directory.
+sky_data_file *create_data_file()
+{
+    mb_cleantmp();
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->path = bfromcstr(MB_TMPDIR "/data");
+    data_file->header_path = bfromcstr(MB_TMPDIR "/header");
+    data_file->durability = SKY_DURABILITY_ASYNC;
+    if(sky_data_file_load(data_file) != 0) {
+        sky_data_file_free(data_file);
+        return NULL;
+    }
+    return data_file;
+}
+
+// Creates EVENT_COUNT events for random objects in a fixed order.
+sky_event **create_events()
+{
+    uint32_t i;
+    uint64_t state = 1;
+    sky_event **events = calloc(EVENT_COUNT, sizeof(*events));
+    for(i=0; i<EVENT_COUNT; i++) {
+        sky_object_id_t object_id = 1 + (mb_random(&state) % OBJECT_COUNT);
+        events[i] = sky_event_create(object_id, mb_random(&state), 1 + (i % 10));
+    }
+    return events;
+}
+
+void free_events(sky_event **events)
+{
+    uint32_t i;
+    for(i=0; i<EVENT_COUNT; i++) {
+        sky_event_free(events[i]);
+    }
+    free(events);
+}
+
+
+//==============================================================================
+//
+// Benchmarks
+//
+//==============================================================================
+
+int bench_sky_data_file_find_insertion_block(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    sky_block *block = NULL;
+    sky_event **events = create_events();
+    sky_data_file *data_file = create_data_file();
+    mb_assert(data_file != NULL);
+    for(i=0; i<EVENT_COUNT; i++) {
+        mb_assert(sky_data_file_add_event(data_file, events[i]) == 0);
+    }
+
+    mb_timer_start(timer);
+    for(i=0; i<ops; i++) {
+        sky_data_file_find_insertion_block(data_file, events[i % EVENT_COUNT], &block);
+    }
+    mb_timer_stop(timer);
+
+    mb_assert(block != NULL);
+    sky_data_file_free(data_file);
+    free_events(events);
+    return 0;
+}
+
+// Adds every event to a new data file. Only adding the event to its block is
+// measured; finding the block is not.
+int bench_sky_block_add_event(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    sky_block *block = NULL;
+    sky_event **events = create_events();
+    sky_data_file *data_file = create_data_file();
+    mb_assert(data_file != NULL);
+    mb_assert(ops <= EVENT_COUNT);
+
+    for(i=0; i<ops; i++) {
+        mb_assert(sky_data_file_find_insertion_block(data_file, events[i], &block) == 0);
+        mb_timer_start(timer);
+        int rc = sky_block_add_event(block, events[i]);
+        mb_timer_stop(timer);
+        mb_assert(rc == 0);
+    }
+
+    sky_data_file_free(data_file);
+    free_events(events);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_benchmarks() {
+    mb_run_bench(bench_sky_data_file_find_insertion_block, 1000000);
+    mb_run_bench(bench_sky_block_add_event, EVENT_COUNT);
+    return 0;
+}
+
+RUN_BENCHMARKS()
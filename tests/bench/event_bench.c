@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <event.h>
+
+#include "minibench.h"
+
+
+//==============================================================================
+//
+// Fixtures
+//
+//==============================================================================
+
+struct tagbstring STRING_VALUE = bsStatic("checkout");
+
+// Creates an event with an action and one property of every data type.
+sky_event *create_event()
+{
+    sky_event *event = sky_event_create(10, 1000000, 20);
+    event->data_count = 4;
+    event->data = calloc(event->data_count, sizeof(*event->data));
+    event->data[0] = sky_event_data_create_int(1, 1000);
+    event->data[1] = sky_event_data_create_float(2, 100.5);
+    event->data[2] = sky_event_data_create_boolean(-1, true);
+    event->data[3] = sky_event_data_create_string(-2, &STRING_VALUE);
+    return event;
+}
+
+
+//==============================================================================
+//
+// Benchmarks
+//
+//==============================================================================
+
+int bench_sky_event_pack(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    size_t sz;
+    sky_event *event = create_event();
+    void *ptr = calloc(1, sky_event_sizeof(event));
+
+    mb_timer_start(timer);
+    for(i=0; i<ops; i++) {
+        sky_event_pack(event, ptr, &sz);
+    }
+    mb_timer_stop(timer);
+
+    mb_assert(sz == sky_event_sizeof(event));
+    free(ptr);
+    sky_event_free(event);
+    return 0;
+}
+
+int bench_sky_event_unpack(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    size_t sz;
+    sky_event *event = create_event();
+    void *ptr = calloc(1, sky_event_sizeof(event));
+    sky_event_pack(event, ptr, &sz);
+    sky_event_free(event);
+
+    sky_event **events = calloc(ops, sizeof(*events));
+    for(i=0; i<ops; i++) {
+        events[i] = sky_event_create(10, 0, 0);
+    }
+
+    mb_timer_start(timer);
+    for(i=0; i<ops; i++) {
+        sky_event_unpack(events[i], ptr, &sz);
+    }
+    mb_timer_stop(timer);
+
+    mb_assert(events[ops-1]->data_count == 4);
+    for(i=0; i<ops; i++) {
+        sky_event_free(events[i]);
+    }
+    free(events);
+    free(ptr);
+    return 0;
+}
+
+int bench_sky_event_unpack_view(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    size_t sz;
+    sky_event_view view;
+    sky_event *event = create_event();
+    void *ptr = calloc(1, sky_event_sizeof(event));
+    sky_event_pack(event, ptr, &sz);
+    sky_event_free(event);
+
+    mb_timer_start(timer);
+    for(i=0; i<ops; i++) {
+        sky_event_unpack_view(&view, ptr, &sz);
+    }
+    mb_timer_stop(timer);
+
+    mb_assert(view.action_id == 20);
+    free(ptr);
+    return 0;
+}
+
+int bench_sky_event_sizeof_raw(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    size_t sz;
+    sky_event *event = create_event();
+    void *ptr = calloc(1, sky_event_sizeof(event));
+    sky_event_pack(event, ptr, &sz);
+
+    mb_timer_start(timer);
+    for(i=0; i<ops; i++) {
+        mb_sink += sky_event_sizeof_raw(ptr);
+    }
+    mb_timer_stop(timer);
+
+    mb_assert(sky_event_sizeof_raw(ptr) == sz);
+    free(ptr);
+    sky_event_free(event);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_benchmarks() {
+    mb_run_bench(bench_sky_event_pack, 1000000);
+    mb_run_bench(bench_sky_event_unpack, 100000);
+    mb_run_bench(bench_sky_event_unpack_view, 1000000);
+    mb_run_bench(bench_sky_event_sizeof_raw, 1000000);
+    return 0;
+}
+
+RUN_BENCHMARKS()
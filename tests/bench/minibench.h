@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <bstring.h>
+#include <file.h>
+
+//==============================================================================
+//
+// Minibench
+//
+//==============================================================================
+
+// Minibench is the microbenchmark counterpart of minunit. Each benchmark is a
+// function that performs a fixed number of operations on a fixed fixture and
+// wraps the code being measured in `mb_timer_start()` and `mb_timer_stop()`.
+// Setup that should not be measured goes outside of the timer.
+//
+// Every benchmark is run several times and the median and the minimum cost
+// per operation are reported. Costs are measured in CPU cycles with the time
+// stamp counter where one is available and in nanoseconds with the monotonic
+// clock. Each result is printed on one line as:
+//
+//   NAME OPS CYCLES/OP NS/OP MIN_CYCLES/OP
+
+
+//--------------------------------------
+// Definitions
+//--------------------------------------
+
+#define MB_SAMPLE_COUNT 7
+
+// The temporary directory used for benchmark fixtures.
+#define MB_TMPDIR "tmp/bench"
+
+// Accumulates the cycles and time spent between starts and stops.
+typedef struct mb_timer {
+    uint64_t cycles;
+    int64_t ns;
+    uint64_t start_cycles;
+    int64_t start_ns;
+} mb_timer;
+
+typedef int (*mb_bench_fn)(uint64_t ops, mb_timer *timer);
+
+// A sink that benchmarks write results to so the measured code is kept.
+volatile uint64_t mb_sink;
+
+
+//--------------------------------------
+// Timers
+//--------------------------------------
+
+// Reads the CPU's cycle counter. Platforms without a counter fall back to
+// the monotonic clock in nanoseconds.
+uint64_t mb_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t lo, hi;
+    __asm__ __volatile__("lfence\n\trdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+#elif defined(__aarch64__)
+    uint64_t value;
+    __asm__ __volatile__("isb\n\tmrs %0, cntvct_el0" : "=r"(value) :: "memory");
+    return value;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+#endif
+}
+
+int64_t mb_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+#define mb_timer_start(TIMER) do {\
+    (TIMER)->start_ns = mb_ns();\
+    (TIMER)->start_cycles = mb_cycles();\
+} while(0)
+
+#define mb_timer_stop(TIMER) do {\
+    (TIMER)->cycles += mb_cycles() - (TIMER)->start_cycles;\
+    (TIMER)->ns += mb_ns() - (TIMER)->start_ns;\
+} while(0)
+
+
+//--------------------------------------
+// Fixtures
+//--------------------------------------
+
+// Removes and recreates the temporary fixture directory.
+#define mb_cleantmp() do {\
+    struct tagbstring _tmpdir = bsStatic(MB_TMPDIR);\
+    sky_file_rm_r(&_tmpdir);\
+    mkdir("tmp", S_IRWXU);\
+    mkdir(MB_TMPDIR, S_IRWXU);\
+} while(0)
+
+// Returns a deterministic pseudo-random number so that fixtures are the same
+// on every run.
+uint64_t mb_random(uint64_t *state)
+{
+    *state = (*state * 6364136223846793005ULL) + 1442695040888963407ULL;
+    return *state >> 33;
+}
+
+
+//--------------------------------------
+// Runner
+//--------------------------------------
+
+int mb_compare_doubles(const void *a, const void *b)
+{
+    double x = *((double*)a), y = *((double*)b);
+    return (x > y) - (x < y);
+}
+
+// Runs a benchmark and prints its cost per operation.
+//
+// name - The name of the benchmark.
+// fn   - The benchmark function.
+// ops  - The number of operations performed per sample.
+//
+// Returns 0 if successful, otherwise returns the benchmark's error code.
+int mb_run(const char *name, mb_bench_fn fn, uint64_t ops)
+{
+    uint32_t i;
+    double cycles[MB_SAMPLE_COUNT], ns[MB_SAMPLE_COUNT];
+
+    for(i=0; i<MB_SAMPLE_COUNT; i++) {
+        mb_timer timer;
+        memset(&timer, 0, sizeof(timer));
+        int rc = fn(ops, &timer);
+        if(rc != 0) {
+            fprintf(stderr, "\n  Benchmark Failure: %s()\n", name);
+            return rc;
+        }
+        cycles[i] = (double)timer.cycles / ops;
+        ns[i] = (double)timer.ns / ops;
+    }
+    qsort(cycles, MB_SAMPLE_COUNT, sizeof(double), mb_compare_doubles);
+    qsort(ns, MB_SAMPLE_COUNT, sizeof(double), mb_compare_doubles);
+
+    printf("%-44s %10" PRIu64 " %12.1f %10.1f %12.1f\n", name, ops,
+        cycles[MB_SAMPLE_COUNT/2], ns[MB_SAMPLE_COUNT/2], cycles[0]);
+    fflush(stdout);
+    return 0;
+}
+
+#define mb_run_bench(BENCH, OPS) do {\
+    int rc = mb_run(#BENCH, BENCH, OPS);\
+    if(rc) return rc;\
+} while(0)
+
+#define mb_fail(MSG, ...) do {\
+    fprintf(stderr, "%s:%d: " MSG "\n", __FILE__, __LINE__, ##__VA_ARGS__);\
+    return 1;\
+} while(0)
+
+#define mb_assert(TEST) do {\
+    if(!(TEST)) {\
+        fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #TEST);\
+        return 1;\
+    }\
+} while(0)
+
+#define RUN_BENCHMARKS() int main() {\
+   fprintf(stderr, "== %s ==\n", __FILE__);\
+   int rc = all_benchmarks();\
+   return rc;\
+}
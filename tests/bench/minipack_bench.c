@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <minipack/minipack.h>
+
+#include "minibench.h"
+
+
+//==============================================================================
+//
+// Fixtures
+//
+//==============================================================================
+
+#define VALUE_COUNT 1024
+
+// The values cover every width of integer encoding.
+uint64_t UINT_VALUES[] = {1, 100, 200, 60000, 70000, 4000000000ULL, 5000000000ULL, 1ULL << 60};
+
+int64_t INT_VALUES[] = {1, -10, -100, 1000, -30000, 100000, -3000000000LL, 1LL << 60};
+
+#define FIXTURE_VALUE_COUNT 8
+
+// Returns a buffer large enough for any encoding of VALUE_COUNT values.
+void *create_buffer()
+{
+    return calloc(VALUE_COUNT, 16);
+}
+
+
+//==============================================================================
+//
+// Benchmarks
+//
+//==============================================================================
+
+int bench_minipack_pack_uint(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    size_t sz;
+    void *buffer = create_buffer();
+
+    mb_timer_start(timer);
+    for(i=0; i<ops/VALUE_COUNT; i++) {
+        void *ptr = buffer;
+        uint32_t j;
+        for(j=0; j<VALUE_COUNT; j++) {
+            minipack_pack_uint(ptr, UINT_VALUES[j % FIXTURE_VALUE_COUNT], &sz);
+            ptr += sz;
+        }
+    }
+    mb_timer_stop(timer);
+
+    free(buffer);
+    return 0;
+}
+
+int bench_minipack_unpack_uint(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    size_t sz;
+    uint32_t j;
+    void *buffer = create_buffer();
+    void *ptr = buffer;
+    for(j=0; j<VALUE_COUNT; j++) {
+        minipack_pack_uint(ptr, UINT_VALUES[j % FIXTURE_VALUE_COUNT], &sz);
+        ptr += sz;
+    }
+
+    mb_timer_start(timer);
+    for(i=0; i<ops/VALUE_COUNT; i++) {
+        ptr = buffer;
+        for(j=0; j<VALUE_COUNT; j++) {
+            mb_sink += minipack_unpack_uint(ptr, &sz);
+            ptr += sz;
+        }
+    }
+    mb_timer_stop(timer);
+
+    free(buffer);
+    return 0;
+}
+
+int bench_minipack_pack_int(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    size_t sz;
+    void *buffer = create_buffer();
+
+    mb_timer_start(timer);
+    for(i=0; i<ops/VALUE_COUNT; i++) {
+        void *ptr = buffer;
+        uint32_t j;
+        for(j=0; j<VALUE_COUNT; j++) {
+            minipack_pack_int(ptr, INT_VALUES[j % FIXTURE_VALUE_COUNT], &sz);
+            ptr += sz;
+        }
+    }
+    mb_timer_stop(timer);
+
+    free(buffer);
+    return 0;
+}
+
+int bench_minipack_unpack_int(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    size_t sz;
+    uint32_t j;
+    void *buffer = create_buffer();
+    void *ptr = buffer;
+    for(j=0; j<VALUE_COUNT; j++) {
+        minipack_pack_int(ptr, INT_VALUES[j % FIXTURE_VALUE_COUNT], &sz);
+        ptr += sz;
+    }
+
+    mb_timer_start(timer);
+    for(i=0; i<ops/VALUE_COUNT; i++) {
+        ptr = buffer;
+        for(j=0; j<VALUE_COUNT; j++) {
+            mb_sink += minipack_unpack_int(ptr, &sz);
+            ptr += sz;
+        }
+    }
+    mb_timer_stop(timer);
+
+    free(buffer);
+    return 0;
+}
+
+int bench_minipack_pack_double(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    size_t sz;
+    void *buffer = create_buffer();
+
+    mb_timer_start(timer);
+    for(i=0; i<ops/VALUE_COUNT; i++) {
+        void *ptr = buffer;
+        uint32_t j;
+        for(j=0; j<VALUE_COUNT; j++) {
+            minipack_pack_double(ptr, (double)j * 1.5, &sz);
+            ptr += sz;
+        }
+    }
+    mb_timer_stop(timer);
+
+    free(buffer);
+    return 0;
+}
+
+int bench_minipack_unpack_double(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    size_t sz;
+    uint32_t j;
+    double sum = 0;
+    void *buffer = create_buffer();
+    void *ptr = buffer;
+    for(j=0; j<VALUE_COUNT; j++) {
+        minipack_pack_double(ptr, (double)j * 1.5, &sz);
+        ptr += sz;
+    }
+
+    mb_timer_start(timer);
+    for(i=0; i<ops/VALUE_COUNT; i++) {
+        ptr = buffer;
+        for(j=0; j<VALUE_COUNT; j++) {
+            sum += minipack_unpack_double(ptr, &sz);
+            ptr += sz;
+        }
+    }
+    mb_timer_stop(timer);
+
+    mb_sink += (uint64_t)sum;
+    free(buffer);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+// Each operation encodes or decodes a single value.
+int all_benchmarks() {
+    mb_run_bench(bench_minipack_pack_uint, 2048000);
+    mb_run_bench(bench_minipack_unpack_uint, 2048000);
+    mb_run_bench(bench_minipack_pack_int, 2048000);
+    mb_run_bench(bench_minipack_unpack_int, 2048000);
+    mb_run_bench(bench_minipack_pack_double, 2048000);
+    mb_run_bench(bench_minipack_unpack_double, 2048000);
+    return 0;
+}
+
+RUN_BENCHMARKS()
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <data_file.h>
+#include <path_iterator.h>
+
+#include "minibench.h"
+
+
+//==============================================================================
+//
+// Fixtures
+//
+//==============================================================================
+
+#define OBJECT_COUNT 2000
+
+#define EVENTS_PER_OBJECT 20
+
+sky_data_file *data_file = NULL;
+
+// Creates a data file in the temporary directory with EVENTS_PER_OBJECT
+// events for each of OBJECT_COUNT objects. Events are added in a fixed
+// pseudo-random order so that the blocks split the way they do in use.
+int create_data_file()
+{
+    uint32_t i;
+    uint64_t state = 1;
+    mb_cleantmp();
+    data_file = sky_data_file_create();
+    data_file->path = bfromcstr(MB_TMPDIR "/data");
+    data_file->header_path = bfromcstr(MB_TMPDIR "/header");
+    data_file->durability = SKY_DURABILITY_ASYNC;
+    mb_assert(sky_data_file_load(data_file) == 0);
+
+    for(i=0; i<OBJECT_COUNT*EVENTS_PER_OBJECT; i++) {
+        sky_object_id_t object_id = 1 + (mb_random(&state) % OBJECT_COUNT);
+        sky_event *event = sky_event_create(object_id, mb_random(&state), 1 + (i % 10));
+        mb_assert(sky_data_file_add_event(data_file, event) == 0);
+        sky_event_free(event);
+    }
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Benchmarks
+//
+//==============================================================================
+
+int bench_sky_path_iterator_next(uint64_t ops, mb_timer *timer) {
+    uint64_t i;
+    uint64_t count = 0;
+    uint64_t path_count = 0;
+    sky_path_iterator iterator;
+
+    // Count the paths so that each pass is the same number of operations.
+    sky_path_iterator_init(&iterator);
+    mb_assert(sky_path_iterator_set_data_file(&iterator, data_file) == 0);
+    while(!iterator.eof) {
+        path_count++;
+        sky_path_iterator_next(&iterator);
+    }
+    sky_path_iterator_uninit(&iterator);
+
+    mb_timer_start(timer);
+    for(i=0; i<ops/path_count; i++) {
+        sky_path_iterator_init(&iterator);
+        sky_path_iterator_set_data_file(&iterator, data_file);
+        while(!iterator.eof) {
+            sky_path_iterator_next(&iterator);
+            count++;
+        }
+        sky_path_iterator_uninit(&iterator);
+    }
+    mb_timer_stop(timer);
+
+    mb_assert(count == (ops/path_count)*path_count);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+// Each operation moves the iterator to the next path.
+int all_benchmarks() {
+    if(create_data_file() != 0) {
+        return 1;
+    }
+    mb_run_bench(bench_sky_path_iterator_next, 200000);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+RUN_BENCHMARKS()
@@ -0,0 +1,21 @@
+echo ""
+echo "Microbenchmarks"
+echo ""
+printf "%-44s %10s %12s %10s %12s\n" "BENCHMARK" "OPS" "CYCLES/OP" "NS/OP" "MIN CYCLES"
+
+# Loop over compiled benchmarks and run them.
+for bench_file in tests/bench/*_bench
+do
+    # Only execute if result is a file.
+    if test -f $bench_file
+    then
+        if ! ./$bench_file 2>/tmp/sky-bench.log
+        then
+            cat /tmp/sky-bench.log
+            exit 1
+        fi
+        rm -f /tmp/sky-bench.log
+    fi
+done
+
+echo ""
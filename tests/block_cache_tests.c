@@ -0,0 +1,156 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <block_cache.h>
+#include <data_file.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+#define BLOCK_COUNT 6
+
+// Creates a data file with two objects in each compressed block.
+#define INIT_DATA_FILE() \
+    uint32_t _i, _j, _count = 0; \
+    cleantmp(); \
+    sky_data_file *data_file = sky_data_file_create(); \
+    data_file->block_size = 16384; \
+    data_file->path = bfromcstr("tmp/data"); \
+    data_file->header_path = bfromcstr("tmp/header"); \
+    mu_assert_int_equals(sky_data_file_load(data_file), 0); \
+    for(_i=0; _i<BLOCK_COUNT*2; _i++) { \
+        for(_j=0; _j<100; _j++) { \
+            struct tagbstring _value = bsStatic("abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz"); \
+            sky_event *_event = sky_event_create(_i+1, (sky_timestamp_t)_j, 20); \
+            sky_event_set_data(_event, 1, &_value); \
+            mu_assert_int_equals(sky_data_file_add_event(data_file, _event), 0); \
+            sky_event_free(_event); \
+        } \
+    } \
+    mu_assert_int_equals(data_file->block_count, BLOCK_COUNT); \
+    mu_assert_int_equals(sky_data_file_compress(data_file, 0, 0, &_count), 0); \
+    mu_assert_int_equals(_count, BLOCK_COUNT); \
+    sky_block_cache *cache = data_file->block_cache;
+
+// Reads a block through the cache as a scan would: pinned and then read.
+#define scan_block(INDEX) do { \
+    void *_ptr = NULL; \
+    mu_assert_int_equals(sky_block_cache_pin(cache, data_file->blocks[INDEX]), 0); \
+    mu_assert_int_equals(sky_block_cache_get(cache, data_file->blocks[INDEX], &_ptr), 0); \
+    mu_assert_bool(_ptr != NULL); \
+    sky_block_cache_unpin(cache, data_file->blocks[INDEX]); \
+    sky_block_cache_release(cache); \
+} while(0)
+
+// Asserts whether a block is cached and whether it is protected.
+#define mu_assert_cached(INDEX, CACHED, PROMOTED) do { \
+    sky_block_cache_entry *_entry = data_file->blocks[INDEX]->cache_entry; \
+    mu_assert_bool((_entry != NULL) == (CACHED)); \
+    if(_entry != NULL) mu_assert_bool(_entry->promoted == (PROMOTED)); \
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Eviction
+//--------------------------------------
+
+int test_sky_block_cache_promote() {
+    INIT_DATA_FILE();
+    sky_block_cache_set_capacity(cache, 10 * data_file->block_size);
+
+    // Pinning and reading a block in one scan only counts once.
+    scan_block(0);
+    mu_assert_cached(0, true, false);
+    mu_assert_int_equals(cache->entry_count, 1);
+
+    // Reading it again in a later scan protects it.
+    scan_block(0);
+    mu_assert_cached(0, true, true);
+    mu_assert_long_equals((long)cache->protected_size, (long)data_file->block_size);
+    mu_assert_bool(cache->protected_head == data_file->blocks[0]->cache_entry);
+    mu_assert_bool(cache->head == NULL);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_block_cache_scan_resistant() {
+    uint32_t i;
+    INIT_DATA_FILE();
+    sky_block_cache_set_capacity(cache, 3 * data_file->block_size);
+
+    // Block 0 is read over and over.
+    scan_block(0);
+    scan_block(0);
+    mu_assert_cached(0, true, true);
+
+    // A scan over every block only evicts blocks on probation.
+    for(i=1; i<BLOCK_COUNT; i++) {
+        scan_block(i);
+    }
+    mu_assert_int_equals(cache->entry_count, 3);
+    mu_assert_cached(0, true, true);
+    mu_assert_cached(1, false, false);
+    mu_assert_cached(BLOCK_COUNT-1, true, false);
+    mu_assert_cached(BLOCK_COUNT-2, true, false);
+    mu_assert_long_equals((long)cache->size, (long)(3 * data_file->block_size));
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_block_cache_demote() {
+    INIT_DATA_FILE();
+    sky_block_cache_set_capacity(cache, 2 * data_file->block_size);
+
+    // Only one block fits in the protected share of two blocks.
+    scan_block(0); scan_block(0);
+    scan_block(1); scan_block(1);
+    mu_assert_cached(0, true, false);
+    mu_assert_cached(1, true, true);
+
+    // A demoted block is protected again when it is read.
+    scan_block(0);
+    mu_assert_cached(0, true, true);
+    mu_assert_cached(1, true, false);
+
+    // Shrinking the cache demotes and evicts right away.
+    sky_block_cache_set_capacity(cache, 1 * data_file->block_size);
+    mu_assert_int_equals(cache->entry_count, 1);
+    mu_assert_long_equals((long)cache->protected_size, 0L);
+    mu_assert_cached(0, true, false);
+    mu_assert_cached(1, false, false);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_block_cache_promote);
+    mu_run_test(test_sky_block_cache_scan_resistant);
+    mu_run_test(test_sky_block_cache_demote);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <data_file.h>
+#include <block.h>
+#include <block_column.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+#define INIT_DATA_FILE(PATH) \
+    loadtmp(PATH); \
+    data_file = sky_data_file_create(); \
+    data_file->block_size = 64; \
+    data_file->path = bfromcstr("tmp/data"); \
+    data_file->header_path = bfromcstr("tmp/header"); \
+    sky_data_file_load(data_file);
+
+#define ADD_EVENT(OBJECT_ID, TIMESTAMP, ACTION_ID) do { \
+    sky_event *event = sky_event_create(OBJECT_ID, TIMESTAMP, ACTION_ID); \
+    mu_assert_int_equals(sky_data_file_add_event(data_file, event), 0); \
+    sky_event_free(event); \
+} while (0)
+
+// Verifies that every column held by a block matches a column freshly built
+// from the block's data.
+#define ASSERT_COLUMNS_CURRENT(DATA_FILE) do { \
+    uint32_t _i, _j; \
+    for(_i=0; _i<(DATA_FILE)->block_count; _i++) { \
+        sky_block_column *_column = (DATA_FILE)->blocks[_i]->column; \
+        if(_column == NULL) continue; \
+        sky_block_column *_expected = sky_block_column_create(); \
+        mu_assert_int_equals(sky_block_column_build(_expected, (DATA_FILE)->blocks[_i]), 0); \
+        mu_assert_int_equals(_column->event_count, _expected->event_count); \
+        mu_assert_int_equals(_column->path_count, _expected->path_count); \
+        for(_j=0; _j<_expected->event_count; _j++) { \
+            mu_assert_int_equals(_column->action_ids[_j], _expected->action_ids[_j]); \
+            mu_assert_int64_equals(_column->timestamps[_j], _expected->timestamps[_j]); \
+        } \
+        for(_j=0; _j<_expected->path_count; _j++) { \
+            mu_assert_int_equals(_column->object_ids[_j], _expected->object_ids[_j]); \
+            mu_assert_int_equals(_column->path_offsets[_j+1], _expected->path_offsets[_j+1]); \
+        } \
+        sky_block_column_free(_expected); \
+    } \
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Build
+//--------------------------------------
+
+int test_sky_block_column_build() {
+    sky_data_file *data_file;
+    INIT_DATA_FILE("tests/fixtures/data_files/1/d");
+
+    sky_block_column *column = NULL;
+    int rc = sky_block_get_column(data_file->blocks[0], &column);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_bool(column != NULL);
+    mu_assert_int_equals(column->path_count, 2);
+    mu_assert_int_equals(column->object_ids[0], 3);
+    mu_assert_int_equals(column->object_ids[1], 4);
+    mu_assert_int_equals(column->path_offsets[0], 0);
+    mu_assert_int_equals(column->path_offsets[1], 2);
+    mu_assert_int_equals(column->path_offsets[2], 3);
+    mu_assert_int_equals(column->event_count, 3);
+    mu_assert_int_equals(column->action_ids[0], 21);
+    mu_assert_int64_equals(column->timestamps[0], 8LL);
+    mu_assert_int_equals(column->action_ids[1], 20);
+    mu_assert_int64_equals(column->timestamps[1], 10LL);
+    mu_assert_int_equals(column->action_ids[2], 22);
+    mu_assert_int64_equals(column->timestamps[2], 11LL);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Maintenance
+//--------------------------------------
+
+int test_sky_block_column_updates_on_insert() {
+    sky_data_file *data_file;
+    INIT_DATA_FILE("tests/fixtures/data_files/1/b");
+
+    sky_block_column *column = NULL;
+    mu_assert_int_equals(sky_block_get_column(data_file->blocks[0], &column), 0);
+    mu_assert_int_equals(column->event_count, 2);
+
+    ADD_EVENT(3LL, 11LL, 22);
+    mu_assert_int_equals(column->event_count, 3);
+    mu_assert_int_equals(column->action_ids[2], 22);
+    ASSERT_COLUMNS_CURRENT(data_file);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_block_column_appends_at_end_of_block() {
+    sky_data_file *data_file;
+    INIT_DATA_FILE("tests/fixtures/data_files/1/d");
+
+    sky_block_column *column = NULL;
+    mu_assert_int_equals(sky_block_get_column(data_file->blocks[0], &column), 0);
+    mu_assert_int_equals(column->event_count, 3);
+
+    // Events after the last event of the block are appended.
+    ADD_EVENT(4LL, 12LL, 20);
+    mu_assert_int_equals(column->event_count, 4);
+    mu_assert_int_equals(column->path_count, 2);
+    mu_assert_int_equals(column->path_offsets[2], 4);
+    ASSERT_COLUMNS_CURRENT(data_file);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_block_column_append_event() {
+    sky_block_column *column = sky_block_column_create();
+    mu_assert_int_equals(sky_block_column_append_event(column, 3, 20, 10LL), 0);
+    mu_assert_int_equals(sky_block_column_append_event(column, 3, 21, 11LL), 0);
+    mu_assert_int_equals(sky_block_column_append_event(column, 5, 22, 1LL), 0);
+    mu_assert_int_equals(column->event_count, 3);
+    mu_assert_int_equals(column->path_count, 2);
+    mu_assert_int_equals(column->object_ids[0], 3);
+    mu_assert_int_equals(column->object_ids[1], 5);
+    mu_assert_int_equals(column->path_offsets[0], 0);
+    mu_assert_int_equals(column->path_offsets[1], 2);
+    mu_assert_int_equals(column->path_offsets[2], 3);
+    mu_assert_int_equals(column->action_ids[2], 22);
+    mu_assert_int64_equals(column->timestamps[2], 1LL);
+
+    // Events cannot be appended before the last path.
+    mu_assert_int_equals(sky_block_column_append_event(column, 4, 20, 1LL), -1);
+    mu_assert_int_equals(column->event_count, 3);
+
+    sky_block_column_free(column);
+    return 0;
+}
+
+int test_sky_block_column_updates_on_split() {
+    uint32_t i;
+    sky_data_file *data_file;
+    INIT_DATA_FILE("tests/fixtures/data_files/2/a");
+
+    // Build the columns of all existing blocks.
+    uint32_t event_count = 0;
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block_column *column = NULL;
+        mu_assert_int_equals(sky_block_get_column(data_file->blocks[i], &column), 0);
+        event_count += column->event_count;
+    }
+
+    ADD_EVENT(10LL, 12LL, 20);
+    ASSERT_COLUMNS_CURRENT(data_file);
+
+    // The new event is in exactly one column.
+    uint32_t new_event_count = 0;
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block_column *column = NULL;
+        mu_assert_int_equals(sky_block_get_column(data_file->blocks[i], &column), 0);
+        new_event_count += column->event_count;
+    }
+    mu_assert_int_equals(new_event_count, event_count+1);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_block_column_build);
+    mu_run_test(test_sky_block_column_updates_on_insert);
+    mu_run_test(test_sky_block_column_appends_at_end_of_block);
+    mu_run_test(test_sky_block_column_append_event);
+    mu_run_test(test_sky_block_column_updates_on_split);
+    return 0;
+}
+
+RUN_TESTS()
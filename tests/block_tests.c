@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 
 #include <block.h>
 #include <mem.h>
@@ -16,8 +17,8 @@
 //==============================================================================
 
 char DATA[] = 
-    "\x0a\x00\x00\x00\x14\x00\x00\x00\x1e\x00\x00\x00\x00\x00\x00\x00"
-    "\x28\x00\x00\x00\x00\x00\x00\x00"
+    "\x0a\x00\x00\x00\x00\x00\x00\x00\x14\x00\x00\x00\x00\x00\x00\x00"
+    "\x1e\x00\x00\x00\x00\x00\x00\x00\x28\x00\x00\x00\x00\x00\x00\x00"
 ;
 
 
@@ -49,6 +50,7 @@ sky_block *create_block(sky_data_file *data_file, uint32_t index,
 {
     sky_block *block = sky_block_create(data_file);
     block->index = index;
+    block->position = index;
     block->min_object_id = min_object_id;
     block->max_object_id = max_object_id;
     block->spanned = spanned;
@@ -120,7 +122,9 @@ int test_sky_block_get_ptr() {
     uint8_t x;
     sky_data_file *data_file = sky_data_file_create();
     data_file->block_size = 128;
-    data_file->data = (void*)&x;
+    sky_data_extent extent = {0, (void*)&x, 0, 0};
+    data_file->extents = &extent;
+    data_file->extent_count = 1;
     sky_block *block = sky_block_create(data_file);
     block->index = 3;
     
@@ -128,6 +132,8 @@ int test_sky_block_get_ptr() {
     int rc = sky_block_get_ptr(block, &ptr);
     mu_assert_int_equals(rc, 0);
     mu_assert_long_equals(ptr-((void*)&x), 384L);
+    data_file->extents = NULL;
+    data_file->extent_count = 0;
     sky_data_file_free(data_file);
     sky_block_free(block);
     return 0;
@@ -149,6 +155,7 @@ int test_sky_block_get_span_count() {
     data_file->blocks[2] = create_block(data_file, 2, 20LL, 20LL, true);
     data_file->blocks[3] = create_block(data_file, 3, 30LL, 30LL, true);
     data_file->blocks[4] = create_block(data_file, 4, 30LL, 30LL, true);
+    mu_assert_int_equals(sky_data_file_normalize(data_file), 0);
 
     // Unspanned blocks should return 1.
     rc = sky_block_get_span_count(data_file->blocks[0], &count);
@@ -182,8 +189,8 @@ int test_sky_block_get_path_stats_with_no_event() {
     int rc = sky_block_get_path_stats(data_file->blocks[0], NULL, &paths, &path_count);
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(path_count, 2);
-    ASSERT_PATH_STAT(paths[0], 3, 0L, 41L, 41L);
-    ASSERT_PATH_STAT(paths[1], 10, 41L, 60L, 19L);
+    ASSERT_PATH_STAT(paths[0], 3, 0L, 45L, 45L);
+    ASSERT_PATH_STAT(paths[1], 10, 45L, 68L, 23L);
     sky_data_file_free(data_file);
     return 0;
 }
@@ -197,8 +204,8 @@ int test_sky_block_get_path_stats_with_event_in_existing_path() {
     int rc = sky_block_get_path_stats(data_file->blocks[0], event, &paths, &path_count);
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(path_count, 2);
-    ASSERT_PATH_STAT(paths[0], 3, 0L, 41L, 52L);
-    ASSERT_PATH_STAT(paths[1], 10, 41L, 60L, 19L);
+    ASSERT_PATH_STAT(paths[0], 3, 0L, 45L, 56L);
+    ASSERT_PATH_STAT(paths[1], 10, 45L, 68L, 23L);
     sky_event_free(event);
     sky_data_file_free(data_file);
     return 0;
@@ -213,9 +220,9 @@ int test_sky_block_get_path_stats_with_event_in_new_starting_path() {
     int rc = sky_block_get_path_stats(data_file->blocks[0], event, &paths, &path_count);
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(path_count, 3);
-    ASSERT_PATH_STAT(paths[0], 2, 0L, 0L, 19L);
-    ASSERT_PATH_STAT(paths[1], 3, 0L, 41L, 41L);
-    ASSERT_PATH_STAT(paths[2], 10, 41L, 60L, 19L);
+    ASSERT_PATH_STAT(paths[0], 2, 0L, 0L, 23L);
+    ASSERT_PATH_STAT(paths[1], 3, 0L, 45L, 45L);
+    ASSERT_PATH_STAT(paths[2], 10, 45L, 68L, 23L);
     sky_event_free(event);
     sky_data_file_free(data_file);
     return 0;
@@ -230,9 +237,9 @@ int test_sky_block_get_path_stats_with_event_in_new_middle_path() {
     int rc = sky_block_get_path_stats(data_file->blocks[0], event, &paths, &path_count);
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(path_count, 3);
-    ASSERT_PATH_STAT(paths[0], 3, 0L, 41L, 41L);
-    ASSERT_PATH_STAT(paths[1], 4, 41L, 41L, 19L);
-    ASSERT_PATH_STAT(paths[2], 10, 41L, 60L, 19L);
+    ASSERT_PATH_STAT(paths[0], 3, 0L, 45L, 45L);
+    ASSERT_PATH_STAT(paths[1], 4, 45L, 45L, 23L);
+    ASSERT_PATH_STAT(paths[2], 10, 45L, 68L, 23L);
     sky_event_free(event);
     sky_data_file_free(data_file);
     return 0;
@@ -247,15 +254,92 @@ int test_sky_block_get_path_stats_with_event_in_new_ending_path() {
     int rc = sky_block_get_path_stats(data_file->blocks[0], event, &paths, &path_count);
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(path_count, 3);
-    ASSERT_PATH_STAT(paths[0], 3, 0L, 41L, 41L);
-    ASSERT_PATH_STAT(paths[1], 10, 41L, 60L, 19L);
-    ASSERT_PATH_STAT(paths[2], 11, 60L, 60L, 19L);
+    ASSERT_PATH_STAT(paths[0], 3, 0L, 45L, 45L);
+    ASSERT_PATH_STAT(paths[1], 10, 45L, 68L, 23L);
+    ASSERT_PATH_STAT(paths[2], 11, 68L, 68L, 23L);
     sky_event_free(event);
     sky_data_file_free(data_file);
     return 0;
 }
 
 
+//--------------------------------------
+// Directory
+//--------------------------------------
+
+#define ASSERT_DIRECTORY_ENTRY(ENTRY, OBJECT_ID, OFFSET) do { \
+    mu_assert_int_equals((ENTRY).object_id, OBJECT_ID); \
+    mu_assert_int_equals((ENTRY).offset, OFFSET); \
+} while(0)
+
+int test_sky_block_build_directory() {
+    sky_data_file *data_file;
+    INIT_DATA_FILE("tests/fixtures/blocks/path_stats/a");
+    sky_block *block = data_file->blocks[0];
+    int rc = sky_block_build_directory(block);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_bool(block->directory_valid);
+    mu_assert_int_equals(block->directory_count, 2);
+    ASSERT_DIRECTORY_ENTRY(block->directory[0], 3, 0);
+    ASSERT_DIRECTORY_ENTRY(block->directory[1], 10, 45);
+    mu_assert_long_equals(block->directory_data_length, 68L);
+    mu_assert_int_equals(sky_block_search_directory(block, 2), 0);
+    mu_assert_int_equals(sky_block_search_directory(block, 3), 0);
+    mu_assert_int_equals(sky_block_search_directory(block, 4), 1);
+    mu_assert_int_equals(sky_block_search_directory(block, 11), 2);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_block_add_event_updates_directory() {
+    sky_data_file *data_file;
+    INIT_DATA_FILE("tests/fixtures/blocks/path_stats/a");
+    sky_block *block = data_file->blocks[0];
+    int rc = sky_block_build_directory(block);
+    mu_assert_int_equals(rc, 0);
+
+    // Insert a new path between the existing paths and append to the first.
+    sky_event *event = sky_event_create(4, 7LL, 20);
+    rc = sky_block_add_event(block, event);
+    mu_assert_int_equals(rc, 0);
+    sky_event_free(event);
+    event = sky_event_create(3, 1000LL, 20);
+    rc = sky_block_add_event(block, event);
+    mu_assert_int_equals(rc, 0);
+    sky_event_free(event);
+    mu_assert_bool(block->directory_valid);
+    mu_assert_int_equals(block->directory_count, 3);
+
+    // The updated directory should match a rebuilt one.
+    uint32_t i;
+    sky_block_directory_entry entries[3];
+    memcpy(entries, block->directory, sizeof(entries));
+    size_t data_length = block->directory_data_length;
+    rc = sky_block_build_directory(block);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(block->directory_count, 3);
+    mu_assert_long_equals(data_length, block->directory_data_length);
+    for(i=0; i<3; i++) {
+        ASSERT_DIRECTORY_ENTRY(entries[i], block->directory[i].object_id, block->directory[i].offset);
+        mu_assert_long_equals(entries[i].min_timestamp, block->directory[i].min_timestamp);
+        mu_assert_long_equals(entries[i].max_timestamp, block->directory[i].max_timestamp);
+        mu_assert_int_equals(entries[i].event_count, block->directory[i].event_count);
+        mu_assert_bool(entries[i].action_mask == block->directory[i].action_mask);
+    }
+    mu_assert_int_equals(block->directory[1].object_id, 4);
+    mu_assert_long_equals(block->directory[0].max_timestamp, 1000LL);
+    mu_assert_long_equals(block->directory[1].max_timestamp, 7LL);
+
+    // Each entry summarizes its path.
+    mu_assert_long_equals(block->directory[1].min_timestamp, 7LL);
+    mu_assert_int_equals(block->directory[1].event_count, 1);
+    mu_assert_bool(block->directory[1].action_mask == sky_block_action_bit(20));
+    mu_assert_bool((block->directory[0].action_mask & sky_block_action_bit(20)) != 0);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
 
 //==============================================================================
 //
@@ -276,6 +360,9 @@ int all_tests() {
     mu_run_test(test_sky_block_get_path_stats_with_event_in_new_middle_path);
     mu_run_test(test_sky_block_get_path_stats_with_event_in_new_ending_path);
 
+    mu_run_test(test_sky_block_build_directory);
+    mu_run_test(test_sky_block_add_event_updates_directory);
+
     return 0;
 }
 
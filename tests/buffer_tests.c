@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <buffer.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Writing
+//--------------------------------------
+
+int test_sky_buffer_write() {
+    char data[5000];
+    memset(data, 'x', sizeof(data));
+    sky_buffer *buffer = sky_buffer_create();
+    mu_assert_bool(buffer->data == NULL);
+
+    // The first write allocates the initial capacity.
+    mu_assert_int_equals(sky_buffer_write(buffer, data, 10), 0);
+    mu_assert_long_equals(buffer->length, 10L);
+    mu_assert_long_equals(buffer->capacity, (long)SKY_BUFFER_INITIAL_CAPACITY);
+
+    // Larger writes double the capacity until they fit.
+    mu_assert_int_equals(sky_buffer_write(buffer, data, sizeof(data)), 0);
+    mu_assert_long_equals(buffer->length, 5010L);
+    mu_assert_long_equals(buffer->capacity, (long)SKY_BUFFER_INITIAL_CAPACITY * 2);
+
+    // Clearing keeps the memory and releasing frees it.
+    sky_buffer_clear(buffer);
+    mu_assert_long_equals(buffer->length, 0L);
+    mu_assert_bool(buffer->data != NULL);
+    sky_buffer_release(buffer);
+    mu_assert_bool(buffer->data == NULL);
+    mu_assert_long_equals(buffer->capacity, 0L);
+
+    sky_buffer_free(buffer);
+    return 0;
+}
+
+//--------------------------------------
+// MessagePack
+//--------------------------------------
+
+int test_sky_buffer_pack() {
+    struct tagbstring foo = bsStatic("foo");
+    sky_buffer *buffer = sky_buffer_create();
+    mu_assert_int_equals(sky_buffer_pack_map(buffer, 3), 0);
+    mu_assert_int_equals(sky_buffer_pack_bstring(buffer, &foo), 0);
+    mu_assert_int_equals(sky_buffer_pack_array(buffer, 2), 0);
+    mu_assert_int_equals(sky_buffer_pack_uint(buffer, 1000), 0);
+    mu_assert_int_equals(sky_buffer_pack_int(buffer, -2), 0);
+    mu_assert_int_equals(sky_buffer_pack_bool(buffer, true), 0);
+    mu_assert_int_equals(sky_buffer_pack_nil(buffer), 0);
+    mu_assert_long_equals(buffer->length, 12L);
+    mu_assert_mem(buffer->data,
+        "\x83" "\xA3" "foo" "\x92" "\xCD\x03\xE8" "\xFE" "\xC3" "\xC0", 12);
+    sky_buffer_free(buffer);
+    return 0;
+}
+
+//--------------------------------------
+// Sending
+//--------------------------------------
+
+int test_sky_buffer_send() {
+    int fds[2];
+    char data[100];
+    memset(data, 'x', sizeof(data));
+    mu_assert_int_equals(pipe(fds), 0);
+
+    sky_buffer *buffer = sky_buffer_create();
+    mu_assert_int_equals(sky_buffer_write(buffer, data, sizeof(data)), 0);
+    mu_assert_int_equals(sky_buffer_send(buffer, fds[1]), 0);
+    mu_assert_long_equals(buffer->length, 0L);
+
+    char received[200];
+    mu_assert_long_equals((long)read(fds[0], received, sizeof(received)), 100L);
+    mu_assert_mem(received, data, sizeof(data));
+
+    // A full non-blocking descriptor leaves the rest of the bytes in the
+    // buffer.
+    mu_assert_int_equals(fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK), 0);
+    char *large = calloc(1, 1048576);
+    mu_assert_int_equals(sky_buffer_write(buffer, large, 1048576), 0);
+    mu_assert_int_equals(sky_buffer_send(buffer, fds[1]), 0);
+    mu_assert_bool(buffer->length > 0 && buffer->length < 1048576);
+    size_t sent = 1048576 - buffer->length;
+    size_t total = 0;
+    while(total < sent) {
+        ssize_t sz = read(fds[0], large, 1048576);
+        mu_assert_bool(sz > 0);
+        total += sz;
+    }
+    mu_assert_long_equals((long)total, (long)sent);
+    mu_assert_int_equals(sky_buffer_send(buffer, fds[1]), 0);
+    sky_buffer_clear(buffer);
+    free(large);
+
+    // Sending fails once the reader has gone away.
+    signal(SIGPIPE, SIG_IGN);
+    close(fds[0]);
+    mu_assert_int_equals(sky_buffer_write(buffer, data, 1), 0);
+    mu_assert_int_equals(sky_buffer_send(buffer, fds[1]), -1);
+    close(fds[1]);
+
+    sky_buffer_free(buffer);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_buffer_write);
+    mu_run_test(test_sky_buffer_pack);
+    mu_run_test(test_sky_buffer_send);
+    return 0;
+}
+
+RUN_TESTS()
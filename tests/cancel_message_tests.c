@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cancel_message.h>
+#include <server.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_cancel_message_pack_unpack() {
+    cleantmp();
+    sky_cancel_message *message = sky_cancel_message_create();
+    message->query_id = 1000;
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_cancel_message_pack(message, file), 0);
+    fclose(file);
+    sky_cancel_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_cancel_message_create();
+    mu_assert_int_equals(sky_cancel_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_int64_equals((long long)message->query_id, 1000LL);
+    sky_cancel_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_cancel_message_process() {
+    sky_server *server = sky_server_create(NULL);
+    sky_server_query query1 = {10, false};
+    sky_server_query query2 = {20, false};
+    mu_assert_int_equals(sky_server_add_query(server, &query1), 0);
+    mu_assert_int_equals(sky_server_add_query(server, &query2), 0);
+
+    sky_cancel_message *message = sky_cancel_message_create();
+    message->query_id = 20;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_cancel_message_process(message, server, output), 0);
+    mu_assert_bool(!query1.cancelled);
+    mu_assert_bool(query2.cancelled);
+
+    //   {status:"ok", count:1}
+    char expected[] = "\x82" "\xA6" "status" "\xA2" "ok" "\xA5" "count" "\x01";
+    mu_assert_int_equals((int)output->length, (int)sizeof(expected)-1);
+    mu_assert_mem(output->data, expected, output->length);
+
+    // Queries that have finished are no longer cancelled.
+    sky_server_remove_query(server, &query2);
+    sky_server_remove_query(server, &query1);
+    mu_assert_int_equals(server->query_count, 0);
+    mu_assert_int_equals(sky_server_cancel_queries(server, 10), 0);
+    mu_assert_bool(!query1.cancelled);
+
+    sky_buffer_free(output);
+    sky_cancel_message_free(message);
+    sky_server_free(server);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_cancel_message_pack_unpack);
+    mu_run_test(test_sky_cancel_message_process);
+    return 0;
+}
+
+RUN_TESTS()
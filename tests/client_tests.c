@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <dbg.h>
+#include <client.h>
+#include <server.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+#define MAX_HANDLERS 4
+
+// A server that answers every pipelined message with its request id and the
+// number of events in it. Messages can be answered in pairs in reverse
+// order and the server can hang up instead of answering.
+typedef struct fake_server {
+    bstring path;
+    int listener;
+    pthread_t thread;
+    pthread_t handlers[MAX_HANDLERS];
+    uint32_t handler_count;
+    bool reverse;
+    bool hang_up;
+    uint32_t message_count;
+    uint32_t event_count;
+} fake_server;
+
+// The results collected by the test callback.
+typedef struct callback_results {
+    uint32_t count;
+    uint32_t failures;
+    uint64_t values[16];
+} callback_results;
+
+void fake_server_respond(FILE *output, sky_message_header *header,
+                         uint64_t value)
+{
+    size_t sz;
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring value_str = bsStatic("value");
+    minipack_fwrite_array(output, 2, &sz);
+    minipack_fwrite_uint(output, header->request_id, &sz);
+    minipack_fwrite_map(output, 2, &sz);
+    sky_minipack_fwrite_bstring(output, &status_str);
+    sky_minipack_fwrite_bstring(output, &ok_str);
+    sky_minipack_fwrite_bstring(output, &value_str);
+    minipack_fwrite_uint(output, value, &sz);
+}
+
+void *fake_server_handle(void *arg)
+{
+    size_t sz;
+    fake_server *server = (fake_server*)arg;
+    int sock = accept(server->listener, NULL, NULL);
+    if(sock == -1) return NULL;
+    FILE *input = fdopen(sock, "r");
+    FILE *output = fdopen(dup(sock), "w");
+    sky_message_header *held = NULL;
+    uint64_t held_value = 0;
+
+    while(true) {
+        sky_message_header *header = sky_message_header_create();
+        if(sky_message_header_unpack(header, input) != 0) {
+            sky_message_header_free(header);
+            break;
+        }
+        if(server->hang_up) {
+            sky_message_header_free(header);
+            break;
+        }
+
+        // EBULK messages are answered with their event count and other
+        // messages with their body length.
+        uint64_t value = header->length;
+        sky_buffer *body = sky_buffer_create();
+        if(sky_server_message_has_body(header)) {
+            sky_minipack_fread_elem(input, body);
+        }
+        if(header->type == SKY_MESSAGE_TYPE_EBULK) {
+            FILE *file = fmemopen(body->data, body->length, "r");
+            value = minipack_fread_array(file, &sz);
+            fclose(file);
+            __sync_add_and_fetch(&server->event_count, value);
+        }
+        __sync_add_and_fetch(&server->message_count, 1);
+        sky_buffer_free(body);
+
+        if(server->reverse && held == NULL) {
+            held = header;
+            held_value = value;
+            continue;
+        }
+        fake_server_respond(output, header, value);
+        if(held != NULL) {
+            fake_server_respond(output, held, held_value);
+            sky_message_header_free(held);
+            held = NULL;
+        }
+        fflush(output);
+        sky_message_header_free(header);
+    }
+
+    sky_message_header_free(held);
+    fclose(input);
+    fclose(output);
+    return NULL;
+}
+
+// Starts the fake server and creates a client that is pointed at it.
+#define START_SERVER(CONNECTION_COUNT) \
+    uint32_t _i; \
+    fake_server server; \
+    memset(&server, 0, sizeof(server)); \
+    server.path = bformat("/tmp/sky-client-%d.sock", (int)getpid()); \
+    unlink(bdata(server.path)); \
+    struct sockaddr_un addr; \
+    memset(&addr, 0, sizeof(addr)); \
+    addr.sun_family = AF_UNIX; \
+    memcpy(addr.sun_path, bdata(server.path), blength(server.path)); \
+    server.listener = socket(AF_UNIX, SOCK_STREAM, 0); \
+    mu_assert_int_equals(bind(server.listener, (struct sockaddr*)&addr, sizeof(addr)), 0); \
+    mu_assert_int_equals(listen(server.listener, MAX_HANDLERS), 0); \
+    for(_i=0; _i<MAX_HANDLERS; _i++) { \
+        pthread_create(&server.handlers[_i], NULL, fake_server_handle, &server); \
+    } \
+    struct tagbstring db_str = bsStatic("db"); \
+    struct tagbstring table_str = bsStatic("users"); \
+    sky_client *client = sky_client_create(); \
+    mu_assert_int_equals(sky_client_set_connection_count(client, CONNECTION_COUNT), 0); \
+    mu_assert_int_equals(sky_client_set_address(client, server.path), 0); \
+    mu_assert_int_equals(sky_client_set_table(client, &db_str, &table_str), 0);
+
+// Closes the client's connections and waits for the server to stop.
+#define STOP_SERVER() \
+    sky_client_free(client); \
+    shutdown(server.listener, SHUT_RDWR); \
+    for(_i=0; _i<MAX_HANDLERS; _i++) { \
+        pthread_join(server.handlers[_i], NULL); \
+    } \
+    close(server.listener); \
+    unlink(bdata(server.path)); \
+    bdestroy(server.path);
+
+// Records the value of a response.
+void record_response(sky_client *client, int status, sky_buffer *response,
+                     void *data)
+{
+    size_t sz;
+    bstring key = NULL;
+    callback_results *results = (callback_results*)data;
+    (void)client;
+    if(status != 0) {
+        results->failures++;
+        return;
+    }
+
+    // Read the value out of {status:"ok", value:<value>}.
+    FILE *file = fmemopen(response->data, response->length, "r");
+    minipack_fread_map(file, &sz);
+    sky_minipack_fread_bstring(file, &key); bdestroy(key);
+    sky_minipack_fread_bstring(file, &key); bdestroy(key);
+    sky_minipack_fread_bstring(file, &key); bdestroy(key);
+    uint64_t value = minipack_fread_uint(file, &sz);
+    fclose(file);
+
+    if(results->count < 16) {
+        results->values[results->count] = value;
+    }
+    results->count++;
+}
+
+// Packs a body with a single uint.
+sky_buffer *create_body(uint64_t value)
+{
+    sky_buffer *body = sky_buffer_create();
+    sky_buffer_pack_uint(body, value);
+    return body;
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Messaging
+//--------------------------------------
+
+int test_sky_client_send() {
+    START_SERVER(2);
+    callback_results results;
+    memset(&results, 0, sizeof(results));
+
+    // A small value packs to one byte and a larger one to three.
+    sky_buffer *small = create_body(1);
+    sky_buffer *large = create_body(1000);
+    mu_assert_int_equals(sky_client_send(client, SKY_MESSAGE_TYPE_EADD, small, record_response, &results), 0);
+    mu_assert_int_equals(sky_client_send(client, SKY_MESSAGE_TYPE_EADD, large, record_response, &results), 0);
+    mu_assert_int_equals(sky_client_send(client, SKY_MESSAGE_TYPE_AALL, NULL, record_response, &results), 0);
+    mu_assert_int_equals(sky_client_get_pending_count(client), 3);
+    mu_assert_int_equals(sky_client_wait(client), 0);
+    mu_assert_int_equals(sky_client_get_pending_count(client), 0);
+
+    // Each connection answers in order.
+    mu_assert_int_equals(results.count, 3);
+    mu_assert_int_equals(results.failures, 0);
+    mu_assert_int_equals(server.message_count, 3);
+    uint64_t total = results.values[0] + results.values[1] + results.values[2];
+    mu_assert_long_equals((long)total, 4L);
+
+    sky_buffer_free(small);
+    sky_buffer_free(large);
+    STOP_SERVER();
+    return 0;
+}
+
+int test_sky_client_send_out_of_order() {
+    START_SERVER(1);
+    server.reverse = true;
+    callback_results results;
+    memset(&results, 0, sizeof(results));
+
+    sky_buffer *small = create_body(1);
+    sky_buffer *large = create_body(1000);
+    mu_assert_int_equals(sky_client_send(client, SKY_MESSAGE_TYPE_EADD, small, record_response, &results), 0);
+    mu_assert_int_equals(sky_client_send(client, SKY_MESSAGE_TYPE_EADD, large, record_response, &results), 0);
+    mu_assert_int_equals(sky_client_wait(client), 0);
+
+    // The second response arrives first and is matched by its request id.
+    mu_assert_int_equals(results.count, 2);
+    mu_assert_long_equals((long)results.values[0], 3L);
+    mu_assert_long_equals((long)results.values[1], 1L);
+
+    sky_buffer_free(small);
+    sky_buffer_free(large);
+    STOP_SERVER();
+    return 0;
+}
+
+int test_sky_client_max_pipelined() {
+    uint32_t i;
+    START_SERVER(1);
+    client->max_pipelined = 2;
+    callback_results results;
+    memset(&results, 0, sizeof(results));
+
+    // Sending beyond the limit reads responses to make room.
+    sky_buffer *body = create_body(1);
+    for(i=0; i<5; i++) {
+        mu_assert_int_equals(sky_client_send(client, SKY_MESSAGE_TYPE_EADD, body, record_response, &results), 0);
+        mu_assert_bool(sky_client_get_pending_count(client) <= 2);
+    }
+    mu_assert_int_equals(results.count, 3);
+    mu_assert_int_equals(sky_client_wait(client), 0);
+    mu_assert_int_equals(results.count, 5);
+
+    sky_buffer_free(body);
+    STOP_SERVER();
+    return 0;
+}
+
+int test_sky_client_connection_failure() {
+    START_SERVER(1);
+    server.hang_up = true;
+    callback_results results;
+    memset(&results, 0, sizeof(results));
+
+    // The callback is run with a failure when the server hangs up.
+    sky_buffer *body = create_body(1);
+    mu_assert_int_equals(sky_client_send(client, SKY_MESSAGE_TYPE_EADD, body, record_response, &results), 0);
+    mu_assert_int_equals(sky_client_wait(client), -1);
+    mu_assert_int_equals(results.count, 0);
+    mu_assert_int_equals(results.failures, 1);
+    mu_assert_int_equals(sky_client_get_pending_count(client), 0);
+
+    // The connection is reopened on the next send.
+    server.hang_up = false;
+    mu_assert_int_equals(sky_client_send(client, SKY_MESSAGE_TYPE_EADD, body, record_response, &results), 0);
+    mu_assert_int_equals(sky_client_wait(client), 0);
+    mu_assert_int_equals(results.count, 1);
+
+    sky_buffer_free(body);
+    STOP_SERVER();
+    return 0;
+}
+
+
+//--------------------------------------
+// Batching
+//--------------------------------------
+
+int test_sky_client_add_event() {
+    uint32_t i;
+    START_SERVER(1);
+    client->batch_size = 2;
+    callback_results results;
+    memset(&results, 0, sizeof(results));
+    client->batch_callback = record_response;
+    client->batch_callback_data = &results;
+
+    sky_eadd_message *message = sky_eadd_message_create();
+    message->object_id = 10;
+    message->timestamp = 1000;
+    for(i=0; i<3; i++) {
+        mu_assert_int_equals(sky_client_add_event(client, message), 0);
+    }
+    mu_assert_int_equals(sky_client_get_pending_count(client), 1);
+    mu_assert_int_equals(client->batch_count, 1);
+
+    // The partial batch is sent on flush.
+    mu_assert_int_equals(sky_client_flush(client), 0);
+    mu_assert_int_equals(client->batch_count, 0);
+    mu_assert_int_equals(sky_client_flush(client), 0);
+    mu_assert_int_equals(sky_client_wait(client), 0);
+    mu_assert_int_equals(results.count, 2);
+    mu_assert_long_equals((long)results.values[0], 2L);
+    mu_assert_long_equals((long)results.values[1], 1L);
+    mu_assert_int_equals(server.message_count, 2);
+    mu_assert_int_equals(server.event_count, 3);
+
+    sky_eadd_message_free(message);
+    STOP_SERVER();
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_client_send);
+    mu_run_test(test_sky_client_send_out_of_order);
+    mu_run_test(test_sky_client_max_pipelined);
+    mu_run_test(test_sky_client_connection_failure);
+    mu_run_test(test_sky_client_add_event);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <compact_message.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_compact_message_pack_unpack() {
+    cleantmp();
+    sky_compact_message *message = sky_compact_message_create();
+    message->fill_factor = 80;
+    mu_assert_long_equals(sky_compact_message_sizeof(message), 1L);
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_compact_message_pack(message, file), 0);
+    fclose(file);
+    sky_compact_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_compact_message_create();
+    mu_assert_int_equals(sky_compact_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_int_equals(message->fill_factor, 80);
+    sky_compact_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_compact_message_process() {
+    size_t sz;
+    bstring str = NULL;
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    sky_compact_message *message = sky_compact_message_create();
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_compact_message_process(message, table, output), 0);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
+
+    // {status:"ok", blockCount:2}
+    FILE *file = fopen("tmp/output", "r");
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 2);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "status"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "ok"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "blockCount"); bdestroy(str);
+    mu_assert_int_equals((uint32_t)minipack_fread_uint(file, &sz), table->data_file->block_count);
+    mu_assert_int_equals(table->data_file->block_count, 2);
+    fclose(file);
+
+    // The events are still in the table.
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 2, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+
+    sky_compact_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_compact_message_pack_unpack);
+    mu_run_test(test_sky_compact_message_process);
+    return 0;
+}
+
+RUN_TESTS()
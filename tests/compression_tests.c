@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <compression.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Round Trip
+//--------------------------------------
+
+int test_sky_compression_round_trip() {
+    int i;
+    size_t length = 0;
+    char src[4096];
+    for(i=0; i<(int)sizeof(src); i++) {
+        src[i] = (i % 512 < 256 ? 'a' + (i % 7) : (char)(i * 31));
+    }
+
+    size_t capacity = sky_compression_bound(sizeof(src));
+    void *compressed = malloc(capacity);
+    char dest[4096];
+    mu_assert_int_equals(sky_compression_compress(src, sizeof(src), compressed, capacity, &length), 0);
+    mu_assert_bool(length < sizeof(src));
+    mu_assert_int_equals(sky_compression_decompress(compressed, length, dest, sizeof(dest)), 0);
+    mu_assert_bool(memcmp(src, dest, sizeof(src)) == 0);
+
+    free(compressed);
+    return 0;
+}
+
+int test_sky_compression_incompressible() {
+    int i;
+    size_t length = 0;
+    char src[100];
+    for(i=0; i<(int)sizeof(src); i++) {
+        src[i] = (char)i;
+    }
+
+    size_t capacity = sky_compression_bound(sizeof(src));
+    void *compressed = malloc(capacity);
+    char dest[100];
+    mu_assert_int_equals(sky_compression_compress(src, sizeof(src), compressed, capacity, &length), 0);
+    mu_assert_bool(length <= capacity);
+    mu_assert_int_equals(sky_compression_decompress(compressed, length, dest, sizeof(dest)), 0);
+    mu_assert_bool(memcmp(src, dest, sizeof(src)) == 0);
+
+    free(compressed);
+    return 0;
+}
+
+
+//--------------------------------------
+// Corruption
+//--------------------------------------
+
+int test_sky_compression_rejects_corrupt_data() {
+    char dest[64];
+
+    // A match offset before the start of the output.
+    char bad_offset[] = {0x10, 'a', 0x05, 0x00};
+    mu_assert_int_equals(sky_compression_decompress(bad_offset, sizeof(bad_offset), dest, sizeof(dest)), -1);
+
+    // A literal run past the end of the input.
+    char truncated[] = {(char)0xF0, 0x00, 'a'};
+    mu_assert_int_equals(sky_compression_decompress(truncated, sizeof(truncated), dest, sizeof(dest)), -1);
+
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_compression_round_trip);
+    mu_run_test(test_sky_compression_incompressible);
+    mu_run_test(test_sky_compression_rejects_corrupt_data);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <table.h>
+#include <continuous_query.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// Asserts that the result of a continuous query matches a full scan.
+#define mu_assert_continuous_query(TABLE, CONTINUOUS_QUERY) do { \
+    mu_assert_int_equals(sky_table_merge(TABLE), 0); \
+    sky_query_result *_expected = sky_query_result_create((CONTINUOUS_QUERY)->query); \
+    mu_assert_int_equals(sky_query_execute((CONTINUOUS_QUERY)->query, (TABLE)->data_file, _expected), 0); \
+    sky_query_result *_actual = (CONTINUOUS_QUERY)->result; \
+    mu_assert_int_equals(_actual->group_count, _expected->group_count); \
+    mu_assert_mem(_actual->keys, _expected->keys, sizeof(*_expected->keys) * _expected->group_count); \
+    mu_assert_mem(_actual->values, _expected->values, sizeof(*_expected->values) * _expected->group_count); \
+    sky_query_result_free(_expected); \
+} while(0)
+
+// Adds random events to a table and checks a continuous query against a
+// full scan along the way.
+int add_random_events(sky_table *table, sky_continuous_query *continuous_query) {
+    uint32_t i;
+    srand(7);
+    sky_event *event = sky_event_create(0, 0, 0);
+    for(i=0; i<300; i++) {
+        event->object_id = 1 + (rand() % 20);
+        event->timestamp = rand() % 1000;
+        event->action_id = 1 + (rand() % 4);
+        mu_assert_int_equals(sky_table_add_event(table, event), 0);
+        if(i % 25 == 0) {
+            mu_assert_continuous_query(table, continuous_query);
+        }
+    }
+    mu_assert_continuous_query(table, continuous_query);
+    mu_assert_bool(continuous_query->result->group_count > 0);
+    sky_event_free(event);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Registration
+//--------------------------------------
+
+int test_sky_table_add_continuous_query() {
+    sky_action_id_t action_ids[] = {1, 2};
+    sky_action_id_t other_action_ids[] = {2, 1};
+    sky_continuous_query *continuous_query = NULL;
+    sky_continuous_query *existing = NULL;
+    importtmp("tests/fixtures/next_action_message/1/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // The query is seeded with a scan.
+    mu_assert_int_equals(sky_table_add_continuous_query(table, action_ids, 2, &continuous_query), 0);
+    mu_assert_int_equals(continuous_query->result->group_count, 2);
+    mu_assert_int64_equals((long long)continuous_query->result->keys[0], 3LL);
+    mu_assert_int64_equals((long long)continuous_query->result->values[0], 2LL);
+    mu_assert_int64_equals((long long)continuous_query->result->keys[1], 4LL);
+    mu_assert_int64_equals((long long)continuous_query->result->values[1], 1LL);
+
+    // Registering the same prior actions returns the existing query.
+    mu_assert_int_equals(sky_table_add_continuous_query(table, action_ids, 2, &existing), 0);
+    mu_assert_bool(existing == continuous_query);
+    mu_assert_int_equals(table->continuous_query_count, 1);
+    mu_assert_bool(sky_table_find_continuous_query(table, other_action_ids, 2) == NULL);
+
+    mu_assert_int_equals(sky_table_remove_continuous_query(table, action_ids, 2), 0);
+    mu_assert_int_equals(table->continuous_query_count, 0);
+    mu_assert_bool(sky_table_find_continuous_query(table, action_ids, 2) == NULL);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//--------------------------------------
+// Maintenance
+//--------------------------------------
+
+int test_sky_continuous_query_add_events() {
+    sky_action_id_t action_ids[] = {1, 2};
+    sky_continuous_query *continuous_query = NULL;
+    cleantmp();
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_int_equals(sky_table_add_continuous_query(table, action_ids, 2, &continuous_query), 0);
+    mu_assert_int_equals(add_random_events(table, continuous_query), 0);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_continuous_query_add_events_with_memtable() {
+    sky_action_id_t action_ids[] = {2, 2};
+    sky_continuous_query *continuous_query = NULL;
+    cleantmp();
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_set_memtable_size(table, 16), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_int_equals(sky_table_add_continuous_query(table, action_ids, 2, &continuous_query), 0);
+    mu_assert_int_equals(add_random_events(table, continuous_query), 0);
+    mu_assert_int_equals(sky_table_close(table), 0);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_table_add_continuous_query);
+    mu_run_test(test_sky_continuous_query_add_events);
+    mu_run_test(test_sky_continuous_query_add_events_with_memtable);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <dbg.h>
+#include <coordinator.h>
+#include <eadd_message.h>
+#include <server.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+#define NODE_COUNT 2
+
+// A node that records the object ids of the EADD messages it receives and
+// answers every message with the same response.
+typedef struct fake_node {
+    bstring path;
+    int listener;
+    pthread_t thread;
+    sky_buffer *response;
+    sky_object_id_t object_ids[64];
+    uint32_t message_count;
+} fake_node;
+
+void *fake_node_run(void *arg)
+{
+    fake_node *node = (fake_node*)arg;
+    int sock = accept(node->listener, NULL, NULL);
+    if(sock == -1) return NULL;
+    FILE *input = fdopen(sock, "r");
+    FILE *output = fdopen(dup(sock), "w");
+
+    while(true) {
+        sky_message_header *header = sky_message_header_create();
+        if(sky_message_header_unpack(header, input) != 0) {
+            sky_message_header_free(header);
+            break;
+        }
+        sky_buffer *body = sky_buffer_create();
+        if(sky_server_message_has_body(header)) {
+            sky_minipack_fread_elem(input, body);
+        }
+        if(header->type == SKY_MESSAGE_TYPE_EADD && node->message_count < 64) {
+            FILE *file = fmemopen(body->data, body->length, "r");
+            sky_eadd_message *message = sky_eadd_message_create();
+            sky_eadd_message_unpack(message, file);
+            node->object_ids[node->message_count] = message->object_id;
+            sky_eadd_message_free(message);
+            fclose(file);
+        }
+        node->message_count++;
+        fwrite(node->response->data, node->response->length, 1, output);
+        fflush(output);
+        sky_buffer_free(body);
+        sky_message_header_free(header);
+    }
+
+    fclose(input);
+    fclose(output);
+    return NULL;
+}
+
+// Starts the fake nodes and creates a coordinator that is connected to them.
+#define START_NODES() \
+    uint32_t _i; \
+    fake_node nodes[NODE_COUNT]; \
+    sky_coordinator *coordinator = sky_coordinator_create(); \
+    for(_i=0; _i<NODE_COUNT; _i++) { \
+        memset(&nodes[_i], 0, sizeof(nodes[_i])); \
+        nodes[_i].path = bformat("/tmp/sky-coordinator-%d-%d.sock", (int)getpid(), _i); \
+        nodes[_i].response = sky_buffer_create(); \
+        unlink(bdata(nodes[_i].path)); \
+        struct sockaddr_un addr; \
+        memset(&addr, 0, sizeof(addr)); \
+        addr.sun_family = AF_UNIX; \
+        memcpy(addr.sun_path, bdata(nodes[_i].path), blength(nodes[_i].path)); \
+        nodes[_i].listener = socket(AF_UNIX, SOCK_STREAM, 0); \
+        mu_assert_int_equals(bind(nodes[_i].listener, (struct sockaddr*)&addr, sizeof(addr)), 0); \
+        mu_assert_int_equals(listen(nodes[_i].listener, 1), 0); \
+        pthread_create(&nodes[_i].thread, NULL, fake_node_run, &nodes[_i]); \
+        mu_assert_int_equals(sky_coordinator_add_node(coordinator, nodes[_i].path), 0); \
+    }
+
+// Closes the coordinator's connections and waits for the nodes to stop.
+#define STOP_NODES() \
+    sky_coordinator_free(coordinator); \
+    for(_i=0; _i<NODE_COUNT; _i++) { \
+        shutdown(nodes[_i].listener, SHUT_RDWR); \
+        pthread_join(nodes[_i].thread, NULL); \
+        close(nodes[_i].listener); \
+        unlink(bdata(nodes[_i].path)); \
+        bdestroy(nodes[_i].path); \
+        sky_buffer_free(nodes[_i].response); \
+    }
+
+// Packs a 'Next Action' style response of action ids and counts.
+void pack_next_action_response(sky_buffer *buffer, uint32_t count,
+                               uint64_t *action_ids, uint64_t *counts)
+{
+    uint32_t i;
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring data_str = bsStatic("data");
+    struct tagbstring count_str = bsStatic("count");
+    sky_buffer_pack_map(buffer, 2);
+    sky_buffer_pack_bstring(buffer, &status_str);
+    sky_buffer_pack_bstring(buffer, &ok_str);
+    sky_buffer_pack_bstring(buffer, &data_str);
+    sky_buffer_pack_map(buffer, count);
+    for(i=0; i<count; i++) {
+        sky_buffer_pack_uint(buffer, action_ids[i]);
+        sky_buffer_pack_map(buffer, 1);
+        sky_buffer_pack_bstring(buffer, &count_str);
+        sky_buffer_pack_uint(buffer, counts[i]);
+    }
+}
+
+sky_message_header *create_header(const char *name)
+{
+    sky_message_header *header = sky_message_header_create();
+    header->version = 1;
+    header->name = bfromcstr(name);
+    header->type = sky_message_type_from_name(header->name);
+    header->database_name = bfromcstr("db");
+    header->table_name = bfromcstr("users");
+    return header;
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Routing
+//--------------------------------------
+
+int test_sky_coordinator_get_node_index() {
+    uint32_t i;
+    uint32_t counts[4] = {0, 0, 0, 0};
+    struct tagbstring address = bsStatic("localhost:8585");
+    sky_coordinator *coordinator = sky_coordinator_create();
+    for(i=0; i<4; i++) {
+        mu_assert_int_equals(sky_coordinator_add_node(coordinator, &address), 0);
+    }
+
+    // Sequential ids are spread over every node.
+    for(i=0; i<4000; i++) {
+        uint32_t index = sky_coordinator_get_node_index(coordinator, i);
+        mu_assert_bool(index < 4);
+        mu_assert_int_equals(sky_coordinator_get_node_index(coordinator, i), index);
+        counts[index]++;
+    }
+    for(i=0; i<4; i++) {
+        mu_assert_bool(counts[i] > 800 && counts[i] < 1200);
+    }
+
+    sky_coordinator_free(coordinator);
+    return 0;
+}
+
+int test_sky_coordinator_routes_eadd_to_owner() {
+    uint32_t i, j;
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    START_NODES();
+    for(i=0; i<NODE_COUNT; i++) {
+        sky_buffer_pack_map(nodes[i].response, 1);
+        sky_buffer_pack_bstring(nodes[i].response, &status_str);
+        sky_buffer_pack_bstring(nodes[i].response, &ok_str);
+    }
+
+    sky_message_header *header = create_header("eadd");
+    sky_buffer *output = sky_buffer_create();
+    for(i=1; i<=20; i++) {
+        sky_eadd_message *message = sky_eadd_message_create();
+        message->object_id = i;
+        message->timestamp = 1000;
+        message->action_id = 1;
+        FILE *file = fopen(TEMPFILE, "w");
+        mu_assert_int_equals(sky_eadd_message_pack(message, file), 0);
+        fclose(file);
+        sky_eadd_message_free(message);
+
+        file = fopen(TEMPFILE, "r");
+        sky_buffer_clear(output);
+        mu_assert_int_equals(sky_coordinator_process_message(coordinator, header, file, output), 0);
+        fclose(file);
+        mu_assert_long_equals((long)output->length, (long)nodes[0].response->length);
+        mu_assert_mem(output->data, nodes[0].response->data, output->length);
+    }
+
+    // Every event reached the node that owns its object.
+    mu_assert_int_equals(nodes[0].message_count + nodes[1].message_count, 20);
+    mu_assert_bool(nodes[0].message_count > 0);
+    mu_assert_bool(nodes[1].message_count > 0);
+    for(i=0; i<NODE_COUNT; i++) {
+        for(j=0; j<nodes[i].message_count; j++) {
+            mu_assert_int_equals(sky_coordinator_get_node_index(coordinator, nodes[i].object_ids[j]), i);
+        }
+    }
+
+    sky_buffer_free(output);
+    sky_message_header_free(header);
+    STOP_NODES();
+    return 0;
+}
+
+int test_sky_coordinator_merges_next_action() {
+    uint64_t action_ids0[] = {1, 2};
+    uint64_t counts0[] = {2, 1};
+    uint64_t action_ids1[] = {2, 3};
+    uint64_t counts1[] = {3, 1};
+    uint64_t merged_action_ids[] = {1, 2, 3};
+    uint64_t merged_counts[] = {2, 4, 1};
+    START_NODES();
+    pack_next_action_response(nodes[0].response, 2, action_ids0, counts0);
+    pack_next_action_response(nodes[1].response, 2, action_ids1, counts1);
+
+    sky_message_header *header = create_header("next_action");
+    sky_buffer *body = sky_buffer_create();
+    sky_buffer_pack_array(body, 1);
+    sky_buffer_pack_uint(body, 1);
+    FILE *file = fmemopen(body->data, body->length, "r");
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_coordinator_process_message(coordinator, header, file, output), 0);
+    fclose(file);
+
+    sky_buffer *expected = sky_buffer_create();
+    pack_next_action_response(expected, 3, merged_action_ids, merged_counts);
+    mu_assert_long_equals((long)output->length, (long)expected->length);
+    mu_assert_mem(output->data, expected->data, expected->length);
+
+    mu_assert_int_equals(nodes[0].message_count, 1);
+    mu_assert_int_equals(nodes[1].message_count, 1);
+
+    sky_buffer_free(expected);
+    sky_buffer_free(output);
+    sky_buffer_free(body);
+    sky_message_header_free(header);
+    STOP_NODES();
+    return 0;
+}
+
+int test_sky_coordinator_splits_ebulk() {
+    uint32_t i;
+    struct tagbstring status_str = bsStatic("status");
+    struct tagbstring ok_str = bsStatic("ok");
+    struct tagbstring count_str = bsStatic("count");
+    START_NODES();
+
+    sky_message_header *header = create_header("ebulk");
+    sky_buffer *body = sky_buffer_create();
+    sky_buffer_pack_array(body, 10);
+    uint32_t counts[NODE_COUNT] = {0, 0};
+    for(i=1; i<=10; i++) {
+        sky_eadd_message *message = sky_eadd_message_create();
+        message->object_id = i;
+        message->timestamp = 1000;
+        message->action_id = 1;
+        FILE *file = fopen(TEMPFILE, "w");
+        mu_assert_int_equals(sky_eadd_message_pack(message, file), 0);
+        fclose(file);
+        sky_eadd_message_free(message);
+        file = fopen(TEMPFILE, "r");
+        mu_assert_int_equals(sky_minipack_fread_elem(file, body), 0);
+        fclose(file);
+        counts[sky_coordinator_get_node_index(coordinator, i)]++;
+    }
+
+    // Each node reports the number of events it was sent.
+    for(i=0; i<NODE_COUNT; i++) {
+        sky_buffer_pack_map(nodes[i].response, 2);
+        sky_buffer_pack_bstring(nodes[i].response, &status_str);
+        sky_buffer_pack_bstring(nodes[i].response, &ok_str);
+        sky_buffer_pack_bstring(nodes[i].response, &count_str);
+        sky_buffer_pack_uint(nodes[i].response, counts[i]);
+    }
+
+    FILE *file = fmemopen(body->data, body->length, "r");
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_coordinator_process_message(coordinator, header, file, output), 0);
+    fclose(file);
+
+    sky_buffer *expected = sky_buffer_create();
+    sky_buffer_pack_map(expected, 2);
+    sky_buffer_pack_bstring(expected, &status_str);
+    sky_buffer_pack_bstring(expected, &ok_str);
+    sky_buffer_pack_bstring(expected, &count_str);
+    sky_buffer_pack_uint(expected, 10);
+    mu_assert_long_equals((long)output->length, (long)expected->length);
+    mu_assert_mem(output->data, expected->data, expected->length);
+
+    sky_buffer_free(expected);
+    sky_buffer_free(output);
+    sky_buffer_free(body);
+    sky_message_header_free(header);
+    STOP_NODES();
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_coordinator_get_node_index);
+    mu_run_test(test_sky_coordinator_routes_eadd_to_owner);
+    mu_run_test(test_sky_coordinator_merges_next_action);
+    mu_run_test(test_sky_coordinator_splits_ebulk);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dbg.h>
+#include <crc32c.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// Calculates a CRC32C one bit at a time.
+uint32_t reference_crc32c(uint8_t *bytes, size_t length) {
+    size_t i;
+    uint32_t j, crc = 0xFFFFFFFF;
+    for(i=0; i<length; i++) {
+        crc ^= bytes[i];
+        for(j=0; j<8; j++) {
+            crc = (crc & 1 ? (crc >> 1) ^ 0x82F63B78 : crc >> 1);
+        }
+    }
+    return ~crc;
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+int test_sky_crc32c() {
+    uint8_t zeros[32];
+    memset(zeros, 0, sizeof(zeros));
+    mu_assert_long_equals((long)sky_crc32c(0, "123456789", 9), 0xE3069283L);
+    mu_assert_long_equals((long)sky_crc32c(0, zeros, sizeof(zeros)), 0x8A9136AAL);
+    mu_assert_long_equals((long)sky_crc32c(0, zeros, 0), 0L);
+    return 0;
+}
+
+int test_sky_crc32c_unaligned() {
+    uint32_t i;
+    uint8_t data[1027];
+    for(i=0; i<sizeof(data); i++) {
+        data[i] = (uint8_t)((i * 31) ^ (i >> 3));
+    }
+
+    // Every offset and length goes through the word and byte loops.
+    for(i=0; i<16; i++) {
+        size_t length = sizeof(data) - (i * 7);
+        mu_assert_long_equals((long)sky_crc32c(0, data + i, length), (long)reference_crc32c(data + i, length));
+    }
+    return 0;
+}
+
+int test_sky_crc32c_pieces() {
+    uint32_t i;
+    uint8_t data[300];
+    for(i=0; i<sizeof(data); i++) {
+        data[i] = (uint8_t)i;
+    }
+
+    uint32_t crc = sky_crc32c(0, data, 13);
+    crc = sky_crc32c(crc, data + 13, 200);
+    crc = sky_crc32c(crc, data + 213, sizeof(data) - 213);
+    mu_assert_long_equals((long)crc, (long)sky_crc32c(0, data, sizeof(data)));
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_crc32c);
+    mu_run_test(test_sky_crc32c_unaligned);
+    mu_run_test(test_sky_crc32c_pieces);
+    return 0;
+}
+
+RUN_TESTS()
@@ -4,6 +4,7 @@
 #include <dbg.h>
 #include <mem.h>
 #include <path_iterator.h>
+#include <cursor.h>
 
 #include "minunit.h"
 
@@ -14,12 +15,55 @@
 //
 //==============================================================================
 
-size_t DATA_LENGTH = 57;
+size_t DATA_LENGTH = 61;
 char DATA[] = 
-    "\x0a\x00\x00\x00\x31\x00\x00\x00\x01\xa0\x00\x00\x00\x00\x00\x00"
-    "\x00\x0b\x00\x02\xa1\x00\x00\x00\x00\x00\x00\x00\x05\x00\x00\x00"
-    "\x01\xa3\x66\x6f\x6f\x03\xa2\x00\x00\x00\x00\x00\x00\x00\x0d\x00"
-    "\x05\x00\x00\x00\x01\xa3\x62\x61\x72"
+    "\x0a\x00\x00\x00\x00\x00\x00\x00\x31\x00\x00\x00\x01\xa0\x00\x00"
+    "\x00\x00\x00\x00\x00\x0b\x00\x02\xa1\x00\x00\x00\x00\x00\x00\x00"
+    "\x05\x00\x00\x00\x01\xa3\x66\x6f\x6f\x03\xa2\x00\x00\x00\x00\x00"
+    "\x00\x00\x0d\x00\x05\x00\x00\x00\x01\xa3\x62\x61\x72"
+;
+
+// Two more parts of the path in DATA as if it spanned three blocks. Each
+// part has a single event at timestamp 176 and 192.
+char SPAN_DATA_1[] = 
+    "\x0a\x00\x00\x00\x00\x00\x00\x00\x0b\x00\x00\x00\x01\xb0\x00\x00\x00\x00\x00\x00\x00\x01\x00"
+;
+char SPAN_DATA_2[] = 
+    "\x0a\x00\x00\x00\x00\x00\x00\x00\x0b\x00\x00\x00\x01\xc0\x00\x00\x00\x00\x00\x00\x00\x02\x00"
+;
+
+// Event 1 sets object property 1 to 10 and action property -1 to true.
+// Event 2 has no data. Event 3 sets object property 1 to 20.
+char STATE_DATA[] = 
+    "\x01\x00\x00\x00\x00\x00\x00\x00\x2d\x00\x00\x00"
+    "\x03\x00\x00\x00\x00\x00\x00\x00\x00\x01\x00\x04\x00\x00\x00"
+    "\x01\x0a\xff\xc3"
+    "\x01\x00\x00\x00\x00\x00\x00\x00\x00\x02\x00"
+    "\x02\x00\x00\x00\x00\x00\x00\x00\x00\x02\x00\x00\x00\x01\x14"
+;
+
+char FIXED_STATE_DATA[] = 
+    "\x01\x00\x00\x00\x00\x00\x00\x00\x2d\x00\x00\x00"
+    "\x02\x00\x00\x00\x00\x00\x00\x00\x00\x11\x00\x00\x00"
+    "\x00\x01\x00\x01\x01\xff\xe8\x03\x00\x00\x00\x00\x00\x00\x01"
+    "\x02\x05"
+    "\x02\x01\x00\x00\x00\x00\x00\x00\x00\x02\x00\x00\x00\x02\x06"
+;
+
+// Three action-only events with a full timestamp, a one byte delta and a
+// two byte delta.
+char ACTION_ONLY_DATA[] = 
+    "\x01\x00\x00\x00\x00\x00\x00\x00\x14\x00\x00\x00"
+    "\x01\x10\x00\x00\x00\x00\x00\x00\x00\x03\x00"
+    "\x05\x20\x04\x00"
+    "\x09\x00\x01\x05\x00"
+;
+
+// A path whose second event has no action or data flag set.
+char INVALID_DATA[] = 
+    "\x01\x00\x00\x00\x00\x00\x00\x00\x16\x00\x00\x00"
+    "\x01\x10\x00\x00\x00\x00\x00\x00\x00\x03\x00"
+    "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
 ;
 
 
@@ -41,7 +85,7 @@ int test_sky_cursor_next() {
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(cursor->path_index, 0);
     mu_assert_int_equals(cursor->event_index, 0);
-    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 8L);
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 12L);
     mu_assert_bool(!cursor->eof);
     
     // Event 2
@@ -49,7 +93,7 @@ int test_sky_cursor_next() {
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(cursor->path_index, 0);
     mu_assert_int_equals(cursor->event_index, 1);
-    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 19L);
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 23L);
     mu_assert_bool(!cursor->eof);
 
     // Event 3
@@ -57,7 +101,7 @@ int test_sky_cursor_next() {
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(cursor->path_index, 0);
     mu_assert_int_equals(cursor->event_index, 2);
-    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 37L);
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 41L);
     mu_assert_bool(!cursor->eof);
     
     // EOF
@@ -71,6 +115,335 @@ int test_sky_cursor_next() {
     return 0;
 }
 
+int test_sky_cursor_next_invalid() {
+    uint32_t count;
+    sky_timestamp_t timestamps[4];
+    sky_cursor *cursor = sky_cursor_create();
+
+    // Events are checked unless the cursor is marked as verified.
+    mu_assert_int_equals(sky_cursor_set_path(cursor, &INVALID_DATA), 0);
+    mu_assert_int_equals(sky_cursor_next(cursor), -1);
+    mu_assert_int_equals(sky_cursor_set_path(cursor, &INVALID_DATA), 0);
+    mu_assert_int_equals(sky_cursor_next_batch(cursor, timestamps, NULL, NULL, NULL, 4, &count), -1);
+
+    cursor->verified = true;
+    mu_assert_int_equals(sky_cursor_set_path(cursor, &INVALID_DATA), 0);
+    mu_assert_int_equals(sky_cursor_next(cursor), 0);
+    mu_assert_long_equals(cursor->ptr-((void*)&INVALID_DATA), 23L);
+
+    sky_cursor_free(cursor);
+    return 0;
+}
+
+int test_sky_cursor_seek_timestamp() {
+    sky_timestamp_t timestamp;
+    sky_cursor *cursor = sky_cursor_create();
+    mu_assert_int_equals(sky_cursor_set_path(cursor, &DATA), 0);
+
+    // Seeking before the first event does not move.
+    mu_assert_int_equals(sky_cursor_seek_timestamp(cursor, 0), 0);
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 12L);
+    mu_assert_int_equals(sky_cursor_get_timestamp(cursor, &timestamp), 0);
+    mu_assert_int64_equals((long long)timestamp, 160LL);
+
+    // Seek to event 3.
+    mu_assert_int_equals(sky_cursor_seek_timestamp(cursor, 162), 0);
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 41L);
+    mu_assert_int_equals(cursor->event_index, 2);
+    mu_assert_bool(!cursor->eof);
+
+    // Seeking past the last event sets EOF.
+    mu_assert_int_equals(sky_cursor_seek_timestamp(cursor, 200), 0);
+    mu_assert_bool(cursor->eof);
+
+    sky_cursor_free(cursor);
+    return 0;
+}
+
+int test_sky_cursor_seek_timestamp_spanned() {
+    sky_action_id_t action_id;
+    sky_cursor *cursor = sky_cursor_create();
+    void **ptrs = malloc(sizeof(void*) * 3);
+    ptrs[0] = &DATA;
+    ptrs[1] = &SPAN_DATA_1;
+    ptrs[2] = &SPAN_DATA_2;
+    mu_assert_int_equals(sky_cursor_set_paths(cursor, ptrs, 3), 0);
+
+    // Seeking inside the first block stays in the first path.
+    mu_assert_int_equals(sky_cursor_seek_timestamp(cursor, 161), 0);
+    mu_assert_int_equals(cursor->path_index, 0);
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 23L);
+
+    // Seeking to the last block jumps over the middle one.
+    mu_assert_int_equals(sky_cursor_seek_timestamp(cursor, 192), 0);
+    mu_assert_int_equals(cursor->path_index, 2);
+    mu_assert_int_equals(sky_cursor_get_action_id(cursor, &action_id), 0);
+    mu_assert_int_equals(action_id, 2);
+
+    // Seeking between blocks stops at the start of the next block.
+    ptrs = malloc(sizeof(void*) * 3);
+    ptrs[0] = &DATA;
+    ptrs[1] = &SPAN_DATA_1;
+    ptrs[2] = &SPAN_DATA_2;
+    mu_assert_int_equals(sky_cursor_set_paths(cursor, ptrs, 3), 0);
+    mu_assert_int_equals(sky_cursor_seek_timestamp(cursor, 170), 0);
+    mu_assert_int_equals(cursor->path_index, 1);
+    mu_assert_int_equals(sky_cursor_get_action_id(cursor, &action_id), 0);
+    mu_assert_int_equals(action_id, 1);
+
+    // Seeking past the end sets EOF.
+    mu_assert_int_equals(sky_cursor_seek_timestamp(cursor, 300), 0);
+    mu_assert_bool(cursor->eof);
+
+    sky_cursor_free(cursor);
+    return 0;
+}
+
+
+int test_sky_cursor_prev() {
+    sky_cursor *cursor = sky_cursor_create();
+    void **ptrs = malloc(sizeof(void*) * 3);
+    ptrs[0] = &DATA;
+    ptrs[1] = &SPAN_DATA_1;
+    ptrs[2] = &SPAN_DATA_2;
+    mu_assert_int_equals(sky_cursor_set_paths(cursor, ptrs, 3), 0);
+    mu_assert_bool(!sky_cursor_has_prev(cursor));
+
+    // Moving back from EOF moves to the last event.
+    mu_assert_int_equals(sky_cursor_seek_timestamp(cursor, 300), 0);
+    mu_assert_bool(cursor->eof);
+    mu_assert_bool(sky_cursor_has_prev(cursor));
+    mu_assert_int_equals(sky_cursor_prev(cursor), 0);
+    mu_assert_bool(!cursor->eof);
+    mu_assert_int_equals(cursor->path_index, 2);
+    mu_assert_int64_equals((long long)cursor->timestamp, 192LL);
+
+    // Moving back crosses into earlier blocks of the span.
+    mu_assert_int_equals(sky_cursor_prev(cursor), 0);
+    mu_assert_int_equals(cursor->path_index, 1);
+    mu_assert_int64_equals((long long)cursor->timestamp, 176LL);
+    mu_assert_int_equals(sky_cursor_prev(cursor), 0);
+    mu_assert_int_equals(cursor->path_index, 0);
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 41L);
+    mu_assert_int64_equals((long long)cursor->timestamp, 162LL);
+    mu_assert_int_equals(sky_cursor_prev(cursor), 0);
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 23L);
+    mu_assert_int64_equals((long long)cursor->timestamp, 161LL);
+    mu_assert_int_equals(sky_cursor_prev(cursor), 0);
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 12L);
+    mu_assert_int64_equals((long long)cursor->timestamp, 160LL);
+    mu_assert_bool(!sky_cursor_has_prev(cursor));
+    mu_assert_int_equals(sky_cursor_prev(cursor), -1);
+
+    // Moving forward again continues from the same event.
+    mu_assert_int_equals(sky_cursor_next(cursor), 0);
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 23L);
+    mu_assert_int64_equals((long long)cursor->timestamp, 161LL);
+
+    // The events before a time are read by seeking to it and moving back.
+    mu_assert_int_equals(sky_cursor_seek_timestamp(cursor, 177), 0);
+    mu_assert_int64_equals((long long)cursor->timestamp, 192LL);
+    mu_assert_int_equals(sky_cursor_prev(cursor), 0);
+    mu_assert_int64_equals((long long)cursor->timestamp, 176LL);
+    mu_assert_int_equals(sky_cursor_prev(cursor), 0);
+    mu_assert_int64_equals((long long)cursor->timestamp, 162LL);
+
+    sky_cursor_free(cursor);
+    return 0;
+}
+
+
+//--------------------------------------
+// Batches
+//--------------------------------------
+
+int test_sky_cursor_next_batch() {
+    uint32_t count;
+    sky_timestamp_t timestamps[4];
+    sky_action_id_t action_ids[4];
+    void *data_ptrs[4];
+    uint32_t data_lengths[4];
+    sky_cursor *cursor = sky_cursor_create();
+    void **ptrs = malloc(sizeof(void*) * 3);
+    ptrs[0] = &DATA;
+    ptrs[1] = &SPAN_DATA_1;
+    ptrs[2] = &SPAN_DATA_2;
+    mu_assert_int_equals(sky_cursor_set_paths(cursor, ptrs, 3), 0);
+
+    // A full batch crosses into the next block of the span.
+    mu_assert_int_equals(sky_cursor_next_batch(cursor, timestamps, action_ids, data_ptrs, data_lengths, 4, &count), 0);
+    mu_assert_int_equals(count, 4);
+    mu_assert_int64_equals((long long)timestamps[0], 160LL);
+    mu_assert_int64_equals((long long)timestamps[1], 161LL);
+    mu_assert_int64_equals((long long)timestamps[2], 162LL);
+    mu_assert_int64_equals((long long)timestamps[3], 176LL);
+    mu_assert_int_equals(action_ids[0], 11);
+    mu_assert_int_equals(action_ids[1], 0);
+    mu_assert_int_equals(action_ids[2], 13);
+    mu_assert_int_equals(action_ids[3], 1);
+    mu_assert_bool(data_ptrs[0] == NULL);
+    mu_assert_int_equals(data_lengths[0], 0);
+    mu_assert_long_equals(data_ptrs[1]-((void*)&DATA), 36L);
+    mu_assert_int_equals(data_lengths[1], 5);
+    mu_assert_long_equals(data_ptrs[2]-((void*)&DATA), 56L);
+    mu_assert_int_equals(data_lengths[2], 5);
+    mu_assert_int_equals(cursor->path_index, 2);
+    mu_assert_int64_equals((long long)cursor->timestamp, 192LL);
+
+    // The last batch stops at EOF and only the requested fields are written.
+    mu_assert_int_equals(sky_cursor_next_batch(cursor, timestamps, NULL, NULL, NULL, 4, &count), 0);
+    mu_assert_int_equals(count, 1);
+    mu_assert_int64_equals((long long)timestamps[0], 192LL);
+    mu_assert_bool(cursor->eof);
+    mu_assert_int_equals(sky_cursor_next_batch(cursor, timestamps, NULL, NULL, NULL, 4, &count), 0);
+    mu_assert_int_equals(count, 0);
+
+    sky_cursor_free(cursor);
+    return 0;
+}
+
+
+//--------------------------------------
+// Fast Iteration
+//--------------------------------------
+
+int test_sky_cursor_fast_next() {
+    sky_cursor *cursor = sky_cursor_create();
+    int rc = sky_cursor_set_path(cursor, &DATA);
+    mu_assert_int_equals(rc, 0);
+    
+    // Event 1
+    mu_assert_long_equals(sky_cursor_fast_sizeof_event(cursor->ptr), 11L);
+    mu_assert_int_equals(sky_cursor_fast_get_action_id(cursor->ptr), 11);
+
+    // Event 2
+    sky_cursor_fast_next(cursor, "Unable to move to event 2");
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 23L);
+    mu_assert_long_equals(sky_cursor_fast_sizeof_event(cursor->ptr), 18L);
+    mu_assert_int_equals(sky_cursor_fast_get_action_id(cursor->ptr), 0);
+
+    // Event 3
+    sky_cursor_fast_next(cursor, "Unable to move to event 3");
+    mu_assert_long_equals(cursor->ptr-((void*)&DATA), 41L);
+    mu_assert_long_equals(sky_cursor_fast_sizeof_event(cursor->ptr), 20L);
+    mu_assert_int_equals(sky_cursor_fast_get_action_id(cursor->ptr), 13);
+    mu_assert_bool(!cursor->eof);
+
+    // EOF
+    sky_cursor_fast_next(cursor, "Unable to move to EOF");
+    mu_assert_bool(cursor->eof);
+
+    sky_cursor_free(cursor);
+    return 0;
+
+error:
+    mu_fail("Fast cursor iteration failed");
+}
+
+int test_sky_path_foreach_event() {
+    int event_count = 0;
+    int action_id_sum = 0;
+    sky_path_foreach_event((void*)&DATA, event_ptr) {
+        event_count++;
+        action_id_sum += sky_cursor_fast_get_action_id(event_ptr);
+    }
+    mu_assert_int_equals(event_count, 3);
+    mu_assert_int_equals(action_id_sum, 24);
+    return 0;
+}
+
+int test_sky_path_foreach_action_only_event() {
+    int event_count = 0;
+    sky_action_id_t action_ids[3];
+    sky_timestamp_t timestamps[3];
+    sky_timestamp_t timestamp = 0;
+    sky_path_foreach_action_only_event((void*)&ACTION_ONLY_DATA, event_ptr) {
+        mu_assert_bool(sky_cursor_action_only_sizeof_event(event_ptr) == sky_cursor_fast_sizeof_event(event_ptr));
+        timestamp = sky_event_get_timestamp(event_ptr, timestamp);
+        timestamps[event_count] = timestamp;
+        action_ids[event_count] = sky_cursor_action_only_get_action_id(event_ptr);
+        event_count++;
+    }
+    mu_assert_int_equals(event_count, 3);
+    mu_assert_int_equals(action_ids[0], 3);
+    mu_assert_int_equals(action_ids[1], 4);
+    mu_assert_int_equals(action_ids[2], 5);
+    mu_assert_bool(timestamps[0] == 0x10);
+    mu_assert_bool(timestamps[1] == 0x30);
+    mu_assert_bool(timestamps[2] == 0x130);
+    return 0;
+}
+
+
+//--------------------------------------
+// State Management
+//--------------------------------------
+
+int test_sky_cursor_state() {
+    void *value_ptr = NULL;
+    sky_cursor *cursor = sky_cursor_create();
+    mu_assert_int_equals(sky_cursor_set_track_state(cursor, true), 0);
+    mu_assert_int_equals(sky_cursor_set_path(cursor, &STATE_DATA), 0);
+
+    // Event 1
+    mu_assert_int_equals(sky_cursor_get_state(cursor, 1, &value_ptr), 0);
+    mu_assert_int_equals(*((uint8_t*)value_ptr), 0x0A);
+    mu_assert_int_equals(sky_cursor_get_state(cursor, -1, &value_ptr), 0);
+    mu_assert_int_equals(*((uint8_t*)value_ptr), 0xC3);
+    mu_assert_int_equals(sky_cursor_get_state(cursor, 2, &value_ptr), 0);
+    mu_assert_bool(value_ptr == NULL);
+
+    // Event 2
+    mu_assert_int_equals(sky_cursor_next(cursor), 0);
+    mu_assert_int_equals(sky_cursor_get_state(cursor, 1, &value_ptr), 0);
+    mu_assert_int_equals(*((uint8_t*)value_ptr), 0x0A);
+    mu_assert_int_equals(sky_cursor_get_state(cursor, -1, &value_ptr), 0);
+    mu_assert_bool(value_ptr == NULL);
+
+    // Event 3
+    sky_cursor_fast_next(cursor, "Unable to move to event 3");
+    mu_assert_int_equals(sky_cursor_get_state(cursor, 1, &value_ptr), 0);
+    mu_assert_int_equals(*((uint8_t*)value_ptr), 0x14);
+
+    // Reset on new path.
+    mu_assert_int_equals(sky_cursor_set_path(cursor, &DATA), 0);
+    mu_assert_int_equals(sky_cursor_get_state(cursor, 1, &value_ptr), 0);
+    mu_assert_bool(value_ptr == NULL);
+
+    sky_cursor_free(cursor);
+    return 0;
+
+error:
+    mu_fail("Cursor state iteration failed");
+}
+
+int test_sky_cursor_fixed_state() {
+    void *value_ptr = NULL;
+    sky_cursor *cursor = sky_cursor_create();
+    mu_assert_int_equals(sky_cursor_set_track_state(cursor, true), 0);
+    mu_assert_int_equals(sky_cursor_set_path(cursor, &FIXED_STATE_DATA), 0);
+
+    // Fixed values are packed as MessagePack values.
+    mu_assert_int_equals(sky_cursor_get_state(cursor, 1, &value_ptr), 0);
+    mu_assert_mem(value_ptr, "\xD1\x03\xE8", 3);
+    mu_assert_int_equals(sky_cursor_get_state(cursor, -1, &value_ptr), 0);
+    mu_assert_int_equals(*((uint8_t*)value_ptr), 0xC3);
+    mu_assert_int_equals(sky_cursor_get_state(cursor, 2, &value_ptr), 0);
+    mu_assert_int_equals(*((uint8_t*)value_ptr), 0x05);
+
+    // Object properties persist and action properties are cleared.
+    mu_assert_int_equals(sky_cursor_next(cursor), 0);
+    mu_assert_int_equals(sky_cursor_get_state(cursor, 1, &value_ptr), 0);
+    mu_assert_mem(value_ptr, "\xD1\x03\xE8", 3);
+    mu_assert_int_equals(sky_cursor_get_state(cursor, -1, &value_ptr), 0);
+    mu_assert_bool(value_ptr == NULL);
+    mu_assert_int_equals(sky_cursor_get_state(cursor, 2, &value_ptr), 0);
+    mu_assert_int_equals(*((uint8_t*)value_ptr), 0x06);
+
+    sky_cursor_free(cursor);
+    return 0;
+}
+
 
 //==============================================================================
 //
@@ -80,6 +453,16 @@ int test_sky_cursor_next() {
 
 int all_tests() {
     mu_run_test(test_sky_cursor_next);
+    mu_run_test(test_sky_cursor_next_invalid);
+    mu_run_test(test_sky_cursor_seek_timestamp);
+    mu_run_test(test_sky_cursor_seek_timestamp_spanned);
+    mu_run_test(test_sky_cursor_prev);
+    mu_run_test(test_sky_cursor_next_batch);
+    mu_run_test(test_sky_cursor_fast_next);
+    mu_run_test(test_sky_path_foreach_event);
+    mu_run_test(test_sky_path_foreach_action_only_event);
+    mu_run_test(test_sky_cursor_state);
+    mu_run_test(test_sky_cursor_fixed_state);
     return 0;
 }
 
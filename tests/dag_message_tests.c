@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dag_message.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_dag_message_pack_unpack() {
+    cleantmp();
+    sky_dag_message *message = sky_dag_message_create();
+    message->profile = true;
+    message->compact = true;
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_dag_message_pack(message, file), 0);
+    fclose(file);
+    sky_dag_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_dag_message_create();
+    mu_assert_int_equals(sky_dag_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_bool(message->profile);
+    mu_assert_bool(message->compact);
+    sky_dag_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_dag_message_process() {
+    importtmp("tests/fixtures/dag_message/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    sky_dag_message *message = sky_dag_message_create();
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_dag_message_process(message, table, output), 0);
+
+    //   {status:"ok", data:{
+    //     1:{2:{count:4}, 3:{count:1}},
+    //     2:{3:{count:2}, 4:{count:1}},
+    //     3:{1:{count:1}, 4:{count:1}},
+    //     4:{1:{count:1}}
+    //   }}
+    char expected[] = "\x82" "\xA6" "status" "\xA2" "ok" "\xA4" "data" "\x84"
+        "\x01" "\x82"
+            "\x02" "\x81" "\xA5" "count" "\x04"
+            "\x03" "\x81" "\xA5" "count" "\x01"
+        "\x02" "\x82"
+            "\x03" "\x81" "\xA5" "count" "\x02"
+            "\x04" "\x81" "\xA5" "count" "\x01"
+        "\x03" "\x82"
+            "\x01" "\x81" "\xA5" "count" "\x01"
+            "\x04" "\x81" "\xA5" "count" "\x01"
+        "\x04" "\x81"
+            "\x01" "\x81" "\xA5" "count" "\x01";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected) - 1));
+    mu_assert_mem(output->data, expected, sizeof(expected) - 1);
+    sky_buffer_free(output);
+    sky_dag_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
+int test_sky_dag_message_process_compact() {
+    importtmp("tests/fixtures/dag_message/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    sky_dag_message *message = sky_dag_message_create();
+    message->compact = true;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_dag_message_process(message, table, output), 0);
+
+    // {status:"ok", data:{names:["count"], keys:<...>, subkeys:<...>, values:<...>}}
+    char expected_keys[] = {1, 1, 2, 2, 3, 3, 4};
+    char expected_subkeys[] = {2, 3, 3, 4, 1, 4, 1};
+    char expected_values[] = {4, 1, 2, 1, 1, 1, 1};
+    char *columns[] = {expected_keys, expected_subkeys, expected_values};
+    char expected[512];
+    size_t length = 0;
+    char header[] = "\x82" "\xA6" "status" "\xA2" "ok" "\xA4" "data" "\x84"
+        "\xA5" "names" "\x91" "\xA5" "count";
+    memcpy(expected, header, sizeof(header) - 1);
+    length += sizeof(header) - 1;
+    char *names[] = {"\xA4" "keys", "\xA7" "subkeys", "\xA6" "values"};
+    uint32_t i, j;
+    for(i=0; i<3; i++) {
+        memcpy(&expected[length], names[i], strlen(names[i]));
+        length += strlen(names[i]);
+        memcpy(&expected[length], "\xDA\x00\x38", 3);
+        length += 3;
+        for(j=0; j<7; j++) {
+            memset(&expected[length], 0, 8);
+            expected[length] = columns[i][j];
+            length += 8;
+        }
+    }
+    mu_assert_long_equals((long)output->length, (long)length);
+    mu_assert_mem(output->data, expected, length);
+    sky_buffer_free(output);
+    sky_dag_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_dag_message_pack_unpack);
+    mu_run_test(test_sky_dag_message_process);
+    mu_run_test(test_sky_dag_message_process_compact);
+    return 0;
+}
+
+RUN_TESTS()
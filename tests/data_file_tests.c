@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <dbg.h>
 #include <mem.h>
 #include <data_file.h>
+#include <cursor.h>
 
 #include "minunit.h"
 
@@ -44,6 +46,37 @@
     mu_assert(_block->spanned == SPANNED, ""); \
 } while(0)
 
+#define ASSERT_BLOCK_RANGES(DATA_FILE) do {\
+    sky_data_file *_data_file = DATA_FILE; \
+    uint32_t _i; \
+    for(_i=0; _i<_data_file->block_count; _i++) { \
+        mu_assert_bool(_data_file->block_min_object_ids[_i] == _data_file->blocks[_i]->min_object_id); \
+        mu_assert_bool(_data_file->block_max_object_ids[_i] == _data_file->blocks[_i]->max_object_id); \
+    } \
+} while(0)
+
+// Asserts that the path of an object holds events with the given timestamps
+// in order.
+#define ASSERT_PATH_TIMESTAMPS(DATA_FILE, OBJECT_ID, ...) do {\
+    sky_timestamp_t _expected[] = {__VA_ARGS__}; \
+    uint32_t _i, _count = sizeof(_expected) / sizeof(*_expected); \
+    void **_paths = NULL; \
+    uint32_t _path_count = 0; \
+    mu_assert_int_equals(sky_data_file_find_path(DATA_FILE, OBJECT_ID, &_paths, &_path_count), 0); \
+    sky_cursor _cursor; \
+    sky_cursor_init(&_cursor); \
+    mu_assert_int_equals(sky_cursor_set_paths(&_cursor, _paths, _path_count), 0); \
+    for(_i=0; _i<_count; _i++) { \
+        sky_timestamp_t _timestamp; \
+        mu_assert_bool(!_cursor.eof); \
+        mu_assert_int_equals(sky_cursor_get_timestamp(&_cursor, &_timestamp), 0); \
+        mu_assert_int64_equals(_timestamp, _expected[_i]); \
+        mu_assert_int_equals(sky_cursor_next(&_cursor), 0); \
+    } \
+    mu_assert_bool(_cursor.eof); \
+    free(_paths); \
+} while(0)
+
 #define ASSERT_DATA_FILE(FIXTURE) \
     mu_assert_file("tmp/data", FIXTURE "/data"); \
     mu_assert_file("tmp/header", FIXTURE "/header");
@@ -98,8 +131,9 @@ int test_sky_data_file_load_empty() {
     rc = sky_data_file_load(data_file);
     mu_assert_int_equals(rc, 0);
 
-    mu_assert_bool(data_file->data != NULL);
-    mu_assert_bool(data_file->data_fd != 0);
+    mu_assert_int_equals(data_file->extent_count, 1);
+    mu_assert_bool(data_file->extents[0].data != NULL);
+    mu_assert_bool(data_file->extents[0].fd != 0);
     mu_assert_long_equals(data_file->data_length, 128L);
     mu_assert_bool(data_file->blocks != NULL);
     mu_assert_int_equals(data_file->block_count, 1);
@@ -109,8 +143,8 @@ int test_sky_data_file_load_empty() {
     rc = sky_data_file_unload(data_file);
     mu_assert_int_equals(rc, 0);
     
-    mu_assert_bool(data_file->data == NULL);
-    mu_assert_bool(data_file->data_fd == 0);
+    mu_assert_bool(data_file->extents == NULL);
+    mu_assert_int_equals(data_file->extent_count, 0);
     mu_assert_long_equals(data_file->data_length, 0L);
     mu_assert_bool(data_file->blocks == NULL);
     mu_assert_int_equals(data_file->block_count, 0);
@@ -120,6 +154,154 @@ int test_sky_data_file_load_empty() {
 }
 
 
+//--------------------------------------
+// Growth
+//--------------------------------------
+
+int test_sky_data_file_grows_mapping_geometrically() {
+    cleantmp();
+
+    uint32_t i;
+    sky_block *block = NULL;
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    mu_assert_long_equals(data_file->mapped_length, 128L);
+
+    // Doubles the mapping as blocks are added.
+    for(i=0; i<3; i++) {
+        mu_assert_int_equals(sky_data_file_create_block(data_file, &block), 0);
+    }
+    mu_assert_long_equals(data_file->data_length, 512L);
+    mu_assert_long_equals(data_file->mapped_length, 512L);
+
+    mu_assert_int_equals(sky_data_file_create_block(data_file, &block), 0);
+    mu_assert_long_equals(data_file->data_length, 640L);
+    mu_assert_long_equals(data_file->mapped_length, 1024L);
+
+    // The file on disk only holds the blocks.
+    struct tagbstring path = bsStatic("tmp/data");
+    mu_assert_long_equals(sky_file_get_size(&path), 640L);
+
+    // Adding blocks within the mapping does not remap.
+    void *data = data_file->extents[0].data;
+    mu_assert_int_equals(sky_data_file_create_block(data_file, &block), 0);
+    mu_assert_bool(data_file->extents[0].data == data);
+    mu_assert_long_equals(data_file->mapped_length, 1024L);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+int test_sky_data_file_adds_extents() {
+    cleantmp();
+
+    uint32_t i;
+    void *ptr = NULL;
+    sky_block *block = NULL;
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->extent_block_count = 2;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    void *data = data_file->extents[0].data;
+
+    // Blocks past the first extent go into new extent files.
+    for(i=0; i<4; i++) {
+        mu_assert_int_equals(sky_data_file_create_block(data_file, &block), 0);
+    }
+    mu_assert_int_equals(data_file->extent_count, 3);
+    mu_assert_long_equals(data_file->data_length, 640L);
+    mu_assert_long_equals(data_file->extents[2].data_length, 128L);
+    mu_assert_bool(data_file->extents[0].data == data);
+
+    struct tagbstring path0 = bsStatic("tmp/data");
+    struct tagbstring path1 = bsStatic("tmp/data.1");
+    struct tagbstring path2 = bsStatic("tmp/data.2");
+    mu_assert_long_equals(sky_file_get_size(&path0), 256L);
+    mu_assert_long_equals(sky_file_get_size(&path1), 256L);
+    mu_assert_long_equals(sky_file_get_size(&path2), 128L);
+
+    // Blocks are addressed within their extent.
+    mu_assert_int_equals(block->index, 4);
+    mu_assert_int_equals(sky_block_get_ptr(block, &ptr), 0);
+    mu_assert_bool(ptr == data_file->extents[2].data);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+int test_sky_data_file_create_blocks() {
+    cleantmp();
+
+    sky_block *blocks[3];
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+
+    // Creates every block with a single growth of the mapping.
+    mu_assert_int_equals(sky_data_file_create_blocks(data_file, 3, blocks), 0);
+    mu_assert_int_equals(data_file->block_count, 4);
+    mu_assert_long_equals(data_file->data_length, 512L);
+    mu_assert_long_equals(data_file->mapped_length, 512L);
+    mu_assert_int_equals(blocks[0]->index, 1);
+    mu_assert_int_equals(blocks[1]->index, 2);
+    mu_assert_int_equals(blocks[2]->index, 3);
+    ASSERT_BLOCK_RANGES(data_file);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+int test_sky_data_file_keeps_memory_for_readers() {
+    cleantmp();
+
+    uint32_t i;
+    sky_block *block = NULL;
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    for(i=0; i<3; i++) {
+        mu_assert_int_equals(sky_data_file_create_block(data_file, &block), 0);
+    }
+    mu_assert_int_equals(data_file->epoch->retiree_count, 0);
+
+    // A reader keeps its block array and mapping while the data file grows.
+    uint64_t epoch = sky_epoch_enter(data_file->epoch);
+    sky_block **blocks = data_file->blocks;
+    void *data = data_file->extents[0].data;
+    memset(data, 1, 512);
+    mu_assert_int_equals(sky_data_file_create_block(data_file, &block), 0);
+    mu_assert_long_equals(data_file->mapped_length, 1024L);
+    mu_assert_bool(data_file->blocks != blocks);
+    mu_assert_bool(data_file->extents[0].data != data);
+    mu_assert_bool(data_file->epoch->retiree_count > 0);
+    for(i=0; i<4; i++) {
+        mu_assert_int_equals(blocks[i]->position, i);
+    }
+    mu_assert_int_equals(((uint8_t*)data)[511], 1);
+    mu_assert_int_equals(((uint8_t*)data_file->extents[0].data)[511], 1);
+
+    // The memory is released once the reader is done.
+    sky_epoch_exit(data_file->epoch, epoch);
+    mu_assert_int_equals(sky_data_file_flush(data_file), 0);
+    mu_assert_int_equals(data_file->epoch->retiree_count, 0);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
 //--------------------------------------
 // Add Event (New Block)
 //--------------------------------------
@@ -133,6 +315,23 @@ int test_sky_data_file_add_event_to_new_block() {
     return 0;
 }
 
+int test_sky_data_file_add_event_bumps_write_version() {
+    sky_data_file *data_file;
+    INIT_DATA_FILE("", 64);
+    uint64_t version = data_file->write_version;
+    mu_assert_bool(version > 0);
+    ADD_EVENT(3LL, 10LL, 20);
+    mu_assert_bool(data_file->write_version > version);
+    version = data_file->write_version;
+    sky_data_file_free(data_file);
+
+    // A reloaded data file never reuses an earlier version.
+    INIT_DATA_FILE("", 64);
+    mu_assert_bool(data_file->write_version > version);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
 
 //--------------------------------------
 // Add Event (Existing Path)
@@ -189,6 +388,7 @@ int test_sky_data_file_add_event_to_starting_path_causing_block_split() {
     INIT_DATA_FILE("tests/fixtures/data_files/2/a", 0);
     ADD_EVENT(3, 12LL, 20);
     ASSERT_DATA_FILE("tests/fixtures/data_files/2/b");
+    ASSERT_BLOCK_RANGES(data_file);
     sky_data_file_free(data_file);
     return 0;
 }
@@ -250,7 +450,7 @@ int test_sky_data_file_add_small_event_to_new_ending_path_causing_block_split()
 int test_sky_data_file_add_medium_event_to_new_ending_path_causing_block_split() {
     sky_data_file *data_file;
     INIT_DATA_FILE("tests/fixtures/data_files/2/e", 0);
-    ADD_EVENT_WITH_DATA(15LL, 12LL, 20, 30, "123456789012345678901234567890123456789012345678901234567890123");
+    ADD_EVENT_WITH_DATA(15LL, 12LL, 20, 30, "1234567890123456789012345678901234567890123456789012345678901234567");
     ASSERT_DATA_FILE("tests/fixtures/data_files/2/j");
     sky_data_file_free(data_file);
     return 0;
@@ -259,7 +459,7 @@ int test_sky_data_file_add_medium_event_to_new_ending_path_causing_block_split()
 int test_sky_data_file_add_large_event_to_new_ending_path_causing_block_split() {
     sky_data_file *data_file;
     INIT_DATA_FILE("tests/fixtures/data_files/2/e", 0);
-    ADD_EVENT_WITH_DATA(15LL, 12LL, 20, 30, "1234567890123456789012345678901234567890123456789012345678901234");
+    ADD_EVENT_WITH_DATA(15LL, 12LL, 20, 30, "12345678901234567890123456789012345678901234567890123456789012345678");
     ASSERT_DATA_FILE("tests/fixtures/data_files/2/k");
     sky_data_file_free(data_file);
     return 0;
@@ -275,10 +475,19 @@ int test_sky_data_file_add_event_to_start_of_starting_path_causing_block_span()
     INIT_DATA_FILE("tests/fixtures/data_files/spanning/a", 0);
     ADD_EVENT_WITH_DATA(3, 7LL, 20, 30, "1234567890");
     ASSERT_DATA_FILE("tests/fixtures/data_files/spanning/b");
-    mu_assert_int_equals(data_file->block_count, 3);
+    mu_assert_int_equals(data_file->block_count, 4);
     ASSERT_BLOCK(data_file, 0, 0, true);
     ASSERT_BLOCK(data_file, 1, 1, true);
-    ASSERT_BLOCK(data_file, 2, 2, false);
+    ASSERT_BLOCK(data_file, 2, 2, true);
+    ASSERT_BLOCK(data_file, 3, 3, false);
+    ASSERT_BLOCK_RANGES(data_file);
+    uint32_t span_count = 0;
+    mu_assert_int_equals(sky_block_get_span_count(data_file->blocks[0], &span_count), 0);
+    mu_assert_int_equals(span_count, 3);
+    mu_assert_int_equals(sky_block_get_span_count(data_file->blocks[1], &span_count), 0);
+    mu_assert_int_equals(span_count, 2);
+    mu_assert_int_equals(sky_block_get_span_count(data_file->blocks[3], &span_count), 0);
+    mu_assert_int_equals(span_count, 1);
     sky_data_file_free(data_file);
     return 0;
 }
@@ -301,10 +510,11 @@ int test_sky_data_file_add_medium_event_to_middle_of_starting_path_causing_block
     INIT_DATA_FILE("tests/fixtures/data_files/spanning/a", 0);
     ADD_EVENT_WITH_DATA(3, 9LL, 20, 30, "1234567890123456789012345678");
     ASSERT_DATA_FILE("tests/fixtures/data_files/spanning/d");
-    mu_assert_int_equals(data_file->block_count, 3);
+    mu_assert_int_equals(data_file->block_count, 4);
     ASSERT_BLOCK(data_file, 0, 0, true);
     ASSERT_BLOCK(data_file, 1, 1, true);
-    ASSERT_BLOCK(data_file, 2, 2, false);
+    ASSERT_BLOCK(data_file, 2, 2, true);
+    ASSERT_BLOCK(data_file, 3, 3, false);
     sky_data_file_free(data_file);
     return 0;
 }
@@ -341,10 +551,11 @@ int test_sky_data_file_add_medium_event_to_end_of_starting_path_causing_block_sp
     INIT_DATA_FILE("tests/fixtures/data_files/spanning/a", 0);
     ADD_EVENT_WITH_DATA(3, 12LL, 20, 30, "1234567890123456789012345678");
     ASSERT_DATA_FILE("tests/fixtures/data_files/spanning/g");
-    mu_assert_int_equals(data_file->block_count, 3);
+    mu_assert_int_equals(data_file->block_count, 4);
     ASSERT_BLOCK(data_file, 0, 0, true);
     ASSERT_BLOCK(data_file, 1, 1, true);
-    ASSERT_BLOCK(data_file, 2, 2, false);
+    ASSERT_BLOCK(data_file, 2, 2, true);
+    ASSERT_BLOCK(data_file, 3, 3, false);
     sky_data_file_free(data_file);
     return 0;
 }
@@ -352,12 +563,13 @@ int test_sky_data_file_add_medium_event_to_end_of_starting_path_causing_block_sp
 int test_sky_data_file_add_large_event_to_end_of_starting_path_causing_block_span() {
     sky_data_file *data_file;
     INIT_DATA_FILE("tests/fixtures/data_files/spanning/a", 0);
-    ADD_EVENT_WITH_DATA(3, 12LL, 20, 30, "1234567890123456789012345678901234567");
+    ADD_EVENT_WITH_DATA(3, 12LL, 20, 30, "1234567890123456789012345678901");
     ASSERT_DATA_FILE("tests/fixtures/data_files/spanning/h");
-    mu_assert_int_equals(data_file->block_count, 3);
+    mu_assert_int_equals(data_file->block_count, 4);
     ASSERT_BLOCK(data_file, 0, 0, true);
     ASSERT_BLOCK(data_file, 1, 1, true);
-    ASSERT_BLOCK(data_file, 2, 2, false);
+    ASSERT_BLOCK(data_file, 2, 2, true);
+    ASSERT_BLOCK(data_file, 3, 3, false);
     sky_data_file_free(data_file);
     return 0;
 }
@@ -389,6 +601,830 @@ int test_sky_data_file_add_event_to_end_of_ending_path_causing_block_span() {
 }
 
 
+//--------------------------------------
+// Block Sorting
+//--------------------------------------
+
+int test_sky_data_file_sort_block() {
+    uint32_t i;
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_count = 4;
+    data_file->blocks = calloc(data_file->block_count, sizeof(sky_block*));
+    for(i=0; i<data_file->block_count; i++) {
+        sky_block *block = sky_block_create(data_file);
+        block->index = block->position = i;
+        block->min_object_id = block->max_object_id = (i+1) * 10;
+        data_file->blocks[i] = block;
+    }
+
+    // Move the first block to the end.
+    sky_block *block = data_file->blocks[0];
+    block->min_object_id = block->max_object_id = 50;
+    mu_assert_int_equals(sky_data_file_sort_block(data_file, block), 0);
+    mu_assert_int_equals(data_file->blocks[0]->index, 1);
+    mu_assert_int_equals(data_file->blocks[3]->index, 0);
+
+    // Move it back to the start.
+    block->min_object_id = block->max_object_id = 5;
+    mu_assert_int_equals(sky_data_file_sort_block(data_file, block), 0);
+    for(i=0; i<data_file->block_count; i++) {
+        mu_assert_int_equals(data_file->blocks[i]->index, i);
+        mu_assert_int_equals(data_file->blocks[i]->position, i);
+    }
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Path Lookup
+//--------------------------------------
+
+int test_sky_data_file_find_path() {
+    loadtmp("tests/fixtures/path_iterator/1");
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+
+    // Path in a multi-object block.
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    mu_assert_long_equals(paths[0]-data_file->extents[0].data, 23L);
+    mu_assert_bool(data_file->blocks[0]->bloom_valid);
+    free(paths);
+
+    // Spanned path.
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 4, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 2);
+    mu_assert_long_equals(paths[0]-data_file->extents[0].data, 64L);
+    mu_assert_long_equals(paths[1]-data_file->extents[0].data, 192L);
+    free(paths);
+
+    // Missing paths.
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 1, &paths, &path_count), 0);
+    mu_assert_bool(paths == NULL);
+    mu_assert_int_equals(path_count, 0);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 6, &paths, &path_count), 0);
+    mu_assert_bool(paths == NULL);
+    mu_assert_int_equals(path_count, 0);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Compaction
+//--------------------------------------
+
+int test_sky_data_file_compact() {
+    loadtmp("tests/fixtures/path_iterator/1");
+    void **paths = NULL;
+    uint32_t i, path_count = 0;
+    struct tagbstring compact_path = bsStatic("tmp/data.compact");
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+
+    // Keep a copy of the last path to compare against after compaction.
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 5, &paths, &path_count), 0);
+    size_t sz = sky_path_sizeof_raw(paths[0]);
+    void *path = malloc(sz);
+    memcpy(path, paths[0], sz);
+    free(paths);
+
+    // Blocks are renumbered in object id order and spans are kept.
+    mu_assert_int_equals(sky_data_file_compact(data_file, 100, 0), 0);
+    mu_assert_int_equals(data_file->block_count, 4);
+    for(i=0; i<data_file->block_count; i++) {
+        mu_assert_int_equals(data_file->blocks[i]->index, i);
+    }
+    ASSERT_BLOCK(data_file, 0, 0, false);
+    ASSERT_BLOCK(data_file, 1, 1, true);
+    ASSERT_BLOCK(data_file, 2, 2, true);
+    ASSERT_BLOCK(data_file, 3, 3, false);
+    mu_assert_bool(!sky_file_exists(&compact_path));
+
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 4, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 2);
+    mu_assert_long_equals(paths[0]-data_file->extents[0].data, 64L);
+    mu_assert_long_equals(paths[1]-data_file->extents[0].data, 128L);
+    free(paths);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 5, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    mu_assert_long_equals(paths[0]-data_file->extents[0].data, 192L);
+    mu_assert_mem(paths[0], path, sz);
+    free(paths);
+    free(path);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_data_file_compact_fill_factor() {
+    cleantmp();
+    void **paths = NULL;
+    uint32_t i, path_count = 0;
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+
+    // Splits leave the blocks partly full.
+    for(i=0; i<40; i++) {
+        ADD_EVENT(40-i, 10LL, 20);
+    }
+    uint32_t block_count = data_file->block_count;
+
+    // Packing the blocks completely uses fewer blocks than a lower fill factor.
+    mu_assert_int_equals(sky_data_file_compact(data_file, 50, 0), 0);
+    uint32_t half_block_count = data_file->block_count;
+    mu_assert_int_equals(sky_data_file_compact(data_file, 100, 0), 0);
+    mu_assert_bool(data_file->block_count < half_block_count);
+    mu_assert_bool(data_file->block_count < block_count);
+
+    for(i=1; i<=40; i++) {
+        mu_assert_int_equals(sky_data_file_find_path(data_file, i, &paths, &path_count), 0);
+        mu_assert_int_equals(path_count, 1);
+        free(paths);
+    }
+    for(i=1; i<data_file->block_count; i++) {
+        mu_assert_bool(data_file->blocks[i-1]->max_object_id < data_file->blocks[i]->min_object_id);
+        mu_assert_int_equals(data_file->blocks[i]->index, i);
+    }
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Durability
+//--------------------------------------
+
+int test_sky_data_file_group_durability_defers_sync_until_flush() {
+    sky_data_file *data_file;
+    INIT_DATA_FILE("", 64);
+    mu_assert_int_equals(sky_data_file_set_durability(data_file, SKY_DURABILITY_GROUP), 0);
+    ADD_EVENT(3LL, 10LL, 20);
+    mu_assert_int_equals(data_file->unflushed_event_count, 1);
+    mu_assert_bool(data_file->blocks[0]->dirty);
+    mu_assert_int_equals(sky_data_file_flush(data_file), 0);
+    mu_assert_int_equals(data_file->unflushed_event_count, 0);
+    mu_assert_bool(!data_file->blocks[0]->dirty);
+    mu_assert_bool(!data_file->blocks[0]->header_dirty);
+    ASSERT_DATA_FILE("tests/fixtures/data_files/1/a");
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_data_file_async_durability_flushes_on_unload() {
+    sky_data_file *data_file;
+    INIT_DATA_FILE("", 64);
+    mu_assert_int_equals(sky_data_file_set_durability(data_file, SKY_DURABILITY_ASYNC), 0);
+    ADD_EVENT(3LL, 10LL, 20);
+    mu_assert_bool(data_file->blocks[0]->dirty);
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+    ASSERT_DATA_FILE("tests/fixtures/data_files/1/a");
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Memory Advice
+//--------------------------------------
+
+int test_sky_data_file_memory_advice() {
+    sky_data_file *data_file;
+    INIT_DATA_FILE("", 64);
+    mu_assert_int_equals(sky_data_file_set_access_pattern(data_file, SKY_ACCESS_PATTERN_RANDOM), 0);
+    mu_assert_int_equals(sky_data_file_set_preload(data_file, true), 0);
+    mu_assert_int_equals(sky_data_file_set_huge_pages(data_file, true), 0);
+    mu_assert_int_equals(data_file->access_pattern, SKY_ACCESS_PATTERN_RANDOM);
+    mu_assert_bool(data_file->preload);
+    mu_assert_bool(data_file->huge_pages);
+
+    // Advice is only a hint and does not change the data.
+    ADD_EVENT(3LL, 10LL, 20);
+    mu_assert_int_equals(sky_data_file_set_access_pattern(data_file, SKY_ACCESS_PATTERN_SEQUENTIAL), 0);
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+    ASSERT_DATA_FILE("tests/fixtures/data_files/1/a");
+
+    // Settings are kept and applied when the data file is reloaded.
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    mu_assert_int_equals(data_file->access_pattern, SKY_ACCESS_PATTERN_SEQUENTIAL);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Timestamp Deltas
+//--------------------------------------
+
+// Adds events to a path that spans several blocks and returns the number of
+// blocks it needed. The last events are inserted before events that are
+// already in the path.
+int add_spanning_events(uint32_t version, uint32_t *block_count) {
+    int i;
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    cleantmp();
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    data_file->version = version;
+    ADD_EVENT(2LL, 0LL, 1);
+    ADD_EVENT(4LL, 0LL, 1);
+    for(i=0; i<60; i++) {
+        if(i % 10 != 5) {
+            ADD_EVENT(3LL, (sky_timestamp_t)(i * 1000), i + 1);
+        }
+    }
+    for(i=55; i>=0; i-=10) {
+        ADD_EVENT(3LL, (sky_timestamp_t)(i * 1000), i + 1);
+    }
+
+    // Every event is read back in order with its own timestamp.
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), 0);
+    mu_assert_bool(path_count > 1);
+    sky_cursor cursor;
+    sky_cursor_init(&cursor);
+    mu_assert_int_equals(sky_cursor_set_paths(&cursor, paths, path_count), 0);
+    for(i=0; i<60; i++) {
+        sky_timestamp_t timestamp;
+        sky_action_id_t action_id;
+        mu_assert_bool(!cursor.eof);
+        mu_assert_int_equals(sky_cursor_get_timestamp(&cursor, &timestamp), 0);
+        mu_assert_int_equals(sky_cursor_get_action_id(&cursor, &action_id), 0);
+        mu_assert_int64_equals(timestamp, (sky_timestamp_t)(i * 1000));
+        mu_assert_int_equals(action_id, i + 1);
+        mu_assert_int_equals(sky_cursor_next(&cursor), 0);
+    }
+    mu_assert_bool(cursor.eof);
+    free(paths);
+
+    *block_count = data_file->block_count;
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_data_file_delta_timestamps() {
+    uint32_t block_count = 0;
+    uint32_t legacy_block_count = 0;
+    mu_assert_int_equals(add_spanning_events(1, &legacy_block_count), 0);
+    mu_assert_int_equals(add_spanning_events(SKY_DATA_FILE_VERSION, &block_count), 0);
+    mu_assert_bool(block_count < legacy_block_count);
+    return 0;
+}
+
+
+//--------------------------------------
+// Block Sizing
+//--------------------------------------
+
+int test_sky_data_file_recommend_block_size() {
+    cleantmp();
+    uint32_t i, block_size = 0;
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 1024;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+
+    // An empty data file keeps the default.
+    mu_assert_int_equals(sky_data_file_recommend_block_size(data_file, &block_size), 0);
+    mu_assert_int_equals(block_size, SKY_DEFAULT_BLOCK_SIZE);
+
+    // The parts of spanned paths are counted together.
+    for(i=0; i<400; i++) {
+        ADD_EVENT_WITH_DATA(100, (sky_timestamp_t)i, 1, 1, "1234567890");
+    }
+    mu_assert_bool(data_file->blocks[0]->spanned);
+    mu_assert_int_equals(sky_data_file_recommend_block_size(data_file, &block_size), 0);
+    mu_assert_int_equals(block_size, 32768);
+
+    // Block sizes are chosen for most paths rather than the largest.
+    for(i=1; i<=40; i++) {
+        ADD_EVENT(i, 1LL, 1);
+    }
+    mu_assert_int_equals(sky_data_file_recommend_block_size(data_file, &block_size), 0);
+    mu_assert_int_equals(block_size, SKY_MIN_RECOMMENDED_BLOCK_SIZE);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Event Removal
+//--------------------------------------
+
+int test_sky_data_file_remove_events() {
+    uint32_t count = 0;
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    cleantmp();
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    ADD_EVENT(1LL, 10LL, 1);
+    ADD_EVENT(1LL, 20LL, 2);
+    ADD_EVENT(1LL, 20LL, 3);
+    ADD_EVENT(1LL, 1000LL, 4);
+    ADD_EVENT(2LL, 5LL, 1);
+
+    // Missing events are ignored.
+    uint64_t write_version = data_file->write_version;
+    mu_assert_int_equals(sky_data_file_remove_events(data_file, 1, 15LL, &count), 0);
+    mu_assert_int_equals(count, 0);
+    mu_assert_int_equals(sky_data_file_remove_events(data_file, 3, 10LL, &count), 0);
+    mu_assert_int_equals(count, 0);
+    mu_assert_bool(data_file->write_version == write_version);
+
+    // Every event at the timestamp is removed and the next delta grows.
+    mu_assert_int_equals(sky_data_file_remove_events(data_file, 1, 20LL, &count), 0);
+    mu_assert_int_equals(count, 2);
+    mu_assert_bool(data_file->write_version > write_version);
+    ASSERT_PATH_TIMESTAMPS(data_file, 1, 10LL, 1000LL);
+    ASSERT_PATH_TIMESTAMPS(data_file, 2, 5LL);
+
+    // Removing the first event stores the full timestamp of the next one.
+    mu_assert_int_equals(sky_data_file_remove_events(data_file, 1, 10LL, &count), 0);
+    mu_assert_int_equals(count, 1);
+    ASSERT_PATH_TIMESTAMPS(data_file, 1, 1000LL);
+    mu_assert_bool(data_file->blocks[0]->min_timestamp == 5LL);
+    mu_assert_bool(data_file->blocks[0]->max_timestamp == 1000LL);
+
+    // Removing the last event removes the path.
+    mu_assert_int_equals(sky_data_file_remove_events(data_file, 1, 1000LL, &count), 0);
+    mu_assert_int_equals(count, 1);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 1, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    ASSERT_PATH_TIMESTAMPS(data_file, 2, 5LL);
+    mu_assert_bool(data_file->blocks[0]->min_object_id == 2LL);
+    ASSERT_BLOCK_RANGES(data_file);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_data_file_remove_events_merges_span() {
+    uint32_t i, count = 0;
+    cleantmp();
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    for(i=0; i<20; i++) {
+        ADD_EVENT_WITH_DATA(3LL, (sky_timestamp_t)i, 1, 1, "1234567890");
+    }
+    mu_assert_bool(data_file->block_count > 2);
+    mu_assert_bool(data_file->blocks[0]->spanned);
+
+    // Shrinking the span moves its parts together and empties blocks.
+    for(i=0; i<20; i++) {
+        if(i != 2 && i != 17) {
+            mu_assert_int_equals(sky_data_file_remove_events(data_file, 3, (sky_timestamp_t)i, &count), 0);
+            mu_assert_int_equals(count, 1);
+        }
+    }
+    ASSERT_PATH_TIMESTAMPS(data_file, 3, 2LL, 17LL);
+    for(i=0; i<data_file->block_count; i++) {
+        mu_assert_bool(!data_file->blocks[i]->spanned);
+    }
+    sky_block *block = data_file->blocks[data_file->block_count-1];
+    mu_assert_bool(block->min_object_id == 3LL);
+    mu_assert_bool(block->min_timestamp == 2LL);
+    mu_assert_bool(block->max_timestamp == 17LL);
+    mu_assert_bool(data_file->blocks[0]->min_object_id == 0LL);
+    ASSERT_BLOCK_RANGES(data_file);
+
+    // New events still go into the remaining block.
+    ADD_EVENT(3LL, 30LL, 1);
+    ASSERT_PATH_TIMESTAMPS(data_file, 3, 2LL, 17LL, 30LL);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_data_file_remove_object() {
+    uint32_t i;
+    bool removed = false;
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    cleantmp();
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    ADD_EVENT(1LL, 10LL, 1);
+    ADD_EVENT(2LL, 20LL, 1);
+    ADD_EVENT(4LL, 40LL, 1);
+    for(i=0; i<20; i++) {
+        ADD_EVENT_WITH_DATA(3LL, (sky_timestamp_t)i, 1, 1, "1234567890");
+    }
+
+    // Paths in a multi-object block are removed from the middle.
+    mu_assert_int_equals(sky_data_file_remove_object(data_file, 2, &removed), 0);
+    mu_assert_bool(removed);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 2, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    ASSERT_PATH_TIMESTAMPS(data_file, 1, 10LL);
+    ASSERT_PATH_TIMESTAMPS(data_file, 4, 40LL);
+
+    // Spanned paths are removed from every block.
+    mu_assert_int_equals(sky_data_file_remove_object(data_file, 3, &removed), 0);
+    mu_assert_bool(removed);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    for(i=0; i<data_file->block_count; i++) {
+        mu_assert_bool(!data_file->blocks[i]->spanned);
+    }
+    ASSERT_PATH_TIMESTAMPS(data_file, 1, 10LL);
+    ASSERT_PATH_TIMESTAMPS(data_file, 4, 40LL);
+    ASSERT_BLOCK_RANGES(data_file);
+
+    // Removing a missing object does nothing.
+    mu_assert_int_equals(sky_data_file_remove_object(data_file, 3, &removed), 0);
+    mu_assert_bool(!removed);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Retention
+//--------------------------------------
+
+int test_sky_data_file_expire() {
+    uint32_t i, count = 0;
+    cleantmp();
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    for(i=0; i<20; i++) {
+        ADD_EVENT_WITH_DATA(3LL, (sky_timestamp_t)(i * 10), 1, 1, "1234567890");
+    }
+    ADD_EVENT(5LL, 500LL, 1);
+    uint32_t block_count = data_file->block_count;
+    mu_assert_bool(block_count > 3);
+
+    // Nothing is dropped before the oldest event.
+    mu_assert_int_equals(sky_data_file_expire(data_file, 0LL, &count), 0);
+    mu_assert_int_equals(count, 0);
+
+    // Only blocks that have entirely expired are dropped.
+    uint64_t write_version = data_file->write_version;
+    mu_assert_int_equals(sky_data_file_expire(data_file, 185LL, &count), 0);
+    mu_assert_bool(count > 0 && count < block_count - 1);
+    mu_assert_bool(data_file->write_version > write_version);
+    mu_assert_int_equals(data_file->block_count, block_count);
+    for(i=0; i<count; i++) {
+        mu_assert_bool(data_file->blocks[i]->min_object_id == 0LL);
+        mu_assert_bool(!data_file->blocks[i]->spanned);
+    }
+    for(i=count; i<data_file->block_count; i++) {
+        mu_assert_bool(data_file->blocks[i]->max_timestamp >= 185LL);
+    }
+    sky_block *block = data_file->blocks[count];
+    mu_assert_bool(block->min_object_id == 3LL);
+    mu_assert_bool(!block->spanned);
+    ASSERT_BLOCK_RANGES(data_file);
+    ASSERT_PATH_TIMESTAMPS(data_file, 5, 500LL);
+
+    // Dropped blocks are reclaimed by compaction, which trims the rest.
+    mu_assert_int_equals(sky_data_file_compact(data_file, 100, 185LL), 0);
+    mu_assert_int_equals(data_file->block_count, 1);
+    ASSERT_PATH_TIMESTAMPS(data_file, 3, 190LL);
+    ASSERT_PATH_TIMESTAMPS(data_file, 5, 500LL);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_data_file_compact_trims_expired_events() {
+    cleantmp();
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    ADD_EVENT(1LL, 10LL, 1);
+    ADD_EVENT(1LL, 20LL, 2);
+    ADD_EVENT(1LL, 30LL, 3);
+    ADD_EVENT(2LL, 10LL, 1);
+    ADD_EVENT(3LL, 40LL, 1);
+
+    mu_assert_int_equals(sky_data_file_compact(data_file, 100, 25LL), 0);
+    ASSERT_PATH_TIMESTAMPS(data_file, 1, 30LL);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 2, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    ASSERT_PATH_TIMESTAMPS(data_file, 3, 40LL);
+    mu_assert_bool(data_file->blocks[0]->min_timestamp == 30LL);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Block Compression
+//--------------------------------------
+
+int test_sky_data_file_compress() {
+    int i;
+    bool compressed;
+    uint32_t count = 0;
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    cleantmp();
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 16384;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    for(i=0; i<100; i++) {
+        ADD_EVENT_WITH_DATA(3LL, (sky_timestamp_t)i, 20, 1, "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz");
+    }
+    mu_assert_int_equals(data_file->block_count, 1);
+    void *original = calloc(1, data_file->block_size);
+    memcpy(original, data_file->extents[0].data, data_file->block_size);
+
+    // Blocks written recently are not idle yet.
+    mu_assert_int_equals(sky_data_file_compress(data_file, 3600, 0, &count), 0);
+    mu_assert_int_equals(count, 0);
+
+    // Idle blocks are compressed in place and read through the cache.
+    mu_assert_int_equals(sky_data_file_compress(data_file, 0, 0, &count), 0);
+    mu_assert_int_equals(count, 1);
+    mu_assert_int_equals(sky_block_is_compressed(data_file->blocks[0], &compressed), 0);
+    mu_assert_bool(compressed);
+    mu_assert_bool(memcmp(original, data_file->extents[0].data, data_file->block_size) != 0);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    mu_assert_bool(memcmp(original, paths[0], data_file->block_size) == 0);
+    mu_assert_int_equals(data_file->block_cache->entry_count, 1);
+    free(paths);
+    sky_data_file_release_cache(data_file);
+
+    // Compression is detected after a reload.
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    mu_assert_int_equals(sky_block_is_compressed(data_file->blocks[0], &compressed), 0);
+    mu_assert_bool(compressed);
+
+    // Writing to a compressed block decompresses it.
+    ADD_EVENT(3LL, 100LL, 21);
+    mu_assert_int_equals(sky_block_is_compressed(data_file->blocks[0], &compressed), 0);
+    mu_assert_bool(!compressed);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    mu_assert_bool(paths[0] == data_file->extents[0].data);
+    free(paths);
+
+    free(original);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Checksums
+//--------------------------------------
+
+int test_sky_data_file_checksums() {
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    struct tagbstring checksum_path = bsStatic("tmp/header.crc");
+    sky_data_file *data_file;
+    INIT_DATA_FILE("", 64);
+    ADD_EVENT(3LL, 10LL, 20);
+    ADD_EVENT(3LL, 11LL, 21);
+
+    // Checksums are only calculated when the data file is flushed.
+    mu_assert_bool(!data_file->blocks[0]->checksum_valid);
+    mu_assert_bool(data_file->blocks[0]->checksum_stale);
+    mu_assert_int_equals(sky_data_file_flush(data_file), 0);
+    mu_assert_bool(data_file->blocks[0]->checksum_valid);
+    mu_assert_bool(!data_file->blocks[0]->checksum_stale);
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+    mu_assert_bool(sky_file_exists(&checksum_path));
+
+    // Blocks are verified the first time they are read after a load.
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    mu_assert_bool(data_file->blocks[0]->checksum_valid);
+    mu_assert_bool(!data_file->blocks[0]->checksum_verified);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    mu_assert_bool(data_file->blocks[0]->checksum_verified);
+    free(paths);
+    paths = NULL;
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+
+    // A damaged block fails every time it is read.
+    FILE *file = fopen("tmp/data", "r+");
+    mu_assert_bool(file != NULL);
+    fseek(file, 16, SEEK_SET);
+    fputc(0x7F, file);
+    fclose(file);
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), -1);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), -1);
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+
+    // Data files without a checksum file are read without verification.
+    mu_assert_int_equals(sky_file_rm(&checksum_path), 0);
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    mu_assert_bool(!data_file->blocks[0]->checksum_valid);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_data_file_checksums_after_split() {
+    uint32_t i;
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_data_file *data_file;
+    INIT_DATA_FILE("", 64);
+
+    // Paths grow in turn so blocks split with events for every range.
+    for(i=0; i<40; i++) {
+        ADD_EVENT((sky_object_id_t)(1 + (i % 8)), (sky_timestamp_t)(10 + i), 20);
+    }
+    mu_assert_bool(data_file->block_count > 1);
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+
+    // Every block that had data moved out of it or into it still verifies.
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    for(i=1; i<=8; i++) {
+        mu_assert_int_equals(sky_data_file_find_path(data_file, i, &paths, &path_count), 0);
+        mu_assert_bool(path_count > 0);
+        free(paths);
+        paths = NULL;
+    }
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Journal
+//--------------------------------------
+
+int test_sky_data_file_journal() {
+    struct tagbstring header_path = bsStatic("tmp/header");
+    struct tagbstring journal_path = bsStatic("tmp/header.journal");
+    struct tagbstring old_header_path = bsStatic("tmp/header.old");
+    struct tagbstring old_journal_path = bsStatic("tmp/header.journal.old");
+    sky_data_file *data_file;
+    INIT_DATA_FILE("", 64);
+    ADD_EVENT(3LL, 10LL, 20);
+    mu_assert_int_equals(data_file->journal_length, 1);
+    mu_assert_bool(data_file->blocks[0]->journaled);
+
+    // A checkpoint empties the journal.
+    mu_assert_int_equals(sky_data_file_flush(data_file), 0);
+    mu_assert_int_equals(data_file->journal_length, 0);
+    mu_assert_bool(!data_file->blocks[0]->journaled);
+    mu_assert_int_equals((int)sky_file_get_size(&journal_path), 0);
+    mu_assert_int_equals(sky_file_cp(&header_path, &old_header_path), 0);
+
+    // Each block is only journaled once between checkpoints.
+    ADD_EVENT(5LL, 20LL, 20);
+    ADD_EVENT(3LL, 5LL, 20);
+    mu_assert_int_equals(data_file->journal_length, 1);
+    mu_assert_int_equals((int)sky_file_get_size(&journal_path), 4);
+    mu_assert_int_equals(sky_file_cp(&journal_path, &old_journal_path), 0);
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+
+    // Stopping before the header entry is written leaves a stale header and
+    // the journal. Only the journaled blocks are rebuilt on load.
+    mu_assert_int_equals(rename("tmp/header.old", "tmp/header"), 0);
+    mu_assert_int_equals(rename("tmp/header.journal.old", "tmp/header.journal"), 0);
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    mu_assert_bool(!data_file->recovery_pending);
+    mu_assert_int_equals(data_file->journal_length, 0);
+    mu_assert_int_equals((int)sky_file_get_size(&journal_path), 0);
+    mu_assert_int64_equals(data_file->blocks[0]->min_object_id, 3LL);
+    mu_assert_int64_equals(data_file->blocks[0]->max_object_id, 5LL);
+    mu_assert_int64_equals(data_file->blocks[0]->min_timestamp, 5LL);
+    mu_assert_int64_equals(data_file->blocks[0]->max_timestamp, 20LL);
+    ASSERT_BLOCK_RANGES(data_file);
+    ASSERT_PATH_TIMESTAMPS(data_file, 3, 5LL, 10LL);
+
+    // The rebuilt entries were written back.
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    mu_assert_int64_equals(data_file->blocks[0]->max_object_id, 5LL);
+    mu_assert_int64_equals(data_file->blocks[0]->min_timestamp, 5LL);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_data_file_journal_split() {
+    struct tagbstring header_path = bsStatic("tmp/header");
+    struct tagbstring journal_path = bsStatic("tmp/header.journal");
+    struct tagbstring checksum_path = bsStatic("tmp/header.crc");
+    struct tagbstring old_header_path = bsStatic("tmp/header.old");
+    struct tagbstring old_journal_path = bsStatic("tmp/header.journal.old");
+    struct tagbstring old_checksum_path = bsStatic("tmp/header.crc.old");
+    sky_data_file *data_file;
+    INIT_DATA_FILE("", 64);
+    ADD_EVENT(3LL, 10LL, 20);
+    ADD_EVENT(3LL, 11LL, 20);
+    ADD_EVENT(4LL, 10LL, 20);
+    mu_assert_int_equals(sky_data_file_flush(data_file), 0);
+    mu_assert_int_equals(data_file->block_count, 1);
+
+    // Split the block inside a batch and stop before the batch is flushed.
+    mu_assert_int_equals(sky_data_file_begin_batch(data_file), 0);
+    ADD_EVENT(5LL, 10LL, 20);
+    ADD_EVENT(5LL, 11LL, 20);
+    ADD_EVENT(4LL, 11LL, 20);
+    ADD_EVENT(4LL, 12LL, 20);
+    mu_assert_bool(data_file->block_count > 1);
+    mu_assert_int_equals(sky_file_cp(&header_path, &old_header_path), 0);
+    mu_assert_int_equals(sky_file_cp(&journal_path, &old_journal_path), 0);
+    mu_assert_int_equals(sky_file_cp(&checksum_path, &old_checksum_path), 0);
+    mu_assert_int_equals(sky_data_file_end_batch(data_file), 0);
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+
+    // The new blocks were journaled with header entries so the paths that
+    // were moved into them are recovered.
+    mu_assert_int_equals(rename("tmp/header.old", "tmp/header"), 0);
+    mu_assert_int_equals(rename("tmp/header.journal.old", "tmp/header.journal"), 0);
+    mu_assert_int_equals(rename("tmp/header.crc.old", "tmp/header.crc"), 0);
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    mu_assert_bool(!data_file->recovery_pending);
+    mu_assert_bool(data_file->block_count > 1);
+    ASSERT_BLOCK_RANGES(data_file);
+    ASSERT_PATH_TIMESTAMPS(data_file, 3, 10LL, 11LL);
+    ASSERT_PATH_TIMESTAMPS(data_file, 4, 10LL, 11LL, 12LL);
+    ASSERT_PATH_TIMESTAMPS(data_file, 5, 10LL, 11LL);
+
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_data_file_residency() {
+    struct tagbstring residency_path = bsStatic("tmp/header.hot");
+    sky_data_file *data_file;
+    INIT_DATA_FILE("", 64);
+    ADD_EVENT(3LL, 10LL, 20);
+
+    // The block was just written so it is in memory when unloaded.
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+    mu_assert_bool(sky_file_exists(&residency_path));
+    mu_assert_int_equals((int)sky_file_get_size(&residency_path), 1);
+    uint8_t *bitmap = NULL;
+    size_t length = 0;
+    mu_assert_int_equals(sky_file_read(&residency_path, (void**)&bitmap, &length), 0);
+    mu_assert_bool((bitmap[0] & 1) == 1);
+    free(bitmap);
+
+    // Bits past the last block are ignored on load.
+    uint8_t stale[2] = {0xFF, 0xFF};
+    mu_assert_int_equals(sky_file_write(&residency_path, stale, sizeof(stale)), 0);
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    ASSERT_PATH_TIMESTAMPS(data_file, 3, 10LL);
+
+    // A missing residency file loads nothing.
+    mu_assert_int_equals(sky_data_file_unload(data_file), 0);
+    mu_assert_int_equals(sky_file_rm(&residency_path), 0);
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    ASSERT_PATH_TIMESTAMPS(data_file, 3, 10LL);
+
+    sky_data_file_free(data_file);
+    mu_assert_bool(sky_file_exists(&residency_path));
+    return 0;
+}
+
+
 //==============================================================================
 //
 // Setup
@@ -399,8 +1435,13 @@ int all_tests() {
     mu_run_test(test_sky_data_file_set_path);
     mu_run_test(test_sky_data_file_set_header_path);
     mu_run_test(test_sky_data_file_load_empty);
+    mu_run_test(test_sky_data_file_grows_mapping_geometrically);
+    mu_run_test(test_sky_data_file_adds_extents);
+    mu_run_test(test_sky_data_file_create_blocks);
+    mu_run_test(test_sky_data_file_keeps_memory_for_readers);
 
     mu_run_test(test_sky_data_file_add_event_to_new_block);
+    mu_run_test(test_sky_data_file_add_event_bumps_write_version);
     mu_run_test(test_sky_data_file_prepend_event_to_existing_path);
     mu_run_test(test_sky_data_file_append_event_to_existing_path);
 
@@ -427,6 +1468,29 @@ int all_tests() {
     mu_run_test(test_sky_data_file_add_event_to_start_of_ending_path_causing_block_span);
     mu_run_test(test_sky_data_file_add_event_to_end_of_ending_path_causing_block_span);
 
+    mu_run_test(test_sky_data_file_sort_block);
+    mu_run_test(test_sky_data_file_find_path);
+
+    mu_run_test(test_sky_data_file_compact);
+    mu_run_test(test_sky_data_file_compact_fill_factor);
+    mu_run_test(test_sky_data_file_recommend_block_size);
+
+    mu_run_test(test_sky_data_file_group_durability_defers_sync_until_flush);
+    mu_run_test(test_sky_data_file_async_durability_flushes_on_unload);
+    mu_run_test(test_sky_data_file_memory_advice);
+    mu_run_test(test_sky_data_file_delta_timestamps);
+    mu_run_test(test_sky_data_file_remove_events);
+    mu_run_test(test_sky_data_file_remove_events_merges_span);
+    mu_run_test(test_sky_data_file_remove_object);
+    mu_run_test(test_sky_data_file_expire);
+    mu_run_test(test_sky_data_file_compact_trims_expired_events);
+    mu_run_test(test_sky_data_file_compress);
+    mu_run_test(test_sky_data_file_checksums);
+    mu_run_test(test_sky_data_file_checksums_after_split);
+    mu_run_test(test_sky_data_file_journal);
+    mu_run_test(test_sky_data_file_journal_split);
+    mu_run_test(test_sky_data_file_residency);
+
     return 0;
 }
 
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <file.h>
+#include <dictionary_file.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+struct tagbstring DICTIONARY_PATH = bsStatic("tmp/dictionary");
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Encode
+//--------------------------------------
+
+int test_sky_dictionary_file_encode() {
+    int64_t code;
+    bstring value = NULL;
+    struct tagbstring us = bsStatic("us");
+    struct tagbstring fr = bsStatic("fr");
+    cleantmp();
+    sky_dictionary_file *dictionary_file = sky_dictionary_file_create();
+    mu_assert_int_equals(sky_dictionary_file_open(dictionary_file, &DICTIONARY_PATH), 0);
+
+    // Codes are assigned per property in the order values are first seen.
+    mu_assert_int_equals(sky_dictionary_file_encode(dictionary_file, 1, &us, &code), 0);
+    mu_assert_long_equals(code, 0L);
+    mu_assert_int_equals(sky_dictionary_file_encode(dictionary_file, 1, &fr, &code), 0);
+    mu_assert_long_equals(code, 1L);
+    mu_assert_int_equals(sky_dictionary_file_encode(dictionary_file, 1, &us, &code), 0);
+    mu_assert_long_equals(code, 0L);
+    mu_assert_int_equals(sky_dictionary_file_encode(dictionary_file, -2, &fr, &code), 0);
+    mu_assert_long_equals(code, 0L);
+
+    // Each record is the property id followed by the raw value.
+    mu_assert_long_equals(sky_file_get_size(&DICTIONARY_PATH), 12L);
+
+    // Lookups do not add values.
+    mu_assert_int_equals(sky_dictionary_file_find_code(dictionary_file, -2, &us, &code), 0);
+    mu_assert_long_equals(code, -1L);
+    mu_assert_int_equals(sky_dictionary_file_find_value(dictionary_file, 1, 1, &value), 0);
+    mu_assert_bstring(value, "fr");
+    mu_assert_int_equals(sky_dictionary_file_find_value(dictionary_file, 1, 2, &value), 0);
+    mu_assert_bool(value == NULL);
+    mu_assert_bool(sky_dictionary_file_has_property(dictionary_file, 1));
+    mu_assert_bool(!sky_dictionary_file_has_property(dictionary_file, 2));
+
+    sky_dictionary_file_free(dictionary_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Reopen
+//--------------------------------------
+
+int test_sky_dictionary_file_reopen() {
+    int64_t code;
+    bstring value = NULL;
+    struct tagbstring us = bsStatic("us");
+    struct tagbstring fr = bsStatic("fr");
+    cleantmp();
+    sky_dictionary_file *dictionary_file = sky_dictionary_file_create();
+    mu_assert_int_equals(sky_dictionary_file_open(dictionary_file, &DICTIONARY_PATH), 0);
+    mu_assert_int_equals(sky_dictionary_file_encode(dictionary_file, 1, &us, &code), 0);
+    mu_assert_int_equals(sky_dictionary_file_encode(dictionary_file, 1, &fr, &code), 0);
+    sky_dictionary_file_free(dictionary_file);
+
+    // Simulate a partially written record at the end of the file.
+    FILE *file = fopen("tmp/dictionary", "a");
+    fwrite("\x01\xa5uk", 1, 4, file);
+    fclose(file);
+
+    // Complete records keep their codes and the partial record is dropped.
+    dictionary_file = sky_dictionary_file_create();
+    mu_assert_int_equals(sky_dictionary_file_open(dictionary_file, &DICTIONARY_PATH), 0);
+    mu_assert_long_equals(sky_file_get_size(&DICTIONARY_PATH), 8L);
+    mu_assert_int_equals(sky_dictionary_file_find_code(dictionary_file, 1, &fr, &code), 0);
+    mu_assert_long_equals(code, 1L);
+    mu_assert_int_equals(sky_dictionary_file_find_value(dictionary_file, 1, 0, &value), 0);
+    mu_assert_bstring(value, "us");
+
+    sky_dictionary_file_free(dictionary_file);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_dictionary_file_encode);
+    mu_run_test(test_sky_dictionary_file_reopen);
+    return 0;
+}
+
+RUN_TESTS()
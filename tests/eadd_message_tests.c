@@ -45,6 +45,18 @@ sky_eadd_message *create_message_with_data()
     return message;
 }
 
+sky_eadd_message *create_message_with_property_ids()
+{
+    uint32_t i;
+    sky_eadd_message *message = create_message_with_data();
+    for(i=0; i<message->data_count; i++) {
+        bdestroy(message->data[i]->key);
+        message->data[i]->key = NULL;
+        message->data[i]->property_id = i+1;
+    }
+    return message;
+}
+
 
 //==============================================================================
 //
@@ -80,10 +92,37 @@ int test_sky_eadd_message_unpack() {
     return 0;
 }
 
+int test_sky_eadd_message_unpack_property_ids() {
+    cleantmp();
+    sky_eadd_message *message = create_message_with_property_ids();
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_bool(sky_eadd_message_pack(message, file) == 0);
+    fclose(file);
+    sky_eadd_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_eadd_message_create();
+    mu_assert_bool(sky_eadd_message_unpack(message, file) == 0);
+    fclose(file);
+
+    mu_assert_int_equals(message->data_count, 4);
+    mu_assert_bool(message->data[0]->key == NULL);
+    mu_assert_int_equals(message->data[0]->property_id, 1);
+    mu_assert_bool(biseqcstr(message->data[0]->string_value, "xyz") == 1);
+    mu_assert_int_equals(message->data[3]->property_id, 4);
+    mu_assert_bool(message->data[3]->boolean_value == true);
+    sky_eadd_message_free(message);
+    return 0;
+}
+
 int test_sky_eadd_message_sizeof() {
     sky_eadd_message *message = create_message_with_data();
     mu_assert_long_equals(sky_eadd_message_sizeof(message), 90L);
     sky_eadd_message_free(message);
+
+    message = create_message_with_property_ids();
+    mu_assert_long_equals(sky_eadd_message_sizeof(message), 61L);
+    sky_eadd_message_free(message);
     return 0;
 }
 
@@ -100,11 +139,34 @@ int test_sky_eadd_message_process() {
     sky_table_open(table);
     
     sky_eadd_message *message = create_message_with_data();
-    FILE *output = fopen("tmp/output", "w");
+    sky_buffer *output = sky_buffer_create();
+    mu_assert(sky_eadd_message_process(message, table, output) == 0, "");
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
+    mu_assert_file("tmp/0/header", "tests/fixtures/eadd_message/1/table/post/0/header");
+    mu_assert_file("tmp/0/data", "tests/fixtures/eadd_message/1/table/post/0/data");
+    mu_assert_file("tmp/dictionary", "tests/fixtures/eadd_message/1/table/post/dictionary");
+    mu_assert_file("tmp/output", "tests/fixtures/eadd_message/1/output");
+
+    sky_eadd_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_eadd_message_process_property_ids() {
+    loadtmp("tests/fixtures/eadd_message/1/table/pre");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    sky_table_open(table);
+    
+    sky_eadd_message *message = create_message_with_property_ids();
+    sky_buffer *output = sky_buffer_create();
     mu_assert(sky_eadd_message_process(message, table, output) == 0, "");
-    fclose(output);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
     mu_assert_file("tmp/0/header", "tests/fixtures/eadd_message/1/table/post/0/header");
     mu_assert_file("tmp/0/data", "tests/fixtures/eadd_message/1/table/post/0/data");
+    mu_assert_file("tmp/dictionary", "tests/fixtures/eadd_message/1/table/post/dictionary");
     mu_assert_file("tmp/output", "tests/fixtures/eadd_message/1/output");
 
     sky_eadd_message_free(message);
@@ -122,8 +184,10 @@ int test_sky_eadd_message_process() {
 int all_tests() {
     mu_run_test(test_sky_eadd_message_pack);
     mu_run_test(test_sky_eadd_message_unpack);
+    mu_run_test(test_sky_eadd_message_unpack_property_ids);
     mu_run_test(test_sky_eadd_message_sizeof);
     mu_run_test(test_sky_eadd_message_process);
+    mu_run_test(test_sky_eadd_message_process_property_ids);
     return 0;
 }
 
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ebulk_message.h>
+#include <eadd_message.h>
+#include <file.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Fixtures
+//
+//==============================================================================
+
+sky_eadd_message *create_eadd_message(sky_object_id_t object_id,
+                                      sky_timestamp_t timestamp,
+                                      int64_t value)
+{
+    sky_eadd_message *message = sky_eadd_message_create();
+    message->object_id = object_id;
+    message->timestamp = timestamp;
+    message->action_id = 1;
+    message->data_count = 1;
+    message->data = malloc(sizeof(*message->data) * message->data_count);
+    message->data[0] = sky_eadd_message_data_create();
+    message->data[0]->key = bfromcstr("myInt");
+    message->data[0]->data_type = &SKY_DATA_TYPE_INT;
+    message->data[0]->int_value = value;
+    return message;
+}
+
+// Creates an unsorted bulk message.
+sky_ebulk_message *create_message()
+{
+    sky_ebulk_message *message = sky_ebulk_message_create();
+    message->message_count = 3;
+    message->messages = malloc(sizeof(*message->messages) * message->message_count);
+    message->messages[0] = create_eadd_message(11, 2000LL, 1);
+    message->messages[1] = create_eadd_message(10, 3000LL, 2);
+    message->messages[2] = create_eadd_message(10, 1000LL, 3);
+    return message;
+}
+
+sky_table *open_table(const char *path)
+{
+    struct tagbstring src = bsStatic("tests/fixtures/eadd_message/1/table/pre");
+    bstring dest = bfromcstr(path);
+    if(sky_file_cp_r(&src, dest) != 0) return NULL;
+    sky_table *table = sky_table_create();
+    table->path = dest;
+    if(sky_table_open(table) != 0) return NULL;
+    return table;
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_ebulk_message_pack_unpack() {
+    struct tagbstring message_path = bsStatic("tmp/message");
+    cleantmp();
+    sky_ebulk_message *message = create_message();
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_bool(sky_ebulk_message_pack(message, file) == 0);
+    fclose(file);
+    mu_assert_long_equals(sky_file_get_size(&message_path), (long)sky_ebulk_message_sizeof(message));
+    sky_ebulk_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_ebulk_message_create();
+    mu_assert_bool(sky_ebulk_message_unpack(message, file) == 0);
+    fclose(file);
+    mu_assert_int_equals(message->message_count, 3);
+    mu_assert_int_equals(message->messages[1]->object_id, 10);
+    mu_assert_int64_equals(message->messages[1]->timestamp, 3000LL);
+    mu_assert_int_equals(message->messages[1]->data_count, 1);
+    mu_assert_bstring(message->messages[1]->data[0]->key, "myInt");
+    mu_assert_int64_equals(message->messages[1]->data[0]->int_value, 2LL);
+    sky_ebulk_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_ebulk_message_process() {
+    cleantmp();
+    sky_ebulk_message *message = create_message();
+
+    // Apply the bulk message to one table.
+    sky_table *table = open_table("tmp/a");
+    mu_assert_bool(table != NULL);
+    sky_buffer *output = sky_buffer_create();
+    mu_assert(sky_ebulk_message_process(message, table, output) == 0, "");
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
+    mu_assert_int_equals(table->data_file->batch_depth, 0);
+    mu_assert_bool(!table->data_file->blocks[0]->dirty);
+    mu_assert_bool(!table->data_file->blocks[0]->header_dirty);
+    sky_table_close(table);
+    sky_table_free(table);
+    mu_assert_file("tmp/output", "tests/fixtures/ebulk_message/0/output");
+
+    // Apply the same events one at a time to another table in sorted order.
+    table = open_table("tmp/b");
+    mu_assert_bool(table != NULL);
+    uint32_t order[] = {2, 1, 0};
+    uint32_t i;
+    for(i=0; i<3; i++) {
+        output = sky_buffer_create();
+        mu_assert(sky_eadd_message_process(message->messages[order[i]], table, output) == 0, "");
+        mu_dump_buffer(output, "tmp/output");
+        sky_buffer_free(output);
+    }
+    sky_table_close(table);
+    sky_table_free(table);
+
+    mu_assert_file("tmp/a/0/data", "tmp/b/0/data");
+    mu_assert_file("tmp/a/0/header", "tmp/b/0/header");
+
+    sky_ebulk_message_free(message);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_ebulk_message_pack_unpack);
+    mu_run_test(test_sky_ebulk_message_process);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <eget_message.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_eget_message_pack_unpack() {
+    cleantmp();
+    sky_eget_message *message = sky_eget_message_create();
+    message->object_id = 300;
+    mu_assert_long_equals(sky_eget_message_sizeof(message), 3L);
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_eget_message_pack(message, file), 0);
+    fclose(file);
+    sky_eget_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_eget_message_create();
+    mu_assert_int_equals(sky_eget_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_int_equals(message->object_id, 300);
+    sky_eget_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_eget_message_process() {
+    size_t sz;
+    bstring str = NULL;
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    sky_eget_message *message = sky_eget_message_create();
+    message->object_id = 2;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_eget_message_process(message, table, output), 0);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
+
+    // {status:"ok", events:[...]}
+    FILE *file = fopen("tmp/output", "r");
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 2);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "status"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "ok"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "events"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_array(file, &sz), 2);
+
+    // {timestamp:1000000, actionId:1, data:{price:7, flag:false}}
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 3);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "timestamp"); bdestroy(str);
+    mu_assert_int64_equals((long long)minipack_fread_int(file, &sz), 1000000LL);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "actionId"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_uint(file, &sz), 1);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "data"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 2);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "price"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_int(file, &sz), 7);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "flag"); bdestroy(str);
+    mu_assert_bool(minipack_fread_bool(file, &sz) == false);
+
+    // {timestamp:2000000, actionId:2, data:{}}
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 3);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "timestamp"); bdestroy(str);
+    mu_assert_int64_equals((long long)minipack_fread_int(file, &sz), 2000000LL);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "actionId"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_uint(file, &sz), 2);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "data"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 0);
+    fclose(file);
+
+    // Missing objects return no events.
+    message->object_id = 10;
+    output = sky_buffer_create();
+    mu_assert_int_equals(sky_eget_message_process(message, table, output), 0);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
+    mu_assert_file("tmp/output", "tests/fixtures/eget_message/0/output");
+
+    sky_eget_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_eget_message_process_string_values() {
+    size_t sz;
+    bstring str = NULL;
+    importtmp("tests/fixtures/query/1/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    sky_eget_message *message = sky_eget_message_create();
+    message->object_id = 2;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_eget_message_process(message, table, output), 0);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
+
+    // Dictionary codes are written as their values.
+    //   {timestamp:1000000, actionId:1, data:{country:"fr", price:7}}
+    FILE *file = fopen("tmp/output", "r");
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 2);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "ok"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "events"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_array(file, &sz), 1);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 3);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    minipack_fread_int(file, &sz);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    minipack_fread_uint(file, &sz);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "data"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 2);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "country"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "fr"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "price"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_int(file, &sz), 7);
+    fclose(file);
+
+    sky_eget_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_eget_message_pack_unpack);
+    mu_run_test(test_sky_eget_message_process);
+    mu_run_test(test_sky_eget_message_process_string_values);
+    return 0;
+}
+
+RUN_TESTS()
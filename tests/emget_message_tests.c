@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <emget_message.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+int collect_frame(sky_buffer *buffer, void *data)
+{
+    sky_buffer **frames = data;
+    uint32_t i = 0;
+    while(frames[i] != NULL) i++;
+    frames[i] = sky_buffer_create();
+    return sky_buffer_write(frames[i], buffer->data, buffer->length);
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_emget_message_pack_unpack() {
+    cleantmp();
+    sky_emget_message *message = sky_emget_message_create();
+    message->object_id_count = 2;
+    message->object_ids = calloc(2, sizeof(*message->object_ids));
+    message->object_ids[0] = 300;
+    message->object_ids[1] = 4;
+    mu_assert_long_equals(sky_emget_message_sizeof(message), 5L);
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_emget_message_pack(message, file), 0);
+    fclose(file);
+    sky_emget_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_emget_message_create();
+    mu_assert_int_equals(sky_emget_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_int_equals(message->object_id_count, 2);
+    mu_assert_int_equals(message->object_ids[0], 300);
+    mu_assert_int_equals(message->object_ids[1], 4);
+    sky_emget_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_emget_message_process() {
+    size_t sz;
+    uint32_t i, j;
+    bstring str = NULL;
+    sky_buffer *frames[8];
+    uint32_t event_counts[4] = {0, 0, 0, 0};
+    uint32_t seen[4] = {0, 0, 0, 0};
+    memset(frames, 0, sizeof(frames));
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // Ids are unordered, repeated and include a missing object.
+    sky_object_id_t object_ids[] = {3, 10, 2, 1, 2};
+    sky_emget_message *message = sky_emget_message_create();
+    message->object_id_count = 5;
+    message->object_ids = calloc(5, sizeof(*message->object_ids));
+    memcpy(message->object_ids, object_ids, sizeof(object_ids));
+
+    sky_buffer *output = sky_buffer_create();
+    output->flush = collect_frame;
+    output->flush_data = frames;
+    mu_assert_int_equals(sky_emget_message_process(message, table, output), 0);
+
+    //   {data:{<objectId>:[...]}} ... {status:"ok"}
+    mu_assert_bool(frames[0] != NULL);
+    for(i=0; frames[i] != NULL; i++) {
+        FILE *file = fmemopen(frames[i]->data, frames[i]->length, "r");
+        mu_assert_int_equals(minipack_fread_map(file, &sz), 1);
+        sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "data"); bdestroy(str);
+        uint32_t object_count = minipack_fread_map(file, &sz);
+        mu_assert_bool(object_count > 0);
+        for(j=0; j<object_count; j++) {
+            sky_object_id_t object_id = (sky_object_id_t)minipack_fread_uint(file, &sz);
+            mu_assert_bool(object_id >= 1 && object_id <= 3);
+            seen[object_id]++;
+            event_counts[object_id] = minipack_fread_array(file, &sz);
+            uint32_t k;
+            for(k=0; k<event_counts[object_id]; k++) {
+                sky_buffer *event = sky_buffer_create();
+                mu_assert_int_equals(sky_minipack_fread_elem(file, event), 0);
+                sky_buffer_free(event);
+            }
+        }
+        fclose(file);
+    }
+    mu_assert_int_equals(seen[1], 1);
+    mu_assert_int_equals(seen[2], 1);
+    mu_assert_int_equals(seen[3], 1);
+    mu_assert_int_equals(event_counts[1], 3);
+    mu_assert_int_equals(event_counts[2], 2);
+    mu_assert_int_equals(event_counts[3], 1);
+
+    char expected[] = "\x81" "\xA6" "status" "\xA2" "ok";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected) - 1));
+    mu_assert_mem(output->data, expected, sizeof(expected) - 1);
+
+    for(i=0; i<8; i++) sky_buffer_free(frames[i]);
+    sky_buffer_free(output);
+    sky_emget_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_emget_message_process_missing() {
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // Objects without paths write no frames.
+    sky_emget_message *message = sky_emget_message_create();
+    message->object_id_count = 2;
+    message->object_ids = calloc(2, sizeof(*message->object_ids));
+    message->object_ids[0] = 10;
+    message->object_ids[1] = 20;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_emget_message_process(message, table, output), 0);
+
+    char expected[] = "\x81" "\xA6" "status" "\xA2" "ok";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected) - 1));
+    mu_assert_mem(output->data, expected, sizeof(expected) - 1);
+
+    sky_buffer_free(output);
+    sky_emget_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
+int test_sky_emget_message_process_shards() {
+    size_t sz;
+    uint32_t i, j;
+    bstring str = NULL;
+    sky_buffer *frames[8];
+    uint32_t seen[21];
+    memset(frames, 0, sizeof(frames));
+    memset(seen, 0, sizeof(seen));
+    cleantmp();
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_set_shard_count(table, 4), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+    sky_event *event = sky_event_create(0, 0LL, 1);
+    for(i=1; i<=20; i++) {
+        event->object_id = i;
+        mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    }
+    sky_event_free(event);
+
+    // Every object is found once in its own shard.
+    sky_emget_message *message = sky_emget_message_create();
+    message->object_id_count = 21;
+    message->object_ids = calloc(21, sizeof(*message->object_ids));
+    for(i=0; i<21; i++) {
+        message->object_ids[i] = (i < 20 ? i + 1 : 30);
+    }
+    sky_buffer *output = sky_buffer_create();
+    output->flush = collect_frame;
+    output->flush_data = frames;
+    mu_assert_int_equals(sky_emget_message_process(message, table, output), 0);
+    for(i=0; frames[i] != NULL; i++) {
+        FILE *file = fmemopen(frames[i]->data, frames[i]->length, "r");
+        mu_assert_int_equals(minipack_fread_map(file, &sz), 1);
+        sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "data"); bdestroy(str);
+        uint32_t object_count = minipack_fread_map(file, &sz);
+        for(j=0; j<object_count; j++) {
+            sky_object_id_t object_id = (sky_object_id_t)minipack_fread_uint(file, &sz);
+            mu_assert_bool(object_id >= 1 && object_id <= 20);
+            seen[object_id]++;
+            mu_assert_int_equals(minipack_fread_array(file, &sz), 1);
+            sky_buffer *elem = sky_buffer_create();
+            mu_assert_int_equals(sky_minipack_fread_elem(file, elem), 0);
+            sky_buffer_free(elem);
+        }
+        fclose(file);
+    }
+    mu_assert_bool(i > 1 && i <= 4);
+    for(i=1; i<=20; i++) {
+        mu_assert_int_equals(seen[i], 1);
+    }
+
+    for(i=0; i<8; i++) sky_buffer_free(frames[i]);
+    sky_buffer_free(output);
+    sky_emget_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_emget_message_pack_unpack);
+    mu_run_test(test_sky_emget_message_process);
+    mu_run_test(test_sky_emget_message_process_missing);
+    mu_run_test(test_sky_emget_message_process_shards);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <epoch.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+uint32_t freed_count = 0;
+
+// Counts the memory released by an epoch.
+void count_free(void *ptr, size_t length)
+{
+    (void)length;
+    freed_count++;
+    free(ptr);
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Readers
+//--------------------------------------
+
+int test_sky_epoch_enter_exit() {
+    sky_epoch *epoch = sky_epoch_create();
+    mu_assert_bool(!sky_epoch_has_readers(epoch));
+
+    uint64_t a = sky_epoch_enter(epoch);
+    uint64_t b = sky_epoch_enter(epoch);
+    mu_assert_bool(a == b);
+    mu_assert_bool(sky_epoch_has_readers(epoch));
+    sky_epoch_exit(epoch, a);
+    mu_assert_bool(sky_epoch_has_readers(epoch));
+    sky_epoch_exit(epoch, b);
+    mu_assert_bool(!sky_epoch_has_readers(epoch));
+
+    sky_epoch_free(epoch);
+    return 0;
+}
+
+
+//--------------------------------------
+// Reclamation
+//--------------------------------------
+
+int test_sky_epoch_retire_without_readers() {
+    freed_count = 0;
+    sky_epoch *epoch = sky_epoch_create();
+
+    // Memory is released right away when there are no readers.
+    mu_assert_int_equals(sky_epoch_retire(epoch, malloc(8), 8, count_free), 0);
+    mu_assert_int_equals(freed_count, 1);
+    mu_assert_int_equals(epoch->retiree_count, 0);
+
+    sky_epoch_free(epoch);
+    return 0;
+}
+
+int test_sky_epoch_retire_with_readers() {
+    freed_count = 0;
+    sky_epoch *epoch = sky_epoch_create();
+
+    // Memory is kept while a reader that entered before it was retired is
+    // still in the epoch.
+    uint64_t reader = sky_epoch_enter(epoch);
+    mu_assert_int_equals(sky_epoch_retire(epoch, malloc(8), 8, count_free), 0);
+    mu_assert_int_equals(freed_count, 0);
+
+    // A reader that enters later holds up memory retired after it entered.
+    uint64_t late_reader = sky_epoch_enter(epoch);
+    sky_epoch_exit(epoch, reader);
+    mu_assert_int_equals(sky_epoch_retire(epoch, malloc(8), 8, count_free), 0);
+    mu_assert_int_equals(freed_count, 1);
+    mu_assert_int_equals(epoch->retiree_count, 1);
+
+    sky_epoch_exit(epoch, late_reader);
+    sky_epoch_reclaim(epoch);
+    mu_assert_int_equals(freed_count, 2);
+    mu_assert_int_equals(epoch->retiree_count, 0);
+
+    // Freeing the epoch releases everything that is left.
+    reader = sky_epoch_enter(epoch);
+    mu_assert_int_equals(sky_epoch_retire(epoch, malloc(8), 8, count_free), 0);
+    mu_assert_int_equals(freed_count, 2);
+    sky_epoch_exit(epoch, reader);
+    sky_epoch_free(epoch);
+    mu_assert_int_equals(freed_count, 3);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_epoch_enter_exit);
+    mu_run_test(test_sky_epoch_retire_without_readers);
+    mu_run_test(test_sky_epoch_retire_with_readers);
+    return 0;
+}
+
+RUN_TESTS()
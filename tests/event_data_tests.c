@@ -219,6 +219,125 @@ int test_sky_event_data_unpack_string() {
 }
 
 
+//--------------------------------------
+// Unpack View
+//--------------------------------------
+
+int test_sky_event_data_view_unpack() {
+    size_t sz;
+    sky_event_data_view view;
+    sky_event_data_view_unpack(&view, &INT_DATA, &sz);
+    mu_assert_long_equals(sz, INT_DATA_LENGTH);
+    mu_assert_int_equals(view.type, SKY_EVENT_DATA_TYPE_INT);
+    mu_assert_int_equals(view.key, 10);
+    mu_assert_int64_equals(view.int_value, 1000LL);
+
+    sky_event_data_view_unpack(&view, &FLOAT_DATA, &sz);
+    mu_assert_long_equals(sz, FLOAT_DATA_LENGTH);
+    mu_assert_int_equals(view.type, SKY_EVENT_DATA_TYPE_FLOAT);
+    mu_assert_bool(fabs(view.float_value - 100.2) < 0.1);
+
+    sky_event_data_view_unpack(&view, &BOOLEAN_DATA, &sz);
+    mu_assert_long_equals(sz, BOOLEAN_DATA_LENGTH);
+    mu_assert_int_equals(view.type, SKY_EVENT_DATA_TYPE_BOOLEAN);
+    mu_assert_bool(view.boolean_value == true);
+
+    sky_event_data_view_unpack(&view, &STRING_DATA, &sz);
+    mu_assert_long_equals(sz, STRING_DATA_LENGTH);
+    mu_assert_int_equals(view.type, SKY_EVENT_DATA_TYPE_STRING);
+    mu_assert_int_equals(view.string_value.length, 3);
+    mu_assert_bool(view.string_value.ptr == ((char*)&STRING_DATA) + 2);
+    return 0;
+}
+
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+int test_sky_event_data_find() {
+    // 1:"foo", 2:1000, -1:true, 3:raw16 "ab", 4:100.1
+    char data[] = "\x01\xa3" "foo" "\x02\xD1\x03\xE8" "\xFF\xC3" "\x03\xDA\x00\x02" "ab"
+        "\x04\xCB\x40\x59\x06\x66\x66\x66\x66\x66";
+    uint32_t length = sizeof(data) - 1;
+    mu_assert_bool(sky_event_data_find(data, length, 1) == data + 1);
+    mu_assert_bool(sky_event_data_find(data, length, 2) == data + 6);
+    mu_assert_bool(sky_event_data_find(data, length, -1) == data + 10);
+    mu_assert_bool(sky_event_data_find(data, length, 3) == data + 12);
+    mu_assert_bool(sky_event_data_find(data, length, 4) == data + 18);
+
+    // Missing keys and events without data are not found.
+    mu_assert_bool(sky_event_data_find(data, length, 5) == NULL);
+    mu_assert_bool(sky_event_data_find(data, 5, 2) == NULL);
+    mu_assert_bool(sky_event_data_find(NULL, 0, 1) == NULL);
+    return 0;
+}
+
+
+//--------------------------------------
+// Fixed Section
+//--------------------------------------
+
+int test_sky_event_data_pack_fixed() {
+    size_t sz;
+    char buffer[64];
+    sky_event_data *data[4];
+    data[0] = sky_event_data_create_string(3, &(struct tagbstring)bsStatic("foo"));
+    data[1] = sky_event_data_create_boolean(-1, true);
+    data[2] = sky_event_data_create_float(2, 1.5);
+    data[3] = sky_event_data_create_int(1, 1000);
+    data[1]->fixed = data[2]->fixed = data[3]->fixed = true;
+
+    // Strings are never fixed.
+    data[0]->fixed = true;
+    mu_assert_bool(!sky_event_data_is_fixed(data[0]));
+    mu_assert_bool(sky_event_data_is_fixed(data[1]));
+
+    mu_assert_long_equals(sky_event_data_sizeof_fixed(data, 4), 24L);
+    mu_assert_long_equals(sky_event_data_sizeof_fixed(data, 1), 0L);
+    mu_assert_int_equals(sky_event_data_pack_fixed(data, 4, buffer, &sz), 0);
+    mu_assert_long_equals(sz, 24L);
+    mu_assert_mem(buffer,
+        "\x00\x01\x01\x01" "\x01\x02\xFF"
+        "\xE8\x03\x00\x00\x00\x00\x00\x00"
+        "\x00\x00\x00\x00\x00\x00\xF8\x3F"
+        "\x01", 24);
+
+    // Values are loaded by position.
+    sky_event_data_view view;
+    mu_assert_int_equals(sky_event_data_get_fixed_count(buffer, 24), 3);
+    mu_assert_long_equals(sky_event_data_get_fixed_length(buffer, 24), 24L);
+    mu_assert_bool(sky_event_data_find_fixed(buffer, 24, 1, &view));
+    mu_assert_int_equals(view.type, SKY_EVENT_DATA_TYPE_INT);
+    mu_assert_int64_equals(view.int_value, 1000LL);
+    mu_assert_bool(sky_event_data_find_fixed(buffer, 24, 2, &view));
+    mu_assert_int_equals(view.type, SKY_EVENT_DATA_TYPE_FLOAT);
+    mu_assert_bool(view.float_value == 1.5);
+    mu_assert_bool(sky_event_data_find_fixed(buffer, 24, -1, &view));
+    mu_assert_int_equals(view.type, SKY_EVENT_DATA_TYPE_BOOLEAN);
+    mu_assert_bool(view.boolean_value);
+    mu_assert_bool(!sky_event_data_find_fixed(buffer, 24, 3, &view));
+
+    // Truncated sections and plain data have no fixed values.
+    mu_assert_int_equals(sky_event_data_get_fixed_count(buffer, 23), 0);
+    mu_assert_int_equals(sky_event_data_get_fixed_count(INT_DATA, INT_DATA_LENGTH), 0);
+    mu_assert_bool(sky_event_data_find(buffer, 24, 1) == NULL);
+
+    // Fixed values can be handed on as MessagePack values.
+    char packed[SKY_EVENT_DATA_FIXED_PACKED_LENGTH];
+    sky_event_data_find_fixed(buffer, 24, 1, &view);
+    mu_assert_int_equals(sky_event_data_view_pack(&view, packed, &sz), 0);
+    mu_assert_long_equals(sz, 3L);
+    mu_assert_mem(packed, "\xD1\x03\xE8", 3);
+
+    uint32_t i;
+    for(i=0; i<4; i++) {
+        sky_event_data_free(data[i]);
+    }
+    return 0;
+}
+
+
 //==============================================================================
 //
 // Setup
@@ -245,6 +364,10 @@ int all_tests() {
     mu_run_test(test_sky_event_data_unpack_float);
     mu_run_test(test_sky_event_data_unpack_boolean);
     mu_run_test(test_sky_event_data_unpack_string);
+
+    mu_run_test(test_sky_event_data_view_unpack);
+    mu_run_test(test_sky_event_data_find);
+    mu_run_test(test_sky_event_data_pack_fixed);
     return 0;
 }
 
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 
 #include <event.h>
 #include <mem.h>
@@ -23,6 +24,11 @@ char ACTION_EVENT_DATA[] =
     "\x01\x1e\x00\x00\x00\x00\x00\x00\x00\x14\x00"
 ;
 
+size_t DELTA_ACTION_EVENT_DATA_LENGTH = 4;
+char DELTA_ACTION_EVENT_DATA[] = 
+    "\x05\x0a\x14\x00"
+;
+
 size_t DATA_EVENT_DATA_LENGTH = 23;
 char DATA_EVENT_DATA[] = 
     "\x02\x1e\x00\x00\x00\x00\x00\x00\x00\x0a\x00\x00\x00\x01\xa3\x66"
@@ -189,6 +195,27 @@ int test_sky_event_action_data_event_pack() {
     return 0;
 }
 
+// Action event with a timestamp delta.
+int test_sky_event_action_event_pack_delta() {
+    size_t sz;
+    void *addr = calloc(ACTION_EVENT_DATA_LENGTH, 1);
+    sky_event *event = sky_event_create(0, 30LL, 20);
+    mu_assert_long_equals(sky_event_sizeof_delta(event, 20LL), DELTA_ACTION_EVENT_DATA_LENGTH);
+    mu_assert_int_equals(sky_event_pack_delta(event, 20LL, addr, &sz), 0);
+    mu_assert_long_equals(sz, DELTA_ACTION_EVENT_DATA_LENGTH);
+    mu_assert_mem(addr, &DELTA_ACTION_EVENT_DATA, DELTA_ACTION_EVENT_DATA_LENGTH);
+
+    // Deltas that do not fit in a delta field store the full timestamp.
+    event->timestamp = 0x0100000000000000LL;
+    mu_assert_long_equals(sky_event_sizeof_delta(event, 0LL), ACTION_EVENT_DATA_LENGTH);
+    mu_assert_int_equals(sky_event_pack_delta(event, 0LL, addr, &sz), 0);
+    mu_assert_long_equals(sz, ACTION_EVENT_DATA_LENGTH);
+    mu_assert_long_equals(sky_event_sizeof_raw(addr), ACTION_EVENT_DATA_LENGTH);
+    sky_event_free(event);
+    free(addr);
+    return 0;
+}
+
 //--------------------------------------
 // Deserialization
 //--------------------------------------
@@ -211,6 +238,26 @@ int test_sky_event_action_event_unpack() {
     return 0;
 }
 
+// Action event with a timestamp delta.
+int test_sky_event_action_event_unpack_delta() {
+    size_t sz;
+    sky_event *event = sky_event_create(0, 20LL, 0);
+    sky_event_unpack(event, &DELTA_ACTION_EVENT_DATA, &sz);
+    mu_assert_long_equals(sz, DELTA_ACTION_EVENT_DATA_LENGTH);
+    mu_assert_long_equals(sky_event_sizeof_raw(&DELTA_ACTION_EVENT_DATA), DELTA_ACTION_EVENT_DATA_LENGTH);
+    mu_assert_int64_equals(event->timestamp, 30LL);
+    mu_assert(event->action_id == 20, "Expected action id to equal 20");
+    sky_event_free(event);
+
+    // Rewriting the delta keeps the length of the event.
+    char ptr[4];
+    memcpy(ptr, DELTA_ACTION_EVENT_DATA, DELTA_ACTION_EVENT_DATA_LENGTH);
+    mu_assert_int_equals(sky_event_set_timestamp(ptr, 30LL, 25LL), 0);
+    mu_assert_int64_equals(sky_event_get_timestamp(ptr, 25LL), 30LL);
+    mu_assert_int_equals(sky_event_set_timestamp(ptr, 30LL, 25LL - 0x100), -1);
+    return 0;
+}
+
 // Data event.
 int test_sky_event_data_event_unpack() {
     size_t sz;
@@ -259,6 +306,79 @@ int test_sky_event_action_data_event_unpack() {
     return 0;
 }
 
+// Action+Data event view.
+int test_sky_event_action_data_event_unpack_view() {
+    size_t sz;
+    sky_event_view view;
+    sky_event_data_view data;
+    sky_event_unpack_view(&view, &ACTION_DATA_EVENT_DATA, &sz);
+
+    mu_assert_long_equals(sz, ACTION_DATA_EVENT_DATA_LENGTH);
+    mu_assert_int64_equals(view.timestamp, 30LL);
+    mu_assert_int_equals(view.action_id, 20);
+    mu_assert_int_equals(view.data_length, 10);
+
+    sky_event_view_get_data(&view, 2, &data);
+    mu_assert_int_equals(data.type, SKY_EVENT_DATA_TYPE_STRING);
+    mu_assert_bool(data.string_value.length == 3 && memcmp(data.string_value.ptr, "bar", 3) == 0);
+    sky_event_view_get_data(&view, 3, &data);
+    mu_assert_int_equals(data.type, SKY_EVENT_DATA_TYPE_NONE);
+
+    // Action-only events have no data.
+    sky_event_unpack_view(&view, &ACTION_EVENT_DATA, &sz);
+    mu_assert_long_equals(sz, ACTION_EVENT_DATA_LENGTH);
+    mu_assert_bool(view.data_ptr == NULL);
+    return 0;
+}
+
+// Event with fixed values.
+int test_sky_event_fixed_event_pack_unpack() {
+    size_t sz;
+    char buffer[128];
+    sky_event *event = sky_event_create(0, 30LL, 20);
+    event->data_count = 3;
+    event->data = calloc(3, sizeof(*event->data));
+    event->data[0] = sky_event_data_create_int(1, 200);
+    event->data[1] = sky_event_data_create_string(2, &(struct tagbstring)bsStatic("bar"));
+    event->data[2] = sky_event_data_create_boolean(3, true);
+    event->data[0]->fixed = event->data[2]->fixed = true;
+
+    // The fixed section comes first and holds the int and the boolean.
+    mu_assert_long_equals(sky_event_sizeof_data(event), 15L + 5L);
+    mu_assert_int_equals(sky_event_pack(event, buffer, &sz), 0);
+    size_t length = sky_event_sizeof(event);
+    mu_assert_long_equals(sz, length);
+    mu_assert_mem(buffer + length - 20, "\x00\x01\x00\x01" "\x01\x03", 6);
+    sky_event_free(event);
+
+    event = sky_event_create(0, 0, 0);
+    mu_assert_int_equals(sky_event_unpack(event, buffer, &sz), 0);
+    mu_assert_long_equals(sz, length);
+    mu_assert_int_equals(event->action_id, 20);
+    mu_assert_int_equals(event->data_count, 3);
+
+    sky_event_data *data = NULL;
+    sky_event_get_data(event, 1, &data);
+    mu_assert_bool(data->fixed && data->data_type == &SKY_DATA_TYPE_INT && data->int_value == 200);
+    sky_event_get_data(event, 3, &data);
+    mu_assert_bool(data->fixed && data->data_type == &SKY_DATA_TYPE_BOOLEAN && data->boolean_value);
+    sky_event_get_data(event, 2, &data);
+    mu_assert_bool(!data->fixed && biseqcstr(data->string_value, "bar"));
+    sky_event_free(event);
+
+    // Views read fixed values and the values after the section.
+    sky_event_view view;
+    sky_event_data_view data_view;
+    sky_event_unpack_view(&view, buffer, &sz);
+    sky_event_view_get_data(&view, 1, &data_view);
+    mu_assert_int_equals(data_view.type, SKY_EVENT_DATA_TYPE_INT);
+    mu_assert_int64_equals(data_view.int_value, 200LL);
+    sky_event_view_get_data(&view, 2, &data_view);
+    mu_assert_int_equals(data_view.type, SKY_EVENT_DATA_TYPE_STRING);
+    mu_assert_bool(data_view.string_value.length == 3 && memcmp(data_view.string_value.ptr, "bar", 3) == 0);
+    return 0;
+}
+
 
 
 //==============================================================================
@@ -282,10 +402,14 @@ int all_tests() {
     mu_run_test(test_sky_event_action_event_pack);
     mu_run_test(test_sky_event_data_event_pack);
     mu_run_test(test_sky_event_action_data_event_pack);
+    mu_run_test(test_sky_event_action_event_pack_delta);
 
     mu_run_test(test_sky_event_action_event_unpack);
+    mu_run_test(test_sky_event_action_event_unpack_delta);
     mu_run_test(test_sky_event_data_event_unpack);
     mu_run_test(test_sky_event_action_data_event_unpack);
+    mu_run_test(test_sky_event_action_data_event_unpack_view);
+    mu_run_test(test_sky_event_fixed_event_pack_unpack);
 
     return 0;
 }
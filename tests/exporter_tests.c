@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <exporter.h>
+#include <importer.h>
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// Exports the table in the tmp directory to a file.
+int export_table(sky_exporter_format_e format, const char *path)
+{
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    int rc = sky_table_open(table);
+    if(rc == 0) {
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        sky_exporter *exporter = sky_exporter_create();
+        exporter->format = format;
+        rc = sky_exporter_export(exporter, table, fd);
+        if(exporter->event_count != 3) rc = -1;
+        sky_exporter_free(exporter);
+        close(fd);
+        sky_table_close(table);
+    }
+    sky_table_free(table);
+    return rc;
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Export
+//--------------------------------------
+
+int test_sky_exporter_export_binary() {
+    loadtmp("tests/fixtures/importer/0/table");
+    mu_assert_int_equals(export_table(SKY_EXPORTER_FORMAT_BINARY, "tmp/export"), 0);
+    mu_assert_file("tmp/export", "tests/fixtures/exporter/0/export");
+
+    // Importing the export into an empty copy of the table and exporting it
+    // again should produce the same stream.
+    mu_assert_int_equals(rename("tmp/export", "tmp/import"), 0);
+    mu_assert_int_equals(remove("tmp/0/data"), 0);
+    mu_assert_int_equals(remove("tmp/0/header"), 0);
+    sky_importer *importer = sky_importer_create();
+    importer->path = bfromcstr("tmp");
+    FILE *file = fopen("tmp/import", "r");
+    mu_assert_int_equals(sky_importer_import(importer, file), 0);
+    fclose(file);
+    sky_importer_free(importer);
+    mu_assert_file("tmp/dictionary", "tests/fixtures/importer/0/table/dictionary");
+    mu_assert_int_equals(export_table(SKY_EXPORTER_FORMAT_BINARY, "tmp/export"), 0);
+    mu_assert_file("tmp/export", "tests/fixtures/exporter/0/export");
+    return 0;
+}
+
+int test_sky_exporter_export_json() {
+    loadtmp("tests/fixtures/importer/0/table");
+    mu_assert_int_equals(export_table(SKY_EXPORTER_FORMAT_JSON, "tmp/export.json"), 0);
+    mu_assert_file("tmp/export.json", "tests/fixtures/exporter/0/export.json");
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_exporter_export_binary);
+    mu_run_test(test_sky_exporter_export_json);
+    return 0;
+}
+
+RUN_TESTS()
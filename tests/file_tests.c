@@ -51,6 +51,36 @@ int test_sky_file_cp_r() {
     return 0;
 }
 
+int test_sky_file_clone() {
+    struct tagbstring src_path  = bsStatic("tests/fixtures/file/lorem.txt");
+    struct tagbstring dest_path = bsStatic("tmp/dest.txt");
+    bool cloned = true;
+    int rc = sky_file_clone(&src_path, &dest_path, &cloned);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_file(bdata(&src_path), bdata(&dest_path));
+
+    // Files that are cloned again replace the old copy.
+    struct tagbstring empty_path = bsStatic("tests/fixtures/file/empty_file.txt");
+    rc = sky_file_clone(&empty_path, &dest_path, NULL);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals((int)sky_file_get_size(&dest_path), 0);
+    return 0;
+}
+
+int test_sky_file_clone_r() {
+    struct tagbstring src_path  = bsStatic("tests/fixtures/file/my_dir");
+    struct tagbstring dest_path = bsStatic("tmp/clone");
+    int rc = sky_file_clone_r(&src_path, &dest_path, NULL);
+    mu_assert_int_equals(rc, 0);
+
+    struct tagbstring dir2 = bsStatic("tmp/clone/c/e");
+    mu_assert_file("tests/fixtures/file/my_dir/a.txt", "tmp/clone/a.txt");
+    mu_assert_file("tests/fixtures/file/my_dir/b.txt", "tmp/clone/b.txt");
+    mu_assert_file("tests/fixtures/file/my_dir/c/d.txt", "tmp/clone/c/d.txt");
+    mu_assert_bool(sky_file_is_dir(&dir2));
+    return 0;
+}
+
 
 //--------------------------------------
 // File Delete
@@ -88,6 +118,8 @@ int all_tests() {
     mu_run_test(test_sky_file_exists);
     mu_run_test(test_sky_file_cp);
     mu_run_test(test_sky_file_cp_r);
+    mu_run_test(test_sky_file_clone);
+    mu_run_test(test_sky_file_clone_r);
     mu_run_test(test_sky_file_rm);
     mu_run_test(test_sky_file_rm_r);
     return 0;
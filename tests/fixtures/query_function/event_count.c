@@ -0,0 +1,84 @@
+#include <inttypes.h>
+
+#include <dbg.h>
+#include <query_function.h>
+
+// A query function library that is loaded by the query function tests. Its
+// 'eventCount' function counts the events of every object in group zero.
+
+
+//==============================================================================
+//
+// Forward Declarations
+//
+//==============================================================================
+
+int event_count_event(void *state, sky_action_id_t action_id,
+    sky_timestamp_t timestamp, void *data_ptr, uint32_t data_length);
+
+int event_count_finish(void *state, sky_object_id_t object_id,
+    sky_query_result *result);
+
+
+//==============================================================================
+//
+// Globals
+//
+//==============================================================================
+
+struct tagbstring event_count_name = bsStatic("eventCount");
+
+sky_query_function event_count = {
+    &event_count_name,
+    sizeof(uint32_t),
+    event_count_event,
+    event_count_finish
+};
+
+
+//==============================================================================
+//
+// Functions
+//
+//==============================================================================
+
+// Registers the functions of the library.
+//
+// Returns 0 if successful, otherwise returns -1.
+int sky_query_function_init()
+{
+    return sky_query_function_register(&event_count);
+}
+
+// Counts an event of the current object.
+//
+// Returns 0 if successful, otherwise returns -1.
+int event_count_event(void *state, sky_action_id_t action_id,
+                      sky_timestamp_t timestamp, void *data_ptr,
+                      uint32_t data_length)
+{
+    (void)action_id;
+    (void)timestamp;
+    (void)data_ptr;
+    (void)data_length;
+    (*((uint32_t*)state))++;
+    return 0;
+}
+
+// Adds the events of the object to group zero.
+//
+// Returns 0 if successful, otherwise returns -1.
+int event_count_finish(void *state, sky_object_id_t object_id,
+                       sky_query_result *result)
+{
+    int rc;
+    (void)object_id;
+    int64_t *values = NULL;
+    rc = sky_query_result_get_values(result, 0, &values);
+    check(rc == 0, "Unable to retrieve group values");
+    values[0] += *((uint32_t*)state);
+    return 0;
+
+error:
+    return -1;
+}
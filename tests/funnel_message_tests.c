@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <funnel_message.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// Processes a funnel against the fixture table and compares the response.
+#define mu_assert_funnel(MESSAGE, EXPECTED) do {\
+    importtmp("tests/fixtures/funnel_message/0/import.json");\
+    sky_table *_table = sky_table_create();\
+    _table->path = bfromcstr("tmp");\
+    mu_assert_int_equals(sky_table_open(_table), 0);\
+    sky_buffer *_output = sky_buffer_create();\
+    mu_assert_int_equals(sky_funnel_message_process(MESSAGE, _table, _output), 0);\
+    mu_assert_long_equals((long)_output->length, (long)(sizeof(EXPECTED) - 1));\
+    mu_assert_mem(_output->data, EXPECTED, sizeof(EXPECTED) - 1);\
+    sky_buffer_free(_output);\
+    sky_table_free(_table);\
+} while(0)
+
+// Creates a funnel message with three steps.
+#define create_funnel(MESSAGE, A0, A1, W1, A2, W2) do {\
+    MESSAGE = sky_funnel_message_create();\
+    MESSAGE->step_count = 3;\
+    MESSAGE->steps = calloc(MESSAGE->step_count, sizeof(*MESSAGE->steps));\
+    MESSAGE->steps[0].action_id = A0;\
+    MESSAGE->steps[1].action_id = A1;\
+    MESSAGE->steps[1].window = W1;\
+    MESSAGE->steps[2].action_id = A2;\
+    MESSAGE->steps[2].window = W2;\
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_funnel_message_pack_unpack() {
+    cleantmp();
+    sky_funnel_message *message = NULL;
+    create_funnel(message, 1, 2, 1800000000LL, 3, 0);
+    message->profile = true;
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_funnel_message_pack(message, file), 0);
+    fclose(file);
+    sky_funnel_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_funnel_message_create();
+    mu_assert_int_equals(sky_funnel_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_bool(message->profile);
+    mu_assert_int_equals(message->step_count, 3);
+    mu_assert_int_equals(message->steps[0].action_id, 1);
+    mu_assert_int_equals(message->steps[1].action_id, 2);
+    mu_assert_int64_equals((long long)message->steps[1].window, 1800000000LL);
+    mu_assert_int_equals(message->steps[2].action_id, 3);
+    mu_assert_int64_equals((long long)message->steps[2].window, 0LL);
+    sky_funnel_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_funnel_message_process() {
+    sky_funnel_message *message = NULL;
+
+    // hello, then goodbye within a second, then so long. Object 5 only
+    // makes it through from its second hello.
+    //   {status:"ok", data:{0:{count:3}, 1:{count:3}, 2:{count:2}}}
+    create_funnel(message, 1, 2, 1000000LL, 4, 0);
+    char expected[] = "\x82" "\xA6" "status" "\xA2" "ok" "\xA4" "data" "\x83"
+        "\x00" "\x81" "\xA5" "count" "\x03"
+        "\x01" "\x81" "\xA5" "count" "\x03"
+        "\x02" "\x81" "\xA5" "count" "\x02";
+    mu_assert_funnel(message, expected);
+    sky_funnel_message_free(message);
+    return 0;
+}
+
+int test_sky_funnel_message_process_window() {
+    sky_funnel_message *message = NULL;
+
+    // Steps that no object reaches in time are still returned.
+    //   {status:"ok", data:{0:{count:3}, 1:{count:1}, 2:{count:0}}}
+    create_funnel(message, 1, 3, 1500000LL, 2, 1LL);
+    char expected[] = "\x82" "\xA6" "status" "\xA2" "ok" "\xA4" "data" "\x83"
+        "\x00" "\x81" "\xA5" "count" "\x03"
+        "\x01" "\x81" "\xA5" "count" "\x01"
+        "\x02" "\x81" "\xA5" "count" "\x00";
+    mu_assert_funnel(message, expected);
+    sky_funnel_message_free(message);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_funnel_message_pack_unpack);
+    mu_run_test(test_sky_funnel_message_process);
+    mu_run_test(test_sky_funnel_message_process_window);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <hll.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// Asserts that an estimate is within a percentage of the exact count.
+#define mu_assert_estimate(ESTIMATE, EXACT, PERCENT) \
+    mu_assert_bool(llabs((long long)(ESTIMATE) - (long long)(EXACT)) * 100 <= (long long)(EXACT) * (PERCENT));
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Counting
+//--------------------------------------
+
+int test_sky_hll_count_empty() {
+    sky_hll *hll = sky_hll_create();
+    mu_assert_int64_equals((long long)sky_hll_count(hll), 0LL);
+    sky_hll_free(hll);
+    return 0;
+}
+
+int test_sky_hll_count_small() {
+    uint64_t i;
+    sky_hll *hll = sky_hll_create();
+    for(i=1; i<=10; i++) {
+        sky_hll_add(hll, i);
+        sky_hll_add(hll, i);
+    }
+    mu_assert_int64_equals((long long)sky_hll_count(hll), 10LL);
+    sky_hll_free(hll);
+    return 0;
+}
+
+int test_sky_hll_count_large() {
+    uint64_t i;
+    sky_hll *hll = sky_hll_create();
+    for(i=0; i<100000; i++) {
+        sky_hll_add(hll, i);
+    }
+    mu_assert_estimate(sky_hll_count(hll), 100000, 5);
+    sky_hll_free(hll);
+    return 0;
+}
+
+int test_sky_hll_merge() {
+    uint64_t i;
+    sky_hll *a = sky_hll_create();
+    sky_hll *b = sky_hll_create();
+    for(i=0; i<30000; i++) {
+        sky_hll_add(a, i);
+        sky_hll_add(b, i + 20000);
+    }
+    sky_hll_merge(a, b);
+    mu_assert_estimate(sky_hll_count(a), 50000, 5);
+    sky_hll_free(a);
+    sky_hll_free(b);
+    return 0;
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_hll_pack_unpack() {
+    uint64_t i;
+    cleantmp();
+    sky_hll *hll = sky_hll_create();
+    for(i=0; i<1000; i++) {
+        sky_hll_add(hll, i * 7);
+    }
+    sky_buffer *buffer = sky_buffer_create();
+    mu_assert_int_equals(sky_hll_pack(hll, buffer), 0);
+    mu_dump_buffer(buffer, "tmp/hll");
+    sky_buffer_free(buffer);
+
+    sky_hll *copy = sky_hll_create();
+    FILE *file = fopen("tmp/hll", "r");
+    mu_assert_int_equals(sky_hll_unpack(copy, file), 0);
+    fclose(file);
+    mu_assert_mem(copy->registers, hll->registers, SKY_HLL_REGISTER_COUNT);
+    sky_hll_free(hll);
+    sky_hll_free(copy);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_hll_count_empty);
+    mu_run_test(test_sky_hll_count_small);
+    mu_run_test(test_sky_hll_count_large);
+    mu_run_test(test_sky_hll_merge);
+    mu_run_test(test_sky_hll_pack_unpack);
+    return 0;
+}
+
+RUN_TESTS()
@@ -1,10 +1,55 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <importer.h>
+#include <cursor.h>
 #include "minunit.h"
 
 
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// Counts the events of an object in a table.
+int count_events(sky_table *table, sky_object_id_t object_id, uint32_t *count)
+{
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    *count = 0;
+    int rc = sky_data_file_find_path(table->data_file, object_id, &paths, &path_count);
+    if(rc != 0) return rc;
+
+    sky_cursor *cursor = sky_cursor_create();
+    rc = sky_cursor_set_paths(cursor, paths, path_count);
+    while(rc == 0 && !cursor->eof) {
+        (*count)++;
+        rc = sky_cursor_next(cursor);
+    }
+    sky_cursor_free(cursor);
+    return rc;
+}
+
+// Writes an event to a binary import stream.
+int write_record(FILE *file, sky_event *event)
+{
+    size_t sz;
+    uint32_t length = sizeof(sky_object_id_t) + sky_event_sizeof(event);
+    void *buffer = calloc(1, length);
+    *((sky_object_id_t*)buffer) = event->object_id;
+    int rc = sky_event_pack(event, buffer + sizeof(sky_object_id_t), &sz);
+    if(rc == 0) {
+        fwrite(&length, sizeof(length), 1, file);
+        fwrite(buffer, length, 1, file);
+    }
+    free(buffer);
+    sky_event_free(event);
+    return rc;
+}
+
+
 //==============================================================================
 //
 // Test Cases
@@ -30,6 +75,7 @@ int test_sky_importer_import() {
     mu_assert_int_equals(importer->table->default_block_size, 128);
     mu_assert_file("tmp/actions", "tests/fixtures/importer/0/table/actions");
     mu_assert_file("tmp/properties", "tests/fixtures/importer/0/table/properties");
+    mu_assert_file("tmp/dictionary", "tests/fixtures/importer/0/table/dictionary");
     mu_assert_file("tmp/0/data", "tests/fixtures/importer/0/table/0/data");
     mu_assert_file("tmp/0/header", "tests/fixtures/importer/0/table/0/header");
 
@@ -37,6 +83,146 @@ int test_sky_importer_import() {
     return 0;
 }
 
+// Imports a stream with more events than fit in a chunk or a batch using a
+// given number of parser threads and validates the table.
+int import_stream(uint32_t thread_count)
+{
+    int i;
+    uint32_t count;
+    cleantmp();
+
+    // Write more events than fit in a chunk or a batch, followed by an event
+    // that is larger than a chunk.
+    FILE *file = fopen("tmp/data.json", "w");
+    fprintf(file, "{table:{actions:[{name:\"a\"}], properties:[{type:\"action\", dataType:\"Int\", name:\"n\"}], events:[\n");
+    for(i=0; i<3000; i++) {
+        fprintf(file, "{objectId:%d, timestamp:\"2010-01-02T10:%02d:%02dZ\", action:\"a\", data:{n:%d}},\n", (i%30)+1, i/60, i%60, i);
+    }
+    fprintf(file, "{objectId:31, timestamp:\"2010-01-02T10:00:00Z\",%*s action:\"a\"}\n]}}", SKY_IMPORTER_CHUNK_SIZE, "");
+    fclose(file);
+
+    sky_importer *importer = sky_importer_create();
+    importer->path = bfromcstr("tmp");
+    importer->thread_count = thread_count;
+    file = fopen("tmp/data.json", "r");
+    mu_assert_int_equals(sky_importer_import(importer, file), 0);
+    fclose(file);
+
+    // The buffer only grows to hold the largest event.
+    mu_assert_long_equals(importer->buffer_capacity, (long)(SKY_IMPORTER_CHUNK_SIZE * 2));
+    sky_importer_free(importer);
+
+    // Validate that every event was loaded.
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    for(i=1; i<=30; i++) {
+        mu_assert_int_equals(count_events(table, i, &count), 0);
+        mu_assert_int_equals(count, 100);
+    }
+    mu_assert_int_equals(count_events(table, 31, &count), 0);
+    mu_assert_int_equals(count, 1);
+    sky_table_close(table);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_importer_import_stream() {
+    return import_stream(1);
+}
+
+int test_sky_importer_import_parallel() {
+    return import_stream(4);
+}
+
+int test_sky_importer_import_invalid_event() {
+    int i;
+    cleantmp();
+
+    // A bad event in a later batch stops the pipeline.
+    FILE *file = fopen("tmp/data.json", "w");
+    fprintf(file, "{table:{actions:[{name:\"a\"}], events:[\n");
+    for(i=0; i<3000; i++) {
+        fprintf(file, "{objectId:%d, timestamp:\"2010-01-02T10:00:00Z\", action:\"%s\"},\n", i+1, (i == 2500 ? "b" : "a"));
+    }
+    fprintf(file, "]}}");
+    fclose(file);
+
+    sky_importer *importer = sky_importer_create();
+    importer->path = bfromcstr("tmp");
+    importer->thread_count = 2;
+    file = fopen("tmp/data.json", "r");
+    mu_assert_int_equals(sky_importer_import(importer, file), -1);
+    fclose(file);
+    sky_importer_free(importer);
+    return 0;
+}
+
+int test_sky_importer_import_binary() {
+    int64_t code;
+    uint32_t count;
+    struct tagbstring bar = bsStatic("bar");
+    loadtmp("");
+
+    // Set up the table with a json import.
+    sky_importer *importer = sky_importer_create();
+    importer->path = bfromcstr("tmp");
+    FILE *file = fopen("tests/fixtures/importer/0/data.json", "r");
+    mu_assert_int_equals(sky_importer_import(importer, file), 0);
+    fclose(file);
+    sky_importer_free(importer);
+
+    // Append events with a binary stream.
+    file = fopen("tmp/data.bin", "w");
+    fwrite(SKY_IMPORTER_BINARY_MAGIC, strlen(SKY_IMPORTER_BINARY_MAGIC), 1, file);
+    sky_event *event = sky_event_create(12, 1000000LL, 1);
+    sky_event_set_data(event, -1, &bar);
+    mu_assert_int_equals(write_record(file, event), 0);
+    mu_assert_int_equals(write_record(file, sky_event_create(10, 2000000LL, 2)), 0);
+    fclose(file);
+
+    importer = sky_importer_create();
+    importer->path = bfromcstr("tmp");
+    importer->thread_count = 2;
+    file = fopen("tmp/data.bin", "r");
+    mu_assert_int_equals(sky_importer_import(importer, file), 0);
+    fclose(file);
+    sky_importer_free(importer);
+
+    // Validate that the events were added and the string was encoded.
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_int_equals(count_events(table, 10, &count), 0);
+    mu_assert_int_equals(count, 3);
+    mu_assert_int_equals(count_events(table, 12, &count), 0);
+    mu_assert_int_equals(count, 1);
+    mu_assert_int_equals(sky_dictionary_file_find_code(table->dictionary_file, -1, &bar, &code), 0);
+    mu_assert_bool(code >= 0);
+    sky_table_close(table);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_importer_import_binary_truncated() {
+    loadtmp("");
+
+    // A record that ends early is rejected.
+    FILE *file = fopen("tmp/data.bin", "w");
+    fwrite(SKY_IMPORTER_BINARY_MAGIC, strlen(SKY_IMPORTER_BINARY_MAGIC), 1, file);
+    mu_assert_int_equals(write_record(file, sky_event_create(10, 1000000LL, 1)), 0);
+    fwrite("\x20\x00\x00\x00\x0a\x00", 6, 1, file);
+    fclose(file);
+
+    sky_importer *importer = sky_importer_create();
+    importer->path = bfromcstr("tmp");
+    file = fopen("tmp/data.bin", "r");
+    mu_assert_int_equals(sky_importer_import(importer, file), -1);
+    fclose(file);
+    sky_importer_free(importer);
+    return 0;
+}
+
 
 //==============================================================================
 //
@@ -46,6 +232,11 @@ int test_sky_importer_import() {
 
 int all_tests() {
     mu_run_test(test_sky_importer_import);
+    mu_run_test(test_sky_importer_import_stream);
+    mu_run_test(test_sky_importer_import_parallel);
+    mu_run_test(test_sky_importer_import_invalid_event);
+    mu_run_test(test_sky_importer_import_binary);
+    mu_run_test(test_sky_importer_import_binary_truncated);
     return 0;
 }
 
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <memtable.h>
+#include <data_file.h>
+#include <cursor.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+struct tagbstring LOG_PATH = bsStatic("tmp/wal");
+
+// Appends an action event to a memtable.
+int append_event(sky_memtable *memtable, sky_object_id_t object_id,
+                 sky_timestamp_t timestamp, sky_action_id_t action_id)
+{
+    sky_event *event = sky_event_create(object_id, timestamp, action_id);
+    int rc = sky_memtable_append(memtable, event);
+    sky_event_free(event);
+    return rc;
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Append
+//--------------------------------------
+
+int test_sky_memtable_append() {
+    cleantmp();
+    sky_memtable *memtable = sky_memtable_create();
+    mu_assert_int_equals(sky_memtable_open(memtable, &LOG_PATH), 0);
+
+    // Each record is the object id followed by the raw event.
+    mu_assert_int_equals(append_event(memtable, 10, 5, 20), 0);
+    mu_assert_int_equals(append_event(memtable, 3, 2, 21), 0);
+    mu_assert_int_equals(memtable->event_count, 2);
+    mu_assert_long_equals(memtable->length, 38L);
+    mu_assert_long_equals(sky_file_get_size(&LOG_PATH), 38L);
+
+    sky_memtable_free(memtable);
+    return 0;
+}
+
+
+//--------------------------------------
+// Replay
+//--------------------------------------
+
+int test_sky_memtable_replay() {
+    cleantmp();
+    sky_memtable *memtable = sky_memtable_create();
+    mu_assert_int_equals(sky_memtable_open(memtable, &LOG_PATH), 0);
+    mu_assert_int_equals(append_event(memtable, 10, 5, 20), 0);
+    mu_assert_int_equals(append_event(memtable, 3, 2, 21), 0);
+    sky_memtable_free(memtable);
+
+    // Simulate a partially written record at the end of the log.
+    FILE *file = fopen("tmp/wal", "a");
+    fwrite("\x01\x00\x00\x00\x01\x00", 1, 6, file);
+    fclose(file);
+
+    // Complete records are replayed and the partial record is dropped.
+    memtable = sky_memtable_create();
+    mu_assert_int_equals(sky_memtable_open(memtable, &LOG_PATH), 0);
+    mu_assert_int_equals(memtable->event_count, 2);
+    mu_assert_long_equals(memtable->length, 38L);
+    mu_assert_long_equals(sky_file_get_size(&LOG_PATH), 38L);
+
+    sky_memtable_free(memtable);
+    return 0;
+}
+
+
+//--------------------------------------
+// Merge
+//--------------------------------------
+
+int test_sky_memtable_merge() {
+    cleantmp();
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+
+    sky_memtable *memtable = sky_memtable_create();
+    mu_assert_int_equals(sky_memtable_open(memtable, &LOG_PATH), 0);
+    mu_assert_int_equals(append_event(memtable, 10, 5, 20), 0);
+    mu_assert_int_equals(append_event(memtable, 3, 2, 21), 0);
+    mu_assert_int_equals(append_event(memtable, 10, 1, 22), 0);
+
+    // The events are merged in order and the log is emptied.
+    mu_assert_int_equals(sky_memtable_merge(memtable, data_file), 0);
+    mu_assert_int_equals(memtable->event_count, 0);
+    mu_assert_long_equals(sky_file_get_size(&LOG_PATH), 0L);
+
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_action_id_t action_id = 0;
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 10, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+
+    sky_cursor cursor;
+    sky_cursor_init(&cursor);
+    mu_assert_int_equals(sky_cursor_set_path(&cursor, paths[0]), 0);
+    mu_assert_int_equals(sky_cursor_get_action_id(&cursor, &action_id), 0);
+    mu_assert_int_equals(action_id, 22);
+    mu_assert_int_equals(sky_cursor_next(&cursor), 0);
+    mu_assert_int_equals(sky_cursor_get_action_id(&cursor, &action_id), 0);
+    mu_assert_int_equals(action_id, 20);
+    free(paths);
+
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+
+    sky_memtable_free(memtable);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_memtable_merge_before() {
+    cleantmp();
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+
+    sky_memtable *memtable = sky_memtable_create();
+    mu_assert_int_equals(sky_memtable_open(memtable, &LOG_PATH), 0);
+    mu_assert_int_equals(append_event(memtable, 10, 5, 20), 0);
+    mu_assert_int_equals(append_event(memtable, 3, 2, 21), 0);
+    mu_assert_int_equals(append_event(memtable, 10, 9, 22), 0);
+    mu_assert_int_equals(append_event(memtable, 4, 7, 23), 0);
+    mu_assert_int64_equals(memtable->max_timestamp, 9LL);
+
+    // Nothing is merged if every event is after the cutoff.
+    mu_assert_int_equals(sky_memtable_merge_before(memtable, data_file, 1), 0);
+    mu_assert_int_equals(memtable->event_count, 4);
+
+    // Later events stay in the log in the order they were appended.
+    mu_assert_int_equals(sky_memtable_merge_before(memtable, data_file, 5), 0);
+    mu_assert_int_equals(memtable->event_count, 2);
+    mu_assert_long_equals(memtable->length, 38L);
+    mu_assert_long_equals(sky_file_get_size(&LOG_PATH), 38L);
+
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 4, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    free(paths);
+
+    // The held back events are replayed from the rewritten log.
+    sky_memtable_free(memtable);
+    memtable = sky_memtable_create();
+    mu_assert_int_equals(sky_memtable_open(memtable, &LOG_PATH), 0);
+    mu_assert_int_equals(memtable->event_count, 2);
+    mu_assert_int64_equals(memtable->max_timestamp, 9LL);
+    mu_assert_int_equals(append_event(memtable, 4, 1, 24), 0);
+    mu_assert_int_equals(sky_memtable_merge(memtable, data_file), 0);
+    mu_assert_int_equals(memtable->event_count, 0);
+    mu_assert_long_equals(sky_file_get_size(&LOG_PATH), 0L);
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 4, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+
+    sky_memtable_free(memtable);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_memtable_append);
+    mu_run_test(test_sky_memtable_replay);
+    mu_run_test(test_sky_memtable_merge);
+    mu_run_test(test_sky_memtable_merge_before);
+    return 0;
+}
+
+RUN_TESTS()
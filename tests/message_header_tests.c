@@ -41,9 +41,45 @@ int test_sky_message_header_unpack() {
 
     mu_assert_int64_equals(header->version, 1LL);
     mu_assert_bstring(header->name, "eadd");
+    mu_assert_int_equals(header->type, SKY_MESSAGE_TYPE_EADD);
     mu_assert_int64_equals(header->length, 10LL);
     mu_assert_bstring(header->database_name, "foo");
     mu_assert_bstring(header->table_name, "bar");
+    mu_assert_bool(!header->pipelined);
+    sky_message_header_free(header);
+    return 0;
+}
+
+int test_sky_message_header_pack_pipelined() {
+    cleantmp();
+    sky_message_header *header = sky_message_header_create();
+    header->version = 1;
+    header->name = bfromcstr("eadd");
+    header->length = 10;
+    header->database_name = bfromcstr("foo");
+    header->table_name = bfromcstr("bar");
+    header->pipelined = true;
+    header->request_id = 7;
+    
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_bool(sky_message_header_pack(header, file) == 0);
+    fclose(file);
+    mu_assert_file("tmp/message", "tests/fixtures/message_header/1/message");
+    sky_message_header_free(header);
+    return 0;
+}
+
+int test_sky_message_header_unpack_pipelined() {
+    FILE *file = fopen("tests/fixtures/message_header/1/message", "r");
+    sky_message_header *header = sky_message_header_create();
+    mu_assert_bool(sky_message_header_unpack(header, file) == 0);
+    fclose(file);
+
+    mu_assert_bstring(header->name, "eadd");
+    mu_assert_int64_equals(header->length, 10LL);
+    mu_assert_bstring(header->table_name, "bar");
+    mu_assert_bool(header->pipelined);
+    mu_assert_int64_equals(header->request_id, 7LL);
     sky_message_header_free(header);
     return 0;
 }
@@ -58,6 +94,8 @@ int test_sky_message_header_unpack() {
 int all_tests() {
     mu_run_test(test_sky_message_header_pack);
     mu_run_test(test_sky_message_header_unpack);
+    mu_run_test(test_sky_message_header_pack_pipelined);
+    mu_run_test(test_sky_message_header_unpack_pipelined);
     return 0;
 }
 
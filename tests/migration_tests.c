@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <migration.h>
+#include <data_file.h>
+#include <memtable.h>
+#include <cursor.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+struct tagbstring TABLE_PATH = bsStatic("tmp");
+struct tagbstring HEADER_PATH = bsStatic("tmp/0/header");
+struct tagbstring LOG_PATH = bsStatic("tmp/wal");
+struct tagbstring LOG_TARGET_PATH = bsStatic("tmp/wal.migrate");
+
+#define ASSERT_EVENT(CURSOR, TIMESTAMP, ACTION_ID) do {\
+    sky_timestamp_t _timestamp = 0; \
+    sky_action_id_t _action_id = 0; \
+    mu_assert_bool(!(CURSOR)->eof); \
+    mu_assert_int_equals(sky_cursor_get_timestamp(CURSOR, &_timestamp), 0); \
+    mu_assert_long_equals(_timestamp, TIMESTAMP##LL); \
+    mu_assert_int_equals(sky_cursor_get_action_id(CURSOR, &_action_id), 0); \
+    mu_assert_int_equals(_action_id, ACTION_ID); \
+    mu_assert_int_equals(sky_cursor_next(CURSOR), 0); \
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Detection
+//--------------------------------------
+
+int test_sky_migration_is_required() {
+    bool required = false;
+    loadtmp("tests/fixtures/migration/0");
+    mu_assert_int_equals(sky_migration_is_required(&HEADER_PATH, &required), 0);
+    mu_assert_bool(required);
+
+    mu_assert_int_equals(sky_migration_migrate_table(&TABLE_PATH), 0);
+    mu_assert_int_equals(sky_migration_is_required(&HEADER_PATH, &required), 0);
+    mu_assert_bool(!required);
+    return 0;
+}
+
+
+//--------------------------------------
+// Tables
+//--------------------------------------
+
+int test_sky_migration_migrate_table() {
+    loadtmp("tests/fixtures/migration/0");
+    mu_assert_int_equals(sky_migration_migrate_table(&TABLE_PATH), 0);
+
+    // Migrating an already migrated table should leave it unchanged.
+    mu_assert_int_equals(sky_migration_migrate_table(&TABLE_PATH), 0);
+
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->path = bfromcstr("tmp/0/data");
+    data_file->header_path = bfromcstr("tmp/0/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+    mu_assert_int_equals(data_file->version, SKY_DATA_FILE_VERSION);
+    mu_assert_int_equals(data_file->block_size, 64);
+
+    // The full legacy block no longer fits with a wider path header so its
+    // path is split into a span across the first two blocks.
+    mu_assert_int_equals(data_file->block_count, 4);
+    mu_assert_bool(data_file->blocks[0]->spanned);
+    mu_assert_bool(data_file->blocks[1]->spanned);
+    mu_assert_bool(data_file->blocks[2]->spanned);
+    mu_assert_bool(!data_file->blocks[3]->spanned);
+
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_cursor *cursor = sky_cursor_create();
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 3, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 3);
+    mu_assert_int_equals(sky_cursor_set_paths(cursor, paths, path_count), 0);
+    ASSERT_EVENT(cursor, 8, 21);
+    ASSERT_EVENT(cursor, 9, 20);
+    ASSERT_EVENT(cursor, 10, 20);
+    ASSERT_EVENT(cursor, 11, 22);
+    mu_assert_bool(cursor->eof);
+
+    mu_assert_int_equals(sky_data_file_find_path(data_file, 10, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    mu_assert_int_equals(sky_cursor_set_paths(cursor, paths, path_count), 0);
+    ASSERT_EVENT(cursor, 11, 20);
+    mu_assert_bool(cursor->eof);
+    sky_cursor_free(cursor);
+    sky_data_file_free(data_file);
+
+    // The complete log records are widened and the partial record is dropped.
+    mu_assert_bool(!sky_file_exists(&LOG_TARGET_PATH));
+    mu_assert_long_equals(sky_file_get_size(&LOG_PATH), 38L);
+    sky_memtable *memtable = sky_memtable_create();
+    mu_assert_int_equals(sky_memtable_open(memtable, &LOG_PATH), 0);
+    mu_assert_int_equals(memtable->event_count, 2);
+    sky_memtable_free(memtable);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_migration_is_required);
+    mu_run_test(test_sky_migration_migrate_table);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dbg.h>
+#include <minipack_batch.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Sizing
+//--------------------------------------
+
+int test_sky_minipack_batch_sizeof_elem() {
+    char data[] = "\x07" "\xE5" "\xC0" "\xC3" "\xCC\xFF" "\xD1\x01\x02"
+        "\xCA\x00\x00\x00\x00" "\xCF\x00\x00\x00\x00\x00\x00\x00\x01"
+        "\xA3" "abc" "\xDA\x00\x02" "ab" "\xDB\x00\x00\x00\x01" "a";
+    size_t expected[] = {1, 1, 1, 1, 2, 3, 5, 9, 4, 5, 6};
+    uint32_t i;
+    char *ptr = data;
+    for(i=0; i<sizeof(expected)/sizeof(*expected); i++) {
+        mu_assert_long_equals((long)sky_minipack_batch_sizeof_elem(ptr), (long)expected[i]);
+        mu_assert_long_equals((long)sky_minipack_batch_sizeof_elem(ptr), (long)minipack_sizeof_elem_and_data(ptr));
+        ptr += expected[i];
+    }
+
+    // Maps and arrays are not sized.
+    mu_assert_long_equals((long)sky_minipack_batch_sizeof_elem("\x81"), 0L);
+    mu_assert_long_equals((long)sky_minipack_batch_sizeof_elem("\x91"), 0L);
+    return 0;
+}
+
+
+//--------------------------------------
+// Integers
+//--------------------------------------
+
+int test_sky_minipack_batch_int() {
+    uint32_t i;
+    size_t sz, expected_sz, _sz;
+    int64_t values[101];
+    int64_t unpacked[101];
+    char expected[101 * 9];
+    char data[101 * 9];
+
+    // Mix runs of fixnums with larger values.
+    for(i=0; i<101; i++) {
+        values[i] = (i % 37 == 0 ? (int64_t)i * -100000 : (int64_t)(i % 120) - 20);
+    }
+    for(i=0, expected_sz=0; i<101; i++) {
+        minipack_pack_int(expected + expected_sz, values[i], &_sz);
+        expected_sz += _sz;
+    }
+
+    // The batch produces the same bytes as packing one value at a time.
+    sky_minipack_batch_pack_int(data, values, 101, &sz);
+    mu_assert_long_equals((long)sz, (long)expected_sz);
+    mu_assert_mem(data, expected, expected_sz);
+
+    memset(unpacked, 0, sizeof(unpacked));
+    mu_assert_int_equals(sky_minipack_batch_unpack_int(data, unpacked, 101, &sz), 0);
+    mu_assert_long_equals((long)sz, (long)expected_sz);
+    mu_assert_mem(unpacked, values, sizeof(values));
+
+    // Other types cannot be unpacked as integers.
+    data[expected_sz - 1] = (char)0xC0;
+    mu_assert_int_equals(sky_minipack_batch_unpack_int(data, unpacked, 101, &sz), -1);
+    return 0;
+}
+
+
+//--------------------------------------
+// Doubles
+//--------------------------------------
+
+int test_sky_minipack_batch_double() {
+    uint32_t i;
+    size_t sz, _sz;
+    double values[7] = {0, 1.5, -2.25, 1e300, -1e-300, 3.14159, 100};
+    double unpacked[7];
+    char expected[7 * 9];
+    char data[7 * 9];
+
+    for(i=0; i<7; i++) {
+        minipack_pack_double(expected + (i * 9), values[i], &_sz);
+    }
+    sky_minipack_batch_pack_double(data, values, 7, &sz);
+    mu_assert_long_equals((long)sz, 63L);
+    mu_assert_mem(data, expected, 63);
+
+    memset(unpacked, 0, sizeof(unpacked));
+    mu_assert_int_equals(sky_minipack_batch_unpack_double(data, unpacked, 7, &sz), 0);
+    mu_assert_long_equals((long)sz, 63L);
+    mu_assert_mem(unpacked, values, sizeof(values));
+
+    // Other types cannot be unpacked as doubles.
+    data[9] = (char)0xCA;
+    mu_assert_int_equals(sky_minipack_batch_unpack_double(data, unpacked, 7, &sz), -1);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_minipack_batch_sizeof_elem);
+    mu_run_test(test_sky_minipack_batch_int);
+    mu_run_test(test_sky_minipack_batch_double);
+    return 0;
+}
+
+RUN_TESTS()
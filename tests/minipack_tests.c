@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dbg.h>
+#include <minipack.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Elements
+//--------------------------------------
+
+int test_sky_minipack_fread_elem() {
+    // {"a":[1,-1,0xFFFF], "b":nil} followed by 0x07.
+    char data[] = "\x82" "\xA1" "a" "\x93" "\x01" "\xFF" "\xCD\xFF\xFF" "\xA1" "b" "\xC0" "\x07";
+    size_t length = sizeof(data) - 2;
+    FILE *file = fmemopen(data, sizeof(data) - 1, "r");
+    sky_buffer *buffer = sky_buffer_create();
+    mu_assert_int_equals(sky_minipack_fread_elem(file, buffer), 0);
+    mu_assert_long_equals(buffer->length, (long)length);
+    mu_assert_mem(buffer->data, data, length);
+
+    // The next element is left on the stream.
+    sky_buffer_clear(buffer);
+    mu_assert_int_equals(sky_minipack_fread_elem(file, buffer), 0);
+    mu_assert_long_equals(buffer->length, 1L);
+    mu_assert_int_equals(buffer->data[0], 7);
+
+    // Nothing is left to read.
+    mu_assert_int_equals(sky_minipack_fread_elem(file, buffer), -1);
+    fclose(file);
+    sky_buffer_free(buffer);
+    return 0;
+}
+
+
+//--------------------------------------
+// Decoder
+//--------------------------------------
+
+int test_sky_minipack_decoder_skip() {
+    // {"a":[1,-1,0xFFFF], "b":nil} followed by 0x07.
+    char data[] = "\x82" "\xA1" "a" "\x93" "\x01" "\xFF" "\xCD\xFF\xFF" "\xA1" "b" "\xC0" "\x07";
+    size_t length = sizeof(data) - 2;
+    bool complete = false;
+    sky_minipack_decoder decoder;
+    sky_minipack_decoder_init(&decoder, 0);
+
+    // Feed the bytes in one at a time. The decoder never stops inside of an
+    // element.
+    size_t i;
+    for(i=0; i<length; i++) {
+        mu_assert_int_equals(sky_minipack_decoder_skip(&decoder, data, i, &complete), 0);
+        mu_assert_bool(!complete);
+        mu_assert_bool(decoder.offset <= i);
+    }
+    mu_assert_int_equals(sky_minipack_decoder_skip(&decoder, data, sizeof(data) - 1, &complete), 0);
+    mu_assert_bool(complete);
+    mu_assert_long_equals((long)decoder.offset, (long)length);
+
+    // The next element starts where the last one ended.
+    sky_minipack_decoder_init(&decoder, decoder.offset);
+    mu_assert_int_equals(sky_minipack_decoder_skip(&decoder, data, sizeof(data) - 1, &complete), 0);
+    mu_assert_bool(complete);
+    mu_assert_long_equals((long)decoder.offset, (long)(sizeof(data) - 1));
+    return 0;
+}
+
+int test_sky_minipack_decoder_skip_raw() {
+    // A raw16 element is only read once all of its data has arrived.
+    char data[] = "\xDA\x00\x03" "abc";
+    bool complete = false;
+    sky_minipack_decoder decoder;
+    sky_minipack_decoder_init(&decoder, 0);
+    mu_assert_int_equals(sky_minipack_decoder_skip(&decoder, data, 2, &complete), 0);
+    mu_assert_bool(!complete);
+    mu_assert_int_equals(sky_minipack_decoder_skip(&decoder, data, 5, &complete), 0);
+    mu_assert_bool(!complete);
+    mu_assert_long_equals((long)decoder.offset, 0L);
+    mu_assert_int_equals(sky_minipack_decoder_skip(&decoder, data, 6, &complete), 0);
+    mu_assert_bool(complete);
+    mu_assert_long_equals((long)decoder.offset, 6L);
+
+    // Unknown types are an error.
+    char invalid[] = "\xC1";
+    sky_minipack_decoder_init(&decoder, 0);
+    mu_assert_int_equals(sky_minipack_decoder_skip(&decoder, invalid, 1, &complete), -1);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_minipack_fread_elem);
+    mu_run_test(test_sky_minipack_decoder_skip);
+    mu_run_test(test_sky_minipack_decoder_skip_raw);
+    return 0;
+}
+
+RUN_TESTS()
@@ -158,6 +158,15 @@ struct tagbstring BSTMPDIR = bsStatic(TMPDIR);
 #define mu_assert_tempfile(EXP_FILENAME) \
     mu_assert_file(TEMPFILE, EXP_FILENAME)
 
+// Writes the contents of a buffer to a file so that it can be compared or
+// read back as a stream.
+#define mu_dump_buffer(BUFFER, FILENAME) do {\
+    FILE *_file = fopen(FILENAME, "w"); \
+    if(_file == NULL) mu_fail("Cannot open file: %s", FILENAME); \
+    if((BUFFER)->length > 0) fwrite((BUFFER)->data, (BUFFER)->length, 1, _file); \
+    fclose(_file); \
+} while(0)
+
 // Asserts the contents of memory. If an error occurs then the memory is
 // dumped to file.
 #define mu_assert_mem(ACTUAL, EXPECTED, N) do {\
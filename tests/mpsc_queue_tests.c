@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include <mpsc_queue.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+#define PRODUCER_COUNT 4
+
+#define ITEM_COUNT 20000
+
+typedef struct item {
+    sky_mpsc_node node;
+    uint32_t producer;
+    uint32_t index;
+} item;
+
+typedef struct producer {
+    sky_mpsc_queue *queue;
+    item *items;
+    pthread_t thread;
+} producer;
+
+void *run_producer(void *arg)
+{
+    uint32_t i;
+    producer *p = (producer*)arg;
+    for(i=0; i<ITEM_COUNT; i++) {
+        sky_mpsc_queue_push(p->queue, &p->items[i].node);
+    }
+    return NULL;
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Queueing
+//--------------------------------------
+
+int test_sky_mpsc_queue_push_pop() {
+    item items[3];
+    sky_mpsc_queue queue;
+    sky_mpsc_queue_init(&queue);
+    mu_assert_bool(sky_mpsc_queue_pop(&queue) == NULL);
+
+    sky_mpsc_queue_push(&queue, &items[0].node);
+    sky_mpsc_queue_push(&queue, &items[1].node);
+    mu_assert_bool(sky_mpsc_queue_pop(&queue) == &items[0].node);
+    sky_mpsc_queue_push(&queue, &items[2].node);
+    mu_assert_bool(sky_mpsc_queue_pop(&queue) == &items[1].node);
+    mu_assert_bool(sky_mpsc_queue_pop(&queue) == &items[2].node);
+    mu_assert_bool(sky_mpsc_queue_pop(&queue) == NULL);
+
+    // The queue can be reused once it is empty.
+    sky_mpsc_queue_push(&queue, &items[0].node);
+    mu_assert_bool(sky_mpsc_queue_pop(&queue) == &items[0].node);
+    mu_assert_bool(sky_mpsc_queue_pop(&queue) == NULL);
+    return 0;
+}
+
+int test_sky_mpsc_queue_producers() {
+    uint32_t i, j;
+    sky_mpsc_queue queue;
+    sky_mpsc_queue_init(&queue);
+    producer producers[PRODUCER_COUNT];
+    uint32_t next_index[PRODUCER_COUNT];
+    for(i=0; i<PRODUCER_COUNT; i++) {
+        producers[i].queue = &queue;
+        producers[i].items = calloc(ITEM_COUNT, sizeof(item));
+        for(j=0; j<ITEM_COUNT; j++) {
+            producers[i].items[j].producer = i;
+            producers[i].items[j].index = j;
+        }
+        next_index[i] = 0;
+    }
+    for(i=0; i<PRODUCER_COUNT; i++) {
+        mu_assert_int_equals(pthread_create(&producers[i].thread, NULL, run_producer, &producers[i]), 0);
+    }
+
+    // Every item arrives once and in the order that its producer pushed it.
+    uint32_t count = 0;
+    bool ordered = true;
+    while(count < PRODUCER_COUNT * ITEM_COUNT) {
+        item *it = (item*)sky_mpsc_queue_pop(&queue);
+        if(it == NULL) {
+            continue;
+        }
+        if(it->index != next_index[it->producer]) {
+            ordered = false;
+        }
+        next_index[it->producer] = it->index + 1;
+        count++;
+    }
+    for(i=0; i<PRODUCER_COUNT; i++) {
+        pthread_join(producers[i].thread, NULL);
+    }
+    mu_assert_bool(ordered);
+    mu_assert_bool(sky_mpsc_queue_pop(&queue) == NULL);
+
+    for(i=0; i<PRODUCER_COUNT; i++) {
+        mu_assert_int_equals(next_index[i], ITEM_COUNT);
+        free(producers[i].items);
+    }
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_mpsc_queue_push_pop);
+    mu_run_test(test_sky_mpsc_queue_producers);
+    return 0;
+}
+
+RUN_TESTS()
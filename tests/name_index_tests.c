@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <name_index.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Entry Management
+//--------------------------------------
+
+int test_sky_name_index_put() {
+    int rc;
+    int foo = 1, bar = 2, baz = 3;
+    struct tagbstring foo_name = bsStatic("foo");
+    struct tagbstring bar_name = bsStatic("bar");
+    struct tagbstring missing_name = bsStatic("baz");
+    sky_name_index *index = sky_name_index_create();
+    mu_assert_bool(sky_name_index_get(index, &foo_name) == NULL);
+
+    rc = sky_name_index_put(index, &foo_name, &foo);
+    mu_assert_int_equals(rc, 0);
+    rc = sky_name_index_put(index, &bar_name, &bar);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(index->count, 2);
+    mu_assert_bool(sky_name_index_get(index, &foo_name) == &foo);
+    mu_assert_bool(sky_name_index_get(index, &bar_name) == &bar);
+    mu_assert_bool(sky_name_index_get(index, &missing_name) == NULL);
+
+    // Putting an existing name replaces its value.
+    rc = sky_name_index_put(index, &foo_name, &baz);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(index->count, 2);
+    mu_assert_bool(sky_name_index_get(index, &foo_name) == &baz);
+
+    // Clearing removes every entry.
+    sky_name_index_clear(index);
+    mu_assert_int_equals(index->count, 0);
+    mu_assert_bool(sky_name_index_get(index, &bar_name) == NULL);
+
+    sky_name_index_free(index);
+    return 0;
+}
+
+int test_sky_name_index_resize() {
+    int i, rc;
+    int values[100];
+    bstring names[100];
+    sky_name_index *index = sky_name_index_create();
+
+    for(i=0; i<100; i++) {
+        names[i] = bformat("name%d", i);
+        rc = sky_name_index_put(index, names[i], &values[i]);
+        mu_assert_int_equals(rc, 0);
+    }
+    mu_assert_int_equals(index->count, 100);
+    mu_assert_bool(index->capacity >= 200);
+
+    for(i=0; i<100; i++) {
+        mu_assert_bool(sky_name_index_get(index, names[i]) == &values[i]);
+    }
+
+    sky_name_index_free(index);
+    for(i=0; i<100; i++) {
+        bdestroy(names[i]);
+    }
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_name_index_put);
+    mu_run_test(test_sky_name_index_resize);
+    return 0;
+}
+
+RUN_TESTS()
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 
 #include <next_action_message.h>
+#include <minipack.h>
 #include <mem.h>
 
 #include "minunit.h"
@@ -46,6 +47,38 @@ int test_sky_next_action_message_unpack() {
     return 0;
 }
 
+int test_sky_next_action_message_pack_unpack_profile() {
+    cleantmp();
+    sky_next_action_message *message = sky_next_action_message_create();
+    message->profile = true;
+    message->distinct = true;
+    message->continuous = true;
+    message->grouped = true;
+    message->group_property_id = -1;
+    message->prior_action_id_count = 1;
+    message->prior_action_ids = calloc(message->prior_action_id_count, sizeof(*message->prior_action_ids));
+    message->prior_action_ids[0] = 3;
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_next_action_message_pack(message, file), 0);
+    fclose(file);
+    sky_next_action_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_next_action_message_create();
+    mu_assert_int_equals(sky_next_action_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_bool(message->profile);
+    mu_assert_bool(message->distinct);
+    mu_assert_bool(message->continuous);
+    mu_assert_bool(message->grouped);
+    mu_assert_int_equals(message->group_property_id, -1);
+    mu_assert_int_equals(message->prior_action_id_count, 1);
+    mu_assert_int_equals(message->prior_action_ids[0], 3);
+    sky_next_action_message_free(message);
+    return 0;
+}
+
 
 //--------------------------------------
 // Processing
@@ -62,10 +95,206 @@ int test_sky_next_action_message_process() {
     message->prior_action_ids = calloc(message->prior_action_id_count, sizeof(*message->prior_action_ids));
     message->prior_action_ids[0] = 1;
     message->prior_action_ids[1] = 2;
-    FILE *output = fopen("tmp/output", "w");
+    sky_buffer *output = sky_buffer_create();
     mu_assert(sky_next_action_message_process(message, table, output) == 0, "");
-    fclose(output);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
+    mu_assert_file("tmp/output", "tests/fixtures/next_action_message/1/output");
+
+    sky_next_action_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_next_action_message_process_distinct() {
+    importtmp("tests/fixtures/next_action_message/1/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    sky_table_open(table);
+
+    sky_next_action_message *message = sky_next_action_message_create();
+    message->distinct = true;
+    message->prior_action_id_count = 2;
+    message->prior_action_ids = calloc(message->prior_action_id_count, sizeof(*message->prior_action_ids));
+    message->prior_action_ids[0] = 1;
+    message->prior_action_ids[1] = 2;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_next_action_message_process(message, table, output), 0);
+
+    // {status:"ok", data:{3:{count:2, distinct:2}, 4:{count:1, distinct:1}}}
+    char expected[] = "\x82" "\xA6" "status" "\xA2" "ok" "\xA4" "data" "\x82"
+        "\x03" "\x82" "\xA5" "count" "\x02" "\xA8" "distinct" "\x02"
+        "\x04" "\x82" "\xA5" "count" "\x01" "\xA8" "distinct" "\x01";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected) - 1));
+    mu_assert_mem(output->data, expected, sizeof(expected) - 1);
+    sky_buffer_free(output);
+
+    sky_next_action_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_next_action_message_process_grouped() {
+    importtmp("tests/fixtures/next_action_message/2/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    sky_table_open(table);
+
+    sky_next_action_message *message = sky_next_action_message_create();
+    message->grouped = true;
+    message->group_property_id = -1;
+    message->prior_action_id_count = 2;
+    message->prior_action_ids = calloc(message->prior_action_id_count, sizeof(*message->prior_action_ids));
+    message->prior_action_ids[0] = 1;
+    message->prior_action_ids[1] = 2;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_next_action_message_process(message, table, output), 0);
+
+    // {status:"ok", data:{"ios":{2:{count:1}, 3:{count:1}}, "web":{3:{count:1}}}}
+    char expected[] = "\x82" "\xA6" "status" "\xA2" "ok" "\xA4" "data" "\x82"
+        "\xA3" "ios" "\x82"
+            "\x02" "\x81" "\xA5" "count" "\x01"
+            "\x03" "\x81" "\xA5" "count" "\x01"
+        "\xA3" "web" "\x81"
+            "\x03" "\x81" "\xA5" "count" "\x01";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected) - 1));
+    mu_assert_mem(output->data, expected, sizeof(expected) - 1);
+    sky_buffer_free(output);
+
+    sky_next_action_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_next_action_message_process_compact() {
+    importtmp("tests/fixtures/next_action_message/1/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    sky_table_open(table);
+
+    sky_next_action_message *message = sky_next_action_message_create();
+    message->compact = true;
+    message->distinct = true;
+    message->prior_action_id_count = 2;
+    message->prior_action_ids = calloc(message->prior_action_id_count, sizeof(*message->prior_action_ids));
+    message->prior_action_ids[0] = 1;
+    message->prior_action_ids[1] = 2;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_next_action_message_process(message, table, output), 0);
+
+    // {status:"ok", data:{names:["count", "distinct"], keys:<3, 4>, values:<2, 2, 1, 1>}}
+    char expected[] = "\x82" "\xA6" "status" "\xA2" "ok" "\xA4" "data" "\x83"
+        "\xA5" "names" "\x92" "\xA5" "count" "\xA8" "distinct"
+        "\xA4" "keys" "\xB0"
+            "\x03\x00\x00\x00\x00\x00\x00\x00" "\x04\x00\x00\x00\x00\x00\x00\x00"
+        "\xA6" "values" "\xDA\x00\x20"
+            "\x02\x00\x00\x00\x00\x00\x00\x00" "\x02\x00\x00\x00\x00\x00\x00\x00"
+            "\x01\x00\x00\x00\x00\x00\x00\x00" "\x01\x00\x00\x00\x00\x00\x00\x00";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected) - 1));
+    mu_assert_mem(output->data, expected, sizeof(expected) - 1);
+    sky_buffer_free(output);
+    sky_next_action_message_free(message);
+    sky_table_free(table);
+
+    // String keys of a grouped message are written as an array.
+    importtmp("tests/fixtures/next_action_message/2/import.json");
+    table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    sky_table_open(table);
+    message = sky_next_action_message_create();
+    message->compact = true;
+    message->grouped = true;
+    message->group_property_id = -1;
+    message->prior_action_id_count = 2;
+    message->prior_action_ids = calloc(message->prior_action_id_count, sizeof(*message->prior_action_ids));
+    message->prior_action_ids[0] = 1;
+    message->prior_action_ids[1] = 2;
+    output = sky_buffer_create();
+    mu_assert_int_equals(sky_next_action_message_process(message, table, output), 0);
+
+    // {status:"ok", data:{names:["count"], keys:["ios", "ios", "web"], subkeys:<2, 3, 3>, values:<1, 1, 1>}}
+    char expected_grouped[] = "\x82" "\xA6" "status" "\xA2" "ok" "\xA4" "data" "\x84"
+        "\xA5" "names" "\x91" "\xA5" "count"
+        "\xA4" "keys" "\x93" "\xA3" "ios" "\xA3" "ios" "\xA3" "web"
+        "\xA7" "subkeys" "\xB8"
+            "\x02\x00\x00\x00\x00\x00\x00\x00" "\x03\x00\x00\x00\x00\x00\x00\x00"
+            "\x03\x00\x00\x00\x00\x00\x00\x00"
+        "\xA6" "values" "\xB8"
+            "\x01\x00\x00\x00\x00\x00\x00\x00" "\x01\x00\x00\x00\x00\x00\x00\x00"
+            "\x01\x00\x00\x00\x00\x00\x00\x00";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected_grouped) - 1));
+    mu_assert_mem(output->data, expected_grouped, sizeof(expected_grouped) - 1);
+    sky_buffer_free(output);
+    sky_next_action_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_next_action_message_process_continuous() {
+    importtmp("tests/fixtures/next_action_message/1/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    sky_table_open(table);
+
+    // Registering the query returns the same results as a scan.
+    sky_next_action_message *message = sky_next_action_message_create();
+    message->continuous = true;
+    message->prior_action_id_count = 2;
+    message->prior_action_ids = calloc(message->prior_action_id_count, sizeof(*message->prior_action_ids));
+    message->prior_action_ids[0] = 1;
+    message->prior_action_ids[1] = 2;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_next_action_message_process(message, table, output), 0);
+    mu_dump_buffer(output, "tmp/output");
     mu_assert_file("tmp/output", "tests/fixtures/next_action_message/1/output");
+    mu_assert_int_equals(table->continuous_query_count, 1);
+
+    // Later messages are answered from the continuous query.
+    message->continuous = false;
+    sky_buffer_clear(output);
+    table->continuous_queries[0]->result->values[0] = 9;
+    mu_assert_int_equals(sky_next_action_message_process(message, table, output), 0);
+    mu_assert_int_equals(output->data[25], 9);
+    sky_buffer_free(output);
+
+    sky_next_action_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_next_action_message_process_profile() {
+    size_t sz;
+    bstring str = NULL;
+    importtmp("tests/fixtures/next_action_message/1/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    sky_table_open(table);
+
+    sky_next_action_message *message = sky_next_action_message_create();
+    message->profile = true;
+    message->prior_action_id_count = 2;
+    message->prior_action_ids = calloc(message->prior_action_id_count, sizeof(*message->prior_action_ids));
+    message->prior_action_ids[0] = 1;
+    message->prior_action_ids[1] = 2;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_next_action_message_process(message, table, output), 0);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
+
+    // The profile follows the status and the data.
+    FILE *file = fopen("tmp/output", "r");
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 3);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "status"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "ok"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "data"); bdestroy(str);
+    sky_buffer *data = sky_buffer_create();
+    mu_assert_int_equals(sky_minipack_fread_elem(file, data), 0);
+    sky_buffer_free(data);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "profile"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 8);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "blocksVisited"); bdestroy(str);
+    mu_assert_bool(minipack_fread_uint(file, &sz) > 0);
+    fclose(file);
 
     sky_next_action_message_free(message);
     sky_table_free(table);
@@ -82,7 +311,13 @@ int test_sky_next_action_message_process() {
 int all_tests() {
     mu_run_test(test_sky_next_action_message_pack);
     mu_run_test(test_sky_next_action_message_unpack);
+    mu_run_test(test_sky_next_action_message_pack_unpack_profile);
     mu_run_test(test_sky_next_action_message_process);
+    mu_run_test(test_sky_next_action_message_process_distinct);
+    mu_run_test(test_sky_next_action_message_process_grouped);
+    mu_run_test(test_sky_next_action_message_process_compact);
+    mu_run_test(test_sky_next_action_message_process_continuous);
+    mu_run_test(test_sky_next_action_message_process_profile);
     return 0;
 }
 
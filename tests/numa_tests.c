@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <numa.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Topology
+//--------------------------------------
+
+int test_sky_numa_parse_list() {
+    uint32_t *values = NULL;
+    uint32_t count = 0;
+    struct tagbstring list_str = bsStatic("0-2,5, 7-8\n");
+    mu_assert_int_equals(sky_numa_parse_list(&list_str, &values, &count), 0);
+    mu_assert_int_equals(count, 6);
+    mu_assert_int_equals(values[0], 0);
+    mu_assert_int_equals(values[2], 2);
+    mu_assert_int_equals(values[3], 5);
+    mu_assert_int_equals(values[4], 7);
+    mu_assert_int_equals(values[5], 8);
+    free(values);
+
+    struct tagbstring empty_str = bsStatic("\n");
+    mu_assert_int_equals(sky_numa_parse_list(&empty_str, &values, &count), 0);
+    mu_assert_int_equals(count, 0);
+    free(values);
+
+    struct tagbstring invalid_str = bsStatic("3-1");
+    mu_assert_int_equals(sky_numa_parse_list(&invalid_str, &values, &count), -1);
+    mu_assert_bool(values == NULL);
+    return 0;
+}
+
+int test_sky_numa_load() {
+    struct tagbstring path = bsStatic("tests/fixtures/numa/0");
+    sky_numa *numa = sky_numa_create();
+    mu_assert_int_equals(sky_numa_load(numa, &path), 0);
+#if defined(__linux__)
+    // The node without CPUs is skipped.
+    mu_assert_int_equals(numa->node_count, 2);
+    mu_assert_int_equals(numa->nodes[0].id, 0);
+    mu_assert_int_equals(numa->nodes[0].cpu_count, 8);
+    mu_assert_int_equals(numa->nodes[0].cpus[4], 8);
+    mu_assert_int_equals(numa->nodes[1].id, 1);
+    mu_assert_int_equals(numa->nodes[1].cpu_count, 8);
+    mu_assert_int_equals(numa->nodes[1].cpus[0], 4);
+
+    // Threads are spread over the nodes in turn.
+    mu_assert_bool(sky_numa_get_node(numa, 0) == &numa->nodes[0]);
+    mu_assert_bool(sky_numa_get_node(numa, 1) == &numa->nodes[1]);
+    mu_assert_bool(sky_numa_get_node(numa, 2) == &numa->nodes[0]);
+#else
+    mu_assert_int_equals(numa->node_count, 0);
+#endif
+    sky_numa_free(numa);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_numa_parse_list);
+    mu_run_test(test_sky_numa_load);
+    return 0;
+}
+
+RUN_TESTS()
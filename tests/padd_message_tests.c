@@ -61,9 +61,10 @@ int test_sky_padd_message_process() {
     message->property->data_type = bfromcstr("Int");
     message->property->name = bfromcstr("foo");
 
-    FILE *output = fopen("tmp/output", "w");
+    sky_buffer *output = sky_buffer_create();
     mu_assert(sky_padd_message_process(message, table, output) == 0, "");
-    fclose(output);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
     mu_assert_file("tmp/properties", "tests/fixtures/padd_message/1/table/properties");
     mu_assert_file("tmp/output", "tests/fixtures/padd_message/1/output");
 
@@ -73,6 +74,65 @@ int test_sky_padd_message_process() {
 }
 
 
+int test_sky_padd_message_process_batch() {
+    uint32_t i;
+    cleantmp();
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    sky_table_open(table);
+
+    // Pack a batch and read it back.
+    char *names[] = {"foo", "bar", "baz"};
+    sky_padd_message *message = sky_padd_message_create();
+    message->properties = calloc(3, sizeof(*message->properties));
+    message->property_count = 3;
+    for(i=0; i<3; i++) {
+        message->properties[i] = sky_property_create();
+        message->properties[i]->type = SKY_PROPERTY_TYPE_OBJECT;
+        message->properties[i]->data_type = bfromcstr("Int");
+        message->properties[i]->name = bfromcstr(names[i]);
+    }
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_padd_message_pack(message, file), 0);
+    fclose(file);
+    sky_padd_message_free(message);
+
+    message = sky_padd_message_create();
+    file = fopen("tmp/message", "r");
+    mu_assert_int_equals(sky_padd_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_int_equals(message->property_count, 3);
+
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_padd_message_process(message, table, output), 0);
+    sky_buffer_free(output);
+    mu_assert_int_equals(table->property_file->property_count, 3);
+    for(i=0; i<3; i++) {
+        mu_assert_bstring(table->property_file->properties[i]->name, names[i]);
+    }
+    sky_padd_message_free(message);
+
+    // A batch with a name that is already defined adds nothing.
+    message = sky_padd_message_create();
+    message->properties = calloc(2, sizeof(*message->properties));
+    message->property_count = 2;
+    for(i=0; i<2; i++) {
+        message->properties[i] = sky_property_create();
+        message->properties[i]->type = SKY_PROPERTY_TYPE_OBJECT;
+        message->properties[i]->data_type = bfromcstr("Int");
+        message->properties[i]->name = bfromcstr(i == 0 ? "qux" : "foo");
+    }
+    output = sky_buffer_create();
+    mu_assert_int_equals(sky_padd_message_process(message, table, output), -1);
+    sky_buffer_free(output);
+    mu_assert_int_equals(table->property_file->property_count, 3);
+
+    sky_padd_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
 //==============================================================================
 //
 // Setup
@@ -83,6 +143,7 @@ int all_tests() {
     mu_run_test(test_sky_padd_message_pack);
     mu_run_test(test_sky_padd_message_unpack);
     mu_run_test(test_sky_padd_message_process);
+    mu_run_test(test_sky_padd_message_process_batch);
     return 0;
 }
 
@@ -52,9 +52,10 @@ int test_sky_pall_message_process() {
     
     sky_pall_message *message = sky_pall_message_create();
 
-    FILE *output = fopen("tmp/output", "w");
+    sky_buffer *output = sky_buffer_create();
     mu_assert(sky_pall_message_process(message, table, output) == 0, "");
-    fclose(output);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
     mu_assert_file("tmp/output", "tests/fixtures/pall_message/1/output");
 
     sky_pall_message_free(message);
@@ -0,0 +1,299 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <file.h>
+#include <partition_set.h>
+#include <cursor.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// One day in microseconds.
+#define DAY (86400LL * 1000000LL)
+
+#define INIT_PARTITION_SET() do {\
+    cleantmp(); \
+    partition_set = sky_partition_set_create(); \
+    partition_set->path = bfromcstr("tmp/partitions"); \
+    partition_set->period = 86400; \
+    partition_set->block_size = 128; \
+    mu_assert_int_equals(sky_partition_set_load(partition_set), 0); \
+} while(0)
+
+#define ADD_EVENT(OBJECT_ID, TIMESTAMP, ACTION_ID) do { \
+    sky_event *_event = sky_event_create(OBJECT_ID, TIMESTAMP, ACTION_ID); \
+    mu_assert_int_equals(sky_partition_set_add_event(partition_set, _event), 0); \
+    sky_event_free(_event); \
+} while (0)
+
+// Asserts that a list of path parts holds events with the given timestamps
+// in order.
+#define ASSERT_PATHS_TIMESTAMPS(PATHS, PATH_COUNT, ...) do {\
+    sky_timestamp_t _expected[] = {__VA_ARGS__}; \
+    uint32_t _i, _count = sizeof(_expected) / sizeof(*_expected); \
+    sky_cursor _cursor; \
+    sky_cursor_init(&_cursor); \
+    mu_assert_int_equals(sky_cursor_set_paths(&_cursor, PATHS, PATH_COUNT), 0); \
+    for(_i=0; _i<_count; _i++) { \
+        sky_timestamp_t _timestamp; \
+        mu_assert_bool(!_cursor.eof); \
+        mu_assert_int_equals(sky_cursor_get_timestamp(&_cursor, &_timestamp), 0); \
+        mu_assert_int64_equals(_timestamp, _expected[_i]); \
+        mu_assert_int_equals(sky_cursor_next(&_cursor), 0); \
+    } \
+    mu_assert_bool(_cursor.eof); \
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Periods
+//--------------------------------------
+
+int test_sky_partition_set_get_period_start() {
+    sky_partition_set *partition_set = sky_partition_set_create();
+    partition_set->period = 86400;
+    mu_assert_int64_equals(sky_partition_set_get_period_start(partition_set, 0), 0LL);
+    mu_assert_int64_equals(sky_partition_set_get_period_start(partition_set, DAY - 1), 0LL);
+    mu_assert_int64_equals(sky_partition_set_get_period_start(partition_set, DAY), DAY);
+    mu_assert_int64_equals(sky_partition_set_get_period_start(partition_set, (3 * DAY) + 10), 3 * DAY);
+    mu_assert_int64_equals(sky_partition_set_get_period_start(partition_set, -1), -DAY);
+    mu_assert_int64_equals(sky_partition_set_get_period_start(partition_set, -DAY), -DAY);
+    sky_partition_set_free(partition_set);
+    return 0;
+}
+
+int test_sky_partition_set_load_period() {
+    sky_partition_set *partition_set = NULL;
+    INIT_PARTITION_SET();
+    ADD_EVENT(1, DAY, 1);
+    sky_partition_set_free(partition_set);
+
+    // The period the set was created with is kept.
+    partition_set = sky_partition_set_create();
+    partition_set->path = bfromcstr("tmp/partitions");
+    partition_set->period = 3600;
+    mu_assert_int_equals(sky_partition_set_load(partition_set), 0);
+    mu_assert_int_equals(partition_set->period, 86400);
+    mu_assert_int_equals(partition_set->partition_count, 1);
+    mu_assert_int64_equals(partition_set->partitions[0].min_timestamp, DAY);
+    sky_partition_set_free(partition_set);
+
+    // A new set needs a period.
+    cleantmp();
+    partition_set = sky_partition_set_create();
+    partition_set->path = bfromcstr("tmp/partitions");
+    mu_assert_int_equals(sky_partition_set_load(partition_set), -1);
+    sky_partition_set_free(partition_set);
+    return 0;
+}
+
+
+//--------------------------------------
+// Add Event
+//--------------------------------------
+
+int test_sky_partition_set_add_event() {
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_partition_set *partition_set = NULL;
+    INIT_PARTITION_SET();
+
+    // Events are routed to the partition of their day.
+    ADD_EVENT(1, (2 * DAY) + 10, 1);
+    ADD_EVENT(1, 10, 1);
+    ADD_EVENT(2, 20, 2);
+    ADD_EVENT(1, DAY + 10, 1);
+    ADD_EVENT(1, 20, 1);
+    mu_assert_int_equals(partition_set->partition_count, 3);
+    mu_assert_int64_equals(partition_set->partitions[0].min_timestamp, 0LL);
+    mu_assert_int64_equals(partition_set->partitions[1].min_timestamp, DAY);
+    mu_assert_int64_equals(partition_set->partitions[2].min_timestamp, 2 * DAY);
+    mu_assert_bool(sky_file_exists(&((struct tagbstring)bsStatic("tmp/partitions/86400/data"))));
+
+    // The parts of a path are returned in time order.
+    mu_assert_int_equals(sky_partition_set_find_path(partition_set, 1, 0, 3 * DAY, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 3);
+    ASSERT_PATHS_TIMESTAMPS(paths, path_count, 10LL, 20LL, DAY + 10, (2 * DAY) + 10);
+    free(paths);
+
+    // Only the partitions that overlap the range are searched.
+    mu_assert_int_equals(sky_partition_set_find_path(partition_set, 1, (2 * DAY) + 5, 3 * DAY, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    ASSERT_PATHS_TIMESTAMPS(paths, path_count, (2 * DAY) + 10);
+    free(paths);
+
+    mu_assert_int_equals(sky_partition_set_find_path(partition_set, 2, DAY, 3 * DAY, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    mu_assert_bool(paths == NULL);
+
+    // The partitions are found again after reloading.
+    mu_assert_int_equals(sky_partition_set_unload(partition_set), 0);
+    mu_assert_int_equals(sky_partition_set_load(partition_set), 0);
+    mu_assert_int_equals(partition_set->partition_count, 3);
+    mu_assert_int64_equals(partition_set->partitions[2].min_timestamp, 2 * DAY);
+    mu_assert_int_equals(sky_partition_set_find_path(partition_set, 1, 0, 3 * DAY, &paths, &path_count), 0);
+    ASSERT_PATHS_TIMESTAMPS(paths, path_count, 10LL, 20LL, DAY + 10, (2 * DAY) + 10);
+    free(paths);
+
+    sky_partition_set_free(partition_set);
+    return 0;
+}
+
+
+//--------------------------------------
+// Iteration
+//--------------------------------------
+
+int test_sky_partition_iterator_next() {
+    sky_partition_set *partition_set = NULL;
+    INIT_PARTITION_SET();
+    ADD_EVENT(3, 10, 1);
+    ADD_EVENT(1, 20, 1);
+    ADD_EVENT(2, DAY + 10, 1);
+    ADD_EVENT(3, DAY + 20, 1);
+    ADD_EVENT(4, (2 * DAY) + 10, 1);
+
+    // Objects are returned in order with their parts from each partition.
+    sky_partition_iterator iterator;
+    sky_partition_iterator_init(&iterator);
+    mu_assert_int_equals(sky_partition_iterator_set_partition_set(&iterator, partition_set, 0, 3 * DAY), 0);
+    mu_assert_int_equals(iterator.iterator_count, 3);
+    mu_assert_bool(!iterator.eof);
+    mu_assert_int64_equals(iterator.current_object_id, 1LL);
+    ASSERT_PATHS_TIMESTAMPS(iterator.paths, iterator.path_count, 20LL);
+    mu_assert_int_equals(sky_partition_iterator_next(&iterator), 0);
+    mu_assert_int64_equals(iterator.current_object_id, 2LL);
+    ASSERT_PATHS_TIMESTAMPS(iterator.paths, iterator.path_count, DAY + 10);
+    mu_assert_int_equals(sky_partition_iterator_next(&iterator), 0);
+    mu_assert_int64_equals(iterator.current_object_id, 3LL);
+    mu_assert_int_equals(iterator.path_count, 2);
+    ASSERT_PATHS_TIMESTAMPS(iterator.paths, iterator.path_count, 10LL, DAY + 20);
+    mu_assert_int_equals(sky_partition_iterator_next(&iterator), 0);
+    mu_assert_int64_equals(iterator.current_object_id, 4LL);
+    mu_assert_int_equals(sky_partition_iterator_next(&iterator), 0);
+    mu_assert_bool(iterator.eof);
+
+    // A bounded range only opens the partitions that overlap it.
+    mu_assert_int_equals(sky_partition_iterator_set_partition_set(&iterator, partition_set, DAY, (2 * DAY) - 1), 0);
+    mu_assert_int_equals(iterator.iterator_count, 1);
+    mu_assert_int64_equals(iterator.current_object_id, 2LL);
+    mu_assert_int_equals(sky_partition_iterator_next(&iterator), 0);
+    mu_assert_int64_equals(iterator.current_object_id, 3LL);
+    ASSERT_PATHS_TIMESTAMPS(iterator.paths, iterator.path_count, DAY + 20);
+    mu_assert_int_equals(sky_partition_iterator_next(&iterator), 0);
+    mu_assert_bool(iterator.eof);
+    sky_partition_iterator_uninit(&iterator);
+
+    sky_partition_set_free(partition_set);
+    return 0;
+}
+
+int test_sky_partition_iterator_next_spanned() {
+    uint32_t i;
+    sky_partition_set *partition_set = NULL;
+    INIT_PARTITION_SET();
+    for(i=0; i<40; i++) {
+        ADD_EVENT(1, DAY + (i * 1000), 1);
+    }
+    ADD_EVENT(1, 10, 1);
+    ADD_EVENT(2, DAY + 10, 1);
+
+    sky_partition_iterator iterator;
+    sky_partition_iterator_init(&iterator);
+    mu_assert_int_equals(sky_partition_iterator_set_partition_set(&iterator, partition_set, 0, 3 * DAY), 0);
+    mu_assert_bool(partition_set->partitions[1].data_file->block_count > 1);
+    mu_assert_int64_equals(iterator.current_object_id, 1LL);
+    mu_assert_bool(iterator.path_count > 2);
+    sky_cursor cursor;
+    sky_cursor_init(&cursor);
+    mu_assert_int_equals(sky_cursor_set_paths(&cursor, iterator.paths, iterator.path_count), 0);
+    sky_timestamp_t timestamp;
+    mu_assert_int_equals(sky_cursor_get_timestamp(&cursor, &timestamp), 0);
+    mu_assert_int64_equals(timestamp, 10LL);
+    for(i=0; i<40; i++) {
+        mu_assert_int_equals(sky_cursor_next(&cursor), 0);
+        mu_assert_int_equals(sky_cursor_get_timestamp(&cursor, &timestamp), 0);
+        mu_assert_int64_equals(timestamp, DAY + (i * 1000));
+    }
+    mu_assert_int_equals(sky_cursor_next(&cursor), 0);
+    mu_assert_bool(cursor.eof);
+    mu_assert_int_equals(sky_partition_iterator_next(&iterator), 0);
+    mu_assert_int64_equals(iterator.current_object_id, 2LL);
+    mu_assert_int_equals(sky_partition_iterator_next(&iterator), 0);
+    mu_assert_bool(iterator.eof);
+    sky_partition_iterator_uninit(&iterator);
+
+    sky_partition_set_free(partition_set);
+    return 0;
+}
+
+
+//--------------------------------------
+// Expire
+//--------------------------------------
+
+int test_sky_partition_set_expire() {
+    uint32_t count = 0;
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_partition_set *partition_set = NULL;
+    INIT_PARTITION_SET();
+    ADD_EVENT(1, 10, 1);
+    ADD_EVENT(1, DAY + 10, 1);
+    ADD_EVENT(1, (2 * DAY) + 10, 1);
+
+    // A partition is only dropped once its whole period is before the cutoff.
+    mu_assert_int_equals(sky_partition_set_expire(partition_set, (2 * DAY) - 1, &count), 0);
+    mu_assert_int_equals(count, 1);
+    mu_assert_int_equals(partition_set->partition_count, 2);
+    mu_assert_int64_equals(partition_set->partitions[0].min_timestamp, DAY);
+    mu_assert_bool(!sky_file_exists(&((struct tagbstring)bsStatic("tmp/partitions/0"))));
+    mu_assert_bool(sky_file_exists(&((struct tagbstring)bsStatic("tmp/partitions/86400"))));
+
+    mu_assert_int_equals(sky_partition_set_expire(partition_set, 2 * DAY, &count), 0);
+    mu_assert_int_equals(count, 1);
+    mu_assert_int_equals(partition_set->partition_count, 1);
+    mu_assert_int_equals(sky_partition_set_find_path(partition_set, 1, 0, 3 * DAY, &paths, &path_count), 0);
+    ASSERT_PATHS_TIMESTAMPS(paths, path_count, (2 * DAY) + 10);
+    free(paths);
+
+    mu_assert_int_equals(sky_partition_set_unload(partition_set), 0);
+    mu_assert_int_equals(sky_partition_set_load(partition_set), 0);
+    mu_assert_int_equals(partition_set->partition_count, 1);
+
+    sky_partition_set_free(partition_set);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_partition_set_get_period_start);
+    mu_run_test(test_sky_partition_set_load_period);
+    mu_run_test(test_sky_partition_set_add_event);
+    mu_run_test(test_sky_partition_iterator_next);
+    mu_run_test(test_sky_partition_iterator_next_spanned);
+    mu_run_test(test_sky_partition_set_expire);
+    return 0;
+}
+
+RUN_TESTS()
@@ -44,20 +44,20 @@ int test_sky_path_iterator_single_block_next() {
     // Path 2
     rc = sky_path_iterator_next(iterator);
     mu_assert_int_equals(rc, 0);
-    mu_assert_int_equals(iterator->byte_index, 19);
+    mu_assert_int_equals(iterator->byte_index, 23);
     mu_assert_bool(!iterator->eof);
     rc = sky_path_iterator_get_ptr(iterator, &ptr);
     mu_assert_int_equals(rc, 0);
-    mu_assert_long_equals(ptr-block_ptr, 19L);
+    mu_assert_long_equals(ptr-block_ptr, 23L);
     
     // Path 3
     rc = sky_path_iterator_next(iterator);
     mu_assert_int_equals(rc, 0);
-    mu_assert_int_equals(iterator->byte_index, 47);
+    mu_assert_int_equals(iterator->byte_index, 55);
     mu_assert_bool(!iterator->eof);
     rc = sky_path_iterator_get_ptr(iterator, &ptr);
     mu_assert_int_equals(rc, 0);
-    mu_assert_long_equals(ptr-block_ptr, 47L);
+    mu_assert_long_equals(ptr-block_ptr, 55L);
     
     // EOF
     rc = sky_path_iterator_next(iterator);
@@ -93,19 +93,19 @@ int test_sky_path_iterator_data_file_next() {
     // Path 1
     rc = sky_path_iterator_get_ptr(iterator, &ptr);
     mu_assert_int_equals(rc, 0);
-    mu_assert_long_equals(ptr-data_file->data, 0L);
+    mu_assert_long_equals(ptr-data_file->extents[0].data, 0L);
     mu_assert_int_equals(iterator->current_object_id, 2);
     mu_assert_bool(!iterator->eof);
 
     // Path 2
     rc = sky_path_iterator_next(iterator);
     mu_assert_int_equals(rc, 0);
-    mu_assert_int_equals(iterator->byte_index, 19);
+    mu_assert_int_equals(iterator->byte_index, 23);
     mu_assert_int_equals(iterator->current_object_id, 3);
     mu_assert_bool(!iterator->eof);
     rc = sky_path_iterator_get_ptr(iterator, &ptr);
     mu_assert_int_equals(rc, 0);
-    mu_assert_long_equals(ptr-data_file->data, 19L);
+    mu_assert_long_equals(ptr-data_file->extents[0].data, 23L);
     
     // Path 3 (Spanned)
     rc = sky_path_iterator_next(iterator);
@@ -115,7 +115,7 @@ int test_sky_path_iterator_data_file_next() {
     mu_assert_bool(!iterator->eof);
     rc = sky_path_iterator_get_ptr(iterator, &ptr);
     mu_assert_int_equals(rc, 0);
-    mu_assert_long_equals(ptr-data_file->data, 64L);
+    mu_assert_long_equals(ptr-data_file->extents[0].data, 64L);
     
     // Path 4
     rc = sky_path_iterator_next(iterator);
@@ -125,7 +125,7 @@ int test_sky_path_iterator_data_file_next() {
     mu_assert_bool(!iterator->eof);
     rc = sky_path_iterator_get_ptr(iterator, &ptr);
     mu_assert_int_equals(rc, 0);
-    mu_assert_long_equals(ptr-data_file->data, 128L);
+    mu_assert_long_equals(ptr-data_file->extents[0].data, 128L);
     
     // EOF
     rc = sky_path_iterator_next(iterator);
@@ -138,6 +138,188 @@ int test_sky_path_iterator_data_file_next() {
     return 0;
 }
 
+int test_sky_path_iterator_next_batch() {
+    loadtmp("tests/fixtures/path_iterator/1");
+    int rc;
+    sky_path_iterator_batch batch;
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    sky_data_file_load(data_file);
+
+    sky_path_iterator iterator;
+    sky_path_iterator_init(&iterator);
+    sky_path_iterator_set_data_file(&iterator, data_file);
+
+    // Both paths of the first block.
+    rc = sky_path_iterator_next_batch(&iterator, &batch);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(batch.count, 2);
+    mu_assert_int_equals(batch.object_ids[0], 2);
+    mu_assert_int_equals(batch.object_ids[1], 3);
+    mu_assert_long_equals(batch.paths[0]-data_file->extents[0].data, 0L);
+    mu_assert_long_equals(batch.paths[1]-data_file->extents[0].data, 23L);
+    mu_assert_int_equals(iterator.block_index, 0);
+
+    // Spanned path on its own.
+    rc = sky_path_iterator_next_batch(&iterator, &batch);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(batch.count, 1);
+    mu_assert_int_equals(batch.object_ids[0], 4);
+    mu_assert_long_equals(batch.paths[0]-data_file->extents[0].data, 64L);
+
+    // Last path.
+    rc = sky_path_iterator_next_batch(&iterator, &batch);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(batch.count, 1);
+    mu_assert_int_equals(batch.object_ids[0], 5);
+    mu_assert_long_equals(batch.paths[0]-data_file->extents[0].data, 128L);
+    mu_assert_bool(!iterator.eof);
+
+    // EOF
+    rc = sky_path_iterator_next_batch(&iterator, &batch);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(batch.count, 0);
+    mu_assert_bool(iterator.eof);
+    rc = sky_path_iterator_next_batch(&iterator, &batch);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(batch.count, 0);
+
+    sky_path_iterator_uninit(&iterator);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Block Range
+//--------------------------------------
+
+int test_sky_path_iterator_block_range_next() {
+    loadtmp("tests/fixtures/path_iterator/1");
+    int rc;
+    uint32_t boundaries[3];
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    sky_data_file_load(data_file);
+
+    // Partitions do not start inside the span of object 4.
+    rc = sky_data_file_get_partitions(data_file, 2, boundaries);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(boundaries[0], 0);
+    mu_assert_int_equals(boundaries[1], 3);
+    mu_assert_int_equals(boundaries[2], 4);
+
+    // First range.
+    sky_path_iterator *iterator = sky_path_iterator_create();
+    rc = sky_path_iterator_set_block_range(iterator, data_file, boundaries[0], boundaries[1]);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(iterator->current_object_id, 2);
+    mu_assert_int_equals(sky_path_iterator_next(iterator), 0);
+    mu_assert_int_equals(iterator->current_object_id, 3);
+    mu_assert_int_equals(sky_path_iterator_next(iterator), 0);
+    mu_assert_int_equals(iterator->current_object_id, 4);
+    mu_assert_int_equals(sky_path_iterator_next(iterator), 0);
+    mu_assert_bool(iterator->eof);
+
+    // Second range.
+    rc = sky_path_iterator_set_block_range(iterator, data_file, boundaries[1], boundaries[2]);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_bool(!iterator->eof);
+    mu_assert_int_equals(iterator->current_object_id, 5);
+    mu_assert_int_equals(sky_path_iterator_next(iterator), 0);
+    mu_assert_bool(iterator->eof);
+
+    // Empty range.
+    rc = sky_path_iterator_set_block_range(iterator, data_file, 4, 4);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_bool(iterator->eof);
+
+    sky_path_iterator_free(iterator);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Timestamp Range
+//--------------------------------------
+
+int test_sky_path_iterator_timestamp_range_next() {
+    loadtmp("tests/fixtures/path_iterator/1");
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    sky_data_file_load(data_file);
+
+    // Only the first block has events at timestamp 27.
+    sky_path_iterator *iterator = sky_path_iterator_create();
+    mu_assert_int_equals(sky_path_iterator_set_timestamp_range(iterator, 27, 30), 0);
+    mu_assert_int_equals(sky_path_iterator_set_data_file(iterator, data_file), 0);
+    mu_assert_int_equals(iterator->current_object_id, 2);
+    mu_assert_int_equals(sky_path_iterator_next(iterator), 0);
+    mu_assert_int_equals(iterator->current_object_id, 3);
+    mu_assert_int_equals(sky_path_iterator_next(iterator), 0);
+    mu_assert_bool(iterator->eof);
+
+    // A span is kept if any of its blocks overlap and it is entered at its
+    // first block.
+    data_file->blocks[2]->max_timestamp = 40;
+    mu_assert_int_equals(sky_path_iterator_set_timestamp_range(iterator, 30, 40), 0);
+    mu_assert_int_equals(sky_path_iterator_set_data_file(iterator, data_file), 0);
+    mu_assert_bool(!iterator->eof);
+    mu_assert_int_equals(iterator->block_index, 1);
+    mu_assert_int_equals(iterator->current_object_id, 4);
+    mu_assert_int_equals(sky_path_iterator_next(iterator), 0);
+    mu_assert_bool(iterator->eof);
+
+    // No blocks are in the range.
+    mu_assert_int_equals(sky_path_iterator_set_timestamp_range(iterator, 0, 25), 0);
+    mu_assert_int_equals(sky_path_iterator_set_data_file(iterator, data_file), 0);
+    mu_assert_bool(iterator->eof);
+
+    // Single blocks are pruned too.
+    mu_assert_int_equals(sky_path_iterator_set_block(iterator, data_file->blocks[0]), 0);
+    mu_assert_bool(iterator->eof);
+
+    sky_path_iterator_free(iterator);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+
+//--------------------------------------
+// Prefetching
+//--------------------------------------
+
+int test_sky_path_iterator_prefetch() {
+    loadtmp("tests/fixtures/path_iterator/1");
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    sky_data_file_load(data_file);
+
+    // The blocks after the first block are advised up front.
+    sky_path_iterator *iterator = sky_path_iterator_create();
+    mu_assert_int_equals(sky_path_iterator_set_data_file(iterator, data_file), 0);
+    mu_assert_int_equals(iterator->prefetch_block_index, 4);
+
+    // Read ahead stops at the end of a block range.
+    mu_assert_int_equals(sky_path_iterator_set_block_range(iterator, data_file, 0, 3), 0);
+    mu_assert_int_equals(iterator->prefetch_block_index, 3);
+    mu_assert_int_equals(sky_path_iterator_set_block_range(iterator, data_file, 3, 4), 0);
+    mu_assert_int_equals(iterator->prefetch_block_index, 4);
+
+    // Single block iterators do not read ahead.
+    mu_assert_int_equals(sky_path_iterator_set_block(iterator, data_file->blocks[0]), 0);
+    mu_assert_int_equals(iterator->prefetch_block_index, 4);
+
+    sky_path_iterator_free(iterator);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
 
 //==============================================================================
 //
@@ -148,6 +330,10 @@ int test_sky_path_iterator_data_file_next() {
 int all_tests() {
     mu_run_test(test_sky_path_iterator_single_block_next);
     mu_run_test(test_sky_path_iterator_data_file_next);
+    mu_run_test(test_sky_path_iterator_next_batch);
+    mu_run_test(test_sky_path_iterator_block_range_next);
+    mu_run_test(test_sky_path_iterator_timestamp_range_next);
+    mu_run_test(test_sky_path_iterator_prefetch);
     return 0;
 }
 
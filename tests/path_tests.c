@@ -33,12 +33,13 @@ struct tagbstring foo = bsStatic("foo");
 struct tagbstring bar = bsStatic("bar");
 struct tagbstring baz = bsStatic("baz");
 
-size_t DATA_LENGTH = 62;
+size_t DATA_LENGTH = 66;
 char DATA[] = 
-    "\x02\x00\x00\x00\x36\x00\x00\x00\x01\x1a\x00\x00\x00\x00\x00\x00"
-    "\x00\x06\x00\x03\x1c\x00\x00\x00\x00\x00\x00\x00\x07\x00\x0a\x00"
-    "\x00\x00\x01\xa3\x66\x6f\x6f\x02\xa3\x62\x61\x72\x02\x1d\x00\x00"
-    "\x00\x00\x00\x00\x00\x05\x00\x00\x00\x01\xa3\x66\x6f\x6f"
+    "\x02\x00\x00\x00\x00\x00\x00\x00\x36\x00\x00\x00\x01\x1a\x00\x00"
+    "\x00\x00\x00\x00\x00\x06\x00\x03\x1c\x00\x00\x00\x00\x00\x00\x00"
+    "\x07\x00\x0a\x00\x00\x00\x01\xa3\x66\x6f\x6f\x02\xa3\x62\x61\x72"
+    "\x02\x1d\x00\x00\x00\x00\x00\x00\x00\x05\x00\x00\x00\x01\xa3\x66"
+    "\x6f\x6f"
 ;
 
 
@@ -200,9 +201,9 @@ int test_sky_path_get_event_stats_with_no_event() {
     int rc = sky_path_get_event_stats(&DATA, NULL, &events, &event_count);
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(event_count, 3);
-    ASSERT_EVENT_STAT(events[0], 26LL, 8L, 19L, 11L);
-    ASSERT_EVENT_STAT(events[1], 28LL, 19L, 44L, 25L);
-    ASSERT_EVENT_STAT(events[2], 29LL, 44L, 62L, 18L);
+    ASSERT_EVENT_STAT(events[0], 26LL, 12L, 23L, 11L);
+    ASSERT_EVENT_STAT(events[1], 28LL, 23L, 48L, 25L);
+    ASSERT_EVENT_STAT(events[2], 29LL, 48L, 66L, 18L);
     free(events);
     return 0;
 }
@@ -214,10 +215,10 @@ int test_sky_path_get_event_stats_with_starting_event() {
     int rc = sky_path_get_event_stats(&DATA, event, &events, &event_count);
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(event_count, 4);
-    ASSERT_EVENT_STAT(events[0], 25LL, 8L, 8L, 11L);
-    ASSERT_EVENT_STAT(events[1], 26LL, 8L, 19L, 11L);
-    ASSERT_EVENT_STAT(events[2], 28LL, 19L, 44L, 25L);
-    ASSERT_EVENT_STAT(events[3], 29LL, 44L, 62L, 18L);
+    ASSERT_EVENT_STAT(events[0], 25LL, 12L, 12L, 11L);
+    ASSERT_EVENT_STAT(events[1], 26LL, 12L, 23L, 11L);
+    ASSERT_EVENT_STAT(events[2], 28LL, 23L, 48L, 25L);
+    ASSERT_EVENT_STAT(events[3], 29LL, 48L, 66L, 18L);
     sky_event_free(event);
     free(events);
     return 0;
@@ -230,10 +231,10 @@ int test_sky_path_get_event_stats_with_middle_event() {
     int rc = sky_path_get_event_stats(&DATA, event, &events, &event_count);
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(event_count, 4);
-    ASSERT_EVENT_STAT(events[0], 26LL, 8L, 19L, 11L);
-    ASSERT_EVENT_STAT(events[1], 27LL, 19L, 19L, 11L);
-    ASSERT_EVENT_STAT(events[2], 28LL, 19L, 44L, 25L);
-    ASSERT_EVENT_STAT(events[3], 29LL, 44L, 62L, 18L);
+    ASSERT_EVENT_STAT(events[0], 26LL, 12L, 23L, 11L);
+    ASSERT_EVENT_STAT(events[1], 27LL, 23L, 23L, 11L);
+    ASSERT_EVENT_STAT(events[2], 28LL, 23L, 48L, 25L);
+    ASSERT_EVENT_STAT(events[3], 29LL, 48L, 66L, 18L);
     sky_event_free(event);
     free(events);
     return 0;
@@ -246,10 +247,10 @@ int test_sky_path_get_event_stats_with_ending_event() {
     int rc = sky_path_get_event_stats(&DATA, event, &events, &event_count);
     mu_assert_int_equals(rc, 0);
     mu_assert_int_equals(event_count, 4);
-    ASSERT_EVENT_STAT(events[0], 26LL, 8L, 19L, 11L);
-    ASSERT_EVENT_STAT(events[1], 28LL, 19L, 44L, 25L);
-    ASSERT_EVENT_STAT(events[2], 29LL, 44L, 62L, 18L);
-    ASSERT_EVENT_STAT(events[3], 30LL, 62L, 62L, 11L);
+    ASSERT_EVENT_STAT(events[0], 26LL, 12L, 23L, 11L);
+    ASSERT_EVENT_STAT(events[1], 28LL, 23L, 48L, 25L);
+    ASSERT_EVENT_STAT(events[2], 29LL, 48L, 66L, 18L);
+    ASSERT_EVENT_STAT(events[3], 30LL, 66L, 66L, 11L);
     sky_event_free(event);
     free(events);
     return 0;
@@ -55,9 +55,10 @@ int test_sky_pget_message_process() {
     sky_pget_message *message = sky_pget_message_create();
     message->property_id = 1;
 
-    FILE *output = fopen("tmp/output", "w");
+    sky_buffer *output = sky_buffer_create();
     mu_assert(sky_pget_message_process(message, table, output) == 0, "");
-    fclose(output);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
     mu_assert_file("tmp/output", "tests/fixtures/pget_message/1/output");
 
     sky_pget_message_free(message);
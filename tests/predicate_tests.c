@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <predicate.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Fixtures
+//
+//==============================================================================
+
+// Property 1 is 10, property 2 is 300 and property -1 is true.
+unsigned char DATA[] = {
+    0x01, 0x0A,
+    0x02, 0xCD, 0x01, 0x2C,
+    0xFF, 0xC3
+};
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+#define EVAL(ACTION_ID, TIMESTAMP) \
+    predicate->eval(predicate, ACTION_ID, TIMESTAMP, DATA, sizeof(DATA))
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Compilation
+//--------------------------------------
+
+int test_sky_predicate_compile_intersect() {
+    sky_query_filter filters[] = {
+        {SKY_QUERY_FIELD_ACTION, 0, 1, 10},
+        {SKY_QUERY_FIELD_ACTION, 0, 5, 20},
+        {SKY_QUERY_FIELD_TIMESTAMP, 0, 100, 200},
+    };
+    sky_predicate *predicate = sky_predicate_create();
+    mu_assert_bool(EVAL(100, 0));
+    mu_assert_int_equals(sky_predicate_compile(predicate, filters, 3), 0);
+    mu_assert_long_equals(predicate->min_action_id, 5L);
+    mu_assert_long_equals(predicate->max_action_id, 10L);
+    mu_assert_bool(!sky_predicate_uses_data(predicate));
+    mu_assert_bool(EVAL(5, 100));
+    mu_assert_bool(EVAL(10, 200));
+    mu_assert_bool(!EVAL(4, 150));
+    mu_assert_bool(!EVAL(11, 150));
+    mu_assert_bool(!EVAL(7, 201));
+    sky_predicate_free(predicate);
+    return 0;
+}
+
+int test_sky_predicate_compile_empty() {
+    sky_query_filter filters[] = {
+        {SKY_QUERY_FIELD_PROPERTY, 1, 0, 10},
+        {SKY_QUERY_FIELD_PROPERTY, 1, 20, 30},
+    };
+    sky_block block;
+    block.min_timestamp = 0;
+    block.max_timestamp = 1000;
+    sky_predicate *predicate = sky_predicate_create();
+    mu_assert_int_equals(sky_predicate_compile(predicate, filters, 2), 0);
+    mu_assert_bool(!EVAL(1, 0));
+    mu_assert_bool(!sky_predicate_may_match_block(predicate, &block));
+    sky_predicate_free(predicate);
+    return 0;
+}
+
+
+//--------------------------------------
+// Evaluation
+//--------------------------------------
+
+int test_sky_predicate_eval_properties() {
+    sky_query_filter filters[] = {
+        {SKY_QUERY_FIELD_PROPERTY, 2, 300, 300},
+        {SKY_QUERY_FIELD_PROPERTY, -1, 1, 1},
+        {SKY_QUERY_FIELD_PROPERTY, 1, 0, 10},
+    };
+    sky_predicate *predicate = sky_predicate_create();
+    mu_assert_int_equals(sky_predicate_compile(predicate, filters, 3), 0);
+    mu_assert_bool(sky_predicate_uses_data(predicate));
+    mu_assert_bool(EVAL(1, 0));
+
+    // Out of range.
+    filters[2].max = 9;
+    mu_assert_int_equals(sky_predicate_compile(predicate, filters, 3), 0);
+    mu_assert_bool(!EVAL(1, 0));
+
+    // Missing property.
+    filters[2].property_id = 3;
+    filters[2].max = 10;
+    mu_assert_int_equals(sky_predicate_compile(predicate, filters, 3), 0);
+    mu_assert_bool(!EVAL(1, 0));
+    mu_assert_bool(!predicate->eval(predicate, 1, 0, NULL, 0));
+    sky_predicate_free(predicate);
+    return 0;
+}
+
+int test_sky_predicate_may_match_block() {
+    sky_query_filter filters[] = {
+        {SKY_QUERY_FIELD_TIMESTAMP, 0, 100, 200},
+    };
+    sky_block block;
+    sky_predicate *predicate = sky_predicate_create();
+    mu_assert_int_equals(sky_predicate_compile(predicate, filters, 1), 0);
+    block.min_timestamp = 0; block.max_timestamp = 99;
+    mu_assert_bool(!sky_predicate_may_match_block(predicate, &block));
+    block.min_timestamp = 0; block.max_timestamp = 100;
+    mu_assert_bool(sky_predicate_may_match_block(predicate, &block));
+    block.min_timestamp = 200; block.max_timestamp = 300;
+    mu_assert_bool(sky_predicate_may_match_block(predicate, &block));
+    block.min_timestamp = 201; block.max_timestamp = 300;
+    mu_assert_bool(!sky_predicate_may_match_block(predicate, &block));
+    sky_predicate_free(predicate);
+    return 0;
+}
+
+
+int test_sky_predicate_may_match_block_zones() {
+    sky_query_filter filters[] = {
+        {SKY_QUERY_FIELD_PROPERTY, 2, 100, 200},
+    };
+    sky_block_zone zones[] = {{1, 0, 1000}, {2, 0, 99}};
+    sky_block block;
+    memset(&block, 0, sizeof(block));
+    block.max_timestamp = 1000;
+    block.zones_valid = true;
+    block.zones = zones;
+    block.zone_count = 2;
+    sky_predicate *predicate = sky_predicate_create();
+    mu_assert_int_equals(sky_predicate_compile(predicate, filters, 1), 0);
+    mu_assert_bool(!sky_predicate_may_match_block(predicate, &block));
+    zones[1].max = 100;
+    mu_assert_bool(sky_predicate_may_match_block(predicate, &block));
+    zones[1].min = 201; zones[1].max = 300;
+    mu_assert_bool(!sky_predicate_may_match_block(predicate, &block));
+
+    // Blocks without the property cannot match.
+    block.zone_count = 1;
+    mu_assert_bool(!sky_predicate_may_match_block(predicate, &block));
+    sky_predicate_free(predicate);
+    return 0;
+}
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_predicate_compile_intersect);
+    mu_run_test(test_sky_predicate_compile_empty);
+    mu_run_test(test_sky_predicate_eval_properties);
+    mu_run_test(test_sky_predicate_may_match_block);
+    mu_run_test(test_sky_predicate_may_match_block_zones);
+    return 0;
+}
+
+RUN_TESTS()
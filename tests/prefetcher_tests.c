@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <prefetcher.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Requests
+//--------------------------------------
+
+int test_sky_prefetcher_read() {
+    size_t length = 4 * (size_t)sysconf(_SC_PAGESIZE);
+    void *ptr = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    mu_assert_bool(ptr != MAP_FAILED);
+
+    // Ranges are widened to pages.
+    mu_assert_int_equals(sky_prefetcher_read(ptr + 10, 100), 0);
+    mu_assert_int_equals(sky_prefetcher_read(ptr, length), 0);
+    mu_assert_int_equals(sky_prefetcher_read(NULL, 0), 0);
+
+    // Unmapped ranges fail without faulting.
+    munmap(ptr, length);
+    mu_assert_int_equals(sky_prefetcher_read(ptr, length), -1);
+    return 0;
+}
+
+int test_sky_prefetcher_submit() {
+    size_t length = 16 * (size_t)sysconf(_SC_PAGESIZE);
+    void *ptr = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    mu_assert_bool(ptr != MAP_FAILED);
+    sky_prefetcher *prefetcher = sky_prefetcher_create(2);
+    mu_assert_bool(prefetcher != NULL);
+
+    // Requests are dropped while the prefetcher is stopped.
+    mu_assert_int_equals(sky_prefetcher_submit(prefetcher, ptr, length), 0);
+    mu_assert_int_equals(prefetcher->request_count, 0);
+    mu_assert_long_equals((long)prefetcher->dropped_count, 1L);
+
+    // Running I/O threads read every request.
+    uint32_t i;
+    mu_assert_int_equals(sky_prefetcher_start(prefetcher), 0);
+    for(i=0; i<100; i++) {
+        mu_assert_int_equals(sky_prefetcher_submit(prefetcher, ptr, length), 0);
+    }
+    for(i=0; i<1000; i++) {
+        pthread_mutex_lock(&prefetcher->mutex);
+        uint32_t count = prefetcher->request_count;
+        pthread_mutex_unlock(&prefetcher->mutex);
+        if(count == 0) break;
+        usleep(1000);
+    }
+    mu_assert_int_equals(prefetcher->request_count, 0);
+    mu_assert_long_equals((long)prefetcher->dropped_count, 1L);
+
+    mu_assert_int_equals(sky_prefetcher_stop(prefetcher), 0);
+    mu_assert_int_equals(prefetcher->started_count, 0);
+    sky_prefetcher_free(prefetcher);
+    munmap(ptr, length);
+    return 0;
+}
+
+int test_sky_prefetcher_submit_full() {
+    sky_prefetcher *prefetcher = sky_prefetcher_create(1);
+    mu_assert_bool(prefetcher != NULL);
+
+    // Fill the queue without any thread reading it.
+    uint32_t i;
+    prefetcher->running = true;
+    for(i=0; i<SKY_PREFETCHER_QUEUE_SIZE+5; i++) {
+        mu_assert_int_equals(sky_prefetcher_submit(prefetcher, (void*)4096, 4096), 0);
+    }
+    mu_assert_int_equals(prefetcher->request_count, SKY_PREFETCHER_QUEUE_SIZE);
+    mu_assert_long_equals((long)prefetcher->dropped_count, 5L);
+
+    mu_assert_int_equals(sky_prefetcher_stop(prefetcher), 0);
+    mu_assert_int_equals(prefetcher->request_count, 0);
+    sky_prefetcher_free(prefetcher);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_prefetcher_read);
+    mu_run_test(test_sky_prefetcher_submit);
+    mu_run_test(test_sky_prefetcher_submit_full);
+    return 0;
+}
+
+RUN_TESTS()
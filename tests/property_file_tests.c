@@ -78,6 +78,87 @@ int test_sky_property_file_save() {
 }
 
 
+int test_sky_property_file_save_appends() {
+    int rc;
+    uint32_t i;
+    cleantmp();
+    struct tagbstring path = bsStatic("tmp/properties");
+    sky_property_file *property_file = sky_property_file_create();
+    sky_property_file_set_path(property_file, &path);
+
+    // Save a snapshot and then append to it until it is rewritten.
+    char *names[] = {"p0", "p1", "p2", "p3"};
+    for(i=0; i<4; i++) {
+        sky_property *property = sky_property_create();
+        property->type = SKY_PROPERTY_TYPE_OBJECT;
+        property->data_type = bfromcstr("Int");
+        property->name = bfromcstr(names[i]);
+        rc = sky_property_file_add_property(property_file, property);
+        mu_assert_int_equals(rc, 0);
+        rc = sky_property_file_save(property_file);
+        mu_assert_int_equals(rc, 0);
+        mu_assert_int_equals(property_file->saved_count, i+1);
+    }
+    mu_assert_int_equals(property_file->snapshot_count, 3);
+
+    // Reload the snapshot and the appended properties.
+    rc = sky_property_file_load(property_file);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(property_file->property_count, 4);
+    mu_assert_int_equals(property_file->snapshot_count, 3);
+    for(i=0; i<4; i++) {
+        mu_assert_bstring(property_file->properties[i]->name, names[i]);
+        mu_assert_int_equals(property_file->properties[i]->id, i+1);
+    }
+
+    sky_property_file_free(property_file);
+    return 0;
+}
+
+int test_sky_property_file_save_fixed() {
+    int rc;
+    cleantmp();
+    struct tagbstring path = bsStatic("tmp/properties");
+    sky_property_file *property_file = sky_property_file_create();
+    sky_property_file_set_path(property_file, &path);
+
+    // Only Int, Float and Boolean properties can be fixed.
+    sky_property *property = sky_property_create();
+    property->data_type = bfromcstr("String");
+    property->name = bfromcstr("name");
+    property->fixed = true;
+    rc = sky_property_file_add_property(property_file, property);
+    mu_assert_int_equals(rc, -1);
+    sky_property_free(property);
+
+    property = sky_property_create();
+    property->data_type = bfromcstr("Float");
+    property->name = bfromcstr("price");
+    property->fixed = true;
+    rc = sky_property_file_add_property(property_file, property);
+    mu_assert_int_equals(rc, 0);
+    property = sky_property_create();
+    property->data_type = bfromcstr("Int");
+    property->name = bfromcstr("count");
+    rc = sky_property_file_add_property(property_file, property);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(property_file->fixed_count, 1);
+    rc = sky_property_file_save(property_file);
+    mu_assert_int_equals(rc, 0);
+
+    // The flag is kept when the file is loaded again.
+    rc = sky_property_file_load(property_file);
+    mu_assert_int_equals(rc, 0);
+    mu_assert_int_equals(property_file->property_count, 2);
+    mu_assert_int_equals(property_file->fixed_count, 1);
+    mu_assert_bool(property_file->properties[0]->fixed);
+    mu_assert_bool(!property_file->properties[1]->fixed);
+
+    sky_property_file_free(property_file);
+    return 0;
+}
+
+
 //--------------------------------------
 // Load
 //--------------------------------------
@@ -95,6 +176,19 @@ int test_sky_property_file_load() {
     // Assert properties.
     mu_assert_int_equals(property_file->property_count, 2);
 
+    // Assert lookups.
+    sky_property *property;
+    struct tagbstring name = bsStatic("this_is_a_really_long_property_name_woohoo");
+    struct tagbstring missing = bsStatic("bar");
+    sky_property_file_find_by_name(property_file, &name, &property);
+    mu_assert_bool(property != NULL && property->id == -1);
+    sky_property_file_find_by_name(property_file, &missing, &property);
+    mu_assert_bool(property == NULL);
+    sky_property_file_find_by_id(property_file, 1, &property);
+    mu_assert_bool(property != NULL && biseqcstr(property->name, "foo") == 1);
+    sky_property_file_find_by_id(property_file, 2, &property);
+    mu_assert_bool(property == NULL);
+
     sky_property_file_free(property_file);
     return 0;
 }
@@ -109,6 +203,8 @@ int test_sky_property_file_load() {
 int all_tests() {
     mu_run_test(test_sky_property_file_path);
     mu_run_test(test_sky_property_file_save);
+    mu_run_test(test_sky_property_file_save_appends);
+    mu_run_test(test_sky_property_file_save_fixed);
     mu_run_test(test_sky_property_file_load);
     return 0;
 }
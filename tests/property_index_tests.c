@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <table.h>
+#include <property_index.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// Asserts the objects that have a value of the property within a range.
+#define mu_assert_object_ids(INDEX, MIN, MAX, ...) do {\
+    sky_object_id_t _expected[] = {__VA_ARGS__}; \
+    uint32_t _i, _count = sizeof(_expected) / sizeof(*_expected); \
+    sky_object_id_t *_object_ids = NULL; \
+    uint32_t _object_id_count = 0; \
+    mu_assert_int_equals(sky_property_index_get_object_ids(INDEX, MIN, MAX, &_object_ids, &_object_id_count), 0); \
+    mu_assert_int_equals(_object_id_count, _count); \
+    for(_i=0; _i<_count; _i++) { \
+        mu_assert_int64_equals((long long)_object_ids[_i], (long long)_expected[_i]); \
+    } \
+    free(_object_ids); \
+} while(0)
+
+// Attaches typed data to an event.
+#define add_event_data(EVENT, DATA) do {\
+    (EVENT)->data = realloc((EVENT)->data, sizeof(*(EVENT)->data) * ((EVENT)->data_count+1)); \
+    (EVENT)->data[(EVENT)->data_count++] = DATA; \
+} while(0)
+
+// Asserts that no object has a value of the property within a range.
+#define mu_assert_no_object_ids(INDEX, MIN, MAX) do {\
+    sky_object_id_t *_object_ids = NULL; \
+    uint32_t _object_id_count = 1; \
+    mu_assert_int_equals(sky_property_index_get_object_ids(INDEX, MIN, MAX, &_object_ids, &_object_id_count), 0); \
+    mu_assert_int_equals(_object_id_count, 0); \
+    mu_assert_bool(_object_ids == NULL); \
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Maintenance
+//--------------------------------------
+
+int test_sky_property_index_add() {
+    sky_property_index *index = sky_property_index_create(1);
+    mu_assert_int_equals(sky_property_index_add(index, 20, 3), 0);
+    mu_assert_int_equals(sky_property_index_add(index, 10, 2), 0);
+    mu_assert_int_equals(sky_property_index_add(index, 20, 1), 0);
+    mu_assert_int_equals(sky_property_index_add(index, -5, 2), 0);
+    mu_assert_int_equals(sky_property_index_add(index, 20, 3), 0);
+    mu_assert_int_equals(sky_property_index_add(index, 10, 4), 0);
+    mu_assert_int_equals(index->value_count, 3);
+    mu_assert_int64_equals((long long)index->values[0].value, -5LL);
+    mu_assert_int64_equals((long long)index->values[2].value, 20LL);
+
+    // Single values return their own list.
+    mu_assert_object_ids(index, 20, 20, 1, 3);
+    mu_assert_object_ids(index, 10, 10, 2, 4);
+
+    // Ranges merge the lists of their values without duplicates.
+    mu_assert_object_ids(index, -10, 10, 2, 4);
+    mu_assert_object_ids(index, 0, 100, 1, 2, 3, 4);
+    mu_assert_no_object_ids(index, 11, 19);
+    mu_assert_no_object_ids(index, 21, 100);
+
+    sky_property_index_clear(index);
+    mu_assert_int_equals(index->value_count, 0);
+    mu_assert_no_object_ids(index, 0, 100);
+    sky_property_index_free(index);
+    return 0;
+}
+
+int test_sky_property_index_add_event() {
+    sky_property_index *index = sky_property_index_create(2);
+    sky_event *event = sky_event_create(5, 0, 1);
+    add_event_data(event, sky_event_data_create_float(2, 12.7));
+    mu_assert_int_equals(sky_property_index_add_event(index, event), 0);
+    sky_event_free(event);
+    mu_assert_object_ids(index, 12, 12, 5);
+
+    // Events without the property are ignored.
+    event = sky_event_create(6, 0, 1);
+    mu_assert_int_equals(sky_property_index_add_event(index, event), 0);
+    sky_event_free(event);
+    mu_assert_int_equals(index->value_count, 1);
+
+    sky_property_index_free(index);
+    return 0;
+}
+
+int test_sky_property_index_build() {
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // The index is built from the data file when it is first requested.
+    sky_property_index *index = NULL;
+    mu_assert_int_equals(sky_table_get_property_index(table, 1, &index), 0);
+    mu_assert_bool(index != NULL && index->built);
+    mu_assert_int_equals(table->property_index_count, 1);
+    mu_assert_object_ids(index, 10, 10, 1);
+    mu_assert_object_ids(index, 5, 10, 1, 2);
+    mu_assert_object_ids(index, 0, 100, 1, 2, 3);
+
+    // Booleans are indexed as integers.
+    sky_property_index *flag_index = NULL;
+    mu_assert_int_equals(sky_table_get_property_index(table, -1, &flag_index), 0);
+    mu_assert_object_ids(flag_index, 1, 1, 1);
+    mu_assert_object_ids(flag_index, 0, 0, 2);
+
+    // The same index is returned again and added events are indexed.
+    sky_property_index *same_index = NULL;
+    mu_assert_int_equals(sky_table_get_property_index(table, 1, &same_index), 0);
+    mu_assert_bool(same_index == index);
+    sky_event *event = sky_event_create(4, 10000000LL, 1);
+    add_event_data(event, sky_event_data_create_int(1, 10));
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    sky_event_free(event);
+    mu_assert_object_ids(index, 10, 10, 1, 4);
+
+    // Replacing the blocks drops the index until it is requested again.
+    sky_table_invalidate(table);
+    mu_assert_bool(!index->built);
+    mu_assert_int_equals(sky_table_get_property_index(table, 1, &index), 0);
+    mu_assert_object_ids(index, 10, 10, 1, 4);
+
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_property_index_add);
+    mu_run_test(test_sky_property_index_add_event);
+    mu_run_test(test_sky_property_index_build);
+    return 0;
+}
+
+RUN_TESTS()
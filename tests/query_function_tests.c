@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <query_function.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+int noop_event(void *state, sky_action_id_t action_id,
+               sky_timestamp_t timestamp, void *data_ptr,
+               uint32_t data_length)
+{
+    (void)state;
+    (void)action_id;
+    (void)timestamp;
+    (void)data_ptr;
+    (void)data_length;
+    return 0;
+}
+
+int noop_finish(void *state, sky_object_id_t object_id,
+                sky_query_result *result)
+{
+    (void)state;
+    (void)object_id;
+    (void)result;
+    return 0;
+}
+
+// Registered functions must outlive the registry so they are not kept on
+// the stack of a test.
+struct tagbstring path_length_str = bsStatic("pathLength");
+
+struct tagbstring noop_str = bsStatic("noop");
+
+sky_query_function noop = {&noop_str, 0, noop_event, noop_finish};
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Registry
+//--------------------------------------
+
+int test_sky_query_function_register() {
+    sky_query_function duplicate = {&path_length_str, 0, noop_event, noop_finish};
+    sky_query_function incomplete = {&noop_str, 0, noop_event, NULL};
+    sky_query_function *function = NULL;
+
+    // The built in function is always available.
+    mu_assert_int_equals(sky_query_function_find(&path_length_str, &function), 0);
+    mu_assert_bool(function != NULL);
+    mu_assert_bstring(function->name, "pathLength");
+
+    mu_assert_int_equals(sky_query_function_find(&noop_str, &function), 0);
+    mu_assert_bool(function == NULL);
+    mu_assert_int_equals(sky_query_function_register(&incomplete), -1);
+    mu_assert_int_equals(sky_query_function_register(&noop), 0);
+    mu_assert_int_equals(sky_query_function_find(&noop_str, &function), 0);
+    mu_assert_bool(function == &noop);
+
+    // Names are unique.
+    mu_assert_int_equals(sky_query_function_register(&duplicate), -1);
+    mu_assert_int_equals(sky_query_function_register(&noop), -1);
+    return 0;
+}
+
+
+//--------------------------------------
+// Loading
+//--------------------------------------
+
+int test_sky_query_function_load() {
+    struct tagbstring library_path = bsStatic("tests/fixtures/query_function/event_count.so");
+    struct tagbstring missing_path = bsStatic("tests/fixtures/query_function/missing.so");
+    struct tagbstring event_count_str = bsStatic("eventCount");
+    sky_query_function *function = NULL;
+
+    mu_assert_int_equals(sky_query_function_load(&missing_path), -1);
+    mu_assert_int_equals(sky_query_function_load(&library_path), 0);
+    mu_assert_int_equals(sky_query_function_find(&event_count_str, &function), 0);
+    mu_assert_bool(function != NULL);
+    mu_assert_long_equals((long)function->state_size, (long)sizeof(uint32_t));
+
+    // The functions of a library can only be registered once.
+    uint32_t count = sky_query_function_count;
+    mu_assert_int_equals(sky_query_function_load(&library_path), -1);
+    mu_assert_int_equals(sky_query_function_count, count);
+    return 0;
+}
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_query_function_register);
+    mu_run_test(test_sky_query_function_load);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,416 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <query_message.h>
+#include <importer.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// Collects the frames flushed from a streamed response.
+int collect_frame(sky_buffer *buffer, void *data)
+{
+    sky_buffer **frames = data;
+    uint32_t i = 0;
+    while(frames[i] != NULL) i++;
+    frames[i] = sky_buffer_create();
+    return sky_buffer_write(frames[i], buffer->data, buffer->length);
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_query_message_pack_unpack() {
+    struct tagbstring total_str = bsStatic("total");
+    sky_action_id_t action_ids[] = {1, 2};
+    cleantmp();
+    sky_query_message *message = sky_query_message_create();
+    struct tagbstring us_str = bsStatic("us");
+    sky_query_add_filter(message->query, SKY_QUERY_FIELD_TIMESTAMP, 0, -10, 20);
+    sky_query_message_add_string_filter(message, 2, &us_str);
+    sky_query_set_sequence(message->query, action_ids, 2);
+    sky_query_set_group_by(message->query, SKY_QUERY_FIELD_PROPERTY, -3);
+    sky_query_add_aggregate(message->query, SKY_QUERY_AGGREGATE_SUM, 4, &total_str);
+    message->profile = true;
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_query_message_pack(message, file), 0);
+    fclose(file);
+    sky_query_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_message_unpack(message, file), 0);
+    fclose(file);
+
+    sky_query *query = message->query;
+    mu_assert_int_equals(query->filter_count, 1);
+    mu_assert_int_equals(query->filters[0].field, SKY_QUERY_FIELD_TIMESTAMP);
+    mu_assert_long_equals(query->filters[0].min, -10L);
+    mu_assert_long_equals(query->filters[0].max, 20L);
+    mu_assert_int_equals(message->string_filter_count, 1);
+    mu_assert_int_equals(message->string_filters[0].property_id, 2);
+    mu_assert_bstring(message->string_filters[0].value, "us");
+    mu_assert_int_equals(query->sequence_length, 2);
+    mu_assert_int_equals(query->sequence[0], 1);
+    mu_assert_int_equals(query->sequence[1], 2);
+    mu_assert_bool(query->grouped);
+    mu_assert_int_equals(query->group_field, SKY_QUERY_FIELD_PROPERTY);
+    mu_assert_int_equals(query->group_property_id, -3);
+    mu_assert_int_equals(query->aggregate_count, 1);
+    mu_assert_int_equals(query->aggregates[0].type, SKY_QUERY_AGGREGATE_SUM);
+    mu_assert_int_equals(query->aggregates[0].property_id, 4);
+    mu_assert_bstring(query->aggregates[0].name, "total");
+    mu_assert_bool(message->profile);
+    sky_query_message_free(message);
+    return 0;
+}
+
+
+int test_sky_query_message_pack_unpack_interval() {
+    cleantmp();
+    sky_query_message *message = sky_query_message_create();
+    sky_query_set_group_by(message->query, SKY_QUERY_FIELD_TIMESTAMP, 0);
+    sky_query_set_group_interval(message->query, 3600);
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_query_message_pack(message, file), 0);
+    fclose(file);
+    sky_query_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_int_equals(message->query->group_field, SKY_QUERY_FIELD_TIMESTAMP);
+    mu_assert_long_equals((long)message->query->group_interval, 3600L);
+    sky_query_message_free(message);
+    return 0;
+}
+
+
+int test_sky_query_message_pack_unpack_cohort() {
+    cleantmp();
+    sky_query_message *message = sky_query_message_create();
+    sky_query_set_cohort(message->query, 1, 2, 604800000000LL, 12);
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_query_message_pack(message, file), 0);
+    fclose(file);
+    sky_query_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_bool(message->query->cohorted);
+    mu_assert_int_equals(message->query->cohort.action_id, 1);
+    mu_assert_int_equals(message->query->cohort.return_action_id, 2);
+    mu_assert_int64_equals((long long)message->query->cohort.interval, 604800000000LL);
+    mu_assert_int_equals(message->query->cohort.period_count, 12);
+    sky_query_message_free(message);
+    return 0;
+}
+
+
+int test_sky_query_message_pack_unpack_function() {
+    struct tagbstring path_length_str = bsStatic("pathLength");
+    struct tagbstring function_str = bsStatic("function");
+    struct tagbstring unknown_str = bsStatic("unknown");
+    sky_query_function *function = NULL;
+    size_t sz;
+    cleantmp();
+    sky_query_message *message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_function_find(&path_length_str, &function), 0);
+    mu_assert_int_equals(sky_query_set_function(message->query, function), 0);
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_query_message_pack(message, file), 0);
+    fclose(file);
+    sky_query_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_bool(message->query->function == function);
+    sky_query_message_free(message);
+
+    // Unknown functions are rejected.
+    file = fopen("tmp/message", "w");
+    minipack_fwrite_map(file, 1, &sz);
+    sky_minipack_fwrite_bstring(file, &function_str);
+    sky_minipack_fwrite_bstring(file, &unknown_str);
+    fclose(file);
+    file = fopen("tmp/message", "r");
+    message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_message_unpack(message, file), -1);
+    fclose(file);
+    sky_query_message_free(message);
+    return 0;
+}
+
+
+int test_sky_query_message_pack_unpack_stream() {
+    cleantmp();
+    sky_query_message *message = sky_query_message_create();
+    message->stream = true;
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_query_message_pack(message, file), 0);
+    fclose(file);
+    sky_query_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_bool(message->stream);
+    mu_assert_int_equals(message->frame_key_count, SKY_QUERY_MESSAGE_DEFAULT_FRAME_KEY_COUNT);
+    sky_query_message_free(message);
+    return 0;
+}
+
+int test_sky_query_message_pack_unpack_timeout() {
+    cleantmp();
+    sky_query_message *message = sky_query_message_create();
+    message->query_id = 12;
+    message->timeout = 500;
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_query_message_pack(message, file), 0);
+    fclose(file);
+    sky_query_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_int64_equals((long long)message->query_id, 12LL);
+    mu_assert_int64_equals((long long)message->timeout, 500LL);
+    sky_query_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+// Executes a query message against a table and reads the result through the
+// data key.
+#define PROCESS_MESSAGE(MESSAGE, TABLE) do { \
+    sky_buffer *_output = sky_buffer_create(); \
+    mu_assert_int_equals(sky_query_message_process(MESSAGE, TABLE, _output), 0); \
+    mu_dump_buffer(_output, "tmp/output"); \
+    sky_buffer_free(_output); \
+    file = fopen("tmp/output", "r"); \
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 2); \
+    sky_minipack_fread_bstring(file, &str); bdestroy(str); \
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "ok"); bdestroy(str); \
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "data"); bdestroy(str); \
+} while(0)
+
+int test_sky_query_message_process_string_values() {
+    size_t sz;
+    FILE *file;
+    bstring str = NULL;
+    struct tagbstring us = bsStatic("us");
+    struct tagbstring uk = bsStatic("uk");
+    importtmp("tests/fixtures/query/1/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // String filters match the dictionary code of the value.
+    sky_query_message *message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_message_add_string_filter(message, 1, &us), 0);
+    PROCESS_MESSAGE(message, table);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 1);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "count"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_uint(file, &sz), 3);
+    fclose(file);
+    sky_query_message_free(message);
+
+    // Values that were never added do not match.
+    message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_message_add_string_filter(message, 1, &uk), 0);
+    PROCESS_MESSAGE(message, table);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 1);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "count"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_uint(file, &sz), 0);
+    fclose(file);
+    sky_query_message_free(message);
+
+    // Group keys are decoded into their values.
+    message = sky_query_message_create();
+    sky_query_set_group_by(message->query, SKY_QUERY_FIELD_PROPERTY, 1);
+    PROCESS_MESSAGE(message, table);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 2);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "us"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 1);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_uint(file, &sz), 3);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "fr"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 1);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_uint(file, &sz), 1);
+    fclose(file);
+    sky_query_message_free(message);
+
+    // The filter builds an index of the property that is kept up to date.
+    mu_assert_int_equals(table->property_index_count, 1);
+    mu_assert_bool(table->property_indexes[0]->property_id == 1 && table->property_indexes[0]->built);
+    sky_event *event = sky_event_create(100, 10000000LL, 1);
+    mu_assert_int_equals(sky_event_set_data(event, 1, &us), 0);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    sky_event_free(event);
+    message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_message_add_string_filter(message, 1, &us), 0);
+    PROCESS_MESSAGE(message, table);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 1);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "count"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_uint(file, &sz), 4);
+    fclose(file);
+    sky_query_message_free(message);
+
+    sky_table_free(table);
+    return 0;
+}
+
+
+int test_sky_query_message_process_cohort() {
+    size_t sz;
+    FILE *file;
+    bstring str = NULL;
+    importtmp("tests/fixtures/query/1/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // {1000000:{0:{count:2}, 1:{count:1}}}
+    sky_query_message *message = sky_query_message_create();
+    mu_assert_int_equals(sky_query_set_cohort(message->query, 1, 2, 1000000LL, 2), 0);
+    PROCESS_MESSAGE(message, table);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 1);
+    mu_assert_int64_equals((long long)minipack_fread_uint(file, &sz), 1000000LL);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 2);
+    mu_assert_int64_equals((long long)minipack_fread_uint(file, &sz), 0LL);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 1);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "count"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_uint(file, &sz), 2);
+    mu_assert_int64_equals((long long)minipack_fread_uint(file, &sz), 1LL);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 1);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "count"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_uint(file, &sz), 1);
+    fclose(file);
+    sky_query_message_free(message);
+
+    sky_table_free(table);
+    return 0;
+}
+
+
+int test_sky_query_message_process_stream() {
+    uint32_t i;
+    struct tagbstring count_str = bsStatic("count");
+    importtmp("tests/fixtures/query/1/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // Each action is sent in its own frame before the final status.
+    sky_query_message *message = sky_query_message_create();
+    sky_query_set_group_by(message->query, SKY_QUERY_FIELD_ACTION, 0);
+    sky_query_add_aggregate(message->query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    message->stream = true;
+    message->frame_key_count = 1;
+    sky_buffer *frames[4] = {NULL, NULL, NULL, NULL};
+    sky_buffer *output = sky_buffer_create();
+    output->flush = collect_frame;
+    output->flush_data = frames;
+    mu_assert_int_equals(sky_query_message_process(message, table, output), 0);
+
+    //   {data:{1:{count:2}}} {data:{2:{count:2}}} {status:"ok"}
+    char expected0[] = "\x81" "\xA4" "data" "\x81" "\x01" "\x81" "\xA5" "count" "\x02";
+    char expected1[] = "\x81" "\xA4" "data" "\x81" "\x02" "\x81" "\xA5" "count" "\x02";
+    char expected2[] = "\x81" "\xA6" "status" "\xA2" "ok";
+    mu_assert_bool(frames[0] != NULL && frames[1] != NULL && frames[2] == NULL);
+    mu_assert_long_equals((long)frames[0]->length, (long)(sizeof(expected0) - 1));
+    mu_assert_mem(frames[0]->data, expected0, sizeof(expected0) - 1);
+    mu_assert_long_equals((long)frames[1]->length, (long)(sizeof(expected1) - 1));
+    mu_assert_mem(frames[1]->data, expected1, sizeof(expected1) - 1);
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected2) - 1));
+    mu_assert_mem(output->data, expected2, sizeof(expected2) - 1);
+
+    for(i=0; i<4; i++) sky_buffer_free(frames[i]);
+    sky_buffer_free(output);
+    sky_query_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_query_message_process_cancelled() {
+    volatile bool cancelled = true;
+    importtmp("tests/fixtures/query/1/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // A cancelled query only returns its status and is not an error.
+    sky_query_message *message = sky_query_message_create();
+    sky_query_set_group_by(message->query, SKY_QUERY_FIELD_ACTION, 0);
+    message->cancelled = &cancelled;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_query_message_process(message, table, output), 0);
+    mu_assert_bool(message->stopped);
+
+    //   {status:"cancelled"}
+    char expected[] = "\x81" "\xA6" "status" "\xA9" "cancelled";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected) - 1));
+    mu_assert_mem(output->data, expected, sizeof(expected) - 1);
+
+    sky_buffer_free(output);
+    sky_query_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_query_message_pack_unpack);
+    mu_run_test(test_sky_query_message_pack_unpack_interval);
+    mu_run_test(test_sky_query_message_pack_unpack_cohort);
+    mu_run_test(test_sky_query_message_pack_unpack_function);
+    mu_run_test(test_sky_query_message_pack_unpack_stream);
+    mu_run_test(test_sky_query_message_pack_unpack_timeout);
+    mu_run_test(test_sky_query_message_process_string_values);
+    mu_run_test(test_sky_query_message_process_cohort);
+    mu_run_test(test_sky_query_message_process_stream);
+    mu_run_test(test_sky_query_message_process_cancelled);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,584 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <table.h>
+#include <query.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+#define INIT_TABLE() \
+    importtmp("tests/fixtures/query/0/import.json"); \
+    sky_table *table = sky_table_create(); \
+    table->path = bfromcstr("tmp"); \
+    mu_assert_int_equals(sky_table_open(table), 0); \
+    sky_query *query = sky_query_create(); \
+    sky_query_result *result = NULL;
+
+#define EXECUTE_QUERY() \
+    result = sky_query_result_create(query); \
+    mu_assert_int_equals(sky_query_execute(query, table->data_file, result), 0);
+
+#define FREE_TABLE() \
+    sky_query_result_free(result); \
+    sky_query_free(query); \
+    sky_table_free(table);
+
+// Asserts the key and the value of an aggregate for a group of the result.
+#define mu_assert_group(INDEX, KEY, VALUE_INDEX, VALUE) \
+    mu_assert_int64_equals((long long)result->keys[INDEX], (long long)(KEY)); \
+    mu_assert_int64_equals((long long)result->values[(INDEX) * result->value_count + (VALUE_INDEX)], (long long)(VALUE));
+
+// Keeps the highest price of an object's events.
+int max_price_event(void *state, sky_action_id_t action_id,
+                    sky_timestamp_t timestamp, void *data_ptr,
+                    uint32_t data_length)
+{
+    (void)action_id;
+    (void)timestamp;
+    int64_t value = 0;
+    if(sky_query_get_property(1, data_ptr, data_length, &value) && value > *((int64_t*)state)) {
+        *((int64_t*)state) = value;
+    }
+    return 0;
+}
+
+// Counts the object by its highest price.
+int max_price_finish(void *state, sky_object_id_t object_id,
+                     sky_query_result *result)
+{
+    (void)object_id;
+    int64_t *values = NULL;
+    check(sky_query_result_get_values(result, *((int64_t*)state), &values) == 0, "Unable to retrieve group values");
+    values[0]++;
+    return 0;
+
+error:
+    return -1;
+}
+
+struct tagbstring MAX_PRICE_NAME = bsStatic("maxPrice");
+
+sky_query_function MAX_PRICE = {&MAX_PRICE_NAME, sizeof(int64_t), max_price_event, max_price_finish};
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Execution
+//--------------------------------------
+
+int test_sky_query_execute_group_by_action() {
+    struct tagbstring count_str = bsStatic("count");
+    struct tagbstring total_str = bsStatic("total");
+    INIT_TABLE();
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_SUM, 1, &total_str);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1, 0, 3);
+    mu_assert_group(0, 1, 1, 22);
+    mu_assert_group(1, 2, 0, 3);
+    mu_assert_group(1, 2, 1, 23);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_with_arena() {
+    INIT_TABLE();
+    sky_arena *arena = sky_arena_create(0);
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    result = sky_query_result_create_with_arena(query, arena);
+    mu_assert_int_equals(sky_query_execute(query, table->data_file, result), 0);
+    mu_assert_bool(result->arena == arena);
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1, 0, 3);
+    mu_assert_group(1, 2, 0, 3);
+    FREE_TABLE();
+    sky_arena_free(arena);
+    return 0;
+}
+
+int test_sky_query_execute_filter() {
+    INIT_TABLE();
+    sky_query_add_filter(query, SKY_QUERY_FIELD_PROPERTY, 1, 5, 10);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 1);
+    mu_assert_group(0, 0, 0, 3);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_timestamp_and_property_filter() {
+    INIT_TABLE();
+    sky_query_add_filter(query, SKY_QUERY_FIELD_TIMESTAMP, 0, 2000000, 3000000);
+    sky_query_add_filter(query, SKY_QUERY_FIELD_PROPERTY, 1, 0, 100);
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1, 0, 1);
+    mu_assert_group(1, 2, 0, 1);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_group_by_boolean_property() {
+    INIT_TABLE();
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_PROPERTY, -1);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 0, 0, 1);
+    mu_assert_group(1, 1, 0, 1);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_subgroup_by() {
+    INIT_TABLE();
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    mu_assert_int_equals(sky_query_set_subgroup_by(query, SKY_QUERY_FIELD_PROPERTY, -1), 0);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1, 0, 1);
+    mu_assert_int64_equals((long long)result->subkeys[0], 0LL);
+    mu_assert_group(1, 1, 0, 1);
+    mu_assert_int64_equals((long long)result->subkeys[1], 1LL);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_group_interval() {
+    INIT_TABLE();
+    sky_query_add_filter(query, SKY_QUERY_FIELD_ACTION, 0, 1, 1);
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_TIMESTAMP, 0);
+    mu_assert_int_equals(sky_query_set_group_interval(query, 1000000LL), 0);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1000000, 0, 2);
+    mu_assert_group(1, 3000000, 0, 1);
+
+    // Empty buckets are filled in when the result is packed.
+    //   {start:1000000, interval:1000000, buckets:[{count:2}, {count:0}, {count:1}]}
+    char expected[] = "\x83"
+        "\xA5" "start" "\xCE\x00\x0F\x42\x40"
+        "\xA8" "interval" "\xCE\x00\x0F\x42\x40"
+        "\xA7" "buckets" "\x93"
+            "\x81" "\xA5" "count" "\x02"
+            "\x81" "\xA5" "count" "\x00"
+            "\x81" "\xA5" "count" "\x01";
+    sky_buffer *buffer = sky_buffer_create();
+    mu_assert_int_equals(sky_query_result_pack(result, query, NULL, buffer), 0);
+    mu_assert_long_equals((long)buffer->length, (long)(sizeof(expected) - 1));
+    mu_assert_mem(buffer->data, expected, sizeof(expected) - 1);
+    sky_buffer_free(buffer);
+
+    // Only timestamp groups can be bucketed.
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    mu_assert_int_equals(sky_query_set_group_interval(query, 1000000LL), -1);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_sequence() {
+    sky_action_id_t action_ids[] = {1};
+    INIT_TABLE();
+    sky_query_set_sequence(query, action_ids, 1);
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_PROPERTY, 1);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 1);
+    mu_assert_group(0, 20, 0, 1);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_funnel() {
+    sky_query_funnel_step steps[] = {{1, 0}, {2, 0}};
+    INIT_TABLE();
+    mu_assert_int_equals(sky_query_set_funnel(query, steps, 2), 0);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 0, 0, 2);
+    mu_assert_group(1, 1, 0, 2);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_cohort() {
+    INIT_TABLE();
+    mu_assert_int_equals(sky_query_set_cohort(query, 1, 2, 2000000LL, 3), 0);
+
+    // A later return by object 1 lands two periods after its cohort.
+    sky_event *event = sky_event_create(1, 5000000LL, 2);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    mu_assert_int_equals(sky_table_merge(table), 0);
+    sky_event_free(event);
+
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 3);
+    mu_assert_group(0, 0, 0, 2);
+    mu_assert_int64_equals((long long)result->subkeys[0], 0LL);
+    mu_assert_group(1, 0, 0, 2);
+    mu_assert_int64_equals((long long)result->subkeys[1], 1LL);
+    mu_assert_group(2, 0, 0, 1);
+    mu_assert_int64_equals((long long)result->subkeys[2], 2LL);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_transitions() {
+    INIT_TABLE();
+    mu_assert_int_equals(sky_query_set_transitions(query, 2), 0);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1, 0, 2);
+    mu_assert_int64_equals((long long)result->subkeys[0], 2LL);
+    mu_assert_group(1, 2, 0, 1);
+    mu_assert_int64_equals((long long)result->subkeys[1], 1LL);
+    sky_query_result_free(result);
+
+    // Actions outside of the dense matrix are grouped directly.
+    mu_assert_int_equals(sky_query_set_transitions(query, 1), 0);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1, 0, 2);
+    mu_assert_int64_equals((long long)result->subkeys[0], 2LL);
+    mu_assert_group(1, 2, 0, 1);
+    mu_assert_int64_equals((long long)result->subkeys[1], 1LL);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_function() {
+    struct tagbstring path_length_str = bsStatic("pathLength");
+    sky_query_function *function = NULL;
+    INIT_TABLE();
+    mu_assert_int_equals(sky_query_function_find(&path_length_str, &function), 0);
+    mu_assert_int_equals(sky_query_set_function(query, function), 0);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 3);
+    mu_assert_group(0, 1, 0, 1);
+    mu_assert_group(1, 2, 0, 1);
+    mu_assert_group(2, 3, 0, 1);
+    sky_query_result_free(result);
+
+    // Objects without an event that passes the filters are not finished.
+    mu_assert_int_equals(sky_query_function_register(&MAX_PRICE), 0);
+    mu_assert_int_equals(sky_query_set_function(query, &MAX_PRICE), 0);
+    mu_assert_int_equals(sky_query_add_filter(query, SKY_QUERY_FIELD_ACTION, 0, 1, 1), 0);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 7, 0, 1);
+    mu_assert_group(1, 10, 0, 1);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_object_ids() {
+    struct tagbstring count_str = bsStatic("count");
+    struct tagbstring total_str = bsStatic("total");
+    sky_object_id_t object_ids[] = {2, 3};
+    INIT_TABLE();
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    mu_assert_int_equals(sky_query_set_object_ids(query, object_ids, 2), 0);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1, 0, 1);
+    mu_assert_group(1, 2, 0, 2);
+    sky_query_result_free(result);
+
+    // Reading properties scans the rows of the same objects.
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_SUM, 1, &total_str);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1, 0, 1);
+    mu_assert_group(0, 1, 1, 7);
+    mu_assert_group(1, 2, 0, 2);
+    mu_assert_group(1, 2, 1, 3);
+    sky_query_result_free(result);
+
+    // A query restricted to no objects matches nothing.
+    mu_assert_int_equals(sky_query_set_object_ids(query, NULL, 0), 0);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 0);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_distinct() {
+    struct tagbstring count_str = bsStatic("count");
+    struct tagbstring users_str = bsStatic("users");
+    INIT_TABLE();
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_DISTINCT, 0, &users_str);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1, 0, 3);
+    mu_assert_group(1, 2, 0, 3);
+    mu_assert_bool(result->distinct != NULL && result->distinct[1]);
+    mu_assert_int64_equals((long long)sky_hll_count(result->sketches[result->values[1] - 1]), 2LL);
+    mu_assert_int64_equals((long long)sky_hll_count(result->sketches[result->values[3] - 1]), 3LL);
+
+    // Merging a result into itself keeps the distinct counts.
+    sky_query_result *copy = sky_query_result_create(query);
+    mu_assert_int_equals(sky_query_result_merge(copy, result), 0);
+    mu_assert_int_equals(sky_query_result_merge(copy, result), 0);
+    mu_assert_int64_equals((long long)copy->values[0], 6LL);
+    mu_assert_int64_equals((long long)sky_hll_count(copy->sketches[copy->values[1] - 1]), 2LL);
+    mu_assert_int64_equals((long long)sky_hll_count(copy->sketches[copy->values[3] - 1]), 3LL);
+    sky_query_result_free(copy);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_profile() {
+    sky_query_profile profile;
+    memset(&profile, 0, sizeof(profile));
+    INIT_TABLE();
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    result = sky_query_result_create(query);
+    result->profile = &profile;
+    mu_assert_int_equals(sky_query_execute(query, table->data_file, result), 0);
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_bool(profile.blocks_visited > 0);
+    mu_assert_int64_equals((long long)profile.blocks_skipped, 0LL);
+    mu_assert_bool(profile.path_count > 0);
+    mu_assert_int64_equals((long long)profile.event_count, (long long)result->event_count);
+    mu_assert_bool(profile.byte_count > 0);
+    mu_assert_bool(profile.scan_time >= 0);
+
+    // A filter that no block can match skips every block.
+    sky_query_result_free(result);
+    memset(&profile, 0, sizeof(profile));
+    sky_query_add_filter(query, SKY_QUERY_FIELD_TIMESTAMP, 0, INT64_MAX - 1, INT64_MAX);
+    result = sky_query_result_create(query);
+    result->profile = &profile;
+    mu_assert_int_equals(sky_query_execute(query, table->data_file, result), 0);
+    mu_assert_int64_equals((long long)profile.blocks_visited, 0LL);
+    mu_assert_bool(profile.blocks_skipped > 0);
+    mu_assert_int64_equals((long long)profile.event_count, 0LL);
+
+    // Profiles can be packed.
+    sky_buffer *buffer = sky_buffer_create();
+    mu_assert_int_equals(sky_query_profile_pack(&profile, buffer), 0);
+    mu_assert_bool(buffer->length > 0);
+    sky_buffer_free(buffer);
+    FREE_TABLE();
+    return 0;
+}
+
+
+int test_sky_query_execute_path_summaries() {
+    sky_query_profile profile;
+    memset(&profile, 0, sizeof(profile));
+    sky_query_funnel_step steps[] = {{1, 0}, {2, 0}};
+    INIT_TABLE();
+    mu_assert_int_equals(sky_query_set_funnel(query, steps, 2), 0);
+    result = sky_query_result_create(query);
+    result->profile = &profile;
+
+    // Object 3 never performs the first step so its path is not read.
+    mu_assert_int_equals(sky_query_execute(query, table->data_file, result), 0);
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 0, 0, 2);
+    mu_assert_group(1, 1, 0, 2);
+    mu_assert_int64_equals((long long)profile.paths_skipped, 1LL);
+    mu_assert_int64_equals((long long)profile.path_count, 2LL);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_zone_maps() {
+    struct tagbstring count_str = bsStatic("count");
+    sky_query_profile profile;
+    memset(&profile, 0, sizeof(profile));
+    INIT_TABLE();
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    sky_query_add_filter(query, SKY_QUERY_FIELD_PROPERTY, 1, 100, 200);
+    result = sky_query_result_create(query);
+    result->profile = &profile;
+
+    // No block has a price in the range so every block is skipped.
+    mu_assert_int_equals(sky_query_execute(query, table->data_file, result), 0);
+    mu_assert_int_equals(result->group_count, 0);
+    mu_assert_int64_equals((long long)profile.blocks_visited, 0LL);
+    mu_assert_bool(profile.blocks_skipped > 0);
+    mu_assert_bool(table->data_file->blocks[0]->zones_valid);
+    sky_query_result_free(result);
+
+    // Added events widen the zones of their block.
+    sky_event *event = sky_event_create(2, 10000000LL, 1);
+    event->data = calloc(1, sizeof(*event->data));
+    event->data[event->data_count++] = sky_event_data_create_int(1, 150);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    sky_event_free(event);
+    memset(&profile, 0, sizeof(profile));
+    result = sky_query_result_create(query);
+    result->profile = &profile;
+    mu_assert_int_equals(sky_query_execute(query, table->data_file, result), 0);
+    mu_assert_int_equals(result->group_count, 1);
+    mu_assert_int64_equals((long long)result->values[0], 1LL);
+    mu_assert_int64_equals((long long)profile.blocks_visited, 1LL);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_cancelled() {
+    volatile bool cancelled = true;
+    INIT_TABLE();
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    sky_query_set_cancel_flag(query, &cancelled);
+    result = sky_query_result_create(query);
+    mu_assert_int_equals(sky_query_execute(query, table->data_file, result), -1);
+    mu_assert_bool(result->cancelled);
+    mu_assert_bool(!result->timed_out);
+    mu_assert_bool(sky_query_result_is_stopped(result));
+
+    // The response only holds the status.
+    sky_buffer *buffer = sky_buffer_create();
+    mu_assert_int_equals(sky_query_result_pack_stopped(result, buffer), 0);
+    mu_assert_mem(buffer->data, "\x81" "\xA6" "status" "\xA9" "cancelled", buffer->length);
+    sky_buffer_free(buffer);
+    sky_query_result_free(result);
+
+    // Queries that are not cancelled run to the end.
+    cancelled = false;
+    EXECUTE_QUERY();
+    mu_assert_bool(!sky_query_result_is_stopped(result));
+    mu_assert_int_equals(result->group_count, 2);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_timeout() {
+    INIT_TABLE();
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    query->deadline = 1;
+    result = sky_query_result_create(query);
+    mu_assert_int_equals(sky_query_execute(query, table->data_file, result), -1);
+    mu_assert_bool(result->timed_out);
+    mu_assert_bool(!result->cancelled);
+    sky_query_result_free(result);
+
+    // A timeout of zero clears the deadline.
+    sky_query_set_timeout(query, 0);
+    mu_assert_int64_equals((long long)query->deadline, 0LL);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    FREE_TABLE();
+    return 0;
+}
+
+int test_sky_query_execute_skewed_tasks() {
+    uint32_t i;
+    struct tagbstring count_str = bsStatic("count");
+    cleantmp();
+    sky_data_file *data_file = sky_data_file_create();
+    data_file->block_size = 128;
+    data_file->path = bfromcstr("tmp/data");
+    data_file->header_path = bfromcstr("tmp/header");
+    mu_assert_int_equals(sky_data_file_load(data_file), 0);
+
+    // One long path spans many blocks between runs of short paths.
+    for(i=0; i<200; i++) {
+        sky_event *event = sky_event_create(i+1, 1000000LL, 2);
+        mu_assert_int_equals(sky_data_file_add_event(data_file, event), 0);
+        sky_event_free(event);
+    }
+    for(i=0; i<2000; i++) {
+        sky_event *event = sky_event_create(500, 1000000LL + i, 1);
+        mu_assert_int_equals(sky_data_file_add_event(data_file, event), 0);
+        sky_event_free(event);
+    }
+    for(i=0; i<200; i++) {
+        sky_event *event = sky_event_create(i+1000, 1000000LL, 2);
+        mu_assert_int_equals(sky_data_file_add_event(data_file, event), 0);
+        sky_event_free(event);
+    }
+    mu_assert_bool(data_file->block_count > 16);
+
+    // The long path is counted once no matter how the blocks are split.
+    sky_query *query = sky_query_create();
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    sky_query_result *result = sky_query_result_create(query);
+    mu_assert_int_equals(sky_query_execute(query, data_file, result), 0);
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1, 0, 2000);
+    mu_assert_group(1, 2, 0, 400);
+    sky_query_result_free(result);
+
+    sky_query_free(query);
+    sky_data_file_free(data_file);
+    return 0;
+}
+
+int test_sky_query_execute_prefetched() {
+    struct tagbstring count_str = bsStatic("count");
+    INIT_TABLE();
+    sky_prefetcher *prefetcher = sky_prefetcher_create(2);
+    mu_assert_int_equals(sky_prefetcher_start(prefetcher), 0);
+    mu_assert_int_equals(sky_table_set_prefetcher(table, prefetcher), 0);
+    mu_assert_bool(table->data_file->prefetcher == prefetcher);
+
+    // Blocks read ahead give the same result.
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    EXECUTE_QUERY();
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_group(0, 1, 0, 3);
+    mu_assert_group(1, 2, 0, 3);
+    FREE_TABLE();
+
+    mu_assert_int_equals(sky_prefetcher_stop(prefetcher), 0);
+    sky_prefetcher_free(prefetcher);
+    return 0;
+}
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_query_execute_group_by_action);
+    mu_run_test(test_sky_query_execute_with_arena);
+    mu_run_test(test_sky_query_execute_filter);
+    mu_run_test(test_sky_query_execute_timestamp_and_property_filter);
+    mu_run_test(test_sky_query_execute_group_by_boolean_property);
+    mu_run_test(test_sky_query_execute_subgroup_by);
+    mu_run_test(test_sky_query_execute_group_interval);
+    mu_run_test(test_sky_query_execute_sequence);
+    mu_run_test(test_sky_query_execute_funnel);
+    mu_run_test(test_sky_query_execute_cohort);
+    mu_run_test(test_sky_query_execute_transitions);
+    mu_run_test(test_sky_query_execute_function);
+    mu_run_test(test_sky_query_execute_object_ids);
+    mu_run_test(test_sky_query_execute_distinct);
+    mu_run_test(test_sky_query_execute_profile);
+    mu_run_test(test_sky_query_execute_path_summaries);
+    mu_run_test(test_sky_query_execute_zone_maps);
+    mu_run_test(test_sky_query_execute_cancelled);
+    mu_run_test(test_sky_query_execute_timeout);
+    mu_run_test(test_sky_query_execute_skewed_tasks);
+    mu_run_test(test_sky_query_execute_prefetched);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include <replica.h>
+#include <replicate_message.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+struct tagbstring REPLICA_PATH = bsStatic("/tmp/skyreplica");
+
+// Opens an empty table to copy the primary into.
+#define open_replica(REPLICA) do {\
+    sky_file_rm_r(&REPLICA_PATH);\
+    mu_assert_int_equals(mkdir(bdata(&REPLICA_PATH), S_IRWXU), 0);\
+    REPLICA = sky_table_create();\
+    REPLICA->path = bstrcpy(&REPLICA_PATH);\
+    mu_assert_int_equals(sky_table_open(REPLICA), 0);\
+} while(0)
+
+// Requests the changes of the primary since the replica's last sync and
+// applies them to the replica.
+#define sync_replica(PRIMARY, REPLICA, STALE) do {\
+    sky_replicate_message *_message = sky_replicate_message_create();\
+    mu_assert_int_equals(sky_action_file_ensure_loaded((REPLICA)->action_file), 0);\
+    mu_assert_int_equals(sky_property_file_ensure_loaded((REPLICA)->property_file), 0);\
+    _message->epoch = (REPLICA)->replica_epoch;\
+    _message->version = (REPLICA)->replica_version;\
+    _message->action_count = (REPLICA)->action_file->action_count;\
+    _message->property_count = (REPLICA)->property_file->property_count;\
+    _message->dictionary_length = (REPLICA)->dictionary_file->length;\
+    sky_buffer *_output = sky_buffer_create();\
+    mu_assert_int_equals(sky_replicate_message_process(_message, PRIMARY, _output), 0);\
+    FILE *_input = fmemopen(_output->data, _output->length, "r");\
+    mu_assert_int_equals(sky_replica_apply(REPLICA, _input, &STALE), 0);\
+    fclose(_input);\
+    sky_buffer_free(_output);\
+    sky_replicate_message_free(_message);\
+} while(0)
+
+// Asserts that the replica has the same blocks as the primary.
+#define mu_assert_replica_blocks(PRIMARY, REPLICA) do {\
+    mu_assert_int_equals((REPLICA)->data_file->block_count, (PRIMARY)->data_file->block_count);\
+    uint32_t _i;\
+    for(_i=0; _i<(PRIMARY)->data_file->block_count; _i++) {\
+        sky_block *_expected = (PRIMARY)->data_file->blocks[_i];\
+        sky_block *_actual = (REPLICA)->data_file->blocks[_i];\
+        mu_assert_int_equals(_actual->index, _expected->index);\
+        mu_assert_bool(_actual->min_object_id == _expected->min_object_id);\
+        mu_assert_bool(_actual->max_object_id == _expected->max_object_id);\
+        mu_assert_bool(_actual->min_timestamp == _expected->min_timestamp);\
+        mu_assert_bool(_actual->max_timestamp == _expected->max_timestamp);\
+        mu_assert_bool(_actual->spanned == _expected->spanned);\
+        void *_expected_ptr = NULL, *_actual_ptr = NULL;\
+        mu_assert_int_equals(sky_block_get_ptr(_expected, &_expected_ptr), 0);\
+        mu_assert_int_equals(sky_block_get_ptr(_actual, &_actual_ptr), 0);\
+        mu_assert_mem(_actual_ptr, _expected_ptr, (PRIMARY)->data_file->block_size);\
+    }\
+} while(0)
+
+// Asserts that an object has a given number of paths in a table.
+#define mu_assert_path_count(TABLE, OBJECT_ID, PATH_COUNT) do {\
+    void **_paths = NULL;\
+    uint32_t _path_count = 0;\
+    mu_assert_int_equals(sky_data_file_find_path((TABLE)->data_file, OBJECT_ID, &_paths, &_path_count), 0);\
+    mu_assert_int_equals(_path_count, PATH_COUNT);\
+    free(_paths);\
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Messages
+//--------------------------------------
+
+int test_sky_replica_accepts_message() {
+    mu_assert_bool(sky_replica_accepts_message(SKY_MESSAGE_TYPE_QUERY));
+    mu_assert_bool(sky_replica_accepts_message(SKY_MESSAGE_TYPE_EGET));
+    mu_assert_bool(sky_replica_accepts_message(SKY_MESSAGE_TYPE_STATS));
+    mu_assert_bool(!sky_replica_accepts_message(SKY_MESSAGE_TYPE_EADD));
+    mu_assert_bool(!sky_replica_accepts_message(SKY_MESSAGE_TYPE_AADD));
+    mu_assert_bool(!sky_replica_accepts_message(SKY_MESSAGE_TYPE_COMPACT));
+    mu_assert_bool(!sky_replica_accepts_message(SKY_MESSAGE_TYPE_REPLICATE));
+    return 0;
+}
+
+
+//--------------------------------------
+// Apply
+//--------------------------------------
+
+int test_sky_replica_apply() {
+    bool stale = false;
+    sky_table *replica = NULL;
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    open_replica(replica);
+
+    // The first sync copies the whole table.
+    sync_replica(table, replica, stale);
+    mu_assert_bool(!stale);
+    mu_assert_bool(replica->replica_epoch == sky_replicate_message_get_epoch());
+    mu_assert_bool(replica->replica_version > 0);
+    mu_assert_replica_blocks(table, replica);
+    mu_assert_int_equals(sky_action_file_ensure_loaded(replica->action_file), 0);
+    mu_assert_int_equals(sky_property_file_ensure_loaded(replica->property_file), 0);
+    mu_assert_int_equals(replica->action_file->action_count, table->action_file->action_count);
+    mu_assert_int_equals(replica->property_file->property_count, table->property_file->property_count);
+    mu_assert_long_equals((long)replica->dictionary_file->length, (long)table->dictionary_file->length);
+    mu_assert_path_count(replica, 1, 1);
+    mu_assert_path_count(replica, 2, 1);
+
+    // Later syncs only copy the changes.
+    uint64_t version = replica->replica_version;
+    sky_event *event = sky_event_create(1000, 10000000LL, 1);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    sky_event_free(event);
+    sync_replica(table, replica, stale);
+    mu_assert_bool(!stale);
+    mu_assert_bool(replica->replica_version > version);
+    mu_assert_replica_blocks(table, replica);
+    mu_assert_path_count(replica, 1000, 1);
+
+    // A replica with more blocks than the primary is stale.
+    version = replica->replica_version;
+    sky_block *block = NULL;
+    mu_assert_int_equals(sky_data_file_create_block(replica->data_file, &block), 0);
+    sync_replica(table, replica, stale);
+    mu_assert_bool(stale);
+    mu_assert_bool(replica->replica_version == version);
+
+    // A full copy fixes it.
+    replica->replica_epoch = 0;
+    replica->replica_version = 0;
+    sync_replica(table, replica, stale);
+    mu_assert_bool(!stale);
+    mu_assert_replica_blocks(table, replica);
+
+    sky_table_free(table);
+    sky_table_free(replica);
+    sky_file_rm_r(&REPLICA_PATH);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_replica_accepts_message);
+    mu_run_test(test_sky_replica_apply);
+    return 0;
+}
+
+RUN_TESTS()
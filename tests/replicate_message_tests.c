@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <replicate_message.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// Processes a Replicate message and reads the start of the response up to
+// the number of changed blocks.
+#define replicate(TABLE, MESSAGE, EPOCH, VERSION, FULL, BLOCK_COUNT) do {\
+    size_t _sz;\
+    bstring _str = NULL;\
+    sky_buffer *_output = sky_buffer_create();\
+    mu_assert_int_equals(sky_replicate_message_process(MESSAGE, TABLE, _output), 0);\
+    mu_dump_buffer(_output, "tmp/output");\
+    sky_buffer_free(_output);\
+    FILE *_file = fopen("tmp/output", "r");\
+    mu_assert_int_equals(minipack_fread_map(_file, &_sz), 11);\
+    sky_minipack_fread_bstring(_file, &_str); mu_assert_bstring(_str, "status"); bdestroy(_str);\
+    sky_minipack_fread_bstring(_file, &_str); mu_assert_bstring(_str, "ok"); bdestroy(_str);\
+    sky_minipack_fread_bstring(_file, &_str); mu_assert_bstring(_str, "epoch"); bdestroy(_str);\
+    EPOCH = minipack_fread_uint(_file, &_sz);\
+    sky_minipack_fread_bstring(_file, &_str); mu_assert_bstring(_str, "version"); bdestroy(_str);\
+    VERSION = minipack_fread_uint(_file, &_sz);\
+    sky_minipack_fread_bstring(_file, &_str); mu_assert_bstring(_str, "full"); bdestroy(_str);\
+    FULL = minipack_fread_bool(_file, &_sz);\
+    sky_minipack_fread_bstring(_file, &_str); mu_assert_bstring(_str, "blockSize"); bdestroy(_str);\
+    mu_assert_int_equals((uint32_t)minipack_fread_uint(_file, &_sz), 128);\
+    sky_minipack_fread_bstring(_file, &_str); mu_assert_bstring(_str, "blockCount"); bdestroy(_str);\
+    mu_assert_int_equals((uint32_t)minipack_fread_uint(_file, &_sz), (TABLE)->data_file->block_count);\
+    sky_minipack_fread_bstring(_file, &_str); mu_assert_bstring(_str, "blocks"); bdestroy(_str);\
+    BLOCK_COUNT = minipack_fread_array(_file, &_sz);\
+    fclose(_file);\
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_replicate_message_pack_unpack() {
+    cleantmp();
+    sky_replicate_message *message = sky_replicate_message_create();
+    message->epoch = 1000;
+    message->version = 20;
+    message->action_count = 3;
+    message->property_count = 4;
+    message->dictionary_length = 50;
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_replicate_message_pack(message, file), 0);
+    mu_assert_long_equals((long)ftell(file), (long)sky_replicate_message_sizeof(message));
+    fclose(file);
+    sky_replicate_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_replicate_message_create();
+    mu_assert_int_equals(sky_replicate_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_long_equals((long)message->epoch, 1000L);
+    mu_assert_long_equals((long)message->version, 20L);
+    mu_assert_int_equals(message->action_count, 3);
+    mu_assert_int_equals(message->property_count, 4);
+    mu_assert_long_equals((long)message->dictionary_length, 50L);
+    sky_replicate_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_replicate_message_process() {
+    uint64_t epoch, version;
+    bool full;
+    uint32_t block_count;
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // A new replica is sent every block.
+    sky_replicate_message *message = sky_replicate_message_create();
+    replicate(table, message, epoch, version, full, block_count);
+    mu_assert_bool(epoch == sky_replicate_message_get_epoch());
+    mu_assert_bool(full);
+    mu_assert_int_equals(block_count, table->data_file->block_count);
+
+    // Nothing changed since the last sync.
+    message->epoch = epoch;
+    message->version = version;
+    replicate(table, message, epoch, version, full, block_count);
+    mu_assert_bool(!full);
+    mu_assert_int_equals(block_count, 0);
+
+    // Only the block that the event was added to changed.
+    sky_event *event = sky_event_create(2, 10000000LL, 1);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    sky_event_free(event);
+    replicate(table, message, epoch, version, full, block_count);
+    mu_assert_bool(!full);
+    mu_assert_int_equals(block_count, 1);
+
+    // A different epoch is sent every block again.
+    message->epoch = epoch + 1;
+    message->version = version;
+    replicate(table, message, epoch, version, full, block_count);
+    mu_assert_bool(full);
+    mu_assert_int_equals(block_count, table->data_file->block_count);
+
+    sky_replicate_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_replicate_message_pack_unpack);
+    mu_run_test(test_sky_replicate_message_process);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <result_cache.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+// The number of bytes an entry with a one byte key and response uses.
+#define ENTRY_SIZE (sizeof(sky_result_cache_entry) + 2)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Lookup
+//--------------------------------------
+
+int test_sky_result_cache_get_put() {
+    void *data = NULL;
+    size_t length = 0;
+    struct tagbstring key = bsStatic("query:abc");
+    sky_result_cache *cache = sky_result_cache_create(1024);
+
+    mu_assert_int_equals(sky_result_cache_get(cache, &key, 1, &data, &length), 0);
+    mu_assert_bool(data == NULL);
+    mu_assert_int_equals(sky_result_cache_put(cache, &key, 1, "xyz", 3), 0);
+    mu_assert_int_equals(sky_result_cache_get(cache, &key, 1, &data, &length), 0);
+    mu_assert_bool(data != NULL);
+    mu_assert_long_equals((long)length, 3L);
+    mu_assert_mem(data, "xyz", 3);
+    mu_assert_long_equals((long)cache->hit_count, 1L);
+    mu_assert_long_equals((long)cache->miss_count, 1L);
+
+    // Replacing a key keeps a single entry.
+    mu_assert_int_equals(sky_result_cache_put(cache, &key, 1, "ab", 2), 0);
+    mu_assert_int_equals(cache->entry_count, 1);
+    mu_assert_int_equals(sky_result_cache_get(cache, &key, 1, &data, &length), 0);
+    mu_assert_long_equals((long)length, 2L);
+    mu_assert_mem(data, "ab", 2);
+
+    sky_result_cache_free(cache);
+    return 0;
+}
+
+int test_sky_result_cache_stale_version() {
+    void *data = NULL;
+    size_t length = 0;
+    struct tagbstring key = bsStatic("query:abc");
+    sky_result_cache *cache = sky_result_cache_create(1024);
+
+    mu_assert_int_equals(sky_result_cache_put(cache, &key, 1, "xyz", 3), 0);
+    mu_assert_int_equals(sky_result_cache_get(cache, &key, 2, &data, &length), 0);
+    mu_assert_bool(data == NULL);
+    mu_assert_int_equals(cache->entry_count, 0);
+    mu_assert_long_equals((long)cache->size, 0L);
+
+    sky_result_cache_free(cache);
+    return 0;
+}
+
+
+//--------------------------------------
+// Eviction
+//--------------------------------------
+
+int test_sky_result_cache_evicts_least_recently_used() {
+    void *data = NULL;
+    size_t length = 0;
+    struct tagbstring a = bsStatic("a");
+    struct tagbstring b = bsStatic("b");
+    struct tagbstring c = bsStatic("c");
+    sky_result_cache *cache = sky_result_cache_create(ENTRY_SIZE * 2);
+
+    mu_assert_int_equals(sky_result_cache_put(cache, &a, 1, "1", 1), 0);
+    mu_assert_int_equals(sky_result_cache_put(cache, &b, 1, "2", 1), 0);
+
+    // Touch 'a' so that 'b' is the least recently used.
+    mu_assert_int_equals(sky_result_cache_get(cache, &a, 1, &data, &length), 0);
+    mu_assert_bool(data != NULL);
+    mu_assert_int_equals(sky_result_cache_put(cache, &c, 1, "3", 1), 0);
+    mu_assert_int_equals(cache->entry_count, 2);
+    mu_assert_long_equals((long)cache->size, (long)(ENTRY_SIZE * 2));
+
+    mu_assert_int_equals(sky_result_cache_get(cache, &b, 1, &data, &length), 0);
+    mu_assert_bool(data == NULL);
+    mu_assert_int_equals(sky_result_cache_get(cache, &a, 1, &data, &length), 0);
+    mu_assert_bool(data != NULL);
+    mu_assert_int_equals(sky_result_cache_get(cache, &c, 1, &data, &length), 0);
+    mu_assert_bool(data != NULL);
+
+    sky_result_cache_free(cache);
+    return 0;
+}
+
+int test_sky_result_cache_skips_oversized_entries() {
+    void *data = NULL;
+    size_t length = 0;
+    struct tagbstring a = bsStatic("a");
+    struct tagbstring b = bsStatic("b");
+    char response[256];
+    memset(response, 'x', sizeof(response));
+    sky_result_cache *cache = sky_result_cache_create(ENTRY_SIZE * 2);
+
+    mu_assert_int_equals(sky_result_cache_put(cache, &a, 1, "1", 1), 0);
+    mu_assert_int_equals(sky_result_cache_put(cache, &b, 1, response, sizeof(response)), 0);
+    mu_assert_int_equals(sky_result_cache_get(cache, &b, 1, &data, &length), 0);
+    mu_assert_bool(data == NULL);
+    mu_assert_int_equals(sky_result_cache_get(cache, &a, 1, &data, &length), 0);
+    mu_assert_bool(data != NULL);
+
+    sky_result_cache_free(cache);
+    return 0;
+}
+
+int test_sky_result_cache_grows_buckets() {
+    int i;
+    void *data = NULL;
+    size_t length = 0;
+    sky_result_cache *cache = sky_result_cache_create(1024 * 1024);
+
+    for(i=0; i<1000; i++) {
+        bstring key = bformat("query:%d", i);
+        mu_assert_int_equals(sky_result_cache_put(cache, key, 1, &i, sizeof(i)), 0);
+        bdestroy(key);
+    }
+    mu_assert_int_equals(cache->entry_count, 1000);
+    mu_assert_bool(cache->bucket_count >= 1000);
+
+    for(i=0; i<1000; i++) {
+        bstring key = bformat("query:%d", i);
+        mu_assert_int_equals(sky_result_cache_get(cache, key, 1, &data, &length), 0);
+        mu_assert_bool(data != NULL);
+        mu_assert_int_equals(*((int*)data), i);
+        bdestroy(key);
+    }
+
+    sky_result_cache_free(cache);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_result_cache_get_put);
+    mu_run_test(test_sky_result_cache_stale_version);
+    mu_run_test(test_sky_result_cache_evicts_least_recently_used);
+    mu_run_test(test_sky_result_cache_skips_oversized_entries);
+    mu_run_test(test_sky_result_cache_grows_buckets);
+    return 0;
+}
+
+RUN_TESTS()
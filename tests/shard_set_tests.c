@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <mem.h>
+#include <file.h>
+#include <shard_set.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+#define INIT_SHARD_SET(COUNT) do {\
+    cleantmp(); \
+    shard_set = sky_shard_set_create(); \
+    shard_set->path = bfromcstr("tmp/shards"); \
+    shard_set->block_size = 128; \
+    mu_assert_int_equals(sky_shard_set_load(shard_set, COUNT), 0); \
+} while(0)
+
+// Asserts the number of path parts that an object has in a data file.
+#define mu_assert_path_count(DATA_FILE, OBJECT_ID, PATH_COUNT) do {\
+    void **_paths = NULL; \
+    uint32_t _path_count = 0; \
+    mu_assert_int_equals(sky_data_file_find_path(DATA_FILE, OBJECT_ID, &_paths, &_path_count), 0); \
+    mu_assert_int_equals(_path_count, PATH_COUNT); \
+    free(_paths); \
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Routing
+//--------------------------------------
+
+int test_sky_shard_set_get_shard_index() {
+    uint32_t i;
+    uint32_t counts[4] = {0, 0, 0, 0};
+    sky_shard_set *shard_set = sky_shard_set_create();
+    shard_set->shard_count = 4;
+
+    // Sequential ids are spread evenly.
+    for(i=1; i<=4000; i++) {
+        uint32_t index = sky_shard_set_get_shard_index(shard_set, i);
+        mu_assert_bool(index < 4);
+        counts[index]++;
+    }
+    for(i=0; i<4; i++) {
+        mu_assert_bool(counts[i] > 900 && counts[i] < 1100);
+    }
+    mu_assert_int_equals(sky_shard_set_get_shard_index(shard_set, 10), sky_shard_set_get_shard_index(shard_set, 10));
+
+    shard_set->shard_count = 0;
+    sky_shard_set_free(shard_set);
+    return 0;
+}
+
+
+//--------------------------------------
+// Events
+//--------------------------------------
+
+int test_sky_shard_set_add_events() {
+    uint32_t i;
+    sky_shard_set *shard_set = NULL;
+    INIT_SHARD_SET(4);
+
+    // Each object gets two events.
+    sky_event *events[200];
+    for(i=0; i<200; i++) {
+        events[i] = sky_event_create((i / 2) + 1, (sky_timestamp_t)(i % 2) * 1000000LL, (i % 2) + 1);
+    }
+    mu_assert_int_equals(sky_shard_set_add_events(shard_set, events, 200), 0);
+    sky_event *event = sky_event_create(1000, 0LL, 1);
+    mu_assert_int_equals(sky_shard_set_add_event(shard_set, event), 0);
+    sky_event_free(event);
+    for(i=0; i<200; i++) {
+        sky_event_free(events[i]);
+    }
+
+    // The path of an object is only in its own shard.
+    for(i=1; i<=100; i++) {
+        uint32_t j, index = sky_shard_set_get_shard_index(shard_set, i);
+        for(j=0; j<4; j++) {
+            mu_assert_path_count(shard_set->shards[j].data_file, i, (j == index ? 1 : 0));
+        }
+    }
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    mu_assert_int_equals(sky_shard_set_find_path(shard_set, 1000, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+
+    // Queries aggregate over every shard.
+    struct tagbstring count_str = bsStatic("count");
+    sky_query *query = sky_query_create();
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    sky_query_result *result = sky_query_result_create(query);
+    mu_assert_int_equals(sky_shard_set_execute_query(shard_set, query, result), 0);
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_int64_equals((long long)result->keys[0], 1LL);
+    mu_assert_int64_equals((long long)result->values[0], 101LL);
+    mu_assert_int64_equals((long long)result->keys[1], 2LL);
+    mu_assert_int64_equals((long long)result->values[1], 100LL);
+    sky_query_result_free(result);
+    sky_query_free(query);
+
+    // The shards are read back from disk.
+    mu_assert_int_equals(sky_shard_set_load(shard_set, 4), 0);
+    mu_assert_path_count(shard_set->shards[sky_shard_set_get_shard_index(shard_set, 50)].data_file, 50, 1);
+
+    // A different number of shards would route objects to the wrong shard.
+    mu_assert_int_equals(sky_shard_set_load(shard_set, 2), -1);
+    mu_assert_int_equals(shard_set->shard_count, 0);
+
+    sky_shard_set_free(shard_set);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_shard_set_get_shard_index);
+    mu_run_test(test_sky_shard_set_add_events);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <snapshot_message.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_snapshot_message_pack_unpack() {
+    cleantmp();
+    sky_snapshot_message *message = sky_snapshot_message_create();
+    message->path = bfromcstr("tmp/snapshot");
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_snapshot_message_pack(message, file), 0);
+    fclose(file);
+    sky_snapshot_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_snapshot_message_create();
+    mu_assert_int_equals(sky_snapshot_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_bstring(message->path, "tmp/snapshot");
+    sky_snapshot_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_snapshot_message_process() {
+    size_t sz;
+    bstring str = NULL;
+    cleantmp();
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp/table");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    sky_event *event = sky_event_create(10, 5, 20);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    sky_event_free(event);
+
+    sky_snapshot_message *message = sky_snapshot_message_create();
+    message->path = bfromcstr("tmp/snapshot");
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_snapshot_message_process(message, table, output), 0);
+    mu_dump_buffer(output, "tmp/output");
+    sky_buffer_free(output);
+
+    // {status:"ok", cloned:<bool>}
+    FILE *file = fopen("tmp/output", "r");
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 2);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "status"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "ok"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "cloned"); bdestroy(str);
+    minipack_fread_bool(file, &sz);
+    mu_assert_bool(sz > 0);
+    fclose(file);
+
+    // An existing directory is never overwritten.
+    output = sky_buffer_create();
+    mu_assert_int_equals(sky_snapshot_message_process(message, table, output), -1);
+    sky_buffer_free(output);
+
+    // The snapshot can be opened while the table is still open.
+    struct tagbstring lock_path = bsStatic("tmp/snapshot/" SKY_LOCK_NAME);
+    mu_assert_bool(!sky_file_exists(&lock_path));
+    sky_table *snapshot = sky_table_create();
+    snapshot->path = bfromcstr("tmp/snapshot");
+    mu_assert_int_equals(sky_table_open(snapshot), 0);
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    mu_assert_int_equals(sky_data_file_find_path(snapshot->data_file, 10, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+    sky_table_free(snapshot);
+
+    sky_snapshot_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_snapshot_message_process_inside_table() {
+    cleantmp();
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp/table");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    sky_snapshot_message *message = sky_snapshot_message_create();
+    message->path = bfromcstr("tmp/table/snapshot");
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_snapshot_message_process(message, table, output), -1);
+    struct tagbstring path = bsStatic("tmp/table/snapshot");
+    mu_assert_bool(!sky_file_exists(&path));
+
+    sky_buffer_free(output);
+    sky_snapshot_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_snapshot_message_pack_unpack);
+    mu_run_test(test_sky_snapshot_message_process);
+    mu_run_test(test_sky_snapshot_message_process_inside_table);
+    return 0;
+}
+
+RUN_TESTS()
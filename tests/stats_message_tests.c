@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stats_message.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_stats_message_pack_unpack() {
+    cleantmp();
+    sky_stats_message *message = sky_stats_message_create();
+    message->format = bfromcstr("prometheus");
+    mu_assert_long_equals(sky_stats_message_sizeof(message), 11L);
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_stats_message_pack(message, file), 0);
+    fclose(file);
+    sky_stats_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_stats_message_create();
+    mu_assert_int_equals(sky_stats_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_bstring(message->format, "prometheus");
+    sky_stats_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_stats_message_process() {
+    size_t sz;
+    bstring str = NULL;
+    sky_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.open_table_count = 3;
+
+    // {status:"ok", stats:{...}}
+    sky_stats_message *message = sky_stats_message_create();
+    message->format = bfromcstr("");
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_stats_message_process(message, &stats, NULL, 0, output), 0);
+    FILE *file = fmemopen(output->data, output->length, "r");
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 3);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "status"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "ok"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "stats"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 14);
+    fclose(file);
+
+    // {status:"ok", text:"..."}
+    sky_buffer_clear(output);
+    bassigncstr(message->format, "prometheus");
+    mu_assert_int_equals(sky_stats_message_process(message, &stats, NULL, 0, output), 0);
+    file = fmemopen(output->data, output->length, "r");
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 2);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "text"); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str);
+    mu_assert_bool(strstr((char*)str->data, "sky_open_tables 3\n") != NULL);
+    bdestroy(str);
+    fclose(file);
+
+    // Unknown formats fail.
+    sky_buffer_clear(output);
+    bassigncstr(message->format, "xml");
+    mu_assert_int_equals(sky_stats_message_process(message, &stats, NULL, 0, output), -1);
+
+    sky_buffer_free(output);
+    sky_stats_message_free(message);
+    return 0;
+}
+
+
+int test_sky_stats_message_process_tables() {
+    size_t sz;
+    bstring str = NULL;
+    sky_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    sky_table_memory tables[2];
+    memset(tables, 0, sizeof(tables));
+    tables[0].name = bfromcstr("db/a");
+    tables[0].mapped_bytes = 4096;
+    tables[0].resident_bytes = 1024;
+    tables[1].name = bfromcstr("db/b");
+    tables[1].subscription_bytes = 20;
+
+    // {status:"ok", stats:{...}, tables:[{name:"db/a", mappedBytes:4096, ...}, ...]}
+    sky_stats_message *message = sky_stats_message_create();
+    message->format = bfromcstr("");
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_stats_message_process(message, &stats, tables, 2, output), 0);
+    FILE *file = fmemopen(output->data, output->length, "r");
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 3);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 14);
+    fclose(file);
+    mu_assert_bool(memmem(output->data, output->length, "tables", 6) != NULL);
+    mu_assert_bool(memmem(output->data, output->length, "db/b", 4) != NULL);
+    mu_assert_bool(memmem(output->data, output->length, "subscriptionBytes", 17) != NULL);
+
+    // sky_table_memory_bytes{table="db/a",type="mapped"} 4096
+    sky_buffer_clear(output);
+    bassigncstr(message->format, "prometheus");
+    mu_assert_int_equals(sky_stats_message_process(message, &stats, tables, 2, output), 0);
+    file = fmemopen(output->data, output->length, "r");
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 2);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str); bdestroy(str);
+    sky_minipack_fread_bstring(file, &str);
+    mu_assert_bool(strstr((char*)str->data, "sky_table_memory_bytes{table=\"db/a\",type=\"mapped\"} 4096\n") != NULL);
+    mu_assert_bool(strstr((char*)str->data, "sky_table_memory_bytes{table=\"db/a\",type=\"resident\"} 1024\n") != NULL);
+    mu_assert_bool(strstr((char*)str->data, "sky_table_memory_bytes{table=\"db/b\",type=\"subscription\"} 20\n") != NULL);
+    bdestroy(str);
+    fclose(file);
+
+    sky_table_memory_free(&tables[0]);
+    sky_table_memory_free(&tables[1]);
+    sky_buffer_free(output);
+    sky_stats_message_free(message);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_stats_message_pack_unpack);
+    mu_run_test(test_sky_stats_message_process);
+    mu_run_test(test_sky_stats_message_process_tables);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stats.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Recording
+//--------------------------------------
+
+int test_sky_stats_get_bucket_index() {
+    mu_assert_int_equals(sky_stats_get_bucket_index(0), 0);
+    mu_assert_int_equals(sky_stats_get_bucket_index(1), 1);
+    mu_assert_int_equals(sky_stats_get_bucket_index(2), 2);
+    mu_assert_int_equals(sky_stats_get_bucket_index(3), 2);
+    mu_assert_int_equals(sky_stats_get_bucket_index(1000), 10);
+    mu_assert_int_equals(sky_stats_get_bucket_index(INT64_MAX), SKY_STATS_HISTOGRAM_BUCKET_COUNT-1);
+    return 0;
+}
+
+int test_sky_stats_record() {
+    sky_stats_histogram histogram;
+    memset(&histogram, 0, sizeof(histogram));
+    sky_stats_record(&histogram, 3);
+    sky_stats_record(&histogram, 1000);
+    sky_stats_record(&histogram, -5);
+    mu_assert_long_equals((long)histogram.count, 3L);
+    mu_assert_long_equals((long)histogram.sum, 1003L);
+    mu_assert_long_equals((long)histogram.buckets[0], 1L);
+    mu_assert_long_equals((long)histogram.buckets[2], 1L);
+    mu_assert_long_equals((long)histogram.buckets[10], 1L);
+    return 0;
+}
+
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_stats_pack() {
+    size_t sz;
+    bstring str = NULL;
+    sky_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.open_table_count = 4;
+    sky_stats_record(&stats.messages[SKY_MESSAGE_TYPE_EADD], 5);
+
+    sky_buffer *buffer = sky_buffer_create();
+    mu_assert_int_equals(sky_stats_pack(&stats, buffer), 0);
+    FILE *file = fmemopen(buffer->data, buffer->length, "r");
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 14);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "messages"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), SKY_MESSAGE_TYPE_COUNT-1);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "eadd"); bdestroy(str);
+    mu_assert_int_equals(minipack_fread_map(file, &sz), 3);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "count"); bdestroy(str);
+    mu_assert_int_equals((int)minipack_fread_uint(file, &sz), 1);
+    sky_minipack_fread_bstring(file, &str); mu_assert_bstring(str, "sum"); bdestroy(str);
+    mu_assert_int_equals((int)minipack_fread_uint(file, &sz), 5);
+    fclose(file);
+    sky_buffer_free(buffer);
+    return 0;
+}
+
+int test_sky_stats_write_prometheus() {
+    sky_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.events_inserted = 7;
+    sky_stats_record(&stats.messages[SKY_MESSAGE_TYPE_QUERY], 3);
+    sky_stats_record(&stats.syncs, 2000000);
+
+    sky_buffer *buffer = sky_buffer_create();
+    mu_assert_int_equals(sky_stats_write_prometheus(&stats, buffer), 0);
+    mu_assert_int_equals(sky_buffer_write(buffer, "", 1), 0);
+    mu_assert_bool(strstr(buffer->data, "sky_message_duration_seconds_bucket{type=\"query\",le=\"2e-06\"} 0\n") != NULL);
+    mu_assert_bool(strstr(buffer->data, "sky_message_duration_seconds_bucket{type=\"query\",le=\"4e-06\"} 1\n") != NULL);
+    mu_assert_bool(strstr(buffer->data, "sky_message_duration_seconds_bucket{type=\"query\",le=\"+Inf\"} 1\n") != NULL);
+    mu_assert_bool(strstr(buffer->data, "sky_message_duration_seconds_count{type=\"query\"} 1\n") != NULL);
+    mu_assert_bool(strstr(buffer->data, "sky_sync_duration_seconds_bucket{le=\"+Inf\"} 1\n") != NULL);
+    mu_assert_bool(strstr(buffer->data, "sky_sync_duration_seconds_sum 2.000000\n") != NULL);
+    mu_assert_bool(strstr(buffer->data, "sky_events_inserted_total 7\n") != NULL);
+    sky_buffer_free(buffer);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_stats_get_bucket_index);
+    mu_run_test(test_sky_stats_record);
+    mu_run_test(test_sky_stats_pack);
+    mu_run_test(test_sky_stats_write_prometheus);
+    return 0;
+}
+
+RUN_TESTS()
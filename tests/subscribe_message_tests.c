@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <subscribe_message.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_subscribe_message_pack_unpack() {
+    cleantmp();
+    sky_subscribe_message *message = sky_subscribe_message_create();
+    message->action_id_count = 2;
+    message->action_ids = calloc(2, sizeof(*message->action_ids));
+    message->action_ids[0] = 3;
+    message->action_ids[1] = 7;
+    message->capacity = 500;
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_subscribe_message_pack(message, file), 0);
+    fclose(file);
+    sky_subscribe_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_subscribe_message_create();
+    mu_assert_int_equals(sky_subscribe_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_int_equals(message->action_id_count, 2);
+    mu_assert_int_equals(message->action_ids[0], 3);
+    mu_assert_int_equals(message->action_ids[1], 7);
+    mu_assert_int_equals(message->capacity, 500);
+    sky_subscribe_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_subscribe_message_process() {
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    sky_subscribe_message *message = sky_subscribe_message_create();
+    message->action_id_count = 1;
+    message->action_ids = calloc(1, sizeof(*message->action_ids));
+    message->action_ids[0] = 2;
+    message->capacity = 10;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_subscribe_message_process(message, table, output), 0);
+
+    //   {status:"ok", subscriptionId:1}
+    char expected[] = "\x82" "\xA6" "status" "\xA2" "ok" "\xAE" "subscriptionId" "\x01";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected) - 1));
+    mu_assert_mem(output->data, expected, sizeof(expected) - 1);
+
+    // The subscription is registered with the filter and capacity.
+    sky_subscription *subscription = sky_table_find_subscription(table, 1);
+    mu_assert_bool(subscription != NULL);
+    mu_assert_int_equals(subscription->capacity, 10);
+    mu_assert_int_equals(subscription->action_id_count, 1);
+    mu_assert_int_equals(subscription->action_ids[0], 2);
+
+    sky_buffer_free(output);
+    sky_subscribe_message_free(message);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_subscribe_message_pack_unpack);
+    mu_run_test(test_sky_subscribe_message_process);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <subscription.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Ring Buffer
+//--------------------------------------
+
+int test_sky_subscription_push() {
+    sky_event *event = sky_event_create(10, 1000, 2);
+    sky_subscription *subscription = sky_subscription_create(0, NULL, 0);
+    mu_assert_int_equals(subscription->capacity, SKY_SUBSCRIPTION_DEFAULT_CAPACITY);
+    mu_assert_bool(sky_subscription_peek(subscription, 0) == NULL);
+
+    // Events are buffered as raw events with their full timestamp.
+    mu_assert_int_equals(sky_subscription_push(subscription, event), 0);
+    mu_assert_int_equals(sky_subscription_get_event_count(subscription), 1);
+    sky_subscription_event *slot = sky_subscription_peek(subscription, 0);
+    mu_assert_bool(slot != NULL);
+    mu_assert_int_equals(slot->object_id, 10);
+    mu_assert_long_equals((long)slot->length, (long)sky_event_sizeof(event));
+    mu_assert_int64_equals((long long)sky_event_get_timestamp(slot->data, 0), 1000LL);
+
+    sky_subscription_shift(subscription, 5);
+    mu_assert_int_equals(sky_subscription_get_event_count(subscription), 0);
+
+    sky_subscription_free(subscription);
+    sky_event_free(event);
+    return 0;
+}
+
+int test_sky_subscription_filter() {
+    sky_action_id_t action_ids[] = {3, 5};
+    sky_event *event = sky_event_create(10, 1000, 2);
+    sky_subscription *subscription = sky_subscription_create(4, action_ids, 2);
+    mu_assert_bool(!sky_subscription_matches(subscription, 2));
+    mu_assert_bool(sky_subscription_matches(subscription, 5));
+
+    // Only events of the listed actions are buffered.
+    mu_assert_int_equals(sky_subscription_push(subscription, event), 0);
+    event->action_id = 5;
+    mu_assert_int_equals(sky_subscription_push(subscription, event), 0);
+    mu_assert_int_equals(sky_subscription_get_event_count(subscription), 1);
+    mu_assert_int_equals(subscription->dropped, 0);
+
+    sky_subscription_free(subscription);
+    sky_event_free(event);
+    return 0;
+}
+
+int test_sky_subscription_overflow() {
+    uint32_t i;
+    sky_event *event = sky_event_create(0, 1000, 1);
+    sky_subscription *subscription = sky_subscription_create(3, NULL, 0);
+
+    // The oldest events are dropped once the ring is full.
+    for(i=1; i<=5; i++) {
+        event->object_id = i;
+        mu_assert_int_equals(sky_subscription_push(subscription, event), 0);
+    }
+    mu_assert_int_equals(sky_subscription_get_event_count(subscription), 3);
+    mu_assert_int_equals(subscription->dropped, 2);
+    mu_assert_int_equals(sky_subscription_peek(subscription, 0)->object_id, 3);
+    mu_assert_int_equals(sky_subscription_peek(subscription, 2)->object_id, 5);
+
+    // Shifting frees room for new events.
+    sky_subscription_shift(subscription, 2);
+    event->object_id = 6;
+    mu_assert_int_equals(sky_subscription_push(subscription, event), 0);
+    mu_assert_int_equals(sky_subscription_get_event_count(subscription), 2);
+    mu_assert_int_equals(sky_subscription_peek(subscription, 0)->object_id, 5);
+    mu_assert_int_equals(sky_subscription_peek(subscription, 1)->object_id, 6);
+    mu_assert_int_equals(subscription->dropped, 2);
+
+    mu_assert_bool(sky_subscription_create(SKY_SUBSCRIPTION_MAX_CAPACITY+1, NULL, 0) == NULL);
+
+    sky_subscription_free(subscription);
+    sky_event_free(event);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_subscription_push);
+    mu_run_test(test_sky_subscription_filter);
+    mu_run_test(test_sky_subscription_overflow);
+    return 0;
+}
+
+RUN_TESTS()
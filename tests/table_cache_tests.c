@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <dbg.h>
+#include <table_cache.h>
+#include <bstring.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Open
+//--------------------------------------
+
+int test_sky_table_cache_open_reuses_tables() {
+    struct tagbstring path_a = bsStatic("tmp/a");
+    struct tagbstring path_b = bsStatic("tmp/b");
+    cleantmp();
+
+    sky_table *table_a = NULL, *table_b = NULL, *table = NULL;
+    sky_table_cache *cache = sky_table_cache_create(4, 0);
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_a, &table_a), 0);
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_b, &table_b), 0);
+    mu_assert_int_equals(cache->table_count, 2);
+    mu_assert_bool(cache->tables[0] == table_b);
+
+    // Reopening returns the cached table and moves it to the front.
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_a, &table), 0);
+    mu_assert_bool(table == table_a);
+    mu_assert_int_equals(cache->table_count, 2);
+    mu_assert_bool(cache->tables[0] == table_a);
+    mu_assert_bool(cache->tables[1] == table_b);
+
+    sky_table_cache_free(cache);
+    return 0;
+}
+
+int test_sky_table_cache_open_with_default_block_size() {
+    struct tagbstring path_a = bsStatic("tmp/a");
+    struct tagbstring path_b = bsStatic("tmp/b");
+    cleantmp();
+
+    // New tables are created with the cache's block size.
+    sky_table *table = NULL;
+    sky_table_cache *cache = sky_table_cache_create(4, 0);
+    cache->default_block_size = 0x100000;
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_a, &table), 0);
+    mu_assert_int_equals(table->data_file->block_size, 0x100000);
+    sky_table_cache_free(cache);
+
+    // Existing tables keep the block size they were created with.
+    cache = sky_table_cache_create(4, 0);
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_a, &table), 0);
+    mu_assert_int_equals(table->data_file->block_size, 0x100000);
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_b, &table), 0);
+    mu_assert_int_equals(table->data_file->block_size, SKY_DEFAULT_BLOCK_SIZE);
+    sky_table_cache_free(cache);
+    return 0;
+}
+
+int test_sky_table_cache_evicts_least_recently_used_table() {
+    struct tagbstring path_a = bsStatic("tmp/a");
+    struct tagbstring path_b = bsStatic("tmp/b");
+    struct tagbstring path_c = bsStatic("tmp/c");
+    cleantmp();
+
+    sky_table *table_a = NULL, *table_b = NULL, *table_c = NULL;
+    sky_table_cache *cache = sky_table_cache_create(2, 0);
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_a, &table_a), 0);
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_b, &table_b), 0);
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_a, &table_a), 0);
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_c, &table_c), 0);
+    mu_assert_int_equals(cache->table_count, 2);
+    mu_assert_bool(cache->tables[0] == table_c);
+    mu_assert_bool(cache->tables[1] == table_a);
+
+    sky_table_cache_free(cache);
+    return 0;
+}
+
+int test_sky_table_cache_evicts_by_mapped_bytes() {
+    struct tagbstring path_a = bsStatic("tmp/a");
+    struct tagbstring path_b = bsStatic("tmp/b");
+    cleantmp();
+
+    sky_table *table_a = NULL, *table_b = NULL;
+    sky_table_cache *cache = sky_table_cache_create(4, 1);
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_a, &table_a), 0);
+    
+    // The only table is kept even when it is over the limit.
+    sky_event *event = sky_event_create(10, 1000LL, 1);
+    mu_assert_int_equals(sky_table_add_event(table_a, event), 0);
+    sky_event_free(event);
+    mu_assert_bool(sky_table_cache_mapped_bytes(cache) > 1);
+    mu_assert_int_equals(sky_table_cache_evict(cache), 0);
+    mu_assert_int_equals(cache->table_count, 1);
+
+    // Opening another table closes the mapped table.
+    mu_assert_int_equals(sky_table_cache_open(cache, &path_b, &table_b), 0);
+    mu_assert_int_equals(cache->table_count, 1);
+    mu_assert_bool(cache->tables[0] == table_b);
+
+    sky_table_cache_free(cache);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_table_cache_open_reuses_tables);
+    mu_run_test(test_sky_table_cache_open_with_default_block_size);
+    mu_run_test(test_sky_table_cache_evicts_least_recently_used_table);
+    mu_run_test(test_sky_table_cache_evicts_by_mapped_bytes);
+    return 0;
+}
+
+RUN_TESTS()
@@ -1,10 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <errno.h>
 
 #include <dbg.h>
 #include <table.h>
+#include <path.h>
+#include <cursor.h>
+#include <timestamp.h>
 #include <bstring.h>
 
 #include "minunit.h"
@@ -49,6 +53,645 @@ int test_sky_table_open() {
 }
 
 
+//--------------------------------------
+// Lazy Loading
+//--------------------------------------
+
+int test_sky_table_open_loads_files_lazily() {
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // Blocks from the header are allocated from a single slab.
+    mu_assert_int_equals(table->data_file->block_slab_count, table->data_file->block_count);
+    mu_assert_bool(table->data_file->blocks[0] == &table->data_file->block_slab[0]);
+
+    // Actions and properties are read on first use.
+    mu_assert_bool(!table->action_file->loaded);
+    mu_assert_bool(!table->property_file->loaded);
+    sky_action *action = NULL;
+    mu_assert_int_equals(sky_action_file_find_action_by_id(table->action_file, 1, &action), 0);
+    mu_assert_bool(table->action_file->loaded);
+    mu_assert_bool(action != NULL);
+    mu_assert_int_equals(sky_property_file_ensure_loaded(table->property_file), 0);
+    mu_assert_bool(table->property_file->loaded);
+    mu_assert_bool(table->property_file->property_count > 0);
+
+    // Blocks created after opening are freed along with the slab.
+    sky_block *block = NULL;
+    mu_assert_int_equals(sky_data_file_create_block(table->data_file, &block), 0);
+    mu_assert_int_equals(table->data_file->block_count, table->data_file->block_slab_count + 1);
+
+    sky_table_free(table);
+    return 0;
+}
+
+
+//--------------------------------------
+// Memtable
+//--------------------------------------
+
+int test_sky_table_memtable() {
+    struct tagbstring log_file_path = bsStatic("tmp/wal");
+    cleantmp();
+
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_set_memtable_size(table, 2), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // Events are buffered until the memtable is full.
+    sky_event *event = sky_event_create(10, 5, 20);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    mu_assert_int_equals(table->memtable->event_count, 1);
+    mu_assert_int_equals(sky_table_get_unflushed_event_count(table), 1);
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 10, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    free(paths);
+
+    event->timestamp = 2;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    mu_assert_int_equals(table->memtable->event_count, 0);
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 10, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+
+    // Events left in the log are merged when the table is opened again.
+    event->object_id = 11;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    mu_assert_long_equals(sky_file_get_size(&log_file_path), 19L);
+    sky_memtable_free(table->memtable);
+    table->memtable = NULL;
+    mu_assert_int_equals(sky_table_close(table), 0);
+
+    mu_assert_int_equals(sky_table_set_memtable_size(table, 0), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_bool(table->memtable == NULL);
+    mu_assert_long_equals(sky_file_get_size(&log_file_path), 0L);
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 11, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+    mu_assert_int_equals(sky_table_close(table), 0);
+
+    sky_event_free(event);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_table_reorder_window() {
+    cleantmp();
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_set_memtable_size(table, 4), 0);
+    mu_assert_int_equals(sky_table_set_reorder_window(table, 10), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // A flush only merges the event that is more than ten seconds older
+    // than the latest event and keeps the rest in the synced log.
+    sky_event *event = sky_event_create(10, 1000000LL, 20);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    event->timestamp = 20000000LL;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    event->timestamp = 15000000LL;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    mu_assert_int_equals(sky_table_flush(table), 0);
+    mu_assert_int_equals(table->memtable->event_count, 2);
+
+    // A late event that arrives inside the window is sorted in with the held
+    // back events. Filling the memtable merges up to the new cutoff.
+    event->timestamp = 12000000LL;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    mu_assert_int_equals(table->memtable->event_count, 3);
+    event->timestamp = 25000000LL;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    mu_assert_int_equals(table->memtable->event_count, 2);
+
+    // Readers see every event.
+    mu_assert_int_equals(sky_table_merge(table), 0);
+    mu_assert_int_equals(table->memtable->event_count, 0);
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 10, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    sky_cursor cursor;
+    sky_cursor_init(&cursor);
+    sky_timestamp_t timestamp = 0;
+    mu_assert_int_equals(sky_cursor_set_path(&cursor, paths[0]), 0);
+    sky_cursor_get_timestamp(&cursor, &timestamp);
+    mu_assert_int64_equals(timestamp, 1000000LL);
+    mu_assert_int_equals(sky_cursor_next(&cursor), 0);
+    sky_cursor_get_timestamp(&cursor, &timestamp);
+    mu_assert_int64_equals(timestamp, 12000000LL);
+    mu_assert_int_equals(sky_cursor_next(&cursor), 0);
+    sky_cursor_get_timestamp(&cursor, &timestamp);
+    mu_assert_int64_equals(timestamp, 15000000LL);
+    mu_assert_int_equals(sky_cursor_next(&cursor), 0);
+    sky_cursor_get_timestamp(&cursor, &timestamp);
+    mu_assert_int64_equals(timestamp, 20000000LL);
+    mu_assert_int_equals(sky_cursor_next(&cursor), 0);
+    sky_cursor_get_timestamp(&cursor, &timestamp);
+    mu_assert_int64_equals(timestamp, 25000000LL);
+    free(paths);
+
+    sky_event_free(event);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//--------------------------------------
+// Fixed Properties
+//--------------------------------------
+
+int test_sky_table_fixed_properties() {
+    cleantmp();
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    sky_property *property = sky_property_create();
+    property->data_type = bfromcstr("Int");
+    property->name = bfromcstr("score");
+    property->fixed = true;
+    mu_assert_int_equals(sky_property_file_add_property(table->property_file, property), 0);
+    property = sky_property_create();
+    property->data_type = bfromcstr("Int");
+    property->name = bfromcstr("count");
+    mu_assert_int_equals(sky_property_file_add_property(table->property_file, property), 0);
+
+    // Only the value of the fixed property goes into the fixed section.
+    sky_event *event = sky_event_create(10, 5, 20);
+    event->data_count = 2;
+    event->data = calloc(2, sizeof(*event->data));
+    event->data[0] = sky_event_data_create_int(2, 3);
+    event->data[1] = sky_event_data_create_int(1, 1000);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    mu_assert_bool(event->data[1]->fixed && !event->data[0]->fixed);
+
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 10, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    size_t sz;
+    sky_event_view view;
+    sky_event_data_view data;
+    mu_assert_int_equals(sky_event_unpack_view(&view, paths[0] + SKY_PATH_HEADER_LENGTH, &sz), 0);
+    mu_assert_int_equals(sky_event_data_get_fixed_count(view.data_ptr, view.data_length), 1);
+    mu_assert_bool(sky_event_data_find_fixed(view.data_ptr, view.data_length, 1, &data));
+    mu_assert_int64_equals(data.int_value, 1000LL);
+    sky_event_view_get_data(&view, 2, &data);
+    mu_assert_int_equals(data.type, SKY_EVENT_DATA_TYPE_INT);
+    mu_assert_int64_equals(data.int_value, 3LL);
+    free(paths);
+
+    mu_assert_int_equals(sky_table_close(table), 0);
+    sky_event_free(event);
+    sky_table_free(table);
+    return 0;
+}
+
+//--------------------------------------
+// Event Removal
+//--------------------------------------
+
+int test_sky_table_remove_events() {
+    cleantmp();
+    bool removed = false;
+    uint32_t count = 0;
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_set_memtable_size(table, 10), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // Buffered events are merged before they are removed.
+    sky_event *event = sky_event_create(10, 5, 20);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    event->timestamp = 6;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    event->object_id = 11;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    mu_assert_int_equals(sky_table_remove_events(table, 10, 5, &count), 0);
+    mu_assert_int_equals(count, 1);
+    mu_assert_int_equals(table->memtable->event_count, 0);
+
+    mu_assert_int_equals(sky_table_remove_object(table, 10, &removed), 0);
+    mu_assert_bool(removed);
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 10, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 11, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+    mu_assert_int_equals(sky_table_close(table), 0);
+
+    sky_event_free(event);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//--------------------------------------
+// Retention
+//--------------------------------------
+
+int test_sky_table_expire() {
+    cleantmp();
+    uint32_t count = 0;
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_timestamp_t now = 0;
+    sky_timestamp_now(&now);
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    table->default_block_size = 128;
+    mu_assert_int_equals(sky_table_open(table), 0);
+    uint32_t i;
+    sky_event *event = sky_event_create(10, 0, 20);
+    for(i=0; i<40; i++) {
+        event->timestamp = 1000 + i;
+        mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    }
+    event->object_id = 11;
+    event->timestamp = now;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    event->object_id = 12;
+    event->timestamp = 1000;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    sky_event_free(event);
+
+    // Tables keep their events forever by default.
+    mu_assert_int_equals(sky_table_expire(table, &count), 0);
+    mu_assert_int_equals(count, 0);
+
+    // Old blocks are dropped once a retention is set.
+    mu_assert_int_equals(sky_table_set_retention(table, 3600), 0);
+    mu_assert_int_equals(sky_table_expire(table, &count), 0);
+    mu_assert_bool(count > 0);
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 10, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 12, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+
+    // Compaction trims the rest.
+    mu_assert_int_equals(sky_table_compact(table, 100), 0);
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 12, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    mu_assert_int_equals(sky_data_file_find_path(table->data_file, 11, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+    mu_assert_int_equals(sky_table_close(table), 0);
+
+    sky_table_free(table);
+    return 0;
+}
+
+
+//--------------------------------------
+// Action-Only
+//--------------------------------------
+
+int test_sky_table_action_only() {
+    struct tagbstring marker_path = bsStatic("tmp/action_only");
+    cleantmp();
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_set_action_only(table, true), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_bool(table->action_only);
+    mu_assert_bool(table->data_file->action_only);
+    mu_assert(sky_file_exists(&marker_path), "");
+    mu_assert_int_equals(sky_table_set_action_only(table, false), -1);
+
+    // Events without data are added and events with data are refused.
+    sky_event *event = sky_event_create(10, 1000, 20);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    event->timestamp = 2000;
+    event->action_id = 21;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    event->data_count = 1;
+    event->data = calloc(1, sizeof(*event->data));
+    event->data[0] = sky_event_data_create_int(1, 100);
+    mu_assert_int_equals(sky_table_add_event(table, event), -1);
+    sky_event_free(event);
+
+    // The action index is built with the action-only macros.
+    sky_action_index *index = NULL;
+    sky_action_id_t action_ids[] = {21};
+    sky_object_id_t *object_ids = NULL;
+    uint32_t object_id_count = 0;
+    mu_assert_int_equals(sky_table_get_action_index(table, &index), 0);
+    mu_assert_int_equals(sky_action_index_get_object_ids(index, action_ids, 1, &object_ids, &object_id_count), 0);
+    mu_assert_int_equals(object_id_count, 1);
+    mu_assert_bool(object_ids[0] == 10);
+    free(object_ids);
+    mu_assert_int_equals(sky_table_close(table), 0);
+    sky_table_free(table);
+
+    // The format is kept when the table is reopened.
+    table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_bool(table->data_file->action_only);
+    mu_assert_int_equals(sky_table_close(table), 0);
+    sky_table_free(table);
+
+    // An existing table is not converted.
+    mu_assert_int_equals(sky_file_rm(&marker_path), 0);
+    table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_set_action_only(table, true), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_bool(!table->action_only);
+    mu_assert(!sky_file_exists(&marker_path), "");
+    mu_assert_int_equals(sky_table_close(table), 0);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//--------------------------------------
+// Shards
+//--------------------------------------
+
+int test_sky_table_shards() {
+    struct tagbstring shard_path = bsStatic("tmp/3/data");
+    struct tagbstring count_str = bsStatic("count");
+    uint32_t i;
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    cleantmp();
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_set_shard_count(table, 4), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_bool(table->shard_set != NULL);
+    mu_assert_bool(table->data_file == NULL);
+    mu_assert_int_equals(sky_table_get_data_file_count(table), 4);
+    mu_assert(sky_file_exists(&shard_path), "");
+    mu_assert_int_equals(sky_table_set_shard_count(table, 2), -1);
+    mu_assert_int_equals(sky_table_set_memtable_size(table, 10), -1);
+
+    // Batches are split across the shards and single events follow them.
+    sky_event *events[200];
+    for(i=0; i<200; i++) {
+        events[i] = sky_event_create((i / 2) + 1, (sky_timestamp_t)(i % 2) * 1000000LL, (i % 2) + 1);
+    }
+    mu_assert_int_equals(sky_table_add_events(table, events, 200), 0);
+    for(i=0; i<200; i++) {
+        sky_event_free(events[i]);
+    }
+    sky_event *event = sky_event_create(1000, 0LL, 1);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    sky_event_free(event);
+    for(i=0; i<4; i++) {
+        mu_assert_bool(table->shard_set->shards[i].data_file->block_count > 0);
+    }
+
+    // Paths are found in the shard of their object.
+    mu_assert_int_equals(sky_table_find_path(table, 50, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+    mu_assert_bool(sky_table_get_object_data_file(table, 50) == table->shard_set->shards[sky_shard_set_get_shard_index(table->shard_set, 50)].data_file);
+
+    // Queries aggregate over every shard.
+    sky_query *query = sky_query_create();
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    sky_query_result *result = sky_query_result_create(query);
+    mu_assert_int_equals(sky_table_execute_query(table, query, result), 0);
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_int64_equals((long long)result->values[0], 101LL);
+    mu_assert_int64_equals((long long)result->values[1], 100LL);
+    sky_query_result_free(result);
+    sky_query_free(query);
+
+    // The action index covers every shard.
+    sky_action_index *index = NULL;
+    sky_action_id_t action_ids[] = {2};
+    sky_object_id_t *object_ids = NULL;
+    uint32_t object_id_count = 0;
+    mu_assert_int_equals(sky_table_get_action_index(table, &index), 0);
+    mu_assert_int_equals(sky_action_index_get_object_ids(index, action_ids, 1, &object_ids, &object_id_count), 0);
+    mu_assert_int_equals(object_id_count, 100);
+    free(object_ids);
+
+    // Removal goes to the owning shard.
+    bool removed = false;
+    mu_assert_int_equals(sky_table_remove_object(table, 50, &removed), 0);
+    mu_assert_bool(removed);
+    mu_assert_int_equals(sky_table_find_path(table, 50, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    mu_assert_int_equals(sky_table_close(table), 0);
+    sky_table_free(table);
+
+    // The shard count is kept when the table is reopened.
+    table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_int_equals(table->shard_count, 4);
+    mu_assert_int_equals(sky_table_find_path(table, 1000, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+    mu_assert_int_equals(sky_table_close(table), 0);
+    sky_table_free(table);
+
+    // An existing table is not sharded.
+    cleantmp();
+    table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_int_equals(sky_table_close(table), 0);
+    mu_assert_int_equals(sky_table_set_shard_count(table, 4), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_bool(table->shard_set == NULL);
+    mu_assert_int_equals(table->shard_count, 1);
+    mu_assert_int_equals(sky_table_close(table), 0);
+    sky_table_free(table);
+    return 0;
+}
+
+int test_sky_table_partitions() {
+    struct tagbstring period_path = bsStatic("tmp/partitions/period");
+    struct tagbstring tablespace_path = bsStatic("tmp/0");
+    struct tagbstring count_str = bsStatic("count");
+    void **paths = NULL;
+    uint32_t path_count = 0;
+    sky_query_profile profile;
+    cleantmp();
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_set_partition_period(table, 86400), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_bool(table->partition_set != NULL);
+    mu_assert_bool(table->data_file == NULL);
+    mu_assert_int_equals(sky_table_get_data_file_count(table), 0);
+    mu_assert(sky_file_exists(&period_path), "");
+    mu_assert(!sky_file_exists(&tablespace_path), "");
+    mu_assert_int_equals(sky_table_set_partition_period(table, 3600), -1);
+    mu_assert_int_equals(sky_table_set_memtable_size(table, 10), -1);
+
+    // Events go to the partition of their day. The older events are two
+    // days before today so that their partition can be expired.
+    sky_timestamp_t now = 0;
+    sky_timestamp_now(&now);
+    sky_timestamp_t day = 86400LL * 1000000LL;
+    sky_timestamp_t day0 = sky_partition_set_get_period_start(table->partition_set, now) - (2 * day);
+    sky_timestamp_t day1 = now - 10000000LL;
+    sky_event *events[3];
+    events[0] = sky_event_create(1, day0, 1);
+    events[1] = sky_event_create(1, day1, 2);
+    events[2] = sky_event_create(2, day1, 1);
+    mu_assert_int_equals(sky_table_add_events(table, events, 3), 0);
+    sky_event_free(events[0]);
+    sky_event_free(events[1]);
+    sky_event_free(events[2]);
+    sky_event *event = sky_event_create(2, day1 + 1000000LL, 3);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    sky_event_free(event);
+    mu_assert_int_equals(sky_table_get_data_file_count(table), 2);
+    mu_assert_bool(sky_table_get_object_data_file(table, 1) == NULL);
+
+    // The path of an object is found in every partition it has events in.
+    mu_assert_int_equals(sky_table_find_path(table, 1, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 2);
+    free(paths);
+
+    // Sequences carry across partitions.
+    sky_action_id_t sequence[] = {1};
+    sky_query *query = sky_query_create();
+    sky_query_set_sequence(query, sequence, 1);
+    sky_query_set_group_by(query, SKY_QUERY_FIELD_ACTION, 0);
+    sky_query_add_aggregate(query, SKY_QUERY_AGGREGATE_COUNT, 0, &count_str);
+    memset(&profile, 0, sizeof(profile));
+    sky_query_result *result = sky_query_result_create(query);
+    result->profile = &profile;
+    mu_assert_int_equals(sky_table_execute_query(table, query, result), 0);
+    mu_assert_int_equals(result->group_count, 2);
+    mu_assert_int64_equals((long long)result->values[0], 1LL);
+    mu_assert_int64_equals((long long)result->values[1], 1LL);
+    mu_assert_int64_equals((long long)profile.path_count, 3LL);
+    sky_query_result_free(result);
+
+    // A query over the recent events only reads their partition.
+    sky_query_add_filter(query, SKY_QUERY_FIELD_TIMESTAMP, 0, day1, now);
+    memset(&profile, 0, sizeof(profile));
+    result = sky_query_result_create(query);
+    result->profile = &profile;
+    mu_assert_int_equals(sky_table_execute_query(table, query, result), 0);
+    mu_assert_int_equals(result->group_count, 1);
+    mu_assert_int64_equals((long long)profile.path_count, 2LL);
+    sky_query_result_free(result);
+    sky_query_free(query);
+
+    // The action index covers every partition.
+    sky_action_index *index = NULL;
+    sky_action_id_t action_ids[] = {1};
+    sky_object_id_t *object_ids = NULL;
+    uint32_t object_id_count = 0;
+    mu_assert_int_equals(sky_table_get_action_index(table, &index), 0);
+    mu_assert_int_equals(sky_action_index_get_object_ids(index, action_ids, 1, &object_ids, &object_id_count), 0);
+    mu_assert_int_equals(object_id_count, 2);
+    free(object_ids);
+
+    // Expiring the older events removes their partition.
+    uint32_t count = 0;
+    mu_assert_int_equals(sky_table_set_retention(table, 86400), 0);
+    mu_assert_int_equals(sky_table_expire(table, &count), 0);
+    mu_assert_int_equals(count, 1);
+    mu_assert_int_equals(sky_table_get_data_file_count(table), 1);
+    mu_assert_int_equals(sky_table_find_path(table, 1, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+
+    // Removal goes to every partition.
+    bool removed = false;
+    mu_assert_int_equals(sky_table_remove_object(table, 1, &removed), 0);
+    mu_assert_bool(removed);
+    mu_assert_int_equals(sky_table_find_path(table, 1, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 0);
+    mu_assert_int_equals(sky_table_close(table), 0);
+    sky_table_free(table);
+
+    // The period is kept when the table is reopened.
+    table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_int_equals(table->partition_period, 86400);
+    mu_assert_int_equals(sky_table_get_data_file_count(table), 1);
+    mu_assert_int_equals(sky_table_find_path(table, 2, &paths, &path_count), 0);
+    mu_assert_int_equals(path_count, 1);
+    free(paths);
+    mu_assert_int_equals(sky_table_close(table), 0);
+    sky_table_free(table);
+
+    // An existing table is not partitioned.
+    cleantmp();
+    table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_int_equals(sky_table_close(table), 0);
+    mu_assert_int_equals(sky_table_set_partition_period(table, 86400), 0);
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_bool(table->partition_set == NULL);
+    mu_assert_int_equals(table->partition_period, 0);
+    mu_assert_int_equals(sky_table_close(table), 0);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//--------------------------------------
+// Memory
+//--------------------------------------
+
+int test_sky_table_get_memory() {
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table_memory memory;
+    memset(&memory, 0, sizeof(memory));
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_get_memory(table, &memory), -1);
+    mu_assert_int_equals(sky_table_open(table), 0);
+
+    // The data file is mapped and its blocks are counted.
+    mu_assert_int_equals(sky_table_get_memory(table, &memory), 0);
+    mu_assert_bool(memory.mapped_bytes >= memory.data_bytes);
+    mu_assert_bool(memory.data_bytes > 0);
+    mu_assert_bool(memory.resident_bytes <= memory.mapped_bytes);
+    mu_assert_bool(memory.block_bytes >= table->data_file->block_count * sizeof(sky_block));
+    mu_assert_long_equals(memory.index_bytes, 0L);
+    mu_assert_long_equals(memory.memtable_bytes, 0L);
+    mu_assert_long_equals(memory.subscription_bytes, 0L);
+
+    // Loading the schema and building an index adds to the heap.
+    size_t schema_bytes = memory.schema_bytes;
+    mu_assert_int_equals(sky_property_file_ensure_loaded(table->property_file), 0);
+    sky_action_index *index = NULL;
+    mu_assert_int_equals(sky_table_get_action_index(table, &index), 0);
+    mu_assert_int_equals(sky_table_get_memory(table, &memory), 0);
+    mu_assert_bool(memory.schema_bytes > schema_bytes);
+    mu_assert_bool(memory.index_bytes > 0);
+
+    // Reading every block brings the data into the page cache.
+    uint32_t i;
+    volatile uint8_t sum = 0;
+    for(i=0; i<table->data_file->data_length; i+=512) {
+        sum += ((uint8_t*)table->data_file->extents[0].data)[i];
+    }
+    mu_assert_int_equals(sky_table_get_memory(table, &memory), 0);
+    mu_assert_bool(memory.resident_bytes > 0);
+
+    sky_table_memory_free(&memory);
+    sky_table_free(table);
+    return 0;
+}
+
+
 //==============================================================================
 //
 // Setup
@@ -57,6 +700,16 @@ int test_sky_table_open() {
 
 int all_tests() {
     mu_run_test(test_sky_table_open);
+    mu_run_test(test_sky_table_open_loads_files_lazily);
+    mu_run_test(test_sky_table_memtable);
+    mu_run_test(test_sky_table_reorder_window);
+    mu_run_test(test_sky_table_fixed_properties);
+    mu_run_test(test_sky_table_remove_events);
+    mu_run_test(test_sky_table_expire);
+    mu_run_test(test_sky_table_action_only);
+    mu_run_test(test_sky_table_shards);
+    mu_run_test(test_sky_table_partitions);
+    mu_run_test(test_sky_table_get_memory);
     return 0;
 }
 
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <tail_message.h>
+#include <minipack.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_tail_message_pack_unpack() {
+    cleantmp();
+    sky_tail_message *message = sky_tail_message_create();
+    message->subscription_id = 20;
+    message->limit = 100;
+    message->close = true;
+
+    FILE *file = fopen("tmp/message", "w");
+    mu_assert_int_equals(sky_tail_message_pack(message, file), 0);
+    fclose(file);
+    sky_tail_message_free(message);
+
+    file = fopen("tmp/message", "r");
+    message = sky_tail_message_create();
+    mu_assert_int_equals(sky_tail_message_unpack(message, file), 0);
+    fclose(file);
+    mu_assert_int64_equals((long long)message->subscription_id, 20LL);
+    mu_assert_int_equals(message->limit, 100);
+    mu_assert_bool(message->close);
+    sky_tail_message_free(message);
+    return 0;
+}
+
+
+//--------------------------------------
+// Processing
+//--------------------------------------
+
+int test_sky_tail_message_process() {
+    sky_action_id_t action_ids[] = {2};
+    sky_subscription *subscription = NULL;
+    importtmp("tests/fixtures/query/0/import.json");
+    sky_table *table = sky_table_create();
+    table->path = bfromcstr("tmp");
+    mu_assert_int_equals(sky_table_open(table), 0);
+    mu_assert_int_equals(sky_table_add_subscription(table, 2, action_ids, 1, &subscription), 0);
+
+    // Only events added after subscribing that pass the filter are buffered.
+    sky_event *event = sky_event_create(4, 100, 2);
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    event->action_id = 1;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    event->action_id = 2;
+    event->object_id = 5;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    event->object_id = 6;
+    mu_assert_int_equals(sky_table_add_event(table, event), 0);
+    mu_assert_int_equals(sky_subscription_get_event_count(subscription), 2);
+
+    // The oldest event was dropped and the next one is returned first.
+    //   {status:"ok", dropped:1, events:[{objectId:5, timestamp:100, actionId:2, data:{}}]}
+    sky_tail_message *message = sky_tail_message_create();
+    message->subscription_id = subscription->id;
+    message->limit = 1;
+    sky_buffer *output = sky_buffer_create();
+    mu_assert_int_equals(sky_tail_message_process(message, table, output), 0);
+    char expected1[] = "\x83" "\xA6" "status" "\xA2" "ok" "\xA7" "dropped" "\x01"
+        "\xA6" "events" "\x91" "\x84" "\xA8" "objectId" "\x05" "\xA9" "timestamp" "\x64"
+        "\xA8" "actionId" "\x02" "\xA4" "data" "\x80";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected1) - 1));
+    mu_assert_mem(output->data, expected1, sizeof(expected1) - 1);
+    mu_assert_int_equals(sky_subscription_get_event_count(subscription), 1);
+
+    // A closing message returns the rest and removes the subscription.
+    //   {status:"ok", dropped:0, events:[{objectId:6, ...}]}
+    message->limit = 0;
+    message->close = true;
+    sky_buffer_clear(output);
+    mu_assert_int_equals(sky_tail_message_process(message, table, output), 0);
+    char expected2[] = "\x83" "\xA6" "status" "\xA2" "ok" "\xA7" "dropped" "\x00"
+        "\xA6" "events" "\x91" "\x84" "\xA8" "objectId" "\x06" "\xA9" "timestamp" "\x64"
+        "\xA8" "actionId" "\x02" "\xA4" "data" "\x80";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected2) - 1));
+    mu_assert_mem(output->data, expected2, sizeof(expected2) - 1);
+    mu_assert_int_equals(table->subscription_count, 0);
+
+    //   {status:"not found"}
+    sky_buffer_clear(output);
+    mu_assert_int_equals(sky_tail_message_process(message, table, output), 0);
+    char expected3[] = "\x81" "\xA6" "status" "\xA9" "not found";
+    mu_assert_long_equals((long)output->length, (long)(sizeof(expected3) - 1));
+    mu_assert_mem(output->data, expected3, sizeof(expected3) - 1);
+
+    sky_buffer_free(output);
+    sky_tail_message_free(message);
+    sky_event_free(event);
+    sky_table_free(table);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_tail_message_pack_unpack);
+    mu_run_test(test_sky_tail_message_process);
+    return 0;
+}
+
+RUN_TESTS()
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include <timestamp.h>
 #include <bstring.h>
 
@@ -18,6 +19,13 @@
     mu_assert_int64_equals(timestamp, VALUE); \
 } while(0)
 
+#define mu_timestamp_format_assert(VALUE, STR) do {\
+    char buffer[SKY_TIMESTAMP_FORMAT_LENGTH]; \
+    int rc = sky_timestamp_format(VALUE, buffer, sizeof(buffer)); \
+    mu_assert_int_equals(rc, 0); \
+    mu_assert_with_msg(strcmp(buffer, STR) == 0, "Expected: %s; Received: %s", STR, buffer); \
+} while(0)
+
 
 //==============================================================================
 //
@@ -51,6 +59,21 @@ int test_sky_timestamp_parse()
     return 0;
 }
 
+int test_sky_timestamp_format()
+{
+    mu_timestamp_format_assert(0LL, "1970-01-01T00:00:00Z");
+    mu_timestamp_format_assert(1262428220000000LL, "2010-01-02T10:30:20Z");
+
+    // Fractional seconds are only written when needed.
+    mu_timestamp_format_assert(1262428220000250LL, "2010-01-02T10:30:20.000250Z");
+    mu_timestamp_format_assert(-1LL, "1969-12-31T23:59:59.999999Z");
+
+    // Buffers that are too small are rejected.
+    char buffer[10];
+    mu_assert_int_equals(sky_timestamp_format(0LL, buffer, sizeof(buffer)), -1);
+    return 0;
+}
+
 //==============================================================================
 //
 // Setup
@@ -59,6 +82,7 @@ int test_sky_timestamp_parse()
 
 int all_tests() {
     mu_run_test(test_sky_timestamp_parse);
+    mu_run_test(test_sky_timestamp_format);
     return 0;
 }
 
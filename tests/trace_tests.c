@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <dbg.h>
+#include <file.h>
+#include <trace.h>
+#include <stats.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+struct tagbstring TRACE_LOG_PATH = bsStatic("tmp/trace.log");
+
+// Creates the header of a 'Query' message.
+sky_message_header *create_query_header()
+{
+    sky_message_header *header = sky_message_header_create();
+    header->version = 1;
+    header->name = bfromcstr("query");
+    header->type = SKY_MESSAGE_TYPE_QUERY;
+    header->database_name = bfromcstr("db");
+    header->table_name = bfromcstr("users");
+    header->pipelined = true;
+    header->request_id = 7;
+    return header;
+}
+
+// Reads the trace log into a string.
+bstring read_trace_log()
+{
+    FILE *file = fopen(bdata(&TRACE_LOG_PATH), "r");
+    if(file == NULL) return bfromcstr("");
+    bstring content = bread((bNread)fread, file);
+    fclose(file);
+    return content;
+}
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Serialization
+//--------------------------------------
+
+int test_sky_trace_write_msgpack_json() {
+    char *data = NULL;
+    size_t length = 0;
+    struct tagbstring query_str = bsStatic("query");
+    struct tagbstring value_str = bsStatic("a\"b\n");
+    struct tagbstring list_str = bsStatic("list");
+    sky_buffer *buffer = sky_buffer_create();
+    sky_buffer_pack_map(buffer, 3);
+    sky_buffer_pack_bstring(buffer, &query_str);
+    sky_buffer_pack_bstring(buffer, &value_str);
+    sky_buffer_pack_bstring(buffer, &list_str);
+    sky_buffer_pack_array(buffer, 4);
+    sky_buffer_pack_uint(buffer, 1000);
+    sky_buffer_pack_int(buffer, -3);
+    sky_buffer_pack_bool(buffer, true);
+    sky_buffer_pack_nil(buffer);
+    sky_buffer_pack_uint(buffer, 5);
+    sky_buffer_pack_map(buffer, 0);
+
+    FILE *file = open_memstream(&data, &length);
+    mu_assert_int_equals(sky_trace_write_msgpack_json(buffer->data, buffer->length, file), 0);
+    fclose(file);
+    mu_assert_with_msg(strcmp(data, "{\"query\":\"a\\\"b\\n\",\"list\":[1000,-3,true,null],\"5\":{}}") == 0, "Unexpected JSON: %s", data);
+    free(data);
+
+    // A truncated element is rejected.
+    file = open_memstream(&data, &length);
+    mu_assert_int_equals(sky_trace_write_msgpack_json(buffer->data, buffer->length - 1, file), -1);
+    fclose(file);
+    free(data);
+
+    sky_buffer_free(buffer);
+    return 0;
+}
+
+
+//--------------------------------------
+// Tracing
+//--------------------------------------
+
+int test_sky_tracer_start() {
+    uint32_t i;
+    sky_message_header *header = create_query_header();
+    sky_tracer *tracer = sky_tracer_create();
+
+    // Nothing is traced without sampling or a slow query threshold.
+    mu_assert_bool(sky_tracer_start(tracer, header, sky_stats_now()) == NULL);
+
+    // Every second message is sampled.
+    tracer->sample_rate = 2;
+    uint32_t sampled_count = 0;
+    for(i=0; i<4; i++) {
+        sky_trace *trace = sky_tracer_start(tracer, header, sky_stats_now());
+        if(trace != NULL) {
+            mu_assert_bool(trace->sampled);
+            mu_assert_int_equals(trace->type, SKY_MESSAGE_TYPE_QUERY);
+            mu_assert_long_equals((long)trace->request_id, 7L);
+            sampled_count++;
+        }
+        sky_trace_free(trace);
+    }
+    mu_assert_int_equals(sampled_count, 2);
+
+    // Every message is traced when slow queries are logged.
+    tracer->sample_rate = 0;
+    tracer->slow_threshold = 1000;
+    for(i=0; i<4; i++) {
+        sky_trace *trace = sky_tracer_start(tracer, header, sky_stats_now());
+        mu_assert_bool(trace != NULL);
+        mu_assert_bool(!trace->sampled);
+        sky_trace_free(trace);
+    }
+
+    sky_tracer_free(tracer);
+    sky_message_header_free(header);
+    return 0;
+}
+
+int test_sky_tracer_finish() {
+    cleantmp();
+    struct tagbstring query_str = bsStatic("query");
+    sky_message_header *header = create_query_header();
+    sky_tracer *tracer = sky_tracer_create();
+    tracer->slow_threshold = 1000000;
+    mu_assert_int_equals(sky_tracer_open(tracer, &TRACE_LOG_PATH), 0);
+
+    // A fast message is not logged.
+    sky_trace *trace = sky_tracer_start(tracer, header, sky_stats_now());
+    sky_trace_mark(trace, SKY_TRACE_SPAN_EXECUTE);
+    mu_assert_bool(!sky_tracer_should_log(tracer, trace));
+    mu_assert_int_equals(sky_tracer_finish(tracer, trace), 0);
+    bstring content = read_trace_log();
+    mu_assert_int_equals(blength(content), 0);
+    bdestroy(content);
+
+    // A message that started long ago is logged with its spans, scan counts
+    // and body.
+    sky_buffer *body = sky_buffer_create();
+    sky_buffer_pack_bstring(body, &query_str);
+    trace = sky_tracer_start(tracer, header, sky_stats_now() - 2000000);
+    sky_trace_current = trace;
+    sky_trace_add_scan(100, 3, 4);
+    sky_trace_mark_current(SKY_TRACE_SPAN_EXECUTE);
+    sky_trace_current = NULL;
+    mu_assert_int_equals(sky_tracer_capture_body(tracer, trace, body->data, body->length), 0);
+    mu_assert_bool(trace->body != NULL);
+    mu_assert_int_equals(sky_tracer_finish(tracer, trace), 0);
+    mu_assert_long_equals((long)tracer->slow_count, 1L);
+
+    content = read_trace_log();
+    mu_assert_bool(strstr(bdata(content), "\"slow\":true,\"sampled\":false,\"type\":\"query\",\"database\":\"db\",\"table\":\"users\",\"requestId\":7,\"failed\":false,") != NULL);
+    mu_assert_bool(strstr(bdata(content), "\"scannedEvents\":100,\"blocksVisited\":3,\"blocksSkipped\":4,\"responseLength\":0,\"body\":\"query\"}\n") != NULL);
+    mu_assert_bool(strstr(bdata(content), "\"spans\":{\"header\":") != NULL);
+    bdestroy(content);
+
+    sky_buffer_free(body);
+    sky_tracer_free(tracer);
+    sky_message_header_free(header);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_trace_write_msgpack_json);
+    mu_run_test(test_sky_tracer_start);
+    mu_run_test(test_sky_tracer_finish);
+    return 0;
+}
+
+RUN_TESTS()
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <worker.h>
+#include <server.h>
+#include <mem.h>
+
+#include "minunit.h"
+
+
+//==============================================================================
+//
+// Helpers
+//
+//==============================================================================
+
+sky_connection CONNECTION;
+
+// Queues a message of a given type without a body.
+#define enqueue(WORKER, TYPE) do {\
+    sky_message_header *_header = sky_message_header_create();\
+    _header->type = TYPE;\
+    mu_assert_int_equals(sky_worker_enqueue(WORKER, &CONNECTION, _header, NULL, NULL, SKY_WORKER_REPLY_DISPATCH, 0), 0);\
+} while(0)
+
+// Asserts the type of the next job that the worker would process.
+#define mu_assert_dequeue(WORKER, DRAIN, TYPE) do {\
+    sky_worker_job *_job = sky_worker_dequeue(WORKER, DRAIN);\
+    mu_assert_bool(_job != NULL);\
+    mu_assert_int_equals(_job->header->type, TYPE);\
+    if(_job->scan_slot) sky_server_release_scan((WORKER)->server);\
+    sky_message_header_free(_job->header);\
+    free(_job);\
+} while(0)
+
+
+//==============================================================================
+//
+// Test Cases
+//
+//==============================================================================
+
+//--------------------------------------
+// Admission
+//--------------------------------------
+
+int test_sky_worker_get_queue() {
+    mu_assert_int_equals(sky_worker_get_queue(SKY_MESSAGE_TYPE_QUERY), SKY_WORKER_QUEUE_LOW);
+    mu_assert_int_equals(sky_worker_get_queue(SKY_MESSAGE_TYPE_NEXT_ACTION), SKY_WORKER_QUEUE_LOW);
+    mu_assert_int_equals(sky_worker_get_queue(SKY_MESSAGE_TYPE_COMPACT), SKY_WORKER_QUEUE_LOW);
+    mu_assert_int_equals(sky_worker_get_queue(SKY_MESSAGE_TYPE_SNAPSHOT), SKY_WORKER_QUEUE_LOW);
+    mu_assert_int_equals(sky_worker_get_queue(SKY_MESSAGE_TYPE_EADD), SKY_WORKER_QUEUE_HIGH);
+    mu_assert_int_equals(sky_worker_get_queue(SKY_MESSAGE_TYPE_EGET), SKY_WORKER_QUEUE_HIGH);
+    mu_assert_bool(sky_worker_is_write(SKY_MESSAGE_TYPE_EBULK));
+    mu_assert_bool(!sky_worker_is_write(SKY_MESSAGE_TYPE_EGET));
+    return 0;
+}
+
+int test_sky_worker_accepts_write() {
+    sky_server *server = sky_server_create(NULL);
+    server->max_queued_writes = 2;
+    sky_worker *worker = sky_worker_create(server, 0, 1, 0);
+    enqueue(worker, SKY_MESSAGE_TYPE_EADD);
+    enqueue(worker, SKY_MESSAGE_TYPE_QUERY);
+    mu_assert_bool(sky_worker_accepts_write(worker));
+    enqueue(worker, SKY_MESSAGE_TYPE_AADD);
+    mu_assert_bool(!sky_worker_accepts_write(worker));
+
+    // Writes are accepted again once they are taken off the queue.
+    mu_assert_dequeue(worker, false, SKY_MESSAGE_TYPE_EADD);
+    mu_assert_bool(sky_worker_accepts_write(worker));
+    mu_assert_dequeue(worker, false, SKY_MESSAGE_TYPE_AADD);
+    mu_assert_dequeue(worker, false, SKY_MESSAGE_TYPE_QUERY);
+    mu_assert_int_equals(worker->queued_write_count, 0);
+
+    sky_worker_free(worker);
+    sky_server_free(server);
+    return 0;
+}
+
+
+//--------------------------------------
+// Job Management
+//--------------------------------------
+
+int test_sky_worker_dequeue_priority() {
+    uint32_t i;
+    sky_server *server = sky_server_create(NULL);
+    sky_worker *worker = sky_worker_create(server, 0, 1, 0);
+
+    // Writes go ahead of scans that were queued before them.
+    enqueue(worker, SKY_MESSAGE_TYPE_QUERY);
+    enqueue(worker, SKY_MESSAGE_TYPE_EADD);
+    mu_assert_dequeue(worker, false, SKY_MESSAGE_TYPE_EADD);
+    mu_assert_dequeue(worker, false, SKY_MESSAGE_TYPE_QUERY);
+    mu_assert_bool(sky_worker_dequeue(worker, false) == NULL);
+
+    // A flood of writes cannot hold a scan back for ever.
+    enqueue(worker, SKY_MESSAGE_TYPE_QUERY);
+    for(i=0; i<SKY_WORKER_MAX_HIGH_STREAK+2; i++) {
+        enqueue(worker, SKY_MESSAGE_TYPE_EADD);
+    }
+    for(i=0; i<SKY_WORKER_MAX_HIGH_STREAK; i++) {
+        mu_assert_dequeue(worker, false, SKY_MESSAGE_TYPE_EADD);
+    }
+    mu_assert_dequeue(worker, false, SKY_MESSAGE_TYPE_QUERY);
+    mu_assert_dequeue(worker, false, SKY_MESSAGE_TYPE_EADD);
+    mu_assert_dequeue(worker, false, SKY_MESSAGE_TYPE_EADD);
+    mu_assert_bool(sky_worker_dequeue(worker, false) == NULL);
+
+    sky_worker_free(worker);
+    sky_server_free(server);
+    return 0;
+}
+
+int test_sky_worker_dequeue_scan_limit() {
+    sky_server *server = sky_server_create(NULL);
+    server->max_concurrent_scans = 1;
+    sky_worker *worker = sky_worker_create(server, 0, 1, 0);
+    server->workers = &worker;
+    server->worker_count = 1;
+
+    // Scans wait for a slot while the other jobs carry on.
+    mu_assert_bool(sky_server_acquire_scan(server));
+    enqueue(worker, SKY_MESSAGE_TYPE_QUERY);
+    enqueue(worker, SKY_MESSAGE_TYPE_EGET);
+    mu_assert_dequeue(worker, false, SKY_MESSAGE_TYPE_EGET);
+    mu_assert_bool(sky_worker_dequeue(worker, false) == NULL);
+
+    // The scan starts once the slot is returned.
+    sky_server_release_scan(server);
+    sky_worker_job *job = sky_worker_dequeue(worker, false);
+    mu_assert_bool(job != NULL && job->scan_slot);
+    mu_assert_int_equals(server->active_scan_count, 1);
+    sky_server_release_scan(server);
+    sky_message_header_free(job->header);
+    free(job);
+
+    // Draining ignores the limit.
+    mu_assert_bool(sky_server_acquire_scan(server));
+    enqueue(worker, SKY_MESSAGE_TYPE_QUERY);
+    mu_assert_bool(sky_worker_dequeue(worker, false) == NULL);
+    mu_assert_dequeue(worker, true, SKY_MESSAGE_TYPE_QUERY);
+    sky_server_release_scan(server);
+    mu_assert_int_equals(server->active_scan_count, 0);
+
+    server->workers = NULL;
+    server->worker_count = 0;
+    sky_worker_free(worker);
+    sky_server_free(server);
+    return 0;
+}
+
+
+//==============================================================================
+//
+// Setup
+//
+//==============================================================================
+
+int all_tests() {
+    mu_run_test(test_sky_worker_get_queue);
+    mu_run_test(test_sky_worker_accepts_write);
+    mu_run_test(test_sky_worker_dequeue_priority);
+    mu_run_test(test_sky_worker_dequeue_scan_limit);
+    return 0;
+}
+
+RUN_TESTS()